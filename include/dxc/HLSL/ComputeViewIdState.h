@@ -15,6 +15,9 @@
 #include "llvm/Pass.h"
 #include "dxc/HLSL/ControlDependence.h"
 #include "llvm/Support/GenericDomTree.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/SparseBitVector.h"
 
 #include <memory>
 #include <bitset>
@@ -98,14 +101,15 @@ private:
   // Information per entry point.
   using FunctionSetType = std::unordered_set<llvm::Function *>;
   using InstructionSetType = std::unordered_set<llvm::Instruction *>;
+  using InstructionNumberSetType = llvm::SparseBitVector<>;
   struct EntryInfo {
     llvm::Function *pEntryFunc = nullptr;
     // Sets of functions that may be reachable from an entry.
     FunctionSetType Functions;
     // Outputs to analyze.
     InstructionSetType Outputs;
-    // Contributing instructions per output.
-    std::unordered_map<unsigned, InstructionSetType> ContributingInstructions[kNumStreams];
+    // Contributing instructions per output, as instruction numbers.
+    std::unordered_map<unsigned, InstructionNumberSetType> ContributingInstructions[kNumStreams];
 
     void Clear();
   };
@@ -130,6 +134,13 @@ private:
   // Cache of stores for each decl.
   std::unordered_map<llvm::Value *, ValueSetType> m_StoresPerDeclCache;
 
+  // Dense numbering of the instructions seen by the analysis, so that the
+  // per-output sets of contributing instructions can be bit vectors.
+  llvm::DenseMap<llvm::Instruction *, unsigned> m_InstructionNumbers;
+  std::vector<llvm::Instruction *> m_NumberedInstructions;
+
+  using ValueWorklistType = llvm::SmallVector<llvm::Value *, 16>;
+
   // Serialized form.
   std::vector<unsigned> m_SerializedState;
 
@@ -138,18 +149,16 @@ private:
   void ComputeReachableFunctionsRec(llvm::CallGraph &CG, llvm::CallGraphNode *pNode, FunctionSetType &FuncSet);
   void AnalyzeFunctions(EntryInfo &Entry);
   void CollectValuesContributingToOutputs(EntryInfo &Entry);
-  void CollectValuesContributingToOutputRec(EntryInfo &Entry,
-                                            llvm::Value *pContributingValue,
-                                            InstructionSetType &ContributingInstructions);
-  void CollectPhiCFValuesContributingToOutputRec(llvm::PHINode *pPhi,
-                                                 EntryInfo &Entry,
-                                                 InstructionSetType &ContributingInstructions);
+  unsigned GetInstructionNumber(llvm::Instruction *pInst);
+  void CollectValuesContributingToOutput(EntryInfo &Entry,
+                                         ValueWorklistType &Worklist,
+                                         InstructionNumberSetType &ContributingInstructions);
+  void CollectPhiCFValuesContributingToOutput(llvm::PHINode *pPhi,
+                                              ValueWorklistType &Worklist);
   const ValueSetType &CollectReachingDecls(llvm::Value *pValue);
-  void CollectReachingDeclsRec(llvm::Value *pValue, ValueSetType &ReachingDecls, ValueSetType &Visited);
   const ValueSetType &CollectStores(llvm::Value *pValue);
-  void CollectStoresRec(llvm::Value *pValue, ValueSetType &Stores, ValueSetType &Visited);
   void UpdateDynamicIndexUsageState() const;
-  void CreateViewIdSets(const std::unordered_map<unsigned, InstructionSetType> &ContributingInstructions,
+  void CreateViewIdSets(const std::unordered_map<unsigned, InstructionNumberSetType> &ContributingInstructions,
                         OutputsDependentOnViewIdType &OutputsDependentOnViewId,
                         InputsContributingToOutputType &InputsContributingToOutputs, bool bPC);
 
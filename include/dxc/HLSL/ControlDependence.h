@@ -12,9 +12,12 @@
 #pragma once
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/Dominators.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SparseBitVector.h"
 
 #include <unordered_set>
 #include <unordered_map>
+#include <vector>
 
 namespace llvm {
   class Function;
@@ -26,22 +29,30 @@ namespace hlsl {
 
 using BasicBlockSet = std::unordered_set<llvm::BasicBlock *>;
 using PostDomRelationType = llvm::DominatorTreeBase<llvm::BasicBlock>;
+// Set of blocks, as indices into the function's block numbering.
+using BasicBlockIndexSet = llvm::SparseBitVector<>;
 
 class ControlDependence {
 public:
   void Compute(llvm::Function *F, PostDomRelationType &PostDomRel);
   void Clear();
-  const BasicBlockSet &GetCDBlocks(llvm::BasicBlock *pBB) const;
+  // Returns the indices of the blocks pBB is control dependent on;
+  // use GetBlock to map them back to blocks.
+  const BasicBlockIndexSet &GetCDBlocks(llvm::BasicBlock *pBB) const;
+  llvm::BasicBlock *GetBlock(unsigned Index) const { return m_Blocks[Index]; }
   void print(llvm::raw_ostream &OS);
   void dump();
 
 private:
   using BasicBlockVector = std::vector<llvm::BasicBlock *>;
-  using ControlDependenceType = std::unordered_map<llvm::BasicBlock *, BasicBlockSet>;
 
   llvm::Function *m_pFunc;
-  ControlDependenceType m_ControlDependence;
-  BasicBlockSet m_EmptyBBSet;
+  // Blocks in function order, and each block's index in it.
+  BasicBlockVector m_Blocks;
+  llvm::DenseMap<llvm::BasicBlock *, unsigned> m_BlockIndex;
+  // Control dependence sets, by block index.
+  std::vector<BasicBlockIndexSet> m_ControlDependence;
+  BasicBlockIndexSet m_EmptyBBSet;
 
   llvm::BasicBlock *GetIPostDom(PostDomRelationType &PostDomRel, llvm::BasicBlock *pBB);
   void ComputeRevTopOrderRec(PostDomRelationType &PostDomRel, llvm::BasicBlock *pBB,
@@ -0,0 +1,88 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxcPhaseReport.h                                                          //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Collects per-phase timing and memory use of a compile.                    //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "dxc/Support/WinIncludes.h"
+#include "dxc/Support/Global.h"
+#include "dxc/Support/CompilePhaseListener.h"
+#include <chrono>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace llvm {
+class raw_ostream;
+}
+
+namespace hlsl {
+
+/// Collects the phases of a compile for the report requested with
+/// -report-phases, and the passes run by the optimizer for -time-passes.
+///
+/// Times are inclusive of nested phases. A phase that runs more than once
+/// under the same parent, such as a function pass, is reported once with its
+/// times and allocations added up. Memory is attributed through the counting
+/// allocator the compile runs under, if any.
+class DxcPhaseReport : public CompilePhaseListener {
+public:
+  explicit DxcPhaseReport(_In_opt_ IMalloc *pCountingMalloc);
+
+  void phaseStarted(const char *pName) override;
+  void phaseFinished(const char *pName) override;
+
+  // Writes a header line naming the columns, then one tab-separated line
+  // per phase, each followed by the phases nested in it.
+  void Write(llvm::raw_ostream &OS) const;
+
+  struct Phase {
+    const char *pKey; // Name as first reported, to speed up lookups.
+    std::string Name;
+    unsigned Parent;
+    unsigned Depth;
+    unsigned long long Count;
+    unsigned long long WallMicroseconds;
+    unsigned long long AllocCount;
+    unsigned long long AllocBytes;
+    unsigned long long PeakLiveBytes;
+    long long SizeDelta; // Change in MeasureSize.
+  };
+  static const unsigned NoParent = ~0U;
+
+  // The phases in the order they first started; nested phases refer to
+  // their parent by index.
+  const std::vector<Phase> &GetPhases() const { return m_phases; }
+
+protected:
+  // Returns the size of what the phases work on, such as the number of
+  // instructions in a module, for SizeDelta; 0 by default. Measured outside
+  // of the timed region.
+  virtual uint64_t MeasureSize() const { return 0; }
+
+private:
+  typedef std::chrono::steady_clock Clock;
+  struct ActivePhase {
+    unsigned Index;
+    uint64_t StartSize;
+    Clock::time_point Start;
+    DxcCountingMallocStats StartStats;
+  };
+
+  unsigned FindOrAddPhase(const char *pName);
+  void WritePhases(llvm::raw_ostream &OS, unsigned parent) const;
+  void GetStats(DxcCountingMallocStats *pStats) const;
+
+  IMalloc *m_pCountingMalloc;
+  std::vector<Phase> m_phases;
+  std::vector<ActivePhase> m_active;
+};
+
+} // namespace hlsl
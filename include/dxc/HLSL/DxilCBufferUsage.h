@@ -0,0 +1,33 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilCBufferUsage.h                                                        //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Finds the parts of constant buffers that a shader reads.                  //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <utility>
+#include <vector>
+
+namespace hlsl {
+
+class DxilModule;
+
+/// Byte ranges [first, second) of one cbuffer instance that are read,
+/// sorted, with no two ranges overlapping or touching.
+typedef std::vector<std::pair<unsigned, unsigned>> DxilCBufferUsedRanges;
+
+/// Returns the ranges read from each cbuffer of DM, indexed by cbuffer ID.
+///
+/// A CBufferLoadLegacy row only counts the components extracted from it.
+/// A load whose offset isn't constant counts as reading from the constant
+/// part of its offset to the end of the cbuffer variable there, as when an
+/// array is indexed.
+std::vector<DxilCBufferUsedRanges> CollectCBufferUsage(DxilModule &DM);
+
+} // namespace hlsl
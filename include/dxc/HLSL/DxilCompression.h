@@ -0,0 +1,42 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilCompression.h                                                         //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Provides the codec for compressed DXIL container parts.                   //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+
+namespace hlsl {
+
+// The LZ codec (DxilCompressionCodec::LZ) is a byte-oriented LZ77 built for
+// speed over ratio. The compressed data is a series of sequences, each a
+// token byte, literals, and a match:
+//
+//   token: the literal count in the high four bits and the match length
+//          minus 4 in the low four; a value of 15 continues with bytes that
+//          are added to it until one is less than 255.
+//   literals: the literal bytes, copied as is.
+//   match: a little-endian 16-bit offset back into the output, then the
+//          continuation of the match length. Matches may overlap the bytes
+//          they produce.
+//
+// The last sequence has no match; the data ends after its literals.
+
+// Appends the compression of the Size bytes at pData to Compressed.
+void CompressLZ(const char *pData, size_t Size, std::vector<char> &Compressed);
+
+// Replaces Data with the decompression of the Size bytes at pCompressed.
+// Returns false if they aren't valid compressed data, or don't decompress to
+// exactly DecompressedSize bytes.
+bool DecompressLZ(const char *pCompressed, size_t Size,
+                  size_t DecompressedSize, std::vector<char> &Data);
+
+} // namespace hlsl
@@ -0,0 +1,73 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilComputeExecutor.h                                                     //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Runs DXIL compute shaders on the CPU.                                     //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <memory>
+
+namespace hlsl {
+
+class DxilModule;
+
+/// Reference executor for compiled compute shaders.
+///
+/// The entry function of a cs_6_x DxilModule is interpreted directly: every
+/// thread of a group runs until it reaches a group barrier or returns, and
+/// once all threads of the group have stopped they resume together.
+/// Thread groups of a dispatch are spread over worker threads.
+///
+/// Wave operations also stop a thread. The threads of a group form waves
+/// of consecutive flattened thread IDs, and a wave operation runs for the
+/// lanes of a wave that wait at that same operation.
+///
+/// Buffers are bound as host memory by register space and register:
+/// - ByteAddressBuffer and RWByteAddressBuffer are addressed in bytes;
+/// - structured buffers use the element stride from the DxilModule;
+/// - typed buffers hold tightly packed elements of their return type,
+///   so a Buffer<float4> element is 16 bytes and a Buffer<float3> one 12;
+/// - constant buffers use the cbuffer layout of the DxilModule.
+/// Loads outside of a bound range return zero, and stores outside of it
+/// are dropped.
+///
+/// Operations the executor doesn't support, such as textures and samplers,
+/// throw hlsl::Exception with E_NOTIMPL when they are reached. Other
+/// errors, like unbound resources, throw with E_INVALIDARG.
+///
+/// The DxilModule and the bound memory must outlive the executor, and
+/// neither may change while Dispatch runs.
+class DxilComputeExecutor {
+public:
+  explicit DxilComputeExecutor(DxilModule &DM);
+  ~DxilComputeExecutor();
+
+  void BindUAV(unsigned space, unsigned reg, void *pData, size_t size);
+  void BindSRV(unsigned space, unsigned reg, const void *pData, size_t size);
+  void BindCBuffer(unsigned space, unsigned reg, const void *pData,
+                   size_t size);
+
+  /// Number of threads running thread groups concurrently; 0, the default,
+  /// uses one per hardware thread.
+  void SetWorkerCount(unsigned count);
+
+  /// Lanes per wave, a power of two from 4 to 128; 32 by default.
+  void SetWaveSize(unsigned size);
+
+  /// Runs groupCountX * groupCountY * groupCountZ thread groups and returns
+  /// once all of them are done.
+  void Dispatch(unsigned groupCountX, unsigned groupCountY,
+                unsigned groupCountZ);
+
+private:
+  class Impl;
+  std::unique_ptr<Impl> m_pImpl;
+};
+
+} // namespace hlsl
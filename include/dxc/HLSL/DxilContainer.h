@@ -17,6 +17,7 @@
 #include <stdint.h>
 #include <iterator>
 #include <functional>
+#include <vector>
 #include "dxc/HLSL/DxilConstants.h"
 
 struct IDxcContainerReflection;
@@ -82,6 +83,8 @@ enum DxilFourCC {
   DFCC_RootSignature            = DXIL_FOURCC('R', 'T', 'S', '0'),
   DFCC_DXIL                     = DXIL_FOURCC('D', 'X', 'I', 'L'),
   DFCC_PipelineStateValidation  = DXIL_FOURCC('P', 'S', 'V', '0'),
+  DFCC_LinkIndex                = DXIL_FOURCC('L', 'I', 'D', 'X'),
+  DFCC_ShaderHash               = DXIL_FOURCC('H', 'A', 'S', 'H'),
 };
 
 #undef DXIL_FOURCC
@@ -223,6 +226,78 @@ struct DxilShaderDebugName {
 };
 static const size_t MinDxilShaderDebugNameSize = sizeof(DxilShaderDebugName) + 4;
 
+/// Content hash of a shader (DFCC_ShaderHash). The digest is the MD5 of the
+/// bitcode in the DXIL part, so it does not change with the debug name or
+/// debug info, and can key runtime caches of pipeline state.
+static const size_t DxilShaderHashSize = 16;
+struct DxilShaderHash {
+  uint32_t Flags;                       // Reserved, must be set to zero.
+  uint8_t Digest[DxilShaderHashSize];
+};
+
+/// Link index of a library (DFCC_LinkIndex). For each function defined in the
+/// library it lists the functions called and the globals referenced, so the
+/// linker can find what an entry needs without loading function bodies.
+struct DxilLinkIndexHeader {
+  uint32_t FunctionCount;   // Number of DxilLinkIndexFunction records.
+  uint32_t RefCount;        // Number of references.
+  uint32_t StringTableSize; // Byte count of the string table.
+  // Followed by FunctionCount DxilLinkIndexFunction records.
+  // Followed by RefCount uint32_t string table offsets.
+  // Followed by StringTableSize bytes of null-terminated UTF-8 names, padded
+  // with zero bytes to a 4-byte boundary.
+};
+struct DxilLinkIndexFunction {
+  uint32_t Name;        // String table offset of the function name.
+  uint32_t FirstCallee; // Index of the first called function reference.
+  uint32_t CalleeCount; // Number of called function references.
+  uint32_t FirstGlobal; // Index of the first referenced global reference.
+  uint32_t GlobalCount; // Number of referenced global references.
+};
+
+static const uint32_t DxilArchiveFourCC = 0x52415844; // 'DXAR'
+static const uint16_t DxilArchiveVersionMajor = 1;
+static const uint16_t DxilArchiveVersionMinor = 0;
+
+/// Use this type to describe an archive of DXIL containers, each looked up
+/// by a key. Parts with identical contents are stored once and shared by
+/// every entry that has them. All tables are located by offsets from the
+/// start of this header and are 8-byte aligned, so the archive can be used
+/// in place from a mapped file.
+struct DxilArchiveHeader {
+  uint32_t              HeaderFourCC;       // DxilArchiveFourCC.
+  DxilContainerVersion  Version;
+  uint64_t              ArchiveSizeInBytes; // From start of this header.
+  uint32_t              EntryCount;
+  uint32_t              BucketCount;        // Power of two, or zero.
+  uint32_t              PartCount;          // Number of distinct parts.
+  uint32_t              PartRefCount;       // Number of entry part references.
+  uint32_t              KeyTableSize;       // Byte count of the key table.
+  uint32_t              BucketsOffset;      // uint32_t[BucketCount]
+  uint32_t              EntriesOffset;      // DxilArchiveEntry[EntryCount]
+  uint32_t              PartRefsOffset;     // uint32_t[PartRefCount]
+  uint32_t              PartOffsetsOffset;  // uint64_t[PartCount]
+  uint32_t              KeyTableOffset;     // char[KeyTableSize]
+  // The hash index is open-addressed: a key's probe sequence starts at bucket
+  // (KeyHash & (BucketCount - 1)) and walks forward, wrapping around, until an
+  // empty bucket. A bucket holds one more than an entry index, or zero.
+  // Part references are indices into the part offset table; part offsets
+  // lead to a DxilPartHeader followed by its data, 4-byte aligned.
+};
+
+/// Use this type to describe one container in an archive.
+struct DxilArchiveEntry {
+  uint64_t              KeyHash;      // HashDxilArchiveKey of the key.
+  uint32_t              KeyOffset;    // Key table offset of the key.
+  uint32_t              KeySize;      // Length of the key, without terminator.
+  uint32_t              FirstPartRef; // Index of the first part reference.
+  uint32_t              PartCount;    // Number of parts, in container order.
+  DxilContainerHash     Hash;         // Hash of the original container.
+  DxilContainerVersion  Version;      // Version of the original container.
+  uint32_t              Reserved;     // Must be zero.
+};
+static_assert(sizeof(DxilArchiveEntry) % 8 == 0, "else archive tables are misaligned");
+
 #pragma pack(pop)
 
 /// Gets a part header by index.
@@ -374,6 +449,53 @@ inline uint32_t GetDxilBitcodeSize(const DxilProgramHeader *pHeader) {
   return pHeader->BitcodeHeader.BitcodeSize;
 }
 
+/// A program part the runtime doesn't read, such as the debug part, may hold
+/// its bitcode compressed. Its bitcode header then has DxilCompressedMagicValue
+/// in place of the DXIL magic and is followed by a DxilCompressedBitcodeHeader;
+/// BitcodeOffset and BitcodeSize locate the compressed bytes.
+static const uint32_t DxilCompressedMagicValue = 0x5A4C5844; // 'DXLZ'
+
+enum class DxilCompressionCodec : uint32_t {
+  LZ = 1, // See DxilCompression.h.
+};
+
+struct DxilCompressedBitcodeHeader {
+  uint32_t Codec;            // DxilCompressionCodec.
+  uint32_t DecompressedSize; // Size of the bitcode once decompressed.
+};
+
+inline bool IsCompressedDxilProgramHeader(const DxilProgramHeader *pHeader,
+                                          uint32_t length) {
+  const uint32_t headersSize =
+      sizeof(DxilBitcodeHeader) + sizeof(DxilCompressedBitcodeHeader);
+  if (length < sizeof(DxilProgramHeader) + sizeof(DxilCompressedBitcodeHeader) ||
+      length < pHeader->SizeInUint32 * sizeof(uint32_t))
+    return false;
+  const DxilBitcodeHeader &bitcodeHeader = pHeader->BitcodeHeader;
+  uint32_t bitcodeLength = length - offsetof(DxilProgramHeader, BitcodeHeader);
+  return bitcodeHeader.DxilMagic == DxilCompressedMagicValue &&
+         bitcodeHeader.BitcodeOffset >= headersSize &&
+         bitcodeHeader.BitcodeOffset + bitcodeHeader.BitcodeSize >=
+             bitcodeHeader.BitcodeOffset &&
+         bitcodeLength >=
+             bitcodeHeader.BitcodeOffset + bitcodeHeader.BitcodeSize;
+}
+
+inline const DxilCompressedBitcodeHeader *
+GetDxilCompressedBitcodeHeader(const DxilProgramHeader *pHeader) {
+  return reinterpret_cast<const DxilCompressedBitcodeHeader *>(pHeader + 1);
+}
+
+/// Returns the bitcode of the program part pHeader, which is length bytes
+/// long. Compressed bitcode is decompressed into storage, which must outlive
+/// the bitcode; other bitcode is returned in place. Returns false if the part
+/// is neither a valid program part nor a valid compressed one.
+bool GetDecompressedDxilProgramBitcode(const DxilProgramHeader *pHeader,
+                                       uint32_t length,
+                                       std::vector<char> &storage,
+                                       const char **pBitcode,
+                                       uint32_t *pBitcodeLength);
+
 /// Extract the shader type from the program version value.
 inline DXIL::ShaderKind GetVersionShaderType(uint32_t programVersion) {
   return (DXIL::ShaderKind)((programVersion & 0xffff0000) >> 16);
@@ -427,21 +549,41 @@ DxilPartWriter *NewProgramSignatureWriter(const DxilModule &M, DXIL::SignatureKi
 DxilPartWriter *NewRootSignatureWriter(const RootSignatureHandle &S);
 DxilPartWriter *NewFeatureInfoWriter(const DxilModule &M);
 DxilPartWriter *NewPSVWriter(const DxilModule &M, uint32_t PSVVersion = 0);
+DxilPartWriter *NewLinkIndexWriter(const DxilModule &M);
 
 class DxilContainerWriter : public DxilPartWriter  {
 public:
   typedef std::function<void(AbstractMemoryStream*)> WriteFn;
   virtual ~DxilContainerWriter() {}
   virtual void AddPart(uint32_t FourCC, uint32_t Size, WriteFn Write) = 0;
+  /// Add a final part whose size is only known once it has been written;
+  /// the part and container headers are patched after writing it. The part
+  /// must write a multiple of 4 bytes, and no part may be added after it.
+  virtual void AddStreamedPart(uint32_t FourCC, WriteFn Write) = 0;
 };
 
 DxilContainerWriter *NewDxilContainerWriter();
 
+/// Collects containers into an archive. Containers are copied when added,
+/// and parts already in the archive are not stored again.
+class DxilArchiveWriter {
+public:
+  virtual ~DxilArchiveWriter() {}
+  /// Adds a valid container under a key that is not already in the archive.
+  virtual void AddContainer(const char *pKey, uint32_t keyLength,
+                            const DxilContainerHeader *pContainer) = 0;
+  virtual uint64_t size() const = 0;
+  virtual void write(AbstractMemoryStream *pStream) = 0;
+};
+
+DxilArchiveWriter *NewDxilArchiveWriter();
+
 enum class SerializeDxilFlags : uint32_t {
   None = 0,                     // No flags defined.
   IncludeDebugInfoPart = 1,     // Include the debug info part in the container.
   IncludeDebugNamePart = 2,     // Include the debug name part in the container.
-  DebugNameDependOnSource = 4   // Make the debug name depend on source (and not just final module).
+  DebugNameDependOnSource = 4,  // Make the debug name depend on source (and not just final module).
+  CompressDebugInfoPart = 8     // Compress the bitcode of the debug info part.
 };
 inline SerializeDxilFlags& operator |=(SerializeDxilFlags& l, const SerializeDxilFlags& r) {
   l = static_cast<SerializeDxilFlags>(static_cast<int>(l) | static_cast<int>(r));
@@ -458,10 +600,30 @@ inline SerializeDxilFlags operator~(SerializeDxilFlags l) {
   return static_cast<SerializeDxilFlags>(~static_cast<uint32_t>(l));
 }
 
+/// Digests of the parts a container was assembled with from its module.
+/// The validator trusts a part that still matches its digest instead of
+/// generating it from the module again, so they must only be used in the
+/// process that assembled the container, on a module left unchanged since.
+class DxilPartDigests {
+public:
+  void Add(const DxilPartHeader *pPart);
+  /// Returns true if pPart is unchanged since it was added.
+  bool Matches(const DxilPartHeader *pPart) const;
+
+private:
+  struct Entry {
+    uint32_t FourCC;
+    uint32_t Size;
+    uint8_t Digest[DxilShaderHashSize];
+  };
+  std::vector<Entry> m_Entries;
+};
+
 void SerializeDxilContainerForModule(hlsl::DxilModule *pModule,
                                      AbstractMemoryStream *pModuleBitcode,
                                      AbstractMemoryStream *pStream,
-                                     SerializeDxilFlags Flags);
+                                     SerializeDxilFlags Flags,
+                                     DxilPartDigests *pDigests = nullptr);
 void SerializeDxilContainerForRootSignature(hlsl::RootSignatureHandle *pRootSigHandle,
                                      AbstractMemoryStream *pStream);
 
@@ -477,6 +639,59 @@ inline char * PartKindToCharArray(uint32_t partKind, _Out_writes_(5) char* pText
   return pText;
 }
 
+/// Hashes an archive key (64-bit FNV-1a).
+inline uint64_t HashDxilArchiveKey(const char *pKey, uint32_t keyLength) {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (uint32_t i = 0; i < keyLength; ++i) {
+    hash ^= (uint8_t)pKey[i];
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+/// Checks whether ptr claims by signature to be a DXIL archive.
+const DxilArchiveHeader *IsDxilArchiveLike(const void *ptr, size_t length);
+
+/// Checks whether the DXIL archive is valid and in-bounds, including every
+/// entry's key and parts.
+bool IsValidDxilArchive(const DxilArchiveHeader *pHeader, size_t length);
+
+/// Gets an archive entry by index.
+inline const DxilArchiveEntry *
+GetDxilArchiveEntry(const DxilArchiveHeader *pHeader, uint32_t index) {
+  return reinterpret_cast<const DxilArchiveEntry *>(
+             reinterpret_cast<const uint8_t *>(pHeader) +
+             pHeader->EntriesOffset) +
+         index;
+}
+
+/// Gets the null-terminated key of an archive entry.
+inline const char *GetDxilArchiveEntryKey(const DxilArchiveHeader *pHeader,
+                                          const DxilArchiveEntry *pEntry) {
+  return reinterpret_cast<const char *>(pHeader) + pHeader->KeyTableOffset +
+         pEntry->KeyOffset;
+}
+
+/// Gets a part of an archive entry by index, in container order.
+const DxilPartHeader *GetDxilArchiveEntryPart(const DxilArchiveHeader *pHeader,
+                                              const DxilArchiveEntry *pEntry,
+                                              uint32_t index);
+
+/// Looks up an archive entry by key; nullptr if not found.
+const DxilArchiveEntry *FindDxilArchiveEntry(const DxilArchiveHeader *pHeader,
+                                             const char *pKey,
+                                             uint32_t keyLength);
+
+/// Returns the size of the container of an archive entry.
+uint32_t GetDxilArchiveEntryContainerSize(const DxilArchiveHeader *pHeader,
+                                          const DxilArchiveEntry *pEntry);
+
+/// Writes the container of an archive entry, as it was added, to pDest,
+/// which must hold GetDxilArchiveEntryContainerSize bytes.
+void CopyDxilArchiveEntryContainer(const DxilArchiveHeader *pHeader,
+                                   const DxilArchiveEntry *pEntry,
+                                   _Out_ void *pDest);
+
 inline size_t GetOffsetTableSize(uint32_t partCount) {
   return sizeof(uint32_t) * partCount;
 }
@@ -11,14 +11,19 @@
 
 #pragma once
 
+#include "llvm/ADT/ArrayRef.h"
+
 namespace llvm {
 class Module;
 class ModulePass;
 class Function;
 class FunctionPass;
 class Instruction;
+class CallInst;
 class PassRegistry;
 class StringRef;
+class TargetIRAnalysis;
+class Value;
 }
 
 namespace hlsl {
@@ -28,9 +33,23 @@ public:
   static WaveSensitivityAnalysis* create();
   virtual ~WaveSensitivityAnalysis() { }
   virtual void Analyze(llvm::Function *F) = 0;
+  // Analyzes only what the given instructions depend on; IsWaveSensitive
+  // may then only be queried for them.
+  virtual void Analyze(llvm::Function *F,
+                       llvm::ArrayRef<llvm::CallInst *> Queries) = 0;
   virtual bool IsWaveSensitive(llvm::Instruction *op) = 0;
 };
 
+// Finds the values that are the same for all active lanes of a wave.
+class UniformityAnalysis {
+public:
+  static UniformityAnalysis* create();
+  virtual ~UniformityAnalysis() { }
+  virtual void Analyze(llvm::Function *F) = 0;
+  // For a terminator, whether all active lanes take the same successor.
+  virtual bool IsUniform(llvm::Value *V) = 0;
+};
+
 class HLSLExtensionsCodegenHelper;
 
 // Pause/resume support.
@@ -41,6 +60,11 @@ void SetPauseResumePasses(llvm::Module &M, llvm::StringRef pause, llvm::StringRe
 
 namespace llvm {
 
+/// \brief Create a target analysis that prices DXIL operations for the loop
+/// unroller, and stops unrolling once a shader reaches UnrollBudget if that
+/// is nonzero; falls back to the defaults without a DXIL module.
+TargetIRAnalysis createDxilTargetIRAnalysis(unsigned UnrollBudget = 0);
+
 /// \brief Create and return a pass that tranform the module into a DXIL module
 /// Note that this pass is designed for use with the legacy pass manager.
 ModulePass *createDxilCondenseResourcesPass();
@@ -50,6 +74,12 @@ ModulePass *createHLEmitMetadataPass();
 ModulePass *createHLEnsureMetadataPass();
 ModulePass *createDxilFinalizeModulePass();
 ModulePass *createDxilEmitMetadataPass();
+ModulePass *createDxilFinalizeAndEmitPass();
+ModulePass *createDxilGroupSharedLayoutPass();
+ModulePass *createDxilRemoveRedundantBarriersPass();
+FunctionPass *createDxilAggregateAtomicsPass();
+FunctionPass *createDxilAnnotateUniformPass();
+FunctionPass *createDxilDemotePrecisionPass();
 FunctionPass *createDxilExpandTrigIntrinsicsPass();
 ModulePass *createDxilLoadMetadataPass();
 ModulePass *createDxilDeadFunctionEliminationPass();
@@ -60,8 +90,12 @@ FunctionPass *createDxilLegalizeResourceUsePass();
 ModulePass *createDxilLegalizeStaticResourceUsePass();
 ModulePass *createDxilLegalizeEvalOperationsPass();
 FunctionPass *createDxilLegalizeSampleOffsetPass();
+FunctionPass *createDxilSinkResourceReadsPass();
+FunctionPass *createDxilHoistHandlesPass();
+FunctionPass *createDxilHoistInvariantReadsPass();
 FunctionPass *createSimplifyInstPass();
 ModulePass *createDxilAddPixelHitInstrumentationPass();
+ModulePass *createDxilAddBlockHitInstrumentationPass();
 ModulePass *createDxilOutputColorBecomesConstantPass();
 ModulePass *createDxilRemoveDiscardsPass();
 ModulePass *createDxilReduceMSAAToSingleSamplePass();
@@ -78,6 +112,12 @@ void initializeHLEnsureMetadataPass(llvm::PassRegistry&);
 void initializeHLEmitMetadataPass(llvm::PassRegistry&);
 void initializeDxilFinalizeModulePass(llvm::PassRegistry&);
 void initializeDxilEmitMetadataPass(llvm::PassRegistry&);
+void initializeDxilFinalizeAndEmitPass(llvm::PassRegistry&);
+void initializeDxilGroupSharedLayoutPass(llvm::PassRegistry&);
+void initializeDxilRemoveRedundantBarriersPass(llvm::PassRegistry&);
+void initializeDxilAggregateAtomicsPass(llvm::PassRegistry&);
+void initializeDxilAnnotateUniformPass(llvm::PassRegistry&);
+void initializeDxilDemotePrecisionPass(llvm::PassRegistry&);
 void initializeDxilExpandTrigIntrinsicsPass(llvm::PassRegistry&);
 void initializeDxilLoadMetadataPass(llvm::PassRegistry&);
 void initializeDxilDeadFunctionEliminationPass(llvm::PassRegistry&);
@@ -88,8 +128,12 @@ void initializeDxilLegalizeResourceUsePassPass(llvm::PassRegistry&);
 void initializeDxilLegalizeStaticResourceUsePassPass(llvm::PassRegistry&);
 void initializeDxilLegalizeEvalOperationsPass(llvm::PassRegistry&);
 void initializeDxilLegalizeSampleOffsetPassPass(llvm::PassRegistry&);
+void initializeDxilSinkResourceReadsPass(llvm::PassRegistry&);
+void initializeDxilHoistHandlesPass(llvm::PassRegistry&);
+void initializeDxilHoistInvariantReadsPass(llvm::PassRegistry&);
 void initializeSimplifyInstPass(llvm::PassRegistry&);
 void initializeDxilAddPixelHitInstrumentationPass(llvm::PassRegistry&);
+void initializeDxilAddBlockHitInstrumentationPass(llvm::PassRegistry&);
 void initializeDxilOutputColorBecomesConstantPass(llvm::PassRegistry&);
 void initializeDxilRemoveDiscardsPass(llvm::PassRegistry&);
 void initializeDxilReduceMSAAToSingleSamplePass(llvm::PassRegistry&);
@@ -13,6 +13,7 @@
 
 #include <unordered_map>
 #include <unordered_set>
+#include "llvm/ADT/SetVector.h"
 #include "llvm/ADT/StringRef.h"
 #include <memory>
 #include "llvm/Support/ErrorOr.h"
@@ -23,6 +24,7 @@ class GlobalVariable;
 class Constant;
 class Module;
 class LLVMContext;
+class raw_ostream;
 } // namespace llvm
 
 namespace hlsl {
@@ -36,9 +38,13 @@ public:
   static DxilLinker *CreateLinker(llvm::LLVMContext &Ctx);
 
   virtual bool HasLibNameRegistered(llvm::StringRef name) = 0;
+  // pLinkIndex is the optional DFCC_LinkIndex part of the library container;
+  // functions it covers are loaded only once they are linked.
   virtual bool RegisterLib(llvm::StringRef name,
                            std::unique_ptr<llvm::Module> pModule,
-                           std::unique_ptr<llvm::Module> pDebugModule) = 0;
+                           std::unique_ptr<llvm::Module> pDebugModule,
+                           const void *pLinkIndex = nullptr,
+                           uint32_t linkIndexSize = 0) = 0;
   virtual bool AttachLib(llvm::StringRef name) = 0;
   virtual bool DetachLib(llvm::StringRef name) = 0;
   virtual void DetachAll() = 0;
@@ -51,4 +57,17 @@ protected:
   llvm::LLVMContext &m_ctx;
 };
 
+// Collects the functions called by F and the globals it references, looking
+// through constant expressions and the initializers of referenced globals.
+void CollectLinkDependencies(llvm::Function &F,
+                             llvm::SetVector<llvm::Function *> &callees,
+                             llvm::SetVector<llvm::GlobalVariable *> &globals);
+
+// Writes the resource remap table of a linked shader. After a header line,
+// each resource left after unused ones are removed gets one tab-separated
+// line with its class, global name, ID, space, lower bound and range size in
+// the linked shader. For cbuffers, the line also has the number of bytes the
+// shader may read. Global names identify resources across the libraries.
+void WriteLinkResourceRemap(DxilModule &DM, llvm::raw_ostream &OS);
+
 } // namespace hlsl
@@ -173,6 +173,8 @@ public:
   static const unsigned kDxilTypeSystemStructTag                  = 0;
   static const unsigned kDxilTypeSystemFunctionTag                = 1; // For DXIL <= 1.1
   static const unsigned kDxilTypeSystemFunction2Tag               = 2; // For DXIL >= 1.2
+  static const unsigned kDxilTypeSystemPackedTag                  = 3; // Packed struct and function annotations.
+  static const unsigned kDxilTypeSystemPackedVersion              = 2; // 2 shares repeated struct annotations.
   static const unsigned kDxilFieldAnnotationSNormTag              = 0;
   static const unsigned kDxilFieldAnnotationUNormTag              = 1;
   static const unsigned kDxilFieldAnnotationMatrixTag             = 2;
@@ -195,6 +197,10 @@ public:
   // Precise attribute.
   static const char kDxilPreciseAttributeMDName[];
 
+  // Uniform attribute, an empty node on terminators whose condition and on
+  // instructions whose result is the same for all active lanes of a wave.
+  static const char kDxilUniformMDName[];
+
   // Validator version.
   static const char kDxilValidatorVersionMDName[];
   // Validator version uses the same constants for fields as kDxilVersion*
@@ -326,9 +332,12 @@ public:
   void LoadDxilSamplerFromMDNode(llvm::MDNode *MD, DxilSampler &S);
 
   // Type system.
-  void EmitDxilTypeSystem(DxilTypeSystem &TypeSystem, std::vector<llvm::GlobalVariable *> &LLVMUsed);
+  void EmitDxilTypeSystem(DxilTypeSystem &TypeSystem, std::vector<llvm::GlobalVariable *> &LLVMUsed, bool bPacked = false);
   void LoadDxilTypeSystemNode(const llvm::MDTuple &MDT, DxilTypeSystem &TypeSystem);
   void LoadDxilTypeSystem(DxilTypeSystem &TypeSystem);
+  bool IsPackedDxilTypeSystem();
+  llvm::MDTuple *EmitDxilPackedTypeSystem(DxilTypeSystem &TypeSystem);
+  void LoadDxilPackedTypeSystem(const llvm::MDTuple &MDT, DxilTypeSystem &TypeSystem);
   llvm::Metadata *EmitDxilStructAnnotation(const DxilStructAnnotation &SA);
   void LoadDxilStructAnnotation(const llvm::MDOperand &MDO, DxilStructAnnotation &SA);
   llvm::Metadata *EmitDxilFieldAnnotation(const DxilFieldAnnotation &FA);
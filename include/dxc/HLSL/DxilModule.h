@@ -140,6 +140,10 @@ public:
 
   // DXIL type system.
   DxilTypeSystem &GetTypeSystem();
+  /// Emit type annotations in the packed binary form, which only
+  /// validators that know DxilMDHelper::kDxilTypeSystemPackedTag accept.
+  void SetPackedTypeSystem(bool bPacked);
+  bool GetPackedTypeSystem() const;
 
   /// Emit llvm.used array to make sure that optimizations do not remove unreferenced globals.
   void EmitLLVMUsed();
@@ -156,8 +160,12 @@ public:
   void EmitDxilMetadata();
   /// Update resource metadata.
   void ReEmitDxilResources();
-  /// Deserialize DXIL metadata form into in-memory form.
-  void LoadDxilMetadata();
+  /// Deserialize DXIL metadata form into in-memory form. With bLazy, the
+  /// type system and view ID state are deserialized on first use; this is
+  /// meant for read-only consumers such as reflection and disassembly.
+  void LoadDxilMetadata(bool bLazy = false);
+  /// Deserialize the sections a lazy LoadDxilMetadata left in metadata form.
+  void LoadLazyDxilMetadata();
   /// Check if a Named meta data node is known by dxil module.
   static bool IsKnownNamedMetaData(llvm::NamedMDNode &Node);
 
@@ -439,6 +447,11 @@ private:
   // ViewId state.
   std::unique_ptr<DxilViewIdState> m_pViewIdState;
 
+  // Sections still in metadata form after a lazy LoadDxilMetadata.
+  mutable bool m_bTypeSystemPending;
+  mutable bool m_bViewIdStatePending;
+  bool m_bPackedTypeSystem;
+
   // DXIL metadata serialization/deserialization.
   llvm::MDTuple *EmitDxilResources();
   void LoadDxilResources(const llvm::MDOperand &MDO);
@@ -16,16 +16,21 @@ class LLVMContext;
 class Module;
 class Type;
 class StructType;
+class FunctionType;
 class Function;
 class Constant;
 class Value;
 class Instruction;
+class CallInst;
 };
 #include "llvm/IR/Attributes.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/StringRef.h"
 
 #include "DxilConstants.h"
 #include <unordered_map>
+#include <vector>
 
 namespace hlsl {
 
@@ -119,8 +124,19 @@ private:
     llvm::Function *pOverloads[kNumTypeOverloads];
   };
   OpCodeCacheItem m_OpCodeClassCache[(unsigned)OpCodeClass::NumOpClasses];
-  std::unordered_map<const llvm::Function *, OpCodeClass> m_FunctionToOpClass;
+  // Only written when a function is first cached; GetOpFunc hits read
+  // m_OpCodeClassCache alone.
+  llvm::DenseMap<const llvm::Function *, OpCodeClass> m_FunctionToOpClass;
   void UpdateCache(OpCodeClass opClass, unsigned typeSlot, llvm::Function *F);
+
+  // Function types and attributes of operations, built once per context and
+  // shared by every OP instance created in it.
+  struct ContextTable;
+  ContextTable *m_pContextTable;
+  static ContextTable *GetContextTable(llvm::LLVMContext &Ctx);
+  llvm::Function *CreateOpFunc(OpCode OpCode, OpCodeClass opClass,
+                               unsigned TypeSlot, llvm::StringRef funcName,
+                               llvm::FunctionType *pFT);
 private:
   // Static properties.
   struct OpCodeProperty {
@@ -140,4 +156,33 @@ private:
   static const char *GetOverloadTypeName(unsigned TypeSlot);
 };
 
+/// The DXIL operation calls of a function, collected in a single scan.
+///
+/// Calls are grouped by opcode class and keep their instruction order within
+/// a class, so a pass that only handles a few operations can visit just their
+/// calls, with the opcode already decoded. The list is a snapshot: it must be
+/// rebuilt once calls are added to or removed from the function.
+class DxilOpCallList {
+public:
+  struct Call {
+    llvm::CallInst *CI;
+    OP::OpCode Opcode;
+  };
+
+  explicit DxilOpCallList(llvm::Function &F);
+
+  /// All operation calls, grouped by opcode class.
+  llvm::ArrayRef<Call> calls() const { return m_Calls; }
+  /// The operation calls of a single opcode class.
+  llvm::ArrayRef<Call> calls(OP::OpCodeClass opClass) const {
+    unsigned C = (unsigned)opClass;
+    return llvm::ArrayRef<Call>(m_Calls).slice(
+        m_ClassBegin[C], m_ClassBegin[C + 1] - m_ClassBegin[C]);
+  }
+
+private:
+  std::vector<Call> m_Calls;
+  unsigned m_ClassBegin[(unsigned)OP::OpCodeClass::NumOpClasses + 1];
+};
+
 } // namespace hlsl
@@ -86,6 +86,20 @@ struct PSVRuntimeInfo1 : public PSVRuntimeInfo0
   uint8_t SigOutputVectors[4];      // Array for GS Stream Out Index
 };
 
+struct PSVRuntimeInfo2 : public PSVRuntimeInfo1
+{
+  // Thread group size, CS only
+  uint32_t NumThreadsX;
+  uint32_t NumThreadsY;
+  uint32_t NumThreadsZ;
+};
+
+struct PSVRuntimeInfo3 : public PSVRuntimeInfo2
+{
+  // Number of PSVCBufferRangeN records, for all cbuffers
+  uint32_t CBufferUsedRangeCount;
+};
+
 enum class PSVResourceType
 {
   Invalid = 0,
@@ -111,7 +125,38 @@ struct PSVResourceBindInfo0
   uint32_t LowerBound;
   uint32_t UpperBound;
 };
-// PSVResourceBindInfo1 would derive and extend
+
+struct PSVResourceBindInfo1 : public PSVResourceBindInfo0
+{
+  uint32_t Name;            // Offset into PSVStringTable
+  // CBV only:
+  uint32_t VariableStart;   // Index of the first PSVCBufferVariableN of the cbuffer
+  uint32_t VariableCount;   // Number of variables in the cbuffer
+  uint32_t Size;            // Size of one cbuffer in the range, rounded up to 16 bytes
+};
+
+struct PSVResourceBindInfo2 : public PSVResourceBindInfo1
+{
+  // CBV only:
+  uint32_t UsedRangeStart;  // Index of the first PSVCBufferRangeN of the cbuffer
+  uint32_t UsedRangeCount;  // Number of ranges the shader reads; 0 if unused
+};
+// PSVResourceBindInfo3 would derive and extend
+
+// Versioning is additive and based on size
+struct PSVCBufferVariable0
+{
+  uint32_t Name;            // Offset into PSVStringTable
+  uint32_t StartOffset;     // Offset in bytes from the start of the cbuffer
+  uint32_t Size;            // Size in bytes, up to the start of the next variable
+};
+
+// Versioning is additive and based on size
+struct PSVCBufferRange0
+{
+  uint32_t StartOffset;     // Offset in bytes from the start of the cbuffer
+  uint32_t Size;            // Size in bytes; ranges of a cbuffer are sorted and don't touch
+};
 
 // Helpers for output dependencies (ViewID and Input-Output tables)
 struct PSVComponentMask {
@@ -286,7 +331,9 @@ struct PSVInitInfo
     SigOutputElements(0),
     SigPatchConstantElements(0),
     SigInputVectors(0),
-    SigPatchConstantVectors(0)
+    SigPatchConstantVectors(0),
+    CBufferVariableCount(0),
+    CBufferUsedRangeCount(0)
   {}
   uint32_t PSVVersion;
   uint32_t ResourceCount;
@@ -300,6 +347,8 @@ struct PSVInitInfo
   uint8_t SigInputVectors;
   uint8_t SigPatchConstantVectors;
   uint8_t SigOutputVectors[4] = {0, 0, 0, 0};
+  uint32_t CBufferVariableCount;
+  uint32_t CBufferUsedRangeCount;
 };
 
 class DxilPipelineStateValidation
@@ -307,6 +356,8 @@ class DxilPipelineStateValidation
   uint32_t m_uPSVRuntimeInfoSize;
   PSVRuntimeInfo0* m_pPSVRuntimeInfo0;
   PSVRuntimeInfo1* m_pPSVRuntimeInfo1;
+  PSVRuntimeInfo2* m_pPSVRuntimeInfo2;
+  PSVRuntimeInfo3* m_pPSVRuntimeInfo3;
   uint32_t m_uResourceCount;
   uint32_t m_uPSVResourceBindInfoSize;
   void* m_pPSVResourceBindInfo;
@@ -321,12 +372,19 @@ class DxilPipelineStateValidation
   uint32_t* m_pInputToOutputTable;
   uint32_t* m_pInputToPCOutputTable;
   uint32_t* m_pPCInputToOutputTable;
+  uint32_t m_uCBufferVariableCount;
+  uint32_t m_uPSVCBufferVariableSize;
+  void* m_pCBufferVariables;
+  uint32_t m_uPSVCBufferRangeSize;
+  void* m_pCBufferRanges;
 
 public:
   DxilPipelineStateValidation() : 
     m_uPSVRuntimeInfoSize(0),
     m_pPSVRuntimeInfo0(nullptr),
     m_pPSVRuntimeInfo1(nullptr),
+    m_pPSVRuntimeInfo2(nullptr),
+    m_pPSVRuntimeInfo3(nullptr),
     m_uResourceCount(0),
     m_uPSVResourceBindInfoSize(0),
     m_pPSVResourceBindInfo(nullptr),
@@ -340,7 +398,12 @@ public:
     m_pViewIDPCOutputMask(nullptr),
     m_pInputToOutputTable(nullptr),
     m_pInputToPCOutputTable(nullptr),
-    m_pPCInputToOutputTable(nullptr)
+    m_pPCInputToOutputTable(nullptr),
+    m_uCBufferVariableCount(0),
+    m_uPSVCBufferVariableSize(0),
+    m_pCBufferVariables(nullptr),
+    m_uPSVCBufferRangeSize(0),
+    m_pCBufferRanges(nullptr)
   {
   }
 
@@ -381,6 +444,15 @@ public:
   //    If (DS and SigOutputVectors[0] and SigPatchConstantVectors non-zero):
   //      { PSVComputeInputOutputTableSize(SigPatchConstantVectors, SigOutputVectors[0]) }
   //        - Outputs affected by patch constant inputs as a table of bitmasks
+  // If PSVRuntimeInfo2:
+  //    uint32_t CBufferVariableCount
+  //    If CBufferVariableCount:
+  //      uint32_t PSVCBufferVariable_size
+  //      { PSVCBufferVariableN structure } * CBufferVariableCount
+  // If PSVRuntimeInfo3:
+  //    If CBufferUsedRangeCount:
+  //      uint32_t PSVCBufferRange_size
+  //      { PSVCBufferRangeN structure } * CBufferUsedRangeCount
   // returns true if no errors occurred.
   bool InitFromPSV0(const void* pBits, uint32_t size) {
     if(!(pBits != nullptr)) return false;
@@ -395,6 +467,10 @@ public:
     m_pPSVRuntimeInfo0 = const_cast<PSVRuntimeInfo0*>((const PSVRuntimeInfo0*)pCurBits);
     if(m_uPSVRuntimeInfoSize >= sizeof(PSVRuntimeInfo1))
       m_pPSVRuntimeInfo1 = const_cast<PSVRuntimeInfo1*>((const PSVRuntimeInfo1*)pCurBits);
+    if(m_uPSVRuntimeInfoSize >= sizeof(PSVRuntimeInfo2))
+      m_pPSVRuntimeInfo2 = const_cast<PSVRuntimeInfo2*>((const PSVRuntimeInfo2*)pCurBits);
+    if(m_uPSVRuntimeInfoSize >= sizeof(PSVRuntimeInfo3))
+      m_pPSVRuntimeInfo3 = const_cast<PSVRuntimeInfo3*>((const PSVRuntimeInfo3*)pCurBits);
     pCurBits += m_uPSVRuntimeInfoSize;
     m_uResourceCount = *(const uint32_t*)pCurBits;
     pCurBits += sizeof(uint32_t);
@@ -497,6 +573,38 @@ public:
         pCurBits += PSVComputeInputOutputTableSize(m_pPSVRuntimeInfo1->SigPatchConstantVectors, m_pPSVRuntimeInfo1->SigOutputVectors[0]);
       }
     }
+
+    if (m_pPSVRuntimeInfo2) {
+      minsize += sizeof(uint32_t);
+      if (!(size >= minsize)) return false;
+      m_uCBufferVariableCount = *(const uint32_t*)pCurBits;
+      pCurBits += sizeof(uint32_t);
+      if (m_uCBufferVariableCount > 0) {
+        minsize += sizeof(uint32_t);
+        if (!(size >= minsize)) return false;
+        m_uPSVCBufferVariableSize = *(const uint32_t*)pCurBits;
+        if (m_uPSVCBufferVariableSize < sizeof(PSVCBufferVariable0))
+          return false;   // Illegal: Size smaller than first version
+        pCurBits += sizeof(uint32_t);
+        minsize += m_uPSVCBufferVariableSize * m_uCBufferVariableCount;
+        if (!(size >= minsize)) return false;
+        m_pCBufferVariables = static_cast<void*>(const_cast<uint8_t*>(pCurBits));
+        pCurBits += m_uPSVCBufferVariableSize * m_uCBufferVariableCount;
+      }
+    }
+
+    if (m_pPSVRuntimeInfo3 && m_pPSVRuntimeInfo3->CBufferUsedRangeCount > 0) {
+      minsize += sizeof(uint32_t);
+      if (!(size >= minsize)) return false;
+      m_uPSVCBufferRangeSize = *(const uint32_t*)pCurBits;
+      if (m_uPSVCBufferRangeSize < sizeof(PSVCBufferRange0))
+        return false;   // Illegal: Size smaller than first version
+      pCurBits += sizeof(uint32_t);
+      minsize += m_uPSVCBufferRangeSize * m_pPSVRuntimeInfo3->CBufferUsedRangeCount;
+      if (!(size >= minsize)) return false;
+      m_pCBufferRanges = static_cast<void*>(const_cast<uint8_t*>(pCurBits));
+      pCurBits += m_uPSVCBufferRangeSize * m_pPSVRuntimeInfo3->CBufferUsedRangeCount;
+    }
     return true;
   }
 
@@ -511,15 +619,25 @@ public:
 
   bool InitNew(const PSVInitInfo &initInfo, void *pBuffer, uint32_t *pSize) {
     if(!(pSize)) return false;
-    if (initInfo.PSVVersion > 1) return false;
+    if (initInfo.PSVVersion > 3) return false;
 
     // Versioned structure sizes
     m_uPSVRuntimeInfoSize = sizeof(PSVRuntimeInfo0);
     m_uPSVResourceBindInfoSize = sizeof(PSVResourceBindInfo0);
     m_uPSVSignatureElementSize = sizeof(PSVSignatureElement0);
+    m_uPSVCBufferVariableSize = sizeof(PSVCBufferVariable0);
+    m_uPSVCBufferRangeSize = sizeof(PSVCBufferRange0);
     if (initInfo.PSVVersion > 0) {
       m_uPSVRuntimeInfoSize = sizeof(PSVRuntimeInfo1);
     }
+    if (initInfo.PSVVersion > 1) {
+      m_uPSVRuntimeInfoSize = sizeof(PSVRuntimeInfo2);
+      m_uPSVResourceBindInfoSize = sizeof(PSVResourceBindInfo1);
+    }
+    if (initInfo.PSVVersion > 2) {
+      m_uPSVRuntimeInfoSize = sizeof(PSVRuntimeInfo3);
+      m_uPSVResourceBindInfoSize = sizeof(PSVResourceBindInfo2);
+    }
 
     // PSVVersion 0
     uint32_t size = m_uPSVRuntimeInfoSize + sizeof(uint32_t) * 2;
@@ -562,6 +680,19 @@ public:
       }
     }
 
+    // PSVVersion 2
+    if (initInfo.PSVVersion > 1) {
+      size += sizeof(uint32_t);
+      if (initInfo.CBufferVariableCount) {
+        size += sizeof(uint32_t) + m_uPSVCBufferVariableSize * initInfo.CBufferVariableCount;
+      }
+    }
+
+    // PSVVersion 3
+    if (initInfo.PSVVersion > 2 && initInfo.CBufferUsedRangeCount) {
+      size += sizeof(uint32_t) + m_uPSVCBufferRangeSize * initInfo.CBufferUsedRangeCount;
+    }
+
     // Validate or return required size
     if (pBuffer) {
       if(!(*pSize >= size)) return false;
@@ -579,6 +710,12 @@ public:
     if (initInfo.PSVVersion > 0) {
       m_pPSVRuntimeInfo1 = (PSVRuntimeInfo1*)pCurBits;
     }
+    if (initInfo.PSVVersion > 1) {
+      m_pPSVRuntimeInfo2 = (PSVRuntimeInfo2*)pCurBits;
+    }
+    if (initInfo.PSVVersion > 2) {
+      m_pPSVRuntimeInfo3 = (PSVRuntimeInfo3*)pCurBits;
+    }
     pCurBits += m_uPSVRuntimeInfoSize;
 
     // Set resource info:
@@ -673,6 +810,30 @@ public:
       }
     }
 
+    // PSVVersion 2
+    if (initInfo.PSVVersion > 1) {
+      m_uCBufferVariableCount = initInfo.CBufferVariableCount;
+      *(uint32_t*)pCurBits = m_uCBufferVariableCount;
+      pCurBits += sizeof(uint32_t);
+      if (m_uCBufferVariableCount) {
+        *(uint32_t*)pCurBits = m_uPSVCBufferVariableSize;
+        pCurBits += sizeof(uint32_t);
+        m_pCBufferVariables = pCurBits;
+        pCurBits += m_uPSVCBufferVariableSize * m_uCBufferVariableCount;
+      }
+    }
+
+    // PSVVersion 3
+    if (initInfo.PSVVersion > 2) {
+      m_pPSVRuntimeInfo3->CBufferUsedRangeCount = initInfo.CBufferUsedRangeCount;
+      if (initInfo.CBufferUsedRangeCount) {
+        *(uint32_t*)pCurBits = m_uPSVCBufferRangeSize;
+        pCurBits += sizeof(uint32_t);
+        m_pCBufferRanges = pCurBits;
+        pCurBits += m_uPSVCBufferRangeSize * initInfo.CBufferUsedRangeCount;
+      }
+    }
+
     return true;
   }
 
@@ -684,6 +845,14 @@ public:
     return m_pPSVRuntimeInfo1;
   }
 
+  PSVRuntimeInfo2* GetPSVRuntimeInfo2() const {
+    return m_pPSVRuntimeInfo2;
+  }
+
+  PSVRuntimeInfo3* GetPSVRuntimeInfo3() const {
+    return m_pPSVRuntimeInfo3;
+  }
+
   uint32_t GetBindCount() const {
     return m_uResourceCount;
   }
@@ -697,6 +866,54 @@ public:
     return nullptr;
   }
 
+  PSVResourceBindInfo1* GetPSVResourceBindInfo1(uint32_t index) const {
+    if (index < m_uResourceCount && m_pPSVResourceBindInfo &&
+        sizeof(PSVResourceBindInfo1) <= m_uPSVResourceBindInfoSize) {
+      return (PSVResourceBindInfo1*)((uint8_t*)m_pPSVResourceBindInfo +
+        (index * m_uPSVResourceBindInfoSize));
+    }
+    return nullptr;
+  }
+
+  PSVResourceBindInfo2* GetPSVResourceBindInfo2(uint32_t index) const {
+    if (index < m_uResourceCount && m_pPSVResourceBindInfo &&
+        sizeof(PSVResourceBindInfo2) <= m_uPSVResourceBindInfoSize) {
+      return (PSVResourceBindInfo2*)((uint8_t*)m_pPSVResourceBindInfo +
+        (index * m_uPSVResourceBindInfoSize));
+    }
+    return nullptr;
+  }
+
+  // CBuffer variable access; variables of a CBV are found through the
+  // VariableStart and VariableCount of its PSVResourceBindInfo1.
+  uint32_t GetCBufferVariableCount() const {
+    return m_uCBufferVariableCount;
+  }
+  PSVCBufferVariable0* GetCBufferVariable0(uint32_t index) const {
+    if (index < m_uCBufferVariableCount && m_pCBufferVariables &&
+        sizeof(PSVCBufferVariable0) <= m_uPSVCBufferVariableSize) {
+      return (PSVCBufferVariable0*)((uint8_t*)m_pCBufferVariables +
+        (index * m_uPSVCBufferVariableSize));
+    }
+    return nullptr;
+  }
+
+  // Ranges of the cbuffers that the shader reads; ranges of a CBV are found
+  // through the UsedRangeStart and UsedRangeCount of its PSVResourceBindInfo2.
+  uint32_t GetCBufferUsedRangeCount() const {
+    if (m_pPSVRuntimeInfo3)
+      return m_pPSVRuntimeInfo3->CBufferUsedRangeCount;
+    return 0;
+  }
+  PSVCBufferRange0* GetCBufferRange0(uint32_t index) const {
+    if (index < GetCBufferUsedRangeCount() && m_pCBufferRanges &&
+        sizeof(PSVCBufferRange0) <= m_uPSVCBufferRangeSize) {
+      return (PSVCBufferRange0*)((uint8_t*)m_pCBufferRanges +
+        (index * m_uPSVCBufferRangeSize));
+    }
+    return nullptr;
+  }
+
   const PSVStringTable &GetStringTable() const { return m_StringTable; }
   const PSVSemanticIndexTable &GetSemanticIndexTable() const { return m_SemanticIndexTable; }
 
@@ -15,6 +15,8 @@
 #define __DXC_ROOTSIGNATURE__
 
 #include <stdint.h>
+#include <memory>
+#include "dxc/HLSL/DxilConstants.h"
 
 struct IDxcBlob;
 struct IDxcBlobEncoding;
@@ -350,6 +352,92 @@ void DeserializeRootSignature(_In_reads_bytes_(SrcDataSizeInBytes) const void *p
                               _In_ uint32_t SrcDataSizeInBytes,
                               _Out_ const DxilVersionedRootSignatureDesc **ppRootSignature);
 
+// Canonical hashing and comparison. Two root signatures that define the same
+// layout have the same hash and compare equal, regardless of where they were
+// allocated or how they were serialized. The hash is stable across processes.
+uint64_t HashRootSignature(_In_ const DxilVersionedRootSignatureDesc *pRootSignature);
+bool AreRootSignaturesEqual(_In_ const DxilVersionedRootSignatureDesc *pLHS,
+                            _In_ const DxilVersionedRootSignatureDesc *pRHS);
+
+// A deserialized root signature that may be shared with the cache.
+typedef std::shared_ptr<const DxilVersionedRootSignatureDesc> SharedRootSignatureDesc;
+
+/// Process-wide interning cache of root signatures.
+///
+/// Compile, link and validate see the same few root signatures over and over;
+/// the cache keeps one deserialized form per distinct serialized form, and
+/// one serialized form per canonical root signature. All storage owned by the
+/// cache is allocated from the default allocator. If the cache has not been
+/// initialized, every call falls through to the uncached implementation.
+namespace RootSignatureCache {
+
+// Like DeserializeRootSignature, but the result may be shared.
+SharedRootSignatureDesc Deserialize(_In_reads_bytes_(SrcDataSizeInBytes) const void *pSrcData,
+                                    _In_ uint32_t SrcDataSizeInBytes);
+
+// Like SerializeRootSignature; root signatures that are equal serialize to
+// the same blob. Failures are never cached.
+void Serialize(_In_ const DxilVersionedRootSignatureDesc *pRootSignature,
+               _Outptr_ IDxcBlob **ppBlob, _Outptr_ IDxcBlobEncoding **ppErrorBlob,
+               bool bAllowReservedRegisterSpace);
+
+// Returns the serialized root signature that AddCompiled recorded for the
+// root signature text at pText and Version, or null. Texts that differ only
+// in runs of white space share an entry.
+void FindCompiled(_In_reads_(TextSize) const char *pText, _In_ size_t TextSize,
+                  _In_ DxilRootSignatureVersion Version,
+                  _Outptr_result_maybenull_ IDxcBlob **ppBlob);
+
+// Records pBlob, a result of Serialize, as the compiled form of the root
+// signature text at pText and Version. Only add text that compiled without
+// errors.
+void AddCompiled(_In_reads_(TextSize) const char *pText, _In_ size_t TextSize,
+                 _In_ DxilRootSignatureVersion Version, _In_ IDxcBlob *pBlob);
+
+// Returns the first serialized root signature seen that is equal to the one
+// in pSrcData, and its canonical hash. Throws if pSrcData is malformed.
+void Intern(_In_reads_bytes_(SrcDataSizeInBytes) const void *pSrcData,
+            _In_ uint32_t SrcDataSizeInBytes,
+            _Outptr_ IDxcBlob **ppInterned, _Out_ uint64_t *pHash);
+
+// Creates the cache; called when the library is loaded.
+HRESULT Initialize();
+
+// Drops all cached entries; called when the library is unloaded.
+void Cleanup();
+
+} // namespace RootSignatureCache
+
+class RootSignatureVerifier;
+
+/// Checks many shaders against one root signature.
+///
+/// Init verifies the root signature and indexes its register ranges by
+/// visibility, range type and space; each VerifyShaderPSV call then only
+/// looks up the shader's bindings, instead of rebuilding the index as
+/// VerifyRootSignatureWithShaderPSV does. Once initialized, the checker may
+/// be used from several threads at once.
+class RootSignatureCompatibilityChecker {
+public:
+  RootSignatureCompatibilityChecker();
+  ~RootSignatureCompatibilityChecker();
+  RootSignatureCompatibilityChecker(const RootSignatureCompatibilityChecker &) = delete;
+
+  // Returns false if the root signature does not verify.
+  bool Init(_In_ const DxilVersionedRootSignatureDesc *pDesc,
+            _In_ llvm::raw_ostream &DiagStream);
+
+  // Takes PSV - pipeline state validation data, not shader container.
+  // Returns false if the shader is not compatible with the root signature.
+  bool VerifyShaderPSV(_In_ DXIL::ShaderKind ShaderKind,
+                       _In_reads_bytes_(PSVSize) const void *pPSVData,
+                       _In_ uint32_t PSVSize,
+                       _In_ llvm::raw_ostream &DiagStream) const;
+
+private:
+  std::unique_ptr<RootSignatureVerifier> m_pVerifier;
+};
+
 // Takes PSV - pipeline state validation data, not shader container.
 bool VerifyRootSignatureWithShaderPSV(_In_ const DxilVersionedRootSignatureDesc *pDesc,
                                       _In_ DXIL::ShaderKind ShaderKind,
@@ -0,0 +1,95 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilShaderCost.h                                                          //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Estimates how expensive a shader is to run, without running it.           //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <stdint.h>
+
+namespace llvm {
+class Function;
+class raw_ostream;
+}
+
+namespace hlsl {
+
+class DxilModule;
+
+/// Kinds of operation the cost estimate counts separately.
+enum class DxilCostCategory : unsigned {
+  ALU,            // Arithmetic, compares, conversions and other operations.
+  Transcendental, // Trigonometry, exp, log and square roots.
+  Texture,        // Samples, gathers, texture loads and stores.
+  Buffer,         // Buffer and cbuffer loads and stores.
+  Wave,           // Wave and quad operations.
+  Atomic,         // Atomic operations.
+  Barrier,        // Barriers.
+  NumCategories
+};
+
+/// Estimated cost of one function. Static counts count each instruction
+/// once. Dynamic counts and the weighted cost multiply each instruction by
+/// the trip counts of the loops it is in; a loop without a constant trip
+/// count is assumed to run kAssumedTripCount times.
+struct DxilShaderCost {
+  static const unsigned kAssumedTripCount = 8;
+  static const unsigned kNumCategories =
+      (unsigned)DxilCostCategory::NumCategories;
+
+  unsigned StaticOps[kNumCategories] = {};
+  uint64_t DynamicOps[kNumCategories] = {};
+  /// Sum of the DxilTTIImpl cost of each instruction, weighted as above.
+  uint64_t WeightedCost = 0;
+
+  /// Instructions, other than phis and branches.
+  unsigned Instructions = 0;
+  /// ALU instructions by operand type, for reflection.
+  unsigned FloatOps = 0;
+  unsigned IntOps = 0;
+  unsigned UintOps = 0;
+  /// Texture instructions by kind, for reflection.
+  unsigned TextureSamples = 0;
+  unsigned TextureBiasSamples = 0;
+  unsigned TextureGradientSamples = 0;
+  unsigned TextureCompareSamples = 0;
+  unsigned TextureLoads = 0;
+  unsigned TextureStores = 0;
+  unsigned EmitOps = 0;
+  unsigned CutOps = 0;
+  unsigned UnconditionalBranches = 0;
+  unsigned ConditionalBranches = 0;
+
+  unsigned Loops = 0;
+  /// Loops whose trip count was assumed to be kAssumedTripCount.
+  unsigned LoopsWithAssumedTripCount = 0;
+  /// Bytes of groupshared memory the function uses.
+  unsigned GroupSharedBytes = 0;
+  /// Most scalar values live at any one point, an approximation of the
+  /// registers the function needs.
+  unsigned MaxLiveValues = 0;
+
+  unsigned GetStaticOps(DxilCostCategory C) const {
+    return StaticOps[(unsigned)C];
+  }
+  uint64_t GetDynamicOps(DxilCostCategory C) const {
+    return DynamicOps[(unsigned)C];
+  }
+};
+
+/// Estimates the cost of F, which must have a body.
+void EstimateShaderCost(llvm::Function &F, DxilShaderCost &Cost);
+
+/// Prints the estimated cost of each entry point of DM, and of the patch
+/// constant function of a hull shader, with each line starting with comment.
+/// Function bodies must have been materialized.
+void PrintShaderCosts(DxilModule &DM, llvm::raw_ostream &OS,
+                      const char *comment);
+
+} // namespace hlsl
@@ -55,8 +55,26 @@ private:
   DXIL::SigPointKind m_sigPointKind;
   std::vector<std::unique_ptr<DxilSignatureElement> > m_Elements;
   bool m_UseMinPrecision;
+
+  unsigned PackElements(std::vector<DxilPackElement> &packElements,
+                        DXIL::PackingStrategy packing);
 };
 
+/// Process-wide cache of signature packing results. Entries are keyed by
+/// the signature point, the packing strategy and every element property
+/// packing reads, so permutations that lower the same signature pack it
+/// once. If the cache has not been initialized, elements are always packed.
+namespace SignaturePackingCache {
+
+// Creates the cache; called when the library is loaded. Returns false if
+// the cache could not be allocated.
+bool Initialize();
+
+// Drops all cached entries; called when the library is unloaded.
+void Cleanup();
+
+} // namespace SignaturePackingCache
+
 struct DxilEntrySignature {
   DxilEntrySignature(DXIL::ShaderKind shaderKind, bool useMinPrecision)
       : InputSignature(shaderKind, DxilSignature::Kind::Input, useMinPrecision),
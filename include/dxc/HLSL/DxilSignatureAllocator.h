@@ -116,6 +116,9 @@ public:
     DXIL::SignatureDataWidth DataWidth; // length of each scalar type in bytes. (2 or 4 for now)
 
     PackedRegister();
+    // Returns a mask of the components that an element with these flags
+    // cannot occupy, because they are occupied or would break ordering.
+    uint8_t GetBlockedMask(uint8_t flags) const;
     ConflictType DetectRowConflict(uint8_t flags, uint8_t indexFlags, DXIL::InterpolationMode interp, unsigned width, DXIL::SignatureDataWidth dataWidth);
     ConflictType DetectColConflict(uint8_t flags, unsigned col, unsigned width);
     void PlaceElement(uint8_t flags, uint8_t indexFlags, DXIL::InterpolationMode interp, unsigned col, unsigned width, DXIL::SignatureDataWidth dataWidth);
@@ -133,17 +136,33 @@ public:
   unsigned PackNext(PackElement* SE, unsigned startRow, unsigned numRows, unsigned startCol = 0);
 
   // Simple greedy in-order packer used by PackOptimized
-  unsigned PackGreedy(std::vector<PackElement*> elements, unsigned startRow, unsigned numRows, unsigned startCol = 0);
+  unsigned PackGreedy(const std::vector<PackElement*> &elements, unsigned startRow, unsigned numRows, unsigned startCol = 0);
 
   // Optimized packing algorithm - appended elements may affect positions of prior elements.
-  unsigned PackOptimized(std::vector<PackElement*> elements, unsigned startRow, unsigned numRows);
+  unsigned PackOptimized(const std::vector<PackElement*> &elements, unsigned startRow, unsigned numRows);
 
   // Pack in a prefix-stable way - appended elements do not affect positions of prior elements.
-  unsigned PackPrefixStable(std::vector<PackElement*> elements, unsigned startRow, unsigned numRows);
+  unsigned PackPrefixStable(const std::vector<PackElement*> &elements, unsigned startRow, unsigned numRows);
 
   bool UseMinPrecision() const { return m_bUseMinPrecision; }
 
 protected:
+  // Packing properties of an element, read once per placement rather than
+  // through the virtual accessors for every candidate row.
+  struct PackShape {
+    unsigned Rows, Cols;
+    uint8_t Flags;
+    DXIL::InterpolationMode Interp;
+    DXIL::SignatureDataWidth DataWidth;
+    PackShape(const PackElement *SE);
+  };
+
+  ConflictType DetectRowConflict(const PackShape &S, unsigned row);
+  // Returns the first column at or after startCol where the element fits in
+  // every row starting at row, or 4 if there is none.
+  unsigned FindFreeCol(const PackShape &S, unsigned row, unsigned startCol);
+  void PlaceElement(const PackShape &S, unsigned row, unsigned col);
+
   std::vector<PackedRegister> m_Registers;
   bool m_bIgnoreIndexing;
   bool m_bUseMinPrecision;
@@ -76,6 +76,26 @@ DxilSignatureAllocator::PackedRegister::PackedRegister()
     Flags[i] = 0;
 }
 
+uint8_t DxilSignatureAllocator::PackedRegister::GetBlockedMask(uint8_t flags) const {
+  flags |= kEFOccupied;
+  uint8_t mask = 0;
+  for (unsigned i = 0; i < 4; ++i) {
+    if (Flags[i] & flags)
+      mask |= 1 << i;
+  }
+  return mask;
+}
+
+// Returns true if mask has a run of width clear bits among the low four.
+static bool HasFreeRun(uint8_t mask, unsigned width) {
+  uint8_t run = (1 << width) - 1;
+  for (unsigned col = 0; col + width <= 4; ++col) {
+    if ((mask & (run << col)) == 0)
+      return true;
+  }
+  return false;
+}
+
 DxilSignatureAllocator::ConflictType DxilSignatureAllocator::PackedRegister::DetectRowConflict(uint8_t flags, uint8_t indexFlags, DXIL::InterpolationMode interp, unsigned width, DXIL::SignatureDataWidth dataWidth) {
   // indexing already present, and element incompatible with indexing
   if (IndexFlags && (flags & kEFConflictsWithIndexed))
@@ -89,16 +109,7 @@ DxilSignatureAllocator::ConflictType DxilSignatureAllocator::PackedRegister::Det
     return kConflictsWithInterpolationMode;
   if (DataWidth != DXIL::SignatureDataWidth::Undefined && DataWidth != dataWidth)
     return kConflictDataWidth;
-  unsigned freeWidth = 0;
-  for (unsigned i = 0; i < 4; ++i) {
-    if ((Flags[i] & kEFOccupied) || (Flags[i] & flags))
-      freeWidth = 0;
-    else
-      ++freeWidth;
-    if (width <= freeWidth)
-      break;
-  }
-  if (width > freeWidth)
+  if (!HasFreeRun(GetBlockedMask(flags), width))
     return kInsufficientFreeComponents;
   return kNoConflict;
 }
@@ -148,22 +159,38 @@ DxilSignatureAllocator::DxilSignatureAllocator(unsigned numRegisters, bool useMi
   m_Registers.resize(numRegisters);
 }
 
-DxilSignatureAllocator::ConflictType DxilSignatureAllocator::DetectRowConflict(const PackElement *SE, unsigned row) {
-  unsigned rows = SE->GetRows();
-  if (rows + row > m_Registers.size())
+DxilSignatureAllocator::PackShape::PackShape(const PackElement *SE)
+    : Rows(SE->GetRows()), Cols(SE->GetCols()), Flags(GetElementFlags(SE)),
+      Interp(SE->GetInterpolationMode()), DataWidth(SE->GetDataBitWidth()) {}
+
+DxilSignatureAllocator::ConflictType DxilSignatureAllocator::DetectRowConflict(const PackShape &S, unsigned row) {
+  if (S.Rows + row > m_Registers.size())
     return kConflictFit;
-  unsigned cols = SE->GetCols();
-  DXIL::InterpolationMode interp = SE->GetInterpolationMode();
-  uint8_t flags = GetElementFlags(SE);
-  for (unsigned i = 0; i < rows; ++i) {
-    uint8_t indexFlags = m_bIgnoreIndexing ? 0 : GetIndexFlags(i, rows);
-    ConflictType conflict = m_Registers[row + i].DetectRowConflict(flags, indexFlags, interp, cols, SE->GetDataBitWidth());
+  for (unsigned i = 0; i < S.Rows; ++i) {
+    uint8_t indexFlags = m_bIgnoreIndexing ? 0 : GetIndexFlags(i, S.Rows);
+    ConflictType conflict = m_Registers[row + i].DetectRowConflict(S.Flags, indexFlags, S.Interp, S.Cols, S.DataWidth);
     if (conflict)
       return conflict;
   }
   return kNoConflict;
 }
 
+DxilSignatureAllocator::ConflictType DxilSignatureAllocator::DetectRowConflict(const PackElement *SE, unsigned row) {
+  return DetectRowConflict(PackShape(SE), row);
+}
+
+unsigned DxilSignatureAllocator::FindFreeCol(const PackShape &S, unsigned row, unsigned startCol) {
+  uint8_t blocked = 0;
+  for (unsigned i = 0; i < S.Rows; ++i)
+    blocked |= m_Registers[row + i].GetBlockedMask(S.Flags);
+  uint8_t run = (1 << S.Cols) - 1;
+  for (unsigned col = startCol; col + S.Cols <= 4; ++col) {
+    if ((blocked & (run << col)) == 0)
+      return col;
+  }
+  return 4;
+}
+
 DxilSignatureAllocator::ConflictType DxilSignatureAllocator::DetectColConflict(const PackElement *SE, unsigned row, unsigned col) {
   unsigned rows = SE->GetRows();
   unsigned cols = SE->GetCols();
@@ -176,18 +203,18 @@ DxilSignatureAllocator::ConflictType DxilSignatureAllocator::DetectColConflict(c
   return kNoConflict;
 }
 
-void DxilSignatureAllocator::PlaceElement(const PackElement *SE, unsigned row, unsigned col) {
+void DxilSignatureAllocator::PlaceElement(const PackShape &S, unsigned row, unsigned col) {
   // Assume no conflicts (DetectRowConflict and DetectColConflict both return 0).
-  unsigned rows = SE->GetRows();
-  unsigned cols = SE->GetCols();
-  DXIL::InterpolationMode interp = SE->GetInterpolationMode();
-  uint8_t flags = GetElementFlags(SE);
-  for (unsigned i = 0; i < rows; ++i) {
-    uint8_t indexFlags = m_bIgnoreIndexing ? 0 : GetIndexFlags(i, rows);
-    m_Registers[row + i].PlaceElement(flags, indexFlags, interp, col, cols, SE->GetDataBitWidth());
+  for (unsigned i = 0; i < S.Rows; ++i) {
+    uint8_t indexFlags = m_bIgnoreIndexing ? 0 : GetIndexFlags(i, S.Rows);
+    m_Registers[row + i].PlaceElement(S.Flags, indexFlags, S.Interp, col, S.Cols, S.DataWidth);
   }
 }
 
+void DxilSignatureAllocator::PlaceElement(const PackElement *SE, unsigned row, unsigned col) {
+  PlaceElement(PackShape(SE), row, col);
+}
+
 
 namespace {
 
@@ -223,40 +250,38 @@ struct {
 unsigned DxilSignatureAllocator::PackNext(PackElement* SE, unsigned startRow, unsigned numRows, unsigned startCol) {
   unsigned rowsUsed = startRow;
 
-  unsigned rows = SE->GetRows();
-  if (rows > numRows)
+  PackShape S(SE);
+  if (S.Rows > numRows)
     return rowsUsed; // element will not fit
 
-  unsigned cols = SE->GetCols();
-  DXASSERT_NOMSG(startCol + cols <= 4);
+  DXASSERT_NOMSG(startCol + S.Cols <= 4);
 
-  for (unsigned row = startRow; row <= (startRow + numRows - rows); ++row) {
-    if (DetectRowConflict(SE, row))
+  for (unsigned row = startRow; row <= (startRow + numRows - S.Rows); ++row) {
+    if (DetectRowConflict(S, row))
       continue;
-    for (unsigned col = startCol; col <= 4 - cols; ++col) {
-      if (DetectColConflict(SE, row, col))
-        continue;
-      PlaceElement(SE, row, col);
-      SE->SetLocation(row, col);
-      return row + rows;
-    }
+    unsigned col = FindFreeCol(S, row, startCol);
+    if (col == 4)
+      continue;
+    PlaceElement(S, row, col);
+    SE->SetLocation(row, col);
+    return row + S.Rows;
   }
 
   return rowsUsed;
 }
 
-unsigned DxilSignatureAllocator::PackGreedy(std::vector<PackElement*> elements, unsigned startRow, unsigned numRows, unsigned startCol) {
+unsigned DxilSignatureAllocator::PackGreedy(const std::vector<PackElement*> &elements, unsigned startRow, unsigned numRows, unsigned startCol) {
   // Allocation failures should be caught by IsFullyAllocated()
   unsigned rowsUsed = startRow;
 
-  for (auto &SE : elements) {
+  for (PackElement *SE : elements) {
     rowsUsed = std::max(rowsUsed, PackNext(SE, startRow, numRows, startCol));
   }
 
   return rowsUsed;
 }
 
-unsigned DxilSignatureAllocator::PackOptimized(std::vector<PackElement*> elements, unsigned startRow, unsigned numRows) {
+unsigned DxilSignatureAllocator::PackOptimized(const std::vector<PackElement*> &elements, unsigned startRow, unsigned numRows) {
   unsigned rowsUsed = startRow;
 
   // Clip/Cull needs special handling due to limitations unique to these.
@@ -402,26 +427,21 @@ unsigned DxilSignatureAllocator::PackOptimized(std::vector<PackElement*> element
   // ==========
   // Allocate clip/cull
   for (unsigned i = 0; i < clipcullRegUsed; ++i) {
-    bool bAllocated = false;
-    unsigned cols = clipcullComponentsByRow[i];
+    PackShape S(&clipcullTempElements[i]);
     for (unsigned row = startRow; row < startRow + numRows; ++row) {
-      if (DetectRowConflict(&clipcullTempElements[i], row))
+      if (DetectRowConflict(S, row))
         continue;
-      for (unsigned col = 0; col <= 4 - cols; ++col) {
-        if (DetectColConflict(&clipcullTempElements[i], row, col))
-          continue;
-        for (auto &SE : clipcullElementsByRow[i]) {
-          PlaceElement(SE, row, col);
-          SE->SetLocation(row, col);
-          col += SE->GetCols();
-        }
-        bAllocated = true;
-        if (rowsUsed < row + 1)
-          rowsUsed = row + 1;
-        break;
+      unsigned col = FindFreeCol(S, row, 0);
+      if (col == 4)
+        continue;
+      for (auto &SE : clipcullElementsByRow[i]) {
+        PlaceElement(SE, row, col);
+        SE->SetLocation(row, col);
+        col += SE->GetCols();
       }
-      if (bAllocated)
-        break;
+      if (rowsUsed < row + 1)
+        rowsUsed = row + 1;
+      break;
     }
   }
 
@@ -437,7 +457,7 @@ unsigned DxilSignatureAllocator::PackOptimized(std::vector<PackElement*> element
   return rowsUsed;
 }
 
-unsigned DxilSignatureAllocator::PackPrefixStable(std::vector<PackElement*> elements, unsigned startRow, unsigned numRows) {
+unsigned DxilSignatureAllocator::PackPrefixStable(const std::vector<PackElement*> &elements, unsigned startRow, unsigned numRows) {
   unsigned rowsUsed = startRow;
 
   // Special handling for prefix-stable clip/cull arguments
@@ -58,7 +58,7 @@ public:
     auto next = m_Spans.lower_bound(Span(nullptr, pos, end));
     if (next == m_Spans.end() || end < next->start)
       return true;  // it fits here
-    return Find(size, result.first, pos, align);
+    return Find(size, next, pos, align);
   }
 
   // allocate element size in first available space, returns false on failure
@@ -69,17 +69,24 @@ public:
     if (m_AllocationFull)
       return false;
     pos = m_FirstFree;
+    // Skip the space already known to have no gap of this size.
+    auto hint = m_SearchStart.find(std::make_pair(size, align));
+    if (hint != m_SearchStart.end() && pos < hint->second)
+      pos = hint->second;
     if (!UpdatePos(pos, size, align))
       return false;
     auto result = m_Spans.emplace(element, pos, pos + (size - 1));
     if (result.second) {
       AdvanceFirstFree(result.first);
+      m_SearchStart[std::make_pair(size, align)] = pos;
       return true;
     }
     // Collision, find a gap from iterator
     if (!Find(size, result.first, pos, align))
       return false;
     result = m_Spans.emplace(element, pos, pos + (size - 1));
+    if (result.second)
+      m_SearchStart[std::make_pair(size, align)] = pos;
     return result.second;
   }
 
@@ -169,6 +176,11 @@ private:
 
 private:
   SpanSet m_Spans;
+  // Spans are never removed, so once Allocate has placed an element of some
+  // size and alignment first-fit, no later one of the same size and
+  // alignment fits below it. Keeps repeated allocation from rescanning the
+  // spans it has already filled.
+  std::map<std::pair<T_index, T_index>, T_index> m_SearchStart;
   T_index m_Min, m_Max, m_FirstFree;
   const T_element *m_Unbounded;
   bool m_AllocationFull;
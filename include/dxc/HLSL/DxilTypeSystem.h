@@ -11,10 +11,11 @@
 
 #pragma once
 #include "llvm/ADT/StringRef.h"
-#include "llvm/ADT/MapVector.h"
+#include "llvm/ADT/DenseMap.h"
 #include "dxc/HLSL/DxilCompType.h"
 #include "dxc/HLSL/DxilInterpolationMode.h"
 
+#include <algorithm>
 #include <memory>
 #include <string>
 #include <vector>
@@ -102,6 +103,9 @@ public:
   const llvm::StructType *GetStructType() const;
   unsigned GetCBufferSize() const;
   void SetCBufferSize(unsigned size);
+  /// Bytes from the field's offset up to the next larger field offset, or to
+  /// the end of the struct; fields don't have to be in offset order.
+  unsigned GetCBufferFieldSpan(unsigned FieldIdx) const;
   void MarkEmptyStruct();
   bool IsEmptyStruct();
 private:
@@ -177,11 +181,79 @@ private:
   DxilFunctionFPFlag m_fpFlag;
 };
 
+/// Annotations of struct types or functions, kept contiguous in the order
+/// they were added, with a dense index by the type or function.
+///
+/// Erasing leaves a hole that is compacted before the next iteration, so
+/// erasing many entries one at a time doesn't rebuild the index each time.
+template <typename KeyT, typename AnnotationT>
+class DxilAnnotationMap {
+public:
+  using value_type = std::pair<const KeyT *, std::unique_ptr<AnnotationT> >;
+  using iterator = typename std::vector<value_type>::iterator;
+
+  DxilAnnotationMap() : m_NumErased(0) {}
+
+  AnnotationT *lookup(const KeyT *Key) const {
+    auto it = m_Index.find(Key);
+    return it != m_Index.end() ? m_Entries[it->second].second.get() : nullptr;
+  }
+  size_t count(const KeyT *Key) const { return m_Index.count(Key); }
+
+  /// Adds an empty annotation for Key and returns it with true, or returns
+  /// the annotation Key already has with false.
+  std::pair<AnnotationT *, bool> insert(const KeyT *Key) {
+    auto result = m_Index.insert(std::make_pair(Key, (unsigned)m_Entries.size()));
+    if (!result.second)
+      return std::make_pair(m_Entries[result.first->second].second.get(), false);
+    m_Entries.emplace_back(Key, std::unique_ptr<AnnotationT>(new AnnotationT()));
+    return std::make_pair(m_Entries.back().second.get(), true);
+  }
+
+  void erase(const KeyT *Key) {
+    auto it = m_Index.find(Key);
+    if (it == m_Index.end())
+      return;
+    m_Entries[it->second].second.reset();
+    m_Index.erase(it);
+    ++m_NumErased;
+  }
+
+  /// Makes room for Count more annotations at once.
+  void reserve(size_t Count) {
+    size_t Total = m_Entries.size() + Count;
+    m_Entries.reserve(Total);
+    m_Index.resize(Total * 4 / 3 + 1);
+  }
+
+  size_t size() const { return m_Index.size(); }
+  bool empty() const { return m_Index.empty(); }
+
+  iterator begin() { Compact(); return m_Entries.begin(); }
+  iterator end() { Compact(); return m_Entries.end(); }
+
+private:
+  std::vector<value_type> m_Entries;
+  llvm::DenseMap<const KeyT *, unsigned> m_Index;
+  unsigned m_NumErased;
+
+  void Compact() {
+    if (m_NumErased == 0)
+      return;
+    m_Entries.erase(std::remove_if(m_Entries.begin(), m_Entries.end(),
+                                   [](const value_type &E) { return !E.second; }),
+                    m_Entries.end());
+    for (unsigned i = 0, e = (unsigned)m_Entries.size(); i != e; ++i)
+      m_Index[m_Entries[i].first] = i;
+    m_NumErased = 0;
+  }
+};
+
 /// Use this class to represent structure type annotations in HL and DXIL.
 class DxilTypeSystem {
 public:
-  using StructAnnotationMap = llvm::MapVector<const llvm::StructType *, std::unique_ptr<DxilStructAnnotation> >;
-  using FunctionAnnotationMap = llvm::MapVector<const llvm::Function *, std::unique_ptr<DxilFunctionAnnotation> >;
+  using StructAnnotationMap = DxilAnnotationMap<llvm::StructType, DxilStructAnnotation>;
+  using FunctionAnnotationMap = DxilAnnotationMap<llvm::Function, DxilFunctionAnnotation>;
 
   DxilTypeSystem(llvm::Module *pModule);
 
@@ -199,6 +271,7 @@ public:
   void EraseFunctionAnnotation(const llvm::Function *pFunction);
 
   FunctionAnnotationMap &GetFunctionAnnotationMap();
+  void ReserveFunctionAnnotations(unsigned count);
 
   // Utility methods to create stand-alone SNORM and UNORM.
   // We may want to move them to a more centralized place for most utilities.
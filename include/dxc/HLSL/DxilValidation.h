@@ -12,6 +12,7 @@
 #pragma once
 
 #include <memory>
+#include <string>
 #include "dxc/Support/Global.h"
 #include "dxc/HLSL/DxilConstants.h"
 
@@ -25,6 +26,8 @@ class DiagnosticInfo;
 
 namespace hlsl {
 
+class CompilePhaseListener;
+
 /* <py::lines('VALRULE-ENUM')>hctdb_instrhelp.get_valrule_enum()</py>*/
 // VALRULE-ENUM:BEGIN
 // Known validation rules
@@ -240,8 +243,34 @@ enum class ValidationRule : unsigned {
 
 const char *GetValidationRuleText(ValidationRule value);
 void GetValidationVersion(_Out_ unsigned *pMajor, _Out_ unsigned *pMinor);
+
+// Remembers the function bodies that passed validation, so that validating a
+// module again after some of its functions changed only revalidates those.
+// Entries are digests of a function's content and of the module state its
+// validation depends on; module-level checks, including those of DXIL
+// operation calls, always run. May be shared by concurrent validations.
+class ValidationFunctionCache {
+public:
+  ValidationFunctionCache();
+  ~ValidationFunctionCache();
+
+  bool Contains(const std::string &Digest);
+  void Insert(const std::string &Digest);
+
+  // Number of lookups that found their digest, for diagnostics and tests.
+  unsigned GetHitCount() const;
+
+private:
+  struct Impl;
+  std::unique_ptr<Impl> m_pImpl;
+};
+
+// pPhases, if given, is called at checkpoints between the steps of
+// validation and before each function, and may throw to stop validating.
 HRESULT ValidateDxilModule(_In_ llvm::Module *pModule,
-                           _In_opt_ llvm::Module *pDebugModule);
+                           _In_opt_ llvm::Module *pDebugModule,
+                           _In_opt_ ValidationFunctionCache *pFunctionCache = nullptr,
+                           _In_opt_ CompilePhaseListener *pPhases = nullptr);
 
 // DXIL Container Verification Functions (return false on failure)
 
@@ -259,12 +288,15 @@ bool VerifyFeatureInfoMatches(_In_ llvm::Module *pModule,
                               _In_reads_bytes_(FeatureInfoSize) const void *pFeatureInfoData,
                               _In_ uint32_t FeatureInfoSize);
 
-// Validate the container parts, assuming supplied module is valid, loaded from the container provided
+// Validate the container parts, assuming supplied module is valid, loaded from the container provided.
+// Parts that match pTrustedParts aren't generated from the module again.
 struct DxilContainerHeader;
+class DxilPartDigests;
 HRESULT ValidateDxilContainerParts(_In_ llvm::Module *pModule,
                                    _In_opt_ llvm::Module *pDebugModule,
                                    _In_reads_bytes_(ContainerSize) const DxilContainerHeader *pContainer,
-                                   _In_ uint32_t ContainerSize);
+                                   _In_ uint32_t ContainerSize,
+                                   _In_opt_ const DxilPartDigests *pTrustedParts = nullptr);
 
 // Loads module, validating load, but not module.
 HRESULT ValidateLoadModule(_In_reads_bytes_(ILLength) const char *pIL,
@@ -292,12 +324,14 @@ HRESULT ValidateLoadModuleFromContainerLazy(
 // Load and validate Dxil module from bitcode.
 HRESULT ValidateDxilBitcode(_In_reads_bytes_(ILLength) const char *pIL,
                             _In_ uint32_t ILLength,
-                            _In_ llvm::raw_ostream &DiagStream);
+                            _In_ llvm::raw_ostream &DiagStream,
+                            _In_opt_ ValidationFunctionCache *pFunctionCache = nullptr);
 
 // Full container validation, including ValidateDxilModule
 HRESULT ValidateDxilContainer(_In_reads_bytes_(ContainerSize) const void *pContainer,
                               _In_ uint32_t ContainerSize,
-                              _In_ llvm::raw_ostream &DiagStream);
+                              _In_ llvm::raw_ostream &DiagStream,
+                              _In_opt_ ValidationFunctionCache *pFunctionCache = nullptr);
 
 class PrintDiagnosticContext {
 private:
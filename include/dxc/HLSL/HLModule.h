@@ -20,6 +20,8 @@
 #include "dxc/HLSL/DxilShaderModel.h"
 #include "dxc/HLSL/DxilSignature.h"
 #include "dxc/HLSL/DxilFunctionProps.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/IR/ValueHandle.h"
 #include <memory>
 #include <string>
 #include <vector>
@@ -29,6 +31,7 @@ namespace llvm {
 class LLVMContext;
 class Module;
 class Function;
+class FunctionType;
 class Instruction;
 class CallInst;
 class MDTuple;
@@ -48,7 +51,8 @@ class RootSignatureHandle;
 struct HLOptions {
   HLOptions()
       : bDefaultRowMajor(false), bIEEEStrict(false), bDisableOptimizations(false),
-        bLegacyCBufferLoad(false), PackingStrategy(0), unused(0) {
+        bLegacyCBufferLoad(false), PackingStrategy(0),
+        bMergeBufferAccess(false), bPackedTypeAnnotations(false), unused(0) {
   }
   uint32_t GetHLOptionsRaw() const;
   void SetHLOptionsRaw(uint32_t data);
@@ -60,7 +64,9 @@ struct HLOptions {
   unsigned PackingStrategy         : 2;
   static_assert((unsigned)DXIL::PackingStrategy::Invalid < 4, "otherwise 2 bits is not enough to store PackingStrategy");
   unsigned bUseMinPrecision        : 1;
-  unsigned unused                  : 24;
+  unsigned bMergeBufferAccess      : 1;
+  unsigned bPackedTypeAnnotations  : 1;
+  unsigned unused                  : 22;
 };
 
 /// Use this class to manipulate HLDXIR of a shader.
@@ -210,6 +216,14 @@ public:
   std::unordered_map<llvm::Function *, std::unique_ptr<DxilFunctionProps>> &&
   ReleaseFunctionPropsMap();
 
+  // HL operation functions made by GetOrCreateHLFunction, by group, opcode
+  // and type, so that their names are only built when they're created.
+  // Returns null if there is none.
+  llvm::Function *GetHLOperationFunction(HLOpcodeGroup group, unsigned opcode,
+                                         llvm::FunctionType *funcTy);
+  void SetHLOperationFunction(HLOpcodeGroup group, unsigned opcode,
+                              llvm::FunctionType *funcTy, llvm::Function *F);
+
   llvm::DebugInfoFinder &GetOrCreateDebugInfoFinder();
   static llvm::DIGlobalVariable *
   FindGlobalVariableDebugInfo(llvm::GlobalVariable *GV,
@@ -245,6 +259,11 @@ private:
   // Resource type annotation.
   std::unordered_map<llvm::Type *, std::pair<DXIL::ResourceClass, DXIL::ResourceKind>> m_ResTypeAnnotation;
 
+  // HL operation functions; weak, as passes may delete them.
+  typedef std::pair<llvm::FunctionType *, std::pair<unsigned, unsigned>>
+      HLOperationKey;
+  llvm::DenseMap<HLOperationKey, llvm::WeakVH> m_HLOperationFunctions;
+
 private:
   llvm::LLVMContext &m_Ctx;
   llvm::Module *m_pModule;
@@ -17,6 +17,9 @@ class Instruction;
 class Value;
 class LoadInst;
 class Function;
+namespace legacy {
+class PassRunListener;
+}
 }
 
 namespace hlsl {
@@ -27,5 +30,6 @@ class HLSLExtensionsCodegenHelper;
 void TranslateBuiltinOperations(
     HLModule &HLM, HLSLExtensionsCodegenHelper *extCodegenHelper,
     std::unordered_set<llvm::LoadInst *> &UpdateCounterSet,
-    std::unordered_set<llvm::Value *> &NonUniformSet);
+    std::unordered_set<llvm::Value *> &NonUniformSet,
+    llvm::legacy::PassRunListener *pListener);
 }
\ No newline at end of file
@@ -40,9 +40,17 @@ namespace hlsl {
       Dxil,           // Convert call to a dxil intrinsic.
     };
 
+    // What the codegen helper answers for each extension opcode. Lowerings
+    // of the extension functions of a module can share one, so that each
+    // opcode is only looked up once per module.
+    struct HelperCache {
+      std::unordered_map<unsigned, std::string> IntrinsicNames;
+      std::unordered_map<unsigned, int> DxilOpcodes; // -1 if not mapped.
+    };
+
     // Create the lowering using the given strategy and custom codegen helper.
-    ExtensionLowering(llvm::StringRef strategy, HLSLExtensionsCodegenHelper *helper, OP& hlslOp);
-    ExtensionLowering(Strategy strategy, HLSLExtensionsCodegenHelper *helper, OP& hlslOp);
+    ExtensionLowering(llvm::StringRef strategy, HLSLExtensionsCodegenHelper *helper, OP& hlslOp, HelperCache *cache = nullptr);
+    ExtensionLowering(Strategy strategy, HLSLExtensionsCodegenHelper *helper, OP& hlslOp, HelperCache *cache = nullptr);
 
     // Translate the HL op call to a DXIL op call.
     // Returns a new value if translation was successful.
@@ -69,6 +77,14 @@ namespace hlsl {
     Strategy m_strategy;
     HLSLExtensionsCodegenHelper *m_helper;
     OP &m_hlslOp;
+    HelperCache m_ownCache;
+    HelperCache &m_cache;
+    // Lowered names by extension opcode. A name only depends on the types of
+    // the function called, so all calls to it share one.
+    std::unordered_map<unsigned, std::string> m_extensionNames;
+
+    const std::string &GetIntrinsicName(unsigned opcode);
+    bool GetDxilOpcode(unsigned opcode, unsigned &dxilOpcode);
 
     llvm::Value *Unknown(llvm::CallInst *CI);
     llvm::Value *NoTranslation(llvm::CallInst *CI);
@@ -0,0 +1,58 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// CompilePhaseListener.h                                                    //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Instrumentation hooks for the phases of a compile.                        //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/Pass.h"
+
+namespace hlsl {
+
+// Receives the phases of a compile as they start and finish. Phases nest,
+// and passes run by a pass manager the listener is installed on are
+// reported as phases named after the pass, as are the regions those passes
+// report.
+//
+// Work that may take long without starting a phase, such as unrolling a
+// loop or validating many functions, calls checkpoint as it goes. A listener
+// may throw from phaseStarted or checkpoint to abandon the compile, but not
+// from phaseFinished, which runs while unwinding. checkpoint may be called
+// from any thread working on the compile.
+class CompilePhaseListener : public llvm::legacy::PassRunListener {
+public:
+  virtual ~CompilePhaseListener() {}
+  virtual void phaseStarted(const char *pName) = 0;
+  virtual void phaseFinished(const char *pName) = 0;
+
+  void passStarted(llvm::Pass *P) override { phaseStarted(P->getPassName()); }
+  void passFinished(llvm::Pass *P) override { phaseFinished(P->getPassName()); }
+  void regionStarted(const char *pName) override { phaseStarted(pName); }
+  void regionFinished(const char *pName) override { phaseFinished(pName); }
+};
+
+// Reports the enclosing scope as a phase; the listener may be null.
+class CompilePhaseScope {
+  CompilePhaseListener *m_pListener;
+  const char *m_pName;
+  CompilePhaseScope(const CompilePhaseScope &) = delete;
+
+public:
+  CompilePhaseScope(CompilePhaseListener *pListener, const char *pName)
+      : m_pListener(pListener), m_pName(pName) {
+    if (m_pListener)
+      m_pListener->phaseStarted(m_pName);
+  }
+  ~CompilePhaseScope() {
+    if (m_pListener)
+      m_pListener->phaseFinished(m_pName);
+  }
+};
+
+} // namespace hlsl
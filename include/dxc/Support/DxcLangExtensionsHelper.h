@@ -27,6 +27,17 @@ class CompilerInstance;
 
 namespace hlsl {
 
+// A parsed semantic define is a semantic define that has actually been
+// parsed by the compiler. It has a name (required), a value (could be
+// the empty string), and a location. We use an encoded clang::SourceLocation
+// for the location to avoid a clang include dependency.
+struct ParsedSemanticDefine{
+  std::string Name;
+  std::string Value;
+  unsigned Location;
+};
+typedef std::vector<ParsedSemanticDefine> ParsedSemanticDefineList;
+
 class DxcLangExtensionsHelper : public DxcLangExtensionsHelperApply {
 private:
   llvm::SmallVector<std::string, 2> m_semanticDefines;
@@ -34,6 +45,7 @@ private:
   llvm::SmallVector<std::string, 2> m_defines;
   llvm::SmallVector<CComPtr<IDxcIntrinsicTable>, 2> m_intrinsicTables;
   CComPtr<IDxcSemanticDefineValidator> m_semanticDefineValidator;
+  CComPtr<IDxcSemanticDefineBatchValidator> m_semanticDefineBatchValidator;
   std::string m_semanticDefineMetaDataName;
 
   HRESULT STDMETHODCALLTYPE RegisterIntoVector(LPCWSTR name, llvm::SmallVector<std::string, 2>& here)
@@ -99,6 +111,8 @@ public:
       return E_POINTER;
 
     m_semanticDefineValidator = pValidator;
+    m_semanticDefineBatchValidator.Release();
+    pValidator->QueryInterface(&m_semanticDefineBatchValidator);
     return S_OK;
   }
 
@@ -148,32 +162,20 @@ public:
     }
   };
 
-  // Use the contained semantice define validator to validate the given semantic define.
-  SemanticDefineValidationResult ValidateSemanticDefine(const std::string &name, const std::string &value) {
-    if (!m_semanticDefineValidator)
-      return SemanticDefineValidationResult::Success();
-
-    // Blobs for getting restul from validator. Strings for returning results to caller.
-    CComPtr<IDxcBlobEncoding> pError;
-    CComPtr<IDxcBlobEncoding> pWarning;
-    std::string error;
-    std::string warning;
-
-    // Run semantic define validator.
-    HRESULT result = m_semanticDefineValidator->GetSemanticDefineWarningsAndErrors(name.c_str(), value.c_str(), &pWarning, &pError);
-
-
-    if (FAILED(result)) {
-      // Failure indicates it was not able to even run validation so
-      // we cannot say whether the define is invalid or not. Return a
-      // generic error message about failure to run the valiadator.
-      error = "failed to run semantic define validator for: ";
-      error.append(name); error.append("="); error.append(value);
-      return SemanticDefineValidationResult{ warning, error };
-    }
+private:
+  // Failure indicates the validator was not able to even run validation so
+  // we cannot say whether the define is invalid or not. Return a generic
+  // error message about failure to run the valiadator.
+  static SemanticDefineValidationResult ValidatorFailure(const std::string &name, const std::string &value) {
+    std::string error = "failed to run semantic define validator for: ";
+    error.append(name); error.append("="); error.append(value);
+    return SemanticDefineValidationResult{ std::string(), error };
+  }
 
+  // Convert the warning and error blobs produced by the validator.
+  static SemanticDefineValidationResult GetValidationResult(const std::string &name, IDxcBlobEncoding *pWarning, IDxcBlobEncoding *pError) {
     // Define a  little function to convert encoded blob into a string.
-    auto GetErrorAsString = [&name](const CComPtr<IDxcBlobEncoding> &pBlobString) -> std::string {
+    auto GetErrorAsString = [&name](IDxcBlobEncoding *pBlobString) -> std::string {
       CComPtr<IDxcBlobEncoding> pUTF8BlobStr;
       if (SUCCEEDED(hlsl::DxcGetBlobAsUtf8(pBlobString, &pUTF8BlobStr)))
         return std::string(static_cast<char*>(pUTF8BlobStr->GetBufferPointer()), pUTF8BlobStr->GetBufferSize());
@@ -182,6 +184,8 @@ public:
     };
 
     // Check to see if any warnings or errors were produced.
+    std::string error;
+    std::string warning;
     if (pError && pError->GetBufferSize()) {
       error = GetErrorAsString(pError);
     }
@@ -192,6 +196,62 @@ public:
     return SemanticDefineValidationResult{ warning, error };
   }
 
+public:
+  // Use the contained semantice define validator to validate the given semantic define.
+  SemanticDefineValidationResult ValidateSemanticDefine(const std::string &name, const std::string &value) {
+    if (!m_semanticDefineValidator)
+      return SemanticDefineValidationResult::Success();
+
+    // Blobs for getting restul from validator.
+    CComPtr<IDxcBlobEncoding> pError;
+    CComPtr<IDxcBlobEncoding> pWarning;
+
+    // Run semantic define validator.
+    HRESULT result = m_semanticDefineValidator->GetSemanticDefineWarningsAndErrors(name.c_str(), value.c_str(), &pWarning, &pError);
+    if (FAILED(result))
+      return ValidatorFailure(name, value);
+    return GetValidationResult(name, pWarning, pError);
+  }
+
+  // Validate several semantic defines, in one call to the validator if it
+  // supports batches. Results are in the order of the defines.
+  std::vector<SemanticDefineValidationResult>
+  ValidateSemanticDefines(const ParsedSemanticDefineList &defines) {
+    std::vector<SemanticDefineValidationResult> results;
+    if (!m_semanticDefineBatchValidator) {
+      results.reserve(defines.size());
+      for (const auto &define : defines)
+        results.emplace_back(ValidateSemanticDefine(define.Name, define.Value));
+      return results;
+    }
+
+    std::vector<LPCSTR> names, values;
+    names.reserve(defines.size());
+    values.reserve(defines.size());
+    for (const auto &define : defines) {
+      names.push_back(define.Name.c_str());
+      values.push_back(define.Value.c_str());
+    }
+    std::vector<IDxcBlobEncoding *> warnings(defines.size(), nullptr);
+    std::vector<IDxcBlobEncoding *> errors(defines.size(), nullptr);
+    HRESULT result = m_semanticDefineBatchValidator->GetSemanticDefinesWarningsAndErrors(
+        (UINT32)defines.size(), names.data(), values.data(), warnings.data(),
+        errors.data());
+
+    results.reserve(defines.size());
+    for (size_t i = 0; i < defines.size(); ++i) {
+      // Take ownership of the blobs so they are released in all cases.
+      CComPtr<IDxcBlobEncoding> pWarning, pError;
+      pWarning.Attach(warnings[i]);
+      pError.Attach(errors[i]);
+      if (FAILED(result))
+        results.emplace_back(ValidatorFailure(defines[i].Name, defines[i].Value));
+      else
+        results.emplace_back(GetValidationResult(defines[i].Name, pWarning, pError));
+    }
+    return results;
+  }
+
   __override void SetupSema(clang::Sema &S) {
     clang::ExternalASTSource *astSource = S.getASTContext().getExternalSource();
     if (clang::ExternalSemaSource *externalSema =
@@ -245,17 +305,6 @@ public:
     return (_helper_field_).SetSemanticDefineMetaDataName(name); \
   } \
 
-// A parsed semantic define is a semantic define that has actually been
-// parsed by the compiler. It has a name (required), a value (could be
-// the empty string), and a location. We use an encoded clang::SourceLocation
-// for the location to avoid a clang include dependency.
-struct ParsedSemanticDefine{
-  std::string Name;
-  std::string Value;
-  unsigned Location;
-};
-typedef std::vector<ParsedSemanticDefine> ParsedSemanticDefineList;
-
 // Return the collection of semantic defines parsed by the compiler instance.
 ParsedSemanticDefineList
   CollectSemanticDefinesParsedByCompiler(clang::CompilerInstance &compiler,
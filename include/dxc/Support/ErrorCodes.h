@@ -101,3 +101,9 @@
 
 // 0X80AA0018 - General internal error.
 #define DXC_E_GENERAL_INTERNAL_ERROR                  DXC_MAKE_HRESULT(DXC_SEVERITY_ERROR,FACILITY_DXC,(0x0018))
+
+// 0X80AA0019 - Compile was cancelled through IDxcCompilerCancel.
+#define DXC_E_COMPILE_CANCELLED                       DXC_MAKE_HRESULT(DXC_SEVERITY_ERROR,FACILITY_DXC,(0x0019))
+
+// 0X80AA001A - Compile ran past the time given with -compile-timeout.
+#define DXC_E_COMPILE_TIMEOUT                         DXC_MAKE_HRESULT(DXC_SEVERITY_ERROR,FACILITY_DXC,(0x001A))
@@ -137,6 +137,12 @@ DxcCreateBlobFromFile(_In_opt_ IMalloc *pMalloc, LPCWSTR pFileName,
 HRESULT DxcCreateBlobFromFile(LPCWSTR pFileName, _In_opt_ UINT32 *pCodePage,
                               _COM_Outptr_ IDxcBlobEncoding **ppBlobEncoding) throw();
 
+// Maps the file read-only instead of reading it; the blob pins the view (and
+// keeps the file from being written) until it is released.
+HRESULT
+DxcCreateBlobFromFileMapped(LPCWSTR pFileName, _In_opt_ UINT32 *pCodePage,
+                            _COM_Outptr_ IDxcBlobEncoding **ppBlobEncoding) throw();
+
 // Given a blob, creates a subrange view.
 HRESULT DxcCreateBlobFromBlob(_In_ IDxcBlob *pBlob, UINT32 offset,
                               UINT32 length,
@@ -210,7 +216,7 @@ public:
   virtual ULONG GetPtrSize() throw() = 0;
   virtual LPBYTE Detach() throw() = 0;
   virtual UINT64 GetPosition() throw() = 0;
-  virtual HRESULT Reserve(ULONG targetSize) throw() = 0;
+  virtual HRESULT Reserve(UINT64 targetSize) throw() = 0;
 };
 HRESULT CreateMemoryStream(_In_ IMalloc *pMalloc, _COM_Outptr_ AbstractMemoryStream** ppResult) throw();
 HRESULT CreateReadOnlyBlobStream(_In_ IDxcBlob *pSource, _COM_Outptr_ IStream** ppResult) throw();
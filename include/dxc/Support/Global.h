@@ -59,6 +59,43 @@ IMalloc *DxcGetThreadMallocNoRef() throw();
 _Ret_maybenull_ _Post_writable_byte_size_(nBytes) void *DxcThreadAlloc(size_t nBytes) throw();
 void DxcThreadFree(void *) throw();
 
+// Arena allocator, meant to be installed as the thread allocator for the
+// duration of a single invocation. Blocks are carved out of large chunks
+// obtained from the parent allocator; freeing a block only updates counters,
+// and the chunks are returned to the parent in one shot once every block has
+// been freed. Objects that outlive the invocation keep the arena alive and
+// its memory reserved until they're released.
+struct DxcArenaMallocStats {
+  unsigned long long AllocCount;    // Total # of alloc and realloc requests.
+  unsigned long long AllocBytes;    // Total # of alloc and realloc bytes.
+  unsigned long long LiveCount;     // Current # of outstanding blocks.
+  unsigned long long ReservedBytes; // Current # of bytes held from the parent.
+  unsigned long long PeakReservedBytes; // Peak of ReservedBytes.
+};
+HRESULT DxcCreateArenaMalloc(IMalloc *pParentMalloc, IMalloc **ppArena) throw();
+// Returns false if pMalloc wasn't created by DxcCreateArenaMalloc.
+bool DxcGetArenaMallocStats(IMalloc *pMalloc, DxcArenaMallocStats *pStats) throw();
+
+// Counting allocator, which forwards every request to its parent and keeps
+// track of the number of blocks and bytes requested through it. Used to
+// attribute memory to the phases of an invocation, and to hold an invocation
+// to a memory budget.
+struct DxcCountingMallocStats {
+  unsigned long long AllocCount;    // Total # of alloc and realloc requests.
+  unsigned long long AllocBytes;    // Total # of alloc and realloc bytes.
+  unsigned long long LiveBytes;     // Current # of outstanding bytes.
+  unsigned long long PeakLiveBytes; // Peak of LiveBytes.
+};
+HRESULT DxcCreateCountingMalloc(IMalloc *pParentMalloc, IMalloc **ppMalloc) throw();
+// Returns false if pMalloc wasn't created by DxcCreateCountingMalloc.
+bool DxcGetCountingMallocStats(IMalloc *pMalloc, DxcCountingMallocStats *pStats) throw();
+// Sets PeakLiveBytes to the larger of peakLiveBytes and LiveBytes, so that
+// the peak of a nested region can be measured and then folded back in.
+bool DxcSetCountingMallocPeak(IMalloc *pMalloc, unsigned long long peakLiveBytes) throw();
+// Fails requests that would take LiveBytes past limitBytes, as if the parent
+// were out of memory; 0 removes the limit.
+bool DxcSetCountingMallocLimit(IMalloc *pMalloc, unsigned long long limitBytes) throw();
+
 struct DxcThreadMalloc {
   DxcThreadMalloc(IMalloc *pMallocOrNull) throw() {
     p = DxcSwapThreadMallocOrDefault(pMallocOrNull, &pPrior);
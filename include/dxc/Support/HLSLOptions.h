@@ -91,6 +91,7 @@ public:
   llvm::opt::InputArgList Args = llvm::opt::InputArgList(nullptr, nullptr); // Original arguments.
 
   llvm::StringRef AssemblyCode; // OPT_Fc
+  llvm::StringRef CostReportFile; // OPT_Fcost
   llvm::StringRef DebugFile;    // OPT_Fd
   llvm::StringRef EntryPoint;   // OPT_entrypoint
   llvm::StringRef ExternalFn;   // OPT_external_fn
@@ -100,8 +101,10 @@ public:
   llvm::StringRef InputFile; // OPT_INPUT
   llvm::StringRef OutputHeader; // OPT_Fh
   llvm::StringRef OutputObject; // OPT_Fo
+  llvm::StringRef OutputBundle; // OPT_Fbundle
   llvm::StringRef OutputWarningsFile; // OPT_Fe
   llvm::StringRef Preprocess; // OPT_P
+  llvm::StringRef ProfileUseFile; // OPT_profile_use
   llvm::StringRef TargetProfile; // OPT_target_profile
   llvm::StringRef VariableName; // OPT_Vn
   llvm::StringRef PrivateSource; // OPT_setprivate
@@ -113,11 +116,26 @@ public:
   bool AllResourcesBound; // OPT_all_resources_bound
   bool AstDump; // OPT_ast_dump
   bool ColorCodeAssembly; // OPT_Cc
+  bool CompileCache; // OPT_compile_cache
+  bool HLCache; // OPT_hl_cache
+  bool ContainerCache; // OPT_container_cache
+  bool Incremental; // OPT_incremental
+  bool ArenaAlloc; // OPT_arena_alloc
+  bool IncludeCache; // OPT_include_cache
+  bool ReportPhases; // OPT_report_phases
+  bool DiagRecords; // OPT_diag_records
+  bool ReportIncludes; // OPT_report_includes
+  bool ScanDependencies; // OPT_scan_deps
+  bool Preprocessed; // OPT_preprocessed
+  unsigned CompileTimeout; // OPT_compile_timeout, in milliseconds; 0 if none
+  unsigned CompileMemoryLimit; // OPT_compile_memory_limit, in MB; 0 if none
   bool CodeGenHighLevel; // OPT_fcgl
   bool DebugInfo; // OPT__SLASH_Zi
   bool DebugNameForBinary; // OPT_Zsb
   bool DebugNameForSource; // OPT_Zss
   bool DumpBin;        // OPT_dumpbin
+  bool FromBundle;     // OPT_from_bundle
+  bool Server;         // OPT_server
   bool WarningAsError; // OPT__SLASH_WX
   bool IEEEStrict;     // OPT_Gis
   bool IgnoreLineDirectives; // OPT_ignore_line_directives
@@ -126,6 +144,7 @@ public:
   bool DisableValidation; // OPT_VD
   unsigned OptLevel;      // OPT_O0/O1/O2/O3
   bool DisableOptimizations; // OPT_Od
+  bool FastIteration;        // OPT_fast_iteration
   bool AvoidFlowControl;     // OPT_Gfa
   bool PreferFlowControl;    // OPT_Gfp
   bool EnableStrictMode;     // OPT_Ges
@@ -141,11 +160,27 @@ public:
   bool UseInstructionByteOffsets; // OPT_No
   bool UseInstructionNumbers; // OPT_Ni
   bool NotUseLegacyCBufLoad;  // OPT_not_use_legacy_cbuf_load
+  bool MergeBufferAccess;  // OPT_merge_buffer_access
+  bool HoistHandles;  // OPT_hoist_handles
+  bool HoistInvariantReads;  // OPT_hoist_invariant_reads
+  bool SinkResourceReads;  // OPT_sink_resource_reads
+  unsigned UnrollBudget;  // OPT_unroll_budget; 0 if none
+  bool AnnotateUniform;  // OPT_annotate_uniform
+  bool OptimizeGroupSharedLayout;  // OPT_optimize_groupshared_layout
+  bool OptimizeCBufferLayout;  // OPT_optimize_cbuffer_layout
+  bool MergeFunctions;  // OPT_merge_functions
+  bool LazyFunctionBodies;  // OPT_lazy_function_bodies
+  bool StreamCodeGen;  // OPT_stream_codegen
+  bool DemotePrecision;  // OPT_demote_precision
+  bool RemoveRedundantBarriers;  // OPT_remove_redundant_barriers
+  bool AggregateAtomics;  // OPT_aggregate_atomics
+  bool PackedTypeAnnotations;  // OPT_packed_type_annotations
   bool PackPrefixStable;  // OPT_pack_prefix_stable
   bool PackOptimized;  // OPT_pack_optimized
   bool DisplayIncludeProcess; // OPT__vi
   bool RecompileFromBinary; // OPT _Recompile (Recompiling the DXBC binary file not .hlsl file)
   bool StripDebug; // OPT Qstrip_debug
+  bool CompressDebug; // OPT_Qcompress_debug
   bool StripRootSignature; // OPT_Qstrip_rootsignature
   bool StripPrivate; // OPT_Qstrip_priv
   bool StripReflection; // OPT_Qstrip_reflect
@@ -161,6 +196,7 @@ public:
 #ifdef ENABLE_SPIRV_CODEGEN
   bool GenSPIRV; // OPT_spirv
   llvm::StringRef VkStageIoOrder;
+  bool VkGroupDecorations; // OPT_fvk_group_decorations
 #endif
   // SPIRV Change Ends
 };
@@ -175,6 +211,7 @@ public:
   MainArgs() = default;
   MainArgs(int argc, const wchar_t **argv, int skipArgCount = 1);
   MainArgs(llvm::ArrayRef<llvm::StringRef> args);
+  MainArgs(const MainArgs &other) { *this = other; }
   MainArgs& operator=(const MainArgs &other);
   llvm::ArrayRef<const char *> getArrayRef() const {
     return llvm::ArrayRef<const char *>(Utf8CharPtrVector.data(),
@@ -0,0 +1,54 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// WorkerThreads.h                                                           //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Provides the thread counts for steps that run on worker threads.          //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+namespace hlsl {
+
+// Threads for a step that spreads its tasks across worker threads, such as
+// validating functions or assembling the entries of a batch. The threads a
+// step starts besides its own come from a budget of one fewer than the
+// number of cores, shared by every step in the process; a step that finds
+// the budget used up by concurrent compiles runs on its own thread. Steps
+// don't nest: a step started from a worker thread of another step gets only
+// the thread it runs on.
+class WorkerThreadReservation {
+public:
+  // Reserves threads for up to TaskCount tasks; they are returned to the
+  // budget on destruction, so the reservation must outlive the threads.
+  explicit WorkerThreadReservation(unsigned TaskCount);
+  ~WorkerThreadReservation();
+  WorkerThreadReservation(const WorkerThreadReservation &) = delete;
+  WorkerThreadReservation &operator=(const WorkerThreadReservation &) = delete;
+
+  // Number of threads to run the tasks on, counting the calling thread;
+  // at least 1.
+  unsigned GetThreadCount() const { return m_threadCount; }
+
+private:
+  unsigned m_threadCount;
+};
+
+// Marks the calling thread as a worker thread while in scope. Worker threads
+// enter one for their lifetime; the calling thread enters one while it runs
+// tasks alongside them.
+class WorkerThreadScope {
+public:
+  WorkerThreadScope();
+  ~WorkerThreadScope();
+  WorkerThreadScope(const WorkerThreadScope &) = delete;
+  WorkerThreadScope &operator=(const WorkerThreadScope &) = delete;
+
+private:
+  bool m_wasWorker;
+};
+
+} // namespace hlsl
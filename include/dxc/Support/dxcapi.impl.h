@@ -15,6 +15,9 @@
 #include "dxc/dxcapi.h"
 #include "dxc/Support/microcom.h"
 #include "llvm/Support/raw_ostream.h"
+#include <climits>
+#include <string>
+#include <vector>
 
 // Simple adaptor for IStream. Can probably do better.
 class raw_stream_ostream : public llvm::raw_ostream {
@@ -32,15 +35,74 @@ public:
   }
 };
 
-class DxcOperationResult : public IDxcOperationResult {
+// Writes all of pData to a caller's stream, in as many writes as it takes.
+// Fails with STG_E_MEDIUMFULL if a write makes no progress.
+inline HRESULT WriteAllToStream(IStream *pStream, const void *pData,
+                                size_t size) {
+  const char *pBytes = (const char *)pData;
+  while (size > 0) {
+    ULONG cb = size > ULONG_MAX ? ULONG_MAX : (ULONG)size;
+    ULONG cbWritten = 0;
+    HRESULT hr = pStream->Write(pBytes, cb, &cbWritten);
+    if (FAILED(hr))
+      return hr;
+    if (cbWritten == 0 || cbWritten > cb)
+      return STG_E_MEDIUMFULL;
+    pBytes += cbWritten;
+    size -= cbWritten;
+  }
+  return S_OK;
+}
+
+// Adaptor for a caller's IStream, which need not report its position. The
+// first write error is kept, and later writes are dropped.
+class raw_istream_ostream : public llvm::raw_ostream {
+private:
+  CComPtr<IStream> m_pStream;
+  uint64_t m_Position = 0;
+  HRESULT m_hr = S_OK;
+  void write_impl(const char *Ptr, size_t Size) override {
+    if (SUCCEEDED(m_hr))
+      m_hr = WriteAllToStream(m_pStream, Ptr, Size);
+    m_Position += Size;
+  }
+  uint64_t current_pos() const override { return m_Position; }
+public:
+  raw_istream_ostream(IStream *pStream) : m_pStream(pStream) { }
+  ~raw_istream_ostream() override {
+    flush();
+  }
+  HRESULT GetStatus() {
+    flush();
+    return m_hr;
+  }
+};
+
+// A diagnostic as recorded by a compile invoked with -diag-records.
+struct DxcDiagnosticRecord {
+  UINT32 Id;
+  UINT32 Severity;
+  std::string FileName; // Empty if the diagnostic has no location.
+  UINT32 Line;
+  UINT32 Column;
+  std::string Message;
+};
+
+class DxcOperationResult : public IDxcOperationResult,
+                           public IDxcOperationResultReport,
+                           public IDxcOperationResultDiagnostics {
 private:
   DXC_MICROCOM_TM_REF_FIELDS()
+  std::vector<DxcDiagnosticRecord> m_diagnostics;
+  bool m_formatDiagnostics = false;
 
   void Init(_In_opt_ IDxcBlob *pResultBlob,
-            _In_opt_ IDxcBlobEncoding *pErrorBlob, HRESULT status) {
+            _In_opt_ IDxcBlobEncoding *pErrorBlob,
+            _In_opt_ IDxcBlobEncoding *pReportBlob, HRESULT status) {
     m_status = status;
     m_result = pResultBlob;
     m_errors = pErrorBlob;
+    m_report = pReportBlob;
   }
 
 public:
@@ -50,19 +112,50 @@ public:
   HRESULT m_status;
   CComPtr<IDxcBlob> m_result;
   CComPtr<IDxcBlobEncoding> m_errors;
+  CComPtr<IDxcBlobEncoding> m_report;
 
   HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) {
-    return DoBasicQueryInterface<IDxcOperationResult>(this, iid, ppvObject);
+    return DoBasicQueryInterface<IDxcOperationResult,
+                                 IDxcOperationResultReport,
+                                 IDxcOperationResultDiagnostics>(this, iid,
+                                                                 ppvObject);
   }
 
   static HRESULT CreateFromResultErrorStatus(_In_opt_ IDxcBlob *pResultBlob,
                                              _In_opt_ IDxcBlobEncoding *pErrorBlob,
                                              HRESULT status,
                                              _COM_Outptr_ IDxcOperationResult **ppResult) {
+    return CreateFromResultErrorReportStatus(pResultBlob, pErrorBlob, nullptr,
+                                             status, ppResult);
+  }
+
+  static HRESULT CreateFromResultErrorReportStatus(_In_opt_ IDxcBlob *pResultBlob,
+                                                   _In_opt_ IDxcBlobEncoding *pErrorBlob,
+                                                   _In_opt_ IDxcBlobEncoding *pReportBlob,
+                                                   HRESULT status,
+                                                   _COM_Outptr_ IDxcOperationResult **ppResult) {
     *ppResult = nullptr;
     CComPtr<DxcOperationResult> result = DxcOperationResult::Alloc(DxcGetThreadMallocNoRef());
     IFROOM(result.p);
-    result->Init(pResultBlob, pErrorBlob, status);
+    result->Init(pResultBlob, pErrorBlob, pReportBlob, status);
+    *ppResult = result.Detach();
+    return S_OK;
+  }
+
+  // Creates a result whose error buffer is formatted from diagnostics on
+  // first request, followed by the text of pErrorBlob if any.
+  static HRESULT CreateFromResultDiagnosticsStatus(_In_opt_ IDxcBlob *pResultBlob,
+                                                   std::vector<DxcDiagnosticRecord> &&diagnostics,
+                                                   _In_opt_ IDxcBlobEncoding *pErrorBlob,
+                                                   _In_opt_ IDxcBlobEncoding *pReportBlob,
+                                                   HRESULT status,
+                                                   _COM_Outptr_ IDxcOperationResult **ppResult) {
+    *ppResult = nullptr;
+    CComPtr<DxcOperationResult> result = DxcOperationResult::Alloc(DxcGetThreadMallocNoRef());
+    IFROOM(result.p);
+    result->Init(pResultBlob, pErrorBlob, pReportBlob, status);
+    result->m_diagnostics = std::move(diagnostics);
+    result->m_formatDiagnostics = !result->m_diagnostics.empty();
     *ppResult = result.Detach();
     return S_OK;
   }
@@ -97,6 +190,44 @@ public:
     return CreateFromResultErrorStatus(resultBlob, errorBlob, status, pResult);
   }
 
+  // Creates a result with the status, errors, report and diagnostics of
+  // pSource but no result blob, so that the blob can be released once it has
+  // been handed over some other way.
+  static HRESULT CreateWithoutResult(_In_ IDxcOperationResult *pSource,
+                                     _COM_Outptr_ IDxcOperationResult **ppResult) {
+    *ppResult = nullptr;
+    HRESULT status;
+    CComPtr<IDxcBlobEncoding> pErrors;
+    CComPtr<IDxcBlobEncoding> pReport;
+    CComPtr<IDxcOperationResultReport> pSourceReport;
+    CComPtr<IDxcOperationResultDiagnostics> pSourceDiagnostics;
+    IFR(pSource->GetStatus(&status));
+    IFR(pSource->GetErrorBuffer(&pErrors));
+    if (SUCCEEDED(pSource->QueryInterface(&pSourceReport)))
+      IFR(pSourceReport->GetReport(&pReport));
+
+    CComPtr<DxcOperationResult> result = DxcOperationResult::Alloc(DxcGetThreadMallocNoRef());
+    IFROOM(result.p);
+    result->Init(nullptr, pErrors, pReport, status);
+    // The errors are already formatted, so the records are only copied.
+    if (SUCCEEDED(pSource->QueryInterface(&pSourceDiagnostics))) {
+      UINT32 count;
+      IFR(pSourceDiagnostics->GetDiagnosticCount(&count));
+      try {
+        for (UINT32 i = 0; i < count; ++i) {
+          DxcDiagnostic diag;
+          IFT(pSourceDiagnostics->GetDiagnostic(i, &diag));
+          result->m_diagnostics.push_back(
+              {diag.Id, diag.Severity, diag.pFileName ? diag.pFileName : "",
+               diag.Line, diag.Column, diag.pMessage});
+        }
+      }
+      CATCH_CPP_RETURN_HRESULT();
+    }
+    *ppResult = result.Detach();
+    return S_OK;
+  }
+
   __override HRESULT STDMETHODCALLTYPE GetStatus(_Out_ HRESULT *pStatus) {
     if (pStatus == nullptr)
       return E_INVALIDARG;
@@ -112,8 +243,65 @@ public:
 
   __override HRESULT STDMETHODCALLTYPE
     GetErrorBuffer(_COM_Outptr_result_maybenull_ IDxcBlobEncoding **ppErrors) {
+    if (m_formatDiagnostics) {
+      *ppErrors = nullptr;
+      try {
+        FormatDiagnostics();
+      }
+      CATCH_CPP_RETURN_HRESULT();
+    }
     return m_errors.CopyTo(ppErrors);
   }
+
+  __override HRESULT STDMETHODCALLTYPE GetDiagnosticCount(_Out_ UINT32 *pCount) {
+    if (pCount == nullptr)
+      return E_INVALIDARG;
+    *pCount = (UINT32)m_diagnostics.size();
+    return S_OK;
+  }
+
+  __override HRESULT STDMETHODCALLTYPE GetDiagnostic(UINT32 index, _Out_ DxcDiagnostic *pDiagnostic) {
+    if (pDiagnostic == nullptr || index >= m_diagnostics.size())
+      return E_INVALIDARG;
+    const DxcDiagnosticRecord &record = m_diagnostics[index];
+    pDiagnostic->Id = record.Id;
+    pDiagnostic->Severity = record.Severity;
+    pDiagnostic->pFileName = record.FileName.empty() ? nullptr : record.FileName.c_str();
+    pDiagnostic->Line = record.Line;
+    pDiagnostic->Column = record.Column;
+    pDiagnostic->pMessage = record.Message.c_str();
+    return S_OK;
+  }
+
+private:
+  // Formats the recorded diagnostics the way the text printer does, less the
+  // source snippets, ahead of the existing error text.
+  void FormatDiagnostics() {
+    static const char *SeverityNames[] = { "note", "remark", "warning", "error" };
+    std::string text;
+    llvm::raw_string_ostream OS(text);
+    for (const DxcDiagnosticRecord &record : m_diagnostics) {
+      if (!record.FileName.empty())
+        OS << record.FileName << ':' << record.Line << ':' << record.Column << ": ";
+      OS << SeverityNames[record.Severity] << ": " << record.Message << '\n';
+    }
+    if (m_errors != nullptr)
+      OS << llvm::StringRef((const char *)m_errors->GetBufferPointer(),
+                            m_errors->GetBufferSize());
+    OS.flush();
+    CComPtr<IDxcBlobEncoding> pErrors;
+    IFT(hlsl::DxcCreateBlobWithEncodingOnHeapCopy(text.data(), text.size(),
+                                                  CP_UTF8, &pErrors));
+    m_errors = pErrors;
+    m_formatDiagnostics = false;
+  }
+
+public:
+
+  __override HRESULT STDMETHODCALLTYPE
+    GetReport(_COM_Outptr_result_maybenull_ IDxcBlobEncoding **ppReport) {
+    return m_report.CopyTo(ppReport);
+  }
 };
 
 #endif
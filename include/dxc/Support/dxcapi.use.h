@@ -13,6 +13,8 @@
 #define __DXCAPI_USE_H__
 
 #include "dxc/dxcapi.h"
+#include <string>
+#include <vector>
 
 namespace dxc {
 
@@ -98,6 +100,15 @@ public:
     return hr;
   }
 
+  // Has the library do its one-time initialization now rather than on its
+  // first request. Returns S_FALSE if the library doesn't support it.
+  HRESULT WarmUp() {
+    if (m_dll == nullptr) return E_FAIL;
+    DxcWarmUpProc warmUpFn = (DxcWarmUpProc)GetProcAddress(m_dll, "DxcWarmUp");
+    if (warmUpFn == nullptr) return S_FALSE;
+    return warmUpFn();
+  }
+
   bool HasCreateWithMalloc() const {
     return m_createFn2 != nullptr;
   }
@@ -135,6 +146,18 @@ void IFT_Data(HRESULT hr, _In_opt_ LPCWSTR data);
 void EnsureEnabled(DxcDllSupport &dxcSupport);
 void ReadFileIntoBlob(DxcDllSupport &dxcSupport, _In_ LPCWSTR pFileName,
                       _Outptr_ IDxcBlobEncoding **ppBlobEncoding);
+// Maps the file rather than copying it; use for containers and other inputs
+// that are only read.
+void ReadFileIntoBlobMapped(_In_ LPCWSTR pFileName,
+                            _Outptr_ IDxcBlobEncoding **ppBlobEncoding);
+// Adds the files Input names to Paths: the file itself, the files matching
+// * and ? wildcards in its file name, or the files under it if it is a
+// directory. Needs a file system installed for the thread.
+void ExpandInputPath(const std::string &Input, std::vector<std::string> &Paths);
+// Expands each line of a list file as an input path; blank lines and lines
+// starting with # are skipped.
+void ReadInputPathList(DxcDllSupport &dxcSupport, _In_ LPCWSTR pListFile,
+                       std::vector<std::string> &Paths);
 void WriteBlobToConsole(_In_opt_ IDxcBlob *pBlob, DWORD streamType = STD_OUTPUT_HANDLE);
 void WriteBlobToFile(_In_opt_ IDxcBlob *pBlob, _In_ LPCWSTR pFileName);
 void WriteBlobToHandle(_In_opt_ IDxcBlob *pBlob, HANDLE hFile, _In_opt_ LPCWSTR pFileName);
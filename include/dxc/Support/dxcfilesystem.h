@@ -13,6 +13,9 @@
 
 #include "dxc/dxcapi.h"
 #include "llvm/Support/MSFileSystem.h"
+#include <string>
+#include <utility>
+#include <vector>
 
 namespace clang {
 class CompilerInstance;
@@ -38,8 +41,27 @@ public:
   virtual void GetStdOutpuHandleStream(IStream **ppResultStream) = 0;
   virtual void WriteStdErrToStream(llvm::raw_string_ostream &s) = 0;
   virtual void EnableDisplayIncludeProcess() = 0;
+  // Loads includes through the process-wide include cache.
+  virtual void EnableIncludeCache() = 0;
+  // Serves the main source and includes reduced to the directives that
+  // decide what they include, for dependency scanning.
+  virtual void EnableMinimizedSources() = 0;
   virtual HRESULT CreateStdStreams(_In_ IMalloc *pMalloc) = 0;
   virtual HRESULT RegisterOutputStream(LPCWSTR pName, IStream *pStream) = 0;
+  // Gets every file loaded through the include handler in load order,
+  // excluding the main source, followed by the names the handler did not
+  // resolve, which are returned with a null blob.
+  typedef std::vector<std::pair<std::wstring, CComPtr<IDxcBlob>>> IncludedFileList;
+  virtual void GetIncludedFiles(IncludedFileList &files) = 0;
+  // Loads an include ahead of the compile, for example to check a cache
+  // entry against it. The compile later gets the same content without
+  // asking the include handler again. *ppBlob is null if the handler did not
+  // resolve the name.
+  virtual HRESULT PreloadInclude(_In_ LPCWSTR pName, _COM_Outptr_result_maybenull_ IDxcBlob **ppBlob) = 0;
+  // Adds includes another file system loaded for the same source and include
+  // handler, as returned by GetIncludedFiles, so that the compile doesn't
+  // ask the include handler for them again.
+  virtual void AddPreloadedIncludes(const IncludedFileList &files) = 0;
 };
 
 DxcArgsFileSystem *
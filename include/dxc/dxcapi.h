@@ -80,6 +80,16 @@ DXC_API_IMPORT HRESULT __stdcall DxcCreateInstance2(
   _Out_ LPVOID*   ppv
 );
 
+typedef HRESULT(__stdcall *DxcWarmUpProc)();
+
+/// <summary>
+/// Does the one-time work the library otherwise does on its first request:
+/// loads dxil.dll when it is available and prepares the validator. Objects
+/// created afterwards don't pay for it. Optional; calling it again has no
+/// further effect.
+/// </summary>
+DXC_API_IMPORT HRESULT __stdcall DxcWarmUp();
+
 
 // IDxcBlob is an alias of ID3D10Blob and ID3DBlob
 struct __declspec(uuid("8BA5FB08-5195-40e2-AC58-0D989C3A0102"))
@@ -130,6 +140,46 @@ IDxcOperationResult : public IUnknown {
   virtual HRESULT STDMETHODCALLTYPE GetErrorBuffer(_COM_Outptr_result_maybenull_ IDxcBlobEncoding **pErrors) = 0;
 };
 
+struct __declspec(uuid("4E7A9C2D-1B38-4F65-A0D9-83C5E6B21F47"))
+IDxcOperationResultReport : public IUnknown {
+  // Gets the report of the operation, or null if there is none. The report
+  // is UTF-8 text, a header line followed by tab-separated lines:
+  // - a compile invoked with -report-phases reports the timing and memory
+  //   of each phase;
+  // - a successful link reports the resource remap table, one line per
+  //   resource of the linked shader with its ID and binding;
+  // - a preprocess invoked with -report-includes reports each #include
+  //   directive, with the file it resolved to, the file and line it is on,
+  //   and whether it was found.
+  virtual HRESULT STDMETHODCALLTYPE GetReport(_COM_Outptr_result_maybenull_ IDxcBlobEncoding **ppReport) = 0;
+};
+
+static const UINT32 DxcDiagnosticSeverity_Note = 0;
+static const UINT32 DxcDiagnosticSeverity_Remark = 1;
+static const UINT32 DxcDiagnosticSeverity_Warning = 2;
+static const UINT32 DxcDiagnosticSeverity_Error = 3;
+
+// A diagnostic recorded by an operation, for IDxcOperationResultDiagnostics.
+struct DxcDiagnostic {
+  UINT32 Id;          // Kind of the diagnostic; not stable across compiler versions.
+  UINT32 Severity;    // One of the DxcDiagnosticSeverity values.
+  LPCSTR pFileName;   // UTF-8; null if the diagnostic has no location.
+  UINT32 Line;        // 1-based; zero if the diagnostic has no location.
+  UINT32 Column;      // 1-based; zero if the diagnostic has no location.
+  LPCSTR pMessage;    // UTF-8, without location or source snippet.
+};
+
+struct __declspec(uuid("9D3B6E1A-2C54-4F87-B0E6-5A8C1D7F3B92"))
+IDxcOperationResultDiagnostics : public IUnknown {
+  // Gets the number of diagnostics the operation recorded. Only a compile
+  // invoked with -diag-records records them; its error buffer is then
+  // formatted from them on first request, without source snippets.
+  virtual HRESULT STDMETHODCALLTYPE GetDiagnosticCount(_Out_ UINT32 *pCount) = 0;
+  // Gets a diagnostic in the order it was reported. The strings remain valid
+  // for the lifetime of the result.
+  virtual HRESULT STDMETHODCALLTYPE GetDiagnostic(UINT32 index, _Out_ DxcDiagnostic *pDiagnostic) = 0;
+};
+
 struct __declspec(uuid("7f61fc7d-950d-467f-b3e3-3c02fb49187c"))
 IDxcIncludeHandler : public IUnknown {
   virtual HRESULT STDMETHODCALLTYPE LoadSource(
@@ -143,6 +193,8 @@ struct DxcDefine {
   _Maybenull_ LPCWSTR Value;
 };
 
+// A compiler object may be used from several threads at once; compiles on
+// one object don't wait on each other, and each keeps its own state.
 struct __declspec(uuid("8c210bf3-011f-4422-8d70-6f9acb8db617"))
 IDxcCompiler : public IUnknown {
   // Compile a single entry point to the target shader model
@@ -197,6 +249,238 @@ IDxcCompiler2 : public IDxcCompiler {
   ) = 0;
 };
 
+// Compiles several entry points of one source, which is preprocessed, parsed
+// and checked once. Available from the compiler object through QueryInterface.
+struct __declspec(uuid("3E8D5A27-6C41-4B9F-A2D3-7F1B0C6E9A58"))
+IDxcCompiler3 : public IDxcCompiler2 {
+  // Compiles each entry point to the profile at the same index. ppResults
+  // receives one result per entry point, in order; an entry point that fails
+  // to compile reports its errors in its own result, while errors in the
+  // shared source fail every entry point.
+  virtual HRESULT STDMETHODCALLTYPE CompileBatch(
+    _In_ IDxcBlob *pSource,                       // Source text to compile
+    _In_opt_ LPCWSTR pSourceName,                 // Optional file name for pSource. Used in errors and include handlers.
+    _In_count_(entryCount) const LPCWSTR *pEntryPoints,    // Array of entry point names
+    _In_count_(entryCount) const LPCWSTR *pTargetProfiles, // Array of shader profiles to compile
+    UINT32 entryCount,                            // Number of entry points
+    _In_count_(argCount) LPCWSTR *pArguments,     // Array of pointers to arguments
+    _In_ UINT32 argCount,                         // Number of arguments
+    _In_count_(defineCount) const DxcDefine *pDefines,  // Array of defines
+    _In_ UINT32 defineCount,                      // Number of defines
+    _In_opt_ IDxcIncludeHandler *pIncludeHandler, // user-provided interface to handle #include directives (optional)
+    _Out_writes_(entryCount) IDxcOperationResult **ppResults // Compiler output status, buffer, and errors per entry point
+  ) = 0;
+};
+
+// Compiles many sources with one set of options. The options are parsed and
+// validated once by Initialize, and reused by every subsequent Compile call.
+// Available from the compiler object through QueryInterface.
+struct __declspec(uuid("5F2B3C4E-8A1D-4E7B-9C36-2D0F6A1B7E45"))
+IDxcCompilerSession : public IUnknown {
+  // Sets the options used by every compile in the session.
+  virtual HRESULT STDMETHODCALLTYPE Initialize(
+    _In_ LPCWSTR pTargetProfile,                  // Shader profile to compile
+    _In_count_(argCount) LPCWSTR *pArguments,     // Array of pointers to arguments
+    _In_ UINT32 argCount,                         // Number of arguments
+    _In_count_(defineCount) const DxcDefine *pDefines,  // Array of defines
+    _In_ UINT32 defineCount,                      // Number of defines
+    _COM_Outptr_opt_ IDxcBlobEncoding **ppErrors  // Errors in the options
+  ) = 0;
+
+  // Compile a single entry point with the session options. Returns
+  // E_NOT_VALID_STATE if Initialize has not succeeded.
+  virtual HRESULT STDMETHODCALLTYPE Compile(
+    _In_ IDxcBlob *pSource,                       // Source text to compile
+    _In_opt_ LPCWSTR pSourceName,                 // Optional file name for pSource. Used in errors and include handlers.
+    _In_ LPCWSTR pEntryPoint,                     // Entry point name
+    _In_opt_ IDxcIncludeHandler *pIncludeHandler, // user-provided interface to handle #include directives (optional)
+    _COM_Outptr_ IDxcOperationResult **ppResult,  // Compiler output status, buffer, and errors
+    _Outptr_opt_result_z_ LPWSTR *ppDebugBlobName,// Suggested file name for debug blob.
+    _COM_Outptr_opt_ IDxcBlob **ppDebugBlob       // Debug blob
+  ) = 0;
+};
+
+// Arguments parsed and validated once by IDxcCompilerArgsParser. The handle
+// is immutable, so any number of compiles may use it, from any thread and
+// through any compiler object.
+struct __declspec(uuid("C3A9E1F4-6B28-4D7E-8F15-9A2D4B7C0E36"))
+IDxcCompilerArgs : public IUnknown {
+};
+
+// Parses compile arguments into a handle that compiles accept in place of
+// the raw arguments. Available from the compiler object through
+// QueryInterface.
+struct __declspec(uuid("E8D46B2F-1A73-4C59-B6E0-3F7C92A5D184"))
+IDxcCompilerArgsParser : public IUnknown {
+  virtual HRESULT STDMETHODCALLTYPE ParseArguments(
+    _In_ LPCWSTR pTargetProfile,                  // Shader profile to compile
+    _In_count_(argCount) LPCWSTR *pArguments,     // Array of pointers to arguments
+    _In_ UINT32 argCount,                         // Number of arguments
+    _In_count_(defineCount) const DxcDefine *pDefines,  // Array of defines
+    _In_ UINT32 defineCount,                      // Number of defines
+    _COM_Outptr_ IDxcCompilerArgs **ppArgs,       // Parsed arguments
+    _COM_Outptr_opt_ IDxcBlobEncoding **ppErrors  // Errors in the arguments
+  ) = 0;
+
+  // Compile a single entry point with parsed arguments. pArgs must come from
+  // ParseArguments of a compiler object of this library.
+  virtual HRESULT STDMETHODCALLTYPE CompileWithArgs(
+    _In_ IDxcBlob *pSource,                       // Source text to compile
+    _In_opt_ LPCWSTR pSourceName,                 // Optional file name for pSource. Used in errors and include handlers.
+    _In_ LPCWSTR pEntryPoint,                     // Entry point name
+    _In_ IDxcCompilerArgs *pArgs,                 // Parsed arguments
+    _In_opt_ IDxcIncludeHandler *pIncludeHandler, // user-provided interface to handle #include directives (optional)
+    _COM_Outptr_ IDxcOperationResult **ppResult,  // Compiler output status, buffer, and errors
+    _Outptr_opt_result_z_ LPWSTR *ppDebugBlobName,// Suggested file name for debug blob.
+    _COM_Outptr_opt_ IDxcBlob **ppDebugBlob       // Debug blob
+  ) = 0;
+};
+
+// Compiles permutations of one shader that differ only in their defines.
+// Permutations that preprocess to the same text share a single compile.
+// That only happens when a permutation's defines don't change the text, for
+// example defines that the entry point's code never reads; any other
+// permutation pays for an extra preprocess on top of its compile. Each
+// include is loaded from the include handler once per call.
+// Available from the compiler object through QueryInterface.
+struct __declspec(uuid("B7C21E94-5F3A-4D68-9E07-1A4C8D2F6B35"))
+IDxcCompilerPermutations : public IUnknown {
+  // Compiles each permutation with pDefines followed by its own defines.
+  // pPermutationDefines holds the defines of every permutation in order,
+  // pPermutationDefineCounts[i] of them for permutation i. ppResults
+  // receives one result per permutation, in order; permutations that share
+  // a compile share the result object.
+  virtual HRESULT STDMETHODCALLTYPE CompilePermutations(
+    _In_ IDxcBlob *pSource,                       // Source text to compile
+    _In_opt_ LPCWSTR pSourceName,                 // Optional file name for pSource. Used in errors and include handlers.
+    _In_ LPCWSTR pEntryPoint,                     // Entry point name
+    _In_ LPCWSTR pTargetProfile,                  // Shader profile to compile
+    _In_count_(argCount) LPCWSTR *pArguments,     // Array of pointers to arguments
+    _In_ UINT32 argCount,                         // Number of arguments
+    _In_count_(defineCount) const DxcDefine *pDefines,  // Defines shared by every permutation
+    _In_ UINT32 defineCount,                      // Number of shared defines
+    _In_opt_ const DxcDefine *pPermutationDefines,      // Defines of every permutation
+    _In_count_(permutationCount) const UINT32 *pPermutationDefineCounts, // Number of defines of each permutation
+    UINT32 permutationCount,                      // Number of permutations
+    _In_opt_ IDxcIncludeHandler *pIncludeHandler, // user-provided interface to handle #include directives (optional)
+    _Out_writes_(permutationCount) IDxcOperationResult **ppResults // Compiler output status, buffer, and errors per permutation
+  ) = 0;
+};
+
+static const UINT32 DxcDisassembleFlags_None = 0;
+static const UINT32 DxcDisassembleFlags_SkipMetadata = 1;  // Leave metadata and debug info out of the IR.
+static const UINT32 DxcDisassembleFlags_ResourcesOnly = 2; // Print the container, signature and resource summaries, but no IR.
+static const UINT32 DxcDisassembleFlags_CostOnly = 4;      // Print only the estimated cost of each entry point.
+static const UINT32 DxcDisassembleFlags_ValidMask = 0x7;
+
+// Disassembles a program straight into a stream, rather than into a single
+// blob, optionally printing only part of it. Available from the compiler
+// object through QueryInterface.
+struct __declspec(uuid("53c1bb85-709e-4b91-a3f2-b5294ab947aa"))
+IDxcDisassembler : public IUnknown {
+  virtual HRESULT STDMETHODCALLTYPE DisassembleToStream(
+    _In_ IDxcBlob *pProgram,                      // Program to disassemble.
+    UINT32 flags,                                 // DxcDisassembleFlags_* values.
+    _In_opt_ LPCWSTR pFunctionName,               // Only print the IR of this function; E_INVALIDARG if it is not found.
+    _In_ IStream *pOutput                         // Receives the UTF-8 disassembly text.
+  ) = 0;
+};
+
+// Dedupes root signatures across shaders. Root signatures are compared by
+// content, so two that define the same layout are equal even if they were
+// serialized differently. Available from the compiler object through
+// QueryInterface.
+struct __declspec(uuid("0bbbd26c-a4b3-44fd-8c73-577e9bd56f02"))
+IDxcRootSignatureCache : public IUnknown {
+  // Returns the first root signature interned in this process that is equal
+  // to pRootSignature, and its canonical hash. The hash is stable across
+  // processes.
+  virtual HRESULT STDMETHODCALLTYPE Intern(
+    _In_ IDxcBlob *pRootSignature,      // Serialized root signature, or a container with a root signature part.
+    _COM_Outptr_ IDxcBlob **ppInterned, // Serialized root signature shared by all equal ones.
+    _Out_opt_ UINT64 *pHash             // Canonical hash of the root signature.
+  ) = 0;
+};
+
+// Stops compiles that are already running, so that a shader that takes too
+// long doesn't hold up the thread compiling it. Available from the compiler
+// object through QueryInterface.
+struct __declspec(uuid("a94edc73-5a8f-4a4f-a59c-2f36920c6db2"))
+IDxcCompilerCancel : public IUnknown {
+  // Makes every compile running on this compiler object, on any thread,
+  // return DXC_E_COMPILE_CANCELLED once it reaches its next checkpoint: the
+  // start of a pass or phase, a top-level declaration or a function being
+  // validated. Compiles started after the call are not affected.
+  virtual HRESULT STDMETHODCALLTYPE CancelCompiles() = 0;
+};
+
+// Compiles a single entry point, writing its outputs to streams of the
+// caller's, such as files, rather than returning them in blobs. Available
+// from the compiler object through QueryInterface.
+struct __declspec(uuid("6e0c5a3d-8b1f-4c27-9d52-f4a81b3e7c06"))
+IDxcCompilerToStreams : public IUnknown {
+  // Streams are only written when the compile succeeds, and any of them may
+  // be null to skip that output. ppResult holds the status, errors and
+  // report of the compile, but no result blob. Fails with the stream's error
+  // if writing to a stream fails, or with STG_E_MEDIUMFULL if a stream stops
+  // taking data.
+  virtual HRESULT STDMETHODCALLTYPE CompileToStreams(
+    _In_ IDxcBlob *pSource,                       // Source text to compile
+    _In_opt_ LPCWSTR pSourceName,                 // Optional file name for pSource. Used in errors and include handlers.
+    _In_ LPCWSTR pEntryPoint,                     // Entry point name
+    _In_ LPCWSTR pTargetProfile,                  // Shader profile to compile
+    _In_count_(argCount) LPCWSTR *pArguments,     // Array of pointers to arguments
+    _In_ UINT32 argCount,                         // Number of arguments
+    _In_count_(defineCount) const DxcDefine *pDefines,  // Array of defines
+    _In_ UINT32 defineCount,                      // Number of defines
+    _In_opt_ IDxcIncludeHandler *pIncludeHandler, // user-provided interface to handle #include directives (optional)
+    _In_opt_ IStream *pObject,                    // Receives the container, as the result blob of Compile.
+    _In_opt_ IStream *pDebug,                     // Receives the debug blob of CompileWithDebug; nothing without -Zi.
+    _In_opt_ IStream *pDisassembly,               // Receives the UTF-8 disassembly of the container.
+    _COM_Outptr_ IDxcOperationResult **ppResult   // Compiler output status and errors
+  ) = 0;
+};
+
+// Captures compiles into self-contained bundles, and compiles bundles.
+// A bundle holds everything a compile reads: the source and its name, the
+// entry point, profile, arguments and defines, every file requested from the
+// include handler, and the validator version the compile targeted. Compiling
+// a bundle needs no include handler, so it can be done by a process without
+// access to the files the bundle was captured from. Available from the
+// compiler object through QueryInterface.
+struct __declspec(uuid("a4f1c2e7-3b58-4d96-8e0a-5c7d2b91f6e3"))
+IDxcCompilerBundle : public IUnknown {
+  // Compiles as CompileWithDebug does, and also returns a bundle of the
+  // compile's inputs. The bundle is returned whether or not the compile
+  // succeeds, unless the arguments can't be read. Result caches are bypassed,
+  // since a cached result doesn't read its includes.
+  virtual HRESULT STDMETHODCALLTYPE CompileAndCaptureBundle(
+    _In_ IDxcBlob *pSource,                       // Source text to compile
+    _In_opt_ LPCWSTR pSourceName,                 // Optional file name for pSource. Used in errors and include handlers.
+    _In_ LPCWSTR pEntryPoint,                     // Entry point name
+    _In_ LPCWSTR pTargetProfile,                  // Shader profile to compile
+    _In_count_(argCount) LPCWSTR *pArguments,     // Array of pointers to arguments
+    _In_ UINT32 argCount,                         // Number of arguments
+    _In_count_(defineCount) const DxcDefine *pDefines,  // Array of defines
+    _In_ UINT32 defineCount,                      // Number of defines
+    _In_opt_ IDxcIncludeHandler *pIncludeHandler, // user-provided interface to handle #include directives (optional)
+    _COM_Outptr_ IDxcOperationResult **ppResult,  // Compiler output status, buffer, and errors
+    _Outptr_opt_result_z_ LPWSTR *ppDebugBlobName,// Suggested file name for debug blob.
+    _COM_Outptr_opt_ IDxcBlob **ppDebugBlob,      // Debug blob
+    _COM_Outptr_result_maybenull_ IDxcBlob **ppBundle // Inputs of the compile
+  ) = 0;
+
+  // Compiles a bundle with the request and validator version it holds.
+  // Includes resolve only to the files in the bundle. Fails with
+  // E_INVALIDARG if pBundle isn't a bundle written by this version.
+  virtual HRESULT STDMETHODCALLTYPE CompileBundle(
+    _In_ IDxcBlob *pBundle,                       // Bundle from CompileAndCaptureBundle
+    _COM_Outptr_ IDxcOperationResult **ppResult,  // Compiler output status, buffer, and errors
+    _Outptr_opt_result_z_ LPWSTR *ppDebugBlobName,// Suggested file name for debug blob.
+    _COM_Outptr_opt_ IDxcBlob **ppDebugBlob       // Debug blob
+  ) = 0;
+};
+
 struct __declspec(uuid("F1B5BE2A-62DD-4327-A1C2-42AC1E1E78E6"))
 IDxcLinker : public IUnknown {
 public:
@@ -222,11 +506,38 @@ public:
   ) = 0;
 };
 
+// Links many entry points against one set of libraries. Available from the
+// linker object through QueryInterface.
+struct __declspec(uuid("9C4E6B1A-3D27-4F58-8A90-5B2E7C1D4F63"))
+IDxcLinker2 : public IDxcLinker {
+public:
+  // Links each entry point with the profile at the same index. ppResults
+  // receives one result per entry point, in order; an entry that fails to
+  // link reports its errors in its own result. No link arguments are
+  // supported yet; any argument fails the call with E_INVALIDARG.
+  virtual HRESULT STDMETHODCALLTYPE LinkBatch(
+      _In_count_(entryCount)
+          const LPCWSTR *pEntryNames,     // Array of entry point names
+      _In_count_(entryCount)
+          const LPCWSTR *pTargetProfiles, // Array of shader profiles to link
+      UINT32 entryCount,                  // Number of entry points to link
+      _In_count_(libCount)
+          const LPCWSTR *pLibNames,       // Array of library names to link
+      UINT32 libCount,                    // Number of libraries to link
+      _In_count_(argCount)
+          const LPCWSTR *pArguments,      // Array of pointers to arguments
+      _In_ UINT32 argCount,               // Number of arguments
+      _Out_writes_(entryCount) IDxcOperationResult *
+          *ppResults // Linker output status, buffer, and errors per entry
+  ) = 0;
+};
+
 static const UINT32 DxcValidatorFlags_Default = 0;
 static const UINT32 DxcValidatorFlags_InPlaceEdit = 1;  // Validator is allowed to update shader blob in-place.
 static const UINT32 DxcValidatorFlags_RootSignatureOnly = 2;
 static const UINT32 DxcValidatorFlags_ModuleOnly = 4;
-static const UINT32 DxcValidatorFlags_ValidMask = 0x7;
+static const UINT32 DxcValidatorFlags_CacheFunctions = 8; // Skip function bodies that passed on this validator before.
+static const UINT32 DxcValidatorFlags_ValidMask = 0xf;
 
 struct __declspec(uuid("A6E82BD2-1FD7-4826-9811-2857E797F49A"))
 IDxcValidator : public IUnknown {
@@ -246,6 +557,35 @@ IDxcContainerBuilder : public IUnknown {
   virtual HRESULT STDMETHODCALLTYPE SerializeContainer(_Out_ IDxcOperationResult **ppResult) = 0; // Builds a container of the given container builder state
 };
 
+// A change to one part of a container, for IDxcContainerBuilder2::EditParts.
+struct DxcContainerPartEdit {
+  UINT32 FourCC;       // Kind of the part.
+  IDxcBlob *pSource;   // New content of the part, or null to remove it.
+};
+
+static const UINT32 DxcContainerBuilderFlags_Default = 0;
+static const UINT32 DxcContainerBuilderFlags_SkipValidation = 1; // Don't validate an added root signature against the shader.
+static const UINT32 DxcContainerBuilderFlags_ValidMask = 0x1;
+
+// Edits many parts of a container at once. Parts that are not edited keep
+// referencing the memory of the loaded container rather than being copied.
+// Available from the container builder object through QueryInterface.
+struct __declspec(uuid("6D3F8E21-4B7A-4C95-B1E0-2A8C5F9D3E74"))
+IDxcContainerBuilder2 : public IDxcContainerBuilder {
+  // Applies the edits in order, adding, replacing or removing parts, or
+  // applies none of them if any is not allowed. Root signature and private
+  // data parts may be added or replaced; those and debug info may be removed.
+  virtual HRESULT STDMETHODCALLTYPE EditParts(
+    _In_count_(editCount) const DxcContainerPartEdit *pEdits, // Array of edits
+    UINT32 editCount                                          // Number of edits
+  ) = 0;
+  // Builds a container of the given container builder state.
+  virtual HRESULT STDMETHODCALLTYPE SerializeContainerWithFlags(
+    UINT32 flags,                                 // DxcContainerBuilderFlags_* values.
+    _COM_Outptr_ IDxcOperationResult **ppResult   // Container, and validation status and errors
+  ) = 0;
+};
+
 struct __declspec(uuid("091f7a26-1c1f-4948-904b-e6e3a8a771d5"))
 IDxcAssembler : public IUnknown {
   // Assemble dxil in ll or llvm bitcode to DXIL container.
@@ -147,6 +147,21 @@ public:
   virtual HRESULT STDMETHODCALLTYPE GetSemanticDefineWarningsAndErrors(LPCSTR pName, LPCSTR pValue, IDxcBlobEncoding **ppWarningBlob, IDxcBlobEncoding **ppErrorBlob) = 0;
 };
 
+// Optionally implemented by a semantic define validator to validate all the
+// semantic defines of a compile in one call. Entry i of ppWarningBlobs and
+// ppErrorBlobs receives the warning and error for define i, or null if there
+// is none.
+struct __declspec(uuid("6bd7e06b-8e4c-4774-9131-fb91bb24c367"))
+IDxcSemanticDefineBatchValidator : public IUnknown
+{
+public:
+  virtual HRESULT STDMETHODCALLTYPE GetSemanticDefinesWarningsAndErrors(
+      UINT32 count, _In_count_(count) const LPCSTR *pNames,
+      _In_count_(count) const LPCSTR *pValues,
+      _Out_writes_(count) IDxcBlobEncoding **ppWarningBlobs,
+      _Out_writes_(count) IDxcBlobEncoding **ppErrorBlobs) = 0;
+};
+
 struct __declspec(uuid("282a56b4-3f56-4360-98c7-9ea04a752272"))
 IDxcLangExtensions : public IUnknown
 {
@@ -165,6 +180,7 @@ public:
   /// <summary>Sets an (optional) validator for parsed semantic defines.<summary>
   /// This provides a hook to check that the semantic defines present in the source
   /// contain valid data. One validator is used to validate all parsed semantic defines.
+  /// If it also implements IDxcSemanticDefineBatchValidator, they are validated in one call.
   virtual HRESULT STDMETHODCALLTYPE SetSemanticDefineValidator(_In_ IDxcSemanticDefineValidator* pValidator) = 0;
   /// <summary>Sets the name for the root metadata node used in DXIL to hold the semantic defines.</summary>
   virtual HRESULT STDMETHODCALLTYPE SetSemanticDefineMetaDataName(LPCSTR name) = 0;
@@ -175,6 +175,22 @@ typedef enum DxcTranslationUnitFlags
   DxcTranslationUnitFlags_UseCallerThread = 0x800
 } DxcTranslationUnitFlags;
 
+typedef enum DxcParseStatus
+{
+  DxcParseStatus_Queued = 0,    // The parse has not started yet.
+  DxcParseStatus_Parsing = 1,   // The parse is running.
+  DxcParseStatus_Completed = 2, // The translation unit is available.
+  DxcParseStatus_Cancelled = 3, // The parse was cancelled; no result will be produced.
+  DxcParseStatus_Failed = 4,    // The parse failed; GetResult returns the failure.
+} DxcParseStatus;
+
+typedef enum DxcCompletionKind
+{
+  DxcCompletionKind_Declaration = 0, // Declared by the source, or a keyword or macro.
+  DxcCompletionKind_Intrinsic = 1,   // A built-in intrinsic function.
+  DxcCompletionKind_ObjectType = 2,  // A built-in object type, such as Texture2D.
+} DxcCompletionKind;
+
 typedef enum DxcCursorFormatting
 {
   DxcCursorFormatting_Default = 0x0,             // Default rules, language-insensitive formatting.
@@ -561,19 +577,59 @@ enum DxcCursorKindFlags
   DxcCursorKind_Unexposed = 0x100,
 };
 
+// A cursor passed by value, without a COM object behind it. The data fields
+// are opaque; the value is valid only as long as its translation unit is.
+typedef struct DxcCursorValue
+{
+  DxcCursorKind kind;
+  int xdata;
+  const void *data[3];
+} DxcCursorValue;
+
+typedef enum DxcChildVisitResult
+{
+  DxcChildVisit_Break = 0,    // Stops the traversal.
+  DxcChildVisit_Continue = 1, // Continues with the next sibling, skipping the children of this cursor.
+  DxcChildVisit_Recurse = 2,  // Visits the children of this cursor before its next sibling.
+} DxcChildVisitResult;
+
+typedef DxcChildVisitResult (STDMETHODCALLTYPE *DxcCursorVisitor)(
+  _In_ const DxcCursorValue *cursor,
+  _In_ const DxcCursorValue *parent,
+  _In_opt_ void *context);
+
+struct IDxcCompletionResults;
 struct IDxcCursor;
+struct IDxcCursor2;
 struct IDxcDiagnostic;
 struct IDxcFile;
 struct IDxcInclusion;
 struct IDxcIntelliSense;
 struct IDxcIndex;
+struct IDxcIndex2;
+struct IDxcParseOperation;
 struct IDxcSourceLocation;
 struct IDxcSourceRange;
 struct IDxcToken;
 struct IDxcTranslationUnit;
+struct IDxcTranslationUnit2;
 struct IDxcType;
 struct IDxcUnsavedFile;
 
+// Code completion candidates, sorted by name ignoring case.
+struct __declspec(uuid("c7e4a9d2-5b18-4f63-a0d5-3e9b8f12c647"))
+IDxcCompletionResults : public IUnknown
+{
+  virtual HRESULT STDMETHODCALLTYPE GetCount(_Out_ unsigned* pCount) = 0;
+  virtual HRESULT STDMETHODCALLTYPE GetResult(unsigned index,
+    _Outptr_result_z_ LPSTR* pText, _Out_ DxcCompletionKind* pKind) = 0;
+  // Gets the results whose names start with prefix, ignoring case, without
+  // completing again. Filtering results that were already filtered only looks
+  // at what is left, so an editor can narrow them on each keystroke.
+  virtual HRESULT STDMETHODCALLTYPE Filter(_In_z_ const char* prefix,
+    _Outptr_result_nullonfailure_ IDxcCompletionResults** pResult) = 0;
+};
+
 struct __declspec(uuid("1467b985-288d-4d2a-80c1-ef89c42c40bc"))
 IDxcCursor : public IUnknown
 {
@@ -613,6 +669,24 @@ IDxcCursor : public IUnknown
   virtual HRESULT STDMETHODCALLTYPE GetSnappedChild(_In_ IDxcSourceLocation* location, _Outptr_result_maybenull_ IDxcCursor** pResult) = 0;
 };
 
+struct __declspec(uuid("a4c9e1b7-3d52-4f86-8e0a-6b27d5f4c913"))
+IDxcCursor2 : public IDxcCursor
+{
+  /// <summary>Gets the value of this cursor.</summary>
+  virtual HRESULT STDMETHODCALLTYPE GetValue(_Out_ DxcCursorValue* pValue) = 0;
+  /// <summary>Calls visitor for the children of this cursor, without creating an object per child.</summary>
+  /// <remarks>The cursor values passed to the visitor are valid only for the duration of the call.</remarks>
+  /// <returns>In pVisitBroken, whether the visitor stopped the traversal with DxcChildVisit_Break.</returns>
+  virtual HRESULT STDMETHODCALLTYPE VisitChildren(
+    _In_ DxcCursorVisitor visitor, _In_opt_ void* context, _Out_opt_ BOOL* pVisitBroken) = 0;
+  /// <summary>Creates a cursor object for a value from the translation unit of this cursor.</summary>
+  virtual HRESULT STDMETHODCALLTYPE CreateCursor(
+    _In_ const DxcCursorValue* value, _Outptr_result_nullonfailure_ IDxcCursor** pResult) = 0;
+  /// <summary>Gets the file offsets of the extent of a value from the translation unit of this cursor.</summary>
+  virtual HRESULT STDMETHODCALLTYPE GetValueExtentOffsets(
+    _In_ const DxcCursorValue* value, _Out_ unsigned* startOffset, _Out_ unsigned* endOffset) = 0;
+};
+
 struct __declspec(uuid("4f76b234-3659-4d33-99b0-3b0db994b564"))
 IDxcDiagnostic : public IUnknown
 {
@@ -678,6 +752,37 @@ IDxcIndex : public IUnknown
       _Out_ IDxcTranslationUnit** pTranslationUnit) = 0;
 };
 
+// A translation unit being parsed on a background thread.
+struct __declspec(uuid("5d3a6c52-1b8e-4f0d-9c27-a84e6b1f03d9"))
+IDxcParseOperation : public IUnknown
+{
+  // Waits up to timeoutMs milliseconds (INFINITE to wait until done); returns S_OK
+  // once the operation has completed, failed or been cancelled, S_FALSE on timeout.
+  virtual HRESULT STDMETHODCALLTYPE Wait(unsigned timeoutMs) = 0;
+  // Requests cancellation; a parse that has not started is skipped, and the result
+  // of a parse in progress is discarded.
+  virtual HRESULT STDMETHODCALLTYPE Cancel() = 0;
+  virtual HRESULT STDMETHODCALLTYPE GetStatus(_Out_ DxcParseStatus* pStatus) = 0;
+  // Returns E_PENDING while the parse runs and E_ABORT when it was cancelled.
+  virtual HRESULT STDMETHODCALLTYPE GetResult(_Outptr_result_nullonfailure_ IDxcTranslationUnit** pTranslationUnit) = 0;
+};
+
+struct __declspec(uuid("2f6e1d8b-93a4-4c71-b5e0-7d19c4a8f256"))
+IDxcIndex2 : public IDxcIndex
+{
+  // Starts parsing on a background thread and returns immediately; the arguments
+  // and unsaved file contents are copied before the call returns. Parses on one
+  // index run one at a time, and a parse waiting for its turn may be cancelled.
+  virtual HRESULT STDMETHODCALLTYPE ParseTranslationUnitAsync(
+      _In_z_ const char *source_filename,
+      _In_count_(num_command_line_args) const char * const *command_line_args,
+      int num_command_line_args,
+      _In_count_(num_unsaved_files) IDxcUnsavedFile** unsaved_files,
+      unsigned num_unsaved_files,
+      DxcTranslationUnitFlags options,
+      _Outptr_result_nullonfailure_ IDxcParseOperation** pOperation) = 0;
+};
+
 struct __declspec(uuid("8e7ddf1c-d7d3-4d69-b286-85fccba1e0cf"))
 IDxcSourceLocation : public IUnknown
 {
@@ -741,6 +846,21 @@ IDxcTranslationUnit : public IUnknown
   virtual HRESULT STDMETHODCALLTYPE GetInclusionList(_Out_ unsigned* pResultCount, _Outptr_result_buffer_(*pResultCount) IDxcInclusion*** pResult) = 0;
 };
 
+struct __declspec(uuid("6b0f3e85-a9c4-4d27-8e1b-52d7c0a4f98e"))
+IDxcTranslationUnit2 : public IDxcTranslationUnit
+{
+  // Gets the completion candidates at a location of the main file, with the
+  // given unsaved files, whose names start with prefix (which may be null).
+  // The built-in intrinsics and object types are listed once per process
+  // rather than on each call.
+  virtual HRESULT STDMETHODCALLTYPE CodeCompleteAt(
+    unsigned line, unsigned column,
+    _In_count_(num_unsaved_files) IDxcUnsavedFile** unsaved_files,
+    unsigned num_unsaved_files,
+    _In_opt_z_ const char* prefix,
+    _Outptr_result_nullonfailure_ IDxcCompletionResults** pResult) = 0;
+};
+
 struct __declspec(uuid("2ec912fd-b144-4a15-ad0d-1c5439c81e46"))
 IDxcType : public IUnknown
 {
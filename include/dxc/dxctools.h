@@ -49,6 +49,30 @@ IDxcRewriter : public IUnknown {
 
 };
 
+static const UINT32 DxcRewriterBatchFlags_None = 0;
+static const UINT32 DxcRewriterBatchFlags_Union = 1; // Keep what any of the entry points reaches, in a single result.
+static const UINT32 DxcRewriterBatchFlags_ValidMask = 0x1;
+
+// Removes unused globals for many entry points of one source, which is
+// parsed only once. Available from the rewriter object through
+// QueryInterface.
+struct __declspec(uuid("2E9B7C41-5A0D-4F36-8B1C-7D4E3A6F9C02"))
+IDxcRewriter2 : public IDxcRewriter {
+
+  // ppResults receives one result per entry point, in order, each as
+  // RemoveUnusedGlobals would return it for that entry point. With
+  // DxcRewriterBatchFlags_Union, ppResults receives a single result that
+  // keeps what any of the entry points reaches.
+  virtual HRESULT STDMETHODCALLTYPE RemoveUnusedGlobalsBatch(_In_ IDxcBlobEncoding *pSource,
+                                                             _In_count_(entryPointCount) const LPCWSTR *pEntryPoints,
+                                                             _In_ UINT32 entryPointCount,
+                                                             _In_count_(defineCount) DxcDefine *pDefines,
+                                                             _In_ UINT32 defineCount,
+                                                             _In_ UINT32 batchFlags,
+                                                             _Out_writes_(entryPointCount) IDxcOperationResult **ppResults) = 0;
+
+};
+
 __declspec(selectany)
 extern const CLSID CLSID_DxcRewriter = { /* b489b951-e07f-40b3-968d-93e124734da4 */
   0xb489b951,
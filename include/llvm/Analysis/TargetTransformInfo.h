@@ -246,6 +246,9 @@ public:
     /// OptSizeThreshold, but used for partial/runtime unrolling (set to
     /// UINT_MAX to disable).
     unsigned PartialOptSizeThreshold;
+    /// The cost threshold for loops with an unroll(full) or unroll_count
+    /// pragma (set to UINT_MAX to disable).
+    unsigned PragmaThreshold; // HLSL Change
     /// A forced unrolling factor (the number of concatenated bodies of the
     /// original loop in the unrolled loop body). When set to 0, the unrolling
     /// transformation will select an unrolling factor based on the current cost
@@ -15,6 +15,7 @@
 #ifndef LLVM_BITCODE_BITSTREAMWRITER_H
 #define LLVM_BITCODE_BITSTREAMWRITER_H
 
+#include "llvm/ADT/ArrayRef.h" // HLSL Change
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/Bitcode/BitCodes.h"
@@ -245,6 +246,23 @@ public:
     BlockScope.pop_back();
   }
 
+  // HLSL Change Starts
+  /// AppendSubblock - Emit a block written by another writer. Body is the
+  /// block from its size word through its END_BLOCK, which is position
+  /// independent as both start word-aligned; only the header is emitted here.
+  void AppendSubblock(unsigned BlockID, unsigned CodeLen,
+                      ArrayRef<char> Body) {
+    assert(Body.size() >= 8 && (Body.size() & 3) == 0 && "Not a block body");
+    assert(support::endian::read32le(Body.data()) == Body.size() / 4 - 1 &&
+           "Block size does not match the body");
+    EmitCode(bitc::ENTER_SUBBLOCK);
+    EmitVBR(BlockID, bitc::BlockIDWidth);
+    EmitVBR(CodeLen, bitc::CodeLenWidth);
+    FlushToWord();
+    Out.append(Body.begin(), Body.end());
+  }
+  // HLSL Change Ends
+
   //===--------------------------------------------------------------------===//
   // Record Emission
   //===--------------------------------------------------------------------===//
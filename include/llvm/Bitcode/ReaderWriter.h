@@ -18,6 +18,7 @@
 #include "llvm/Support/Endian.h"
 #include "llvm/Support/ErrorOr.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include <functional> // HLSL Change
 #include <memory>
 #include <string>
 
@@ -69,6 +70,21 @@ namespace llvm {
   void WriteBitcodeToFile(const Module *M, raw_ostream &Out,
                           bool ShouldPreserveUseListOrder = false);
 
+  // HLSL Change Starts
+  /// \brief Runs Task for every index below Count, possibly concurrently,
+  /// and returns once all of them are done.
+  typedef std::function<void(unsigned Count,
+                             const std::function<void(unsigned)> &Task)>
+      BitcodeParallelForFn;
+
+  /// \brief Like WriteBitcodeToFile, but function bodies are written by up to
+  /// TaskCount tasks run through ParallelFor and then stitched in module
+  /// order. The output is the same as WriteBitcodeToFile's.
+  void WriteBitcodeToFile(const Module *M, raw_ostream &Out,
+                          bool ShouldPreserveUseListOrder, unsigned TaskCount,
+                          const BitcodeParallelForFn &ParallelFor);
+  // HLSL Change Ends
+
   /// isBitcodeWrapper - Return true if the given bytes are the magic bytes
   /// for an LLVM IR bitcode wrapper.
   ///
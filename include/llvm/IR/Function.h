@@ -83,7 +83,8 @@ private:
   enum {
     /// Whether this function is materializable.
     IsMaterializableBit = 1 << 0,
-    HasMetadataHashEntryBit = 1 << 1
+    HasMetadataHashEntryBit = 1 << 1,
+    IsDxilOpBit = 1 << 2 // HLSL Change
   };
   void setGlobalObjectBit(unsigned Mask, bool Value) {
     setGlobalObjectSubClassData((~Mask & getGlobalObjectSubClassData()) |
@@ -166,6 +167,20 @@ public:
   /// from Value::setName() whenever the name of this function changes.
   void recalculateIntrinsicID();
 
+  // HLSL Change Begin
+  /// isDxilOp - Return true if this function is a DXIL operation, that is,
+  /// if its name starts with "dx.op.". The result is computed when the
+  /// function is named, so this doesn't look at the name.
+  bool isDxilOp() const {
+    return getGlobalObjectSubClassData() & IsDxilOpBit;
+  }
+
+  /// \brief Recalculate whether this function is a DXIL operation. Like
+  /// recalculateIntrinsicID, this is called whenever the name of this
+  /// function changes.
+  void recalculateIsDxilOp();
+  // HLSL Change End
+
   /// getCallingConv()/setCallingConv(CC) - These method get and set the
   /// calling convention of this function.  The enum values for the known
   /// calling conventions are defined in CallingConv.h.
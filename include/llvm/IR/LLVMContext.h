@@ -169,6 +169,23 @@ public:
   void emitError(const Instruction *I, const Twine &ErrorStr);
   void emitError(const Twine &ErrorStr);
 
+  // HLSL Change Begin - context-owned data for HLSL libraries.
+  /// Base class for data that HLSL libraries attach to a context so that it
+  /// can be shared by every module created in it. The data is destroyed
+  /// along with the context.
+  class HLSLContextData {
+  public:
+    virtual ~HLSLContextData() {}
+  };
+
+  /// getHLSLContextData - Return the data set by setHLSLContextData, or null.
+  HLSLContextData *getHLSLContextData() const;
+
+  /// setHLSLContextData - Attach data to this context, destroying any data
+  /// previously attached. The context takes ownership of the pointer.
+  void setHLSLContextData(HLSLContextData *Data);
+  // HLSL Change End
+
   /// \brief Query for a debug option's value.
   ///
   /// This function returns typed data populated from command line parsing.
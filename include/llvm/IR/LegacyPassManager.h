@@ -30,6 +30,26 @@ namespace legacy {
 class PassManagerImpl;
 class FunctionPassManagerImpl;
 
+// HLSL Change Starts
+/// PassRunListener - Notified before and after every pass run by a pass
+/// manager, including passes run by the managers nested within it. Pass
+/// managers themselves are not reported.
+///
+/// A pass may also report named regions of its own work, found through
+/// Pass::getRunListener; regions nest within the pass that reports them.
+/// Long-running work checks in through checkpoint. The listener may throw
+/// from passStarted, regionStarted or checkpoint to abandon the run.
+class PassRunListener {
+public:
+  virtual ~PassRunListener() {}
+  virtual void passStarted(Pass *P) = 0;
+  virtual void passFinished(Pass *P) = 0;
+  virtual void regionStarted(const char *Name) {}
+  virtual void regionFinished(const char *Name) {}
+  virtual void checkpoint() {}
+};
+// HLSL Change Ends
+
 /// PassManagerBase - An abstract interface to allow code to add passes to
 /// a pass manager without having to hard-code what kind of pass manager
 /// it is.
@@ -45,6 +65,7 @@ public:
   virtual void add(Pass *P) = 0;
 
   raw_ostream *TrackPassOS = nullptr; // HLSL Change - add this field
+  PassRunListener *RunListener = nullptr; // HLSL Change - add this field
 };
 
 /// PassManager manages ModulePassManagers
@@ -98,6 +98,7 @@ namespace llvm {
   class Value;
   class Timer;
   class PMDataManager;
+  namespace legacy { class PassRunListener; } // HLSL Change
 
 // enums for debugging strings
 enum PassDebuggingString {
@@ -230,6 +231,9 @@ public:
   // Active Pass Managers
   PMStack activeStack;
 
+  // HLSL Change - listener for the passes run by this manager, if any.
+  legacy::PassRunListener *RunListener = nullptr;
+
 protected:
 
   /// Collection of pass managers
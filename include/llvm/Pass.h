@@ -47,6 +47,7 @@ class AnalysisResolver;
 class PMDataManager;
 class raw_ostream;
 class StringRef;
+namespace legacy { class PassRunListener; } // HLSL Change
 
 // AnalysisID - Use the PassInfo to identify a pass...
 typedef const void* AnalysisID;
@@ -181,6 +182,9 @@ public:
   void setResolver(AnalysisResolver *AR);
   AnalysisResolver *getResolver() const { return Resolver; }
 
+  // HLSL Change - run listener of the pass manager running this pass, if any.
+  legacy::PassRunListener *getRunListener() const;
+
   /// getAnalysisUsage - This function should be overriden by passes that need
   /// analysis information to do their job.  If a pass specifies that it uses a
   /// particular analysis result to this function, it can then use the
@@ -33,9 +33,14 @@ namespace llvm {
 
 class TargetMachine;
 
+// HLSL Change - passes initialize themselves every time they are created, so
+// the flag is read before trying to claim it; once set, threads creating
+// passes only read the flag rather than all writing the same cache line.
 #define CALL_ONCE_INITIALIZATION(function) \
   static volatile sys::cas_flag initialized = 0; \
-  sys::cas_flag old_val = sys::CompareAndSwap(&initialized, 1, 0); \
+  sys::cas_flag old_val = initialized; \
+  if (old_val != 2) \
+    old_val = sys::CompareAndSwap(&initialized, 1, 0); \
   if (old_val == 0) { \
     function(Registry); \
     sys::MemoryFence(); \
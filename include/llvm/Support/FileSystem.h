@@ -70,6 +70,7 @@ int msf_write(int fd, const void* buffer, unsigned int count) throw();
 int msf_close(int fd) throw();
 int msf_setmode(int fd, int mode) throw();
 long msf_lseek(int fd, long offset, int origin);
+bool msf_get_contents(int fd, const char **ppData, size_t *pSize, bool *pNullTerminated) throw();
 
 class AutoPerThreadSystem
 {
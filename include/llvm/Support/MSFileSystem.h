@@ -86,6 +86,15 @@ public:
   virtual errno_t resize_file(_In_ LPCWSTR path, uint64_t size) throw() = 0; // A number of C calls.
   virtual int Read(int fd, _Out_bytecap_(count) void* buffer, unsigned int count) throw() = 0;
   virtual int Write(int fd, _In_bytecount_(count) const void* buffer, unsigned int count) throw() = 0;
+
+  // Gets the contents of a file that the file system holds in memory, so
+  // they can be used without reading them through fd. The contents stay
+  // valid for as long as the file system. *pNullTerminated is set if a null
+  // character follows them. Returns false if the file must be read.
+  virtual bool GetFileContents(int fd, _Outptr_result_bytebuffer_(*pSize) const char **ppData,
+                               _Out_ size_t *pSize, _Out_ bool *pNullTerminated) throw() {
+    return false;
+  }
 };
 
 
@@ -127,6 +127,16 @@ public:
   bool MergeFunctions;
   bool PrepareForLTO;
   bool HLSLHighLevel = false; // HLSL Change
+  bool HLSLFastIteration = false; // HLSL Change
+  bool HLSLHoistHandles = false; // HLSL Change
+  bool HLSLHoistInvariantReads = false; // HLSL Change
+  bool HLSLSinkResourceReads = false; // HLSL Change
+  bool HLSLAnnotateUniform = false; // HLSL Change
+  bool HLSLDemotePrecision = false; // HLSL Change
+  bool HLSLRemoveRedundantBarriers = false; // HLSL Change
+  bool HLSLAggregateAtomics = false; // HLSL Change
+  bool HLSLOptimizeGroupSharedLayout = false; // HLSL Change
+  const char *HLSLProfileFile = nullptr; // HLSL Change - sample profile, must outlive the passes
   hlsl::HLSLExtensionsCodegenHelper *HLSLExtensionsCodeGen = nullptr; // HLSL Change
 
 private:
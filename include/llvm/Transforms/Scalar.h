@@ -147,6 +147,11 @@ void initializeMultiDimArrayToOneDimArrayPass(PassRegistry&);
 //
 ModulePass *createResourceToHandlePass();
 void initializeResourceToHandlePass(PassRegistry&);
+//===----------------------------------------------------------------------===//
+// ResourceToHandle and DynamicIndexingVectorToArray in one sweep.
+//
+ModulePass *createLowerResourceAndVectorTypesPass();
+void initializeLowerResourceAndVectorTypesPass(PassRegistry&);
 
 //===----------------------------------------------------------------------===//
 // Hoist a local array initialized with constant values to a global array with
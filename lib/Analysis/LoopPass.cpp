@@ -15,6 +15,7 @@
 
 #include "llvm/Analysis/LoopPass.h"
 #include "llvm/IR/IRPrintingPasses.h"
+#include "llvm/IR/LegacyPassManager.h" // HLSL Change
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/Timer.h"
@@ -244,6 +245,12 @@ bool LPPassManager::runOnFunction(Function &F) {
 
       initializeAnalysisImpl(P);
 
+      // HLSL Change Starts - loop passes aren't reported to the run listener,
+      // but may run many times over, so check in before each.
+      if (legacy::PassRunListener *L = TPM->RunListener)
+        L->checkpoint();
+      // HLSL Change Ends
+
       {
         PassManagerPrettyStackEntry X(P, *CurrentLoop->getHeader());
         TimeRegion PassTimer(getPassTimer(P));
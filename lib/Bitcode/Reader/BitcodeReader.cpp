@@ -64,6 +64,7 @@ public:
   // vector compatibility methods
   unsigned size() const { return ValuePtrs.size(); }
   void resize(unsigned N) { ValuePtrs.resize(N); }
+  void reserve(unsigned N) { ValuePtrs.reserve(N); } // HLSL Change
   void push_back(Value *V) { ValuePtrs.emplace_back(V); }
 
   void clear() {
@@ -109,6 +110,7 @@ public:
   // vector compatibility methods
   unsigned size() const       { return MDValuePtrs.size(); }
   void resize(unsigned N)     { MDValuePtrs.resize(N); }
+  void reserve(unsigned N)    { MDValuePtrs.reserve(N); } // HLSL Change
   void push_back(Metadata *MD) { MDValuePtrs.emplace_back(MD); }
   void clear()                { MDValuePtrs.clear();  }
   Metadata *back() const      { return MDValuePtrs.back(); }
@@ -217,6 +219,20 @@ class BitcodeReader : public GVMaterializer {
 
   bool StripDebugInfo = false;
 
+  // HLSL Change Starts
+  /// True if the module targets DXIL. DXIL is written by current tools only,
+  /// so the upgrades for older bitcode are skipped, and tables are sized from
+  /// the length of the blocks that fill them.
+  bool IsDxil = false;
+
+  /// Reserves room for the values of a block of NumWords words: every record
+  /// takes about a word, give or take abbreviations.
+  void reserveForBlock(unsigned NumWords) {
+    if (IsDxil)
+      ValueList.reserve(ValueList.size() + NumWords);
+  }
+  // HLSL Change Ends
+
 public:
   std::error_code error(BitcodeError E, const Twine &Message);
   std::error_code error(BitcodeError E);
@@ -1631,8 +1647,11 @@ std::error_code BitcodeReader::parseMetadata() {
   IsMetadataMaterialized = true;
   unsigned NextMDValueNo = MDValueList.size();
 
-  if (Stream.EnterSubBlock(bitc::METADATA_BLOCK_ID))
+  unsigned NumWords = 0; // HLSL Change
+  if (Stream.EnterSubBlock(bitc::METADATA_BLOCK_ID, &NumWords))
     return error("Invalid record");
+  if (IsDxil) // HLSL Change
+    MDValueList.reserve(MDValueList.size() + NumWords);
 
   SmallVector<uint64_t, 64> Record;
 
@@ -2190,8 +2209,10 @@ static APInt readWideAPInt(ArrayRef<uint64_t> Vals, unsigned TypeBits) {
 }
 
 std::error_code BitcodeReader::parseConstants() {
-  if (Stream.EnterSubBlock(bitc::CONSTANTS_BLOCK_ID))
+  unsigned NumWords = 0; // HLSL Change
+  if (Stream.EnterSubBlock(bitc::CONSTANTS_BLOCK_ID, &NumWords))
     return error("Invalid record");
+  reserveForBlock(NumWords); // HLSL Change
 
   SmallVector<uint64_t, 64> Record;
 
@@ -2772,6 +2793,8 @@ std::error_code BitcodeReader::globalCleanup() {
   if (!GlobalInits.empty() || !AliasInits.empty())
     return error("Malformed global initializer set");
 
+  // HLSL Change - DXIL has no intrinsics or globals from older versions.
+  if (!IsDxil) {
   // Look for intrinsic functions which need to be upgraded at some point
   for (Function &F : *TheModule) {
     Function *NewFn;
@@ -2782,6 +2805,7 @@ std::error_code BitcodeReader::globalCleanup() {
   // Look for global variables which need to be renamed.
   for (GlobalVariable &GV : TheModule->globals())
     UpgradeGlobalVariable(&GV);
+  } // HLSL Change
 
   // Force deallocation of memory for these vectors to favor the client that
   // want lazy deserialization.
@@ -2920,6 +2944,7 @@ std::error_code BitcodeReader::parseModule(bool Resume,
       if (convertToString(Record, 0, S))
         return error("Invalid record");
       TheModule->setTargetTriple(S);
+      IsDxil = StringRef(S).startswith("dxil"); // HLSL Change
       break;
     }
     case bitc::MODULE_CODE_DATALAYOUT: {  // DATALAYOUT: [strchr x N]
@@ -3388,8 +3413,10 @@ static std::error_code typeCheckLoadStoreInst(DiagnosticHandlerFunction DH,
 
 /// Lazily parse the specified function body block.
 std::error_code BitcodeReader::parseFunctionBody(Function *F) {
-  if (Stream.EnterSubBlock(bitc::FUNCTION_BLOCK_ID))
+  unsigned NumWords = 0; // HLSL Change
+  if (Stream.EnterSubBlock(bitc::FUNCTION_BLOCK_ID, &NumWords))
     return error("Invalid record");
+  reserveForBlock(F->arg_size() + NumWords); // HLSL Change
 
   InstructionList.clear();
   unsigned ModuleValueListSize = ValueList.size();
@@ -4631,6 +4658,9 @@ std::error_code BitcodeReader::materializeModule(Module *M) {
   for (unsigned I = 0, E = InstsWithTBAATag.size(); I < E; I++)
     UpgradeInstWithTBAATag(InstsWithTBAATag[I]);
 
+  // HLSL Change - without debug info, which is how DXIL usually ships, this
+  // would walk every instruction to strip nothing.
+  if (!IsDxil || M->getNamedMetadata("llvm.dbg.cu"))
   UpgradeDebugInfo(*M);
 
   // HLSL Change Starts
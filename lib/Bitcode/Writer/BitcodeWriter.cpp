@@ -30,6 +30,7 @@
 #include "llvm/Support/MathExtras.h"
 #include "llvm/Support/Program.h"
 #include "llvm/Support/raw_ostream.h"
+#include <algorithm> // HLSL Change
 #include <cctype>
 #include <map>
 using namespace llvm;
@@ -1160,6 +1161,30 @@ static void WriteDIImportedEntity(const DIImportedEntity *N,
   Record.clear();
 }
 
+// HLSL Change Starts
+// Strings made only of [a-zA-Z0-9._], such as DXIL resource, semantic and
+// metadata names, are written with 6 bits per character. Abbreviations are
+// defined in the stream, so readers need no change to decode them.
+static bool IsChar6String(StringRef Str) {
+  for (char C : Str)
+    if (!BitCodeAbbrevOp::isChar6(C))
+      return false;
+  return true;
+}
+
+static unsigned EmitStringAbbrev(BitstreamWriter &Stream, unsigned Code,
+                                 BitCodeAbbrevOp::Encoding CharEncoding) {
+  IntrusiveRefCntPtr<BitCodeAbbrev> Abbv = new BitCodeAbbrev();
+  Abbv->Add(BitCodeAbbrevOp(Code));
+  Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Array));
+  if (CharEncoding == BitCodeAbbrevOp::Char6)
+    Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Char6));
+  else
+    Abbv->Add(BitCodeAbbrevOp(CharEncoding, 8));
+  return Stream.EmitAbbrev(Abbv.get());
+}
+// HLSL Change Ends
+
 static void WriteModuleMetadata(const Module *M,
                                 const ValueEnumerator &VE,
                                 BitstreamWriter &Stream) {
@@ -1170,13 +1195,15 @@ static void WriteModuleMetadata(const Module *M,
   Stream.EnterSubblock(bitc::METADATA_BLOCK_ID, 3);
 
   unsigned MDSAbbrev = 0;
+  unsigned MDSChar6Abbrev = 0; // HLSL Change
   if (VE.hasMDString()) {
     // Abbrev for METADATA_STRING.
-    IntrusiveRefCntPtr<BitCodeAbbrev> Abbv = new BitCodeAbbrev();
-    Abbv->Add(BitCodeAbbrevOp(bitc::METADATA_STRING));
-    Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Array));
-    Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Fixed, 8));
-    MDSAbbrev = Stream.EmitAbbrev(Abbv.get());
+    // HLSL Change Starts
+    MDSAbbrev = EmitStringAbbrev(Stream, bitc::METADATA_STRING,
+                                 BitCodeAbbrevOp::Fixed);
+    MDSChar6Abbrev = EmitStringAbbrev(Stream, bitc::METADATA_STRING,
+                                      BitCodeAbbrevOp::Char6);
+    // HLSL Change Ends
   }
 
   // Initialize MDNode abbreviations.
@@ -1215,13 +1242,15 @@ static void WriteModuleMetadata(const Module *M,
   }
 
   unsigned NameAbbrev = 0;
+  unsigned NameChar6Abbrev = 0; // HLSL Change
   if (!M->named_metadata_empty()) {
     // Abbrev for METADATA_NAME.
-    IntrusiveRefCntPtr<BitCodeAbbrev> Abbv = new BitCodeAbbrev();
-    Abbv->Add(BitCodeAbbrevOp(bitc::METADATA_NAME));
-    Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Array));
-    Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Fixed, 8));
-    NameAbbrev = Stream.EmitAbbrev(Abbv.get());
+    // HLSL Change Starts
+    NameAbbrev = EmitStringAbbrev(Stream, bitc::METADATA_NAME,
+                                  BitCodeAbbrevOp::Fixed);
+    NameChar6Abbrev = EmitStringAbbrev(Stream, bitc::METADATA_NAME,
+                                       BitCodeAbbrevOp::Char6);
+    // HLSL Change Ends
   }
 
   SmallVector<uint64_t, 64> Record;
@@ -1248,7 +1277,9 @@ static void WriteModuleMetadata(const Module *M,
     Record.append(MDS->bytes_begin(), MDS->bytes_end());
 
     // Emit the finished record.
-    Stream.EmitRecord(bitc::METADATA_STRING, Record, MDSAbbrev);
+    Stream.EmitRecord(bitc::METADATA_STRING, Record,
+                      IsChar6String(MDS->getString()) ? MDSChar6Abbrev
+                                                      : MDSAbbrev); // HLSL Change
     Record.clear();
   }
 
@@ -1257,7 +1288,9 @@ static void WriteModuleMetadata(const Module *M,
     // Write name.
     StringRef Str = NMD.getName();
     Record.append(Str.bytes_begin(), Str.bytes_end());
-    Stream.EmitRecord(bitc::METADATA_NAME, Record, NameAbbrev);
+    Stream.EmitRecord(bitc::METADATA_NAME, Record,
+                      IsChar6String(Str) ? NameChar6Abbrev
+                                         : NameAbbrev); // HLSL Change
     Record.clear();
 
     // Write named metadata operands.
@@ -2348,9 +2381,81 @@ static void WriteBlockInfo(const ValueEnumerator &VE, BitstreamWriter &Stream) {
   Stream.ExitBlock();
 }
 
+// HLSL Change Starts
+static const size_t kMinFunctionsPerWriterTask = 4;
+
+/// WriteFunctionsInParallel - Emit the function bodies from several tasks.
+/// Function blocks refer to the module only through IDs and the BLOCKINFO
+/// abbreviations, so each task writes a contiguous range of them into its own
+/// buffer, with its own copy of the enumerator and of BLOCKINFO, and the
+/// blocks are then appended in module order. Returns false if there are too
+/// few functions to be worth it.
+static bool WriteFunctionsInParallel(const Module *M, ValueEnumerator &VE,
+                                     BitstreamWriter &Stream,
+                                     unsigned TaskCount,
+                                     const BitcodeParallelForFn &ParallelFor) {
+  std::vector<const Function *> Definitions;
+  for (const Function &F : *M)
+    if (!F.isDeclaration())
+      Definitions.push_back(&F);
+  TaskCount = std::min<size_t>(TaskCount,
+                               Definitions.size() / kMinFunctionsPerWriterTask);
+  if (TaskCount < 2)
+    return false;
+
+  // The use-list orders are stacked in function order; give each function
+  // its own stack, topped by the first one to write.
+  std::vector<UseListOrderStack> UseListOrders(Definitions.size());
+  if (VE.shouldPreserveUseListOrder()) {
+    for (size_t i = 0, e = Definitions.size(); i != e; ++i) {
+      UseListOrderStack &Orders = UseListOrders[i];
+      while (!VE.UseListOrders.empty() &&
+             VE.UseListOrders.back().F == Definitions[i]) {
+        Orders.push_back(std::move(VE.UseListOrders.back()));
+        VE.UseListOrders.pop_back();
+      }
+      std::reverse(Orders.begin(), Orders.end());
+    }
+  }
+
+  struct TaskOutput {
+    SmallVector<char, 0> Buffer;
+    std::vector<std::pair<size_t, size_t>> Blocks; // [begin, end) in Buffer.
+  };
+  std::vector<TaskOutput> Outputs(TaskCount);
+  ParallelFor(TaskCount, [&](unsigned Task) {
+    size_t Begin = Definitions.size() * Task / TaskCount;
+    size_t End = Definitions.size() * (Task + 1) / TaskCount;
+    ValueEnumerator TaskVE(VE);
+    TaskOutput &Output = Outputs[Task];
+    Output.Buffer.reserve(64 * 1024);
+    BitstreamWriter TaskStream(Output.Buffer);
+    // Only written to set up the abbreviations; dropped when appending.
+    WriteBlockInfo(TaskVE, TaskStream);
+    for (size_t i = Begin; i != End; ++i) {
+      TaskVE.UseListOrders = std::move(UseListOrders[i]);
+      size_t BlockBegin = Output.Buffer.size();
+      WriteFunction(*Definitions[i], TaskVE, TaskStream);
+      Output.Blocks.emplace_back(BlockBegin, Output.Buffer.size());
+    }
+  });
+
+  // The function block header takes one word at the top level of the task
+  // streams; the rest of each block is copied as is.
+  for (const TaskOutput &Output : Outputs)
+    for (const std::pair<size_t, size_t> &Block : Output.Blocks)
+      Stream.AppendSubblock(bitc::FUNCTION_BLOCK_ID, 4,
+                            makeArrayRef(Output.Buffer.data() + Block.first + 4,
+                                         Block.second - Block.first - 4));
+  return true;
+}
+// HLSL Change Ends
+
 /// WriteModule - Emit the specified module to the bitstream.
 static void WriteModule(const Module *M, BitstreamWriter &Stream,
-                        bool ShouldPreserveUseListOrder) {
+                        bool ShouldPreserveUseListOrder,
+                        unsigned TaskCount, // HLSL Change
+                        const BitcodeParallelForFn *ParallelFor) { // HLSL Change
   Stream.EnterSubblock(bitc::MODULE_BLOCK_ID, 3);
 
   SmallVector<unsigned, 1> Vals;
@@ -2396,6 +2501,10 @@ static void WriteModule(const Module *M, BitstreamWriter &Stream,
     WriteUseListBlock(nullptr, VE, Stream);
 
   // Emit function bodies.
+  // HLSL Change Starts
+  if (!ParallelFor ||
+      !WriteFunctionsInParallel(M, VE, Stream, TaskCount, *ParallelFor))
+  // HLSL Change Ends
   for (Module::const_iterator F = M->begin(), E = M->end(); F != E; ++F)
     if (!F->isDeclaration())
       WriteFunction(*F, VE, Stream);
@@ -2477,6 +2586,16 @@ static void EmitDarwinBCHeaderAndTrailer(SmallVectorImpl<char> &Buffer,
 /// stream.
 void llvm::WriteBitcodeToFile(const Module *M, raw_ostream &Out,
                               bool ShouldPreserveUseListOrder) {
+  // HLSL Change Starts
+  WriteBitcodeToFile(M, Out, ShouldPreserveUseListOrder, 1,
+                     BitcodeParallelForFn());
+}
+
+void llvm::WriteBitcodeToFile(const Module *M, raw_ostream &Out,
+                              bool ShouldPreserveUseListOrder,
+                              unsigned TaskCount,
+                              const BitcodeParallelForFn &ParallelFor) {
+  // HLSL Change Ends
   SmallVector<char, 0> Buffer;
   Buffer.reserve(256*1024);
 
@@ -2499,7 +2618,8 @@ void llvm::WriteBitcodeToFile(const Module *M, raw_ostream &Out,
     Stream.Emit(0xD, 4);
 
     // Emit the module.
-    WriteModule(M, Stream, ShouldPreserveUseListOrder);
+    WriteModule(M, Stream, ShouldPreserveUseListOrder, TaskCount, // HLSL Change
+                ParallelFor ? &ParallelFor : nullptr); // HLSL Change
   }
 
   if (TT.isOSDarwin())
@@ -397,6 +397,24 @@ ValueEnumerator::ValueEnumerator(const Module &M,
   OptimizeConstants(FirstConstant, Values.size());
 }
 
+// HLSL Change Starts
+ValueEnumerator::ValueEnumerator(const ValueEnumerator &VE)
+    : TypeMap(VE.TypeMap), Types(VE.Types), ValueMap(VE.ValueMap),
+      Values(VE.Values), Comdats(VE.Comdats), MDs(VE.MDs),
+      FunctionLocalMDs(VE.FunctionLocalMDs), MDValueMap(VE.MDValueMap),
+      HasMDString(VE.HasMDString), HasDILocation(VE.HasDILocation),
+      HasGenericDINode(VE.HasGenericDINode),
+      ShouldPreserveUseListOrder(VE.ShouldPreserveUseListOrder),
+      AttributeGroupMap(VE.AttributeGroupMap),
+      AttributeGroups(VE.AttributeGroups), AttributeMap(VE.AttributeMap),
+      Attribute(VE.Attribute), GlobalBasicBlockIDs(VE.GlobalBasicBlockIDs),
+      InstructionMap(VE.InstructionMap), InstructionCount(VE.InstructionCount),
+      BasicBlocks(VE.BasicBlocks), NumModuleValues(VE.NumModuleValues),
+      NumModuleMDs(VE.NumModuleMDs),
+      FirstFuncConstantID(VE.FirstFuncConstantID),
+      FirstInstID(VE.FirstInstID) {}
+// HLSL Change Ends
+
 unsigned ValueEnumerator::getInstructionID(const Instruction *Inst) const {
   InstructionMapType::const_iterator I = InstructionMap.find(Inst);
   assert(I != InstructionMap.end() && "Instruction is not mapped!");
@@ -100,10 +100,12 @@ private:
   unsigned FirstFuncConstantID;
   unsigned FirstInstID;
 
-  ValueEnumerator(const ValueEnumerator &) = delete;
   void operator=(const ValueEnumerator &) = delete;
 public:
   ValueEnumerator(const Module &M, bool ShouldPreserveUseListOrder);
+  // HLSL Change - copies all but the use-list orders, so that function bodies
+  // can be written concurrently, each from its own copy.
+  ValueEnumerator(const ValueEnumerator &VE);
 
   void dump() const;
   void print(raw_ostream &OS, const ValueMapType &Map, const char *Name) const;
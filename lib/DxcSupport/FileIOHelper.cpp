@@ -276,6 +276,75 @@ public:
   void ClearFreeFlag() { m_MallocFree = 0; }
 };
 
+// A read-only view of a whole file. The view stays mapped, and the file
+// cannot be modified, for as long as the blob is alive.
+class InternalDxcMappedBlobEncoding : public IDxcBlobEncoding {
+private:
+  DXC_MICROCOM_TM_REF_FIELDS()
+  HANDLE m_hMapping = nullptr;
+  LPCVOID m_pView = nullptr;
+  SIZE_T m_ViewSize = 0;
+  bool m_EncodingKnown = false;
+  UINT32 m_CodePage = 0;
+public:
+  DXC_MICROCOM_ADDREF_IMPL(m_dwRef)
+  ULONG STDMETHODCALLTYPE Release() {
+    // Because blobs are also used by tests and utilities, we avoid using TLS.
+    ULONG result = InterlockedDecrement(&m_dwRef);
+    if (result == 0) {
+      CComPtr<IMalloc> pTmp(m_pMalloc);
+      this->~InternalDxcMappedBlobEncoding();
+      pTmp->Free(this);
+    }
+    return result;
+  }
+  DXC_MICROCOM_TM_CTOR(InternalDxcMappedBlobEncoding)
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) {
+    return DoBasicQueryInterface<IDxcBlob, IDxcBlobEncoding>(this, iid, ppvObject);
+  }
+
+  ~InternalDxcMappedBlobEncoding() {
+    if (m_pView != nullptr) {
+      UnmapViewOfFile(m_pView);
+    }
+    if (m_hMapping != nullptr) {
+      CloseHandle(m_hMapping);
+    }
+  }
+
+  // Maps the file; the caller falls back to reading empty files, which
+  // cannot be mapped.
+  HRESULT Map(HANDLE hFile, SIZE_T fileSize) {
+    m_hMapping = CreateFileMappingW(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (m_hMapping == nullptr) {
+      return HRESULT_FROM_WIN32(GetLastError());
+    }
+    m_pView = MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, fileSize);
+    if (m_pView == nullptr) {
+      return HRESULT_FROM_WIN32(GetLastError());
+    }
+    m_ViewSize = fileSize;
+    return S_OK;
+  }
+
+  void SetEncoding(bool encodingKnown, UINT32 codePage) {
+    m_EncodingKnown = encodingKnown;
+    m_CodePage = codePage;
+  }
+
+  virtual LPVOID STDMETHODCALLTYPE GetBufferPointer(void) override {
+    return (LPVOID)m_pView;
+  }
+  virtual SIZE_T STDMETHODCALLTYPE GetBufferSize(void) override {
+    return m_ViewSize;
+  }
+  virtual HRESULT STDMETHODCALLTYPE GetEncoding(_Out_ BOOL *pKnown, _Out_ UINT32 *pCodePage) {
+    *pKnown = m_EncodingKnown ? TRUE : FALSE;
+    *pCodePage = m_CodePage;
+    return S_OK;
+  }
+};
+
 static HRESULT CodePageBufferToUtf16(UINT32 codePage, LPCVOID bufferPointer,
                                      SIZE_T bufferSize,
                                      CDxcMallocHeapPtr<WCHAR> &utf16NewCopy,
@@ -421,6 +490,45 @@ HRESULT DxcCreateBlobFromFile(LPCWSTR pFileName, UINT32 *pCodePage,
   return DxcCreateBlobFromFile(pMalloc, pFileName, pCodePage, ppBlobEncoding);
 }
 
+_Use_decl_annotations_
+HRESULT DxcCreateBlobFromFileMapped(LPCWSTR pFileName, UINT32 *pCodePage,
+                                    IDxcBlobEncoding **ppBlobEncoding) throw() {
+  if (pFileName == nullptr || ppBlobEncoding == nullptr) {
+    return E_POINTER;
+  }
+  *ppBlobEncoding = nullptr;
+
+  HANDLE hFile = CreateFileW(pFileName, GENERIC_READ, FILE_SHARE_READ, NULL,
+                             OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (hFile == INVALID_HANDLE_VALUE) {
+    return HRESULT_FROM_WIN32(GetLastError());
+  }
+  // The mapping keeps the file open once it has been created.
+  CHandle h(hFile);
+
+  LARGE_INTEGER FileSize;
+  if (!GetFileSizeEx(hFile, &FileSize)) {
+    return HRESULT_FROM_WIN32(GetLastError());
+  }
+  if ((ULONGLONG)FileSize.QuadPart > (ULONGLONG)(SIZE_T)-1) {
+    return DXC_E_INPUT_FILE_TOO_LARGE;
+  }
+  if (FileSize.QuadPart == 0) {
+    return DxcCreateBlobFromFile(pFileName, pCodePage, ppBlobEncoding);
+  }
+
+  CComPtr<IMalloc> pMalloc;
+  IFR(CoGetMalloc(1, &pMalloc));
+  CComPtr<InternalDxcMappedBlobEncoding> pMapped =
+      InternalDxcMappedBlobEncoding::Alloc(pMalloc);
+  IFROOM(pMapped.p);
+  IFR(pMapped->Map(hFile, (SIZE_T)FileSize.QuadPart));
+  pMapped->SetEncoding(pCodePage != nullptr,
+                       (pCodePage != nullptr) ? *pCodePage : 0);
+  *ppBlobEncoding = pMapped.Detach();
+  return S_OK;
+}
+
 _Use_decl_annotations_
 HRESULT
 DxcCreateBlobWithEncodingSet(IMalloc *pMalloc, IDxcBlob *pBlob, UINT32 codePage,
@@ -765,13 +873,31 @@ bool IsBlobNullOrEmpty(_In_opt_ IDxcBlob *pBlob) throw() {
 ///////////////////////////////////////////////////////////////////////////////
 // Stream implementations.
 
+// Memory stream that grows by appending segments, so data that was written is
+// never copied to make room. Small streams stay in the single head buffer;
+// once that reaches kMinSegmentSize, further data goes to segments about as
+// large as the stream so far. The data is made contiguous on demand: when a
+// pointer to it is requested, or it is read, resized or written anywhere but
+// at the end. A stream reserved to its final size up front never segments.
 class MemoryStream : public AbstractMemoryStream, public IDxcBlob {
 private:
+  // A segment's data follows its header, in one allocation from m_pMalloc.
+  struct Segment {
+    Segment *pNext;
+    SIZE_T Capacity;
+    SIZE_T Used;
+    LPBYTE Data() { return reinterpret_cast<LPBYTE>(this + 1); }
+  };
+  static const SIZE_T kMinSegmentSize = 64 * 1024;
+
   DXC_MICROCOM_TM_REF_FIELDS()
-  LPBYTE m_pMemory = nullptr;
-  ULONG m_offset = 0;
-  ULONG m_size = 0;
-  ULONG m_allocSize = 0;
+  LPBYTE m_pMemory = nullptr;   // Head buffer; all the data when contiguous.
+  SIZE_T m_allocSize = 0;       // Capacity of the head buffer.
+  SIZE_T m_headSize = 0;        // Bytes of data in the head buffer.
+  Segment *m_pFirstSegment = nullptr;
+  Segment *m_pLastSegment = nullptr;
+  SIZE_T m_offset = 0;
+  SIZE_T m_size = 0;            // m_headSize plus the bytes in segments.
 public:
   DXC_MICROCOM_ADDREF_IMPL(m_dwRef)
   ULONG STDMETHODCALLTYPE Release() {
@@ -796,63 +922,188 @@ public:
     Reset();
   }
 
-  HRESULT Grow(ULONG targetSize) {
-    if (targetSize < m_allocSize * 2) {
-      targetSize = m_allocSize * 2;
+  HRESULT ReallocHead(SIZE_T targetSize) {
+    if (m_pMemory == nullptr) {
+      m_pMemory = (LPBYTE)m_pMalloc->Alloc(targetSize);
+      if (m_pMemory == nullptr) {
+        return E_OUTOFMEMORY;
+      }
+    }
+    else {
+      void* newPtr = m_pMalloc->Realloc(m_pMemory, targetSize);
+      if (newPtr == nullptr) {
+        return E_OUTOFMEMORY;
+      }
+      m_pMemory = (LPBYTE)newPtr;
     }
 
-    return Reserve(targetSize);
+    m_allocSize = targetSize;
+
+    return S_OK;
+  }
+
+  HRESULT AppendSegment(SIZE_T minCapacity) {
+    SIZE_T capacity = std::max(minCapacity, std::max(m_size, kMinSegmentSize));
+    if (capacity > SIZE_MAX - sizeof(Segment)) {
+      return E_OUTOFMEMORY;
+    }
+    Segment *pSegment = (Segment *)m_pMalloc->Alloc(sizeof(Segment) + capacity);
+    if (pSegment == nullptr) {
+      return E_OUTOFMEMORY;
+    }
+    pSegment->pNext = nullptr;
+    pSegment->Capacity = capacity;
+    pSegment->Used = 0;
+    if (m_pLastSegment != nullptr) {
+      m_pLastSegment->pNext = pSegment;
+    }
+    else {
+      m_pFirstSegment = pSegment;
+    }
+    m_pLastSegment = pSegment;
+    return S_OK;
+  }
+
+  void FreeSegments() {
+    Segment *pSegment = m_pFirstSegment;
+    while (pSegment != nullptr) {
+      Segment *pNext = pSegment->pNext;
+      m_pMalloc->Free(pSegment);
+      pSegment = pNext;
+    }
+    m_pFirstSegment = nullptr;
+    m_pLastSegment = nullptr;
+  }
+
+  // Moves the data in segments to the end of the head buffer. The head is
+  // reallocated, which often extends it in place, and each segment is freed
+  // once copied, to keep the peak footprint down.
+  HRESULT Flatten() {
+    if (m_pFirstSegment == nullptr) {
+      return S_OK;
+    }
+    if (m_size > m_allocSize) {
+      HRESULT hr = ReallocHead(m_size);
+      if (FAILED(hr)) return hr;
+    }
+    while (m_pFirstSegment != nullptr) {
+      Segment *pSegment = m_pFirstSegment;
+      memcpy(m_pMemory + m_headSize, pSegment->Data(), pSegment->Used);
+      m_headSize += pSegment->Used;
+      m_pFirstSegment = pSegment->pNext;
+      m_pMalloc->Free(pSegment);
+    }
+    m_pLastSegment = nullptr;
+    DXASSERT_NOMSG(m_headSize == m_size);
+    return S_OK;
+  }
+
+  // Writes at the end of the stream.
+  HRESULT Append(const BYTE *pData, SIZE_T cb) {
+    if (cb > SIZE_MAX - m_size) {
+      return E_OUTOFMEMORY;
+    }
+    if (m_pFirstSegment == nullptr) {
+      if (cb > m_allocSize - m_headSize) {
+        if (m_headSize + cb > kMinSegmentSize && m_pMemory != nullptr) {
+          // Fill the head buffer, and continue in segments.
+          SIZE_T cbHead = m_allocSize - m_headSize;
+          memcpy(m_pMemory + m_headSize, pData, cbHead);
+          m_headSize += cbHead;
+          m_size = m_headSize;
+          pData += cbHead;
+          cb -= cbHead;
+          return AppendToSegments(pData, cb);
+        }
+        // Grow the head buffer by doubling while it is small.
+        HRESULT hr = ReallocHead(std::max(
+            m_headSize + cb, std::min(m_allocSize * 2, kMinSegmentSize)));
+        if (FAILED(hr)) return hr;
+      }
+      memcpy(m_pMemory + m_headSize, pData, cb);
+      m_headSize += cb;
+      m_size = m_headSize;
+      return S_OK;
+    }
+    return AppendToSegments(pData, cb);
+  }
+
+  HRESULT AppendToSegments(const BYTE *pData, SIZE_T cb) {
+    SIZE_T room = m_pLastSegment ? m_pLastSegment->Capacity - m_pLastSegment->Used : 0;
+    if (cb > room) {
+      if (room != 0) {
+        memcpy(m_pLastSegment->Data() + m_pLastSegment->Used, pData, room);
+        m_pLastSegment->Used += room;
+        m_size += room;
+        pData += room;
+        cb -= room;
+      }
+      HRESULT hr = AppendSegment(cb);
+      if (FAILED(hr)) return hr;
+    }
+    memcpy(m_pLastSegment->Data() + m_pLastSegment->Used, pData, cb);
+    m_pLastSegment->Used += cb;
+    m_size += cb;
+    return S_OK;
   }
 
   void Reset() {
+    FreeSegments();
     if (m_pMemory != nullptr) {
       m_pMalloc->Free(m_pMemory);
     }
     m_pMemory = nullptr;
     m_offset = 0;
     m_size = 0;
+    m_headSize = 0;
     m_allocSize = 0;
   }
 
   // AbstractMemoryStream implementation.
   __override LPBYTE GetPtr() {
+    if (FAILED(Flatten())) {
+      return nullptr;
+    }
     return m_pMemory;
   }
 
   __override ULONG GetPtrSize() {
-    return m_size;
+    DXASSERT(m_size <= ULONG_MAX, "else caller should use GetBufferSize");
+    return (ULONG)m_size;
   }
 
   __override LPBYTE Detach() {
+    if (FAILED(Flatten())) {
+      return nullptr;
+    }
     LPBYTE result = m_pMemory;
     m_pMemory = nullptr;
     Reset();
     return result;
   }
 
-  __override HRESULT Reserve(ULONG targetSize) {
-    if (m_pMemory == nullptr) {
-      m_pMemory = (LPBYTE)m_pMalloc->Alloc(targetSize);
-      if (m_pMemory == nullptr) {
-        return E_OUTOFMEMORY;
-      }
+  // Makes room for the stream to reach targetSize bytes without further
+  // allocations; a hint of the final size. Never shrinks the stream.
+  __override HRESULT Reserve(UINT64 targetSize) {
+    if (targetSize > SIZE_MAX) {
+      return E_OUTOFMEMORY;
     }
-    else {
-      void* newPtr = m_pMalloc->Realloc(m_pMemory, targetSize);
-      if (newPtr == nullptr) {
-        return E_OUTOFMEMORY;
+    if (m_pFirstSegment == nullptr) {
+      if (targetSize <= m_allocSize) {
+        return S_OK;
       }
-      m_pMemory = (LPBYTE)newPtr;
+      return ReallocHead((SIZE_T)targetSize);
     }
-
-    m_allocSize = targetSize;
-
-    return S_OK;
+    SIZE_T room = m_pLastSegment->Capacity - m_pLastSegment->Used;
+    if (targetSize <= m_size + room) {
+      return S_OK;
+    }
+    return AppendSegment((SIZE_T)targetSize - m_size);
   }
 
   // IDxcBlob implementation. Requires no further writes.
   __override LPVOID STDMETHODCALLTYPE GetBufferPointer(void) {
-    return m_pMemory;
+    return GetPtr();
   }
   __override SIZE_T STDMETHODCALLTYPE GetBufferSize(void) {
     return m_size;
@@ -869,8 +1120,10 @@ public:
       *pcbRead = 0;
       return S_FALSE;
     }
-    ULONG cbLeft = m_size - m_offset;
-    *pcbRead = std::min(cb, cbLeft);
+    HRESULT hr = Flatten();
+    if (FAILED(hr)) return hr;
+    SIZE_T cbLeft = m_size - m_offset;
+    *pcbRead = (ULONG)std::min((SIZE_T)cb, cbLeft);
     memcpy(pv, m_pMemory + m_offset, *pcbRead);
     m_offset += *pcbRead;
     return (*pcbRead == cb) ? S_OK : S_FALSE;
@@ -878,37 +1131,52 @@ public:
 
   __override HRESULT STDMETHODCALLTYPE Write(void const* pv, ULONG cb, ULONG* pcbWritten) {
     if (!pv || !pcbWritten) return E_POINTER;
+    if (m_offset == m_size) {
+      HRESULT hr = Append((const BYTE *)pv, cb);
+      if (FAILED(hr)) return hr;
+      m_offset = m_size;
+      *pcbWritten = cb;
+      return S_OK;
+    }
+
+    // Overwriting, or writing past the end, works on contiguous data.
+    HRESULT hr = Flatten();
+    if (FAILED(hr)) return hr;
+    if (cb > SIZE_MAX - m_offset) return E_OUTOFMEMORY;
     if (cb + m_offset > m_allocSize) {
-      HRESULT hr = Grow(cb + m_offset);
+      hr = ReallocHead(std::max(cb + m_offset, m_allocSize * 2));
       if (FAILED(hr)) return hr;
-      // Implicitly extend as needed with zeroes.
-      if (m_offset > m_size) {
-        memset(m_pMemory + m_size, 0, m_offset - m_size);
-      }
+    }
+    // Implicitly extend as needed with zeroes.
+    if (m_offset > m_size) {
+      memset(m_pMemory + m_size, 0, m_offset - m_size);
     }
     *pcbWritten = cb;
     memcpy(m_pMemory + m_offset, pv, cb);
     m_offset += cb;
     m_size = std::max(m_size, m_offset);
+    m_headSize = m_size;
     return S_OK;
   }
 
   // IStream implementation.
   __override HRESULT STDMETHODCALLTYPE SetSize(ULARGE_INTEGER val) {
-    if (val.HighPart != 0) {
+    if (val.QuadPart > SIZE_MAX) {
       return E_OUTOFMEMORY;
     }
-    if (val.LowPart > m_allocSize) {
-      return Grow(m_allocSize);
-    }
-    if (val.LowPart < m_size) {
-      m_size = val.LowPart;
-      m_offset = std::min(m_offset, m_size);
+    SIZE_T newSize = (SIZE_T)val.QuadPart;
+    HRESULT hr = Flatten();
+    if (FAILED(hr)) return hr;
+    if (newSize > m_allocSize) {
+      hr = ReallocHead(newSize);
+      if (FAILED(hr)) return hr;
     }
-    else if (val.LowPart > m_size) {
-      memset(m_pMemory + m_size, 0, val.LowPart - m_size);
-      m_size = val.LowPart;
+    if (newSize > m_size) {
+      memset(m_pMemory + m_size, 0, newSize - m_size);
     }
+    m_size = newSize;
+    m_headSize = newSize;
+    m_offset = std::min(m_offset, m_size);
     return S_OK;
   }
 
@@ -941,29 +1209,28 @@ public:
       lpNewFilePointer->QuadPart = 0;
     }
 
-    if (liDistanceToMove.HighPart != 0) {
-      return E_FAIL;
-    }
-
-    ULONG targetOffset;
-
+    LONGLONG base;
     switch (dwOrigin) {
     case STREAM_SEEK_SET:
-      targetOffset = liDistanceToMove.LowPart;
+      base = 0;
       break;
     case STREAM_SEEK_CUR:
-      targetOffset = liDistanceToMove.LowPart + m_offset;
+      base = (LONGLONG)m_offset;
       break;
     case STREAM_SEEK_END:
-      targetOffset = liDistanceToMove.LowPart + m_size;
+      base = (LONGLONG)m_size;
       break;
     default:
       return STG_E_INVALIDFUNCTION;
     }
 
-    m_offset = targetOffset;
+    LONGLONG targetOffset = base + liDistanceToMove.QuadPart;
+    if (targetOffset < 0 || (ULONGLONG)targetOffset > SIZE_MAX) {
+      return STG_E_INVALIDFUNCTION;
+    }
+    m_offset = (SIZE_T)targetOffset;
     if (lpNewFilePointer != nullptr) {
-      lpNewFilePointer->LowPart = targetOffset;
+      lpNewFilePointer->QuadPart = targetOffset;
     }
     return S_OK;
   }
@@ -975,7 +1242,7 @@ public:
     }
     ZeroMemory(pStatstg, sizeof(*pStatstg));
     pStatstg->type = STGTY_STREAM;
-    pStatstg->cbSize.LowPart = m_size;
+    pStatstg->cbSize.QuadPart = m_size;
     return S_OK;
   }
 };
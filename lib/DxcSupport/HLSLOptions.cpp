@@ -157,12 +157,16 @@ MainArgs::MainArgs(llvm::ArrayRef<llvm::StringRef> args) {
 }
 
 MainArgs& MainArgs::operator=(const MainArgs &other) {
-  Utf8StringVector.clear();
+  if (this == &other)
+    return *this;
+  // Pointers are taken once every string is in place, as growing the string
+  // vector moves the strings and may move their characters too.
+  Utf8StringVector.assign(other.Utf8StringVector.begin(),
+                          other.Utf8StringVector.end());
   Utf8CharPtrVector.clear();
-  for (const std::string &str : other.Utf8StringVector) {
-    Utf8StringVector.emplace_back(str);
-    Utf8CharPtrVector.push_back(Utf8StringVector.back().data());
-  }
+  Utf8CharPtrVector.reserve(Utf8StringVector.size());
+  for (const std::string &str : Utf8StringVector)
+    Utf8CharPtrVector.push_back(str.data());
   return *this;
 }
 
@@ -268,10 +272,12 @@ int ReadDxcOpts(const OptTable *optionTable, unsigned flagsToInclude,
   // AssemblyCodeHex not supported (Fx)
   // OutputLibrary not supported (Fl)
   opts.AssemblyCode = Args.getLastArgValue(OPT_Fc);
+  opts.CostReportFile = Args.getLastArgValue(OPT_Fcost);
   opts.DebugFile = Args.getLastArgValue(OPT_Fd);
   opts.ExtractPrivateFile = Args.getLastArgValue(OPT_getprivate);
   opts.NoMinPrecision = Args.hasFlag(OPT_no_min_precision, OPT_INVALID, false);
   opts.OutputObject = Args.getLastArgValue(OPT_Fo);
+  opts.OutputBundle = Args.getLastArgValue(OPT_Fbundle);
   opts.OutputHeader = Args.getLastArgValue(OPT_Fh);
   opts.OutputWarningsFile = Args.getLastArgValue(OPT_Fe);
   opts.UseColor = Args.hasFlag(OPT_Cc, OPT_INVALID);
@@ -302,6 +308,31 @@ int ReadDxcOpts(const OptTable *optionTable, unsigned flagsToInclude,
   opts.IEEEStrict = Args.hasFlag(OPT_Gis, OPT_INVALID, false);
 
   opts.IgnoreLineDirectives = Args.hasFlag(OPT_ignore_line_directives, OPT_INVALID, false);
+  opts.CompileCache = Args.hasFlag(OPT_compile_cache, OPT_INVALID, false);
+  opts.HLCache = Args.hasFlag(OPT_hl_cache, OPT_INVALID, false);
+  opts.ContainerCache = Args.hasFlag(OPT_container_cache, OPT_INVALID, false);
+  opts.Incremental = Args.hasFlag(OPT_incremental, OPT_INVALID, false);
+  opts.ArenaAlloc = Args.hasFlag(OPT_arena_alloc, OPT_INVALID, false);
+  opts.IncludeCache = Args.hasFlag(OPT_include_cache, OPT_INVALID, false);
+  opts.ReportPhases = Args.hasFlag(OPT_report_phases, OPT_INVALID, false);
+  opts.DiagRecords = Args.hasFlag(OPT_diag_records, OPT_INVALID, false);
+  opts.ReportIncludes = Args.hasFlag(OPT_report_includes, OPT_INVALID, false);
+  opts.ScanDependencies = Args.hasFlag(OPT_scan_deps, OPT_INVALID, false);
+  opts.Preprocessed = Args.hasFlag(OPT_preprocessed, OPT_INVALID, false);
+  opts.CompileTimeout = 0;
+  llvm::StringRef timeout = Args.getLastArgValue(OPT_compile_timeout);
+  if (!timeout.empty() && timeout.getAsInteger(10, opts.CompileTimeout)) {
+    errors << "Unsupported value '" << timeout << "' for compile-timeout.";
+    return 1;
+  }
+  opts.CompileMemoryLimit = 0;
+  llvm::StringRef memoryLimit = Args.getLastArgValue(OPT_compile_memory_limit);
+  if (!memoryLimit.empty() &&
+      memoryLimit.getAsInteger(10, opts.CompileMemoryLimit)) {
+    errors << "Unsupported value '" << memoryLimit
+           << "' for compile-memory-limit.";
+    return 1;
+  }
 
   opts.FPDenormalMode = Args.getLastArgValue(OPT_denorm);
   // Check if a given denormalized value is valid
@@ -342,9 +373,18 @@ int ReadDxcOpts(const OptTable *optionTable, unsigned flagsToInclude,
   opts.OptDump = Args.hasFlag(OPT_Odump, OPT_INVALID, false);
 
   opts.DisableOptimizations = Args.hasFlag(OPT_Od, OPT_INVALID, false);
+  opts.FastIteration = Args.hasFlag(OPT_fast_iteration, OPT_INVALID, false);
+  if (opts.FastIteration)
+    opts.DisableOptimizations = true;
   if (opts.DisableOptimizations)
     opts.OptLevel = 0;
 
+  opts.ProfileUseFile = Args.getLastArgValue(OPT_profile_use);
+  if (!opts.ProfileUseFile.empty() && !opts.DebugInfo) {
+    errors << "Profile-guided optimization requires debug information (/Zi).";
+    return 1;
+  }
+
   opts.DisableValidation = Args.hasFlag(OPT_VD, OPT_INVALID, false);
 
   opts.AllResourcesBound = Args.hasFlag(OPT_all_resources_bound, OPT_INVALID, false);
@@ -352,7 +392,30 @@ int ReadDxcOpts(const OptTable *optionTable, unsigned flagsToInclude,
   opts.DefaultRowMajor = Args.hasFlag(OPT_Zpr, OPT_INVALID, false);
   opts.DefaultColMajor = Args.hasFlag(OPT_Zpc, OPT_INVALID, false);
   opts.DumpBin = Args.hasFlag(OPT_dumpbin, OPT_INVALID, false);
+  opts.FromBundle = Args.hasFlag(OPT_from_bundle, OPT_INVALID, false);
+  opts.Server = Args.hasFlag(OPT_server, OPT_INVALID, false);
   opts.NotUseLegacyCBufLoad = Args.hasFlag(OPT_not_use_legacy_cbuf_load, OPT_INVALID, false);
+  opts.MergeBufferAccess = Args.hasFlag(OPT_merge_buffer_access, OPT_INVALID, false);
+  opts.HoistHandles = Args.hasFlag(OPT_hoist_handles, OPT_INVALID, false);
+  opts.HoistInvariantReads = Args.hasFlag(OPT_hoist_invariant_reads, OPT_INVALID, false);
+  opts.SinkResourceReads = Args.hasFlag(OPT_sink_resource_reads, OPT_INVALID, false);
+  opts.UnrollBudget = 0;
+  llvm::StringRef unrollBudget = Args.getLastArgValue(OPT_unroll_budget);
+  if (!unrollBudget.empty() &&
+      unrollBudget.getAsInteger(10, opts.UnrollBudget)) {
+    errors << "Unsupported value '" << unrollBudget << "' for unroll-budget.";
+    return 1;
+  }
+  opts.AnnotateUniform = Args.hasFlag(OPT_annotate_uniform, OPT_INVALID, false);
+  opts.OptimizeGroupSharedLayout = Args.hasFlag(OPT_optimize_groupshared_layout, OPT_INVALID, false);
+  opts.OptimizeCBufferLayout = Args.hasFlag(OPT_optimize_cbuffer_layout, OPT_INVALID, false);
+  opts.MergeFunctions = Args.hasFlag(OPT_merge_functions, OPT_INVALID, false);
+  opts.LazyFunctionBodies = Args.hasFlag(OPT_lazy_function_bodies, OPT_INVALID, false);
+  opts.StreamCodeGen = Args.hasFlag(OPT_stream_codegen, OPT_INVALID, false);
+  opts.DemotePrecision = Args.hasFlag(OPT_demote_precision, OPT_INVALID, false);
+  opts.RemoveRedundantBarriers = Args.hasFlag(OPT_remove_redundant_barriers, OPT_INVALID, false);
+  opts.AggregateAtomics = Args.hasFlag(OPT_aggregate_atomics, OPT_INVALID, false);
+  opts.PackedTypeAnnotations = Args.hasFlag(OPT_packed_type_annotations, OPT_INVALID, false);
   opts.PackPrefixStable = Args.hasFlag(OPT_pack_prefix_stable, OPT_INVALID, false);
   opts.PackOptimized = Args.hasFlag(OPT_pack_optimized, OPT_INVALID, false);
   opts.DisplayIncludeProcess = Args.hasFlag(OPT_H, OPT_INVALID, false);
@@ -361,6 +424,7 @@ int ReadDxcOpts(const OptTable *optionTable, unsigned flagsToInclude,
   opts.PreferFlowControl = Args.hasFlag(OPT_Gfp, OPT_INVALID, false);
   opts.RecompileFromBinary = Args.hasFlag(OPT_recompile, OPT_INVALID, false);
   opts.StripDebug = Args.hasFlag(OPT_Qstrip_debug, OPT_INVALID, false);
+  opts.CompressDebug = Args.hasFlag(OPT_Qcompress_debug, OPT_INVALID, false);
   opts.StripRootSignature = Args.hasFlag(OPT_Qstrip_rootsignature, OPT_INVALID, false);
   opts.StripPrivate = Args.hasFlag(OPT_Qstrip_priv, OPT_INVALID, false);
   opts.StripReflection = Args.hasFlag(OPT_Qstrip_reflect, OPT_INVALID, false);
@@ -382,6 +446,10 @@ int ReadDxcOpts(const OptTable *optionTable, unsigned flagsToInclude,
     errors << "Cannot specify /pack_prefix_stable and /pack_optimized together, use /? to get usage information";
     return 1;
   }
+  if (opts.Preprocessed && !opts.RootSignatureDefine.empty()) {
+    errors << "Cannot specify /rootsig-define for preprocessed source, macros are not available";
+    return 1;
+  }
   // TODO: more fxc option check.
   // ERR_RES_MAY_ALIAS_ONLY_IN_CS_5
   // ERR_NOT_ABLE_TO_FLATTEN on if that contain side effects
@@ -392,7 +460,7 @@ int ReadDxcOpts(const OptTable *optionTable, unsigned flagsToInclude,
   // ERR_TEMPLATE_VAR_CONFLICT
   // ERR_ATTRIBUTE_PARAM_SIDE_EFFECT
 
-  if ((flagsToInclude & hlsl::options::DriverOption) && opts.InputFile.empty()) {
+  if ((flagsToInclude & hlsl::options::DriverOption) && opts.InputFile.empty() && !opts.Server) {
     // Input file is required in arguments only for drivers; APIs take this through an argument.
     errors << "Required input file argument is missing. use -help to get more information.";
     return 1;
@@ -425,8 +493,23 @@ int ReadDxcOpts(const OptTable *optionTable, unsigned flagsToInclude,
     }
   }
 
+  if (opts.FromBundle) {
+    // The bundle holds the whole compile request.
+    if (!opts.OutputBundle.empty() || !opts.Preprocess.empty() ||
+        opts.DumpBin || opts.RecompileFromBinary) {
+      errors << "Cannot specify /from-bundle with /Fbundle, /P, /dumpbin or /recompile.";
+      return 1;
+    }
+    if (opts.Defines.size() != 0 || !opts.EntryPoint.empty() ||
+        !opts.TargetProfile.empty()) {
+      errors << "Cannot specify compilation options when compiling a bundle.";
+      return 1;
+    }
+  }
+
   if ((flagsToInclude & hlsl::options::DriverOption) &&
-      opts.TargetProfile.empty() && !opts.DumpBin && opts.Preprocess.empty() && !opts.RecompileFromBinary) {
+      opts.TargetProfile.empty() && !opts.DumpBin && opts.Preprocess.empty() && !opts.RecompileFromBinary &&
+      !opts.Server && !opts.FromBundle) {
     // Target profile is required in arguments only for drivers when compiling;
     // APIs take this through an argument.
     errors << "Target profile argument is missing";
@@ -450,8 +533,11 @@ int ReadDxcOpts(const OptTable *optionTable, unsigned flagsToInclude,
            << opts.VkStageIoOrder;
     return 1;
   }
+  opts.VkGroupDecorations =
+      Args.hasFlag(OPT_fvk_group_decorations, OPT_INVALID, false);
 #else
   if (Args.hasFlag(OPT_spirv, OPT_INVALID, false) ||
+      Args.hasFlag(OPT_fvk_group_decorations, OPT_INVALID, false) ||
       !Args.getLastArgValue(OPT_fvk_stage_io_order_EQ).empty()) {
     errors << "SPIR-V CodeGen not available. "
               "Please recompile with -DENABLE_SPIRV_CODEGEN=ON.";
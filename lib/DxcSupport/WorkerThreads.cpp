@@ -0,0 +1,55 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// WorkerThreads.cpp                                                         //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Provides the thread counts for steps that run on worker threads.          //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/Support/WorkerThreads.h"
+#include "llvm/Support/Compiler.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+using namespace hlsl;
+
+static LLVM_THREAD_LOCAL bool g_IsWorkerThread;
+// Threads started by all the steps in the process, besides their own.
+static std::atomic<unsigned> g_ReservedThreads(0);
+
+static unsigned GetExtraThreadBudget() {
+  static const unsigned Budget =
+      std::max(std::thread::hardware_concurrency(), 1u) - 1;
+  return Budget;
+}
+
+WorkerThreadReservation::WorkerThreadReservation(unsigned TaskCount)
+    : m_threadCount(1) {
+  if (g_IsWorkerThread || TaskCount < 2)
+    return;
+  const unsigned Budget = GetExtraThreadBudget();
+  unsigned Reserved = g_ReservedThreads.load();
+  unsigned Extra;
+  do {
+    if (Reserved >= Budget)
+      return;
+    Extra = std::min(TaskCount - 1, Budget - Reserved);
+  } while (!g_ReservedThreads.compare_exchange_weak(Reserved,
+                                                    Reserved + Extra));
+  m_threadCount = 1 + Extra;
+}
+
+WorkerThreadReservation::~WorkerThreadReservation() {
+  if (m_threadCount > 1)
+    g_ReservedThreads -= m_threadCount - 1;
+}
+
+WorkerThreadScope::WorkerThreadScope() : m_wasWorker(g_IsWorkerThread) {
+  g_IsWorkerThread = true;
+}
+
+WorkerThreadScope::~WorkerThreadScope() { g_IsWorkerThread = m_wasWorker; }
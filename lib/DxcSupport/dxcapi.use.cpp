@@ -13,6 +13,13 @@
 #include "dxc/Support/dxcapi.use.h"
 #include "dxc/Support/Global.h"
 #include "dxc/Support/Unicode.h"
+#include "dxc/Support/FileIOHelper.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+
+using namespace llvm;
 
 namespace dxc {
 
@@ -68,6 +75,81 @@ void ReadFileIntoBlob(DxcDllSupport &dxcSupport, _In_ LPCWSTR pFileName,
            pFileName);
 }
 
+void ReadFileIntoBlobMapped(_In_ LPCWSTR pFileName,
+                            _Outptr_ IDxcBlobEncoding **ppBlobEncoding) {
+  IFT_Data(hlsl::DxcCreateBlobFromFileMapped(pFileName, nullptr, ppBlobEncoding),
+           pFileName);
+}
+
+// Matches a file name against a pattern with * and ? wildcards, ignoring case
+// as Windows does.
+static bool MatchWildcard(StringRef Pattern, StringRef Name) {
+  size_t p = 0, n = 0, star = StringRef::npos, mark = 0;
+  while (n < Name.size()) {
+    if (p < Pattern.size() &&
+        (Pattern[p] == '?' || tolower(Pattern[p]) == tolower(Name[n]))) {
+      ++p;
+      ++n;
+    } else if (p < Pattern.size() && Pattern[p] == '*') {
+      star = p++;
+      mark = n;
+    } else if (star != StringRef::npos) {
+      p = star + 1;
+      n = ++mark;
+    } else {
+      return false;
+    }
+  }
+  while (p < Pattern.size() && Pattern[p] == '*')
+    ++p;
+  return p == Pattern.size();
+}
+
+// Wildcards are only expanded in the file name, not in directory names.
+void ExpandInputPath(const std::string &Input,
+                     std::vector<std::string> &Paths) {
+  StringRef Name = sys::path::filename(Input);
+  std::error_code EC;
+  if (Name.find_first_of("*?") != StringRef::npos) {
+    std::string Dir = sys::path::parent_path(Input);
+    if (Dir.empty())
+      Dir = ".";
+    for (sys::fs::directory_iterator I(Dir, EC), E; I != E && !EC;
+         I.increment(EC)) {
+      if (MatchWildcard(Name, sys::path::filename(I->path())) &&
+          !sys::fs::is_directory(I->path()))
+        Paths.push_back(I->path());
+    }
+    IFTLLVM(EC);
+    return;
+  }
+  if (!sys::fs::is_directory(Input)) {
+    Paths.push_back(Input);
+    return;
+  }
+  for (sys::fs::recursive_directory_iterator I(Input, EC), E; I != E && !EC;
+       I.increment(EC)) {
+    if (!sys::fs::is_directory(I->path()))
+      Paths.push_back(I->path());
+  }
+  IFTLLVM(EC);
+}
+
+void ReadInputPathList(DxcDllSupport &dxcSupport, _In_ LPCWSTR pListFile,
+                       std::vector<std::string> &Paths) {
+  CComPtr<IDxcBlobEncoding> pList;
+  ReadFileIntoBlob(dxcSupport, pListFile, &pList);
+  StringRef Text((const char *)pList->GetBufferPointer(),
+                 pList->GetBufferSize());
+  SmallVector<StringRef, 64> Lines;
+  Text.split(Lines, "\n", -1, false);
+  for (StringRef Line : Lines) {
+    Line = Line.trim();
+    if (!Line.empty() && !Line.startswith("#"))
+      ExpandInputPath(Line, Paths);
+  }
+}
+
 void WriteOperationErrorsToConsole(_In_ IDxcOperationResult *pResult,
                                    bool outputWarnings) {
   HRESULT status;
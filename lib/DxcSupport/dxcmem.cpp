@@ -13,7 +13,10 @@
 #include <specstrings.h>
 
 #include "dxc/Support/WinIncludes.h"
+#include <algorithm>
 #include <memory>
+#include <mutex>
+#include <new>
 
 static DWORD g_ThreadMallocTlsIndex;
 static IMalloc *g_pDefaultMalloc;
@@ -92,3 +95,409 @@ IMalloc *DxcSwapThreadMalloc(IMalloc *pMalloc, IMalloc **ppPrior) {
 IMalloc *DxcSwapThreadMallocOrDefault(IMalloc *pMallocOrNull, IMalloc **ppPrior) {
   return DxcSwapThreadMalloc(pMallocOrNull ? pMallocOrNull : g_pDefaultMalloc, ppPrior);
 }
+
+namespace {
+
+struct __declspec(uuid("3c1f4a6e-92d7-4b8e-a5f0-6d2e8b7c9a14"))
+DxcArenaMalloc : public IMalloc {
+private:
+  // Precedes every block handed out, so that GetSize and Realloc work and
+  // Free can tell blocks that were forwarded to the parent.
+  struct BlockHeader {
+    SIZE_T Size;
+    SIZE_T IsLarge;
+  };
+  // Precedes the blocks carved out of each chunk.
+  struct ChunkHeader {
+    ChunkHeader *pNext;
+    SIZE_T Size;
+  };
+  static const SIZE_T Alignment = 16;
+  static const SIZE_T ChunkSize = 1 << 20;
+  // Requests this large are forwarded to the parent rather than wasting
+  // the tail of a chunk.
+  static const SIZE_T LargeBlockSize = ChunkSize / 4;
+  static SIZE_T AlignUp(SIZE_T cb) {
+    return (cb + Alignment - 1) & ~(Alignment - 1);
+  }
+  static const SIZE_T HeaderSize = (sizeof(BlockHeader) + Alignment - 1) & ~(Alignment - 1);
+  static const SIZE_T ChunkHeaderSize = (sizeof(ChunkHeader) + Alignment - 1) & ~(Alignment - 1);
+  static BlockHeader *HeaderFromPtr(void *pv) {
+    return (BlockHeader *)((char *)pv - HeaderSize);
+  }
+
+  volatile ULONG m_RefCount;
+  IMalloc *m_pParent;
+  std::mutex m_Lock; // Blocks may be freed by objects released on other threads.
+  ChunkHeader *m_pChunks;
+  char *m_pNext;     // Next free byte in the current chunk.
+  char *m_pEnd;      // End of the current chunk.
+  DxcArenaMallocStats m_Stats;
+
+  void ReleaseChunks() {
+    while (m_pChunks) {
+      ChunkHeader *pNext = m_pChunks->pNext;
+      m_Stats.ReservedBytes -= m_pChunks->Size;
+      m_pParent->Free(m_pChunks);
+      m_pChunks = pNext;
+    }
+    m_pNext = m_pEnd = nullptr;
+  }
+
+  void *AllocLocked(SIZE_T cb) {
+    SIZE_T total = HeaderSize + AlignUp(cb);
+    if (total < cb)
+      return nullptr; // Overflow.
+    BlockHeader *pHeader;
+    if (total >= LargeBlockSize) {
+      pHeader = (BlockHeader *)m_pParent->Alloc(total);
+      if (pHeader == nullptr)
+        return nullptr;
+      pHeader->IsLarge = 1;
+      m_Stats.ReservedBytes += total;
+    } else {
+      if ((SIZE_T)(m_pEnd - m_pNext) < total) {
+        ChunkHeader *pChunk = (ChunkHeader *)m_pParent->Alloc(ChunkSize);
+        if (pChunk == nullptr)
+          return nullptr;
+        pChunk->pNext = m_pChunks;
+        pChunk->Size = ChunkSize;
+        m_pChunks = pChunk;
+        m_pNext = (char *)pChunk + ChunkHeaderSize;
+        m_pEnd = (char *)pChunk + ChunkSize;
+        m_Stats.ReservedBytes += ChunkSize;
+      }
+      pHeader = (BlockHeader *)m_pNext;
+      pHeader->IsLarge = 0;
+      m_pNext += total;
+    }
+    pHeader->Size = cb;
+    if (m_Stats.ReservedBytes > m_Stats.PeakReservedBytes)
+      m_Stats.PeakReservedBytes = m_Stats.ReservedBytes;
+    ++m_Stats.AllocCount;
+    m_Stats.AllocBytes += cb;
+    ++m_Stats.LiveCount;
+    return (char *)pHeader + HeaderSize;
+  }
+
+  void FreeLocked(void *pv) {
+    BlockHeader *pHeader = HeaderFromPtr(pv);
+    if (pHeader->IsLarge) {
+      m_Stats.ReservedBytes -= HeaderSize + AlignUp(pHeader->Size);
+      m_pParent->Free(pHeader);
+    }
+    DXASSERT(m_Stats.LiveCount > 0, "else block freed twice");
+    if (--m_Stats.LiveCount == 0)
+      ReleaseChunks();
+  }
+
+public:
+  DxcArenaMalloc(IMalloc *pParent)
+      : m_RefCount(0), m_pParent(pParent), m_pChunks(nullptr),
+        m_pNext(nullptr), m_pEnd(nullptr) {
+    memset(&m_Stats, 0, sizeof(m_Stats));
+    m_pParent->AddRef();
+  }
+  ~DxcArenaMalloc() {
+    DXASSERT(m_Stats.LiveCount == 0, "else arena released with live blocks");
+    ReleaseChunks();
+  }
+
+  ULONG STDMETHODCALLTYPE AddRef() override {
+    return InterlockedIncrement(&m_RefCount);
+  }
+  ULONG STDMETHODCALLTYPE Release() override {
+    ULONG result = InterlockedDecrement(&m_RefCount);
+    if (result == 0) {
+      // The arena lives in memory from the parent, not the thread allocator.
+      IMalloc *pParent = m_pParent;
+      this->~DxcArenaMalloc();
+      pParent->Free(this);
+      pParent->Release();
+    }
+    return result;
+  }
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) override {
+    if (ppvObject == nullptr)
+      return E_POINTER;
+    if (IsEqualIID(iid, __uuidof(IUnknown)) ||
+        IsEqualIID(iid, __uuidof(IMalloc)) ||
+        IsEqualIID(iid, __uuidof(DxcArenaMalloc))) {
+      *ppvObject = this;
+      AddRef();
+      return S_OK;
+    }
+    *ppvObject = nullptr;
+    return E_NOINTERFACE;
+  }
+
+  void *STDMETHODCALLTYPE Alloc(SIZE_T cb) override {
+    std::lock_guard<std::mutex> lock(m_Lock);
+    return AllocLocked(cb);
+  }
+  void *STDMETHODCALLTYPE Realloc(void *pv, SIZE_T cb) override {
+    std::lock_guard<std::mutex> lock(m_Lock);
+    if (pv == nullptr)
+      return AllocLocked(cb);
+    if (cb == 0) {
+      FreeLocked(pv);
+      return nullptr;
+    }
+    BlockHeader *pHeader = HeaderFromPtr(pv);
+    if (cb <= pHeader->Size)
+      return pv;
+    void *pNew = AllocLocked(cb);
+    if (pNew == nullptr)
+      return nullptr;
+    memcpy(pNew, pv, pHeader->Size);
+    FreeLocked(pv);
+    return pNew;
+  }
+  void STDMETHODCALLTYPE Free(void *pv) override {
+    if (pv == nullptr)
+      return;
+    std::lock_guard<std::mutex> lock(m_Lock);
+    FreeLocked(pv);
+  }
+  SIZE_T STDMETHODCALLTYPE GetSize(void *pv) override {
+    return pv == nullptr ? 0 : HeaderFromPtr(pv)->Size;
+  }
+  int STDMETHODCALLTYPE DidAlloc(void *pv) override {
+    return -1; // don't know
+  }
+  void STDMETHODCALLTYPE HeapMinimize(void) override {}
+
+  void GetStats(DxcArenaMallocStats *pStats) {
+    std::lock_guard<std::mutex> lock(m_Lock);
+    *pStats = m_Stats;
+  }
+};
+
+} // namespace
+
+HRESULT DxcCreateArenaMalloc(IMalloc *pParentMalloc, IMalloc **ppArena) {
+  if (pParentMalloc == nullptr || ppArena == nullptr)
+    return E_POINTER;
+  *ppArena = nullptr;
+  void *pMemory = pParentMalloc->Alloc(sizeof(DxcArenaMalloc));
+  if (pMemory == nullptr)
+    return E_OUTOFMEMORY;
+  DxcArenaMalloc *pArena = new (pMemory) DxcArenaMalloc(pParentMalloc);
+  pArena->AddRef();
+  *ppArena = pArena;
+  return S_OK;
+}
+
+bool DxcGetArenaMallocStats(IMalloc *pMalloc, DxcArenaMallocStats *pStats) {
+  if (pMalloc == nullptr || pStats == nullptr)
+    return false;
+  DxcArenaMalloc *pArena;
+  if (FAILED(pMalloc->QueryInterface(__uuidof(DxcArenaMalloc), (void **)&pArena)))
+    return false;
+  pArena->GetStats(pStats);
+  pArena->Release();
+  return true;
+}
+
+namespace {
+
+struct __declspec(uuid("b8d54e27-6a1f-4c93-8e02-f97a3d6c15b0"))
+DxcCountingMalloc : public IMalloc {
+private:
+  // Precedes every block handed out, so that frees can be accounted for
+  // without relying on the parent's GetSize.
+  struct BlockHeader {
+    SIZE_T Size;
+  };
+  static const SIZE_T HeaderSize = 16;
+  static_assert(sizeof(BlockHeader) <= HeaderSize, "else header too large");
+  static BlockHeader *HeaderFromPtr(void *pv) {
+    return (BlockHeader *)((char *)pv - HeaderSize);
+  }
+
+  volatile ULONG m_RefCount;
+  IMalloc *m_pParent;
+  std::mutex m_Lock; // Blocks may be freed by objects released on other threads.
+  DxcCountingMallocStats m_Stats;
+  unsigned long long m_LimitBytes; // 0 if there is no limit.
+
+  // Accounts for a request of cb bytes that replaces a block of oldSize
+  // bytes, unless it would grow the live bytes past the limit. Requests are
+  // accounted for before they are forwarded, so that concurrent ones can't
+  // get past the limit together.
+  bool TryReserve(SIZE_T oldSize, SIZE_T cb) {
+    std::lock_guard<std::mutex> lock(m_Lock);
+    unsigned long long liveBytes = m_Stats.LiveBytes - oldSize + cb;
+    if (m_LimitBytes != 0 && cb > oldSize && liveBytes > m_LimitBytes)
+      return false;
+    ++m_Stats.AllocCount;
+    m_Stats.AllocBytes += cb;
+    m_Stats.LiveBytes = liveBytes;
+    if (m_Stats.LiveBytes > m_Stats.PeakLiveBytes)
+      m_Stats.PeakLiveBytes = m_Stats.LiveBytes;
+    return true;
+  }
+  // Undoes TryReserve after the parent failed the request.
+  void Unreserve(SIZE_T oldSize, SIZE_T cb) {
+    std::lock_guard<std::mutex> lock(m_Lock);
+    --m_Stats.AllocCount;
+    m_Stats.AllocBytes -= cb;
+    m_Stats.LiveBytes = m_Stats.LiveBytes - cb + oldSize;
+  }
+
+public:
+  DxcCountingMalloc(IMalloc *pParent)
+      : m_RefCount(0), m_pParent(pParent), m_LimitBytes(0) {
+    memset(&m_Stats, 0, sizeof(m_Stats));
+    m_pParent->AddRef();
+  }
+
+  ULONG STDMETHODCALLTYPE AddRef() override {
+    return InterlockedIncrement(&m_RefCount);
+  }
+  ULONG STDMETHODCALLTYPE Release() override {
+    ULONG result = InterlockedDecrement(&m_RefCount);
+    if (result == 0) {
+      // Lives in memory from the parent, not the thread allocator.
+      IMalloc *pParent = m_pParent;
+      this->~DxcCountingMalloc();
+      pParent->Free(this);
+      pParent->Release();
+    }
+    return result;
+  }
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) override {
+    if (ppvObject == nullptr)
+      return E_POINTER;
+    if (IsEqualIID(iid, __uuidof(IUnknown)) ||
+        IsEqualIID(iid, __uuidof(IMalloc)) ||
+        IsEqualIID(iid, __uuidof(DxcCountingMalloc))) {
+      *ppvObject = this;
+      AddRef();
+      return S_OK;
+    }
+    *ppvObject = nullptr;
+    return E_NOINTERFACE;
+  }
+
+  void *STDMETHODCALLTYPE Alloc(SIZE_T cb) override {
+    if (cb + HeaderSize < cb)
+      return nullptr; // Overflow.
+    if (!TryReserve(0, cb))
+      return nullptr;
+    BlockHeader *pHeader = (BlockHeader *)m_pParent->Alloc(cb + HeaderSize);
+    if (pHeader == nullptr) {
+      Unreserve(0, cb);
+      return nullptr;
+    }
+    pHeader->Size = cb;
+    return (char *)pHeader + HeaderSize;
+  }
+  void *STDMETHODCALLTYPE Realloc(void *pv, SIZE_T cb) override {
+    if (pv == nullptr)
+      return Alloc(cb);
+    if (cb == 0) {
+      Free(pv);
+      return nullptr;
+    }
+    if (cb + HeaderSize < cb)
+      return nullptr; // Overflow.
+    SIZE_T oldSize = HeaderFromPtr(pv)->Size;
+    if (!TryReserve(oldSize, cb))
+      return nullptr;
+    BlockHeader *pHeader =
+        (BlockHeader *)m_pParent->Realloc(HeaderFromPtr(pv), cb + HeaderSize);
+    if (pHeader == nullptr) {
+      Unreserve(oldSize, cb);
+      return nullptr;
+    }
+    pHeader->Size = cb;
+    return (char *)pHeader + HeaderSize;
+  }
+  void STDMETHODCALLTYPE Free(void *pv) override {
+    if (pv == nullptr)
+      return;
+    BlockHeader *pHeader = HeaderFromPtr(pv);
+    {
+      std::lock_guard<std::mutex> lock(m_Lock);
+      DXASSERT(m_Stats.LiveBytes >= pHeader->Size, "else block freed twice");
+      m_Stats.LiveBytes -= pHeader->Size;
+    }
+    m_pParent->Free(pHeader);
+  }
+  SIZE_T STDMETHODCALLTYPE GetSize(void *pv) override {
+    return pv == nullptr ? 0 : HeaderFromPtr(pv)->Size;
+  }
+  int STDMETHODCALLTYPE DidAlloc(void *pv) override {
+    return -1; // don't know
+  }
+  void STDMETHODCALLTYPE HeapMinimize(void) override {
+    m_pParent->HeapMinimize();
+  }
+
+  void GetStats(DxcCountingMallocStats *pStats) {
+    std::lock_guard<std::mutex> lock(m_Lock);
+    *pStats = m_Stats;
+  }
+  void SetPeak(unsigned long long peakLiveBytes) {
+    std::lock_guard<std::mutex> lock(m_Lock);
+    m_Stats.PeakLiveBytes = std::max(peakLiveBytes, m_Stats.LiveBytes);
+  }
+  void SetLimit(unsigned long long limitBytes) {
+    std::lock_guard<std::mutex> lock(m_Lock);
+    m_LimitBytes = limitBytes;
+  }
+};
+
+DxcCountingMalloc *GetCountingMalloc(IMalloc *pMalloc) {
+  DxcCountingMalloc *pCounting;
+  if (pMalloc == nullptr ||
+      FAILED(pMalloc->QueryInterface(__uuidof(DxcCountingMalloc),
+                                     (void **)&pCounting)))
+    return nullptr;
+  return pCounting;
+}
+
+} // namespace
+
+HRESULT DxcCreateCountingMalloc(IMalloc *pParentMalloc, IMalloc **ppMalloc) {
+  if (pParentMalloc == nullptr || ppMalloc == nullptr)
+    return E_POINTER;
+  *ppMalloc = nullptr;
+  void *pMemory = pParentMalloc->Alloc(sizeof(DxcCountingMalloc));
+  if (pMemory == nullptr)
+    return E_OUTOFMEMORY;
+  DxcCountingMalloc *pCounting = new (pMemory) DxcCountingMalloc(pParentMalloc);
+  pCounting->AddRef();
+  *ppMalloc = pCounting;
+  return S_OK;
+}
+
+bool DxcGetCountingMallocStats(IMalloc *pMalloc, DxcCountingMallocStats *pStats) {
+  if (pStats == nullptr)
+    return false;
+  DxcCountingMalloc *pCounting = GetCountingMalloc(pMalloc);
+  if (pCounting == nullptr)
+    return false;
+  pCounting->GetStats(pStats);
+  pCounting->Release();
+  return true;
+}
+
+bool DxcSetCountingMallocPeak(IMalloc *pMalloc, unsigned long long peakLiveBytes) {
+  DxcCountingMalloc *pCounting = GetCountingMalloc(pMalloc);
+  if (pCounting == nullptr)
+    return false;
+  pCounting->SetPeak(peakLiveBytes);
+  pCounting->Release();
+  return true;
+}
+
+bool DxcSetCountingMallocLimit(IMalloc *pMalloc, unsigned long long limitBytes) {
+  DxcCountingMalloc *pCounting = GetCountingMalloc(pMalloc);
+  if (pCounting == nullptr)
+    return false;
+  pCounting->SetLimit(limitBytes);
+  pCounting->Release();
+  return true;
+}
@@ -206,6 +206,9 @@ void DxilViewIdState::Clear() {
   m_PCEntry.Clear();
   m_FuncInfo.clear();
   m_ReachingDeclsCache.clear();
+  m_StoresPerDeclCache.clear();
+  m_InstructionNumbers.clear();
+  m_NumberedInstructions.clear();
   m_SerializedState.clear();
 }
 
@@ -277,33 +280,44 @@ void DxilViewIdState::AnalyzeFunctions(EntryInfo &Entry) {
       pFuncInfo = m_FuncInfo[F].get();
     }
 
-    for (auto itBB = F->begin(), endBB = F->end(); itBB != endBB; ++itBB) {
-      BasicBlock *BB = itBB;
-
-      for (auto itInst = BB->begin(), endInst = BB->end(); itInst != endInst; ++itInst) {
-        if (ReturnInst *RI = dyn_cast<ReturnInst>(itInst)) {
-          pFuncInfo->Returns.emplace(RI);
-          continue;
-        }
-
-        CallInst *CI = dyn_cast<CallInst>(itInst);
-        if (!CI) continue;
+    for (BasicBlock &BB : *F) {
+      if (ReturnInst *RI = dyn_cast<ReturnInst>(BB.getTerminator()))
+        pFuncInfo->Returns.emplace(RI);
+    }
 
+    // Only signature accesses are of interest here, so visit just the calls of
+    // their opcode classes.
+    const OP::OpCodeClass SigAccessClasses[] = {
+      OP::OpCodeClass::LoadInput, OP::OpCodeClass::StoreOutput,
+      OP::OpCodeClass::LoadPatchConstant, OP::OpCodeClass::StorePatchConstant,
+      OP::OpCodeClass::LoadOutputControlPoint };
+    DxilOpCallList OpCalls(*F);
+    for (OP::OpCodeClass OpClass : SigAccessClasses) {
+      for (const DxilOpCallList::Call &C : OpCalls.calls(OpClass)) {
+        CallInst *CI = C.CI;
         DynamicallyIndexedElemsType *pDynIdxElems = nullptr;
         int row = Semantic::kUndefinedRow;
         unsigned id, col;
-        if (DxilInst_LoadInput LI = DxilInst_LoadInput(CI)) {
+        switch (C.Opcode) {
+        case OP::OpCode::LoadInput: {
+          DxilInst_LoadInput LI(CI);
           pDynIdxElems = &m_InpSigDynIdxElems;
           IFTBOOL(GetUnsignedVal(LI.get_inputSigId(), &id), DXC_E_GENERAL_INTERNAL_ERROR);
           GetUnsignedVal(LI.get_rowIndex(), (uint32_t*)&row);
           IFTBOOL(GetUnsignedVal(LI.get_colIndex(), &col), DXC_E_GENERAL_INTERNAL_ERROR);
-        } else if (DxilInst_StoreOutput SO = DxilInst_StoreOutput(CI)) {
+          break;
+        }
+        case OP::OpCode::StoreOutput: {
+          DxilInst_StoreOutput SO(CI);
           pDynIdxElems = &m_OutSigDynIdxElems;
           IFTBOOL(GetUnsignedVal(SO.get_outputSigId(), &id), DXC_E_GENERAL_INTERNAL_ERROR);
           GetUnsignedVal(SO.get_rowIndex(), (uint32_t*)&row);
           IFTBOOL(GetUnsignedVal(SO.get_colIndex(), &col), DXC_E_GENERAL_INTERNAL_ERROR);
           Entry.Outputs.emplace(CI);
-        } else if (DxilInst_LoadPatchConstant LPC = DxilInst_LoadPatchConstant(CI)) {
+          break;
+        }
+        case OP::OpCode::LoadPatchConstant: {
+          DxilInst_LoadPatchConstant LPC(CI);
           if (m_pModule->GetShaderModel()->IsDS()) {
             pDynIdxElems = &m_PCSigDynIdxElems;
             IFTBOOL(GetUnsignedVal(LPC.get_inputSigId(), &id), DXC_E_GENERAL_INTERNAL_ERROR);
@@ -313,13 +327,19 @@ void DxilViewIdState::AnalyzeFunctions(EntryInfo &Entry) {
             // Do nothing. This is an internal helper function for DXBC-2-DXIL converter.
             DXASSERT_NOMSG(m_pModule->GetShaderModel()->IsHS());
           }
-        } else if (DxilInst_StorePatchConstant SPC = DxilInst_StorePatchConstant(CI)) {
+          break;
+        }
+        case OP::OpCode::StorePatchConstant: {
+          DxilInst_StorePatchConstant SPC(CI);
           pDynIdxElems = &m_PCSigDynIdxElems;
           IFTBOOL(GetUnsignedVal(SPC.get_outputSigID(), &id), DXC_E_GENERAL_INTERNAL_ERROR);
           GetUnsignedVal(SPC.get_row(), (uint32_t*)&row);
           IFTBOOL(GetUnsignedVal(SPC.get_col(), &col), DXC_E_GENERAL_INTERNAL_ERROR);
           Entry.Outputs.emplace(CI);
-        } else if (DxilInst_LoadOutputControlPoint LOCP = DxilInst_LoadOutputControlPoint(CI)) {
+          break;
+        }
+        case OP::OpCode::LoadOutputControlPoint: {
+          DxilInst_LoadOutputControlPoint LOCP(CI);
           if (m_pModule->GetShaderModel()->IsDS()) {
             pDynIdxElems = &m_InpSigDynIdxElems;
             IFTBOOL(GetUnsignedVal(LOCP.get_inputSigId(), &id), DXC_E_GENERAL_INTERNAL_ERROR);
@@ -330,7 +350,9 @@ void DxilViewIdState::AnalyzeFunctions(EntryInfo &Entry) {
           } else {
             DXASSERT_NOMSG(false);
           }
-        } else {
+          break;
+        }
+        default:
           continue;
         }
 
@@ -400,101 +422,107 @@ void DxilViewIdState::CollectValuesContributingToOutputs(EntryInfo &Entry) {
       endRow = SigElem.GetRows() - 1;
     }
 
-    InstructionSetType ContributingInstructionsAllRows;
-    InstructionSetType *pContributingInstructions = &ContributingInstructionsAllRows;
+    InstructionNumberSetType ContributingInstructionsAllRows;
+    InstructionNumberSetType *pContributingInstructions = &ContributingInstructionsAllRows;
     if (startRow == endRow) {
       // Scalar or indexable with known index.
       unsigned index = GetLinearIndex(SigElem, startRow, col);
       pContributingInstructions = &Entry.ContributingInstructions[StreamId][index];
     }
 
-    CollectValuesContributingToOutputRec(Entry, pContributingValue, *pContributingInstructions);
-
-    // Handle control dependence of this instruction BB.
+    // Handle the stored value and control dependence of this instruction BB.
+    ValueWorklistType Worklist;
+    Worklist.push_back(pContributingValue);
     BasicBlock *pBB = CI->getParent();
     Function *F = pBB->getParent();
     FuncInfo *pFuncInfo = m_FuncInfo[F].get();
-    const BasicBlockSet &CtrlDepSet = pFuncInfo->CtrlDep.GetCDBlocks(pBB);
-    for (BasicBlock *B : CtrlDepSet) {
-      CollectValuesContributingToOutputRec(Entry, B->getTerminator(), *pContributingInstructions);
+    const BasicBlockIndexSet &CtrlDepSet = pFuncInfo->CtrlDep.GetCDBlocks(pBB);
+    for (unsigned iB : CtrlDepSet) {
+      Worklist.push_back(pFuncInfo->CtrlDep.GetBlock(iB)->getTerminator());
     }
+    CollectValuesContributingToOutput(Entry, Worklist, *pContributingInstructions);
 
     if (pContributingInstructions == &ContributingInstructionsAllRows) {
       // Write dynamically indexed output contributions to all rows.
       for (int row = startRow; row <= endRow; row++) {
         unsigned index = GetLinearIndex(SigElem, row, col);
-        Entry.ContributingInstructions[StreamId][index].insert(ContributingInstructionsAllRows.begin(), ContributingInstructionsAllRows.end());
+        Entry.ContributingInstructions[StreamId][index] |= ContributingInstructionsAllRows;
       }
     }
   }
 }
 
-void DxilViewIdState::CollectValuesContributingToOutputRec(EntryInfo &Entry,
-                                                           Value *pContributingValue,
-                                                           InstructionSetType &ContributingInstructions) {
-  if (Argument *pArg = dyn_cast<Argument>(pContributingValue)) {
-    // This must be a leftover signature argument of an entry function.
-    DXASSERT_NOMSG(Entry.pEntryFunc == m_pModule->GetEntryFunction() ||
-                   Entry.pEntryFunc == m_pModule->GetPatchConstantFunction());
-    return;
-  }
+unsigned DxilViewIdState::GetInstructionNumber(Instruction *pInst) {
+  auto it = m_InstructionNumbers.insert(
+      std::make_pair(pInst, (unsigned)m_NumberedInstructions.size()));
+  if (it.second)
+    m_NumberedInstructions.push_back(pInst);
+  return it.first->second;
+}
 
-  Instruction *pContributingInst = dyn_cast<Instruction>(pContributingValue);
-  if (pContributingInst == nullptr) {
-    // Can be literal constant, global decl, branch target.
-    DXASSERT_NOMSG(isa<Constant>(pContributingValue) || isa<BasicBlock>(pContributingValue));
-    return;
-  }
+// Walks the values in Worklist, and everything they depend on, with an
+// explicit stack, so that long def-use chains don't exhaust the call stack.
+void DxilViewIdState::CollectValuesContributingToOutput(EntryInfo &Entry,
+                                                        ValueWorklistType &Worklist,
+                                                        InstructionNumberSetType &ContributingInstructions) {
+  while (!Worklist.empty()) {
+    Value *pContributingValue = Worklist.pop_back_val();
+    if (Argument *pArg = dyn_cast<Argument>(pContributingValue)) {
+      // This must be a leftover signature argument of an entry function.
+      DXASSERT_NOMSG(Entry.pEntryFunc == m_pModule->GetEntryFunction() ||
+                     Entry.pEntryFunc == m_pModule->GetPatchConstantFunction());
+      continue;
+    }
 
-  auto itInst = ContributingInstructions.emplace(pContributingInst);
-  // Already visited instruction.
-  if (!itInst.second) return;
-
-  // Handle special cases.
-  if (PHINode *phi = dyn_cast<PHINode>(pContributingInst)) {
-    CollectPhiCFValuesContributingToOutputRec(phi, Entry, ContributingInstructions);
-  } else if (isa<LoadInst>(pContributingInst) || 
-             isa<AtomicCmpXchgInst>(pContributingInst) ||
-             isa<AtomicRMWInst>(pContributingInst)) {
-    Value *pPtrValue = pContributingInst->getOperand(0);
-    DXASSERT_NOMSG(pPtrValue->getType()->isPointerTy());
-    const ValueSetType &ReachingDecls = CollectReachingDecls(pPtrValue);
-    DXASSERT_NOMSG(ReachingDecls.size() > 0);
-    for (Value *pDeclValue : ReachingDecls) {
-      const ValueSetType &Stores = CollectStores(pDeclValue);
-      for (Value *V : Stores) {
-        CollectValuesContributingToOutputRec(Entry, V, ContributingInstructions);
-      }
+    Instruction *pContributingInst = dyn_cast<Instruction>(pContributingValue);
+    if (pContributingInst == nullptr) {
+      // Can be literal constant, global decl, branch target.
+      DXASSERT_NOMSG(isa<Constant>(pContributingValue) || isa<BasicBlock>(pContributingValue));
+      continue;
     }
-  } else if (CallInst *CI = dyn_cast<CallInst>(pContributingInst)) {
-    if (!hlsl::OP::IsDxilOpFuncCallInst(CI)) {
-      Function *F = CI->getCalledFunction();
-      if (!F->empty()) {
-        // Return value of a user function.
-        if (Entry.Functions.find(F) != Entry.Functions.end()) {
-          const FuncInfo &FI = *m_FuncInfo[F];
-          for (ReturnInst *pRetInst : FI.Returns) {
-            CollectValuesContributingToOutputRec(Entry, pRetInst, ContributingInstructions);
+
+    // Already visited instruction.
+    if (!ContributingInstructions.test_and_set(GetInstructionNumber(pContributingInst)))
+      continue;
+
+    // Handle special cases.
+    if (PHINode *phi = dyn_cast<PHINode>(pContributingInst)) {
+      CollectPhiCFValuesContributingToOutput(phi, Worklist);
+    } else if (isa<LoadInst>(pContributingInst) || 
+               isa<AtomicCmpXchgInst>(pContributingInst) ||
+               isa<AtomicRMWInst>(pContributingInst)) {
+      Value *pPtrValue = pContributingInst->getOperand(0);
+      DXASSERT_NOMSG(pPtrValue->getType()->isPointerTy());
+      const ValueSetType &ReachingDecls = CollectReachingDecls(pPtrValue);
+      DXASSERT_NOMSG(ReachingDecls.size() > 0);
+      for (Value *pDeclValue : ReachingDecls) {
+        const ValueSetType &Stores = CollectStores(pDeclValue);
+        Worklist.append(Stores.begin(), Stores.end());
+      }
+    } else if (CallInst *CI = dyn_cast<CallInst>(pContributingInst)) {
+      if (!hlsl::OP::IsDxilOpFuncCallInst(CI)) {
+        Function *F = CI->getCalledFunction();
+        if (!F->empty()) {
+          // Return value of a user function.
+          if (Entry.Functions.find(F) != Entry.Functions.end()) {
+            const FuncInfo &FI = *m_FuncInfo[F];
+            Worklist.append(FI.Returns.begin(), FI.Returns.end());
           }
         }
       }
     }
-  }
 
-  // Handle instruction inputs.
-  unsigned NumOps = pContributingInst->getNumOperands();
-  for (unsigned i = 0; i < NumOps; i++) {
-    Value *O = pContributingInst->getOperand(i);
-    CollectValuesContributingToOutputRec(Entry, O, ContributingInstructions);
-  }
+    // Handle instruction inputs.
+    Worklist.append(pContributingInst->op_begin(), pContributingInst->op_end());
 
-  // Handle control dependence of this instruction BB.
-  BasicBlock *pBB = pContributingInst->getParent();
-  Function *F = pBB->getParent();
-  FuncInfo *pFuncInfo = m_FuncInfo[F].get();
-  const BasicBlockSet &CtrlDepSet = pFuncInfo->CtrlDep.GetCDBlocks(pBB);
-  for (BasicBlock *B : CtrlDepSet) {
-    CollectValuesContributingToOutputRec(Entry, B->getTerminator(), ContributingInstructions);
+    // Handle control dependence of this instruction BB.
+    BasicBlock *pBB = pContributingInst->getParent();
+    Function *F = pBB->getParent();
+    FuncInfo *pFuncInfo = m_FuncInfo[F].get();
+    const BasicBlockIndexSet &CtrlDepSet = pFuncInfo->CtrlDep.GetCDBlocks(pBB);
+    for (unsigned iB : CtrlDepSet) {
+      Worklist.push_back(pFuncInfo->CtrlDep.GetBlock(iB)->getTerminator());
+    }
   }
 }
 
@@ -503,9 +531,8 @@ void DxilViewIdState::CollectValuesContributingToOutputRec(EntryInfo &Entry,
 // However, this may be too conservative and, as such, pick up extra control dependent BBs.
 // A better "definition" point is the highest dominator where it is still legal to "insert" constant assignment.
 // In this context, "legal" means that only one value "leaves" the dominator and reaches Phi.
-void DxilViewIdState::CollectPhiCFValuesContributingToOutputRec(PHINode *pPhi,
-                                                                EntryInfo &Entry,
-                                                                InstructionSetType &ContributingInstructions) {
+void DxilViewIdState::CollectPhiCFValuesContributingToOutput(PHINode *pPhi,
+                                                             ValueWorklistType &Worklist) {
   Function *F = pPhi->getParent()->getParent();
   FuncInfo *pFuncInfo = m_FuncInfo[F].get();
   unordered_map<DomTreeNodeBase<BasicBlock> *, Value *> DomTreeMarkers;
@@ -578,102 +605,95 @@ void DxilViewIdState::CollectPhiCFValuesContributingToOutputRec(PHINode *pPhi,
 
     // Handle control dependence of this constant argument highest legal "definition" point.
     pBB = pDefDomNode->getBlock();
-    const BasicBlockSet &CtrlDepSet = pFuncInfo->CtrlDep.GetCDBlocks(pBB);
-    for (BasicBlock *B : CtrlDepSet) {
-      CollectValuesContributingToOutputRec(Entry, B->getTerminator(), ContributingInstructions);
+    const BasicBlockIndexSet &CtrlDepSet = pFuncInfo->CtrlDep.GetCDBlocks(pBB);
+    for (unsigned iB : CtrlDepSet) {
+      Worklist.push_back(pFuncInfo->CtrlDep.GetBlock(iB)->getTerminator());
     }
   }
 }
 
 const DxilViewIdState::ValueSetType &DxilViewIdState::CollectReachingDecls(Value *pValue) {
-  auto it = m_ReachingDeclsCache.emplace(pValue, ValueSetType());
-  if (it.second) {
-    // We have not seen this value before.
-    ValueSetType Visited;
-    CollectReachingDeclsRec(pValue, it.first->second, Visited);
-  }
-  return it.first->second;
-}
-
-void DxilViewIdState::CollectReachingDeclsRec(Value *pValue, ValueSetType &ReachingDecls, ValueSetType &Visited) {
-  if (Visited.find(pValue) != Visited.end())
-    return;
-
-  bool bInitialValue = Visited.size() == 0;
-  Visited.emplace(pValue);
+  auto itCache = m_ReachingDeclsCache.emplace(pValue, ValueSetType());
+  if (!itCache.second)
+    return itCache.first->second;
+
+  // We have not seen this value before.
+  ValueSetType &ReachingDecls = itCache.first->second;
+  ValueSetType Visited;
+  ValueWorklistType Worklist;
+  Worklist.push_back(pValue);
+  while (!Worklist.empty()) {
+    Value *pCurValue = Worklist.pop_back_val();
+    if (!Visited.emplace(pCurValue).second)
+      continue;
 
-  if (!bInitialValue) {
-    auto it = m_ReachingDeclsCache.find(pValue);
-    if (it != m_ReachingDeclsCache.end()) {
-      ReachingDecls.insert(it->second.begin(), it->second.end());
-      return;
+    if (pCurValue != pValue) {
+      auto it = m_ReachingDeclsCache.find(pCurValue);
+      if (it != m_ReachingDeclsCache.end()) {
+        ReachingDecls.insert(it->second.begin(), it->second.end());
+        continue;
+      }
     }
-  }
 
-  if (GlobalVariable *GV = dyn_cast<GlobalVariable>(pValue)) {
-    ReachingDecls.emplace(pValue);
-    return;
-  }
-
-  if (GetElementPtrInst *pGepInst = dyn_cast<GetElementPtrInst>(pValue)) {
-    Value *pPtrValue = pGepInst->getPointerOperand();
-    CollectReachingDeclsRec(pPtrValue, ReachingDecls, Visited);
-  } else if (GEPOperator *pGepOp = dyn_cast<GEPOperator>(pValue)) {
-    Value *pPtrValue = pGepOp->getPointerOperand();
-    CollectReachingDeclsRec(pPtrValue, ReachingDecls, Visited);
-  } else if (AllocaInst *AI = dyn_cast<AllocaInst>(pValue)) {
-    ReachingDecls.emplace(pValue);
-  } else if (PHINode *phi = dyn_cast<PHINode>(pValue)) {
-    for (Value *pPtrValue : phi->operands()) {
-      CollectReachingDeclsRec(pPtrValue, ReachingDecls, Visited);
+    if (GlobalVariable *GV = dyn_cast<GlobalVariable>(pCurValue)) {
+      ReachingDecls.emplace(pCurValue);
+    } else if (GetElementPtrInst *pGepInst = dyn_cast<GetElementPtrInst>(pCurValue)) {
+      Worklist.push_back(pGepInst->getPointerOperand());
+    } else if (GEPOperator *pGepOp = dyn_cast<GEPOperator>(pCurValue)) {
+      Worklist.push_back(pGepOp->getPointerOperand());
+    } else if (AllocaInst *AI = dyn_cast<AllocaInst>(pCurValue)) {
+      ReachingDecls.emplace(pCurValue);
+    } else if (PHINode *phi = dyn_cast<PHINode>(pCurValue)) {
+      Worklist.append(phi->op_begin(), phi->op_end());
+    } else if (Argument *pArg = dyn_cast<Argument>(pCurValue)) {
+      ReachingDecls.emplace(pCurValue);
+    } else {
+      IFT(DXC_E_GENERAL_INTERNAL_ERROR);
     }
-  } else if (Argument *pArg = dyn_cast<Argument>(pValue)) {
-    ReachingDecls.emplace(pValue);
-  } else {
-    IFT(DXC_E_GENERAL_INTERNAL_ERROR);
   }
+  return ReachingDecls;
 }
 
 const DxilViewIdState::ValueSetType &DxilViewIdState::CollectStores(llvm::Value *pValue) {
-  auto it = m_StoresPerDeclCache.emplace(pValue, ValueSetType());
-  if (it.second) {
-    // We have not seen this value before.
-    ValueSetType Visited;
-    CollectStoresRec(pValue, it.first->second, Visited);
-  }
-  return it.first->second;
-}
-
-void DxilViewIdState::CollectStoresRec(llvm::Value *pValue, ValueSetType &Stores, ValueSetType &Visited) {
-  if (Visited.find(pValue) != Visited.end())
-    return;
-
-  bool bInitialValue = Visited.size() == 0;
-  Visited.emplace(pValue);
+  auto itCache = m_StoresPerDeclCache.emplace(pValue, ValueSetType());
+  if (!itCache.second)
+    return itCache.first->second;
+
+  // We have not seen this value before.
+  ValueSetType &Stores = itCache.first->second;
+  ValueSetType Visited;
+  ValueWorklistType Worklist;
+  Worklist.push_back(pValue);
+  while (!Worklist.empty()) {
+    Value *pCurValue = Worklist.pop_back_val();
+    if (!Visited.emplace(pCurValue).second)
+      continue;
 
-  if (!bInitialValue) {
-    auto it = m_StoresPerDeclCache.find(pValue);
-    if (it != m_StoresPerDeclCache.end()) {
-      Stores.insert(it->second.begin(), it->second.end());
-      return;
+    if (pCurValue != pValue) {
+      auto it = m_StoresPerDeclCache.find(pCurValue);
+      if (it != m_StoresPerDeclCache.end()) {
+        Stores.insert(it->second.begin(), it->second.end());
+        continue;
+      }
     }
-  }
 
-  if (isa<LoadInst>(pValue)) {
-    return;
-  } else if (isa<StoreInst>(pValue) ||
-             isa<AtomicCmpXchgInst>(pValue) ||
-             isa<AtomicRMWInst>(pValue)) {
-    Stores.emplace(pValue);
-    return;
-  }
+    if (isa<LoadInst>(pCurValue)) {
+      continue;
+    } else if (isa<StoreInst>(pCurValue) ||
+               isa<AtomicCmpXchgInst>(pCurValue) ||
+               isa<AtomicRMWInst>(pCurValue)) {
+      Stores.emplace(pCurValue);
+      continue;
+    }
 
-  for (auto *U : pValue->users()) {
-    CollectStoresRec(U, Stores, Visited);
+    for (auto *U : pCurValue->users()) {
+      Worklist.push_back(U);
+    }
   }
+  return Stores;
 }
 
-void DxilViewIdState::CreateViewIdSets(const std::unordered_map<unsigned, InstructionSetType> &ContributingInstructions, 
+void DxilViewIdState::CreateViewIdSets(const std::unordered_map<unsigned, InstructionNumberSetType> &ContributingInstructions, 
                                        OutputsDependentOnViewIdType &OutputsDependentOnViewId,
                                        InputsContributingToOutputType &InputsContributingToOutputs,
                                        bool bPC) {
@@ -681,7 +701,8 @@ void DxilViewIdState::CreateViewIdSets(const std::unordered_map<unsigned, Instru
 
   for (auto &itOut : ContributingInstructions) {
     unsigned outIdx = itOut.first;
-    for (Instruction *pInst : itOut.second) {
+    for (unsigned InstNum : itOut.second) {
+      Instruction *pInst = m_NumberedInstructions[InstNum];
       // Set output dependence on ViewId.
       if (DxilInst_ViewID VID = DxilInst_ViewID(pInst)) {
         DXASSERT(m_bUsesViewId, "otherwise, DxilModule flag not set properly");
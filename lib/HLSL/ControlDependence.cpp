@@ -19,23 +19,25 @@ using namespace llvm;
 using namespace hlsl;
 
 
-const BasicBlockSet &ControlDependence::GetCDBlocks(BasicBlock *pBB) const {
-  auto it = m_ControlDependence.find(pBB);
-  if (it != m_ControlDependence.end())
-    return it->second;
+const BasicBlockIndexSet &ControlDependence::GetCDBlocks(BasicBlock *pBB) const {
+  auto it = m_BlockIndex.find(pBB);
+  if (it != m_BlockIndex.end())
+    return m_ControlDependence[it->second];
   else
     return m_EmptyBBSet;
 }
 
 void ControlDependence::print(raw_ostream &OS) {
   OS << "Control dependence for function '" << m_pFunc->getName() << "'\n";
-  for (auto &it : m_ControlDependence) {
-    BasicBlock *pBB = it.first;
+  for (unsigned iBB = 0; iBB < m_Blocks.size(); iBB++) {
+    if (m_ControlDependence[iBB].empty())
+      continue;
+    BasicBlock *pBB = m_Blocks[iBB];
     OS << "Block " << pBB->getName() << ": { ";
     bool bFirst = true;
-    for (BasicBlock *pBB2 : it.second) {
+    for (unsigned iBB2 : m_ControlDependence[iBB]) {
       if (!bFirst) OS << ", ";
-      OS << pBB2->getName();
+      OS << m_Blocks[iBB2]->getName();
       bFirst = false;
     }
     OS << " }\n";
@@ -50,6 +52,13 @@ void ControlDependence::dump() {
 void ControlDependence::Compute(Function *F, PostDomRelationType &PostDomRel) {
   m_pFunc = F;
 
+  // Number the blocks, so that dependence sets can be bit vectors.
+  for (BasicBlock &BB : *F) {
+    m_BlockIndex[&BB] = m_Blocks.size();
+    m_Blocks.push_back(&BB);
+  }
+  m_ControlDependence.resize(m_Blocks.size());
+
   // Compute reverse topological order of PDT.
   BasicBlockVector RevTopOrder;
   BasicBlockSet VisitedBBs;
@@ -61,13 +70,14 @@ void ControlDependence::Compute(Function *F, PostDomRelationType &PostDomRel) {
   // Compute control dependence relation.
   for (size_t iBB = 0; iBB < RevTopOrder.size(); iBB++) {
     BasicBlock *x = RevTopOrder[iBB];
+    BasicBlockIndexSet &CDx = m_ControlDependence[m_BlockIndex[x]];
 
     // For each y = pred(x): if ipostdom(y) != x then add "x is control dependent on y"
     for (auto itPred = pred_begin(x), endPred = pred_end(x); itPred != endPred; ++itPred) {
       BasicBlock *y = *itPred;  // predecessor of x
       BasicBlock *pPredIDomBB = GetIPostDom(PostDomRel, y);
       if (pPredIDomBB != x) {
-        m_ControlDependence[x].insert(y);
+        CDx.set(m_BlockIndex[y]);
       }
     }
 
@@ -75,16 +85,12 @@ void ControlDependence::Compute(Function *F, PostDomRelationType &PostDomRel) {
     for (DomTreeNode *child : PostDomRel.getNode(x)->getChildren()) {
       BasicBlock *z = child->getBlock();
 
-      auto it = m_ControlDependence.find(z);
-      if (it == m_ControlDependence.end())
-        continue;
-
       // For all y in CDG(z)
-      for (BasicBlock *y : it->second) {
+      for (unsigned iy : m_ControlDependence[m_BlockIndex[z]]) {
         // if ipostdom(y) != x then add "x is control dependent on y" 
-        BasicBlock *pPredIDomBB = GetIPostDom(PostDomRel, y);
+        BasicBlock *pPredIDomBB = GetIPostDom(PostDomRel, m_Blocks[iy]);
         if (pPredIDomBB != x) {
-          m_ControlDependence[x].insert(y);
+          CDx.set(iy);
         }
       }
     }
@@ -93,6 +99,8 @@ void ControlDependence::Compute(Function *F, PostDomRelationType &PostDomRel) {
 
 void ControlDependence::Clear() {
   m_pFunc = nullptr;
+  m_Blocks.clear();
+  m_BlockIndex.clear();
   m_ControlDependence.clear();
   m_EmptyBBSet.clear();
 }
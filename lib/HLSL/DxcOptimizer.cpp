@@ -16,11 +16,13 @@
 #include "dxc/HLSL/DxilContainer.h"
 #include "dxc/Support/FileIOHelper.h"
 #include "dxc/HLSL/DxilModule.h"
+#include "dxc/HLSL/DxilMetadataHelper.h"
 #include "dxc/HLSL/ReducibilityAnalysis.h"
 #include "dxc/HLSL/HLMatrixLowerPass.h"
 #include "dxc/HLSL/DxilGenerationPass.h"
 #include "dxc/HLSL/ComputeViewIdState.h"
 #include "dxc/HLSL/DxilUtil.h"
+#include "dxc/HLSL/DxcPhaseReport.h"
 #include "dxc/Support/dxcapi.impl.h"
 
 #include "llvm/Pass.h"
@@ -28,6 +30,7 @@
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/IRReader/IRReader.h"
 #include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/IR/DiagnosticPrinter.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/SourceMgr.h"
@@ -84,16 +87,24 @@ HRESULT SetupRegistryPassForHLSL() {
     initializeDCEPass(Registry);
     initializeDSEPass(Registry);
     initializeDeadInstEliminationPass(Registry);
+    initializeDxilAddBlockHitInstrumentationPass(Registry);
     initializeDxilAddPixelHitInstrumentationPass(Registry);
+    initializeDxilAggregateAtomicsPass(Registry);
+    initializeDxilAnnotateUniformPass(Registry);
     initializeDxilCondenseResourcesPass(Registry);
     initializeDxilDeadFunctionEliminationPass(Registry);
     initializeDxilDebugInstrumentationPass(Registry);
+    initializeDxilDemotePrecisionPass(Registry);
     initializeDxilEliminateOutputDynamicIndexingPass(Registry);
     initializeDxilEmitMetadataPass(Registry);
     initializeDxilExpandTrigIntrinsicsPass(Registry);
+    initializeDxilFinalizeAndEmitPass(Registry);
     initializeDxilFinalizeModulePass(Registry);
     initializeDxilForceEarlyZPass(Registry);
     initializeDxilGenerationPassPass(Registry);
+    initializeDxilGroupSharedLayoutPass(Registry);
+    initializeDxilHoistHandlesPass(Registry);
+    initializeDxilHoistInvariantReadsPass(Registry);
     initializeDxilLegalizeEvalOperationsPass(Registry);
     initializeDxilLegalizeResourceUsePassPass(Registry);
     initializeDxilLegalizeSampleOffsetPassPass(Registry);
@@ -104,6 +115,8 @@ HRESULT SetupRegistryPassForHLSL() {
     initializeDxilPreserveAllOutputsPass(Registry);
     initializeDxilReduceMSAAToSingleSamplePass(Registry);
     initializeDxilRemoveDiscardsPass(Registry);
+    initializeDxilRemoveRedundantBarriersPass(Registry);
+    initializeDxilSinkResourceReadsPass(Registry);
     initializeDynamicIndexingVectorToArrayPass(Registry);
     initializeEarlyCSELegacyPassPass(Registry);
     initializeEliminateAvailableExternallyPass(Registry);
@@ -133,6 +146,7 @@ HRESULT SetupRegistryPassForHLSL() {
     initializeLoopUnswitchPass(Registry);
     initializeLowerBitSetsPass(Registry);
     initializeLowerExpectIntrinsicPass(Registry);
+    initializeLowerResourceAndVectorTypesPass(Registry);
     initializeLowerStaticGlobalIntoAllocaPass(Registry);
     initializeMergeFunctionsPass(Registry);
     initializeMergedLoadStoreMotionPass(Registry);
@@ -174,6 +188,59 @@ HRESULT SetupRegistryPassForHLSL() {
 
 }
 
+// Named pass pipelines that RunOptimizer expands for -preset:NAME. A preset
+// may be pinned with -preset:NAME@VERSION; bump the version whenever its
+// pass list changes, so that tuning results can be matched to a pipeline.
+struct OptimizerPreset {
+  LPCWSTR pName;
+  unsigned Version;
+  const LPCWSTR *pPasses;
+  unsigned PassCount;
+};
+
+// Cheap cleanup for iterating on shaders; skips the expensive scalar passes.
+static const LPCWSTR FastIterationPresetPasses[] = {
+  L"-sroa", L"-early-cse", L"-simplifycfg", L"-dce"
+};
+// Full scalar pipeline, including loop-invariant code motion.
+static const LPCWSTR ShipPresetPasses[] = {
+  L"-sroa", L"-early-cse", L"-simplifycfg", L"-instcombine", L"-reassociate",
+  L"-gvn", L"-sccp", L"-licm", L"-dse", L"-adce", L"-simplifycfg",
+  L"-globaldce", L"-constmerge"
+};
+// As ship, minus the passes that tend to grow code.
+static const LPCWSTR SizePresetPasses[] = {
+  L"-sroa", L"-early-cse", L"-simplifycfg", L"-instcombine", L"-gvn",
+  L"-dse", L"-adce", L"-simplifycfg", L"-globaldce", L"-constmerge"
+};
+
+static const OptimizerPreset OptimizerPresets[] = {
+  { L"fast-iteration", 1, FastIterationPresetPasses, _countof(FastIterationPresetPasses) },
+  { L"ship", 1, ShipPresetPasses, _countof(ShipPresetPasses) },
+  { L"size", 1, SizePresetPasses, _countof(SizePresetPasses) },
+};
+
+// Parses the NAME[@VERSION] argument of -preset; returns nullptr if there is
+// no such preset or the requested version is not the registered one.
+static const OptimizerPreset *FindOptimizerPreset(LPCWSTR pArg) {
+  std::wstring name(pArg);
+  std::wstring::size_type versionPos = name.find(L'@');
+  unsigned version = 0;
+  if (versionPos != std::wstring::npos) {
+    LPCWSTR pVersion = pArg + versionPos + 1;
+    wchar_t *pVersionEnd;
+    version = wcstoul(pVersion, &pVersionEnd, 10);
+    if (*pVersion == L'\0' || *pVersionEnd != L'\0' || version == 0)
+      return nullptr;
+    name.resize(versionPos);
+  }
+  for (const OptimizerPreset &preset : OptimizerPresets) {
+    if (name == preset.pName)
+      return (version == 0 || version == preset.Version) ? &preset : nullptr;
+  }
+  return nullptr;
+}
+
 static ArrayRef<LPCSTR> GetPassArgNames(LPCSTR passName) {
   /* <py::lines('GETPASSARGNAMES')>hctdb_instrhelp.get_pass_arg_names()</py>*/
   // GETPASSARGNAMES:BEGIN
@@ -182,7 +249,8 @@ static ArrayRef<LPCSTR> GetPassArgNames(LPCSTR passName) {
   static const LPCSTR ArgPromotionArgs[] = { "maxElements" };
   static const LPCSTR CFGSimplifyPassArgs[] = { "Threshold", "Ftor", "bonus-inst-threshold" };
   static const LPCSTR DxilAddPixelHitInstrumentationArgs[] = { "force-early-z", "add-pixel-cost", "rt-width", "sv-position-index", "num-pixels" };
-  static const LPCSTR DxilDebugInstrumentationArgs[] = { "UAVSize", "parameter0", "parameter1", "parameter2" };
+  static const LPCSTR DxilDebugInstrumentationArgs[] = { "UAVSize", "parameter0", "parameter1", "parameter2", "compact-packets", "sample-rate", "lines", "blocks" };
+  static const LPCSTR DxilExpandTrigIntrinsicsArgs[] = { "relaxed" };
   static const LPCSTR DxilGenerationPassArgs[] = { "NotOptimized" };
   static const LPCSTR DxilOutputColorBecomesConstantArgs[] = { "mod-mode", "constant-red", "constant-green", "constant-blue", "constant-alpha" };
   static const LPCSTR DynamicIndexingVectorToArrayArgs[] = { "ReplaceAllVectors" };
@@ -215,6 +283,7 @@ static ArrayRef<LPCSTR> GetPassArgNames(LPCSTR passName) {
   if (strcmp(passName, "simplifycfg") == 0) return ArrayRef<LPCSTR>(CFGSimplifyPassArgs, _countof(CFGSimplifyPassArgs));
   if (strcmp(passName, "hlsl-dxil-add-pixel-hit-instrmentation") == 0) return ArrayRef<LPCSTR>(DxilAddPixelHitInstrumentationArgs, _countof(DxilAddPixelHitInstrumentationArgs));
   if (strcmp(passName, "hlsl-dxil-debug-instrumentation") == 0) return ArrayRef<LPCSTR>(DxilDebugInstrumentationArgs, _countof(DxilDebugInstrumentationArgs));
+  if (strcmp(passName, "hlsl-dxil-expand-trig-intrinsics") == 0) return ArrayRef<LPCSTR>(DxilExpandTrigIntrinsicsArgs, _countof(DxilExpandTrigIntrinsicsArgs));
   if (strcmp(passName, "dxilgen") == 0) return ArrayRef<LPCSTR>(DxilGenerationPassArgs, _countof(DxilGenerationPassArgs));
   if (strcmp(passName, "hlsl-dxil-constantColor") == 0) return ArrayRef<LPCSTR>(DxilOutputColorBecomesConstantArgs, _countof(DxilOutputColorBecomesConstantArgs));
   if (strcmp(passName, "dynamic-vector-to-array") == 0) return ArrayRef<LPCSTR>(DynamicIndexingVectorToArrayArgs, _countof(DynamicIndexingVectorToArrayArgs));
@@ -253,7 +322,8 @@ static ArrayRef<LPCSTR> GetPassArgDescriptions(LPCSTR passName) {
   static const LPCSTR ArgPromotionArgs[] = { "None" };
   static const LPCSTR CFGSimplifyPassArgs[] = { "None", "None", "Control the number of bonus instructions (default = 1)" };
   static const LPCSTR DxilAddPixelHitInstrumentationArgs[] = { "None", "None", "None", "None", "None" };
-  static const LPCSTR DxilDebugInstrumentationArgs[] = { "None", "None", "None", "None" };
+  static const LPCSTR DxilDebugInstrumentationArgs[] = { "None", "None", "None", "None", "None", "None", "None", "None" };
+  static const LPCSTR DxilExpandTrigIntrinsicsArgs[] = { "Use reduced precision expansions for 32-bit types" };
   static const LPCSTR DxilGenerationPassArgs[] = { "None" };
   static const LPCSTR DxilOutputColorBecomesConstantArgs[] = { "None", "None", "None", "None", "None" };
   static const LPCSTR DynamicIndexingVectorToArrayArgs[] = { "None" };
@@ -286,6 +356,7 @@ static ArrayRef<LPCSTR> GetPassArgDescriptions(LPCSTR passName) {
   if (strcmp(passName, "simplifycfg") == 0) return ArrayRef<LPCSTR>(CFGSimplifyPassArgs, _countof(CFGSimplifyPassArgs));
   if (strcmp(passName, "hlsl-dxil-add-pixel-hit-instrmentation") == 0) return ArrayRef<LPCSTR>(DxilAddPixelHitInstrumentationArgs, _countof(DxilAddPixelHitInstrumentationArgs));
   if (strcmp(passName, "hlsl-dxil-debug-instrumentation") == 0) return ArrayRef<LPCSTR>(DxilDebugInstrumentationArgs, _countof(DxilDebugInstrumentationArgs));
+  if (strcmp(passName, "hlsl-dxil-expand-trig-intrinsics") == 0) return ArrayRef<LPCSTR>(DxilExpandTrigIntrinsicsArgs, _countof(DxilExpandTrigIntrinsicsArgs));
   if (strcmp(passName, "dxilgen") == 0) return ArrayRef<LPCSTR>(DxilGenerationPassArgs, _countof(DxilGenerationPassArgs));
   if (strcmp(passName, "hlsl-dxil-constantColor") == 0) return ArrayRef<LPCSTR>(DxilOutputColorBecomesConstantArgs, _countof(DxilOutputColorBecomesConstantArgs));
   if (strcmp(passName, "dynamic-vector-to-array") == 0) return ArrayRef<LPCSTR>(DynamicIndexingVectorToArrayArgs, _countof(DynamicIndexingVectorToArrayArgs));
@@ -340,7 +411,9 @@ static bool IsPassOptionName(StringRef S) {
     ||  S.equals("Threshold")
     ||  S.equals("UAVSize")
     ||  S.equals("add-pixel-cost")
+    ||  S.equals("blocks")
     ||  S.equals("bonus-inst-threshold")
+    ||  S.equals("compact-packets")
     ||  S.equals("constant-alpha")
     ||  S.equals("constant-blue")
     ||  S.equals("constant-green")
@@ -355,6 +428,7 @@ static bool IsPassOptionName(StringRef S) {
     ||  S.equals("force-ssa-updater")
     ||  S.equals("jump-threading-threshold")
     ||  S.equals("likely-branch-weight")
+    ||  S.equals("lines")
     ||  S.equals("loop-distribute-non-if-convertible")
     ||  S.equals("loop-distribute-verify")
     ||  S.equals("loop-unswitch-threshold")
@@ -371,12 +445,14 @@ static bool IsPassOptionName(StringRef S) {
     ||  S.equals("parameter1")
     ||  S.equals("parameter2")
     ||  S.equals("pragma-unroll-threshold")
+    ||  S.equals("relaxed")
     ||  S.equals("reroll-num-tolerated-failed-matches")
     ||  S.equals("rewrite-map-file")
     ||  S.equals("rotation-max-header-size")
     ||  S.equals("rt-width")
     ||  S.equals("sample-profile-file")
     ||  S.equals("sample-profile-max-propagate-iterations")
+    ||  S.equals("sample-rate")
     ||  S.equals("sroa-random-shuffle-slices")
     ||  S.equals("sroa-strict-inbounds")
     ||  S.equals("sv-position-index")
@@ -399,6 +475,62 @@ static void FatalErrorHandlerStreamWrite(void *user_data, const std::string& rea
   throw std::exception();
 }
 
+static void CollectMetadataFunctions(const MDNode *N,
+                                     SmallPtrSetImpl<const MDNode *> &Visited,
+                                     std::vector<Function *> &Functions) {
+  if (!Visited.insert(N).second)
+    return;
+  for (const MDOperand &Op : N->operands()) {
+    if (!Op)
+      continue;
+    if (const ValueAsMetadata *V = dyn_cast<ValueAsMetadata>(Op.get())) {
+      if (Function *F = dyn_cast<Function>(V->getValue()))
+        Functions.push_back(F);
+    } else if (const MDNode *Child = dyn_cast<MDNode>(Op.get())) {
+      CollectMetadataFunctions(Child, Visited, Functions);
+    }
+  }
+}
+
+// For -opt-lazy: reads the bodies of the named functions, or of the entry
+// point functions if none are named, and of every function they reference.
+// Other bodies are left unread; passes skip them, and they are only read
+// when the module is written back.
+static HRESULT MaterializeLazyRoots(Module &M,
+                                    const std::vector<std::string> &Names) {
+  std::vector<Function *> worklist;
+  if (Names.empty()) {
+    if (NamedMDNode *pEntries =
+            M.getNamedMetadata(DxilMDHelper::kDxilEntryPointsMDName)) {
+      SmallPtrSet<const MDNode *, 16> visited;
+      for (const MDNode *pEntry : pEntries->operands())
+        CollectMetadataFunctions(pEntry, visited, worklist);
+    }
+  }
+  for (const std::string &Name : Names) {
+    Function *F = M.getFunction(Name);
+    if (F == nullptr)
+      return E_INVALIDARG;
+    worklist.push_back(F);
+  }
+
+  while (!worklist.empty()) {
+    Function *F = worklist.back();
+    worklist.pop_back();
+    if (!F->isMaterializable())
+      continue;
+    if (F->materialize())
+      return DXC_E_IR_VERIFICATION_FAILED;
+    for (BasicBlock &BB : *F)
+      for (Instruction &I : BB)
+        for (Value *Op : I.operands())
+          if (Function *Callee = dyn_cast<Function>(Op->stripPointerCasts()))
+            if (Callee->isMaterializable())
+              worklist.push_back(Callee);
+  }
+  return S_OK;
+}
+
 static HRESULT Utf8ToUtf16CoTaskMalloc(LPCSTR pValue, LPWSTR *ppResult) {
   if (ppResult == nullptr)
     return E_POINTER;
@@ -515,6 +647,84 @@ public:
   }
 };
 
+// Reports the time spent in each pass and the change it makes to the size of
+// the module, for -time-passes. The passes are collected as phases, named by
+// their option; size is the number of instructions in the module.
+//
+// Times are inclusive of passes nested in them, such as analyses computed on
+// the fly. A pass that runs more than once, such as a function pass, is
+// reported once with its times and deltas added up, wherever it nests.
+class PassTimingReport : public DxcPhaseReport {
+public:
+  PassTimingReport(PassRegistry *pRegistry, Module &M)
+      : DxcPhaseReport(nullptr), m_pRegistry(pRegistry), m_M(M) {
+    m_startInstCount = MeasureSize();
+  }
+
+  void passStarted(Pass *P) override { phaseStarted(GetPassOptionName(P)); }
+  void passFinished(Pass *P) override { phaseFinished(GetPassOptionName(P)); }
+  // Only passes are reported, not the regions within them.
+  void regionStarted(const char *pName) override {}
+  void regionFinished(const char *pName) override {}
+
+  // Writes a header line naming the columns, one tab-separated line per pass
+  // in the order the passes first ran, and a line with the totals.
+  void WritePasses(raw_ostream &OS) const {
+    struct PassTiming {
+      StringRef Name;
+      unsigned long long Count;
+      unsigned long long WallMicroseconds;
+      long long InstDelta;
+    };
+    std::vector<PassTiming> passes;
+    unsigned long long totalMicroseconds = 0;
+    for (const Phase &phase : GetPhases()) {
+      if (phase.Parent == NoParent)
+        totalMicroseconds += phase.WallMicroseconds;
+      auto it = std::find_if(passes.begin(), passes.end(),
+                             [&](const PassTiming &timing) {
+                               return timing.Name == phase.Name;
+                             });
+      if (it == passes.end()) {
+        passes.push_back({phase.Name, 0, 0, 0});
+        it = passes.end() - 1;
+      }
+      it->Count += phase.Count;
+      it->WallMicroseconds += phase.WallMicroseconds;
+      it->InstDelta += phase.SizeDelta;
+    }
+
+    OS << "pass\truns\twall_us\tinst_delta\n";
+    for (const PassTiming &timing : passes) {
+      OS << timing.Name << '\t' << timing.Count << '\t'
+         << timing.WallMicroseconds << '\t' << timing.InstDelta << '\n';
+    }
+    OS << "total\t-\t" << totalMicroseconds << '\t'
+       << ((long long)MeasureSize() - (long long)m_startInstCount) << '\n';
+  }
+
+protected:
+  uint64_t MeasureSize() const override {
+    uint64_t count = 0;
+    for (const Function &F : m_M)
+      for (const BasicBlock &BB : F)
+        count += BB.size();
+    return count;
+  }
+
+private:
+  const char *GetPassOptionName(Pass *P) const {
+    // Prefer the option name, which is how passes are requested.
+    const PassInfo *PI = m_pRegistry->getPassInfo(P->getPassID());
+    return PI && *PI->getPassArgument() ? PI->getPassArgument()
+                                        : P->getPassName();
+  }
+
+  PassRegistry *m_pRegistry;
+  Module &m_M;
+  uint64_t m_startInstCount;
+};
+
 HRESULT DxcOptimizer::Initialize() {
   try {
     m_registry = PassRegistry::getPassRegistry();
@@ -567,6 +777,25 @@ HRESULT STDMETHODCALLTYPE DxcOptimizer::RunOptimizer(
 
   DxcThreadMalloc TM(m_pMalloc);
 
+  // -opt-lazy[:NAME] reads function bodies only as needed, which the input
+  // has to be known for; see MaterializeLazyRoots. A requested pass that
+  // works on the whole module reads every body first, since passes such as
+  // -globaldce would otherwise miss uses in the bodies that were skipped.
+  bool LazyLoad = false;
+  std::vector<std::string> lazyRoots;
+  for (UINT32 i = 0; i < optionCount; ++i) {
+    if (!wcsstartswith(ppOptions[i], L"-opt-lazy"))
+      continue;
+    LPCWSTR pName = ppOptions[i] + _countof(L"-opt-lazy") - 1;
+    if (*pName) {
+      if (*pName != L':' && *pName != L'=')
+        return E_INVALIDARG;
+      CW2A name8(pName + 1, CP_UTF8);
+      lazyRoots.push_back(name8.m_psz);
+    }
+    LazyLoad = true;
+  }
+
   // Setup input buffer.
   //
   // The ir parsing requires the buffer to be null terminated. We deal with
@@ -575,8 +804,13 @@ HRESULT STDMETHODCALLTYPE DxcOptimizer::RunOptimizer(
   //
   // If we have the beginning of a DXIL program header, skip to the bitcode.
   //
+  // Lazily loaded bitcode is read in place; the blob outlives the module.
+  //
   LLVMContext Context;
   SMDiagnostic Err;
+  std::string DiagStr;
+  raw_string_ostream DiagStream(DiagStr);
+  DiagnosticPrinterRawOStream DiagPrinter(DiagStream);
   std::unique_ptr<MemoryBuffer> memBuf;
   std::unique_ptr<Module> M;
   const char * pBlobContent = reinterpret_cast<const char *>(pBlob->GetBufferPointer());
@@ -584,16 +818,29 @@ HRESULT STDMETHODCALLTYPE DxcOptimizer::RunOptimizer(
   const DxilProgramHeader *pProgramHeader =
     reinterpret_cast<const DxilProgramHeader *>(pBlobContent);
   if (IsValidDxilProgramHeader(pProgramHeader, blobSize)) {
-    std::string DiagStr;
     GetDxilProgramBitcode(pProgramHeader, &pBlobContent, &blobSize);
-    M = hlsl::dxilutil::LoadModuleFromBitcode(
-      llvm::StringRef(pBlobContent, blobSize), Context, DiagStr);
+    if (!LazyLoad)
+      M = hlsl::dxilutil::LoadModuleFromBitcode(
+        llvm::StringRef(pBlobContent, blobSize), Context, DiagStr);
   }
-  else {
+  else if (!LazyLoad ||
+           !isBitcode((const unsigned char *)pBlobContent,
+                      (const unsigned char *)pBlobContent + blobSize)) {
+    // Assembly is always read in full.
+    LazyLoad = false;
     StringRef bufStrRef(pBlobContent, blobSize);
     memBuf = MemoryBuffer::getMemBufferCopy(bufStrRef);
     M = parseIR(memBuf->getMemBufferRef(), Err, Context);
   }
+  if (LazyLoad) {
+    Context.setDiagnosticHandler(hlsl::dxilutil::PrintDiagnosticHandler,
+                                 &DiagPrinter, true);
+    ErrorOr<std::unique_ptr<Module>> pLazyModule = getLazyBitcodeModule(
+        MemoryBuffer::getMemBuffer(StringRef(pBlobContent, blobSize), "", false),
+        Context);
+    if (pLazyModule)
+      M = std::move(pLazyModule.get());
+  }
 
   if (M == nullptr) {
     return DXC_E_IR_VERIFICATION_FAILED;
@@ -612,6 +859,9 @@ HRESULT STDMETHODCALLTYPE DxcOptimizer::RunOptimizer(
 
     raw_stream_ostream outStream(pOutputStream.p);
 
+    if (LazyLoad)
+      IFT(MaterializeLazyRoots(*M.get(), lazyRoots));
+
     //
     // Consider some differences from opt.exe:
     //
@@ -628,6 +878,27 @@ HRESULT STDMETHODCALLTYPE DxcOptimizer::RunOptimizer(
     //
     bool OutputAssembly = false;
     bool AnalyzeOnly = false;
+    bool TimePasses = false;
+    bool HasModuleScopePass = false;
+
+    // Expand presets in place, so they combine with passes around them.
+    std::vector<LPCWSTR> expandedOptions;
+    for (UINT32 i = 0; i < optionCount; ++i) {
+      if (!wcsstartswith(ppOptions[i], L"-preset")) {
+        expandedOptions.push_back(ppOptions[i]);
+        continue;
+      }
+      LPCWSTR pArg = ppOptions[i] + _countof(L"-preset") - 1;
+      if (*pArg != L':' && *pArg != L'=')
+        return E_INVALIDARG;
+      const OptimizerPreset *pPreset = FindOptimizerPreset(pArg + 1);
+      if (pPreset == nullptr)
+        return E_INVALIDARG;
+      expandedOptions.insert(expandedOptions.end(), pPreset->pPasses,
+                             pPreset->pPasses + pPreset->PassCount);
+    }
+    ppOptions = expandedOptions.data();
+    optionCount = expandedOptions.size();
 
     // First gather flags, wherever they may be.
     SmallVector<UINT32, 2> handled;
@@ -642,6 +913,15 @@ HRESULT STDMETHODCALLTYPE DxcOptimizer::RunOptimizer(
         handled.push_back(i);
         continue;
       }
+      if (wcseq(L"-time-passes", ppOptions[i])) {
+        TimePasses = true;
+        handled.push_back(i);
+        continue;
+      }
+      if (wcsstartswith(ppOptions[i], L"-opt-lazy")) {
+        handled.push_back(i); // Applied when loading.
+        continue;
+      }
     }
 
     // TODO: should really use string_table for this once that's available
@@ -737,6 +1017,11 @@ HRESULT STDMETHODCALLTYPE DxcOptimizer::RunOptimizer(
       pass->applyOptions(options);
       options.clear();
       pPassManager->add(pass);
+      if (pPassManager == &ModulePasses) {
+        PassKind Kind = pass->getPassKind();
+        if (Kind == PT_Module || Kind == PT_CallGraphSCC)
+          HasModuleScopePass = true;
+      }
       if (AnalyzeOnly) {
         const bool Quiet = false;
         PassKind Kind = pass->getPassKind();
@@ -769,19 +1054,34 @@ HRESULT STDMETHODCALLTYPE DxcOptimizer::RunOptimizer(
       ModulePasses.add(llvm::createPrintModulePass(outStream));
     }
 
+    std::unique_ptr<PassTimingReport> pTiming;
+    if (TimePasses) {
+      pTiming.reset(new PassTimingReport(m_registry, *M.get()));
+      FunctionPasses.RunListener = pTiming.get();
+      ModulePasses.RunListener = pTiming.get();
+    }
+
     // Now that we have all of the passes ready, run them.
     {
       raw_ostream *err_ostream = &outStream;
       ScopedFatalErrorHandler errHandler(FatalErrorHandlerStreamWrite, err_ostream);
 
+      if (LazyLoad && HasModuleScopePass) {
+        IFTBOOL(!M->materializeAll(), DXC_E_IR_VERIFICATION_FAILED);
+        LazyLoad = false;
+      }
+
       FunctionPasses.doInitialization();
       for (Function &F : *M.get())
-        if (!F.isDeclaration())
+        if (!F.isDeclaration() && !F.isMaterializable())
           FunctionPasses.run(F);
       FunctionPasses.doFinalization();
       ModulePasses.run(*M.get());
     }
 
+    if (pTiming)
+      pTiming->WritePasses(outStream);
+
     outStream.flush();
     if (ppOutputText != nullptr) {
       IFT(DxcCreateBlobWithEncodingSet(pOutputBlob, CP_UTF8, ppOutputText));
@@ -791,6 +1091,10 @@ HRESULT STDMETHODCALLTYPE DxcOptimizer::RunOptimizer(
       IFT(CreateMemoryStream(m_pMalloc, &pProgramStream));
       {
         raw_stream_ostream outStream(pProgramStream.p);
+        // The writer renumbers the whole module, so the bodies that no pass
+        // read can't be copied over as they are; read them now.
+        if (LazyLoad)
+          IFTBOOL(!M->materializeAll(), DXC_E_IR_VERIFICATION_FAILED);
         WriteBitcodeToFile(M.get(), outStream, true);
       }
       IFT(pProgramStream.QueryInterface(ppOutputModule));
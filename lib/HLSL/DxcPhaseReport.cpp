@@ -0,0 +1,112 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxcPhaseReport.cpp                                                        //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Collects per-phase timing and memory use of a compile.                    //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/HLSL/DxcPhaseReport.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <string.h>
+
+namespace hlsl {
+
+DxcPhaseReport::DxcPhaseReport(IMalloc *pCountingMalloc)
+    : m_pCountingMalloc(pCountingMalloc) {
+  // Passes make up most phases; avoid growing while the compile runs.
+  m_phases.reserve(256);
+  m_active.reserve(16);
+}
+
+void DxcPhaseReport::GetStats(DxcCountingMallocStats *pStats) const {
+  if (!DxcGetCountingMallocStats(m_pCountingMalloc, pStats))
+    memset(pStats, 0, sizeof(*pStats));
+}
+
+unsigned DxcPhaseReport::FindOrAddPhase(const char *pName) {
+  unsigned parent = m_active.empty() ? NoParent : m_active.back().Index;
+  for (unsigned i = 0, e = m_phases.size(); i != e; ++i) {
+    const Phase &phase = m_phases[i];
+    if (phase.Parent == parent &&
+        (phase.pKey == pName || phase.Name == pName))
+      return i;
+  }
+  Phase phase;
+  phase.pKey = pName;
+  phase.Name = pName;
+  phase.Parent = parent;
+  phase.Depth = m_active.size();
+  phase.Count = 0;
+  phase.WallMicroseconds = 0;
+  phase.AllocCount = 0;
+  phase.AllocBytes = 0;
+  phase.PeakLiveBytes = 0;
+  phase.SizeDelta = 0;
+  m_phases.push_back(std::move(phase));
+  return m_phases.size() - 1;
+}
+
+void DxcPhaseReport::phaseStarted(const char *pName) {
+  ActivePhase active;
+  active.Index = FindOrAddPhase(pName);
+  active.StartSize = MeasureSize();
+  GetStats(&active.StartStats);
+  // Measure the peak of this phase alone; the enclosing peak is folded back
+  // in when the phase finishes.
+  DxcSetCountingMallocPeak(m_pCountingMalloc, 0);
+  active.Start = Clock::now();
+  m_active.push_back(active);
+}
+
+void DxcPhaseReport::phaseFinished(const char *pName) {
+  DXASSERT(!m_active.empty(), "else phase finished without starting");
+  if (m_active.empty())
+    return;
+  ActivePhase active = m_active.back();
+  m_active.pop_back();
+  Clock::time_point end = Clock::now();
+  uint64_t size = MeasureSize();
+  DxcCountingMallocStats stats;
+  GetStats(&stats);
+  DxcSetCountingMallocPeak(m_pCountingMalloc,
+                           std::max(active.StartStats.PeakLiveBytes,
+                                    stats.PeakLiveBytes));
+
+  Phase &phase = m_phases[active.Index];
+  DXASSERT(phase.Name == pName, "else phases finished out of order");
+  ++phase.Count;
+  phase.WallMicroseconds +=
+      std::chrono::duration_cast<std::chrono::microseconds>(end - active.Start)
+          .count();
+  phase.AllocCount += stats.AllocCount - active.StartStats.AllocCount;
+  phase.AllocBytes += stats.AllocBytes - active.StartStats.AllocBytes;
+  phase.PeakLiveBytes = std::max(phase.PeakLiveBytes, stats.PeakLiveBytes);
+  phase.SizeDelta += (long long)size - (long long)active.StartSize;
+}
+
+void DxcPhaseReport::WritePhases(llvm::raw_ostream &OS,
+                                 unsigned parent) const {
+  for (unsigned i = 0, e = m_phases.size(); i != e; ++i) {
+    const Phase &phase = m_phases[i];
+    if (phase.Parent != parent)
+      continue;
+    OS.indent(phase.Depth * 2) << phase.Name << '\t' << phase.Depth << '\t'
+                               << phase.Count << '\t'
+                               << phase.WallMicroseconds << '\t'
+                               << phase.AllocCount << '\t' << phase.AllocBytes
+                               << '\t' << phase.PeakLiveBytes << '\n';
+    WritePhases(OS, i);
+  }
+}
+
+void DxcPhaseReport::Write(llvm::raw_ostream &OS) const {
+  OS << "phase\tdepth\tcount\twall_us\tallocs\talloc_bytes\tpeak_bytes\n";
+  WritePhases(OS, NoParent);
+}
+
+} // namespace hlsl
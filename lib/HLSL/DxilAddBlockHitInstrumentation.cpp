@@ -0,0 +1,184 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilAddBlockHitInstrumentation.cpp                                        //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Provides a pass to add instrumentation that counts how often each basic   //
+// block of the entry point executes. Used by PIX.                           //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/HLSL/DxilGenerationPass.h"
+#include "dxc/HLSL/DxilOperations.h"
+#include "dxc/HLSL/DxilModule.h"
+
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DebugInfo.h"
+#include "llvm/IR/DebugInfoMetadata.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+
+using namespace llvm;
+using namespace hlsl;
+
+// Overview of instrumentation:
+//
+// Each basic block of the entry point gets an ID, in function order, and a uint32 counter at byte
+// offset ID * 4 of a UAV. On entry to a block, the first active lane of the wave adds the number of
+// active lanes to the block's counter, so each wave does one atomic operation per block it executes
+// rather than one per invocation.
+//
+// The pass writes a map from block ID to source location (taken from the first instruction in the
+// block that has one) to the pass output, one "<ID> <file>:<line> <offset>" line per block, where
+// offset is the line relative to the entry point's declaration. Summing the counters per offset gives
+// the body of a sample profile for the entry point, which /profile-use feeds back into the compiler.
+// Blocks without debug information map to "<unknown>".
+
+class DxilAddBlockHitInstrumentation : public ModulePass {
+
+public:
+  static char ID; // Pass identification, replacement for typeid
+  explicit DxilAddBlockHitInstrumentation() : ModulePass(ID) {}
+  const char *getPassName() const override { return "DXIL Count basic block executions"; }
+  bool runOnModule(Module &M) override;
+
+private:
+  CallInst * addUAV(DxilModule &DM, IRBuilder<> &Builder);
+};
+
+CallInst * DxilAddBlockHitInstrumentation::addUAV(DxilModule &DM, IRBuilder<> &Builder)
+{
+  LLVMContext & Ctx = DM.GetCtx();
+  OP *HlslOP = DM.GetOP();
+
+  // Set up a UAV with structure of a single int
+  unsigned int UAVResourceHandle = static_cast<unsigned int>(DM.GetUAVs().size());
+  SmallVector<llvm::Type*, 1> Elements{ Type::getInt32Ty(Ctx) };
+  llvm::StructType *UAVStructTy = llvm::StructType::create(Elements, "PIX_BlockHitUAV_Type");
+  std::unique_ptr<DxilResource> pUAV = llvm::make_unique<DxilResource>();
+  pUAV->SetGlobalName("PIX_BlockHitUAVName");
+  pUAV->SetGlobalSymbol(UndefValue::get(UAVStructTy->getPointerTo()));
+  pUAV->SetID(UAVResourceHandle);
+  pUAV->SetSpaceID((unsigned int)-2); // This is the reserved-for-tools register space
+  pUAV->SetSampleCount(1);
+  pUAV->SetGloballyCoherent(false);
+  pUAV->SetHasCounter(false);
+  pUAV->SetCompType(CompType::getI32());
+  pUAV->SetLowerBound(0);
+  pUAV->SetRangeSize(1);
+  pUAV->SetKind(DXIL::ResourceKind::RawBuffer);
+  pUAV->SetRW(true);
+
+  auto ID = DM.AddUAV(std::move(pUAV));
+  assert(ID == UAVResourceHandle);
+
+  DM.m_ShaderFlags.SetEnableRawAndStructuredBuffers(true);
+
+  // Create handle for the newly-added UAV
+  Function* CreateHandleOpFunc = HlslOP->GetOpFunc(DXIL::OpCode::CreateHandle, Type::getVoidTy(Ctx));
+  Constant* CreateHandleOpcodeArg = HlslOP->GetU32Const((unsigned)DXIL::OpCode::CreateHandle);
+  Constant* UAVArg = HlslOP->GetI8Const(static_cast<std::underlying_type<DxilResourceBase::Class>::type>(DXIL::ResourceClass::UAV));
+  Constant* MetaDataArg = HlslOP->GetU32Const(ID); // position of the metadata record in the corresponding metadata list
+  Constant* IndexArg = HlslOP->GetU32Const(0); //
+  Constant* FalseArg = HlslOP->GetI1Const(0); // non-uniform resource index: false
+  return Builder.CreateCall(CreateHandleOpFunc,
+  { CreateHandleOpcodeArg, UAVArg, MetaDataArg, IndexArg, FalseArg }, "PIX_BlockHitUAV_Handle");
+}
+
+bool DxilAddBlockHitInstrumentation::runOnModule(Module &M)
+{
+  DxilModule &DM = M.GetOrCreateDxilModule();
+  LLVMContext & Ctx = M.getContext();
+  OP *HlslOP = DM.GetOP();
+
+  Function * EntryPointFunction = DM.GetEntryFunction();
+
+  // Instrumentation splits blocks, so take the IDs and locations up front:
+  std::vector<Instruction*> BlockStarts;
+  std::vector<DebugLoc> BlockLocations;
+  for (BasicBlock & BB : *EntryPointFunction) {
+    BlockStarts.push_back(BB.getFirstInsertionPt());
+    DebugLoc Location;
+    for (Instruction & Inst : BB) {
+      if (Inst.getDebugLoc()) {
+        Location = Inst.getDebugLoc();
+        break;
+      }
+    }
+    BlockLocations.push_back(Location);
+  }
+
+  CallInst *HandleForUAV;
+  {
+    IRBuilder<> Builder(EntryPointFunction->getEntryBlock().getFirstInsertionPt());
+    HandleForUAV = addUAV(DM, Builder);
+  }
+  DM.m_ShaderFlags.SetWaveOps(true);
+
+  Function* WaveAllOpFunc = HlslOP->GetOpFunc(OP::OpCode::WaveAllBitCount, Type::getVoidTy(Ctx));
+  Constant* WaveAllBitCountOpcode = HlslOP->GetU32Const((unsigned)OP::OpCode::WaveAllBitCount);
+  Function* IsFirstLaneFunc = HlslOP->GetOpFunc(OP::OpCode::WaveIsFirstLane, Type::getVoidTy(Ctx));
+  Constant* IsFirstLaneOpcode = HlslOP->GetU32Const((unsigned)OP::OpCode::WaveIsFirstLane);
+  Function* AtomicOpFunc = HlslOP->GetOpFunc(OP::OpCode::AtomicBinOp, Type::getInt32Ty(Ctx));
+  Constant* AtomicBinOpcode = HlslOP->GetU32Const((unsigned)OP::OpCode::AtomicBinOp);
+  Constant* AtomicAdd = HlslOP->GetU32Const((unsigned)DXIL::AtomicBinOpCode::Add);
+  UndefValue* UndefArg = UndefValue::get(Type::getInt32Ty(Ctx));
+
+  for (size_t BlockID = 0; BlockID < BlockStarts.size(); ++BlockID) {
+    Instruction * InsertPt = BlockStarts[BlockID];
+    IRBuilder<> Builder(InsertPt);
+
+    // Count the active lanes, and have the first of them add the count to the block's counter:
+    auto ActiveLanes = Builder.CreateCall(WaveAllOpFunc,
+    { WaveAllBitCountOpcode, HlslOP->GetI1Const(1) }, "ActiveLanes");
+    auto IsFirstLane = Builder.CreateCall(IsFirstLaneFunc, { IsFirstLaneOpcode }, "IsFirstLane");
+
+    TerminatorInst* CountTerm = SplitBlockAndInsertIfThen(IsFirstLane, InsertPt, false);
+    Builder.SetInsertPoint(CountTerm);
+    (void)Builder.CreateCall(AtomicOpFunc, {
+      AtomicBinOpcode,                                        // i32, ; opcode
+      HandleForUAV,                                           // %dx.types.Handle, ; resource handle
+      AtomicAdd,                                              // i32, ; binary operation code : EXCHANGE, IADD, AND, OR, XOR, IMIN, IMAX, UMIN, UMAX
+      HlslOP->GetU32Const(static_cast<unsigned>(BlockID) * 4), // i32, ; coordinate c0: byte offset
+      UndefArg,                                               // i32, ; coordinate c1 (unused)
+      UndefArg,                                               // i32, ; coordinate c2 (unused)
+      ActiveLanes                                             // i32); increment value
+    }, "UAVIncResult");
+  }
+
+  DM.ReEmitDxilResources();
+
+  if (OSOverride != nullptr) {
+    DISubprogram *EntrySubprogram = getDISubprogram(EntryPointFunction);
+    unsigned HeaderLine = EntrySubprogram ? EntrySubprogram->getLine() : 0;
+    *OSOverride << "\nBlockHitMap:\n";
+    for (size_t BlockID = 0; BlockID < BlockLocations.size(); ++BlockID) {
+      *OSOverride << BlockID << " ";
+      const DebugLoc & Location = BlockLocations[BlockID];
+      if (Location) {
+        DILocation *Loc = Location.get();
+        *OSOverride << Loc->getFilename() << ":" << Loc->getLine();
+        if (EntrySubprogram && Loc->getLine() >= HeaderLine)
+          *OSOverride << " " << (Loc->getLine() - HeaderLine);
+        *OSOverride << "\n";
+      }
+      else {
+        *OSOverride << "<unknown>\n";
+      }
+    }
+  }
+
+  return true;
+}
+
+char DxilAddBlockHitInstrumentation::ID = 0;
+
+ModulePass *llvm::createDxilAddBlockHitInstrumentationPass() {
+  return new DxilAddBlockHitInstrumentation();
+}
+
+INITIALIZE_PASS(DxilAddBlockHitInstrumentation, "hlsl-dxil-add-block-hit-instrumentation", "DXIL Count basic block executions", false, false)
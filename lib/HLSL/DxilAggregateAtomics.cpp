@@ -0,0 +1,236 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilAggregateAtomics.cpp                                                  //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Turns atomics that all lanes of a wave do on the same address into one    //
+// atomic per wave.                                                          //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/HLSL/DxilGenerationPass.h"
+#include "dxc/HLSL/DxilInstructions.h"
+#include "dxc/HLSL/DxilModule.h"
+#include "dxc/HLSL/DxilOperations.h"
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+
+#include <memory>
+
+using namespace llvm;
+using namespace hlsl;
+
+///////////////////////////////////////////////////////////////////////////////
+// Aggregate atomics.
+
+namespace {
+// An atomic whose address is the same for every active lane of the wave,
+// on a UAV or in groupshared memory, serializes on that address. It is
+// rewritten as:
+//
+//   v = WaveActiveSum(value);         // or Min, Max, BitAnd, BitOr, BitXor
+//   if (WaveIsFirstLane())
+//     r = atomic(address, v);
+//   original = WaveReadLaneFirst(r) + WavePrefixSum(value);
+//
+// Only adds give each lane an original value, as if the atomics had run in
+// lane order; the other operations are rewritten only when the original
+// value isn't used. Exchanges and compare-exchanges are left alone.
+//
+// Helper lanes of pixel shaders take part in wave operations but their
+// atomics have no effect, so pixel shaders, and libraries that may be called
+// from them, are left alone.
+class DxilAggregateAtomics : public FunctionPass {
+public:
+  static char ID; // Pass identification, replacement for typeid
+  explicit DxilAggregateAtomics() : FunctionPass(ID) {}
+
+  const char *getPassName() const override {
+    return "DXIL aggregate wave-uniform atomics";
+  }
+
+  bool runOnFunction(Function &F) override;
+};
+
+char DxilAggregateAtomics::ID = 0;
+
+// The operation of an atomic binary operation, or Invalid.
+DXIL::AtomicBinOpCode GetAtomicOp(Instruction *I) {
+  if (DxilInst_AtomicBinOp Atomic = DxilInst_AtomicBinOp(I)) {
+    if (!isa<ConstantInt>(Atomic.get_atomicOp()))
+      return DXIL::AtomicBinOpCode::Invalid;
+    return (DXIL::AtomicBinOpCode)cast<ConstantInt>(Atomic.get_atomicOp())
+        ->getZExtValue();
+  }
+  AtomicRMWInst *RMW = dyn_cast<AtomicRMWInst>(I);
+  if (!RMW ||
+      RMW->getPointerAddressSpace() != DXIL::kTGSMAddrSpace)
+    return DXIL::AtomicBinOpCode::Invalid;
+  switch (RMW->getOperation()) {
+  case AtomicRMWInst::Add:  return DXIL::AtomicBinOpCode::Add;
+  case AtomicRMWInst::And:  return DXIL::AtomicBinOpCode::And;
+  case AtomicRMWInst::Or:   return DXIL::AtomicBinOpCode::Or;
+  case AtomicRMWInst::Xor:  return DXIL::AtomicBinOpCode::Xor;
+  case AtomicRMWInst::Min:  return DXIL::AtomicBinOpCode::IMin;
+  case AtomicRMWInst::Max:  return DXIL::AtomicBinOpCode::IMax;
+  case AtomicRMWInst::UMin: return DXIL::AtomicBinOpCode::UMin;
+  case AtomicRMWInst::UMax: return DXIL::AtomicBinOpCode::UMax;
+  default:                  return DXIL::AtomicBinOpCode::Invalid;
+  }
+}
+
+bool CanAggregate(Instruction *I, DXIL::AtomicBinOpCode Op) {
+  switch (Op) {
+  case DXIL::AtomicBinOpCode::Add:
+    return true;
+  case DXIL::AtomicBinOpCode::Exchange:
+  case DXIL::AtomicBinOpCode::Invalid:
+    return false;
+  default:
+    return I->use_empty();
+  }
+}
+
+bool HasUniformAddress(Instruction *I, UniformityAnalysis &Uniformity) {
+  if (DxilInst_AtomicBinOp Atomic = DxilInst_AtomicBinOp(I))
+    return Uniformity.IsUniform(Atomic.get_handle()) &&
+           Uniformity.IsUniform(Atomic.get_offset0()) &&
+           Uniformity.IsUniform(Atomic.get_offset1()) &&
+           Uniformity.IsUniform(Atomic.get_offset2());
+  return Uniformity.IsUniform(cast<AtomicRMWInst>(I)->getPointerOperand());
+}
+
+Value *GetNewValue(Instruction *I) {
+  if (DxilInst_AtomicBinOp Atomic = DxilInst_AtomicBinOp(I))
+    return Atomic.get_newValue();
+  return cast<AtomicRMWInst>(I)->getValOperand();
+}
+
+void SetNewValue(Instruction *I, Value *V) {
+  if (DxilInst_AtomicBinOp Atomic = DxilInst_AtomicBinOp(I))
+    Atomic.set_newValue(V);
+  else
+    I->setOperand(1, V);
+}
+
+// Reduces V over the active lanes of the wave with the atomic's operation.
+Value *CreateWaveReduction(DXIL::AtomicBinOpCode Op, Value *V,
+                           IRBuilder<> &Builder, hlsl::OP *hlslOP) {
+  Type *Ty = V->getType();
+  DXIL::WaveBitOpKind BitKind = DXIL::WaveBitOpKind::And;
+  switch (Op) {
+  case DXIL::AtomicBinOpCode::And: break;
+  case DXIL::AtomicBinOpCode::Or:  BitKind = DXIL::WaveBitOpKind::Or;  break;
+  case DXIL::AtomicBinOpCode::Xor: BitKind = DXIL::WaveBitOpKind::Xor; break;
+  default: {
+    DXIL::WaveOpKind Kind = DXIL::WaveOpKind::Sum;
+    DXIL::SignedOpKind Sign = DXIL::SignedOpKind::Unsigned;
+    if (Op == DXIL::AtomicBinOpCode::IMin || Op == DXIL::AtomicBinOpCode::UMin)
+      Kind = DXIL::WaveOpKind::Min;
+    else if (Op == DXIL::AtomicBinOpCode::IMax ||
+             Op == DXIL::AtomicBinOpCode::UMax)
+      Kind = DXIL::WaveOpKind::Max;
+    if (Op == DXIL::AtomicBinOpCode::IMin || Op == DXIL::AtomicBinOpCode::IMax)
+      Sign = DXIL::SignedOpKind::Signed;
+    Value *Args[] = {hlslOP->GetU32Const((unsigned)DXIL::OpCode::WaveActiveOp),
+                     V, hlslOP->GetI8Const((char)Kind),
+                     hlslOP->GetI8Const((char)Sign)};
+    return Builder.CreateCall(
+        hlslOP->GetOpFunc(DXIL::OpCode::WaveActiveOp, Ty), Args);
+  }
+  }
+  Value *Args[] = {hlslOP->GetU32Const((unsigned)DXIL::OpCode::WaveActiveBit),
+                   V, hlslOP->GetI8Const((char)BitKind)};
+  return Builder.CreateCall(hlslOP->GetOpFunc(DXIL::OpCode::WaveActiveBit, Ty),
+                            Args);
+}
+
+void Aggregate(Instruction *I, DXIL::AtomicBinOpCode Op, hlsl::OP *hlslOP) {
+  IRBuilder<> Builder(I);
+  Value *V = GetNewValue(I);
+  Type *Ty = V->getType();
+  Type *VoidTy = Builder.getVoidTy();
+  Value *Prefix = nullptr;
+  if (!I->use_empty()) {
+    Value *Args[] = {hlslOP->GetU32Const((unsigned)DXIL::OpCode::WavePrefixOp),
+                     V, hlslOP->GetI8Const((char)DXIL::WaveOpKind::Sum),
+                     hlslOP->GetI8Const((char)DXIL::SignedOpKind::Unsigned)};
+    Prefix = Builder.CreateCall(
+        hlslOP->GetOpFunc(DXIL::OpCode::WavePrefixOp, Ty), Args);
+  }
+  SetNewValue(I, CreateWaveReduction(Op, V, Builder, hlslOP));
+  Value *IsFirstArgs[] = {
+      hlslOP->GetU32Const((unsigned)DXIL::OpCode::WaveIsFirstLane)};
+  Value *IsFirst = Builder.CreateCall(
+      hlslOP->GetOpFunc(DXIL::OpCode::WaveIsFirstLane, VoidTy), IsFirstArgs);
+
+  BasicBlock *Head = I->getParent();
+  TerminatorInst *ThenTerm = SplitBlockAndInsertIfThen(IsFirst, I, false);
+  BasicBlock *Tail = I->getParent();
+  I->moveBefore(ThenTerm);
+  if (!Prefix)
+    return;
+
+  // The first lane's original value, which the others offset by the values
+  // of the lanes before them.
+  PHINode *Phi = PHINode::Create(Ty, 2, "", &Tail->front());
+  Builder.SetInsertPoint(Tail->getFirstInsertionPt());
+  Value *ReadFirstArgs[] = {
+      hlslOP->GetU32Const((unsigned)DXIL::OpCode::WaveReadLaneFirst), Phi};
+  Value *First = Builder.CreateCall(
+      hlslOP->GetOpFunc(DXIL::OpCode::WaveReadLaneFirst, Ty), ReadFirstArgs);
+  I->replaceAllUsesWith(Builder.CreateAdd(First, Prefix));
+  Phi->addIncoming(I, ThenTerm->getParent());
+  Phi->addIncoming(UndefValue::get(Ty), Head);
+}
+}
+
+bool DxilAggregateAtomics::runOnFunction(Function &F) {
+  Module *M = F.getParent();
+  if (F.isDeclaration() || !M->HasDxilModule())
+    return false;
+  DxilModule &DM = M->GetDxilModule();
+  const ShaderModel *SM = DM.GetShaderModel();
+  if (SM->IsPS() || SM->IsLib())
+    return false;
+
+  SmallVector<std::pair<Instruction *, DXIL::AtomicBinOpCode>, 8> Atomics;
+  for (BasicBlock &BB : F) {
+    for (Instruction &I : BB) {
+      DXIL::AtomicBinOpCode Op = GetAtomicOp(&I);
+      if (CanAggregate(&I, Op))
+        Atomics.emplace_back(&I, Op);
+    }
+  }
+  if (Atomics.empty())
+    return false;
+
+  std::unique_ptr<UniformityAnalysis> Uniformity(UniformityAnalysis::create());
+  Uniformity->Analyze(&F);
+  // Decided up front, as rewriting splits blocks under the analysis.
+  SmallVector<std::pair<Instruction *, DXIL::AtomicBinOpCode>, 8> Uniform;
+  for (auto &Atomic : Atomics) {
+    if (HasUniformAddress(Atomic.first, *Uniformity))
+      Uniform.push_back(Atomic);
+  }
+
+  hlsl::OP *hlslOP = DM.GetOP();
+  for (auto &Atomic : Uniform)
+    Aggregate(Atomic.first, Atomic.second, hlslOP);
+  return !Uniform.empty();
+}
+
+FunctionPass *llvm::createDxilAggregateAtomicsPass() {
+  return new DxilAggregateAtomics();
+}
+
+INITIALIZE_PASS(DxilAggregateAtomics, "hlsl-dxil-aggregate-atomics",
+                "DXIL aggregate wave-uniform atomics", false, false)
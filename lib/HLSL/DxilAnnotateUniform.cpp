@@ -0,0 +1,111 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilAnnotateUniform.cpp                                                   //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Marks branches and loads that are the same for the whole wave.            //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/HLSL/DxilGenerationPass.h"
+#include "dxc/HLSL/DxilMetadataHelper.h"
+#include "dxc/HLSL/DxilModule.h"
+#include "dxc/HLSL/DxilOperations.h"
+
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Metadata.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+
+#include <memory>
+
+using namespace llvm;
+using namespace hlsl;
+
+///////////////////////////////////////////////////////////////////////////////
+// Annotate uniform values.
+
+namespace {
+// Conditional branches and switches that every active lane takes the same
+// way, and loads whose result is the same for every active lane, get an
+// empty dx.uniform node. A driver can then keep such values in scalar
+// registers and skip divergence handling for such branches.
+//
+// Older validators reject unknown instruction metadata, so nothing is added
+// unless the module targets a validator that knows dx.uniform.
+class DxilAnnotateUniform : public FunctionPass {
+public:
+  static char ID; // Pass identification, replacement for typeid
+  explicit DxilAnnotateUniform() : FunctionPass(ID) {}
+
+  const char *getPassName() const override {
+    return "DXIL annotate wave-uniform values";
+  }
+
+  bool runOnFunction(Function &F) override;
+};
+
+char DxilAnnotateUniform::ID = 0;
+
+bool IsAnnotatedKind(Instruction *I) {
+  if (BranchInst *BI = dyn_cast<BranchInst>(I))
+    return BI->isConditional();
+  if (isa<SwitchInst>(I) || isa<LoadInst>(I))
+    return true;
+  if (!OP::IsDxilOpFuncCallInst(I))
+    return false;
+  switch (OP::GetDxilOpFuncCallInst(I)) {
+  case DXIL::OpCode::CBufferLoad:
+  case DXIL::OpCode::CBufferLoadLegacy:
+  case DXIL::OpCode::BufferLoad:
+  case DXIL::OpCode::TextureLoad:
+  case DXIL::OpCode::Sample:
+  case DXIL::OpCode::SampleBias:
+  case DXIL::OpCode::SampleLevel:
+  case DXIL::OpCode::SampleGrad:
+  case DXIL::OpCode::SampleCmp:
+  case DXIL::OpCode::SampleCmpLevelZero:
+    return true;
+  default:
+    return false;
+  }
+}
+}
+
+bool DxilAnnotateUniform::runOnFunction(Function &F) {
+  Module *M = F.getParent();
+  if (F.isDeclaration() || !M->HasDxilModule())
+    return false;
+
+  unsigned ValMajor, ValMinor;
+  M->GetDxilModule().GetValidatorVersion(ValMajor, ValMinor);
+  // 0.0 means the container is not validated.
+  if (ValMajor == 1 && ValMinor < 6)
+    return false;
+
+  std::unique_ptr<UniformityAnalysis> Uniformity(UniformityAnalysis::create());
+  Uniformity->Analyze(&F);
+
+  MDNode *Uniform = MDNode::get(F.getContext(), {});
+  unsigned UniformKind =
+      F.getContext().getMDKindID(DxilMDHelper::kDxilUniformMDName);
+  bool bChanged = false;
+  for (BasicBlock &BB : F) {
+    for (Instruction &I : BB) {
+      if (IsAnnotatedKind(&I) && Uniformity->IsUniform(&I)) {
+        I.setMetadata(UniformKind, Uniform);
+        bChanged = true;
+      }
+    }
+  }
+  return bChanged;
+}
+
+FunctionPass *llvm::createDxilAnnotateUniformPass() {
+  return new DxilAnnotateUniform();
+}
+
+INITIALIZE_PASS(DxilAnnotateUniform, "hlsl-dxil-annotate-uniform",
+                "DXIL annotate wave-uniform values", false, false)
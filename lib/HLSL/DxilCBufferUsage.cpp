@@ -0,0 +1,188 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilCBufferUsage.cpp                                                      //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Finds the parts of constant buffers that a shader reads.                  //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/HLSL/DxilCBufferUsage.h"
+#include "dxc/HLSL/DxilCBuffer.h"
+#include "dxc/HLSL/DxilInstructions.h"
+#include "dxc/HLSL/DxilModule.h"
+#include "dxc/HLSL/DxilOperations.h"
+#include "dxc/HLSL/DxilTypeSystem.h"
+
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Instructions.h"
+
+#include <algorithm>
+
+using namespace llvm;
+using namespace hlsl;
+
+namespace {
+class CBufferUsageCollector {
+public:
+  CBufferUsageCollector(DxilModule &DM, const DxilCBuffer &CB);
+  void CollectLoads(Value *Handle);
+  DxilCBufferUsedRanges TakeRanges();
+
+private:
+  void AddRange(unsigned Start, unsigned End) {
+    if (Start < End)
+      m_Ranges.emplace_back(Start, End);
+  }
+  void AddDynamicRange(unsigned Start);
+  void CollectRowUsage(Value *V, unsigned RowOffset, unsigned CompSize,
+                       SmallPtrSetImpl<Value *> &Visited);
+
+  DxilCBufferUsedRanges m_Ranges;
+  // Offsets where the cbuffer's variables start, sorted.
+  std::vector<unsigned> m_VariableStarts;
+  unsigned m_Size;
+};
+}
+
+// Splits an offset into its constant part and returns whether that is all
+// of it. Or is treated as an add, since offsets only or disjoint bits.
+static bool SplitOffset(Value *V, unsigned &ConstPart) {
+  ConstPart = 0;
+  if (ConstantInt *Imm = dyn_cast<ConstantInt>(V)) {
+    ConstPart = Imm->getLimitedValue();
+    return true;
+  }
+  BinaryOperator *BO = dyn_cast<BinaryOperator>(V);
+  if (!BO || (BO->getOpcode() != Instruction::Add &&
+              BO->getOpcode() != Instruction::Or))
+    return false;
+  unsigned Left, Right;
+  bool bConstLeft = SplitOffset(BO->getOperand(0), Left);
+  bool bConstRight = SplitOffset(BO->getOperand(1), Right);
+  ConstPart = Left + Right;
+  return bConstLeft && bConstRight;
+}
+
+CBufferUsageCollector::CBufferUsageCollector(DxilModule &DM,
+                                             const DxilCBuffer &CB) {
+  // Offsets are into one cbuffer of a range.
+  m_Size = CB.GetSize() / std::max(CB.GetRangeSize(), 1u);
+  Type *Ty = CB.GetGlobalSymbol()->getType()->getPointerElementType();
+  if (Ty->isArrayTy())
+    Ty = Ty->getArrayElementType();
+  StructType *ST = dyn_cast<StructType>(Ty);
+  // Modules translated from DXBC have no annotations; dynamic loads then
+  // read to the end of the cbuffer.
+  if (DxilStructAnnotation *Annotation =
+          ST ? DM.GetTypeSystem().GetStructAnnotation(ST) : nullptr) {
+    for (unsigned i = 0; i < Annotation->GetNumFields(); ++i)
+      m_VariableStarts.emplace_back(
+          Annotation->GetFieldAnnotation(i).GetCBufferOffset());
+    std::sort(m_VariableStarts.begin(), m_VariableStarts.end());
+  }
+}
+
+void CBufferUsageCollector::AddDynamicRange(unsigned Start) {
+  auto Next = std::upper_bound(m_VariableStarts.begin(),
+                               m_VariableStarts.end(), Start);
+  AddRange(Start, Next == m_VariableStarts.end() ? std::max(m_Size, Start)
+                                                 : *Next);
+}
+
+// Adds the components of a legacy row that V's users extract.
+void CBufferUsageCollector::CollectRowUsage(Value *V, unsigned RowOffset,
+                                            unsigned CompSize,
+                                            SmallPtrSetImpl<Value *> &Visited) {
+  if (!Visited.insert(V).second)
+    return;
+  for (User *U : V->users()) {
+    if (ExtractValueInst *EV = dyn_cast<ExtractValueInst>(U)) {
+      for (unsigned Idx : EV->getIndices())
+        AddRange(RowOffset + Idx * CompSize,
+                 RowOffset + (Idx + 1) * CompSize);
+    } else if (isa<PHINode>(U) || isa<SelectInst>(U)) {
+      CollectRowUsage(U, RowOffset, CompSize, Visited);
+    } else {
+      AddRange(RowOffset, RowOffset + 16);
+    }
+  }
+}
+
+void CBufferUsageCollector::CollectLoads(Value *Handle) {
+  for (User *U : Handle->users()) {
+    CallInst *CI = dyn_cast<CallInst>(U);
+    if (!CI || !OP::IsDxilOpFuncCallInst(CI))
+      continue;
+    switch (OP::GetDxilOpFuncCallInst(CI)) {
+    case DXIL::OpCode::CBufferLoadLegacy: {
+      DxilInst_CBufferLoadLegacy Load(CI);
+      unsigned Row;
+      if (!SplitOffset(Load.get_regIndex(), Row)) {
+        AddDynamicRange(Row << 4);
+        break;
+      }
+      Type *CompTy = CI->getType()->getStructElementType(0);
+      SmallPtrSet<Value *, 4> Visited;
+      CollectRowUsage(CI, Row << 4, CompTy->getPrimitiveSizeInBits() / 8,
+                      Visited);
+    } break;
+    case DXIL::OpCode::CBufferLoad: {
+      DxilInst_CBufferLoad Load(CI);
+      unsigned Offset;
+      if (!SplitOffset(Load.get_byteOffset(), Offset)) {
+        AddDynamicRange(Offset);
+        break;
+      }
+      AddRange(Offset, Offset + CI->getType()->getPrimitiveSizeInBits() / 8);
+    } break;
+    default:
+      break;
+    }
+  }
+}
+
+DxilCBufferUsedRanges CBufferUsageCollector::TakeRanges() {
+  std::sort(m_Ranges.begin(), m_Ranges.end());
+  DxilCBufferUsedRanges Merged;
+  for (const std::pair<unsigned, unsigned> &Range : m_Ranges) {
+    if (!Merged.empty() && Range.first <= Merged.back().second)
+      Merged.back().second = std::max(Merged.back().second, Range.second);
+    else
+      Merged.emplace_back(Range);
+  }
+  m_Ranges.clear();
+  return Merged;
+}
+
+std::vector<DxilCBufferUsedRanges> hlsl::CollectCBufferUsage(DxilModule &DM) {
+  unsigned NumCBuffers = DM.GetCBuffers().size();
+  std::vector<std::vector<Value *>> Handles(NumCBuffers);
+  for (Function *F : DM.GetOP()->GetOpFuncList(DXIL::OpCode::CreateHandle)) {
+    if (!F)
+      continue;
+    for (User *U : F->users()) {
+      DxilInst_CreateHandle Handle(cast<CallInst>(U));
+      ConstantInt *ResClass = dyn_cast<ConstantInt>(Handle.get_resourceClass());
+      ConstantInt *RangeID = dyn_cast<ConstantInt>(Handle.get_rangeId());
+      if (!ResClass || !RangeID ||
+          ResClass->getLimitedValue() !=
+              (unsigned)DXIL::ResourceClass::CBuffer ||
+          RangeID->getLimitedValue() >= NumCBuffers)
+        continue;
+      Handles[RangeID->getLimitedValue()].emplace_back(U);
+    }
+  }
+
+  std::vector<DxilCBufferUsedRanges> Usage(NumCBuffers);
+  for (unsigned i = 0; i < NumCBuffers; ++i) {
+    CBufferUsageCollector Collector(DM, DM.GetCBuffer(i));
+    for (Value *Handle : Handles[i])
+      Collector.CollectLoads(Handle);
+    Usage[i] = Collector.TakeRanges();
+  }
+  return Usage;
+}
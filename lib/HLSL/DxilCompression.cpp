@@ -0,0 +1,141 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilCompression.cpp                                                       //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Implements the codec for compressed DXIL container parts.                 //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/HLSL/DxilCompression.h"
+#include <stdint.h>
+#include <string.h>
+
+namespace {
+
+const unsigned kMinMatch = 4;
+const unsigned kMaxOffset = 0xFFFF;
+const unsigned kHashBits = 14;
+
+uint32_t Read32(const char *p) {
+  uint32_t value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+unsigned Hash(uint32_t value) {
+  return (value * 2654435761u) >> (32 - kHashBits);
+}
+
+void WriteLength(size_t Length, std::vector<char> &Out) {
+  for (; Length >= 255; Length -= 255)
+    Out.push_back((char)255);
+  Out.push_back((char)Length);
+}
+
+void WriteSequence(const char *pLiterals, size_t LiteralCount,
+                   size_t MatchLength, size_t Offset, std::vector<char> &Out) {
+  size_t MatchCode = MatchLength ? MatchLength - kMinMatch : 0;
+  unsigned Token = (unsigned)((LiteralCount < 15 ? LiteralCount : 15) << 4) |
+                   (unsigned)(MatchCode < 15 ? MatchCode : 15);
+  Out.push_back((char)Token);
+  if (LiteralCount >= 15)
+    WriteLength(LiteralCount - 15, Out);
+  Out.insert(Out.end(), pLiterals, pLiterals + LiteralCount);
+  if (!MatchLength)
+    return;
+  Out.push_back((char)(Offset & 0xFF));
+  Out.push_back((char)(Offset >> 8));
+  if (MatchCode >= 15)
+    WriteLength(MatchCode - 15, Out);
+}
+
+// Reads a length continuation into Length; false if the data ends first.
+bool ReadLength(const unsigned char *&p, const unsigned char *pEnd,
+                size_t &Length) {
+  unsigned char b;
+  do {
+    if (p == pEnd)
+      return false;
+    b = *p++;
+    Length += b;
+  } while (b == 255);
+  return true;
+}
+
+} // namespace
+
+namespace hlsl {
+
+void CompressLZ(const char *pData, size_t Size, std::vector<char> &Compressed) {
+  // Positions are stored plus one, so that zero means none.
+  std::vector<uint32_t> Table(1u << kHashBits, 0);
+  size_t Anchor = 0;
+  size_t Pos = 0;
+  while (Size >= kMinMatch && Pos <= Size - kMinMatch) {
+    uint32_t Value = Read32(pData + Pos);
+    uint32_t &Entry = Table[Hash(Value)];
+    size_t Candidate = Entry;
+    Entry = (uint32_t)(Pos + 1);
+    if (Candidate == 0 || Pos - (Candidate - 1) > kMaxOffset ||
+        Read32(pData + Candidate - 1) != Value) {
+      ++Pos;
+      continue;
+    }
+    size_t Match = Candidate - 1;
+    size_t Length = kMinMatch;
+    while (Pos + Length < Size && pData[Match + Length] == pData[Pos + Length])
+      ++Length;
+    WriteSequence(pData + Anchor, Pos - Anchor, Length, Pos - Match,
+                  Compressed);
+    Pos += Length;
+    Anchor = Pos;
+  }
+  WriteSequence(pData + Anchor, Size - Anchor, 0, 0, Compressed);
+}
+
+bool DecompressLZ(const char *pCompressed, size_t Size,
+                  size_t DecompressedSize, std::vector<char> &Data) {
+  Data.clear();
+  // No byte of input expands to more than 255 bytes of output, so a larger
+  // size can't be right; reject it before reserving memory for it.
+  if (DecompressedSize / 255 > Size)
+    return false;
+  Data.reserve(DecompressedSize);
+  const unsigned char *p = (const unsigned char *)pCompressed;
+  const unsigned char *pEnd = p + Size;
+  while (p != pEnd) {
+    unsigned Token = *p++;
+    size_t LiteralCount = Token >> 4;
+    if (LiteralCount == 15 && !ReadLength(p, pEnd, LiteralCount))
+      return false;
+    if ((size_t)(pEnd - p) < LiteralCount ||
+        DecompressedSize - Data.size() < LiteralCount)
+      return false;
+    Data.insert(Data.end(), p, p + LiteralCount);
+    p += LiteralCount;
+    if (p == pEnd)
+      return (Token & 0xF) == 0 && Data.size() == DecompressedSize;
+
+    if (pEnd - p < 2)
+      return false;
+    size_t Offset = p[0] | ((size_t)p[1] << 8);
+    p += 2;
+    size_t MatchLength = Token & 0xF;
+    if (MatchLength == 15 && !ReadLength(p, pEnd, MatchLength))
+      return false;
+    MatchLength += kMinMatch;
+    if (Offset == 0 || Offset > Data.size() ||
+        DecompressedSize - Data.size() < MatchLength)
+      return false;
+    // Copied a byte at a time, as the match may overlap its own output.
+    size_t From = Data.size() - Offset;
+    for (size_t i = 0; i < MatchLength; ++i)
+      Data.push_back(Data[From + i]);
+  }
+  return false;
+}
+
+} // namespace hlsl
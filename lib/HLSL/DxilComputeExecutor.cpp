@@ -0,0 +1,1693 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilComputeExecutor.cpp                                                   //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Runs DXIL compute shaders on the CPU.                                     //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/HLSL/DxilComputeExecutor.h"
+#include "dxc/HLSL/DxilCBuffer.h"
+#include "dxc/HLSL/DxilInstructions.h"
+#include "dxc/HLSL/DxilModule.h"
+#include "dxc/HLSL/DxilOperations.h"
+#include "dxc/HLSL/DxilResource.h"
+#include "dxc/HLSL/DxilShaderModel.h"
+#include "dxc/Support/Global.h"
+#include "dxc/Support/WinIncludes.h"
+#include "llvm/ADT/APFloat.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/GetElementPtrTypeIterator.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Operator.h"
+#include "llvm/IR/TypeFinder.h"
+#include "llvm/Support/MathExtras.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+using namespace llvm;
+using namespace hlsl;
+
+namespace {
+
+hlsl::Exception NotSupported(const Twine &What) {
+  return hlsl::Exception(E_NOTIMPL,
+                         ("DXIL executor does not support " + What).str());
+}
+
+uint8_t *Bytes(std::vector<uint64_t> &Words) {
+  return reinterpret_cast<uint8_t *>(Words.data());
+}
+
+uint8_t *ToPointer(uint64_t Address) {
+  return reinterpret_cast<uint8_t *>(static_cast<uintptr_t>(Address));
+}
+
+uint64_t ToAddress(const void *P) {
+  return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(P));
+}
+
+uint64_t LoadScalar(const uint8_t *P, unsigned Size) {
+  uint64_t V = 0;
+  memcpy(&V, P, Size);
+  return V;
+}
+
+void StoreScalar(uint8_t *P, unsigned Size, uint64_t V) {
+  memcpy(P, &V, Size);
+}
+
+// Values are kept in 64 bits, zero-extended from the width of their type.
+uint64_t Truncate(Type *Ty, uint64_t V) {
+  unsigned Width = 64;
+  if (Ty->isIntegerTy())
+    Width = Ty->getIntegerBitWidth();
+  else if (Ty->isHalfTy())
+    Width = 16;
+  else if (Ty->isFloatTy())
+    Width = 32;
+  return Width < 64 ? V & ((1ULL << Width) - 1) : V;
+}
+
+int64_t SignExtend(Type *Ty, uint64_t V) {
+  unsigned Width = Ty->getIntegerBitWidth();
+  if (Width >= 64)
+    return static_cast<int64_t>(V);
+  return static_cast<int64_t>(V << (64 - Width)) >> (64 - Width);
+}
+
+float HalfToFloat(uint64_t V) {
+  APFloat F(APFloat::IEEEhalf, APInt(16, V & 0xFFFF));
+  bool LosesInfo;
+  F.convert(APFloat::IEEEsingle, APFloat::rmNearestTiesToEven, &LosesInfo);
+  return F.convertToFloat();
+}
+
+uint64_t FloatToHalf(float V) {
+  APFloat F(V);
+  bool LosesInfo;
+  F.convert(APFloat::IEEEhalf, APFloat::rmNearestTiesToEven, &LosesInfo);
+  return F.bitcastToAPInt().getZExtValue();
+}
+
+// Floating-point operations are evaluated in double precision. For the
+// basic arithmetic of float operands this rounds to the same result as
+// float arithmetic would.
+double ReadFP(Type *Ty, uint64_t V) {
+  if (Ty->isFloatTy())
+    return BitsToFloat(static_cast<uint32_t>(V));
+  if (Ty->isDoubleTy())
+    return BitsToDouble(V);
+  if (Ty->isHalfTy())
+    return HalfToFloat(V);
+  throw NotSupported("this floating-point type");
+}
+
+uint64_t WriteFP(Type *Ty, double D) {
+  if (Ty->isFloatTy())
+    return FloatToBits(static_cast<float>(D));
+  if (Ty->isDoubleTy())
+    return DoubleToBits(D);
+  if (Ty->isHalfTy())
+    return FloatToHalf(static_cast<float>(D));
+  throw NotSupported("this floating-point type");
+}
+
+uint64_t IntBinary(unsigned Opcode, Type *Ty, uint64_t A, uint64_t B) {
+  unsigned Width = Ty->getIntegerBitWidth();
+  switch (Opcode) {
+  case Instruction::Add:
+    return A + B;
+  case Instruction::Sub:
+    return A - B;
+  case Instruction::Mul:
+    return A * B;
+  case Instruction::UDiv:
+    return B ? A / B : ~0ULL;
+  case Instruction::URem:
+    return B ? A % B : ~0ULL;
+  case Instruction::SDiv: {
+    int64_t SA = SignExtend(Ty, A), SB = SignExtend(Ty, B);
+    if (SB == 0)
+      return ~0ULL;
+    if (SB == -1)
+      return 0 - static_cast<uint64_t>(SA);
+    return static_cast<uint64_t>(SA / SB);
+  }
+  case Instruction::SRem: {
+    int64_t SA = SignExtend(Ty, A), SB = SignExtend(Ty, B);
+    if (SB == 0)
+      return ~0ULL;
+    if (SB == -1)
+      return 0;
+    return static_cast<uint64_t>(SA % SB);
+  }
+  case Instruction::Shl:
+    return A << (B % Width);
+  case Instruction::LShr:
+    return A >> (B % Width);
+  case Instruction::AShr:
+    return static_cast<uint64_t>(SignExtend(Ty, A) >> (B % Width));
+  case Instruction::And:
+    return A & B;
+  case Instruction::Or:
+    return A | B;
+  case Instruction::Xor:
+    return A ^ B;
+  }
+  llvm_unreachable("not an integer binary operator");
+}
+
+double FloatBinary(unsigned Opcode, double A, double B) {
+  switch (Opcode) {
+  case Instruction::FAdd:
+    return A + B;
+  case Instruction::FSub:
+    return A - B;
+  case Instruction::FMul:
+    return A * B;
+  case Instruction::FDiv:
+    return A / B;
+  case Instruction::FRem:
+    return std::fmod(A, B);
+  }
+  llvm_unreachable("not a floating-point binary operator");
+}
+
+bool CompareInt(CmpInst::Predicate P, Type *Ty, uint64_t A, uint64_t B) {
+  switch (P) {
+  case CmpInst::ICMP_EQ:
+    return A == B;
+  case CmpInst::ICMP_NE:
+    return A != B;
+  case CmpInst::ICMP_UGT:
+    return A > B;
+  case CmpInst::ICMP_UGE:
+    return A >= B;
+  case CmpInst::ICMP_ULT:
+    return A < B;
+  case CmpInst::ICMP_ULE:
+    return A <= B;
+  case CmpInst::ICMP_SGT:
+    return SignExtend(Ty, A) > SignExtend(Ty, B);
+  case CmpInst::ICMP_SGE:
+    return SignExtend(Ty, A) >= SignExtend(Ty, B);
+  case CmpInst::ICMP_SLT:
+    return SignExtend(Ty, A) < SignExtend(Ty, B);
+  case CmpInst::ICMP_SLE:
+    return SignExtend(Ty, A) <= SignExtend(Ty, B);
+  default:
+    llvm_unreachable("not an integer predicate");
+  }
+}
+
+bool CompareFloat(CmpInst::Predicate P, double A, double B) {
+  bool Unordered = std::isnan(A) || std::isnan(B);
+  switch (P) {
+  case CmpInst::FCMP_FALSE:
+    return false;
+  case CmpInst::FCMP_OEQ:
+    return !Unordered && A == B;
+  case CmpInst::FCMP_OGT:
+    return !Unordered && A > B;
+  case CmpInst::FCMP_OGE:
+    return !Unordered && A >= B;
+  case CmpInst::FCMP_OLT:
+    return !Unordered && A < B;
+  case CmpInst::FCMP_OLE:
+    return !Unordered && A <= B;
+  case CmpInst::FCMP_ONE:
+    return !Unordered && A != B;
+  case CmpInst::FCMP_ORD:
+    return !Unordered;
+  case CmpInst::FCMP_UNO:
+    return Unordered;
+  case CmpInst::FCMP_UEQ:
+    return Unordered || A == B;
+  case CmpInst::FCMP_UGT:
+    return Unordered || A > B;
+  case CmpInst::FCMP_UGE:
+    return Unordered || A >= B;
+  case CmpInst::FCMP_ULT:
+    return Unordered || A < B;
+  case CmpInst::FCMP_ULE:
+    return Unordered || A <= B;
+  case CmpInst::FCMP_UNE:
+    return Unordered || A != B;
+  case CmpInst::FCMP_TRUE:
+    return true;
+  default:
+    llvm_unreachable("not a floating-point predicate");
+  }
+}
+
+// Float to integer conversions saturate, and NaN converts to zero.
+uint64_t FloatToInt(double D, Type *Ty, bool Signed) {
+  unsigned Width = Ty->getIntegerBitWidth();
+  if (std::isnan(D))
+    return 0;
+  if (Signed) {
+    double Limit = std::ldexp(1.0, Width - 1);
+    if (D <= -Limit)
+      return Truncate(Ty, 1ULL << (Width - 1));
+    if (D >= Limit)
+      return Truncate(Ty, (1ULL << (Width - 1)) - 1);
+    return Truncate(Ty, static_cast<uint64_t>(static_cast<int64_t>(D)));
+  }
+  if (D <= 0)
+    return 0;
+  if (D >= std::ldexp(1.0, Width))
+    return Truncate(Ty, ~0ULL);
+  return static_cast<uint64_t>(D);
+}
+
+// Atomically replaces the value at P with Update(old value) and returns the
+// old value.
+template <typename UpdateFn>
+uint64_t AtomicUpdate(uint8_t *P, unsigned Size, UpdateFn Update) {
+  if (Size == 4) {
+    volatile LONG *Target = reinterpret_cast<volatile LONG *>(P);
+    LONG Old = *Target;
+    for (;;) {
+      uint32_t Prev = static_cast<uint32_t>(Old);
+      LONG New = static_cast<LONG>(static_cast<uint32_t>(Update(Prev)));
+      LONG Seen = InterlockedCompareExchange(Target, New, Old);
+      if (Seen == Old)
+        return Prev;
+      Old = Seen;
+    }
+  }
+  if (Size == 8) {
+    volatile LONGLONG *Target = reinterpret_cast<volatile LONGLONG *>(P);
+    LONGLONG Old = *Target;
+    for (;;) {
+      uint64_t Prev = static_cast<uint64_t>(Old);
+      LONGLONG New = static_cast<LONGLONG>(Update(Prev));
+      LONGLONG Seen = InterlockedCompareExchange64(Target, New, Old);
+      if (Seen == Old)
+        return Prev;
+      Old = Seen;
+    }
+  }
+  throw NotSupported("atomic operations on values of this size");
+}
+
+uint64_t ApplyAtomicBinOp(DXIL::AtomicBinOpCode Op, Type *Ty, uint64_t Old,
+                          uint64_t V) {
+  switch (Op) {
+  case DXIL::AtomicBinOpCode::Add:
+    return Old + V;
+  case DXIL::AtomicBinOpCode::And:
+    return Old & V;
+  case DXIL::AtomicBinOpCode::Or:
+    return Old | V;
+  case DXIL::AtomicBinOpCode::Xor:
+    return Old ^ V;
+  case DXIL::AtomicBinOpCode::IMin:
+    return SignExtend(Ty, Old) < SignExtend(Ty, V) ? Old : V;
+  case DXIL::AtomicBinOpCode::IMax:
+    return SignExtend(Ty, Old) > SignExtend(Ty, V) ? Old : V;
+  case DXIL::AtomicBinOpCode::UMin:
+    return Old < V ? Old : V;
+  case DXIL::AtomicBinOpCode::UMax:
+    return Old > V ? Old : V;
+  case DXIL::AtomicBinOpCode::Exchange:
+    return V;
+  default:
+    throw NotSupported("this atomic operation");
+  }
+}
+
+uint64_t ApplyAtomicRMW(AtomicRMWInst::BinOp Op, Type *Ty, uint64_t Old,
+                        uint64_t V) {
+  switch (Op) {
+  case AtomicRMWInst::Xchg:
+    return V;
+  case AtomicRMWInst::Add:
+    return Old + V;
+  case AtomicRMWInst::Sub:
+    return Old - V;
+  case AtomicRMWInst::And:
+    return Old & V;
+  case AtomicRMWInst::Nand:
+    return ~(Old & V);
+  case AtomicRMWInst::Or:
+    return Old | V;
+  case AtomicRMWInst::Xor:
+    return Old ^ V;
+  case AtomicRMWInst::Max:
+    return SignExtend(Ty, Old) > SignExtend(Ty, V) ? Old : V;
+  case AtomicRMWInst::Min:
+    return SignExtend(Ty, Old) < SignExtend(Ty, V) ? Old : V;
+  case AtomicRMWInst::UMax:
+    return Old > V ? Old : V;
+  case AtomicRMWInst::UMin:
+    return Old < V ? Old : V;
+  default:
+    throw NotSupported("this atomicrmw operation");
+  }
+}
+
+uint64_t CombineWaveValues(DXIL::WaveOpKind Kind, bool Unsigned, Type *Ty,
+                           uint64_t A, uint64_t B) {
+  if (Ty->isFloatingPointTy()) {
+    double X = ReadFP(Ty, A), Y = ReadFP(Ty, B);
+    switch (Kind) {
+    case DXIL::WaveOpKind::Sum:
+      return WriteFP(Ty, X + Y);
+    case DXIL::WaveOpKind::Product:
+      return WriteFP(Ty, X * Y);
+    case DXIL::WaveOpKind::Min:
+      return WriteFP(Ty, std::fmin(X, Y));
+    case DXIL::WaveOpKind::Max:
+      return WriteFP(Ty, std::fmax(X, Y));
+    }
+  } else {
+    bool Less = Unsigned ? A < B : SignExtend(Ty, A) < SignExtend(Ty, B);
+    switch (Kind) {
+    case DXIL::WaveOpKind::Sum:
+      return A + B;
+    case DXIL::WaveOpKind::Product:
+      return A * B;
+    case DXIL::WaveOpKind::Min:
+      return Less ? A : B;
+    case DXIL::WaveOpKind::Max:
+      return Less ? B : A;
+    }
+  }
+  throw NotSupported("this wave operation kind");
+}
+
+// The value prefix operations give the first active lane.
+uint64_t WavePrefixIdentity(DXIL::WaveOpKind Kind, Type *Ty) {
+  switch (Kind) {
+  case DXIL::WaveOpKind::Sum:
+    return Ty->isFloatingPointTy() ? WriteFP(Ty, 0.0) : 0;
+  case DXIL::WaveOpKind::Product:
+    return Ty->isFloatingPointTy() ? WriteFP(Ty, 1.0) : 1;
+  default:
+    throw NotSupported("prefix minimum or maximum");
+  }
+}
+
+uint64_t CombineWaveBits(DXIL::WaveBitOpKind Kind, uint64_t A, uint64_t B) {
+  switch (Kind) {
+  case DXIL::WaveBitOpKind::And:
+    return A & B;
+  case DXIL::WaveBitOpKind::Or:
+    return A | B;
+  case DXIL::WaveBitOpKind::Xor:
+    return A ^ B;
+  }
+  throw NotSupported("this wave bit operation kind");
+}
+
+// Bit index of the highest set bit counted from the most significant bit,
+// or ~0 if no bit is set.
+uint64_t FirstBitHigh(uint64_t V, unsigned Width) {
+  if (V == 0)
+    return ~0ULL;
+  return countLeadingZeros(V) - (64 - Width);
+}
+
+} // namespace
+
+namespace hlsl {
+
+class DxilComputeExecutor::Impl {
+public:
+  explicit Impl(DxilModule &DM);
+
+  void Bind(DXIL::ResourceClass Class, unsigned Space, unsigned Reg,
+            void *pData, size_t Size);
+  void SetWorkerCount(unsigned Count) { m_WorkerCount = Count; }
+  void SetWaveSize(unsigned Size);
+  void Dispatch(unsigned X, unsigned Y, unsigned Z);
+
+private:
+  typedef std::tuple<unsigned, unsigned, unsigned> ResourceKey;
+
+  struct Binding {
+    uint8_t *Data;
+    size_t Size;
+  };
+
+  // A bound resource, as a handle from CreateHandle refers to it.
+  struct ResourceView {
+    uint8_t *Data;
+    size_t Size;
+    DXIL::ResourceKind Kind;
+    unsigned Stride;     // Element size of structured and typed buffers.
+    unsigned Components; // Components of a typed buffer element.
+  };
+
+  struct GlobalInfo {
+    enum StorageKind { Constant, Shared, Private } Storage;
+    uint64_t Offset;
+  };
+
+  enum class ThreadState { Running, AtBarrier, AtWaveOp, Done };
+
+  struct Thread {
+    unsigned Id[3];
+    unsigned Index; // Flattened thread ID in the group.
+    BasicBlock *BB;
+    BasicBlock::iterator It;
+    ThreadState State;
+    CallInst *WaveOp; // The wave operation the thread waits at.
+    std::vector<uint64_t> Slots;
+    std::vector<uint64_t> Private;
+    std::vector<std::unique_ptr<uint64_t[]>> Stack;
+  };
+
+  struct Group {
+    unsigned Id[3];
+    std::vector<uint64_t> Shared;
+    std::vector<Thread> Threads;
+  };
+
+  DxilModule &m_DM;
+  const DataLayout &m_DL;
+  Function *m_pEntry;
+  unsigned m_NumThreads[3];
+  unsigned m_WorkerCount;
+  unsigned m_WaveSize;
+
+  // Results of an instruction start at its slot; aggregates take one slot
+  // per element.
+  DenseMap<const Instruction *, unsigned> m_SlotOf;
+  unsigned m_SlotCount;
+
+  DenseMap<const GlobalVariable *, GlobalInfo> m_Globals;
+  std::vector<uint64_t> m_ConstantData;
+  std::vector<uint64_t> m_PrivateInit;
+  size_t m_SharedWords;
+
+  std::map<ResourceKey, Binding> m_Bindings; // By class, space and register.
+  std::map<ResourceKey, ResourceView> m_Views; // By class, ID and register.
+
+  void NumberSlots();
+  void LayoutGlobals();
+  void ComputeStructLayouts();
+  void WriteConstant(Constant *C, uint8_t *P);
+  void PrepareViews();
+  const DxilResourceBase &GetResource(DXIL::ResourceClass Class,
+                                      unsigned ID);
+
+  void RunGroup(Group &G);
+  bool RunWaveOps(Group &G);
+  void ExecuteWaveOp(CallInst *CI, ArrayRef<Thread *> Lanes, Group &G);
+  void Run(Thread &T, Group &G);
+  void Jump(Thread &T, Group &G, BasicBlock *To);
+  void Execute(Instruction *I, Thread &T, Group &G);
+  bool ExecuteDxilOp(CallInst *CI, Thread &T, Group &G);
+  uint64_t ExecuteGEP(GetElementPtrInst *GEP, Thread &T, Group &G);
+
+  void BufferLoad(CallInst *CI, Thread &T, Group &G);
+  void BufferStore(CallInst *CI, Thread &T, Group &G);
+  void CBufferLoadLegacy(CallInst *CI, Thread &T, Group &G);
+  uint64_t AtomicBinOp(CallInst *CI, Thread &T, Group &G);
+  uint64_t AtomicCompareExchange(CallInst *CI, Thread &T, Group &G);
+
+  unsigned Slot(const Instruction *I) const {
+    return m_SlotOf.find(I)->second;
+  }
+  uint64_t Get(Value *V, Thread &T, Group &G, unsigned Elt = 0);
+  uint64_t GlobalAddress(GlobalVariable *GV, Thread &T, Group &G);
+  const ResourceView &GetView(Value *Handle, Thread &T, Group &G) {
+    return *reinterpret_cast<const ResourceView *>(
+        static_cast<uintptr_t>(Get(Handle, T, G)));
+  }
+  uint64_t ViewOffset(const ResourceView &View, uint64_t Coord0,
+                      uint64_t Coord1) const;
+  static bool InBounds(const ResourceView &View, uint64_t Offset,
+                       unsigned Size) {
+    return Size <= View.Size && Offset <= View.Size - Size;
+  }
+};
+
+DxilComputeExecutor::Impl::Impl(DxilModule &DM)
+    : m_DM(DM), m_DL(DM.GetModule()->getDataLayout()),
+      m_pEntry(DM.GetEntryFunction()), m_WorkerCount(0), m_WaveSize(32),
+      m_SlotCount(0),
+      m_SharedWords(0) {
+  if (!DM.GetShaderModel()->IsCS())
+    throw hlsl::Exception(E_INVALIDARG,
+                          "DXIL executor only runs compute shaders");
+  if (!m_pEntry || m_pEntry->isDeclaration())
+    throw hlsl::Exception(E_INVALIDARG, "DXIL module has no entry function");
+  for (unsigned i = 0; i < 3; ++i)
+    m_NumThreads[i] = DM.m_NumThreads[i];
+  NumberSlots();
+  LayoutGlobals();
+  ComputeStructLayouts();
+}
+
+void DxilComputeExecutor::Impl::NumberSlots() {
+  for (BasicBlock &BB : *m_pEntry) {
+    for (Instruction &I : BB) {
+      Type *Ty = I.getType();
+      if (Ty->isVoidTy())
+        continue;
+      if (Ty->isVectorTy() || Ty->isArrayTy())
+        throw NotSupported("values of vector or array type");
+      m_SlotOf[&I] = m_SlotCount;
+      m_SlotCount += Ty->isStructTy() ? Ty->getStructNumElements() : 1;
+    }
+  }
+}
+
+// The DataLayout computes struct layouts on first use and caches them, and
+// structs cache whether they are sized, without locking either. Dispatch
+// workers share both, so every struct is laid out before any of them runs.
+void DxilComputeExecutor::Impl::ComputeStructLayouts() {
+  TypeFinder StructTypes;
+  StructTypes.run(*m_DM.GetModule(), /*onlyNamed*/ false);
+  for (StructType *ST : StructTypes) {
+    if (ST->isSized())
+      m_DL.getStructLayout(ST);
+  }
+}
+
+// Constant globals are shared by all threads, groupshared ones get fresh
+// storage for each group and other static globals for each thread.
+void DxilComputeExecutor::Impl::LayoutGlobals() {
+  uint64_t Sizes[3] = {0, 0, 0};
+  for (GlobalVariable &GV : m_DM.GetModule()->globals()) {
+    Type *Ty = GV.getType()->getElementType();
+    if (GV.use_empty() || !Ty->isSized())
+      continue;
+    GlobalInfo Info;
+    if (GV.getType()->getAddressSpace() == DXIL::kTGSMAddrSpace)
+      Info.Storage = GlobalInfo::Shared;
+    else if (GV.isConstant())
+      Info.Storage = GlobalInfo::Constant;
+    else
+      Info.Storage = GlobalInfo::Private;
+    uint64_t &Size = Sizes[Info.Storage];
+    Info.Offset = RoundUpToAlignment(Size, m_DL.getPreferredAlignment(&GV));
+    Size = Info.Offset + m_DL.getTypeAllocSize(Ty);
+    m_Globals[&GV] = Info;
+  }
+
+  m_ConstantData.resize((Sizes[GlobalInfo::Constant] + 7) / 8);
+  m_PrivateInit.resize((Sizes[GlobalInfo::Private] + 7) / 8);
+  m_SharedWords = (Sizes[GlobalInfo::Shared] + 7) / 8;
+  for (auto &Entry : m_Globals) {
+    const GlobalVariable *GV = Entry.first;
+    const GlobalInfo &Info = Entry.second;
+    if (Info.Storage == GlobalInfo::Shared || !GV->hasInitializer())
+      continue;
+    std::vector<uint64_t> &Data = Info.Storage == GlobalInfo::Constant
+                                      ? m_ConstantData
+                                      : m_PrivateInit;
+    WriteConstant(const_cast<Constant *>(GV->getInitializer()),
+                  Bytes(Data) + Info.Offset);
+  }
+}
+
+void DxilComputeExecutor::Impl::WriteConstant(Constant *C, uint8_t *P) {
+  // The storage starts out zeroed.
+  if (isa<UndefValue>(C) || isa<ConstantAggregateZero>(C) ||
+      isa<ConstantPointerNull>(C))
+    return;
+  Type *Ty = C->getType();
+  if (ConstantInt *CI = dyn_cast<ConstantInt>(C)) {
+    StoreScalar(P, m_DL.getTypeStoreSize(Ty), CI->getZExtValue());
+  } else if (ConstantFP *CFP = dyn_cast<ConstantFP>(C)) {
+    StoreScalar(P, m_DL.getTypeStoreSize(Ty),
+                CFP->getValueAPF().bitcastToAPInt().getZExtValue());
+  } else if (ConstantDataSequential *CDS =
+                 dyn_cast<ConstantDataSequential>(C)) {
+    uint64_t EltSize = m_DL.getTypeAllocSize(CDS->getElementType());
+    for (unsigned i = 0, e = CDS->getNumElements(); i < e; ++i)
+      WriteConstant(CDS->getElementAsConstant(i), P + i * EltSize);
+  } else if (ConstantArray *CA = dyn_cast<ConstantArray>(C)) {
+    uint64_t EltSize = m_DL.getTypeAllocSize(Ty->getArrayElementType());
+    for (unsigned i = 0, e = CA->getNumOperands(); i < e; ++i)
+      WriteConstant(CA->getOperand(i), P + i * EltSize);
+  } else if (ConstantStruct *CS = dyn_cast<ConstantStruct>(C)) {
+    const StructLayout *SL = m_DL.getStructLayout(CS->getType());
+    for (unsigned i = 0, e = CS->getNumOperands(); i < e; ++i)
+      WriteConstant(CS->getOperand(i), P + SL->getElementOffset(i));
+  } else {
+    throw NotSupported("this global initializer");
+  }
+}
+
+void DxilComputeExecutor::Impl::SetWaveSize(unsigned Size) {
+  if (Size < 4 || Size > 128 || !isPowerOf2_32(Size))
+    throw hlsl::Exception(E_INVALIDARG,
+                          "wave size must be a power of two from 4 to 128");
+  m_WaveSize = Size;
+}
+
+void DxilComputeExecutor::Impl::Bind(DXIL::ResourceClass Class,
+                                     unsigned Space, unsigned Reg,
+                                     void *pData, size_t Size) {
+  Binding &B = m_Bindings[ResourceKey((unsigned)Class, Space, Reg)];
+  B.Data = static_cast<uint8_t *>(pData);
+  B.Size = Size;
+}
+
+void DxilComputeExecutor::Impl::PrepareViews() {
+  m_Views.clear();
+  for (auto &Entry : m_Bindings) {
+    DXIL::ResourceClass Class = (DXIL::ResourceClass)std::get<0>(Entry.first);
+    unsigned Space = std::get<1>(Entry.first);
+    unsigned Reg = std::get<2>(Entry.first);
+
+    ResourceView View;
+    View.Data = Entry.second.Data;
+    View.Size = Entry.second.Size;
+    View.Stride = 0;
+    View.Components = 0;
+
+    if (Class == DXIL::ResourceClass::CBuffer) {
+      for (auto &CB : m_DM.GetCBuffers()) {
+        if (CB->GetSpaceID() != Space || Reg < CB->GetLowerBound() ||
+            Reg > CB->GetUpperBound())
+          continue;
+        View.Kind = DXIL::ResourceKind::CBuffer;
+        m_Views[ResourceKey((unsigned)Class, CB->GetID(), Reg)] = View;
+      }
+      continue;
+    }
+
+    const std::vector<std::unique_ptr<DxilResource>> &Resources =
+        Class == DXIL::ResourceClass::UAV ? m_DM.GetUAVs() : m_DM.GetSRVs();
+    for (auto &Res : Resources) {
+      if (Res->GetSpaceID() != Space || Reg < Res->GetLowerBound() ||
+          Reg > Res->GetUpperBound())
+        continue;
+      View.Kind = Res->GetKind();
+      if (Res->IsStructuredBuffer()) {
+        View.Stride = Res->GetElementStride();
+      } else if (Res->IsTypedBuffer()) {
+        Type *RetTy = Res->GetRetType();
+        View.Components =
+            RetTy->isVectorTy() ? RetTy->getVectorNumElements() : 1;
+        View.Stride = View.Components *
+                      m_DL.getTypeStoreSize(RetTy->getScalarType());
+      }
+      m_Views[ResourceKey((unsigned)Class, Res->GetID(), Reg)] = View;
+    }
+  }
+}
+
+const DxilResourceBase &
+DxilComputeExecutor::Impl::GetResource(DXIL::ResourceClass Class,
+                                       unsigned ID) {
+  switch (Class) {
+  case DXIL::ResourceClass::UAV:
+    return m_DM.GetUAV(ID);
+  case DXIL::ResourceClass::SRV:
+    return m_DM.GetSRV(ID);
+  case DXIL::ResourceClass::CBuffer:
+    return m_DM.GetCBuffer(ID);
+  default:
+    throw NotSupported("samplers");
+  }
+}
+
+void DxilComputeExecutor::Impl::Dispatch(unsigned X, unsigned Y,
+                                         unsigned Z) {
+  PrepareViews();
+  const uint64_t GroupCount = (uint64_t)X * Y * Z;
+  if (GroupCount == 0)
+    return;
+
+  std::atomic<uint64_t> NextGroup(0);
+  std::atomic<bool> Failed(false);
+  std::exception_ptr Error;
+  std::mutex ErrorLock;
+  auto Worker = [&]() {
+    Group G;
+    try {
+      for (;;) {
+        uint64_t Index = NextGroup++;
+        if (Index >= GroupCount || Failed)
+          return;
+        G.Id[0] = (unsigned)(Index % X);
+        G.Id[1] = (unsigned)(Index / X % Y);
+        G.Id[2] = (unsigned)(Index / X / Y);
+        RunGroup(G);
+      }
+    } catch (...) {
+      std::lock_guard<std::mutex> Lock(ErrorLock);
+      if (!Error)
+        Error = std::current_exception();
+      Failed = true;
+    }
+  };
+
+  unsigned Workers = m_WorkerCount;
+  if (Workers == 0)
+    Workers = std::max(1U, std::thread::hardware_concurrency());
+  if ((uint64_t)Workers > GroupCount)
+    Workers = (unsigned)GroupCount;
+  if (Workers == 1) {
+    Worker();
+  } else {
+    std::vector<std::thread> Threads;
+    for (unsigned i = 0; i < Workers; ++i)
+      Threads.emplace_back(Worker);
+    for (std::thread &Th : Threads)
+      Th.join();
+  }
+  if (Error)
+    std::rethrow_exception(Error);
+}
+
+// Runs every thread of the group until it returns, or stops at a group
+// barrier or a wave operation. Once all of them have stopped, the waiting
+// wave operations run, and only when there are none left do the threads
+// at the barrier resume.
+void DxilComputeExecutor::Impl::RunGroup(Group &G) {
+  G.Shared.assign(m_SharedWords, 0);
+  G.Threads.resize(m_NumThreads[0] * m_NumThreads[1] * m_NumThreads[2]);
+  unsigned Index = 0;
+  for (unsigned z = 0; z < m_NumThreads[2]; ++z) {
+    for (unsigned y = 0; y < m_NumThreads[1]; ++y) {
+      for (unsigned x = 0; x < m_NumThreads[0]; ++x) {
+        Thread &T = G.Threads[Index++];
+        T.Id[0] = x;
+        T.Id[1] = y;
+        T.Id[2] = z;
+        T.Index = Index - 1;
+        T.BB = &m_pEntry->getEntryBlock();
+        T.It = T.BB->begin();
+        T.State = ThreadState::Running;
+        T.WaveOp = nullptr;
+        T.Slots.resize(m_SlotCount);
+        T.Private = m_PrivateInit;
+        T.Stack.clear();
+      }
+    }
+  }
+
+  for (;;) {
+    for (Thread &T : G.Threads) {
+      if (T.State == ThreadState::Running)
+        Run(T, G);
+    }
+    if (RunWaveOps(G))
+      continue;
+    bool AtBarrier = false;
+    for (Thread &T : G.Threads) {
+      if (T.State == ThreadState::AtBarrier) {
+        T.State = ThreadState::Running;
+        AtBarrier = true;
+      }
+    }
+    if (!AtBarrier)
+      return;
+  }
+}
+
+// Runs the wave operations the threads wait at. The active lanes of an
+// operation are the lanes of the wave waiting at the same instruction, so
+// lanes that took different paths run their operations apart. Returns
+// false if no thread waited at one.
+bool DxilComputeExecutor::Impl::RunWaveOps(Group &G) {
+  bool Ran = false;
+  SmallVector<Thread *, 128> Lanes;
+  for (size_t Base = 0; Base < G.Threads.size(); Base += m_WaveSize) {
+    size_t End = std::min(Base + m_WaveSize, G.Threads.size());
+    for (size_t First = Base; First < End; ++First) {
+      if (G.Threads[First].State != ThreadState::AtWaveOp)
+        continue;
+      CallInst *CI = G.Threads[First].WaveOp;
+      Lanes.clear();
+      for (size_t i = First; i < End; ++i) {
+        Thread &T = G.Threads[i];
+        if (T.State == ThreadState::AtWaveOp && T.WaveOp == CI)
+          Lanes.push_back(&T);
+      }
+      ExecuteWaveOp(CI, Lanes, G);
+      for (Thread *T : Lanes) {
+        T->State = ThreadState::Running;
+        T->WaveOp = nullptr;
+      }
+      Ran = true;
+    }
+  }
+  return Ran;
+}
+
+void DxilComputeExecutor::Impl::Run(Thread &T, Group &G) {
+  for (;;) {
+    Instruction *I = &*T.It++;
+    switch (I->getOpcode()) {
+    case Instruction::Br: {
+      BranchInst *BI = cast<BranchInst>(I);
+      BasicBlock *To = BI->getSuccessor(0);
+      if (BI->isConditional() && !Get(BI->getCondition(), T, G))
+        To = BI->getSuccessor(1);
+      Jump(T, G, To);
+      break;
+    }
+    case Instruction::Switch: {
+      SwitchInst *SI = cast<SwitchInst>(I);
+      uint64_t V = Get(SI->getCondition(), T, G);
+      BasicBlock *To = SI->getDefaultDest();
+      for (auto Case : SI->cases()) {
+        if (Case.getCaseValue()->getZExtValue() == V) {
+          To = Case.getCaseSuccessor();
+          break;
+        }
+      }
+      Jump(T, G, To);
+      break;
+    }
+    case Instruction::Ret:
+      T.State = ThreadState::Done;
+      return;
+    case Instruction::Unreachable:
+      throw hlsl::Exception(E_FAIL, "DXIL executor reached unreachable code");
+    case Instruction::Call:
+      if (isa<DbgInfoIntrinsic>(I))
+        break;
+      if (ExecuteDxilOp(cast<CallInst>(I), T, G))
+        return;
+      break;
+    default:
+      Execute(I, T, G);
+      break;
+    }
+  }
+}
+
+void DxilComputeExecutor::Impl::Jump(Thread &T, Group &G, BasicBlock *To) {
+  // Phi nodes take their values together, as of the end of the old block.
+  SmallVector<std::pair<unsigned, uint64_t>, 8> Incoming;
+  BasicBlock::iterator It = To->begin();
+  while (PHINode *Phi = dyn_cast<PHINode>(&*It)) {
+    Incoming.push_back(std::make_pair(
+        Slot(Phi), Get(Phi->getIncomingValueForBlock(T.BB), T, G)));
+    ++It;
+  }
+  for (auto &In : Incoming)
+    T.Slots[In.first] = In.second;
+  T.BB = To;
+  T.It = It;
+}
+
+uint64_t DxilComputeExecutor::Impl::Get(Value *V, Thread &T, Group &G,
+                                        unsigned Elt) {
+  if (Instruction *I = dyn_cast<Instruction>(V))
+    return T.Slots[Slot(I) + Elt];
+  if (ConstantInt *CI = dyn_cast<ConstantInt>(V))
+    return CI->getZExtValue();
+  if (ConstantFP *CFP = dyn_cast<ConstantFP>(V))
+    return CFP->getValueAPF().bitcastToAPInt().getZExtValue();
+  if (isa<UndefValue>(V) || isa<ConstantAggregateZero>(V) ||
+      isa<ConstantPointerNull>(V))
+    return 0;
+  if (ConstantStruct *CS = dyn_cast<ConstantStruct>(V))
+    return Get(CS->getOperand(Elt), T, G);
+  if (GlobalVariable *GV = dyn_cast<GlobalVariable>(V))
+    return GlobalAddress(GV, T, G);
+  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(V)) {
+    switch (CE->getOpcode()) {
+    case Instruction::GetElementPtr: {
+      GEPOperator *GEP = cast<GEPOperator>(CE);
+      APInt Offset(64, 0);
+      if (!GEP->accumulateConstantOffset(m_DL, Offset))
+        break;
+      return Get(GEP->getPointerOperand(), T, G) + Offset.getSExtValue();
+    }
+    case Instruction::BitCast:
+    case Instruction::AddrSpaceCast:
+      return Get(CE->getOperand(0), T, G);
+    }
+    throw NotSupported(Twine("constant expression ") + CE->getOpcodeName());
+  }
+  throw NotSupported("this kind of operand");
+}
+
+uint64_t DxilComputeExecutor::Impl::GlobalAddress(GlobalVariable *GV,
+                                                  Thread &T, Group &G) {
+  auto It = m_Globals.find(GV);
+  if (It == m_Globals.end())
+    throw NotSupported(Twine("global ") + GV->getName());
+  switch (It->second.Storage) {
+  case GlobalInfo::Constant:
+    return ToAddress(Bytes(m_ConstantData) + It->second.Offset);
+  case GlobalInfo::Shared:
+    return ToAddress(Bytes(G.Shared) + It->second.Offset);
+  default:
+    return ToAddress(Bytes(T.Private) + It->second.Offset);
+  }
+}
+
+uint64_t DxilComputeExecutor::Impl::ExecuteGEP(GetElementPtrInst *GEP,
+                                               Thread &T, Group &G) {
+  uint64_t Address = Get(GEP->getPointerOperand(), T, G);
+  for (gep_type_iterator GTI = gep_type_begin(GEP), E = gep_type_end(GEP);
+       GTI != E; ++GTI) {
+    Value *Idx = GTI.getOperand();
+    if (StructType *ST = dyn_cast<StructType>(*GTI)) {
+      unsigned Field = (unsigned)cast<ConstantInt>(Idx)->getZExtValue();
+      Address += m_DL.getStructLayout(ST)->getElementOffset(Field);
+    } else {
+      int64_t Index = SignExtend(Idx->getType(), Get(Idx, T, G));
+      Address += Index * (int64_t)m_DL.getTypeAllocSize(GTI.getIndexedType());
+    }
+  }
+  return Address;
+}
+
+void DxilComputeExecutor::Impl::Execute(Instruction *I, Thread &T,
+                                        Group &G) {
+  Type *Ty = I->getType();
+  uint64_t R;
+  switch (I->getOpcode()) {
+  case Instruction::Add:
+  case Instruction::Sub:
+  case Instruction::Mul:
+  case Instruction::UDiv:
+  case Instruction::SDiv:
+  case Instruction::URem:
+  case Instruction::SRem:
+  case Instruction::Shl:
+  case Instruction::LShr:
+  case Instruction::AShr:
+  case Instruction::And:
+  case Instruction::Or:
+  case Instruction::Xor:
+    R = IntBinary(I->getOpcode(), Ty, Get(I->getOperand(0), T, G),
+                  Get(I->getOperand(1), T, G));
+    break;
+  case Instruction::FAdd:
+  case Instruction::FSub:
+  case Instruction::FMul:
+  case Instruction::FDiv:
+  case Instruction::FRem:
+    R = WriteFP(Ty, FloatBinary(I->getOpcode(),
+                                ReadFP(Ty, Get(I->getOperand(0), T, G)),
+                                ReadFP(Ty, Get(I->getOperand(1), T, G))));
+    break;
+  case Instruction::ICmp: {
+    ICmpInst *Cmp = cast<ICmpInst>(I);
+    R = CompareInt(Cmp->getPredicate(), Cmp->getOperand(0)->getType(),
+                   Get(Cmp->getOperand(0), T, G),
+                   Get(Cmp->getOperand(1), T, G));
+    break;
+  }
+  case Instruction::FCmp: {
+    FCmpInst *Cmp = cast<FCmpInst>(I);
+    Type *OpTy = Cmp->getOperand(0)->getType();
+    R = CompareFloat(Cmp->getPredicate(),
+                     ReadFP(OpTy, Get(Cmp->getOperand(0), T, G)),
+                     ReadFP(OpTy, Get(Cmp->getOperand(1), T, G)));
+    break;
+  }
+  case Instruction::Select: {
+    SelectInst *SI = cast<SelectInst>(I);
+    R = Get(SI->getCondition(), T, G) ? Get(SI->getTrueValue(), T, G)
+                                      : Get(SI->getFalseValue(), T, G);
+    break;
+  }
+  case Instruction::Trunc:
+  case Instruction::ZExt:
+  case Instruction::BitCast:
+  case Instruction::PtrToInt:
+  case Instruction::IntToPtr:
+  case Instruction::AddrSpaceCast:
+    R = Get(I->getOperand(0), T, G);
+    break;
+  case Instruction::SExt:
+    R = SignExtend(I->getOperand(0)->getType(), Get(I->getOperand(0), T, G));
+    break;
+  case Instruction::FPToUI:
+  case Instruction::FPToSI:
+    R = FloatToInt(ReadFP(I->getOperand(0)->getType(),
+                          Get(I->getOperand(0), T, G)),
+                   Ty, I->getOpcode() == Instruction::FPToSI);
+    break;
+  case Instruction::UIToFP:
+    R = WriteFP(Ty, (double)Get(I->getOperand(0), T, G));
+    break;
+  case Instruction::SIToFP:
+    R = WriteFP(Ty, (double)SignExtend(I->getOperand(0)->getType(),
+                                       Get(I->getOperand(0), T, G)));
+    break;
+  case Instruction::FPTrunc:
+  case Instruction::FPExt:
+    R = WriteFP(Ty, ReadFP(I->getOperand(0)->getType(),
+                           Get(I->getOperand(0), T, G)));
+    break;
+  case Instruction::Load: {
+    LoadInst *LI = cast<LoadInst>(I);
+    R = LoadScalar(ToPointer(Get(LI->getPointerOperand(), T, G)),
+                   m_DL.getTypeStoreSize(Ty));
+    break;
+  }
+  case Instruction::Store: {
+    StoreInst *SI = cast<StoreInst>(I);
+    Value *V = SI->getValueOperand();
+    StoreScalar(ToPointer(Get(SI->getPointerOperand(), T, G)),
+                m_DL.getTypeStoreSize(V->getType()), Get(V, T, G));
+    return;
+  }
+  case Instruction::GetElementPtr:
+    R = ExecuteGEP(cast<GetElementPtrInst>(I), T, G);
+    break;
+  case Instruction::Alloca: {
+    AllocaInst *AI = cast<AllocaInst>(I);
+    uint64_t Size = m_DL.getTypeAllocSize(AI->getAllocatedType()) *
+                    cast<ConstantInt>(AI->getArraySize())->getZExtValue();
+    T.Stack.emplace_back(new uint64_t[(Size + 7) / 8]());
+    R = ToAddress(T.Stack.back().get());
+    break;
+  }
+  case Instruction::AtomicRMW: {
+    AtomicRMWInst *RMW = cast<AtomicRMWInst>(I);
+    uint64_t V = Get(RMW->getValOperand(), T, G);
+    AtomicRMWInst::BinOp Op = RMW->getOperation();
+    R = AtomicUpdate(ToPointer(Get(RMW->getPointerOperand(), T, G)),
+                     m_DL.getTypeStoreSize(Ty), [&](uint64_t Old) {
+                       return ApplyAtomicRMW(Op, Ty, Old, V);
+                     });
+    break;
+  }
+  case Instruction::AtomicCmpXchg: {
+    AtomicCmpXchgInst *CX = cast<AtomicCmpXchgInst>(I);
+    Type *ValTy = CX->getNewValOperand()->getType();
+    uint64_t Cmp = Get(CX->getCompareOperand(), T, G);
+    uint64_t New = Get(CX->getNewValOperand(), T, G);
+    uint64_t Old = AtomicUpdate(
+        ToPointer(Get(CX->getPointerOperand(), T, G)),
+        m_DL.getTypeStoreSize(ValTy),
+        [&](uint64_t Prev) { return Truncate(ValTy, Prev) == Cmp ? New : Prev; });
+    Old = Truncate(ValTy, Old);
+    T.Slots[Slot(I)] = Old;
+    T.Slots[Slot(I) + 1] = Old == Cmp;
+    return;
+  }
+  case Instruction::ExtractValue: {
+    ExtractValueInst *EV = cast<ExtractValueInst>(I);
+    if (EV->getNumIndices() != 1)
+      throw NotSupported("nested aggregates");
+    R = Get(EV->getAggregateOperand(), T, G, EV->getIndices()[0]);
+    break;
+  }
+  default:
+    throw NotSupported(Twine("instruction ") + I->getOpcodeName());
+  }
+  T.Slots[Slot(I)] = Truncate(Ty, R);
+}
+
+uint64_t DxilComputeExecutor::Impl::ViewOffset(const ResourceView &View,
+                                               uint64_t Coord0,
+                                               uint64_t Coord1) const {
+  switch (View.Kind) {
+  case DXIL::ResourceKind::RawBuffer:
+    return Coord0;
+  case DXIL::ResourceKind::StructuredBuffer:
+    return Coord0 * View.Stride + Coord1;
+  default:
+    return Coord0 * View.Stride;
+  }
+}
+
+void DxilComputeExecutor::Impl::BufferLoad(CallInst *CI, Thread &T,
+                                           Group &G) {
+  DxilInst_BufferLoad Load(CI);
+  const ResourceView &View = GetView(Load.get_srv(), T, G);
+  uint64_t Offset = ViewOffset(View, Get(Load.get_index(), T, G),
+                               Get(Load.get_wot(), T, G));
+  Type *EltTy = CI->getType()->getStructElementType(0);
+  unsigned Size = m_DL.getTypeStoreSize(EltTy);
+  unsigned Count =
+      View.Kind == DXIL::ResourceKind::TypedBuffer ? View.Components : 4;
+  unsigned Result = Slot(CI);
+  for (unsigned i = 0; i < 4; ++i) {
+    uint64_t ComponentOffset = Offset + i * Size;
+    T.Slots[Result + i] = i < Count && InBounds(View, ComponentOffset, Size)
+                              ? LoadScalar(View.Data + ComponentOffset, Size)
+                              : 0;
+  }
+  T.Slots[Result + 4] = 1; // Status: fully mapped.
+}
+
+void DxilComputeExecutor::Impl::BufferStore(CallInst *CI, Thread &T,
+                                            Group &G) {
+  DxilInst_BufferStore Store(CI);
+  const ResourceView &View = GetView(Store.get_uav(), T, G);
+  uint64_t Offset = ViewOffset(View, Get(Store.get_coord0(), T, G),
+                               Get(Store.get_coord1(), T, G));
+  Value *Values[4] = {Store.get_value0(), Store.get_value1(),
+                      Store.get_value2(), Store.get_value3()};
+  unsigned Size = m_DL.getTypeStoreSize(Values[0]->getType());
+  unsigned Count =
+      View.Kind == DXIL::ResourceKind::TypedBuffer ? View.Components : 4;
+  uint64_t Mask = Get(Store.get_mask(), T, G);
+  for (unsigned i = 0; i < Count; ++i) {
+    uint64_t ComponentOffset = Offset + i * Size;
+    if ((Mask & (1 << i)) && InBounds(View, ComponentOffset, Size))
+      StoreScalar(View.Data + ComponentOffset, Size, Get(Values[i], T, G));
+  }
+}
+
+void DxilComputeExecutor::Impl::CBufferLoadLegacy(CallInst *CI, Thread &T,
+                                                  Group &G) {
+  DxilInst_CBufferLoadLegacy Load(CI);
+  const ResourceView &View = GetView(Load.get_handle(), T, G);
+  uint64_t Offset = Get(Load.get_regIndex(), T, G) * 16;
+  StructType *RetTy = cast<StructType>(CI->getType());
+  unsigned Size = m_DL.getTypeStoreSize(RetTy->getElementType(0));
+  unsigned Result = Slot(CI);
+  for (unsigned i = 0, e = RetTy->getNumElements(); i < e; ++i) {
+    uint64_t ComponentOffset = Offset + i * Size;
+    T.Slots[Result + i] = InBounds(View, ComponentOffset, Size)
+                              ? LoadScalar(View.Data + ComponentOffset, Size)
+                              : 0;
+  }
+}
+
+uint64_t DxilComputeExecutor::Impl::AtomicBinOp(CallInst *CI, Thread &T,
+                                                Group &G) {
+  DxilInst_AtomicBinOp Atomic(CI);
+  const ResourceView &View = GetView(Atomic.get_handle(), T, G);
+  uint64_t Offset = ViewOffset(View, Get(Atomic.get_offset0(), T, G),
+                               Get(Atomic.get_offset1(), T, G));
+  Type *Ty = Atomic.get_newValue()->getType();
+  unsigned Size = m_DL.getTypeStoreSize(Ty);
+  if (!InBounds(View, Offset, Size))
+    return 0;
+  DXIL::AtomicBinOpCode Op =
+      (DXIL::AtomicBinOpCode)Get(Atomic.get_atomicOp(), T, G);
+  uint64_t V = Get(Atomic.get_newValue(), T, G);
+  return AtomicUpdate(View.Data + Offset, Size, [&](uint64_t Old) {
+    return ApplyAtomicBinOp(Op, Ty, Old, V);
+  });
+}
+
+uint64_t DxilComputeExecutor::Impl::AtomicCompareExchange(CallInst *CI,
+                                                          Thread &T,
+                                                          Group &G) {
+  DxilInst_AtomicCompareExchange Atomic(CI);
+  const ResourceView &View = GetView(Atomic.get_handle(), T, G);
+  uint64_t Offset = ViewOffset(View, Get(Atomic.get_offset0(), T, G),
+                               Get(Atomic.get_offset1(), T, G));
+  Type *Ty = Atomic.get_newValue()->getType();
+  unsigned Size = m_DL.getTypeStoreSize(Ty);
+  if (!InBounds(View, Offset, Size))
+    return 0;
+  uint64_t Cmp = Get(Atomic.get_compareValue(), T, G);
+  uint64_t New = Get(Atomic.get_newValue(), T, G);
+  return AtomicUpdate(View.Data + Offset, Size, [&](uint64_t Old) {
+    return Old == Cmp ? New : Old;
+  });
+}
+
+// Returns true if the thread has stopped at a group barrier or a wave
+// operation.
+bool DxilComputeExecutor::Impl::ExecuteDxilOp(CallInst *CI, Thread &T,
+                                              Group &G) {
+  Function *F = CI->getCalledFunction();
+  if (!F || !OP::IsDxilOpFunc(F))
+    throw NotSupported(Twine("call to ") +
+                       (F ? F->getName() : StringRef("function pointer")));
+  OP::OpCode Opcode = OP::GetDxilOpFuncCallInst(CI);
+  Type *Ty = CI->getType();
+  auto Arg = [&](unsigned i) { return Get(CI->getArgOperand(i), T, G); };
+  auto FPArg = [&](unsigned i) {
+    return ReadFP(CI->getArgOperand(i)->getType(), Arg(i));
+  };
+  uint64_t R;
+
+  if (OP::IsDxilOpWave(Opcode) && Opcode != OP::OpCode::WaveGetLaneIndex &&
+      Opcode != OP::OpCode::WaveGetLaneCount) {
+    T.State = ThreadState::AtWaveOp;
+    T.WaveOp = CI;
+    return true;
+  }
+
+  switch (Opcode) {
+  case OP::OpCode::ThreadId: {
+    unsigned C = (unsigned)Arg(1);
+    R = G.Id[C] * m_NumThreads[C] + T.Id[C];
+    break;
+  }
+  case OP::OpCode::GroupId:
+    R = G.Id[Arg(1)];
+    break;
+  case OP::OpCode::ThreadIdInGroup:
+    R = T.Id[Arg(1)];
+    break;
+  case OP::OpCode::FlattenedThreadIdInGroup:
+    R = T.Index;
+    break;
+
+  case OP::OpCode::Barrier:
+    // Groups run on one worker each, so fences need nothing further.
+    if ((Arg(1) & (unsigned)DXIL::BarrierMode::SyncThreadGroup) == 0)
+      return false;
+    T.State = ThreadState::AtBarrier;
+    return true;
+
+  case OP::OpCode::WaveGetLaneIndex:
+    R = T.Index % m_WaveSize;
+    break;
+  case OP::OpCode::WaveGetLaneCount:
+    R = m_WaveSize;
+    break;
+
+  case OP::OpCode::CreateHandle: {
+    DxilInst_CreateHandle Create(CI);
+    DXIL::ResourceClass Class =
+        (DXIL::ResourceClass)Get(Create.get_resourceClass(), T, G);
+    unsigned ID = (unsigned)Get(Create.get_rangeId(), T, G);
+    unsigned Reg = (unsigned)Get(Create.get_index(), T, G);
+    auto It = m_Views.find(ResourceKey((unsigned)Class, ID, Reg));
+    if (It == m_Views.end()) {
+      const DxilResourceBase &Res = GetResource(Class, ID);
+      throw hlsl::Exception(
+          E_INVALIDARG,
+          (Twine("no memory bound for ") + Res.GetGlobalName() +
+           " at register " + Twine(Reg) + " in space " +
+           Twine(Res.GetSpaceID()))
+              .str());
+    }
+    switch (It->second.Kind) {
+    case DXIL::ResourceKind::RawBuffer:
+    case DXIL::ResourceKind::StructuredBuffer:
+    case DXIL::ResourceKind::TypedBuffer:
+    case DXIL::ResourceKind::CBuffer:
+    case DXIL::ResourceKind::TBuffer:
+      break;
+    default:
+      throw NotSupported("textures");
+    }
+    R = ToAddress(&It->second);
+    break;
+  }
+  case OP::OpCode::BufferLoad:
+    BufferLoad(CI, T, G);
+    return false;
+  case OP::OpCode::BufferStore:
+    BufferStore(CI, T, G);
+    return false;
+  case OP::OpCode::CheckAccessFullyMapped:
+    R = Arg(1) != 0;
+    break;
+  case OP::OpCode::CBufferLoadLegacy:
+    CBufferLoadLegacy(CI, T, G);
+    return false;
+  case OP::OpCode::CBufferLoad: {
+    DxilInst_CBufferLoad Load(CI);
+    const ResourceView &View = GetView(Load.get_handle(), T, G);
+    uint64_t Offset = Get(Load.get_byteOffset(), T, G);
+    unsigned Size = m_DL.getTypeStoreSize(Ty);
+    R = InBounds(View, Offset, Size) ? LoadScalar(View.Data + Offset, Size)
+                                     : 0;
+    break;
+  }
+  case OP::OpCode::AtomicBinOp:
+    R = AtomicBinOp(CI, T, G);
+    break;
+  case OP::OpCode::AtomicCompareExchange:
+    R = AtomicCompareExchange(CI, T, G);
+    break;
+
+  case OP::OpCode::FAbs:
+    R = WriteFP(Ty, std::fabs(FPArg(1)));
+    break;
+  case OP::OpCode::Saturate: {
+    double X = FPArg(1);
+    R = WriteFP(Ty, X > 0 ? (X < 1 ? X : 1.0) : 0.0);
+    break;
+  }
+  case OP::OpCode::IsNaN:
+    R = std::isnan(FPArg(1));
+    break;
+  case OP::OpCode::IsInf:
+    R = std::isinf(FPArg(1));
+    break;
+  case OP::OpCode::IsFinite:
+    R = std::isfinite(FPArg(1));
+    break;
+  case OP::OpCode::IsNormal:
+    R = std::isnormal(FPArg(1));
+    break;
+  case OP::OpCode::Cos:
+    R = WriteFP(Ty, std::cos(FPArg(1)));
+    break;
+  case OP::OpCode::Sin:
+    R = WriteFP(Ty, std::sin(FPArg(1)));
+    break;
+  case OP::OpCode::Tan:
+    R = WriteFP(Ty, std::tan(FPArg(1)));
+    break;
+  case OP::OpCode::Acos:
+    R = WriteFP(Ty, std::acos(FPArg(1)));
+    break;
+  case OP::OpCode::Asin:
+    R = WriteFP(Ty, std::asin(FPArg(1)));
+    break;
+  case OP::OpCode::Atan:
+    R = WriteFP(Ty, std::atan(FPArg(1)));
+    break;
+  case OP::OpCode::Hcos:
+    R = WriteFP(Ty, std::cosh(FPArg(1)));
+    break;
+  case OP::OpCode::Hsin:
+    R = WriteFP(Ty, std::sinh(FPArg(1)));
+    break;
+  case OP::OpCode::Htan:
+    R = WriteFP(Ty, std::tanh(FPArg(1)));
+    break;
+  case OP::OpCode::Exp:
+    R = WriteFP(Ty, std::exp2(FPArg(1)));
+    break;
+  case OP::OpCode::Log:
+    R = WriteFP(Ty, std::log2(FPArg(1)));
+    break;
+  case OP::OpCode::Frc: {
+    double X = FPArg(1);
+    R = WriteFP(Ty, X - std::floor(X));
+    break;
+  }
+  case OP::OpCode::Sqrt:
+    R = WriteFP(Ty, std::sqrt(FPArg(1)));
+    break;
+  case OP::OpCode::Rsqrt:
+    R = WriteFP(Ty, 1.0 / std::sqrt(FPArg(1)));
+    break;
+  case OP::OpCode::Round_ne:
+    R = WriteFP(Ty, std::nearbyint(FPArg(1)));
+    break;
+  case OP::OpCode::Round_ni:
+    R = WriteFP(Ty, std::floor(FPArg(1)));
+    break;
+  case OP::OpCode::Round_pi:
+    R = WriteFP(Ty, std::ceil(FPArg(1)));
+    break;
+  case OP::OpCode::Round_z:
+    R = WriteFP(Ty, std::trunc(FPArg(1)));
+    break;
+
+  case OP::OpCode::Bfrev: {
+    unsigned Width = Ty->getIntegerBitWidth();
+    uint64_t V = Arg(1), Reversed = 0;
+    for (unsigned i = 0; i < Width; ++i)
+      Reversed |= ((V >> i) & 1) << (Width - 1 - i);
+    R = Reversed;
+    break;
+  }
+  case OP::OpCode::Countbits:
+    R = countPopulation(Arg(1));
+    break;
+  case OP::OpCode::FirstbitLo: {
+    uint64_t V = Arg(1);
+    R = V ? countTrailingZeros(V) : ~0ULL;
+    break;
+  }
+  case OP::OpCode::FirstbitHi: {
+    Type *SrcTy = CI->getArgOperand(1)->getType();
+    R = FirstBitHigh(Arg(1), SrcTy->getIntegerBitWidth());
+    break;
+  }
+  case OP::OpCode::FirstbitSHi: {
+    Type *SrcTy = CI->getArgOperand(1)->getType();
+    uint64_t V = Arg(1);
+    if (SignExtend(SrcTy, V) < 0)
+      V = Truncate(SrcTy, ~V);
+    R = FirstBitHigh(V, SrcTy->getIntegerBitWidth());
+    break;
+  }
+
+  case OP::OpCode::FMax:
+    R = WriteFP(Ty, std::fmax(FPArg(1), FPArg(2)));
+    break;
+  case OP::OpCode::FMin:
+    R = WriteFP(Ty, std::fmin(FPArg(1), FPArg(2)));
+    break;
+  case OP::OpCode::IMax:
+    R = SignExtend(Ty, Arg(1)) > SignExtend(Ty, Arg(2)) ? Arg(1) : Arg(2);
+    break;
+  case OP::OpCode::IMin:
+    R = SignExtend(Ty, Arg(1)) < SignExtend(Ty, Arg(2)) ? Arg(1) : Arg(2);
+    break;
+  case OP::OpCode::UMax:
+    R = std::max(Arg(1), Arg(2));
+    break;
+  case OP::OpCode::UMin:
+    R = std::min(Arg(1), Arg(2));
+    break;
+  case OP::OpCode::UAddc:
+  case OP::OpCode::USubb: {
+    Type *EltTy = Ty->getStructElementType(0);
+    uint64_t A = Arg(1), B = Arg(2);
+    bool Add = Opcode == OP::OpCode::UAddc;
+    uint64_t Sum = Truncate(EltTy, Add ? A + B : A - B);
+    T.Slots[Slot(CI)] = Sum;
+    T.Slots[Slot(CI) + 1] = Add ? Sum < A : B > A;
+    return false;
+  }
+
+  case OP::OpCode::FMad:
+  case OP::OpCode::Fma:
+    R = WriteFP(Ty, FPArg(1) * FPArg(2) + FPArg(3));
+    break;
+  case OP::OpCode::IMad:
+  case OP::OpCode::UMad:
+    R = Arg(1) * Arg(2) + Arg(3);
+    break;
+  case OP::OpCode::Dot2:
+  case OP::OpCode::Dot3:
+  case OP::OpCode::Dot4: {
+    unsigned N = Opcode == OP::OpCode::Dot2 ? 2
+                 : Opcode == OP::OpCode::Dot3 ? 3 : 4;
+    double Sum = 0;
+    for (unsigned i = 0; i < N; ++i)
+      Sum += FPArg(1 + i) * FPArg(1 + N + i);
+    R = WriteFP(Ty, Sum);
+    break;
+  }
+
+  case OP::OpCode::MakeDouble:
+    R = Arg(1) | (Arg(2) << 32);
+    break;
+  case OP::OpCode::SplitDouble: {
+    uint64_t V = Arg(1);
+    T.Slots[Slot(CI)] = V & 0xFFFFFFFF;
+    T.Slots[Slot(CI) + 1] = V >> 32;
+    return false;
+  }
+  case OP::OpCode::LegacyF32ToF16:
+    R = FloatToHalf((float)FPArg(1));
+    break;
+  case OP::OpCode::LegacyF16ToF32:
+    R = FloatToBits(HalfToFloat(Arg(1)));
+    break;
+  case OP::OpCode::BitcastF16toI16:
+  case OP::OpCode::BitcastI16toF16:
+  case OP::OpCode::BitcastF32toI32:
+  case OP::OpCode::BitcastI32toF32:
+  case OP::OpCode::BitcastF64toI64:
+  case OP::OpCode::BitcastI64toF64:
+    R = Arg(1);
+    break;
+
+  default:
+    throw NotSupported(Twine("operation ") + OP::GetOpCodeName(Opcode));
+  }
+  T.Slots[Slot(CI)] = Truncate(Ty, R);
+  return false;
+}
+
+// Runs a wave operation for its active lanes, which are in lane order.
+void DxilComputeExecutor::Impl::ExecuteWaveOp(CallInst *CI,
+                                              ArrayRef<Thread *> Lanes,
+                                              Group &G) {
+  OP::OpCode Opcode = OP::GetDxilOpFuncCallInst(CI);
+  Type *Ty = CI->getType();
+  unsigned Result = Slot(CI);
+  auto Arg = [&](Thread *T, unsigned i) {
+    return Get(CI->getArgOperand(i), *T, G);
+  };
+  auto LaneIndex = [&](Thread *T) { return T->Index % m_WaveSize; };
+  // The active lane with the given index, if there is one.
+  auto FindLane = [&](uint64_t Lane) -> Thread * {
+    for (Thread *T : Lanes)
+      if (LaneIndex(T) == Lane)
+        return T;
+    return nullptr;
+  };
+  auto SetAll = [&](uint64_t R) {
+    for (Thread *T : Lanes)
+      T->Slots[Result] = Truncate(Ty, R);
+  };
+
+  switch (Opcode) {
+  case OP::OpCode::WaveIsFirstLane:
+    for (Thread *T : Lanes)
+      T->Slots[Result] = T == Lanes.front();
+    return;
+  case OP::OpCode::WaveAnyTrue: {
+    bool Any = false;
+    for (Thread *T : Lanes)
+      Any |= Arg(T, 1) != 0;
+    SetAll(Any);
+    return;
+  }
+  case OP::OpCode::WaveAllTrue: {
+    bool All = true;
+    for (Thread *T : Lanes)
+      All &= Arg(T, 1) != 0;
+    SetAll(All);
+    return;
+  }
+  case OP::OpCode::WaveActiveAllEqual: {
+    uint64_t First = Arg(Lanes.front(), 1);
+    bool Equal = true;
+    for (Thread *T : Lanes)
+      Equal &= Arg(T, 1) == First;
+    SetAll(Equal);
+    return;
+  }
+  case OP::OpCode::WaveActiveBallot: {
+    uint64_t Mask[4] = {0, 0, 0, 0};
+    for (Thread *T : Lanes) {
+      unsigned Lane = LaneIndex(T);
+      if (Arg(T, 1))
+        Mask[Lane / 32] |= 1ULL << (Lane % 32);
+    }
+    for (Thread *T : Lanes)
+      for (unsigned i = 0; i < 4; ++i)
+        T->Slots[Result + i] = Mask[i];
+    return;
+  }
+  case OP::OpCode::WaveReadLaneAt:
+    for (Thread *T : Lanes) {
+      Thread *Source = FindLane(Arg(T, 2));
+      T->Slots[Result] = Source ? Arg(Source, 1) : 0;
+    }
+    return;
+  case OP::OpCode::WaveReadLaneFirst:
+    SetAll(Arg(Lanes.front(), 1));
+    return;
+  case OP::OpCode::WaveActiveOp: {
+    DxilInst_WaveActiveOp Op(CI);
+    DXIL::WaveOpKind Kind = (DXIL::WaveOpKind)Op.get_op_val();
+    bool Unsigned = Op.get_sop_val() == (int8_t)DXIL::SignedOpKind::Unsigned;
+    uint64_t Acc = Arg(Lanes.front(), 1);
+    for (Thread *T : Lanes.slice(1))
+      Acc = CombineWaveValues(Kind, Unsigned, Ty, Acc, Arg(T, 1));
+    SetAll(Acc);
+    return;
+  }
+  case OP::OpCode::WaveActiveBit: {
+    DxilInst_WaveActiveBit Op(CI);
+    DXIL::WaveBitOpKind Kind = (DXIL::WaveBitOpKind)Op.get_op_val();
+    uint64_t Acc = Arg(Lanes.front(), 1);
+    for (Thread *T : Lanes.slice(1))
+      Acc = CombineWaveBits(Kind, Acc, Arg(T, 1));
+    SetAll(Acc);
+    return;
+  }
+  case OP::OpCode::WavePrefixOp: {
+    DxilInst_WavePrefixOp Op(CI);
+    DXIL::WaveOpKind Kind = (DXIL::WaveOpKind)Op.get_op_val();
+    bool Unsigned = Op.get_sop_val() == (int8_t)DXIL::SignedOpKind::Unsigned;
+    uint64_t Acc = WavePrefixIdentity(Kind, Ty);
+    for (Thread *T : Lanes) {
+      uint64_t V = Arg(T, 1);
+      T->Slots[Result] = Truncate(Ty, Acc);
+      Acc = CombineWaveValues(Kind, Unsigned, Ty, Acc, V);
+    }
+    return;
+  }
+  case OP::OpCode::WaveAllBitCount: {
+    uint64_t Count = 0;
+    for (Thread *T : Lanes)
+      Count += Arg(T, 1) != 0;
+    SetAll(Count);
+    return;
+  }
+  case OP::OpCode::WavePrefixBitCount: {
+    uint64_t Count = 0;
+    for (Thread *T : Lanes) {
+      bool Set = Arg(T, 1) != 0;
+      T->Slots[Result] = Count;
+      Count += Set;
+    }
+    return;
+  }
+  case OP::OpCode::QuadReadLaneAt:
+  case OP::OpCode::QuadOp:
+    for (Thread *T : Lanes) {
+      unsigned Lane = LaneIndex(T);
+      unsigned Other =
+          Opcode == OP::OpCode::QuadReadLaneAt
+              ? (Lane & ~3U) | (unsigned)(Arg(T, 2) & 3)
+              : Lane ^ ((unsigned)DxilInst_QuadOp(CI).get_op_val() + 1);
+      Thread *Source = FindLane(Other);
+      T->Slots[Result] = Source ? Arg(Source, 1) : 0;
+    }
+    return;
+  default:
+    throw NotSupported(Twine("operation ") + OP::GetOpCodeName(Opcode));
+  }
+}
+
+DxilComputeExecutor::DxilComputeExecutor(DxilModule &DM)
+    : m_pImpl(new Impl(DM)) {}
+
+DxilComputeExecutor::~DxilComputeExecutor() {}
+
+void DxilComputeExecutor::BindUAV(unsigned space, unsigned reg, void *pData,
+                                  size_t size) {
+  m_pImpl->Bind(DXIL::ResourceClass::UAV, space, reg, pData, size);
+}
+
+void DxilComputeExecutor::BindSRV(unsigned space, unsigned reg,
+                                  const void *pData, size_t size) {
+  // Shaders can't write to SRVs, so the memory stays unchanged.
+  m_pImpl->Bind(DXIL::ResourceClass::SRV, space, reg,
+                const_cast<void *>(pData), size);
+}
+
+void DxilComputeExecutor::BindCBuffer(unsigned space, unsigned reg,
+                                      const void *pData, size_t size) {
+  m_pImpl->Bind(DXIL::ResourceClass::CBuffer, space, reg,
+                const_cast<void *>(pData), size);
+}
+
+void DxilComputeExecutor::SetWorkerCount(unsigned count) {
+  m_pImpl->SetWorkerCount(count);
+}
+
+void DxilComputeExecutor::SetWaveSize(unsigned size) {
+  m_pImpl->SetWaveSize(size);
+}
+
+void DxilComputeExecutor::Dispatch(unsigned groupCountX,
+                                   unsigned groupCountY,
+                                   unsigned groupCountZ) {
+  m_pImpl->Dispatch(groupCountX, groupCountY, groupCountZ);
+}
+
+} // namespace hlsl
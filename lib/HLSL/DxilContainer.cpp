@@ -10,6 +10,7 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include "dxc/HLSL/DxilContainer.h"
+#include "dxc/HLSL/DxilCompression.h"
 #include <algorithm>
 
 namespace hlsl {
@@ -122,4 +123,188 @@ DxilProgramHeader *GetDxilProgramHeader(DxilContainerHeader *pHeader, DxilFourCC
       GetDxilProgramHeader(static_cast<const DxilContainerHeader *>(pHeader), fourCC));
 }
 
+bool GetDecompressedDxilProgramBitcode(const DxilProgramHeader *pHeader,
+                                       uint32_t length,
+                                       std::vector<char> &storage,
+                                       const char **pBitcode,
+                                       uint32_t *pBitcodeLength) {
+  if (IsValidDxilProgramHeader(pHeader, length)) {
+    GetDxilProgramBitcode(pHeader, pBitcode, pBitcodeLength);
+    return true;
+  }
+  if (!IsCompressedDxilProgramHeader(pHeader, length))
+    return false;
+  const DxilCompressedBitcodeHeader *pCompressedHeader =
+      GetDxilCompressedBitcodeHeader(pHeader);
+  if (pCompressedHeader->Codec != (uint32_t)DxilCompressionCodec::LZ)
+    return false;
+  const char *pCompressed;
+  uint32_t compressedLength;
+  GetDxilProgramBitcode(pHeader, &pCompressed, &compressedLength);
+  if (!DecompressLZ(pCompressed, compressedLength,
+                    pCompressedHeader->DecompressedSize, storage))
+    return false;
+  *pBitcode = storage.data();
+  *pBitcodeLength = (uint32_t)storage.size();
+  return true;
+}
+
+const DxilArchiveHeader *IsDxilArchiveLike(const void *ptr, size_t length) {
+  if (ptr == nullptr || length < 4)
+    return nullptr;
+  if (DxilArchiveFourCC != *reinterpret_cast<const uint32_t *>(ptr))
+    return nullptr;
+  return reinterpret_cast<const DxilArchiveHeader *>(ptr);
+}
+
+bool IsValidDxilArchive(const DxilArchiveHeader *pHeader, size_t length) {
+  // Validate that the header is where it's supposed to be.
+  if (pHeader == nullptr) return false;
+  if (length < sizeof(DxilArchiveHeader)) return false;
+
+  // Validate the header values.
+  if (pHeader->HeaderFourCC != DxilArchiveFourCC) return false;
+  if (pHeader->Version.Major != DxilArchiveVersionMajor) return false;
+  if (pHeader->ArchiveSizeInBytes > length) return false;
+  if (pHeader->BucketCount & (pHeader->BucketCount - 1)) return false;
+  if (pHeader->EntryCount > pHeader->BucketCount) return false;
+
+  // Make sure that each table is aligned and fits.
+  const uint64_t archiveSize = pHeader->ArchiveSizeInBytes;
+  auto tableFits = [archiveSize](uint32_t offset, uint64_t tableSize) {
+    return (offset % 8) == 0 && offset >= sizeof(DxilArchiveHeader) &&
+           offset + tableSize <= archiveSize;
+  };
+  if (!tableFits(pHeader->BucketsOffset,
+                 (uint64_t)pHeader->BucketCount * sizeof(uint32_t)) ||
+      !tableFits(pHeader->EntriesOffset,
+                 (uint64_t)pHeader->EntryCount * sizeof(DxilArchiveEntry)) ||
+      !tableFits(pHeader->PartRefsOffset,
+                 (uint64_t)pHeader->PartRefCount * sizeof(uint32_t)) ||
+      !tableFits(pHeader->PartOffsetsOffset,
+                 (uint64_t)pHeader->PartCount * sizeof(uint64_t)) ||
+      !tableFits(pHeader->KeyTableOffset, pHeader->KeyTableSize))
+    return false;
+
+  const uint8_t *pLinearArchive = reinterpret_cast<const uint8_t *>(pHeader);
+  const uint32_t *pBuckets =
+      reinterpret_cast<const uint32_t *>(pLinearArchive + pHeader->BucketsOffset);
+  for (uint32_t i = 0; i < pHeader->BucketCount; ++i) {
+    if (pBuckets[i] > pHeader->EntryCount)
+      return false;
+  }
+
+  // Make sure that each part is within the bounds.
+  const uint64_t *pPartOffsets = reinterpret_cast<const uint64_t *>(
+      pLinearArchive + pHeader->PartOffsetsOffset);
+  for (uint32_t i = 0; i < pHeader->PartCount; ++i) {
+    uint64_t partOffset = pPartOffsets[i];
+    if ((partOffset % 4) != 0 ||
+        partOffset > archiveSize - sizeof(DxilPartHeader))
+      return false;
+    const DxilPartHeader *pPartHeader =
+        reinterpret_cast<const DxilPartHeader *>(pLinearArchive + partOffset);
+    if (partOffset + sizeof(DxilPartHeader) + pPartHeader->PartSize >
+        archiveSize)
+      return false;
+  }
+
+  const uint32_t *pPartRefs = reinterpret_cast<const uint32_t *>(
+      pLinearArchive + pHeader->PartRefsOffset);
+  for (uint32_t i = 0; i < pHeader->PartRefCount; ++i) {
+    if (pPartRefs[i] >= pHeader->PartCount)
+      return false;
+  }
+
+  // Make sure that each entry's key is terminated and that its container
+  // can be rebuilt.
+  const char *pKeyTable =
+      reinterpret_cast<const char *>(pLinearArchive + pHeader->KeyTableOffset);
+  for (uint32_t i = 0; i < pHeader->EntryCount; ++i) {
+    const DxilArchiveEntry *pEntry = GetDxilArchiveEntry(pHeader, i);
+    if ((uint64_t)pEntry->KeyOffset + pEntry->KeySize >= pHeader->KeyTableSize)
+      return false;
+    if (pKeyTable[pEntry->KeyOffset + pEntry->KeySize] != '\0')
+      return false;
+    if ((uint64_t)pEntry->FirstPartRef + pEntry->PartCount >
+        pHeader->PartRefCount)
+      return false;
+    uint64_t containerSize = sizeof(DxilContainerHeader);
+    for (uint32_t j = 0; j < pEntry->PartCount; ++j) {
+      containerSize += sizeof(uint32_t) + sizeof(DxilPartHeader) +
+                       GetDxilArchiveEntryPart(pHeader, pEntry, j)->PartSize;
+    }
+    if (containerSize > DxilContainerMaxSize)
+      return false;
+  }
+
+  return true;
+}
+
+const DxilPartHeader *GetDxilArchiveEntryPart(const DxilArchiveHeader *pHeader,
+                                              const DxilArchiveEntry *pEntry,
+                                              uint32_t index) {
+  const uint8_t *pLinearArchive = reinterpret_cast<const uint8_t *>(pHeader);
+  const uint32_t *pPartRefs = reinterpret_cast<const uint32_t *>(
+      pLinearArchive + pHeader->PartRefsOffset);
+  const uint64_t *pPartOffsets = reinterpret_cast<const uint64_t *>(
+      pLinearArchive + pHeader->PartOffsetsOffset);
+  return reinterpret_cast<const DxilPartHeader *>(
+      pLinearArchive + pPartOffsets[pPartRefs[pEntry->FirstPartRef + index]]);
+}
+
+const DxilArchiveEntry *FindDxilArchiveEntry(const DxilArchiveHeader *pHeader,
+                                             const char *pKey,
+                                             uint32_t keyLength) {
+  if (pHeader->BucketCount == 0)
+    return nullptr;
+  const uint64_t keyHash = HashDxilArchiveKey(pKey, keyLength);
+  const uint32_t *pBuckets = reinterpret_cast<const uint32_t *>(
+      reinterpret_cast<const uint8_t *>(pHeader) + pHeader->BucketsOffset);
+  const uint32_t mask = pHeader->BucketCount - 1;
+  uint32_t bucket = (uint32_t)keyHash & mask;
+  for (uint32_t i = 0; i < pHeader->BucketCount; ++i) {
+    if (pBuckets[bucket] == 0)
+      return nullptr;
+    const DxilArchiveEntry *pEntry =
+        GetDxilArchiveEntry(pHeader, pBuckets[bucket] - 1);
+    if (pEntry->KeyHash == keyHash && pEntry->KeySize == keyLength &&
+        memcmp(GetDxilArchiveEntryKey(pHeader, pEntry), pKey, keyLength) == 0)
+      return pEntry;
+    bucket = (bucket + 1) & mask;
+  }
+  return nullptr;
+}
+
+uint32_t GetDxilArchiveEntryContainerSize(const DxilArchiveHeader *pHeader,
+                                          const DxilArchiveEntry *pEntry) {
+  uint32_t partsSize = 0;
+  for (uint32_t i = 0; i < pEntry->PartCount; ++i) {
+    partsSize += GetDxilArchiveEntryPart(pHeader, pEntry, i)->PartSize;
+  }
+  return (uint32_t)GetDxilContainerSizeFromParts(pEntry->PartCount, partsSize);
+}
+
+void CopyDxilArchiveEntryContainer(const DxilArchiveHeader *pHeader,
+                                   const DxilArchiveEntry *pEntry,
+                                   _Out_ void *pDest) {
+  DxilContainerHeader *pContainer = reinterpret_cast<DxilContainerHeader *>(pDest);
+  InitDxilContainer(pContainer, pEntry->PartCount,
+                    GetDxilArchiveEntryContainerSize(pHeader, pEntry));
+  pContainer->Hash = pEntry->Hash;
+  pContainer->Version = pEntry->Version;
+
+  uint8_t *pLinearContainer = reinterpret_cast<uint8_t *>(pDest);
+  uint32_t *pPartOffsetTable = reinterpret_cast<uint32_t *>(pContainer + 1);
+  uint32_t offset = sizeof(DxilContainerHeader) +
+                    (uint32_t)GetOffsetTableSize(pEntry->PartCount);
+  for (uint32_t i = 0; i < pEntry->PartCount; ++i) {
+    const DxilPartHeader *pPart = GetDxilArchiveEntryPart(pHeader, pEntry, i);
+    uint32_t partBytes = sizeof(DxilPartHeader) + pPart->PartSize;
+    pPartOffsetTable[i] = offset;
+    memcpy(pLinearContainer + offset, pPart, partBytes);
+    offset += partBytes;
+  }
+}
+
 } // namespace hlsl
@@ -10,11 +10,16 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include "llvm/ADT/MapVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringSet.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/DebugInfo.h"
 #include "llvm/Bitcode/ReaderWriter.h"
 #include "llvm/Support/MD5.h"
+#include "dxc/HLSL/DxilCBufferUsage.h"
+#include "dxc/HLSL/DxilCompression.h"
 #include "dxc/HLSL/DxilContainer.h"
+#include "dxc/HLSL/DxilLinker.h"
 #include "dxc/HLSL/DxilModule.h"
 #include "dxc/HLSL/DxilShaderModel.h"
 #include "dxc/HLSL/DxilRootSignature.h"
@@ -23,9 +28,15 @@
 #include "dxc/Support/WinIncludes.h"
 #include "dxc/Support/FileIOHelper.h"
 #include "dxc/Support/dxcapi.impl.h"
+#include "dxc/Support/WorkerThreads.h"
 #include "dxc/HLSL/DxilPipelineStateValidation.h"
 #include <algorithm>
+#include <atomic>
+#include <exception>
 #include <functional>
+#include <system_error>
+#include <thread>
+#include <vector>
 
 using namespace llvm;
 using namespace hlsl;
@@ -338,6 +349,76 @@ DxilPartWriter *hlsl::NewFeatureInfoWriter(const DxilModule &M) {
   return new DxilFeatureInfoWriter(M);
 }
 
+class DxilLinkIndexWriter : public DxilPartWriter {
+private:
+  std::vector<DxilLinkIndexFunction> m_functions;
+  std::vector<uint32_t> m_refs;
+  std::string m_strings;
+  llvm::StringMap<uint32_t> m_stringOffsets;
+
+  uint32_t AddString(StringRef str) {
+    auto it = m_stringOffsets.find(str);
+    if (it != m_stringOffsets.end())
+      return it->second;
+    uint32_t offset = (uint32_t)m_strings.size();
+    m_strings.append(str.begin(), str.end());
+    m_strings.push_back('\0');
+    m_stringOffsets[str] = offset;
+    return offset;
+  }
+
+public:
+  DxilLinkIndexWriter(const DxilModule &M) {
+    for (Function &F : M.GetModule()->functions()) {
+      if (F.isDeclaration())
+        continue;
+      SetVector<Function *> callees;
+      SetVector<GlobalVariable *> globals;
+      CollectLinkDependencies(F, callees, globals);
+
+      DxilLinkIndexFunction record;
+      record.Name = AddString(F.getName());
+      record.FirstCallee = (uint32_t)m_refs.size();
+      record.CalleeCount = (uint32_t)callees.size();
+      for (Function *callee : callees)
+        m_refs.emplace_back(AddString(callee->getName()));
+      record.FirstGlobal = (uint32_t)m_refs.size();
+      record.GlobalCount = (uint32_t)globals.size();
+      for (GlobalVariable *GV : globals)
+        m_refs.emplace_back(AddString(GV->getName()));
+      m_functions.emplace_back(record);
+    }
+    // Pad the string table to a 4-byte boundary.
+    m_strings.resize((m_strings.size() + 3) & ~(size_t)3, '\0');
+  }
+  __override uint32_t size() const {
+    return sizeof(DxilLinkIndexHeader) +
+           m_functions.size() * sizeof(DxilLinkIndexFunction) +
+           m_refs.size() * sizeof(uint32_t) + m_strings.size();
+  }
+  __override void write(AbstractMemoryStream *pStream) {
+    DxilLinkIndexHeader header;
+    header.FunctionCount = (uint32_t)m_functions.size();
+    header.RefCount = (uint32_t)m_refs.size();
+    header.StringTableSize = (uint32_t)m_strings.size();
+    IFT(WriteStreamValue(pStream, header));
+    ULONG cbWritten;
+    if (!m_functions.empty())
+      IFT(pStream->Write(m_functions.data(),
+                         m_functions.size() * sizeof(DxilLinkIndexFunction),
+                         &cbWritten));
+    if (!m_refs.empty())
+      IFT(pStream->Write(m_refs.data(), m_refs.size() * sizeof(uint32_t),
+                         &cbWritten));
+    if (!m_strings.empty())
+      IFT(pStream->Write(m_strings.data(), m_strings.size(), &cbWritten));
+  }
+};
+
+DxilPartWriter *hlsl::NewLinkIndexWriter(const DxilModule &M) {
+  return new DxilLinkIndexWriter(M);
+}
+
 class DxilPSVWriter : public DxilPartWriter  {
 private:
   const DxilModule &m_Module;
@@ -350,14 +431,74 @@ private:
   std::vector<PSVSignatureElement0> m_SigInputElements;
   std::vector<PSVSignatureElement0> m_SigOutputElements;
   std::vector<PSVSignatureElement0> m_SigPatchConstantElements;
+  // PSVVersion 2: resource names and cbuffer variables, in binding order.
+  std::vector<uint32_t> m_ResourceNames;
+  std::vector<PSVCBufferVariable0> m_CBufferVariables;
+  std::vector<std::pair<uint32_t, uint32_t> > m_CBufferVariableRanges;
+  // PSVVersion 3: ranges of the cbuffers that are read, in binding order.
+  std::vector<PSVCBufferRange0> m_CBufferUsedRanges;
+  std::vector<std::pair<uint32_t, uint32_t> > m_CBufferUsedRangeIndices;
+
+  uint32_t AddString(StringRef Str) {
+    uint32_t Offset = (uint32_t)m_StringBuffer.size();
+    m_StringBuffer.append(Str.begin(), Str.end());
+    m_StringBuffer.push_back('\0');
+    return Offset;
+  }
+
+  void AddResourceName(const DxilResourceBase &R) {
+    m_ResourceNames.push_back(AddString(R.GetGlobalName()));
+  }
+
+  void AddCBufferVariables(const DxilCBuffer &CB) {
+    uint32_t Start = (uint32_t)m_CBufferVariables.size();
+    Type *Ty = CB.GetGlobalSymbol()->getType()->getPointerElementType();
+    // For ConstantBuffer<> buf[2], the array size is in the binding range.
+    if (Ty->isArrayTy())
+      Ty = Ty->getArrayElementType();
+    // The type system may still have to be loaded from metadata.
+    DxilTypeSystem &TypeSys = const_cast<DxilModule &>(m_Module).GetTypeSystem();
+    StructType *ST = dyn_cast<StructType>(Ty);
+    const DxilStructAnnotation *Annotation =
+        ST ? TypeSys.GetStructAnnotation(ST) : nullptr;
+    // Modules translated from DXBC have no annotations; report no variables.
+    if (Annotation) {
+      // Sizes are computed as in reflection: up to the next variable in the
+      // cbuffer, or to its end for the last one.
+      unsigned NumFields = ST->getNumContainedTypes();
+      for (unsigned i = 0; i < NumFields; ++i) {
+        const DxilFieldAnnotation &Field = Annotation->GetFieldAnnotation(i);
+        PSVCBufferVariable0 Var;
+        Var.Name = AddString(Field.GetFieldName());
+        Var.StartOffset = Field.GetCBufferOffset();
+        Var.Size = Annotation->GetCBufferFieldSpan(i);
+        m_CBufferVariables.push_back(Var);
+      }
+    }
+    m_CBufferVariableRanges.emplace_back(
+        Start, (uint32_t)m_CBufferVariables.size() - Start);
+  }
+
+  void AddCBufferUsedRanges() {
+    std::vector<DxilCBufferUsedRanges> Usage =
+        CollectCBufferUsage(const_cast<DxilModule &>(m_Module));
+    for (const DxilCBufferUsedRanges &Ranges : Usage) {
+      uint32_t Start = (uint32_t)m_CBufferUsedRanges.size();
+      for (const std::pair<unsigned, unsigned> &Range : Ranges) {
+        PSVCBufferRange0 PSVRange;
+        PSVRange.StartOffset = Range.first;
+        PSVRange.Size = Range.second - Range.first;
+        m_CBufferUsedRanges.push_back(PSVRange);
+      }
+      m_CBufferUsedRangeIndices.emplace_back(
+          Start, (uint32_t)m_CBufferUsedRanges.size() - Start);
+    }
+  }
 
   void SetPSVSigElement(PSVSignatureElement0 &E, const DxilSignatureElement &SE) {
     memset(&E, 0, sizeof(PSVSignatureElement0));
     if (SE.GetKind() == DXIL::SemanticKind::Arbitrary && strlen(SE.GetName()) > 0) {
-      E.SemanticName = (uint32_t)m_StringBuffer.size();
-      StringRef Name(SE.GetName());
-      m_StringBuffer.append(Name.size()+1, '\0');
-      memcpy(m_StringBuffer.data() + E.SemanticName, Name.data(), Name.size());
+      E.SemanticName = AddString(SE.GetName());
     } else {
       // m_StringBuffer always starts with '\0' so offset 0 is empty string:
       E.SemanticName = 0;
@@ -429,6 +570,10 @@ public:
     // Allow PSVVersion to be upgraded
     if (m_PSVInitInfo.PSVVersion < 1 && (ValMajor > 1 || (ValMajor == 1 && ValMinor >= 1)))
       m_PSVInitInfo.PSVVersion = 1;
+    if (m_PSVInitInfo.PSVVersion < 2 && (ValMajor > 1 || (ValMajor == 1 && ValMinor >= 3)))
+      m_PSVInitInfo.PSVVersion = 2;
+    if (m_PSVInitInfo.PSVVersion < 3 && (ValMajor > 1 || (ValMajor == 1 && ValMinor >= 5)))
+      m_PSVInitInfo.PSVVersion = 3;
 
     const ShaderModel *SM = m_Module.GetShaderModel();
     UINT uCBuffers = m_Module.GetCBuffers().size();
@@ -458,6 +603,23 @@ public:
       for (auto &SE : m_Module.GetPatchConstantSignature().GetElements()) {
         SetPSVSigElement(m_SigPatchConstantElements[i++], *(SE.get()));
       }
+      if (m_PSVInitInfo.PSVVersion > 1) {
+        for (auto &&R : m_Module.GetCBuffers()) {
+          AddResourceName(*R);
+          AddCBufferVariables(*R);
+        }
+        for (auto &&R : m_Module.GetSamplers())
+          AddResourceName(*R);
+        for (auto &&R : m_Module.GetSRVs())
+          AddResourceName(*R);
+        for (auto &&R : m_Module.GetUAVs())
+          AddResourceName(*R);
+        m_PSVInitInfo.CBufferVariableCount = m_CBufferVariables.size();
+      }
+      if (m_PSVInitInfo.PSVVersion > 2) {
+        AddCBufferUsedRanges();
+        m_PSVInitInfo.CBufferUsedRangeCount = m_CBufferUsedRanges.size();
+      }
       // Set String and SemanticInput Tables
       m_PSVInitInfo.StringTable.Table = m_StringBuffer.data();
       m_PSVInitInfo.StringTable.Size = m_StringBuffer.size();
@@ -640,6 +802,50 @@ public:
     }
     DXASSERT_NOMSG(uResIndex == m_PSVInitInfo.ResourceCount);
 
+    if (m_PSVInitInfo.PSVVersion > 1) {
+      PSVRuntimeInfo2* pInfo2 = m_PSV.GetPSVRuntimeInfo2();
+      DXASSERT_NOMSG(pInfo2);
+      if (SM->IsCS()) {
+        pInfo2->NumThreadsX = m_Module.m_NumThreads[0];
+        pInfo2->NumThreadsY = m_Module.m_NumThreads[1];
+        pInfo2->NumThreadsZ = m_Module.m_NumThreads[2];
+      }
+
+      DXASSERT_NOMSG(m_ResourceNames.size() == m_PSVInitInfo.ResourceCount);
+      for (UINT i = 0; i < m_PSVInitInfo.ResourceCount; ++i) {
+        PSVResourceBindInfo1* pBindInfo = m_PSV.GetPSVResourceBindInfo1(i);
+        DXASSERT_NOMSG(pBindInfo);
+        pBindInfo->Name = m_ResourceNames[i];
+      }
+      // CBuffers come first in binding order.
+      for (UINT i = 0; i < m_CBufferVariableRanges.size(); ++i) {
+        PSVResourceBindInfo1* pBindInfo = m_PSV.GetPSVResourceBindInfo1(i);
+        const DxilCBuffer &CB = m_Module.GetCBuffer(i);
+        pBindInfo->VariableStart = m_CBufferVariableRanges[i].first;
+        pBindInfo->VariableCount = m_CBufferVariableRanges[i].second;
+        pBindInfo->Size = PSVALIGN(CB.GetSize() / CB.GetRangeSize(), 4);
+      }
+      for (UINT i = 0; i < m_CBufferVariables.size(); ++i) {
+        PSVCBufferVariable0 *pVar = m_PSV.GetCBufferVariable0(i);
+        DXASSERT_NOMSG(pVar);
+        memcpy(pVar, &m_CBufferVariables[i], sizeof(PSVCBufferVariable0));
+      }
+    }
+
+    if (m_PSVInitInfo.PSVVersion > 2) {
+      for (UINT i = 0; i < m_CBufferUsedRangeIndices.size(); ++i) {
+        PSVResourceBindInfo2* pBindInfo = m_PSV.GetPSVResourceBindInfo2(i);
+        DXASSERT_NOMSG(pBindInfo);
+        pBindInfo->UsedRangeStart = m_CBufferUsedRangeIndices[i].first;
+        pBindInfo->UsedRangeCount = m_CBufferUsedRangeIndices[i].second;
+      }
+      for (UINT i = 0; i < m_CBufferUsedRanges.size(); ++i) {
+        PSVCBufferRange0 *pRange = m_PSV.GetCBufferRange0(i);
+        DXASSERT_NOMSG(pRange);
+        memcpy(pRange, &m_CBufferUsedRanges[i], sizeof(PSVCBufferRange0));
+      }
+    }
+
     if (m_PSVInitInfo.PSVVersion > 0) {
       DXASSERT_NOMSG(pInfo1);
 
@@ -712,12 +918,38 @@ private:
   };
 
   llvm::SmallVector<DxilPart, 8> m_Parts;
+  bool m_bHasStreamedPart = false;
 
 public:
   __override void AddPart(uint32_t FourCC, uint32_t Size, WriteFn Write) {
+    DXASSERT(!m_bHasStreamedPart, "else part added after the streamed part");
     m_Parts.emplace_back(FourCC, Size, Write);
   }
 
+  __override void AddStreamedPart(uint32_t FourCC, WriteFn Write) {
+    DXASSERT(!m_bHasStreamedPart, "else part added after the streamed part");
+    m_Parts.emplace_back(FourCC, 0, Write);
+    m_bHasStreamedPart = true;
+  }
+
+  // Runs the writers of the parts added so far into buffers of their own, so
+  // their contents are produced now rather than while the container is
+  // written.
+  void RenderParts() {
+    for (auto &&part : m_Parts) {
+      CComPtr<AbstractMemoryStream> pPartStream;
+      IFT(CreateMemoryStream(DxcGetThreadMallocNoRef(), &pPartStream));
+      IFT(pPartStream->Reserve(part.Header.PartSize));
+      part.Write(pPartStream);
+      DXASSERT(pPartStream->GetPtrSize() == part.Header.PartSize, "out of bound");
+      part.Write = [pPartStream](AbstractMemoryStream *pStream) {
+        ULONG cbWritten;
+        IFT(pStream->Write(pPartStream->GetPtr(), pPartStream->GetPtrSize(),
+                           &cbWritten));
+      };
+    }
+  }
+
   __override uint32_t size() const {
     uint32_t partSize = 0;
     for (auto &part : m_Parts) {
@@ -732,6 +964,7 @@ public:
     uint32_t containerSizeInBytes = size();
     InitDxilContainer(&header, PartCount, containerSizeInBytes);
     IFT(pStream->Reserve(header.ContainerSizeInBytes));
+    size_t headerPos = pStream->GetPosition();
     IFT(WriteStreamValue(pStream, header));
     uint32_t offset = sizeof(header) + (uint32_t)GetOffsetTableSize(PartCount);
     for (auto &&part : m_Parts) {
@@ -739,12 +972,24 @@ public:
       offset += sizeof(DxilPartHeader) + part.Header.PartSize;
     }
     for (auto &&part : m_Parts) {
+      size_t partHeaderPos = pStream->GetPosition();
       IFT(WriteStreamValue(pStream, part.Header));
       size_t start = pStream->GetPosition();
       part.Write(pStream);
+      if (m_bHasStreamedPart && &part == &m_Parts.back()) {
+        // The stream may have grown while writing, so only now take pointers
+        // into it.
+        uint32_t partSize = (uint32_t)(pStream->GetPosition() - start);
+        DXASSERT(partSize % 4 == 0, "else streamed part is not aligned");
+        LPBYTE pBase = pStream->GetPtr();
+        reinterpret_cast<DxilPartHeader *>(pBase + partHeaderPos)->PartSize = partSize;
+        reinterpret_cast<DxilContainerHeader *>(pBase + headerPos)->ContainerSizeInBytes += partSize;
+        containerSizeInBytes += partSize;
+        break;
+      }
       DXASSERT_LOCALVAR(start, pStream->GetPosition() - start == (size_t)part.Header.PartSize, "out of bound");
     }
-    DXASSERT(containerSizeInBytes == (uint32_t)pStream->GetPosition(), "else stream size is incorrect");
+    DXASSERT(containerSizeInBytes == (uint32_t)(pStream->GetPosition() - headerPos), "else stream size is incorrect");
   }
 };
 
@@ -752,6 +997,191 @@ DxilContainerWriter *hlsl::NewDxilContainerWriter() {
   return new DxilContainerWriter_impl();
 }
 
+class DxilArchiveWriter_impl : public DxilArchiveWriter {
+private:
+  struct Entry {
+    std::string Key;
+    uint64_t KeyHash;
+    uint32_t KeyOffset;
+    uint32_t FirstPartRef;
+    uint32_t PartCount;
+    DxilContainerHash Hash;
+    DxilContainerVersion Version;
+  };
+
+  std::vector<Entry> m_Entries;
+  llvm::StringSet<> m_Keys;
+  // Distinct parts, keyed by their header and data, which the map owns.
+  llvm::StringMap<uint32_t> m_PartIndex;
+  std::vector<StringRef> m_Parts;
+  std::vector<uint32_t> m_PartRefs;
+  uint32_t m_KeyTableSize = 0;
+  uint64_t m_PartDataSize = 0;
+
+  static uint64_t AlignTable(uint64_t offset) { return (offset + 7) & ~7ULL; }
+  static uint64_t AlignPart(uint64_t size) { return (size + 3) & ~3ULL; }
+
+  void GetLayout(DxilArchiveHeader &header, uint64_t &partDataOffset) const {
+    memset(&header, 0, sizeof(header));
+    header.HeaderFourCC = DxilArchiveFourCC;
+    header.Version.Major = DxilArchiveVersionMajor;
+    header.Version.Minor = DxilArchiveVersionMinor;
+    header.EntryCount = (uint32_t)m_Entries.size();
+    // Keep the index at most half full so probe sequences stay short.
+    header.BucketCount = 0;
+    if (header.EntryCount != 0) {
+      header.BucketCount = 1;
+      while (header.BucketCount < header.EntryCount * 2)
+        header.BucketCount <<= 1;
+    }
+    header.PartCount = (uint32_t)m_Parts.size();
+    header.PartRefCount = (uint32_t)m_PartRefs.size();
+    header.KeyTableSize = m_KeyTableSize;
+
+    uint64_t offset = sizeof(DxilArchiveHeader);
+    header.BucketsOffset = (uint32_t)offset;
+    offset = AlignTable(offset + (uint64_t)header.BucketCount * sizeof(uint32_t));
+    header.EntriesOffset = (uint32_t)offset;
+    offset += (uint64_t)header.EntryCount * sizeof(DxilArchiveEntry);
+    header.PartRefsOffset = (uint32_t)offset;
+    offset = AlignTable(offset + (uint64_t)header.PartRefCount * sizeof(uint32_t));
+    header.PartOffsetsOffset = (uint32_t)offset;
+    offset += (uint64_t)header.PartCount * sizeof(uint64_t);
+    header.KeyTableOffset = (uint32_t)offset;
+    offset = AlignTable(offset + header.KeyTableSize);
+    IFTBOOL(offset <= UINT32_MAX, DXC_E_DATA_TOO_LARGE);
+    partDataOffset = offset;
+    header.ArchiveSizeInBytes = offset + m_PartDataSize;
+  }
+
+  static void WritePadding(AbstractMemoryStream *pStream, uint64_t size) {
+    static const uint8_t Zeros[8] = {};
+    DXASSERT_NOMSG(size < sizeof(Zeros));
+    ULONG cbWritten;
+    if (size)
+      IFT(pStream->Write(Zeros, (ULONG)size, &cbWritten));
+  }
+
+  static void WriteTable(AbstractMemoryStream *pStream, const void *pData,
+                         size_t size) {
+    ULONG cbWritten;
+    if (size)
+      IFT(pStream->Write(pData, (ULONG)size, &cbWritten));
+  }
+
+public:
+  __override void AddContainer(const char *pKey, uint32_t keyLength,
+                               const DxilContainerHeader *pContainer) {
+    IFTBOOL(IsValidDxilContainer(pContainer, pContainer->ContainerSizeInBytes),
+            DXC_E_CONTAINER_INVALID);
+    StringRef Key(pKey, keyLength);
+    // Keys are stored null-terminated.
+    IFTBOOL(Key.find('\0') == StringRef::npos, E_INVALIDARG);
+    IFTBOOL(m_Keys.count(Key) == 0, E_INVALIDARG);
+    IFTBOOL((uint64_t)m_KeyTableSize + keyLength + 1 <= UINT32_MAX,
+            DXC_E_DATA_TOO_LARGE);
+
+    Entry entry;
+    entry.Key = Key;
+    entry.KeyHash = HashDxilArchiveKey(pKey, keyLength);
+    entry.KeyOffset = m_KeyTableSize;
+    entry.FirstPartRef = (uint32_t)m_PartRefs.size();
+    entry.PartCount = pContainer->PartCount;
+    entry.Hash = pContainer->Hash;
+    entry.Version = pContainer->Version;
+    for (DxilPartIterator it = begin(pContainer), itEnd = end(pContainer);
+         it != itEnd; ++it) {
+      const DxilPartHeader *pPart = *it;
+      StringRef partBytes(reinterpret_cast<const char *>(pPart),
+                          sizeof(DxilPartHeader) + pPart->PartSize);
+      auto inserted = m_PartIndex.insert(
+          std::make_pair(partBytes, (uint32_t)m_Parts.size()));
+      if (inserted.second) {
+        m_Parts.push_back(inserted.first->getKey());
+        m_PartDataSize += AlignPart(partBytes.size());
+      }
+      m_PartRefs.push_back(inserted.first->getValue());
+    }
+    m_KeyTableSize += keyLength + 1;
+    m_Keys.insert(Key);
+    m_Entries.push_back(std::move(entry));
+  }
+
+  __override uint64_t size() const {
+    DxilArchiveHeader header;
+    uint64_t partDataOffset;
+    GetLayout(header, partDataOffset);
+    return header.ArchiveSizeInBytes;
+  }
+
+  __override void write(AbstractMemoryStream *pStream) {
+    DxilArchiveHeader header;
+    uint64_t partDataOffset;
+    GetLayout(header, partDataOffset);
+    if (header.ArchiveSizeInBytes <= ULONG_MAX)
+      IFT(pStream->Reserve(header.ArchiveSizeInBytes));
+    const uint64_t headerPos = pStream->GetPosition();
+    auto PadTo = [&](uint64_t offset) {
+      uint64_t pos = pStream->GetPosition() - headerPos;
+      DXASSERT_NOMSG(pos <= offset);
+      WritePadding(pStream, offset - pos);
+    };
+    IFT(WriteStreamValue(pStream, header));
+
+    std::vector<uint32_t> buckets(header.BucketCount, 0);
+    const uint32_t mask = header.BucketCount - 1;
+    for (uint32_t i = 0; i < header.EntryCount; ++i) {
+      uint32_t bucket = (uint32_t)m_Entries[i].KeyHash & mask;
+      while (buckets[bucket] != 0)
+        bucket = (bucket + 1) & mask;
+      buckets[bucket] = i + 1;
+    }
+    PadTo(header.BucketsOffset);
+    WriteTable(pStream, buckets.data(), buckets.size() * sizeof(uint32_t));
+
+    PadTo(header.EntriesOffset);
+    for (const Entry &entry : m_Entries) {
+      DxilArchiveEntry value;
+      value.KeyHash = entry.KeyHash;
+      value.KeyOffset = entry.KeyOffset;
+      value.KeySize = (uint32_t)entry.Key.size();
+      value.FirstPartRef = entry.FirstPartRef;
+      value.PartCount = entry.PartCount;
+      value.Hash = entry.Hash;
+      value.Version = entry.Version;
+      value.Reserved = 0;
+      IFT(WriteStreamValue(pStream, value));
+    }
+
+    PadTo(header.PartRefsOffset);
+    WriteTable(pStream, m_PartRefs.data(), m_PartRefs.size() * sizeof(uint32_t));
+
+    PadTo(header.PartOffsetsOffset);
+    uint64_t partOffset = partDataOffset;
+    for (StringRef part : m_Parts) {
+      IFT(WriteStreamValue(pStream, partOffset));
+      partOffset += AlignPart(part.size());
+    }
+
+    PadTo(header.KeyTableOffset);
+    for (const Entry &entry : m_Entries) {
+      WriteTable(pStream, entry.Key.c_str(), entry.Key.size() + 1);
+    }
+
+    PadTo(partDataOffset);
+    for (StringRef part : m_Parts) {
+      WriteTable(pStream, part.data(), part.size());
+      WritePadding(pStream, AlignPart(part.size()) - part.size());
+    }
+    DXASSERT(header.ArchiveSizeInBytes == pStream->GetPosition() - headerPos,
+             "else stream size is incorrect");
+  }
+};
+
+DxilArchiveWriter *hlsl::NewDxilArchiveWriter() {
+  return new DxilArchiveWriter_impl();
+}
+
 static bool HasDebugInfo(const Module &M) {
   for (Module::const_named_metadata_iterator NMI = M.named_metadata_begin(),
                                              NME = M.named_metadata_end();
@@ -771,36 +1201,207 @@ static void GetPaddedProgramPartSize(AbstractMemoryStream *pStream,
   bitcodeInUInt32 = (bitcodeInUInt32 / 4) + (bitcodePaddingBytes ? 1 : 0);
 }
 
-static void WriteProgramPart(const ShaderModel *pModel,
-                             AbstractMemoryStream *pModuleBitcode,
-                             AbstractMemoryStream *pStream) {
+static void InitProgramHeader(const ShaderModel *pModel,
+                              DxilProgramHeader &programHeader,
+                              uint32_t bitcodeSize) {
   DXASSERT(pModel != nullptr, "else generation should have failed");
-  DxilProgramHeader programHeader;
   uint32_t shaderVersion =
       EncodeVersion(pModel->GetKind(), pModel->GetMajor(), pModel->GetMinor());
   unsigned dxilMajor, dxilMinor;
   pModel->GetDxilVersion(dxilMajor, dxilMinor);
   uint32_t dxilVersion = DXIL::MakeDxilVersion(dxilMajor, dxilMinor);
-  InitProgramHeader(programHeader, shaderVersion, dxilVersion, pModuleBitcode->GetPtrSize());
+  InitProgramHeader(programHeader, shaderVersion, dxilVersion, bitcodeSize);
+}
+
+static void WriteProgramPadding(uint32_t bitcodeSize,
+                                AbstractMemoryStream *pStream) {
+  if (uint32_t programPaddingBytes = (4 - bitcodeSize % 4) % 4) {
+    ULONG cbWritten;
+    uint32_t paddingValue = 0;
+    IFT(pStream->Write(&paddingValue, programPaddingBytes, &cbWritten));
+  }
+}
+
+// Writes the debug module on a worker thread while the parts added so far
+// are rendered on this one. Both only read the module, and both are done
+// before it is stripped. The program part can't be written alongside: it is
+// the same module once stripped, and a copy would cost as much as the write.
+static void WriteDebugModuleAndRenderParts(Module *pModule,
+                                           AbstractMemoryStream *pDebugStream,
+                                           DxilContainerWriter_impl &writer) {
+  std::exception_ptr debugError;
+  IMalloc *pMalloc = DxcGetThreadMallocNoRef();
+  auto writeDebugModule = [&]() {
+    DxcThreadMalloc TM(pMalloc);
+    try {
+      raw_stream_ostream outStream(pDebugStream);
+      WriteBitcodeToFile(pModule, outStream, true);
+    } catch (...) {
+      debugError = std::current_exception();
+    }
+  };
+
+  std::thread debugThread;
+  try {
+    debugThread = std::thread(writeDebugModule);
+  } catch (const std::system_error &) {
+    // Write the debug module on this thread instead.
+  }
+  try {
+    writer.RenderParts();
+  } catch (...) {
+    if (debugThread.joinable())
+      debugThread.join();
+    throw;
+  }
+  if (debugThread.joinable())
+    debugThread.join();
+  else
+    writeDebugModule();
+  if (debugError)
+    std::rethrow_exception(debugError);
+}
+
+// Adaptor for a memory stream that also hashes the bytes written to it.
+class raw_hashing_stream_ostream : public raw_ostream {
+private:
+  AbstractMemoryStream *m_pStream;
+  llvm::MD5 &m_Hash;
+  void write_impl(const char *Ptr, size_t Size) override {
+    ULONG cbWritten;
+    IFT(m_pStream->Write(Ptr, Size, &cbWritten));
+    m_Hash.update(ArrayRef<uint8_t>((const uint8_t *)Ptr, Size));
+  }
+  uint64_t current_pos() const override { return m_pStream->GetPosition(); }
+public:
+  raw_hashing_stream_ostream(AbstractMemoryStream *pStream, llvm::MD5 &Hash)
+      : m_pStream(pStream), m_Hash(Hash) {}
+  ~raw_hashing_stream_ostream() override {
+    flush();
+  }
+};
 
-  uint32_t programInUInt32, programPaddingBytes;
-  GetPaddedProgramPartSize(pModuleBitcode, programInUInt32,
-                           programPaddingBytes);
+// Writes a program part from bitcode in a buffer; the bitcode is added to
+// pBitcodeHash if one is given.
+static void WriteProgramPart(const ShaderModel *pModel,
+                             AbstractMemoryStream *pModuleBitcode,
+                             AbstractMemoryStream *pStream,
+                             llvm::MD5 *pBitcodeHash) {
+  DxilProgramHeader programHeader;
+  InitProgramHeader(pModel, programHeader, pModuleBitcode->GetPtrSize());
 
   ULONG cbWritten;
   IFT(WriteStreamValue(pStream, programHeader));
   IFT(pStream->Write(pModuleBitcode->GetPtr(), pModuleBitcode->GetPtrSize(),
                      &cbWritten));
-  if (programPaddingBytes) {
-    uint32_t paddingValue = 0;
-    IFT(pStream->Write(&paddingValue, programPaddingBytes, &cbWritten));
+  WriteProgramPadding(pModuleBitcode->GetPtrSize(), pStream);
+  if (pBitcodeHash)
+    pBitcodeHash->update(ArrayRef<uint8_t>(pModuleBitcode->GetPtr(),
+                                           pModuleBitcode->GetPtrSize()));
+}
+
+// Writes a program part holding compressed, the LZ compression of
+// bitcodeSize bytes of bitcode.
+static void WriteCompressedProgramPart(const ShaderModel *pModel,
+                                       const std::vector<char> &compressed,
+                                       uint32_t bitcodeSize,
+                                       AbstractMemoryStream *pStream) {
+  const uint32_t compressedSize = (uint32_t)compressed.size();
+  DxilProgramHeader programHeader;
+  InitProgramHeader(pModel, programHeader,
+                    sizeof(DxilCompressedBitcodeHeader) + compressedSize);
+  programHeader.BitcodeHeader.DxilMagic = DxilCompressedMagicValue;
+  programHeader.BitcodeHeader.BitcodeOffset +=
+      sizeof(DxilCompressedBitcodeHeader);
+  programHeader.BitcodeHeader.BitcodeSize = compressedSize;
+  DxilCompressedBitcodeHeader compressedHeader;
+  compressedHeader.Codec = (uint32_t)DxilCompressionCodec::LZ;
+  compressedHeader.DecompressedSize = bitcodeSize;
+
+  ULONG cbWritten;
+  IFT(WriteStreamValue(pStream, programHeader));
+  IFT(WriteStreamValue(pStream, compressedHeader));
+  IFT(pStream->Write(compressed.data(), compressedSize, &cbWritten));
+  WriteProgramPadding(compressedSize, pStream);
+}
+
+// Runs Task(0) .. Task(Count - 1) for the bitcode writer on the threads
+// reserved for them, this one included, with this thread's allocator. The
+// first exception is rethrown once all tasks are done.
+static void ParallelForWithThreadMalloc(
+    unsigned Count, const std::function<void(unsigned)> &Task) {
+  std::vector<std::exception_ptr> errors(Count);
+  std::atomic<unsigned> nextTask(0);
+  IMalloc *pMalloc = DxcGetThreadMallocNoRef();
+  auto worker = [&]() {
+    DxcThreadMalloc TM(pMalloc);
+    WorkerThreadScope workerScope;
+    for (unsigned i = nextTask++; i < Count; i = nextTask++) {
+      try {
+        Task(i);
+      } catch (...) {
+        errors[i] = std::current_exception();
+      }
+    }
+  };
+
+  WorkerThreadReservation reservation(Count);
+  std::vector<std::thread> threads;
+  try {
+    for (unsigned i = 1; i < reservation.GetThreadCount(); ++i)
+      threads.emplace_back(worker);
+  } catch (const std::system_error &) {
+    // The threads already started pick up the remaining tasks.
   }
+  worker();
+  for (std::thread &t : threads)
+    t.join();
+  for (const std::exception_ptr &error : errors)
+    if (error)
+      std::rethrow_exception(error);
+}
+
+// Serializes the module straight into the container stream, hashing the
+// bitcode as it goes, with function bodies written in parallel, then patches
+// the program header with the bitcode size.
+static void WriteProgramPart(const ShaderModel *pModel, Module *pModule,
+                             AbstractMemoryStream *pStream,
+                             llvm::MD5 &bitcodeHash) {
+  size_t headerPos = pStream->GetPosition();
+  DxilProgramHeader programHeader;
+  InitProgramHeader(pModel, programHeader, 0);
+  IFT(WriteStreamValue(pStream, programHeader));
+
+  size_t bitcodePos = pStream->GetPosition();
+  {
+    raw_hashing_stream_ostream outStream(pStream, bitcodeHash);
+    WriteBitcodeToFile(pModule, outStream, true,
+                       std::thread::hardware_concurrency(),
+                       ParallelForWithThreadMalloc);
+  }
+  uint32_t bitcodeSize = (uint32_t)(pStream->GetPosition() - bitcodePos);
+  WriteProgramPadding(bitcodeSize, pStream);
+
+  InitProgramHeader(pModel, programHeader, bitcodeSize);
+  memcpy(pStream->GetPtr() + headerPos, &programHeader, sizeof(programHeader));
+}
+
+static const uint32_t DebugInfoNameHashLen = 32;   // 32 chars of MD5
+
+static void GetDebugNameHash(ArrayRef<uint8_t> Data, SmallString<32> &Hash) {
+  llvm::MD5 md5;
+  llvm::MD5::MD5Result md5Result;
+  md5.update(Data);
+  md5.final(md5Result);
+  md5.stringifyResult(md5Result, Hash);
+  DXASSERT_NOMSG(Hash.size() == DebugInfoNameHashLen);
 }
 
 void hlsl::SerializeDxilContainerForModule(DxilModule *pModule,
                                            AbstractMemoryStream *pModuleBitcode,
                                            AbstractMemoryStream *pFinalStream,
-                                           SerializeDxilFlags Flags) {
+                                           SerializeDxilFlags Flags,
+                                           DxilPartDigests *pDigests) {
   // TODO: add a flag to update the module and remove information that is not part
   // of DXIL proper and is used only to assemble the container.
 
@@ -854,65 +1455,96 @@ void hlsl::SerializeDxilContainerForModule(DxilModule *pModule,
     PSVWriter.write(pStream);
   });
 
+  // Write the link index (LIDX) part of a library. It is built before debug
+  // info is stripped, so it also covers linking the debug module. Validators
+  // before 1.3 reject parts they don't know.
+  std::unique_ptr<DxilLinkIndexWriter> pLinkIndexWriter;
+  if (pModule->GetShaderModel()->IsLib() &&
+      (ValMajor > 1 || (ValMajor == 1 && ValMinor >= 3) ||
+       (ValMajor == 0 && ValMinor == 0))) {
+    pLinkIndexWriter = llvm::make_unique<DxilLinkIndexWriter>(*pModule);
+    writer.AddPart(DFCC_LinkIndex, pLinkIndexWriter->size(),
+                   [&](AbstractMemoryStream *pStream) {
+                     pLinkIndexWriter->write(pStream);
+                   });
+  }
+
   // Write the root signature (RTS0) part.
+  // Once the module no longer matches pModuleBitcode, the program part is
+  // serialized straight into the container instead of through a buffer.
   DxilProgramRootSignatureWriter rootSigWriter(pModule->GetRootSignature());
-  CComPtr<AbstractMemoryStream> pInputProgramStream = pModuleBitcode;
+  bool bModuleChanged = false;
   if (!pModule->GetRootSignature().IsEmpty()) {
     writer.AddPart(
         DFCC_RootSignature, rootSigWriter.size(),
         [&](AbstractMemoryStream *pStream) { rootSigWriter.write(pStream); });
     pModule->StripRootSignatureFromMetadata();
-    pInputProgramStream.Release();
-    IFT(CreateMemoryStream(DxcGetThreadMallocNoRef(), &pInputProgramStream));
-    raw_stream_ostream outStream(pInputProgramStream.p);
-    WriteBitcodeToFile(pModule->GetModule(), outStream, true);
+    bModuleChanged = true;
   }
 
   // If we have debug information present, serialize it to a debug part, then use the stripped version as the canonical program version.
-  CComPtr<AbstractMemoryStream> pProgramStream = pInputProgramStream;
+  CComPtr<AbstractMemoryStream> pInputProgramStream = pModuleBitcode;
+  std::vector<char> compressedDebugInfo;
+  size_t debugNameHashPos = 0;
   if (HasDebugInfo(*pModule->GetModule())) {
-    uint32_t debugInUInt32, debugPaddingBytes;
-    GetPaddedProgramPartSize(pInputProgramStream, debugInUInt32, debugPaddingBytes);
     if (Flags & SerializeDxilFlags::IncludeDebugInfoPart) {
-      writer.AddPart(DFCC_ShaderDebugInfoDXIL, debugInUInt32 * sizeof(uint32_t) + sizeof(DxilProgramHeader), [&](AbstractMemoryStream *pStream) {
-        WriteProgramPart(pModule->GetShaderModel(), pInputProgramStream, pStream);
-      });
+      if (bModuleChanged) {
+        pInputProgramStream.Release();
+        IFT(CreateMemoryStream(DxcGetThreadMallocNoRef(), &pInputProgramStream));
+        WriteDebugModuleAndRenderParts(pModule->GetModule(),
+                                       pInputProgramStream, writer);
+      }
+      if (Flags & SerializeDxilFlags::CompressDebugInfoPart) {
+        CompressLZ((const char *)pInputProgramStream->GetPtr(),
+                   pInputProgramStream->GetPtrSize(), compressedDebugInfo);
+        uint32_t debugSize = sizeof(DxilProgramHeader) +
+                             sizeof(DxilCompressedBitcodeHeader) +
+                             (((uint32_t)compressedDebugInfo.size() + 3) & ~3u);
+        writer.AddPart(DFCC_ShaderDebugInfoDXIL, debugSize, [&](AbstractMemoryStream *pStream) {
+          WriteCompressedProgramPart(pModule->GetShaderModel(),
+                                     compressedDebugInfo,
+                                     pInputProgramStream->GetPtrSize(),
+                                     pStream);
+        });
+      } else {
+        uint32_t debugInUInt32, debugPaddingBytes;
+        GetPaddedProgramPartSize(pInputProgramStream, debugInUInt32, debugPaddingBytes);
+        writer.AddPart(DFCC_ShaderDebugInfoDXIL, debugInUInt32 * sizeof(uint32_t) + sizeof(DxilProgramHeader), [&](AbstractMemoryStream *pStream) {
+          WriteProgramPart(pModule->GetShaderModel(), pInputProgramStream,
+                           pStream, nullptr);
+        });
+      }
     }
 
-    pProgramStream.Release();
-
     llvm::StripDebugInfo(*pModule->GetModule());
     pModule->StripDebugRelatedCode();
-
-    IFT(CreateMemoryStream(DxcGetThreadMallocNoRef(), &pProgramStream));
-    raw_stream_ostream outStream(pProgramStream.p);
-    WriteBitcodeToFile(pModule->GetModule(), outStream, true);
+    bModuleChanged = true;
 
     if (Flags & SerializeDxilFlags::IncludeDebugNamePart) {
-      CComPtr<AbstractMemoryStream> pHashStream;
       // If the debug name should be specific to the sources, base the name on the debug
       // bitcode, which will include the source references, line numbers, etc. Otherwise,
-      // do it exclusively on the target shader bitcode.
-      pHashStream = (int)(Flags & SerializeDxilFlags::DebugNameDependOnSource) ? pModuleBitcode : pProgramStream;
-      const uint32_t DebugInfoNameHashLen = 32;   // 32 chars of MD5
+      // do it exclusively on the target shader bitcode, which is only written with the
+      // program part; the name is filled in from the shader hash then.
+      bool bHashSource = (int)(Flags & SerializeDxilFlags::DebugNameDependOnSource);
       const uint32_t DebugInfoNameSuffix = 4;     // '.lld'
       const uint32_t DebugInfoNameNullAndPad = 4; // '\0\0\0\0'
       const uint32_t DebugInfoContentLen =
           sizeof(DxilShaderDebugName) + DebugInfoNameHashLen +
           DebugInfoNameSuffix + DebugInfoNameNullAndPad;
-      writer.AddPart(DFCC_ShaderDebugName, DebugInfoContentLen, [&](AbstractMemoryStream *pStream) {
+      writer.AddPart(DFCC_ShaderDebugName, DebugInfoContentLen, [&, bHashSource](AbstractMemoryStream *pStream) {
         DxilShaderDebugName NameContent;
         NameContent.Flags = 0;
         NameContent.NameLength = DebugInfoNameHashLen + DebugInfoNameSuffix;
         IFT(WriteStreamValue(pStream, NameContent));
 
-        ArrayRef<uint8_t> Data((uint8_t *)pHashStream->GetPtr(), pHashStream->GetPtrSize());
-        llvm::MD5 md5;
-        llvm::MD5::MD5Result md5Result;
         SmallString<32> Hash;
-        md5.update(Data);
-        md5.final(md5Result);
-        md5.stringifyResult(md5Result, Hash);
+        if (bHashSource) {
+          ArrayRef<uint8_t> Data((uint8_t *)pModuleBitcode->GetPtr(), pModuleBitcode->GetPtrSize());
+          GetDebugNameHash(Data, Hash);
+        } else {
+          debugNameHashPos = pStream->GetPosition();
+          Hash.assign(DebugInfoNameHashLen, '0');
+        }
 
         ULONG cbWritten;
         IFT(pStream->Write(Hash.data(), Hash.size(), &cbWritten));
@@ -922,16 +1554,105 @@ void hlsl::SerializeDxilContainerForModule(DxilModule *pModule,
     }
   }
 
-  // Compute padded bitcode size.
-  uint32_t programInUInt32, programPaddingBytes;
-  GetPaddedProgramPartSize(pProgramStream, programInUInt32, programPaddingBytes);
+  // Write the shader hash (HASH) part. The digest is that of the program
+  // bitcode, which is hashed as the program part is written, so the part is
+  // filled in once the container is complete.
+  size_t shaderHashPos = 0;
+  if (ValMajor > 1 || (ValMajor == 1 && ValMinor >= 4) ||
+      (ValMajor == 0 && ValMinor == 0)) {
+    writer.AddPart(DFCC_ShaderHash, sizeof(DxilShaderHash),
+                   [&](AbstractMemoryStream *pStream) {
+                     DxilShaderHash HashContent;
+                     memset(&HashContent, 0, sizeof(HashContent));
+                     shaderHashPos = pStream->GetPosition();
+                     IFT(WriteStreamValue(pStream, HashContent));
+                   });
+  }
 
   // Write the program part.
-  writer.AddPart(DFCC_DXIL, programInUInt32 * sizeof(uint32_t) + sizeof(DxilProgramHeader), [&](AbstractMemoryStream *pStream) {
-    WriteProgramPart(pModule->GetShaderModel(), pProgramStream, pStream);
-  });
+  llvm::MD5 bitcodeHash;
+  if (bModuleChanged) {
+    writer.AddStreamedPart(DFCC_DXIL, [&](AbstractMemoryStream *pStream) {
+      WriteProgramPart(pModule->GetShaderModel(), pModule->GetModule(),
+                       pStream, bitcodeHash);
+    });
+  } else {
+    // Compute padded bitcode size.
+    uint32_t programInUInt32, programPaddingBytes;
+    GetPaddedProgramPartSize(pModuleBitcode, programInUInt32, programPaddingBytes);
+    writer.AddPart(DFCC_DXIL, programInUInt32 * sizeof(uint32_t) + sizeof(DxilProgramHeader), [&](AbstractMemoryStream *pStream) {
+      WriteProgramPart(pModule->GetShaderModel(), pModuleBitcode, pStream,
+                       &bitcodeHash);
+    });
+  }
 
   writer.write(pFinalStream);
+
+  llvm::MD5::MD5Result bitcodeDigest;
+  bitcodeHash.final(bitcodeDigest);
+  LPBYTE pBase = pFinalStream->GetPtr();
+  if (shaderHashPos != 0) {
+    memcpy(pBase + shaderHashPos + offsetof(DxilShaderHash, Digest),
+           bitcodeDigest, DxilShaderHashSize);
+  }
+  if (debugNameHashPos != 0) {
+    SmallString<32> Hash;
+    llvm::MD5::stringifyResult(bitcodeDigest, Hash);
+    DXASSERT_NOMSG(Hash.size() == DebugInfoNameHashLen);
+    memcpy(pBase + debugNameHashPos, Hash.data(), Hash.size());
+  }
+
+  // Only the parts the validator would generate from the module again.
+  if (pDigests) {
+    const DxilContainerHeader *pContainer =
+        (const DxilContainerHeader *)pBase;
+    for (auto it = begin(pContainer), itEnd = end(pContainer); it != itEnd;
+         ++it) {
+      const DxilPartHeader *pPart = *it;
+      switch (pPart->PartFourCC) {
+      case DFCC_FeatureInfo:
+      case DFCC_InputSignature:
+      case DFCC_OutputSignature:
+      case DFCC_PatchConstantSignature:
+      case DFCC_PipelineStateValidation:
+        pDigests->Add(pPart);
+        break;
+      default:
+        break;
+      }
+    }
+  }
+}
+
+static void GetPartDigest(const DxilPartHeader *pPart,
+                          uint8_t (&Digest)[DxilShaderHashSize]) {
+  llvm::MD5 md5;
+  llvm::MD5::MD5Result md5Result;
+  md5.update(ArrayRef<uint8_t>((const uint8_t *)GetDxilPartData(pPart),
+                               pPart->PartSize));
+  md5.final(md5Result);
+  memcpy(Digest, md5Result, DxilShaderHashSize);
+}
+
+void DxilPartDigests::Add(const DxilPartHeader *pPart) {
+  Entry E;
+  E.FourCC = pPart->PartFourCC;
+  E.Size = pPart->PartSize;
+  GetPartDigest(pPart, E.Digest);
+  m_Entries.push_back(E);
+}
+
+bool DxilPartDigests::Matches(const DxilPartHeader *pPart) const {
+  for (const Entry &E : m_Entries) {
+    if (E.FourCC != pPart->PartFourCC)
+      continue;
+    if (E.Size != pPart->PartSize)
+      return false;
+    uint8_t Digest[DxilShaderHashSize];
+    GetPartDigest(pPart, Digest);
+    return memcmp(E.Digest, Digest, DxilShaderHashSize) == 0;
+  }
+  return false;
 }
 
 void hlsl::SerializeDxilContainerForRootSignature(hlsl::RootSignatureHandle *pRootSigHandle,
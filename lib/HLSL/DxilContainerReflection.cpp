@@ -9,14 +9,17 @@
 //                                                                           //
 ///////////////////////////////////////////////////////////////////////////////
 
+#include "llvm/ADT/StringMap.h"
 #include "llvm/Bitcode/ReaderWriter.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/InstIterator.h"
+#include "dxc/HLSL/DxilCBufferUsage.h"
 #include "dxc/HLSL/DxilContainer.h"
 #include "dxc/HLSL/DxilModule.h"
 #include "dxc/HLSL/DxilShaderModel.h"
 #include "dxc/HLSL/DxilOperations.h"
 #include "dxc/HLSL/DxilInstructions.h"
+#include "dxc/HLSL/DxilShaderCost.h"
 #include "dxc/Support/Global.h"
 #include "dxc/Support/Unicode.h"
 #include "dxc/Support/WinIncludes.h"
@@ -24,6 +27,9 @@
 #include "dxc/Support/FileIOHelper.h"
 #include "dxc/Support/dxcapi.impl.h"
 
+#include <algorithm>
+#include <map>
+#include <tuple>
 #include <unordered_set>
 
 #include "dxc/dxcapi.h"
@@ -68,10 +74,29 @@ public:
 
 class CShaderReflectionConstantBuffer;
 class CShaderReflectionType;
+class CShaderReflectionVariable;
+
+// Creates reflection types the first time they are asked for, and shares one
+// between all variables and members of the same type at the same offset.
+class CShaderReflectionTypeCache {
+  // The LLVM type, component type, matrix orientation, rows and columns, and
+  // offset: everything CShaderReflectionType::Initialize reads.
+  typedef std::tuple<llvm::Type *, unsigned, unsigned, unsigned, unsigned,
+                     unsigned> TypeKey;
+  DxilModule *m_pModule = nullptr;
+  std::vector<std::unique_ptr<CShaderReflectionType>> m_Types;
+  std::map<TypeKey, CShaderReflectionType *> m_TypeMap;
+
+public:
+  void Initialize(DxilModule &M) { m_pModule = &M; }
+  CShaderReflectionType *Get(llvm::Type *Ty, DxilFieldAnnotation &annotation,
+                             unsigned baseOffset);
+};
 class DxilShaderReflection : public ID3D12ShaderReflection {
 private:
   DXC_MICROCOM_TM_REF_FIELDS()
   CComPtr<IDxcBlob> m_pContainer;
+  std::vector<char> m_DecompressedBitcode; // For a compressed debug part.
   LLVMContext Context;
   std::unique_ptr<Module> m_pModule; // Must come after LLVMContext, otherwise unique_ptr will over-delete.
   DxilModule *m_pDxilModule = nullptr;
@@ -81,8 +106,17 @@ private:
   std::vector<D3D12_SIGNATURE_PARAMETER_DESC>     m_OutputSignature;
   std::vector<D3D12_SIGNATURE_PARAMETER_DESC>     m_PatchConstantSignature;
   std::vector<std::unique_ptr<char[]>>            m_UpperCaseNames;
-  std::vector<std::unique_ptr<CShaderReflectionType>> m_Types;
+  CShaderReflectionTypeCache m_Types;
+  // Name lookups; where names repeat, the first one wins, as in a search.
+  llvm::StringMap<CShaderReflectionVariable *> m_VariablesByName;
+  llvm::StringMap<unsigned> m_CBsByName;
+  llvm::StringMap<unsigned> m_ResourcesByName;
+  // Whether function bodies have been read to find what the shader uses.
+  bool m_bUsageMarked = false;
+  // Estimated cost of the entry point, for the instruction counts.
+  DxilShaderCost m_Cost;
   void CreateReflectionObjects();
+  void MarkUsage();
   void SetCBufferUsage();
   void CreateReflectionObjectForResource(DxilResourceBase *R);
   void CreateReflectionObjectsForSignature(
@@ -288,7 +322,7 @@ public:
     llvm::Type              *type,
     DxilFieldAnnotation     &typeAnnotation,
     unsigned int            baseOffset,
-    std::vector<std::unique_ptr<CShaderReflectionType>>& allTypes);
+    CShaderReflectionTypeCache &allTypes);
 
   // ID3D12ShaderReflectionType
   STDMETHOD(GetDesc)(D3D12_SHADER_TYPE_DESC *pDesc);
@@ -317,11 +351,21 @@ protected:
   CShaderReflectionType              *m_pType;
   CShaderReflectionConstantBuffer    *m_pBuffer;
   BYTE                               *m_pDefaultValue;
+  // What m_pType is created from, when it is first asked for.
+  CShaderReflectionTypeCache         *m_pTypeCache;
+  llvm::Type                         *m_pLLVMType;
+  DxilFieldAnnotation                *m_pTypeAnnotation;
+  unsigned                            m_TypeBaseOffset;
 
 public:
   void Initialize(CShaderReflectionConstantBuffer *pBuffer,
-                  D3D12_SHADER_VARIABLE_DESC *pDesc,
-                  CShaderReflectionType *pType, BYTE *pDefaultValue);
+                  D3D12_SHADER_VARIABLE_DESC *pDesc, BYTE *pDefaultValue);
+  void SetType(CShaderReflectionTypeCache *pTypeCache, llvm::Type *Ty,
+               DxilFieldAnnotation *pAnnotation, unsigned baseOffset);
+  void ClearUsed() { m_Desc.uFlags &= ~D3D_SVF_USED; }
+  void SetBuffer(CShaderReflectionConstantBuffer *pBuffer) {
+    m_pBuffer = pBuffer;
+  }
 
   LPCSTR GetName() { return m_Desc.Name; }
 
@@ -345,15 +389,19 @@ public:
   CShaderReflectionConstantBuffer(CShaderReflectionConstantBuffer &&other) {
     m_Desc = other.m_Desc;
     std::swap(m_Variables, other.m_Variables);
+    for (CShaderReflectionVariable &Var : m_Variables)
+      Var.SetBuffer(this);
   }
 
   void Initialize(DxilModule &M,
                   DxilCBuffer &CB,
-                  std::vector<std::unique_ptr<CShaderReflectionType>>& allTypes);
+                  CShaderReflectionTypeCache &allTypes);
   void InitializeStructuredBuffer(DxilModule &M,
                                   DxilResource &R,
-                                  std::vector<std::unique_ptr<CShaderReflectionType>>& allTypes);
+                                  CShaderReflectionTypeCache &allTypes);
   LPCSTR GetName() { return m_Desc.Name; }
+  unsigned GetVariableCount() { return m_Variables.size(); }
+  CShaderReflectionVariable &GetVariable(unsigned i) { return m_Variables[i]; }
 
   // ID3D12ShaderReflectionConstantBuffer
   STDMETHOD(GetDesc)(D3D12_SHADER_BUFFER_DESC *pDesc);
@@ -412,11 +460,25 @@ static CInvalidSRConstantBuffer g_InvalidSRConstantBuffer;
 
 void CShaderReflectionVariable::Initialize(
     CShaderReflectionConstantBuffer *pBuffer, D3D12_SHADER_VARIABLE_DESC *pDesc,
-    CShaderReflectionType *pType, BYTE *pDefaultValue) {
+    BYTE *pDefaultValue) {
   m_pBuffer = pBuffer;
   memcpy(&m_Desc, pDesc, sizeof(m_Desc));
-  m_pType = pType;
+  m_pType = nullptr;
   m_pDefaultValue = pDefaultValue;
+  m_pTypeCache = nullptr;
+  m_pLLVMType = nullptr;
+  m_pTypeAnnotation = nullptr;
+  m_TypeBaseOffset = 0;
+}
+
+void CShaderReflectionVariable::SetType(CShaderReflectionTypeCache *pTypeCache,
+                                        llvm::Type *Ty,
+                                        DxilFieldAnnotation *pAnnotation,
+                                        unsigned baseOffset) {
+  m_pTypeCache = pTypeCache;
+  m_pLLVMType = Ty;
+  m_pTypeAnnotation = pAnnotation;
+  m_TypeBaseOffset = baseOffset;
 }
 
 HRESULT CShaderReflectionVariable::GetDesc(D3D12_SHADER_VARIABLE_DESC *pDesc) {
@@ -426,6 +488,9 @@ HRESULT CShaderReflectionVariable::GetDesc(D3D12_SHADER_VARIABLE_DESC *pDesc) {
 }
 
 ID3D12ShaderReflectionType *CShaderReflectionVariable::GetType() {
+  if (!m_pType && m_pTypeCache)
+    m_pType = m_pTypeCache->Get(m_pLLVMType, *m_pTypeAnnotation,
+                                m_TypeBaseOffset);
   return m_pType;
 }
 
@@ -640,7 +705,7 @@ HRESULT CShaderReflectionType::Initialize(
   llvm::Type              *inType,
   DxilFieldAnnotation     &typeAnnotation,
   unsigned int            baseOffset,
-  std::vector<std::unique_ptr<CShaderReflectionType>>& allTypes)
+  CShaderReflectionTypeCache &allTypes)
 {
   DXASSERT_NOMSG(inType);
 
@@ -857,10 +922,8 @@ HRESULT CShaderReflectionType::Initialize(
           continue;
         }
 
-        CShaderReflectionType *fieldReflectionType = new CShaderReflectionType();
-        allTypes.push_back(std::unique_ptr<CShaderReflectionType>(fieldReflectionType));
-
-        fieldReflectionType->Initialize(M, fieldType, fieldAnnotation, 0, allTypes);
+        CShaderReflectionType *fieldReflectionType =
+            allTypes.Get(fieldType, fieldAnnotation, 0);
 
         m_MemberTypes.push_back(fieldReflectionType);
         m_MemberNames.push_back(fieldAnnotation.GetFieldName().c_str());
@@ -924,11 +987,39 @@ HRESULT CShaderReflectionType::Initialize(
   return S_OK;
 }
 
+CShaderReflectionType *
+CShaderReflectionTypeCache::Get(llvm::Type *Ty,
+                                DxilFieldAnnotation &annotation,
+                                unsigned baseOffset) {
+  DXASSERT(m_pModule, "otherwise the cache was not initialized");
+  unsigned orientation = UINT_MAX, rows = 0, cols = 0;
+  if (annotation.HasMatrixAnnotation()) {
+    const DxilMatrixAnnotation &matrix = annotation.GetMatrixAnnotation();
+    orientation = (unsigned)matrix.Orientation;
+    rows = matrix.Rows;
+    cols = matrix.Cols;
+  }
+  TypeKey key(Ty, (unsigned)annotation.GetCompType().GetKind(), orientation,
+              rows, cols, annotation.GetCBufferOffset() - baseOffset);
+  auto it = m_TypeMap.find(key);
+  if (it != m_TypeMap.end())
+    return it->second;
+
+  // Struct members are created before the struct is added, which is fine as
+  // HLSL types cannot contain themselves.
+  std::unique_ptr<CShaderReflectionType> pType(new CShaderReflectionType());
+  pType->Initialize(*m_pModule, Ty, annotation, baseOffset, *this);
+  CShaderReflectionType *pResult = pType.get();
+  m_Types.push_back(std::move(pType));
+  m_TypeMap[key] = pResult;
+  return pResult;
+}
+
 
 void CShaderReflectionConstantBuffer::Initialize(
   DxilModule &M,
   DxilCBuffer &CB,
-  std::vector<std::unique_ptr<CShaderReflectionType>>& allTypes) {
+  CShaderReflectionTypeCache &allTypes) {
   ZeroMemory(&m_Desc, sizeof(m_Desc));
   m_Desc.Name = CB.GetGlobalName().c_str();
   m_Desc.Size = CB.GetSize() / CB.GetRangeSize();
@@ -950,7 +1041,6 @@ void CShaderReflectionConstantBuffer::Initialize(
     return;
 
   m_Desc.Variables = ST->getNumContainedTypes();
-  unsigned lastIndex = ST->getNumContainedTypes() - 1;
 
   for (unsigned i = 0; i < ST->getNumContainedTypes(); ++i) {
     DxilFieldAnnotation &fieldAnnotation = annotation->GetFieldAnnotation(i);
@@ -959,24 +1049,17 @@ void CShaderReflectionConstantBuffer::Initialize(
     ZeroMemory(&VarDesc, sizeof(VarDesc));
     VarDesc.uFlags |= D3D_SVF_USED; // Will update in SetCBufferUsage.
     CShaderReflectionVariable Var;
-    //Create reflection type.
-    CShaderReflectionType *pVarType = new CShaderReflectionType();
-    allTypes.push_back(std::unique_ptr<CShaderReflectionType>(pVarType));
-    pVarType->Initialize(M, ST->getContainedType(i), fieldAnnotation, fieldAnnotation.GetCBufferOffset(), allTypes);
-
     BYTE *pDefaultValue = nullptr;
 
     VarDesc.Name = fieldAnnotation.GetFieldName().c_str();
     VarDesc.StartOffset = fieldAnnotation.GetCBufferOffset();
-    if (i < lastIndex) {
-      DxilFieldAnnotation &nextFieldAnnotation =
-          annotation->GetFieldAnnotation(i + 1);
-      VarDesc.Size = nextFieldAnnotation.GetCBufferOffset() - fieldAnnotation.GetCBufferOffset();
-    }
-    else {
-      VarDesc.Size = CB.GetSize() - fieldAnnotation.GetCBufferOffset();
-    }
-    Var.Initialize(this, &VarDesc, pVarType, pDefaultValue);
+    // Members with packoffset or from -optimize-cbuffer-layout may be out of
+    // declaration order.
+    VarDesc.Size = annotation->GetCBufferFieldSpan(i);
+    Var.Initialize(this, &VarDesc, pDefaultValue);
+    // The reflection type is only created if it is asked for.
+    Var.SetType(&allTypes, ST->getContainedType(i), &fieldAnnotation,
+                fieldAnnotation.GetCBufferOffset());
     m_Variables.push_back(Var);
   }
 }
@@ -1019,7 +1102,7 @@ static unsigned CalcResTypeSize(DxilModule &M, DxilResource &R) {
 void CShaderReflectionConstantBuffer::InitializeStructuredBuffer(
   DxilModule &M,
   DxilResource &R,
-  std::vector<std::unique_ptr<CShaderReflectionType>>& allTypes) {
+  CShaderReflectionTypeCache &allTypes) {
   ZeroMemory(&m_Desc, sizeof(m_Desc));
   m_Desc.Name = R.GetGlobalName().c_str();
   //m_Desc.Size = R.GetSize();
@@ -1035,9 +1118,10 @@ void CShaderReflectionConstantBuffer::InitializeStructuredBuffer(
   VarDesc.StartSampler = UINT_MAX;
   VarDesc.uFlags |= D3D_SVF_USED; // TODO: not necessarily true
   CShaderReflectionVariable Var;
-  CShaderReflectionType *pVarType = nullptr;
+  BYTE *pDefaultValue = nullptr;
+  Var.Initialize(this, &VarDesc, pDefaultValue);
 
-  // Create reflection type, if we have the necessary annotation info
+  // Set up the reflection type, if we have the necessary annotation info
 
   // Extract the `struct` that wraps element type of the buffer resource
   Constant *GV = R.GetGlobalSymbol();
@@ -1054,19 +1138,14 @@ void CShaderReflectionConstantBuffer::InitializeStructuredBuffer(
   // Dxil from dxbc doesn't have annotation.
   if(annotation)
   {
-    // Actually create the reflection type.
-    pVarType = new CShaderReflectionType();
-    allTypes.push_back(std::unique_ptr<CShaderReflectionType>(pVarType));
-
     // The user-visible element type is the first field of the wrapepr `struct`
     Type *fieldType = ST->getElementType(0);
     DxilFieldAnnotation &fieldAnnotation = annotation->GetFieldAnnotation(0);
 
-    pVarType->Initialize(M, fieldType, fieldAnnotation, fieldAnnotation.GetCBufferOffset(), allTypes);
+    Var.SetType(&allTypes, fieldType, &fieldAnnotation,
+                fieldAnnotation.GetCBufferOffset());
   }
 
-  BYTE *pDefaultValue = nullptr;
-  Var.Initialize(this, &VarDesc, pVarType, pDefaultValue);
   m_Variables.push_back(Var);
 
   m_Desc.Size = VarDesc.Size;
@@ -1264,155 +1343,42 @@ void DxilShaderReflection::CreateReflectionObjectForResource(DxilResourceBase *R
   m_Resources.push_back(inputBind);
 }
 
-// Find the imm offset part from a value.
-// It must exist unless offset is 0.
-static unsigned GetCBOffset(Value *V) {
-  if (ConstantInt *Imm = dyn_cast<ConstantInt>(V))
-    return Imm->getLimitedValue();
-  else if (UnaryInstruction *UI = dyn_cast<UnaryInstruction>(V)) {
-    return 0;
-  } else if (BinaryOperator *BO = dyn_cast<BinaryOperator>(V)) {
-    switch (BO->getOpcode()) {
-    case Instruction::Add: {
-      unsigned left = GetCBOffset(BO->getOperand(0));
-      unsigned right = GetCBOffset(BO->getOperand(1));
-      return left + right;
-    } break;
-    case Instruction::Or: {
-      unsigned left = GetCBOffset(BO->getOperand(0));
-      unsigned right = GetCBOffset(BO->getOperand(1));
-      return left | right;
-    } break;
-    default:
-      return 0;
-    }
-  } else {
-    return 0;
-  }
-}
-
-void CollectInPhiChain(PHINode *cbUser, std::vector<unsigned> &cbufUsage,
-                  unsigned offset, std::unordered_set<Value *> &userSet) {
-  if (userSet.count(cbUser) > 0)
-    return;
-
-  userSet.insert(cbUser);
-  for (User *cbU : cbUser->users()) {
-    if (ExtractValueInst *EV = dyn_cast<ExtractValueInst>(cbU)) {
-      for (unsigned idx : EV->getIndices()) {
-        cbufUsage.emplace_back(offset + idx * 4);
-      }
-    } else {
-      PHINode *phi = cast<PHINode>(cbU);
-      CollectInPhiChain(phi, cbufUsage, offset, userSet);
-    }
-  }
-}
-
-static void CollectCBufUsage(Value *cbHandle,
-                             std::vector<unsigned> &cbufUsage) {
-  for (User *U : cbHandle->users()) {
-    CallInst *CI = cast<CallInst>(U);
-    ConstantInt *opcodeV =
-        cast<ConstantInt>(CI->getArgOperand(DXIL::OperandIndex::kOpcodeIdx));
-    DXIL::OpCode opcode = static_cast<DXIL::OpCode>(opcodeV->getLimitedValue());
-    if (opcode == DXIL::OpCode::CBufferLoadLegacy) {
-      DxilInst_CBufferLoadLegacy cbload(CI);
-      Value *resIndex = cbload.get_regIndex();
-      unsigned offset = GetCBOffset(resIndex);
-      // 16 bytes align.
-      offset <<= 4;
-      for (User *cbU : U->users()) {
-        if (ExtractValueInst *EV = dyn_cast<ExtractValueInst>(cbU)) {
-          for (unsigned idx : EV->getIndices()) {
-            cbufUsage.emplace_back(offset + idx * 4);
-          }
-        } else {
-          PHINode *phi = cast<PHINode>(cbU);
-          std::unordered_set<Value *> userSet;
-          CollectInPhiChain(phi, cbufUsage, offset, userSet);
-        }
-      }
-    } else if (opcode == DXIL::OpCode::CBufferLoad) {
-      DxilInst_CBufferLoad cbload(CI);
-      Value *byteOffset = cbload.get_byteOffset();
-      unsigned offset = GetCBOffset(byteOffset);
-      cbufUsage.emplace_back(offset);
-    } else {
-      //
-      DXASSERT(0, "invalid opcode");
-    }
-  }
-}
-
 static void SetCBufVarUsage(CShaderReflectionConstantBuffer &cb,
-                            std::vector<unsigned> usage) {
-  D3D12_SHADER_BUFFER_DESC Desc;
-  if (FAILED(cb.GetDesc(&Desc)))
-    return;
-
-  unsigned size = Desc.Variables;
-
-  std::sort(usage.begin(), usage.end());
-  for (unsigned i = 0; i < size; i++) {
-    ID3D12ShaderReflectionVariable *pVar = cb.GetVariableByIndex(i);
+                            const DxilCBufferUsedRanges &usage) {
+  for (unsigned i = 0; i < cb.GetVariableCount(); i++) {
+    CShaderReflectionVariable &Var = cb.GetVariable(i);
     D3D12_SHADER_VARIABLE_DESC VarDesc;
-    if (FAILED(pVar->GetDesc(&VarDesc)))
-      continue;
-    if (!pVar)
+    if (FAILED(Var.GetDesc(&VarDesc)))
       continue;
 
     unsigned begin = VarDesc.StartOffset;
     unsigned end = begin + VarDesc.Size;
-    auto beginIt = std::find_if(usage.begin(), usage.end(),
-                                [&](unsigned v) { return v >= begin; });
-    auto endIt = std::find_if(usage.begin(), usage.end(),
-                              [&](unsigned v) { return v >= end; });
-
-    bool used = beginIt != endIt;
-    // Clear used.
-    if (!used) {
-      CShaderReflectionType *pVarType = (CShaderReflectionType *)pVar->GetType();
-      BYTE *pDefaultValue = nullptr;
-
-      VarDesc.uFlags &= ~D3D_SVF_USED;
-      CShaderReflectionVariable *pCVarDesc = (CShaderReflectionVariable*)pVar;
-      pCVarDesc->Initialize(&cb, &VarDesc, pVarType, pDefaultValue);
-    }
+    // The first range that ends after the variable begins.
+    auto it = std::upper_bound(
+        usage.begin(), usage.end(), begin,
+        [](unsigned v, const std::pair<unsigned, unsigned> &range) {
+          return v < range.second;
+        });
+
+    bool used = it != usage.end() && it->first < end;
+    // Clear used, without creating the variable's type.
+    if (!used)
+      Var.ClearUsed();
   }
 }
 
 void DxilShaderReflection::SetCBufferUsage() {
-  hlsl::OP *hlslOP = m_pDxilModule->GetOP();
-  LLVMContext &Ctx = m_pDxilModule->GetCtx();
-  unsigned cbSize = m_CBs.size();
-  std::vector< std::vector<unsigned> > cbufUsage(cbSize);
-
-  Function *createHandle = hlslOP->GetOpFunc(DXIL::OpCode::CreateHandle, Type::getVoidTy(Ctx));
-
-  if (createHandle->user_empty()) {
-    createHandle->eraseFromParent();
-    return;
-  }
-
-  // Find all cb handles.
-  for (User *U : createHandle->users()) {
-    DxilInst_CreateHandle handle(cast<CallInst>(U));
-    Value *resClass = handle.get_resourceClass();
-    ConstantInt *immResClass = cast<ConstantInt>(resClass);
-    if (immResClass->getLimitedValue() == (unsigned)DXIL::ResourceClass::CBuffer) {
-      ConstantInt *cbID = cast<ConstantInt>(handle.get_rangeId());
-      CollectCBufUsage(U, cbufUsage[cbID->getLimitedValue()]);
-    }
-  }
-
-  for (unsigned i=0;i<cbSize;i++) {
+  // Structured buffers follow the cbuffers in m_CBs and have no usage.
+  std::vector<DxilCBufferUsedRanges> cbufUsage =
+      CollectCBufferUsage(*m_pDxilModule);
+  for (unsigned i = 0; i < cbufUsage.size(); i++) {
     SetCBufVarUsage(m_CBs[i], cbufUsage[i]);
   }
 }
 
 void DxilShaderReflection::CreateReflectionObjects() {
   DXASSERT_NOMSG(m_pDxilModule != nullptr);
+  m_Types.Initialize(*m_pDxilModule);
 
   // Create constant buffers, resources and signatures.
   for (auto && cb : m_pDxilModule->GetCBuffers()) {
@@ -1420,8 +1386,6 @@ void DxilShaderReflection::CreateReflectionObjects() {
     rcb.Initialize(*m_pDxilModule, *(cb.get()), m_Types);
     m_CBs.push_back(std::move(rcb));
   }
-  // Set cbuf usage.
-  SetCBufferUsage();
 
   // TODO: add tbuffers into m_CBs
   for (auto && uav : m_pDxilModule->GetUAVs()) {
@@ -1455,11 +1419,44 @@ void DxilShaderReflection::CreateReflectionObjects() {
     CreateReflectionObjectForResource(uavRes.get());
   }
 
+  // Index names once all objects are in place; moving a constant buffer
+  // doesn't move its variables.
+  for (unsigned i = 0; i < m_CBs.size(); ++i) {
+    CShaderReflectionConstantBuffer &CB = m_CBs[i];
+    m_CBsByName.insert(std::make_pair(StringRef(CB.GetName()), i));
+    for (unsigned v = 0; v < CB.GetVariableCount(); ++v) {
+      CShaderReflectionVariable &Var = CB.GetVariable(v);
+      m_VariablesByName.insert(std::make_pair(StringRef(Var.GetName()), &Var));
+    }
+  }
+  for (unsigned i = 0; i < m_Resources.size(); ++i) {
+    m_ResourcesByName.insert(
+        std::make_pair(StringRef(m_Resources[i].Name), i));
+  }
+
   // Populate input/output/patch constant signatures.
   CreateReflectionObjectsForSignature(m_pDxilModule->GetInputSignature(), m_InputSignature);
   CreateReflectionObjectsForSignature(m_pDxilModule->GetOutputSignature(), m_OutputSignature);
   CreateReflectionObjectsForSignature(m_pDxilModule->GetPatchConstantSignature(), m_PatchConstantSignature);
+}
+
+// Only variable and signature element usage and the instruction counts need
+// function bodies, so they are read the first time one of those is asked
+// for. Loaders that only look at bindings, signature layout, thread group
+// size or flags never pay for it.
+void DxilShaderReflection::MarkUsage() {
+  if (m_bUsageMarked)
+    return;
+  m_bUsageMarked = true;
+  // Without bodies, usage stays at its default: unread inputs, written
+  // outputs, and unused variables.
+  if (m_pModule->materializeAllPermanently())
+    return;
+  SetCBufferUsage();
   MarkUsedSignatureElements();
+  Function *pEntry = m_pDxilModule->GetEntryFunction();
+  if (pEntry && !pEntry->isDeclaration())
+    EstimateShaderCost(*pEntry, m_Cost);
 }
 
 static D3D_REGISTER_COMPONENT_TYPE CompTypeToRegisterComponentType(CompType CT) {
@@ -1643,21 +1640,24 @@ HRESULT DxilShaderReflection::Load(IDxcBlob *pBlob,
   try {
     const char *pBitcode;
     uint32_t bitcodeLength;
-    GetDxilProgramBitcode((DxilProgramHeader *)pData, &pBitcode, &bitcodeLength);
-    std::unique_ptr<MemoryBuffer> pMemBuffer =
-        MemoryBuffer::getMemBufferCopy(StringRef(pBitcode, bitcodeLength));
-#if 0 // We materialize eagerly, because we'll need to walk instructions to look for usage information.
+    if (!GetDecompressedDxilProgramBitcode(
+            (const DxilProgramHeader *)pData, pPart->PartSize,
+            m_DecompressedBitcode, &pBitcode, &bitcodeLength)) {
+      return E_INVALIDARG;
+    }
+    // The container is kept alive by m_pContainer, and decompressed bitcode
+    // by m_DecompressedBitcode, so the bitcode is read in place. Function bodies are only materialized by MarkUsage; everything
+    // else comes from globals and metadata.
+    std::unique_ptr<MemoryBuffer> pMemBuffer = MemoryBuffer::getMemBuffer(
+        StringRef(pBitcode, bitcodeLength), "", false);
     ErrorOr<std::unique_ptr<Module>> module =
         getLazyBitcodeModule(std::move(pMemBuffer), Context);
-#else
-    ErrorOr<std::unique_ptr<Module>> module =
-      parseBitcodeFile(pMemBuffer->getMemBufferRef(), Context, nullptr);
-#endif
     if (!module) {
       return E_INVALIDARG;
     }
     std::swap(m_pModule, module.get());
-    m_pDxilModule = &m_pModule->GetOrCreateDxilModule();
+    m_pDxilModule = &m_pModule->GetOrCreateDxilModule(/*skipInit*/true);
+    m_pDxilModule->LoadDxilMetadata(/*bLazy*/true);
     CreateReflectionObjects();
     return S_OK;
   }
@@ -1680,25 +1680,27 @@ HRESULT DxilShaderReflection::GetDesc(D3D12_SHADER_DESC *pDesc) {
   pDesc->OutputParameters = m_OutputSignature.size();
   pDesc->PatchConstantParameters = m_PatchConstantSignature.size();
 
-  // Unset:  UINT                    InstructionCount;            // Number of emitted instructions
-  // Unset:  UINT                    TempRegisterCount;           // Number of temporary registers used 
+  // The instruction counts come from the cost estimate of the entry point.
+  MarkUsage();
+  pDesc->InstructionCount = m_Cost.Instructions;
+  pDesc->TempRegisterCount = m_Cost.MaxLiveValues;
   // Unset:  UINT                    TempArrayCount;              // Number of temporary arrays used
   // Unset:  UINT                    DefCount;                    // Number of constant defines 
   // Unset:  UINT                    DclCount;                    // Number of declarations (input + output)
-  // Unset:  UINT                    TextureNormalInstructions;   // Number of non-categorized texture instructions
-  // Unset:  UINT                    TextureLoadInstructions;     // Number of texture load instructions
-  // Unset:  UINT                    TextureCompInstructions;     // Number of texture comparison instructions
-  // Unset:  UINT                    TextureBiasInstructions;     // Number of texture bias instructions
-  // Unset:  UINT                    TextureGradientInstructions; // Number of texture gradient instructions
-  // Unset:  UINT                    FloatInstructionCount;       // Number of floating point arithmetic instructions used
-  // Unset:  UINT                    IntInstructionCount;         // Number of signed integer arithmetic instructions used
-  // Unset:  UINT                    UintInstructionCount;        // Number of unsigned integer arithmetic instructions used
-  // Unset:  UINT                    StaticFlowControlCount;      // Number of static flow control instructions used
-  // Unset:  UINT                    DynamicFlowControlCount;     // Number of dynamic flow control instructions used
+  pDesc->TextureNormalInstructions = m_Cost.TextureSamples;
+  pDesc->TextureLoadInstructions = m_Cost.TextureLoads;
+  pDesc->TextureCompInstructions = m_Cost.TextureCompareSamples;
+  pDesc->TextureBiasInstructions = m_Cost.TextureBiasSamples;
+  pDesc->TextureGradientInstructions = m_Cost.TextureGradientSamples;
+  pDesc->FloatInstructionCount = m_Cost.FloatOps;
+  pDesc->IntInstructionCount = m_Cost.IntOps;
+  pDesc->UintInstructionCount = m_Cost.UintOps;
+  pDesc->StaticFlowControlCount = m_Cost.UnconditionalBranches;
+  pDesc->DynamicFlowControlCount = m_Cost.ConditionalBranches;
   // Unset:  UINT                    MacroInstructionCount;       // Number of macro instructions used
   // Unset:  UINT                    ArrayInstructionCount;       // Number of array instructions used
-  // Unset:  UINT                    CutInstructionCount;         // Number of cut instructions used
-  // Unset:  UINT                    EmitInstructionCount;        // Number of emit instructions used
+  pDesc->CutInstructionCount = m_Cost.CutOps;
+  pDesc->EmitInstructionCount = m_Cost.EmitOps;
   // Unset:  D3D_PRIMITIVE_TOPOLOGY  GSOutputTopology;            // Geometry shader output topology
   // Unset:  UINT                    GSMaxOutputVertexCount;      // Geometry shader maximum output vertex count
   // Unset:  D3D_PRIMITIVE           InputPrimitive;              // GS/HS input primitive
@@ -1708,9 +1710,10 @@ HRESULT DxilShaderReflection::GetDesc(D3D12_SHADER_DESC *pDesc) {
   // Unset:  D3D_TESSELLATOR_PARTITIONING HSPartitioning;         // Partitioning mode of the tessellator
   // Unset:  D3D_TESSELLATOR_DOMAIN  TessellatorDomain;           // Domain of the tessellator (quad, tri, isoline)
   // instruction counts
-  // Unset:  UINT cBarrierInstructions;                           // Number of barrier instructions in a compute shader
-  // Unset:  UINT cInterlockedInstructions;                       // Number of interlocked instructions
-  // Unset:  UINT cTextureStoreInstructions;                      // Number of texture writes
+  pDesc->cBarrierInstructions = m_Cost.GetStaticOps(DxilCostCategory::Barrier);
+  pDesc->cInterlockedInstructions =
+      m_Cost.GetStaticOps(DxilCostCategory::Atomic);
+  pDesc->cTextureStoreInstructions = m_Cost.TextureStores;
   return S_OK;
 }
 
@@ -1788,6 +1791,7 @@ void DxilShaderReflection::MarkUsedSignatureElements() {
 
 _Use_decl_annotations_
 ID3D12ShaderReflectionConstantBuffer* DxilShaderReflection::GetConstantBufferByIndex(UINT Index) {
+  MarkUsage();
   if (Index >= m_CBs.size()) {
     return &g_InvalidSRConstantBuffer;
   }
@@ -1796,15 +1800,15 @@ ID3D12ShaderReflectionConstantBuffer* DxilShaderReflection::GetConstantBufferByI
 
 _Use_decl_annotations_
 ID3D12ShaderReflectionConstantBuffer* DxilShaderReflection::GetConstantBufferByName(LPCSTR Name) {
+  MarkUsage();
   if (!Name) {
     return &g_InvalidSRConstantBuffer;
   }
-  for (UINT index = 0; index < m_CBs.size(); ++index) {
-    if (0 == strcmp(m_CBs[index].GetName(), Name)) {
-      return &m_CBs[index];
-    }
+  auto it = m_CBsByName.find(Name);
+  if (it == m_CBsByName.end()) {
+    return &g_InvalidSRConstantBuffer;
   }
-  return &g_InvalidSRConstantBuffer;
+  return &m_CBs[it->second];
 }
 
 _Use_decl_annotations_
@@ -1826,6 +1830,7 @@ HRESULT DxilShaderReflection::GetInputParameterDesc(UINT ParameterIndex,
   _Out_ D3D12_SIGNATURE_PARAMETER_DESC *pDesc) {
   IFRBOOL(pDesc != nullptr, E_INVALIDARG);
   IFRBOOL(ParameterIndex < m_InputSignature.size(), E_INVALIDARG);
+  MarkUsage();
   if (m_PublicAPI != PublicAPI::D3D11_43)
     *pDesc = m_InputSignature[ParameterIndex];
   else
@@ -1841,6 +1846,7 @@ HRESULT DxilShaderReflection::GetOutputParameterDesc(UINT ParameterIndex,
   D3D12_SIGNATURE_PARAMETER_DESC *pDesc) {
   IFRBOOL(pDesc != nullptr, E_INVALIDARG);
   IFRBOOL(ParameterIndex < m_OutputSignature.size(), E_INVALIDARG);
+  MarkUsage();
   if (m_PublicAPI != PublicAPI::D3D11_43)
     *pDesc = m_OutputSignature[ParameterIndex];
   else
@@ -1856,6 +1862,7 @@ HRESULT DxilShaderReflection::GetPatchConstantParameterDesc(UINT ParameterIndex,
   D3D12_SIGNATURE_PARAMETER_DESC *pDesc) {
   IFRBOOL(pDesc != nullptr, E_INVALIDARG);
   IFRBOOL(ParameterIndex < m_PatchConstantSignature.size(), E_INVALIDARG);
+  MarkUsage();
   if (m_PublicAPI != PublicAPI::D3D11_43)
     *pDesc = m_PatchConstantSignature[ParameterIndex];
   else
@@ -1868,13 +1875,11 @@ HRESULT DxilShaderReflection::GetPatchConstantParameterDesc(UINT ParameterIndex,
 
 _Use_decl_annotations_
 ID3D12ShaderReflectionVariable* DxilShaderReflection::GetVariableByName(LPCSTR Name) {
+  MarkUsage();
   if (Name != nullptr) {
-    // Iterate through all cbuffers to find the variable.
-    for (UINT i = 0; i < m_CBs.size(); i++) {
-      ID3D12ShaderReflectionVariable *pVar = m_CBs[i].GetVariableByName(Name);
-      if (pVar != &g_InvalidSRVariable) {
-        return pVar;
-      }
+    auto it = m_VariablesByName.find(Name);
+    if (it != m_VariablesByName.end()) {
+      return it->second;
     }
   }
 
@@ -1886,19 +1891,18 @@ HRESULT DxilShaderReflection::GetResourceBindingDescByName(LPCSTR Name,
   D3D12_SHADER_INPUT_BIND_DESC *pDesc) {
   IFRBOOL(Name != nullptr, E_INVALIDARG);
 
-  for (UINT i = 0; i < m_Resources.size(); i++) {
-    if (strcmp(m_Resources[i].Name, Name) == 0) {
-      if (m_PublicAPI != PublicAPI::D3D12) {
-        memcpy(pDesc, &m_Resources[i], sizeof(D3D11_SHADER_INPUT_BIND_DESC));
-      }
-      else {
-        *pDesc = m_Resources[i];
-      }
-      return S_OK;
-    }
+  auto it = m_ResourcesByName.find(Name);
+  if (it == m_ResourcesByName.end()) {
+    return HRESULT_FROM_WIN32(ERROR_NOT_FOUND);
   }
-
-  return HRESULT_FROM_WIN32(ERROR_NOT_FOUND);
+  const D3D12_SHADER_INPUT_BIND_DESC &Resource = m_Resources[it->second];
+  if (m_PublicAPI != PublicAPI::D3D12) {
+    memcpy(pDesc, &Resource, sizeof(D3D11_SHADER_INPUT_BIND_DESC));
+  }
+  else {
+    *pDesc = Resource;
+  }
+  return S_OK;
 }
 
 UINT DxilShaderReflection::GetMovInstructionCount() { return 0; }
@@ -17,6 +17,7 @@
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/InstIterator.h"
 #include "llvm/IR/IRBuilder.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
 
 
 using namespace llvm;
@@ -66,10 +67,60 @@ using namespace hlsl;
 // close to the end of the power-of-two size of the UAV. If this value has been overwritten, the debug session
 // is deemed to have overflowed the UAV. The caller will than allocate a UAV that is twice the size and
 // try again, up to a predefined maximum.
+//
+// Compact packets (the "compact-packets" option) change the above as follows, to cut the cost of
+// capturing large shaders:
+// -  Instead of one step packet per instruction, one variable-length packet is written per executed
+//    basic block. It holds the index of the block's first instruction and then the return values of
+//    the block's instructions, in order. Instructions are numbered consecutively within a block, so
+//    their indices are not written; the debugger application derives them, and which of them return
+//    a value, from the shader itself.
+// -  Space is reserved once per wave rather than once per invocation: the first active lane adds the
+//    space needed by all selected lanes to the counter, and each selected lane finds its own offset
+//    from the count of selected lanes before it (WaveActiveCountBits/WavePrefixCountBits).
+// -  Invocations that are not of interest branch around the writes, so there is no dumping ground
+//    traffic. The instance identifier is the invocation's offset in its first reservation.
+//
+// The trace can be narrowed further with these options:
+// -  "lines" and "blocks" restrict instrumentation to source lines (from the debug info) or to basic
+//    blocks (numbered in function order) in the given ranges, e.g. "lines=10-20:35". Instructions
+//    outside the ranges keep their step numbers but emit nothing. In compact mode, a block is
+//    instrumented as a whole if any of its instructions is in range.
+// -  "sample-rate" keeps only every Nth invocation that matches the instance selection. Matching
+//    invocations count themselves on the last uint32 of the UAV, which is inside the dumping ground.
 
 // Keep this in sync with the same-named value in the debugger application's WinPixShaderUtils.h
 constexpr uint64_t DebugBufferDumpingGroundSize = 64 * 1024;
 
+typedef std::vector<std::pair<unsigned, unsigned>> InstrumentationRanges;
+
+// Parses colon-separated ranges such as "10-20:35".
+static InstrumentationRanges ParseInstrumentationRanges(StringRef Text) {
+  InstrumentationRanges Ranges;
+  SmallVector<StringRef, 4> Parts;
+  Text.split(Parts, ":", -1, false);
+  for (StringRef Part : Parts) {
+    std::pair<StringRef, StringRef> Bounds = Part.split('-');
+    unsigned First = 0;
+    unsigned Last = 0;
+    Bounds.first.trim().getAsInteger(10, First);
+    if (Bounds.second.empty() || Bounds.second.trim().getAsInteger(10, Last)) {
+      Last = First;
+    }
+    Ranges.emplace_back(First, Last);
+  }
+  return Ranges;
+}
+
+static bool IsInInstrumentationRanges(const InstrumentationRanges &Ranges, unsigned Value) {
+  for (auto & Range : Ranges) {
+    if (Range.first <= Value && Value <= Range.second) {
+      return true;
+    }
+  }
+  return false;
+}
+
 
 // These definitions echo those in the debugger application's debugshaderrecord.h file
 enum DebugShaderModifierRecordType {
@@ -82,6 +133,7 @@ enum DebugShaderModifierRecordType {
   DebugShaderModifierRecordTypeRegisterRelativeIndex0,
   DebugShaderModifierRecordTypeRegisterRelativeIndex1,
   DebugShaderModifierRecordTypeRegisterRelativeIndex2,
+  DebugShaderModifierRecordTypeDXILBlock = 250,
   DebugShaderModifierRecordTypeDXILStepVoid = 251,
   DebugShaderModifierRecordTypeDXILStepFloat = 252,
   DebugShaderModifierRecordTypeDXILStepUint32 = 253,
@@ -128,6 +180,22 @@ struct DebugShaderModifierRecordDXILStep : public DebugShaderModifierRecordDXILS
 template< >
 struct DebugShaderModifierRecordDXILStep<void> : public DebugShaderModifierRecordDXILStepBase {
 };
+
+// Followed by the return values of the block's instructions. SizeDwords is too narrow for
+// those, so the payload size is in PayloadSizeDwords instead.
+struct DebugShaderModifierRecordDXILBlock {
+  union {
+    struct {
+      uint32_t SizeDwords : 4;
+      uint32_t Flags : 4;
+      uint32_t Type : 8;
+      uint32_t PayloadSizeDwords : 16;
+    } Details;
+    uint32_t u32Header;
+  } Header;
+  uint32_t UID;
+  uint32_t FirstInstructionOffset;
+};
 #pragma pack(pop)
 
 
@@ -135,6 +203,21 @@ uint32_t DebugShaderModifierRecordPayloadSizeDwords(size_t recordTotalSizeBytes)
   return ((recordTotalSizeBytes - sizeof(DebugShaderModifierRecordHeader)) / sizeof(uint32_t));
 }
 
+// The number of dwords addStepDebugEntry writes for an instruction's return value.
+uint32_t DebugEntryValueSizeDwords(Type *Ty) {
+  switch (Ty->getTypeID()) {
+  case Type::TypeID::FloatTyID:
+  case Type::TypeID::HalfTyID:
+    return 1;
+  case Type::TypeID::IntegerTyID:
+    return Ty->getIntegerBitWidth() == 64 ? 2 : 1;
+  case Type::TypeID::DoubleTyID:
+    return 2;
+  default:
+    return 0;
+  }
+}
+
 class DxilDebugInstrumentation : public ModulePass {
 
 private:
@@ -166,6 +249,10 @@ private:
   };
 
   uint64_t m_UAVSize = 1024*1024;
+  bool m_CompactPackets = false;
+  unsigned m_SampleRate = 1;
+  InstrumentationRanges m_LineRanges;
+  InstrumentationRanges m_BlockRanges;
   Value * m_SelectionCriterion = nullptr;
   CallInst * m_HandleForUAV = nullptr;
   Value * m_InvocationId = nullptr;
@@ -215,7 +302,11 @@ private:
   void addDebugEntryValue(BuilderContext &BC, Value * TheValue);
   void addInvocationStartMarker(BuilderContext &BC);
   void reserveDebugEntrySpace(BuilderContext &BC, uint32_t SpaceInDwords);
+  void reserveWaveDebugEntrySpace(BuilderContext &BC, uint32_t SpaceInBytes);
   void addStepDebugEntry(BuilderContext &BC, Instruction *Inst);
+  void addBlockDebugEntry(BuilderContext &BC, const std::vector<Instruction*> &Steps);
+  Value * addSamplingProlog(BuilderContext &BC, Value * ParameterTestResult);
+  bool isInstrumented(unsigned BlockIndex, Instruction *Inst);
   uint32_t UAVDumpingGroundOffset();
   template<typename ReturnType>
   void addStepEntryForType(DebugShaderModifierRecordType RecordType, BuilderContext &BC, Instruction *Inst);
@@ -236,6 +327,18 @@ void DxilDebugInstrumentation::applyOptions(PassOptions O) {
     else if (0 == option.first.compare("UAVSize")) {
       m_UAVSize = std::stoull(option.second.data());
     }
+    else if (0 == option.first.compare("compact-packets")) {
+      m_CompactPackets = atoi(option.second.data()) != 0;
+    }
+    else if (0 == option.first.compare("sample-rate")) {
+      m_SampleRate = std::max(1, atoi(option.second.data()));
+    }
+    else if (0 == option.first.compare("lines")) {
+      m_LineRanges = ParseInstrumentationRanges(option.second);
+    }
+    else if (0 == option.first.compare("blocks")) {
+      m_BlockRanges = ParseInstrumentationRanges(option.second);
+    }
   }
 }
 
@@ -243,6 +346,19 @@ uint32_t DxilDebugInstrumentation::UAVDumpingGroundOffset() {
   return static_cast<uint32_t>(m_UAVSize - DebugBufferDumpingGroundSize);
 }
 
+bool DxilDebugInstrumentation::isInstrumented(unsigned BlockIndex, Instruction *Inst) {
+  if (!m_BlockRanges.empty() && !IsInInstrumentationRanges(m_BlockRanges, BlockIndex)) {
+    return false;
+  }
+  if (!m_LineRanges.empty()) {
+    const DebugLoc & Loc = Inst->getDebugLoc();
+    if (!Loc || !IsInInstrumentationRanges(m_LineRanges, Loc.getLine())) {
+      return false;
+    }
+  }
+  return true;
+}
+
 
 DxilDebugInstrumentation::SystemValueIndices DxilDebugInstrumentation::addRequiredSystemValues(BuilderContext &BC) {
   SystemValueIndices SVIndices{};
@@ -442,6 +558,26 @@ void DxilDebugInstrumentation::addUAV(BuilderContext &BC)
   { CreateHandleOpcodeArg, UAVVArg, MetaDataArg, IndexArg, FalseArg }, "PIX_DebugUAV_Handle");
 }
 
+Value * DxilDebugInstrumentation::addSamplingProlog(BuilderContext &BC, Value * ParameterTestResult) {
+  // Matching invocations take a ticket from a counter at the top of the dumping ground,
+  // and only every m_SampleRate-th ticket is kept:
+  Function* AtomicOpFunc = BC.HlslOP->GetOpFunc(OP::OpCode::AtomicBinOp, Type::getInt32Ty(BC.Ctx));
+  UndefValue* UndefArg = UndefValue::get(Type::getInt32Ty(BC.Ctx));
+  auto Ticket = BC.Builder.CreateCast(Instruction::CastOps::ZExt, ParameterTestResult, Type::getInt32Ty(BC.Ctx), "SampleTicket");
+  auto SampleCounter = BC.Builder.CreateCall(AtomicOpFunc, {
+    BC.HlslOP->GetU32Const((unsigned)OP::OpCode::AtomicBinOp),             // i32, ; opcode
+    m_HandleForUAV,                                                           // %dx.types.Handle, ; resource handle
+    BC.HlslOP->GetU32Const((unsigned)DXIL::AtomicBinOpCode::Add),             // i32, ; binary operation code
+    BC.HlslOP->GetU32Const(static_cast<uint32_t>(m_UAVSize - sizeof(uint32_t))), // i32, ; coordinate c0: index in bytes
+    UndefArg,                                                                 // i32, ; coordinate c1 (unused)
+    UndefArg,                                                                 // i32, ; coordinate c2 (unused)
+    Ticket,                                                                   // i32); increment value
+  }, "SampleCounter");
+  auto SampleIndex = BC.Builder.CreateURem(SampleCounter, BC.HlslOP->GetU32Const(m_SampleRate), "SampleIndex");
+  auto IsSampled = BC.Builder.CreateICmpEQ(SampleIndex, BC.HlslOP->GetU32Const(0), "IsSampled");
+  return BC.Builder.CreateAnd(ParameterTestResult, IsSampled, "SelectedAndSampled");
+}
+
 void DxilDebugInstrumentation::addInvocationSelectionProlog(BuilderContext &BC, SystemValueIndices SVIndices) {
   auto ShaderModel = BC.DM.GetShaderModel();
 
@@ -460,17 +596,28 @@ void DxilDebugInstrumentation::addInvocationSelectionProlog(BuilderContext &BC,
     assert(false); // guaranteed by runOnModule
   }
 
+  if (m_SampleRate > 1) {
+    ParameterTestResult = addSamplingProlog(BC, ParameterTestResult);
+  }
+
   // This is a convenient place to calculate the values that modify the UAV offset for invocations of interest and for
-  // UAV size.
-  m_OffsetMultiplicand = BC.Builder.CreateCast(Instruction::CastOps::ZExt, ParameterTestResult, Type::getInt32Ty(BC.Ctx), "OffsetMultiplicand");
-  auto InverseOffsetMultiplicand = BC.Builder.CreateSub(BC.HlslOP->GetU32Const(1), m_OffsetMultiplicand, "ComplementOfMultiplicand");
-  m_OffsetAddend = BC.Builder.CreateMul(BC.HlslOP->GetU32Const(UAVDumpingGroundOffset()), InverseOffsetMultiplicand, "OffsetAddend");
+  // UAV size. Compact packets branch around uninteresting invocations instead.
+  if (!m_CompactPackets) {
+    m_OffsetMultiplicand = BC.Builder.CreateCast(Instruction::CastOps::ZExt, ParameterTestResult, Type::getInt32Ty(BC.Ctx), "OffsetMultiplicand");
+    auto InverseOffsetMultiplicand = BC.Builder.CreateSub(BC.HlslOP->GetU32Const(1), m_OffsetMultiplicand, "ComplementOfMultiplicand");
+    m_OffsetAddend = BC.Builder.CreateMul(BC.HlslOP->GetU32Const(UAVDumpingGroundOffset()), InverseOffsetMultiplicand, "OffsetAddend");
+  }
   m_OffsetMask = BC.HlslOP->GetU32Const(UAVDumpingGroundOffset() - 1);
 
   m_SelectionCriterion = ParameterTestResult;
 }
 
 void DxilDebugInstrumentation::reserveDebugEntrySpace(BuilderContext &BC, uint32_t SpaceInBytes) {
+  if (m_CompactPackets) {
+    reserveWaveDebugEntrySpace(BC, SpaceInBytes);
+    return;
+  }
+
   assert(m_CurrentIndex == nullptr);
   assert(m_RemainingReservedSpaceInBytes == 0);
 
@@ -517,6 +664,66 @@ void DxilDebugInstrumentation::reserveDebugEntrySpace(BuilderContext &BC, uint32
   m_CurrentIndex = AddedForInterest;
 }
 
+// Leaves the builder in a block that only invocations of interest execute.
+void DxilDebugInstrumentation::reserveWaveDebugEntrySpace(BuilderContext &BC, uint32_t SpaceInBytes) {
+  assert(m_CurrentIndex == nullptr);
+  assert(m_RemainingReservedSpaceInBytes == 0);
+
+  m_RemainingReservedSpaceInBytes = SpaceInBytes;
+
+  Constant* Size = BC.HlslOP->GetU32Const(SpaceInBytes);
+
+  // Count the selected lanes of the wave, and the selected lanes before this one:
+  Function* WaveAllOpFunc = BC.HlslOP->GetOpFunc(OP::OpCode::WaveAllBitCount, Type::getVoidTy(BC.Ctx));
+  auto SelectedLanes = BC.Builder.CreateCall(WaveAllOpFunc, {
+    BC.HlslOP->GetU32Const((unsigned)OP::OpCode::WaveAllBitCount), m_SelectionCriterion }, "SelectedLanes");
+  Function* WavePrefixOpFunc = BC.HlslOP->GetOpFunc(OP::OpCode::WavePrefixBitCount, Type::getVoidTy(BC.Ctx));
+  auto SelectedLanesBefore = BC.Builder.CreateCall(WavePrefixOpFunc, {
+    BC.HlslOP->GetU32Const((unsigned)OP::OpCode::WavePrefixBitCount), m_SelectionCriterion }, "SelectedLanesBefore");
+  Function* IsFirstLaneFunc = BC.HlslOP->GetOpFunc(OP::OpCode::WaveIsFirstLane, Type::getVoidTy(BC.Ctx));
+  auto IsFirstLane = BC.Builder.CreateCall(IsFirstLaneFunc, {
+    BC.HlslOP->GetU32Const((unsigned)OP::OpCode::WaveIsFirstLane) }, "IsFirstLane");
+
+  // The first lane reserves space for the whole wave:
+  Instruction* InsertPt = &*BC.Builder.GetInsertPoint();
+  BasicBlock* CountBlock = InsertPt->getParent();
+  TerminatorInst* ReserveTerm = SplitBlockAndInsertIfThen(IsFirstLane, InsertPt, false);
+  BC.Builder.SetInsertPoint(ReserveTerm);
+  Function* AtomicOpFunc = BC.HlslOP->GetOpFunc(OP::OpCode::AtomicBinOp, Type::getInt32Ty(BC.Ctx));
+  UndefValue* UndefArg = UndefValue::get(Type::getInt32Ty(BC.Ctx));
+  auto SpaceForWave = BC.Builder.CreateMul(SelectedLanes, Size, "SpaceForWave");
+  auto PreviousValue = BC.Builder.CreateCall(AtomicOpFunc, {
+    BC.HlslOP->GetU32Const((unsigned)OP::OpCode::AtomicBinOp), // i32, ; opcode
+    m_HandleForUAV,                                               // %dx.types.Handle, ; resource handle
+    BC.HlslOP->GetU32Const((unsigned)DXIL::AtomicBinOpCode::Add), // i32, ; binary operation code
+    BC.HlslOP->GetU32Const(0),                                     // i32, ; coordinate c0: index in bytes
+    UndefArg,                                                     // i32, ; coordinate c1 (unused)
+    UndefArg,                                                     // i32, ; coordinate c2 (unused)
+    SpaceForWave,                                                 // i32); increment value
+  }, "UAVIncResult");
+
+  // ...and shares the reservation with the other lanes:
+  BC.Builder.SetInsertPoint(InsertPt);
+  PHINode* Reservation = BC.Builder.CreatePHI(Type::getInt32Ty(BC.Ctx), 2, "WaveReservation");
+  Reservation->addIncoming(PreviousValue, ReserveTerm->getParent());
+  Reservation->addIncoming(UndefArg, CountBlock);
+  Function* ReadLaneFirstFunc = BC.HlslOP->GetOpFunc(OP::OpCode::WaveReadLaneFirst, Type::getInt32Ty(BC.Ctx));
+  auto WaveBase = BC.Builder.CreateCall(ReadLaneFirstFunc, {
+    BC.HlslOP->GetU32Const((unsigned)OP::OpCode::WaveReadLaneFirst), Reservation }, "WaveBase");
+  auto LaneOffset = BC.Builder.CreateAdd(WaveBase, BC.Builder.CreateMul(SelectedLanesBefore, Size), "LaneOffset");
+
+  if (m_InvocationId == nullptr)
+  {
+      m_InvocationId = LaneOffset;
+  }
+
+  m_CurrentIndex = BC.Builder.CreateAnd(LaneOffset, m_OffsetMask, "MaskedForUAVLimit");
+
+  // Only invocations of interest write:
+  TerminatorInst* WriteTerm = SplitBlockAndInsertIfThen(m_SelectionCriterion, InsertPt, false);
+  BC.Builder.SetInsertPoint(WriteTerm);
+}
+
 void DxilDebugInstrumentation::addDebugEntryValue(BuilderContext &BC, Value * TheValue) {
   assert(m_RemainingReservedSpaceInBytes > 0);
 
@@ -576,8 +783,8 @@ void DxilDebugInstrumentation::addDebugEntryValue(BuilderContext &BC, Value * Th
       WriteMask_X
     });
 
+    assert(m_RemainingReservedSpaceInBytes >= 4);  // check for underflow
     m_RemainingReservedSpaceInBytes -= 4;
-    assert(m_RemainingReservedSpaceInBytes < 1024);  // check for underflow
 
     if (m_RemainingReservedSpaceInBytes != 0) {
       m_CurrentIndex = BC.Builder.CreateAdd(m_CurrentIndex, BC.HlslOP->GetU32Const(4));
@@ -616,6 +823,29 @@ void DxilDebugInstrumentation::addStepEntryForType(DebugShaderModifierRecordType
   }
 }
 
+void DxilDebugInstrumentation::addBlockDebugEntry(BuilderContext &BC, const std::vector<Instruction*> &Steps) {
+  uint32_t ValueSizeDwords = 0;
+  for (auto & Inst : Steps) {
+    ValueSizeDwords += DebugEntryValueSizeDwords(Inst->getType());
+  }
+
+  DebugShaderModifierRecordDXILBlock block = {};
+  reserveDebugEntrySpace(BC, sizeof(block) + ValueSizeDwords * sizeof(uint32_t));
+
+  block.Header.Details.Type = DebugShaderModifierRecordTypeDXILBlock;
+  block.Header.Details.PayloadSizeDwords = DebugShaderModifierRecordPayloadSizeDwords(sizeof(block)) + ValueSizeDwords;
+  addDebugEntryValue(BC, BC.HlslOP->GetU32Const(block.Header.u32Header));
+  addDebugEntryValue(BC, m_InvocationId);
+  addDebugEntryValue(BC, BC.HlslOP->GetU32Const(m_InstructionIndex));
+  m_InstructionIndex += Steps.size();
+
+  for (auto & Inst : Steps) {
+    if (DebugEntryValueSizeDwords(Inst->getType()) != 0) {
+      addDebugEntryValue(BC, Inst);
+    }
+  }
+}
+
 void DxilDebugInstrumentation::addStepDebugEntry(BuilderContext &BC, Instruction *Inst) {
   if (Inst->getOpcode() == Instruction::OtherOps::PHI) {
     return;
@@ -673,10 +903,16 @@ bool DxilDebugInstrumentation::runOnModule(Module &M) {
   }
 
 
-  // First record pointers to all instructions in the function:
+  // First record pointers to all instructions in the function, and whether the filters select them:
   std::vector<Instruction*> AllInstructions;
-  for (inst_iterator I = inst_begin(DM.GetEntryFunction()), E = inst_end(DM.GetEntryFunction()); I != E; ++I) {
-    AllInstructions.push_back(&*I);
+  std::vector<bool> InstructionIsInstrumented;
+  unsigned BlockIndex = 0;
+  for (BasicBlock & BB : *DM.GetEntryFunction()) {
+    for (Instruction & Inst : BB) {
+      AllInstructions.push_back(&Inst);
+      InstructionIsInstrumented.push_back(isInstrumented(BlockIndex, &Inst));
+    }
+    ++BlockIndex;
   }
 
   // Branchless instrumentation requires taking care of a few things:
@@ -694,13 +930,59 @@ bool DxilDebugInstrumentation::runOnModule(Module &M) {
   BuilderContext BC{ M, DM, Ctx, HlslOP, Builder };
 
   addUAV(BC);
+  if (m_CompactPackets) {
+    DM.m_ShaderFlags.SetWaveOps(true);
+  }
   auto SystemValues = addRequiredSystemValues(BC);
   addInvocationSelectionProlog(BC, SystemValues);
   addInvocationStartMarker(BC);
 
   // Instrument original instructions:
-  {
-    for (auto & Inst : AllInstructions) {
+  if (m_CompactPackets) {
+    // Block packets are written just before the terminator, which all the
+    // block's values dominate. Splitting blocks during instrumentation keeps
+    // each original terminator, so record those up front.
+    struct BlockSteps {
+      Instruction * Terminator = nullptr;
+      std::vector<Instruction*> Steps;
+      bool IsInstrumented = false;
+    };
+    std::vector<BlockSteps> Blocks;
+    for (size_t i = 0; i < AllInstructions.size(); ++i) {
+      Instruction * Inst = AllInstructions[i];
+      if (Inst->getOpcode() == Instruction::OtherOps::PHI) {
+        continue;
+      }
+      if (Blocks.empty() || Blocks.back().Terminator != nullptr) {
+        Blocks.emplace_back();
+      }
+      Blocks.back().Steps.push_back(Inst);
+      Blocks.back().IsInstrumented |= InstructionIsInstrumented[i];
+      if (isa<TerminatorInst>(Inst)) {
+        Blocks.back().Terminator = Inst;
+      }
+    }
+
+    for (auto & Block : Blocks) {
+      if (!Block.IsInstrumented) {
+        m_InstructionIndex += Block.Steps.size();
+        continue;
+      }
+      IRBuilder<> Builder(Block.Terminator);
+      BuilderContext BC2{ BC.M, BC.DM, BC.Ctx, BC.HlslOP, Builder };
+      addBlockDebugEntry(BC2, Block.Steps);
+    }
+  }
+  else {
+    for (size_t i = 0; i < AllInstructions.size(); ++i) {
+      Instruction * Inst = AllInstructions[i];
+      if (!InstructionIsInstrumented[i]) {
+        // Keep the step numbering of the unfiltered trace.
+        if (Inst->getOpcode() != Instruction::OtherOps::PHI) {
+          ++m_InstructionIndex;
+        }
+        continue;
+      }
       // Instrumentation goes after the instruction if it has a return value.
       // Otherwise, the instruction might be a terminator so we HAVE to put the instrumentation before
       if (Inst->getType()->getTypeID() != Type::TypeID::VoidTyID) {
@@ -0,0 +1,407 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilDemotePrecision.cpp                                                   //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Computes float math that only feeds half values in half.                  //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/HLSL/DxilGenerationPass.h"
+#include "dxc/HLSL/DxilInstructions.h"
+#include "dxc/HLSL/DxilModule.h"
+#include "dxc/HLSL/DxilOperations.h"
+#include "dxc/HLSL/DxilResource.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DiagnosticInfo.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+
+#include <algorithm>
+#include <limits>
+
+using namespace llvm;
+using namespace hlsl;
+
+///////////////////////////////////////////////////////////////////////////////
+// Demote float math to half.
+
+namespace {
+// Float additions, subtractions, multiplications, min, max, mad and
+// saturate whose results only reach half values - min16float outputs,
+// stores and other min16float math - are computed in half. The results are
+// rounded to half anyway, so only the rounding of intermediate results
+// changes, and hardware with 16-bit packed math does two such operations at
+// once. With -enable-16bit-types half is a true 16-bit type; otherwise it is
+// min16float, and the driver picks the precision.
+//
+// An operation is only demoted when its result and operands provably fit in
+// half. Bounds come from constants, half values, saturate, sin, cos, frac and
+// reads of UNORM and SNORM resources; anything else is unbounded. Precise
+// operations are never demoted.
+//
+// Every demoted expression is reported as an optimization remark.
+class DxilDemotePrecision : public FunctionPass {
+public:
+  static char ID; // Pass identification, replacement for typeid
+  explicit DxilDemotePrecision() : FunctionPass(ID) {}
+
+  const char *getPassName() const override {
+    return "DXIL demote float math to half";
+  }
+
+  bool runOnFunction(Function &F) override;
+};
+
+char DxilDemotePrecision::ID = 0;
+
+const char kPassArg[] = "hlsl-dxil-demote-precision";
+const double kHalfMax = 65504.0;
+
+struct ValueRange {
+  double Lo, Hi;
+
+  static ValueRange Unbounded() {
+    const double Inf = std::numeric_limits<double>::infinity();
+    return {-Inf, Inf};
+  }
+  // False for NaN bounds as well.
+  bool IsBounded() const {
+    return -std::numeric_limits<double>::max() <= Lo &&
+           Hi <= std::numeric_limits<double>::max();
+  }
+  bool FitsInHalf() const { return -kHalfMax <= Lo && Hi <= kHalfMax; }
+};
+
+ValueRange Add(ValueRange A, ValueRange B) {
+  return {A.Lo + B.Lo, A.Hi + B.Hi};
+}
+
+ValueRange Sub(ValueRange A, ValueRange B) {
+  return {A.Lo - B.Hi, A.Hi - B.Lo};
+}
+
+ValueRange Mul(ValueRange A, ValueRange B) {
+  double P[4] = {A.Lo * B.Lo, A.Lo * B.Hi, A.Hi * B.Lo, A.Hi * B.Hi};
+  return {*std::min_element(P, P + 4), *std::max_element(P, P + 4)};
+}
+
+// Returns true if I can be computed in half, with Op set to its DXIL
+// operation, or to NumOpCodes for plain instructions.
+bool IsDemotable(Instruction *I, DxilModule &DM, DXIL::OpCode &Op) {
+  if (!I->getType()->isFloatTy() || DM.IsPrecise(I))
+    return false;
+  Op = DXIL::OpCode::NumOpCodes;
+  switch (I->getOpcode()) {
+  case Instruction::FAdd:
+  case Instruction::FSub:
+  case Instruction::FMul:
+    return true;
+  default:
+    break;
+  }
+  if (!OP::IsDxilOpFuncCallInst(I))
+    return false;
+  Op = OP::GetDxilOpFuncCallInst(I);
+  switch (Op) {
+  case DXIL::OpCode::Saturate:
+  case DXIL::OpCode::FMax:
+  case DXIL::OpCode::FMin:
+  case DXIL::OpCode::FMad:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// Returns the component type of the resource read by a sample or load,
+// or Invalid if it isn't known.
+CompType GetReadCompType(CallInst *CI, DxilModule &DM) {
+  // All reads take the resource handle right after the opcode.
+  DxilInst_CreateHandle Handle(dyn_cast<Instruction>(CI->getArgOperand(1)));
+  if (!Handle.Instr || !Handle ||
+      !isa<ConstantInt>(Handle.get_resourceClass()) ||
+      !isa<ConstantInt>(Handle.get_rangeId()))
+    return CompType();
+  unsigned RangeId =
+      cast<ConstantInt>(Handle.get_rangeId())->getLimitedValue();
+  switch (static_cast<DXIL::ResourceClass>(Handle.get_resourceClass_val())) {
+  case DXIL::ResourceClass::SRV:
+    return DM.GetSRV(RangeId).GetCompType();
+  case DXIL::ResourceClass::UAV:
+    return DM.GetUAV(RangeId).GetCompType();
+  default:
+    return CompType();
+  }
+}
+
+ValueRange GetLeafRange(Value *V, DxilModule &DM) {
+  if (ConstantFP *C = dyn_cast<ConstantFP>(V)) {
+    double D = C->getValueAPF().convertToFloat();
+    return {D, D};
+  }
+  if (FPExtInst *Ext = dyn_cast<FPExtInst>(V)) {
+    if (Ext->getSrcTy()->isHalfTy())
+      return {-kHalfMax, kHalfMax};
+  }
+  if (ExtractValueInst *EV = dyn_cast<ExtractValueInst>(V)) {
+    // The status of a read comes after its four values.
+    Instruction *Read = dyn_cast<Instruction>(EV->getAggregateOperand());
+    if (Read && OP::IsDxilOpFuncCallInst(Read) && EV->getIndices()[0] < 4) {
+      switch (OP::GetDxilOpFuncCallInst(Read)) {
+      case DXIL::OpCode::Sample:
+      case DXIL::OpCode::SampleBias:
+      case DXIL::OpCode::SampleLevel:
+      case DXIL::OpCode::SampleGrad:
+      case DXIL::OpCode::TextureLoad: {
+        CompType Comp = GetReadCompType(cast<CallInst>(Read), DM);
+        if (Comp.IsUNorm())
+          return {0.0, 1.0};
+        if (Comp.IsSNorm())
+          return {-1.0, 1.0};
+        break;
+      }
+      default:
+        break;
+      }
+    }
+  }
+  if (Instruction *I = dyn_cast<Instruction>(V)) {
+    if (OP::IsDxilOpFuncCallInst(I)) {
+      switch (OP::GetDxilOpFuncCallInst(I)) {
+      case DXIL::OpCode::Saturate:
+      case DXIL::OpCode::Frc:
+        return {0.0, 1.0};
+      case DXIL::OpCode::Sin:
+      case DXIL::OpCode::Cos:
+        return {-1.0, 1.0};
+      default:
+        break;
+      }
+    }
+  }
+  return ValueRange::Unbounded();
+}
+
+bool IsHalfTrunc(User *U) {
+  FPTruncInst *Trunc = dyn_cast<FPTruncInst>(U);
+  return Trunc && Trunc->getDestTy()->isHalfTy();
+}
+
+// Returns the index of the first operand computed in half.
+unsigned GetFirstOperand(DXIL::OpCode Op) {
+  return Op == DXIL::OpCode::NumOpCodes ? 0
+                                         : DXIL::OperandIndex::kUnarySrc0OpIdx;
+}
+}
+
+bool DxilDemotePrecision::runOnFunction(Function &F) {
+  Module *M = F.getParent();
+  if (F.isDeclaration() || !M->HasDxilModule())
+    return false;
+  DxilModule &DM = M->GetDxilModule();
+
+  // Visit operands before their users to compute ranges in a single sweep;
+  // phis are leaves, so cycles don't matter.
+  SmallVector<Instruction *, 32> Candidates;
+  DenseMap<Instruction *, DXIL::OpCode> CandidateOps;
+  DenseMap<Value *, ValueRange> Ranges;
+  auto GetRange = [&](Value *V) {
+    auto It = Ranges.find(V);
+    return It != Ranges.end() ? It->second : GetLeafRange(V, DM);
+  };
+  ReversePostOrderTraversal<Function *> RPOT(&F);
+  for (BasicBlock *BB : RPOT) {
+    for (Instruction &I : *BB) {
+      DXIL::OpCode Op;
+      if (!IsDemotable(&I, DM, Op))
+        continue;
+      unsigned First = GetFirstOperand(Op);
+      SmallVector<ValueRange, 3> Operands;
+      for (unsigned i = First; i < I.getNumOperands(); ++i) {
+        if (I.getOperand(i)->getType()->isFloatTy())
+          Operands.push_back(GetRange(I.getOperand(i)));
+      }
+      bool Bounded = std::all_of(Operands.begin(), Operands.end(),
+                                 [](ValueRange R) { return R.IsBounded(); });
+      ValueRange R = ValueRange::Unbounded();
+      switch (Op) {
+      case DXIL::OpCode::Saturate:
+        R = {0.0, 1.0};
+        break;
+      case DXIL::OpCode::FMax:
+        if (Bounded)
+          R = {std::max(Operands[0].Lo, Operands[1].Lo),
+               std::max(Operands[0].Hi, Operands[1].Hi)};
+        break;
+      case DXIL::OpCode::FMin:
+        if (Bounded)
+          R = {std::min(Operands[0].Lo, Operands[1].Lo),
+               std::min(Operands[0].Hi, Operands[1].Hi)};
+        break;
+      case DXIL::OpCode::FMad:
+        if (Bounded)
+          R = Add(Mul(Operands[0], Operands[1]), Operands[2]);
+        break;
+      default:
+        if (!Bounded)
+          break;
+        if (I.getOpcode() == Instruction::FAdd)
+          R = Add(Operands[0], Operands[1]);
+        else if (I.getOpcode() == Instruction::FSub)
+          R = Sub(Operands[0], Operands[1]);
+        else
+          R = Mul(Operands[0], Operands[1]);
+        break;
+      }
+      Ranges[&I] = R;
+
+      // Saturate is exact on the infinity an overflowing operand becomes.
+      bool Fits = R.FitsInHalf() &&
+                  (Op == DXIL::OpCode::Saturate ||
+                   std::all_of(Operands.begin(), Operands.end(),
+                               [](ValueRange R) { return R.FitsInHalf(); }));
+      if (Fits && !I.use_empty()) {
+        Candidates.push_back(&I);
+        CandidateOps[&I] = Op;
+      }
+    }
+  }
+  if (Candidates.empty())
+    return false;
+
+  // Keep the candidates whose users are all demoted or truncate to half.
+  SmallPtrSet<Instruction *, 32> Demoted(Candidates.begin(), Candidates.end());
+  SmallVector<Instruction *, 32> Worklist(Candidates.begin(), Candidates.end());
+  while (!Worklist.empty()) {
+    Instruction *I = Worklist.pop_back_val();
+    if (!Demoted.count(I))
+      continue;
+    bool AllDemoted = std::all_of(I->user_begin(), I->user_end(), [&](User *U) {
+      return IsHalfTrunc(U) || Demoted.count(cast<Instruction>(U));
+    });
+    if (AllDemoted)
+      continue;
+    Demoted.erase(I);
+    for (Value *Operand : I->operands()) {
+      if (Instruction *OpI = dyn_cast<Instruction>(Operand))
+        Worklist.push_back(OpI);
+    }
+  }
+  if (Demoted.empty())
+    return false;
+
+  // Report each expression by the operation whose result is truncated.
+  for (Instruction *I : Candidates) {
+    if (!Demoted.count(I) || !std::any_of(I->user_begin(), I->user_end(),
+                                          IsHalfTrunc))
+      continue;
+    unsigned Count = 0;
+    SmallPtrSet<Instruction *, 8> Visited;
+    SmallVector<Instruction *, 8> Expr(1, I);
+    while (!Expr.empty()) {
+      Instruction *E = Expr.pop_back_val();
+      if (!Visited.insert(E).second)
+        continue;
+      ++Count;
+      for (Value *Operand : E->operands()) {
+        Instruction *OpI = dyn_cast<Instruction>(Operand);
+        if (OpI && Demoted.count(OpI))
+          Expr.push_back(OpI);
+      }
+    }
+    DXIL::OpCode Op = CandidateOps[I];
+    const char *Name = Op == DXIL::OpCode::NumOpCodes ? I->getOpcodeName()
+                                                      : OP::GetOpCodeName(Op);
+    emitOptimizationRemark(F.getContext(), kPassArg, F, I->getDebugLoc(),
+                           Twine("computed ") + Name + " expression of " +
+                               Twine(Count) + " float operation" +
+                               (Count == 1 ? "" : "s") + " in half");
+  }
+
+  // Leaves become half where they're defined, so every user sees them.
+  Type *HalfTy = Type::getHalfTy(F.getContext());
+  DenseMap<Value *, Value *> HalfValues;
+  auto GetHalf = [&](Value *V) -> Value * {
+    Value *&Half = HalfValues[V];
+    if (Half)
+      return Half;
+    if (Constant *C = dyn_cast<Constant>(V)) {
+      Half = ConstantExpr::getFPTrunc(C, HalfTy);
+    } else if (isa<FPExtInst>(V) &&
+               cast<FPExtInst>(V)->getSrcTy()->isHalfTy()) {
+      Half = cast<FPExtInst>(V)->getOperand(0);
+    } else if (Instruction *I = dyn_cast<Instruction>(V)) {
+      BasicBlock::iterator InsertPt =
+          isa<PHINode>(I) ? I->getParent()->getFirstInsertionPt()
+                          : std::next(BasicBlock::iterator(I));
+      IRBuilder<> Builder(I->getParent(), InsertPt);
+      Builder.SetCurrentDebugLocation(I->getDebugLoc());
+      Half = Builder.CreateFPTrunc(V, HalfTy);
+    } else {
+      IRBuilder<> Builder(&F.getEntryBlock(),
+                          F.getEntryBlock().getFirstInsertionPt());
+      Half = Builder.CreateFPTrunc(V, HalfTy);
+    }
+    return Half;
+  };
+
+  OP *HlslOP = DM.GetOP();
+  for (Instruction *I : Candidates) {
+    if (!Demoted.count(I))
+      continue;
+    DXIL::OpCode Op = CandidateOps[I];
+    IRBuilder<> Builder(I);
+    if (Op == DXIL::OpCode::NumOpCodes) {
+      Value *Half =
+          Builder.CreateBinOp(cast<BinaryOperator>(I)->getOpcode(),
+                              GetHalf(I->getOperand(0)),
+                              GetHalf(I->getOperand(1)));
+      if (Instruction *HalfI = dyn_cast<Instruction>(Half))
+        HalfI->copyFastMathFlags(I);
+      HalfValues[I] = Half;
+      continue;
+    }
+    CallInst *CI = cast<CallInst>(I);
+    SmallVector<Value *, 4> Args;
+    Args.push_back(CI->getArgOperand(DXIL::OperandIndex::kOpcodeIdx));
+    for (unsigned i = GetFirstOperand(Op); i < CI->getNumArgOperands(); ++i)
+      Args.push_back(GetHalf(CI->getArgOperand(i)));
+    HalfValues[I] = Builder.CreateCall(HlslOP->GetOpFunc(Op, HalfTy), Args);
+  }
+
+  // Truncations of demoted values now have them in half already; the float
+  // operations are left without users, users first.
+  for (Instruction *I : Candidates) {
+    if (!Demoted.count(I))
+      continue;
+    for (auto U = I->user_begin(); U != I->user_end();) {
+      User *Trunc = *(U++);
+      if (IsHalfTrunc(Trunc)) {
+        Trunc->replaceAllUsesWith(HalfValues[I]);
+        cast<Instruction>(Trunc)->eraseFromParent();
+      }
+    }
+  }
+  for (auto It = Candidates.rbegin(); It != Candidates.rend(); ++It) {
+    if (Demoted.count(*It))
+      (*It)->eraseFromParent();
+  }
+  return true;
+}
+
+FunctionPass *llvm::createDxilDemotePrecisionPass() {
+  return new DxilDemotePrecision();
+}
+
+INITIALIZE_PASS(DxilDemotePrecision, "hlsl-dxil-demote-precision",
+                "DXIL demote float math to half", false, false)
@@ -19,7 +19,11 @@
 #include "llvm/IR/Module.h"
 #include "llvm/Pass.h"
 #include "llvm/IR/IRBuilder.h"
+#include "llvm/ADT/BitVector.h"
 #include "llvm/ADT/MapVector.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/IR/ConstantRange.h"
+#include <algorithm>
 
 using namespace llvm;
 using namespace hlsl;
@@ -36,6 +40,10 @@ public:
     return "DXIL eliminate ouptut dynamic indexing";
   }
 
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.addRequired<ScalarEvolution>();
+  }
+
   bool runOnModule(Module &M) override {
     DxilModule &DM = M.GetOrCreateDxilModule();
     bool bUpdated = false;
@@ -60,10 +68,25 @@ public:
   }
 
 private:
+  // Rows a store may write, [Lo, Hi].
+  struct RowRange {
+    unsigned Lo;
+    unsigned Hi;
+  };
+  // Temporary for one column of an output, holding rows [Lo, Hi].
+  struct TmpColumn {
+    Value *Alloca;
+    unsigned Lo;
+    unsigned Hi;
+    BitVector Written;
+  };
+
   bool EliminateDynamicOutput(hlsl::OP *hlslOP, DXIL::OpCode opcode, DxilSignature &outputSig, Function *Entry);
-  void ReplaceDynamicOutput(ArrayRef<Value *> tmpSigElts, Value * sigID, Value *zero, Function *F);
-  void StoreTmpSigToOutput(ArrayRef<Value *> tmpSigElts, unsigned row,
-                           Value *opcode, Value *sigID, Function *StoreOutput,
+  RowRange GetRowRange(Value *row, unsigned rows, ScalarEvolution *SE);
+  void ReplaceDynamicOutput(ArrayRef<TmpColumn> tmpSigElts, Value *sigID,
+                            Value *zero, Function *F);
+  void StoreTmpSigToOutput(ArrayRef<TmpColumn> tmpSigElts, Value *opcode,
+                           Value *sigID, Function *StoreOutput,
                            Function *Entry);
 };
 
@@ -103,6 +126,11 @@ bool DxilEliminateOutputDynamicIndexing::EliminateDynamicOutput(
   ArrayRef<llvm::Function *> storeOutputs =
       hlslOP->GetOpFuncList(opcode);
 
+  bool bUpdated = false;
+  // Value ranges are only computed for Entry, where the stores are after
+  // inlining; a dynamic store anywhere else may write any row.
+  ScalarEvolution *SE = nullptr;
+  DenseMap<CallInst *, RowRange> dynamicRows;
   MapVector<Value *, Type *> dynamicSigSet;
   for (Function *F : storeOutputs) {
     // Skip overload not used.
@@ -111,16 +139,31 @@ bool DxilEliminateOutputDynamicIndexing::EliminateDynamicOutput(
     for (User *U : F->users()) {
       CallInst *CI = cast<CallInst>(U);
       DxilOutputStore store(CI);
-      // Save dynamic indeed sigID.
-      if (!isa<ConstantInt>(store.get_rowIndex())) {
-        Value *sigID = store.get_outputSigId();
-        dynamicSigSet[sigID] = store.get_value()->getType();
+      Value *row = store.get_rowIndex();
+      if (isa<ConstantInt>(row))
+        continue;
+      Value *sigID = store.get_outputSigId();
+      unsigned ID = cast<ConstantInt>(sigID)->getLimitedValue();
+      unsigned rows = outputSig.GetElement(ID).GetRows();
+      bool bInEntry = CI->getParent()->getParent() == Entry;
+      if (bInEntry && !SE)
+        SE = &getAnalysis<ScalarEvolution>(*Entry);
+      RowRange range = GetRowRange(row, rows, bInEntry ? SE : nullptr);
+      // A store that can only reach one row isn't dynamic after all.
+      if (range.Lo == range.Hi) {
+        CI->setArgOperand(DXIL::OperandIndex::kStoreOutputRowOpIdx,
+                          ConstantInt::get(row->getType(), range.Lo));
+        bUpdated = true;
+        continue;
       }
+      // Save dynamic indeed sigID.
+      dynamicRows[CI] = range;
+      dynamicSigSet[sigID] = store.get_value()->getType();
     }
   }
 
   if (dynamicSigSet.empty())
-    return false;
+    return bUpdated;
 
   IRBuilder<> Builder(Entry->getEntryBlock().getFirstInsertionPt());
 
@@ -134,35 +177,84 @@ bool DxilEliminateOutputDynamicIndexing::EliminateDynamicOutput(
     DxilSignatureElement &sigElt = outputSig.GetElement(ID);
     unsigned row = sigElt.GetRows();
     unsigned col = sigElt.GetCols();
-    Type *AT = ArrayType::get(EltTy, row);
+    Function *F = hlslOP->GetOpFunc(opcode, EltTy);
 
-    std::vector<Value *> tmpSigElts(col);
-    for (unsigned c = 0; c < col; c++) {
-      Value *newCol = Builder.CreateAlloca(AT);
-      tmpSigElts[c] = newCol;
+    // Collect the rows each column may be written at. Only those are kept
+    // in the temporary columns and copied to the output.
+    std::vector<TmpColumn> tmpSigElts(col);
+    for (TmpColumn &tmp : tmpSigElts) {
+      tmp.Alloca = nullptr;
+      tmp.Written.resize(row);
+    }
+    for (User *U : F->users()) {
+      CallInst *CI = cast<CallInst>(U);
+      DxilOutputStore store(CI);
+      if (sigID != store.get_outputSigId())
+        continue;
+      auto it = dynamicRows.find(CI);
+      RowRange range = it != dynamicRows.end()
+                           ? it->second
+                           : GetRowRange(store.get_rowIndex(), row, nullptr);
+      tmpSigElts[store.get_colIndex()].Written.set(range.Lo, range.Hi + 1);
+    }
+
+    for (TmpColumn &tmp : tmpSigElts) {
+      if (tmp.Written.none())
+        continue;
+      tmp.Lo = tmp.Written.find_first();
+      for (int r = tmp.Lo; r != -1; r = tmp.Written.find_next(r))
+        tmp.Hi = r;
+      Type *AT = ArrayType::get(EltTy, tmp.Hi - tmp.Lo + 1);
+      tmp.Alloca = Builder.CreateAlloca(AT);
     }
 
-    Function *F = hlslOP->GetOpFunc(opcode, EltTy);
     // Change store output to store tmpSigElts.
     ReplaceDynamicOutput(tmpSigElts, sigID, zero, F);
     // Store tmpSigElts to Output before return.
-    StoreTmpSigToOutput(tmpSigElts, row, opcodeV, sigID, F, Entry);
+    StoreTmpSigToOutput(tmpSigElts, opcodeV, sigID, F, Entry);
   }
   return true;
 }
 
+DxilEliminateOutputDynamicIndexing::RowRange
+DxilEliminateOutputDynamicIndexing::GetRowRange(Value *row, unsigned rows,
+                                                ScalarEvolution *SE) {
+  RowRange range = {0, rows - 1};
+  if (ConstantInt *C = dyn_cast<ConstantInt>(row)) {
+    range.Lo = range.Hi =
+        (unsigned)std::min<uint64_t>(C->getLimitedValue(), rows - 1);
+    return range;
+  }
+  if (!SE || !SE->isSCEVable(row->getType()))
+    return range;
+
+  // Covers masked indices like i & 3 as well as loop counters with a known
+  // trip count.
+  ConstantRange CR = SE->getUnsignedRange(SE->getSCEV(row));
+  uint64_t lo = CR.getUnsignedMin().getLimitedValue();
+  uint64_t hi = CR.getUnsignedMax().getLimitedValue();
+  // Rows past the end can't be written, so they don't narrow anything.
+  if (lo < rows) {
+    range.Lo = (unsigned)lo;
+    range.Hi = (unsigned)std::min<uint64_t>(hi, rows - 1);
+  }
+  return range;
+}
+
 void DxilEliminateOutputDynamicIndexing::ReplaceDynamicOutput(
-    ArrayRef<Value *> tmpSigElts, Value *sigID, Value *zero, Function *F) {
+    ArrayRef<TmpColumn> tmpSigElts, Value *sigID, Value *zero, Function *F) {
   for (auto it = F->user_begin(); it != F->user_end();) {
     CallInst *CI = cast<CallInst>(*(it++));
     DxilOutputStore store(CI);
     if (sigID == store.get_outputSigId()) {
       uint64_t col = store.get_colIndex();
-      Value *tmpSigElt = tmpSigElts[col];
+      const TmpColumn &tmpSigElt = tmpSigElts[col];
       IRBuilder<> Builder(CI);
       Value *r = store.get_rowIndex();
+      if (tmpSigElt.Lo != 0)
+        r = Builder.CreateSub(r, Builder.getInt32(tmpSigElt.Lo));
       // Store to tmpSigElt.
-      Value *GEP = Builder.CreateInBoundsGEP(tmpSigElt, {zero, r});
+      Value *GEP = Builder.CreateInBoundsGEP(tmpSigElt.Alloca, {zero, r});
       Builder.CreateStore(store.get_value(), GEP);
       // Remove store output.
       CI->eraseFromParent();
@@ -171,7 +263,7 @@ void DxilEliminateOutputDynamicIndexing::ReplaceDynamicOutput(
 }
 
 void DxilEliminateOutputDynamicIndexing::StoreTmpSigToOutput(
-    ArrayRef<Value *> tmpSigElts, unsigned row, Value *opcode, Value *sigID,
+    ArrayRef<TmpColumn> tmpSigElts, Value *opcode, Value *sigID,
     Function *StoreOutput, Function *Entry) {
   Value *args[] = {opcode, sigID, /*row*/ nullptr, /*col*/ nullptr,
                    /*val*/ nullptr};
@@ -181,11 +273,14 @@ void DxilEliminateOutputDynamicIndexing::StoreTmpSigToOutput(
       IRBuilder<> Builder(RI);
       Value *zero = Builder.getInt32(0);
       for (unsigned c = 0; c<tmpSigElts.size(); c++) {
-        Value *col = tmpSigElts[c];
+        const TmpColumn &col = tmpSigElts[c];
+        if (!col.Alloca)
+          continue;
         args[DXIL::OperandIndex::kStoreOutputColOpIdx] = Builder.getInt8(c);
-        for (unsigned r = 0; r < row; r++) {
-          Value *GEP =
-              Builder.CreateInBoundsGEP(col, {zero, Builder.getInt32(r)});
+        for (int r = col.Written.find_first(); r != -1;
+             r = col.Written.find_next(r)) {
+          Value *GEP = Builder.CreateInBoundsGEP(
+              col.Alloca, {zero, Builder.getInt32(r - col.Lo)});
           Value *V = Builder.CreateLoad(GEP);
           args[DXIL::OperandIndex::kStoreOutputRowOpIdx] = Builder.getInt32(r);
           args[DXIL::OperandIndex::kStoreOutputValOpIdx] = V;
@@ -204,6 +299,10 @@ ModulePass *llvm::createDxilEliminateOutputDynamicIndexingPass() {
   return new DxilEliminateOutputDynamicIndexing();
 }
 
-INITIALIZE_PASS(DxilEliminateOutputDynamicIndexing,
-                "hlsl-dxil-eliminate-output-dynamic",
-                "DXIL eliminate ouptut dynamic indexing", false, false)
+INITIALIZE_PASS_BEGIN(DxilEliminateOutputDynamicIndexing,
+                      "hlsl-dxil-eliminate-output-dynamic",
+                      "DXIL eliminate ouptut dynamic indexing", false, false)
+INITIALIZE_PASS_DEPENDENCY(ScalarEvolution)
+INITIALIZE_PASS_END(DxilEliminateOutputDynamicIndexing,
+                    "hlsl-dxil-eliminate-output-dynamic",
+                    "DXIL eliminate ouptut dynamic indexing", false, false)
@@ -29,6 +29,14 @@
 // 
 // where e contains the final expanded result.
 // 
+// Precision
+// ---------------------------------------------------------------------------
+// Asin, Acos, Atan and Htan have a full and a reduced precision expansion.
+// The reduced expansions evaluate lower degree polynomials, with an error
+// that is still below the precision of a 16-bit float. They are used for
+// 16-bit types (half and min16float), and for all types when the pass runs
+// with the relaxed option. Precise operations always use the full expansion.
+// 
 // References
 // ---------------------------------------------------------------------------
 // [HMF] Handbook of Mathematical Formulas by Abramowitz and Stegun, 1964
@@ -50,7 +58,6 @@
 #include "llvm/IR/Module.h"
 #include "llvm/Pass.h"
 #include "llvm/IR/IRBuilder.h"
-#include "llvm/IR/InstIterator.h"
 #include "llvm/ADT/MapVector.h"
 
 #include <cmath>
@@ -65,22 +72,26 @@ private:
 
 public:
   static char ID; // Pass identification, replacement for typeid
-  explicit DxilExpandTrigIntrinsics() : FunctionPass(ID) {}
+  explicit DxilExpandTrigIntrinsics() : FunctionPass(ID), Relaxed(false) {}
 
   const char *getPassName() const override {
     return "DXIL expand trig intrinsics";
   }
   
+  void applyOptions(PassOptions O) override;
   bool runOnFunction(Function &F) override;
   
 
 private:
+  // Use reduced precision expansions for 32-bit types as well.
+  bool Relaxed;
+
   typedef std::vector<CallInst *> IntrinsicList;
   IntrinsicList findTrigFunctionsToExpand(Function &F);
-  CallInst *isExpandableTrigIntrinsicCall(Instruction *I);
   bool expandTrigIntrinsics(DxilModule &DM, const IntrinsicList &worklist);
   FastMathFlags getFastMathFlagsForIntrinsic(CallInst *intrinsic);
   void prepareBuilderToExpandIntrinsic(IRBuilder<> &builder, CallInst *intrinsic);
+  bool useReducedPrecision(IRBuilder<> &builder, Value *X);
 
   // Expansion implementations.
   Value *expandACos(IRBuilder<> &builder, DxilInst_Acos acos, DxilModule &DM);
@@ -101,6 +112,19 @@ namespace math {
   constexpr double LOG2E = 1.44269504088896340736;
 }
 
+// Polynomial coefficients, lowest order first. See the expansions below for
+// the polynomials and their error.
+namespace coeffs {
+  const double PsiFull[]     = { 1.5707288, -0.2121144, 0.0742610, -0.0187293 };
+  const double PsiReduced[]  = { 1.5704704, -0.2054980, 0.0513901 };
+  const double ATanFull[]    = { 0.9998660, -0.3302995, 0.1801410, -0.0851330, 0.0208351 };
+  const double ATanReduced[] = { 0.9953578, -0.2886894, 0.0793382 };
+}
+
+}
+
+void DxilExpandTrigIntrinsics::applyOptions(PassOptions O) {
+  GetPassOptionBool(O, "relaxed", &Relaxed, false);
 }
 
 
@@ -111,28 +135,24 @@ bool DxilExpandTrigIntrinsics::runOnFunction(Function &F) {
   return changed;
 }
 
-CallInst *DxilExpandTrigIntrinsics::isExpandableTrigIntrinsicCall(Instruction *I) {
-    if (OP::IsDxilOpFuncCallInst(I)) {
-      switch (OP::GetDxilOpFuncCallInst(I)) {
-      case OP::OpCode::Acos:
-      case OP::OpCode::Asin:
-      case OP::OpCode::Atan:
-      case OP::OpCode::Hcos:
-      case OP::OpCode::Hsin:
-      case OP::OpCode::Htan:
-      case OP::OpCode::Tan:
-        return cast<CallInst>(I);
-      default: break;
-      }
-    }
-    return nullptr;
-}
-
 DxilExpandTrigIntrinsics::IntrinsicList DxilExpandTrigIntrinsics::findTrigFunctionsToExpand(Function &F) {
   IntrinsicList worklist;
-  for (inst_iterator I = inst_begin(F), E = inst_end(F); I != E; ++I)
-    if (CallInst *call = isExpandableTrigIntrinsicCall(&*I))
-      worklist.push_back(call);
+  // All of the expanded operations are in the unary class.
+  DxilOpCallList OpCalls(F);
+  for (const DxilOpCallList::Call &C : OpCalls.calls(OP::OpCodeClass::Unary)) {
+    switch (C.Opcode) {
+    case OP::OpCode::Acos:
+    case OP::OpCode::Asin:
+    case OP::OpCode::Atan:
+    case OP::OpCode::Hcos:
+    case OP::OpCode::Hsin:
+    case OP::OpCode::Htan:
+    case OP::OpCode::Tan:
+      worklist.push_back(C.CI);
+      break;
+    default: break;
+    }
+  }
 
   return worklist;
 }
@@ -156,6 +176,12 @@ void DxilExpandTrigIntrinsics::prepareBuilderToExpandIntrinsic(IRBuilder<> &buil
   setPreciseBuilder(builder, DM.IsPrecise(intrinsic));
 }
   
+bool DxilExpandTrigIntrinsics::useReducedPrecision(IRBuilder<> &builder, Value *X) {
+  if (isPreciseBuilder(builder))
+    return false;
+  return Relaxed || X->getType()->getScalarType()->isHalfTy();
+}
+
 bool DxilExpandTrigIntrinsics::expandTrigIntrinsics(DxilModule &DM, const IntrinsicList &worklist) {
   IRBuilder<> builder(DM.GetCtx());
   for (CallInst *intrinsic: worklist) {
@@ -220,25 +246,22 @@ static Value *emitSqrt(IRBuilder<> &builder, Value *X, OP *dxOp, StringRef name)
 //         = a0 + x(a1 + a2x + a3x^2)
 //         = a0 + x(a1 + x(a2 + a3x))
 //
-static Value *emitSqrt1mXtimesPsiX(IRBuilder<> &builder, Value *X, OP *dxOp, StringRef name) {
+static Value *emitSqrt1mXtimesPsiX(IRBuilder<> &builder, Value *X,
+                                   ArrayRef<double> a, OP *dxOp,
+                                   StringRef name) {
   Value *One = ConstantFP::get(X->getType(), 1.0);
-  Value *a0 = ConstantFP::get(X->getType(),  1.5707288);
-  Value *a1 = ConstantFP::get(X->getType(), -0.2121144);
-  Value *a2 = ConstantFP::get(X->getType(),  0.0742610);
-  Value *a3 = ConstantFP::get(X->getType(), -0.0187293);
-
 
   // sqrt(1-x)
   Value *r1 = builder.CreateFSub(One, X, name);
   Value *r2 = emitSqrt(builder, r1, dxOp, name);
 
   // psi*(x)
-  Value *r3 = builder.CreateFMul(X,  a3, name);
-         r3 = builder.CreateFAdd(r3, a2, name);
-         r3 = builder.CreateFMul(X,  r3, name);
-         r3 = builder.CreateFAdd(r3, a1, name);
-         r3 = builder.CreateFMul(X,  r3, name);
-         r3 = builder.CreateFAdd(r3, a0, name);
+  Value *r3 = builder.CreateFMul(X, ConstantFP::get(X->getType(), a.back()), name);
+  for (size_t i = a.size() - 1; i-- > 0;) {
+    r3 = builder.CreateFAdd(r3, ConstantFP::get(X->getType(), a[i]), name);
+    if (i > 0)
+      r3 = builder.CreateFMul(X, r3, name);
+  }
 
   // sqrt(1-x) * psi*(x)
   Value *r4 = builder.CreateFMul(r2, r3,  name);
@@ -295,6 +318,13 @@ static std::pair<Value *, Value *> emitExEmx(IRBuilder<> &builder, Value *X, OP
 // In [HMF] the authors claim an error, e, of |e| <= 5e-5, but the error graph
 // in [ADC] looks like the error can be larger that that for some inputs.
 // 
+// The reduced precision expansion uses a minimax fit of degree two instead
+//    Psi*(X) = a0 + a1x + a2x^2
+//      a0 =  1.5704704
+//      a1 = -0.2054980
+//      a2 =  0.0513901
+// with an error of |e| <= 3.3e-4.
+//
 Value *DxilExpandTrigIntrinsics::expandASin(IRBuilder<> &builder, DxilInst_Asin asin, DxilModule &DM) {
   assert(asin);
   StringRef name = "asin.x";
@@ -306,7 +336,10 @@ Value *DxilExpandTrigIntrinsics::expandASin(IRBuilder<> &builder, DxilInst_Asin
   Value *absX = emitFAbs(builder, X, DM.GetOP(), name);
 
   // Approximation
-  Value *psiX = emitSqrt1mXtimesPsiX(builder, absX, DM.GetOP(), name);
+  ArrayRef<double> psi = useReducedPrecision(builder, X)
+                             ? makeArrayRef(coeffs::PsiReduced)
+                             : makeArrayRef(coeffs::PsiFull);
+  Value *psiX = emitSqrt1mXtimesPsiX(builder, absX, psi, DM.GetOP(), name);
   Value *asinX = builder.CreateFSub(PI_2, psiX, name);
   Value *asinmX = builder.CreateFSub(Zero, asinX, name);
 
@@ -350,7 +383,10 @@ Value *DxilExpandTrigIntrinsics::expandACos(IRBuilder<> &builder, DxilInst_Acos
   Value *absX = emitFAbs(builder, X, DM.GetOP(), name);
 
   // Approximation
-  Value *acosX = emitSqrt1mXtimesPsiX(builder, absX, DM.GetOP(), name);
+  ArrayRef<double> psi = useReducedPrecision(builder, X)
+                             ? makeArrayRef(coeffs::PsiReduced)
+                             : makeArrayRef(coeffs::PsiFull);
+  Value *acosX = emitSqrt1mXtimesPsiX(builder, absX, psi, DM.GetOP(), name);
   Value *acosmX = builder.CreateFSub(PI, acosX, name);
 
   // Range expansion to [-1, 1]
@@ -385,6 +421,13 @@ Value *DxilExpandTrigIntrinsics::expandACos(IRBuilder<> &builder, DxilInst_Acos
 // 	= x(c1 + x^2(c3 + x^2(c5 + c7x^2 + c9x^4)))
 // 	= x(c1 + x^2(c3 + x^2(c5 + x^2(c7 + c9x^2))))
 // 	
+// The reduced precision expansion uses a minimax fit with three terms
+//    arctan*(x) = c1x + c3x^3 + c5x^5
+//      c1 =  0.9953578
+//      c3 = -0.2886894
+//      c5 =  0.0793382
+// with an error of |e| <= 6.1e-4.
+// 	
 // The range reduction is a little more compilicated for atan because the
 // domain of atan is [-inf, inf], but the domain of the approximation is only
 // [-1, 1]. We use the following identities for range reduction from
@@ -407,11 +450,9 @@ Value *DxilExpandTrigIntrinsics::expandATan(IRBuilder<> &builder, DxilInst_Atan
   Value *PI_2 = ConstantFP::get(X->getType(), math::PI_2);
   Value *One  = ConstantFP::get(X->getType(), 1.0);
   Value *Zero = ConstantFP::get(X->getType(), 0.0);
-  Value *c1 = ConstantFP::get(X->getType(),  0.9998660);
-  Value *c3 = ConstantFP::get(X->getType(), -0.3302995);
-  Value *c5 = ConstantFP::get(X->getType(),  0.1801410);
-  Value *c7 = ConstantFP::get(X->getType(), -0.0851330);
-  Value *c9 = ConstantFP::get(X->getType(),  0.0208351);
+  ArrayRef<double> c = useReducedPrecision(builder, X)
+                           ? makeArrayRef(coeffs::ATanReduced)
+                           : makeArrayRef(coeffs::ATanFull);
 
   // Range reduction to [0, inf]
   Value *absX = emitFAbs(builder, X, DM.GetOP(), name);
@@ -423,15 +464,13 @@ Value *DxilExpandTrigIntrinsics::expandATan(IRBuilder<> &builder, DxilInst_Atan
 
   // Approximate
   Value *r3 = builder.CreateFMul(r2, r2, name);
-  Value *r4 = builder.CreateFMul(r3, c9, name);
-         r4 = builder.CreateFAdd(r4, c7, name);
-         r4 = builder.CreateFMul(r4, r3, name);
-         r4 = builder.CreateFAdd(r4, c5, name);
-         r4 = builder.CreateFMul(r4, r3, name);
-         r4 = builder.CreateFAdd(r4, c3, name);
-         r4 = builder.CreateFMul(r4, r3, name);
-         r4 = builder.CreateFAdd(r4, c1, name);
-         r4 = builder.CreateFMul(r2, r4, name);
+  Value *r4 = builder.CreateFMul(r3, ConstantFP::get(X->getType(), c.back()), name);
+  for (size_t i = c.size() - 1; i-- > 0;) {
+    r4 = builder.CreateFAdd(r4, ConstantFP::get(X->getType(), c[i]), name);
+    if (i > 0)
+      r4 = builder.CreateFMul(r4, r3, name);
+  }
+  r4 = builder.CreateFMul(r2, r4, name);
 
   // Range Expansion to [0, inf]
   Value *r5 = builder.CreateFSub(PI_2, r4, name);
@@ -497,12 +536,42 @@ Value *DxilExpandTrigIntrinsics::expandHSin(IRBuilder<> &builder, DxilInst_Hsin
 //
 // No range reduction is needed.
 //
+// The reduced precision expansion needs a single exponential. Dividing the
+// identity above by e^x gives, for x >= 0,
+//
+//    tanh(x) = (1 - e^-2x) / (1 + e^-2x)
+//
+// and we use tanh(-x) = -tanh(x) for negative inputs. This also avoids the
+// overflow of e^x for large inputs, which is reached early for half.
+//
 Value *DxilExpandTrigIntrinsics::expandHTan(IRBuilder<> &builder, DxilInst_Htan htan, DxilModule &DM) {
   assert(htan);
   StringRef name = "htan.x";
   Value *eX, *emX;
   Value *X = htan.get_value();
 
+  if (useReducedPrecision(builder, X)) {
+    Value *One  = ConstantFP::get(X->getType(), 1.0);
+    Value *Zero = ConstantFP::get(X->getType(), 0.0);
+    Value *M2Log2e = ConstantFP::get(X->getType(), -2.0 * math::LOG2E);
+
+    // Range reduction to [0, inf]
+    Value *absX = emitFAbs(builder, X, DM.GetOP(), name);
+
+    // e^-2x
+    Value *r0 = builder.CreateFMul(absX, M2Log2e, name);
+    Value *r1 = emitUnaryFloat(builder, r0, DM.GetOP(), OP::OpCode::Exp, name);
+
+    Value *r2 = builder.CreateFSub(One, r1, name);
+    Value *r3 = builder.CreateFAdd(One, r1, name);
+    Value *r4 = builder.CreateFDiv(r2, r3, name);
+
+    // Range expansion to [-inf, inf]
+    Value *r5 = builder.CreateFSub(Zero, r4, name);
+    Value *lt0 = builder.CreateFCmp(CmpInst::FCMP_ULT, X, Zero, name);
+    return builder.CreateSelect(lt0, r5, r4, name);
+  }
+
   std::tie(eX, emX) = emitExEmx(builder, X, DM.GetOP(), name);
   Value *r4 = builder.CreateFSub(eX, emX, name);
   Value *r5 = builder.CreateFAdd(eX, emX, name);
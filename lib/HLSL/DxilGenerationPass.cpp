@@ -187,6 +187,7 @@ void InitDxilModuleFromHLModule(HLModule &H, DxilModule &M, DxilEntrySignature *
 
   // DXIL type system.
   M.ResetTypeSystem(H.ReleaseTypeSystem());
+  M.SetPackedTypeSystem(H.GetHLOptions().bPackedTypeAnnotations);
   // Dxil OP.
   M.ResetOP(H.ReleaseOP());
   // Keep llvm used.
@@ -1005,7 +1006,8 @@ void DxilGenerationPass::GenerateDxilOperations(
   }
 
   TranslateBuiltinOperations(*m_pHLModule, m_extensionsCodegenHelper,
-                             UpdateCounterSet, NonUniformSet);
+                             UpdateCounterSet, NonUniformSet,
+                             getRunListener());
 
   // Remove unused HL Operation functions.
   std::vector<Function *> deadList;
@@ -1558,12 +1560,11 @@ public:
 
   bool runOnFunction(Function &F) override {
     // Promote local resource first.
-    PromoteLocalResource(F);
-    return true;
+    return PromoteLocalResource(F);
   }
 
 private:
-  void PromoteLocalResource(Function &F);
+  bool PromoteLocalResource(Function &F);
 };
 
 char DxilLegalizeResourceUsePass::ID = 0;
@@ -1576,49 +1577,42 @@ void DxilLegalizeResourceUsePass::getAnalysisUsage(AnalysisUsage &AU) const {
   AU.setPreservesAll();
 }
 
-void DxilLegalizeResourceUsePass::PromoteLocalResource(Function &F) {
-  std::vector<AllocaInst *> Allocas;
-  DominatorTree *DT = &getAnalysis<DominatorTreeWrapperPass>().getDomTree();
-  AssumptionCache &AC =
-      getAnalysis<AssumptionCacheTracker>().getAssumptionCache(F);
+bool DxilLegalizeResourceUsePass::PromoteLocalResource(Function &F) {
   HLModule &HLM = F.getParent()->GetOrCreateHLModule();
   OP *hlslOP = HLM.GetOP();
   Type *HandleTy = hlslOP->GetHandleType();
 
   bool IsLib = HLM.GetShaderModel()->IsLib();
 
+  // Find allocas that are safe to promote, by looking at all instructions in
+  // the entry node. Promoting one never makes another promotable, so they all
+  // go through a single SSA construction.
+  std::vector<AllocaInst *> Allocas;
+  bool bUnmapped = false;
   BasicBlock &BB = F.getEntryBlock();
-  unsigned allocaSize = 0;
-  while (1) {
-    Allocas.clear();
-
-    // Find allocas that are safe to promote, by looking at all instructions in
-    // the entry node
-    for (BasicBlock::iterator I = BB.begin(), E = --BB.end(); I != E; ++I)
-      if (AllocaInst *AI = dyn_cast<AllocaInst>(I)) { // Is it an alloca?
-        if (HandleTy == dxilutil::GetArrayEltTy(AI->getAllocatedType())) {
+  for (BasicBlock::iterator I = BB.begin(), E = --BB.end(); I != E; ++I)
+    if (AllocaInst *AI = dyn_cast<AllocaInst>(I)) { // Is it an alloca?
+      if (HandleTy == dxilutil::GetArrayEltTy(AI->getAllocatedType())) {
+        if (!isAllocaPromotable(AI)) {
           // Skip for unpromotable for lib.
-          if (!isAllocaPromotable(AI) && IsLib)
-            continue;
-          DXASSERT(isAllocaPromotable(AI), "otherwise, non-promotable resource array alloca found");
-          Allocas.push_back(AI);
+          bUnmapped |= !IsLib;
+          continue;
         }
+        Allocas.push_back(AI);
       }
-    if (Allocas.empty())
-      break;
-
-    // No update.
-    // Report error and break.
-    if (allocaSize == Allocas.size()) {
-      F.getContext().emitError(kResourceMapErrorMsg);
-      break;
     }
-    allocaSize = Allocas.size();
-
-    PromoteMemToReg(Allocas, *DT, nullptr, &AC);
-  }
+  if (bUnmapped)
+    F.getContext().emitError(kResourceMapErrorMsg);
+  // Most functions have no local resources; don't build a dominator tree
+  // for them.
+  if (Allocas.empty())
+    return false;
 
-  return;
+  DominatorTree *DT = &getAnalysis<DominatorTreeWrapperPass>().getDomTree();
+  AssumptionCache &AC =
+      getAnalysis<AssumptionCacheTracker>().getAssumptionCache(F);
+  PromoteMemToReg(Allocas, *DT, nullptr, &AC);
+  return true;
 }
 
 FunctionPass *llvm::createDxilLegalizeResourceUsePass() {
@@ -1639,39 +1633,39 @@ void DxilLegalizeStaticResourceUsePass::PromoteStaticGlobalResources(
   HLModule &HLM = M.GetOrCreateHLModule();
   Type *HandleTy = HLM.GetOP()->GetHandleType();
 
-  std::set<GlobalVariable *> staticResources;
+  // Collect in module order so the promoted values are named the same way
+  // on every run.
+  std::vector<GlobalVariable *> staticResources;
   for (auto &GV : M.globals()) {
     if (GV.getLinkage() == GlobalValue::LinkageTypes::InternalLinkage &&
         HandleTy == dxilutil::GetArrayEltTy(GV.getType())) {
-      staticResources.insert(&GV);
+      staticResources.emplace_back(&GV);
     }
   }
+  if (staticResources.empty())
+    return;
+
+  // Promoting one resource only replaces its own loads and stores; loads of
+  // other resources it copied from stay in place for their own promotion.
+  // So a single sweep maps every resource that can be mapped.
   SSAUpdater SSA;
   SmallVector<Instruction *, 4> Insts;
-  // Make sure every resource load has mapped to global variable.
-  while (!staticResources.empty()) {
-    bool bUpdated = false;
-    for (auto it = staticResources.begin(); it != staticResources.end();) {
-      GlobalVariable *GV = *(it++);
-      // Build list of instructions to promote.
-      for (User *U : GV->users()) {
-        Instruction *I = cast<Instruction>(U);
-        Insts.emplace_back(I);
-      }
+  bool bMapped = true;
+  for (GlobalVariable *GV : staticResources) {
+    // Build list of instructions to promote.
+    for (User *U : GV->users()) {
+      Instruction *I = cast<Instruction>(U);
+      Insts.emplace_back(I);
+    }
 
-      LoadAndStorePromoter(Insts, SSA).run(Insts);
-      if (GV->user_empty()) {
-        bUpdated = true;
-        staticResources.erase(GV);
-      }
+    LoadAndStorePromoter(Insts, SSA).run(Insts);
+    // Make sure every resource load has mapped to global variable.
+    bMapped &= GV->user_empty();
 
-      Insts.clear();
-    }
-    if (!bUpdated) {
-      M.getContext().emitError(kResourceMapErrorMsg);
-      break;
-    }
+    Insts.clear();
   }
+  if (!bMapped)
+    M.getContext().emitError(kResourceMapErrorMsg);
 }
 
 static void ReplaceResUseWithHandle(Instruction *Res, Value *Handle) {
@@ -0,0 +1,376 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilGroupSharedLayout.cpp                                                 //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Lays out groupshared arrays of compute shaders to avoid bank conflicts    //
+// and to share memory between arrays that are never live at once.           //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/HLSL/DxilGenerationPass.h"
+#include "dxc/HLSL/DxilModule.h"
+#include "dxc/HLSL/DxilOperations.h"
+#include "dxc/HLSL/DxilInstructions.h"
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Analysis/CFG.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Operator.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/MathExtras.h"
+
+#include <algorithm>
+
+using namespace llvm;
+using namespace hlsl;
+
+#define DEBUG_TYPE "dxil-groupshared-layout"
+
+///////////////////////////////////////////////////////////////////////////////
+// Groupshared layout.
+
+namespace {
+// Groupshared memory is spread over banks of one 32-bit word, and the lanes
+// of a wave that access different words of the same bank at once are
+// serialized.
+const unsigned kTGSMBankCount = 32;
+
+// Only one-dimensional arrays of 32-bit scalars, the form arrays take after
+// DXIL lowering, are changed. All of their accesses must go through
+// getelementptr 0, index in the entry function.
+struct GroupSharedArray {
+  GlobalVariable *GV;
+  // Instructions that read or write the array.
+  SmallVector<Instruction *, 8> Accesses;
+};
+
+class DxilGroupSharedLayout : public ModulePass {
+public:
+  static char ID; // Pass identification, replacement for typeid
+  explicit DxilGroupSharedLayout() : ModulePass(ID) {}
+
+  const char *getPassName() const override {
+    return "DXIL groupshared layout";
+  }
+
+  bool runOnModule(Module &M) override {
+    if (!M.HasDxilModule())
+      return false;
+    DxilModule &DM = M.GetDxilModule();
+    Function *Entry = DM.GetEntryFunction();
+    if (!Entry || !DM.GetShaderModel()->IsCS())
+      return false;
+
+    std::vector<GroupSharedArray> Arrays;
+    for (GlobalVariable &GV : M.globals()) {
+      if (GV.getType()->getAddressSpace() != DXIL::kTGSMAddrSpace)
+        continue;
+      GroupSharedArray Array = { &GV, {} };
+      if (CollectAccesses(Array, Entry))
+        Arrays.emplace_back(std::move(Array));
+    }
+    if (Arrays.empty())
+      return false;
+
+    bool bChanged = ShareDisjointArrays(Arrays, *Entry);
+    for (GroupSharedArray &Array : Arrays)
+      bChanged |= PadConflictingArray(Array, M);
+    return bChanged;
+  }
+
+private:
+  bool CollectAccesses(GroupSharedArray &Array, Function *Entry);
+  bool ShareDisjointArrays(std::vector<GroupSharedArray> &Arrays,
+                           Function &Entry);
+  bool PadConflictingArray(GroupSharedArray &Array, Module &M);
+};
+
+char DxilGroupSharedLayout::ID = 0;
+
+bool IsRewritableType(Type *Ty) {
+  ArrayType *AT = dyn_cast<ArrayType>(Ty);
+  if (!AT)
+    return false;
+  Type *EltTy = AT->getElementType();
+  return EltTy->isFloatTy() || EltTy->isIntegerTy(32);
+}
+
+// Whether the value varies with the lane of a wave: SV_GroupThreadID.x,
+// SV_DispatchThreadID.x and SV_GroupIndex advance from one lane to the next.
+bool DependsOnLaneIndex(Value *V, unsigned Depth = 6) {
+  Instruction *I = dyn_cast<Instruction>(V);
+  if (!I || Depth == 0)
+    return false;
+  if (DxilInst_ThreadIdInGroup TID = DxilInst_ThreadIdInGroup(I))
+    return isa<ConstantInt>(TID.get_component()) &&
+           cast<ConstantInt>(TID.get_component())->isZero();
+  if (DxilInst_ThreadId TID = DxilInst_ThreadId(I))
+    return isa<ConstantInt>(TID.get_component()) &&
+           cast<ConstantInt>(TID.get_component())->isZero();
+  if (OP::IsDxilOpFuncCallInst(I, DXIL::OpCode::FlattenedThreadIdInGroup))
+    return true;
+  if (!isa<BinaryOperator>(I) && !isa<CastInst>(I))
+    return false;
+  for (Value *Op : I->operands()) {
+    if (DependsOnLaneIndex(Op, Depth - 1))
+      return true;
+  }
+  return false;
+}
+
+// Words between the elements that consecutive lanes access, for indices of
+// the form lane * stride + offset; 0 when the index isn't of that form.
+unsigned GetLaneStride(Value *Index, unsigned Depth = 4) {
+  BinaryOperator *BO = dyn_cast<BinaryOperator>(Index);
+  if (!BO || Depth == 0)
+    return 0;
+  Value *Op0 = BO->getOperand(0);
+  Value *Op1 = BO->getOperand(1);
+  switch (BO->getOpcode()) {
+  case Instruction::Add:
+  case Instruction::Or:
+    return std::max(GetLaneStride(Op0, Depth - 1),
+                    GetLaneStride(Op1, Depth - 1));
+  case Instruction::Mul:
+    if (isa<ConstantInt>(Op0))
+      std::swap(Op0, Op1);
+    if (ConstantInt *C = dyn_cast<ConstantInt>(Op1)) {
+      if (DependsOnLaneIndex(Op0))
+        return (unsigned)C->getLimitedValue(UINT32_MAX);
+    }
+    return 0;
+  case Instruction::Shl:
+    if (ConstantInt *C = dyn_cast<ConstantInt>(Op1)) {
+      if (C->getLimitedValue() < 32 && DependsOnLaneIndex(Op0))
+        return 1u << C->getZExtValue();
+    }
+    return 0;
+  default:
+    return 0;
+  }
+}
+
+bool IsGroupSyncBarrier(Instruction *I) {
+  DxilInst_Barrier Barrier(I);
+  if (!Barrier || !isa<ConstantInt>(Barrier.get_barrierMode()))
+    return false;
+  unsigned Mode = Barrier.get_barrierMode_val();
+  const unsigned Required = (unsigned)DXIL::BarrierMode::SyncThreadGroup |
+                            (unsigned)DXIL::BarrierMode::TGSMFence;
+  return (Mode & Required) == Required;
+}
+
+// Points the accesses of From at To. Index i becomes i + i / PadStride when
+// PadStride is not 0, which leaves one unused word after every PadStride
+// words.
+void RetargetAccesses(GlobalVariable *From, GlobalVariable *To,
+                      unsigned PadStride) {
+  Type *I32Ty = Type::getInt32Ty(From->getContext());
+  Constant *Zero = ConstantInt::get(I32Ty, 0);
+  unsigned PadShift = PadStride ? Log2_32(PadStride) : 0;
+  for (auto UI = From->user_begin(); UI != From->user_end();) {
+    User *U = *(UI++);
+    Value *Index = U->getOperand(2);
+    if (ConstantExpr *CE = dyn_cast<ConstantExpr>(U)) {
+      uint64_t I = cast<ConstantInt>(Index)->getZExtValue();
+      if (PadStride)
+        I += I >> PadShift;
+      Constant *Indices[] = { Zero, ConstantInt::get(I32Ty, I) };
+      CE->replaceAllUsesWith(ConstantExpr::getInBoundsGetElementPtr(
+          To->getType()->getElementType(), To, Indices));
+      CE->destroyConstant();
+      continue;
+    }
+    GetElementPtrInst *GEP = cast<GetElementPtrInst>(U);
+    IRBuilder<> Builder(GEP);
+    if (PadStride)
+      Index = Builder.CreateAdd(Index, Builder.CreateLShr(Index, PadShift));
+    Value *Indices[] = { Zero, Index };
+    Value *NewGEP = Builder.CreateInBoundsGEP(To, Indices);
+    NewGEP->takeName(GEP);
+    GEP->replaceAllUsesWith(NewGEP);
+    GEP->eraseFromParent();
+  }
+}
+
+unsigned GetGroupSharedSize(Module &M) {
+  const DataLayout &DL = M.getDataLayout();
+  unsigned Size = 0;
+  for (GlobalVariable &GV : M.globals()) {
+    if (GV.getType()->getAddressSpace() == DXIL::kTGSMAddrSpace)
+      Size += DL.getTypeAllocSize(GV.getType()->getElementType());
+  }
+  return Size;
+}
+}
+
+bool DxilGroupSharedLayout::CollectAccesses(GroupSharedArray &Array,
+                                            Function *Entry) {
+  GlobalVariable *GV = Array.GV;
+  if (!IsRewritableType(GV->getType()->getElementType()))
+    return false;
+  for (User *U : GV->users()) {
+    GEPOperator *GEP = dyn_cast<GEPOperator>(U);
+    if (!GEP || GEP->getNumIndices() != 2 ||
+        !isa<ConstantInt>(GEP->getOperand(1)) ||
+        !cast<ConstantInt>(GEP->getOperand(1))->isZero())
+      return false;
+    if (isa<ConstantExpr>(GEP) && !isa<ConstantInt>(GEP->getOperand(2)))
+      return false;
+    if (Instruction *I = dyn_cast<Instruction>(GEP)) {
+      if (I->getParent()->getParent() != Entry)
+        return false;
+    }
+    for (User *GEPU : GEP->users()) {
+      Instruction *Access = dyn_cast<Instruction>(GEPU);
+      if (!Access || Access->getParent()->getParent() != Entry)
+        return false;
+      Array.Accesses.push_back(Access);
+    }
+  }
+  return true;
+}
+
+// Arrays whose accesses are separated by a group barrier can share memory:
+// when every access of one comes before the barrier and every access of the
+// other after it, no thread can see the other's data except where it would
+// have been undefined anyway. The smaller array moves into the larger one.
+bool DxilGroupSharedLayout::ShareDisjointArrays(
+    std::vector<GroupSharedArray> &Arrays, Function &Entry) {
+  SmallVector<Instruction *, 4> Barriers;
+  for (BasicBlock &BB : Entry) {
+    for (Instruction &I : BB) {
+      if (IsGroupSyncBarrier(&I))
+        Barriers.push_back(&I);
+    }
+  }
+  if (Barriers.empty() || Arrays.size() < 2)
+    return false;
+
+  DominatorTree DT;
+  DT.recalculate(Entry);
+  auto IsBefore = [&](const GroupSharedArray &First,
+                      const GroupSharedArray &Second) {
+    for (Instruction *Barrier : Barriers) {
+      bool bSeparates = true;
+      for (Instruction *Access : Second.Accesses)
+        bSeparates &= DT.dominates(Barrier, Access);
+      for (Instruction *Access : First.Accesses)
+        bSeparates &= !isPotentiallyReachable(Barrier, Access, &DT);
+      if (bSeparates)
+        return true;
+    }
+    return false;
+  };
+
+  // Largest first, so that arrays move into ones that can hold them.
+  const DataLayout &DL = Entry.getParent()->getDataLayout();
+  auto Size = [&](const GroupSharedArray &Array) {
+    return DL.getTypeAllocSize(Array.GV->getType()->getElementType());
+  };
+  std::stable_sort(Arrays.begin(), Arrays.end(),
+                   [&](const GroupSharedArray &A, const GroupSharedArray &B) {
+                     return Size(A) > Size(B);
+                   });
+
+  std::vector<GroupSharedArray> Hosts;
+  for (GroupSharedArray &Array : Arrays) {
+    Type *EltTy = Array.GV->getType()->getElementType()->getArrayElementType();
+    GroupSharedArray *pHost = nullptr;
+    for (GroupSharedArray &Host : Hosts) {
+      if (Host.GV->getType()->getElementType()->getArrayElementType() ==
+              EltTy &&
+          (IsBefore(Host, Array) || IsBefore(Array, Host))) {
+        pHost = &Host;
+        break;
+      }
+    }
+    if (!pHost) {
+      Hosts.emplace_back(std::move(Array));
+      continue;
+    }
+
+    DEBUG(dbgs() << "DXIL groupshared layout: " << Array.GV->getName()
+                 << " shares the memory of " << pHost->GV->getName()
+                 << ", saving " << Size(Array) << " bytes\n");
+    RetargetAccesses(Array.GV, pHost->GV, 0);
+    Array.GV->eraseFromParent();
+    pHost->Accesses.append(Array.Accesses.begin(), Array.Accesses.end());
+  }
+
+  bool bChanged = Hosts.size() != Arrays.size();
+  Arrays.swap(Hosts);
+  return bChanged;
+}
+
+// When consecutive lanes access words a multiple of the bank count apart,
+// they all hit the same bank. Padding each row of stride words by one word
+// moves consecutive lanes to consecutive banks.
+bool DxilGroupSharedLayout::PadConflictingArray(GroupSharedArray &Array,
+                                                Module &M) {
+  unsigned Stride = 0;
+  for (Instruction *Access : Array.Accesses) {
+    Value *Ptr = nullptr;
+    if (LoadInst *LI = dyn_cast<LoadInst>(Access))
+      Ptr = LI->getPointerOperand();
+    else if (StoreInst *SI = dyn_cast<StoreInst>(Access))
+      Ptr = SI->getPointerOperand();
+    else
+      continue;
+    GEPOperator *GEP = cast<GEPOperator>(Ptr);
+    unsigned AccessStride = GetLaneStride(GEP->getOperand(2));
+    if (AccessStride == 0 || AccessStride % kTGSMBankCount != 0)
+      continue;
+    // Padding suits a single row length.
+    if (Stride != 0 && Stride != AccessStride)
+      return false;
+    Stride = AccessStride;
+  }
+  if (Stride == 0 || !isPowerOf2_32(Stride))
+    return false;
+
+  GlobalVariable *GV = Array.GV;
+  ArrayType *Ty = cast<ArrayType>(GV->getType()->getElementType());
+  uint64_t NumElts = Ty->getNumElements();
+  if (NumElts <= Stride)
+    return false;
+  uint64_t PaddedNumElts = NumElts + (NumElts - 1) / Stride;
+  unsigned ExtraSize = (unsigned)(PaddedNumElts - NumElts) * 4;
+  if (GetGroupSharedSize(M) + ExtraSize > DXIL::kMaxTGSMSize) {
+    DEBUG(dbgs() << "DXIL groupshared layout: " << GV->getName()
+                 << " has bank conflicts, but padding it would exceed the "
+                    "groupshared limit\n");
+    return false;
+  }
+
+  DEBUG(dbgs() << "DXIL groupshared layout: " << GV->getName()
+               << " is padded after every " << Stride
+               << " words against bank conflicts, adding " << ExtraSize
+               << " bytes\n");
+  ArrayType *PaddedTy = ArrayType::get(Ty->getElementType(), PaddedNumElts);
+  GlobalVariable *PaddedGV = new GlobalVariable(
+      M, PaddedTy, GV->isConstant(), GV->getLinkage(),
+      UndefValue::get(PaddedTy), "", GV, GV->getThreadLocalMode(),
+      DXIL::kTGSMAddrSpace);
+  PaddedGV->takeName(GV);
+  PaddedGV->setAlignment(GV->getAlignment());
+  RetargetAccesses(GV, PaddedGV, Stride);
+  GV->eraseFromParent();
+  Array.GV = PaddedGV;
+  return true;
+}
+
+ModulePass *llvm::createDxilGroupSharedLayoutPass() {
+  return new DxilGroupSharedLayout();
+}
+
+INITIALIZE_PASS(DxilGroupSharedLayout, "hlsl-dxil-groupshared-layout",
+                "DXIL groupshared layout", false, false)
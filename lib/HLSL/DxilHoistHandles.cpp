@@ -0,0 +1,212 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilHoistHandles.cpp                                                      //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Merges createHandle calls with the same operands and hoists them to where //
+// they dominate all their uses.                                             //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/HLSL/DxilGenerationPass.h"
+#include "dxc/HLSL/DxilConstants.h"
+#include "dxc/HLSL/DxilOperations.h"
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Pass.h"
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <vector>
+
+using namespace llvm;
+using namespace hlsl;
+
+///////////////////////////////////////////////////////////////////////////////
+// Hoist handles.
+
+namespace {
+// Handles are created next to each use during DXIL generation. createHandle
+// is readonly rather than readnone, so GVN won't merge two calls with a store
+// between them, and LICM won't move them out of loops that write UAVs.
+// Creating a handle reads no memory that a shader can write, though, so calls
+// with the same operands give the same handle wherever they are.
+//
+// Each set of equal calls is replaced by one call in the nearest block that
+// dominates all of them, moved on to the preheader of loops its operands
+// don't depend on. That may run the call on paths that never needed it,
+// which is only done when every lane would index the same resource: the
+// index is constant or wave-uniform and not marked NonUniformResourceIndex.
+// Otherwise calls are only merged into an equal call that dominates them.
+class DxilHoistHandles : public FunctionPass {
+public:
+  static char ID; // Pass identification, replacement for typeid
+  explicit DxilHoistHandles() : FunctionPass(ID) {}
+
+  const char *getPassName() const override {
+    return "DXIL hoist handles";
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.addRequired<DominatorTreeWrapperPass>();
+    AU.addRequired<LoopInfoWrapperPass>();
+    AU.setPreservesCFG();
+  }
+
+  bool runOnFunction(Function &F) override;
+
+private:
+  bool MayHoist(CallInst *Handle);
+  Instruction *FindInsertPoint(ArrayRef<CallInst *> Handles);
+  bool Hoist(ArrayRef<CallInst *> Handles);
+  bool MergeDominated(ArrayRef<CallInst *> Handles);
+
+  DominatorTree *m_pDT;
+  LoopInfo *m_pLI;
+  std::unique_ptr<UniformityAnalysis> m_pUniformity;
+};
+
+char DxilHoistHandles::ID = 0;
+}
+
+bool DxilHoistHandles::runOnFunction(Function &F) {
+  // Group the calls by operands, in program order.
+  std::map<std::vector<Value *>, unsigned> GroupIndex;
+  std::vector<SmallVector<CallInst *, 4>> Groups;
+  bool bHasDynamicIndex = false;
+  for (BasicBlock &BB : F) {
+    for (Instruction &I : BB) {
+      if (!OP::IsDxilOpFuncCallInst(&I, DXIL::OpCode::CreateHandle))
+        continue;
+      CallInst *CI = cast<CallInst>(&I);
+      std::vector<Value *> Key(CI->arg_operands().begin(),
+                               CI->arg_operands().end());
+      auto It = GroupIndex.emplace(Key, Groups.size()).first;
+      if (It->second == Groups.size())
+        Groups.emplace_back();
+      Groups[It->second].push_back(CI);
+      bHasDynamicIndex |= !isa<Constant>(
+          CI->getArgOperand(DXIL::OperandIndex::kCreateHandleResIndexOpIdx));
+    }
+  }
+  if (Groups.empty())
+    return false;
+
+  m_pDT = &getAnalysis<DominatorTreeWrapperPass>().getDomTree();
+  m_pLI = &getAnalysis<LoopInfoWrapperPass>().getLoopInfo();
+  m_pUniformity.reset();
+  if (bHasDynamicIndex) {
+    m_pUniformity.reset(UniformityAnalysis::create());
+    m_pUniformity->Analyze(&F);
+  }
+
+  bool bChanged = false;
+  for (SmallVectorImpl<CallInst *> &Handles : Groups) {
+    if (MayHoist(Handles.front()))
+      bChanged |= Hoist(Handles);
+    else
+      bChanged |= MergeDominated(Handles);
+  }
+  return bChanged;
+}
+
+bool DxilHoistHandles::MayHoist(CallInst *Handle) {
+  ConstantInt *NonUniform = dyn_cast<ConstantInt>(
+      Handle->getArgOperand(DXIL::OperandIndex::kCreateHandleIsUniformOpIdx));
+  if (!NonUniform || !NonUniform->isZero())
+    return false;
+  Value *Index =
+      Handle->getArgOperand(DXIL::OperandIndex::kCreateHandleResIndexOpIdx);
+  return isa<Constant>(Index) || m_pUniformity->IsUniform(Index);
+}
+
+// Returns where one call can replace all of Handles: before the first of them
+// in their nearest common dominator, or at its end when none are there.
+Instruction *DxilHoistHandles::FindInsertPoint(ArrayRef<CallInst *> Handles) {
+  BasicBlock *BB = Handles.front()->getParent();
+  for (CallInst *Handle : Handles.slice(1))
+    BB = m_pDT->findNearestCommonDominator(BB, Handle->getParent());
+
+  // The operands dominate every call, so they dominate BB too; they only keep
+  // the call in a loop they are defined in.
+  CallInst *Handle = Handles.front();
+  for (Loop *L = m_pLI->getLoopFor(BB); L; L = L->getParentLoop()) {
+    BasicBlock *Preheader = L->getLoopPreheader();
+    if (!Preheader)
+      break;
+    bool bInvariant = true;
+    for (Value *Op : Handle->arg_operands()) {
+      Instruction *OpI = dyn_cast<Instruction>(Op);
+      bInvariant &= !OpI || !L->contains(OpI);
+    }
+    if (!bInvariant)
+      break;
+    BB = Preheader;
+  }
+
+  for (Instruction &I : *BB) {
+    if (std::find(Handles.begin(), Handles.end(), &I) != Handles.end())
+      return &I;
+  }
+  return BB->getTerminator();
+}
+
+bool DxilHoistHandles::Hoist(ArrayRef<CallInst *> Handles) {
+  Instruction *InsertPt = FindInsertPoint(Handles);
+  CallInst *Leader = Handles.front();
+  if (CallInst *CI = dyn_cast<CallInst>(InsertPt))
+    Leader = CI;
+  bool bChanged = false;
+  if (Leader != InsertPt) {
+    Leader->moveBefore(InsertPt);
+    bChanged = true;
+  }
+  for (CallInst *Handle : Handles) {
+    if (Handle == Leader)
+      continue;
+    Handle->replaceAllUsesWith(Leader);
+    Handle->eraseFromParent();
+    bChanged = true;
+  }
+  return bChanged;
+}
+
+bool DxilHoistHandles::MergeDominated(ArrayRef<CallInst *> Handles) {
+  bool bChanged = false;
+  SmallVector<CallInst *, 4> Kept;
+  for (CallInst *Handle : Handles) {
+    CallInst *Dominator = nullptr;
+    for (CallInst *K : Kept) {
+      if (m_pDT->dominates(K, Handle)) {
+        Dominator = K;
+        break;
+      }
+    }
+    if (!Dominator) {
+      Kept.push_back(Handle);
+      continue;
+    }
+    Handle->replaceAllUsesWith(Dominator);
+    Handle->eraseFromParent();
+    bChanged = true;
+  }
+  return bChanged;
+}
+
+FunctionPass *llvm::createDxilHoistHandlesPass() {
+  return new DxilHoistHandles();
+}
+
+INITIALIZE_PASS_BEGIN(DxilHoistHandles, "hlsl-dxil-hoist-handles",
+                      "DXIL hoist handles", false, false)
+INITIALIZE_PASS_DEPENDENCY(DominatorTreeWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(LoopInfoWrapperPass)
+INITIALIZE_PASS_END(DxilHoistHandles, "hlsl-dxil-hoist-handles",
+                    "DXIL hoist handles", false, false)
@@ -0,0 +1,204 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilHoistInvariantReads.cpp                                               //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Hoists loop-invariant samples, loads and cbuffer reads out of loops.      //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/HLSL/DxilGenerationPass.h"
+#include "dxc/HLSL/DxilConstants.h"
+#include "dxc/HLSL/DxilOperations.h"
+#include "DxilTargetTransformInfo.h"
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Pass.h"
+
+#include <memory>
+
+using namespace llvm;
+using namespace hlsl;
+
+///////////////////////////////////////////////////////////////////////////////
+// Hoist invariant reads.
+
+namespace {
+// Resource reads are readonly calls, which LICM only hoists out of loops
+// that write no memory at all. SRVs and cbuffers can't be written by the
+// shader, though, so their reads with loop-invariant operands give the same
+// result on every iteration of any loop. UAV reads are hoisted only out of
+// loops that write no memory.
+//
+// Reads are hoisted to the preheader from blocks that run on every
+// iteration, so a loop that is entered runs them at least once either way.
+// createHandle calls and extractvalues of hoisted reads move with them.
+//
+// Samples with implicit derivatives need the lanes of a quad to run them
+// together, so they are only hoisted out of loops where every branch is the
+// same for the whole wave, as ValidateGradientOps requires of them. The
+// preheader runs with the same lanes as the first iteration of such a loop.
+class DxilHoistInvariantReads : public FunctionPass {
+public:
+  static char ID; // Pass identification, replacement for typeid
+  explicit DxilHoistInvariantReads() : FunctionPass(ID) {}
+
+  const char *getPassName() const override {
+    return "DXIL hoist loop-invariant reads";
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.addRequired<DominatorTreeWrapperPass>();
+    AU.addRequired<LoopInfoWrapperPass>();
+    AU.setPreservesCFG();
+  }
+
+  bool runOnFunction(Function &F) override;
+
+private:
+  bool HoistFromLoop(Loop *L);
+  bool IsUniformLoop(Loop *L);
+
+  DominatorTree *m_pDT;
+  Function *m_pF;
+  std::unique_ptr<UniformityAnalysis> m_pUniformity;
+};
+
+char DxilHoistInvariantReads::ID = 0;
+
+bool HasImplicitDerivatives(DXIL::OpCode opcode) {
+  return opcode == DXIL::OpCode::Sample ||
+         opcode == DXIL::OpCode::SampleBias ||
+         opcode == DXIL::OpCode::SampleCmp;
+}
+
+// Whether reads through Handle may see memory the shader writes.
+bool IsWritable(Value *Handle) {
+  Instruction *I = dyn_cast<Instruction>(Handle);
+  if (!I || !OP::IsDxilOpFuncCallInst(I, DXIL::OpCode::CreateHandle))
+    return true;
+  ConstantInt *Class = dyn_cast<ConstantInt>(cast<CallInst>(I)->getArgOperand(
+      DXIL::OperandIndex::kCreateHandleResClassOpIdx));
+  return !Class ||
+         Class->getZExtValue() == (uint64_t)DXIL::ResourceClass::UAV;
+}
+}
+
+bool DxilHoistInvariantReads::runOnFunction(Function &F) {
+  LoopInfo &LI = getAnalysis<LoopInfoWrapperPass>().getLoopInfo();
+  if (LI.empty())
+    return false;
+  m_pDT = &getAnalysis<DominatorTreeWrapperPass>().getDomTree();
+  m_pF = &F;
+  m_pUniformity.reset();
+
+  // Inner loops first, so that reads can move out one loop at a time.
+  SmallVector<Loop *, 8> Loops(LI.begin(), LI.end());
+  for (unsigned i = 0; i < Loops.size(); ++i)
+    Loops.append(Loops[i]->begin(), Loops[i]->end());
+  bool bChanged = false;
+  for (auto It = Loops.rbegin(), E = Loops.rend(); It != E; ++It)
+    bChanged |= HoistFromLoop(*It);
+  return bChanged;
+}
+
+bool DxilHoistInvariantReads::IsUniformLoop(Loop *L) {
+  if (!m_pUniformity) {
+    m_pUniformity.reset(UniformityAnalysis::create());
+    m_pUniformity->Analyze(m_pF);
+  }
+  for (BasicBlock *BB : L->blocks()) {
+    if (!m_pUniformity->IsUniform(BB->getTerminator()))
+      return false;
+  }
+  return true;
+}
+
+bool DxilHoistInvariantReads::HoistFromLoop(Loop *L) {
+  BasicBlock *Preheader = L->getLoopPreheader();
+  if (!Preheader)
+    return false;
+
+  SmallVector<BasicBlock *, 4> Exiting;
+  L->getExitingBlocks(Exiting);
+  bool bWritesMemory = false;
+  for (BasicBlock *BB : L->blocks()) {
+    for (Instruction &I : *BB)
+      bWritesMemory |= I.mayWriteToMemory();
+  }
+  // Computed when a sample needs it.
+  enum { Unknown, Uniform, Divergent } LoopUniformity = Unknown;
+
+  auto MayHoist = [&](Instruction *I) {
+    if (!L->hasLoopInvariantOperands(I))
+      return false;
+    if (isa<ExtractValueInst>(I))
+      return true;
+    if (!OP::IsDxilOpFuncCallInst(I))
+      return false;
+    DXIL::OpCode opcode = OP::GetDxilOpFuncCallInst(I);
+    switch (opcode) {
+    case DXIL::OpCode::CreateHandle:
+    case DXIL::OpCode::CBufferLoad:
+    case DXIL::OpCode::CBufferLoadLegacy:
+      return true;
+    default:
+      break;
+    }
+    if (!DxilTTIImpl::isResourceRead(opcode))
+      return false;
+    // Every read takes its resource handle first, as samples do.
+    if (bWritesMemory &&
+        IsWritable(cast<CallInst>(I)->getArgOperand(
+            DXIL::OperandIndex::kTextureSampleTexHandleOpIdx)))
+      return false;
+    if (HasImplicitDerivatives(opcode)) {
+      if (LoopUniformity == Unknown)
+        LoopUniformity = IsUniformLoop(L) ? Uniform : Divergent;
+      return LoopUniformity == Uniform;
+    }
+    return true;
+  };
+
+  Instruction *InsertPt = Preheader->getTerminator();
+  bool bChanged = false;
+  bool bHoisted;
+  do {
+    bHoisted = false;
+    for (BasicBlock *BB : L->blocks()) {
+      bool bEveryIteration = true;
+      for (BasicBlock *ExitingBB : Exiting)
+        bEveryIteration &= m_pDT->dominates(BB, ExitingBB);
+      if (!bEveryIteration)
+        continue;
+      for (auto It = BB->begin(), E = BB->end(); It != E;) {
+        Instruction *I = &*(It++);
+        if (!MayHoist(I))
+          continue;
+        I->moveBefore(InsertPt);
+        bHoisted = true;
+      }
+    }
+    bChanged |= bHoisted;
+  } while (bHoisted);
+  return bChanged;
+}
+
+FunctionPass *llvm::createDxilHoistInvariantReadsPass() {
+  return new DxilHoistInvariantReads();
+}
+
+INITIALIZE_PASS_BEGIN(DxilHoistInvariantReads,
+                      "hlsl-dxil-hoist-invariant-reads",
+                      "DXIL hoist loop-invariant reads", false, false)
+INITIALIZE_PASS_DEPENDENCY(DominatorTreeWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(LoopInfoWrapperPass)
+INITIALIZE_PASS_END(DxilHoistInvariantReads,
+                    "hlsl-dxil-hoist-invariant-reads",
+                    "DXIL hoist loop-invariant reads", false, false)
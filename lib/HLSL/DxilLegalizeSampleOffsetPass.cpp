@@ -15,6 +15,8 @@
 
 #include "llvm/Analysis/InstructionSimplify.h"
 #include "llvm/Analysis/LoopInfo.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/Dominators.h"
 #include "llvm/IR/Instructions.h"
@@ -23,6 +25,8 @@
 #include "llvm/IR/PassManager.h"
 #include "llvm/Pass.h"
 #include "llvm/Transforms/Scalar.h"
+#include "llvm/Transforms/Utils/Local.h"
+#include "llvm/Transforms/Utils/PromoteMemToReg.h"
 
 #include <unordered_set>
 
@@ -57,8 +61,14 @@ public:
     if (illegalOffsets.empty())
       return false;
 
+    SmallPtrSet<Instruction *, 8> oldPhis;
+    for (BasicBlock &BB : F)
+      for (Instruction &I : BB)
+        if (isa<PHINode>(I))
+          oldPhis.insert(&I);
+
     // Loop unroll if has offset inside loop.
-    TryUnrollLoop(illegalOffsets, F);
+    bool bUnroll = TryUnrollLoop(illegalOffsets, F);
 
     // Collect offset again after mem2reg.
     std::vector<Instruction *> ssaIllegalOffsets;
@@ -68,9 +78,13 @@ public:
     LegalizeOffsets(ssaIllegalOffsets);
 
     // Remove PHINodes to keep code shape.
-    legacy::FunctionPassManager PM(F.getParent());
-    PM.add(createDemoteRegisterToMemoryHlslPass());
-    PM.run(F);
+    if (bUnroll) {
+      legacy::FunctionPassManager PM(F.getParent());
+      PM.add(createDemoteRegisterToMemoryHlslPass());
+      PM.run(F);
+    } else {
+      DemoteNewPhis(oldPhis, F);
+    }
 
     FinalCheck(illegalOffsets, F, hlslOP);
 
@@ -78,7 +92,11 @@ public:
   }
 
 private:
-  void TryUnrollLoop(std::vector<Instruction *> &illegalOffsets, Function &F);
+  void CollectOffsetLoops(std::vector<Instruction *> &illegalOffsets,
+                          LoopInfo &LI, SmallPtrSetImpl<Loop *> &offsetLoops);
+  bool TryUnrollLoop(std::vector<Instruction *> &illegalOffsets, Function &F);
+  void DemoteNewPhis(const SmallPtrSetImpl<Instruction *> &oldPhis,
+                     Function &F);
   void CollectIllegalOffsets(std::vector<Instruction *> &illegalOffsets,
                              Function &F, hlsl::OP *hlslOP);
   void CollectIllegalOffsets(std::vector<Instruction *> &illegalOffsets,
@@ -91,25 +109,6 @@ private:
 
 char DxilLegalizeSampleOffsetPass::ID = 0;
 
-bool HasIllegalOffsetInLoop(std::vector<Instruction *> &illegalOffsets,
-                            Function &F) {
-  DominatorTreeAnalysis DTA;
-  DominatorTree DT = DTA.run(F);
-  LoopInfo LI;
-  LI.Analyze(DT);
-
-  bool findOffset = false;
-
-  for (Instruction *I : illegalOffsets) {
-    BasicBlock *BB = I->getParent();
-    if (LI.getLoopFor(BB)) {
-      findOffset = true;
-      break;
-    }
-  }
-  return findOffset;
-}
-
 void CollectIllegalOffset(CallInst *CI,
                           std::vector<Instruction *> &illegalOffsets) {
   Value *offset0 =
@@ -127,6 +126,20 @@ void CollectIllegalOffset(CallInst *CI,
 }
 }
 
+void DxilLegalizeSampleOffsetPass::CollectOffsetLoops(
+    std::vector<Instruction *> &illegalOffsets, LoopInfo &LI,
+    SmallPtrSetImpl<Loop *> &offsetLoops) {
+  for (Instruction *I : illegalOffsets) {
+    Loop *L = LI.getLoopFor(I->getParent());
+    if (!L)
+      continue;
+    // The whole nest has to be unrolled to make the offset immediate.
+    while (Loop *Parent = L->getParentLoop())
+      L = Parent;
+    offsetLoops.insert(L);
+  }
+}
+
 void DxilLegalizeSampleOffsetPass::FinalCheck(
     std::vector<Instruction *> &illegalOffsets, Function &F, hlsl::OP *hlslOP) {
   // Collect offset to make sure no illegal offsets.
@@ -150,20 +163,166 @@ void DxilLegalizeSampleOffsetPass::FinalCheck(
   }
 }
 
-void DxilLegalizeSampleOffsetPass::TryUnrollLoop(
+namespace {
+// Names the unroll(disable) entries added to keep the unroller away from
+// loops without illegal offsets, so they can be told apart from pragmas.
+const char kOffsetUnrollDisabledMDName[] = "dx.sampleoffset.unroll.disabled";
+
+MDNode *GetOffsetUnrollDisabledMarker(LLVMContext &Ctx) {
+  return MDNode::get(Ctx, MDString::get(Ctx, kOffsetUnrollDisabledMDName));
+}
+
+// Returns a new self-referential loop ID with the given operands.
+MDNode *CreateLoopID(LLVMContext &Ctx, ArrayRef<Metadata *> Ops) {
+  SmallVector<Metadata *, 4> MDs;
+  // Reserve first location for self reference to the LoopID metadata node.
+  MDs.push_back(nullptr);
+  MDs.append(Ops.begin(), Ops.end());
+  MDNode *LoopID = MDNode::get(Ctx, MDs);
+  LoopID->replaceOperandWith(0, LoopID);
+  return LoopID;
+}
+
+void DisableUnrollForNest(Loop *L, LLVMContext &Ctx) {
+  SmallVector<Loop *, 8> Nest(1, L);
+  while (!Nest.empty()) {
+    Loop *Cur = Nest.pop_back_val();
+    Nest.append(Cur->begin(), Cur->end());
+
+    SmallVector<Metadata *, 4> Ops;
+    if (MDNode *LoopID = Cur->getLoopID()) {
+      for (unsigned i = 1; i < LoopID->getNumOperands(); i++)
+        Ops.push_back(LoopID->getOperand(i));
+    }
+    // Ahead of any unroll pragma the loop already has.
+    Ops.insert(Ops.begin(), GetOffsetUnrollDisabledMarker(Ctx));
+    Ops.insert(Ops.begin(), MDNode::get(Ctx, MDString::get(Ctx, "llvm.loop.unroll.disable")));
+    Cur->setLoopID(CreateLoopID(Ctx, Ops));
+  }
+}
+
+// Restores the loop IDs changed by DisableUnrollForNest.
+void RestoreUnroll(Function &F) {
+  LLVMContext &Ctx = F.getContext();
+  MDNode *Marker = GetOffsetUnrollDisabledMarker(Ctx);
+  unsigned LoopMDKind = Ctx.getMDKindID("llvm.loop");
+  DenseMap<MDNode *, MDNode *> Restored;
+  for (BasicBlock &BB : F) {
+    TerminatorInst *TI = BB.getTerminator();
+    MDNode *LoopID = TI->getMetadata(LoopMDKind);
+    if (!LoopID || LoopID->getNumOperands() < 3 ||
+        LoopID->getOperand(2) != Marker)
+      continue;
+    auto it = Restored.find(LoopID);
+    if (it == Restored.end()) {
+      MDNode *Original = nullptr;
+      if (LoopID->getNumOperands() > 3) {
+        SmallVector<Metadata *, 4> Ops;
+        for (unsigned i = 3; i < LoopID->getNumOperands(); i++)
+          Ops.push_back(LoopID->getOperand(i));
+        Original = CreateLoopID(Ctx, Ops);
+      }
+      it = Restored.insert(std::make_pair(LoopID, Original)).first;
+    }
+    TI->setMetadata(LoopMDKind, it->second);
+  }
+}
+
+// Collects the promotable allocas the offsets are computed from.
+void CollectOffsetAllocas(const std::vector<Instruction *> &illegalOffsets,
+                          std::vector<AllocaInst *> &allocas) {
+  SmallPtrSet<Value *, 16> visited;
+  SmallVector<Value *, 16> worklist(illegalOffsets.begin(),
+                                    illegalOffsets.end());
+  while (!worklist.empty()) {
+    Value *V = worklist.pop_back_val();
+    if (!visited.insert(V).second)
+      continue;
+    if (LoadInst *LI = dyn_cast<LoadInst>(V)) {
+      AllocaInst *AI = dyn_cast<AllocaInst>(LI->getPointerOperand());
+      if (!AI || !isAllocaPromotable(AI) || !visited.insert(AI).second)
+        continue;
+      allocas.emplace_back(AI);
+      // The offset is also computed from every value stored to it.
+      for (User *U : AI->users())
+        if (StoreInst *SI = dyn_cast<StoreInst>(U))
+          worklist.emplace_back(SI->getValueOperand());
+    } else if (Instruction *I = dyn_cast<Instruction>(V)) {
+      for (Value *Op : I->operands())
+        worklist.emplace_back(Op);
+    }
+  }
+}
+} // namespace
+
+bool DxilLegalizeSampleOffsetPass::TryUnrollLoop(
     std::vector<Instruction *> &illegalOffsets, Function &F) {
+  bool bUnroll = false;
+  {
+    // Reuse the dominator tree if an earlier pass left one; only functions
+    // with illegal offsets get here, so it is not worth requiring.
+    std::unique_ptr<DominatorTree> LocalDT;
+    DominatorTree *DT = nullptr;
+    if (DominatorTreeWrapperPass *DTWP =
+            getAnalysisIfAvailable<DominatorTreeWrapperPass>()) {
+      DT = &DTWP->getDomTree();
+    } else {
+      LocalDT = llvm::make_unique<DominatorTree>();
+      LocalDT->recalculate(F);
+      DT = LocalDT.get();
+    }
+    LoopInfo LI;
+    LI.Analyze(*DT);
+
+    SmallPtrSet<Loop *, 4> offsetLoops;
+    CollectOffsetLoops(illegalOffsets, LI, offsetLoops);
+    if (!offsetLoops.empty()) {
+      // Only unroll the loop nests the illegal offsets are in.
+      for (Loop *L : LI) {
+        if (!offsetLoops.count(L))
+          DisableUnrollForNest(L, F.getContext());
+      }
+      bUnroll = true;
+    } else {
+      // Nothing to unroll, so only the allocas the offsets are computed from
+      // are promoted; the rest of the function keeps its unoptimized shape.
+      std::vector<AllocaInst *> allocas;
+      CollectOffsetAllocas(illegalOffsets, allocas);
+      if (!allocas.empty())
+        PromoteMemToReg(allocas, *DT);
+    }
+  }
+
+  if (!bUnroll)
+    return false;
+
+  // The unroller needs the whole function in SSA form.
   legacy::FunctionPassManager PM(F.getParent());
-  // Always need mem2reg for simplify illegal offsets.
   PM.add(createPromoteMemoryToRegisterPass());
-
-  if (HasIllegalOffsetInLoop(illegalOffsets, F)) {
-    PM.add(createCFGSimplificationPass());
-    PM.add(createLCSSAPass());
-    PM.add(createLoopSimplifyPass());
-    PM.add(createLoopRotatePass());
-    PM.add(createLoopUnrollPass(-2, -1, 0, 0));
-  }
+  PM.add(createCFGSimplificationPass());
+  PM.add(createLCSSAPass());
+  PM.add(createLoopSimplifyPass());
+  PM.add(createLoopRotatePass());
+  PM.add(createLoopUnrollPass(-2, -1, 0, 0));
   PM.run(F);
+
+  RestoreUnroll(F);
+  return true;
+}
+
+void DxilLegalizeSampleOffsetPass::DemoteNewPhis(
+    const SmallPtrSetImpl<Instruction *> &oldPhis, Function &F) {
+  // Only the PHIs made by promoting the offset allocas are demoted; without
+  // loop passes there is no LCSSA form to preserve.
+  std::vector<PHINode *> newPhis;
+  for (BasicBlock &BB : F)
+    for (Instruction &I : BB)
+      if (isa<PHINode>(I) && !oldPhis.count(&I))
+        newPhis.emplace_back(cast<PHINode>(&I));
+
+  Instruction *AllocaPoint = F.getEntryBlock().begin();
+  for (PHINode *P : newPhis)
+    DemotePHIToStack(P, AllocaPoint);
 }
 
 void DxilLegalizeSampleOffsetPass::CollectIllegalOffsets(
@@ -10,19 +10,23 @@
 #include "dxc/HLSL/DxilLinker.h"
 #include "dxc/HLSL/DxilCBuffer.h"
 #include "dxc/HLSL/DxilFunctionProps.h"
+#include "dxc/HLSL/DxilInstructions.h"
 #include "dxc/HLSL/DxilModule.h"
 #include "dxc/HLSL/DxilOperations.h"
 #include "dxc/HLSL/DxilResource.h"
 #include "dxc/HLSL/DxilSampler.h"
 #include "dxc/Support/Global.h"
 #include "llvm/ADT/StringSet.h"
-#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/MapVector.h"
+#include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Transforms/Utils/Cloning.h"
 #include "llvm/ADT/StringMap.h"
+#include <algorithm>
 #include <memory>
 #include <vector>
 
@@ -34,21 +38,28 @@
 #include "llvm/IR/LegacyPassManager.h"
 #include "llvm/Transforms/IPO.h"
 #include "llvm/Transforms/Scalar.h"
+#include "llvm/Support/raw_ostream.h"
 
 using namespace llvm;
 using namespace hlsl;
 
 namespace {
 
-void CollectUsedFunctions(Constant *C,
-                          std::unordered_set<Function *> &funcSet) {
-  for (User *U : C->users()) {
-    if (Instruction *I = dyn_cast<Instruction>(U)) {
-      funcSet.insert(I->getParent()->getParent());
-    } else {
-      Constant *CU = cast<Constant>(U);
-      CollectUsedFunctions(CU, funcSet);
-    }
+void CollectUsedGlobals(Constant *C, SetVector<GlobalVariable *> &globals,
+                        SmallPtrSetImpl<Constant *> &visited) {
+  if (!visited.insert(C).second)
+    return;
+  if (GlobalVariable *GV = dyn_cast<GlobalVariable>(C)) {
+    globals.insert(GV);
+    if (GV->hasInitializer())
+      CollectUsedGlobals(GV->getInitializer(), globals, visited);
+    return;
+  }
+  if (isa<GlobalValue>(C))
+    return;
+  for (Use &U : C->operands()) {
+    if (Constant *CU = dyn_cast<Constant>(U.get()))
+      CollectUsedGlobals(CU, globals, visited);
   }
 }
 
@@ -87,16 +98,25 @@ namespace {
 struct DxilFunctionLinkInfo {
   DxilFunctionLinkInfo(llvm::Function *F);
   llvm::Function *func;
-  std::unordered_set<llvm::Function *> usedFunctions;
-  std::unordered_set<llvm::GlobalVariable *> usedGVs;
-  std::unordered_set<DxilResourceBase *> usedResources;
+  // Ordered sets, so that what they pull into a link is added in the same
+  // order on every run.
+  llvm::SetVector<llvm::Function *> usedFunctions;
+  llvm::SetVector<llvm::GlobalVariable *> usedGVs;
+  llvm::SetVector<DxilResourceBase *> usedResources;
+  // Set once the sets above are built; the library is not changed by
+  // linking, so they stay valid across links.
+  bool bLoaded;
+  // Set if the sets above came from the library's link index, so the body
+  // is only materialized when the function is cloned.
+  bool bIndexed;
 };
 
 // Library to link.
 class DxilLib {
 
 public:
-  DxilLib(std::unique_ptr<llvm::Module> pModule);
+  DxilLib(std::unique_ptr<llvm::Module> pModule, const void *pLinkIndex,
+          uint32_t linkIndexSize);
   virtual ~DxilLib() {}
   bool HasFunction(std::string &name);
   llvm::StringMap<std::unique_ptr<DxilFunctionLinkInfo>> &GetFunctionTable() {
@@ -113,6 +133,16 @@ public:
                                 SmallVector<StringRef, 4> &workList);
 
 private:
+  struct IndexedFunction {
+    Function *F;
+    std::vector<Function *> usedFunctions;
+    std::vector<GlobalVariable *> usedGVs;
+  };
+  // Resolves the names in a DFCC_LinkIndex part against the module. Returns
+  // false, and nothing, if the part is malformed.
+  bool ReadLinkIndex(const void *pLinkIndex, uint32_t linkIndexSize,
+                     std::vector<IndexedFunction> &functions);
+
   std::unique_ptr<llvm::Module> m_pModule;
   DxilModule &m_DM;
   // Map from name to Link info for extern functions.
@@ -120,7 +150,9 @@ private:
   // Map from resource link global to resource.
   std::unordered_map<const llvm::Constant *, DxilResourceBase *> m_resourceMap;
   // Set of initialize functions for global variable.
-  std::unordered_set<llvm::Function *> m_initFuncSet;
+  llvm::SetVector<llvm::Function *> m_initFuncSet;
+  // Set once the init functions and resource map are collected.
+  bool m_bGlobalUsageBuilt;
 };
 
 struct DxilLinkJob;
@@ -131,7 +163,8 @@ public:
   virtual ~DxilLinkerImpl() {}
   bool HasLibNameRegistered(StringRef name) override;
   bool RegisterLib(StringRef name, std::unique_ptr<llvm::Module> pModule,
-                   std::unique_ptr<llvm::Module> pDebugModule) override;
+                   std::unique_ptr<llvm::Module> pDebugModule,
+                   const void *pLinkIndex, uint32_t linkIndexSize) override;
   bool AttachLib(StringRef name) override;
   bool DetachLib(StringRef name) override;
   void DetachAll() override;
@@ -143,8 +176,8 @@ private:
   bool AttachLib(DxilLib *lib);
   bool DetachLib(DxilLib *lib);
   bool AddFunctions(SmallVector<StringRef, 4> &workList,
-                    DenseSet<DxilLib *> &libSet, StringSet<> &addedFunctionSet,
-                    DxilLinkJob &linkJob, bool bLazyLoadDone);
+                    SetVector<DxilLib *> &libSet, StringSet<> &addedFunctionSet,
+                    DxilLinkJob &linkJob);
   // Attached libs to link.
   std::unordered_set<DxilLib *> m_attachedLibs;
   // Owner of all DxilLib.
@@ -159,7 +192,8 @@ private:
 //
 // DxilFunctionLinkInfo methods.
 //
-DxilFunctionLinkInfo::DxilFunctionLinkInfo(Function *F) : func(F) {
+DxilFunctionLinkInfo::DxilFunctionLinkInfo(Function *F)
+    : func(F), bLoaded(false), bIndexed(false) {
   DXASSERT_NOMSG(F);
 }
 
@@ -168,11 +202,19 @@ DxilFunctionLinkInfo::DxilFunctionLinkInfo(Function *F) : func(F) {
 // DxilLib methods.
 //
 
-DxilLib::DxilLib(std::unique_ptr<llvm::Module> pModule)
-    : m_pModule(std::move(pModule)), m_DM(m_pModule->GetOrCreateDxilModule()) {
+DxilLib::DxilLib(std::unique_ptr<llvm::Module> pModule,
+                 const void *pLinkIndex, uint32_t linkIndexSize)
+    : m_pModule(std::move(pModule)), m_DM(m_pModule->GetOrCreateDxilModule()),
+      m_bGlobalUsageBuilt(false) {
   Module &M = *m_pModule;
   const std::string &MID = M.getModuleIdentifier();
 
+  // The index names functions and globals before internal ones are renamed.
+  std::vector<IndexedFunction> indexedFunctions;
+  if (pLinkIndex &&
+      !ReadLinkIndex(pLinkIndex, linkIndexSize, indexedFunctions))
+    indexedFunctions.clear();
+
   // Collect function defines.
   for (Function &F : M.functions()) {
     if (F.isDeclaration())
@@ -192,21 +234,101 @@ DxilLib::DxilLib(std::unique_ptr<llvm::Module> pModule)
       GV.setName(MID + GV.getName());
     }
   }
+
+  for (IndexedFunction &indexed : indexedFunctions) {
+    DxilFunctionLinkInfo *linkInfo =
+        m_functionNameMap[indexed.F->getName()].get();
+    linkInfo->usedFunctions.insert(indexed.usedFunctions.begin(),
+                                   indexed.usedFunctions.end());
+    linkInfo->usedGVs.insert(indexed.usedGVs.begin(), indexed.usedGVs.end());
+    linkInfo->bIndexed = true;
+  }
+}
+
+bool DxilLib::ReadLinkIndex(const void *pLinkIndex, uint32_t linkIndexSize,
+                            std::vector<IndexedFunction> &functions) {
+  Module &M = *m_pModule;
+  const uint8_t *pData = (const uint8_t *)pLinkIndex;
+  if (linkIndexSize < sizeof(DxilLinkIndexHeader))
+    return false;
+  const DxilLinkIndexHeader *pHeader = (const DxilLinkIndexHeader *)pData;
+  uint64_t functionsSize =
+      (uint64_t)pHeader->FunctionCount * sizeof(DxilLinkIndexFunction);
+  uint64_t refsSize = (uint64_t)pHeader->RefCount * sizeof(uint32_t);
+  if (sizeof(DxilLinkIndexHeader) + functionsSize + refsSize +
+          pHeader->StringTableSize > linkIndexSize)
+    return false;
+  const DxilLinkIndexFunction *pFunctions =
+      (const DxilLinkIndexFunction *)(pHeader + 1);
+  const uint32_t *pRefs = (const uint32_t *)(pFunctions +
+                                             pHeader->FunctionCount);
+  const char *pStrings = (const char *)(pRefs + pHeader->RefCount);
+  StringRef strings(pStrings, pHeader->StringTableSize);
+  auto getName = [&](uint32_t offset, StringRef &name) -> bool {
+    if (offset >= strings.size())
+      return false;
+    size_t end = strings.find('\0', offset);
+    if (end == StringRef::npos)
+      return false;
+    name = strings.slice(offset, end);
+    return true;
+  };
+  auto inRefs = [&](uint32_t first, uint32_t count) -> bool {
+    return (uint64_t)first + count <= pHeader->RefCount;
+  };
+
+  for (uint32_t i = 0; i < pHeader->FunctionCount; ++i) {
+    const DxilLinkIndexFunction &record = pFunctions[i];
+    StringRef name;
+    if (!getName(record.Name, name) ||
+        !inRefs(record.FirstCallee, record.CalleeCount) ||
+        !inRefs(record.FirstGlobal, record.GlobalCount))
+      return false;
+    IndexedFunction indexed;
+    indexed.F = M.getFunction(name);
+    // A function the module doesn't define is loaded and scanned instead.
+    if (!indexed.F || indexed.F->isDeclaration())
+      continue;
+    for (uint32_t j = 0; j < record.CalleeCount; ++j) {
+      if (!getName(pRefs[record.FirstCallee + j], name))
+        return false;
+      // Declarations stripped from the module along with debug info have no
+      // calls left to them.
+      if (Function *callee = M.getFunction(name))
+        indexed.usedFunctions.emplace_back(callee);
+    }
+    for (uint32_t j = 0; j < record.GlobalCount; ++j) {
+      if (!getName(pRefs[record.FirstGlobal + j], name))
+        return false;
+      GlobalVariable *GV = M.getGlobalVariable(name, /*AllowInternal*/ true);
+      if (!GV)
+        return false;
+      indexed.usedGVs.emplace_back(GV);
+    }
+    functions.emplace_back(std::move(indexed));
+  }
+  return true;
 }
 
 void DxilLib::LazyLoadFunction(Function *F) {
   DXASSERT(m_functionNameMap.count(F->getName()), "else invalid Function");
   DxilFunctionLinkInfo *linkInfo = m_functionNameMap[F->getName()].get();
-  std::error_code EC = F->materialize();
-  DXASSERT_LOCALVAR(EC, !EC, "else fail to materialize");
-
-  // Build used functions for F.
-  for (auto &BB : F->getBasicBlockList()) {
-    for (auto &I : BB.getInstList()) {
-      if (CallInst *CI = dyn_cast<CallInst>(&I)) {
-        linkInfo->usedFunctions.insert(CI->getCalledFunction());
-      }
-    }
+  // Functions are loaded at most once per library, however many links use
+  // them.
+  if (linkInfo->bLoaded)
+    return;
+  linkInfo->bLoaded = true;
+
+  if (!linkInfo->bIndexed) {
+    std::error_code EC = F->materialize();
+    DXASSERT_LOCALVAR(EC, !EC, "else fail to materialize");
+
+    // Build used functions and globals for F.
+    SetVector<Function *> callees;
+    SetVector<GlobalVariable *> globals;
+    CollectLinkDependencies(*F, callees, globals);
+    linkInfo->usedFunctions.insert(callees.begin(), callees.end());
+    linkInfo->usedGVs.insert(globals.begin(), globals.end());
   }
 
   if (m_DM.HasDxilFunctionProps(F)) {
@@ -217,10 +339,13 @@ void DxilLib::LazyLoadFunction(Function *F) {
       linkInfo->usedFunctions.insert(patchConstantFunc);
     }
   }
-  // Used globals will be build before link.
 }
 
 void DxilLib::BuildGlobalUsage() {
+  if (m_bGlobalUsageBuilt)
+    return;
+  m_bGlobalUsageBuilt = true;
+
   Module &M = *m_pModule;
 
   // Collect init functions for static globals.
@@ -247,16 +372,7 @@ void DxilLib::BuildGlobalUsage() {
     }
   }
 
-  // Build used globals.
-  for (GlobalVariable &GV : M.globals()) {
-    std::unordered_set<Function *> funcSet;
-    CollectUsedFunctions(&GV, funcSet);
-    for (Function *F : funcSet) {
-      DXASSERT(m_functionNameMap.count(F->getName()), "must exist in table");
-      DxilFunctionLinkInfo *linkInfo = m_functionNameMap[F->getName()].get();
-      linkInfo->usedGVs.insert(&GV);
-    }
-  }
+  // Used globals are built per function in LazyLoadFunction.
 
   // Build resource map.
   AddResourceMap(m_DM.GetUAVs(), DXIL::ResourceClass::UAV, m_resourceMap, m_DM);
@@ -274,25 +390,27 @@ void DxilLib::CollectUsedInitFunctions(StringSet<> &addedFunctionSet,
     DXASSERT(m_functionNameMap.count(Ctor->getName()),
              "must exist in internal table");
     DxilFunctionLinkInfo *linkInfo = m_functionNameMap[Ctor->getName()].get();
-    // If function other than Ctor used GV of Ctor.
-    // Add Ctor to usedFunctions for it.
-    for (GlobalVariable *GV : linkInfo->usedGVs) {
-      std::unordered_set<Function *> funcSet;
-      CollectUsedFunctions(GV, funcSet);
-      bool bAdded = false;
-      for (Function *F : funcSet) {
-        if (F == Ctor)
-          continue;
-        // If F is added for link, add init func to workList.
-        if (addedFunctionSet.count(F->getName())) {
-          workList.emplace_back(Ctor->getName());
-          bAdded = true;
+    // If a function other than Ctor added for link uses a GV of Ctor, add
+    // Ctor to the workList.
+    bool bUsed = false;
+    for (auto &added : addedFunctionSet) {
+      StringRef name = added.getKey();
+      if (name == Ctor->getName())
+        continue;
+      auto it = m_functionNameMap.find(name);
+      if (it == m_functionNameMap.end())
+        continue;
+      for (GlobalVariable *GV : linkInfo->usedGVs) {
+        if (it->second->usedGVs.count(GV)) {
+          bUsed = true;
           break;
         }
       }
-      if (bAdded)
+      if (bUsed)
         break;
     }
+    if (bUsed)
+      workList.emplace_back(Ctor->getName());
   }
 }
 
@@ -326,7 +444,9 @@ struct DxilLinkJob {
 private:
   bool AddResource(DxilResourceBase *res, llvm::GlobalVariable *GV);
   void AddResourceToDM(DxilModule &DM);
-  std::unordered_map<DxilFunctionLinkInfo *, DxilLib *> m_functionDefs;
+  // Kept in the order functions were added, which decides the order of
+  // functions and globals in the linked module.
+  llvm::MapVector<DxilFunctionLinkInfo *, DxilLib *> m_functionDefs;
   llvm::StringMap<llvm::Function *> m_dxilFunctions;
   // New created functions.
   llvm::StringMap<llvm::Function *> m_newFunctions;
@@ -546,6 +666,7 @@ DxilLinkJob::Link(std::pair<DxilFunctionLinkInfo *, DxilLib *> &entryLinkPair,
   ValueToValueMapTy vmap;
 
   std::unordered_set<Function *> initFuncSet;
+  typeSys.ReserveFunctionAnnotations(m_functionDefs.size());
   // Add function
   for (auto &it : m_functionDefs) {
     DxilFunctionLinkInfo *linkInfo = it.first;
@@ -668,6 +789,9 @@ DxilLinkJob::Link(std::pair<DxilFunctionLinkInfo *, DxilLib *> &entryLinkPair,
       }
     }
 
+    // Functions found through the link index are loaded only when cloned.
+    std::error_code EC = F->materialize();
+    DXASSERT_LOCALVAR(EC, !EC, "else fail to materialize");
     CloneFunction(F, NewF, vmap);
   }
 
@@ -721,11 +845,7 @@ void DxilLinkJob::RunPreparePass(Module &M) {
   PM.add(createCFGSimplificationPass());
 
   PM.add(createDxilCondenseResourcesPass());
-  PM.add(createDxilFinalizeModulePass());
-  PM.add(createComputeViewIdStatePass());
-  PM.add(createDxilDeadFunctionEliminationPass());
-  PM.add(createNoPausePassesPass());
-  PM.add(createDxilEmitMetadataPass());
+  PM.add(createDxilFinalizeAndEmitPass());
 
   PM.run(M);
 }
@@ -741,7 +861,9 @@ bool DxilLinkerImpl::HasLibNameRegistered(StringRef name) {
 
 bool DxilLinkerImpl::RegisterLib(StringRef name,
                                  std::unique_ptr<llvm::Module> pModule,
-                                 std::unique_ptr<llvm::Module> pDebugModule) {
+                                 std::unique_ptr<llvm::Module> pDebugModule,
+                                 const void *pLinkIndex,
+                                 uint32_t linkIndexSize) {
   if (m_LibMap.count(name))
     return false;
 
@@ -753,7 +875,7 @@ bool DxilLinkerImpl::RegisterLib(StringRef name,
 
   pM->setModuleIdentifier(name);
   std::unique_ptr<DxilLib> pLib =
-      std::make_unique<DxilLib>(std::move(pM));
+      std::make_unique<DxilLib>(std::move(pM), pLinkIndex, linkIndexSize);
   m_LibMap[name] = std::move(pLib);
   return true;
 }
@@ -843,9 +965,9 @@ bool DxilLinkerImpl::DetachLib(DxilLib *lib) {
 }
 
 bool DxilLinkerImpl::AddFunctions(SmallVector<StringRef, 4> &workList,
-                                  DenseSet<DxilLib *> &libSet,
+                                  SetVector<DxilLib *> &libSet,
                                   StringSet<> &addedFunctionSet,
-                                  DxilLinkJob &linkJob, bool bLazyLoadDone) {
+                                  DxilLinkJob &linkJob) {
   while (!workList.empty()) {
     StringRef name = workList.pop_back_val();
     // Ignore added function.
@@ -863,10 +985,7 @@ bool DxilLinkerImpl::AddFunctions(SmallVector<StringRef, 4> &workList,
 
     DxilLib *pLib = linkPair.second;
     libSet.insert(pLib);
-    if (!bLazyLoadDone) {
-      Function *F = linkPair.first->func;
-      pLib->LazyLoadFunction(F);
-    }
+    pLib->LazyLoadFunction(linkPair.first->func);
     for (Function *F : linkPair.first->usedFunctions) {
       if (hlsl::OP::IsDxilOpFunc(F)) {
         // Add dxil operations directly.
@@ -890,9 +1009,8 @@ std::unique_ptr<llvm::Module> DxilLinkerImpl::Link(StringRef entry,
 
   DxilLinkJob linkJob(m_ctx);
 
-  DenseSet<DxilLib *> libSet;
-  if (!AddFunctions(workList, libSet, addedFunctionSet, linkJob,
-                    /*bLazyLoadDone*/ false))
+  SetVector<DxilLib *> libSet;
+  if (!AddFunctions(workList, libSet, addedFunctionSet, linkJob))
     return nullptr;
 
   // Save global users.
@@ -905,10 +1023,7 @@ std::unique_ptr<llvm::Module> DxilLinkerImpl::Link(StringRef entry,
     pLib->CollectUsedInitFunctions(addedFunctionSet, workList);
   }
   // Add init functions if used.
-  // All init function already loaded in BuildGlobalUsage, so set bLazyLoad
-  // false here.
-  if (!AddFunctions(workList, libSet, addedFunctionSet, linkJob,
-                    /*bLazyLoadDone*/ true))
+  if (!AddFunctions(workList, libSet, addedFunctionSet, linkJob))
     return nullptr;
 
   std::pair<DxilFunctionLinkInfo *, DxilLib *> &entryLinkPair =
@@ -919,6 +1034,111 @@ std::unique_ptr<llvm::Module> DxilLinkerImpl::Link(StringRef entry,
 
 namespace hlsl {
 
+void CollectLinkDependencies(Function &F, SetVector<Function *> &callees,
+                             SetVector<GlobalVariable *> &globals) {
+  SmallPtrSet<Constant *, 16> visited;
+  for (auto &BB : F.getBasicBlockList()) {
+    for (auto &I : BB.getInstList()) {
+      if (CallInst *CI = dyn_cast<CallInst>(&I)) {
+        if (Function *callee = CI->getCalledFunction())
+          callees.insert(callee);
+      }
+      for (Use &U : I.operands()) {
+        if (Constant *C = dyn_cast<Constant>(U.get()))
+          CollectUsedGlobals(C, globals, visited);
+      }
+    }
+  }
+}
+
+// Returns the cbuffer ID a handle refers to, or -1 if it is not known.
+static int GetCBufferHandleID(Value *handle) {
+  Instruction *I = dyn_cast<Instruction>(handle);
+  if (!I)
+    return -1;
+  DxilInst_CreateHandle CH(I);
+  if (!CH || !isa<ConstantInt>(CH.get_resourceClass()) ||
+      CH.get_resourceClass_val() != (int8_t)DXIL::ResourceClass::CBuffer)
+    return -1;
+  ConstantInt *rangeID = dyn_cast<ConstantInt>(CH.get_rangeId());
+  return rangeID ? (int)rangeID->getZExtValue() : -1;
+}
+
+template <typename T>
+static void WriteResourceRemapLines(
+    const std::vector<std::unique_ptr<T>> &resTab,
+    const std::vector<unsigned> *pUsedSizes, raw_ostream &OS) {
+  for (auto &Res : resTab) {
+    OS << Res->GetResClassName() << '\t' << Res->GetGlobalName() << '\t'
+       << Res->GetID() << '\t' << Res->GetSpaceID() << '\t'
+       << Res->GetLowerBound() << '\t';
+    if (Res->IsUnbounded())
+      OS << "unbounded";
+    else
+      OS << Res->GetRangeSize();
+    OS << '\t';
+    if (pUsedSizes)
+      OS << (*pUsedSizes)[Res->GetID()];
+    else
+      OS << '-';
+    OS << '\n';
+  }
+}
+
+void WriteLinkResourceRemap(DxilModule &DM, raw_ostream &OS) {
+  // Bytes of each cbuffer read by constant offsets; a cbuffer read at an
+  // offset not known here is reported at its full size.
+  const std::vector<std::unique_ptr<DxilCBuffer>> &CBuffers =
+      DM.GetCBuffers();
+  std::vector<unsigned> usedSizes(CBuffers.size(), 0);
+  bool bAllUsed = false;
+  // pEnd is the end of the bytes read, or null if the offset isn't constant.
+  auto markUsed = [&](Value *handle, const unsigned *pEnd) {
+    int ID = GetCBufferHandleID(handle);
+    if (ID < 0 || (unsigned)ID >= usedSizes.size()) {
+      bAllUsed = true;
+      return;
+    }
+    unsigned end = pEnd ? *pEnd : CBuffers[ID]->GetSize();
+    usedSizes[ID] = std::max(usedSizes[ID], end);
+  };
+  const DataLayout &DL = DM.GetModule()->getDataLayout();
+  for (Function &F : DM.GetModule()->functions()) {
+    for (BasicBlock &BB : F) {
+      for (Instruction &I : BB) {
+        DxilInst_CBufferLoadLegacy LegacyLoad(&I);
+        if (LegacyLoad) {
+          // Legacy loads read a whole 16-byte row.
+          ConstantInt *row = dyn_cast<ConstantInt>(LegacyLoad.get_regIndex());
+          unsigned end = row ? ((unsigned)row->getZExtValue() + 1) * 16 : 0;
+          markUsed(LegacyLoad.get_handle(), row ? &end : nullptr);
+          continue;
+        }
+        DxilInst_CBufferLoad Load(&I);
+        if (Load) {
+          ConstantInt *offset = dyn_cast<ConstantInt>(Load.get_byteOffset());
+          unsigned end = offset ? (unsigned)offset->getZExtValue() +
+                                      (unsigned)DL.getTypeStoreSize(I.getType())
+                                : 0;
+          markUsed(Load.get_handle(), offset ? &end : nullptr);
+        }
+      }
+    }
+  }
+  for (unsigned i = 0; i < usedSizes.size(); ++i) {
+    if (bAllUsed)
+      usedSizes[i] = CBuffers[i]->GetSize();
+    else
+      usedSizes[i] = std::min(usedSizes[i], CBuffers[i]->GetSize());
+  }
+
+  OS << "class\tname\tid\tspace\tlower_bound\trange_size\tused_bytes\n";
+  WriteResourceRemapLines(CBuffers, &usedSizes, OS);
+  WriteResourceRemapLines(DM.GetSRVs(), nullptr, OS);
+  WriteResourceRemapLines(DM.GetUAVs(), nullptr, OS);
+  WriteResourceRemapLines(DM.GetSamplers(), nullptr, OS);
+}
+
 DxilLinker *DxilLinker::CreateLinker(LLVMContext &Ctx) {
   return new DxilLinkerImpl(Ctx);
 }
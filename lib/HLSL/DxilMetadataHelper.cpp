@@ -28,6 +28,7 @@
 #include "llvm/Support/raw_ostream.h"
 #include <array>
 #include <algorithm>
+#include <map>
 
 #include "dxc/Support/WinIncludes.h"
 
@@ -48,6 +49,7 @@ const char DxilMDHelper::kDxilTypeSystemMDName[]                      = "dx.type
 const char DxilMDHelper::kDxilTypeSystemHelperVariablePrefix[]        = "dx.typevar.";
 const char DxilMDHelper::kDxilControlFlowHintMDName[]                 = "dx.controlflow.hints";
 const char DxilMDHelper::kDxilPreciseAttributeMDName[]                = "dx.precise";
+const char DxilMDHelper::kDxilUniformMDName[]                         = "dx.uniform";
 const char DxilMDHelper::kHLDxilResourceAttributeMDName[]             = "dx.hl.resource.attribute";
 const char DxilMDHelper::kDxilValidatorVersionMDName[]                = "dx.valver";
 
@@ -678,7 +680,18 @@ void DxilMDHelper::LoadDxilCBuffer(const MDOperand &MDO, DxilCBuffer &CB) {
   m_ExtraPropertyHelper->LoadCBufferProperties(pTupleMD->getOperand(kDxilCBufferNameValueList), CB);
 }
 
-void DxilMDHelper::EmitDxilTypeSystem(DxilTypeSystem &TypeSystem, vector<GlobalVariable*> &LLVMUsed) {
+void DxilMDHelper::EmitDxilTypeSystem(DxilTypeSystem &TypeSystem, vector<GlobalVariable*> &LLVMUsed, bool bPacked) {
+  if (bPacked) {
+    NamedMDNode *pDxilTypeAnnotationsMD = m_pModule->getNamedMetadata(kDxilTypeSystemMDName);
+    if (pDxilTypeAnnotationsMD != nullptr)
+      m_pModule->eraseNamedMetadata(pDxilTypeAnnotationsMD);
+    if (MDTuple *pPackedMD = EmitDxilPackedTypeSystem(TypeSystem)) {
+      pDxilTypeAnnotationsMD = m_pModule->getOrInsertNamedMetadata(kDxilTypeSystemMDName);
+      pDxilTypeAnnotationsMD->addOperand(pPackedMD);
+    }
+    return;
+  }
+
   auto &TypeMap = TypeSystem.GetStructAnnotationMap();
   vector<Metadata *> MDVals;
   MDVals.emplace_back(Uint32ToConstMD(kDxilTypeSystemStructTag)); // Tag
@@ -757,6 +770,8 @@ void DxilMDHelper::LoadDxilTypeSystemNode(const llvm::MDTuple &MDT,
       DxilStructAnnotation *pSA = TypeSystem.AddStructAnnotation(pGVType);
       LoadDxilStructAnnotation(MDT.getOperand(i + 1), *pSA);
     }
+  } else if (Tag == kDxilTypeSystemPackedTag) {
+    LoadDxilPackedTypeSystem(MDT, TypeSystem);
   } else if (Tag == kDxilTypeSystemFunctionTag) {
     IFTBOOL((MDT.getNumOperands() & 0x1) == 1, DXC_E_INCORRECT_DXIL_METADATA);
     for (unsigned i = 1; i < MDT.getNumOperands(); i += 2) {
@@ -787,6 +802,330 @@ void DxilMDHelper::LoadDxilTypeSystem(DxilTypeSystem &TypeSystem) {
   }
 }
 
+// Packed type system.
+//
+// The packed form is a single tuple:
+//   !{i32 kDxilTypeSystemPackedTag, !"<data>", <struct undefs>..., <functions>...}
+// The data string holds, as LEB128-encoded unsigned values: the encoding
+// version, a table of the strings used by the annotations, the number of
+// structs and functions, and then the annotations of each struct and each
+// function in operand order. Field names and semantics are indices into
+// the string table, so a name shared by many fields is stored once.
+// From version 2, each struct starts with a reference: 0 if its annotation
+// follows, or N to repeat the Nth annotation written that way, so structs
+// that only differ by type, as linking and type renaming produce, share
+// one copy.
+namespace {
+enum PackedFieldFlags : unsigned {
+  kPackedFieldName = 1 << 0,
+  kPackedPrecise = 1 << 1,
+  kPackedMatrix = 1 << 2,
+  kPackedCBufferOffset = 1 << 3,
+  kPackedSemantic = 1 << 4,
+  kPackedInterpMode = 1 << 5,
+  kPackedCompType = 1 << 6,
+};
+
+class PackedTypeSystemWriter {
+public:
+  void WriteUint(unsigned V, std::string &Out) {
+    do {
+      uint8_t Byte = V & 0x7f;
+      V >>= 7;
+      if (V != 0)
+        Byte |= 0x80;
+      Out.push_back((char)Byte);
+    } while (V != 0);
+  }
+  void WriteUint(unsigned V) { WriteUint(V, m_Body); }
+  void WriteString(const std::string &S) {
+    auto it = m_StringIndices.insert(
+        std::make_pair(S, (unsigned)m_Strings.size()));
+    if (it.second)
+      m_Strings.push_back(&it.first->first);
+    WriteUint(it.first->second);
+  }
+
+  void WriteFieldAnnotation(const DxilFieldAnnotation &FA) {
+    unsigned Flags = 0;
+    if (FA.HasFieldName())          Flags |= kPackedFieldName;
+    if (FA.IsPrecise())             Flags |= kPackedPrecise;
+    if (FA.HasMatrixAnnotation())   Flags |= kPackedMatrix;
+    if (FA.HasCBufferOffset())      Flags |= kPackedCBufferOffset;
+    if (FA.HasSemanticString())     Flags |= kPackedSemantic;
+    if (FA.HasInterpolationMode())  Flags |= kPackedInterpMode;
+    if (FA.HasCompType())           Flags |= kPackedCompType;
+    WriteUint(Flags);
+    if (Flags & kPackedFieldName)
+      WriteString(FA.GetFieldName());
+    if (Flags & kPackedMatrix) {
+      const DxilMatrixAnnotation &MA = FA.GetMatrixAnnotation();
+      WriteUint(MA.Rows);
+      WriteUint(MA.Cols);
+      WriteUint((unsigned)MA.Orientation);
+    }
+    if (Flags & kPackedCBufferOffset)
+      WriteUint(FA.GetCBufferOffset());
+    if (Flags & kPackedSemantic)
+      WriteString(FA.GetSemanticString());
+    if (Flags & kPackedInterpMode)
+      WriteUint((unsigned)FA.GetInterpolationMode().GetKind());
+    if (Flags & kPackedCompType)
+      WriteUint((unsigned)FA.GetCompType().GetKind());
+  }
+
+  void WriteStructAnnotation(const DxilStructAnnotation &SA) {
+    size_t Start = m_Body.size();
+    WriteUint(0);
+    WriteUint(SA.GetCBufferSize());
+    WriteUint(SA.GetNumFields());
+    for (unsigned i = 0; i < SA.GetNumFields(); i++)
+      WriteFieldAnnotation(SA.GetFieldAnnotation(i));
+    auto it = m_StructIndices.insert(std::make_pair(
+        m_Body.substr(Start + 1), (unsigned)m_StructIndices.size() + 1));
+    if (!it.second) {
+      m_Body.resize(Start);
+      WriteUint(it.first->second);
+    }
+  }
+
+  void WriteParamAnnotation(const DxilParameterAnnotation &PA) {
+    WriteUint((unsigned)PA.GetParamInputQual());
+    WriteFieldAnnotation(PA);
+    const std::vector<unsigned> &SemIdx = PA.GetSemanticIndexVec();
+    WriteUint(SemIdx.size());
+    for (unsigned Idx : SemIdx)
+      WriteUint(Idx);
+  }
+
+  // Returns the header, the string table and the body, in that order.
+  std::string GetData(unsigned NumStructs, unsigned NumFunctions) {
+    std::string Data;
+    WriteUint(DxilMDHelper::kDxilTypeSystemPackedVersion, Data);
+    WriteUint(m_Strings.size(), Data);
+    for (const std::string *S : m_Strings) {
+      WriteUint(S->size(), Data);
+      Data.append(*S);
+    }
+    WriteUint(NumStructs, Data);
+    WriteUint(NumFunctions, Data);
+    Data.append(m_Body);
+    return Data;
+  }
+
+private:
+  std::string m_Body;
+  std::map<std::string, unsigned> m_StringIndices;
+  std::vector<const std::string *> m_Strings;
+  std::map<std::string, unsigned> m_StructIndices;
+};
+
+class PackedTypeSystemReader {
+public:
+  PackedTypeSystemReader(StringRef Data)
+      : m_pCur(Data.bytes_begin()), m_pEnd(Data.bytes_end()),
+        m_pResume(nullptr) {}
+
+  unsigned ReadUint() {
+    uint64_t V = 0;
+    for (unsigned Shift = 0;; Shift += 7) {
+      IFTBOOL(m_pCur != m_pEnd && Shift < 35, DXC_E_INCORRECT_DXIL_METADATA);
+      uint8_t Byte = *m_pCur++;
+      V |= (uint64_t)(Byte & 0x7f) << Shift;
+      if ((Byte & 0x80) == 0)
+        break;
+    }
+    IFTBOOL(V <= UINT32_MAX, DXC_E_INCORRECT_DXIL_METADATA);
+    return (unsigned)V;
+  }
+  // Reads an enumerator of an enum whose values are 0 .. Count - 1.
+  unsigned ReadEnum(unsigned Count) {
+    unsigned V = ReadUint();
+    IFTBOOL(V < Count, DXC_E_INCORRECT_DXIL_METADATA);
+    return V;
+  }
+  void ReadStringTable() {
+    unsigned NumStrings = ReadUint();
+    IFTBOOL(NumStrings <= (size_t)(m_pEnd - m_pCur),
+            DXC_E_INCORRECT_DXIL_METADATA);
+    m_Strings.reserve(NumStrings);
+    for (unsigned i = 0; i < NumStrings; i++) {
+      unsigned Size = ReadUint();
+      IFTBOOL(Size <= (size_t)(m_pEnd - m_pCur), DXC_E_INCORRECT_DXIL_METADATA);
+      m_Strings.emplace_back((const char *)m_pCur, Size);
+      m_pCur += Size;
+    }
+  }
+  const std::string &ReadString() {
+    unsigned Idx = ReadUint();
+    IFTBOOL(Idx < m_Strings.size(), DXC_E_INCORRECT_DXIL_METADATA);
+    return m_Strings[Idx];
+  }
+
+  void ReadFieldAnnotation(DxilFieldAnnotation &FA) {
+    unsigned Flags = ReadUint();
+    IFTBOOL((Flags & ~(kPackedCompType * 2 - 1)) == 0,
+            DXC_E_INCORRECT_DXIL_METADATA);
+    if (Flags & kPackedFieldName)
+      FA.SetFieldName(ReadString());
+    if (Flags & kPackedPrecise)
+      FA.SetPrecise();
+    if (Flags & kPackedMatrix) {
+      DxilMatrixAnnotation MA;
+      MA.Rows = ReadUint();
+      MA.Cols = ReadUint();
+      MA.Orientation = (MatrixOrientation)ReadEnum(
+          (unsigned)MatrixOrientation::LastEntry);
+      FA.SetMatrixAnnotation(MA);
+    }
+    if (Flags & kPackedCBufferOffset)
+      FA.SetCBufferOffset(ReadUint());
+    if (Flags & kPackedSemantic)
+      FA.SetSemanticString(ReadString());
+    if (Flags & kPackedInterpMode)
+      FA.SetInterpolationMode(InterpolationMode((InterpolationMode::Kind)
+          ReadEnum((unsigned)InterpolationMode::Kind::Invalid + 1)));
+    if (Flags & kPackedCompType)
+      FA.SetCompType((CompType::Kind)ReadEnum(
+          (unsigned)CompType::Kind::LastEntry));
+  }
+
+  // Returns the number of fields; the fields are then read with
+  // ReadFieldAnnotation, followed by a call to EndStructAnnotation.
+  unsigned BeginStructAnnotation(unsigned Version, unsigned &CBufferSize) {
+    m_pResume = nullptr;
+    if (Version >= 2) {
+      unsigned Ref = ReadUint();
+      if (Ref != 0) {
+        IFTBOOL(Ref <= m_StructStarts.size(), DXC_E_INCORRECT_DXIL_METADATA);
+        m_pResume = m_pCur;
+        m_pCur = m_StructStarts[Ref - 1];
+      } else {
+        m_StructStarts.push_back(m_pCur);
+      }
+    }
+    CBufferSize = ReadUint();
+    return ReadUint();
+  }
+  void EndStructAnnotation() {
+    if (m_pResume != nullptr)
+      m_pCur = m_pResume;
+    m_pResume = nullptr;
+  }
+
+  void ReadParamAnnotation(DxilParameterAnnotation &PA) {
+    PA.SetParamInputQual((DxilParamInputQual)ReadEnum(
+        (unsigned)DxilParamInputQual::InputPrimitive + 1));
+    ReadFieldAnnotation(PA);
+    unsigned NumSemIdx = ReadUint();
+    IFTBOOL(NumSemIdx <= (size_t)(m_pEnd - m_pCur),
+            DXC_E_INCORRECT_DXIL_METADATA);
+    std::vector<unsigned> SemIdx(NumSemIdx);
+    for (unsigned i = 0; i < NumSemIdx; i++)
+      SemIdx[i] = ReadUint();
+    PA.SetSemanticIndexVec(SemIdx);
+  }
+
+  bool AtEnd() const { return m_pCur == m_pEnd; }
+
+private:
+  const uint8_t *m_pCur;
+  const uint8_t *m_pEnd;
+  const uint8_t *m_pResume; // Where to continue after a repeated struct.
+  std::vector<std::string> m_Strings;
+  std::vector<const uint8_t *> m_StructStarts;
+};
+} // namespace
+
+bool DxilMDHelper::IsPackedDxilTypeSystem() {
+  NamedMDNode *pDxilTypeAnnotationsMD = m_pModule->getNamedMetadata(kDxilTypeSystemMDName);
+  if (pDxilTypeAnnotationsMD == nullptr ||
+      pDxilTypeAnnotationsMD->getNumOperands() != 1)
+    return false;
+  const MDTuple *pTupleMD = dyn_cast<MDTuple>(pDxilTypeAnnotationsMD->getOperand(0));
+  return pTupleMD != nullptr && pTupleMD->getNumOperands() > 0 &&
+         ConstMDToUint32(pTupleMD->getOperand(0)) == kDxilTypeSystemPackedTag;
+}
+
+MDTuple *DxilMDHelper::EmitDxilPackedTypeSystem(DxilTypeSystem &TypeSystem) {
+  auto &TypeMap = TypeSystem.GetStructAnnotationMap();
+  auto &FuncMap = TypeSystem.GetFunctionAnnotationMap();
+  if (TypeMap.empty() && FuncMap.empty())
+    return nullptr;
+
+  PackedTypeSystemWriter Writer;
+  vector<Metadata *> MDVals;
+  MDVals.emplace_back(Uint32ToConstMD(kDxilTypeSystemPackedTag)); // Tag
+  MDVals.emplace_back(nullptr); // Data, filled in below.
+  for (auto it = TypeMap.begin(); it != TypeMap.end(); ++it) {
+    StructType *pStructType = const_cast<StructType *>(it->first);
+    const DxilStructAnnotation &SA = *it->second;
+    MDVals.push_back(ValueAsMetadata::get(UndefValue::get(pStructType)));
+    Writer.WriteStructAnnotation(SA);
+  }
+  for (auto it = FuncMap.begin(); it != FuncMap.end(); ++it) {
+    const DxilFunctionAnnotation &FA = *it->second;
+    MDVals.push_back(ValueAsMetadata::get(const_cast<Function*>(FA.GetFunction())));
+    Writer.WriteUint(FA.GetFlag().GetFlagValue());
+    Writer.WriteUint(FA.GetNumParameters());
+    Writer.WriteParamAnnotation(FA.GetRetTypeAnnotation());
+    for (unsigned i = 0; i < FA.GetNumParameters(); i++)
+      Writer.WriteParamAnnotation(FA.GetParameterAnnotation(i));
+  }
+  MDVals[1] = MDString::get(m_Ctx, Writer.GetData(TypeMap.size(), FuncMap.size()));
+  return MDNode::get(m_Ctx, MDVals);
+}
+
+void DxilMDHelper::LoadDxilPackedTypeSystem(const MDTuple &MDT,
+                                            DxilTypeSystem &TypeSystem) {
+  IFTBOOL(MDT.getNumOperands() >= 2, DXC_E_INCORRECT_DXIL_METADATA);
+  const MDString *pData = dyn_cast<MDString>(MDT.getOperand(1));
+  IFTBOOL(pData != nullptr, DXC_E_INCORRECT_DXIL_METADATA);
+
+  PackedTypeSystemReader Reader(pData->getString());
+  unsigned Version = Reader.ReadUint();
+  IFTBOOL(Version >= 1 && Version <= kDxilTypeSystemPackedVersion,
+          DXC_E_INCORRECT_DXIL_METADATA);
+  Reader.ReadStringTable();
+  unsigned NumStructs = Reader.ReadUint();
+  unsigned NumFunctions = Reader.ReadUint();
+  IFTBOOL((uint64_t)NumStructs + NumFunctions + 2 == MDT.getNumOperands(),
+          DXC_E_INCORRECT_DXIL_METADATA);
+
+  unsigned MDIdx = 2;
+  for (unsigned i = 0; i < NumStructs; i++) {
+    Constant *pGV = dyn_cast<Constant>(ValueMDToValue(MDT.getOperand(MDIdx++)));
+    IFTBOOL(pGV != nullptr, DXC_E_INCORRECT_DXIL_METADATA);
+    StructType *pGVType = dyn_cast<StructType>(pGV->getType());
+    IFTBOOL(pGVType != nullptr, DXC_E_INCORRECT_DXIL_METADATA);
+
+    DxilStructAnnotation *pSA = TypeSystem.AddStructAnnotation(pGVType);
+    unsigned CBufferSize;
+    unsigned NumFields = Reader.BeginStructAnnotation(Version, CBufferSize);
+    pSA->SetCBufferSize(CBufferSize);
+    if (NumFields == 0 && pGVType->getNumElements() == 1 &&
+        pGVType->getElementType(0) == Type::getInt8Ty(m_Ctx)) {
+      pSA->MarkEmptyStruct();
+    }
+    IFTBOOL(NumFields == pSA->GetNumFields(), DXC_E_INCORRECT_DXIL_METADATA);
+    for (unsigned f = 0; f < NumFields; f++)
+      Reader.ReadFieldAnnotation(pSA->GetFieldAnnotation(f));
+    Reader.EndStructAnnotation();
+  }
+  for (unsigned i = 0; i < NumFunctions; i++) {
+    Function *F = dyn_cast<Function>(ValueMDToValue(MDT.getOperand(MDIdx++)));
+    IFTBOOL(F != nullptr, DXC_E_INCORRECT_DXIL_METADATA);
+    DxilFunctionAnnotation *pFA = TypeSystem.AddFunctionAnnotation(F);
+    pFA->GetFlag().SetFlagValue(Reader.ReadUint());
+    IFTBOOL(Reader.ReadUint() == pFA->GetNumParameters(),
+            DXC_E_INCORRECT_DXIL_METADATA);
+    Reader.ReadParamAnnotation(pFA->GetRetTypeAnnotation());
+    for (unsigned p = 0; p < pFA->GetNumParameters(); p++)
+      Reader.ReadParamAnnotation(pFA->GetParameterAnnotation(p));
+  }
+  IFTBOOL(Reader.AtEnd(), DXC_E_INCORRECT_DXIL_METADATA);
+}
+
 Metadata *DxilMDHelper::EmitDxilStructAnnotation(const DxilStructAnnotation &SA) {
   vector<Metadata *> MDVals(SA.GetNumFields() + 1);
   MDVals[0] = Uint32ToConstMD(SA.GetCBufferSize());
@@ -62,6 +62,9 @@ DxilModule::DxilModule(Module *pModule)
 , m_pOP(std::make_unique<OP>(pModule->getContext(), pModule))
 , m_pTypeSystem(std::make_unique<DxilTypeSystem>(pModule))
 , m_pViewIdState(std::make_unique<DxilViewIdState>(this))
+, m_bTypeSystemPending(false)
+, m_bViewIdStatePending(false)
+, m_bPackedTypeSystem(false)
 , m_pMDHelper(std::make_unique<DxilMDHelper>(pModule, std::make_unique<DxilExtraPropertyHelper>(pModule)))
 , m_pDebugInfoFinder(nullptr)
 , m_pEntryFunc(nullptr)
@@ -973,8 +976,9 @@ void DxilModule::RemoveFunction(llvm::Function *F) {
   DXASSERT_NOMSG(F != nullptr);
   m_DxilFunctionPropsMap.erase(F);
   m_DxilEntrySignatureMap.erase(F);
-  if (m_pTypeSystem.get()->GetFunctionAnnotation(F))
-    m_pTypeSystem.get()->EraseFunctionAnnotation(F);
+  DxilTypeSystem &typeSys = GetTypeSystem();
+  if (typeSys.GetFunctionAnnotation(F))
+    typeSys.EraseFunctionAnnotation(F);
   m_pOP->RemoveFunction(F);
 }
 
@@ -1122,18 +1126,36 @@ void DxilModule::ResetRootSignature(RootSignatureHandle *pValue) {
 }
 
 DxilTypeSystem &DxilModule::GetTypeSystem() {
+  if (m_bTypeSystemPending) {
+    m_bTypeSystemPending = false;
+    m_pMDHelper->LoadDxilTypeSystem(*m_pTypeSystem.get());
+  }
   return *m_pTypeSystem;
 }
 
+void DxilModule::SetPackedTypeSystem(bool bPacked) {
+  m_bPackedTypeSystem = bPacked;
+}
+
+bool DxilModule::GetPackedTypeSystem() const {
+  return m_bPackedTypeSystem;
+}
+
 DxilViewIdState &DxilModule::GetViewIdState() {
-  return *m_pViewIdState;
+  const DxilModule *pThis = this;
+  return const_cast<DxilViewIdState &>(pThis->GetViewIdState());
 }
 const DxilViewIdState &DxilModule::GetViewIdState() const {
+  if (m_bViewIdStatePending) {
+    m_bViewIdStatePending = false;
+    m_pMDHelper->LoadDxilViewIdState(*m_pViewIdState.get());
+  }
   return *m_pViewIdState;
 }
 
 void DxilModule::ResetTypeSystem(DxilTypeSystem *pValue) {
   m_pTypeSystem.reset(pValue);
+  m_bTypeSystemPending = false;
 }
 
 void DxilModule::ResetOP(hlsl::OP *hlslOP) { m_pOP.reset(hlslOP); }
@@ -1201,6 +1223,9 @@ void DxilModule::ClearDxilMetadata(Module &M) {
     b = M.named_metadata_begin(),
     e = M.named_metadata_end();
   SmallVector<NamedMDNode*, 8> nodes;
+  // Sections loaded lazily must be read before their metadata goes away.
+  if (M.HasDxilModule())
+    M.GetDxilModule().LoadLazyDxilMetadata();
   for (; b != e; ++b) {
     StringRef name = b->getName();
     if (name == DxilMDHelper::kDxilVersionMDName ||
@@ -1233,7 +1258,8 @@ void DxilModule::EmitDxilMetadata() {
   MDTuple *pMDResources = EmitDxilResources();
   if (pMDResources)
     m_pMDHelper->EmitDxilResources(pMDResources);
-  m_pMDHelper->EmitDxilTypeSystem(GetTypeSystem(), m_LLVMUsed);
+  m_pMDHelper->EmitDxilTypeSystem(GetTypeSystem(), m_LLVMUsed,
+                                  m_bPackedTypeSystem);
   if (!m_pSM->IsCS() &&
       ((m_ValMajor == 0 &&  m_ValMinor == 0) ||
        (m_ValMajor > 1 || (m_ValMajor == 1 && m_ValMinor >= 1)))) {
@@ -1250,22 +1276,28 @@ void DxilModule::EmitDxilMetadata() {
   }
   if (m_pSM->IsLib()) {
     EmitDxilResourcesLinkInfo();
+    // Emit in module order rather than map order, which follows function
+    // addresses and would change the output from one run to the next.
     NamedMDNode *fnProps = m_pModule->getOrInsertNamedMetadata(
         DxilMDHelper::kDxilFunctionPropertiesMDName);
-    for (auto &&pair : m_DxilFunctionPropsMap) {
-      const hlsl::DxilFunctionProps *props = pair.second.get();
-      MDTuple *pProps = m_pMDHelper->EmitDxilFunctionProps(props, pair.first);
-      fnProps->addOperand(pProps);
-    }
-
     NamedMDNode *entrySigs = m_pModule->getOrInsertNamedMetadata(
         DxilMDHelper::kDxilEntrySignaturesMDName);
-    for (auto &&pair : m_DxilEntrySignatureMap) {
-      Function *F = pair.first;
-      DxilEntrySignature *Sig = pair.second.get();
-      MDTuple *pSig = m_pMDHelper->EmitDxilSignatures(*Sig);
-      entrySigs->addOperand(
-          MDTuple::get(m_Ctx, {ValueAsMetadata::get(F), pSig}));
+    for (Function &F : m_pModule->functions()) {
+      auto propsIt = m_DxilFunctionPropsMap.find(&F);
+      if (propsIt != m_DxilFunctionPropsMap.end()) {
+        const hlsl::DxilFunctionProps *props = propsIt->second.get();
+        MDTuple *pProps = m_pMDHelper->EmitDxilFunctionProps(props, &F);
+        fnProps->addOperand(pProps);
+      }
+    }
+    for (Function &F : m_pModule->functions()) {
+      auto sigIt = m_DxilEntrySignatureMap.find(&F);
+      if (sigIt != m_DxilEntrySignatureMap.end()) {
+        DxilEntrySignature *Sig = sigIt->second.get();
+        MDTuple *pSig = m_pMDHelper->EmitDxilSignatures(*Sig);
+        entrySigs->addOperand(
+            MDTuple::get(m_Ctx, {ValueAsMetadata::get(&F), pSig}));
+      }
     }
   }
 }
@@ -1274,7 +1306,7 @@ bool DxilModule::IsKnownNamedMetaData(llvm::NamedMDNode &Node) {
   return DxilMDHelper::IsKnownNamedMetaData(Node);
 }
 
-void DxilModule::LoadDxilMetadata() {
+void DxilModule::LoadDxilMetadata(bool bLazy) {
   m_pMDHelper->LoadDxilVersion(m_DxilMajor, m_DxilMinor);
   m_pMDHelper->LoadValidatorVersion(m_ValMajor, m_ValMinor);
   const ShaderModel *loadedModule;
@@ -1298,12 +1330,16 @@ void DxilModule::LoadDxilMetadata() {
   m_pMDHelper->LoadDxilSignatures(*pSignatures, *m_EntrySignature);
   LoadDxilResources(*pResources);
 
-  m_pMDHelper->LoadDxilTypeSystem(*m_pTypeSystem.get());
+  // The type system and view ID state are only needed by some consumers and
+  // cost the most to deserialize.
+  m_bPackedTypeSystem = m_pMDHelper->IsPackedDxilTypeSystem();
+  m_bTypeSystemPending = true;
+  m_bViewIdStatePending = true;
+  if (!bLazy)
+    LoadLazyDxilMetadata();
 
   m_pMDHelper->LoadRootSignature(*m_RootSignature.get());
 
-  m_pMDHelper->LoadDxilViewIdState(*m_pViewIdState.get());
-
   if (loadedModule->IsLib()) {
     LoadDxilResourcesLinkInfo();
     NamedMDNode *fnProps = m_pModule->getNamedMetadata(
@@ -1344,6 +1380,11 @@ void DxilModule::LoadDxilMetadata() {
   }
 }
 
+void DxilModule::LoadLazyDxilMetadata() {
+  GetTypeSystem();
+  GetViewIdState();
+}
+
 MDTuple *DxilModule::EmitDxilResources() {
   // Emit SRV records.
   MDTuple *pTupleSRVs = nullptr;
@@ -1395,7 +1436,8 @@ MDTuple *DxilModule::EmitDxilResources() {
 void DxilModule::ReEmitDxilResources() {
   MDTuple *pNewResource = EmitDxilResources();
   m_pMDHelper->UpdateDxilResources(pNewResource);
-  m_pMDHelper->EmitDxilTypeSystem(GetTypeSystem(), m_LLVMUsed);
+  m_pMDHelper->EmitDxilTypeSystem(GetTypeSystem(), m_LLVMUsed,
+                                  m_bPackedTypeSystem);
   const llvm::NamedMDNode *pEntries = m_pMDHelper->GetDxilEntryPoints();
   IFTBOOL(pEntries->getNumOperands() == 1, DXC_E_INCORRECT_DXIL_METADATA);
 
@@ -15,11 +15,15 @@
 #include "dxc/HLSL/HLModule.h"
 
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Type.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/Instructions.h"
+#include <algorithm>
 
 using namespace llvm;
 using std::vector;
@@ -340,9 +344,8 @@ bool OP::IsDxilOpFuncName(StringRef name) {
 }
 
 bool OP::IsDxilOpFunc(const llvm::Function *F) {
-  if (!F->hasName())
-    return false;
-  return IsDxilOpFuncName(F->getName());
+  // The name is checked against the prefix when the function is named.
+  return F->isDxilOp();
 }
 
 bool OP::IsDxilOpType(llvm::StructType *ST) {
@@ -392,6 +395,41 @@ OP::OpCode OP::GetDxilOpFuncCallInst(const llvm::Instruction *I) {
   return (OP::OpCode)llvm::cast<llvm::ConstantInt>(I->getOperand(0))->getZExtValue();
 }
 
+DxilOpCallList::DxilOpCallList(llvm::Function &F) {
+  const unsigned NumClasses = (unsigned)OP::OpCodeClass::NumOpClasses;
+  unsigned ClassCount[NumClasses] = {};
+  SmallVector<Call, 64> Found;
+  for (BasicBlock &BB : F) {
+    for (Instruction &I : BB) {
+      CallInst *CI = dyn_cast<CallInst>(&I);
+      if (!CI || !CI->getCalledFunction() ||
+          !CI->getCalledFunction()->isDxilOp())
+        continue;
+      // Malformed calls are left to the validator.
+      ConstantInt *OpArg = dyn_cast<ConstantInt>(CI->getArgOperand(0));
+      if (!OpArg || OpArg->getLimitedValue() >= (unsigned)OP::OpCode::NumOpCodes)
+        continue;
+      OP::OpCode Opcode = (OP::OpCode)OpArg->getLimitedValue();
+      Found.push_back({ CI, Opcode });
+      ++ClassCount[(unsigned)OP::GetOpCodeClass(Opcode)];
+    }
+  }
+
+  // Counting sort by class; stable, so calls keep their order in a class.
+  unsigned Begin = 0;
+  for (unsigned C = 0; C < NumClasses; ++C) {
+    m_ClassBegin[C] = Begin;
+    Begin += ClassCount[C];
+  }
+  m_ClassBegin[NumClasses] = Begin;
+
+  unsigned Next[NumClasses];
+  std::copy(m_ClassBegin, m_ClassBegin + NumClasses, Next);
+  m_Calls.resize(Found.size());
+  for (const Call &C : Found)
+    m_Calls[Next[(unsigned)OP::GetOpCodeClass(C.Opcode)]++] = C;
+}
+
 bool OP::IsDxilOpWave(OpCode C) {
   unsigned op = (unsigned)C;
   /* <py::lines('OPCODE-WAVE')>hctdb_instrhelp.get_instrs_pred("op", "is_wave")</py>*/
@@ -426,6 +464,26 @@ static Type *GetOrCreateStructType(LLVMContext &Ctx, ArrayRef<Type*> types, Stri
     return StructType::create(Ctx, types, Name);
 }
 
+// Named struct types are uniqued by the context, so function types built
+// from them are valid for every module in it. The exception is the half
+// overload of the cbuffer return type, whose layout depends on the module's
+// precision mode; it is never recorded here.
+struct OP::ContextTable : public LLVMContext::HLSLContextData {
+  FunctionType *FuncTypes[(unsigned)OpCodeClass::NumOpClasses][kNumTypeOverloads];
+  AttributeSet FuncAttrs[(unsigned)OpCode::NumOpCodes];
+  // Op code classes by the name their functions are given, for RefreshCache.
+  StringMap<OpCodeClass> OpCodeClassByName;
+  ContextTable() { memset(FuncTypes, 0, sizeof(FuncTypes)); }
+};
+
+OP::ContextTable *OP::GetContextTable(LLVMContext &Ctx) {
+  if (LLVMContext::HLSLContextData *pData = Ctx.getHLSLContextData())
+    return static_cast<ContextTable *>(pData);
+  ContextTable *pTable = new ContextTable();
+  Ctx.setHLSLContextData(pTable);
+  return pTable;
+}
+
 //------------------------------------------------------------------------------
 //
 //  OP methods.
@@ -433,7 +491,8 @@ static Type *GetOrCreateStructType(LLVMContext &Ctx, ArrayRef<Type*> types, Stri
 OP::OP(LLVMContext &Ctx, Module *pModule)
 : m_Ctx(Ctx)
 , m_pModule(pModule)
-, m_LowPrecisionMode(DXIL::LowPrecisionMode::Undefined) {
+, m_LowPrecisionMode(DXIL::LowPrecisionMode::Undefined)
+, m_pContextTable(GetContextTable(Ctx)) {
   memset(m_pResRetType, 0, sizeof(m_pResRetType));
   memset(m_pCBufferRetType, 0, sizeof(m_pCBufferRetType));
   memset(m_OpCodeClassCache, 0, sizeof(m_OpCodeClassCache));
@@ -463,15 +522,33 @@ OP::OP(LLVMContext &Ctx, Module *pModule)
 }
 
 void OP::RefreshCache() {
+  // Functions are named dx.op.<class>[.<overload>], so existing ones are
+  // resolved from their names, without rebuilding their signatures; this
+  // runs for every DXIL module that is loaded.
+  StringMap<OpCodeClass> &ClassByName = m_pContextTable->OpCodeClassByName;
+  if (ClassByName.empty()) {
+    for (const OpCodeProperty &Prop : m_OpCodeProps)
+      ClassByName[Prop.pOpCodeClassName] = Prop.OpCodeClass;
+  }
+
+  const size_t PrefixLen = strlen(m_NamePrefix);
   for (Function &F : m_pModule->functions()) {
-    if (OP::IsDxilOpFunc(&F) && !F.user_empty()) {
-      CallInst *CI = cast<CallInst>(*F.user_begin());
-      OpCode OpCode = OP::GetDxilOpFuncCallInst(CI);
-      Type *pOverloadType = OP::GetOverloadType(OpCode, &F);
-      Function *OpFunc = GetOpFunc(OpCode, pOverloadType);
-      (OpFunc);
-      DXASSERT_NOMSG(OpFunc == &F);
+    if (!OP::IsDxilOpFunc(&F) || F.user_empty())
+      continue;
+    std::pair<StringRef, StringRef> ClassAndOverload =
+        F.getName().drop_front(PrefixLen).split('.');
+    auto ClassIt = ClassByName.find(ClassAndOverload.first);
+    if (ClassIt == ClassByName.end())
+      continue; // Not a valid op function; left to the validator.
+    unsigned TypeSlot = 0; // void
+    if (!ClassAndOverload.second.empty()) {
+      for (TypeSlot = 1; TypeSlot < kNumTypeOverloads; ++TypeSlot)
+        if (ClassAndOverload.second == m_OverloadTypeName[TypeSlot])
+          break;
+      if (TypeSlot == kNumTypeOverloads)
+        continue;
     }
+    UpdateCache(ClassIt->second, TypeSlot, &F);
   }
 }
 
@@ -487,10 +564,8 @@ Function *OP::GetOpFunc(OpCode OpCode, Type *pOverloadType) {
   unsigned TypeSlot = GetTypeSlot(pOverloadType);
   OpCodeClass opClass = m_OpCodeProps[(unsigned)OpCode].OpCodeClass;
   Function *&F = m_OpCodeClassCache[(unsigned)opClass].pOverloads[TypeSlot];
-  if (F != nullptr) {
-    UpdateCache(opClass, TypeSlot, F);
+  if (F != nullptr)
     return F;
-  }
 
   vector<Type*> ArgTypes;      // RetType is ArgTypes[0]
   Type *pETy = pOverloadType;
@@ -513,11 +588,13 @@ Function *OP::GetOpFunc(OpCode OpCode, Type *pOverloadType) {
   Type *pSDT = GetSplitDoubleType();  // Split double type.
   Type *pI4S = GetInt4Type(); // 4 i32s in a struct.
 
-  std::string funcName = (Twine(OP::m_NamePrefix) + Twine(GetOpCodeClassName(OpCode))).str();
+  SmallString<64> funcName(OP::m_NamePrefix);
+  funcName += GetOpCodeClassName(OpCode);
   // Add ret type to the name.
   if (pOverloadType != pV) {
-    funcName = Twine(funcName).concat(".").concat(GetOverloadTypeName(TypeSlot)).str();
-  } 
+    funcName += ".";
+    funcName += GetOverloadTypeName(TypeSlot);
+  }
   // Try to find exist function with the same name in the module.
   if (Function *existF = m_pModule->getFunction(funcName)) {
     F = existF;
@@ -525,6 +602,11 @@ Function *OP::GetOpFunc(OpCode OpCode, Type *pOverloadType) {
     return F;
   }
 
+  FunctionType *&pSharedFT = m_pContextTable->FuncTypes[(unsigned)opClass][TypeSlot];
+  bool bShareFT = !(opClass == OpCodeClass::CBufferLoadLegacy && pOverloadType->isHalfTy());
+  if (bShareFT && pSharedFT != nullptr)
+    return CreateOpFunc(OpCode, opClass, TypeSlot, funcName, pSharedFT);
+
 #define A(_x) ArgTypes.emplace_back(_x)
 #define RRT(_y) A(GetResRetType(_y))
 #define CBRT(_y) A(GetCBufferRetType(_y))
@@ -745,14 +827,28 @@ Function *OP::GetOpFunc(OpCode OpCode, Type *pOverloadType) {
   FunctionType *pFT;
   DXASSERT(ArgTypes.size() > 1, "otherwise forgot to initialize arguments");
   pFT = FunctionType::get(ArgTypes[0], ArrayRef<Type*>(&ArgTypes[1], ArgTypes.size()-1), false);
+  if (bShareFT)
+    pSharedFT = pFT;
 
-  F = cast<Function>(m_pModule->getOrInsertFunction(funcName, pFT));
+  return CreateOpFunc(OpCode, opClass, TypeSlot, funcName, pFT);
+}
+
+Function *OP::CreateOpFunc(OpCode OpCode, OpCodeClass opClass,
+                           unsigned TypeSlot, StringRef funcName,
+                           FunctionType *pFT) {
+  Function *F = cast<Function>(m_pModule->getOrInsertFunction(funcName, pFT));
 
   UpdateCache(opClass, TypeSlot, F);
   F->setCallingConv(CallingConv::C);
-  F->addFnAttr(Attribute::NoUnwind);
-  if (m_OpCodeProps[(unsigned)OpCode].FuncAttr != Attribute::None)
-    F->addFnAttr(m_OpCodeProps[(unsigned)OpCode].FuncAttr);
+  AttributeSet &Attrs = m_pContextTable->FuncAttrs[(unsigned)OpCode];
+  if (Attrs.isEmpty()) {
+    AttrBuilder B;
+    B.addAttribute(Attribute::NoUnwind);
+    if (m_OpCodeProps[(unsigned)OpCode].FuncAttr != Attribute::None)
+      B.addAttribute(m_OpCodeProps[(unsigned)OpCode].FuncAttr);
+    Attrs = AttributeSet::get(m_Ctx, AttributeSet::FunctionIndex, B);
+  }
+  F->setAttributes(Attrs);
 
   return F;
 }
@@ -765,11 +861,14 @@ llvm::ArrayRef<llvm::Function *> OP::GetOpFuncList(OpCode OpCode) const {
 
 void OP::RemoveFunction(Function *F) {
   if (OP::IsDxilOpFunc(F)) {
-    OpCodeClass opClass = m_FunctionToOpClass[F];
+    auto iter = m_FunctionToOpClass.find(F);
+    if (iter == m_FunctionToOpClass.end())
+      return;
+    OpCodeClass opClass = iter->second;
     for (unsigned i=0;i<kNumTypeOverloads;i++) {
       if (F == m_OpCodeClassCache[(unsigned)opClass].pOverloads[i]) {
         m_OpCodeClassCache[(unsigned)opClass].pOverloads[i] = nullptr;
-        m_FunctionToOpClass.erase(F);
+        m_FunctionToOpClass.erase(iter);
         break;
       }
     }
@@ -16,6 +16,7 @@
 #include "dxc/HLSL/DxilTypeSystem.h"
 #include "dxc/HLSL/DxilUtil.h"
 #include "dxc/HLSL/DxilFunctionProps.h"
+#include "dxc/HLSL/ComputeViewIdState.h"
 #include "llvm/IR/GetElementPtrTypeIterator.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Instructions.h"
@@ -45,6 +46,12 @@ public:
 
   bool runOnFunction(Function &F) override;
 
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    // Only folds and deletes instructions; dominator trees and loop info
+    // computed before stay valid for the passes after.
+    AU.setPreservesCFG();
+  }
+
 private:
 };
 }
@@ -56,11 +63,12 @@ FunctionPass *llvm::createSimplifyInstPass() { return new SimplifyInst(); }
 INITIALIZE_PASS(SimplifyInst, "simplify-inst", "Simplify Instructions", false, false)
 
 bool SimplifyInst::runOnFunction(Function &F) {
+  bool Changed = false;
   for (Function::iterator BBI = F.begin(), BBE = F.end(); BBI != BBE; ++BBI) {
     BasicBlock *BB = BBI;
-    llvm::SimplifyInstructionsInBlock(BB, nullptr);
+    Changed |= llvm::SimplifyInstructionsInBlock(BB, nullptr);
   }
-  return true;
+  return Changed;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -427,3 +435,53 @@ ModulePass *llvm::createDxilEmitMetadataPass() {
 }
 
 INITIALIZE_PASS(DxilEmitMetadata, "hlsl-dxilemit", "HLSL DXIL Metadata Emit", false, false)
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+// Runs DxilFinalizeModule, ComputeViewIdState, DxilDeadFunctionElimination,
+// NoPausePasses and DxilEmitMetadata as one pass, so the module is finalized
+// and its metadata emitted exactly once. The resulting DxilModule matches
+// the emitted metadata and can be validated in memory.
+class DxilFinalizeAndEmit : public ModulePass {
+public:
+  static char ID; // Pass identification, replacement for typeid
+  explicit DxilFinalizeAndEmit() : ModulePass(ID) {}
+
+  const char *getPassName() const override {
+    return "HLSL DXIL Finalize Module and Metadata Emit";
+  }
+
+  bool runOnModule(Module &M) override {
+    if (!M.HasDxilModule())
+      return false;
+
+    DxilFinalizeModule Finalize;
+    Finalize.runOnModule(M);
+
+    DxilModule &DM = M.GetDxilModule();
+    const ShaderModel *pSM = DM.GetShaderModel();
+    if (!pSM->IsCS() && !pSM->IsLib())
+      DM.GetViewIdState().Compute();
+
+    dxilutil::RemoveUnusedFunctions(M, DM.GetEntryFunction(),
+                                    DM.GetPatchConstantFunction(),
+                                    pSM->IsLib());
+
+    ClearPauseResumePasses(M);
+
+    DxilModule::ClearDxilMetadata(M);
+    DM.EmitDxilMetadata();
+    return true;
+  }
+};
+}
+
+char DxilFinalizeAndEmit::ID = 0;
+
+ModulePass *llvm::createDxilFinalizeAndEmitPass() {
+  return new DxilFinalizeAndEmit();
+}
+
+INITIALIZE_PASS(DxilFinalizeAndEmit, "hlsl-dxilfinalize-emit", "HLSL DXIL Finalize Module and Metadata Emit", false, false)
@@ -0,0 +1,414 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilRemoveRedundantBarriers.cpp                                           //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Removes and weakens barriers of compute shaders that order no memory      //
+// accesses between threads.                                                 //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/HLSL/DxilGenerationPass.h"
+#include "dxc/HLSL/DxilInstructions.h"
+#include "dxc/HLSL/DxilModule.h"
+#include "dxc/HLSL/DxilOperations.h"
+
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DiagnosticInfo.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Operator.h"
+#include "llvm/Pass.h"
+
+#include <algorithm>
+
+using namespace llvm;
+using namespace hlsl;
+
+///////////////////////////////////////////////////////////////////////////////
+// Redundant barrier removal.
+
+namespace {
+// A group barrier with a groupshared fence is only needed when a thread may
+// access, on one side of it, groupshared memory that another thread accesses
+// on the other side, and one of them writes. The accesses on each side are
+// those reachable from the barrier without crossing another such barrier;
+// the entry function has no callers, so nothing comes before its first
+// block or after its returns.
+//
+// Two accesses can't touch the same memory when they are to different
+// variables, to fixed addresses that don't overlap - the accesses the
+// validator checks for races - or to the same element indexed only by
+// SV_GroupIndex, which is different for every thread of the group.
+//
+// Besides that, barriers with no memory access between them are merged, and
+// UAV fences are dropped when the shader has no UAVs. A barrier left with
+// only its group sync is removed. Every change is reported as an
+// optimization remark.
+const char kPassArg[] = "hlsl-dxil-remove-redundant-barriers";
+
+// Past this many accesses on either side a barrier is kept, to bound the
+// quadratic comparison.
+const unsigned kMaxAccessesPerSide = 256;
+
+const unsigned kSyncTGSM = (unsigned)DXIL::BarrierMode::SyncThreadGroup |
+                           (unsigned)DXIL::BarrierMode::TGSMFence;
+const unsigned kUAVFences = (unsigned)DXIL::BarrierMode::UAVFenceGlobal |
+                            (unsigned)DXIL::BarrierMode::UAVFenceThreadGroup;
+
+struct TGSMAccess {
+  Instruction *I;
+  // The variable accessed; null when it isn't known.
+  GlobalVariable *GV;
+  Value *Ptr;
+  bool bWrite;
+};
+
+class DxilRemoveRedundantBarriers : public ModulePass {
+public:
+  static char ID; // Pass identification, replacement for typeid
+  explicit DxilRemoveRedundantBarriers() : ModulePass(ID) {}
+
+  const char *getPassName() const override {
+    return "DXIL remove redundant barriers";
+  }
+
+  bool runOnModule(Module &M) override {
+    if (!M.HasDxilModule())
+      return false;
+    DxilModule &DM = M.GetDxilModule();
+    Function *Entry = DM.GetEntryFunction();
+    if (!Entry || !DM.GetShaderModel()->IsCS())
+      return false;
+
+    SmallVector<CallInst *, 8> Barriers;
+    for (BasicBlock &BB : *Entry) {
+      for (Instruction &I : BB) {
+        DxilInst_Barrier Barrier(&I);
+        if (Barrier && isa<ConstantInt>(Barrier.get_barrierMode()))
+          Barriers.push_back(cast<CallInst>(&I));
+      }
+    }
+    if (Barriers.empty())
+      return false;
+
+    bool bChanged = MergeAdjacentBarriers(Barriers, *Entry);
+    if (DM.GetUAVs().empty())
+      bChanged |= RemoveUAVFences(Barriers, *Entry);
+    bChanged |= RemoveTGSMFences(Barriers, *Entry);
+    return bChanged;
+  }
+
+private:
+  bool MergeAdjacentBarriers(SmallVectorImpl<CallInst *> &Barriers,
+                             Function &F);
+  bool RemoveUAVFences(SmallVectorImpl<CallInst *> &Barriers, Function &F);
+  bool RemoveTGSMFences(SmallVectorImpl<CallInst *> &Barriers, Function &F);
+};
+
+char DxilRemoveRedundantBarriers::ID = 0;
+
+unsigned GetMode(CallInst *Barrier) {
+  return (unsigned)DxilInst_Barrier(Barrier).get_barrierMode_val();
+}
+
+void SetMode(CallInst *Barrier, unsigned Mode) {
+  DxilInst_Barrier(Barrier).set_barrierMode_val((int32_t)Mode);
+}
+
+bool IsSyncTGSMBarrier(Instruction *I) {
+  DxilInst_Barrier Barrier(I);
+  return Barrier && isa<ConstantInt>(Barrier.get_barrierMode()) &&
+         (Barrier.get_barrierMode_val() & kSyncTGSM) == kSyncTGSM;
+}
+
+void Report(Function &F, CallInst *Barrier, const Twine &Msg) {
+  emitOptimizationRemark(F.getContext(), kPassArg, F, Barrier->getDebugLoc(),
+                         Msg);
+}
+
+// Removes a barrier that is left with no fence, returning whether it did.
+bool EraseIfEmpty(CallInst *Barrier, Function &F) {
+  if ((GetMode(Barrier) & ~(unsigned)DXIL::BarrierMode::SyncThreadGroup) != 0)
+    return false;
+  Report(F, Barrier, "removed barrier");
+  Barrier->eraseFromParent();
+  return true;
+}
+
+void RemoveErased(SmallVectorImpl<CallInst *> &Barriers,
+                  SmallPtrSetImpl<CallInst *> &Erased) {
+  Barriers.erase(std::remove_if(Barriers.begin(), Barriers.end(),
+                                [&](CallInst *B) { return Erased.count(B); }),
+                 Barriers.end());
+}
+
+// Returns whether I may access groupshared memory, and if so describes the
+// access. Calls other than DXIL operations may access any variable.
+bool GetTGSMAccess(Instruction *I, TGSMAccess &Access) {
+  Value *Ptr = nullptr;
+  bool bWrite = true;
+  if (LoadInst *LI = dyn_cast<LoadInst>(I)) {
+    Ptr = LI->getPointerOperand();
+    bWrite = false;
+  } else if (StoreInst *SI = dyn_cast<StoreInst>(I)) {
+    Ptr = SI->getPointerOperand();
+  } else if (AtomicRMWInst *RMW = dyn_cast<AtomicRMWInst>(I)) {
+    Ptr = RMW->getPointerOperand();
+  } else if (AtomicCmpXchgInst *CX = dyn_cast<AtomicCmpXchgInst>(I)) {
+    Ptr = CX->getPointerOperand();
+  } else if (CallInst *CI = dyn_cast<CallInst>(I)) {
+    Function *Callee = CI->getCalledFunction();
+    if ((Callee && OP::IsDxilOpFunc(Callee)) || !I->mayReadOrWriteMemory())
+      return false;
+    Access = { I, nullptr, nullptr, true };
+    return true;
+  } else {
+    return false;
+  }
+  if (Ptr->getType()->getPointerAddressSpace() != DXIL::kTGSMAddrSpace)
+    return false;
+  Value *Base = Ptr;
+  while (true) {
+    if (GEPOperator *GEP = dyn_cast<GEPOperator>(Base))
+      Base = GEP->getPointerOperand();
+    else if (BitCastOperator *BC = dyn_cast<BitCastOperator>(Base))
+      Base = BC->getOperand(0);
+    else
+      break;
+  }
+  Access = { I, dyn_cast<GlobalVariable>(Base), Ptr, bWrite };
+  return true;
+}
+
+// Whether every thread of the group accesses a different element through
+// both pointers: they index the same variable with the same values, which
+// are constants and SV_GroupIndex.
+bool IsPerThreadElement(Value *PtrA, Value *PtrB) {
+  GEPOperator *A = dyn_cast<GEPOperator>(PtrA);
+  GEPOperator *B = dyn_cast<GEPOperator>(PtrB);
+  if (!A || !B || A->getPointerOperand() != B->getPointerOperand() ||
+      !isa<GlobalVariable>(A->getPointerOperand()) ||
+      A->getNumOperands() != B->getNumOperands())
+    return false;
+  bool bHasThreadIndex = false;
+  for (unsigned i = 1, e = A->getNumOperands(); i < e; ++i) {
+    Value *Index = A->getOperand(i);
+    if (Index != B->getOperand(i))
+      return false;
+    if (isa<ConstantInt>(Index))
+      continue;
+    Instruction *IndexI = dyn_cast<Instruction>(Index);
+    if (!IndexI ||
+        !OP::IsDxilOpFuncCallInst(IndexI,
+                                  DXIL::OpCode::FlattenedThreadIdInGroup))
+      return false;
+    bHasThreadIndex = true;
+  }
+  return bHasThreadIndex;
+}
+
+// Whether the accesses touch disjoint fixed addresses.
+bool AreDisjointFixedAddresses(const TGSMAccess &A, const TGSMAccess &B,
+                               const DataLayout &DL) {
+  auto GetRange = [&](const TGSMAccess &Access, APInt &Offset,
+                      uint64_t &Size) {
+    Offset = APInt(DL.getPointerSizeInBits(DXIL::kTGSMAddrSpace), 0);
+    if (GEPOperator *GEP = dyn_cast<GEPOperator>(Access.Ptr)) {
+      if (GEP->getPointerOperand() != Access.GV ||
+          !GEP->accumulateConstantOffset(DL, Offset))
+        return false;
+    } else if (Access.Ptr != Access.GV) {
+      return false;
+    }
+    Size = DL.getTypeStoreSize(
+        Access.Ptr->getType()->getPointerElementType());
+    return true;
+  };
+  APInt OffsetA, OffsetB;
+  uint64_t SizeA, SizeB;
+  if (!GetRange(A, OffsetA, SizeA) || !GetRange(B, OffsetB, SizeB))
+    return false;
+  uint64_t StartA = OffsetA.getZExtValue();
+  uint64_t StartB = OffsetB.getZExtValue();
+  return StartA + SizeA <= StartB || StartB + SizeB <= StartA;
+}
+
+// Whether a thread's access A and another thread's access B may need a
+// barrier between them.
+bool MayConflict(const TGSMAccess &A, const TGSMAccess &B,
+                 const DataLayout &DL) {
+  if (!A.bWrite && !B.bWrite)
+    return false;
+  if (!A.GV || !B.GV)
+    return true;
+  if (A.GV != B.GV)
+    return false;
+  return !AreDisjointFixedAddresses(A, B, DL) &&
+         !IsPerThreadElement(A.Ptr, B.Ptr);
+}
+
+// Collects the groupshared accesses reachable from Barrier in one direction
+// without crossing another group barrier with a groupshared fence. Returns
+// false when there are too many to compare.
+bool CollectAccesses(CallInst *Barrier, bool bForward,
+                     SmallVectorImpl<TGSMAccess> &Accesses) {
+  // Returns whether the walk continues past I.
+  auto Visit = [&](Instruction &I) {
+    if (&I != Barrier && IsSyncTGSMBarrier(&I))
+      return false;
+    TGSMAccess Access;
+    if (GetTGSMAccess(&I, Access))
+      Accesses.push_back(Access);
+    return Accesses.size() <= kMaxAccessesPerSide;
+  };
+  // Visits the instructions of BB in the direction of the walk, starting
+  // after Barrier when it is in BB.
+  auto Scan = [&](BasicBlock *BB, bool bFromBarrier) {
+    if (bForward) {
+      BasicBlock::iterator It = bFromBarrier
+                                    ? std::next(BasicBlock::iterator(Barrier))
+                                    : BB->begin();
+      for (; It != BB->end(); ++It) {
+        if (!Visit(*It))
+          return false;
+      }
+    } else {
+      BasicBlock::reverse_iterator It =
+          bFromBarrier ? BasicBlock::reverse_iterator(
+                             BasicBlock::iterator(Barrier))
+                       : BB->rbegin();
+      for (; It != BB->rend(); ++It) {
+        if (!Visit(*It))
+          return false;
+      }
+    }
+    return true;
+  };
+
+  SmallPtrSet<BasicBlock *, 16> Visited;
+  SmallVector<BasicBlock *, 16> Worklist;
+  auto Continue = [&](BasicBlock *BB) {
+    if (bForward)
+      Worklist.append(succ_begin(BB), succ_end(BB));
+    else
+      Worklist.append(pred_begin(BB), pred_end(BB));
+  };
+  if (Scan(Barrier->getParent(), /*bFromBarrier*/ true))
+    Continue(Barrier->getParent());
+  while (!Worklist.empty()) {
+    BasicBlock *BB = Worklist.pop_back_val();
+    if (!Visited.insert(BB).second)
+      continue;
+    if (Scan(BB, /*bFromBarrier*/ false))
+      Continue(BB);
+  }
+  return Accesses.size() <= kMaxAccessesPerSide;
+}
+}
+
+// Two barriers with no memory access between them synchronize like one
+// barrier with the fences of both.
+bool DxilRemoveRedundantBarriers::MergeAdjacentBarriers(
+    SmallVectorImpl<CallInst *> &Barriers, Function &F) {
+  SmallPtrSet<CallInst *, 8> Erased;
+  for (BasicBlock &BB : F) {
+    CallInst *Prev = nullptr;
+    for (auto It = BB.begin(); It != BB.end();) {
+      Instruction *I = &*(It++);
+      DxilInst_Barrier Barrier(I);
+      if (!Barrier || !isa<ConstantInt>(Barrier.get_barrierMode())) {
+        if (I->mayReadOrWriteMemory())
+          Prev = nullptr;
+        continue;
+      }
+      CallInst *CI = cast<CallInst>(I);
+      if (!Prev) {
+        Prev = CI;
+        continue;
+      }
+      unsigned Mode = GetMode(Prev) | GetMode(CI);
+      // A global UAV fence covers the group one.
+      if ((Mode & kUAVFences) == kUAVFences)
+        Mode &= ~(unsigned)DXIL::BarrierMode::UAVFenceThreadGroup;
+      SetMode(Prev, Mode);
+      Report(F, CI, "merged barrier into the one before it");
+      Erased.insert(CI);
+      CI->eraseFromParent();
+    }
+  }
+  RemoveErased(Barriers, Erased);
+  return !Erased.empty();
+}
+
+bool DxilRemoveRedundantBarriers::RemoveUAVFences(
+    SmallVectorImpl<CallInst *> &Barriers, Function &F) {
+  bool bChanged = false;
+  SmallPtrSet<CallInst *, 8> Erased;
+  for (CallInst *Barrier : Barriers) {
+    unsigned Mode = GetMode(Barrier);
+    if ((Mode & kUAVFences) == 0)
+      continue;
+    SetMode(Barrier, Mode & ~kUAVFences);
+    Report(F, Barrier, "removed UAV fence from barrier, as there are no UAVs");
+    bChanged = true;
+    if (EraseIfEmpty(Barrier, F))
+      Erased.insert(Barrier);
+  }
+  RemoveErased(Barriers, Erased);
+  return bChanged;
+}
+
+// Barriers are decided in order, each against the barriers still in place,
+// so removing one never makes an earlier decision wrong.
+bool DxilRemoveRedundantBarriers::RemoveTGSMFences(
+    SmallVectorImpl<CallInst *> &Barriers, Function &F) {
+  const DataLayout &DL = F.getParent()->getDataLayout();
+  bool bChanged = false;
+  SmallPtrSet<CallInst *, 8> Erased;
+  for (CallInst *Barrier : Barriers) {
+    if (!IsSyncTGSMBarrier(Barrier))
+      continue;
+    SmallVector<TGSMAccess, 16> Before, After;
+    if (!CollectAccesses(Barrier, /*bForward*/ false, Before) ||
+        !CollectAccesses(Barrier, /*bForward*/ true, After))
+      continue;
+    bool bConflict = false;
+    for (const TGSMAccess &A : Before) {
+      for (const TGSMAccess &B : After) {
+        if (MayConflict(A, B, DL)) {
+          bConflict = true;
+          break;
+        }
+      }
+      if (bConflict)
+        break;
+    }
+    if (bConflict)
+      continue;
+
+    unsigned Mode = GetMode(Barrier) & ~(unsigned)DXIL::BarrierMode::TGSMFence;
+    SetMode(Barrier, Mode);
+    bChanged = true;
+    if (EraseIfEmpty(Barrier, F))
+      Erased.insert(Barrier);
+    else
+      Report(F, Barrier, "removed groupshared fence from barrier, as it "
+                         "orders no groupshared accesses between threads");
+  }
+  RemoveErased(Barriers, Erased);
+  return bChanged;
+}
+
+ModulePass *llvm::createDxilRemoveRedundantBarriersPass() {
+  return new DxilRemoveRedundantBarriers();
+}
+
+INITIALIZE_PASS(DxilRemoveRedundantBarriers,
+                "hlsl-dxil-remove-redundant-barriers",
+                "DXIL remove redundant barriers", false, false)
@@ -22,6 +22,8 @@
 
 #include <string>
 #include <algorithm>
+#include <mutex>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 #include <set>
@@ -81,7 +83,8 @@ void RootSignatureHandle::EnsureSerializedAvailable() {
   DXASSERT_NOMSG(!IsEmpty());
   if (m_pSerialized == nullptr) {
     CComPtr<IDxcBlob> pResult;
-    hlsl::SerializeRootSignature(m_pDesc, &pResult, nullptr, false);
+    CComPtr<IDxcBlobEncoding> pErrors;
+    hlsl::RootSignatureCache::Serialize(m_pDesc, &pResult, &pErrors, false);
     IFTBOOL(pResult != nullptr, E_FAIL);
     m_pSerialized = pResult.Detach();
   }
@@ -252,7 +255,7 @@ class CIntervalCollection {
 private:
   std::set<T> m_set;
 public:
-  const T* FindIntersectingInterval(const T &I) {
+  const T* FindIntersectingInterval(const T &I) const {
     auto it = m_set.find(I);
     if (it != m_set.end())
       return &*it;
@@ -292,10 +295,12 @@ public:
   void VerifyRootSignature(const DxilVersionedRootSignatureDesc *pRootSignature,
                            DiagnosticPrinter &DiagPrinter);
 
+  // Only reads the accumulated state, so shaders may be verified
+  // concurrently against one root signature.
   void VerifyShader(DxilShaderVisibility VisType,
                     const void *pPSVData,
                     uint32_t PSVSize,
-                    DiagnosticPrinter &DiagPrinter);
+                    DiagnosticPrinter &DiagPrinter) const;
 
   typedef enum NODE_TYPE {
     DESCRIPTOR_TABLE_ENTRY,
@@ -347,12 +352,16 @@ private:
                                             DxilShaderVisibility VisType,
                                             unsigned Num,
                                             unsigned LB,
-                                            unsigned Space);
+                                            unsigned Space) const;
 
   RegisterRanges &
   GetRanges(DxilShaderVisibility VisType, DxilDescriptorRangeType DescType) {
     return RangeKinds[(unsigned)VisType][(unsigned)DescType];
   }
+  const RegisterRanges &
+  GetRanges(DxilShaderVisibility VisType, DxilDescriptorRangeType DescType) const {
+    return RangeKinds[(unsigned)VisType][(unsigned)DescType];
+  }
 
   RegisterRanges RangeKinds[kMaxVisType + 1][kMaxDescType + 1];
   bool m_bAllowReservedRegisterSpace;
@@ -577,7 +586,7 @@ RootSignatureVerifier::FindCoveringInterval(DxilDescriptorRangeType RangeType,
                                             DxilShaderVisibility VisType,
                                             unsigned Num,
                                             unsigned LB,
-                                            unsigned Space) {
+                                            unsigned Space) const {
   RegisterRange RR;
   RR.space = Space;
   RR.lb = LB;
@@ -768,7 +777,7 @@ void RootSignatureVerifier::VerifyRootSignature(
 void RootSignatureVerifier::VerifyShader(DxilShaderVisibility VisType,
                                          const void *pPSVData,
                                          uint32_t PSVSize,
-                                         DiagnosticPrinter &DiagPrinter) {
+                                         DiagnosticPrinter &DiagPrinter) const {
   DxilPipelineStateValidation PSV;
   IFTBOOL(PSV.InitFromPSV0(pPSVData, PSVSize), E_INVALIDARG);
 
@@ -1664,17 +1673,19 @@ static DxilShaderVisibility GetVisibilityType(DXIL::ShaderKind ShaderKind) {
   }
 }
 
+RootSignatureCompatibilityChecker::RootSignatureCompatibilityChecker() {}
+
+RootSignatureCompatibilityChecker::~RootSignatureCompatibilityChecker() {}
+
 _Use_decl_annotations_
-bool VerifyRootSignatureWithShaderPSV(const DxilVersionedRootSignatureDesc *pDesc,
-                                      DXIL::ShaderKind ShaderKind,
-                                      const void *pPSVData,
-                                      uint32_t PSVSize,
-                                      llvm::raw_ostream &DiagStream) {
+bool RootSignatureCompatibilityChecker::Init(const DxilVersionedRootSignatureDesc *pDesc,
+                                             llvm::raw_ostream &DiagStream) {
+  m_pVerifier.reset();
   try {
-    RootSignatureVerifier RSV;
+    std::unique_ptr<RootSignatureVerifier> pVerifier(new RootSignatureVerifier());
     DiagnosticPrinterRawOStream DiagPrinter(DiagStream);
-    RSV.VerifyRootSignature(pDesc, DiagPrinter);
-    RSV.VerifyShader(GetVisibilityType(ShaderKind), pPSVData, PSVSize, DiagPrinter);
+    pVerifier->VerifyRootSignature(pDesc, DiagPrinter);
+    m_pVerifier = std::move(pVerifier);
   } catch (...) {
     return false;
   }
@@ -1682,4 +1693,355 @@ bool VerifyRootSignatureWithShaderPSV(const DxilVersionedRootSignatureDesc *pDes
   return true;
 }
 
+_Use_decl_annotations_
+bool RootSignatureCompatibilityChecker::VerifyShaderPSV(DXIL::ShaderKind ShaderKind,
+                                                        const void *pPSVData,
+                                                        uint32_t PSVSize,
+                                                        llvm::raw_ostream &DiagStream) const {
+  DXASSERT(m_pVerifier != nullptr, "else Init has not succeeded");
+  if (m_pVerifier == nullptr)
+    return false;
+  try {
+    DiagnosticPrinterRawOStream DiagPrinter(DiagStream);
+    m_pVerifier->VerifyShader(GetVisibilityType(ShaderKind), pPSVData, PSVSize, DiagPrinter);
+  } catch (...) {
+    return false;
+  }
+
+  return true;
+}
+
+_Use_decl_annotations_
+bool VerifyRootSignatureWithShaderPSV(const DxilVersionedRootSignatureDesc *pDesc,
+                                      DXIL::ShaderKind ShaderKind,
+                                      const void *pPSVData,
+                                      uint32_t PSVSize,
+                                      llvm::raw_ostream &DiagStream) {
+  RootSignatureCompatibilityChecker Checker;
+  return Checker.Init(pDesc, DiagStream) &&
+         Checker.VerifyShaderPSV(ShaderKind, pPSVData, PSVSize, DiagStream);
+}
+
+//=============================================================================
+//
+// Canonical form and interning cache.
+//
+
+namespace {
+
+// The canonical form of a root signature is the sequence of every value that
+// defines it, in declaration order. Pointers and serialized offsets are left
+// out, and flags that rs_1_0 leaves implicit are made explicit.
+class RootSignatureCanonicalizer {
+public:
+  std::string Words;
+
+  void Add(uint32_t value) {
+    Words.append((const char *)&value, sizeof(value));
+  }
+
+  template<typename T_ROOT_SIGNATURE_DESC, typename T_ROOT_PARAMETER>
+  void AddDesc(const T_ROOT_SIGNATURE_DESC &Desc) {
+    Add((uint32_t)Desc.Flags);
+    Add(Desc.NumParameters);
+    for (unsigned iRP = 0; iRP < Desc.NumParameters; iRP++) {
+      const T_ROOT_PARAMETER &P = Desc.pParameters[iRP];
+      Add((uint32_t)P.ParameterType);
+      Add((uint32_t)P.ShaderVisibility);
+      switch (P.ParameterType) {
+      case DxilRootParameterType::DescriptorTable:
+        Add(P.DescriptorTable.NumDescriptorRanges);
+        for (unsigned i = 0; i < P.DescriptorTable.NumDescriptorRanges; i++) {
+          const auto &R = P.DescriptorTable.pDescriptorRanges[i];
+          Add((uint32_t)R.RangeType);
+          Add(R.NumDescriptors);
+          Add(R.BaseShaderRegister);
+          Add(R.RegisterSpace);
+          Add(R.OffsetInDescriptorsFromTableStart);
+          Add((uint32_t)GetFlags(R));
+        }
+        break;
+      case DxilRootParameterType::Constants32Bit:
+        Add(P.Constants.ShaderRegister);
+        Add(P.Constants.RegisterSpace);
+        Add(P.Constants.Num32BitValues);
+        break;
+      case DxilRootParameterType::CBV:
+      case DxilRootParameterType::SRV:
+      case DxilRootParameterType::UAV:
+        Add(P.Descriptor.ShaderRegister);
+        Add(P.Descriptor.RegisterSpace);
+        Add((uint32_t)GetFlags(P.Descriptor));
+        break;
+      default:
+        // Nothing else is defined for an unknown type.
+        break;
+      }
+    }
+    Add(Desc.NumStaticSamplers);
+    // Samplers are plain 32-bit fields; floats are compared by bit pattern.
+    static_assert(sizeof(DxilStaticSamplerDesc) % sizeof(uint32_t) == 0,
+                  "else static samplers have padding");
+    if (Desc.NumStaticSamplers)
+      Words.append((const char *)Desc.pStaticSamplers,
+                   sizeof(DxilStaticSamplerDesc) * Desc.NumStaticSamplers);
+  }
+
+  void AddVersionedDesc(const DxilVersionedRootSignatureDesc *pDesc) {
+    Add((uint32_t)pDesc->Version);
+    switch (pDesc->Version) {
+    case DxilRootSignatureVersion::Version_1_0:
+      AddDesc<DxilRootSignatureDesc, DxilRootParameter>(pDesc->Desc_1_0);
+      break;
+    case DxilRootSignatureVersion::Version_1_1:
+      AddDesc<DxilRootSignatureDesc1, DxilRootParameter1>(pDesc->Desc_1_1);
+      break;
+    default:
+      IFT(E_INVALIDARG);
+    }
+  }
+};
+
+std::string GetCanonicalRootSignature(const DxilVersionedRootSignatureDesc *pDesc) {
+  DXASSERT_NOMSG(pDesc != nullptr);
+  RootSignatureCanonicalizer C;
+  C.AddVersionedDesc(pDesc);
+  return std::move(C.Words);
+}
+
+// 64-bit FNV-1a, so hashes can be compared across processes.
+uint64_t HashCanonicalRootSignature(const std::string &Canonical) {
+  uint64_t Hash = 14695981039346656037ULL;
+  for (char c : Canonical) {
+    Hash ^= (uint8_t)c;
+    Hash *= 1099511628211ULL;
+  }
+  return Hash;
+}
+
+SharedRootSignatureDesc DeserializeShared(const void *pSrcData,
+                                          uint32_t SrcDataSizeInBytes) {
+  const DxilVersionedRootSignatureDesc *pDesc = nullptr;
+  DeserializeRootSignature(pSrcData, SrcDataSizeInBytes, &pDesc);
+  // The deleter runs even if allocating the control block fails.
+  return SharedRootSignatureDesc(pDesc, DeleteRootSignature);
+}
+
+class RootSignatureCacheImpl {
+public:
+  // Bound on the number of entries in each map; a map starts over once it
+  // is reached.
+  static const size_t MaxEntries = 4096;
+
+  // Deserialized forms, keyed by serialized bytes.
+  SharedRootSignatureDesc FindDesc(const std::string &Key) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_descs.find(Key);
+    if (it == m_descs.end())
+      return nullptr;
+    return it->second;
+  }
+  SharedRootSignatureDesc InsertDesc(const std::string &Key,
+                                     SharedRootSignatureDesc pDesc) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return Insert(m_descs, Key, std::move(pDesc));
+  }
+
+  // Serialized forms, keyed by canonical form. Serializer output and
+  // interned input are kept apart, as only the former has been verified.
+  CComPtr<IDxcBlob> FindBlob(const std::string &Key) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_blobs.find(Key);
+    if (it == m_blobs.end())
+      return nullptr;
+    return it->second;
+  }
+  CComPtr<IDxcBlob> InsertBlob(const std::string &Key, IDxcBlob *pBlob) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return Insert(m_blobs, Key, CComPtr<IDxcBlob>(pBlob));
+  }
+
+private:
+  // Returns the value in the map, which is Value unless another thread
+  // inserted one first.
+  template<typename T>
+  static T Insert(std::unordered_map<std::string, T> &Map,
+                  const std::string &Key, T Value) {
+    auto it = Map.find(Key);
+    if (it != Map.end())
+      return it->second;
+    if (Map.size() >= MaxEntries)
+      Map.clear();
+    Map[Key] = Value;
+    return Value;
+  }
+
+  std::mutex m_mutex;
+  std::unordered_map<std::string, SharedRootSignatureDesc> m_descs;
+  std::unordered_map<std::string, CComPtr<IDxcBlob>> m_blobs;
+};
+
+// Created by RootSignatureCache::Initialize when the library is loaded.
+RootSignatureCacheImpl *g_pRootSignatureCache;
+
+// Key prefixes that keep the kinds of blobs apart in the cache.
+const char SerializedKeyPrefix = 'S';
+const char ReservedSpaceSerializedKeyPrefix = 'R';
+const char InternedKeyPrefix = 'I';
+const char CompiledKeyPrefix = 'T';
+
+// Keys compiled root signature text by version and by the text with runs of
+// white space collapsed to one space; tokens stay apart, and nothing else in
+// the text is changed.
+std::string GetCompiledKey(const char *pText, size_t TextSize,
+                           DxilRootSignatureVersion Version) {
+  std::string Key(1, CompiledKeyPrefix);
+  Key += (char)('0' + (unsigned)Version);
+  const size_t PrefixSize = Key.size();
+  bool bPendingSpace = false;
+  for (size_t i = 0; i < TextSize; ++i) {
+    char c = pText[i];
+    if (c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' ||
+        c == '\v') {
+      bPendingSpace = Key.size() > PrefixSize;
+      continue;
+    }
+    if (bPendingSpace) {
+      Key += ' ';
+      bPendingSpace = false;
+    }
+    Key += c;
+  }
+  return Key;
+}
+
+} // namespace
+
+_Use_decl_annotations_
+uint64_t HashRootSignature(const DxilVersionedRootSignatureDesc *pRootSignature) {
+  return HashCanonicalRootSignature(GetCanonicalRootSignature(pRootSignature));
+}
+
+_Use_decl_annotations_
+bool AreRootSignaturesEqual(const DxilVersionedRootSignatureDesc *pLHS,
+                            const DxilVersionedRootSignatureDesc *pRHS) {
+  if (pLHS == pRHS)
+    return true;
+  return GetCanonicalRootSignature(pLHS) == GetCanonicalRootSignature(pRHS);
+}
+
+namespace RootSignatureCache {
+
+_Use_decl_annotations_
+SharedRootSignatureDesc Deserialize(const void *pSrcData,
+                                    uint32_t SrcDataSizeInBytes) {
+  if (g_pRootSignatureCache == nullptr)
+    return DeserializeShared(pSrcData, SrcDataSizeInBytes);
+  IFTBOOL(pSrcData != nullptr && SrcDataSizeInBytes != 0, E_INVALIDARG);
+
+  // Cache storage is shared across compiler instances and their allocators.
+  DxcThreadMalloc TM(nullptr);
+  std::string Key((const char *)pSrcData, SrcDataSizeInBytes);
+  SharedRootSignatureDesc pDesc = g_pRootSignatureCache->FindDesc(Key);
+  if (pDesc)
+    return pDesc;
+  pDesc = DeserializeShared(pSrcData, SrcDataSizeInBytes);
+  return g_pRootSignatureCache->InsertDesc(Key, std::move(pDesc));
+}
+
+_Use_decl_annotations_
+void Serialize(const DxilVersionedRootSignatureDesc *pRootSignature,
+               IDxcBlob **ppBlob, IDxcBlobEncoding **ppErrorBlob,
+               bool bAllowReservedRegisterSpace) {
+  if (g_pRootSignatureCache == nullptr) {
+    SerializeRootSignature(pRootSignature, ppBlob, ppErrorBlob,
+                           bAllowReservedRegisterSpace);
+    return;
+  }
+  DXASSERT_NOMSG(ppBlob != nullptr);
+  DXASSERT_NOMSG(ppErrorBlob != nullptr);
+  *ppBlob = nullptr;
+  *ppErrorBlob = nullptr;
+
+  // Verification depends on whether reserved spaces are allowed.
+  std::string Key(1, bAllowReservedRegisterSpace
+                         ? ReservedSpaceSerializedKeyPrefix
+                         : SerializedKeyPrefix);
+  Key += GetCanonicalRootSignature(pRootSignature);
+  CComPtr<IDxcBlob> pBlob = g_pRootSignatureCache->FindBlob(Key);
+  if (pBlob == nullptr) {
+    SerializeRootSignature(pRootSignature, &pBlob, ppErrorBlob,
+                           bAllowReservedRegisterSpace);
+    if (pBlob == nullptr)
+      return;
+    DxcThreadMalloc TM(nullptr);
+    CComPtr<IDxcBlob> pCopy;
+    IFT(DxcCreateBlobOnHeapCopy(pBlob->GetBufferPointer(),
+                                pBlob->GetBufferSize(), &pCopy));
+    pBlob = g_pRootSignatureCache->InsertBlob(Key, pCopy);
+  }
+  *ppBlob = pBlob.Detach();
+}
+
+_Use_decl_annotations_
+void FindCompiled(const char *pText, size_t TextSize,
+                  DxilRootSignatureVersion Version, IDxcBlob **ppBlob) {
+  DXASSERT_NOMSG(ppBlob != nullptr);
+  *ppBlob = nullptr;
+  if (g_pRootSignatureCache == nullptr)
+    return;
+  DxcThreadMalloc TM(nullptr);
+  CComPtr<IDxcBlob> pBlob = g_pRootSignatureCache->FindBlob(
+      GetCompiledKey(pText, TextSize, Version));
+  *ppBlob = pBlob.Detach();
+}
+
+_Use_decl_annotations_
+void AddCompiled(const char *pText, size_t TextSize,
+                 DxilRootSignatureVersion Version, IDxcBlob *pBlob) {
+  DXASSERT_NOMSG(pBlob != nullptr);
+  if (g_pRootSignatureCache == nullptr)
+    return;
+  DxcThreadMalloc TM(nullptr);
+  g_pRootSignatureCache->InsertBlob(GetCompiledKey(pText, TextSize, Version),
+                                    pBlob);
+}
+
+_Use_decl_annotations_
+void Intern(const void *pSrcData, uint32_t SrcDataSizeInBytes,
+            IDxcBlob **ppInterned, uint64_t *pHash) {
+  DXASSERT_NOMSG(ppInterned != nullptr && pHash != nullptr);
+  *ppInterned = nullptr;
+  SharedRootSignatureDesc pDesc = Deserialize(pSrcData, SrcDataSizeInBytes);
+  std::string Canonical = GetCanonicalRootSignature(pDesc.get());
+  *pHash = HashCanonicalRootSignature(Canonical);
+  std::string Key = std::string(1, InternedKeyPrefix) + Canonical;
+
+  CComPtr<IDxcBlob> pBlob;
+  if (g_pRootSignatureCache != nullptr)
+    pBlob = g_pRootSignatureCache->FindBlob(Key);
+  if (pBlob == nullptr) {
+    DxcThreadMalloc TM(nullptr);
+    IFT(DxcCreateBlobOnHeapCopy(pSrcData, SrcDataSizeInBytes, &pBlob));
+    if (g_pRootSignatureCache != nullptr)
+      pBlob = g_pRootSignatureCache->InsertBlob(Key, pBlob);
+  }
+  *ppInterned = pBlob.Detach();
+}
+
+HRESULT Initialize() {
+  DXASSERT(g_pRootSignatureCache == nullptr, "else double-init");
+  DxcThreadMalloc TM(nullptr);
+  g_pRootSignatureCache = new (std::nothrow) RootSignatureCacheImpl();
+  return g_pRootSignatureCache ? S_OK : E_OUTOFMEMORY;
+}
+
+void Cleanup() {
+  DxcThreadMalloc TM(nullptr);
+  delete g_pRootSignatureCache;
+  g_pRootSignatureCache = nullptr;
+}
+
+} // namespace RootSignatureCache
+
 } // namespace hlsl
@@ -19,6 +19,86 @@ using std::string;
 
 namespace hlsl {
 
+// System value names are looked up in a perfect hash of the names without
+// their SV_ prefix, folded to lower case.
+// <py::lines('SEMANTIC-NAME-HASH')>hctdb_instrhelp.get_semantic_name_hash()</py>
+// SEMANTIC-NAME-HASH:BEGIN
+static const unsigned kSemanticNameHashSize = 64;
+
+static unsigned HashSemanticName(llvm::StringRef Name) {
+  return ((unsigned)Name.size() * 1 + ((unsigned char)Name[0] | 0x20) * 7 +
+          ((unsigned char)Name[1] | 0x20) * 22 + ((unsigned char)Name.back() | 0x20)) &
+         (kSemanticNameHashSize - 1);
+}
+
+static const DXIL::SemanticKind SemanticNameHashTable[kSemanticNameHashSize] = {
+  DXIL::SemanticKind::Invalid,
+  DXIL::SemanticKind::InstanceID,
+  DXIL::SemanticKind::DomainLocation,
+  DXIL::SemanticKind::Barycentrics,
+  DXIL::SemanticKind::Invalid,
+  DXIL::SemanticKind::InnerCoverage,
+  DXIL::SemanticKind::Invalid,
+  DXIL::SemanticKind::Invalid,
+  DXIL::SemanticKind::GroupID,
+  DXIL::SemanticKind::Invalid,
+  DXIL::SemanticKind::ViewPortArrayIndex,
+  DXIL::SemanticKind::PrimitiveID,
+  DXIL::SemanticKind::Invalid,
+  DXIL::SemanticKind::StencilRef,
+  DXIL::SemanticKind::GroupThreadID,
+  DXIL::SemanticKind::OutputControlPointID,
+  DXIL::SemanticKind::Position,
+  DXIL::SemanticKind::Invalid,
+  DXIL::SemanticKind::Invalid,
+  DXIL::SemanticKind::Invalid,
+  DXIL::SemanticKind::VertexID,
+  DXIL::SemanticKind::InsideTessFactor,
+  DXIL::SemanticKind::TessFactor,
+  DXIL::SemanticKind::Depth,
+  DXIL::SemanticKind::Invalid,
+  DXIL::SemanticKind::Invalid,
+  DXIL::SemanticKind::RenderTargetArrayIndex,
+  DXIL::SemanticKind::Invalid,
+  DXIL::SemanticKind::Invalid,
+  DXIL::SemanticKind::Invalid,
+  DXIL::SemanticKind::Invalid,
+  DXIL::SemanticKind::GroupIndex,
+  DXIL::SemanticKind::Invalid,
+  DXIL::SemanticKind::Invalid,
+  DXIL::SemanticKind::Invalid,
+  DXIL::SemanticKind::GSInstanceID,
+  DXIL::SemanticKind::DepthLessEqual,
+  DXIL::SemanticKind::Invalid,
+  DXIL::SemanticKind::Invalid,
+  DXIL::SemanticKind::DepthGreaterEqual,
+  DXIL::SemanticKind::Invalid,
+  DXIL::SemanticKind::Invalid,
+  DXIL::SemanticKind::ViewID,
+  DXIL::SemanticKind::Invalid,
+  DXIL::SemanticKind::Coverage,
+  DXIL::SemanticKind::Invalid,
+  DXIL::SemanticKind::ClipDistance,
+  DXIL::SemanticKind::Invalid,
+  DXIL::SemanticKind::Invalid,
+  DXIL::SemanticKind::IsFrontFace,
+  DXIL::SemanticKind::Invalid,
+  DXIL::SemanticKind::Invalid,
+  DXIL::SemanticKind::CullDistance,
+  DXIL::SemanticKind::Invalid,
+  DXIL::SemanticKind::DispatchThreadID,
+  DXIL::SemanticKind::Invalid,
+  DXIL::SemanticKind::Invalid,
+  DXIL::SemanticKind::Invalid,
+  DXIL::SemanticKind::Invalid,
+  DXIL::SemanticKind::Invalid,
+  DXIL::SemanticKind::Target,
+  DXIL::SemanticKind::Invalid,
+  DXIL::SemanticKind::SampleIndex,
+  DXIL::SemanticKind::Invalid,
+};
+// SEMANTIC-NAME-HASH:END
+
 //------------------------------------------------------------------------------
 //
 // Semantic class methods.
@@ -34,14 +114,15 @@ const Semantic *Semantic::GetByName(llvm::StringRef name) {
   if (!HasSVPrefix(name))
     return GetArbitrary();
 
-  // The search is a simple linear scan as it is fairly infrequent operation and the list is short.
-  // The search can be improved if linear traversal has inadequate performance.
-  for (unsigned i = (unsigned)Kind::Arbitrary + 1; i < (unsigned)Kind::Invalid; i++) {
-    if (name.compare_lower(ms_SemanticTable[i].m_pszName) == 0)
-      return &ms_SemanticTable[i];
-  }
-
-  return GetInvalid();
+  // The hash only picks a candidate; its name still has to match.
+  llvm::StringRef SVName = name.drop_front(3);
+  if (SVName.size() < 2)
+    return GetInvalid();
+  const Semantic &Candidate =
+      ms_SemanticTable[(unsigned)SemanticNameHashTable[HashSemanticName(SVName)]];
+  if (Candidate.IsInvalid() || name.compare_lower(Candidate.m_pszName) != 0)
+    return GetInvalid();
+  return &Candidate;
 }
 
 const Semantic *Semantic::GetByName(llvm::StringRef Name, DXIL::SigPointKind sigPointKind,
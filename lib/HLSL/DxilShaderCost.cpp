@@ -0,0 +1,490 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilShaderCost.cpp                                                        //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Estimates how expensive a shader is to run, without running it.           //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/HLSL/DxilShaderCost.h"
+#include "dxc/HLSL/DxilFunctionProps.h"
+#include "dxc/HLSL/DxilModule.h"
+#include "dxc/HLSL/DxilOperations.h"
+#include "DxilTargetTransformInfo.h"
+
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+using namespace hlsl;
+
+namespace {
+
+// Loops are only simulated this far; longer ones get the assumed count.
+const unsigned kMaxTripCount = 4096;
+
+DxilCostCategory GetDxilOpCategory(DXIL::OpCode opcode) {
+  switch (opcode) {
+  case DXIL::OpCode::Acos:
+  case DXIL::OpCode::Asin:
+  case DXIL::OpCode::Atan:
+  case DXIL::OpCode::Cos:
+  case DXIL::OpCode::Exp:
+  case DXIL::OpCode::Hcos:
+  case DXIL::OpCode::Hsin:
+  case DXIL::OpCode::Htan:
+  case DXIL::OpCode::Log:
+  case DXIL::OpCode::Rsqrt:
+  case DXIL::OpCode::Sin:
+  case DXIL::OpCode::Sqrt:
+  case DXIL::OpCode::Tan:
+    return DxilCostCategory::Transcendental;
+  case DXIL::OpCode::Sample:
+  case DXIL::OpCode::SampleBias:
+  case DXIL::OpCode::SampleLevel:
+  case DXIL::OpCode::SampleGrad:
+  case DXIL::OpCode::SampleCmp:
+  case DXIL::OpCode::SampleCmpLevelZero:
+  case DXIL::OpCode::TextureGather:
+  case DXIL::OpCode::TextureGatherCmp:
+  case DXIL::OpCode::TextureLoad:
+  case DXIL::OpCode::TextureStore:
+  case DXIL::OpCode::CalculateLOD:
+    return DxilCostCategory::Texture;
+  case DXIL::OpCode::BufferLoad:
+  case DXIL::OpCode::BufferStore:
+  case DXIL::OpCode::BufferUpdateCounter:
+  case DXIL::OpCode::CBufferLoad:
+  case DXIL::OpCode::CBufferLoadLegacy:
+    return DxilCostCategory::Buffer;
+  case DXIL::OpCode::AtomicBinOp:
+  case DXIL::OpCode::AtomicCompareExchange:
+    return DxilCostCategory::Atomic;
+  case DXIL::OpCode::Barrier:
+    return DxilCostCategory::Barrier;
+  default:
+    if (OP::IsDxilOpWave(opcode))
+      return DxilCostCategory::Wave;
+    return DxilCostCategory::ALU;
+  }
+}
+
+bool IsUnsignedDxilOp(DXIL::OpCode opcode) {
+  switch (opcode) {
+  case DXIL::OpCode::UDiv:
+  case DXIL::OpCode::UMul:
+  case DXIL::OpCode::UMax:
+  case DXIL::OpCode::UMin:
+  case DXIL::OpCode::UAddc:
+  case DXIL::OpCode::USubb:
+  case DXIL::OpCode::UMad:
+  case DXIL::OpCode::Ubfe:
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool IsUnsignedInst(const Instruction &I) {
+  switch (I.getOpcode()) {
+  case Instruction::UDiv:
+  case Instruction::URem:
+  case Instruction::LShr:
+  case Instruction::ZExt:
+  case Instruction::UIToFP:
+    return true;
+  case Instruction::ICmp:
+    return cast<ICmpInst>(I).isUnsigned();
+  default:
+    return false;
+  }
+}
+
+void CountDxilOp(DXIL::OpCode opcode, DxilShaderCost &Cost) {
+  switch (opcode) {
+  case DXIL::OpCode::Sample:
+  case DXIL::OpCode::SampleLevel:
+  case DXIL::OpCode::TextureGather:
+    Cost.TextureSamples++;
+    break;
+  case DXIL::OpCode::SampleBias:
+    Cost.TextureBiasSamples++;
+    break;
+  case DXIL::OpCode::SampleGrad:
+    Cost.TextureGradientSamples++;
+    break;
+  case DXIL::OpCode::SampleCmp:
+  case DXIL::OpCode::SampleCmpLevelZero:
+  case DXIL::OpCode::TextureGatherCmp:
+    Cost.TextureCompareSamples++;
+    break;
+  case DXIL::OpCode::TextureLoad:
+  case DXIL::OpCode::BufferLoad:
+    Cost.TextureLoads++;
+    break;
+  case DXIL::OpCode::TextureStore:
+  case DXIL::OpCode::BufferStore:
+    Cost.TextureStores++;
+    break;
+  case DXIL::OpCode::EmitStream:
+    Cost.EmitOps++;
+    break;
+  case DXIL::OpCode::CutStream:
+    Cost.CutOps++;
+    break;
+  case DXIL::OpCode::EmitThenCutStream:
+    Cost.EmitOps++;
+    Cost.CutOps++;
+    break;
+  default:
+    break;
+  }
+}
+
+// Returns the number of times the body of L runs if it counts with a
+// constant start, step and bound, or 0 if it doesn't.
+unsigned GetConstantTripCount(Loop *L) {
+  BasicBlock *Preheader = L->getLoopPreheader();
+  BasicBlock *Latch = L->getLoopLatch();
+  BasicBlock *Exiting = L->getExitingBlock();
+  if (!Preheader || !Latch || !Exiting)
+    return 0;
+  BranchInst *BI = dyn_cast<BranchInst>(Exiting->getTerminator());
+  if (!BI || !BI->isConditional())
+    return 0;
+  ICmpInst *Cmp = dyn_cast<ICmpInst>(BI->getCondition());
+  if (!Cmp)
+    return 0;
+  ConstantInt *Bound = dyn_cast<ConstantInt>(Cmp->getOperand(1));
+  if (!Bound)
+    return 0;
+
+  // The compare tests the counter, or its next value.
+  Value *Tested = Cmp->getOperand(0);
+  PHINode *Counter = dyn_cast<PHINode>(Tested);
+  if (!Counter) {
+    if (BinaryOperator *Inc = dyn_cast<BinaryOperator>(Tested))
+      Counter = dyn_cast<PHINode>(Inc->getOperand(0));
+  }
+  if (!Counter || Counter->getParent() != L->getHeader() ||
+      Counter->getNumIncomingValues() != 2)
+    return 0;
+  ConstantInt *Start =
+      dyn_cast<ConstantInt>(Counter->getIncomingValueForBlock(Preheader));
+  BinaryOperator *Next =
+      dyn_cast<BinaryOperator>(Counter->getIncomingValueForBlock(Latch));
+  if (!Start || !Next || Next->getOpcode() != Instruction::Add ||
+      Next->getOperand(0) != Counter)
+    return 0;
+  if (Tested != Counter && Tested != Next)
+    return 0;
+  ConstantInt *Step = dyn_cast<ConstantInt>(Next->getOperand(1));
+  if (!Step)
+    return 0;
+
+  bool ExitOnTrue = !L->contains(BI->getSuccessor(0));
+  Constant *Current = Start;
+  for (unsigned Trips = 1; Trips <= kMaxTripCount; ++Trips) {
+    Constant *NextValue = ConstantExpr::getAdd(Current, Step);
+    Constant *Result = ConstantExpr::getICmp(
+        Cmp->getPredicate(), Tested == Next ? NextValue : Current, Bound);
+    if (Result->isOneValue() == ExitOnTrue)
+      return Trips;
+    Current = NextValue;
+  }
+  return 0;
+}
+
+// Number of scalar registers a value of type Ty takes.
+unsigned GetComponentCount(Type *Ty) {
+  if (Ty->isVectorTy())
+    return Ty->getVectorNumElements();
+  if (StructType *ST = dyn_cast<StructType>(Ty))
+    return ST->getNumElements();
+  if (Ty->isArrayTy())
+    return Ty->getArrayNumElements();
+  return 1;
+}
+
+bool IsRegisterValue(const Value *V) {
+  const Instruction *I = dyn_cast<Instruction>(V);
+  return I && !I->getType()->isVoidTy() && !isa<AllocaInst>(I);
+}
+
+// Finds the most scalar values live at once, with a backward liveness
+// analysis over the blocks of F.
+unsigned GetMaxLiveValues(Function &F) {
+  DenseMap<const Value *, unsigned> ValueIdx;
+  SmallVector<unsigned, 64> ValueSize;
+  for (BasicBlock &BB : F) {
+    for (Instruction &I : BB) {
+      if (!IsRegisterValue(&I))
+        continue;
+      ValueIdx[&I] = ValueSize.size();
+      ValueSize.push_back(GetComponentCount(I.getType()));
+    }
+  }
+  if (ValueSize.empty())
+    return 0;
+
+  unsigned NumValues = ValueSize.size();
+  DenseMap<BasicBlock *, unsigned> BlockIdx;
+  unsigned NumBlocks = 0;
+  for (BasicBlock &BB : F)
+    BlockIdx[&BB] = NumBlocks++;
+  std::vector<BitVector> UpwardUses(NumBlocks, BitVector(NumValues));
+  std::vector<BitVector> Defs(NumBlocks, BitVector(NumValues));
+  std::vector<BitVector> LiveIn(NumBlocks, BitVector(NumValues));
+  std::vector<BitVector> LiveOut(NumBlocks, BitVector(NumValues));
+
+  for (BasicBlock &BB : F) {
+    unsigned B = BlockIdx[&BB];
+    for (Instruction &I : BB) {
+      if (PHINode *Phi = dyn_cast<PHINode>(&I)) {
+        // Phi operands are live out of the incoming block.
+        for (unsigned i = 0; i < Phi->getNumIncomingValues(); ++i) {
+          auto It = ValueIdx.find(Phi->getIncomingValue(i));
+          if (It != ValueIdx.end())
+            LiveOut[BlockIdx[Phi->getIncomingBlock(i)]].set(It->second);
+        }
+      } else {
+        for (Value *Op : I.operands()) {
+          auto It = ValueIdx.find(Op);
+          if (It != ValueIdx.end() && !Defs[B].test(It->second))
+            UpwardUses[B].set(It->second);
+        }
+      }
+      auto It = ValueIdx.find(&I);
+      if (It != ValueIdx.end())
+        Defs[B].set(It->second);
+    }
+  }
+
+  bool Changed = true;
+  while (Changed) {
+    Changed = false;
+    for (BasicBlock &BB : F) {
+      unsigned B = BlockIdx[&BB];
+      for (BasicBlock *Succ : successors(&BB))
+        LiveOut[B] |= LiveIn[BlockIdx[Succ]];
+      BitVector In = LiveOut[B];
+      In.reset(Defs[B]);
+      In |= UpwardUses[B];
+      if (In != LiveIn[B]) {
+        LiveIn[B] = In;
+        Changed = true;
+      }
+    }
+  }
+
+  unsigned MaxLive = 0;
+  for (BasicBlock &BB : F) {
+    BitVector Live = LiveOut[BlockIdx[&BB]];
+    unsigned Size = 0;
+    for (int i = Live.find_first(); i >= 0; i = Live.find_next(i))
+      Size += ValueSize[i];
+    MaxLive = std::max(MaxLive, Size);
+    for (auto I = BB.rbegin(), E = BB.rend(); I != E; ++I) {
+      auto It = ValueIdx.find(&*I);
+      if (It != ValueIdx.end() && Live.test(It->second)) {
+        Live.reset(It->second);
+        Size -= ValueSize[It->second];
+      }
+      if (isa<PHINode>(*I))
+        continue;
+      for (Value *Op : I->operands()) {
+        auto OpIt = ValueIdx.find(Op);
+        if (OpIt != ValueIdx.end() && !Live.test(OpIt->second)) {
+          Live.set(OpIt->second);
+          Size += ValueSize[OpIt->second];
+        }
+      }
+      MaxLive = std::max(MaxLive, Size);
+    }
+  }
+  return MaxLive;
+}
+
+bool IsUsedIn(const Value *V, const Function &F) {
+  for (const User *U : V->users()) {
+    if (const Instruction *I = dyn_cast<Instruction>(U)) {
+      if (I->getParent()->getParent() == &F)
+        return true;
+    } else if (isa<ConstantExpr>(U) && IsUsedIn(U, F)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+unsigned GetGroupSharedBytes(Function &F) {
+  Module &M = *F.getParent();
+  const DataLayout &DL = M.getDataLayout();
+  unsigned Bytes = 0;
+  for (GlobalVariable &GV : M.globals()) {
+    if (GV.getType()->getPointerAddressSpace() == DXIL::kTGSMAddrSpace &&
+        IsUsedIn(&GV, F))
+      Bytes += DL.getTypeAllocSize(GV.getType()->getElementType());
+  }
+  return Bytes;
+}
+
+void PrintShaderCost(StringRef Name, const DxilShaderCost &Cost,
+                     raw_ostream &OS, const char *comment) {
+  static const char *CategoryNames[] = {
+      "alu", "transcendental", "texture", "buffer", "wave", "atomic",
+      "barrier"};
+  static_assert(array_lengthof(CategoryNames) == DxilShaderCost::kNumCategories,
+                "else category names are out of date");
+
+  OS << comment << " Estimated cost of " << Name << ":\n";
+  OS << comment << "\n";
+  OS << comment << format(" %-16s %10s %12s\n", "Operation", "Static",
+                          "Dynamic");
+  OS << comment << " ---------------- ---------- ------------\n";
+  for (unsigned i = 0; i < DxilShaderCost::kNumCategories; ++i) {
+    OS << comment
+       << format(" %-16s %10u %12llu\n", CategoryNames[i], Cost.StaticOps[i],
+                 (unsigned long long)Cost.DynamicOps[i]);
+  }
+  OS << comment << "\n";
+  OS << comment << " weighted cost: " << Cost.WeightedCost << "\n";
+  OS << comment << " loops: " << Cost.Loops;
+  if (Cost.LoopsWithAssumedTripCount)
+    OS << " (" << Cost.LoopsWithAssumedTripCount
+       << " assumed to run " << DxilShaderCost::kAssumedTripCount
+       << " times)";
+  OS << "\n";
+  OS << comment << " groupshared bytes: " << Cost.GroupSharedBytes << "\n";
+  OS << comment << " max live values: " << Cost.MaxLiveValues << "\n";
+  OS << comment << "\n";
+}
+
+} // namespace
+
+namespace hlsl {
+
+void EstimateShaderCost(Function &F, DxilShaderCost &Cost) {
+  DominatorTree DT;
+  DT.recalculate(F);
+  LoopInfo LI;
+  LI.Analyze(DT);
+
+  // Trip count of each loop, times those of the loops around it.
+  DenseMap<Loop *, uint64_t> LoopWeight;
+  SmallVector<Loop *, 8> Worklist(LI.begin(), LI.end());
+  while (!Worklist.empty()) {
+    Loop *L = Worklist.pop_back_val();
+    Worklist.append(L->begin(), L->end());
+    unsigned Trips = GetConstantTripCount(L);
+    Cost.Loops++;
+    if (Trips == 0) {
+      Trips = DxilShaderCost::kAssumedTripCount;
+      Cost.LoopsWithAssumedTripCount++;
+    }
+    uint64_t Weight = Trips;
+    if (Loop *Parent = L->getParentLoop())
+      Weight *= LoopWeight[Parent];
+    LoopWeight[L] = Weight;
+  }
+
+  for (BasicBlock &BB : F) {
+    uint64_t Weight = 1;
+    if (Loop *L = LI.getLoopFor(&BB))
+      Weight = LoopWeight[L];
+
+    for (Instruction &I : BB) {
+      if (isa<PHINode>(I) || isa<DbgInfoIntrinsic>(I) || isa<AllocaInst>(I) ||
+          isa<ReturnInst>(I))
+        continue;
+      if (BranchInst *BI = dyn_cast<BranchInst>(&I)) {
+        if (BI->isConditional())
+          Cost.ConditionalBranches++;
+        else
+          Cost.UnconditionalBranches++;
+        continue;
+      }
+      if (isa<SwitchInst>(I)) {
+        Cost.ConditionalBranches++;
+        continue;
+      }
+
+      DxilCostCategory Category = DxilCostCategory::ALU;
+      unsigned InstCost = TargetTransformInfo::TCC_Basic;
+      if (OP::IsDxilOpFuncCallInst(&I)) {
+        DXIL::OpCode opcode = OP::GetDxilOpFuncCallInst(&I);
+        Category = GetDxilOpCategory(opcode);
+        InstCost = DxilTTIImpl::getDxilOpCost(opcode);
+        CountDxilOp(opcode, Cost);
+        if (Category == DxilCostCategory::ALU) {
+          if (I.getType()->isFPOrFPVectorTy())
+            Cost.FloatOps++;
+          else if (IsUnsignedDxilOp(opcode))
+            Cost.UintOps++;
+          else if (I.getType()->isIntOrIntVectorTy())
+            Cost.IntOps++;
+        }
+      } else if (I.getType()->isFPOrFPVectorTy() ||
+                 (I.getNumOperands() &&
+                  I.getOperand(0)->getType()->isFPOrFPVectorTy())) {
+        Cost.FloatOps++;
+      } else if (I.getType()->isIntOrIntVectorTy()) {
+        if (IsUnsignedInst(I))
+          Cost.UintOps++;
+        else
+          Cost.IntOps++;
+      }
+
+      Cost.Instructions++;
+      Cost.StaticOps[(unsigned)Category]++;
+      Cost.DynamicOps[(unsigned)Category] += Weight;
+      Cost.WeightedCost += Weight * InstCost;
+    }
+  }
+
+  Cost.GroupSharedBytes = GetGroupSharedBytes(F);
+  Cost.MaxLiveValues = GetMaxLiveValues(F);
+}
+
+void PrintShaderCosts(DxilModule &DM, raw_ostream &OS, const char *comment) {
+  SmallVector<Function *, 4> Entries;
+  if (DM.GetShaderModel()->IsLib()) {
+    for (Function &F : DM.GetModule()->functions()) {
+      if (F.isDeclaration() || !DM.HasDxilFunctionProps(&F))
+        continue;
+      Entries.push_back(&F);
+      DxilFunctionProps &Props = DM.GetDxilFunctionProps(&F);
+      if (Props.IsHS() && Props.ShaderProps.HS.patchConstantFunc)
+        Entries.push_back(Props.ShaderProps.HS.patchConstantFunc);
+    }
+  } else {
+    if (Function *F = DM.GetEntryFunction())
+      Entries.push_back(F);
+    if (Function *F = DM.GetPatchConstantFunction())
+      Entries.push_back(F);
+  }
+
+  for (Function *F : Entries) {
+    if (F->isDeclaration())
+      continue;
+    DxilShaderCost Cost;
+    EstimateShaderCost(*F, Cost);
+    PrintShaderCost(F->getName(), Cost, OS, comment);
+  }
+}
+
+} // namespace hlsl
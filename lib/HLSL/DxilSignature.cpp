@@ -12,6 +12,9 @@
 #include "dxc/HLSL/DxilSignatureAllocator.h"
 #include "dxc/HLSL/DxilSigPoint.h"
 #include "llvm/ADT/STLExtras.h"
+#include <functional>
+#include <mutex>
+#include <unordered_map>
 
 using std::vector;
 using std::unique_ptr;
@@ -99,6 +102,81 @@ static bool ShouldBeAllocated(const DxilSignatureElement *SE) {
   return true;
 }
 
+// Every compile that packs a signature looks here, so entries are spread
+// over shards with their own locks, keeping concurrent compiles from
+// waiting on each other.
+class SignaturePackingCacheImpl {
+public:
+  static const size_t ShardCount = 16;
+  // Bound on the number of entries of a shard; the shard starts over once it
+  // is reached.
+  static const size_t MaxEntriesPerShard = 256;
+
+  struct Result {
+    unsigned RowsUsed;
+    // Start row and column of each packed element, in packing order.
+    std::vector<std::pair<uint32_t, uint32_t> > Locations;
+  };
+
+  bool Find(const std::string &Key, Result &R) {
+    Shard &S = GetShard(Key);
+    std::lock_guard<std::mutex> lock(S.Mutex);
+    auto it = S.Results.find(Key);
+    if (it == S.Results.end())
+      return false;
+    R = it->second;
+    return true;
+  }
+  void Insert(const std::string &Key, const Result &R) {
+    Shard &S = GetShard(Key);
+    std::lock_guard<std::mutex> lock(S.Mutex);
+    if (S.Results.size() >= MaxEntriesPerShard)
+      S.Results.clear();
+    S.Results[Key] = R;
+  }
+
+private:
+  struct Shard {
+    std::mutex Mutex;
+    std::unordered_map<std::string, Result> Results;
+  };
+  Shard m_shards[ShardCount];
+
+  Shard &GetShard(const std::string &Key) {
+    return m_shards[std::hash<std::string>()(Key) % ShardCount];
+  }
+};
+
+// Created by SignaturePackingCache::Initialize when the library is loaded.
+SignaturePackingCacheImpl *g_pPackingCache;
+
+void AppendKey(std::string &Key, uint32_t Value) {
+  Key.append((const char *)&Value, sizeof(Value));
+}
+
+// Everything the allocator reads from an element, in packing order; the
+// current location is cleared before packing, so it is left out.
+std::string GetPackingKey(DXIL::SigPointKind sigPointKind,
+                          DXIL::PackingStrategy packing,
+                          bool useMinPrecision,
+                          std::vector<DxilPackElement> &packElements) {
+  std::string Key;
+  AppendKey(Key, (uint32_t)sigPointKind);
+  AppendKey(Key, (uint32_t)packing);
+  AppendKey(Key, useMinPrecision ? 1 : 0);
+  for (auto &SE : packElements) {
+    AppendKey(Key, SE.GetID());
+    AppendKey(Key, (uint32_t)SE.GetKind());
+    AppendKey(Key, (uint32_t)SE.GetInterpolationMode());
+    AppendKey(Key, (uint32_t)SE.GetInterpretation());
+    AppendKey(Key, (uint32_t)SE.GetDataBitWidth());
+    AppendKey(Key, SE.GetRows());
+    AppendKey(Key, SE.GetCols());
+    AppendKey(Key, SE.Get()->GetOutputStream());
+  }
+  return Key;
+}
+
 } // anonymous namespace
 
 
@@ -122,8 +200,6 @@ unsigned DxilSignature::NumVectorsUsed(unsigned streamIndex) const {
 }
 
 unsigned DxilSignature::PackElements(DXIL::PackingStrategy packing) {
-  unsigned rowsUsed = 0;
-
   // Transfer to elements derived from DxilSignatureAllocator::PackElement
   std::vector<DxilPackElement> packElements;
   for (auto &SE : m_Elements) {
@@ -131,6 +207,46 @@ unsigned DxilSignature::PackElements(DXIL::PackingStrategy packing) {
       packElements.emplace_back(SE.get(), m_UseMinPrecision);
   }
 
+  // Only results of the allocator are worth caching; the other packing
+  // kinds assign rows in a single pass.
+  DXIL::PackingKind PK = SigPoint::GetSigPoint(m_sigPointKind)->GetPackingKind();
+  bool bCacheable = g_pPackingCache != nullptr && !packElements.empty() &&
+                    (m_sigPointKind == DXIL::SigPointKind::GSOut ||
+                     PK == DXIL::PackingKind::Vertex ||
+                     PK == DXIL::PackingKind::PatchConstant);
+  if (!bCacheable)
+    return PackElements(packElements, packing);
+
+  // Cache storage is shared across compiler instances and their allocators,
+  // so the key and result are allocated from, and freed to, the default
+  // allocator: TM must outlive them. Packing itself runs under the compile's
+  // allocator.
+  DxcThreadMalloc TM(nullptr);
+  std::string Key =
+      GetPackingKey(m_sigPointKind, packing, m_UseMinPrecision, packElements);
+  SignaturePackingCacheImpl::Result R;
+  if (g_pPackingCache->Find(Key, R)) {
+    DXASSERT_NOMSG(R.Locations.size() == packElements.size());
+    for (unsigned i = 0; i < packElements.size(); ++i)
+      packElements[i].SetLocation(R.Locations[i].first, R.Locations[i].second);
+    return R.RowsUsed;
+  }
+
+  {
+    DxcThreadMalloc CompileTM(TM.pPrior);
+    R.RowsUsed = PackElements(packElements, packing);
+  }
+  R.Locations.reserve(packElements.size());
+  for (auto &SE : packElements)
+    R.Locations.emplace_back(SE.GetStartRow(), SE.GetStartCol());
+  g_pPackingCache->Insert(Key, R);
+  return R.RowsUsed;
+}
+
+unsigned DxilSignature::PackElements(std::vector<DxilPackElement> &packElements,
+                                     DXIL::PackingStrategy packing) {
+  unsigned rowsUsed = 0;
+
   if (m_sigPointKind == DXIL::SigPointKind::GSOut) {
     // Special case due to support for multiple streams
     DxilSignatureAllocator alloc[4] = {{32, UseMinPrecision()},
@@ -222,6 +338,23 @@ unsigned DxilSignature::PackElements(DXIL::PackingStrategy packing) {
   return rowsUsed;
 }
 
+namespace SignaturePackingCache {
+
+bool Initialize() {
+  DXASSERT(g_pPackingCache == nullptr, "else double-init");
+  DxcThreadMalloc TM(nullptr);
+  g_pPackingCache = new (std::nothrow) SignaturePackingCacheImpl();
+  return g_pPackingCache != nullptr;
+}
+
+void Cleanup() {
+  DxcThreadMalloc TM(nullptr);
+  delete g_pPackingCache;
+  g_pPackingCache = nullptr;
+}
+
+} // namespace SignaturePackingCache
+
 //------------------------------------------------------------------------------
 //
 // EntrySingnature methods.
@@ -0,0 +1,201 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilSinkResourceReads.cpp                                                 //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Moves resource reads next to their uses where they would otherwise keep   //
+// too many registers live.                                                  //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/HLSL/DxilGenerationPass.h"
+#include "dxc/HLSL/DxilOperations.h"
+#include "DxilTargetTransformInfo.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Pass.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace llvm;
+using namespace hlsl;
+
+///////////////////////////////////////////////////////////////////////////////
+// Sink resource reads.
+
+namespace {
+// Samples, gathers and loads are issued wherever the optimizer left them,
+// often hoisted well ahead of their uses. Issuing early hides their latency,
+// but every component read stays live until its last use. In blocks where the
+// live components are estimated to exceed what DxilTTIImpl budgets for, each
+// read is moved down to its first use instead.
+//
+// Reads only move within their block and never past an instruction that may
+// write memory, so they see the same values and run under the same control
+// flow, which also keeps implicit derivatives intact.
+class DxilSinkResourceReads : public FunctionPass {
+public:
+  static char ID; // Pass identification, replacement for typeid
+  explicit DxilSinkResourceReads() : FunctionPass(ID) {}
+
+  const char *getPassName() const override {
+    return "DXIL sink resource reads";
+  }
+
+  bool runOnFunction(Function &F) override {
+    bool bChanged = false;
+    for (BasicBlock &BB : F)
+      bChanged |= SinkReads(BB);
+    return bChanged;
+  }
+
+private:
+  bool SinkReads(BasicBlock &BB);
+  unsigned EstimatePeakLiveComponents(BasicBlock &BB,
+                                      ArrayRef<CallInst *> Reads);
+  bool SinkRead(CallInst *Read);
+};
+
+char DxilSinkResourceReads::ID = 0;
+
+bool IsResourceRead(Instruction *I) {
+  return OP::IsDxilOpFuncCallInst(I) &&
+         DxilTTIImpl::isResourceRead(OP::GetDxilOpFuncCallInst(I));
+}
+
+// Whether U extracts a component of the read, in the read's block.
+bool IsComponentOf(Instruction *U, CallInst *Read) {
+  return isa<ExtractValueInst>(U) && U->getOperand(0) == Read &&
+         U->getParent() == Read->getParent();
+}
+}
+
+bool DxilSinkResourceReads::SinkReads(BasicBlock &BB) {
+  SmallVector<CallInst *, 16> Reads;
+  for (Instruction &I : BB) {
+    if (IsResourceRead(&I))
+      Reads.push_back(cast<CallInst>(&I));
+  }
+  if (Reads.empty())
+    return false;
+
+  // Issuing reads early is the better schedule unless it runs out of
+  // registers.
+  if (EstimatePeakLiveComponents(BB, Reads) <=
+      DxilTTIImpl::MaxLiveReadComponents)
+    return false;
+
+  bool bChanged = false;
+  for (CallInst *Read : Reads)
+    bChanged |= SinkRead(Read);
+  return bChanged;
+}
+
+// Each use of a read extracts one component, which is live from the read to
+// its last use in the block, or to the end of the block when it is used past
+// it.
+unsigned
+DxilSinkResourceReads::EstimatePeakLiveComponents(BasicBlock &BB,
+                                                  ArrayRef<CallInst *> Reads) {
+  DenseMap<Instruction *, unsigned> Position;
+  unsigned End = 0;
+  for (Instruction &I : BB)
+    Position[&I] = End++;
+
+  auto LastUse = [&](Instruction *I) {
+    unsigned Last = Position[I];
+    for (User *U : I->users()) {
+      Instruction *UI = cast<Instruction>(U);
+      if (UI->getParent() != &BB || isa<PHINode>(UI))
+        return End;
+      Last = std::max(Last, Position[UI]);
+    }
+    return Last;
+  };
+
+  // Live component count changes, by position.
+  std::vector<int> Delta(End + 1, 0);
+  for (CallInst *Read : Reads) {
+    for (User *U : Read->users()) {
+      Instruction *UI = cast<Instruction>(U);
+      unsigned Last;
+      if (UI->getParent() != &BB || isa<PHINode>(UI))
+        Last = End;
+      else if (IsComponentOf(UI, Read))
+        Last = LastUse(UI);
+      else
+        Last = Position[UI];
+      ++Delta[Position[Read]];
+      --Delta[Last];
+    }
+  }
+
+  int Live = 0;
+  unsigned Peak = 0;
+  for (int D : Delta) {
+    Live += D;
+    Peak = std::max(Peak, (unsigned)Live);
+  }
+  return Peak;
+}
+
+// Moves the read and its extracted components to just before the first
+// instruction that uses any of them.
+bool DxilSinkResourceReads::SinkRead(CallInst *Read) {
+  BasicBlock *BB = Read->getParent();
+  SmallVector<Instruction *, 4> Components;
+  for (BasicBlock::iterator It = std::next(BasicBlock::iterator(Read)),
+                            E = BB->end();
+       It != E; ++It) {
+    Instruction *I = It;
+    if (IsComponentOf(I, Read))
+      Components.push_back(I);
+  }
+
+  auto IsUsed = [&](Instruction *I) {
+    for (Value *Op : I->operands()) {
+      if (Op == Read)
+        return true;
+      if (Instruction *OpI = dyn_cast<Instruction>(Op)) {
+        if (IsComponentOf(OpI, Read))
+          return true;
+      }
+    }
+    return false;
+  };
+
+  Instruction *Target = nullptr;
+  bool bMovesPastOthers = false;
+  for (BasicBlock::iterator It = std::next(BasicBlock::iterator(Read)),
+                            E = BB->end();
+       It != E; ++It) {
+    Instruction *I = It;
+    if (IsComponentOf(I, Read))
+      continue;
+    if (IsUsed(I) || I->mayHaveSideEffects() || isa<TerminatorInst>(I)) {
+      Target = I;
+      break;
+    }
+    bMovesPastOthers = true;
+  }
+  if (!Target || !bMovesPastOthers)
+    return false;
+
+  Read->moveBefore(Target);
+  // Keep the components in their order, right after the read.
+  for (Instruction *C : Components)
+    C->moveBefore(Target);
+  return true;
+}
+
+FunctionPass *llvm::createDxilSinkResourceReadsPass() {
+  return new DxilSinkResourceReads();
+}
+
+INITIALIZE_PASS(DxilSinkResourceReads, "hlsl-dxil-sink-resource-reads",
+                "DXIL sink resource reads", false, false)
@@ -9,14 +9,19 @@
 //
 // \file
 // This file implements a TargetTransformInfo analysis pass specific to the
-// DXIL. Only implemented isSourceOfDivergence for DivergenceAnalysis.
+// DXIL. Implements isSourceOfDivergence for DivergenceAnalysis, and prices
+// DXIL operations for the loop unroller.
 //
 //===----------------------------------------------------------------------===//
 
 #include "DxilTargetTransformInfo.h"
 #include "dxc/HLSL/DxilModule.h"
 #include "dxc/HLSL/DxilOperations.h"
+#include "dxc/HLSL/DxilGenerationPass.h"
+#include "llvm/Analysis/LoopInfo.h"
 #include "llvm/CodeGen/BasicTTIImpl.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Support/Debug.h"
 
 using namespace llvm;
 using namespace hlsl;
@@ -30,9 +35,10 @@ cl::opt<unsigned>
                                     cl::Hidden);
 
 DxilTTIImpl::DxilTTIImpl(const TargetMachine *TM, const Function &F,
-                         hlsl::DxilModule &DM, bool ThreadGroup)
-    : BaseT(TM, F.getParent()->getDataLayout()), m_pHlslOP(DM.GetOP()),
-      m_isThreadGroup(ThreadGroup) {}
+                         hlsl::DxilModule &DM, bool ThreadGroup,
+                         unsigned UnrollBudget)
+    : BaseT(F.getParent()->getDataLayout()), m_pHlslOP(DM.GetOP()),
+      m_isThreadGroup(ThreadGroup), m_unrollBudget(UnrollBudget) {}
 
 namespace {
 bool IsDxilOpSourceOfDivergence(const CallInst *CI, OP *hlslOP,
@@ -94,3 +100,133 @@ bool DxilTTIImpl::isSourceOfDivergence(const Value *V) const {
 
   return false;
 }
+
+namespace {
+// Costs of DXIL operations, relative to TTI::TCC_Basic.
+// Sampling and gathering pay for filtering on top of the texture fetch.
+const unsigned kDxilSampleCost = 8;
+// Other resource reads and writes, and atomics, go through memory.
+const unsigned kDxilResourceAccessCost = TargetTransformInfo::TCC_Expensive;
+// Wave and quad operations exchange values across lanes.
+const unsigned kDxilCrossLaneCost = TargetTransformInfo::TCC_Expensive;
+}
+
+bool DxilTTIImpl::isResourceRead(DXIL::OpCode opcode) {
+  switch (opcode) {
+  case DXIL::OpCode::Sample:
+  case DXIL::OpCode::SampleBias:
+  case DXIL::OpCode::SampleLevel:
+  case DXIL::OpCode::SampleGrad:
+  case DXIL::OpCode::SampleCmp:
+  case DXIL::OpCode::SampleCmpLevelZero:
+  case DXIL::OpCode::TextureGather:
+  case DXIL::OpCode::TextureGatherCmp:
+  case DXIL::OpCode::TextureLoad:
+  case DXIL::OpCode::BufferLoad:
+    return true;
+  default:
+    return false;
+  }
+}
+
+unsigned DxilTTIImpl::getDxilOpCost(DXIL::OpCode opcode) {
+  switch (opcode) {
+  case DXIL::OpCode::Sample:
+  case DXIL::OpCode::SampleBias:
+  case DXIL::OpCode::SampleLevel:
+  case DXIL::OpCode::SampleGrad:
+  case DXIL::OpCode::SampleCmp:
+  case DXIL::OpCode::SampleCmpLevelZero:
+  case DXIL::OpCode::TextureGather:
+  case DXIL::OpCode::TextureGatherCmp:
+    return kDxilSampleCost;
+  case DXIL::OpCode::TextureLoad:
+  case DXIL::OpCode::TextureStore:
+  case DXIL::OpCode::BufferLoad:
+  case DXIL::OpCode::BufferStore:
+  case DXIL::OpCode::BufferUpdateCounter:
+  case DXIL::OpCode::AtomicBinOp:
+  case DXIL::OpCode::AtomicCompareExchange:
+    return kDxilResourceAccessCost;
+  default:
+    if (OP::IsDxilOpWave(opcode))
+      return kDxilCrossLaneCost;
+    // The opcode argument is an immediate, not an operand to materialize.
+    return TargetTransformInfo::TCC_Basic;
+  }
+}
+
+unsigned DxilTTIImpl::getCallCost(const Function *F,
+                                  ArrayRef<const Value *> Arguments) {
+  if (!OP::IsDxilOpFunc(F))
+    return BaseT::getCallCost(F, Arguments);
+  const ConstantInt *opArg = dyn_cast<ConstantInt>(Arguments[0]);
+  if (!opArg)
+    return BaseT::getCallCost(F, Arguments);
+  return getDxilOpCost((DXIL::OpCode)opArg->getLimitedValue());
+}
+
+void DxilTTIImpl::getUnrollingPreferences(Loop *L,
+                                          TTI::UnrollingPreferences &UP) {
+  unsigned loopCost = 0;
+  unsigned liveReadComponents = 0;
+  for (BasicBlock *BB : L->blocks()) {
+    for (Instruction &I : *BB) {
+      loopCost += getUserCost(&I);
+      if (CallInst *CI = dyn_cast<CallInst>(&I)) {
+        if (m_pHlslOP->IsDxilOpFuncCallInst(CI) &&
+            isResourceRead(m_pHlslOP->GetDxilOpFuncCallInst(CI)))
+          // Each used component is extracted once.
+          liveReadComponents += CI->getNumUses();
+      }
+    }
+  }
+
+  if (liveReadComponents) {
+    // Unrolled copies of a read tend to be scheduled together, so their
+    // results are live at once. [unroll] loops use the pragma threshold and
+    // are not limited by this.
+    unsigned maxCopies =
+        std::max(2u, MaxLiveReadComponents / liveReadComponents);
+    UP.Threshold = std::min(UP.Threshold, loopCost * maxCopies);
+    UP.PartialThreshold = std::min(UP.PartialThreshold, loopCost * maxCopies);
+  }
+
+  // With -unroll-budget, the function may grow to the budget, counting the
+  // unrolled loop; by unrolling time everything is inlined into the entry, so
+  // this is a per-shader budget. It covers [unroll] loops too, which may then
+  // be left rolled. Measuring the function for every loop costs time in
+  // proportion to the number of loops, so it is only done when asked.
+  unsigned functionCost = 0;
+  if (m_unrollBudget) {
+    for (BasicBlock &BB : *L->getHeader()->getParent())
+      for (Instruction &I : BB)
+        functionCost += getUserCost(&I);
+
+    // The unrolled loop replaces the rolled one, so it may use whatever the
+    // rest of the function leaves of the budget.
+    unsigned restCost = functionCost - loopCost;
+    unsigned maxUnrolledCost =
+        restCost < m_unrollBudget ? m_unrollBudget - restCost : 0;
+    UP.Threshold = std::min(UP.Threshold, maxUnrolledCost);
+    UP.PartialThreshold = std::min(UP.PartialThreshold, maxUnrolledCost);
+    UP.PragmaThreshold = std::min(UP.PragmaThreshold, maxUnrolledCost);
+  }
+
+  DEBUG(dbgs() << "DXIL unroll: loop cost " << loopCost << ", function cost "
+               << functionCost << ", live read components "
+               << liveReadComponents << ", threshold " << UP.Threshold
+               << ", pragma threshold " << UP.PragmaThreshold << "\n");
+}
+
+TargetIRAnalysis llvm::createDxilTargetIRAnalysis(unsigned UnrollBudget) {
+  return TargetIRAnalysis([UnrollBudget](Function &F) {
+    Module *M = F.getParent();
+    // High-level modules have no DXIL operations to price yet.
+    if (!M->HasDxilModule())
+      return TargetTransformInfo(M->getDataLayout());
+    return TargetTransformInfo(
+        DxilTTIImpl(nullptr, F, M->GetDxilModule(), /*ThreadGroup*/ false,
+                    UnrollBudget));
+  });
+}
@@ -8,13 +8,15 @@
 //===----------------------------------------------------------------------===//
 /// \file
 /// This file declares a TargetTransformInfo analysis pass specific to the DXIL.
-/// Only implemented isSourceOfDivergence for DivergenceAnalysis.
+/// Implements isSourceOfDivergence for DivergenceAnalysis, and prices DXIL
+/// operations for the loop unroller.
 ///
 //===----------------------------------------------------------------------===//
 
 #pragma once
 
-#include "llvm/CodeGen/BasicTTIImpl.h"
+#include "dxc/HLSL/DxilConstants.h"
+#include "llvm/Analysis/TargetTransformInfoImpl.h"
 
 namespace hlsl {
 class DxilModule;
@@ -23,21 +25,37 @@ class OP;
 
 namespace llvm {
 
-class DxilTTIImpl final : public BasicTTIImplBase<DxilTTIImpl> {
-  typedef BasicTTIImplBase<DxilTTIImpl> BaseT;
+// There is no DXIL target lowering, so this builds on the target-independent
+// defaults rather than BasicTTIImplBase, which queries the lowering.
+class DxilTTIImpl final : public TargetTransformInfoImplCRTPBase<DxilTTIImpl> {
+  typedef TargetTransformInfoImplCRTPBase<DxilTTIImpl> BaseT;
   typedef TargetTransformInfo TTI;
   friend BaseT;
   hlsl::OP *m_pHlslOP;
   bool m_isThreadGroup;
-  const TargetSubtargetInfo *getST() const { return nullptr; }
-  const TargetLowering *getTLI() const { return nullptr; }
+  // Cost the function may grow to through unrolling; 0 if unbounded.
+  unsigned m_unrollBudget;
 
 public:
   explicit DxilTTIImpl(const TargetMachine *TM, const Function &F,
-                       hlsl::DxilModule &DM, bool ThreadGroup);
+                       hlsl::DxilModule &DM, bool ThreadGroup,
+                       unsigned UnrollBudget = 0);
 
   bool hasBranchDivergence() { return true; }
   bool isSourceOfDivergence(const Value *V) const;
+
+  using BaseT::getCallCost;
+  unsigned getCallCost(const Function *F, ArrayRef<const Value *> Arguments);
+  void getUnrollingPreferences(Loop *L, TTI::UnrollingPreferences &UP);
+
+  /// Whether the operation reads a resource into registers: samples,
+  /// gathers and loads.
+  static bool isResourceRead(hlsl::DXIL::OpCode opcode);
+  /// Cost of a call to the DXIL operation, as getCallCost prices it.
+  static unsigned getDxilOpCost(hlsl::DXIL::OpCode opcode);
+  /// Number of resource read components that may be live at once before
+  /// they are expected to limit occupancy.
+  static const unsigned MaxLiveReadComponents = 64;
 };
 
 } // end namespace llvm
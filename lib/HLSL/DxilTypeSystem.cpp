@@ -100,6 +100,16 @@ const StructType *DxilStructAnnotation::GetStructType() const {
 
 unsigned DxilStructAnnotation::GetCBufferSize() const { return m_CBufferSize; }
 void DxilStructAnnotation::SetCBufferSize(unsigned size) { m_CBufferSize = size; }
+unsigned DxilStructAnnotation::GetCBufferFieldSpan(unsigned FieldIdx) const {
+  unsigned Start = m_FieldAnnotations[FieldIdx].GetCBufferOffset();
+  unsigned End = m_CBufferSize;
+  for (const DxilFieldAnnotation &FA : m_FieldAnnotations) {
+    unsigned Offset = FA.GetCBufferOffset();
+    if (Offset > Start && Offset < End)
+      End = Offset;
+  }
+  return End - Start;
+}
 void DxilStructAnnotation::MarkEmptyStruct() { m_FieldAnnotations.clear(); }
 bool DxilStructAnnotation::IsEmptyStruct() { return m_FieldAnnotations.empty(); }
 
@@ -200,38 +210,26 @@ DxilTypeSystem::DxilTypeSystem(Module *pModule)
       m_LowPrecisionMode(DXIL::LowPrecisionMode::Undefined) {}
 
 DxilStructAnnotation *DxilTypeSystem::AddStructAnnotation(const StructType *pStructType) {
-  DXASSERT_NOMSG(m_StructAnnotations.find(pStructType) == m_StructAnnotations.end());
-  DxilStructAnnotation *pA = new DxilStructAnnotation();
-  m_StructAnnotations[pStructType] = unique_ptr<DxilStructAnnotation>(pA);
+  auto inserted = m_StructAnnotations.insert(pStructType);
+  DXASSERT_NOMSG(inserted.second);
+  DxilStructAnnotation *pA = inserted.first;
   pA->m_pStructType = pStructType;
   pA->m_FieldAnnotations.resize(pStructType->getNumElements());
   return pA;
 }
 
 DxilStructAnnotation *DxilTypeSystem::GetStructAnnotation(const StructType *pStructType) {
-  auto it = m_StructAnnotations.find(pStructType);
-  if (it != m_StructAnnotations.end()) {
-    return it->second.get();
-  } else {
-    return nullptr;
-  }
+  return m_StructAnnotations.lookup(pStructType);
 }
 
 const DxilStructAnnotation *
 DxilTypeSystem::GetStructAnnotation(const StructType *pStructType) const {
-  auto it = m_StructAnnotations.find(pStructType);
-  if (it != m_StructAnnotations.end()) {
-    return it->second.get();
-  } else {
-    return nullptr;
-  }
+  return m_StructAnnotations.lookup(pStructType);
 }
 
 void DxilTypeSystem::EraseStructAnnotation(const StructType *pStructType) {
   DXASSERT_NOMSG(m_StructAnnotations.count(pStructType));
-  m_StructAnnotations.remove_if([pStructType](
-      const std::pair<const StructType *, std::unique_ptr<DxilStructAnnotation>>
-          &I) { return pStructType == I.first; });
+  m_StructAnnotations.erase(pStructType);
 }
 
 DxilTypeSystem::StructAnnotationMap &DxilTypeSystem::GetStructAnnotationMap() {
@@ -246,9 +244,9 @@ DxilFunctionAnnotation *DxilTypeSystem::AddFunctionAnnotation(const Function *pF
 }
 
 DxilFunctionAnnotation *DxilTypeSystem::AddFunctionAnnotationWithFPFlag(const Function *pFunction, const DxilFunctionFPFlag *pFlag) {
-  DXASSERT_NOMSG(m_FunctionAnnotations.find(pFunction) == m_FunctionAnnotations.end());
-  DxilFunctionAnnotation *pA = new DxilFunctionAnnotation();
-  m_FunctionAnnotations[pFunction] = unique_ptr<DxilFunctionAnnotation>(pA);
+  auto inserted = m_FunctionAnnotations.insert(pFunction);
+  DXASSERT_NOMSG(inserted.second);
+  DxilFunctionAnnotation *pA = inserted.first;
   pA->m_pFunction = pFunction;
   pA->m_parameterAnnotations.resize(pFunction->getFunctionType()->getNumParams());
   pA->GetFlag().SetFlagValue(pFlag->GetFlagValue());
@@ -256,35 +254,27 @@ DxilFunctionAnnotation *DxilTypeSystem::AddFunctionAnnotationWithFPFlag(const Fu
 }
 
 DxilFunctionAnnotation *DxilTypeSystem::GetFunctionAnnotation(const Function *pFunction) {
-  auto it = m_FunctionAnnotations.find(pFunction);
-  if (it != m_FunctionAnnotations.end()) {
-    return it->second.get();
-  } else {
-    return nullptr;
-  }
+  return m_FunctionAnnotations.lookup(pFunction);
 }
 
 const DxilFunctionAnnotation *
 DxilTypeSystem::GetFunctionAnnotation(const Function *pFunction) const {
-  auto it = m_FunctionAnnotations.find(pFunction);
-  if (it != m_FunctionAnnotations.end()) {
-    return it->second.get();
-  } else {
-    return nullptr;
-  }
+  return m_FunctionAnnotations.lookup(pFunction);
 }
 
 void DxilTypeSystem::EraseFunctionAnnotation(const Function *pFunction) {
   DXASSERT_NOMSG(m_FunctionAnnotations.count(pFunction));
-  m_FunctionAnnotations.remove_if([pFunction](
-      const std::pair<const Function *, std::unique_ptr<DxilFunctionAnnotation>>
-          &I) { return pFunction == I.first; });
+  m_FunctionAnnotations.erase(pFunction);
 }
 
 DxilTypeSystem::FunctionAnnotationMap &DxilTypeSystem::GetFunctionAnnotationMap() {
   return m_FunctionAnnotations;
 }
 
+void DxilTypeSystem::ReserveFunctionAnnotations(unsigned count) {
+  m_FunctionAnnotations.reserve(count);
+}
+
 StructType *DxilTypeSystem::GetSNormF32Type(unsigned NumComps) {
   return GetNormFloatType(CompType::getSNormF32(), NumComps);
 }
@@ -329,18 +319,20 @@ void DxilTypeSystem::CopyTypeAnnotation(const llvm::Type *Ty,
     return;
 
   const StructType *ST = cast<StructType>(Ty);
+  const DxilStructAnnotation *annot = src.GetStructAnnotation(ST);
+  if (!annot)
+    return;
+
+  auto inserted = m_StructAnnotations.insert(ST);
   // Already exist.
-  if (GetStructAnnotation(ST))
+  if (!inserted.second)
     return;
 
-  if (const DxilStructAnnotation *annot = src.GetStructAnnotation(ST)) {
-    DxilStructAnnotation *dstAnnot = AddStructAnnotation(ST);
-    // Copy the annotation.
-    *dstAnnot = *annot;
-    // Copy field type annotations.
-    for (Type *Ty : ST->elements()) {
-      CopyTypeAnnotation(Ty, src);
-    }
+  // Copy the annotation.
+  *inserted.first = *annot;
+  // Copy field type annotations.
+  for (Type *Ty : ST->elements()) {
+    CopyTypeAnnotation(Ty, src);
   }
 }
 
@@ -16,26 +16,33 @@
 #include "dxc/HLSL/DxilShaderModel.h"
 #include "dxc/HLSL/DxilContainer.h"
 #include "dxc/Support/Global.h"
+#include "dxc/Support/CompilePhaseListener.h"
 #include "dxc/HLSL/DxilUtil.h"
 #include "dxc/HLSL/DxilInstructions.h"
 #include "dxc/HLSL/ReducibilityAnalysis.h"
 #include "dxc/Support/WinIncludes.h"
 #include "dxc/Support/FileIOHelper.h"
+#include "dxc/Support/WorkerThreads.h"
 
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/Analysis/CallGraph.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Type.h"
+#include "llvm/IR/TypeFinder.h"
 #include "llvm/IR/Operator.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/InstIterator.h"
+#include "llvm/IR/InlineAsm.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/DiagnosticInfo.h"
 #include "llvm/IR/DiagnosticPrinter.h"
 #include "llvm/ADT/BitVector.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/MD5.h"
 #include "llvm/Bitcode/ReaderWriter.h"
 #include <unordered_set>
 #include "llvm/Analysis/LoopInfo.h"
@@ -45,6 +52,11 @@
 #include "dxc/HLSL/DxilSignatureAllocator.h"
 #include "dxc/HLSL/DxilRootSignature.h"
 #include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <system_error>
+#include <thread>
 
 
 using namespace llvm;
@@ -355,9 +367,20 @@ struct ValidationContext {
   unsigned domainLocSize;
   const unsigned kDxilControlFlowHintMDKind;
   const unsigned kDxilPreciseMDKind;
+  const unsigned kDxilUniformMDKind;
   const unsigned kLLVMLoopMDKind;
   bool m_bCoverageIn, m_bInnerCoverageIn;
   unsigned m_DxilMajor, m_DxilMinor;
+  // Guards hlsl::OP, which creates its builtin types on first request; shared
+  // with the contexts that validate function bodies on other threads.
+  std::mutex &OPMutex;
+  std::mutex OPMutexStorage;
+  // Function bodies that passed validation before, if any, along with the
+  // module state that function digests are combined with.
+  ValidationFunctionCache *pFunctionCache = nullptr;
+  std::string FunctionCacheModuleState;
+  // Called at checkpoints, if set; may throw to stop validation.
+  CompilePhaseListener *pPhases = nullptr;
 
   ValidationContext(Module &llvmModule, Module *DebugModule,
                     DxilModule &dxilModule,
@@ -368,10 +391,12 @@ struct ValidationContext {
             DxilMDHelper::kDxilControlFlowHintMDName)),
         kDxilPreciseMDKind(llvmModule.getContext().getMDKindID(
             DxilMDHelper::kDxilPreciseAttributeMDName)),
+        kDxilUniformMDKind(llvmModule.getContext().getMDKindID(
+            DxilMDHelper::kDxilUniformMDName)),
         kLLVMLoopMDKind(llvmModule.getContext().getMDKindID("llvm.loop")),
         DiagPrinter(DiagPrn), LastRuleEmit((ValidationRule)-1),
         m_bCoverageIn(false), m_bInnerCoverageIn(false),
-        hasViewID(false) {
+        hasViewID(false), OPMutex(OPMutexStorage) {
     DxilMod.GetDxilVersion(m_DxilMajor, m_DxilMinor);
     for (unsigned i = 0; i < DXIL::kNumOutputStreams; i++) {
       hasOutputPosition[i] = false;
@@ -381,6 +406,31 @@ struct ValidationContext {
     patchConstCols.resize(DxilMod.GetPatchConstantSignature().GetElements().size(), 0);
   }
 
+  // Creates a context that validates a function body on behalf of Parent,
+  // reporting to its own printer. It does not touch the LLVMContext, so it may
+  // be created on any thread. The call sets, signature columns and output
+  // tracking start out empty, as function bodies neither read nor update them.
+  ValidationContext(ValidationContext &Parent,
+                    DiagnosticPrinterRawOStream &DiagPrn)
+      : M(Parent.M), pDebugModule(Parent.pDebugModule),
+        DxilMod(Parent.DxilMod), DL(Parent.DL), DiagPrinter(DiagPrn),
+        LastRuleEmit((ValidationRule)-1),
+        kDxilControlFlowHintMDKind(Parent.kDxilControlFlowHintMDKind),
+        kDxilPreciseMDKind(Parent.kDxilPreciseMDKind),
+        kDxilUniformMDKind(Parent.kDxilUniformMDKind),
+        kLLVMLoopMDKind(Parent.kLLVMLoopMDKind),
+        m_bCoverageIn(false), m_bInnerCoverageIn(false),
+        m_DxilMajor(Parent.m_DxilMajor), m_DxilMinor(Parent.m_DxilMinor),
+        hasViewID(false), OPMutex(Parent.OPMutex),
+        pFunctionCache(Parent.pFunctionCache),
+        FunctionCacheModuleState(Parent.FunctionCacheModuleState),
+        pPhases(Parent.pPhases) {
+    for (unsigned i = 0; i < DXIL::kNumOutputStreams; i++) {
+      hasOutputPosition[i] = false;
+      OutputPositionMask[i] = 0;
+    }
+  }
+
   // Provide direct access to the raw_ostream in DiagPrinter.
   raw_ostream &DiagStream() {
     struct DiagnosticPrinterRawOStream_Pub : public DiagnosticPrinterRawOStream {
@@ -391,6 +441,11 @@ struct ValidationContext {
     return p->DiagStream();
   }
 
+  void Checkpoint() {
+    if (pPhases)
+      pPhases->checkpoint();
+  }
+
   void EmitGlobalValueError(GlobalValue *GV, ValidationRule rule) {
     EmitFormatError(rule, { GV->getName().str() });
   }
@@ -553,48 +608,170 @@ struct ValidationContext {
   }
 };
 
+// Shader kinds and minimum shader model in which a DXIL operation is
+// available.
+struct OpCodeProfileInfo {
+  uint8_t ShaderKindMask; // One bit per DXIL::ShaderKind.
+  uint8_t MinMajor;
+  uint8_t MinMinor;
+};
+
+static const OpCodeProfileInfo OpCodeProfileTable[] = {
+  /* <py::lines('VALOPCODESM-TABLE')>hctdb_instrhelp.get_valopcode_sm_table()</py>*/
+  // VALOPCODESM-TABLE:BEGIN
+  { 0xff, 6, 0 }, // TempRegLoad=0 (*)
+  { 0xff, 6, 0 }, // TempRegStore=1 (*)
+  { 0xff, 6, 0 }, // MinPrecXRegLoad=2 (*)
+  { 0xff, 6, 0 }, // MinPrecXRegStore=3 (*)
+  { 0xff, 6, 0 }, // LoadInput=4 (*)
+  { 0xff, 6, 0 }, // StoreOutput=5 (*)
+  { 0xff, 6, 0 }, // FAbs=6 (*)
+  { 0xff, 6, 0 }, // Saturate=7 (*)
+  { 0xff, 6, 0 }, // IsNaN=8 (*)
+  { 0xff, 6, 0 }, // IsInf=9 (*)
+  { 0xff, 6, 0 }, // IsFinite=10 (*)
+  { 0xff, 6, 0 }, // IsNormal=11 (*)
+  { 0xff, 6, 0 }, // Cos=12 (*)
+  { 0xff, 6, 0 }, // Sin=13 (*)
+  { 0xff, 6, 0 }, // Tan=14 (*)
+  { 0xff, 6, 0 }, // Acos=15 (*)
+  { 0xff, 6, 0 }, // Asin=16 (*)
+  { 0xff, 6, 0 }, // Atan=17 (*)
+  { 0xff, 6, 0 }, // Hcos=18 (*)
+  { 0xff, 6, 0 }, // Hsin=19 (*)
+  { 0xff, 6, 0 }, // Htan=20 (*)
+  { 0xff, 6, 0 }, // Exp=21 (*)
+  { 0xff, 6, 0 }, // Frc=22 (*)
+  { 0xff, 6, 0 }, // Log=23 (*)
+  { 0xff, 6, 0 }, // Sqrt=24 (*)
+  { 0xff, 6, 0 }, // Rsqrt=25 (*)
+  { 0xff, 6, 0 }, // Round_ne=26 (*)
+  { 0xff, 6, 0 }, // Round_ni=27 (*)
+  { 0xff, 6, 0 }, // Round_pi=28 (*)
+  { 0xff, 6, 0 }, // Round_z=29 (*)
+  { 0xff, 6, 0 }, // Bfrev=30 (*)
+  { 0xff, 6, 0 }, // Countbits=31 (*)
+  { 0xff, 6, 0 }, // FirstbitLo=32 (*)
+  { 0xff, 6, 0 }, // FirstbitHi=33 (*)
+  { 0xff, 6, 0 }, // FirstbitSHi=34 (*)
+  { 0xff, 6, 0 }, // FMax=35 (*)
+  { 0xff, 6, 0 }, // FMin=36 (*)
+  { 0xff, 6, 0 }, // IMax=37 (*)
+  { 0xff, 6, 0 }, // IMin=38 (*)
+  { 0xff, 6, 0 }, // UMax=39 (*)
+  { 0xff, 6, 0 }, // UMin=40 (*)
+  { 0xff, 6, 0 }, // IMul=41 (*)
+  { 0xff, 6, 0 }, // UMul=42 (*)
+  { 0xff, 6, 0 }, // UDiv=43 (*)
+  { 0xff, 6, 0 }, // UAddc=44 (*)
+  { 0xff, 6, 0 }, // USubb=45 (*)
+  { 0xff, 6, 0 }, // FMad=46 (*)
+  { 0xff, 6, 0 }, // Fma=47 (*)
+  { 0xff, 6, 0 }, // IMad=48 (*)
+  { 0xff, 6, 0 }, // UMad=49 (*)
+  { 0xff, 6, 0 }, // Msad=50 (*)
+  { 0xff, 6, 0 }, // Ibfe=51 (*)
+  { 0xff, 6, 0 }, // Ubfe=52 (*)
+  { 0xff, 6, 0 }, // Bfi=53 (*)
+  { 0xff, 6, 0 }, // Dot2=54 (*)
+  { 0xff, 6, 0 }, // Dot3=55 (*)
+  { 0xff, 6, 0 }, // Dot4=56 (*)
+  { 0xff, 6, 0 }, // CreateHandle=57 (*)
+  { 0xff, 6, 0 }, // CBufferLoad=58 (*)
+  { 0xff, 6, 0 }, // CBufferLoadLegacy=59 (*)
+  { 0x01, 6, 0 }, // Sample=60 (p)
+  { 0x01, 6, 0 }, // SampleBias=61 (p)
+  { 0xff, 6, 0 }, // SampleLevel=62 (*)
+  { 0xff, 6, 0 }, // SampleGrad=63 (*)
+  { 0x01, 6, 0 }, // SampleCmp=64 (p)
+  { 0xff, 6, 0 }, // SampleCmpLevelZero=65 (*)
+  { 0xff, 6, 0 }, // TextureLoad=66 (*)
+  { 0xff, 6, 0 }, // TextureStore=67 (*)
+  { 0xff, 6, 0 }, // BufferLoad=68 (*)
+  { 0xff, 6, 0 }, // BufferStore=69 (*)
+  { 0xff, 6, 0 }, // BufferUpdateCounter=70 (*)
+  { 0xff, 6, 0 }, // CheckAccessFullyMapped=71 (*)
+  { 0xff, 6, 0 }, // GetDimensions=72 (*)
+  { 0xff, 6, 0 }, // TextureGather=73 (*)
+  { 0xff, 6, 0 }, // TextureGatherCmp=74 (*)
+  { 0xff, 6, 0 }, // Texture2DMSGetSamplePosition=75 (*)
+  { 0x01, 6, 0 }, // RenderTargetGetSamplePosition=76 (p)
+  { 0x01, 6, 0 }, // RenderTargetGetSampleCount=77 (p)
+  { 0xff, 6, 0 }, // AtomicBinOp=78 (*)
+  { 0xff, 6, 0 }, // AtomicCompareExchange=79 (*)
+  { 0xff, 6, 0 }, // Barrier=80 (*)
+  { 0x01, 6, 0 }, // CalculateLOD=81 (p)
+  { 0x01, 6, 0 }, // Discard=82 (p)
+  { 0x01, 6, 0 }, // DerivCoarseX=83 (p)
+  { 0x01, 6, 0 }, // DerivCoarseY=84 (p)
+  { 0x01, 6, 0 }, // DerivFineX=85 (p)
+  { 0x01, 6, 0 }, // DerivFineY=86 (p)
+  { 0x01, 6, 0 }, // EvalSnapped=87 (p)
+  { 0x01, 6, 0 }, // EvalSampleIndex=88 (p)
+  { 0x01, 6, 0 }, // EvalCentroid=89 (p)
+  { 0x01, 6, 0 }, // SampleIndex=90 (p)
+  { 0x01, 6, 0 }, // Coverage=91 (p)
+  { 0x01, 6, 0 }, // InnerCoverage=92 (p)
+  { 0x20, 6, 0 }, // ThreadId=93 (c)
+  { 0x20, 6, 0 }, // GroupId=94 (c)
+  { 0x20, 6, 0 }, // ThreadIdInGroup=95 (c)
+  { 0x20, 6, 0 }, // FlattenedThreadIdInGroup=96 (c)
+  { 0x04, 6, 0 }, // EmitStream=97 (g)
+  { 0x04, 6, 0 }, // CutStream=98 (g)
+  { 0x04, 6, 0 }, // EmitThenCutStream=99 (g)
+  { 0x04, 6, 0 }, // GSInstanceID=100 (g)
+  { 0xff, 6, 0 }, // MakeDouble=101 (*)
+  { 0xff, 6, 0 }, // SplitDouble=102 (*)
+  { 0x18, 6, 0 }, // LoadOutputControlPoint=103 (dh)
+  { 0x18, 6, 0 }, // LoadPatchConstant=104 (dh)
+  { 0x10, 6, 0 }, // DomainLocation=105 (d)
+  { 0x08, 6, 0 }, // StorePatchConstant=106 (h)
+  { 0x08, 6, 0 }, // OutputControlPointID=107 (h)
+  { 0x1d, 6, 0 }, // PrimitiveID=108 (gdhp)
+  { 0xff, 6, 0 }, // CycleCounterLegacy=109 (*)
+  { 0xff, 6, 0 }, // WaveIsFirstLane=110 (*)
+  { 0xff, 6, 0 }, // WaveGetLaneIndex=111 (*)
+  { 0xff, 6, 0 }, // WaveGetLaneCount=112 (*)
+  { 0xff, 6, 0 }, // WaveAnyTrue=113 (*)
+  { 0xff, 6, 0 }, // WaveAllTrue=114 (*)
+  { 0xff, 6, 0 }, // WaveActiveAllEqual=115 (*)
+  { 0xff, 6, 0 }, // WaveActiveBallot=116 (*)
+  { 0xff, 6, 0 }, // WaveReadLaneAt=117 (*)
+  { 0xff, 6, 0 }, // WaveReadLaneFirst=118 (*)
+  { 0xff, 6, 0 }, // WaveActiveOp=119 (*)
+  { 0xff, 6, 0 }, // WaveActiveBit=120 (*)
+  { 0xff, 6, 0 }, // WavePrefixOp=121 (*)
+  { 0xff, 6, 0 }, // QuadReadLaneAt=122 (*)
+  { 0xff, 6, 0 }, // QuadOp=123 (*)
+  { 0xff, 6, 0 }, // BitcastI16toF16=124 (*)
+  { 0xff, 6, 0 }, // BitcastF16toI16=125 (*)
+  { 0xff, 6, 0 }, // BitcastI32toF32=126 (*)
+  { 0xff, 6, 0 }, // BitcastF32toI32=127 (*)
+  { 0xff, 6, 0 }, // BitcastI64toF64=128 (*)
+  { 0xff, 6, 0 }, // BitcastF64toI64=129 (*)
+  { 0xff, 6, 0 }, // LegacyF32ToF16=130 (*)
+  { 0xff, 6, 0 }, // LegacyF16ToF32=131 (*)
+  { 0xff, 6, 0 }, // LegacyDoubleToFloat=132 (*)
+  { 0xff, 6, 0 }, // LegacyDoubleToSInt32=133 (*)
+  { 0xff, 6, 0 }, // LegacyDoubleToUInt32=134 (*)
+  { 0xff, 6, 0 }, // WaveAllBitCount=135 (*)
+  { 0xff, 6, 0 }, // WavePrefixBitCount=136 (*)
+  { 0x01, 6, 1 }, // AttributeAtVertex=137 (p)
+  { 0x1f, 6, 1 }, // ViewID=138 (vhdgp)
+  // VALOPCODESM-TABLE:END
+};
+static_assert(_countof(OpCodeProfileTable) == (unsigned)DXIL::OpCode::NumOpCodes,
+              "otherwise the opcode profile table is out of date");
+
 static bool ValidateOpcodeInProfile(DXIL::OpCode opcode,
                                     const ShaderModel *pSM) {
   unsigned op = (unsigned)opcode;
-  /* <py::lines('VALOPCODESM-TEXT')>hctdb_instrhelp.get_valopcode_sm_text()</py>*/
-  // VALOPCODESM-TEXT:BEGIN
-  // Instructions: ThreadId=93, GroupId=94, ThreadIdInGroup=95,
-  // FlattenedThreadIdInGroup=96
-  if (93 <= op && op <= 96)
-    return (pSM->IsCS());
-  // Instructions: DomainLocation=105
-  if (op == 105)
-    return (pSM->IsDS());
-  // Instructions: LoadOutputControlPoint=103, LoadPatchConstant=104
-  if (103 <= op && op <= 104)
-    return (pSM->IsDS() || pSM->IsHS());
-  // Instructions: EmitStream=97, CutStream=98, EmitThenCutStream=99,
-  // GSInstanceID=100
-  if (97 <= op && op <= 100)
-    return (pSM->IsGS());
-  // Instructions: PrimitiveID=108
-  if (op == 108)
-    return (pSM->IsGS() || pSM->IsDS() || pSM->IsHS() || pSM->IsPS());
-  // Instructions: StorePatchConstant=106, OutputControlPointID=107
-  if (106 <= op && op <= 107)
-    return (pSM->IsHS());
-  // Instructions: Sample=60, SampleBias=61, SampleCmp=64,
-  // RenderTargetGetSamplePosition=76, RenderTargetGetSampleCount=77,
-  // CalculateLOD=81, Discard=82, DerivCoarseX=83, DerivCoarseY=84,
-  // DerivFineX=85, DerivFineY=86, EvalSnapped=87, EvalSampleIndex=88,
-  // EvalCentroid=89, SampleIndex=90, Coverage=91, InnerCoverage=92
-  if (60 <= op && op <= 61 || op == 64 || 76 <= op && op <= 77 || 81 <= op && op <= 92)
-    return (pSM->IsPS());
-  // Instructions: AttributeAtVertex=137
-  if (op == 137)
-    return (pSM->GetMajor() > 6 || (pSM->GetMajor() == 6 && pSM->GetMinor() >= 1))
-        && (pSM->IsPS());
-  // Instructions: ViewID=138
-  if (op == 138)
-    return (pSM->GetMajor() > 6 || (pSM->GetMajor() == 6 && pSM->GetMinor() >= 1))
-        && (pSM->IsVS() || pSM->IsHS() || pSM->IsDS() || pSM->IsGS() || pSM->IsPS());
-  return true;
-  // VALOPCODESM-TEXT:END
+  DXASSERT(op < _countof(OpCodeProfileTable), "otherwise caller passed OOB opcode");
+  const OpCodeProfileInfo &info = OpCodeProfileTable[op];
+  if ((info.ShaderKindMask & (1 << (unsigned)pSM->GetKind())) == 0)
+    return false;
+  return pSM->GetMajor() > info.MinMajor ||
+         (pSM->GetMajor() == info.MinMajor && pSM->GetMinor() >= info.MinMinor);
 }
 
 static unsigned ValidateSignatureRowCol(Instruction *I, DxilSignatureElement &SE,
@@ -1884,6 +2061,56 @@ static bool IsDxilFunction(llvm::Function *F) {
   return OP::IsDxilOpFunc(F);
 }
 
+// Outcome of the checks on a DXIL operation call that depend only on the
+// opcode and the called declaration.
+enum class DxilOpDeclCheck {
+  Legal,
+  IllegalOverload,    // InstrOload
+  MismatchedOverload, // InstrCallOload
+  NotInProfile,       // SmOpcode
+};
+
+static DxilOpDeclCheck CheckDxilOpDeclaration(DXIL::OpCode dxilOpcode,
+                                              Function *F, Function *FCalled,
+                                              ValidationContext &ValCtx,
+                                              Function *&dxilFunc) {
+  OP *hlslOP = ValCtx.DxilMod.GetOP();
+  Type *voidTy = Type::getVoidTy(F->getContext());
+  dxilFunc = nullptr;
+
+  // In some cases, no overloads are provided (void is exclusive to others)
+  if (hlslOP->IsOverloadLegal(dxilOpcode, voidTy)) {
+    dxilFunc = hlslOP->GetOpFunc(dxilOpcode, voidTy);
+  }
+  else {
+    Type *Ty = hlslOP->GetOverloadType(dxilOpcode, FCalled);
+    try {
+      if (!hlslOP->IsOverloadLegal(dxilOpcode, Ty)) {
+        return DxilOpDeclCheck::IllegalOverload;
+      }
+    }
+    catch (...) {
+      return DxilOpDeclCheck::IllegalOverload;
+    }
+    dxilFunc = hlslOP->GetOpFunc(dxilOpcode, Ty->getScalarType());
+  }
+
+  if (!dxilFunc) {
+    // Cannot find dxilFunction based on opcode and type.
+    return DxilOpDeclCheck::IllegalOverload;
+  }
+
+  if (dxilFunc->getFunctionType() != F->getFunctionType()) {
+    return DxilOpDeclCheck::MismatchedOverload;
+  }
+
+  if (!ValidateOpcodeInProfile(dxilOpcode, ValCtx.DxilMod.GetShaderModel())) {
+    // Opcode not available in profile.
+    return DxilOpDeclCheck::NotInProfile;
+  }
+  return DxilOpDeclCheck::Legal;
+}
+
 static void ValidateExternalFunction(Function *F, ValidationContext &ValCtx) {
   if (!IsDxilFunction(F)) {
     ValCtx.EmitGlobalValueError(F, ValidationRule::DeclDxilFnExtern);
@@ -1897,7 +2124,13 @@ static void ValidateExternalFunction(Function *F, ValidationContext &ValCtx) {
 
   const ShaderModel *pSM = ValCtx.DxilMod.GetShaderModel();
   OP *hlslOP = ValCtx.DxilMod.GetOP();
-  Type *voidTy = Type::getVoidTy(F->getContext());
+
+  // Calls through one declaration nearly always share an opcode, so the
+  // declaration checks are only redone when the opcode or callee changes.
+  DXIL::OpCode checkedOpcode = DXIL::OpCode::NumOpCodes;
+  Function *checkedCallee = nullptr;
+  DxilOpDeclCheck check = DxilOpDeclCheck::Legal;
+  Function *dxilFunc = nullptr;
   for (User *user : F->users()) {
     CallInst *CI = dyn_cast<CallInst>(user);
     if (!CI) {
@@ -1919,44 +2152,28 @@ static void ValidateExternalFunction(Function *F, ValidationContext &ValCtx) {
     }
 
     DXIL::OpCode dxilOpcode = (DXIL::OpCode)opcode;
-
-    // In some cases, no overloads are provided (void is exclusive to others)
-    Function *dxilFunc;
-    if (hlslOP->IsOverloadLegal(dxilOpcode, voidTy)) {
-      dxilFunc = hlslOP->GetOpFunc(dxilOpcode, voidTy);
-    }
-    else {
-      Type *Ty = hlslOP->GetOverloadType(dxilOpcode, CI->getCalledFunction());
-      try {
-        if (!hlslOP->IsOverloadLegal(dxilOpcode, Ty)) {
-          ValCtx.EmitInstrError(CI, ValidationRule::InstrOload);
-          continue;
-        }
-      }
-      catch (...) {
-        ValCtx.EmitInstrError(CI, ValidationRule::InstrOload);
-        continue;
-      }
-      dxilFunc = hlslOP->GetOpFunc(dxilOpcode, Ty->getScalarType());
+    Function *FCalled = CI->getCalledFunction();
+    if (dxilOpcode != checkedOpcode || FCalled != checkedCallee) {
+      check = CheckDxilOpDeclaration(dxilOpcode, F, FCalled, ValCtx,
+                                     dxilFunc);
+      checkedOpcode = dxilOpcode;
+      checkedCallee = FCalled;
     }
 
-    if (!dxilFunc) {
-      // Cannot find dxilFunction based on opcode and type.
+    switch (check) {
+    case DxilOpDeclCheck::IllegalOverload:
       ValCtx.EmitInstrError(CI, ValidationRule::InstrOload);
       continue;
-    }
-
-    if (dxilFunc->getFunctionType() != F->getFunctionType()) {
+    case DxilOpDeclCheck::MismatchedOverload:
       ValCtx.EmitGlobalValueError(dxilFunc, ValidationRule::InstrCallOload);
       continue;
-    }
-
-    if (!ValidateOpcodeInProfile(dxilOpcode, pSM)) {
-      // Opcode not available in profile.
+    case DxilOpDeclCheck::NotInProfile:
       ValCtx.EmitInstrFormatError(CI, ValidationRule::SmOpcode,
                                   {hlslOP->GetOpCodeName(dxilOpcode),
                                    pSM->GetName()});
       continue;
+    case DxilOpDeclCheck::Legal:
+      break;
     }
 
     // Check more detail.
@@ -2014,6 +2231,11 @@ static bool IsDxilBuiltinStructType(StructType *ST, hlsl::OP *hlslOP) {
   }
 }
 
+static bool IsDxilBuiltinStructType(StructType *ST, ValidationContext &ValCtx) {
+  std::lock_guard<std::mutex> lock(ValCtx.OPMutex);
+  return IsDxilBuiltinStructType(ST, ValCtx.DxilMod.GetOP());
+}
+
 static bool ValidateType(Type *Ty, ValidationContext &ValCtx) {
   DXASSERT_NOMSG(Ty != nullptr);
   if (Ty->isPointerTy()) {
@@ -2033,8 +2255,7 @@ static bool ValidateType(Type *Ty, ValidationContext &ValCtx) {
 
     StringRef Name = ST->getName();
     if (Name.startswith("dx.")) {
-      hlsl::OP *hlslOP = ValCtx.DxilMod.GetOP();
-      if (IsDxilBuiltinStructType(ST, hlslOP)) {
+      if (IsDxilBuiltinStructType(ST, ValCtx)) {
         ValCtx.EmitTypeError(Ty, ValidationRule::InstrDxilStructUser);
         result = false;
       }
@@ -2090,7 +2311,7 @@ static bool GetNodeOperandAsInt(ValidationContext &ValCtx, MDNode *pMD, unsigned
 }
 
 static bool IsPrecise(Instruction &I, ValidationContext &ValCtx) {
-  MDNode *pMD = I.getMetadata(DxilMDHelper::kDxilPreciseAttributeMDName);
+  MDNode *pMD = I.getMetadata(ValCtx.kDxilPreciseMDKind);
   if (pMD == nullptr) {
     return false;
   }
@@ -2133,8 +2354,9 @@ static void ValidateGradientOps(Function *F, ArrayRef<CallInst *> ops, ArrayRef<
     return;
   }
 
+  // Only propagate along what the gradient ops depend on.
   std::unique_ptr<WaveSensitivityAnalysis> WaveVal(WaveSensitivityAnalysis::create());
-  WaveVal->Analyze(F);
+  WaveVal->Analyze(F, ops);
   for (CallInst *op : ops) {
     if (WaveVal->IsWaveSensitive(op)) {
       ValCtx.EmitInstrError(op, ValidationRule::UniNoWaveSensitiveGradient);
@@ -2148,7 +2370,7 @@ static void ValidateControlFlowHint(BasicBlock &bb, ValidationContext &ValCtx) {
   if (!TI)
     return;
 
-  MDNode *pNode = TI->getMetadata(DxilMDHelper::kDxilControlFlowHintMDName);
+  MDNode *pNode = TI->getMetadata(ValCtx.kDxilControlFlowHintMDKind);
   if (!pNode)
     return;
 
@@ -2298,6 +2520,10 @@ static void ValidateInstructionMetadata(Instruction *I,
       }
     } else if (MD.first == ValCtx.kDxilPreciseMDKind) {
       // Validated in IsPrecise.
+    } else if (MD.first == ValCtx.kDxilUniformMDKind) {
+      // A hint only; it carries no operands.
+      if (MD.second->getNumOperands() != 0)
+        ValCtx.EmitMetaError(MD.second, ValidationRule::MetaWellFormed);
     } else if (MD.first == ValCtx.kLLVMLoopMDKind) {
       ValidateLoopMetadata(MD.second, ValCtx);
     } else if (MD.first == LLVMContext::MD_tbaa) {
@@ -2435,7 +2661,7 @@ static void ValidateFunctionBody(Function *F, ValidationContext &ValCtx) {
         if (StructType *ST = dyn_cast<StructType>(Ty)) {
           Value *Agg = EV->getAggregateOperand();
           if (!isa<AtomicCmpXchgInst>(Agg) &&
-              !IsDxilBuiltinStructType(ST, ValCtx.DxilMod.GetOP())) {
+              !IsDxilBuiltinStructType(ST, ValCtx)) {
             ValCtx.EmitInstrError(EV, ValidationRule::InstrExtractValue);
           }
         } else {
@@ -2619,6 +2845,405 @@ static void ValidateFunction(Function &F, ValidationContext &ValCtx) {
   }
 }
 
+struct ValidationFunctionCache::Impl {
+  // Bound on the number of digests kept; the cache starts over once it is
+  // reached.
+  static const size_t MaxEntries = 64 * 1024;
+
+  std::mutex Mutex;
+  std::unordered_set<std::string> Digests;
+  unsigned HitCount = 0;
+};
+
+ValidationFunctionCache::ValidationFunctionCache() : m_pImpl(new Impl()) {}
+
+ValidationFunctionCache::~ValidationFunctionCache() {}
+
+bool ValidationFunctionCache::Contains(const std::string &Digest) {
+  std::lock_guard<std::mutex> lock(m_pImpl->Mutex);
+  if (m_pImpl->Digests.count(Digest) == 0)
+    return false;
+  ++m_pImpl->HitCount;
+  return true;
+}
+
+unsigned ValidationFunctionCache::GetHitCount() const {
+  std::lock_guard<std::mutex> lock(m_pImpl->Mutex);
+  return m_pImpl->HitCount;
+}
+
+void ValidationFunctionCache::Insert(const std::string &Digest) {
+  std::lock_guard<std::mutex> lock(m_pImpl->Mutex);
+  if (m_pImpl->Digests.size() >= Impl::MaxEntries)
+    m_pImpl->Digests.clear();
+  m_pImpl->Digests.insert(Digest);
+}
+
+namespace {
+// Builds the digest of everything that validating a function body depends
+// on. Values are identified by content, by name or by their position in the
+// function, never by address, so digests match across loads of a module.
+// Debug locations only affect the text of diagnostics, and only functions
+// that validate without diagnostics are cached, so they are left out.
+class FunctionDigestBuilder {
+public:
+  FunctionDigestBuilder(ValidationContext &ValCtx) : m_ValCtx(ValCtx) {
+    ValCtx.M.getContext().getMDKindNames(m_MDKindNames);
+  }
+
+  std::string Build(Function &F) {
+    AddString(m_ValCtx.FunctionCacheModuleState);
+    AddType(F.getFunctionType());
+    AddUInt(m_ValCtx.DxilMod.GetTypeSystem().GetFunctionAnnotation(&F) != nullptr);
+    SmallVector<std::pair<unsigned, MDNode *>, 2> MDNodes;
+    F.getAllMetadata(MDNodes);
+    AddUInt(MDNodes.size());
+
+    // Number local values up front, as phis may refer to later ones.
+    for (Argument &Arg : F.args())
+      AddLocal(&Arg);
+    for (BasicBlock &BB : F) {
+      AddLocal(&BB);
+      for (Instruction &I : BB)
+        AddLocal(&I);
+    }
+
+    for (BasicBlock &BB : F) {
+      AddUInt(BB.size());
+      for (Instruction &I : BB)
+        AddInstruction(I);
+    }
+
+    MD5::MD5Result result;
+    m_md5.final(result);
+    return std::string((const char *)result, sizeof(result));
+  }
+
+private:
+  ValidationContext &m_ValCtx;
+  SmallVector<StringRef, 32> m_MDKindNames;
+  MD5 m_md5;
+  DenseMap<const Value *, unsigned> m_LocalIds;
+  DenseMap<const MDNode *, unsigned> m_NodeIds;
+  SmallPtrSet<StructType *, 4> m_StructsInProgress;
+
+  void AddLocal(const Value *V) {
+    unsigned id = m_LocalIds.size();
+    m_LocalIds[V] = id;
+  }
+
+  void AddUInt(uint64_t value) {
+    m_md5.update(ArrayRef<uint8_t>((const uint8_t *)&value, sizeof(value)));
+  }
+
+  void AddString(StringRef value) {
+    AddUInt(value.size());
+    m_md5.update(value);
+  }
+
+  void AddAPInt(const APInt &value) {
+    AddUInt(value.getBitWidth());
+    for (unsigned i = 0; i < value.getNumWords(); ++i)
+      AddUInt(value.getRawData()[i]);
+  }
+
+  void AddType(Type *Ty) {
+    AddUInt(Ty->getTypeID());
+    switch (Ty->getTypeID()) {
+    case Type::IntegerTyID:
+      AddUInt(Ty->getIntegerBitWidth());
+      break;
+    case Type::PointerTyID:
+      AddUInt(Ty->getPointerAddressSpace());
+      break;
+    case Type::ArrayTyID:
+      AddUInt(Ty->getArrayNumElements());
+      break;
+    case Type::VectorTyID:
+      AddUInt(Ty->getVectorNumElements());
+      break;
+    case Type::FunctionTyID:
+      AddUInt(cast<FunctionType>(Ty)->isVarArg());
+      break;
+    case Type::StructTyID: {
+      StructType *ST = cast<StructType>(Ty);
+      AddUInt(ST->isPacked());
+      AddUInt(ST->isOpaque());
+      AddString(ST->hasName() ? ST->getName() : StringRef());
+      // A named struct may refer to itself; its name identifies it there.
+      if (ST->hasName() && !m_StructsInProgress.insert(ST).second)
+        return;
+      AddUInt(ST->getNumElements());
+      for (Type *EltTy : ST->elements())
+        AddType(EltTy);
+      m_StructsInProgress.erase(ST);
+      return;
+    }
+    default:
+      break;
+    }
+    AddUInt(Ty->getNumContainedTypes());
+    for (Type *ContainedTy : Ty->subtypes())
+      AddType(ContainedTy);
+  }
+
+  void AddValue(Value *V) {
+    auto it = m_LocalIds.find(V);
+    if (it != m_LocalIds.end()) {
+      AddUInt('L');
+      AddUInt(it->second);
+      return;
+    }
+    AddUInt(V->getValueID());
+    AddType(V->getType());
+    if (GlobalValue *GV = dyn_cast<GlobalValue>(V)) {
+      AddString(GV->getName());
+    } else if (Constant *C = dyn_cast<Constant>(V)) {
+      AddConstant(C);
+    } else if (MetadataAsValue *MV = dyn_cast<MetadataAsValue>(V)) {
+      AddMetadata(MV->getMetadata());
+    } else if (InlineAsm *IA = dyn_cast<InlineAsm>(V)) {
+      AddString(IA->getAsmString());
+      AddString(IA->getConstraintString());
+    }
+  }
+
+  void AddConstant(Constant *C) {
+    if (ConstantInt *CI = dyn_cast<ConstantInt>(C)) {
+      AddAPInt(CI->getValue());
+    } else if (ConstantFP *CFP = dyn_cast<ConstantFP>(C)) {
+      AddAPInt(CFP->getValueAPF().bitcastToAPInt());
+    } else if (ConstantDataSequential *CDS = dyn_cast<ConstantDataSequential>(C)) {
+      AddString(CDS->getRawDataValues());
+    } else if (ConstantExpr *CE = dyn_cast<ConstantExpr>(C)) {
+      AddUInt(CE->getOpcode());
+      AddUInt(CE->getRawSubclassOptionalData());
+      if (CE->isCompare())
+        AddUInt(CE->getPredicate());
+      if (CE->hasIndices()) {
+        for (unsigned idx : CE->getIndices())
+          AddUInt(idx);
+      }
+    }
+    AddUInt(C->getNumOperands());
+    for (Value *Op : C->operands())
+      AddValue(Op);
+  }
+
+  void AddMetadata(Metadata *MD) {
+    if (MD == nullptr) {
+      AddUInt('N');
+      return;
+    }
+    AddUInt(MD->getMetadataID());
+    if (MDString *S = dyn_cast<MDString>(MD)) {
+      AddString(S->getString());
+    } else if (ValueAsMetadata *VM = dyn_cast<ValueAsMetadata>(MD)) {
+      AddValue(VM->getValue());
+    } else if (MDNode *N = dyn_cast<MDNode>(MD)) {
+      // Nodes may be cyclic, as loop metadata is; repeats refer back to the
+      // first occurrence.
+      auto it = m_NodeIds.find(N);
+      if (it != m_NodeIds.end()) {
+        AddUInt('R');
+        AddUInt(it->second);
+        return;
+      }
+      unsigned id = m_NodeIds.size();
+      m_NodeIds[N] = id;
+      AddUInt(N->isDistinct());
+      AddUInt(N->getNumOperands());
+      for (const MDOperand &Op : N->operands())
+        AddMetadata(Op.get());
+    }
+  }
+
+  void AddInstruction(Instruction &I) {
+    AddUInt(I.getOpcode());
+    AddUInt(I.getRawSubclassOptionalData());
+    AddType(I.getType());
+    AddUInt(I.getNumOperands());
+    for (Value *Op : I.operands())
+      AddValue(Op);
+
+    if (CmpInst *Cmp = dyn_cast<CmpInst>(&I)) {
+      AddUInt(Cmp->getPredicate());
+    } else if (AllocaInst *AI = dyn_cast<AllocaInst>(&I)) {
+      AddUInt(AI->getAlignment());
+    } else if (LoadInst *LI = dyn_cast<LoadInst>(&I)) {
+      AddUInt(LI->getAlignment());
+      AddUInt(LI->isVolatile());
+      AddUInt(LI->getOrdering());
+      AddUInt(LI->getSynchScope());
+    } else if (StoreInst *SI = dyn_cast<StoreInst>(&I)) {
+      AddUInt(SI->getAlignment());
+      AddUInt(SI->isVolatile());
+      AddUInt(SI->getOrdering());
+      AddUInt(SI->getSynchScope());
+    } else if (AtomicRMWInst *RMW = dyn_cast<AtomicRMWInst>(&I)) {
+      AddUInt(RMW->getOperation());
+      AddUInt(RMW->isVolatile());
+      AddUInt(RMW->getOrdering());
+      AddUInt(RMW->getSynchScope());
+    } else if (AtomicCmpXchgInst *CX = dyn_cast<AtomicCmpXchgInst>(&I)) {
+      AddUInt(CX->isVolatile());
+      AddUInt(CX->isWeak());
+      AddUInt(CX->getSuccessOrdering());
+      AddUInt(CX->getFailureOrdering());
+      AddUInt(CX->getSynchScope());
+    } else if (ExtractValueInst *EV = dyn_cast<ExtractValueInst>(&I)) {
+      for (unsigned idx : EV->getIndices())
+        AddUInt(idx);
+    } else if (InsertValueInst *IV = dyn_cast<InsertValueInst>(&I)) {
+      for (unsigned idx : IV->getIndices())
+        AddUInt(idx);
+    } else if (PHINode *Phi = dyn_cast<PHINode>(&I)) {
+      for (unsigned i = 0, e = Phi->getNumIncomingValues(); i < e; ++i)
+        AddValue(Phi->getIncomingBlock(i));
+    } else if (CallInst *CI = dyn_cast<CallInst>(&I)) {
+      AddUInt(CI->getCallingConv());
+      AddUInt(CI->getTailCallKind());
+    }
+
+    SmallVector<std::pair<unsigned, MDNode *>, 4> MDNodes;
+    I.getAllMetadataOtherThanDebugLoc(MDNodes);
+    AddUInt(MDNodes.size());
+    for (auto &MD : MDNodes) {
+      AddString(MD.first < m_MDKindNames.size() ? m_MDKindNames[MD.first]
+                                                : StringRef());
+      AddMetadata(MD.second);
+    }
+  }
+};
+} // namespace
+
+// Module state that validating a function body depends on, apart from the
+// body itself.
+static std::string GetFunctionCacheModuleState(ValidationContext &ValCtx) {
+  std::string state;
+  raw_string_ostream OS(state);
+  const ShaderModel *pSM = ValCtx.DxilMod.GetShaderModel();
+  OS << ValCtx.m_DxilMajor << '.' << ValCtx.m_DxilMinor << ';'
+     << (pSM ? pSM->GetName() : "") << ';' << ValCtx.DxilMod.GetGlobalFlags()
+     << ';' << ValCtx.DxilMod.m_ShaderFlags.GetWaveOps() << ';'
+     << ValCtx.DL.getStringRepresentation();
+  return OS.str();
+}
+
+// Validates a function, skipping definitions that the function cache has
+// seen pass before and recording the ones that pass now.
+static void ValidateFunctionWithCache(Function &F, ValidationContext &ValCtx) {
+  ValCtx.Checkpoint();
+  if (ValCtx.pFunctionCache == nullptr || F.isDeclaration()) {
+    ValidateFunction(F, ValCtx);
+    return;
+  }
+
+  std::string digest = FunctionDigestBuilder(ValCtx).Build(F);
+  if (ValCtx.pFunctionCache->Contains(digest))
+    return;
+
+  bool failedBefore = ValCtx.Failed;
+  ValCtx.Failed = false;
+  ValidateFunction(F, ValCtx);
+  if (!ValCtx.Failed)
+    ValCtx.pFunctionCache->Insert(digest);
+  ValCtx.Failed |= failedBefore;
+}
+
+// Function bodies are spread across worker threads once there are enough of
+// them for the threads to pay off, as in libraries with many exports.
+static const size_t kMinFunctionsPerValidationThread = 4;
+
+// Validates every function in the module. Definitions are validated in
+// parallel, each into its own diagnostic buffer; declarations update state
+// shared across the module, so they are validated on this thread once the
+// workers are done. Diagnostics are merged in module order, as if every
+// function had been validated in turn.
+static void ValidateFunctions(ValidationContext &ValCtx) {
+  std::vector<Function *> definitions;
+  for (Function &F : ValCtx.M.functions()) {
+    if (!F.isDeclaration())
+      definitions.push_back(&F);
+  }
+
+  WorkerThreadReservation reservation(
+      (unsigned)(definitions.size() / kMinFunctionsPerValidationThread));
+  size_t threadCount = reservation.GetThreadCount();
+  if (threadCount < 2) {
+    for (Function &F : ValCtx.M.functions()) {
+      ValidateFunctionWithCache(F, ValCtx);
+    }
+    return;
+  }
+
+  struct FunctionResult {
+    std::string Diag;
+    bool Failed = false;
+  };
+  std::vector<FunctionResult> results(definitions.size());
+  std::vector<std::exception_ptr> errors(threadCount);
+  std::atomic<size_t> nextFunction(0);
+
+  // Struct layouts are computed and cached by the module's DataLayout on
+  // first use, and structs cache whether they are sized; neither is locked.
+  // Both are filled in here so the workers only read them.
+  TypeFinder structTypes;
+  structTypes.run(ValCtx.M, /*onlyNamed*/ false);
+  for (StructType *ST : structTypes) {
+    if (ST->isSized())
+      ValCtx.DL.getStructLayout(ST);
+  }
+
+  IMalloc *pMalloc = DxcGetThreadMallocNoRef();
+  auto worker = [&](size_t threadIndex) {
+    DxcThreadMalloc TM(pMalloc);
+    WorkerThreadScope workerScope;
+    try {
+      size_t i;
+      while ((i = nextFunction++) < definitions.size()) {
+        FunctionResult &result = results[i];
+        raw_string_ostream diagStream(result.Diag);
+        DiagnosticPrinterRawOStream DiagPrinter(diagStream);
+        ValidationContext FuncCtx(ValCtx, DiagPrinter);
+        ValidateFunctionWithCache(*definitions[i], FuncCtx);
+        diagStream.flush();
+        result.Failed = FuncCtx.Failed;
+      }
+    } catch (...) {
+      errors[threadIndex] = std::current_exception();
+      // Stop the other workers from picking up more functions.
+      nextFunction = definitions.size();
+    }
+  };
+
+  std::vector<std::thread> threads;
+  try {
+    for (size_t t = 1; t < threadCount; ++t)
+      threads.emplace_back(worker, t);
+  } catch (const std::system_error &) {
+    // Carry on with the threads that did start.
+  }
+  worker(0);
+  for (std::thread &thread : threads)
+    thread.join();
+  for (std::exception_ptr &error : errors) {
+    if (error)
+      std::rethrow_exception(error);
+  }
+
+  size_t definitionIndex = 0;
+  for (Function &F : ValCtx.M.functions()) {
+    if (F.isDeclaration()) {
+      ValidateFunction(F, ValCtx);
+      continue;
+    }
+    FunctionResult &result = results[definitionIndex++];
+    ValCtx.DiagStream() << result.Diag;
+    ValCtx.Failed |= result.Failed;
+  }
+}
+
 static void ValidateGlobalVariable(GlobalVariable &GV,
                                    ValidationContext &ValCtx) {
   bool isInternalGV =
@@ -2787,10 +3412,24 @@ static void ValidateTypeAnnotation(ValidationContext &ValCtx) {
       uint64_t tagValue = tag->getZExtValue();
       if (tagValue != DxilMDHelper::kDxilTypeSystemStructTag &&
           tagValue != DxilMDHelper::kDxilTypeSystemFunctionTag &&
-          tagValue != DxilMDHelper::kDxilTypeSystemFunction2Tag) {
+          tagValue != DxilMDHelper::kDxilTypeSystemFunction2Tag &&
+          tagValue != DxilMDHelper::kDxilTypeSystemPackedTag) {
           ValCtx.EmitMetaError(TANode, ValidationRule::MetaWellFormed);
           return;
       }
+      if (tagValue == DxilMDHelper::kDxilTypeSystemPackedTag) {
+        // The packed form was decoded when the module was loaded; check the
+        // flags it carries.
+        auto &FuncMap = ValCtx.DxilMod.GetTypeSystem().GetFunctionAnnotationMap();
+        for (auto &it : FuncMap) {
+          uint32_t flagValue = it.second->GetFlag().GetFlagValue();
+          if (flagValue != (uint32_t)DXIL::FPDenormMode::Any &&
+              flagValue != (uint32_t)DXIL::FPDenormMode::FTZ &&
+              flagValue != (uint32_t)DXIL::FPDenormMode::Preserve) {
+            ValCtx.EmitMetaError(TANode, ValidationRule::MetaFPFlag);
+          }
+        }
+      }
       if (tagValue == DxilMDHelper::kDxilTypeSystemFunction2Tag) {
           for (unsigned j = 2, jEnd = TANode->getNumOperands();
               j != jEnd; ++j) {
@@ -4177,12 +4816,23 @@ void GetValidationVersion(_Out_ unsigned *pMajor, _Out_ unsigned *pMinor) {
   // - ILDN container part support
   // 1.2 adds:
   // - Metadata for floating point denorm mode
+  // 1.3 adds:
+  // - PSV version 2, with resource names and cbuffer variables
+  // - LIDX container part in libraries, with the link index
+  // 1.4 adds:
+  // - HASH container part, with the shader content hash
+  // 1.5 adds:
+  // - PSV version 3, with the ranges of cbuffers that are read
+  // 1.6 adds:
+  // - dx.uniform metadata on instructions
   *pMajor = 1;
-  *pMinor = 2;
+  *pMinor = 6;
 }
 
 _Use_decl_annotations_ HRESULT
-ValidateDxilModule(llvm::Module *pModule, llvm::Module *pDebugModule) {
+ValidateDxilModule(llvm::Module *pModule, llvm::Module *pDebugModule,
+                   ValidationFunctionCache *pFunctionCache,
+                   CompilePhaseListener *pPhases) {
   std::string diagStr;
   raw_string_ostream diagStream(diagStr);
   DiagnosticPrinterRawOStream DiagPrinter(diagStream);
@@ -4193,6 +4843,11 @@ ValidateDxilModule(llvm::Module *pModule, llvm::Module *pDebugModule) {
   }
 
   ValidationContext ValCtx(*pModule, pDebugModule, *pDxilModule, DiagPrinter);
+  if (pFunctionCache) {
+    ValCtx.pFunctionCache = pFunctionCache;
+    ValCtx.FunctionCacheModuleState = GetFunctionCacheModuleState(ValCtx);
+  }
+  ValCtx.pPhases = pPhases;
 
   ValidateMetadata(ValCtx);
 
@@ -4204,13 +4859,13 @@ ValidateDxilModule(llvm::Module *pModule, llvm::Module *pDebugModule) {
 
   // Validate control flow and collect function call info.
   // If has recursive call, call info collection will not finish.
+  ValCtx.Checkpoint();
   ValidateFlowControl(ValCtx);
 
   // Validate functions.
-  for (Function &F : pModule->functions()) {
-    ValidateFunction(F, ValCtx);
-  }
+  ValidateFunctions(ValCtx);
 
+  ValCtx.Checkpoint();
   ValidateUninitializedOutput(ValCtx);
 
   ValidateShaderFlags(ValCtx);
@@ -4325,7 +4980,7 @@ bool VerifySignatureMatches(llvm::Module *pModule,
 static void VerifyPSVMatches(_In_ ValidationContext &ValCtx,
                              _In_reads_bytes_(PSVSize) const void *pPSVData,
                              _In_ uint32_t PSVSize) {
-  uint32_t PSVVersion = 1;  // This should be set to the newest version
+  uint32_t PSVVersion = 3;  // This should be set to the newest version
   unique_ptr<DxilPartWriter> pWriter(NewPSVWriter(ValCtx.DxilMod, PSVVersion));
   // Try each version in case an earlier version matches module
   while (PSVVersion && pWriter->size() != PSVSize) {
@@ -4374,11 +5029,43 @@ bool VerifyFeatureInfoMatches(llvm::Module *pModule,
   return !ValCtx.Failed;
 }
 
+static void VerifyShaderHashMatches(_In_ ValidationContext &ValCtx,
+                                    _In_ const DxilContainerHeader *pContainer,
+                                    _In_reads_bytes_(HashSize) const void *pHashData,
+                                    _In_ uint32_t HashSize) {
+  // The digest is the MD5 of the bitcode in the program part.
+  const DxilShaderHash *pHash = (const DxilShaderHash *)pHashData;
+  const DxilPartHeader *pProgramPart =
+      GetDxilPartByType(pContainer, DFCC_DXIL);
+  if (HashSize != sizeof(DxilShaderHash) || pHash->Flags != 0 ||
+      !pProgramPart) {
+    ValCtx.EmitFormatError(ValidationRule::ContainerPartMatches, {"Shader Hash"});
+    return;
+  }
+  const DxilProgramHeader *pProgramHeader =
+      (const DxilProgramHeader *)GetDxilPartData(pProgramPart);
+  if (!IsValidDxilProgramHeader(pProgramHeader, pProgramPart->PartSize)) {
+    ValCtx.EmitFormatError(ValidationRule::ContainerPartMatches, {"Shader Hash"});
+    return;
+  }
+  const char *pBitcode;
+  uint32_t BitcodeSize;
+  GetDxilProgramBitcode(pProgramHeader, &pBitcode, &BitcodeSize);
+  llvm::MD5 md5;
+  llvm::MD5::MD5Result md5Result;
+  md5.update(ArrayRef<uint8_t>((const uint8_t *)pBitcode, BitcodeSize));
+  md5.final(md5Result);
+  if (memcmp(pHash->Digest, md5Result, DxilShaderHashSize)) {
+    ValCtx.EmitFormatError(ValidationRule::ContainerPartMatches, {"Shader Hash"});
+  }
+}
+
 _Use_decl_annotations_
 HRESULT ValidateDxilContainerParts(llvm::Module *pModule,
                                    llvm::Module *pDebugModule,
                                    const DxilContainerHeader *pContainer,
-                                   uint32_t ContainerSize) {
+                                   uint32_t ContainerSize,
+                                   const DxilPartDigests *pTrustedParts) {
 
   DXASSERT_NOMSG(pModule);
   if (!pContainer || !IsValidDxilContainer(pContainer, ContainerSize)) {
@@ -4414,30 +5101,42 @@ HRESULT ValidateDxilContainerParts(llvm::Module *pModule,
     }
     FourCCFound.insert(pPart->PartFourCC);
 
+    // A part assembled from this module moments ago would be generated the
+    // same way again, so it is only checked to be unchanged since.
+    bool bTrusted = pTrustedParts && pTrustedParts->Matches(pPart);
+
     switch (pPart->PartFourCC)
     {
     case DFCC_InputSignature:
-      VerifySignatureMatches(ValCtx, DXIL::SignatureKind::Input, GetDxilPartData(pPart), pPart->PartSize);
+      if (!bTrusted)
+        VerifySignatureMatches(ValCtx, DXIL::SignatureKind::Input, GetDxilPartData(pPart), pPart->PartSize);
       break;
     case DFCC_OutputSignature:
-      VerifySignatureMatches(ValCtx, DXIL::SignatureKind::Output, GetDxilPartData(pPart), pPart->PartSize);
+      if (!bTrusted)
+        VerifySignatureMatches(ValCtx, DXIL::SignatureKind::Output, GetDxilPartData(pPart), pPart->PartSize);
       break;
     case DFCC_PatchConstantSignature:
-      if (bTess) {
-        VerifySignatureMatches(ValCtx, DXIL::SignatureKind::PatchConstant, GetDxilPartData(pPart), pPart->PartSize);
-      } else {
+      if (!bTess) {
         ValCtx.EmitFormatError(ValidationRule::ContainerPartMatches, {"Program Patch Constant Signature"});
+      } else if (!bTrusted) {
+        VerifySignatureMatches(ValCtx, DXIL::SignatureKind::PatchConstant, GetDxilPartData(pPart), pPart->PartSize);
       }
       break;
     case DFCC_FeatureInfo:
-      VerifyFeatureInfoMatches(ValCtx, GetDxilPartData(pPart), pPart->PartSize);
+      if (!bTrusted)
+        VerifyFeatureInfoMatches(ValCtx, GetDxilPartData(pPart), pPart->PartSize);
       break;
     case DFCC_RootSignature:
       pRootSignaturePart = pPart;
       break;
     case DFCC_PipelineStateValidation:
       pPSVPart = pPart;
-      VerifyPSVMatches(ValCtx, GetDxilPartData(pPart), pPart->PartSize);
+      if (!bTrusted)
+        VerifyPSVMatches(ValCtx, GetDxilPartData(pPart), pPart->PartSize);
+      break;
+    case DFCC_ShaderHash:
+      VerifyShaderHashMatches(ValCtx, pContainer, GetDxilPartData(pPart),
+                              pPart->PartSize);
       break;
 
     // Skip these
@@ -4447,6 +5146,7 @@ HRESULT ValidateDxilContainerParts(llvm::Module *pModule,
     case DFCC_DXIL:
     case DFCC_ShaderDebugInfoDXIL:
     case DFCC_ShaderDebugName:
+    case DFCC_LinkIndex:
       continue;
 
     case DFCC_Container:
@@ -4477,10 +5177,9 @@ HRESULT ValidateDxilContainerParts(llvm::Module *pModule,
   if (pPSVPart) {
     if (pRootSignaturePart) {
       try {
-        RootSignatureHandle RS;
-        RS.LoadSerialized((const uint8_t*)GetDxilPartData(pRootSignaturePart), pRootSignaturePart->PartSize);
-        RS.Deserialize();
-        IFTBOOL(VerifyRootSignatureWithShaderPSV(RS.GetDesc(),
+        SharedRootSignatureDesc pDesc = RootSignatureCache::Deserialize(
+            GetDxilPartData(pRootSignaturePart), pRootSignaturePart->PartSize);
+        IFTBOOL(VerifyRootSignatureWithShaderPSV(pDesc.get(),
                                                   pDxilModule->GetShaderModel()->GetKind(),
                                                   GetDxilPartData(pPSVPart), pPSVPart->PartSize,
                                                   DiagStream), DXC_E_INCORRECT_ROOT_SIGNATURE);
@@ -4520,9 +5219,12 @@ static HRESULT FindDxilPart(_In_reads_bytes_(ContainerSize) const void *pContain
     IFR(DXC_E_CONTAINER_MISSING_DXIL);
   }
 
+  // Only the debug part may be compressed.
   const DxilProgramHeader *pProgramHeader =
     reinterpret_cast<const DxilProgramHeader *>(GetDxilPartData(*it));
-  if (!IsValidDxilProgramHeader(pProgramHeader, (*it)->PartSize)) {
+  if (!IsValidDxilProgramHeader(pProgramHeader, (*it)->PartSize) &&
+      (FourCC != DFCC_ShaderDebugInfoDXIL ||
+       !IsCompressedDxilProgramHeader(pProgramHeader, (*it)->PartSize))) {
     IFR(DXC_E_CONTAINER_INVALID);
   }
 
@@ -4563,7 +5265,8 @@ HRESULT ValidateLoadModule(const char *pIL,
 HRESULT ValidateDxilBitcode(
   _In_reads_bytes_(ILLength) const char *pIL,
   _In_ uint32_t ILLength,
-  _In_ llvm::raw_ostream &DiagStream) {
+  _In_ llvm::raw_ostream &DiagStream,
+  _In_opt_ ValidationFunctionCache *pFunctionCache) {
 
   LLVMContext Ctx;
   std::unique_ptr<llvm::Module> pModule;
@@ -4578,7 +5281,7 @@ HRESULT ValidateDxilBitcode(
                                      /*bLazyLoad*/ false)))
     return hr;
 
-  if (FAILED(hr = ValidateDxilModule(pModule.get(), nullptr)))
+  if (FAILED(hr = ValidateDxilModule(pModule.get(), nullptr, pFunctionCache)))
     return hr;
 
   DxilModule &dxilModule = pModule->GetDxilModule();
@@ -4590,12 +5293,14 @@ HRESULT ValidateDxilBitcode(
     pOutputStream->Reserve(pWriter->size());
     pWriter->write(pOutputStream);
     const DxilVersionedRootSignatureDesc* pDesc = dxilModule.GetRootSignature().GetDesc();
-    RootSignatureHandle RS;
+    SharedRootSignatureDesc pSharedDesc;
     try {
       if (!pDesc) {
-        RS.Assign(nullptr, dxilModule.GetRootSignature().GetSerialized());
-        RS.Deserialize();
-        pDesc = RS.GetDesc();
+        IDxcBlob *pSerialized = dxilModule.GetRootSignature().GetSerialized();
+        pSharedDesc = RootSignatureCache::Deserialize(
+            pSerialized->GetBufferPointer(),
+            (uint32_t)pSerialized->GetBufferSize());
+        pDesc = pSharedDesc.get();
         if (!pDesc)
           return DXC_E_INCORRECT_ROOT_SIGNATURE;
       }
@@ -4646,11 +5351,17 @@ static HRESULT ValidateLoadModuleFromContainer(
   }
 
   if (pDbgPart) {
-    GetDxilProgramBitcode(
-        reinterpret_cast<const DxilProgramHeader *>(GetDxilPartData(pDbgPart)),
-        &pIL, &ILLength);
+    std::vector<char> DbgStorage;
+    if (!GetDecompressedDxilProgramBitcode(
+            reinterpret_cast<const DxilProgramHeader *>(
+                GetDxilPartData(pDbgPart)),
+            pDbgPart->PartSize, DbgStorage, &pIL, &ILLength)) {
+      return DXC_E_CONTAINER_INVALID;
+    }
+    // Decompressed bitcode doesn't outlive this call, so load it eagerly.
     if (FAILED(hr = ValidateLoadModule(pIL, ILLength, pDebugModule, DbgCtx,
-                                       DiagStream, bLazyLoad))) {
+                                       DiagStream,
+                                       bLazyLoad && DbgStorage.empty()))) {
       return hr;
     }
   }
@@ -4683,7 +5394,8 @@ _Use_decl_annotations_ HRESULT ValidateLoadModuleFromContainerLazy(
 _Use_decl_annotations_
 HRESULT ValidateDxilContainer(const void *pContainer,
                               uint32_t ContainerSize,
-                              llvm::raw_ostream &DiagStream) {
+                              llvm::raw_ostream &DiagStream,
+                              ValidationFunctionCache *pFunctionCache) {
   LLVMContext Ctx, DbgCtx;
   std::unique_ptr<llvm::Module> pModule, pDebugModule;
 
@@ -4698,7 +5410,7 @@ HRESULT ValidateDxilContainer(const void *pContainer,
       Ctx, DbgCtx, DiagStream));
 
   // Validate DXIL Module
-  IFR(ValidateDxilModule(pModule.get(), pDebugModule.get()));
+  IFR(ValidateDxilModule(pModule.get(), pDebugModule.get(), pFunctionCache));
 
   if (DiagContext.HasErrors() || DiagContext.HasWarnings()) {
     return DXC_E_IR_VERIFICATION_FAILED;
@@ -187,6 +187,9 @@ public:
     for (GlobalVariable *GV : staticGVs)
       runOnGlobal(GV);
 
+    m_loweredTypes.clear();
+    m_vecFunctions.clear();
+    m_majorCastMasks.clear();
     return true;
   }
 
@@ -211,6 +214,20 @@ private:
       AddToDeadInsts(I);
     }
   }
+  // Lowered types, vector HL functions and shuffle masks are shared by all
+  // matrix instructions of the module, so they are only built once.
+  DenseMap<Type *, Type *> m_loweredTypes;
+  DenseMap<std::pair<FunctionType *, std::pair<unsigned, unsigned>>,
+           Function *>
+      m_vecFunctions;
+  DenseMap<std::pair<Type *, unsigned>, Constant *> m_majorCastMasks;
+  // Memoized HLMatrixLower::LowerMatrixType.
+  Type *GetLoweredType(Type *Ty);
+  // Memoized GetOrCreateHLFunction for the vector version of HL functions.
+  Function *GetOrCreateVecFunction(FunctionType *FT, HLOpcodeGroup group,
+                                   unsigned opcode);
+  Function *GetOrCreateMadIntrinsic(Type *Ty, IntrinsicOp madOp);
+  Constant *GetMajorCastMask(Type *matTy, bool bRowToCol);
   void runOnFunction(Function &F);
   void runOnGlobal(GlobalVariable *GV);
   void runOnGlobalMatrixArray(GlobalVariable *GV);
@@ -291,6 +308,25 @@ ModulePass *llvm::createHLMatrixLowerPass() { return new HLMatrixLowerPass(); }
 
 INITIALIZE_PASS(HLMatrixLowerPass, "hlmatrixlower", "HLSL High-Level Matrix Lower", false, false)
 
+Type *HLMatrixLowerPass::GetLoweredType(Type *Ty) {
+  if (!isa<FunctionType>(Ty) && !IsMatrixType(Ty))
+    return Ty;
+  Type *&LoweredTy = m_loweredTypes[Ty];
+  if (!LoweredTy)
+    LoweredTy = LowerMatrixType(Ty);
+  return LoweredTy;
+}
+
+Function *HLMatrixLowerPass::GetOrCreateVecFunction(FunctionType *FT,
+                                                    HLOpcodeGroup group,
+                                                    unsigned opcode) {
+  Function *&F = m_vecFunctions[std::make_pair(
+      FT, std::make_pair(static_cast<unsigned>(group), opcode))];
+  if (!F)
+    F = GetOrCreateHLFunction(*m_pModule, FT, group, opcode);
+  return F;
+}
+
 static Instruction *CreateTypeCast(HLCastOpcode castOp, Type *toTy, Value *src,
                                    IRBuilder<> Builder) {
   // Cast to bool.
@@ -378,7 +414,7 @@ Instruction *HLMatrixLowerPass::MatCastToVec(CallInst *CI) {
       IRBuilder<> Builder(CI);
 
       // Here only lower the return type to vector.
-      Type *RetTy = LowerMatrixType(CI->getType());
+      Type *RetTy = GetLoweredType(CI->getType());
       SmallVector<Type *, 4> params;
       for (Value *operand : CI->arg_operands()) {
         params.emplace_back(operand->getType());
@@ -389,8 +425,8 @@ Instruction *HLMatrixLowerPass::MatCastToVec(CallInst *CI) {
       HLOpcodeGroup group = GetHLOpcodeGroupByName(CI->getCalledFunction());
       unsigned opcode = GetHLOpcode(CI);
 
-      Function *vecF = GetOrCreateHLFunction(*m_pModule, cast<FunctionType>(FT),
-                                             group, opcode);
+      Function *vecF =
+          GetOrCreateVecFunction(cast<FunctionType>(FT), group, opcode);
 
       SmallVector<Value *, 4> argList;
       for (Value *arg : CI->arg_operands()) {
@@ -426,7 +462,7 @@ Instruction *HLMatrixLowerPass::MatLdStToVec(CallInst *CI) {
       Value *vecPtr = matToVecMap[cast<Instruction>(matPtr)];
       Value *matVal = CI->getArgOperand(HLOperandIndex::kMatStoreValOpIdx);
       Value *vecVal =
-          UndefValue::get(HLMatrixLower::LowerMatrixType(matVal->getType()));
+          UndefValue::get(GetLoweredType(matVal->getType()));
       result = Builder.CreateStore(vecVal, vecPtr);
     } else
       result = MatIntrinsicToVec(CI);
@@ -455,7 +491,8 @@ Instruction *HLMatrixLowerPass::MatSubscriptToVec(CallInst *CI) {
 
     FunctionType *funcTy = FunctionType::get(CI->getType(), paramTyList, false);
     unsigned opcode = GetHLOpcode(CI);
-    Function *opFunc = GetOrCreateHLFunction(*m_pModule, funcTy, HLOpcodeGroup::HLSubscript, opcode);
+    Function *opFunc =
+        GetOrCreateVecFunction(funcTy, HLOpcodeGroup::HLSubscript, opcode);
     return Builder.CreateCall(opFunc, args);
   } else
     return MatIntrinsicToVec(CI);
@@ -464,14 +501,14 @@ Instruction *HLMatrixLowerPass::MatSubscriptToVec(CallInst *CI) {
 Instruction *HLMatrixLowerPass::MatFrExpToVec(CallInst *CI) {
   IRBuilder<> Builder(CI);
   FunctionType *FT = CI->getCalledFunction()->getFunctionType();
-  Type *RetTy = LowerMatrixType(FT->getReturnType());
+  Type *RetTy = GetLoweredType(FT->getReturnType());
   SmallVector<Type *, 4> params;
   for (Type *param : FT->params()) {
     if (!param->isPointerTy()) {
-      params.emplace_back(LowerMatrixType(param));
+      params.emplace_back(GetLoweredType(param));
     } else {
       // Lower pointer type for frexp.
-      Type *EltTy = LowerMatrixType(param->getPointerElementType());
+      Type *EltTy = GetLoweredType(param->getPointerElementType());
       params.emplace_back(
           PointerType::get(EltTy, param->getPointerAddressSpace()));
     }
@@ -481,8 +518,8 @@ Instruction *HLMatrixLowerPass::MatFrExpToVec(CallInst *CI) {
 
   HLOpcodeGroup group = GetHLOpcodeGroupByName(CI->getCalledFunction());
   Function *vecF =
-      GetOrCreateHLFunction(*m_pModule, cast<FunctionType>(VecFT), group,
-                            static_cast<unsigned>(IntrinsicOp::IOP_frexp));
+      GetOrCreateVecFunction(cast<FunctionType>(VecFT), group,
+                             static_cast<unsigned>(IntrinsicOp::IOP_frexp));
 
   SmallVector<Value *, 4> argList;
   auto paramTyIt = params.begin();
@@ -506,17 +543,17 @@ Instruction *HLMatrixLowerPass::MatIntrinsicToVec(CallInst *CI) {
   if (opcode == static_cast<unsigned>(IntrinsicOp::IOP_frexp))
     return MatFrExpToVec(CI);
 
-  Type *FT = LowerMatrixType(CI->getCalledFunction()->getFunctionType());
+  Type *FT = GetLoweredType(CI->getCalledFunction()->getFunctionType());
 
   HLOpcodeGroup group = GetHLOpcodeGroupByName(CI->getCalledFunction());
 
-  Function *vecF = GetOrCreateHLFunction(*m_pModule, cast<FunctionType>(FT), group, opcode);
+  Function *vecF = GetOrCreateVecFunction(cast<FunctionType>(FT), group, opcode);
 
   SmallVector<Value *, 4> argList;
   for (Value *arg : CI->arg_operands()) {
     Type *Ty = arg->getType();
     if (IsMatrixType(Ty)) {
-      argList.emplace_back(UndefValue::get(LowerMatrixType(Ty)));
+      argList.emplace_back(UndefValue::get(GetLoweredType(Ty)));
     } else
       argList.emplace_back(arg);
   }
@@ -541,7 +578,7 @@ static Value *VectorizeScalarOp(Value *op, Type *dstTy, IRBuilder<> &Builder) {
 }
 
 Instruction *HLMatrixLowerPass::TrivialMatUnOpToVec(CallInst *CI) {
-  Type *ResultTy = LowerMatrixType(CI->getType());
+  Type *ResultTy = GetLoweredType(CI->getType());
   UndefValue *tmp = UndefValue::get(ResultTy);
   IRBuilder<> Builder(CI);
   HLUnaryOpcode opcode = static_cast<HLUnaryOpcode>(GetHLOpcode(CI));
@@ -598,10 +635,10 @@ Instruction *HLMatrixLowerPass::TrivialMatUnOpToVec(CallInst *CI) {
 }
 
 Instruction *HLMatrixLowerPass::TrivialMatBinOpToVec(CallInst *CI) {
-  Type *ResultTy = LowerMatrixType(CI->getType());
+  Type *ResultTy = GetLoweredType(CI->getType());
   IRBuilder<> Builder(CI);
   HLBinaryOpcode opcode = static_cast<HLBinaryOpcode>(GetHLOpcode(CI));
-  Type *OpTy = LowerMatrixType(
+  Type *OpTy = GetLoweredType(
       CI->getOperand(HLOperandIndex::kBinaryOpSrc0Idx)->getType());
   UndefValue *tmp = UndefValue::get(OpTy);
   bool isFloat = OpTy->getVectorElementType()->isFloatingPointTy();
@@ -800,7 +837,7 @@ void HLMatrixLowerPass::lowerToVec(Instruction *matInst) {
       vecTy = vecTy->getPointerElementType();
       vecInst = Builder.CreateAlloca(vecTy, nullptr, AI->getName());
     } else {
-      Type *vecTy = HLMatrixLower::LowerMatrixType(matTy);
+      Type *vecTy = GetLoweredType(matTy);
       vecInst = Builder.CreateAlloca(vecTy, nullptr, AI->getName());
     }
     // Update debug info.
@@ -871,13 +908,14 @@ void HLMatrixLowerPass::TrivialMatBinOpReplace(CallInst *matInst,
   }
 }
 
-static Function *GetOrCreateMadIntrinsic(Type *Ty, Type *opcodeTy, IntrinsicOp madOp, Module &M) {
+Function *HLMatrixLowerPass::GetOrCreateMadIntrinsic(Type *Ty,
+                                                     IntrinsicOp madOp) {
+  Type *opcodeTy = Type::getInt32Ty(Ty->getContext());
   llvm::FunctionType *MadFuncTy =
       llvm::FunctionType::get(Ty, { opcodeTy, Ty, Ty, Ty}, false);
 
-  Function *MAD =
-      GetOrCreateHLFunction(M, MadFuncTy, HLOpcodeGroup::HLIntrinsic,
-                            (unsigned)madOp);
+  Function *MAD = GetOrCreateVecFunction(MadFuncTy, HLOpcodeGroup::HLIntrinsic,
+                                         (unsigned)madOp);
   return MAD;
 }
 
@@ -900,7 +938,7 @@ void HLMatrixLowerPass::TranslateMatMatMul(CallInst *matInst,
 
   bool isFloat = EltTy->isFloatingPointTy();
 
-  Value *retVal = llvm::UndefValue::get(LowerMatrixType(mulInst->getType()));
+  Value *retVal = llvm::UndefValue::get(GetLoweredType(mulInst->getType()));
   IRBuilder<> Builder(mulInst);
 
   Value *lMat = matToVecMap[cast<Instruction>(LVal)];
@@ -916,9 +954,7 @@ void HLMatrixLowerPass::TranslateMatMatMul(CallInst *matInst,
   };
 
   IntrinsicOp madOp = isSigned ? IntrinsicOp::IOP_mad : IntrinsicOp::IOP_umad;
-  Type *opcodeTy = Builder.getInt32Ty();
-  Function *Mad = GetOrCreateMadIntrinsic(EltTy, opcodeTy, madOp,
-                                          *m_pHLModule->GetModule());
+  Function *Mad = GetOrCreateMadIntrinsic(EltTy, madOp);
   Value *madOpArg = Builder.getInt32((unsigned)madOp);
 
   auto CreateOneEltMad = [&](unsigned r, unsigned lc, unsigned c,
@@ -969,9 +1005,7 @@ void HLMatrixLowerPass::TranslateMatVecMul(CallInst *matInst,
   Value *mat = vecInst; // vec version of matInst;
 
   IntrinsicOp madOp = isSigned ? IntrinsicOp::IOP_mad : IntrinsicOp::IOP_umad;
-  Type *opcodeTy = Builder.getInt32Ty();
-  Function *Mad = GetOrCreateMadIntrinsic(EltTy, opcodeTy, madOp,
-                                          *m_pHLModule->GetModule());
+  Function *Mad = GetOrCreateMadIntrinsic(EltTy, madOp);
   Value *madOpArg = Builder.getInt32((unsigned)madOp);
 
   auto CreateOneEltMad = [&](unsigned r, unsigned c, Value *acc) -> Value * {
@@ -1021,9 +1055,7 @@ void HLMatrixLowerPass::TranslateVecMatMul(CallInst *matInst,
   Value *mat = RVal;
 
   IntrinsicOp madOp = isSigned ? IntrinsicOp::IOP_mad : IntrinsicOp::IOP_umad;
-  Type *opcodeTy = Builder.getInt32Ty();
-  Function *Mad = GetOrCreateMadIntrinsic(EltTy, opcodeTy, madOp,
-                                          *m_pHLModule->GetModule());
+  Function *Mad = GetOrCreateMadIntrinsic(EltTy, madOp);
   Value *madOpArg = Builder.getInt32((unsigned)madOp);
 
   auto CreateOneEltMad = [&](unsigned r, unsigned c, Value *acc) -> Value * {
@@ -1191,18 +1223,14 @@ void HLMatrixLowerPass::TrivialMatReplace(CallInst *matInst,
     }
 }
 
-void HLMatrixLowerPass::TranslateMatMajorCast(CallInst *matInst,
-                                              Instruction *vecInst,
-                                              CallInst *castInst,
-                                              bool bRowToCol) {
-  unsigned col, row;
-  GetMatrixInfo(castInst->getType(), col, row);
-  DXASSERT(castInst->getType() == matInst->getType(), "type must match");
-
-  IRBuilder<> Builder(castInst);
+Constant *HLMatrixLowerPass::GetMajorCastMask(Type *matTy, bool bRowToCol) {
+  Constant *&Mask = m_majorCastMasks[std::make_pair(matTy, (unsigned)bRowToCol)];
+  if (Mask)
+    return Mask;
 
-  // shuf to change major.
-  SmallVector<int, 16> castMask(col * row);
+  unsigned col, row;
+  GetMatrixInfo(matTy, col, row);
+  SmallVector<uint32_t, 16> castMask(col * row);
   unsigned idx = 0;
   if (bRowToCol) {
     for (unsigned c = 0; c < col; c++)
@@ -1217,7 +1245,20 @@ void HLMatrixLowerPass::TranslateMatMajorCast(CallInst *matInst,
         castMask[idx++] = matIdx;
       }
   }
+  Mask = ConstantDataVector::get(matTy->getContext(), castMask);
+  return Mask;
+}
 
+void HLMatrixLowerPass::TranslateMatMajorCast(CallInst *matInst,
+                                              Instruction *vecInst,
+                                              CallInst *castInst,
+                                              bool bRowToCol) {
+  DXASSERT(castInst->getType() == matInst->getType(), "type must match");
+
+  IRBuilder<> Builder(castInst);
+
+  // shuf to change major.
+  Constant *castMask = GetMajorCastMask(castInst->getType(), bRowToCol);
   Instruction *vecCast = cast<Instruction>(
       Builder.CreateShuffleVector(vecInst, vecInst, castMask));
 
@@ -1535,7 +1576,7 @@ void HLMatrixLowerPass::TranslateMatLoadStoreOnGlobal(
   Type *matType = matGlobal->getType()->getPointerElementType();
   unsigned col, row;
   HLMatrixLower::GetMatrixInfo(matType, col, row);
-  Type *vecType = HLMatrixLower::LowerMatrixType(matType);
+  Type *vecType = GetLoweredType(matType);
 
   IRBuilder<> Builder(matLdStInst);
 
@@ -2108,10 +2149,15 @@ void HLMatrixLowerPass::finalMatTranslation(Instruction *matInst) {
 }
 
 void HLMatrixLowerPass::DeleteDeadInsts() {
+  // Drop the operands of all dead insts first, so uses among them go away
+  // together and only uses from live insts need to be replaced.
+  for (Instruction *deadInst : m_deadInsts)
+    deadInst->dropAllReferences();
   // Delete the matrix version insts.
   for (Instruction *deadInst : m_deadInsts) {
     // Replace with undef and remove it.
-    deadInst->replaceAllUsesWith(UndefValue::get(deadInst->getType()));
+    if (!deadInst->use_empty())
+      deadInst->replaceAllUsesWith(UndefValue::get(deadInst->getType()));
     deadInst->eraseFromParent();
   }
   m_deadInsts.clear();
@@ -2272,7 +2318,7 @@ void HLMatrixLowerPass::runOnGlobal(GlobalVariable *GV) {
 
   bool isConst = GV->isConstant();
 
-  Type *vecTy = HLMatrixLower::LowerMatrixType(Ty);
+  Type *vecTy = GetLoweredType(Ty);
   Module *M = GV->getParent();
   const DataLayout &DL = M->getDataLayout();
 
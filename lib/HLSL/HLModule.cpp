@@ -1263,6 +1263,29 @@ void HLModule::UpdateGlobalVariableDebugInfo(
                       DbgInfoFinder,/*removeDIGV*/true);
 }
 
+Function *HLModule::GetHLOperationFunction(HLOpcodeGroup group,
+                                           unsigned opcode,
+                                           FunctionType *funcTy) {
+  auto it = m_HLOperationFunctions.find(
+      HLOperationKey(funcTy, std::make_pair((unsigned)group, opcode)));
+  if (it == m_HLOperationFunctions.end())
+    return nullptr;
+  // The handle is null once the function is deleted, and follows it if it is
+  // replaced; only a function of the same type still serves.
+  Function *F = dyn_cast_or_null<Function>(it->second);
+  if (!F || F->getFunctionType() != funcTy) {
+    m_HLOperationFunctions.erase(it);
+    return nullptr;
+  }
+  return F;
+}
+
+void HLModule::SetHLOperationFunction(HLOpcodeGroup group, unsigned opcode,
+                                      FunctionType *funcTy, Function *F) {
+  m_HLOperationFunctions[HLOperationKey(
+      funcTy, std::make_pair((unsigned)group, opcode))] = F;
+}
+
 DebugInfoFinder &HLModule::GetOrCreateDebugInfoFinder() {
   if (m_pDebugInfoFinder == nullptr) {
     m_pDebugInfoFinder = llvm::make_unique<llvm::DebugInfoFinder>();
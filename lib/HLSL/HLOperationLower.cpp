@@ -11,6 +11,7 @@
 
 #include "dxc/HLSL/DxilModule.h"
 #include "dxc/HLSL/DxilOperations.h"
+#include "dxc/HLSL/DxilInstructions.h"
 #include "dxc/HLSL/HLMatrixLowerHelper.h"
 #include "dxc/HLSL/HLModule.h"
 #include "dxc/HLSL/DxilUtil.h"
@@ -19,10 +20,16 @@
 #include "dxc/HLSL/HLOperations.h"
 #include "dxc/HlslIntrinsicOp.h"
 
+#include "llvm/ADT/MapVector.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/IR/GetElementPtrTypeIterator.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/IR/LegacyPassManager.h"
 #include "llvm/IR/Module.h"
+#include "llvm/IR/ValueHandle.h"
+#include "llvm/Support/MathExtras.h"
+#include <algorithm>
 #include <unordered_set>
 
 using namespace llvm;
@@ -38,6 +45,7 @@ struct HLOperationLowerHelper {
   DxilTypeSystem &dxilTypeSys;
   DxilFunctionProps *functionProps;
   bool bLegacyCBufferLoad;
+  bool bMergeBufferAccess;
   DataLayout legacyDataLayout;
   HLOperationLowerHelper(HLModule &HLM);
 };
@@ -56,6 +64,7 @@ HLOperationLowerHelper::HLOperationLowerHelper(HLModule &HLM)
   if (HLM.HasDxilFunctionProps(EntryFunc))
     functionProps = &HLM.GetDxilFunctionProps(EntryFunc);
   bLegacyCBufferLoad = HLM.GetHLOptions().bLegacyCBufferLoad;
+  bMergeBufferAccess = HLM.GetHLOptions().bMergeBufferAccess;
 }
 
 struct HLObjectOperationLowerHelper {
@@ -4372,10 +4381,8 @@ IntrinsicLower gLowerTable[static_cast<unsigned>(IntrinsicOp::Num_Intrinsics)] =
 };
 }
 
-static void TranslateBuiltinIntrinsic(CallInst *CI,
+static void TranslateBuiltinIntrinsic(CallInst *CI, const IntrinsicLower &lower,
                                       HLOperationLowerHelper &helper,  HLObjectOperationLowerHelper *pObjHelper, bool &Translated) {
-  unsigned opcode = hlsl::GetHLOpcode(CI);
-  const IntrinsicLower &lower = gLowerTable[opcode];
   Value *Result =
       lower.LowerFunc(CI, lower.IntriOpcode, lower.DxilOpcode, helper, pObjHelper, Translated);
   if (Result)
@@ -5309,6 +5316,78 @@ void TranslateCBOperationsLegacy(Value *handle, Value *ptr, OP *hlslOP,
   }
 }
 
+// Merges CBufferLoadLegacy calls that read the same row of the same cbuffer
+// within a block into the first of them, and merges the extracts of the
+// same channel of that row. Lowering emits a row load per accessed element,
+// so shaders that read many fields of a row would otherwise carry one load
+// for each of them until CSE.
+void CoalesceCBufferLoadsLegacy(OP *hlslOP) {
+  typedef std::pair<BasicBlock *, Function *> BlockAndFunc;
+  typedef std::pair<Value *, Value *> HandleAndRow;
+  MapVector<std::pair<BlockAndFunc, HandleAndRow>, SmallVector<CallInst *, 4>>
+      rowLoads;
+  for (Function *F : hlslOP->GetOpFuncList(OP::OpCode::CBufferLoadLegacy)) {
+    if (F == nullptr)
+      continue;
+    for (User *U : F->users()) {
+      CallInst *CI = cast<CallInst>(U);
+      DxilInst_CBufferLoadLegacy rowLoad(CI);
+      rowLoads[std::make_pair(
+                   std::make_pair(CI->getParent(), F),
+                   std::make_pair(rowLoad.get_handle(),
+                                  rowLoad.get_regIndex()))]
+          .push_back(CI);
+    }
+  }
+
+  // Blocks are numbered on first use; merging only erases instructions, so
+  // the numbering stays valid for the ones that remain.
+  DenseMap<Instruction *, unsigned> order;
+  SmallPtrSet<BasicBlock *, 8> numberedBlocks;
+  auto getOrder = [&](Instruction *I) {
+    BasicBlock *BB = I->getParent();
+    if (numberedBlocks.insert(BB).second) {
+      unsigned n = 0;
+      for (Instruction &BBI : *BB)
+        order[&BBI] = n++;
+    }
+    return order[I];
+  };
+  auto isEarlier = [&](Instruction *A, Instruction *B) {
+    return getOrder(A) < getOrder(B);
+  };
+
+  for (auto &it : rowLoads) {
+    SmallVectorImpl<CallInst *> &loads = it.second;
+    if (loads.size() < 2)
+      continue;
+    CallInst *first = *std::min_element(loads.begin(), loads.end(), isEarlier);
+    for (CallInst *CI : loads) {
+      if (CI == first)
+        continue;
+      CI->replaceAllUsesWith(first);
+      CI->eraseFromParent();
+    }
+
+    SmallVector<ExtractValueInst *, 16> extracts;
+    for (User *U : first->users())
+      if (ExtractValueInst *EV = dyn_cast<ExtractValueInst>(U))
+        if (EV->getParent() == first->getParent())
+          extracts.push_back(EV);
+    std::sort(extracts.begin(), extracts.end(), isEarlier);
+    SmallDenseMap<unsigned, ExtractValueInst *, 8> channels;
+    for (ExtractValueInst *EV : extracts) {
+      ExtractValueInst *&channel = channels[*EV->idx_begin()];
+      if (channel == nullptr) {
+        channel = EV;
+        continue;
+      }
+      EV->replaceAllUsesWith(channel);
+      EV->eraseFromParent();
+    }
+  }
+}
+
 }
 
 // Structured buffer.
@@ -5972,6 +6051,242 @@ void TranslateStructBufSubscript(CallInst *CI, Value *handle, Value *status,
 }
 }
 
+// Structured buffer access merging.
+namespace {
+const unsigned kBufCompBytes = 4;
+const unsigned kBufMaxBytes = 4 * kBufCompBytes;
+
+// Byte range of a structured buffer element touched by a load or store.
+struct BufAccessRange {
+  unsigned Begin;
+  unsigned End;
+};
+
+bool GetConstStructBufOffset(Value *offset, unsigned &byteOffset) {
+  // Typed and raw buffer accesses have an undef offset.
+  ConstantInt *C = dyn_cast<ConstantInt>(offset);
+  if (C == nullptr)
+    return false;
+  byteOffset = C->getLimitedValue();
+  return (byteOffset % kBufCompBytes) == 0;
+}
+
+bool IsMergeableBufOverload(Type *Ty) {
+  return Ty->isFloatTy() || Ty->isIntegerTy(32);
+}
+
+// A load can be merged if it reads 32-bit components at a constant offset
+// and only its values are used, not its status.
+bool GetMergeableBufLoad(CallInst *CI, BufAccessRange &range) {
+  if (!OP::IsDxilOpFuncCallInst(CI, OP::OpCode::BufferLoad))
+    return false;
+  if (!IsMergeableBufOverload(CI->getType()->getStructElementType(0)))
+    return false;
+  DxilInst_BufferLoad bufLd(CI);
+  if (!GetConstStructBufOffset(bufLd.get_wot(), range.Begin))
+    return false;
+  if (CI->use_empty())
+    return false;
+  unsigned maxComp = 0;
+  for (User *U : CI->users()) {
+    ExtractValueInst *EV = dyn_cast<ExtractValueInst>(U);
+    if (EV == nullptr || *EV->idx_begin() >= 4)
+      return false;
+    maxComp = std::max(maxComp, *EV->idx_begin());
+  }
+  range.End = range.Begin + (maxComp + 1) * kBufCompBytes;
+  return true;
+}
+
+bool GetMergeableBufStore(CallInst *CI, BufAccessRange &range) {
+  if (!OP::IsDxilOpFuncCallInst(CI, OP::OpCode::BufferStore))
+    return false;
+  DxilInst_BufferStore bufSt(CI);
+  if (!IsMergeableBufOverload(bufSt.get_value0()->getType()))
+    return false;
+  if (!GetConstStructBufOffset(bufSt.get_coord1(), range.Begin))
+    return false;
+  ConstantInt *mask = dyn_cast<ConstantInt>(bufSt.get_mask());
+  if (mask == nullptr || mask->isZero())
+    return false;
+  unsigned maxComp = 31 - llvm::countLeadingZeros((uint32_t)mask->getLimitedValue());
+  range.End = range.Begin + (maxComp + 1) * kBufCompBytes;
+  return true;
+}
+
+// Accesses to the same element of the same buffer, through the same
+// overload, that fit in one 4-component access.
+struct BufAccessGroup {
+  SmallVector<CallInst *, 4> Accesses;
+  SmallVector<unsigned, 4> Offsets;
+  BufAccessRange Range;
+
+  bool CanAdd(const BufAccessRange &range) const {
+    if (Accesses.empty())
+      return true;
+    return std::max(Range.End, range.End) -
+               std::min(Range.Begin, range.Begin) <= kBufMaxBytes;
+  }
+  void Add(CallInst *CI, const BufAccessRange &range) {
+    if (Accesses.empty()) {
+      Range = range;
+    } else {
+      Range.Begin = std::min(Range.Begin, range.Begin);
+      Range.End = std::max(Range.End, range.End);
+    }
+    Accesses.push_back(CI);
+    Offsets.push_back(range.Begin);
+  }
+};
+
+// Replaces the loads of a group with one load at the position of the first,
+// which precedes every use of the others.
+void MergeBufLoads(BufAccessGroup &group, hlsl::OP *OP) {
+  if (group.Accesses.size() < 2)
+    return;
+  CallInst *first = group.Accesses.front();
+  DxilInst_BufferLoad firstLd(first);
+  IRBuilder<> Builder(first);
+  Value *Args[] = {first->getArgOperand(0), firstLd.get_srv(),
+                   firstLd.get_index(), OP->GetU32Const(group.Range.Begin)};
+  Value *Ld = Builder.CreateCall(first->getCalledFunction(), Args,
+                                 OP::GetOpCodeName(OP::OpCode::BufferLoad));
+  Value *comps[4] = {nullptr, nullptr, nullptr, nullptr};
+  for (unsigned i = 0; i < group.Accesses.size(); ++i) {
+    CallInst *CI = group.Accesses[i];
+    unsigned compBase = (group.Offsets[i] - group.Range.Begin) / kBufCompBytes;
+    for (auto U = CI->user_begin(); U != CI->user_end();) {
+      ExtractValueInst *EV = cast<ExtractValueInst>(*(U++));
+      unsigned comp = compBase + *EV->idx_begin();
+      if (comps[comp] == nullptr)
+        comps[comp] = Builder.CreateExtractValue(Ld, comp);
+      EV->replaceAllUsesWith(comps[comp]);
+      EV->eraseFromParent();
+    }
+  }
+  for (CallInst *CI : group.Accesses)
+    CI->eraseFromParent();
+}
+
+// Replaces the stores of a group with one store at the position of the
+// last, after every value stored has been computed. Later stores to a
+// component take precedence, as they did before.
+void MergeBufStores(BufAccessGroup &group, hlsl::OP *OP) {
+  if (group.Accesses.size() < 2)
+    return;
+  CallInst *last = group.Accesses.back();
+  DxilInst_BufferStore lastSt(last);
+  Value *undefVal = UndefValue::get(lastSt.get_value0()->getType());
+  Value *vals[4] = {undefVal, undefVal, undefVal, undefVal};
+  unsigned mask = 0;
+  for (unsigned i = 0; i < group.Accesses.size(); ++i) {
+    DxilInst_BufferStore bufSt(group.Accesses[i]);
+    unsigned compBase = (group.Offsets[i] - group.Range.Begin) / kBufCompBytes;
+    unsigned stMask = cast<ConstantInt>(bufSt.get_mask())->getLimitedValue();
+    Value *stVals[4] = {bufSt.get_value0(), bufSt.get_value1(),
+                        bufSt.get_value2(), bufSt.get_value3()};
+    for (unsigned j = 0; j < 4; ++j) {
+      if ((stMask & (1 << j)) == 0)
+        continue;
+      vals[compBase + j] = stVals[j];
+      mask |= 1 << (compBase + j);
+    }
+  }
+  IRBuilder<> Builder(last);
+  Value *Args[] = {last->getArgOperand(0),
+                   lastSt.get_uav(),
+                   lastSt.get_coord0(),
+                   OP->GetU32Const(group.Range.Begin),
+                   vals[0],
+                   vals[1],
+                   vals[2],
+                   vals[3],
+                   OP->GetU8Const(mask)};
+  Builder.CreateCall(last->getCalledFunction(), Args);
+  for (CallInst *CI : group.Accesses)
+    CI->eraseFromParent();
+}
+
+typedef std::pair<Function *, std::pair<Value *, Value *>> BufAccessKey;
+
+BufAccessKey GetBufAccessKey(CallInst *CI) {
+  // Operands 1 and 2 are the handle and element index of loads and stores.
+  return std::make_pair(CI->getCalledFunction(),
+                        std::make_pair(CI->getArgOperand(1),
+                                       CI->getArgOperand(2)));
+}
+
+// Merges accesses in program order. Loads move up to the first load of
+// their group, so a group is closed by anything that may write memory;
+// stores move down to the last store, so a group is closed by anything that
+// may read or write memory.
+void MergeStructBufAccessesInBlock(BasicBlock &BB, hlsl::OP *OP) {
+  MapVector<BufAccessKey, BufAccessGroup> loadGroups;
+  BufAccessKey storeKey;
+  BufAccessGroup storeGroup;
+
+  auto flushLoads = [&]() {
+    for (auto &it : loadGroups)
+      MergeBufLoads(it.second, OP);
+    loadGroups.clear();
+  };
+  auto flushStores = [&]() {
+    MergeBufStores(storeGroup, OP);
+    storeGroup = BufAccessGroup();
+  };
+
+  for (auto It = BB.begin(), E = BB.end(); It != E;) {
+    Instruction *I = It++;
+    CallInst *CI = dyn_cast<CallInst>(I);
+    BufAccessRange range;
+    if (CI && GetMergeableBufLoad(CI, range)) {
+      flushStores();
+      BufAccessGroup &group = loadGroups[GetBufAccessKey(CI)];
+      if (!group.CanAdd(range)) {
+        MergeBufLoads(group, OP);
+        group = BufAccessGroup();
+      }
+      group.Add(CI, range);
+    } else if (CI && GetMergeableBufStore(CI, range)) {
+      flushLoads();
+      BufAccessKey key = GetBufAccessKey(CI);
+      if (!storeGroup.Accesses.empty() &&
+          (key != storeKey || !storeGroup.CanAdd(range)))
+        flushStores();
+      storeKey = key;
+      storeGroup.Add(CI, range);
+    } else if (I->mayWriteToMemory()) {
+      flushLoads();
+      flushStores();
+    } else if (I->mayReadFromMemory()) {
+      flushStores();
+    }
+  }
+  flushLoads();
+  flushStores();
+}
+
+// Merges structured buffer loads and stores to adjacent fields of the same
+// element within a block into 4-component accesses. Element access is
+// lowered one field at a time, so reading or writing several fields would
+// otherwise issue a buffer operation for each of them.
+void MergeStructBufAccesses(hlsl::OP *OP) {
+  MapVector<BasicBlock *, unsigned> accessCounts;
+  for (OP::OpCode opcode : {OP::OpCode::BufferLoad, OP::OpCode::BufferStore}) {
+    for (Function *F : OP->GetOpFuncList(opcode)) {
+      if (F == nullptr)
+        continue;
+      for (User *U : F->users())
+        ++accessCounts[cast<CallInst>(U)->getParent()];
+    }
+  }
+  for (auto &it : accessCounts) {
+    if (it.second > 1)
+      MergeStructBufAccessesInBlock(*it.first, OP);
+  }
+}
+}
+
 // HLSubscript.
 namespace {
 
@@ -6357,75 +6672,148 @@ void TranslateHLSubscript(CallInst *CI, HLSubscriptOpcode opcode,
 
 }
 
-void TranslateSubscriptOperation(Function *F, HLOperationLowerHelper &helper,  HLObjectOperationLowerHelper *pObjHelper) {
-  for (auto U = F->user_begin(); U != F->user_end();) {
-    Value *user = *(U++);
-    if (!isa<Instruction>(user))
+namespace {
+// Refers to a call waiting in the lowering worklist. The handle is cleared
+// if lowering an earlier call erases this one; unlike WeakVH, it does not
+// follow replaceAllUsesWith to the replacement value.
+class HLCallHandle : public CallbackVH {
+public:
+  HLCallHandle(CallInst *CI) : CallbackVH(CI) {}
+  HLCallHandle(const HLCallHandle &RHS) : CallbackVH(RHS) {}
+  CallInst *getCall() const {
+    return cast_or_null<CallInst>(static_cast<Value *>(*this));
+  }
+};
+
+struct HLLowerCall {
+  HLCallHandle Call;
+  unsigned Opcode;
+  // Lowering entry for HLIntrinsic calls, resolved when the call is queued.
+  const IntrinsicLower *pLower;
+};
+
+// The calls to one HL declaration, in use-list order.
+struct HLLowerBatch {
+  Function *F;
+  HLOpcodeGroup Group;
+  unsigned Begin, End; // Range of the batch in HLLowerWorklist::Calls.
+};
+
+// All HL call sites of a module, collected in a single walk so that each
+// declaration's user list is visited and each call's dispatch is resolved
+// only once. Batches keep module order, which keeps the output stable.
+struct HLLowerWorklist {
+  std::vector<HLLowerBatch> Batches;
+  std::vector<HLLowerCall> Calls;
+
+  void AddFunction(Function *F, HLOpcodeGroup group) {
+    HLLowerBatch batch = {F, group, (unsigned)Calls.size(), 0};
+    if (group == HLOpcodeGroup::HLIntrinsic ||
+        group == HLOpcodeGroup::HLSubscript) {
+      for (User *U : F->users()) {
+        if (!isa<Instruction>(U))
+          continue;
+        // must be call inst
+        CallInst *CI = cast<CallInst>(U);
+        unsigned opcode = GetHLOpcode(CI);
+        const IntrinsicLower *pLower = nullptr;
+        if (group == HLOpcodeGroup::HLIntrinsic)
+          pLower = &gLowerTable[opcode];
+        Calls.push_back({HLCallHandle(CI), opcode, pLower});
+      }
+    }
+    batch.End = Calls.size();
+    Batches.push_back(batch);
+  }
+};
+
+// Reports each run of calls to the same intrinsic as a region of the
+// lowering pass, so phase reports show lowering time per intrinsic.
+class HLLowerRegion {
+  legacy::PassRunListener *m_pListener;
+  const char *m_pName;
+
+public:
+  HLLowerRegion(legacy::PassRunListener *pListener)
+      : m_pListener(pListener), m_pName(nullptr) {}
+  ~HLLowerRegion() { Set(nullptr); }
+  void Set(const char *pName) {
+    if (!m_pListener || pName == m_pName)
+      return;
+    if (m_pName)
+      m_pListener->regionFinished(m_pName);
+    m_pName = pName;
+    if (m_pName)
+      m_pListener->regionStarted(m_pName);
+  }
+};
+
+const char *GetHLLowerRegionName(HLOpcodeGroup group, unsigned opcode) {
+  switch (group) {
+  case HLOpcodeGroup::HLIntrinsic:
+    return GetIntrinsicOpName(static_cast<IntrinsicOp>(opcode));
+  case HLOpcodeGroup::HLSubscript:
+    return "HL subscript";
+  default:
+    return "HL extension intrinsic";
+  }
+}
+
+void TranslateHLCalls(const HLLowerWorklist &worklist,
+                      const HLLowerBatch &batch,
+                      HLOperationLowerHelper &helper,
+                      HLObjectOperationLowerHelper *pObjHelper,
+                      HLLowerRegion &region) {
+  for (unsigned i = batch.Begin; i != batch.End; ++i) {
+    const HLLowerCall &item = worklist.Calls[i];
+    CallInst *CI = item.Call.getCall();
+    // Skip calls erased while lowering an earlier one.
+    if (CI == nullptr)
       continue;
-    // must be call inst
-    CallInst *CI = cast<CallInst>(user);
-    unsigned opcode = GetHLOpcode(CI);
+    region.Set(GetHLLowerRegionName(batch.Group, item.Opcode));
+
+    // Keep the instruction to lower by other function.
     bool Translated = true;
-    TranslateHLSubscript(
-        CI, static_cast<HLSubscriptOpcode>(opcode), helper, pObjHelper, Translated);
+    if (batch.Group == HLOpcodeGroup::HLIntrinsic) {
+      TranslateBuiltinIntrinsic(CI, *item.pLower, helper, pObjHelper,
+                                Translated);
+      DXASSERT(!Translated || CI->use_empty(),
+               "else TranslateBuiltinIntrinsic didn't replace/erase uses");
+    } else {
+      TranslateHLSubscript(CI, static_cast<HLSubscriptOpcode>(item.Opcode),
+                           helper, pObjHelper, Translated);
+      DXASSERT(!Translated || CI->use_empty(),
+               "else TranslateHLSubscript didn't replace/erase uses");
+    }
     if (Translated) {
       // delete the call
-      DXASSERT(CI->use_empty(),
-               "else TranslateHLSubscript didn't replace/erase uses");
       CI->eraseFromParent();
     }
   }
 }
 
-void TranslateHLBuiltinOperation(Function *F, HLOperationLowerHelper &helper,
-                               hlsl::HLOpcodeGroup group, HLObjectOperationLowerHelper *pObjHelper) {
-  if (group == HLOpcodeGroup::HLIntrinsic) {
-    // map to dxil operations
-    for (auto U = F->user_begin(); U != F->user_end();) {
-      Value *User = *(U++);
-      if (!isa<Instruction>(User))
-        continue;
-      // must be call inst
-      CallInst *CI = cast<CallInst>(User);
-
-      // Keep the instruction to lower by other function.
-      bool Translated = true;
+void CheckHLMatLoadStore(Function *F) {
+  // Both ld/st use arg1 for the pointer.
+  Type *PtrTy =
+      F->getFunctionType()->getParamType(HLOperandIndex::kMatLoadPtrOpIdx);
 
-      TranslateBuiltinIntrinsic(CI, helper, pObjHelper, Translated);
-
-      if (Translated) {
-        // delete the call
-        DXASSERT(CI->use_empty(),
-                 "else TranslateBuiltinIntrinsic didn't replace/erase uses");
-        CI->eraseFromParent();
-      }
-    }
-  } else {
-    if (group == HLOpcodeGroup::HLMatLoadStore) {
-      // Both ld/st use arg1 for the pointer.
-      Type *PtrTy =
-          F->getFunctionType()->getParamType(HLOperandIndex::kMatLoadPtrOpIdx);
-
-      if (PtrTy->getPointerAddressSpace() == DXIL::kTGSMAddrSpace ||
-          // TODO: use DeviceAddressSpace for SRV/UAV and CBufferAddressSpace
-          // for CBuffer.
-          PtrTy->getPointerAddressSpace() == DXIL::kDefaultAddrSpace) {
-        // Translate matrix into vector of array for share memory or local
-        // variable should be done in HLMatrixLowerPass.
-        if (!F->user_empty())
-          F->getContext().emitError("Fail to lower matrix load/store.");
-      }
-    } else if (group == HLOpcodeGroup::HLSubscript) {
-      TranslateSubscriptOperation(F, helper, pObjHelper);
-    }
-    // map to math function or llvm ir
+  if (PtrTy->getPointerAddressSpace() == DXIL::kTGSMAddrSpace ||
+      // TODO: use DeviceAddressSpace for SRV/UAV and CBufferAddressSpace
+      // for CBuffer.
+      PtrTy->getPointerAddressSpace() == DXIL::kDefaultAddrSpace) {
+    // Translate matrix into vector of array for share memory or local
+    // variable should be done in HLMatrixLowerPass.
+    if (!F->user_empty())
+      F->getContext().emitError("Fail to lower matrix load/store.");
   }
 }
+}
 
 typedef std::unordered_map<llvm::Instruction *, llvm::Value *> HandleMap;
 static void TranslateHLExtension(Function *F,
                                  HLSLExtensionsCodegenHelper *helper,
-                                 OP& hlslOp) {
+                                 OP& hlslOp,
+                                 ExtensionLowering::HelperCache &cache) {
   // Find all calls to the function F.
   // Store the calls in a vector for now to be replaced the loop below.
   // We use a two step "find then replace" to avoid removing uses while
@@ -6439,7 +6827,7 @@ static void TranslateHLExtension(Function *F,
 
   // Get the lowering strategy to use for this intrinsic.
   llvm::StringRef LowerStrategy = GetHLLowerStrategy(F);
-  ExtensionLowering lower(LowerStrategy, helper, hlslOp);
+  ExtensionLowering lower(LowerStrategy, helper, hlslOp, &cache);
 
   // Replace all calls that were successfully translated.
   for (CallInst *CI : CallsToReplace) {
@@ -6457,7 +6845,8 @@ namespace hlsl {
 void TranslateBuiltinOperations(
     HLModule &HLM, HLSLExtensionsCodegenHelper *extCodegenHelper,
     std::unordered_set<LoadInst *> &UpdateCounterSet,
-    std::unordered_set<Value *> &NonUniformSet) {
+    std::unordered_set<Value *> &NonUniformSet,
+    legacy::PassRunListener *pListener) {
   HLOperationLowerHelper helper(HLM);
 
   HLObjectOperationLowerHelper objHelper = {HLM, UpdateCounterSet,
@@ -6465,7 +6854,8 @@ void TranslateBuiltinOperations(
 
   Module *M = HLM.GetModule();
 
-  // generate dxil operation
+  // Queue every HL call site before lowering any of them.
+  HLLowerWorklist worklist;
   for (iplist<Function>::iterator F : M->getFunctionList()) {
     if (!F->isDeclaration()) {
       continue;
@@ -6477,16 +6867,42 @@ void TranslateBuiltinOperations(
       // Nothing to do.
       continue;
     }
-    if (group == HLOpcodeGroup::HLExtIntrinsic) {
-      TranslateHLExtension(F, extCodegenHelper, helper.hlslOP);
-      continue;
-    }
     if (group == HLOpcodeGroup::HLCreateHandle) {
       // Will lower in later pass.
       continue;
     }
-    TranslateHLBuiltinOperation(F, helper, group, &objHelper);
+    worklist.AddFunction(F, group);
+  }
+
+  // generate dxil operation
+  HLLowerRegion region(pListener);
+  ExtensionLowering::HelperCache extensionCache;
+  for (const HLLowerBatch &batch : worklist.Batches) {
+    switch (batch.Group) {
+    case HLOpcodeGroup::HLExtIntrinsic:
+      region.Set(GetHLLowerRegionName(batch.Group, 0));
+      TranslateHLExtension(batch.F, extCodegenHelper, helper.hlslOP,
+                           extensionCache);
+      break;
+    case HLOpcodeGroup::HLIntrinsic:
+    case HLOpcodeGroup::HLSubscript:
+      TranslateHLCalls(worklist, batch, helper, &objHelper, region);
+      break;
+    case HLOpcodeGroup::HLMatLoadStore:
+      region.Set(nullptr);
+      CheckHLMatLoadStore(batch.F);
+      break;
+    default:
+      // map to math function or llvm ir
+      break;
+    }
   }
+  region.Set(nullptr);
+
+  if (helper.bLegacyCBufferLoad)
+    CoalesceCBufferLoadsLegacy(&helper.hlslOP);
+  if (helper.bMergeBufferAccess)
+    MergeStructBufAccesses(&helper.hlslOP);
 }
 
 }
@@ -53,14 +53,35 @@ llvm::StringRef ExtensionLowering::GetStrategyName(Strategy strategy) {
   return "?";
 }
 
-ExtensionLowering::ExtensionLowering(Strategy strategy, HLSLExtensionsCodegenHelper *helper, OP& hlslOp)
+ExtensionLowering::ExtensionLowering(Strategy strategy, HLSLExtensionsCodegenHelper *helper, OP& hlslOp, HelperCache *cache)
   : m_strategy(strategy), m_helper(helper), m_hlslOp(hlslOp)
+  , m_cache(cache ? *cache : m_ownCache)
   {}
 
-ExtensionLowering::ExtensionLowering(StringRef strategy, HLSLExtensionsCodegenHelper *helper, OP& hlslOp)
-  : ExtensionLowering(GetStrategy(strategy), helper, hlslOp)
+ExtensionLowering::ExtensionLowering(StringRef strategy, HLSLExtensionsCodegenHelper *helper, OP& hlslOp, HelperCache *cache)
+  : ExtensionLowering(GetStrategy(strategy), helper, hlslOp, cache)
   {}
 
+const std::string &ExtensionLowering::GetIntrinsicName(unsigned opcode) {
+  auto it = m_cache.IntrinsicNames.find(opcode);
+  if (it == m_cache.IntrinsicNames.end())
+    it = m_cache.IntrinsicNames.emplace(opcode, m_helper->GetIntrinsicName(opcode)).first;
+  return it->second;
+}
+
+bool ExtensionLowering::GetDxilOpcode(unsigned opcode, unsigned &dxilOpcode) {
+  auto it = m_cache.DxilOpcodes.find(opcode);
+  if (it == m_cache.DxilOpcodes.end()) {
+    OP::OpCode mapped;
+    int value = m_helper->GetDxilOpcode(opcode, mapped) ? static_cast<int>(mapped) : -1;
+    it = m_cache.DxilOpcodes.emplace(opcode, value).first;
+  }
+  if (it->second < 0)
+    return false;
+  dxilOpcode = static_cast<unsigned>(it->second);
+  return true;
+}
+
 llvm::Value *ExtensionLowering::Translate(llvm::CallInst *CI) {
   switch (m_strategy) {
   case Strategy::NoTranslation: return NoTranslation(CI);
@@ -618,9 +639,10 @@ Value *ExtensionLowering::Resource(CallInst *CI) {
 Value *ExtensionLowering::Dxil(CallInst *CI) {
   // Map the extension opcode to the corresponding dxil opcode.
   unsigned extOpcode = GetHLOpcode(CI);
-  OP::OpCode dxilOpcode;
-  if (!m_helper->GetDxilOpcode(extOpcode, dxilOpcode))
+  unsigned mappedOpcode;
+  if (!GetDxilOpcode(extOpcode, mappedOpcode))
     return nullptr;
+  OP::OpCode dxilOpcode = static_cast<OP::OpCode>(mappedOpcode);
 
   // Find the dxil function based on the overload type.
   Type *overloadTy = m_hlslOp.GetOverloadType(dxilOpcode, CI->getCalledFunction());
@@ -653,16 +675,14 @@ Value *ExtensionLowering::Dxil(CallInst *CI) {
 // chooses a default name based on the lowergin strategy.
 class ExtensionName {
 public:
-  ExtensionName(CallInst *CI, ExtensionLowering::Strategy strategy, HLSLExtensionsCodegenHelper *helper)
+  ExtensionName(CallInst *CI, ExtensionLowering::Strategy strategy, StringRef intrinsicName)
     : m_CI(CI)
     , m_strategy(strategy)
-    , m_helper(helper)
+    , m_intrinsicName(intrinsicName)
   {}
 
   std::string Get() {
-    std::string name;
-    if (m_helper)
-      name = GetCustomExtensionName(m_CI, *m_helper);
+    std::string name = GetCustomExtensionName(m_CI, m_intrinsicName);
 
     if (!HasCustomExtensionName(name))
       name = GetDefaultCustomExtensionName(m_CI, ExtensionLowering::GetStrategyName(m_strategy));
@@ -673,11 +693,10 @@ public:
 private:
   CallInst *m_CI;
   ExtensionLowering::Strategy m_strategy;
-  HLSLExtensionsCodegenHelper *m_helper;
+  StringRef m_intrinsicName;
 
-  static std::string GetCustomExtensionName(CallInst *CI, HLSLExtensionsCodegenHelper &helper) {
-    unsigned opcode = GetHLOpcode(CI);
-    std::string name = helper.GetIntrinsicName(opcode);
+  static std::string GetCustomExtensionName(CallInst *CI, StringRef intrinsicName) {
+    std::string name = intrinsicName;
     ReplaceOverloadMarkerWithTypeName(name, CI);
 
     return name;
@@ -742,6 +761,12 @@ private:
 };
 
 std::string ExtensionLowering::GetExtensionName(llvm::CallInst *CI) {
-  ExtensionName name(CI, m_strategy, m_helper);
-  return name.Get();
+  unsigned opcode = GetHLOpcode(CI);
+  auto it = m_extensionNames.find(opcode);
+  if (it == m_extensionNames.end()) {
+    StringRef intrinsicName = m_helper ? StringRef(GetIntrinsicName(opcode)) : StringRef();
+    ExtensionName name(CI, m_strategy, intrinsicName);
+    it = m_extensionNames.emplace(opcode, name.Get()).first;
+  }
+  return it->second;
 }
@@ -12,7 +12,9 @@
 #pragma once
 
 #include "dxc/HLSL/HLOperations.h"
+#include "dxc/HLSL/HLModule.h"
 #include "dxc/HlslIntrinsicOp.h"
+#include "llvm/ADT/SmallString.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Module.h"
@@ -277,38 +279,33 @@ void SetHLLowerStrategy(Function *F, StringRef S) {
   F->addFnAttr(HLLowerStrategy, S);
 }
 
-std::string GetHLFullName(HLOpcodeGroup op, unsigned opcode) {
+static void WriteHLFullName(raw_ostream &OS, HLOpcodeGroup op,
+                            unsigned opcode) {
   assert(op != HLOpcodeGroup::HLExtIntrinsic && "else table name should be used");
-  std::string opName = GetHLOpcodeGroupFullName(op).str() + ".";
+  OS << GetHLOpcodeGroupFullName(op) << '.';
 
   switch (op) {
-  case HLOpcodeGroup::HLBinOp: {
-    HLBinaryOpcode binOp = static_cast<HLBinaryOpcode>(opcode);
-    return opName + GetHLOpcodeName(binOp).str();
-  }
-  case HLOpcodeGroup::HLUnOp: {
-    HLUnaryOpcode unOp = static_cast<HLUnaryOpcode>(opcode);
-    return opName + GetHLOpcodeName(unOp).str();
-  }
-  case HLOpcodeGroup::HLIntrinsic: {
+  case HLOpcodeGroup::HLBinOp:
+    OS << GetHLOpcodeName(static_cast<HLBinaryOpcode>(opcode));
+    break;
+  case HLOpcodeGroup::HLUnOp:
+    OS << GetHLOpcodeName(static_cast<HLUnaryOpcode>(opcode));
+    break;
+  case HLOpcodeGroup::HLIntrinsic:
     // intrinsic with same signature will share the funciton now
     // The opcode is in arg0.
-    return opName;
-  }
-  case HLOpcodeGroup::HLMatLoadStore: {
-    HLMatLoadStoreOpcode matOp = static_cast<HLMatLoadStoreOpcode>(opcode);
-    return opName + GetHLOpcodeName(matOp).str();
-  }
-  case HLOpcodeGroup::HLSubscript: {
-    HLSubscriptOpcode subOp = static_cast<HLSubscriptOpcode>(opcode);
-    return opName + GetHLOpcodeName(subOp).str();
-  }
-  case HLOpcodeGroup::HLCast: {
-    HLCastOpcode castOp = static_cast<HLCastOpcode>(opcode);
-    return opName + GetHLOpcodeName(castOp).str();
-  }
+    break;
+  case HLOpcodeGroup::HLMatLoadStore:
+    OS << GetHLOpcodeName(static_cast<HLMatLoadStoreOpcode>(opcode));
+    break;
+  case HLOpcodeGroup::HLSubscript:
+    OS << GetHLOpcodeName(static_cast<HLSubscriptOpcode>(opcode));
+    break;
+  case HLOpcodeGroup::HLCast:
+    OS << GetHLOpcodeName(static_cast<HLCastOpcode>(opcode));
+    break;
   default:
-    return opName;
+    break;
   }
 }
 
@@ -438,8 +435,20 @@ Function *GetOrCreateHLFunction(Module &M, FunctionType *funcTy,
 Function *GetOrCreateHLFunction(Module &M, FunctionType *funcTy,
                                 HLOpcodeGroup group, llvm::StringRef *groupName,
                                 llvm::StringRef *fnName, unsigned opcode) {
-  std::string mangledName;
-  raw_string_ostream mangledNameStr(mangledName);
+  // Extension intrinsics are named by their table, so only the others are
+  // cached; their name is built only when the cache misses.
+  HLModule *pHLModule = nullptr;
+  if (group != HLOpcodeGroup::HLExtIntrinsic && M.HasHLModule()) {
+    pHLModule = &M.GetHLModule();
+    if (Function *F =
+            pHLModule->GetHLOperationFunction(group, opcode, funcTy)) {
+      SetHLFunctionAttribute(F, group, opcode);
+      return F;
+    }
+  }
+
+  SmallString<128> mangledName;
+  raw_svector_ostream mangledNameStr(mangledName);
   if (group == HLOpcodeGroup::HLExtIntrinsic) {
     assert(groupName && "else intrinsic should have been rejected");
     assert(fnName && "else intrinsic should have been rejected");
@@ -448,19 +457,20 @@ Function *GetOrCreateHLFunction(Module &M, FunctionType *funcTy,
     mangledNameStr << *fnName;
   }
   else {
-    mangledNameStr << GetHLFullName(group, opcode);
+    WriteHLFullName(mangledNameStr, group, opcode);
     mangledNameStr << '.';
     funcTy->print(mangledNameStr);
   }
 
-  mangledNameStr.flush();
-
-  Function *F = cast<Function>(M.getOrInsertFunction(mangledName, funcTy));
+  Function *F =
+      cast<Function>(M.getOrInsertFunction(mangledNameStr.str(), funcTy));
   if (group == HLOpcodeGroup::HLExtIntrinsic) {
     F->addFnAttr(hlsl::HLPrefix, *groupName);
   }
 
   SetHLFunctionAttribute(F, group, opcode);
+  if (pHLModule)
+    pHLModule->SetHLOperationFunction(group, opcode, funcTy, F);
 
   return F;
 }
@@ -470,13 +480,14 @@ Function *GetOrCreateHLFunction(Module &M, FunctionType *funcTy,
 Function *GetOrCreateHLFunctionWithBody(Module &M, FunctionType *funcTy,
                                         HLOpcodeGroup group, unsigned opcode,
                                         StringRef name) {
-  std::string operatorName = GetHLFullName(group, opcode);
-  std::string mangledName = operatorName + "." + name.str();
-  raw_string_ostream mangledNameStr(mangledName);
+  SmallString<128> mangledName;
+  raw_svector_ostream mangledNameStr(mangledName);
+  WriteHLFullName(mangledNameStr, group, opcode);
+  mangledNameStr << '.' << name;
   funcTy->print(mangledNameStr);
-  mangledNameStr.flush();
 
-  Function *F = cast<Function>(M.getOrInsertFunction(mangledName, funcTy));
+  Function *F =
+      cast<Function>(M.getOrInsertFunction(mangledNameStr.str(), funcTy));
 
   SetHLFunctionAttribute(F, group, opcode);
 
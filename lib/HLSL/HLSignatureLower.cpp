@@ -20,6 +20,7 @@
 #include "dxc/HLSL/HLMatrixLowerHelper.h"
 #include "dxc/HlslIntrinsicOp.h"
 
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/DebugInfo.h"
 #include "llvm/Transforms/Utils/Local.h"
@@ -510,10 +511,42 @@ void replaceStWithStOutput(Function *stOutput, StoreInst *stInst,
   }
 }
 
+// Input loads of one signature element whose row, column and vertex are all
+// constant. Each is created once at the start of the entry block and shared by
+// every use, rather than loaded again at each use.
+class InputLoadCache {
+public:
+  InputLoadCache(BasicBlock *EntryBB) : EntryBB(EntryBB) {}
+  // Returns the load for args, or null if its indices aren't constant.
+  Value *GetLoad(Function *loadInput, ArrayRef<Value *> args) {
+    Value *rowIdx = args[DXIL::OperandIndex::kLoadInputRowOpIdx];
+    Value *colIdx = args[DXIL::OperandIndex::kLoadInputColOpIdx];
+    Value *vertexID = args.size() > DXIL::OperandIndex::kLoadInputVertexIDOpIdx
+                          ? args[DXIL::OperandIndex::kLoadInputVertexIDOpIdx]
+                          : nullptr;
+    if (!isa<Constant>(rowIdx) || !isa<Constant>(colIdx) ||
+        (vertexID && !isa<Constant>(vertexID)))
+      return nullptr;
+    Value *&input =
+        Loads[std::make_pair(rowIdx, std::make_pair(colIdx, vertexID))];
+    if (!input) {
+      IRBuilder<> Builder(EntryBB->getFirstInsertionPt());
+      input = Builder.CreateCall(loadInput, args);
+    }
+    return input;
+  }
+
+private:
+  BasicBlock *EntryBB;
+  DenseMap<std::pair<Value *, std::pair<Value *, Value *>>, Value *> Loads;
+};
+
 Value *GenerateLdInput(Function *loadInput, ArrayRef<Value *> args,
                        IRBuilder<> &Builder, Value *zero, bool bCast,
-                       Type *Ty) {
-  Value *input = Builder.CreateCall(loadInput, args);
+                       Type *Ty, InputLoadCache *cache = nullptr) {
+  Value *input = cache ? cache->GetLoad(loadInput, args) : nullptr;
+  if (!input)
+    input = Builder.CreateCall(loadInput, args);
   if (!bCast)
     return input;
   else {
@@ -528,7 +561,7 @@ Value *GenerateLdInput(Function *loadInput, ArrayRef<Value *> args,
 
 Value *replaceLdWithLdInput(Function *loadInput, LoadInst *ldInst,
                             unsigned cols, MutableArrayRef<Value *> args,
-                            bool bCast) {
+                            bool bCast, InputLoadCache *cache) {
   IRBuilder<> Builder(ldInst);
   Type *Ty = ldInst->getType();
   Type *EltTy = Ty->getScalarType();
@@ -541,8 +574,8 @@ Value *replaceLdWithLdInput(Function *loadInput, LoadInst *ldInst,
     for (unsigned col = 0; col < cols; col++) {
       Value *colIdx = Builder.getInt8(col);
       args[DXIL::OperandIndex::kLoadInputColOpIdx] = colIdx;
-      Value *input =
-          GenerateLdInput(loadInput, args, Builder, zero, bCast, EltTy);
+      Value *input = GenerateLdInput(loadInput, args, Builder, zero, bCast,
+                                     EltTy, cache);
       newVec = Builder.CreateInsertElement(newVec, input, col);
     }
     ldInst->replaceAllUsesWith(newVec);
@@ -561,8 +594,8 @@ Value *replaceLdWithLdInput(Function *loadInput, LoadInst *ldInst,
 
     if (isa<ConstantInt>(colIdx)) {
       args[DXIL::OperandIndex::kLoadInputColOpIdx] = colIdx;
-      Value *input =
-          GenerateLdInput(loadInput, args, Builder, zero, bCast, EltTy);
+      Value *input = GenerateLdInput(loadInput, args, Builder, zero, bCast,
+                                     EltTy, cache);
       ldInst->replaceAllUsesWith(input);
       ldInst->eraseFromParent();
       return input;
@@ -576,8 +609,8 @@ Value *replaceLdWithLdInput(Function *loadInput, LoadInst *ldInst,
       for (unsigned col = 0; col < cols; col++) {
         Value *colIdx = Builder.getInt8(col);
         args[DXIL::OperandIndex::kLoadInputColOpIdx] = colIdx;
-        Value *input =
-            GenerateLdInput(loadInput, args, Builder, zero, bCast, EltTy);
+        Value *input = GenerateLdInput(loadInput, args, Builder, zero, bCast,
+                                       EltTy, cache);
         Value *GEP = Builder.CreateInBoundsGEP(arrayVec, {zeroIdx, colIdx});
         Builder.CreateStore(input, GEP);
       }
@@ -821,7 +854,8 @@ void collectInputOutputAccessInfo(
 void GenerateInputOutputUserCall(InputOutputAccessInfo &info, Value *undefVertexIdx,
     Function *ldStFunc, Constant *OpArg, Constant *ID, unsigned cols, bool bI1Cast,
     Constant *columnConsts[],
-    bool bNeedVertexID, bool isArrayTy, bool bInput, bool bIsInout) {
+    bool bNeedVertexID, bool isArrayTy, bool bInput, bool bIsInout,
+    InputLoadCache *cache) {
   Value *idxVal = info.idx;
   Value *vertexID = undefVertexIdx;
   if (bNeedVertexID && isArrayTy) {
@@ -833,7 +867,7 @@ void GenerateInputOutputUserCall(InputOutputAccessInfo &info, Value *undefVertex
     if (vertexID)
       args.emplace_back(vertexID);
 
-    replaceLdWithLdInput(ldStFunc, ldInst, cols, args, bI1Cast);
+    replaceLdWithLdInput(ldStFunc, ldInst, cols, args, bI1Cast, cache);
   } else if (StoreInst *stInst = dyn_cast<StoreInst>(info.user)) {
     if (bInput) {
       DXASSERT_LOCALVAR(bIsInout, bIsInout, "input should not have store use.");
@@ -908,7 +942,9 @@ void GenerateInputOutputUserCall(InputOutputAccessInfo &info, Value *undefVertex
           if (vertexID)
             args.emplace_back(vertexID);
 
-          Value *input = LocalBuilder.CreateCall(ldStFunc, args);
+          Value *input = cache->GetLoad(ldStFunc, args);
+          if (!input)
+            input = LocalBuilder.CreateCall(ldStFunc, args);
           unsigned matIdx = c * row + r;
           matElts[matIdx] = input;
         }
@@ -934,7 +970,9 @@ void GenerateInputOutputUserCall(InputOutputAccessInfo &info, Value *undefVertex
           if (vertexID)
             args.emplace_back(vertexID);
 
-          Value *input = LocalBuilder.CreateCall(ldStFunc, args);
+          Value *input = cache->GetLoad(ldStFunc, args);
+          if (!input)
+            input = LocalBuilder.CreateCall(ldStFunc, args);
           unsigned matIdx = r * col + c;
           matElts[matIdx] = input;
         }
@@ -1100,10 +1138,11 @@ void HLSignatureLower::GenerateDxilInputsOutputs(bool bInput) {
     collectInputOutputAccessInfo(GV, constZero, accessInfoList,
                                  bNeedVertexID && bIsArrayTy, bInput, bRowMajor);
 
+    InputLoadCache cache(&Entry->getEntryBlock());
     for (InputOutputAccessInfo &info : accessInfoList) {
       GenerateInputOutputUserCall(info, undefVertexIdx, dxilFunc, OpArg, ID,
                                   cols, bI1Cast, columnConsts, bNeedVertexID,
-                                  bIsArrayTy, bInput, bIsInout);
+                                  bIsArrayTy, bInput, bIsInout, &cache);
     }
   }
 }
@@ -1277,10 +1316,11 @@ void HLSignatureLower::GenerateDxilPatchConstantLdSt() {
     if (isPrecise)
       HLModule::MarkPreciseAttributeOnPtrWithFunctionCall(GV, M);
 
+    InputLoadCache cache(InsertPt->getParent());
     for (InputOutputAccessInfo &info : accessInfoList) {
       GenerateInputOutputUserCall(info, undefVertexIdx, dxilFunc, OpArg, ID,
                                   cols, bI1Cast, columnConsts, bNeedVertexID,
-                                  bIsArrayTy, bIsInput, bIsInout);
+                                  bIsArrayTy, bIsInput, bIsInout, &cache);
     }
   }
 }
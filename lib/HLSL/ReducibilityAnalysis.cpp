@@ -18,6 +18,7 @@
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/IR/CFG.h"
+#include "llvm/ADT/DenseMap.h"
 
 #include <vector>
 #include <unordered_map>
@@ -76,20 +77,6 @@ struct Node {
   IdxSet m_Pred;
 };
 
-class NodeWorklist {
-public:
-  NodeWorklist(size_t MaxSize) : m_Size(0) { m_Data.resize(MaxSize); }
-
-  size_t Size() const { return m_Size; }
-  unsigned Get(size_t idx) const { return m_Data[idx]; }
-  void PushBack(unsigned Val) { m_Data[m_Size++] = Val; }
-  void Clear() { m_Size = 0; }
-
-private:
-  size_t m_Size;
-  vector<unsigned> m_Data;
-};
-
 static bool IsEntryNode(size_t NodeIdx) {
   return NodeIdx == 0;
 }
@@ -100,7 +87,7 @@ bool ReducibilityAnalysis::runOnFunction(Function &F) {
   IFTBOOL(F.size() < UINT32_MAX, DXC_E_DATA_TOO_LARGE);
 
   vector<Node> Nodes(F.size());
-  unordered_map<BasicBlock*, unsigned> BasicBlockToNodeIdxMap;
+  DenseMap<BasicBlock*, unsigned> BasicBlockToNodeIdxMap;
 
   //
   // Initialize.
@@ -130,78 +117,82 @@ bool ReducibilityAnalysis::runOnFunction(Function &F) {
   //
   // Reduce.
   //
-  NodeWorklist Q1(Nodes.size()), Q2(Nodes.size());
-  NodeWorklist *pReady = &Q1, *pWaiting = &Q2;
-  for (unsigned i = 0; i < Nodes.size(); i++) {
-    pReady->PushBack(i);
+  // T1/T2 reduction reaches the same limit graph in any order, so rather
+  // than sweeping all nodes until nothing changes, only nodes whose edges
+  // changed are looked at again.
+  vector<bool> Removed(Nodes.size(), false);
+  vector<bool> Queued(Nodes.size(), true);
+  vector<unsigned> Worklist;
+  Worklist.reserve(Nodes.size());
+  for (unsigned i = Nodes.size(); i > 0; i--) {
+    Worklist.push_back(i - 1);
   }
+  auto Enqueue = [&](unsigned N) {
+    if (!Removed[N] && !Queued[N]) {
+      Queued[N] = true;
+      Worklist.push_back(N);
+    }
+  };
+  size_t NumNodes = Nodes.size();
+
+  while (!Worklist.empty()) {
+    unsigned N = Worklist.back();
+    Worklist.pop_back();
+    Queued[N] = false;
+    if (Removed[N])
+      continue;
+    Node *pNode = &Nodes[N];
+
+    // T1: self-edge.
+    auto itSucc = pNode->m_Succ.find(N);
+    if (itSucc != pNode->m_Succ.end()) {
+      pNode->m_Succ.erase(itSucc);
+      auto s1 = pNode->m_Pred.erase(N); DXASSERT_LOCALVAR(s1, s1 == 1, "otherwise check Pred/Succ sets");
+      Enqueue(N);
+      continue;
+    }
 
-  for (;;) {
-    bool bChanged = false;
-    pWaiting->Clear();
-    
-    for (unsigned iNode = 0; iNode < pReady->Size(); iNode++) {
-      unsigned N = pReady->Get(iNode);
-      Node *pNode = &Nodes[N];
-
-      // T1: self-edge.
-      auto itSucc = pNode->m_Succ.find(N);
-      if (itSucc != pNode->m_Succ.end()) {
-        pWaiting->PushBack(N);
-        pNode->m_Succ.erase(itSucc);
-        auto s1 = pNode->m_Pred.erase(N); DXASSERT_LOCALVAR(s1, s1 == 1, "otherwise check Pred/Succ sets");
-
-        bChanged = true;
-        continue;
-      }
-
-      // T2: single predecessor.
-      if (pNode->m_Pred.size() == 1) {
-        unsigned PredNode = *pNode->m_Pred.begin();
-        Node *pPredNode = &Nodes[PredNode];
-        auto s1 = pPredNode->m_Succ.erase(N); DXASSERT_LOCALVAR(s1, s1 == 1, "otherwise check Pred/Succ sets");
-        // Do not update N's sets, as N is discarded and never looked at again.
-
-        for (auto itSucc = pNode->m_Succ.begin(), endSucc = pNode->m_Succ.end(); itSucc != endSucc; ++itSucc) {
-          unsigned SuccNode = *itSucc;
-          Node *pSuccNode = &Nodes[SuccNode];
-          auto s2 = pSuccNode->m_Pred.erase(N); DXASSERT_LOCALVAR(s2, s2, "otherwise check Pred/Succ sets");
-          pPredNode->m_Succ.insert(SuccNode);
-          pSuccNode->m_Pred.insert(PredNode);
-        }
-
-        bChanged = true;
-        continue;
-      }
-
-      // Unreachable.
-      if (pNode->m_Pred.size() == 0 && !IsEntryNode(N)) {
-        for (auto itSucc = pNode->m_Succ.begin(), endSucc = pNode->m_Succ.end(); itSucc != endSucc; ++itSucc) {
-          unsigned SuccNode = *itSucc;
-          Node *pSuccNode = &Nodes[SuccNode];
-          auto s1 = pSuccNode->m_Pred.erase(N); DXASSERT_LOCALVAR(s1, s1, "otherwise check Pred/Succ sets");
-        }
-
-        bChanged = true;
-        continue;
+    // T2: single predecessor.
+    if (pNode->m_Pred.size() == 1) {
+      unsigned PredNode = *pNode->m_Pred.begin();
+      Node *pPredNode = &Nodes[PredNode];
+      auto s1 = pPredNode->m_Succ.erase(N); DXASSERT_LOCALVAR(s1, s1 == 1, "otherwise check Pred/Succ sets");
+      // Do not update N's sets, as N is discarded and never looked at again.
+
+      for (auto itSucc = pNode->m_Succ.begin(), endSucc = pNode->m_Succ.end(); itSucc != endSucc; ++itSucc) {
+        unsigned SuccNode = *itSucc;
+        Node *pSuccNode = &Nodes[SuccNode];
+        auto s2 = pSuccNode->m_Pred.erase(N); DXASSERT_LOCALVAR(s2, s2, "otherwise check Pred/Succ sets");
+        pPredNode->m_Succ.insert(SuccNode);
+        pSuccNode->m_Pred.insert(PredNode);
+        Enqueue(SuccNode);
       }
 
-      // Could not reduce.
-      pWaiting->PushBack(N);
+      Removed[N] = true;
+      NumNodes--;
+      Enqueue(PredNode);
+      continue;
     }
 
-    if (pWaiting->Size() == 1) {
-      break;
-    }
+    // Unreachable.
+    if (pNode->m_Pred.size() == 0 && !IsEntryNode(N)) {
+      for (auto itSucc = pNode->m_Succ.begin(), endSucc = pNode->m_Succ.end(); itSucc != endSucc; ++itSucc) {
+        unsigned SuccNode = *itSucc;
+        Node *pSuccNode = &Nodes[SuccNode];
+        auto s1 = pSuccNode->m_Pred.erase(N); DXASSERT_LOCALVAR(s1, s1, "otherwise check Pred/Succ sets");
+        Enqueue(SuccNode);
+      }
 
-    if (!bChanged) {
-      m_bReducible = false;
-      break;
+      Removed[N] = true;
+      NumNodes--;
+      continue;
     }
 
-    std::swap(pReady, pWaiting);
+    // Could not reduce; N is looked at again if its edges change.
   }
 
+  m_bReducible = NumNodes == 1;
+
   if (!IsReducible()) {
     switch (m_Action) {
     case IrreducibilityAction::ThrowException:
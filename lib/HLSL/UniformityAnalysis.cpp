@@ -0,0 +1,255 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// UniformityAnalysis.cpp                                                    //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// This file provides an analysis of the values that are the same for all    //
+// active lanes of a wave.                                                   //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/HLSL/DxilGenerationPass.h"
+#include "dxc/HLSL/DxilOperations.h"
+#include "dxc/HLSL/DxilConstants.h"
+
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/GenericDomTreeConstruction.h"
+
+#include <vector>
+
+using namespace llvm;
+
+namespace hlsl {
+
+// Values start out uniform and are marked divergent when they read per-lane
+// state or depend on a divergent value, which is the usual forward
+// divergence analysis.
+//
+// Control flow adds two more ways to diverge:
+// - a phi where paths from a divergent branch meet merges values from lanes
+//   that went different ways;
+// - a value defined in a loop and used after it, when lanes may leave the
+//   loop on different iterations.
+class UniformityAnalyzer : public UniformityAnalysis {
+private:
+  SmallPtrSet<Value *, 64> Divergent;
+  std::vector<Value *> WorkList;
+  DominatorTree DT;
+  DominatorTreeBase<BasicBlock> PDT{true};
+  LoopInfo LI;
+  void MarkDivergent(Value *V);
+  void VisitUser(Value *V, Instruction *U);
+  void MarkJoins(TerminatorInst *TI);
+  void MarkLoopExits(TerminatorInst *TI);
+public:
+  void Analyze(Function *F);
+  bool IsUniform(Value *V);
+};
+
+UniformityAnalysis* UniformityAnalysis::create() {
+  return new UniformityAnalyzer();
+}
+
+// Whether a dx.op gives each lane its own value, whatever its operands.
+static bool IsPerLaneOp(OP::OpCodeClass opClass) {
+  switch (opClass) {
+  case OP::OpCodeClass::FlattenedThreadIdInGroup:
+  case OP::OpCodeClass::ThreadId:
+  case OP::OpCodeClass::ThreadIdInGroup:
+  case OP::OpCodeClass::LoadInput:
+  case OP::OpCodeClass::LoadOutputControlPoint:
+  case OP::OpCodeClass::LoadPatchConstant:
+  case OP::OpCodeClass::DomainLocation:
+  case OP::OpCodeClass::GSInstanceID:
+  case OP::OpCodeClass::ViewID:
+  case OP::OpCodeClass::OutputControlPointID:
+  case OP::OpCodeClass::PrimitiveID:
+  case OP::OpCodeClass::AttributeAtVertex:
+  case OP::OpCodeClass::Coverage:
+  case OP::OpCodeClass::InnerCoverage:
+  case OP::OpCodeClass::SampleIndex:
+  case OP::OpCodeClass::EvalCentroid:
+  case OP::OpCodeClass::EvalSampleIndex:
+  case OP::OpCodeClass::EvalSnapped:
+  case OP::OpCodeClass::AtomicBinOp:
+  case OP::OpCodeClass::AtomicCompareExchange:
+  case OP::OpCodeClass::BufferUpdateCounter:
+  case OP::OpCodeClass::CycleCounterLegacy:
+  case OP::OpCodeClass::MinPrecXRegLoad:
+  case OP::OpCodeClass::TempRegLoad:
+  case OP::OpCodeClass::QuadOp:
+  case OP::OpCodeClass::QuadReadLaneAt:
+  case OP::OpCodeClass::WaveGetLaneIndex:
+  case OP::OpCodeClass::WaveIsFirstLane:
+  case OP::OpCodeClass::WavePrefixOp:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// Whether a dx.op gives all active lanes the same value, whatever its
+// operands.
+static bool IsWaveUniformOp(OP::OpCodeClass opClass) {
+  switch (opClass) {
+  case OP::OpCodeClass::WaveActiveAllEqual:
+  case OP::OpCodeClass::WaveActiveBallot:
+  case OP::OpCodeClass::WaveActiveBit:
+  case OP::OpCodeClass::WaveActiveOp:
+  case OP::OpCodeClass::WaveAllOp:
+  case OP::OpCodeClass::WaveAllTrue:
+  case OP::OpCodeClass::WaveAnyTrue:
+  case OP::OpCodeClass::WaveGetLaneCount:
+  case OP::OpCodeClass::WaveReadLaneFirst:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// Whether lanes loading the same address from Ptr read the same value.
+// Thread-private memory may hold a different value for every lane.
+static bool IsSharedMemory(Value *Ptr, const DataLayout &DL) {
+  switch (Ptr->getType()->getPointerAddressSpace()) {
+  case DXIL::kTGSMAddrSpace:
+  case DXIL::kCBufferAddrSpace:
+  case DXIL::kImmediateCBufferAddrSpace:
+    return true;
+  default:
+    break;
+  }
+  GlobalVariable *GV =
+      dyn_cast<GlobalVariable>(GetUnderlyingObject(Ptr, DL));
+  return GV && GV->isConstant();
+}
+
+static bool IsDivergentSource(Instruction *I) {
+  if (CallInst *CI = dyn_cast<CallInst>(I)) {
+    if (!OP::IsDxilOpFuncCallInst(CI))
+      return !CI->getType()->isVoidTy();
+    return IsPerLaneOp(OP::GetOpCodeClass(OP::GetDxilOpFuncCallInst(CI)));
+  }
+  if (LoadInst *LI = dyn_cast<LoadInst>(I))
+    return !IsSharedMemory(LI->getPointerOperand(),
+                           I->getModule()->getDataLayout());
+  return isa<AtomicRMWInst>(I) || isa<AtomicCmpXchgInst>(I);
+}
+
+void UniformityAnalyzer::MarkDivergent(Value *V) {
+  if (Divergent.insert(V).second)
+    WorkList.push_back(V);
+}
+
+// V became divergent; decides whether its user U follows.
+void UniformityAnalyzer::VisitUser(Value *V, Instruction *U) {
+  if (CallInst *CI = dyn_cast<CallInst>(U)) {
+    if (OP::IsDxilOpFuncCallInst(CI)) {
+      OP::OpCode opcode = OP::GetDxilOpFuncCallInst(CI);
+      OP::OpCodeClass opClass = OP::GetOpCodeClass(opcode);
+      if (IsWaveUniformOp(opClass))
+        return;
+      // Every lane reads the same lane unless the lane index diverges.
+      if (opClass == OP::OpCodeClass::WaveReadLaneAt &&
+          V != CI->getArgOperand(2))
+        return;
+    }
+  }
+  // Stores don't make the memory diverge in a way that matters here: private
+  // memory is already divergent, and lanes reading shared memory at the
+  // same address read it at the same time.
+  if (isa<StoreInst>(U))
+    return;
+  MarkDivergent(U);
+}
+
+// Marks the phis where paths from TI's successors meet again. They are in
+// the blocks reachable from TI before its immediate post-dominator, and in
+// that post-dominator itself.
+void UniformityAnalyzer::MarkJoins(TerminatorInst *TI) {
+  BasicBlock *BB = TI->getParent();
+  DomTreeNodeBase<BasicBlock> *Node = PDT.getNode(BB);
+  BasicBlock *IPDom = Node && Node->getIDom() ? Node->getIDom()->getBlock()
+                                              : nullptr;
+  SmallPtrSet<BasicBlock *, 16> Visited;
+  SmallVector<BasicBlock *, 16> Blocks(succ_begin(BB), succ_end(BB));
+  while (!Blocks.empty()) {
+    BasicBlock *Succ = Blocks.pop_back_val();
+    if (!Visited.insert(Succ).second)
+      continue;
+    for (BasicBlock::iterator I = Succ->begin(); isa<PHINode>(I); ++I) {
+      PHINode *Phi = cast<PHINode>(I);
+      if (!Phi->hasConstantValue())
+        MarkDivergent(Phi);
+    }
+    if (Succ != IPDom && Succ != BB)
+      Blocks.append(succ_begin(Succ), succ_end(Succ));
+  }
+}
+
+// When TI leaves loops, lanes may leave them on different iterations, so
+// values from inside the loops differ once used outside.
+void UniformityAnalyzer::MarkLoopExits(TerminatorInst *TI) {
+  BasicBlock *BB = TI->getParent();
+  for (Loop *L = LI.getLoopFor(BB); L; L = L->getParentLoop()) {
+    bool bExits = false;
+    for (BasicBlock *Succ : TI->successors())
+      bExits |= !L->contains(Succ);
+    if (!bExits)
+      continue;
+    for (BasicBlock *LoopBB : L->blocks()) {
+      for (Instruction &I : *LoopBB) {
+        for (User *U : I.users()) {
+          Instruction *UI = cast<Instruction>(U);
+          if (!L->contains(UI->getParent()))
+            MarkDivergent(UI);
+        }
+      }
+    }
+  }
+}
+
+void UniformityAnalyzer::Analyze(Function *F) {
+  DT.recalculate(*F);
+  PDT.recalculate(*F);
+  LI.Analyze(DT);
+
+  // Callers of a function may pass anything.
+  for (Argument &Arg : F->args())
+    MarkDivergent(&Arg);
+  for (BasicBlock &BB : *F) {
+    for (Instruction &I : BB) {
+      if (IsDivergentSource(&I))
+        MarkDivergent(&I);
+    }
+  }
+
+  while (!WorkList.empty()) {
+    Value *V = WorkList.back();
+    WorkList.pop_back();
+    if (TerminatorInst *TI = dyn_cast<TerminatorInst>(V)) {
+      MarkJoins(TI);
+      MarkLoopExits(TI);
+    }
+    for (User *U : V->users()) {
+      if (Instruction *UI = dyn_cast<Instruction>(U))
+        VisitUser(V, UI);
+    }
+  }
+}
+
+bool UniformityAnalyzer::IsUniform(Value *V) {
+  return !Divergent.count(V);
+}
+
+} // namespace hlsl
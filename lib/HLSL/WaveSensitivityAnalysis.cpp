@@ -31,6 +31,9 @@
 #include "llvm/IR/DiagnosticInfo.h"
 #include "llvm/IR/DiagnosticPrinter.h"
 #include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/IR/CFG.h"
 #include <winerror.h>
 #include "llvm/Support/raw_ostream.h"
 #include <unordered_set>
@@ -47,17 +50,25 @@ private:
     KnownNotSensitive,
     Unknown
   };
-  map<Instruction *, WaveSensitivity> InstState;
-  map<BasicBlock *, WaveSensitivity> BBState;
+  DenseMap<Instruction *, WaveSensitivity> InstState;
+  DenseMap<BasicBlock *, WaveSensitivity> BBState;
   std::vector<Instruction *> InstWorkList;
   std::vector<BasicBlock *> BBWorkList;
+  // When analyzing on demand, the instructions the queries depend on;
+  // everything else is left unvisited.
+  SmallPtrSet<Instruction *, 32> Cone;
+  bool bRestrictToCone = false;
+  // Set when the queries were answered without propagation.
+  bool bNoneSensitive = false;
   bool CheckBBState(BasicBlock *BB, WaveSensitivity WS);
   WaveSensitivity GetInstState(Instruction *I);
   void UpdateBlock(BasicBlock *BB, WaveSensitivity WS);
   void UpdateInst(Instruction *I, WaveSensitivity WS);
   void VisitInst(Instruction *I);
+  bool ComputeCone(ArrayRef<CallInst *> Queries);
 public:
   void Analyze(Function *F);
+  void Analyze(Function *F, ArrayRef<CallInst *> Queries);
   bool IsWaveSensitive(Instruction *op);
 };
 
@@ -94,6 +105,55 @@ void WaveSensitivityAnalyzer::Analyze(Function *F) {
   }
 }
 
+static bool IsWaveOp(Instruction *I) {
+  if (CallInst *CI = dyn_cast<CallInst>(I)) {
+    if (OP::IsDxilOpFuncCallInst(CI))
+      return OP::IsDxilOpWave(OP::GetDxilOpFuncCallInst(CI));
+  }
+  return false;
+}
+
+// Collects the instructions whose state can affect the queries: their
+// operands, transitively, and the terminators of the predecessors of every
+// block involved, as those determine the state of the block. Returns true
+// if the cone contains a wave operation.
+bool WaveSensitivityAnalyzer::ComputeCone(ArrayRef<CallInst *> Queries) {
+  SmallPtrSet<BasicBlock *, 16> ConeBlocks;
+  SmallVector<Instruction *, 32> WorkList(Queries.begin(), Queries.end());
+  bool bHasWaveOp = false;
+  while (!WorkList.empty()) {
+    Instruction *I = WorkList.pop_back_val();
+    if (!Cone.insert(I).second)
+      continue;
+    if (IsWaveOp(I)) {
+      // A wave op is sensitive regardless of its operands.
+      bHasWaveOp = true;
+      continue;
+    }
+    for (Value *V : I->operands()) {
+      if (Instruction *IArg = dyn_cast<Instruction>(V))
+        WorkList.push_back(IArg);
+    }
+    BasicBlock *BB = I->getParent();
+    if (ConeBlocks.insert(BB).second) {
+      for (BasicBlock *Pred : predecessors(BB))
+        WorkList.push_back(Pred->getTerminator());
+    }
+  }
+  return bHasWaveOp;
+}
+
+void WaveSensitivityAnalyzer::Analyze(Function *F, ArrayRef<CallInst *> Queries) {
+  // Nothing the queries depend on is a wave op, so none of them can be
+  // wave sensitive.
+  if (!ComputeCone(Queries)) {
+    bNoneSensitive = true;
+    return;
+  }
+  bRestrictToCone = true;
+  Analyze(F);
+}
+
 bool WaveSensitivityAnalyzer::CheckBBState(BasicBlock *BB, WaveSensitivity WS) {
   auto c = BBState.find(BB);
   if (c == BBState.end()) {
@@ -139,6 +199,9 @@ void WaveSensitivityAnalyzer::UpdateInst(Instruction *I, WaveSensitivity WS) {
 }
 
 void WaveSensitivityAnalyzer::VisitInst(Instruction *I) {
+  if (bRestrictToCone && !Cone.count(I))
+    return;
+
   unsigned firstArg = 0;
   if (CallInst *CI = dyn_cast<CallInst>(I)) {
     if (OP::IsDxilOpFuncCallInst(CI)) {
@@ -177,6 +240,9 @@ void WaveSensitivityAnalyzer::VisitInst(Instruction *I) {
 }
 
 bool WaveSensitivityAnalyzer::IsWaveSensitive(Instruction *op) {
+  if (bNoneSensitive)
+    return false;
+  DXASSERT(!bRestrictToCone || Cone.count(op), "else op was not queried");
   auto c = InstState.find(op);
   DXASSERT(c != InstState.end(), "else analysis didn't complete");
   DXASSERT((*c).second != Unknown, "else analysis is missing a case");
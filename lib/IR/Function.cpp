@@ -29,6 +29,7 @@
 #include "llvm/IR/Module.h"
 #include "dxc/HLSL/HLModule.h" // HLSL Change
 #include "dxc/HLSL/DxilModule.h" // HLSL Change
+#include "dxc/HLSL/DxilOperations.h" // HLSL Change
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/RWMutex.h"
 #include "llvm/Support/StringPool.h"
@@ -260,6 +261,7 @@ Function::Function(FunctionType *Ty, LinkageTypes Linkage, const Twine &name,
   assert(FunctionType::isValidReturnType(getReturnType()) &&
          "invalid return type");
   setGlobalObjectSubClassData(0);
+  recalculateIsDxilOp(); // HLSL Change - the name was set before the bits were cleared.
   SymTab = new ValueSymbolTable();
 
   // If the function has arguments, mark them as lazily built.
@@ -479,6 +481,12 @@ void Function::recalculateIntrinsicID() {
   IntID = lookupIntrinsicID(ValName);
 }
 
+// HLSL Change Begin
+void Function::recalculateIsDxilOp() {
+  setGlobalObjectBit(IsDxilOpBit, hlsl::OP::IsDxilOpFuncName(getName()));
+}
+// HLSL Change End
+
 /// Returns a stable mangling for the type specified for use in the name
 /// mangling scheme used by 'any' types in intrinsic signatures.  The mangling
 /// of named types is simply their name.  Manglings for unnamed types consist
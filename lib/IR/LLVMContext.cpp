@@ -155,6 +155,16 @@ void *LLVMContext::getDiagnosticContext() const {
   return pImpl->DiagnosticContext;
 }
 
+// HLSL Change Begin - context-owned data for HLSL libraries.
+LLVMContext::HLSLContextData *LLVMContext::getHLSLContextData() const {
+  return pImpl->HLSLData.get();
+}
+
+void LLVMContext::setHLSLContextData(HLSLContextData *Data) {
+  pImpl->HLSLData.reset(Data);
+}
+// HLSL Change End
+
 void LLVMContext::setYieldCallback(YieldCallbackTy Callback, void *OpaqueHandle)
 {
   pImpl->YieldCallback = Callback;
@@ -68,6 +68,9 @@ struct DropFirst {
 }
 
 LLVMContextImpl::~LLVMContextImpl() {
+  // HLSL Change - attached data may refer to types and values in the context.
+  HLSLData.reset();
+
   // NOTE: We need to delete the contents of OwnedModules, but Module's dtor
   // will call LLVMContextImpl::removeModule, thus invalidating iterators into
   // the container. Avoid iterators during this operation:
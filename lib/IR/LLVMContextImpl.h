@@ -32,6 +32,7 @@
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Metadata.h"
 #include "llvm/IR/ValueHandle.h"
+#include <memory> // HLSL Change
 #include <vector>
 
 namespace llvm {
@@ -1044,6 +1045,9 @@ public:
   typedef DenseMap<const Function *, ReturnInst *> PrologueDataMapTy;
   PrologueDataMapTy PrologueDataMap;
 
+  /// HLSLData - Data attached through LLVMContext::setHLSLContextData.
+  std::unique_ptr<LLVMContext::HLSLContextData> HLSLData; // HLSL Change
+
   int getOrAddScopeRecordIdxEntry(MDNode *N, int ExistingIdx);
   int getOrAddScopeInlinedAtIdxEntry(MDNode *Scope, MDNode *IA,int ExistingIdx);
 
@@ -156,6 +156,33 @@ void PassManagerPrettyStackEntry::print(raw_ostream &OS) const {
   OS << "'\n";
 }
 
+// HLSL Change Starts
+namespace {
+/// PassRunRegion - Notifies the run listener of the top level manager, if
+/// any, around a pass run. Nested pass managers are not reported, since the
+/// passes they contain are.
+class PassRunRegion {
+  legacy::PassRunListener *L;
+  Pass *P;
+  PassRunRegion(const PassRunRegion &) = delete;
+public:
+  PassRunRegion(PMTopLevelManager *TPM, Pass *P)
+      : L(P->getAsPMDataManager() ? nullptr : TPM->RunListener), P(P) {
+    if (L) L->passStarted(P);
+  }
+  ~PassRunRegion() {
+    if (L) L->passFinished(P);
+  }
+};
+} // End of anon namespace
+
+legacy::PassRunListener *Pass::getRunListener() const {
+  if (!Resolver)
+    return nullptr;
+  return Resolver->getPMDataManager().getTopLevelManager()->RunListener;
+}
+// HLSL Change Ends
+
 
 namespace {
 //===----------------------------------------------------------------------===//
@@ -1318,6 +1345,7 @@ bool BBPassManager::runOnFunction(Function &F) {
         // If the pass crashes, remember this.
         PassManagerPrettyStackEntry X(BP, *I);
         TimeRegion PassTimer(getPassTimer(BP));
+        PassRunRegion PassRun(TPM, BP); // HLSL Change
 
         LocalChanged |= BP->runOnBasicBlock(*I);
       }
@@ -1419,6 +1447,7 @@ void FunctionPassManager::add(Pass *P) {
 bool FunctionPassManager::run(Function &F) {
   if (std::error_code EC = F.materialize())
     report_fatal_error("Error reading bitcode file: " + EC.message());
+  FPM->RunListener = RunListener; // HLSL Change
   return FPM->run(F);
 }
 
@@ -1527,6 +1556,9 @@ void FPPassManager::dumpPassStructure(unsigned Offset) {
 bool FPPassManager::runOnFunction(Function &F) {
   if (F.isDeclaration())
     return false;
+  // HLSL Change - skip bodies of a lazily loaded module that were never read.
+  if (F.isMaterializable())
+    return false;
 
   bool Changed = false;
 
@@ -1545,6 +1577,7 @@ bool FPPassManager::runOnFunction(Function &F) {
     {
       PassManagerPrettyStackEntry X(FP, F);
       TimeRegion PassTimer(getPassTimer(FP));
+      PassRunRegion PassRun(TPM, FP); // HLSL Change
 
       LocalChanged |= FP->runOnFunction(F);
     }
@@ -1621,6 +1654,7 @@ MPPassManager::runOnModule(Module &M) {
     {
       PassManagerPrettyStackEntry X(MP, M);
       TimeRegion PassTimer(getPassTimer(MP));
+      PassRunRegion PassRun(TPM, MP); // HLSL Change
 
       LocalChanged |= MP->runOnModule(M);
     }
@@ -1763,6 +1797,7 @@ void PassManager::add(Pass *P) {
 /// run - Execute all of the passes scheduled for execution.  Keep track of
 /// whether any of the passes modifies the module, and if so, return true.
 bool PassManager::run(Module &M) {
+  PM->RunListener = RunListener; // HLSL Change
   return PM->run(M);
 }
 
@@ -249,11 +249,23 @@ void Value::setNameImpl(const Twine &NewName) {
 
 void Value::setName(const Twine &NewName) {
   setNameImpl(NewName);
-  if (Function *F = dyn_cast<Function>(this))
+  if (Function *F = dyn_cast<Function>(this)) {
     F->recalculateIntrinsicID();
+    F->recalculateIsDxilOp(); // HLSL Change
+  }
 }
 
 void Value::takeName(Value *V) {
+  // HLSL Change Begin - both values may have a different name on return.
+  struct RecalculateIsDxilOp {
+    Value *Vals[2];
+    ~RecalculateIsDxilOp() {
+      for (Value *Val : Vals)
+        if (Function *F = dyn_cast<Function>(Val))
+          F->recalculateIsDxilOp();
+    }
+  } RecalculateOnReturn = {{this, V}};
+  // HLSL Change End
   ValueSymbolTable *ST = nullptr;
   // If this value has a name, drop it.
   if (hasName()) {
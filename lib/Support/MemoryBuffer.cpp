@@ -333,6 +333,30 @@ getOpenFileImpl(int FD, const Twine &Filename, uint64_t FileSize,
                 bool IsVolatileSize) {
   static int PageSize = sys::Process::getPageSize();
 
+  // HLSL Change Starts - use contents the file system holds in memory, in
+  // place if they are null-terminated where needed, rather than reading them.
+  {
+    const char *Data;
+    size_t DataSize;
+    bool NullTerminated;
+    if (Offset >= 0 &&
+        llvm::sys::fs::msf_get_contents(FD, &Data, &DataSize, &NullTerminated) &&
+        (uint64_t)Offset <= DataSize) {
+      uint64_t Size = MapSize == uint64_t(-1) ? DataSize - Offset : MapSize;
+      if (Size <= DataSize - Offset) {
+        SmallString<256> NameBuf;
+        StringRef Contents(Data + Offset, Size);
+        StringRef Name = Filename.toStringRef(NameBuf);
+        if (!RequiresNullTerminator ||
+            (NullTerminated && Offset + Size == DataSize))
+          return MemoryBuffer::getMemBuffer(Contents, Name,
+                                            RequiresNullTerminator);
+        return MemoryBuffer::getMemBufferCopy(Contents, Name);
+      }
+    }
+  }
+  // HLSL Change Ends
+
   // Default is to map the full file.
   if (MapSize == uint64_t(-1)) {
     // If we don't know the file size, use fstat to find out.  fstat on an open
@@ -139,6 +139,15 @@ long msf_lseek(int fd, long offset, int origin)
   return fsr->lseek(fd, offset, origin);
 }
 
+bool msf_get_contents(int fd, const char **ppData, size_t *pSize, bool *pNullTerminated)
+{
+  MSFileSystemRef fsr = GetCurrentThreadFileSystem();
+  if (fsr == nullptr) {
+    return false;
+  }
+  return fsr->GetFileContents(fd, ppData, pSize, pNullTerminated);
+}
+
 int msf_setmode(int fd, int mode)
 {
   MSFileSystemRef fsr = GetCurrentThreadFileSystem();
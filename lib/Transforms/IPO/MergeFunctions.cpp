@@ -102,6 +102,8 @@
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/raw_ostream.h"
+#include "dxc/HLSL/DxilModule.h" // HLSL Change
+#include "dxc/HLSL/DxilFunctionProps.h" // HLSL Change
 #include <vector>
 using namespace llvm;
 
@@ -1145,6 +1147,16 @@ private:
 
   /// Whether or not the target supports global aliases.
   bool HasGlobalAliases;
+
+  // HLSL Change Begin
+  /// The DXIL module, whose metadata refers to functions by identity.
+  hlsl::DxilModule *DM = nullptr;
+  /// Entry points and patch constant functions, which keep their bodies.
+  SmallPtrSet<Function *, 8> DxilEntries;
+
+  /// Replace the body of G with a call to F, keeping G itself.
+  void writeDxilThunk(Function *F, Function *G);
+  // HLSL Change End
 };
 
 }  // end anonymous namespace
@@ -1231,8 +1243,29 @@ bool MergeFunctions::doSanityCheck(std::vector<WeakVH> &Worklist) {
 bool MergeFunctions::runOnModule(Module &M) {
   bool Changed = false;
 
+  // HLSL Change Begin - the signatures and properties of entry points
+  // describe their bodies, so they're never merged.
+  DM = M.HasDxilModule() ? &M.GetDxilModule() : nullptr;
+  DxilEntries.clear();
+  if (DM) {
+    if (Function *EntryF = DM->GetEntryFunction())
+      DxilEntries.insert(EntryF);
+    if (Function *PatchConstantF = DM->GetPatchConstantFunction())
+      DxilEntries.insert(PatchConstantF);
+    for (Function &F : M) {
+      if (!DM->HasDxilFunctionProps(&F))
+        continue;
+      DxilEntries.insert(&F);
+      hlsl::DxilFunctionProps &Props = DM->GetDxilFunctionProps(&F);
+      if (Props.IsHS() && Props.ShaderProps.HS.patchConstantFunc)
+        DxilEntries.insert(Props.ShaderProps.HS.patchConstantFunc);
+    }
+  }
+  // HLSL Change End
+
   for (Module::iterator I = M.begin(), E = M.end(); I != E; ++I) {
-    if (!I->isDeclaration() && !I->hasAvailableExternallyLinkage())
+    if (!I->isDeclaration() && !I->hasAvailableExternallyLinkage() &&
+        !DxilEntries.count(I)) // HLSL Change
       Deferred.push_back(WeakVH(I));
   }
 
@@ -1344,10 +1377,18 @@ void MergeFunctions::writeThunk(Function *F, Function *G) {
   // If G was internal then we may have replaced all uses of G with F. If so,
   // stop here and delete G. There's no need for a thunk.
   if (G->hasLocalLinkage() && G->use_empty()) {
+    if (DM) DM->RemoveFunction(G); // HLSL Change
     G->eraseFromParent();
     return;
   }
 
+  // HLSL Change Begin
+  if (DM) {
+    writeDxilThunk(F, G);
+    return;
+  }
+  // HLSL Change End
+
   Function *NewG = Function::Create(G->getFunctionType(), G->getLinkage(), "",
                                     G->getParent());
   BasicBlock *BB = BasicBlock::Create(F->getContext(), "", NewG);
@@ -1381,6 +1422,34 @@ void MergeFunctions::writeThunk(Function *F, Function *G) {
   ++NumThunksWritten;
 }
 
+// HLSL Change Begin
+// DXIL has no aliases and only calls functions directly, and its metadata
+// keeps the properties and annotations of exported functions by identity, so
+// G stays and only its body becomes a call to F. G and F have the same type.
+void MergeFunctions::writeDxilThunk(Function *F, Function *G) {
+  GlobalValue::LinkageTypes Linkage = G->getLinkage();
+  removeUsers(G);
+  G->deleteBody();
+  G->setLinkage(Linkage);
+
+  BasicBlock *BB = BasicBlock::Create(F->getContext(), "", G);
+  IRBuilder<false> Builder(BB);
+  SmallVector<Value *, 16> Args;
+  for (Function::arg_iterator AI = G->arg_begin(), AE = G->arg_end();
+       AI != AE; ++AI)
+    Args.push_back(AI);
+  CallInst *CI = Builder.CreateCall(F, Args);
+  CI->setCallingConv(F->getCallingConv());
+  if (G->getReturnType()->isVoidTy())
+    Builder.CreateRetVoid();
+  else
+    Builder.CreateRet(CI);
+
+  DEBUG(dbgs() << "writeDxilThunk: " << G->getName() << '\n');
+  ++NumThunksWritten;
+}
+// HLSL Change End
+
 // Replace G with an alias to F and delete G.
 void MergeFunctions::writeAlias(Function *F, Function *G) {
   PointerType *PTy = G->getType();
@@ -1457,6 +1526,13 @@ bool MergeFunctions::insert(Function *NewFunction) {
 
   const FunctionNode &OldF = *Result.first;
 
+  // HLSL Change Begin - functions that differ in type would have to be called
+  // through a bitcast, which DXIL doesn't allow.
+  if (DM && OldF.getFunc()->getFunctionType() !=
+                NewFunction->getFunctionType())
+    return false;
+  // HLSL Change End
+
   // Don't merge tiny functions, since it can just end up making the function
   // larger.
   // FIXME: Should still merge them if they are unnamed_addr and produce an
@@ -28,7 +28,6 @@
 #include "llvm/Transforms/Vectorize.h"
 #include "dxc/HLSL/DxilGenerationPass.h" // HLSL Change
 #include "dxc/HLSL/HLMatrixLowerPass.h" // HLSL Change
-#include "dxc/HLSL/ComputeViewIdState.h" // HLSL Change
 
 using namespace llvm;
 
@@ -203,7 +202,10 @@ void PassManagerBuilder::populateFunctionPassManager(
 }
 
 // HLSL Change Starts
-static void addHLSLPasses(bool HLSLHighLevel, bool NoOpt, hlsl::HLSLExtensionsCodegenHelper *ExtHelper, legacy::PassManagerBase &MPM) {
+// With FastIteration (which implies NoOpt), only the passes needed to produce
+// valid DXIL are added; almost all of the NoOpt list is lowering, so this
+// drops just the final cleanup.
+static void addHLSLPasses(bool HLSLHighLevel, bool NoOpt, bool FastIteration, hlsl::HLSLExtensionsCodegenHelper *ExtHelper, const char *ProfileFile, legacy::PassManagerBase &MPM) {
   // Don't do any lowering if we're targeting high-level.
   if (HLSLHighLevel) {
     MPM.add(createHLEmitMetadataPass());
@@ -222,7 +224,8 @@ static void addHLSLPasses(bool HLSLHighLevel, bool NoOpt, hlsl::HLSLExtensionsCo
                                              /*Promote*/ !NoOpt));
 
   MPM.add(createHLMatrixLowerPass());
-  MPM.add(createResourceToHandlePass());
+  if (NoOpt)
+    MPM.add(createResourceToHandlePass());
   // DCE should after SROA to remove unused element.
   MPM.add(createDeadCodeEliminationPass());
   MPM.add(createGlobalDCEPass());
@@ -231,11 +234,14 @@ static void addHLSLPasses(bool HLSLHighLevel, bool NoOpt, hlsl::HLSLExtensionsCo
     // If not run mem2reg, try to promote allocas used by EvalOperations.
     // Do this before change vector to array.
     MPM.add(createDxilLegalizeEvalOperationsPass());
+    // Change dynamic indexing vector to array.
+    MPM.add(createDynamicIndexingVectorToArrayPass(NoOpt));
+  } else {
+    // Lower resources into handles and change dynamic indexing vector to
+    // array in one sweep of the module.
+    MPM.add(createLowerResourceAndVectorTypesPass());
   }
 
-  // Change dynamic indexing vector to array.
-  MPM.add(createDynamicIndexingVectorToArrayPass(NoOpt));
-
   if (!NoOpt) {
     MPM.add(createLowerStaticGlobalIntoAlloca());
     // mem2reg
@@ -245,6 +251,11 @@ static void addHLSLPasses(bool HLSLHighLevel, bool NoOpt, hlsl::HLSLExtensionsCo
   MPM.add(createSimplifyInstPass());
   MPM.add(createCFGSimplificationPass());
 
+  // Turn profiled execution counts into branch weights now that the entry
+  // point is inlined and in SSA form, so everything after sees them.
+  if (!NoOpt && ProfileFile)
+    MPM.add(createSampleProfileLoaderPass(ProfileFile));
+
   MPM.add(createDxilLegalizeResourceUsePass());
   MPM.add(createDxilLegalizeStaticResourceUsePass());
   MPM.add(createDxilGenerationPass(NoOpt, ExtHelper));
@@ -258,9 +269,11 @@ static void addHLSLPasses(bool HLSLHighLevel, bool NoOpt, hlsl::HLSLExtensionsCo
   // scalarize vector to scalar
   MPM.add(createScalarizerPass());
 
+  // Folds the gathers left by the scalarizer so DCE can remove them.
   MPM.add(createSimplifyInstPass());
 
-  MPM.add(createCFGSimplificationPass());
+  if (!FastIteration)
+    MPM.add(createCFGSimplificationPass());
 
   MPM.add(createDeadCodeEliminationPass());
 }
@@ -285,23 +298,36 @@ void PassManagerBuilder::populateModulePassManager(
     // that pass manager. To prevent this we insert a no-op module pass to reset
     // the pass manager to get the same behavior as EP_OptimizerLast in non-O0
     // builds. The function merging pass is 
-    if (MergeFunctions)
-      MPM.add(createMergeFunctionsPass());
-    else if (!Extensions.empty()) // HLSL Change - GlobalExtensions not considered
+    // HLSL Change - functions are merged once DXIL is generated, below.
+    if (!Extensions.empty()) // HLSL Change - GlobalExtensions not considered
       MPM.add(createBarrierNoopPass());
 
     addExtensionsToPM(EP_EnabledOnOptLevel0, MPM);
     // HLSL Change Begins.
-    addHLSLPasses(HLSLHighLevel, true/*NoOpt*/, HLSLExtensionsCodeGen, MPM);
+    addHLSLPasses(HLSLHighLevel, true/*NoOpt*/, HLSLFastIteration, HLSLExtensionsCodeGen, nullptr, MPM);
     if (!HLSLHighLevel) {
       MPM.add(createMultiDimArrayToOneDimArrayPass());
       MPM.add(createDxilCondenseResourcesPass());
       MPM.add(createDxilLegalizeSampleOffsetPass());
-      MPM.add(createDxilFinalizeModulePass());
-      MPM.add(createComputeViewIdStatePass());
-      MPM.add(createDxilDeadFunctionEliminationPass());
-      MPM.add(createNoPausePassesPass());
-      MPM.add(createDxilEmitMetadataPass());
+      if (MergeFunctions)
+        MPM.add(createMergeFunctionsPass());
+      if (HLSLOptimizeGroupSharedLayout)
+        MPM.add(createDxilGroupSharedLayoutPass());
+      if (HLSLRemoveRedundantBarriers)
+        MPM.add(createDxilRemoveRedundantBarriersPass());
+      if (HLSLHoistHandles)
+        MPM.add(createDxilHoistHandlesPass());
+      if (HLSLHoistInvariantReads)
+        MPM.add(createDxilHoistInvariantReadsPass());
+      if (HLSLSinkResourceReads)
+        MPM.add(createDxilSinkResourceReadsPass());
+      if (HLSLDemotePrecision)
+        MPM.add(createDxilDemotePrecisionPass());
+      if (HLSLAggregateAtomics)
+        MPM.add(createDxilAggregateAtomicsPass());
+      if (HLSLAnnotateUniform)
+        MPM.add(createDxilAnnotateUniformPass());
+      MPM.add(createDxilFinalizeAndEmitPass());
     }
     // HLSL Change Ends.
     return;
@@ -317,7 +343,7 @@ void PassManagerBuilder::populateModulePassManager(
     delete Inliner;
     Inliner = nullptr;
   }
-  addHLSLPasses(HLSLHighLevel, false/*NoOpt*/, HLSLExtensionsCodeGen, MPM); // HLSL Change
+  addHLSLPasses(HLSLHighLevel, false/*NoOpt*/, false/*FastIteration*/, HLSLExtensionsCodeGen, HLSLProfileFile, MPM); // HLSL Change
   // HLSL Change Ends
 
   // Add LibraryInfo if we have some.
@@ -561,7 +587,8 @@ void PassManagerBuilder::populateModulePassManager(
     }
   }
 
-  if (MergeFunctions)
+  // HLSL Change - only DXIL functions are merged; see MergeFunctions.cpp.
+  if (MergeFunctions && !HLSLHighLevel)
     MPM.add(createMergeFunctionsPass());
 
   // HLSL Change Begins.
@@ -570,11 +597,23 @@ void PassManagerBuilder::populateModulePassManager(
     MPM.add(createDxilCondenseResourcesPass());
     if (DisableUnrollLoops)
       MPM.add(createDxilLegalizeSampleOffsetPass());
-    MPM.add(createDxilFinalizeModulePass());
-    MPM.add(createComputeViewIdStatePass());
-    MPM.add(createDxilDeadFunctionEliminationPass());
-    MPM.add(createNoPausePassesPass());
-    MPM.add(createDxilEmitMetadataPass());
+    if (HLSLOptimizeGroupSharedLayout)
+      MPM.add(createDxilGroupSharedLayoutPass());
+    if (HLSLRemoveRedundantBarriers)
+      MPM.add(createDxilRemoveRedundantBarriersPass());
+    if (HLSLHoistHandles)
+      MPM.add(createDxilHoistHandlesPass());
+    if (HLSLHoistInvariantReads)
+      MPM.add(createDxilHoistInvariantReadsPass());
+    if (HLSLSinkResourceReads)
+      MPM.add(createDxilSinkResourceReadsPass());
+    if (HLSLDemotePrecision)
+      MPM.add(createDxilDemotePrecisionPass());
+    if (HLSLAggregateAtomics)
+      MPM.add(createDxilAggregateAtomicsPass());
+    if (HLSLAnnotateUniform)
+      MPM.add(createDxilAnnotateUniformPass());
+    MPM.add(createDxilFinalizeAndEmitPass());
   }
   // HLSL Change Ends.
   addExtensionsToPM(EP_OptimizerLast, MPM);
@@ -184,6 +184,7 @@ namespace {
       UP.OptSizeThreshold = OptSizeUnrollThreshold;
       UP.PartialThreshold = CurrentThreshold;
       UP.PartialOptSizeThreshold = OptSizeUnrollThreshold;
+      UP.PragmaThreshold = PragmaUnrollThreshold; // HLSL Change
       UP.Count = CurrentCount;
       UP.MaxCount = UINT_MAX;
       UP.Partial = CurrentAllowPartial;
@@ -237,11 +238,13 @@ namespace {
         // aggressive with unrolling limits.  Set thresholds to at
         // least the PragmaTheshold value which is larger than the
         // default limits.
+        // HLSL Change - take the pragma threshold from the target, which may
+        // lower it to fit a size budget.
         if (Threshold != NoThreshold)
-          Threshold = std::max<unsigned>(Threshold, PragmaUnrollThreshold);
+          Threshold = std::max<unsigned>(Threshold, UP.PragmaThreshold);
         if (PartialThreshold != NoThreshold)
           PartialThreshold =
-              std::max<unsigned>(PartialThreshold, PragmaUnrollThreshold);
+              std::max<unsigned>(PartialThreshold, UP.PragmaThreshold);
       }
     }
     bool canUnrollCompletely(Loop *L, unsigned Threshold,
@@ -83,6 +83,13 @@ public:
                                   IRBuilder<> &Builder, bool bFlatVector,
                                   bool hasPrecise, DxilTypeSystem &typeSys,
                                   SmallVector<Value *, 32> &DeadInsts);
+  // Split nested structs of AI straight into AllocaInsts for the leaf fields
+  // and save them into Elts. Return false and leave AI untouched when a user
+  // needs to be split one level at a time.
+  static bool DoFlatScalarReplacement(AllocaInst *AI, std::vector<Value *> &Elts,
+                                      IRBuilder<> &Builder, bool hasPrecise,
+                                      DxilTypeSystem &typeSys,
+                                      SmallVector<Value *, 32> &DeadInsts);
   // Lower memcpy related to V.
   static bool LowerMemcpy(Value *V, DxilFieldAnnotation *annotation,
                           DxilTypeSystem &typeSys, const DataLayout &DL,
@@ -1606,9 +1613,14 @@ bool SROA_HLSL::performScalarRepl(Function &F, DxilTypeSystem &typeSys) {
         IRBuilder<> Builder(AI);
         bool hasPrecise = HLModule::HasPreciseAttributeWithMetadata(AI);
 
-        bool SROAed = SROA_Helper::DoScalarReplacement(
-            AI, Elts, Builder, /*bFlatVector*/ true, hasPrecise, typeSys,
-            DeadInsts);
+        // Nested structs are split to their leaves at once, so their users
+        // are not rewritten again for every level of nesting.
+        bool SROAed =
+            SROA_Helper::DoFlatScalarReplacement(AI, Elts, Builder, hasPrecise,
+                                                 typeSys, DeadInsts) ||
+            SROA_Helper::DoScalarReplacement(AI, Elts, Builder,
+                                             /*bFlatVector*/ true, hasPrecise,
+                                             typeSys, DeadInsts);
 
         if (SROAed) {
           Type *Ty = AI->getAllocatedType();
@@ -3281,6 +3293,281 @@ bool SROA_Helper::DoScalarReplacement(Value *V, std::vector<Value *> &Elts,
   return true;
 }
 
+namespace {
+/// FlatStructLayout - The leaf fields of a nested struct, computed once so
+/// every user of the struct can be rewritten to the leaves in a single walk
+/// instead of splitting, and rewalking, one struct level at a time.
+class FlatStructLayout {
+public:
+  struct Node {
+    Type *Ty;
+    // Nodes of the fields for a nested struct; empty for a leaf.
+    SmallVector<unsigned, 4> Fields;
+    // First leaf covered by the node.
+    unsigned LeafBegin;
+  };
+  struct Leaf {
+    Type *Ty;
+    // Field indices from the root struct to the leaf.
+    SmallVector<unsigned, 4> Path;
+    bool bPrecise;
+  };
+
+  FlatStructLayout(DxilTypeSystem &typeSys) : m_typeSys(typeSys) {}
+  // Return false if ST has no nested struct to flatten.
+  bool Build(StructType *ST, bool hasPrecise);
+  bool CanRewrite(Value *Ptr, unsigned NodeIdx);
+  void Rewrite(Value *Ptr, unsigned NodeIdx, ArrayRef<Value *> LeafPtrs,
+               SmallVector<Value *, 32> &DeadInsts);
+
+  std::vector<Node> Nodes; // Nodes[0] is the root struct.
+  std::vector<Leaf> Leaves;
+
+private:
+  DxilTypeSystem &m_typeSys;
+
+  bool IsNestedStruct(Type *Ty);
+  unsigned AddNode(Type *Ty, SmallVectorImpl<unsigned> &Path, bool bPrecise);
+  unsigned GetGEPNode(GEPOperator *GEP, unsigned NodeIdx,
+                      User::op_iterator &IdxIt);
+  Value *LoadNode(unsigned NodeIdx, ArrayRef<Value *> LeafPtrs,
+                  IRBuilder<> &Builder);
+  void StoreNode(unsigned NodeIdx, Value *Val, ArrayRef<Value *> LeafPtrs,
+                 IRBuilder<> &Builder);
+};
+}
+
+/// IsNestedStruct - Check if Ty is a struct which is split into its fields.
+bool FlatStructLayout::IsNestedStruct(Type *Ty) {
+  StructType *ST = dyn_cast<StructType>(Ty);
+  if (!ST || ST->getNumElements() == 0)
+    return false;
+  if (HLMatrixLower::IsMatrixType(ST) || HLModule::IsHLSLObjectType(ST))
+    return false;
+  // Empty structs are left to the empty struct cleanup.
+  DxilStructAnnotation *SA = m_typeSys.GetStructAnnotation(ST);
+  return !(SA && SA->IsEmptyStruct());
+}
+
+unsigned FlatStructLayout::AddNode(Type *Ty, SmallVectorImpl<unsigned> &Path,
+                                   bool bPrecise) {
+  unsigned NodeIdx = Nodes.size();
+  Nodes.emplace_back();
+  Nodes[NodeIdx].Ty = Ty;
+  Nodes[NodeIdx].LeafBegin = Leaves.size();
+  if (!IsNestedStruct(Ty)) {
+    Leaves.emplace_back();
+    Leaf &L = Leaves.back();
+    L.Ty = Ty;
+    L.Path.append(Path.begin(), Path.end());
+    L.bPrecise = bPrecise;
+    return NodeIdx;
+  }
+
+  StructType *ST = cast<StructType>(Ty);
+  DxilStructAnnotation *SA = m_typeSys.GetStructAnnotation(ST);
+  for (unsigned i = 0, e = ST->getNumElements(); i != e; ++i) {
+    bool bFieldPrecise = bPrecise;
+    if (SA)
+      bFieldPrecise |= SA->GetFieldAnnotation(i).IsPrecise();
+    Path.push_back(i);
+    unsigned FieldIdx = AddNode(ST->getElementType(i), Path, bFieldPrecise);
+    Path.pop_back();
+    Nodes[NodeIdx].Fields.push_back(FieldIdx);
+  }
+  return NodeIdx;
+}
+
+bool FlatStructLayout::Build(StructType *ST, bool hasPrecise) {
+  if (!IsNestedStruct(ST))
+    return false;
+  // One level structs are split as they are.
+  bool bHasNestedField = false;
+  for (Type *EltTy : ST->elements())
+    bHasNestedField |= IsNestedStruct(EltTy);
+  if (!bHasNestedField)
+    return false;
+
+  SmallVector<unsigned, 8> Path;
+  AddNode(ST, Path, hasPrecise);
+  return true;
+}
+
+/// GetGEPNode - Follow the struct indices of GEP from NodeIdx, and return the
+/// node the GEP points into with IdxIt at the first index past that node.
+unsigned FlatStructLayout::GetGEPNode(GEPOperator *GEP, unsigned NodeIdx,
+                                      User::op_iterator &IdxIt) {
+  // Skip the pointer index.
+  IdxIt = GEP->idx_begin() + 1;
+  for (User::op_iterator E = GEP->idx_end();
+       IdxIt != E && !Nodes[NodeIdx].Fields.empty(); ++IdxIt) {
+    unsigned FieldIdx = cast<ConstantInt>(IdxIt->get())->getLimitedValue();
+    NodeIdx = Nodes[NodeIdx].Fields[FieldIdx];
+  }
+  return NodeIdx;
+}
+
+/// CanRewrite - Check that all users of Ptr, which points to the struct of
+/// NodeIdx, are plain GEPs, loads and stores that Rewrite handles.
+bool FlatStructLayout::CanRewrite(Value *Ptr, unsigned NodeIdx) {
+  for (User *U : Ptr->users()) {
+    if (GetElementPtrInst *GEP = dyn_cast<GetElementPtrInst>(U)) {
+      if (GEP->getNumIndices() < 2)
+        return false;
+      ConstantInt *PtrIdx = dyn_cast<ConstantInt>(GEP->idx_begin()->get());
+      if (!PtrIdx || !PtrIdx->isZero())
+        return false;
+      User::op_iterator IdxIt;
+      unsigned GEPNodeIdx = GetGEPNode(cast<GEPOperator>(GEP), NodeIdx, IdxIt);
+      if (!Nodes[GEPNodeIdx].Fields.empty() && !CanRewrite(GEP, GEPNodeIdx))
+        return false;
+    } else if (LoadInst *LI = dyn_cast<LoadInst>(U)) {
+      if (!LI->isSimple() || LI->getType() != Nodes[NodeIdx].Ty)
+        return false;
+    } else if (StoreInst *SI = dyn_cast<StoreInst>(U)) {
+      if (!SI->isSimple() || SI->getValueOperand() == Ptr ||
+          SI->getValueOperand()->getType() != Nodes[NodeIdx].Ty)
+        return false;
+    } else {
+      // Memcpys which survived LowerMemcpy, bitcasts and calls.
+      return false;
+    }
+  }
+  return true;
+}
+
+Value *FlatStructLayout::LoadNode(unsigned NodeIdx, ArrayRef<Value *> LeafPtrs,
+                                  IRBuilder<> &Builder) {
+  const Node &N = Nodes[NodeIdx];
+  if (N.Fields.empty()) {
+    Value *Ptr = LeafPtrs[N.LeafBegin];
+    if (!HLMatrixLower::IsMatrixType(N.Ty))
+      return Builder.CreateLoad(Ptr, "load");
+    // Generate Matrix Load.
+    Module *M = Builder.GetInsertBlock()->getModule();
+    return HLModule::EmitHLOperationCall(
+        Builder, HLOpcodeGroup::HLMatLoadStore,
+        static_cast<unsigned>(HLMatLoadStoreOpcode::RowMatLoad), N.Ty, {Ptr},
+        *M);
+  }
+
+  Value *Insert = UndefValue::get(N.Ty);
+  for (unsigned i = 0, e = N.Fields.size(); i != e; ++i) {
+    Value *Field = LoadNode(N.Fields[i], LeafPtrs, Builder);
+    Insert = Builder.CreateInsertValue(Insert, Field, i, "insert");
+  }
+  return Insert;
+}
+
+void FlatStructLayout::StoreNode(unsigned NodeIdx, Value *Val,
+                                 ArrayRef<Value *> LeafPtrs,
+                                 IRBuilder<> &Builder) {
+  const Node &N = Nodes[NodeIdx];
+  if (N.Fields.empty()) {
+    Value *Ptr = LeafPtrs[N.LeafBegin];
+    if (!HLMatrixLower::IsMatrixType(N.Ty)) {
+      Builder.CreateStore(Val, Ptr);
+      return;
+    }
+    // Generate Matrix Store.
+    Module *M = Builder.GetInsertBlock()->getModule();
+    HLModule::EmitHLOperationCall(
+        Builder, HLOpcodeGroup::HLMatLoadStore,
+        static_cast<unsigned>(HLMatLoadStoreOpcode::RowMatStore), N.Ty,
+        {Ptr, Val}, *M);
+    return;
+  }
+
+  for (unsigned i = 0, e = N.Fields.size(); i != e; ++i) {
+    Value *Extract = Builder.CreateExtractValue(Val, i, Val->getName());
+    StoreNode(N.Fields[i], Extract, LeafPtrs, Builder);
+  }
+}
+
+/// Rewrite - Ptr points to the struct of NodeIdx; rewrite its users to use
+/// the leaf pointers directly.
+void FlatStructLayout::Rewrite(Value *Ptr, unsigned NodeIdx,
+                               ArrayRef<Value *> LeafPtrs,
+                               SmallVector<Value *, 32> &DeadInsts) {
+  for (auto UI = Ptr->user_begin(), E = Ptr->user_end(); UI != E;) {
+    User *U = *(UI++);
+    if (GetElementPtrInst *GEP = dyn_cast<GetElementPtrInst>(U)) {
+      User::op_iterator IdxIt;
+      unsigned GEPNodeIdx = GetGEPNode(cast<GEPOperator>(GEP), NodeIdx, IdxIt);
+      const Node &N = Nodes[GEPNodeIdx];
+      if (!N.Fields.empty()) {
+        // Still points to a nested struct.
+        Rewrite(GEP, GEPNodeIdx, LeafPtrs, DeadInsts);
+        if (GEP->user_empty())
+          DeadInsts.push_back(GEP);
+        continue;
+      }
+
+      Value *NewGEP = LeafPtrs[N.LeafBegin];
+      if (IdxIt != GEP->idx_end()) {
+        // Keep the pointer index and the indices into the leaf.
+        SmallVector<Value *, 8> NewArgs;
+        NewArgs.push_back(*GEP->idx_begin());
+        NewArgs.append(IdxIt, GEP->idx_end());
+        IRBuilder<> Builder(GEP);
+        NewGEP = Builder.CreateInBoundsGEP(NewGEP, NewArgs);
+        NewGEP->takeName(GEP);
+      }
+      assert(NewGEP->getType() == GEP->getType() && "type mismatch");
+      GEP->replaceAllUsesWith(NewGEP);
+      DeadInsts.push_back(GEP);
+    } else if (LoadInst *LI = dyn_cast<LoadInst>(U)) {
+      IRBuilder<> Builder(LI);
+      const Node &N = Nodes[NodeIdx];
+      std::vector<Value *> FieldVals(N.Fields.size());
+      Value *Insert = UndefValue::get(N.Ty);
+      for (unsigned i = 0, e = N.Fields.size(); i != e; ++i) {
+        FieldVals[i] = LoadNode(N.Fields[i], LeafPtrs, Builder);
+        Insert = Builder.CreateInsertValue(Insert, FieldVals[i], i, "insert");
+      }
+      LI->replaceAllUsesWith(Insert);
+      SimplifyStructValUsage(Insert, FieldVals, DeadInsts);
+      DeadInsts.push_back(LI);
+    } else {
+      StoreInst *SI = cast<StoreInst>(U);
+      IRBuilder<> Builder(SI);
+      StoreNode(NodeIdx, SI->getValueOperand(), LeafPtrs, Builder);
+      DeadInsts.push_back(SI);
+    }
+  }
+}
+
+/// DoFlatScalarReplacement - Split the nested structs of AI to their leaf
+/// fields with one rewrite of its users. The leaves are saved into Elts in
+/// layout order; those still aggregate are split further by the caller.
+bool SROA_Helper::DoFlatScalarReplacement(AllocaInst *AI,
+                                          std::vector<Value *> &Elts,
+                                          IRBuilder<> &Builder, bool hasPrecise,
+                                          DxilTypeSystem &typeSys,
+                                          SmallVector<Value *, 32> &DeadInsts) {
+  StructType *ST = dyn_cast<StructType>(AI->getAllocatedType());
+  if (!ST)
+    return false;
+  FlatStructLayout Layout(typeSys);
+  if (!Layout.Build(ST, hasPrecise) || !Layout.CanRewrite(AI, 0))
+    return false;
+
+  DEBUG(dbgs() << "Found inst to flat SROA: " << *AI << '\n');
+  Elts.reserve(Layout.Leaves.size());
+  for (const FlatStructLayout::Leaf &L : Layout.Leaves) {
+    std::string Name = AI->getName();
+    for (unsigned i : L.Path)
+      Name += "." + std::to_string(i);
+    AllocaInst *NA = Builder.CreateAlloca(L.Ty, nullptr, Name);
+    if (L.bPrecise)
+      HLModule::MarkPreciseAttributeWithMetadata(NA);
+    Elts.push_back(NA);
+  }
+
+  Layout.Rewrite(AI, 0, Elts, DeadInsts);
+  return true;
+}
+
 static Constant *GetEltInit(Type *Ty, Constant *Init, unsigned idx,
                             Type *EltTy) {
   if (isa<UndefValue>(Init))
@@ -6324,8 +6611,13 @@ public:
       : ModulePass(ID) {}
 
   bool runOnModule(Module &M) override;
+  // Runs several lowerings in one sweep of the module. Each alloca and
+  // global is lowered by the first lowering that needs to lower it, so the
+  // lowerings must apply to distinct types.
+  static bool lowerTypes(Module &M, ArrayRef<LowerTypePass *> Lowerings);
 private:
-  bool runOnFunction(Function &F, bool HasDbgInfo);
+  static void runOnFunction(Function &F, ArrayRef<LowerTypePass *> Lowerings,
+                            bool HasDbgInfo);
   AllocaInst *lowerAlloca(AllocaInst *A);
   GlobalVariable *lowerInternalGlobal(GlobalVariable *GV);
 protected:
@@ -6369,20 +6661,28 @@ GlobalVariable *LowerTypePass::lowerInternalGlobal(GlobalVariable *GV) {
   return NewGV;
 }
 
-bool LowerTypePass::runOnFunction(Function &F, bool HasDbgInfo) {
-  std::vector<AllocaInst *> workList;
+void LowerTypePass::runOnFunction(Function &F,
+                                  ArrayRef<LowerTypePass *> Lowerings,
+                                  bool HasDbgInfo) {
+  std::vector<std::pair<AllocaInst *, LowerTypePass *>> workList;
   // Scan the entry basic block, adding allocas to the worklist.
   BasicBlock &BB = F.getEntryBlock();
   for (BasicBlock::iterator I = BB.begin(), E = BB.end(); I != E; ++I) {
     if (!isa<AllocaInst>(I))
       continue;
     AllocaInst *A = cast<AllocaInst>(I);
-    if (needToLower(A))
-      workList.emplace_back(A);
+    for (LowerTypePass *Lowering : Lowerings) {
+      if (Lowering->needToLower(A)) {
+        workList.emplace_back(A, Lowering);
+        break;
+      }
+    }
   }
   LLVMContext &Context = F.getContext();
-  for (AllocaInst *A : workList) {
-    AllocaInst *NewA = lowerAlloca(A);
+  for (auto &Item : workList) {
+    AllocaInst *A = Item.first;
+    LowerTypePass *Lowering = Item.second;
+    AllocaInst *NewA = Lowering->lowerAlloca(A);
     if (HasDbgInfo) {
       // Add debug info.
       DbgDeclareInst *DDI = llvm::FindAllocaDbgDeclare(A);
@@ -6396,47 +6696,61 @@ bool LowerTypePass::runOnFunction(Function &F, bool HasDbgInfo) {
       }
     }
     // Replace users.
-    lowerUseWithNewValue(A, NewA);
+    Lowering->lowerUseWithNewValue(A, NewA);
     // Remove alloca.
     A->eraseFromParent();
   }
-  return true;
 }
 
 bool LowerTypePass::runOnModule(Module &M) {
-  initialize(M);
-  // Load up debug information, to cross-reference values and the instructions
-  // used to load them.
+  LowerTypePass *Self = this;
+  return lowerTypes(M, Self);
+}
+
+bool LowerTypePass::lowerTypes(Module &M,
+                               ArrayRef<LowerTypePass *> Lowerings) {
+  for (LowerTypePass *Lowering : Lowerings)
+    Lowering->initialize(M);
   bool HasDbgInfo = getDebugMetadataVersionFromModule(M) != 0;
-  llvm::DebugInfoFinder Finder;
-  if (HasDbgInfo) {
-    Finder.processModule(M);
-  }
 
-  std::vector<AllocaInst*> multiDimAllocas;
   for (Function &F : M.functions()) {
     if (F.isDeclaration())
       continue;
-    runOnFunction(F, HasDbgInfo);
+    runOnFunction(F, Lowerings, HasDbgInfo);
   }
 
   // Work on internal global.
-  std::vector<GlobalVariable *> vecGVs;
+  std::vector<std::pair<GlobalVariable *, LowerTypePass *>> vecGVs;
   for (GlobalVariable &GV : M.globals()) {
     if (dxilutil::IsStaticGlobal(&GV) || dxilutil::IsSharedMemoryGlobal(&GV)) {
-      if (needToLower(&GV) && !GV.user_empty())
-        vecGVs.emplace_back(&GV);
+      if (GV.user_empty())
+        continue;
+      for (LowerTypePass *Lowering : Lowerings) {
+        if (Lowering->needToLower(&GV)) {
+          vecGVs.emplace_back(&GV, Lowering);
+          break;
+        }
+      }
     }
   }
 
-  for (GlobalVariable *GV : vecGVs) {
-    GlobalVariable *NewGV = lowerInternalGlobal(GV);
+  // Load up debug information to update for the new globals; only globals
+  // need it, and most modules have none to lower.
+  llvm::DebugInfoFinder Finder;
+  if (HasDbgInfo && !vecGVs.empty()) {
+    Finder.processModule(M);
+  }
+
+  for (auto &Item : vecGVs) {
+    GlobalVariable *GV = Item.first;
+    LowerTypePass *Lowering = Item.second;
+    GlobalVariable *NewGV = Lowering->lowerInternalGlobal(GV);
     // Add debug info.
     if (HasDbgInfo) {
       HLModule::UpdateGlobalVariableDebugInfo(GV, Finder, NewGV);
     }
     // Replace users.
-    lowerUseWithNewValue(GV, NewGV);
+    Lowering->lowerUseWithNewValue(GV, NewGV);
     // Remove GV.
     GV->removeDeadConstantUsers();
     GV->eraseFromParent();
@@ -7049,3 +7363,36 @@ INITIALIZE_PASS(ResourceToHandle, "resource-handle",
 ModulePass *llvm::createResourceToHandlePass() {
   return new ResourceToHandle();
 }
+
+//===----------------------------------------------------------------------===//
+// Lower resources into handles and dynamic indexing vectors into arrays.
+//===----------------------------------------------------------------------===//
+
+namespace {
+
+// ResourceToHandle and DynamicIndexingVectorToArray in a single sweep of the
+// module; they lower distinct types, so neither sees the other's work.
+class LowerResourceAndVectorTypes : public ModulePass {
+public:
+  explicit LowerResourceAndVectorTypes() : ModulePass(ID) {}
+  static char ID; // Pass identification, replacement for typeid
+  bool runOnModule(Module &M) override {
+    ResourceToHandle ResLowering;
+    DynamicIndexingVectorToArray VecLowering;
+    LowerTypePass *Lowerings[] = {&ResLowering, &VecLowering};
+    return LowerTypePass::lowerTypes(M, Lowerings);
+  }
+};
+
+}
+
+char LowerResourceAndVectorTypes::ID = 0;
+
+INITIALIZE_PASS(LowerResourceAndVectorTypes, "lower-resource-vector-types",
+  "Lower resource into handle and dynamic indexing vector into array", false,
+  false)
+
+// Public interface to the LowerResourceAndVectorTypes pass
+ModulePass *llvm::createLowerResourceAndVectorTypesPass() {
+  return new LowerResourceAndVectorTypes();
+}
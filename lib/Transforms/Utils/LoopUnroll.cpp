@@ -28,6 +28,7 @@
 #include "llvm/IR/DataLayout.h"
 #include "llvm/IR/DiagnosticInfo.h"
 #include "llvm/IR/Dominators.h"
+#include "llvm/IR/LegacyPassManager.h" // HLSL Change
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/raw_ostream.h"
@@ -307,7 +308,14 @@ bool llvm::UnrollLoop(Loop *L, unsigned Count, unsigned TripCount,
   LoopBlocksDFS::RPOIterator BlockBegin = DFS.beginRPO();
   LoopBlocksDFS::RPOIterator BlockEnd = DFS.endRPO();
 
+  // HLSL Change Starts - large unrolls can run for long, so let the run
+  // listener stop the compile between copies of the body.
+  legacy::PassRunListener *RunListener =
+      LPM ? LPM->getTopLevelManager()->RunListener : nullptr;
+  // HLSL Change Ends
+
   for (unsigned It = 1; It != Count; ++It) {
+    if (RunListener) RunListener->checkpoint(); // HLSL Change
     std::vector<BasicBlock*> NewBlocks;
     SmallDenseMap<const Loop *, Loop *, 4> NewLoops;
     NewLoops[L] = L;
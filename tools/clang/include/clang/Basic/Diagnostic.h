@@ -629,6 +629,20 @@ public:
   /// \brief Reset the state of the diagnostic object to its initial 
   /// configuration.
   void Reset();
+
+  // HLSL Change Starts
+  /// \brief Forget the errors reported so far, keeping the diagnostic
+  /// mappings that Reset() discards. Used to report the errors of each
+  /// entry point generated from a single parse on their own.
+  void resetErrors() {
+    ErrorOccurred = false;
+    UncompilableErrorOccurred = false;
+    FatalErrorOccurred = false;
+    UnrecoverableErrorOccurred = false;
+    NumErrors = 0;
+    LastDiagLevel = DiagnosticIDs::Ignored;
+  }
+  // HLSL Change Ends
   
   //===--------------------------------------------------------------------===//
   // DiagnosticsEngine classification and reporting interfaces.
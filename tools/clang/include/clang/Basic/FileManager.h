@@ -276,6 +276,12 @@ public:
   /// required, which is (almost) never.
   StringRef getCanonicalName(const DirectoryEntry *Dir);
 
+  // HLSL Change Starts
+  /// \brief Produces the paths that were looked up as files but did not
+  /// exist, such as header search probes and unresolved includes.
+  void getMissingFilePaths(SmallVectorImpl<StringRef> &Paths) const;
+  // HLSL Change Ends
+
   void PrintStats() const;
 };
 
@@ -157,6 +157,9 @@ public:
   unsigned RootSigMinor;
   bool IsHLSLLibrary;
   bool UseMinPrecision; // use min precision, not native precision.
+  // Parse the bodies of functions other than the entry point only once they
+  // are used; ignored for libraries.
+  bool HLSLLazyFunctionBodies = false;
   // MS Change Ends
 
   bool SPIRV = false;  // SPIRV Change
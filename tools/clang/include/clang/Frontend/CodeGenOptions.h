@@ -21,6 +21,8 @@
 #include <vector>
 #include "dxc/HLSL/HLSLExtensionsCodegenHelper.h" // HLSL change
 
+namespace hlsl { class CompilePhaseListener; } // HLSL change
+
 namespace clang {
 
 /// \brief Bitfields of CodeGenOptions, split out from CodeGenOptions to ensure
@@ -176,10 +178,39 @@ public:
   std::string HLSLProfile;
   /// Whether to target high-level DXIL.
   bool HLSLHighLevel = false;
+  /// Whether to emit referenced definitions after each top-level declaration
+  /// rather than at the end of the translation unit.
+  bool HLSLStreamCodeGen = false;
+  /// Whether to run only the passes needed to produce valid DXIL.
+  bool HLSLFastIteration = false;
+  /// Whether to merge equal resource handles and hoist them.
+  bool HLSLHoistHandles = false;
+  /// Whether to hoist loop-invariant resource reads out of loops.
+  bool HLSLHoistInvariantReads = false;
+  /// Whether to move resource reads next to their uses under register pressure.
+  bool HLSLSinkResourceReads = false;
+  /// Cost a shader may grow to through loop unrolling; 0 if unbounded.
+  unsigned HLSLUnrollBudget = 0;
+  /// Whether to mark wave-uniform branches and loads with dx.uniform.
+  bool HLSLAnnotateUniform = false;
+  /// Whether to compute float math that only feeds half values in half.
+  bool HLSLDemotePrecision = false;
+  /// Whether to remove compute shader barriers that order no accesses.
+  bool HLSLRemoveRedundantBarriers = false;
+  /// Whether to turn wave-uniform atomics into one atomic per wave.
+  bool HLSLAggregateAtomics = false;
+  /// Whether to pad and share groupshared arrays.
+  bool HLSLOptimizeGroupSharedLayout = false;
+  /// Whether to reorder cbuffer members without packoffset to save rows.
+  bool HLSLOptimizeCBufferLayout = false;
   /// Whether use row major as default matrix major.
   bool HLSLDefaultRowMajor = false;
   /// Whether use legacy cbuffer load.
   bool HLSLNotUseLegacyCBufLoad = false;
+  /// Whether to merge structured buffer accesses to adjacent fields.
+  bool HLSLMergeBufferAccess = false;
+  /// Whether to store type annotations in the packed binary form.
+  bool HLSLPackedTypeAnnotations = false;
   /// Set [branch] on every if.
   bool HLSLPreferControlFlow = false;
   /// Set [flatten] on every if.
@@ -200,6 +231,8 @@ public:
   unsigned HLSLSignaturePackingStrategy = 0;
   /// denormalized number mode ("ieee" for default)
   hlsl::DXIL::FPDenormMode HLSLFlushFPDenorm;
+  /// Listener for the phases and passes of the compile, if reporting them.
+  hlsl::CompilePhaseListener *HLSLPhaseListener = nullptr;
   // HLSL Change Ends
   /// Regular expression to select optimizations for which we should enable
   /// optimization remarks. Transformation passes whose name matches this
@@ -0,0 +1,35 @@
+//===--- DependencyDirectivesMinimizer.h - Directive-only sources -*- C++ -*-===//
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DependencyDirectivesMinimizer.h                                           //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+//  This file declares a raw scanner that reduces a source file to the       //
+//  preprocessor directives that decide which files it includes, so that     //
+//  the dependencies of a shader can be found without lexing all of it.      //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+#ifndef LLVM_CLANG_LEX_DEPENDENCYDIRECTIVESMINIMIZER_H
+#define LLVM_CLANG_LEX_DEPENDENCYDIRECTIVESMINIMIZER_H
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+
+namespace clang {
+
+/// Reduces Input to its #include, #define, #undef, conditional and
+/// #pragma once directives, with comments removed and continued lines
+/// joined. Every other line is left empty, so the result has the same line
+/// numbers as Input and preprocesses to the same include set and macros.
+///
+/// Returns false, leaving Output unspecified, if Input has a block comment
+/// that isn't closed; the full source should be preprocessed instead, so
+/// that the error is reported.
+bool minimizeSourceToDependencyDirectives(llvm::StringRef Input,
+                                          llvm::SmallVectorImpl<char> &Output);
+
+} // end namespace clang
+
+#endif // LLVM_CLANG_LEX_DEPENDENCYDIRECTIVESMINIMIZER_H
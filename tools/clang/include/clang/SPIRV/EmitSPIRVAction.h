@@ -9,6 +9,9 @@
 #ifndef LLVM_CLANG_SPIRV_EMITSPIRVACTION_H
 #define LLVM_CLANG_SPIRV_EMITSPIRVACTION_H
 
+#include <string>
+#include <vector>
+
 #include "clang/Frontend/FrontendAction.h"
 
 #include "clang/SPIRV/EmitSPIRVOptions.h"
@@ -27,6 +30,40 @@ private:
   EmitSPIRVOptions options;
 };
 
+/// An entry function to translate, and the profile to translate it for.
+struct SPIRVEntryPoint {
+  std::string name;
+  std::string profile;
+};
+
+/// Translates several entry functions of one translation unit, emitting a
+/// separate SPIR-V module for each. The source is parsed and analyzed once.
+///
+/// Each entry is translated with its own SPIRVContext and ModuleBuilder.
+/// Translation walks and extends the shared ASTContext, so it runs on the
+/// calling thread; the SPIRV-Tools legalization and optimization of the
+/// resulting modules runs in parallel.
+class EmitSPIRVModulesAction : public ASTFrontendAction {
+public:
+  EmitSPIRVModulesAction(const EmitSPIRVOptions &opts,
+                         std::vector<SPIRVEntryPoint> entryPoints)
+      : options(opts), entries(std::move(entryPoints)) {}
+
+  /// Returns the emitted modules, in the order of the entry points. The
+  /// module of an entry point that failed to translate is empty, as are the
+  /// modules of all entry points after it.
+  std::vector<std::vector<uint32_t>> &getModules() { return modules; }
+
+protected:
+  std::unique_ptr<ASTConsumer> CreateASTConsumer(CompilerInstance &CI,
+                                                 StringRef InFile) override;
+
+private:
+  EmitSPIRVOptions options;
+  std::vector<SPIRVEntryPoint> entries;
+  std::vector<std::vector<uint32_t>> modules;
+};
+
 } // end namespace clang
 
 #endif
\ No newline at end of file
@@ -14,7 +14,10 @@
 namespace clang {
 /// Structs for controlling behaviors of SPIR-V codegen.
 struct EmitSPIRVOptions {
+  EmitSPIRVOptions() : groupDecorations(false) {}
+
   llvm::StringRef stageIoOrder;
+  bool groupDecorations;
 };
 } // end namespace clang
 
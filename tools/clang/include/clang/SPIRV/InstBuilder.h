@@ -32,7 +32,10 @@ using WordConsumer = std::function<void(std::vector<uint32_t> &&)>;
 
 /// \brief A low-level SPIR-V instruction builder that generates SPIR-V words
 /// directly. All generated SPIR-V words will be fed into the WordConsumer
-/// passed in the constructor.
+/// passed in the constructor, or written into the construction site vector
+/// passed in the constructor instead. Writing into a construction site
+/// involves no type-erased call and reuses the capacity of both vectors, so
+/// building an instruction does not allocate once they have grown.
 ///
 /// The methods of this builder reflects the layouts of the corresponding
 /// SPIR-V instructions. For example, to construct an "OpMemoryModel Logical
@@ -68,6 +71,9 @@ public:
   };
 
   explicit InstBuilder(WordConsumer);
+  /// Constructs a builder that replaces the contents of the given vector with
+  /// each finished instruction.
+  explicit InstBuilder(std::vector<uint32_t> *constructSite);
 
   // Disable copy constructor/assignment.
   InstBuilder(const InstBuilder &) = delete;
@@ -81,7 +87,7 @@ public:
   const WordConsumer &getConsumer() const;
 
   /// \brief Finalizes the building and feeds the generated SPIR-V words
-  /// to the consumer.
+  /// to the consumer or the construction site.
   Status x();
   /// \brief Finalizes the building and returns the generated SPIR-V words.
   /// Returns an empty vector if errors happened during the construction.
@@ -830,6 +836,7 @@ private:
   void encodeString(std::string value);
 
   WordConsumer TheConsumer;
+  std::vector<uint32_t> *TheSite;      ///< Construction site, if any.
   std::vector<uint32_t> TheInst;       ///< The instruction under construction.
   std::deque<OperandKind> Expectation; ///< Expected additional parameters.
   Status TheStatus;                    ///< Current building status.
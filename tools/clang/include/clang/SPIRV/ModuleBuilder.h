@@ -43,6 +43,10 @@ public:
   /// module under construction.
   std::vector<uint32_t> takeModule();
 
+  /// \brief Sets whether takeModule() collapses decorations shared by many
+  /// targets into decoration groups. Off by default.
+  void setGroupDecorations(bool group) { groupingDecorations = group; }
+
   // === Function and Basic Block ===
 
   /// \brief Begins building a SPIR-V function. Returns the <result-id> for the
@@ -302,6 +306,18 @@ public:
   void decorateDSetBinding(uint32_t targetId, uint32_t setNumber,
                            uint32_t bindingNumber);
 
+  /// \brief The descriptor set and binding number of a resource variable.
+  struct DSetBinding {
+    uint32_t targetId;
+    uint32_t setNumber;
+    uint32_t bindingNumber;
+  };
+
+  /// \brief Decorates each of the given targets with its descriptor set and
+  /// binding number, in order. Each distinct descriptor set decoration is
+  /// looked up once.
+  void decorateDSetBindings(llvm::ArrayRef<DSetBinding> bindings);
+
   /// \brief Decorates the given target <result-id> with the given decoration
   /// (without additional parameters).
   void decorate(uint32_t targetId, spv::Decoration);
@@ -376,6 +392,7 @@ private:
   InstBuilder instBuilder;
   std::vector<uint32_t> constructSite; ///< InstBuilder construction site.
   uint32_t glslExtSetId; ///< The <result-id> of GLSL extended instruction set.
+  bool groupingDecorations; ///< Whether to emit decoration groups.
 };
 
 SPIRVContext *ModuleBuilder::getSPIRVContext() { return &theContext; }
@@ -9,20 +9,38 @@
 #ifndef LLVM_CLANG_SPIRV_SPIRVCONTEXT_H
 #define LLVM_CLANG_SPIRV_SPIRVCONTEXT_H
 
-#include <unordered_map>
+#include <deque>
+#include <unordered_set>
+#include <vector>
 
 #include "clang/Frontend/FrontendAction.h"
 #include "clang/SPIRV/Constant.h"
 #include "clang/SPIRV/Decoration.h"
 #include "clang/SPIRV/Type.h"
+#include "llvm/ADT/Hashing.h"
 
 namespace clang {
 namespace spirv {
 
+namespace detail {
+/// \brief Hashes a set of decorations. Equal types and constants may list
+/// the same decorations in different orders, so the combination must not
+/// depend on the order.
+template <typename DecorationSetT>
+std::size_t hashDecorations(const DecorationSetT &decorations) {
+  std::size_t result = 0;
+  for (const Decoration *d : decorations)
+    result += llvm::hash_value(d);
+  return result;
+}
+} // end namespace detail
+
 struct TypeHash {
   std::size_t operator()(const Type &t) const {
-    // TODO: We could improve this hash function if necessary.
-    return std::hash<uint32_t>{}(static_cast<uint32_t>(t.getOpcode()));
+    return llvm::hash_combine(
+        static_cast<uint32_t>(t.getOpcode()),
+        llvm::hash_combine_range(t.getArgs().begin(), t.getArgs().end()),
+        detail::hashDecorations(t.getDecorations()));
   }
 };
 struct DecorationHash {
@@ -33,11 +51,77 @@ struct DecorationHash {
 };
 struct ConstantHash {
   std::size_t operator()(const Constant &c) const {
-    // TODO: We could improve this hash function if necessary.
-    return std::hash<uint32_t>{}(static_cast<uint32_t>(c.getTypeId()));
+    return llvm::hash_combine(
+        static_cast<uint32_t>(c.getOpcode()), c.getTypeId(),
+        llvm::hash_combine_range(c.getArgs().begin(), c.getArgs().end()),
+        detail::hashDecorations(c.getDecorations()));
   }
 };
 
+/// \brief An open-addressing table that interns objects of type T.
+///
+/// The canonical objects are kept in a deque so their addresses stay stable
+/// as the table grows. Each slot keeps the hash computed when its object was
+/// interned; probing compares hashes before objects, and growing the table
+/// never rehashes an object.
+template <typename T, typename Hasher> class InternTable {
+public:
+  InternTable() : numObjects(0) {}
+
+  /// \brief Returns the canonical object equal to the given one. Copies the
+  /// given object in as the canonical one if there is none yet.
+  const T *intern(const T &obj) {
+    if ((numObjects + 1) * 4 > slots.size() * 3)
+      grow();
+    const std::size_t hash = Hasher()(obj);
+    Slot *slot = findSlot(hash, obj);
+    if (slot->object == nullptr) {
+      objects.push_back(obj);
+      slot->hash = hash;
+      slot->object = &objects.back();
+      ++numObjects;
+    }
+    return slot->object;
+  }
+
+private:
+  struct Slot {
+    std::size_t hash;
+    const T *object; ///< nullptr if the slot is empty
+  };
+
+  /// \brief Returns the slot holding an object equal to the given one, or
+  /// the empty slot to put it in. The table must have an empty slot.
+  Slot *findSlot(std::size_t hash, const T &obj) {
+    const std::size_t mask = slots.size() - 1;
+    for (std::size_t i = hash & mask;; i = (i + 1) & mask) {
+      Slot &slot = slots[i];
+      if (slot.object == nullptr ||
+          (slot.hash == hash && *slot.object == obj))
+        return &slot;
+    }
+  }
+
+  void grow() {
+    std::vector<Slot> oldSlots(slots.empty() ? 64 : slots.size() * 2,
+                               Slot{0, nullptr});
+    oldSlots.swap(slots);
+    const std::size_t mask = slots.size() - 1;
+    for (const Slot &old : oldSlots) {
+      if (old.object == nullptr)
+        continue;
+      std::size_t i = old.hash & mask;
+      while (slots[i].object != nullptr)
+        i = (i + 1) & mask;
+      slots[i] = old;
+    }
+  }
+
+  std::deque<T> objects;
+  std::vector<Slot> slots; ///< Size is zero or a power of two
+  std::size_t numObjects;
+};
+
 /// \brief A class for holding various data needed in SPIR-V codegen.
 /// It should outlive all SPIR-V codegen components that requires/allocates
 /// data.
@@ -80,8 +164,8 @@ public:
   const Decoration *registerDecoration(const Decoration &);
 
 private:
-  using TypeSet = std::unordered_set<Type, TypeHash>;
-  using ConstantSet = std::unordered_set<Constant, ConstantHash>;
+  using TypeSet = InternTable<Type, TypeHash>;
+  using ConstantSet = InternTable<Constant, ConstantHash>;
   using DecorationSet = std::unordered_set<Decoration, DecorationHash>;
 
   uint32_t nextId;
@@ -94,17 +178,10 @@ private:
 
   /// \brief All constants defined in the current context.
   /// These can be boolean, integer, float, or composite constants.
+  ///
+  /// The <result-id>s of types and constants are stored in the canonical
+  /// objects themselves; zero means none has been assigned yet.
   ConstantSet existingConstants;
-
-  /// \brief Maps a given type to the <result-id> that is defined for
-  /// that type. If a Type* does not exist in the map, the type
-  /// is not yet defined and is not associated with a <result-id>.
-  std::unordered_map<const Type *, uint32_t> typeResultIdMap;
-
-  /// \brief Maps a given constant to the <result-id> that is defined for
-  /// that constant. If a Constant* does not exist in the map, the constant
-  /// is not yet defined and is not associated with a <result-id>.
-  std::unordered_map<const Constant *, uint32_t> constantResultIdMap;
 };
 
 SPIRVContext::SPIRVContext() : nextId(1) {}
@@ -18,7 +18,6 @@
 #ifndef LLVM_CLANG_SPIRV_STRUCTURE_H
 #define LLVM_CLANG_SPIRV_STRUCTURE_H
 
-#include <deque>
 #include <memory>
 #include <set>
 #include <string>
@@ -31,7 +30,9 @@
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/MapVector.h"
 #include "llvm/ADT/Optional.h"
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/StringRef.h"
 
 namespace clang {
@@ -76,6 +77,47 @@ private:
   std::vector<uint32_t> words; ///< Underlying SPIR-V words
 };
 
+/// \brief The class representing a sequence of SPIR-V instructions stored as
+/// one contiguous word stream. Instructions are referenced by the offset of
+/// their first word, so a whole sequence is emitted with a single copy.
+class InstructionList {
+public:
+  inline InstructionList();
+
+  // Disable copy constructor/assignment
+  InstructionList(const InstructionList &) = delete;
+  InstructionList &operator=(const InstructionList &) = delete;
+
+  // Move constructor/assignment
+  InstructionList(InstructionList &&) = default;
+  InstructionList &operator=(InstructionList &&) = default;
+
+  /// Returns true if this list contains no instructions.
+  inline bool isEmpty() const;
+  /// Removes all instructions from this list.
+  inline void clear();
+
+  /// Appends the instruction made of the given words to this list and returns
+  /// its offset.
+  uint32_t append(llvm::ArrayRef<uint32_t> inst);
+  /// Inserts all instructions in the given list before the instructions in
+  /// this list, keeping their order. The given list will be empty after this
+  /// call.
+  void prepend(InstructionList &&);
+
+  /// Returns the opcode of the last instruction in this list. Returns
+  /// spv::Op::Max if this list is empty.
+  spv::Op getLastOpcode() const;
+
+  /// Returns the underlying SPIR-V words for all instructions in this list.
+  /// This list will be empty after this call.
+  inline std::vector<uint32_t> take();
+
+private:
+  std::vector<uint32_t> words; ///< Underlying SPIR-V words
+  uint32_t lastOffset;         ///< Offset of the last instruction
+};
+
 // === Basic block definition ===
 
 /// \brief The class representing a SPIR-V basic block.
@@ -105,10 +147,10 @@ public:
   void take(InstBuilder *builder);
 
   /// \brief Appends an instruction to this basic block.
-  inline void appendInstruction(Instruction &&);
+  inline void appendInstruction(llvm::ArrayRef<uint32_t> inst);
 
-  /// \brief Preprends an instruction to this basic block.
-  inline void prependInstruction(Instruction &&);
+  /// \brief Preprends the given instructions to this basic block.
+  inline void prependInstructions(InstructionList &&);
 
   /// \brief Adds the given basic block as a successsor to this basic block.
   inline void addSuccessor(BasicBlock *);
@@ -146,7 +188,7 @@ public:
 private:
   uint32_t labelId; ///< The label id for this basic block. Zero means invalid.
   std::string debugName;
-  std::deque<Instruction> instructions;
+  InstructionList instructions;
 
   llvm::SmallVector<BasicBlock *, 2> successors;
   BasicBlock *mergeTarget;
@@ -204,7 +246,7 @@ private:
   /// Parameter <result-type> and <result-id> pairs.
   std::vector<std::pair<uint32_t, uint32_t>> parameters;
   /// Local variables.
-  std::vector<Instruction> variables;
+  InstructionList variables;
   std::vector<std::unique_ptr<BasicBlock>> blocks;
 };
 
@@ -257,6 +299,14 @@ struct DecorationIdPair {
   const uint32_t targetId;
 };
 
+/// \brief The struct representing a decoration group: decorations applied to
+/// a group <result-id>, and the targets the group is applied to.
+struct DecorationGroup {
+  uint32_t groupId;
+  llvm::SmallVector<const Decoration *, 2> decorations;
+  std::vector<uint32_t> targets;
+};
+
 /// \brief The struct representing a type and its <result-id>.
 struct TypeIdPair {
   inline TypeIdPair(const Type &ty, uint32_t id);
@@ -270,6 +320,10 @@ struct TypeIdPair {
 /// \brief The class representing a SPIR-V module.
 class SPIRVModule {
 public:
+  /// \brief The number of targets from which grouping a decoration takes
+  /// fewer words than decorating each target.
+  static const uint32_t kMinDecorationGroupTargets = 3;
+
   /// \brief Default constructs an empty SPIR-V module.
   inline SPIRVModule();
 
@@ -303,19 +357,25 @@ public:
   inline void addEntryPoint(spv::ExecutionModel, uint32_t targetId,
                             std::string targetName,
                             llvm::ArrayRef<uint32_t> intefaces);
-  inline void addExecutionMode(Instruction &&);
+  inline void addExecutionMode(llvm::ArrayRef<uint32_t> inst);
   // TODO: source code debug information
   inline void addDebugName(uint32_t targetId, llvm::StringRef name,
                            llvm::Optional<uint32_t> memberIndex = llvm::None);
   /// \brief Adds a decoration to the given target.
   inline void addDecoration(const Decoration *decoration, uint32_t targetId);
+  /// \brief Moves the decorations applied to at least
+  /// kMinDecorationGroupTargets ids (not struct members) into decoration
+  /// groups, so each target costs one word instead of a whole OpDecorate.
+  /// Decorations applied to the same set of targets share one group.
+  /// takeNextId is called for the <result-id> of each group.
+  void groupDecorations(llvm::function_ref<uint32_t()> takeNextId);
   /// \brief Adds a type to the module. Also adds the type's decorations to the
   /// set of decorations of the module.
   inline void addType(const Type *type, uint32_t resultId);
   /// \brief Adds a constant to the module. Also adds the constant's decorations
   /// to the set of decorations of the module.
   inline void addConstant(const Constant *constant, uint32_t resultId);
-  inline void addVariable(Instruction &&);
+  inline void addVariable(llvm::ArrayRef<uint32_t> inst);
   inline void addFunction(std::unique_ptr<Function>);
 
   /// \brief Returns the <result-id> of the given extended instruction set.
@@ -346,10 +406,11 @@ private:
   llvm::Optional<spv::AddressingModel> addressingModel;
   llvm::Optional<spv::MemoryModel> memoryModel;
   std::vector<EntryPoint> entryPoints;
-  std::vector<Instruction> executionModes;
+  InstructionList executionModes;
   // TODO: source code debug information
   std::set<DebugName> debugNames;
   llvm::SetVector<std::pair<uint32_t, const Decoration *>> decorations;
+  std::vector<DecorationGroup> decorationGroups;
 
   // Note that types and constants are interdependent; Types like arrays have
   // <result-id>s for constants in their definition, and constants all have
@@ -358,7 +419,7 @@ private:
   llvm::MapVector<const Type *, uint32_t> types;
   llvm::MapVector<const Constant *, uint32_t> constants;
 
-  std::vector<Instruction> variables;
+  InstructionList variables;
   std::vector<std::unique_ptr<Function>> functions;
 };
 
@@ -371,6 +432,24 @@ bool Instruction::isEmpty() const { return words.empty(); }
 
 std::vector<uint32_t> Instruction::take() { return std::move(words); }
 
+// === Instruction list inline implementations ===
+
+InstructionList::InstructionList() : lastOffset(0) {}
+
+bool InstructionList::isEmpty() const { return words.empty(); }
+
+void InstructionList::clear() {
+  words.clear();
+  lastOffset = 0;
+}
+
+std::vector<uint32_t> InstructionList::take() {
+  lastOffset = 0;
+  std::vector<uint32_t> result = std::move(words);
+  words.clear();
+  return result;
+}
+
 // === Basic block inline implementations ===
 
 BasicBlock::BasicBlock(uint32_t id, llvm::StringRef name)
@@ -378,15 +457,15 @@ BasicBlock::BasicBlock(uint32_t id, llvm::StringRef name)
       continueTarget(nullptr) {}
 
 bool BasicBlock::isEmpty() const {
-  return labelId == 0 && instructions.empty();
+  return labelId == 0 && instructions.isEmpty();
 }
 
-void BasicBlock::appendInstruction(Instruction &&inst) {
-  instructions.push_back(std::move(inst));
+void BasicBlock::appendInstruction(llvm::ArrayRef<uint32_t> inst) {
+  instructions.append(inst);
 }
 
-void BasicBlock::prependInstruction(Instruction &&inst) {
-  instructions.push_front(std::move(inst));
+void BasicBlock::prependInstructions(InstructionList &&insts) {
+  instructions.prepend(std::move(insts));
 }
 
 void BasicBlock::addSuccessor(BasicBlock *successor) {
@@ -486,8 +565,8 @@ void SPIRVModule::addEntryPoint(spv::ExecutionModel em, uint32_t targetId,
   entryPoints.emplace_back(em, targetId, std::move(name), interfaces);
 }
 
-void SPIRVModule::addExecutionMode(Instruction &&execMode) {
-  executionModes.push_back(std::move(execMode));
+void SPIRVModule::addExecutionMode(llvm::ArrayRef<uint32_t> execMode) {
+  executionModes.append(execMode);
 }
 
 void SPIRVModule::addDebugName(uint32_t targetId, llvm::StringRef name,
@@ -517,8 +596,8 @@ void SPIRVModule::addConstant(const Constant *constant, uint32_t resultId) {
   }
 };
 
-void SPIRVModule::addVariable(Instruction &&var) {
-  variables.push_back(std::move(var));
+void SPIRVModule::addVariable(llvm::ArrayRef<uint32_t> var) {
+  variables.append(var);
 }
 
 void SPIRVModule::addFunction(std::unique_ptr<Function> f) {
@@ -144,6 +144,12 @@ private:
   /// a) Duplicate decorations should be removed.
   /// b) Order of insertion matters for deterministic SPIR-V emitting
   llvm::SetVector<const Decoration *> decorations;
+
+  /// The <result-id> the owning SPIRVContext assigned to this type, or 0.
+  /// Only set on the unique type kept by the context.
+  mutable uint32_t assignedId;
+
+  friend class SPIRVContext;
 };
 
 } // end namespace spirv
@@ -4058,6 +4058,14 @@ public:
   bool IsOnHLSLBufferView();
   Decl *ActOnHLSLBufferView(Scope *bufferScope, SourceLocation KwLoc,
                         DeclGroupPtrTy &dcl, bool iscbuf);
+
+  /// Canonical declarations of the functions used under
+  /// HLSLLazyFunctionBodies; their stored bodies are parsed at the end of the
+  /// translation unit.
+  llvm::SetVector<FunctionDecl *> HLSLUsedFunctions;
+  /// Parses the stored bodies of the used functions, and of the functions
+  /// that they in turn use, handing each to the consumer.
+  void ParseUsedHLSLFunctionBodies();
   // HLSL Change Ends
 
   //===---------------------------- C++ Features --------------------------===//
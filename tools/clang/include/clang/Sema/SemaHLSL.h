@@ -47,6 +47,14 @@ bool CheckTemplateArgumentListForHLSL(
   clang::TemplateDecl*, 
   clang::SourceLocation, 
   clang::TemplateArgumentListInfo&);
+
+/// Returns the canonical type of a vector or matrix template-id whose
+/// arguments are a scalar type and integer literals, or a null type if the
+/// template-id needs to go through regular template argument checking.
+clang::QualType LookupVectorOrMatrixSpecialization(
+  clang::Sema& self,
+  clang::TemplateDecl*,
+  const clang::TemplateArgumentListInfo&);
   
 clang::QualType CheckUnaryOpForHLSL(
   clang::Sema& self,
@@ -241,6 +249,18 @@ bool CanConvert(
 // Sema itself, this can be invoked on the Sema object directly.
 void RegisterIntrinsicTable(_In_ clang::ExternalSemaSource* self, IDxcIntrinsicTable* table);
 
+// A name that code completion should offer in global scope.
+struct GlobalCompletionName {
+  const char *Name;
+  bool IsObjectType; // A built-in object type; otherwise an intrinsic function.
+};
+
+// Gets the names of the built-in intrinsic functions and object types, sorted
+// ignoring case and without duplicates. They are declared only as they are
+// looked up, so code completion on the AST alone doesn't find them. The list
+// is built on first use and kept for the life of the process.
+llvm::ArrayRef<GlobalCompletionName> GetGlobalCompletionNames();
+
 clang::QualType CheckVectorConditional(
   _In_ clang::Sema* self,
   _In_ clang::ExprResult &Cond,
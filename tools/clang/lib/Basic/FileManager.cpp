@@ -523,6 +523,15 @@ void FileManager::GetUniqueIDMapping(
       UIDToFiles[(*VFE)->getUID()] = *VFE;
 }
 
+// HLSL Change Starts
+void FileManager::getMissingFilePaths(SmallVectorImpl<StringRef> &Paths) const {
+  Paths.clear();
+  for (const auto &FE : SeenFileEntries)
+    if (FE.getValue() == NON_EXISTENT_FILE)
+      Paths.push_back(FE.getKey());
+}
+// HLSL Change Ends
+
 void FileManager::modifyFileEntry(FileEntry *File,
                                   off_t Size, time_t ModificationTime) {
   File->Size = Size;
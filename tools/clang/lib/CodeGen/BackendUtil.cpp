@@ -43,6 +43,7 @@
 #include <memory>
 #include "dxc/HLSL/DxilGenerationPass.h" // HLSL Change
 #include "dxc/HLSL/HLMatrixLowerPass.h"  // HLSL Change
+#include "dxc/Support/CompilePhaseListener.h" // HLSL Change
 
 using namespace clang;
 using namespace llvm;
@@ -75,6 +76,10 @@ private:
     if (TM)
       return TM->getTargetIRAnalysis();
 
+    // HLSL Change - there is no DXIL target machine; price DXIL directly.
+    if (LangOpts.HLSL)
+      return createDxilTargetIRAnalysis(CodeGenOpts.HLSLUnrollBudget);
+
     return TargetIRAnalysis();
   }
 
@@ -82,6 +87,7 @@ private:
     if (!CodeGenPasses) {
       CodeGenPasses = new legacy::PassManager();
       CodeGenPasses->TrackPassOS = &CodeGenPassesConfigOS;
+      CodeGenPasses->RunListener = CodeGenOpts.HLSLPhaseListener; // HLSL Change
       CodeGenPasses->add(
           createTargetTransformInfoWrapperPass(getTargetIRAnalysis()));
     }
@@ -92,6 +98,7 @@ private:
     if (!PerModulePasses) {
       PerModulePasses = new legacy::PassManager();
       PerModulePasses->TrackPassOS = &PerModulePassesConfigOS;
+      PerModulePasses->RunListener = CodeGenOpts.HLSLPhaseListener; // HLSL Change
       PerModulePasses->add(
           createTargetTransformInfoWrapperPass(getTargetIRAnalysis()));
     }
@@ -102,6 +109,7 @@ private:
     if (!PerFunctionPasses) {
       PerFunctionPasses = new legacy::FunctionPassManager(TheModule);
       PerFunctionPasses->TrackPassOS = &PerFunctionPassesConfigOS;
+      PerFunctionPasses->RunListener = CodeGenOpts.HLSLPhaseListener; // HLSL Change
       PerFunctionPasses->add(
           createTargetTransformInfoWrapperPass(getTargetIRAnalysis()));
     }
@@ -320,6 +328,15 @@ void EmitAssemblyHelper::CreatePasses() {
   PMBuilder.SLPVectorize = CodeGenOpts.VectorizeSLP;
   PMBuilder.LoopVectorize = CodeGenOpts.VectorizeLoop;
   PMBuilder.HLSLHighLevel = CodeGenOpts.HLSLHighLevel; // HLSL Change
+  PMBuilder.HLSLFastIteration = CodeGenOpts.HLSLFastIteration; // HLSL Change
+  PMBuilder.HLSLHoistHandles = CodeGenOpts.HLSLHoistHandles; // HLSL Change
+  PMBuilder.HLSLHoistInvariantReads = CodeGenOpts.HLSLHoistInvariantReads; // HLSL Change
+  PMBuilder.HLSLSinkResourceReads = CodeGenOpts.HLSLSinkResourceReads; // HLSL Change
+  PMBuilder.HLSLAnnotateUniform = CodeGenOpts.HLSLAnnotateUniform; // HLSL Change
+  PMBuilder.HLSLDemotePrecision = CodeGenOpts.HLSLDemotePrecision; // HLSL Change
+  PMBuilder.HLSLRemoveRedundantBarriers = CodeGenOpts.HLSLRemoveRedundantBarriers; // HLSL Change
+  PMBuilder.HLSLAggregateAtomics = CodeGenOpts.HLSLAggregateAtomics; // HLSL Change
+  PMBuilder.HLSLOptimizeGroupSharedLayout = CodeGenOpts.HLSLOptimizeGroupSharedLayout; // HLSL Change
   PMBuilder.HLSLExtensionsCodeGen = CodeGenOpts.HLSLExtensionsCodegen.get(); // HLSL Change
 
   PMBuilder.DisableUnitAtATime = !CodeGenOpts.UnitAtATime;
@@ -328,9 +345,17 @@ void EmitAssemblyHelper::CreatePasses() {
   PMBuilder.PrepareForLTO = CodeGenOpts.PrepareForLTO;
   PMBuilder.RerollLoops = CodeGenOpts.RerollLoops;
 
+  if (!CodeGenOpts.HLSLFastIteration) // HLSL Change
   PMBuilder.addExtension(PassManagerBuilder::EP_EarlyAsPossible,
                          addAddDiscriminatorsPass);
 
+  // HLSL Change Begins - HLSL loads the profile once its code is inlined.
+  if (LangOpts.HLSL) {
+    if (!CodeGenOpts.SampleProfileFile.empty())
+      PMBuilder.HLSLProfileFile = CodeGenOpts.SampleProfileFile.c_str();
+  }
+  else
+  // HLSL Change Ends
   if (!CodeGenOpts.SampleProfileFile.empty())
     PMBuilder.addExtension(PassManagerBuilder::EP_EarlyAsPossible,
                            addSampleProfileLoaderPass);
@@ -705,6 +730,8 @@ void EmitAssemblyHelper::EmitAssembly(BackendAction Action,
 
   if (PerFunctionPasses) {
     PrettyStackTraceString CrashInfo("Per-function optimization");
+    hlsl::CompilePhaseScope Phase(CodeGenOpts.HLSLPhaseListener,
+                                  "Per-function optimization"); // HLSL Change
 
     PerFunctionPasses->doInitialization();
     for (Function &F : *TheModule)
@@ -715,11 +742,15 @@ void EmitAssemblyHelper::EmitAssembly(BackendAction Action,
 
   if (PerModulePasses) {
     PrettyStackTraceString CrashInfo("Per-module optimization passes");
+    hlsl::CompilePhaseScope Phase(CodeGenOpts.HLSLPhaseListener,
+                                  "Per-module optimization"); // HLSL Change
     PerModulePasses->run(*TheModule);
   }
 
   if (CodeGenPasses) {
     PrettyStackTraceString CrashInfo("Code generation");
+    hlsl::CompilePhaseScope Phase(CodeGenOpts.HLSLPhaseListener,
+                                  "Code generation"); // HLSL Change
     CodeGenPasses->run(*TheModule);
   }
 }
@@ -919,11 +919,6 @@ CodeGenFunction::EmitAutoVarAlloca(const VarDecl &D) {
     // reference or bitfield members, and a few other cases, and checking
     // for POD-ness protects us from some of these.
     if (D.getInit() && (Ty->isArrayType() || Ty->isRecordType()) &&
-        // HLSL Change Begins.
-        // HLSL will not evaluate constant array init list.
-        // So skip it here.
-        !getLangOpts().HLSL &&
-        // HLSL Change Ends.
         (D.isConstexpr() ||
          ((Ty.isPODType(getContext()) ||
            getContext().getBaseElementType(Ty)->isObjCObjectPointerType()) &&
@@ -933,6 +928,7 @@ CodeGenFunction::EmitAutoVarAlloca(const VarDecl &D) {
       // candidate nor a __block variable and has no mutable members,
       // emit it as a global instead.
       if (CGM.getCodeGenOpts().MergeAllConstants && !NRVO && !isByRef &&
+          !getLangOpts().HLSL && // HLSL Change - keep locals in allocas.
           CGM.isTypeConstant(Ty, true)) {
         EmitStaticVarDecl(D, llvm::GlobalValue::InternalLinkage);
 
@@ -1170,6 +1166,9 @@ void CodeGenFunction::EmitAutoVarInit(const AutoVarEmission &emission) {
   if (getLangOpts().HLSL) {
     // create a temporary global with the initializer then
     // Store from the global to the alloca.
+    // This keeps large constant tables out of per-element stores; when the
+    // init list is not constant, EmitConstantInit fails and the regular
+    // init list path is used above.
     std::string Name = getStaticDeclName(CGM, D);
     llvm::GlobalVariable *GV =
       new llvm::GlobalVariable(CGM.getModule(), constant->getType(), true,
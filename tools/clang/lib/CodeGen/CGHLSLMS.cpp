@@ -25,12 +25,19 @@
 #include "clang/AST/HlslTypes.h"
 #include "clang/Frontend/CodeGenOptions.h"
 #include "clang/Lex/HLSLMacroExpander.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/StringSwitch.h"
+#include "llvm/Analysis/LoopInfo.h"
 #include "llvm/IR/Constants.h"
+#include "llvm/IR/Dominators.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/GetElementPtrTypeIterator.h"
+#include "llvm/IR/InstIterator.h"
 #include "llvm/Transforms/Utils/Cloning.h"
+#include <algorithm>
 #include <memory>
 #include <unordered_map>
 #include <unordered_set>
@@ -42,6 +49,7 @@
 #include "dxc/dxcapi.h"                 // stream support
 #include "dxc/HLSL/HLSLExtensionsCodegenHelper.h"
 #include "dxc/HLSL/DxilGenerationPass.h" // support pause/resume passes
+#include "dxc/Support/CompilePhaseListener.h" // phase reports
 
 using namespace clang;
 using namespace CodeGen;
@@ -166,6 +174,16 @@ private:
                                    clang::QualType SrcType,
                                    clang::QualType DestType,
                                    llvm::Type *Ty);
+  // Copy the parts of src and dest that have the same type whole, and
+  // flatten only the parts that need a conversion. Return false when the
+  // parts don't line up; nothing is emitted unless bEmit is set.
+  bool EmitHLSLPartwiseConversionCopy(CodeGenFunction &CGF, Value *SrcPtr,
+                                      SmallVector<Value *, 4> &SrcIdxList,
+                                      QualType SrcType, llvm::Type *SrcTy,
+                                      Value *DestPtr,
+                                      SmallVector<Value *, 4> &DestIdxList,
+                                      QualType DestType, llvm::Type *DestTy,
+                                      bool bEmit);
 
   void EmitHLSLFlatConversionToAggregate(CodeGenFunction &CGF, Value *SrcVal,
                                          llvm::Value *DestPtr,
@@ -286,6 +304,17 @@ void clang::CompileRootSignature(
     StringRef rootSigStr, DiagnosticsEngine &Diags, SourceLocation SLoc,
     hlsl::DxilRootSignatureVersion rootSigVer,
     hlsl::RootSignatureHandle *pRootSigHandle) {
+  // Most shaders share a few root signatures, so text that has compiled
+  // before is not parsed again. The handle then holds only the serialized
+  // form; validation deserializes it through the same cache.
+  CComPtr<IDxcBlob> pCached;
+  hlsl::RootSignatureCache::FindCompiled(rootSigStr.data(), rootSigStr.size(),
+                                         rootSigVer, &pCached);
+  if (pCached != nullptr) {
+    pRootSigHandle->Assign(nullptr, pCached);
+    return;
+  }
+
   std::string OSStr;
   llvm::raw_string_ostream OS(OSStr);
   hlsl::DxilVersionedRootSignatureDesc *D = nullptr;
@@ -294,7 +323,7 @@ void clang::CompileRootSignature(
                              &D, SLoc, Diags)) {
     CComPtr<IDxcBlob> pSignature;
     CComPtr<IDxcBlobEncoding> pErrors;
-    hlsl::SerializeRootSignature(D, &pSignature, &pErrors, false);
+    hlsl::RootSignatureCache::Serialize(D, &pSignature, &pErrors, false);
     if (pSignature == nullptr) {
       assert(pErrors != nullptr && "else serialize failed with no msg");
       ReportHLSLRootSigError(Diags, SLoc, (char *)pErrors->GetBufferPointer(),
@@ -302,6 +331,8 @@ void clang::CompileRootSignature(
       hlsl::DeleteRootSignature(D);
     } else {
       pRootSigHandle->Assign(D, pSignature);
+      hlsl::RootSignatureCache::AddCompiled(
+          rootSigStr.data(), rootSigStr.size(), rootSigVer, pSignature);
     }
   }
 }
@@ -347,6 +378,8 @@ CGMSHLSLRuntime::CGMSHLSLRuntime(CodeGenModule &CGM)
   opts.bDefaultRowMajor = CGM.getCodeGenOpts().HLSLDefaultRowMajor;
   opts.bDisableOptimizations = CGM.getCodeGenOpts().DisableLLVMOpts;
   opts.bLegacyCBufferLoad = !CGM.getCodeGenOpts().HLSLNotUseLegacyCBufLoad;
+  opts.bMergeBufferAccess = CGM.getCodeGenOpts().HLSLMergeBufferAccess;
+  opts.bPackedTypeAnnotations = CGM.getCodeGenOpts().HLSLPackedTypeAnnotations;
   opts.bAllResourcesBound = CGM.getCodeGenOpts().HLSLAllResourcesBound;
   opts.PackingStrategy = CGM.getCodeGenOpts().HLSLSignaturePackingStrategy;
 
@@ -2667,10 +2700,82 @@ static unsigned AllocateDxilConstantBuffer(HLCBuffer &CB) {
   return offset;
 }
 
-static void AllocateDxilConstantBuffers(HLModule *pHLModule) {
+// Whether V is used, directly or through constant expressions, from a
+// function in LiveFuncs.
+static bool IsUsedByFunctions(Value *V,
+                              const SmallPtrSetImpl<Function *> &LiveFuncs) {
+  for (User *U : V->users()) {
+    if (Instruction *I = dyn_cast<Instruction>(U)) {
+      if (LiveFuncs.count(I->getParent()->getParent()))
+        return true;
+    } else if (isa<Constant>(U) && IsUsedByFunctions(U, LiveFuncs)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Allocates the constants without packoffset in an order of its own, to
+// use as few rows as possible. Constants used by LiveFuncs are placed first
+// so they share the rows at the start of the cbuffer; the unused ones then
+// fill what is left. Within each group, larger constants are placed first,
+// and each constant goes into the first row with room for it under the
+// legacy alignment rules.
+static unsigned AllocateDxilConstantBufferPacked(
+    HLCBuffer &CB, const SmallPtrSetImpl<Function *> &LiveFuncs) {
+  unsigned offset = 0;
+  std::vector<DxilResourceBase *> Hot, Cold;
+  for (const std::unique_ptr<DxilResourceBase> &C : CB.GetConstants()) {
+    if (C->GetLowerBound() != UINT_MAX) {
+      offset = std::max(offset, C->GetLowerBound() + C->GetRangeSize());
+      continue;
+    }
+    if (IsUsedByFunctions(C->GetGlobalSymbol(), LiveFuncs))
+      Hot.emplace_back(C.get());
+    else
+      Cold.emplace_back(C.get());
+  }
+
+  // Rows with room left after a constant, as start offset and end of use.
+  std::vector<std::pair<unsigned, unsigned>> OpenRows;
+  auto Place = [&](DxilResourceBase *C) {
+    unsigned size = C->GetRangeSize();
+    llvm::Type *Ty = C->GetGlobalSymbol()->getType()->getPointerElementType();
+    for (std::pair<unsigned, unsigned> &Row : OpenRows) {
+      unsigned start = AlignCBufferOffset(Row.second, size, Ty);
+      if (start + size <= Row.first + 16) {
+        C->SetLowerBound(start);
+        Row.second = start + size;
+        return;
+      }
+    }
+    unsigned start = AlignCBufferOffset(offset, size, Ty);
+    C->SetLowerBound(start);
+    offset = start + size;
+    if (offset & 0xf)
+      OpenRows.emplace_back(offset & ~0xfu, offset);
+  };
+  auto BySizeDescending = [](DxilResourceBase *A, DxilResourceBase *B) {
+    return A->GetRangeSize() > B->GetRangeSize();
+  };
+  for (std::vector<DxilResourceBase *> *Group : {&Hot, &Cold}) {
+    std::stable_sort(Group->begin(), Group->end(), BySizeDescending);
+    for (DxilResourceBase *C : *Group)
+      Place(C);
+  }
+  return offset;
+}
+
+// With pLiveFuncs, constants without packoffset are reordered to pack the
+// cbuffers; see AllocateDxilConstantBufferPacked.
+static void
+AllocateDxilConstantBuffers(HLModule *pHLModule,
+                            const SmallPtrSetImpl<Function *> *pLiveFuncs) {
   for (unsigned i = 0; i < pHLModule->GetCBuffers().size(); i++) {
     HLCBuffer &CB = *static_cast<HLCBuffer*>(&(pHLModule->GetCBuffer(i)));
-    unsigned size = AllocateDxilConstantBuffer(CB);
+    unsigned size = pLiveFuncs
+                        ? AllocateDxilConstantBufferPacked(CB, *pLiveFuncs)
+                        : AllocateDxilConstantBuffer(CB);
     CB.SetSize(size);
   }
 }
@@ -3867,17 +3972,20 @@ static void SimpleTransformForHLDXIR(Instruction *I,
 }
 
 // Do simple transform to make later lower pass easier.
-static void SimpleTransformForHLDXIR(llvm::Module *pM) {
-  std::vector<Instruction *> deadInsts;
-  for (Function &F : pM->functions()) {
-    for (BasicBlock &BB : F.getBasicBlockList()) {
-      for (BasicBlock::iterator Iter = BB.begin(); Iter != BB.end(); ) {
-        Instruction *I = (Iter++);
-        SimpleTransformForHLDXIR(I, deadInsts);
-      }
+// Instructions made dead are collected in deadInsts, and erased by
+// SimpleTransformForHLDXIR(Module) once every function is transformed.
+static void SimpleTransformForHLDXIR(Function &F,
+                                     std::vector<Instruction *> &deadInsts) {
+  for (BasicBlock &BB : F.getBasicBlockList()) {
+    for (BasicBlock::iterator Iter = BB.begin(); Iter != BB.end(); ) {
+      Instruction *I = (Iter++);
+      SimpleTransformForHLDXIR(I, deadInsts);
     }
   }
+}
 
+static void SimpleTransformForHLDXIR(llvm::Module *pM,
+                                     std::vector<Instruction *> &deadInsts) {
   for (Instruction * I : deadInsts)
     I->dropAllReferences();
   for (Instruction * I : deadInsts)
@@ -4016,7 +4124,87 @@ static void ReplaceConstStaticGlobals(
   }
 }
 
+namespace {
+// Decides which helpers a library inlines. A shader inlines everything into
+// its entry point, but a library that does so copies each helper into every
+// exported function that uses it. Large helpers called from more than one
+// place, none of them in a loop, stay calls instead; the linker inlines them
+// when it links a shader from the library.
+class LibraryInlinePolicy {
+public:
+  // Helpers with fewer instructions than this are always inlined.
+  static const unsigned kMinCallSize = 200;
+
+  bool ShouldInline(Function &F) {
+    const Summary &S = GetSummary(F);
+    if (!S.bCallable || S.Size < kMinCallSize)
+      return true;
+    unsigned NumCalls = 0;
+    for (User *U : F.users()) {
+      CallInst *CI = dyn_cast<CallInst>(U);
+      if (!CI || CI->getCalledFunction() != &F)
+        return true;
+      // A call in a loop is hot.
+      if (GetLoopBlocks(*CI->getParent()->getParent()).count(CI->getParent()))
+        return true;
+      ++NumCalls;
+    }
+    return NumCalls < 2;
+  }
+
+private:
+  struct Summary {
+    unsigned Size;
+    // Whether calls can survive lowering: arguments and the result are
+    // scalars or vectors, passed by value.
+    bool bCallable;
+  };
+
+  static bool IsCallableType(Type *Ty) {
+    if (Ty->isVectorTy())
+      Ty = Ty->getVectorElementType();
+    return Ty->isIntegerTy() || Ty->isFloatingPointTy();
+  }
+
+  const Summary &GetSummary(Function &F) {
+    auto it = m_Summaries.find(&F);
+    if (it != m_Summaries.end())
+      return it->second;
+    Summary S;
+    S.Size = 0;
+    for (BasicBlock &BB : F)
+      S.Size += BB.size();
+    S.bCallable = !F.isDeclaration() && !F.isVarArg() &&
+                  (F.getReturnType()->isVoidTy() ||
+                   IsCallableType(F.getReturnType()));
+    for (Argument &Arg : F.args())
+      S.bCallable &= IsCallableType(Arg.getType());
+    return m_Summaries[&F] = S;
+  }
+
+  const DenseSet<BasicBlock *> &GetLoopBlocks(Function &F) {
+    auto it = m_LoopBlocks.find(&F);
+    if (it != m_LoopBlocks.end())
+      return it->second;
+    DenseSet<BasicBlock *> &Blocks = m_LoopBlocks[&F];
+    DominatorTree DT(F);
+    LoopInfo LI;
+    LI.Analyze(DT);
+    for (BasicBlock &BB : F) {
+      if (LI.getLoopFor(&BB))
+        Blocks.insert(&BB);
+    }
+    return Blocks;
+  }
+
+  DenseMap<Function *, Summary> m_Summaries;
+  DenseMap<Function *, DenseSet<BasicBlock *>> m_LoopBlocks;
+};
+} // namespace
+
 void CGMSHLSLRuntime::FinishCodeGen() {
+  hlsl::CompilePhaseScope Phase(CGM.getCodeGenOpts().HLSLPhaseListener,
+                                "HLSL finish codegen");
   // Library don't have entry.
   if (!m_bIsLib) {
     SetEntryFunction();
@@ -4061,7 +4249,37 @@ void CGMSHLSLRuntime::FinishCodeGen() {
   }
 
   // Allocate constant buffers.
-  AllocateDxilConstantBuffers(m_pHLModule);
+  if (CGM.getCodeGenOpts().HLSLOptimizeCBufferLayout) {
+    // Constants count as used when a function that can still run after dead
+    // code is removed uses them.
+    SmallPtrSet<Function *, 16> LiveFuncs;
+    SmallVector<Function *, 16> Worklist;
+    if (m_bIsLib) {
+      for (Function &F : TheModule) {
+        if (!F.isDeclaration())
+          Worklist.emplace_back(&F);
+      }
+    } else {
+      Worklist.emplace_back(m_pHLModule->GetEntryFunction());
+      for (auto &it : patchConstantFunctionMap)
+        Worklist.emplace_back(it.second);
+    }
+    while (!Worklist.empty()) {
+      Function *F = Worklist.pop_back_val();
+      if (!LiveFuncs.insert(F).second)
+        continue;
+      for (inst_iterator I = inst_begin(F), E = inst_end(F); I != E; ++I) {
+        if (CallInst *CI = dyn_cast<CallInst>(&*I)) {
+          Function *Callee = CI->getCalledFunction();
+          if (Callee && !Callee->isDeclaration())
+            Worklist.emplace_back(Callee);
+        }
+      }
+    }
+    AllocateDxilConstantBuffers(m_pHLModule, &LiveFuncs);
+  } else {
+    AllocateDxilConstantBuffers(m_pHLModule, nullptr);
+  }
   // TODO: create temp variable for constant which has store use.
 
   // Create Global variable and type annotation for each CBuffer.
@@ -4104,7 +4322,11 @@ void CGMSHLSLRuntime::FinishCodeGen() {
   AddOpcodeParamForIntrinsics(*m_pHLModule, m_IntrinsicMap, resMetadataMap);
 
   // Pin entry point and constant buffers, mark everything else internal.
+  // Do simple transform to make later lower pass easier in the same walk.
+  std::vector<Instruction *> deadInsts;
+  LibraryInlinePolicy libInlinePolicy;
   for (Function &f : m_pHLModule->GetModule()->functions()) {
+    SimpleTransformForHLDXIR(f, deadInsts);
     if (!m_bIsLib) {
       if (&f == m_pHLModule->GetEntryFunction() ||
           IsPatchConstantFunction(&f) || f.isDeclaration()) {
@@ -4116,13 +4338,12 @@ void CGMSHLSLRuntime::FinishCodeGen() {
     // Skip no inline functions.
     if (f.hasFnAttribute(llvm::Attribute::NoInline))
       continue;
-    // Always inline for used functions.
-    if (!f.user_empty())
+    // Always inline for used functions; libraries may keep large helpers.
+    if (!f.user_empty() && (!m_bIsLib || f.isDeclaration() ||
+                            libInlinePolicy.ShouldInline(f)))
       f.addFnAttr(llvm::Attribute::AlwaysInline);
   }
-
-  // Do simple transform to make later lower pass easier.
-  SimpleTransformForHLDXIR(m_pHLModule->GetModule());
+  SimpleTransformForHLDXIR(m_pHLModule->GetModule(), deadInsts);
 
   // Handle lang extensions if provided.
   if (CGM.getCodeGenOpts().HLSLExtensionsCodegen) {
@@ -5700,6 +5921,143 @@ void CGMSHLSLRuntime::EmitHLSLAggregateCopy(CodeGenFunction &CGF, llvm::Value *S
     EmitHLSLAggregateCopy(CGF, SrcPtr, DestPtr, idxList, Ty, Ty, SrcPtr->getType());
 }
 
+namespace {
+// A base or field of a struct, in the order FlattenAggregatePtrToGepList
+// visits them.
+struct AggregatePart {
+  QualType Type;
+  llvm::Type *Ty;
+  unsigned FieldNo;
+};
+}
+
+static void GetStructParts(CodeGenFunction &CGF, QualType Type, StructType *ST,
+                           SmallVectorImpl<AggregatePart> &Parts) {
+  RecordDecl *RD = Type->getAsStructureType()->getDecl();
+  const CGRecordLayout &RL = CGF.getTypes().getCGRecordLayout(RD);
+  if (const CXXRecordDecl *CXXRD = dyn_cast<CXXRecordDecl>(RD)) {
+    for (const auto &I : CXXRD->bases()) {
+      const CXXRecordDecl *BaseDecl =
+          cast<CXXRecordDecl>(I.getType()->castAs<RecordType>()->getDecl());
+      // Skip empty struct.
+      if (BaseDecl->field_empty())
+        continue;
+      QualType parentTy = QualType(BaseDecl->getTypeForDecl(), 0);
+      Parts.push_back({parentTy, CGF.ConvertType(parentTy),
+                       RL.getNonVirtualBaseLLVMFieldNo(BaseDecl)});
+    }
+  }
+  for (auto fieldIter = RD->field_begin(), fieldEnd = RD->field_end();
+       fieldIter != fieldEnd; ++fieldIter) {
+    unsigned i = RL.getLLVMFieldNo(*fieldIter);
+    Parts.push_back({fieldIter->getType(), ST->getElementType(i), i});
+  }
+}
+
+// Number of scalars a scalar, vector or matrix flattens to; 0 for anything
+// else.
+static unsigned GetFlattenedLeafCount(llvm::Type *Ty) {
+  if (HLMatrixLower::IsMatrixType(Ty)) {
+    unsigned col, row;
+    HLMatrixLower::GetMatrixInfo(Ty, col, row);
+    return col * row;
+  }
+  if (llvm::VectorType *VT = dyn_cast<llvm::VectorType>(Ty))
+    return VT->getNumElements();
+  if (Ty->isAggregateType())
+    return 0;
+  return 1;
+}
+
+bool CGMSHLSLRuntime::EmitHLSLPartwiseConversionCopy(
+    CodeGenFunction &CGF, Value *SrcPtr, SmallVector<Value *, 4> &SrcIdxList,
+    QualType SrcType, llvm::Type *SrcTy, Value *DestPtr,
+    SmallVector<Value *, 4> &DestIdxList, QualType DestType,
+    llvm::Type *DestTy, bool bEmit) {
+  if (SrcTy == DestTy) {
+    // Same type, copy it whole.
+    if (bEmit) {
+      Value *srcGEP = CGF.Builder.CreateInBoundsGEP(SrcPtr, SrcIdxList);
+      Value *dstGEP = CGF.Builder.CreateInBoundsGEP(DestPtr, DestIdxList);
+      SmallVector<Value *, 4> idxList;
+      EmitHLSLAggregateCopy(CGF, srcGEP, dstGEP, idxList, SrcType, DestType,
+                            srcGEP->getType());
+    }
+    return true;
+  }
+
+  StructType *SrcST = dyn_cast<StructType>(SrcTy);
+  StructType *DestST = dyn_cast<StructType>(DestTy);
+  if (SrcST && DestST && !HLMatrixLower::IsMatrixType(SrcTy) &&
+      !HLMatrixLower::IsMatrixType(DestTy)) {
+    if (HLModule::IsHLSLObjectType(SrcST) ||
+        HLModule::IsHLSLObjectType(DestST))
+      return false;
+    SmallVector<AggregatePart, 8> SrcParts, DestParts;
+    GetStructParts(CGF, SrcType, SrcST, SrcParts);
+    GetStructParts(CGF, DestType, DestST, DestParts);
+    if (SrcParts.size() != DestParts.size())
+      return false;
+    for (unsigned i = 0; i < SrcParts.size(); i++) {
+      SrcIdxList.emplace_back(CGF.Builder.getInt32(SrcParts[i].FieldNo));
+      DestIdxList.emplace_back(CGF.Builder.getInt32(DestParts[i].FieldNo));
+      bool bMatched = EmitHLSLPartwiseConversionCopy(
+          CGF, SrcPtr, SrcIdxList, SrcParts[i].Type, SrcParts[i].Ty, DestPtr,
+          DestIdxList, DestParts[i].Type, DestParts[i].Ty, bEmit);
+      SrcIdxList.pop_back();
+      DestIdxList.pop_back();
+      if (!bMatched)
+        return false;
+    }
+    return true;
+  }
+
+  llvm::ArrayType *SrcAT = dyn_cast<llvm::ArrayType>(SrcTy);
+  llvm::ArrayType *DestAT = dyn_cast<llvm::ArrayType>(DestTy);
+  if (SrcAT && DestAT) {
+    if (SrcAT->getNumElements() != DestAT->getNumElements())
+      return false;
+    QualType SrcEltType = CGF.getContext().getBaseElementType(SrcType);
+    QualType DestEltType = CGF.getContext().getBaseElementType(DestType);
+    // Every element pair lines up the same way, so check only the first.
+    uint64_t Count = bEmit ? SrcAT->getNumElements() : 1;
+    for (uint64_t i = 0; i < Count; i++) {
+      SrcIdxList.emplace_back(CGF.Builder.getInt32(i));
+      DestIdxList.emplace_back(CGF.Builder.getInt32(i));
+      bool bMatched = EmitHLSLPartwiseConversionCopy(
+          CGF, SrcPtr, SrcIdxList, SrcEltType, SrcAT->getElementType(), DestPtr,
+          DestIdxList, DestEltType, DestAT->getElementType(), bEmit);
+      SrcIdxList.pop_back();
+      DestIdxList.pop_back();
+      if (!bMatched)
+        return false;
+    }
+    return true;
+  }
+
+  // Scalars, vectors and matrices with the same number of elements convert
+  // element by element.
+  unsigned SrcLeafCount = GetFlattenedLeafCount(SrcTy);
+  if (SrcLeafCount == 0 || SrcLeafCount != GetFlattenedLeafCount(DestTy))
+    return false;
+  if (bEmit) {
+    SmallVector<Value *, 4> SrcGEPList;
+    SmallVector<QualType, 4> SrcEltTyList;
+    FlattenAggregatePtrToGepList(CGF, SrcPtr, SrcIdxList, SrcType, SrcTy,
+                                 SrcGEPList, SrcEltTyList);
+    SmallVector<Value *, 4> LdEltList;
+    LoadFlattenedGepList(CGF, SrcGEPList, SrcEltTyList, LdEltList);
+
+    SmallVector<Value *, 4> DestGEPList;
+    SmallVector<QualType, 4> DestEltTyList;
+    FlattenAggregatePtrToGepList(CGF, DestPtr, DestIdxList, DestType, DestTy,
+                                 DestGEPList, DestEltTyList);
+    StoreFlattenedGepList(CGF, DestGEPList, DestEltTyList, LdEltList,
+                          SrcEltTyList);
+  }
+  return true;
+}
+
 void CGMSHLSLRuntime::EmitHLSLFlatConversionAggregateCopy(CodeGenFunction &CGF, llvm::Value *SrcPtr,
     clang::QualType SrcTy,
     llvm::Value *DestPtr,
@@ -5719,6 +6077,21 @@ void CGMSHLSLRuntime::EmitHLSLFlatConversionAggregateCopy(CodeGenFunction &CGF,
     return;
   }
 
+  // When src and dest have the same shape, only convert the parts that
+  // differ, and copy the rest whole.
+  {
+    SmallVector<Value *, 4> SrcIdxList(1, CGF.Builder.getInt32(0));
+    SmallVector<Value *, 4> DestIdxList(1, CGF.Builder.getInt32(0));
+    if (EmitHLSLPartwiseConversionCopy(CGF, SrcPtr, SrcIdxList, SrcTy,
+                                       SrcPtrTy, DestPtr, DestIdxList, DestTy,
+                                       DestPtrTy, /*bEmit*/ false)) {
+      EmitHLSLPartwiseConversionCopy(CGF, SrcPtr, SrcIdxList, SrcTy, SrcPtrTy,
+                                     DestPtr, DestIdxList, DestTy, DestPtrTy,
+                                     /*bEmit*/ true);
+      return;
+    }
+  }
+
   // It is possiable to implement EmitHLSLAggregateCopy, EmitHLSLAggregateStore
   // the same way. But split value to scalar will generate many instruction when
   // src type is same as dest type.
@@ -34,6 +34,7 @@
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/SourceMgr.h"
 #include "llvm/Support/Timer.h"
+#include "dxc/Support/CompilePhaseListener.h" // HLSL Change
 #include <memory>
 using namespace clang;
 using namespace llvm;
@@ -115,6 +116,8 @@ namespace clang {
 
       if (llvm::TimePassesIsEnabled)
         LLVMIRGeneration.startTimer();
+      hlsl::CompilePhaseScope Phase(CodeGenOpts.HLSLPhaseListener,
+                                    "IR generation"); // HLSL Change
 
       Gen->HandleTopLevelDecl(D);
 
@@ -142,6 +145,8 @@ namespace clang {
         PrettyStackTraceString CrashInfo("Per-file LLVM IR generation");
         if (llvm::TimePassesIsEnabled)
           LLVMIRGeneration.startTimer();
+        hlsl::CompilePhaseScope Phase(CodeGenOpts.HLSLPhaseListener,
+                                      "IR generation"); // HLSL Change
 
         Gen->HandleTranslationUnit(C);
 
@@ -187,9 +192,13 @@ namespace clang {
       void *OldDiagnosticContext = Ctx.getDiagnosticContext();
       Ctx.setDiagnosticHandler(DiagnosticHandler, this);
 
-      EmitBackendOutput(Diags, CodeGenOpts, TargetOpts, LangOpts,
-                        C.getTargetInfo().getTargetDescription(),
-                        TheModule.get(), Action, AsmOutStream);
+      {
+        hlsl::CompilePhaseScope Phase(CodeGenOpts.HLSLPhaseListener,
+                                      "Backend"); // HLSL Change
+        EmitBackendOutput(Diags, CodeGenOpts, TargetOpts, LangOpts,
+                          C.getTargetInfo().getTargetDescription(),
+                          TheModule.get(), Action, AsmOutStream);
+      }
 
       Ctx.setInlineAsmDiagnosticHandler(OldHandler, OldContext);
 
@@ -1309,6 +1309,13 @@ bool CodeGenModule::MustBeEmitted(const ValueDecl *Global) {
   if (LangOpts.EmitAllDecls)
     return true;
 
+  // HLSL Change Starts - the entry point of this module is always emitted,
+  // also when one parse generates modules for several entry points.
+  if (const auto *FD = dyn_cast<FunctionDecl>(Global))
+    if (FD->getIdentifier() && FD->getName() == CodeGenOpts.HLSLEntryFunction)
+      return true;
+  // HLSL Change Ends
+
   return getContext().DeclMustBeEmitted(Global);
 }
 
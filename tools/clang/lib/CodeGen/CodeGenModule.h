@@ -544,6 +544,9 @@ public:
     return *HLSLRuntime;
   }
   void FinishCodeGen();
+  /// Emit the definitions referenced so far, rather than waiting for the end
+  /// of the translation unit.
+  void EmitReferencedDefinitions() { EmitDeferred(); }
   // HLSL Change Ends
 
   ARCEntrypoints &getARCEntrypoints() const {
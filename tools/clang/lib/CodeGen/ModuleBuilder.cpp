@@ -123,11 +123,21 @@ namespace {
       if (Diags.hasErrorOccurred())
         return true;
 
-      HandlingTopLevelDeclRAII HandlingDecl(*this);
+      // HLSL Change Begin - scoped so deferred inline methods are emitted
+      // before the referenced definitions are.
+      {
+        HandlingTopLevelDeclRAII HandlingDecl(*this);
+
+        // Make sure to emit all elements of a Decl.
+        for (DeclGroupRef::iterator I = DG.begin(), E = DG.end(); I != E; ++I)
+          Builder->EmitTopLevelDecl(*I);
+      }
 
-      // Make sure to emit all elements of a Decl.
-      for (DeclGroupRef::iterator I = DG.begin(), E = DG.end(); I != E; ++I)
-        Builder->EmitTopLevelDecl(*I);
+      // Keep the definitions the module references from piling up until the
+      // end of the translation unit.
+      if (CodeGenOpts.HLSLStreamCodeGen && HandlingTopLevelDecls == 0)
+        Builder->EmitReferencedDefinitions();
+      // HLSL Change End
 
       return true;
     }
@@ -0,0 +1,268 @@
+//===--- DependencyDirectivesMinimizer.cpp - Directive-only sources -------===//
+//                                                                            //
+// DependencyDirectivesMinimizer.cpp                                          //
+// Copyright (C) Microsoft Corporation. All rights reserved.                  //
+// This file is distributed under the University of Illinois Open Source      //
+// License. See LICENSE.TXT for details.                                      //
+//===----------------------------------------------------------------------===//
+//
+// This file implements minimizeSourceToDependencyDirectives. The scanner
+// only needs to know where lines start, so it recognizes comments, literals
+// and line continuations, and nothing else of the language.
+//
+//===----------------------------------------------------------------------===//
+#include "clang/Lex/DependencyDirectivesMinimizer.h"
+
+#include "clang/Basic/CharInfo.h"
+#include "llvm/ADT/StringSwitch.h"
+
+using namespace clang;
+using namespace llvm;
+
+namespace {
+
+class Minimizer {
+public:
+  Minimizer(StringRef Input, SmallVectorImpl<char> &Output)
+      : Cur(Input.begin()), End(Input.end()), Out(Output) {}
+
+  bool minimize();
+
+private:
+  const char *Cur;
+  const char *End;
+  SmallVectorImpl<char> &Out;
+  // Newlines consumed inside a kept directive, written after it.
+  unsigned PendingNewlines = 0;
+  bool Failed = false;
+
+  bool startsWith(const char *S) const {
+    for (const char *P = Cur; *S; ++P, ++S) {
+      if (P == End || *P != *S)
+        return false;
+    }
+    return true;
+  }
+  // Returns the length of the line continuation at Cur, or zero.
+  unsigned continuationLength() const;
+  void newline(bool bInDirective);
+  void skipBlockComment(bool bInDirective);
+  void skipLineComment(bool bInDirective);
+  void skipHorizontalSpace(bool bInDirective);
+  void skipLiteral(bool bCopy);
+  StringRef lexIdentifier();
+  void skipLine();
+  void copyDirectiveBody();
+  void lexDirective();
+};
+
+}
+
+unsigned Minimizer::continuationLength() const {
+  if (Cur == End || *Cur != '\\')
+    return 0;
+  if (startsWith("\\\r\n"))
+    return 3;
+  if (startsWith("\\\n"))
+    return 2;
+  return 0;
+}
+
+// Consumes the newline at Cur. Lines outside directives are left empty;
+// lines joined into a directive are made up after it.
+void Minimizer::newline(bool bInDirective) {
+  Cur += startsWith("\r\n") ? 2 : 1;
+  if (bInDirective)
+    ++PendingNewlines;
+  else
+    Out.push_back('\n');
+}
+
+void Minimizer::skipBlockComment(bool bInDirective) {
+  Cur += 2;
+  while (Cur != End) {
+    if (startsWith("*/")) {
+      Cur += 2;
+      return;
+    }
+    if (*Cur == '\n' || startsWith("\r\n"))
+      newline(bInDirective);
+    else
+      ++Cur;
+  }
+  Failed = true;
+}
+
+// Leaves Cur at the newline that ends the comment.
+void Minimizer::skipLineComment(bool bInDirective) {
+  while (Cur != End && *Cur != '\n' && !startsWith("\r\n")) {
+    if (unsigned Len = continuationLength()) {
+      Cur += Len;
+      if (bInDirective)
+        ++PendingNewlines;
+      else
+        Out.push_back('\n');
+      continue;
+    }
+    ++Cur;
+  }
+}
+
+void Minimizer::skipHorizontalSpace(bool bInDirective) {
+  while (Cur != End) {
+    if (isHorizontalWhitespace(*Cur)) {
+      ++Cur;
+    } else if (unsigned Len = continuationLength()) {
+      Cur += Len;
+      if (bInDirective)
+        ++PendingNewlines;
+      else
+        Out.push_back('\n');
+    } else if (startsWith("/*")) {
+      skipBlockComment(bInDirective);
+    } else {
+      return;
+    }
+  }
+}
+
+// Skips the string or character literal at Cur, which ends at its closing
+// quote or, if it has none, at the end of the line. Literals are only copied
+// in directives.
+void Minimizer::skipLiteral(bool bCopy) {
+  char Quote = *Cur;
+  if (bCopy)
+    Out.push_back(*Cur);
+  ++Cur;
+  while (Cur != End && *Cur != '\n' && *Cur != '\r') {
+    if (unsigned Len = continuationLength()) {
+      Cur += Len;
+      if (bCopy)
+        ++PendingNewlines;
+      else
+        Out.push_back('\n');
+      continue;
+    }
+    char C = *Cur++;
+    if (bCopy)
+      Out.push_back(C);
+    if (C == Quote)
+      return;
+    if (C == '\\' && Cur != End && *Cur != '\n' && *Cur != '\r') {
+      if (bCopy)
+        Out.push_back(*Cur);
+      ++Cur;
+    }
+  }
+}
+
+StringRef Minimizer::lexIdentifier() {
+  const char *Start = Cur;
+  while (Cur != End && isIdentifierBody(*Cur))
+    ++Cur;
+  return StringRef(Start, Cur - Start);
+}
+
+// Skips to the start of the next line that isn't continued from this one.
+void Minimizer::skipLine() {
+  while (Cur != End) {
+    if (*Cur == '\n' || startsWith("\r\n")) {
+      newline(/*bInDirective*/ false);
+      return;
+    }
+    if (unsigned Len = continuationLength()) {
+      Cur += Len;
+      Out.push_back('\n');
+    } else if (*Cur == '"' || *Cur == '\'') {
+      skipLiteral(/*bCopy*/ false);
+    } else if (startsWith("/*")) {
+      skipBlockComment(/*bInDirective*/ false);
+    } else if (startsWith("//")) {
+      skipLineComment(/*bInDirective*/ false);
+    } else {
+      ++Cur;
+    }
+  }
+}
+
+// Copies the rest of a directive's line, with comments replaced by a space.
+void Minimizer::copyDirectiveBody() {
+  while (Cur != End && *Cur != '\n' && !startsWith("\r\n")) {
+    if (unsigned Len = continuationLength()) {
+      Cur += Len;
+      ++PendingNewlines;
+    } else if (*Cur == '"' || *Cur == '\'') {
+      skipLiteral(/*bCopy*/ true);
+    } else if (startsWith("/*")) {
+      skipBlockComment(/*bInDirective*/ true);
+      Out.push_back(' ');
+    } else if (startsWith("//")) {
+      skipLineComment(/*bInDirective*/ true);
+    } else if (*Cur == '\r') {
+      ++Cur;
+    } else {
+      Out.push_back(*Cur++);
+    }
+  }
+  Out.push_back('\n');
+  Out.append(PendingNewlines, '\n');
+  PendingNewlines = 0;
+  if (Cur != End)
+    Cur += (*Cur == '\n') ? 1 : 2;
+}
+
+// Cur is past the '#' that starts a directive.
+void Minimizer::lexDirective() {
+  skipHorizontalSpace(/*bInDirective*/ true);
+  StringRef Name = lexIdentifier();
+  bool bKeep = StringSwitch<bool>(Name)
+                   .Cases("include", "include_next", "import", true)
+                   .Cases("define", "undef", true)
+                   .Cases("if", "ifdef", "ifndef", true)
+                   .Cases("elif", "else", "endif", true)
+                   .Default(false);
+  if (!bKeep && Name == "pragma") {
+    skipHorizontalSpace(/*bInDirective*/ true);
+    if (lexIdentifier() == "once") {
+      StringRef PragmaOnce("#pragma once");
+      Out.append(PragmaOnce.begin(), PragmaOnce.end());
+      Name = StringRef();
+      bKeep = true;
+    }
+  }
+  if (!bKeep) {
+    // Lines joined into the skipped directive are left empty like it.
+    Out.append(PendingNewlines, '\n');
+    PendingNewlines = 0;
+    skipLine();
+    return;
+  }
+  if (!Name.empty()) {
+    Out.push_back('#');
+    Out.append(Name.begin(), Name.end());
+  }
+  copyDirectiveBody();
+}
+
+bool Minimizer::minimize() {
+  while (Cur != End && !Failed) {
+    // A directive may follow whitespace and comments on its line.
+    skipHorizontalSpace(/*bInDirective*/ false);
+    if (Cur == End)
+      break;
+    if (*Cur == '#') {
+      ++Cur;
+      lexDirective();
+    } else {
+      skipLine();
+    }
+  }
+  return !Failed;
+}
+
+bool clang::minimizeSourceToDependencyDirectives(StringRef Input,
+                                                 SmallVectorImpl<char> &Output) {
+  Output.clear();
+  Output.reserve(Input.size() / 8);
+  return Minimizer(Input, Output).minimize();
+}
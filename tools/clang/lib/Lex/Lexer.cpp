@@ -26,6 +26,19 @@
 #include "llvm/Support/ConvertUTF.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include <cstring>
+// HLSL Change Begin - MSVC never defines __SSE2__, but SSE2 is always there
+// on x64 and on x86 built with /arch:SSE2 or above.
+#if defined(__SSE2__) || defined(_M_X64) ||                                   \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HLSL_LEXER_SSE2 1
+#endif
+// HLSL Change End
+#ifdef HLSL_LEXER_SSE2 // HLSL Change
+#include <emmintrin.h>
+#elif __ALTIVEC__
+#include <altivec.h>
+#undef bool
+#endif
 using namespace clang;
 
 //===----------------------------------------------------------------------===//
@@ -1468,9 +1481,63 @@ bool Lexer::tryConsumeIdentifierUTF8Char(const char *&CurPtr) {
   return true;
 }
 
+// HLSL Change Starts - vectorized scanning of the runs that make up most of
+// large sources. Each scanner returns the first byte at or after Ptr that
+// ends the run, looking only at whole 16-byte blocks before End; the caller's
+// byte loop finishes the run from there, and handles whatever needs decoding.
+#ifdef HLSL_LEXER_SSE2
+static inline const char *ScanEndOfRun(const char *Ptr, const char *End,
+                                       __m128i (*Matches)(__m128i)) {
+  while (Ptr + 16 <= End) {
+    __m128i Chars = _mm_loadu_si128((const __m128i *)Ptr);
+    unsigned Mask = _mm_movemask_epi8(Matches(Chars)) ^ 0xFFFF;
+    if (Mask != 0)
+      return Ptr + llvm::countTrailingZeros(Mask);
+    Ptr += 16;
+  }
+  return Ptr;
+}
+
+/// Matches [_A-Za-z0-9]. Bytes outside ASCII are negative, so they fail the
+/// signed range checks.
+static inline __m128i MatchIdentifierBody(__m128i Chars) {
+  __m128i Folded = _mm_or_si128(Chars, _mm_set1_epi8(0x20));
+  __m128i Alpha = _mm_and_si128(_mm_cmpgt_epi8(Folded, _mm_set1_epi8('a' - 1)),
+                                _mm_cmplt_epi8(Folded, _mm_set1_epi8('z' + 1)));
+  __m128i Digit = _mm_and_si128(_mm_cmpgt_epi8(Chars, _mm_set1_epi8('0' - 1)),
+                                _mm_cmplt_epi8(Chars, _mm_set1_epi8('9' + 1)));
+  __m128i Under = _mm_cmpeq_epi8(Chars, _mm_set1_epi8('_'));
+  return _mm_or_si128(_mm_or_si128(Alpha, Digit), Under);
+}
+
+/// Matches ' ', '\t', '\f' and '\v'.
+static inline __m128i MatchHorizontalWhitespace(__m128i Chars) {
+  __m128i Space = _mm_cmpeq_epi8(Chars, _mm_set1_epi8(' '));
+  __m128i Tab = _mm_cmpeq_epi8(Chars, _mm_set1_epi8('\t'));
+  __m128i FormFeed = _mm_cmpeq_epi8(Chars, _mm_set1_epi8('\f'));
+  __m128i VerticalTab = _mm_cmpeq_epi8(Chars, _mm_set1_epi8('\v'));
+  return _mm_or_si128(_mm_or_si128(Space, Tab),
+                      _mm_or_si128(FormFeed, VerticalTab));
+}
+
+/// Matches everything but '\n', '\r' and '\0', which end the fast loop of a
+/// line comment.
+static inline __m128i MatchLineCommentBody(__m128i Chars) {
+  __m128i Newline = _mm_cmpeq_epi8(Chars, _mm_set1_epi8('\n'));
+  __m128i Return = _mm_cmpeq_epi8(Chars, _mm_set1_epi8('\r'));
+  __m128i Nul = _mm_cmpeq_epi8(Chars, _mm_setzero_si128());
+  return _mm_cmpeq_epi8(_mm_or_si128(_mm_or_si128(Newline, Return), Nul),
+                        _mm_setzero_si128());
+}
+#endif
+// HLSL Change Ends
+
 bool Lexer::LexIdentifier(Token &Result, const char *CurPtr) {
   // Match [_A-Za-z0-9]*, we have already matched [_A-Za-z$]
   unsigned Size;
+#ifdef HLSL_LEXER_SSE2
+  CurPtr = ScanEndOfRun(CurPtr, BufferEnd, MatchIdentifierBody); // HLSL Change
+#endif
   unsigned char C = *CurPtr++;
   while (isIdentifierBody(C))
     C = *CurPtr++;
@@ -1976,6 +2043,14 @@ bool Lexer::SkipWhitespace(Token &Result, const char *CurPtr,
   // Skip consecutive spaces efficiently.
   while (1) {
     // Skip horizontal whitespace very aggressively.
+#ifdef HLSL_LEXER_SSE2
+    // HLSL Change Begin - skip whole blocks of indentation at once.
+    if (isHorizontalWhitespace(Char)) {
+      CurPtr = ScanEndOfRun(CurPtr, BufferEnd, MatchHorizontalWhitespace);
+      Char = *CurPtr;
+    }
+    // HLSL Change End
+#endif
     while (isHorizontalWhitespace(Char))
       Char = *++CurPtr;
 
@@ -2050,6 +2125,9 @@ bool Lexer::SkipLineComment(Token &Result, const char *CurPtr,
   // them.  As such, optimize for this case with the inner loop.
   char C;
   do {
+#ifdef HLSL_LEXER_SSE2
+    CurPtr = ScanEndOfRun(CurPtr, BufferEnd, MatchLineCommentBody); // HLSL Change
+#endif
     C = *CurPtr;
     // Skip over characters in the fast loop.
     while (C != 0 &&                // Potentially EOF.
@@ -2255,13 +2333,6 @@ static bool isEndOfBlockCommentWithEscapedNewLine(const char *CurPtr,
   return true;
 }
 
-#ifdef __SSE2__
-#include <emmintrin.h>
-#elif __ALTIVEC__
-#include <altivec.h>
-#undef bool
-#endif
-
 /// We have just read from input the / and * characters that started a comment.
 /// Read until we find the * and / characters that terminate the comment.
 /// Note that we don't bother decoding trigraphs or escaped newlines in block
@@ -1357,7 +1357,9 @@ void Parser::LateTemplateParserCallback(void *P, LateParsedTemplate &LPT) {
 
 /// \brief Late parse a C++ function template in Microsoft mode.
 void Parser::ParseLateTemplatedFuncDef(LateParsedTemplate &LPT) {
-  assert(!getLangOpts().HLSL && "no template parsing is supported in HLSL"); // HLSL Change
+  // HLSL Change - HLSL has no templates, but late parses lazy function bodies.
+  assert((!getLangOpts().HLSL || getLangOpts().HLSLLazyFunctionBodies) &&
+         "no template parsing is supported in HLSL");
   if (!LPT.D)
      return;
 
@@ -1448,7 +1450,9 @@ void Parser::ParseLateTemplatedFuncDef(LateParsedTemplate &LPT) {
 
 /// \brief Lex a delayed template function for late parsing.
 void Parser::LexTemplateFunctionForLateParsing(CachedTokens &Toks) {
-  assert(!getLangOpts().HLSL && "no template parsing is supported in HLSL"); // HLSL Change
+  // HLSL Change - HLSL has no templates, but late parses lazy function bodies.
+  assert((!getLangOpts().HLSL || getLangOpts().HLSLLazyFunctionBodies) &&
+         "no template parsing is supported in HLSL");
   tok::TokenKind kind = Tok.getKind();
   if (!ConsumeAndStoreFunctionPrologue(Toks)) {
     // Consume everything up to (and including) the matching right brace.
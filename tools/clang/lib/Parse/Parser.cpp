@@ -575,7 +575,8 @@ bool Parser::ParseTopLevelDecl(DeclGroupPtrTy &Result) {
 
   case tok::eof:
     // Late template parsing can begin.
-    if (getLangOpts().DelayedTemplateParsing)
+    if (getLangOpts().DelayedTemplateParsing ||
+        getLangOpts().HLSLLazyFunctionBodies) // HLSL Change
       Actions.SetLateTemplateParser(LateTemplateParserCallback,
                                     PP.isIncrementalProcessingEnabled() ?
                                     LateTemplateParserCleanupCallback : nullptr,
@@ -1104,6 +1105,34 @@ Decl *Parser::ParseFunctionDefinition(ParsingDeclarator &D,
     // FIXME: Should we really fall through here?
   }
 
+  // HLSL Change Starts - with lazy function bodies, store the tokens of a
+  // body the entry point may not need; Sema parses it if the function is used.
+  if (getLangOpts().HLSLLazyFunctionBodies && !getLangOpts().IsHLSLLibrary &&
+      Tok.is(tok::l_brace) && !TemplateInfo.TemplateParams &&
+      Actions.CurContext->isFileContext() && !D.getCXXScopeSpec().isSet() &&
+      D.getIdentifier() &&
+      D.getIdentifier()->getName() != getLangOpts().HLSLEntryFunction) {
+    ParseScope BodyScope(this, Scope::FnScope|Scope::DeclScope);
+    Scope *ParentScope = getCurScope()->getParent();
+
+    D.setFunctionDefinitionKind(FDK_Definition);
+    Decl *DP = Actions.HandleDeclarator(ParentScope, D,
+                                        MultiTemplateParamsArg());
+    D.complete(DP);
+    D.getMutableDeclSpec().abort();
+
+    CachedTokens Toks;
+    LexTemplateFunctionForLateParsing(Toks);
+
+    if (DP) {
+      FunctionDecl *FnD = DP->getAsFunction();
+      Actions.CheckForFunctionRedefinition(FnD);
+      Actions.MarkAsLateParsedTemplate(FnD, DP, Toks);
+    }
+    return DP;
+  }
+  // HLSL Change Ends
+
   // Enter a scope for the function body.
   ParseScope BodyScope(this, Scope::FnScope|Scope::DeclScope);
 
@@ -12,40 +12,68 @@
 namespace clang {
 namespace spirv {
 
-void BlockReadableOrderVisitor::visit(BasicBlock *block) {
-  if (doneBlocks.count(block) || todoBlocks.count(block))
-    return;
+void BlockReadableOrderVisitor::start(BasicBlock *block) {
+  stack.clear();
+  doneBlocks.reset();
+  todoBlocks.reset();
+  startBlock = enter(block) ? block : nullptr;
+}
 
-  callback(block);
+bool BlockReadableOrderVisitor::enter(BasicBlock *block) {
+  if (contains(doneBlocks, block) || contains(todoBlocks, block))
+    return false;
 
-  doneBlocks.insert(block);
+  insert(doneBlocks, block);
 
   // Check the continue and merge targets. If any one of them exists, we need
   // to make sure visiting it is delayed until we've done the rest.
 
-  BasicBlock *continueBlock = block->getContinueTarget();
-  BasicBlock *mergeBlock = block->getMergeTarget();
+  if (BasicBlock *continueBlock = block->getContinueTarget())
+    insert(todoBlocks, continueBlock);
 
-  if (continueBlock)
-    todoBlocks.insert(continueBlock);
+  if (BasicBlock *mergeBlock = block->getMergeTarget())
+    insert(todoBlocks, mergeBlock);
 
-  if (mergeBlock)
-    todoBlocks.insert(mergeBlock);
+  stack.push_back({block, 0});
+  return true;
+}
 
-  for (BasicBlock *successor : block->getSuccessors())
-    visit(successor);
+BasicBlock *BlockReadableOrderVisitor::getNextBlock() {
+  if (BasicBlock *block = startBlock) {
+    startBlock = nullptr;
+    return block;
+  }
 
-  // Handle continue and merge targets now.
+  while (!stack.empty()) {
+    // Entering a block invalidates the reference, so it's used up front.
+    Frame &frame = stack.back();
+    const auto &successors = frame.block->getSuccessors();
+    const uint32_t numSuccessors = successors.size();
+    BasicBlock *candidate = nullptr;
 
-  if (continueBlock) {
-    todoBlocks.erase(continueBlock);
-    visit(continueBlock);
-  }
+    if (frame.next < numSuccessors) {
+      candidate = successors[frame.next++];
+    } else if (frame.next == numSuccessors) {
+      // Handle continue and merge targets now.
+      ++frame.next;
+      candidate = frame.block->getContinueTarget();
+      if (candidate)
+        erase(todoBlocks, candidate);
+    } else if (frame.next == numSuccessors + 1) {
+      ++frame.next;
+      candidate = frame.block->getMergeTarget();
+      if (candidate)
+        erase(todoBlocks, candidate);
+    } else {
+      stack.pop_back();
+      continue;
+    }
 
-  if (mergeBlock) {
-    todoBlocks.erase(mergeBlock);
-    visit(mergeBlock);
+    if (candidate && enter(candidate))
+      return candidate;
   }
+
+  return nullptr;
 }
 
 } // end namespace spirv
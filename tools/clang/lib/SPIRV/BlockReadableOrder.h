@@ -29,28 +29,65 @@
 #define LLVM_CLANG_LIB_SPIRV_BLOCKREADABLEORDER_H
 
 #include "clang/SPIRV/Structure.h"
-#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/SmallVector.h"
 
 namespace clang {
 namespace spirv {
 
 /// \brief A basic block visitor traversing basic blocks in a human readable
-/// order and calling a pre-set callback on each basic block.
+/// order and calling a callback on each basic block.
+///
+/// The traversal keeps its own stack rather than recursing, so deeply nested
+/// control flow can't overflow the call stack. Blocks are tracked by their
+/// <label-id>, which the module assigns densely.
 class BlockReadableOrderVisitor {
 public:
-  explicit BlockReadableOrderVisitor(std::function<void(BasicBlock *)> cb)
-      : callback(cb) {}
-
-  /// \brief Recursively visits all blocks reachable from the given starting
-  /// basic block in a depth-first manner and calls the callback passed-in
-  /// during construction on each basic block.
-  void visit(BasicBlock *block);
+  /// \brief Visits all blocks reachable from the given starting basic block
+  /// in a depth-first manner and calls callback on each basic block.
+  template <typename Callback>
+  void visit(BasicBlock *block, Callback callback) {
+    start(block);
+    while (BasicBlock *next = getNextBlock())
+      callback(next);
+  }
 
 private:
-  std::function<void(BasicBlock *)> callback;
+  /// A block being visited, and how far its visit has got: first through
+  /// its successors, then its continue target, then its merge target.
+  struct Frame {
+    BasicBlock *block;
+    uint32_t next;
+  };
+
+  void start(BasicBlock *block);
+  /// Returns the next block in readable order, or nullptr once all the
+  /// reachable blocks have been returned.
+  BasicBlock *getNextBlock();
+  /// Starts visiting block; returns false if it's already visited or its
+  /// visit is delayed.
+  bool enter(BasicBlock *block);
+
+  static bool contains(const llvm::BitVector &blocks, BasicBlock *block) {
+    uint32_t id = block->getLabelId();
+    return id < blocks.size() && blocks.test(id);
+  }
+  static void insert(llvm::BitVector &blocks, BasicBlock *block) {
+    uint32_t id = block->getLabelId();
+    if (id >= blocks.size())
+      blocks.resize(id + 1);
+    blocks.set(id);
+  }
+  static void erase(llvm::BitVector &blocks, BasicBlock *block) {
+    uint32_t id = block->getLabelId();
+    if (id < blocks.size())
+      blocks.reset(id);
+  }
 
-  llvm::DenseSet<BasicBlock *> doneBlocks; ///< Blocks already visited
-  llvm::DenseSet<BasicBlock *> todoBlocks; ///< Blocks to be visited later
+  llvm::SmallVector<Frame, 16> stack; ///< Blocks being visited
+  BasicBlock *startBlock = nullptr;   ///< Starting block, not yet returned
+  llvm::BitVector doneBlocks;         ///< Blocks already visited
+  llvm::BitVector todoBlocks;         ///< Blocks to be visited later
 };
 
 } // end namespace spirv
@@ -16,7 +16,7 @@ namespace spirv {
 
 Constant::Constant(spv::Op op, uint32_t type, llvm::ArrayRef<uint32_t> arg,
                    DecorationSet decs)
-    : opcode(op), typeId(type), args(arg) {
+    : opcode(op), typeId(type), args(arg), assignedId(0) {
   decorations = llvm::SetVector<const Decoration *>(decs.begin(), decs.end());
 }
 
@@ -270,13 +270,9 @@ uint32_t DeclResultIdMapper::getCounterId(const VarDecl *decl) {
   return 0;
 }
 
-std::vector<uint32_t> DeclResultIdMapper::collectStageVars() const {
-  std::vector<uint32_t> vars;
-
-  for (const auto &var : stageVars)
-    vars.push_back(var.getSpirvId());
-
-  return vars;
+void DeclResultIdMapper::reserveDecls(uint32_t count) {
+  // The map grows once it's three quarters full.
+  astDecls.resize(count * 4 / 3 + 1);
 }
 
 namespace {
@@ -422,6 +418,7 @@ bool DeclResultIdMapper::finalizeStageIOLocations(bool forInput) {
   }
 
   std::vector<const StageVar *> vars;
+  vars.reserve(stageVars.size());
   LocationSet locSet;
 
   for (const auto &var : stageVars) {
@@ -468,6 +465,9 @@ bool DeclResultIdMapper::finalizeStageIOLocations(bool forInput) {
 bool DeclResultIdMapper::decorateResourceBindings() {
   BindingSet bindingSet;
   bool noError = true;
+  // Collected for a single bulk decoration, in assignment order.
+  std::vector<ModuleBuilder::DSetBinding> bindings;
+  bindings.reserve(resourceVars.size());
 
   // Process variables with [[vk::binding(...)]] binding assignment
   for (const auto &var : resourceVars)
@@ -481,7 +481,7 @@ bool DeclResultIdMapper::decorateResourceBindings() {
             << binding << set;
         noError = false;
       } else {
-        theBuilder.decorateDSetBinding(var.getSpirvId(), set, binding);
+        bindings.push_back({var.getSpirvId(), set, binding});
         bindingSet.useBinding(binding, set);
       }
     }
@@ -496,16 +496,16 @@ bool DeclResultIdMapper::decorateResourceBindings() {
         // TODO: we can have duplicated set and binding number because of there
         // are multiple resource types in the following. E.g., :register(s0) and
         // :register(t0) will both map to set #0 and binding #0.
-        theBuilder.decorateDSetBinding(var.getSpirvId(), set, binding);
+        bindings.push_back({var.getSpirvId(), set, binding});
         bindingSet.useBinding(binding, set);
       }
 
   // Process variables with no binding assignment
   for (const auto &var : resourceVars)
     if (!var.getBinding() && !var.getRegister())
-      theBuilder.decorateDSetBinding(var.getSpirvId(), 0,
-                                     bindingSet.useNextBinding());
+      bindings.push_back({var.getSpirvId(), 0, bindingSet.useNextBinding()});
 
+  theBuilder.decorateDSetBindings(bindings);
   return noError;
 }
 
@@ -533,7 +533,7 @@ uint32_t DeclResultIdMapper::createStageVarWithoutSemantics(
     return 0;
   stageVar.setSpirvId(varId);
   stageVar.setLocationAttr(loc);
-  stageVars.push_back(stageVar);
+  addStageVar(stageVar);
   return varId;
 }
 
@@ -616,7 +616,7 @@ bool DeclResultIdMapper::createStageVars(const DeclaratorDecl *decl,
 
     stageVar.setSpirvId(varId);
     stageVar.setLocationAttr(decl->getAttr<VKLocationAttr>());
-    stageVars.push_back(stageVar);
+    addStageVar(stageVar);
 
     if (asInput) {
       *value = theBuilder.createLoad(typeId, varId);
@@ -20,6 +20,7 @@
 #include "clang/AST/Attr.h"
 #include "clang/SPIRV/EmitSPIRVOptions.h"
 #include "clang/SPIRV/ModuleBuilder.h"
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/Optional.h"
 #include "llvm/ADT/SmallVector.h"
@@ -222,9 +223,13 @@ public:
   /// {Append|Consume}StructuredBuffer variable.
   uint32_t getCounterId(const VarDecl *decl);
 
-  /// \brief Returns all defined stage (builtin/input/ouput) variables in this
-  /// mapper.
-  std::vector<uint32_t> collectStageVars() const;
+  /// \brief Returns the <result-id>s of all defined stage
+  /// (builtin/input/ouput) variables in this mapper, in creation order.
+  llvm::ArrayRef<uint32_t> getStageVarIds() const { return stageVarIds; }
+
+  /// \brief Makes room for the given number of decls, so that registering
+  /// them doesn't rehash the decl map.
+  void reserveDecls(uint32_t count);
 
   /// \brief Decorates all stage input and output variables with proper
   /// location and returns true on success.
@@ -295,6 +300,12 @@ private:
   /// SigPoint.
   spv::StorageClass getStorageClassForSigPoint(const hlsl::SigPoint *);
 
+  /// Records the given stage variable, which must have its <result-id> set.
+  void addStageVar(const StageVar &var) {
+    stageVars.push_back(var);
+    stageVarIds.push_back(var.getSpirvId());
+  }
+
   /// Returns true if the given SPIR-V stage variable has Input storage class.
   inline bool isInputStorageClass(const StageVar &v) {
     return getStorageClassForSigPoint(v.getSigPoint()) ==
@@ -315,6 +326,9 @@ private:
   llvm::DenseMap<const NamedDecl *, DeclSpirvInfo> astDecls;
   /// Vector of all defined stage variables.
   llvm::SmallVector<StageVar, 8> stageVars;
+  /// The <result-id> of each stage variable, which is the interface list of
+  /// the entry point.
+  llvm::SmallVector<uint32_t, 8> stageVarIds;
   /// Vector of all defined resource variables.
   llvm::SmallVector<ResourceVar, 8> resourceVars;
   /// Mapping from {Append|Consume}StructuredBuffers to their counter variables
@@ -9,15 +9,126 @@
 
 #include "clang/SPIRV/EmitSPIRVAction.h"
 
+#include <atomic>
+#include <system_error>
+#include <thread>
+
 #include "SPIRVEmitter.h"
+#include "dxc/Support/WorkerThreads.h"
 #include "clang/AST/ASTConsumer.h"
 #include "clang/Frontend/CompilerInstance.h"
 #include "llvm/ADT/STLExtras.h"
 
 namespace clang {
 
+namespace {
+/// Emits one SPIR-V module per entry point of the translation unit.
+class SPIRVModulesEmitter : public ASTConsumer {
+public:
+  SPIRVModulesEmitter(CompilerInstance &ci, const EmitSPIRVOptions &options,
+                      llvm::ArrayRef<SPIRVEntryPoint> entries,
+                      std::vector<std::vector<uint32_t>> *modules)
+      : theCompilerInstance(ci), spirvOptions(options), entryPoints(entries),
+        theModules(modules) {}
+
+  void HandleTranslationUnit(ASTContext &context) override;
+
+private:
+  /// Runs SPIRV-Tools on the modules with a nonzero optimization level, in
+  /// parallel. Returns the messages of each module that failed, or an empty
+  /// string for the modules that succeeded.
+  std::vector<std::string>
+  optimizeModules(const std::vector<unsigned> &optLevels);
+
+  CompilerInstance &theCompilerInstance;
+  const EmitSPIRVOptions &spirvOptions;
+  llvm::ArrayRef<SPIRVEntryPoint> entryPoints;
+  std::vector<std::vector<uint32_t>> *theModules;
+};
+
+void SPIRVModulesEmitter::HandleTranslationUnit(ASTContext &context) {
+  theModules->clear();
+  theModules->resize(entryPoints.size());
+  // Zero for the modules that need no SPIRV-Tools passes.
+  std::vector<unsigned> optLevels(entryPoints.size(), 0);
+
+  for (size_t i = 0; i < entryPoints.size(); ++i) {
+    const hlsl::ShaderModel *model =
+        hlsl::ShaderModel::GetByName(entryPoints[i].profile.c_str());
+    if (model == nullptr || !model->IsValid()) {
+      DiagnosticsEngine &diags = theCompilerInstance.getDiagnostics();
+      const auto diagId = diags.getCustomDiagID(
+          DiagnosticsEngine::Error,
+          "unknown shader model '%0' for entry point %1");
+      diags.Report(diagId) << entryPoints[i].profile << entryPoints[i].name;
+      return;
+    }
+    spirv::SPIRVEmitter emitter(theCompilerInstance, spirvOptions,
+                                entryPoints[i].name, *model);
+    // Like a single compile, stop at the first entry point with errors.
+    if (!emitter.translateTranslationUnit(context, &(*theModules)[i])) {
+      (*theModules)[i].clear();
+      return;
+    }
+    if (emitter.needsOptimization())
+      optLevels[i] = emitter.getOptimizationLevel();
+  }
+
+  const std::vector<std::string> messages = optimizeModules(optLevels);
+  DiagnosticsEngine &diags = theCompilerInstance.getDiagnostics();
+  for (size_t i = 0; i < entryPoints.size(); ++i) {
+    if (messages[i].empty())
+      continue;
+    const auto diagId = diags.getCustomDiagID(
+        DiagnosticsEngine::Fatal,
+        "failed to legalize/optimize SPIR-V for entry point %0: %1");
+    diags.Report(diagId) << entryPoints[i].name << messages[i];
+    (*theModules)[i].clear();
+  }
+}
+
+std::vector<std::string> SPIRVModulesEmitter::optimizeModules(
+    const std::vector<unsigned> &optLevels) {
+  std::vector<std::string> messages(entryPoints.size());
+  std::atomic<size_t> nextModule(0);
+  auto worker = [&]() {
+    hlsl::WorkerThreadScope workerScope;
+    for (size_t i = nextModule++; i < entryPoints.size(); i = nextModule++) {
+      if (optLevels[i] == 0)
+        continue;
+      std::string moduleMessages;
+      if (!spirv::SPIRVEmitter::optimizeModule(&(*theModules)[i],
+                                               optLevels[i], &moduleMessages))
+        messages[i] = moduleMessages.empty() ? "unknown error"
+                                             : std::move(moduleMessages);
+    }
+  };
+
+  hlsl::WorkerThreadReservation reservation((unsigned)entryPoints.size());
+  const size_t threadCount = reservation.GetThreadCount();
+  std::vector<std::thread> threads;
+  try {
+    for (size_t t = 1; t < threadCount; ++t)
+      threads.emplace_back(worker);
+  } catch (const std::system_error &) {
+    // Carry on with the threads that did start.
+  }
+  worker();
+  for (std::thread &thread : threads)
+    thread.join();
+  return messages;
+}
+} // namespace
+
 std::unique_ptr<ASTConsumer>
 EmitSPIRVAction::CreateASTConsumer(CompilerInstance &CI, StringRef InFile) {
   return llvm::make_unique<spirv::SPIRVEmitter>(CI, options);
 }
+
+std::unique_ptr<ASTConsumer>
+EmitSPIRVModulesAction::CreateASTConsumer(CompilerInstance &CI,
+                                          StringRef InFile) {
+  return llvm::make_unique<SPIRVModulesEmitter>(CI, options, entries,
+                                                &modules);
+}
 } // end namespace clang
@@ -31,13 +31,20 @@ inline bool bitEnumContains(spv::MemoryAccessMask bits,
 } // namespace
 
 InstBuilder::InstBuilder(WordConsumer consumer)
-    : TheConsumer(consumer), TheStatus(Status::Success) {}
+    : TheConsumer(consumer), TheSite(nullptr), TheStatus(Status::Success) {}
 
-void InstBuilder::setConsumer(WordConsumer consumer) { TheConsumer = consumer; }
+InstBuilder::InstBuilder(std::vector<uint32_t> *constructSite)
+    : TheConsumer(nullptr), TheSite(constructSite),
+      TheStatus(Status::Success) {}
+
+void InstBuilder::setConsumer(WordConsumer consumer) {
+  TheConsumer = consumer;
+  TheSite = nullptr;
+}
 const WordConsumer &InstBuilder::getConsumer() const { return TheConsumer; }
 
 InstBuilder::Status InstBuilder::x() {
-  if (TheConsumer == nullptr)
+  if (TheConsumer == nullptr && TheSite == nullptr)
     return Status::NullConsumer;
 
   if (TheStatus != Status::Success)
@@ -66,7 +73,11 @@ InstBuilder::Status InstBuilder::x() {
 
   if (!TheInst.empty())
     TheInst.front() |= uint32_t(TheInst.size()) << 16;
-  TheConsumer(std::move(TheInst));
+  if (TheSite) {
+    TheSite->assign(TheInst.begin(), TheInst.end());
+  } else {
+    TheConsumer(std::move(TheInst));
+  }
   TheInst.clear();
 
   return TheStatus;
@@ -11,6 +11,7 @@
 
 #include "spirv/1.0//spirv.hpp11"
 #include "clang/SPIRV/InstBuilder.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/llvm_assert/assert.h"
 
 namespace clang {
@@ -18,13 +19,12 @@ namespace spirv {
 
 ModuleBuilder::ModuleBuilder(SPIRVContext *C)
     : theContext(*C), theModule(), theFunction(nullptr), insertPoint(nullptr),
-      instBuilder(nullptr), glslExtSetId(0) {
-  instBuilder.setConsumer([this](std::vector<uint32_t> &&words) {
-    this->constructSite = std::move(words);
-  });
-}
+      instBuilder(&constructSite), glslExtSetId(0),
+      groupingDecorations(false) {}
 
 std::vector<uint32_t> ModuleBuilder::takeModule() {
+  if (groupingDecorations)
+    theModule.groupDecorations([this]() { return theContext.takeNextId(); });
   theModule.setBound(theContext.getNextId());
 
   std::vector<uint32_t> binary;
@@ -133,7 +133,7 @@ ModuleBuilder::createCompositeConstruct(uint32_t resultType,
   assert(insertPoint && "null insert point");
   const uint32_t resultId = theContext.takeNextId();
   instBuilder.opCompositeConstruct(resultType, resultId, constituents).x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  insertPoint->appendInstruction(constructSite);
   return resultId;
 }
 
@@ -143,7 +143,7 @@ ModuleBuilder::createCompositeExtract(uint32_t resultType, uint32_t composite,
   assert(insertPoint && "null insert point");
   const uint32_t resultId = theContext.takeNextId();
   instBuilder.opCompositeExtract(resultType, resultId, composite, indexes).x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  insertPoint->appendInstruction(constructSite);
   return resultId;
 }
 
@@ -155,7 +155,7 @@ ModuleBuilder::createVectorShuffle(uint32_t resultType, uint32_t vector1,
   const uint32_t resultId = theContext.takeNextId();
   instBuilder.opVectorShuffle(resultType, resultId, vector1, vector2, selectors)
       .x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  insertPoint->appendInstruction(constructSite);
   return resultId;
 }
 
@@ -163,14 +163,14 @@ uint32_t ModuleBuilder::createLoad(uint32_t resultType, uint32_t pointer) {
   assert(insertPoint && "null insert point");
   const uint32_t resultId = theContext.takeNextId();
   instBuilder.opLoad(resultType, resultId, pointer, llvm::None).x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  insertPoint->appendInstruction(constructSite);
   return resultId;
 }
 
 void ModuleBuilder::createStore(uint32_t address, uint32_t value) {
   assert(insertPoint && "null insert point");
   instBuilder.opStore(address, value, llvm::None).x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  insertPoint->appendInstruction(constructSite);
 }
 
 uint32_t ModuleBuilder::createFunctionCall(uint32_t returnType,
@@ -179,7 +179,7 @@ uint32_t ModuleBuilder::createFunctionCall(uint32_t returnType,
   assert(insertPoint && "null insert point");
   const uint32_t id = theContext.takeNextId();
   instBuilder.opFunctionCall(returnType, id, functionId, params).x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  insertPoint->appendInstruction(constructSite);
   return id;
 }
 
@@ -188,7 +188,7 @@ uint32_t ModuleBuilder::createAccessChain(uint32_t resultType, uint32_t base,
   assert(insertPoint && "null insert point");
   const uint32_t id = theContext.takeNextId();
   instBuilder.opAccessChain(resultType, id, base, indexes).x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  insertPoint->appendInstruction(constructSite);
   return id;
 }
 
@@ -197,7 +197,7 @@ uint32_t ModuleBuilder::createUnaryOp(spv::Op op, uint32_t resultType,
   assert(insertPoint && "null insert point");
   const uint32_t id = theContext.takeNextId();
   instBuilder.unaryOp(op, resultType, id, operand).x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  insertPoint->appendInstruction(constructSite);
   return id;
 }
 
@@ -206,7 +206,7 @@ uint32_t ModuleBuilder::createBinaryOp(spv::Op op, uint32_t resultType,
   assert(insertPoint && "null insert point");
   const uint32_t id = theContext.takeNextId();
   instBuilder.binaryOp(op, resultType, id, lhs, rhs).x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  insertPoint->appendInstruction(constructSite);
   return id;
 }
 
@@ -262,7 +262,7 @@ uint32_t ModuleBuilder::createAtomicOp(spv::Op opcode, uint32_t resultType,
     assert(false && "unimplemented atomic opcode");
   }
   instBuilder.x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  insertPoint->appendInstruction(constructSite);
   return id;
 }
 
@@ -276,7 +276,7 @@ uint32_t ModuleBuilder::createAtomicCompareExchange(
       resultType, id, orignalValuePtr, scopeId, equalMemorySemanticsId,
       unequalMemorySemanticsId, valueToOp, comparator);
   instBuilder.x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  insertPoint->appendInstruction(constructSite);
   return id;
 }
 
@@ -342,7 +342,7 @@ uint32_t ModuleBuilder::createImageSample(
   const uint32_t sampledImgId = theContext.takeNextId();
   const uint32_t sampledImgTy = getSampledImageType(imageType);
   instBuilder.opSampledImage(sampledImgTy, sampledImgId, image, sampler).x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  insertPoint->appendInstruction(constructSite);
 
   const uint32_t texelId = theContext.takeNextId();
   llvm::SmallVector<uint32_t, 4> params;
@@ -378,7 +378,7 @@ uint32_t ModuleBuilder::createImageSample(
   for (const auto param : params)
     instBuilder.idRef(param);
   instBuilder.x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  insertPoint->appendInstruction(constructSite);
 
   return texelId;
 }
@@ -387,7 +387,7 @@ void ModuleBuilder::createImageWrite(uint32_t imageId, uint32_t coordId,
                                      uint32_t texelId) {
   assert(insertPoint && "null insert point");
   instBuilder.opImageWrite(imageId, coordId, texelId, llvm::None).x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  insertPoint->appendInstruction(constructSite);
 }
 
 uint32_t ModuleBuilder::createImageFetchOrRead(
@@ -411,7 +411,7 @@ uint32_t ModuleBuilder::createImageFetchOrRead(
   for (const auto param : params)
     instBuilder.idRef(param);
   instBuilder.x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  insertPoint->appendInstruction(constructSite);
 
   return texelId;
 }
@@ -427,7 +427,7 @@ uint32_t ModuleBuilder::createImageGather(
   const uint32_t sampledImgId = theContext.takeNextId();
   const uint32_t sampledImgTy = getSampledImageType(imageType);
   instBuilder.opSampledImage(sampledImgTy, sampledImgId, image, sampler).x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  insertPoint->appendInstruction(constructSite);
 
   llvm::SmallVector<uint32_t, 2> params;
 
@@ -449,7 +449,7 @@ uint32_t ModuleBuilder::createImageGather(
   for (const auto param : params)
     instBuilder.idRef(param);
   instBuilder.x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  insertPoint->appendInstruction(constructSite);
 
   return texelId;
 }
@@ -459,7 +459,7 @@ uint32_t ModuleBuilder::createSelect(uint32_t resultType, uint32_t condition,
   assert(insertPoint && "null insert point");
   const uint32_t id = theContext.takeNextId();
   instBuilder.opSelect(resultType, id, condition, trueValue, falseValue).x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  insertPoint->appendInstruction(constructSite);
   return id;
 }
 
@@ -470,18 +470,18 @@ void ModuleBuilder::createSwitch(
   // Create the OpSelectioMerege.
   instBuilder.opSelectionMerge(mergeLabel, spv::SelectionControlMask::MaskNone)
       .x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  insertPoint->appendInstruction(constructSite);
 
   // Create the OpSwitch.
   instBuilder.opSwitch(selector, defaultLabel, target).x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  insertPoint->appendInstruction(constructSite);
 }
 
 void ModuleBuilder::createKill() {
   assert(insertPoint && "null insert point");
   assert(!isCurrentBasicBlockTerminated());
   instBuilder.opKill().x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  insertPoint->appendInstruction(constructSite);
 }
 
 void ModuleBuilder::createBranch(uint32_t targetLabel, uint32_t mergeBB,
@@ -491,11 +491,11 @@ void ModuleBuilder::createBranch(uint32_t targetLabel, uint32_t mergeBB,
 
   if (mergeBB && continueBB) {
     instBuilder.opLoopMerge(mergeBB, continueBB, loopControl).x();
-    insertPoint->appendInstruction(std::move(constructSite));
+    insertPoint->appendInstruction(constructSite);
   }
 
   instBuilder.opBranch(targetLabel).x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  insertPoint->appendInstruction(constructSite);
 }
 
 void ModuleBuilder::createConditionalBranch(
@@ -508,27 +508,27 @@ void ModuleBuilder::createConditionalBranch(
   if (mergeLabel) {
     if (continueLabel) {
       instBuilder.opLoopMerge(mergeLabel, continueLabel, loopControl).x();
-      insertPoint->appendInstruction(std::move(constructSite));
+      insertPoint->appendInstruction(constructSite);
     } else {
       instBuilder.opSelectionMerge(mergeLabel, selectionControl).x();
-      insertPoint->appendInstruction(std::move(constructSite));
+      insertPoint->appendInstruction(constructSite);
     }
   }
 
   instBuilder.opBranchConditional(condition, trueLabel, falseLabel, {}).x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  insertPoint->appendInstruction(constructSite);
 }
 
 void ModuleBuilder::createReturn() {
   assert(insertPoint && "null insert point");
   instBuilder.opReturn().x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  insertPoint->appendInstruction(constructSite);
 }
 
 void ModuleBuilder::createReturnValue(uint32_t value) {
   assert(insertPoint && "null insert point");
   instBuilder.opReturnValue(value).x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  insertPoint->appendInstruction(constructSite);
 }
 
 uint32_t ModuleBuilder::createExtInst(uint32_t resultType, uint32_t setId,
@@ -537,7 +537,7 @@ uint32_t ModuleBuilder::createExtInst(uint32_t resultType, uint32_t setId,
   assert(insertPoint && "null insert point");
   uint32_t resultId = theContext.takeNextId();
   instBuilder.opExtInst(resultType, resultId, setId, instId, operands).x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  insertPoint->appendInstruction(constructSite);
   return resultId;
 }
 
@@ -545,7 +545,7 @@ void ModuleBuilder::createControlBarrier(uint32_t execution, uint32_t memory,
                                          uint32_t semantics) {
   assert(insertPoint && "null insert point");
   instBuilder.opControlBarrier(execution, memory, semantics).x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  insertPoint->appendInstruction(constructSite);
 }
 
 void ModuleBuilder::addExecutionMode(uint32_t entryPointId,
@@ -556,7 +556,7 @@ void ModuleBuilder::addExecutionMode(uint32_t entryPointId,
     instBuilder.literalInteger(param);
   }
   instBuilder.x();
-  theModule.addExecutionMode(std::move(constructSite));
+  theModule.addExecutionMode(constructSite);
 }
 
 uint32_t ModuleBuilder::getGLSLExtInstSet() {
@@ -573,7 +573,7 @@ uint32_t ModuleBuilder::addStageIOVar(uint32_t type,
   const uint32_t pointerType = getPointerType(type, storageClass);
   const uint32_t varId = theContext.takeNextId();
   instBuilder.opVariable(pointerType, varId, storageClass, llvm::None).x();
-  theModule.addVariable(std::move(constructSite));
+  theModule.addVariable(constructSite);
   theModule.addDebugName(varId, name);
   return varId;
 }
@@ -583,7 +583,7 @@ uint32_t ModuleBuilder::addStageBuiltinVar(uint32_t type, spv::StorageClass sc,
   const uint32_t pointerType = getPointerType(type, sc);
   const uint32_t varId = theContext.takeNextId();
   instBuilder.opVariable(pointerType, varId, sc, llvm::None).x();
-  theModule.addVariable(std::move(constructSite));
+  theModule.addVariable(constructSite);
 
   // Decorate with the specified Builtin
   const Decoration *d = Decoration::getBuiltIn(theContext, builtin);
@@ -601,7 +601,7 @@ uint32_t ModuleBuilder::addModuleVar(uint32_t type, spv::StorageClass sc,
   const uint32_t pointerType = getPointerType(type, sc);
   const uint32_t varId = theContext.takeNextId();
   instBuilder.opVariable(pointerType, varId, sc, init).x();
-  theModule.addVariable(std::move(constructSite));
+  theModule.addVariable(constructSite);
   theModule.addDebugName(varId, name);
   return varId;
 }
@@ -615,6 +615,21 @@ void ModuleBuilder::decorateDSetBinding(uint32_t targetId, uint32_t setNumber,
   theModule.addDecoration(d, targetId);
 }
 
+void ModuleBuilder::decorateDSetBindings(llvm::ArrayRef<DSetBinding> bindings) {
+  // Resources rarely span more than a few descriptor sets.
+  llvm::SmallDenseMap<uint32_t, const Decoration *, 4> setDecorations;
+  for (const auto &binding : bindings) {
+    const Decoration *&setDecoration = setDecorations[binding.setNumber];
+    if (!setDecoration)
+      setDecoration =
+          Decoration::getDescriptorSet(theContext, binding.setNumber);
+    theModule.addDecoration(setDecoration, binding.targetId);
+    theModule.addDecoration(
+        Decoration::getBinding(theContext, binding.bindingNumber),
+        binding.targetId);
+  }
+}
+
 void ModuleBuilder::decorateLocation(uint32_t targetId, uint32_t location) {
   const Decoration *d =
       Decoration::getLocation(theContext, location, llvm::None);
@@ -17,54 +17,36 @@ namespace spirv {
 
 uint32_t SPIRVContext::getResultIdForType(const Type *t, bool *isRegistered) {
   assert(t != nullptr);
-  uint32_t result_id = 0;
 
-  auto iter = typeResultIdMap.find(t);
-  if (iter == typeResultIdMap.end()) {
+  if (isRegistered)
+    *isRegistered = t->assignedId != 0;
+  if (t->assignedId == 0) {
     // The Type has not been defined yet. Reserve an ID for it.
-    result_id = takeNextId();
-    typeResultIdMap[t] = result_id;
-    if (isRegistered)
-      *isRegistered = false;
-  } else {
-    result_id = iter->second;
-    if (isRegistered)
-      *isRegistered = true;
+    t->assignedId = takeNextId();
   }
 
-  assert(result_id != 0);
-  return result_id;
+  return t->assignedId;
 }
 
 uint32_t SPIRVContext::getResultIdForConstant(const Constant *c) {
   assert(c != nullptr);
-  uint32_t result_id = 0;
 
-  auto iter = constantResultIdMap.find(c);
-  if (iter == constantResultIdMap.end()) {
+  if (c->assignedId == 0) {
     // The constant has not been defined yet. Reserve an ID for it.
-    result_id = takeNextId();
-    constantResultIdMap[c] = result_id;
-  } else {
-    result_id = iter->second;
+    c->assignedId = takeNextId();
   }
 
-  assert(result_id != 0);
-  return result_id;
+  return c->assignedId;
 }
 
 const Type *SPIRVContext::registerType(const Type &t) {
-  // Insert function will only insert if it doesn't already exist in the set.
-  TypeSet::iterator it;
-  std::tie(it, std::ignore) = existingTypes.insert(t);
-  return &*it;
+  // Only copies the type in if it doesn't already exist in the table.
+  return existingTypes.intern(t);
 }
 
 const Constant *SPIRVContext::registerConstant(const Constant &c) {
-  // Insert function will only insert if it doesn't already exist in the set.
-  ConstantSet::iterator it;
-  std::tie(it, std::ignore) = existingConstants.insert(c);
-  return &*it;
+  // Only copies the constant in if it doesn't already exist in the table.
+  return existingConstants.intern(c);
 }
 
 const Decoration *SPIRVContext::registerDecoration(const Decoration &d) {
@@ -13,6 +13,8 @@
 
 #include "SPIRVEmitter.h"
 
+#include <algorithm>
+
 #include "dxc/HlslIntrinsicOp.h"
 #include "spirv-tools/optimizer.hpp"
 #include "llvm/ADT/StringExtras.h"
@@ -174,7 +176,12 @@ const Expr *isStructuredBufferLoad(const Expr *expr, const Expr **index) {
   return nullptr;
 }
 
-bool spirvToolsOptimize(std::vector<uint32_t> *module, std::string *messages) {
+/// Runs the SPIRV-Tools passes for the given optimization level on the given
+/// module. Every level legalizes the module; higher levels also fold and
+/// unify constants and repeat the load/store elimination the first round of
+/// cleanups exposes.
+bool spirvToolsOptimize(std::vector<uint32_t> *module, unsigned optLevel,
+                        std::string *messages) {
   spvtools::Optimizer optimizer(SPV_ENV_VULKAN_1_0);
 
   optimizer.SetMessageConsumer(
@@ -195,7 +202,24 @@ bool spirvToolsOptimize(std::vector<uint32_t> *module, std::string *messages) {
   optimizer.RegisterPass(spvtools::CreateInsertExtractElimPass());
   optimizer.RegisterPass(spvtools::CreateAggressiveDCEPass());
 
+  if (optLevel >= 2) {
+    // Loads from uniform and stage input variables are redundant across
+    // blocks; hoist them so the second round sees through them.
+    optimizer.RegisterPass(spvtools::CreateCommonUniformElimPass());
+    optimizer.RegisterPass(spvtools::CreateLocalSingleBlockLoadStoreElimPass());
+    optimizer.RegisterPass(spvtools::CreateLocalSingleStoreElimPass());
+    optimizer.RegisterPass(spvtools::CreateDeadBranchElimPass());
+    optimizer.RegisterPass(spvtools::CreateBlockMergePass());
+    optimizer.RegisterPass(spvtools::CreateInsertExtractElimPass());
+    optimizer.RegisterPass(spvtools::CreateAggressiveDCEPass());
+  }
+
   optimizer.RegisterPass(spvtools::CreateEliminateDeadFunctionsPass());
+  if (optLevel >= 1) {
+    optimizer.RegisterPass(
+        spvtools::CreateFoldSpecConstantOpAndCompositePass());
+    optimizer.RegisterPass(spvtools::CreateUnifyConstantPass());
+  }
   optimizer.RegisterPass(spvtools::CreateEliminateDeadConstantPass());
 
   optimizer.RegisterPass(spvtools::CreateCompactIdsPass());
@@ -237,25 +261,52 @@ spv::Op translateRWBABufferAtomicMethods(hlsl::IntrinsicOp opcode) {
 
 SPIRVEmitter::SPIRVEmitter(CompilerInstance &ci,
                            const EmitSPIRVOptions &options)
+    : SPIRVEmitter(ci, options, ci.getCodeGenOpts().HLSLEntryFunction,
+                   *hlsl::ShaderModel::GetByName(
+                       ci.getCodeGenOpts().HLSLProfile.c_str())) {}
+
+SPIRVEmitter::SPIRVEmitter(CompilerInstance &ci,
+                           const EmitSPIRVOptions &options,
+                           llvm::StringRef entry,
+                           const hlsl::ShaderModel &model)
     : theCompilerInstance(ci), astContext(ci.getASTContext()),
       diags(ci.getDiagnostics()), spirvOptions(options),
-      entryFunctionName(ci.getCodeGenOpts().HLSLEntryFunction),
-      shaderModel(*hlsl::ShaderModel::GetByName(
-          ci.getCodeGenOpts().HLSLProfile.c_str())),
-      theContext(), theBuilder(&theContext),
+      entryFunctionName(entry), shaderModel(model), theContext(),
+      theBuilder(&theContext),
       declIdMapper(shaderModel, astContext, theBuilder, diags, spirvOptions),
       typeTranslator(astContext, theBuilder, diags), entryFunctionId(0),
       curFunction(nullptr), curThis(0), needsLegalization(false) {
   if (shaderModel.GetKind() == hlsl::ShaderModel::Kind::Invalid)
     emitError("unknown shader module: %0") << shaderModel.GetName();
+  theBuilder.setGroupDecorations(spirvOptions.groupDecorations);
 }
 
 void SPIRVEmitter::HandleTranslationUnit(ASTContext &context) {
+  std::vector<uint32_t> m;
+  if (!translateTranslationUnit(context, &m))
+    return;
+
+  if (needsOptimization()) {
+    std::string messages;
+    if (!optimizeModule(&m, getOptimizationLevel(), &messages)) {
+      emitFatalError("failed to legalize/optimize SPIR-V: %0") << messages;
+      return;
+    }
+  }
+
+  theCompilerInstance.getOutStream()->write(
+      reinterpret_cast<const char *>(m.data()), m.size() * 4);
+}
+
+bool SPIRVEmitter::translateTranslationUnit(ASTContext &context,
+                                            std::vector<uint32_t> *module) {
   // Stop translating if there are errors in previous compilation stages.
   if (context.getDiagnostics().hasErrorOccurred())
-    return;
+    return false;
 
   TranslationUnitDecl *tu = context.getTranslationUnitDecl();
+  declIdMapper.reserveDecls(
+      std::distance(tu->decls_begin(), tu->decls_end()));
 
   // The entry function is the seed of the queue.
   for (auto *decl : tu->decls()) {
@@ -287,7 +338,7 @@ void SPIRVEmitter::HandleTranslationUnit(ASTContext &context) {
   }
 
   if (context.getDiagnostics().hasErrorOccurred())
-    return;
+    return false;
 
   AddRequiredCapabilitiesForShaderModel();
 
@@ -296,35 +347,40 @@ void SPIRVEmitter::HandleTranslationUnit(ASTContext &context) {
   theBuilder.setMemoryModel(spv::MemoryModel::GLSL450);
 
   theBuilder.addEntryPoint(getSpirvShaderStage(shaderModel), entryFunctionId,
-                           entryFunctionName, declIdMapper.collectStageVars());
+                           entryFunctionName, declIdMapper.getStageVarIds());
 
   AddExecutionModeForEntryPoint(entryFunctionId);
 
   // Add Location decorations to stage input/output variables.
   if (!declIdMapper.decorateStageIOLocations())
-    return;
+    return false;
 
   // Add descriptor set and binding decorations to resource variables.
   if (!declIdMapper.decorateResourceBindings())
-    return;
+    return false;
 
   // Output the constructed module.
-  std::vector<uint32_t> m = theBuilder.takeModule();
+  *module = theBuilder.takeModule();
+  return true;
+}
 
+bool SPIRVEmitter::needsOptimization() {
   const auto optLevel = theCompilerInstance.getCodeGenOpts().OptimizationLevel;
-  if (needsLegalization || optLevel > 0) {
-    if (needsLegalization && optLevel == 0)
-      emitWarning("-O0 ignored since SPIR-V legalization required");
+  if (needsLegalization && optLevel == 0)
+    emitWarning("-O0 ignored since SPIR-V legalization required");
+  return needsLegalization || optLevel > 0;
+}
 
-    std::string messages;
-    if (!spirvToolsOptimize(&m, &messages)) {
-      emitFatalError("failed to legalize/optimize SPIR-V: %0") << messages;
-      return;
-    }
-  }
+unsigned SPIRVEmitter::getOptimizationLevel() const {
+  // Legalization runs the -O1 pipeline.
+  const unsigned optLevel =
+      theCompilerInstance.getCodeGenOpts().OptimizationLevel;
+  return std::max(optLevel, needsLegalization ? 1u : 0u);
+}
 
-  theCompilerInstance.getOutStream()->write(
-      reinterpret_cast<const char *>(m.data()), m.size() * 4);
+bool SPIRVEmitter::optimizeModule(std::vector<uint32_t> *module,
+                                  unsigned optLevel, std::string *messages) {
+  return spirvToolsOptimize(module, optLevel, messages);
 }
 
 void SPIRVEmitter::doDecl(const Decl *decl) {
@@ -4289,28 +4345,23 @@ uint32_t SPIRVEmitter::processIntrinsicDot(const CallExpr *callExpr) {
   // Therefore, we use other SPIR-V instructions (addition and
   // multiplication).
   else {
-    uint32_t result = 0;
-    llvm::SmallVector<uint32_t, 4> multIds;
     const spv::Op multSpvOp = translateOp(BO_Mul, arg0Type);
     const spv::Op addSpvOp = translateOp(BO_Add, arg0Type);
 
-    // Extract members from the two vectors and multiply them.
-    for (unsigned int i = 0; i < vec0Size; ++i) {
-      const uint32_t vec0member =
-          theBuilder.createCompositeExtract(returnTypeId, arg0Id, {i});
-      const uint32_t vec1member =
-          theBuilder.createCompositeExtract(returnTypeId, arg1Id, {i});
-      const uint32_t multId = theBuilder.createBinaryOp(multSpvOp, returnTypeId,
-                                                        vec0member, vec1member);
-      multIds.push_back(multId);
-    }
-    // Add all the multiplications.
-    result = multIds[0];
-    for (unsigned int i = 1; i < vec0Size; ++i) {
-      const uint32_t additionId =
+    // Multiply the two vectors as a whole rather than component by component,
+    // so that vector hardware does all the multiplications at once.
+    const uint32_t multId = theBuilder.createBinaryOp(
+        multSpvOp, typeTranslator.translateType(arg0Type), arg0Id, arg1Id);
+
+    // Extract the products and add them.
+    llvm::SmallVector<uint32_t, 4> multIds;
+    for (uint32_t i = 0; i < vec0Size; ++i)
+      multIds.push_back(
+          theBuilder.createCompositeExtract(returnTypeId, multId, {i}));
+    uint32_t result = multIds[0];
+    for (uint32_t i = 1; i < vec0Size; ++i)
+      result =
           theBuilder.createBinaryOp(addSpvOp, returnTypeId, result, multIds[i]);
-      result = additionId;
-    }
     return result;
   }
 }
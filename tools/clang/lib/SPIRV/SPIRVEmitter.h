@@ -46,9 +46,35 @@ namespace spirv {
 class SPIRVEmitter : public ASTConsumer {
 public:
   SPIRVEmitter(CompilerInstance &ci, const EmitSPIRVOptions &options);
+  /// Constructs an emitter translating the given entry function for the given
+  /// shader model, instead of the ones on the command line.
+  SPIRVEmitter(CompilerInstance &ci, const EmitSPIRVOptions &options,
+               llvm::StringRef entry, const hlsl::ShaderModel &model);
 
   void HandleTranslationUnit(ASTContext &context) override;
 
+  /// Translates the entry function and everything reachable from it into
+  /// *module, without legalizing or optimizing the result. Returns false if
+  /// translation failed.
+  bool translateTranslationUnit(ASTContext &context,
+                                std::vector<uint32_t> *module);
+
+  /// Returns whether the module produced by translateTranslationUnit() must
+  /// be run through optimizeModule() before being written out.
+  bool needsOptimization();
+
+  /// Returns the level of the SPIRV-Tools pipeline to run on the module
+  /// produced by translateTranslationUnit(): the -O level, but at least 1 if
+  /// the module needs legalization.
+  unsigned getOptimizationLevel() const;
+
+  /// Runs the SPIRV-Tools legalization and optimization passes for the given
+  /// level on the given module. This neither touches the AST nor reports
+  /// diagnostics, so modules for different entry points may be optimized on
+  /// different threads.
+  static bool optimizeModule(std::vector<uint32_t> *module, unsigned optLevel,
+                             std::string *messages);
+
   ASTContext &getASTContext() { return astContext; }
   ModuleBuilder &getModuleBuilder() { return theBuilder; }
   TypeTranslator &getTypeTranslator() { return typeTranslator; }
@@ -622,7 +648,7 @@ private:
   EmitSPIRVOptions spirvOptions;
 
   /// Entry function name and shader stage. Both of them are derived from the
-  /// command line and should be const.
+  /// command line, unless given explicitly, and should be const.
   const llvm::StringRef entryFunctionName;
   const hlsl::ShaderModel &shaderModel;
 
@@ -9,7 +9,10 @@
 
 #include "clang/SPIRV/Structure.h"
 
+#include <map>
+
 #include "BlockReadableOrder.h"
+#include "llvm/ADT/SmallPtrSet.h"
 
 namespace clang {
 namespace spirv {
@@ -17,6 +20,25 @@ namespace spirv {
 namespace {
 constexpr uint32_t kGeneratorNumber = 14;
 constexpr uint32_t kToolVersion = 0;
+
+/// Returns true if the given opcode is for a termination instruction.
+///
+/// See "2.2.4. Control Flow" in the SPIR-V spec for the defintion of
+/// termination instructions.
+bool isTerminatorOpcode(spv::Op opcode) {
+  switch (opcode) {
+  case spv::Op::OpBranch:
+  case spv::Op::OpBranchConditional:
+  case spv::Op::OpReturn:
+  case spv::Op::OpReturnValue:
+  case spv::Op::OpSwitch:
+  case spv::Op::OpKill:
+  case spv::Op::OpUnreachable:
+    return true;
+  default:
+    return false;
+  }
+}
 } // namespace
 
 // === Instruction implementations ===
@@ -30,18 +52,37 @@ spv::Op Instruction::getOpcode() const {
 }
 
 bool Instruction::isTerminator() const {
-  switch (getOpcode()) {
-  case spv::Op::OpBranch:
-  case spv::Op::OpBranchConditional:
-  case spv::Op::OpReturn:
-  case spv::Op::OpReturnValue:
-  case spv::Op::OpSwitch:
-  case spv::Op::OpKill:
-  case spv::Op::OpUnreachable:
-    return true;
-  default:
-    return false;
+  return isTerminatorOpcode(getOpcode());
+}
+
+// === Instruction list implementations ===
+
+uint32_t InstructionList::append(llvm::ArrayRef<uint32_t> inst) {
+  if (inst.empty())
+    return static_cast<uint32_t>(words.size());
+  lastOffset = static_cast<uint32_t>(words.size());
+  words.insert(words.end(), inst.begin(), inst.end());
+  return lastOffset;
+}
+
+void InstructionList::prepend(InstructionList &&that) {
+  if (that.isEmpty())
+    return;
+  if (!isEmpty()) {
+    lastOffset += static_cast<uint32_t>(that.words.size());
+  } else {
+    lastOffset = that.lastOffset;
+  }
+  words.insert(words.begin(), that.words.begin(), that.words.end());
+  that.clear();
+}
+
+spv::Op InstructionList::getLastOpcode() const {
+  if (!isEmpty()) {
+    return static_cast<spv::Op>(words[lastOffset] & spv::OpCodeMask);
   }
+
+  return spv::Op::Max;
 }
 
 // === Basic block implementations ===
@@ -74,15 +115,14 @@ void BasicBlock::take(InstBuilder *builder) {
 
   builder->opLabel(labelId).x();
 
-  for (auto &inst : instructions) {
-    builder->getConsumer()(inst.take());
-  }
+  // All instructions of the block go out in one piece.
+  builder->getConsumer()(instructions.take());
 
   clear();
 }
 
 bool BasicBlock::isTerminated() const {
-  return !instructions.empty() && instructions.back().isTerminator();
+  return isTerminatorOpcode(instructions.getLastOpcode());
 }
 
 // === Function implementations ===
@@ -127,26 +167,21 @@ void Function::take(InstBuilder *builder) {
     builder->opFunctionParameter(param.first, param.second).x();
   }
 
-  if (!variables.empty()) {
+  if (!variables.isEmpty()) {
     assert(!blocks.empty());
-  }
-
-  // Preprend all local variables to the entry block.
-  // This is necessary since SPIR-V requires all local variables to be defined
-  // at the very begining of the entry block.
-  // We need to do it in the reverse order to guarantee variables have the
-  // same definition order in SPIR-V as in the source code.
-  for (auto it = variables.rbegin(), ie = variables.rend(); it != ie; ++it) {
-    blocks.front()->prependInstruction(std::move(*it));
+    // Preprend all local variables to the entry block.
+    // This is necessary since SPIR-V requires all local variables to be
+    // defined at the very begining of the entry block.
+    blocks.front()->prependInstructions(std::move(variables));
   }
 
   // Collect basic blocks in a human-readable order that satisfies SPIR-V
   // validation rules.
   std::vector<BasicBlock *> orderedBlocks;
   if (!blocks.empty()) {
-    BlockReadableOrderVisitor([&orderedBlocks](BasicBlock *block) {
-      orderedBlocks.push_back(block);
-    }).visit(blocks.front().get());
+    BlockReadableOrderVisitor().visit(
+        blocks.front().get(),
+        [&orderedBlocks](BasicBlock *block) { orderedBlocks.push_back(block); });
   }
 
   // Write out all basic blocks.
@@ -160,7 +195,7 @@ void Function::take(InstBuilder *builder) {
 
 void Function::addVariable(uint32_t varType, uint32_t varId,
                            llvm::Optional<uint32_t> init) {
-  variables.emplace_back(
+  variables.append(
       InstBuilder(nullptr)
           .opVariable(varType, varId, spv::StorageClass::Function, init)
           .take());
@@ -168,9 +203,9 @@ void Function::addVariable(uint32_t varType, uint32_t varId,
 
 void Function::getReachableBasicBlocks(std::vector<BasicBlock *> *bbVec) const {
   if (!blocks.empty()) {
-    BlockReadableOrderVisitor([&bbVec](BasicBlock *block) {
-      bbVec->push_back(block);
-    }).visit(blocks.front().get());
+    BlockReadableOrderVisitor().visit(
+        blocks.front().get(),
+        [&bbVec](BasicBlock *block) { bbVec->push_back(block); });
   }
 }
 
@@ -228,9 +263,9 @@ bool SPIRVModule::isEmpty() const {
   return header.bound == 0 && capabilities.empty() && extensions.empty() &&
          extInstSets.empty() && !addressingModel.hasValue() &&
          !memoryModel.hasValue() && entryPoints.empty() &&
-         executionModes.empty() && debugNames.empty() && decorations.empty() &&
-         types.empty() && constants.empty() && variables.empty() &&
-         functions.empty();
+         executionModes.isEmpty() && debugNames.empty() &&
+         decorations.empty() && decorationGroups.empty() && types.empty() &&
+         constants.empty() && variables.isEmpty() && functions.empty();
 }
 
 void SPIRVModule::clear() {
@@ -245,6 +280,7 @@ void SPIRVModule::clear() {
   executionModes.clear();
   debugNames.clear();
   decorations.clear();
+  decorationGroups.clear();
   types.clear();
   constants.clear();
   variables.clear();
@@ -282,9 +318,8 @@ void SPIRVModule::take(InstBuilder *builder) {
         .x();
   }
 
-  for (auto &inst : executionModes) {
-    consumer(inst.take());
-  }
+  if (!executionModes.isEmpty())
+    consumer(executionModes.take());
 
   // BasicBlock debug names should be emitted only for blocks that are
   // reachable.
@@ -311,6 +346,15 @@ void SPIRVModule::take(InstBuilder *builder) {
     consumer(idDecorPair.second->withTargetId(idDecorPair.first));
   }
 
+  // A group must be decorated before it is declared, and declared before it
+  // is applied.
+  for (const auto &group : decorationGroups) {
+    for (const Decoration *d : group.decorations)
+      consumer(d->withTargetId(group.groupId));
+    builder->opDecorationGroup(group.groupId).x();
+    builder->opGroupDecorate(group.groupId, group.targets).x();
+  }
+
   // Note on interdependence of types and constants:
   // There is only one type (OpTypeArray) that requires the result-id of a
   // constant. As a result, the constant integer should be defined before the
@@ -334,9 +378,8 @@ void SPIRVModule::take(InstBuilder *builder) {
     consumer(c.first->withResultId(c.second));
   }
 
-  for (auto &v : variables) {
-    consumer(v.take());
-  }
+  if (!variables.isEmpty())
+    consumer(variables.take());
 
   for (uint32_t i = 0; i < functions.size(); ++i) {
     functions[i]->take(builder);
@@ -345,6 +388,41 @@ void SPIRVModule::take(InstBuilder *builder) {
   clear();
 }
 
+void SPIRVModule::groupDecorations(llvm::function_ref<uint32_t()> takeNextId) {
+  // The targets of each decoration, in the order they were decorated.
+  llvm::MapVector<const Decoration *, std::vector<uint32_t>> targets;
+  for (const auto &idDecorPair : decorations)
+    if (!idDecorPair.second->getMemberIndex().hasValue())
+      targets[idDecorPair.second].push_back(idDecorPair.first);
+
+  const size_t firstNewGroup = decorationGroups.size();
+  std::map<std::vector<uint32_t>, size_t> groupForTargets;
+  llvm::SmallPtrSet<const Decoration *, 8> grouped;
+  for (auto &entry : targets) {
+    if (entry.second.size() < kMinDecorationGroupTargets)
+      continue;
+    auto inserted =
+        groupForTargets.insert({entry.second, decorationGroups.size()});
+    if (inserted.second) {
+      decorationGroups.emplace_back();
+      decorationGroups.back().groupId = takeNextId();
+      decorationGroups.back().targets = std::move(entry.second);
+    }
+    decorationGroups[inserted.first->second].decorations.push_back(
+        entry.first);
+    grouped.insert(entry.first);
+  }
+
+  if (decorationGroups.size() == firstNewGroup)
+    return;
+  // All the targets of a grouped decoration get it through the group.
+  decorations.remove_if(
+      [&grouped](const std::pair<uint32_t, const Decoration *> &item) {
+        return !item.second->getMemberIndex().hasValue() &&
+               grouped.count(item.second);
+      });
+}
+
 void SPIRVModule::takeIntegerTypes(InstBuilder *ib) {
   const auto &consumer = ib->getConsumer();
   // If it finds any integer type, feeds it into the consumer, and removes it
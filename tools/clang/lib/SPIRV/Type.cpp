@@ -15,7 +15,7 @@ namespace clang {
 namespace spirv {
 
 Type::Type(spv::Op op, std::vector<uint32_t> arg, DecorationSet decs)
-    : opcode(op), args(std::move(arg)) {
+    : opcode(op), args(std::move(arg)), assignedId(0) {
   decorations = llvm::SetVector<const Decoration *>(decs.begin(), decs.end());
 }
 
@@ -116,9 +116,19 @@ uint32_t TypeTranslator::translateType(QualType type, LayoutRule rule,
 
   // Try to translate the canonical type first
   const auto canonicalType = type.getCanonicalType();
-  if (canonicalType != type)
-    return translateType(canonicalType, rule, isRowMajor);
+  const TypeKey key = getTypeKey(canonicalType, rule, isRowMajor);
+  const auto found = translatedTypes.find(key);
+  if (found != translatedTypes.end())
+    return found->second;
 
+  const uint32_t id = translateCanonicalType(canonicalType, rule, isRowMajor);
+  if (id != 0)
+    translatedTypes[key] = id;
+  return id;
+}
+
+uint32_t TypeTranslator::translateCanonicalType(QualType type, LayoutRule rule,
+                                                bool isRowMajor) {
   // Primitive types
   {
     QualType ty = {};
@@ -795,9 +805,29 @@ TypeTranslator::getAlignmentAndSize(QualType type, LayoutRule rule,
   // 10. If the member is an array of S structures, the S elements of the array
   //     are laid out in order, according to rule (9).
   const auto canonicalType = type.getCanonicalType();
-  if (canonicalType != type)
-    return getAlignmentAndSize(canonicalType, rule, isRowMajor, stride);
+  const TypeKey key = getTypeKey(canonicalType, rule, isRowMajor);
+  auto found = typeLayouts.find(key);
+  if (found == typeLayouts.end()) {
+    // Compute with a marker in place of the stride to learn whether the
+    // computation writes it.
+    const uint32_t kNoStride = ~0u;
+    TypeLayout layout = {0, 0, kNoStride, false};
+    std::tie(layout.alignment, layout.size) = computeAlignmentAndSize(
+        canonicalType, rule, isRowMajor, &layout.stride);
+    layout.hasStride = layout.stride != kNoStride;
+    found = typeLayouts.insert({key, layout}).first;
+  }
 
+  const TypeLayout &layout = found->second;
+  if (layout.hasStride)
+    *stride = layout.stride;
+  return {layout.alignment, layout.size};
+}
+
+std::pair<uint32_t, uint32_t>
+TypeTranslator::computeAlignmentAndSize(QualType type, LayoutRule rule,
+                                        const bool isRowMajor,
+                                        uint32_t *stride) {
   if (const auto *typedefType = type->getAs<TypedefType>())
     return getAlignmentAndSize(typedefType->desugar(), rule, isRowMajor,
                                stride);
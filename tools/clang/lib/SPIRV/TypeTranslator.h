@@ -15,6 +15,7 @@
 #include "clang/AST/Type.h"
 #include "clang/Basic/Diagnostic.h"
 #include "clang/SPIRV/ModuleBuilder.h"
+#include "llvm/ADT/DenseMap.h"
 
 #include "SpirvEvalInfo.h"
 
@@ -178,6 +179,18 @@ private:
     return diags.Report(diagId);
   }
 
+  /// \brief Translates the given canonical type. translateType() caches the
+  /// results.
+  uint32_t translateCanonicalType(QualType type, LayoutRule rule,
+                                  bool isRowMajor);
+
+  /// \brief Computes getAlignmentAndSize() for the given canonical type.
+  /// Writes *stride only for array and matrix types, or types containing them.
+  std::pair<uint32_t, uint32_t> computeAlignmentAndSize(QualType type,
+                                                        LayoutRule rule,
+                                                        bool isRowMajor,
+                                                        uint32_t *stride);
+
   /// \brief Translates the given HLSL resource type into its SPIR-V
   /// instructions and returns the <result-id>. Returns 0 on failure.
   uint32_t translateResourceType(QualType type, LayoutRule rule);
@@ -207,9 +220,32 @@ public:
                                                     uint32_t *stride);
 
 private:
+  /// A canonical type with the layout rule and majorness it is translated or
+  /// laid out with.
+  using TypeKey = std::pair<void *, unsigned>;
+  static TypeKey getTypeKey(QualType type, LayoutRule rule, bool isRowMajor) {
+    return {type.getAsOpaquePtr(),
+            (static_cast<unsigned>(rule) << 1) | (isRowMajor ? 1u : 0u)};
+  }
+
+  /// The layout of a type as returned by getAlignmentAndSize().
+  struct TypeLayout {
+    uint32_t alignment;
+    uint32_t size;
+    uint32_t stride;
+    bool hasStride; ///< Whether the computation wrote the stride
+  };
+
   ASTContext &astContext;
   ModuleBuilder &theBuilder;
   DiagnosticsEngine &diags;
+
+  /// The <result-id>s of the types translated so far. Struct types with a
+  /// layout rule are costly to rebuild, since that recomputes the offsets
+  /// of all their members; failed translations are not cached.
+  llvm::DenseMap<TypeKey, uint32_t> translatedTypes;
+  /// The layouts of the types laid out so far.
+  llvm::DenseMap<TypeKey, TypeLayout> typeLayouts;
 };
 
 } // end namespace spirv
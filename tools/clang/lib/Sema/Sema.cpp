@@ -683,6 +683,9 @@ void Sema::ActOnEndOfTranslationUnit() {
       PendingInstantiations.insert(PendingInstantiations.begin(),
                                    Pending.begin(), Pending.end());
     }
+    // HLSL Change Begin - parse the stored function bodies that are used.
+    ParseUsedHLSLFunctionBodies();
+    // HLSL Change End
     PerformPendingInstantiations();
 
     if (LateTemplateParserCleanup)
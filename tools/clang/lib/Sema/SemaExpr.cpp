@@ -12509,6 +12509,11 @@ void Sema::MarkFunctionReferenced(SourceLocation Loc, FunctionDecl *Func,
 
   if (!OdrUse) return;
 
+  // HLSL Change Begin - a stored body is parsed once its function is used.
+  if (getLangOpts().HLSLLazyFunctionBodies)
+    HLSLUsedFunctions.insert(Func->getCanonicalDecl());
+  // HLSL Change End
+
   // Implicit instantiation of function templates and member functions of
   // class templates.
   if (Func->isImplicitlyInstantiable()) {
@@ -12,6 +12,11 @@
 
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/Allocator.h"
+#include "clang/AST/ASTConsumer.h"
 #include "clang/AST/ASTContext.h"
 #include "clang/AST/Attr.h"
 #include "clang/AST/DeclCXX.h"
@@ -1661,8 +1666,17 @@ public:
     : m_argLength(argCount), m_intrinsicSource(intrinsicSource), m_functionDecl(nullptr)
   {
     std::copy(args, args + argCount, m_args);
+
+    // Hash what compare looks at: the intrinsic and the argument type pointers.
+    llvm::hash_code hash = llvm::hash_value(intrinsicSource);
+    for (size_t i = 0; i < argCount; i++) {
+      hash = llvm::hash_combine(hash, args[i].getTypePtr());
+    }
+    m_hash = hash;
   }
 
+  unsigned getHash() const { return m_hash; }
+
   void setFunctionDecl(FunctionDecl* value) const
   {
     DXASSERT(value != nullptr, "no reason to clear this out");
@@ -1685,6 +1699,7 @@ private:
   QualType m_args[g_MaxIntrinsicParamCount];
   size_t m_argLength;
   const HLSL_INTRINSIC* m_intrinsicSource;
+  unsigned m_hash;
   mutable FunctionDecl* m_functionDecl;
 };
 
@@ -1865,8 +1880,56 @@ static bool CombineBasicTypes(
   return true;
 }
 
-class UsedIntrinsicStore : public std::set<UsedIntrinsic>
+/// <summary>
+/// Use this class to find the overload declared for an intrinsic and its
+/// argument types. Entries are hashed once, when created, and allocated from
+/// an arena that lives as long as the store.
+/// </summary>
+class UsedIntrinsicStore
 {
+private:
+  struct EntryInfo {
+    static UsedIntrinsic *getEmptyKey() {
+      return llvm::DenseMapInfo<UsedIntrinsic *>::getEmptyKey();
+    }
+    static UsedIntrinsic *getTombstoneKey() {
+      return llvm::DenseMapInfo<UsedIntrinsic *>::getTombstoneKey();
+    }
+    static bool isSentinel(const UsedIntrinsic *value) {
+      return value == getEmptyKey() || value == getTombstoneKey();
+    }
+    static unsigned getHashValue(const UsedIntrinsic *value) {
+      return value->getHash();
+    }
+    static unsigned getHashValue(const UsedIntrinsic &value) {
+      return value.getHash();
+    }
+    static bool isEqual(const UsedIntrinsic *LHS, const UsedIntrinsic *RHS) {
+      if (LHS == RHS) return true;
+      if (isSentinel(LHS) || isSentinel(RHS)) return false;
+      return *LHS == *RHS;
+    }
+    static bool isEqual(const UsedIntrinsic &LHS, const UsedIntrinsic *RHS) {
+      return !isSentinel(RHS) && LHS == *RHS;
+    }
+  };
+
+  llvm::BumpPtrAllocator m_allocator;
+  llvm::DenseSet<UsedIntrinsic *, EntryInfo> m_entries;
+
+public:
+  /// <summary>Finds the entry equal to value, adding a copy of it if there is none.</summary>
+  /// <returns>The entry, and whether it was added.</returns>
+  std::pair<UsedIntrinsic *, bool> insert(const UsedIntrinsic &value)
+  {
+    auto found = m_entries.find_as(value);
+    if (found != m_entries.end()) {
+      return std::make_pair(*found, false);
+    }
+    UsedIntrinsic *entry = new (m_allocator.Allocate<UsedIntrinsic>()) UsedIntrinsic(value);
+    m_entries.insert(entry);
+    return std::make_pair(entry, true);
+  }
 };
 
 static
@@ -2426,6 +2489,13 @@ private:
   // Intrinsic tables available externally.
   llvm::SmallVector<CComPtr<IDxcIntrinsicTable>, 2> m_intrinsicTables;
 
+  // Built-in intrinsic tables indexed by name. Overloads with the same name
+  // and argument count are adjacent in a table; each name maps to the start
+  // of its run of overloads for each argument count.
+  typedef llvm::StringMap<llvm::SmallVector<unsigned, 2> > IntrinsicNameIndex;
+  llvm::DenseMap<const HLSL_INTRINSIC *, std::unique_ptr<IntrinsicNameIndex> >
+      m_intrinsicNameIndexes;
+
   // Scalar types indexed by HLSLScalarType.
   QualType m_scalarTypes[HLSLScalarTypeCount];
 
@@ -2445,16 +2515,35 @@ private:
   // BuiltinType for each scalar type.
   QualType m_baseTypes[HLSLScalarTypeCount];
 
-  // Built-in object types declarations, indexed by basic kind constant.
+  // Built-in object types declarations, indexed by basic kind constant; each
+  // is declared the first time it is looked up or needed.
   CXXRecordDecl* m_objectTypeDecls[_countof(g_ArBasicKindsAsTypes)];
+  // Map from object type name to the object index.
+  llvm::StringMap<unsigned> m_objectTypeNames;
   // Map from object decl to the object index.
-  using ObjectTypeDeclMapType = std::array<std::pair<CXXRecordDecl*,unsigned>, _countof(g_ArBasicKindsAsTypes)+_countof(g_DeprecatedEffectObjectNames)>;
-  ObjectTypeDeclMapType m_objectTypeDeclsMap;
+  llvm::DenseMap<const CXXRecordDecl*, unsigned> m_objectTypeDeclsMap;
   // Mask for object which not has methods created.
   uint64_t m_objectTypeLazyInitMask;
 
   UsedIntrinsicStore m_usedIntrinsics;
 
+  // Conversion between the structural forms of two types, as found by
+  // GetStructuralConversion.
+  struct StructuralConversion {
+    bool Allowed;
+    TYPE_CONVERSION_REMARKS Remarks;
+    ImplicitConversionKind Second;
+    ImplicitConversionKind ComponentConversion;
+    ArTypeObjectKind TargetShapeKind;
+    bool Cacheable; // False if finding it may have reported diagnostics.
+  };
+  // Conversions keyed by source and target structural forms and whether the
+  // conversion is explicit.
+  typedef std::pair<std::pair<void *, void *>, unsigned> ConversionKey;
+  llvm::DenseMap<ConversionKey, StructuralConversion> m_structuralConversions;
+  // Results of ScoreCast keyed by the canonical left and right types.
+  llvm::DenseMap<std::pair<void *, void *>, UINT64> m_castScores;
+
   /// <summary>Add all base QualTypes for each hlsl scalar types.</summary>
   void AddBaseTypes();
 
@@ -2818,31 +2907,61 @@ private:
     }
   }
 
-  static bool ObjectTypeDeclMapTypeCmp(const std::pair<CXXRecordDecl*,unsigned> &a,
-                           const std::pair<CXXRecordDecl*,unsigned> &b) {
-    return a.first < b.first;
-  };
-
   int FindObjectBasicKindIndex(const CXXRecordDecl* recordDecl) {
-    auto begin = m_objectTypeDeclsMap.begin();
-    auto end = m_objectTypeDeclsMap.end();
-    auto val = std::make_pair(const_cast<CXXRecordDecl*>(recordDecl), 0);
-    auto low = std::lower_bound(begin, end, val, ObjectTypeDeclMapTypeCmp);
-    if (low == end)
+    auto found = m_objectTypeDeclsMap.find(recordDecl);
+    if (found == m_objectTypeDeclsMap.end())
       return -1;
-    if (recordDecl == low->first)
-      return low->second;
+    return found->second;
+  }
+
+  /// <summary>Gets the declaration of a built-in object type, declaring it on first use.</summary>
+  CXXRecordDecl* GetObjectTypeDecl(unsigned i)
+  {
+    DXASSERT_NOMSG(i < _countof(g_ArBasicKindsAsTypes));
+    if (m_objectTypeDecls[i] != nullptr)
+      return m_objectTypeDecls[i];
+
+    ArBasicKind kind = g_ArBasicKindsAsTypes[i];
+    DXASSERT(kind != AR_OBJECT_WAVE, "wave objects are currently unused");
+    DXASSERT(kind < _countof(g_ArBasicTypeNames), "g_ArBasicTypeNames has the wrong number of entries");
+    _Analysis_assume_(kind < _countof(g_ArBasicTypeNames));
+    const char* typeName = g_ArBasicTypeNames[kind];
+    uint8_t templateArgCount = g_ArBasicKindsTemplateCount[i];
+    CXXRecordDecl* recordDecl = nullptr;
+    if (templateArgCount == 0)
+    {
+      AddRecordTypeWithHandle(*m_context, &recordDecl, typeName);
+      DXASSERT(recordDecl != nullptr, "AddRecordTypeWithHandle failed to return the object declaration");
+      recordDecl->setImplicit(true);
+    }
     else
-      return -1;
+    {
+      DXASSERT(templateArgCount == 1 || templateArgCount == 2, "otherwise a new case has been added");
+
+      ClassTemplateDecl* typeDecl = nullptr;
+      TypeSourceInfo* typeDefault = nullptr;
+      if (TemplateHasDefaultType(kind)) {
+        QualType float4Type = LookupVectorType(HLSLScalarType_float, 4);
+        typeDefault = m_context->getTrivialTypeSourceInfo(float4Type, NoLoc);
+      }
+      AddTemplateTypeWithHandle(*m_context, &typeDecl, &recordDecl, typeName, templateArgCount, typeDefault);
+      DXASSERT(typeDecl != nullptr, "AddTemplateTypeWithHandle failed to return the object declaration");
+      typeDecl->setImplicit(true);
+      recordDecl->setImplicit(true);
+    }
+    m_objectTypeDecls[i] = recordDecl;
+    m_objectTypeDeclsMap[recordDecl] = i;
+    m_objectTypeLazyInitMask |= ((uint64_t)1)<<i;
+    return recordDecl;
   }
 
-  // Adds all built-in HLSL object types.
+  // Adds the names of the built-in HLSL object types, which are declared as
+  // they are looked up; declaring all of them costs more than a small shader
+  // takes to compile.
   void AddObjectTypes()
   {
     DXASSERT(m_context != nullptr, "otherwise caller hasn't initialized context yet");
 
-    QualType float4Type = LookupVectorType(HLSLScalarType_float, 4);
-    TypeSourceInfo *float4TypeSourceInfo = m_context->getTrivialTypeSourceInfo(float4Type, NoLoc);
     m_objectTypeLazyInitMask = 0;
     unsigned effectKindIndex = 0;
     for (int i = 0; i < _countof(g_ArBasicKindsAsTypes); i++)
@@ -2856,29 +2975,7 @@ private:
 
       DXASSERT(kind < _countof(g_ArBasicTypeNames), "g_ArBasicTypeNames has the wrong number of entries");
       _Analysis_assume_(kind < _countof(g_ArBasicTypeNames));
-      const char* typeName = g_ArBasicTypeNames[kind];
-      uint8_t templateArgCount = g_ArBasicKindsTemplateCount[i];
-      CXXRecordDecl* recordDecl = nullptr;
-      if (templateArgCount == 0)
-      {
-        AddRecordTypeWithHandle(*m_context, &recordDecl, typeName);
-        DXASSERT(recordDecl != nullptr, "AddRecordTypeWithHandle failed to return the object declaration");
-        recordDecl->setImplicit(true);
-      }
-      else
-      {
-        DXASSERT(templateArgCount == 1 || templateArgCount == 2, "otherwise a new case has been added");
-
-        ClassTemplateDecl* typeDecl = nullptr;
-        TypeSourceInfo* typeDefault = TemplateHasDefaultType(kind) ? float4TypeSourceInfo : nullptr;
-        AddTemplateTypeWithHandle(*m_context, &typeDecl, &recordDecl, typeName, templateArgCount, typeDefault);
-        DXASSERT(typeDecl != nullptr, "AddTemplateTypeWithHandle failed to return the object declaration");
-        typeDecl->setImplicit(true);
-        recordDecl->setImplicit(true);
-      }
-      m_objectTypeDecls[i] = recordDecl;
-      m_objectTypeDeclsMap[i] = std::make_pair(recordDecl, i);
-      m_objectTypeLazyInitMask |= ((uint64_t)1)<<i;
+      m_objectTypeNames[g_ArBasicTypeNames[kind]] = i;
     }
 
     // Create an alias for SamplerState. 'sampler' is very commonly used.
@@ -2899,12 +2996,9 @@ private:
         CXXRecordDecl *effectObjDecl = CXXRecordDecl::Create(*m_context, TagTypeKind::TTK_Struct, currentDeclContext, NoLoc, NoLoc, &idInfo);
         currentDeclContext->addDecl(effectObjDecl);
         effectObjDecl->setImplicit(true);
-        m_objectTypeDeclsMap[i+effectObjBase] = std::make_pair(effectObjDecl, effectKindIndex);
+        m_objectTypeDeclsMap[effectObjDecl] = effectKindIndex;
       }
     }
-
-    // Make sure it's in order.
-    std::sort(m_objectTypeDeclsMap.begin(), m_objectTypeDeclsMap.end(), ObjectTypeDeclMapTypeCmp);
   }
 
   FunctionDecl* AddSubscriptSpecialization(
@@ -2963,6 +3057,7 @@ public:
     memset(m_scalarTypes, 0, sizeof(m_scalarTypes));
     memset(m_scalarTypeDefs, 0, sizeof(m_scalarTypeDefs));
     memset(m_baseTypes, 0, sizeof(m_baseTypes));
+    memset(m_objectTypeDecls, 0, sizeof(m_objectTypeDecls));
   }
 
   ~HLSLExternalSource() { }
@@ -2985,9 +3080,6 @@ public:
 
     AddObjectTypes();
     AddStdIsEqualImplementation(S.getASTContext(), S);
-    for (auto && intrinsic : m_intrinsicTables) {
-      AddIntrinsicTableMethods(intrinsic);
-    }
   }
 
   void ForgetSema() override
@@ -3101,6 +3193,17 @@ public:
       }
       return true;
     }
+
+    // Declare built-in objects as they are first named.
+    llvm::StringMap<unsigned>::const_iterator objectName = m_objectTypeNames.find(nameIdentifier);
+    if (objectName != m_objectTypeNames.end()) {
+      CXXRecordDecl *recordDecl = GetObjectTypeDecl(objectName->second);
+      if (ClassTemplateDecl *templateDecl = recordDecl->getDescribedClassTemplate())
+        R.addDecl(templateDecl);
+      else
+        R.addDecl(recordDecl);
+      return true;
+    }
     return false;
   }
 
@@ -3310,38 +3413,46 @@ public:
     return AR_BASIC_UNKNOWN;
   }
 
-  void AddIntrinsicTableMethods(_In_ IDxcIntrinsicTable *table) {
+  void AddIntrinsicTableMethods(_In_ IDxcIntrinsicTable *table, unsigned i) {
     DXASSERT_NOMSG(table != nullptr);
 
-    // Function intrinsics are added on-demand, objects get template methods.
-    for (int i = 0; i < _countof(g_ArBasicKindsAsTypes); i++) {
-      // Grab information already processed by AddObjectTypes.
-      ArBasicKind kind = g_ArBasicKindsAsTypes[i];
-      const char *typeName = g_ArBasicTypeNames[kind];
-      uint8_t templateArgCount = g_ArBasicKindsTemplateCount[i];
-      DXASSERT(0 <= templateArgCount && templateArgCount <= 2,
-        "otherwise a new case has been added");
-      int startDepth = (templateArgCount == 0) ? 0 : 1;
-      CXXRecordDecl *recordDecl = m_objectTypeDecls[i];
-      if (recordDecl == nullptr) {
-        DXASSERT(kind == AR_OBJECT_WAVE, "else objects other than reserved not initialized");
-        continue;
+    // Grab information already processed by GetObjectTypeDecl.
+    ArBasicKind kind = g_ArBasicKindsAsTypes[i];
+    const char *typeName = g_ArBasicTypeNames[kind];
+    uint8_t templateArgCount = g_ArBasicKindsTemplateCount[i];
+    DXASSERT(0 <= templateArgCount && templateArgCount <= 2,
+      "otherwise a new case has been added");
+    int startDepth = (templateArgCount == 0) ? 0 : 1;
+    CXXRecordDecl *recordDecl = m_objectTypeDecls[i];
+    DXASSERT_NOMSG(recordDecl != nullptr);
+
+    // This is a variation of AddObjectMethods using the new table.
+    const HLSL_INTRINSIC *pIntrinsic = nullptr;
+    const HLSL_INTRINSIC *pPrior = nullptr;
+    UINT64 lookupCookie = 0;
+    CA2W wideTypeName(typeName);
+    HRESULT found = table->LookupIntrinsic(wideTypeName, L"*", &pIntrinsic, &lookupCookie);
+    while (pIntrinsic != nullptr && SUCCEEDED(found)) {
+      if (!AreIntrinsicTemplatesEquivalent(pIntrinsic, pPrior)) {
+        AddObjectIntrinsicTemplate(recordDecl, startDepth, pIntrinsic);
+        // NOTE: this only works with the current implementation because
+        // intrinsics are alive as long as the table is alive.
+        pPrior = pIntrinsic;
       }
+      found = table->LookupIntrinsic(wideTypeName, L"*", &pIntrinsic, &lookupCookie);
+    }
+  }
 
-      // This is a variation of AddObjectMethods using the new table.
-      const HLSL_INTRINSIC *pIntrinsic = nullptr;
-      const HLSL_INTRINSIC *pPrior = nullptr;
-      UINT64 lookupCookie = 0;
-      CA2W wideTypeName(typeName);
-      HRESULT found = table->LookupIntrinsic(wideTypeName, L"*", &pIntrinsic, &lookupCookie);
-      while (pIntrinsic != nullptr && SUCCEEDED(found)) {
-        if (!AreIntrinsicTemplatesEquivalent(pIntrinsic, pPrior)) {
-          AddObjectIntrinsicTemplate(recordDecl, startDepth, pIntrinsic);
-          // NOTE: this only works with the current implementation because
-          // intrinsics are alive as long as the table is alive.
-          pPrior = pIntrinsic;
-        }
-        found = table->LookupIntrinsic(wideTypeName, L"*", &pIntrinsic, &lookupCookie);
+  void AddIntrinsicTableMethods(_In_ IDxcIntrinsicTable *table) {
+    DXASSERT_NOMSG(table != nullptr);
+
+    // Function intrinsics are added on-demand, objects get template methods
+    // along with their built-in methods; only add them here to objects that
+    // already have those.
+    for (int i = 0; i < _countof(g_ArBasicKindsAsTypes); i++) {
+      if (m_objectTypeDecls[i] != nullptr &&
+          (m_objectTypeLazyInitMask & (((uint64_t)1) << i)) == 0) {
+        AddIntrinsicTableMethods(table, i);
       }
     }
   }
@@ -3457,7 +3568,7 @@ public:
         const ArBasicKind* match = std::find(g_ArBasicKindsAsTypes, &g_ArBasicKindsAsTypes[_countof(g_ArBasicKindsAsTypes)], kind);
         DXASSERT(match != &g_ArBasicKindsAsTypes[_countof(g_ArBasicKindsAsTypes)], "otherwise can't find constant in basic kinds");
         size_t index = match - g_ArBasicKindsAsTypes;
-        return m_context->getTagDeclType(this->m_objectTypeDecls[index]);
+        return m_context->getTagDeclType(GetObjectTypeDecl(index));
     }
 
     case AR_OBJECT_SAMPLER1D:
@@ -3568,6 +3679,35 @@ public:
     _In_ const HLSL_INTRINSIC *pIntrinsic,
     _In_ QualType objectElement);
 
+  /// <summary>Gets the name index of a built-in intrinsic table, building it on first use.</summary>
+  const IntrinsicNameIndex &GetIntrinsicNameIndex(
+    _In_count_(tableSize) const HLSL_INTRINSIC* table,
+    size_t tableSize)
+  {
+    std::unique_ptr<IntrinsicNameIndex> &index = m_intrinsicNameIndexes[table];
+    if (index) {
+      return *index;
+    }
+
+    index.reset(new IntrinsicNameIndex());
+    for (unsigned int i = 0; i < tableSize; i++) {
+      const HLSL_INTRINSIC* pIntrinsic = &table[i];
+      llvm::SmallVector<unsigned, 2> &runs = (*index)[pIntrinsic->pArgs[0].pName];
+      // Only the first run for an argument count is found, as with a scan.
+      bool found = false;
+      for (unsigned run : runs) {
+        if (table[run].uNumArgs == pIntrinsic->uNumArgs) {
+          found = true;
+          break;
+        }
+      }
+      if (!found) {
+        runs.push_back(i);
+      }
+    }
+    return *index;
+  }
+
   IntrinsicDefIter FindIntrinsicByNameAndArgCount(
     _In_count_(tableSize) const HLSL_INTRINSIC* table,
     size_t tableSize,
@@ -3575,20 +3715,18 @@ public:
     StringRef nameIdentifier,
     size_t argumentCount)
   {
-    // TODO: avoid linear scan
-    for (unsigned int i = 0; i < tableSize; i++) {
-      const HLSL_INTRINSIC* pIntrinsic = &table[i];
+    const IntrinsicNameIndex &index = GetIntrinsicNameIndex(table, tableSize);
+    IntrinsicNameIndex::const_iterator runs = index.find(nameIdentifier);
+    if (runs != index.end()) {
+      for (unsigned run : runs->second) {
+        const HLSL_INTRINSIC* pIntrinsic = &table[run];
+        if (pIntrinsic->uNumArgs != 1 + argumentCount) {
+          continue;
+        }
 
-      // Do some quick checks to verify size and name.
-      if (pIntrinsic->uNumArgs != 1 + argumentCount) {
-        continue;
+        return IntrinsicDefIter::CreateStart(table, tableSize, pIntrinsic,
+          IntrinsicTableDefIter::CreateStart(m_intrinsicTables, typeName, nameIdentifier, argumentCount));
       }
-      if (!nameIdentifier.equals(StringRef(pIntrinsic->pArgs[0].pName))) {
-        continue;
-      }
-
-      return IntrinsicDefIter::CreateStart(table, tableSize, pIntrinsic,
-        IntrinsicTableDefIter::CreateStart(m_intrinsicTables, typeName, nameIdentifier, argumentCount));
     }
 
     return IntrinsicDefIter::CreateStart(table, tableSize, table + tableSize,
@@ -3636,7 +3774,7 @@ public:
 
       // Get or create the overload we're interested in.
       FunctionDecl* intrinsicFuncDecl = nullptr;
-      std::pair<UsedIntrinsicStore::iterator, bool> insertResult = m_usedIntrinsics.insert(UsedIntrinsic(
+      std::pair<UsedIntrinsic *, bool> insertResult = m_usedIntrinsics.insert(UsedIntrinsic(
         pIntrinsic, functionArgTypes, functionArgTypeCount));
       bool insertedNewValue = insertResult.second;
       if (insertedNewValue)
@@ -3795,6 +3933,9 @@ public:
     }
   }
 
+  bool GetStructuralConversion(SourceLocation loc, QualType source,
+    QualType target, bool explicitConversion,
+    _Out_ StructuralConversion* pConversion);
   /// <summary>Checks whether the source type can be converted to the target type.</summary>
   bool CanConvert(SourceLocation loc, Expr* sourceExpr, QualType target, bool explicitConversion,
     _Out_opt_ TYPE_CONVERSION_REMARKS* remarks,
@@ -3877,6 +4018,76 @@ public:
     return false;
   }
 
+  /// <summary>Gets the integer value of a vector or matrix dimension spelled as a literal; zero otherwise.</summary>
+  static unsigned GetDimensionLiteral(const TemplateArgument &arg) {
+    llvm::APSInt value;
+    if (arg.getKind() == TemplateArgument::ArgKind::Integral) {
+      value = arg.getAsIntegral();
+    } else if (arg.getKind() == TemplateArgument::ArgKind::Expression) {
+      const IntegerLiteral *literal = dyn_cast_or_null<IntegerLiteral>(arg.getAsExpr());
+      if (literal == nullptr)
+        return 0;
+      value = llvm::APSInt(literal->getValue());
+    } else {
+      return 0;
+    }
+    if (value.getActiveBits() > 3 || value.getZExtValue() < 1 || value.getZExtValue() > 4)
+      return 0;
+    return (unsigned)value.getZExtValue();
+  }
+
+  /// <summary>
+  /// Finds the canonical type of vector&lt;T, n&gt; or matrix&lt;T, r, c&gt; when T is a scalar
+  /// type and the dimensions are literals, from the types already built for the shorthand forms.
+  /// </summary>
+  QualType LookupVectorOrMatrixSpecialization(_In_ TemplateDecl *Template,
+                                              const TemplateArgumentListInfo &TemplateArgList) {
+    DXASSERT_NOMSG(Template != nullptr);
+    if (m_sema == nullptr)
+      return QualType();
+
+    bool isMatrix = Template->getCanonicalDecl() ==
+                    m_matrixTemplateDecl->getCanonicalDecl();
+    bool isVector = Template->getCanonicalDecl() ==
+                    m_vectorTemplateDecl->getCanonicalDecl();
+    if (!isMatrix && !isVector)
+      return QualType();
+    if (TemplateArgList.size() != (isMatrix ? 3 : 2))
+      return QualType();
+
+    // The element type must be accepted by IsValidTemplateArgumentType as is.
+    const TemplateArgument &typeArg = TemplateArgList[0].getArgument();
+    if (typeArg.getKind() != TemplateArgument::ArgKind::Type)
+      return QualType();
+    QualType elementType = typeArg.getAsType();
+    if (elementType.isNull() || elementType.hasQualifiers() ||
+        elementType->isDependentType())
+      return QualType();
+    CanQualType canonElementType = elementType->getCanonicalTypeUnqualified();
+    ArBasicKind basicKind = BasicTypeForScalarType(canonElementType);
+    if (basicKind == AR_BASIC_UNKNOWN)
+      return QualType();
+    HLSLScalarType scalarType = ScalarTypeForBasic(basicKind);
+    if (scalarType == HLSLScalarType_unknown ||
+        m_baseTypes[scalarType].isNull() ||
+        m_context->getCanonicalType(m_baseTypes[scalarType]) != canonElementType)
+      return QualType();
+
+    unsigned rowCount = 1;
+    if (isMatrix) {
+      rowCount = GetDimensionLiteral(TemplateArgList[1].getArgument());
+      if (rowCount == 0)
+        return QualType();
+    }
+    unsigned colCount = GetDimensionLiteral(TemplateArgList[isMatrix ? 2 : 1].getArgument());
+    if (colCount == 0)
+      return QualType();
+
+    QualType qt = isMatrix ? LookupMatrixType(scalarType, rowCount, colCount)
+                           : LookupVectorType(scalarType, colCount);
+    return m_context->getCanonicalType(qt);
+  }
+
   /// <summary>Performs HLSL-specific processing of template declarations.</summary>
   bool
   CheckTemplateArgumentListForHLSL(_In_ TemplateDecl *Template,
@@ -4127,6 +4338,9 @@ public:
       startDepth = 1;
     }
 
+    for (auto && table : m_intrinsicTables) {
+      AddIntrinsicTableMethods(table, idx);
+    }
     AddObjectMethods(kind, recordDecl, startDepth);
     // Clear the object.
     m_objectTypeLazyInitMask &= ~bit;
@@ -5916,6 +6130,15 @@ UINT64 HLSLExternalSource::ScoreCast(QualType pLType, QualType pRType)
     return 0;
   }
 
+  // The score depends only on the types, and the same pairs are scored for
+  // every candidate of every call.
+  std::pair<void *, void *> key(pLType.getCanonicalType().getAsOpaquePtr(),
+                                pRType.getCanonicalType().getAsOpaquePtr());
+  auto cached = m_castScores.find(key);
+  if (cached != m_castScores.end()) {
+    return cached->second;
+  }
+
   UINT64 uScore = 0;
   UINT uLSize = GetNumElements(pLType);
   UINT uRSize = GetNumElements(pRType);
@@ -6006,6 +6229,7 @@ UINT64 HLSLExternalSource::ScoreCast(QualType pLType, QualType pRType)
   // Make sure our scores fit in a UINT64.
   C_ASSERT(SCORE_MIN_SHIFT + SCORE_PARAM_SHIFT * 8 <= 64);
 
+  m_castScores[key] = uScore;
   return uScore;
 }
 
@@ -7066,63 +7290,35 @@ bool HandleVoidConversion(QualType source, QualType target, bool explicitConvers
   return applicable;
 }
 
-_Use_decl_annotations_
-bool HLSLExternalSource::CanConvert(
+/// <summary>Finds the conversion between the structural forms of a source
+/// and a target type; returns false if there is none.</summary>
+bool HLSLExternalSource::GetStructuralConversion(
   SourceLocation loc,
-  Expr* sourceExpr,
+  QualType source,
   QualType target,
   bool explicitConversion,
-  _Out_opt_ TYPE_CONVERSION_REMARKS* remarks,
-  _Inout_opt_ StandardConversionSequence* standard)
+  _Out_ StructuralConversion* pConversion)
 {
-  DXASSERT_NOMSG(sourceExpr != nullptr);
-  DXASSERT_NOMSG(!target.isNull());
-
-  // Implements the semantics of ArType::CanConvertTo.
   TYPE_CONVERSION_FLAGS Flags = explicitConversion ? TYPE_CONVERSION_EXPLICIT : TYPE_CONVERSION_DEFAULT;
-  TYPE_CONVERSION_REMARKS Remarks = TYPE_CONVERSION_NONE;
-  QualType source = sourceExpr->getType();
-  // Cannot cast function type.
-  if (source->isFunctionType())
-    return false;
-  // Convert to an r-value to begin with.
-  bool needsLValueToRValue = sourceExpr->isLValue() &&
-    !target->isLValueReferenceType() && 
-    IsConversionToLessOrEqualElements(source, target, explicitConversion);
-
-  bool targetRef = target->isReferenceType();
-
-  // Initialize the output standard sequence if available.
-  if (standard != nullptr) {
-    // Set up a no-op conversion, other than lvalue to rvalue - HLSL does not support references.
-    standard->setAsIdentityConversion();
-    if (needsLValueToRValue) {
-      standard->First = ICK_Lvalue_To_Rvalue;
-    }
-
-    standard->setFromType(source);
-    standard->setAllToTypes(target);
-  }
-
-  source = GetStructuralForm(source);
-  target = GetStructuralForm(target);
-
-  // Temporary conversion kind tracking which will be used/fixed up at the end
-  ImplicitConversionKind Second = ICK_Identity;
-  ImplicitConversionKind ComponentConversion = ICK_Identity;
+  pConversion->Remarks = TYPE_CONVERSION_NONE;
+  pConversion->Second = ICK_Identity;
+  pConversion->ComponentConversion = ICK_Identity;
+  pConversion->TargetShapeKind = AR_TOBJ_INVALID;
+  pConversion->Cacheable = true;
 
   // Identical types require no conversion.
   if (source == target) {
-    Remarks = TYPE_CONVERSION_IDENTICAL;
-    goto lSuccess;
+    pConversion->Remarks = TYPE_CONVERSION_IDENTICAL;
+    return true;
   }
 
   // Trivial cases for void.
   bool allowed;
   if (HandleVoidConversion(source, target, explicitConversion, &allowed)) {
     if (allowed) {
-      Remarks = target->isVoidType() ? TYPE_CONVERSION_TO_VOID : Remarks;
-      goto lSuccess;
+      if (target->isVoidType())
+        pConversion->Remarks = TYPE_CONVERSION_TO_VOID;
+      return true;
     }
     else {
       return false;
@@ -7132,6 +7328,7 @@ bool HLSLExternalSource::CanConvert(
   ArTypeInfo TargetInfo, SourceInfo;
   CollectInfo(target, &TargetInfo);
   CollectInfo(source, &SourceInfo);
+  pConversion->TargetShapeKind = TargetInfo.ShapeKind;
 
   UINT uTSize = TargetInfo.uTotalElts;
   UINT uSSize = SourceInfo.uTotalElts;
@@ -7145,6 +7342,9 @@ bool HLSLExternalSource::CanConvert(
   // Structure cast.
   if (TargetInfo.ShapeKind == AR_TOBJ_COMPOUND || TargetInfo.ShapeKind == AR_TOBJ_ARRAY ||
       SourceInfo.ShapeKind == AR_TOBJ_COMPOUND || SourceInfo.ShapeKind == AR_TOBJ_ARRAY) {
+    // Comparing the elements may report unsupported types at loc, so the
+    // result is found again each time.
+    pConversion->Cacheable = false;
     if (!explicitConversion && TargetInfo.ShapeKind != SourceInfo.ShapeKind)
     {
       return false;
@@ -7165,17 +7365,17 @@ bool HLSLExternalSource::CanConvert(
       const CXXRecordDecl *sourceCXXRD = dyn_cast<CXXRecordDecl>(sourceRD);
       if (targetCXXRD && sourceCXXRD) {
         if (targetRD == sourceRD) {
-          Second = ICK_Flat_Conversion;
-          goto lSuccess;
+          pConversion->Second = ICK_Flat_Conversion;
+          return true;
         }
         if (sourceCXXRD->isDerivedFrom(targetCXXRD)) {
-          Second = ICK_HLSL_Derived_To_Base;
-          goto lSuccess;
+          pConversion->Second = ICK_HLSL_Derived_To_Base;
+          return true;
         }
       } else {
         if (targetRD == sourceRD) {
-          Second = ICK_Flat_Conversion;
-          goto lSuccess;
+          pConversion->Second = ICK_Flat_Conversion;
+          return true;
         }
       }
     }
@@ -7189,8 +7389,8 @@ bool HLSLExternalSource::CanConvert(
       case BuiltinType::Kind::LitFloat:
       case BuiltinType::Kind::LitInt:
         if (explicitConversion) {
-          Second = ICK_Flat_Conversion;
-          goto lSuccess;
+          pConversion->Second = ICK_Flat_Conversion;
+          return true;
         }
         break;
       }
@@ -7205,8 +7405,8 @@ bool HLSLExternalSource::CanConvert(
       case BuiltinType::Kind::LitFloat:
       case BuiltinType::Kind::LitInt:
         if (explicitConversion) {
-          Second = ICK_Flat_Conversion;
-          goto lSuccess;
+          pConversion->Second = ICK_Flat_Conversion;
+          return true;
         }
         break;
       }
@@ -7233,8 +7433,8 @@ bool HLSLExternalSource::CanConvert(
     {
       return false;
     }
-    Second = ICK_Flat_Conversion;
-    goto lSuccess;
+    pConversion->Second = ICK_Flat_Conversion;
+    return true;
   }
 
   // Base type cast.
@@ -7260,21 +7460,21 @@ bool HLSLExternalSource::CanConvert(
     switch (SourceInfo.ShapeKind)
     {
     case AR_TOBJ_BASIC:
-      Second = ICK_Identity;
+      pConversion->Second = ICK_Identity;
       break;
 
     case AR_TOBJ_VECTOR:
       if(1 < SourceInfo.uCols)
-        Second = ICK_HLSLVector_Truncation;
+        pConversion->Second = ICK_HLSLVector_Truncation;
       else
-        Second = ICK_HLSLVector_Scalar;
+        pConversion->Second = ICK_HLSLVector_Scalar;
       break;
 
     case AR_TOBJ_MATRIX:
       if(1 < SourceInfo.uRows * SourceInfo.uCols)
-        Second = ICK_HLSLVector_Truncation;
+        pConversion->Second = ICK_HLSLVector_Truncation;
       else
-        Second = ICK_HLSLVector_Scalar;
+        pConversion->Second = ICK_HLSLVector_Scalar;
       break;
     
     case AR_TOBJ_OBJECT:
@@ -7291,20 +7491,20 @@ bool HLSLExternalSource::CanConvert(
     {
     case AR_TOBJ_BASIC:
       // Conversions between scalars and aggregates are always supported.
-      Second = ICK_HLSLVector_Splat;
+      pConversion->Second = ICK_HLSLVector_Splat;
       break;
 
     case AR_TOBJ_VECTOR:
       if (TargetInfo.uCols > SourceInfo.uCols) {
         if (SourceInfo.uCols == 1) {
-          Second = ICK_HLSLVector_Splat;
+          pConversion->Second = ICK_HLSLVector_Splat;
         } else {
           return false;
       }
       } else if (TargetInfo.uCols < SourceInfo.uCols) {
-        Second = ICK_HLSLVector_Truncation;
+        pConversion->Second = ICK_HLSLVector_Truncation;
       } else {
-        Second = ICK_Identity;
+        pConversion->Second = ICK_Identity;
       }
       break;
 
@@ -7312,21 +7512,21 @@ bool HLSLExternalSource::CanConvert(
       UINT SourceComponents = SourceInfo.uRows * SourceInfo.uCols;
       if (1 == SourceComponents && TargetInfo.uCols != 1) {
         // splat: matrix<[..], 1, 1> -> vector<[..], O>
-        Second = ICK_HLSLVector_Splat;
+        pConversion->Second = ICK_HLSLVector_Splat;
       } else if (1 == SourceInfo.uRows || 1 == SourceInfo.uCols) {
         // cases for: matrix<[..], M, N> -> vector<[..], O>, where N == 1 or M == 1
         if (TargetInfo.uCols > SourceComponents)          // illegal: O > N*M
         return false;
         else if (TargetInfo.uCols < SourceComponents)     // truncation: O < N*M
-          Second = ICK_HLSLVector_Truncation;
+          pConversion->Second = ICK_HLSLVector_Truncation;
         else                                              // equalivalent: O == N*M
-          Second = ICK_HLSLVector_Conversion;
+          pConversion->Second = ICK_HLSLVector_Conversion;
       } else if (TargetInfo.uCols != SourceComponents) {
         // illegal: matrix<[..], M, N> -> vector<[..], O> where N != 1 and M != 1 and O != N*M
         return false;
       } else {
         // legal: matrix<[..], M, N> -> vector<[..], O> where N != 1 and M != 1 and O == N*M
-        Second = ICK_HLSLVector_Conversion;
+        pConversion->Second = ICK_HLSLVector_Conversion;
       }
       break;
     }
@@ -7346,27 +7546,27 @@ bool HLSLExternalSource::CanConvert(
     {
     case AR_TOBJ_BASIC:
       // Conversions between scalars and aggregates are always supported.
-      Second = ICK_HLSLVector_Splat;
+      pConversion->Second = ICK_HLSLVector_Splat;
       break;
 
     case AR_TOBJ_VECTOR: {
       if (1 == SourceInfo.uCols && TargetComponents != 1) {
         // splat: vector<[..], 1> -> matrix<[..], M, N>
-        Second = ICK_HLSLVector_Splat;
+        pConversion->Second = ICK_HLSLVector_Splat;
       } else if (1 == TargetInfo.uRows || 1 == TargetInfo.uCols) {
         // cases for: vector<[..], O> -> matrix<[..], N, M>, where N == 1 or M == 1
         if (TargetComponents > SourceInfo.uCols)          // illegal: N*M > O
         return false;
         else if (TargetComponents < SourceInfo.uCols)     // truncation: N*M < O
-          Second = ICK_HLSLVector_Truncation;
+          pConversion->Second = ICK_HLSLVector_Truncation;
         else                                              // equalivalent: N*M == O
-          Second = ICK_HLSLVector_Conversion;
+          pConversion->Second = ICK_HLSLVector_Conversion;
       } else if (TargetComponents != SourceInfo.uCols) {
         // illegal: vector<[..], O> -> matrix<[..], M, N> where N != 1 and M != 1 and O != N*M
         return false;
       } else {
         // legal: vector<[..], O> -> matrix<[..], M, N> where N != 1 and M != 1 and O == N*M
-        Second = ICK_HLSLVector_Conversion;
+        pConversion->Second = ICK_HLSLVector_Conversion;
       }
       break;
       }
@@ -7375,13 +7575,13 @@ bool HLSLExternalSource::CanConvert(
       UINT SourceComponents = SourceInfo.uRows * SourceInfo.uCols;
       if (1 == SourceComponents && TargetComponents != 1) {
         // splat: matrix<[..], 1, 1> -> matrix<[..], M, N>
-        Second = ICK_HLSLVector_Splat;
+        pConversion->Second = ICK_HLSLVector_Splat;
       } else if (TargetInfo.uRows > SourceInfo.uRows || TargetInfo.uCols > SourceInfo.uCols) {
         return false;
       } else if(TargetInfo.uRows < SourceInfo.uRows || TargetInfo.uCols < SourceInfo.uCols) {
-          Second = ICK_HLSLVector_Truncation;
+          pConversion->Second = ICK_HLSLVector_Truncation;
       } else {
-          Second = ICK_Identity;
+          pConversion->Second = ICK_Identity;
       }
       break;
       }
@@ -7415,12 +7615,12 @@ bool HLSLExternalSource::CanConvert(
       GET_BASIC_BITS(SourceInfo.EltKind))
     {
       precisionLoss = true;
-      Remarks |= TYPE_CONVERSION_PRECISION_LOSS;
+      pConversion->Remarks |= TYPE_CONVERSION_PRECISION_LOSS;
     }
 
     if (TargetInfo.uTotalElts < SourceInfo.uTotalElts)
     {
-      Remarks |= TYPE_CONVERSION_ELT_TRUNCATION;
+      pConversion->Remarks |= TYPE_CONVERSION_ELT_TRUNCATION;
     }
     // enum -> enum not allowed
     if ((SourceInfo.EltKind == AR_BASIC_ENUM &&
@@ -7434,11 +7634,11 @@ bool HLSLExternalSource::CanConvert(
       if (TargetInfo.EltKind == AR_BASIC_UNKNOWN ||
           SourceInfo.EltKind == AR_BASIC_UNKNOWN)
       {
-        Second = ICK_Flat_Conversion;
+        pConversion->Second = ICK_Flat_Conversion;
       }
       else if (IS_BASIC_BOOL(TargetInfo.EltKind))
       {
-        ComponentConversion = ICK_Boolean_Conversion;
+        pConversion->ComponentConversion = ICK_Boolean_Conversion;
       }
       else if (IS_BASIC_ENUM(TargetInfo.EltKind))
       {
@@ -7448,7 +7648,7 @@ bool HLSLExternalSource::CanConvert(
       else if (IS_BASIC_ENUM(SourceInfo.EltKind))
       {
         // enum -> int/float
-        ComponentConversion = ICK_Integral_Conversion;
+        pConversion->ComponentConversion = ICK_Integral_Conversion;
       }
       else
       {
@@ -7457,11 +7657,11 @@ bool HLSLExternalSource::CanConvert(
         {
           if (targetIsInt)
           {
-            ComponentConversion = precisionLoss ? ICK_Integral_Conversion : ICK_Integral_Promotion;
+            pConversion->ComponentConversion = precisionLoss ? ICK_Integral_Conversion : ICK_Integral_Promotion;
           }
           else
           {
-            ComponentConversion = ICK_Floating_Integral;
+            pConversion->ComponentConversion = ICK_Floating_Integral;
           }
         }
         else if (IS_BASIC_FLOAT(SourceInfo.EltKind))
@@ -7469,22 +7669,87 @@ bool HLSLExternalSource::CanConvert(
           DXASSERT(IS_BASIC_FLOAT(SourceInfo.EltKind), "otherwise should not be checking element types");
           if (targetIsInt)
           {
-            ComponentConversion = ICK_Floating_Integral;
+            pConversion->ComponentConversion = ICK_Floating_Integral;
           }
           else
           {
-            ComponentConversion = precisionLoss ? ICK_Floating_Conversion : ICK_Floating_Promotion;
+            pConversion->ComponentConversion = precisionLoss ? ICK_Floating_Conversion : ICK_Floating_Promotion;
           }
         } else if (IS_BASIC_BOOL(SourceInfo.EltKind)) {
           if (targetIsInt)
-            ComponentConversion = ICK_Integral_Conversion;
+            pConversion->ComponentConversion = ICK_Integral_Conversion;
           else
-            ComponentConversion = ICK_Floating_Integral;
+            pConversion->ComponentConversion = ICK_Floating_Integral;
         }
       }
     }
   }
 
+  return true;
+}
+
+_Use_decl_annotations_
+bool HLSLExternalSource::CanConvert(
+  SourceLocation loc,
+  Expr* sourceExpr,
+  QualType target,
+  bool explicitConversion,
+  _Out_opt_ TYPE_CONVERSION_REMARKS* remarks,
+  _Inout_opt_ StandardConversionSequence* standard)
+{
+  DXASSERT_NOMSG(sourceExpr != nullptr);
+  DXASSERT_NOMSG(!target.isNull());
+
+  // Implements the semantics of ArType::CanConvertTo.
+  QualType source = sourceExpr->getType();
+  // Cannot cast function type.
+  if (source->isFunctionType())
+    return false;
+  // Convert to an r-value to begin with.
+  bool needsLValueToRValue = sourceExpr->isLValue() &&
+    !target->isLValueReferenceType() && 
+    IsConversionToLessOrEqualElements(source, target, explicitConversion);
+
+  bool targetRef = target->isReferenceType();
+
+  // Initialize the output standard sequence if available.
+  if (standard != nullptr) {
+    // Set up a no-op conversion, other than lvalue to rvalue - HLSL does not support references.
+    standard->setAsIdentityConversion();
+    if (needsLValueToRValue) {
+      standard->First = ICK_Lvalue_To_Rvalue;
+    }
+
+    standard->setFromType(source);
+    standard->setAllToTypes(target);
+  }
+
+  source = GetStructuralForm(source);
+  target = GetStructuralForm(target);
+
+  // Overload resolution asks for the same pairs of types over and over, so
+  // conversions between structural forms are kept for the translation unit.
+  StructuralConversion conversion;
+  ConversionKey key(std::make_pair(source.getAsOpaquePtr(),
+                                   target.getAsOpaquePtr()),
+                    explicitConversion ? 1 : 0);
+  auto cached = m_structuralConversions.find(key);
+  if (cached != m_structuralConversions.end()) {
+    conversion = cached->second;
+  } else {
+    conversion.Allowed = GetStructuralConversion(loc, source, target,
+                                                 explicitConversion,
+                                                 &conversion);
+    if (conversion.Cacheable)
+      m_structuralConversions[key] = conversion;
+  }
+  if (!conversion.Allowed)
+    return false;
+
+  TYPE_CONVERSION_REMARKS Remarks = conversion.Remarks;
+  ImplicitConversionKind Second = conversion.Second;
+  ImplicitConversionKind ComponentConversion = conversion.ComponentConversion;
+
 lSuccess:
   if (standard)
   {
@@ -7523,7 +7788,7 @@ lSuccess:
     // identity vector/matrix component conversion
     if (ICK_Identity != ComponentConversion) {
       if (Second == ICK_Identity) {
-        if (TargetInfo.ShapeKind == AR_TOBJ_BASIC) {
+        if (conversion.TargetShapeKind == AR_TOBJ_BASIC) {
           // Scalar to scalar type conversion, use normal mechanism (Second)
           Second = ComponentConversion;
           ComponentConversion = ICK_Identity;
@@ -8649,6 +8914,19 @@ bool hlsl::CheckTemplateArgumentListForHLSL(Sema& self, TemplateDecl* Template,
   return hlsl->CheckTemplateArgumentListForHLSL(Template, TemplateLoc, TemplateArgList);
 }
 
+QualType hlsl::LookupVectorOrMatrixSpecialization(Sema& self, TemplateDecl* Template, const TemplateArgumentListInfo& TemplateArgList)
+{
+  DXASSERT_NOMSG(Template != nullptr);
+
+  ExternalSemaSource* externalSource = self.getExternalSource();
+  if (externalSource == nullptr) {
+    return QualType();
+  }
+
+  HLSLExternalSource* hlsl = reinterpret_cast<HLSLExternalSource*>(externalSource);
+  return hlsl->LookupVectorOrMatrixSpecialization(Template, TemplateArgList);
+}
+
 /// <summary>Deduces template arguments on a function call in an HLSL program.</summary>
 Sema::TemplateDeductionResult hlsl::DeduceTemplateArgumentsForHLSL(Sema* self,
   FunctionTemplateDecl *FunctionTemplate,
@@ -10383,6 +10661,34 @@ void Sema::ActOnStartHLSLBufferView() {
   HLSLBuffers.emplace_back(nullptr);
 }
 
+void Sema::ParseUsedHLSLFunctionBodies() {
+  if (LateParsedTemplateMap.empty() || !LateTemplateParser)
+    return;
+
+  // The patch constant function is named by an attribute rather than used,
+  // so parse every function that could be one, as DeclMustBeEmitted emits.
+  for (auto &LPT : LateParsedTemplateMap) {
+    if (Context.IsPatchConstantFunctionDecl(LPT.first))
+      HLSLUsedFunctions.insert(
+          const_cast<FunctionDecl *>(LPT.first->getCanonicalDecl()));
+  }
+
+  // Parsing a body adds the functions it uses to the end of the list.
+  for (unsigned i = 0; i < HLSLUsedFunctions.size(); ++i) {
+    for (FunctionDecl *FD : HLSLUsedFunctions[i]->redecls()) {
+      if (!FD->isLateTemplateParsed())
+        continue;
+      LateParsedTemplate *LPT = LateParsedTemplateMap.lookup(FD);
+      if (!LPT)
+        break;
+      LateTemplateParser(OpaqueParser, *LPT);
+      // Code generation skipped the function while it had no body.
+      Consumer.HandleTopLevelDecl(DeclGroupRef(FD));
+      break;
+    }
+  }
+}
+
 HLSLBufferDecl::HLSLBufferDecl(
     DeclContext *DC, bool cbuffer, bool cbufferView, SourceLocation KwLoc,
     IdentifierInfo *Id, SourceLocation IdLoc,
@@ -11413,6 +11719,35 @@ void hlsl::RegisterIntrinsicTable(_In_ clang::ExternalSemaSource* self, _In_ IDx
   source->RegisterIntrinsicTable(table);
 }
 
+llvm::ArrayRef<GlobalCompletionName> hlsl::GetGlobalCompletionNames()
+{
+  static const std::vector<GlobalCompletionName> names = []() {
+    std::vector<GlobalCompletionName> result;
+    for (const HLSL_INTRINSIC &intrinsic : g_Intrinsics)
+      result.push_back({ intrinsic.pArgs[0].pName, false });
+    for (ArBasicKind kind : g_ArBasicKindsAsTypes) {
+      // Skip the types that can't be named in source.
+      if (kind == AR_OBJECT_LEGACY_EFFECT || kind == AR_OBJECT_WAVE)
+        continue;
+      result.push_back({ g_ArBasicTypeNames[kind], true });
+    }
+    result.push_back({ "sampler", true });
+
+    std::sort(result.begin(), result.end(),
+      [](const GlobalCompletionName &left, const GlobalCompletionName &right) {
+        int order = StringRef(left.Name).compare_lower(right.Name);
+        return order != 0 ? order < 0 : strcmp(left.Name, right.Name) < 0;
+      });
+    // Overloads of an intrinsic each have an entry.
+    result.erase(std::unique(result.begin(), result.end(),
+      [](const GlobalCompletionName &left, const GlobalCompletionName &right) {
+        return strcmp(left.Name, right.Name) == 0;
+      }), result.end());
+    return result;
+  }();
+  return names;
+}
+
 clang::QualType hlsl::CheckVectorConditional(
   _In_ clang::Sema* self,
   _In_ clang::ExprResult &Cond,
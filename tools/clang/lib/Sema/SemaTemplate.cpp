@@ -2054,6 +2054,16 @@ QualType Sema::CheckTemplateIdType(TemplateName Name,
     return QualType();
   }
 
+  // HLSL Change Starts - reuse vector/matrix specializations without
+  // checking arguments that are known to be valid.
+  if (getLangOpts().HLSL) {
+    QualType CanonType =
+        hlsl::LookupVectorOrMatrixSpecialization(*this, Template, TemplateArgs);
+    if (!CanonType.isNull())
+      return Context.getTemplateSpecializationType(Name, TemplateArgs, CanonType);
+  }
+  // HLSL Change Ends
+
   // Check that the template argument list is well-formed for this
   // template.
   SmallVector<TemplateArgument, 4> Converted;
@@ -0,0 +1,34 @@
+// RUN: %dxc -E main -T cs_6_0 -aggregate-atomics %s | FileCheck %s
+
+// The add to a fixed offset is done once per wave, and each lane's original
+// value is rebuilt from the first lane's and a prefix sum.
+// CHECK: call i32 @dx.op.wavePrefixOp.i32(i32 121, i32 %{{.*}}, i8 0, i8 1)
+// CHECK: call i32 @dx.op.waveActiveOp.i32(i32 119, i32 %{{.*}}, i8 0, i8 1)
+// CHECK: call i1 @dx.op.waveIsFirstLane(i32 110)
+// CHECK: call i32 @dx.op.atomicBinOp.i32(i32 78,
+// CHECK: call i32 @dx.op.waveReadLaneFirst.i32(i32 118,
+
+// The or into one groupshared value has no result used, so it only needs the
+// reduction.
+// CHECK: call i32 @dx.op.waveActiveBit.i32(i32 120, i32 %{{.*}}, i8 1)
+// CHECK: call i1 @dx.op.waveIsFirstLane(i32 110)
+// CHECK: atomicrmw or
+
+// Each lane adds to its own bin, so that add is left alone.
+// CHECK-NOT: @dx.op.waveIsFirstLane
+// CHECK: atomicrmw add
+
+RWByteAddressBuffer counters;
+RWStructuredBuffer<uint> output;
+groupshared uint mask;
+groupshared uint bins[64];
+
+[numthreads(64, 1, 1)]
+void main(uint gi : SV_GroupIndex) {
+  uint offset;
+  counters.InterlockedAdd(0, gi & 3, offset);
+  InterlockedOr(mask, 1u << (gi & 31));
+  InterlockedAdd(bins[gi], 1);
+  GroupMemoryBarrierWithGroupSync();
+  output[gi] = offset + mask + bins[gi];
+}
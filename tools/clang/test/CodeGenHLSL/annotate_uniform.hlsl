@@ -0,0 +1,26 @@
+// RUN: %dxc -E main -T cs_6_0 -annotate-uniform %s | FileCheck %s
+
+// The branch on a cbuffer value goes the same way for the whole wave, and so
+// does the buffer load indexed by it. The branch on the thread index does not.
+// CHECK-DAG: br i1 %{{.*}}, label %{{.*}}, label %{{.*}}, !dx.uniform
+// CHECK-DAG: @dx.op.bufferLoad.f32({{.*}}), !dx.uniform
+// CHECK-DAG: [[C:%[0-9a-z.]+]] = icmp ugt i32 %{{.*}}, 3
+// CHECK-DAG: br i1 [[C]], label %{{[0-9a-z.]+}}, label %{{[0-9a-z.]+}}{{$}}
+
+cbuffer Params {
+  uint g_Count;
+  uint g_Index;
+};
+
+Buffer<float> g_In;
+RWBuffer<float> g_Out;
+
+[numthreads(64, 1, 1)]
+void main(uint gi : SV_GroupIndex) {
+  if (g_Count > 4) {
+    g_Out[0] = g_In[g_Index];
+  }
+  if (gi > 3) {
+    g_Out[gi] = 1.0;
+  }
+}
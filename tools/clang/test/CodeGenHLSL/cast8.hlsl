@@ -0,0 +1,32 @@
+// RUN: %dxc -E main -T ps_6_0 %s -fcgl | FileCheck %s
+
+// Make sure only the field that needs a conversion is flattened, and the
+// field with the same type on both sides is copied whole.
+// CHECK: sitofp
+// CHECK: @llvm.memcpy{{.*}}, i64 64,
+
+struct Inner {
+   float4 v[4];
+};
+
+struct A {
+   int i;
+   Inner s;
+};
+
+struct B {
+   float f;
+   Inner s;
+};
+
+float main(int i : I, float4 v : V) : SV_Target
+{
+  A a;
+  a.i = i;
+  a.s.v[0] = v;
+  a.s.v[1] = v * 2;
+  a.s.v[2] = v * 3;
+  a.s.v[3] = v * 4;
+  B b = (B)a;
+  return b.f + b.s.v[i].x;
+}
@@ -0,0 +1,21 @@
+// RUN: %dxc -E main -T ps_6_0 -Od %s | FileCheck %s
+
+// Fields that share a cbuffer row are read through a single row load, even
+// without the optimizer.
+// CHECK: call %dx.types.CBufRet.f32 @dx.op.cbufferLoadLegacy.f32(i32 59, %dx.types.Handle %{{.*}}, i32 0)
+// CHECK-NOT: @dx.op.cbufferLoadLegacy.f32(i32 59, %dx.types.Handle %{{.*}}, i32 0)
+// CHECK: @dx.op.cbufferLoadLegacy.f32(i32 59, %dx.types.Handle %{{.*}}, i32 1)
+// CHECK-NOT: @dx.op.cbufferLoadLegacy.f32(i32 59, %dx.types.Handle %{{.*}}, i32 0)
+// CHECK: ret void
+
+cbuffer Material {
+  float roughness;
+  float metallic;
+  float specular;
+  float occlusion;
+  float4 tint;
+};
+
+float4 main() : SV_Target {
+  return tint * (roughness + metallic * specular - occlusion);
+}
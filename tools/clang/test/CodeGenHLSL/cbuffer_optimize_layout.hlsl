@@ -0,0 +1,24 @@
+// RUN: %dxc -E main -T ps_6_0 -optimize-cbuffer-layout %s | FileCheck %s
+
+// In declaration order this takes five rows. Packed, it takes four: the
+// member with packoffset stays in the first row, the used members fill the
+// next two, and the unused one follows them.
+// CHECK: ;   struct Params
+// CHECK: float4 unused;{{.*}}; Offset:   48
+// CHECK: float x;{{.*}}; Offset:   32
+// CHECK: float4 v;{{.*}}; Offset:   16
+// CHECK: float y;{{.*}}; Offset:   36
+// CHECK: float4 pinned;{{.*}}; Offset:    0
+// CHECK: } Params{{.*}}; Offset:    0 Size:   64
+
+cbuffer Params {
+  float4 unused;
+  float x;
+  float4 v;
+  float y;
+  float4 pinned : packoffset(c0);
+};
+
+float4 main() : SV_Target {
+  return v * x + y + pinned;
+}
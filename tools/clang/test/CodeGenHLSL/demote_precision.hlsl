@@ -0,0 +1,36 @@
+// RUN: %dxc -E main -T ps_6_0 -demote-precision %s | FileCheck %s
+
+// The UNORM texel is scaled, biased and saturated into a min16float output,
+// and stays in half range throughout, so that math is done in half.
+// CHECK-DAG: fmul fast half %{{.*}}, 0xH4000
+// CHECK-DAG: call half @dx.op.unary.f16(i32 7, half
+
+// The cbuffer scale has no known range, so that product stays in float and
+// is truncated as before.
+// CHECK-DAG: [[L:%.*]] = fmul fast float %{{.*}}, %{{.*}}
+// CHECK-DAG: fptrunc float [[L]] to half
+
+// A float output keeps its math in float.
+// CHECK-DAG: fmul fast float %{{.*}}, 5.000000e-01
+
+Texture2D<unorm float4> g_Color;
+SamplerState g_Samp;
+
+cbuffer Params {
+  float g_Scale;
+};
+
+struct PSOut {
+  min16float4 Color : SV_Target0;
+  min16float Luma : SV_Target1;
+  float Raw : SV_Target2;
+};
+
+PSOut main(float2 uv : TEXCOORD) {
+  float4 c = g_Color.Sample(g_Samp, uv);
+  PSOut o;
+  o.Color = saturate(c * 2.0 - 0.5);
+  o.Luma = c.r * g_Scale;
+  o.Raw = c.g * 0.5;
+  return o;
+}
@@ -0,0 +1,29 @@
+// RUN: %dxc -E main -T cs_6_0 -optimize-groupshared-layout %s | FileCheck %s
+
+// tile is read down its columns, 32 words apart from one lane to the next, so
+// it gets one padding word after every row of 32.
+// CHECK: addrspace(3) global [1055 x float]
+
+// b is only used after the barrier that ends the use of tile, so it shares
+// the memory of tile.
+// CHECK: addrspace(3) global [64 x float]
+// CHECK-NOT: addrspace(3) global [64 x float]
+
+// CHECK: lshr i32 {{.*}}, 5
+
+groupshared float tile[32 * 32];
+groupshared float a[64];
+groupshared float b[64];
+RWStructuredBuffer<float> output;
+
+[numthreads(32, 2, 1)]
+void main(uint3 tid : SV_GroupThreadID, uint gi : SV_GroupIndex) {
+  tile[tid.y * 32 + tid.x] = gi;
+  a[gi] = gi * 2;
+  GroupMemoryBarrierWithGroupSync();
+  float v = tile[tid.x * 32 + tid.y] + a[gi ^ 1];
+  GroupMemoryBarrierWithGroupSync();
+  b[gi] = v;
+  GroupMemoryBarrierWithGroupSync();
+  output[gi] = b[63 - gi];
+}
@@ -0,0 +1,23 @@
+// RUN: %dxc -E main -T cs_6_0 -hoist-handles %s | FileCheck %s
+
+// The stores keep GVN from merging the handles created in the loop body, and
+// the index into g_Bufs is uniform, so every handle is created once, before
+// the loop.
+// CHECK: @dx.op.bufferLoad.f32
+// CHECK-NOT: @dx.op.createHandle
+// CHECK: ret void
+
+cbuffer Params {
+  uint g_Count;
+  uint g_Buf;
+};
+
+Buffer<float> g_Bufs[4];
+RWBuffer<float> g_Out;
+
+[numthreads(64, 1, 1)]
+void main(uint gi : SV_GroupIndex) {
+  for (uint i = 0; i < g_Count; ++i) {
+    g_Out[gi * 8 + i] = g_Bufs[g_Buf][i];
+  }
+}
@@ -0,0 +1,29 @@
+// RUN: %dxc -E main -T ps_6_0 -hoist-invariant-reads %s | FileCheck %s
+
+// The store to g_Log keeps LICM from hoisting any read out of the loop. The
+// sample's coordinates come from a cbuffer and the loop count is uniform, so
+// the sample runs once, before the loop; the load of g_Log can't move.
+// CHECK: @dx.op.sample.f32(i32 60
+// CHECK: br label
+// CHECK-NOT: @dx.op.sample
+// CHECK: @dx.op.bufferLoad.f32
+// CHECK: @dx.op.bufferStore.f32
+
+cbuffer Params {
+  float2 g_UV;
+  uint g_Count;
+};
+
+Texture2D<float4> g_Tex;
+SamplerState g_Samp;
+RWBuffer<float4> g_Log;
+
+float4 main(float4 pos : SV_Position) : SV_Target {
+  float4 result = 0;
+  [loop]
+  for (uint i = 0; i < g_Count; ++i) {
+    result += g_Tex.Sample(g_Samp, g_UV) * g_Log[0];
+    g_Log[i + 1] = result;
+  }
+  return result;
+}
@@ -0,0 +1,19 @@
+// RUN: %dxc -E main -T ps_6_0 %s | FileCheck %s
+
+// Each component is loaded once, in the entry block.
+// CHECK: entry:
+// CHECK: call float @dx.op.loadInput.f32(i32 4, i32 0, i32 1, i8 0, i32 undef)
+// CHECK-NOT: call float @dx.op.loadInput.f32(i32 4, i32 0, i32 1, i8 0, i32 undef)
+// CHECK: ret void
+
+float4 main(float4 a[2] : A, uint b : B) : SV_Target
+{
+    float4 r = a[0];
+    if (b > 1)
+        r += a[1].x * 2;
+    else if (b > 0)
+        r -= a[1].x;
+    else
+        r *= a[1];
+    return r;
+}
@@ -0,0 +1,28 @@
+// RUN: %dxc -E main -T ps_6_0 -lazy-function-bodies %s | FileCheck %s
+
+// Only the bodies the entry point reaches are parsed, so the error in the
+// unused function isn't reported. Functions defined after their first use
+// are still found.
+
+// CHECK: define void @main()
+// CHECK: fadd
+// CHECK: fmul
+// CHECK: ret void
+
+float unused(float a) {
+  return undeclared_identifier * a;
+}
+
+float helper2(float a);
+
+float helper(float a) {
+  return helper2(a) * 3;
+}
+
+float4 main(float a : A) : SV_Target {
+  return helper(a);
+}
+
+float helper2(float a) {
+  return a + 1;
+}
@@ -0,0 +1,102 @@
+// RUN: %dxc -T lib_6_1 %s | FileCheck %s
+
+// Large helpers called from several exports, none in a loop, stay calls;
+// small helpers and helpers called in loops are inlined.
+
+// CHECK-NOT: call float @"\01?small@@
+// CHECK-NOT: call float @"\01?hot@@
+// CHECK: call float @"\01?big@@
+// CHECK-NOT: call float @"\01?small@@
+// CHECK-NOT: call float @"\01?hot@@
+// CHECK: call float @"\01?big@@
+// CHECK-NOT: call float @"\01?small@@
+// CHECK-NOT: call float @"\01?hot@@
+
+float small(float a) {
+  return a * 2 + 1;
+}
+
+float big(float a, float b) {
+  float r = a;
+  r = r * a + sin(r * b + 0.5);
+  r = r * a + sin(r * b + 1.5);
+  r = r * a + sin(r * b + 2.5);
+  r = r * a + sin(r * b + 3.5);
+  r = r * a + sin(r * b + 4.5);
+  r = r * a + sin(r * b + 5.5);
+  r = r * a + sin(r * b + 6.5);
+  r = r * a + sin(r * b + 0.5);
+  r = r * a + sin(r * b + 1.5);
+  r = r * a + sin(r * b + 2.5);
+  r = r * a + sin(r * b + 3.5);
+  r = r * a + sin(r * b + 4.5);
+  r = r * a + sin(r * b + 5.5);
+  r = r * a + sin(r * b + 6.5);
+  r = r * a + sin(r * b + 0.5);
+  r = r * a + sin(r * b + 1.5);
+  r = r * a + sin(r * b + 2.5);
+  r = r * a + sin(r * b + 3.5);
+  r = r * a + sin(r * b + 4.5);
+  r = r * a + sin(r * b + 5.5);
+  r = r * a + sin(r * b + 6.5);
+  r = r * a + sin(r * b + 0.5);
+  r = r * a + sin(r * b + 1.5);
+  r = r * a + sin(r * b + 2.5);
+  r = r * a + sin(r * b + 3.5);
+  r = r * a + sin(r * b + 4.5);
+  r = r * a + sin(r * b + 5.5);
+  r = r * a + sin(r * b + 6.5);
+  r = r * a + sin(r * b + 0.5);
+  r = r * a + sin(r * b + 1.5);
+  r = r * a + sin(r * b + 2.5);
+  r = r * a + sin(r * b + 3.5);
+  return r;
+}
+
+float hot(float a, float b) {
+  float r = a;
+  r = r * a + sin(r * b + 0.5);
+  r = r * a + sin(r * b + 1.5);
+  r = r * a + sin(r * b + 2.5);
+  r = r * a + sin(r * b + 3.5);
+  r = r * a + sin(r * b + 4.5);
+  r = r * a + sin(r * b + 5.5);
+  r = r * a + sin(r * b + 6.5);
+  r = r * a + sin(r * b + 0.5);
+  r = r * a + sin(r * b + 1.5);
+  r = r * a + sin(r * b + 2.5);
+  r = r * a + sin(r * b + 3.5);
+  r = r * a + sin(r * b + 4.5);
+  r = r * a + sin(r * b + 5.5);
+  r = r * a + sin(r * b + 6.5);
+  r = r * a + sin(r * b + 0.5);
+  r = r * a + sin(r * b + 1.5);
+  r = r * a + sin(r * b + 2.5);
+  r = r * a + sin(r * b + 3.5);
+  r = r * a + sin(r * b + 4.5);
+  r = r * a + sin(r * b + 5.5);
+  r = r * a + sin(r * b + 6.5);
+  r = r * a + sin(r * b + 0.5);
+  r = r * a + sin(r * b + 1.5);
+  r = r * a + sin(r * b + 2.5);
+  r = r * a + sin(r * b + 3.5);
+  r = r * a + sin(r * b + 4.5);
+  r = r * a + sin(r * b + 5.5);
+  r = r * a + sin(r * b + 6.5);
+  r = r * a + sin(r * b + 0.5);
+  r = r * a + sin(r * b + 1.5);
+  r = r * a + sin(r * b + 2.5);
+  r = r * a + sin(r * b + 3.5);
+  return r;
+}
+
+export float test_a(float a, float b) {
+  return big(a, b) + small(b);
+}
+
+export float test_b(float a, float b, uint n) {
+  float r = big(b, a);
+  for (uint i = 0; i < n; ++i)
+    r += hot(r, a);
+  return r + hot(b, a);
+}
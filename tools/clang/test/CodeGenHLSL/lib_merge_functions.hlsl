@@ -0,0 +1,27 @@
+// RUN: %dxc -T lib_6_1 -merge-functions %s | FileCheck %s
+
+// Scale and ScaleAgain have the same body, so the one named later keeps its
+// export but only calls the other.
+// CHECK: define float @"\01?Scale@@YAMM@Z"
+// CHECK: fmul
+// CHECK: define float @"\01?ScaleAgain@@YAMM@Z"
+// CHECK-NOT: fmul
+// CHECK: call float @"\01?Scale@@YAMM@Z"
+// CHECK: ret float
+
+// Entry points keep their bodies even when they match.
+// CHECK: define void @cs_main()
+// CHECK: dx.op.bufferStore
+// CHECK: define void @cs_main2()
+// CHECK: dx.op.bufferStore
+
+RWBuffer<float> Out : register(u0);
+
+export float Scale(float x) { return x * 3.0 + 1.0; }
+export float ScaleAgain(float x) { return x * 3.0 + 1.0; }
+
+[numthreads(8, 8, 1)]
+void cs_main() { Out[0] = 5; }
+
+[numthreads(8, 8, 1)]
+void cs_main2() { Out[0] = 5; }
@@ -0,0 +1,13 @@
+// RUN: %dxc -E main -T ps_6_0 %s -fcgl | FileCheck %s
+
+// Make sure a local array with a constant initializer is copied from a
+// constant global instead of being stored element by element.
+// CHECK: private unnamed_addr constant [8 x float] [float 1.000000e+00, float 2.000000e+00
+// CHECK: @llvm.memcpy
+// CHECK-NOT: store float 8.000000e+00
+
+float main(uint i : I) : SV_Target
+{
+  float lut[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+  return lut[i];
+}
@@ -0,0 +1,21 @@
+// RUN: %dxc -E main -T ps_6_0  -Zi -Od %s | FileCheck %s
+
+// The offset is legalized without the loop unroller.
+// CHECK: @dx.op.sample.f32(i32 60, {{.*}}, i32 5, i32 1, i32 undef, float undef)
+
+SamplerState samp1 : register(s5);
+Texture2D<float4> text1 : register(t3);
+
+
+float4 main(float2 a : A, float b : B) : SV_Target {
+  float4 r = 0;
+  int x = 3;
+  int y = 2;
+  if (b > 0)
+    r = b;
+  else
+    r = -b;
+  r += text1.Sample(samp1, a, int2(x+y,x-y));
+
+  return r;
+}
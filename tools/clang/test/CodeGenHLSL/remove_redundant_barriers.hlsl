@@ -0,0 +1,27 @@
+// RUN: %dxc -E main -T cs_6_0 -remove-redundant-barriers %s | FileCheck %s
+
+// The first barrier is removed: each thread only reads back the element of a
+// it wrote, indexed by SV_GroupIndex.
+// CHECK: store float {{.*}} addrspace(3)*
+// CHECK-NOT: @dx.op.barrier
+// CHECK: load float, float addrspace(3)*
+
+// The two barriers before the read of a neighbour's element of b are merged
+// into one, which is kept.
+// CHECK: call void @dx.op.barrier(i32 80, i32 9)
+// CHECK-NOT: call void @dx.op.barrier
+// CHECK: ret void
+
+groupshared float a[64];
+groupshared float b[64];
+RWStructuredBuffer<float> output;
+
+[numthreads(64, 1, 1)]
+void main(uint gi : SV_GroupIndex) {
+  a[gi] = gi;
+  GroupMemoryBarrierWithGroupSync();
+  b[gi] = a[gi] * 2;
+  GroupMemoryBarrierWithGroupSync();
+  GroupMemoryBarrierWithGroupSync();
+  output[gi] = b[(gi + 1) % 64];
+}
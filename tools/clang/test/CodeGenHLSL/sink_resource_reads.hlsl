@@ -0,0 +1,25 @@
+// RUN: %dxc -E main -T ps_6_0 -sink-resource-reads %s | FileCheck %s
+
+// Twenty float4 samples are more than the register budget, so each one is
+// moved down to its first use.
+// CHECK: call %dx.types.ResRet.f32 @dx.op.sample.f32(i32 60
+// CHECK: {{fadd|fmul}}
+// CHECK: call %dx.types.ResRet.f32 @dx.op.sample.f32(i32 60
+// CHECK: {{fadd|fmul}}
+// CHECK: call %dx.types.ResRet.f32 @dx.op.sample.f32(i32 60
+
+Texture2D g_Tex;
+SamplerState g_Samp;
+
+float4 main(float2 uv : UV) : SV_Target {
+  float4 s[20];
+  [unroll]
+  for (int i = 0; i < 20; ++i)
+    s[i] = g_Tex.Sample(g_Samp, uv + i * 0.01);
+
+  float4 r = 1;
+  [unroll]
+  for (int j = 0; j < 20; ++j)
+    r = r * s[j] + 0.5;
+  return r;
+}
@@ -0,0 +1,33 @@
+// RUN: %dxc -E main -T ps_6_0 -stream-codegen %s | FileCheck %s
+
+// Generating code as functions are parsed gives the same result: functions
+// defined before and after their first use are both inlined, and the unused
+// function is dropped.
+
+// CHECK: define void @main()
+// CHECK: fadd
+// CHECK: fmul
+// CHECK: ret void
+// CHECK-NOT: unused
+
+cbuffer CB {
+  float scale;
+};
+
+float unused(float a) {
+  return a * scale;
+}
+
+float helper2(float a);
+
+float helper(float a) {
+  return helper2(a) * scale;
+}
+
+float4 main(float a : A) : SV_Target {
+  return helper(a);
+}
+
+float helper2(float a) {
+  return a + 1;
+}
@@ -0,0 +1,25 @@
+// RUN: %dxc -E main -T cs_6_0 -merge-buffer-access %s | FileCheck %s
+
+// Reads of adjacent fields share one load.
+// CHECK: call %dx.types.ResRet.f32 @dx.op.bufferLoad.f32(i32 68, %dx.types.Handle %{{.*}}, i32 %{{.*}}, i32 4)
+// CHECK-NOT: @dx.op.bufferLoad.f32
+// Writes to adjacent fields share one store.
+// CHECK: call void @dx.op.bufferStore.f32(i32 69, %dx.types.Handle %{{.*}}, i32 %{{.*}}, i32 0, float %{{.*}}, float %{{.*}}, float %{{.*}}, float undef, i8 7)
+// CHECK-NOT: @dx.op.bufferStore.f32
+
+struct Particle {
+  float mass;
+  float3 velocity;
+};
+
+RWStructuredBuffer<Particle> particles;
+StructuredBuffer<Particle> source;
+
+[numthreads(64, 1, 1)]
+void main(uint id : SV_DispatchThreadID) {
+  float speed = source[id].velocity.x + source[id].velocity.y +
+                source[id].velocity.z;
+  particles[id].mass = speed;
+  particles[id].velocity.x = speed * 2;
+  particles[id].velocity.y = speed * 3;
+}
@@ -0,0 +1,40 @@
+// RUN: %dxc -E main -T ps_6_0 %s | FileCheck %s
+
+// Locals of nested struct type are split down to their leaf fields and
+// promoted, including through partial and whole struct copies.
+// CHECK: define void @main()
+// CHECK-NOT: alloca
+// CHECK: ret void
+
+struct Layer {
+  float4 color;
+  float weights[4];
+  float2x2 xform;
+};
+
+struct Surface {
+  float roughness;
+  uint flags;
+};
+
+struct Material {
+  Layer base;
+  Layer coat;
+  Surface surface;
+};
+
+cbuffer C {
+  Material g_mat;
+  uint g_idx;
+};
+
+float4 main(float2 uv : UV) : SV_Target {
+  Material m = g_mat;
+  Layer l = m.base;
+  l.weights[g_idx] = uv.x;
+  m.coat = l;
+  m.surface.roughness *= uv.y;
+  float2 t = mul(m.coat.xform, uv);
+  return m.coat.color * m.coat.weights[g_idx] * m.surface.roughness +
+         float4(t, m.base.weights[1], m.surface.flags);
+}
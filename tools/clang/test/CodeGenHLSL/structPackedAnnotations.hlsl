@@ -0,0 +1,18 @@
+// RUN: %dxc -E main -T ps_6_2 -packed-type-annotations %s | FileCheck %s
+
+// The struct and function annotations share one packed tuple.
+// CHECK: !dx.typeAnnotations = !{![[TA:[0-9]+]]}
+// CHECK: ![[TA]] = !{i32 3, !"{{.*}}", {{.*}} undef, {{.*}}void ()* @main}
+
+struct Light {
+  float3 dir;
+  float4 color;
+  row_major float3x3 rot;
+};
+
+Light light;
+float4 ambient;
+
+float4 main(float3 n : NORMAL) : SV_Target {
+  return ambient + light.color * saturate(dot(mul(n, light.rot), light.dir));
+}
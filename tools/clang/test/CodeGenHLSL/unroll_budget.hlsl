@@ -0,0 +1,17 @@
+// RUN: %dxc -E main -T ps_6_0 -unroll-budget 256 %s | FileCheck %s
+
+// With -unroll-budget, [unroll] loops are limited too: 64 copies of the
+// body don't fit in the budget, so the loop stays rolled with a single load.
+// CHECK: phi
+// CHECK: call %dx.types.ResRet.f32 @dx.op.bufferLoad.f32(i32 68
+// CHECK-NOT: @dx.op.bufferLoad.f32(i32 68
+
+Buffer<float4> g_Buf;
+
+float4 main() : SV_Target {
+  float4 r = 0;
+  [unroll]
+  for (int i = 0; i < 64; ++i)
+    r += g_Buf[i];
+  return r;
+}
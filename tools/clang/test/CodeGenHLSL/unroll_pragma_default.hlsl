@@ -0,0 +1,19 @@
+// RUN: %dxc -E main -T ps_6_0 %s | FileCheck %s
+
+// Without -unroll-budget, an [unroll] loop gets the full pragma threshold
+// however large the shader is, so all 64 loads are straight-line code.
+// CHECK-NOT: phi
+// CHECK: call %dx.types.ResRet.f32 @dx.op.bufferLoad.f32(i32 68, %dx.types.Handle %{{.*}}, i32 0, i32 undef)
+// CHECK-NOT: phi
+// CHECK: call %dx.types.ResRet.f32 @dx.op.bufferLoad.f32(i32 68, %dx.types.Handle %{{.*}}, i32 63, i32 undef)
+// CHECK-NOT: phi
+
+Buffer<float4> g_Buf;
+
+float4 main() : SV_Target {
+  float4 r = 0;
+  [unroll]
+  for (int i = 0; i < 64; ++i)
+    r += g_Buf[i];
+  return r;
+}
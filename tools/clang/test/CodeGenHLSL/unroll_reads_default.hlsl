@@ -0,0 +1,28 @@
+// RUN: %dxc -E main -T ps_6_0 %s | FileCheck %s
+
+// A loop without [unroll] is only unrolled within the default threshold.
+// The first loop is small and has no resource reads, so it is unrolled.
+// The second one samples twice per iteration; its unrolled copies would
+// be too large and would keep many sample results live, so it stays
+// rolled with one copy of each sample.
+// CHECK-NOT: phi
+// CHECK: @dx.op.cbufferLoadLegacy.f32(i32 59
+// CHECK: phi
+// CHECK: call %dx.types.ResRet.f32 @dx.op.sample.f32(i32 60
+// CHECK: call %dx.types.ResRet.f32 @dx.op.sample.f32(i32 60
+// CHECK-NOT: @dx.op.sample.f32(i32 60
+
+Texture2D g_Tex;
+SamplerState g_Samp;
+float4 g_Scale[4];
+
+float4 main(float2 uv : UV) : SV_Target {
+  float4 s = 1;
+  for (int i = 0; i < 4; ++i)
+    s = s * g_Scale[i] + 0.5;
+
+  float4 r = 0;
+  for (int j = 0; j < 32; ++j)
+    r += g_Tex.Sample(g_Samp, uv * j) * g_Tex.Sample(g_Samp, uv + j);
+  return r * s;
+}
@@ -0,0 +1,20 @@
+// RUN: %dxc -Emain -Tvs_6_0 %s | %opt -S -hlsl-dxil-eliminate-output-dynamic | %FileCheck %s
+
+// Only the rows i & 3 can reach are copied to the output.
+// CHECK-NOT: storeOutput.f32(i32 5, i32 0, i32 %
+// CHECK: storeOutput.f32(i32 5, i32 0, i32 0
+// CHECK: storeOutput.f32(i32 5, i32 0, i32 1
+// CHECK: storeOutput.f32(i32 5, i32 0, i32 2
+// CHECK: storeOutput.f32(i32 5, i32 0, i32 3
+// CHECK-NOT: storeOutput.f32(i32 5, i32 0, i32 4
+
+int  count;
+float4 c[16];
+
+float4 main(out float o[8] : I, float4 pos: POS) : SV_POSITION {
+
+    for (uint i=0;i<count;i++)
+        o[i & 3] = c[i].x;
+
+    return pos;
+}
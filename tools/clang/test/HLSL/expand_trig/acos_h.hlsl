@@ -3,7 +3,7 @@
 // Make sure the expansion works for half.
 // Only checking for for minimal expansion here, full check is done for float case.
 
-// CHECK: fmul fast half %{{.*}}, 0xHA4CB
+// CHECK: fmul fast half %{{.*}}, 0xH2A94
 
 
 [RootSignature("")]
@@ -0,0 +1,31 @@
+// RUN: %dxc -Emain -Tps_6_0 %s | %opt -S -hlsl-dxil-debug-instrumentation,compact-packets=1 | %FileCheck %s
+
+// Check that uninteresting invocations are branched around rather than sent to the dumping ground:
+// CHECK-NOT: %OffsetAddend
+
+// Check that the first lane reserves space for the invocation start markers of the whole wave:
+// CHECK: %SelectedLanes = call i32 @dx.op.waveAllOp(i32 135, i1 %ComparePos)
+// CHECK: %SelectedLanesBefore = call i32 @dx.op.wavePrefixOp(i32 136, i1 %ComparePos)
+// CHECK: %IsFirstLane = call i1 @dx.op.waveIsFirstLane(i32 110)
+// CHECK: br i1 %IsFirstLane
+// CHECK: %SpaceForWave = mul i32 %SelectedLanes, 8
+// CHECK: %UAVIncResult = call i32 @dx.op.atomicBinOp.i32(i32 78, %dx.types.Handle %PIX_DebugUAV_Handle, i32 0, i32 0, i32 undef, i32 undef, i32 %SpaceForWave)
+// CHECK: %WaveReservation = phi i32
+// CHECK: %WaveBase = call i32 @dx.op.waveReadLaneFirst.i32(i32 118, i32 %WaveReservation)
+// CHECK: %LaneOffset = add i32 %WaveBase
+// CHECK: %MaskedForUAVLimit = and i32 %LaneOffset, 983039
+// CHECK: br i1 %ComparePos
+// CHECK: call void @dx.op.bufferStore.i32(i32 69, %dx.types.Handle %PIX_DebugUAV_Handle, i32 %MaskedForUAVLimit, i32 0, i32 0, i32 0, i32 0, i32 0, i8 1)
+
+// Check that the block is recorded in one 12-byte packet (type 250, payload of one dword)
+// starting at the first instruction:
+// CHECK: mul i32 %SelectedLanes{{[0-9]+}}, 12
+// CHECK: call void @dx.op.bufferStore.i32(i32 69, %dx.types.Handle %PIX_DebugUAV_Handle, i32 %MaskedForUAVLimit{{[0-9]+}}, i32 0, i32 129536, i32 0, i32 0, i32 0, i8 1)
+// CHECK: call void @dx.op.bufferStore.i32(i32 69, %dx.types.Handle %PIX_DebugUAV_Handle, i32 {{.*}}, i32 0, i32 %LaneOffset, i32 0, i32 0, i32 0, i8 1)
+// CHECK: call void @dx.op.bufferStore.i32(i32 69, %dx.types.Handle %PIX_DebugUAV_Handle, i32 {{.*}}, i32 0, i32 0, i32 0, i32 0, i32 0, i8 1)
+// CHECK: ret void
+
+[RootSignature("")]
+float4 main() : SV_Target {
+    return float4(0,0,0,0);
+}
@@ -0,0 +1,16 @@
+// RUN: %dxc -Emain -Tps_6_0 %s | %opt -S -hlsl-dxil-debug-instrumentation,sample-rate=4 | %FileCheck %s
+
+// Check that only every fourth matching invocation is selected:
+
+// CHECK: %ComparePos = and i1 %CompareToX, %CompareToY
+// CHECK: %SampleTicket = zext i1 %ComparePos to i32
+// CHECK: %SampleCounter = call i32 @dx.op.atomicBinOp.i32(i32 78, %dx.types.Handle %PIX_DebugUAV_Handle, i32 0, i32 1048572, i32 undef, i32 undef, i32 %SampleTicket)
+// CHECK: %SampleIndex = urem i32 %SampleCounter, 4
+// CHECK: %IsSampled = icmp eq i32 %SampleIndex, 0
+// CHECK: %SelectedAndSampled = and i1 %ComparePos, %IsSampled
+// CHECK: %OffsetMultiplicand = zext i1 %SelectedAndSampled to i32
+
+[RootSignature("")]
+float4 main() : SV_Target {
+    return float4(0,0,0,0);
+}
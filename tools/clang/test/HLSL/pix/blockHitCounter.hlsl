@@ -0,0 +1,21 @@
+// RUN: %dxc -Emain -Tps_6_0 %s | %opt -S -hlsl-dxil-add-block-hit-instrumentation | %FileCheck %s
+
+// Check that each block's counter is incremented once per wave, by the number of active lanes:
+
+// CHECK: %PIX_BlockHitUAV_Handle = call %dx.types.Handle @dx.op.createHandle(i32 57, i8 1, i32 0, i32 0, i1 false)
+// CHECK: %ActiveLanes = call i32 @dx.op.waveAllOp(i32 135, i1 true)
+// CHECK: %IsFirstLane = call i1 @dx.op.waveIsFirstLane(i32 110)
+// CHECK: br i1 %IsFirstLane
+// CHECK: %UAVIncResult = call i32 @dx.op.atomicBinOp.i32(i32 78, %dx.types.Handle %PIX_BlockHitUAV_Handle, i32 0, i32 0, i32 undef, i32 undef, i32 %ActiveLanes)
+// CHECK: %ActiveLanes{{[0-9]+}} = call i32 @dx.op.waveAllOp(i32 135, i1 true)
+// CHECK: %UAVIncResult{{[0-9]+}} = call i32 @dx.op.atomicBinOp.i32(i32 78, %dx.types.Handle %PIX_BlockHitUAV_Handle, i32 0, i32 4, i32 undef, i32 undef, i32 %ActiveLanes{{[0-9]+}})
+
+int i32;
+
+float4 main() : SV_Target {
+  float4 ret = float4(0, 0, 0, 1);
+  for (int i = 0; i < i32; ++i) {
+    ret.r += 0.5;
+  }
+  return ret;
+}
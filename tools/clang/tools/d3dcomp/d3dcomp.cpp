@@ -18,20 +18,39 @@
 #include <vector>
 #include <string>
 
+// Engines going through the d3dcompiler entry points call them once per
+// shader, often tens of thousands of times while loading, and creating the
+// dxcompiler objects each time costs more than compiling a small shader.
+// Each thread creates them on first use and keeps them; dxcompiler objects
+// may be used from one thread at a time, and none of these calls can re-enter
+// on the same thread, since user include handlers are not supported.
+struct BridgeThreadCache {
+  CComPtr<IDxcLibrary> Library;
+  CComPtr<IDxcCompiler> Compiler;
+  CComPtr<IDxcContainerReflection> Reflection;
+};
+static thread_local BridgeThreadCache t_BridgeCache;
+
+template <typename TInterface>
+static HRESULT GetCachedInstance(CComPtr<TInterface> &cached, REFCLSID clsid,
+                                 TInterface **ppResult) {
+  if (!cached)
+    IFR(DxcCreateInstance(clsid, __uuidof(TInterface), (void **)&cached));
+  return cached.CopyTo(ppResult);
+}
+
 HRESULT CreateLibrary(IDxcLibrary **pLibrary) {
-  return DxcCreateInstance(CLSID_DxcLibrary, __uuidof(IDxcLibrary),
-                           (void **)pLibrary);
+  return GetCachedInstance(t_BridgeCache.Library, CLSID_DxcLibrary, pLibrary);
 }
 
 HRESULT CreateCompiler(IDxcCompiler **ppCompiler) {
-  return DxcCreateInstance(CLSID_DxcCompiler, __uuidof(IDxcCompiler),
-                           (void **)ppCompiler);
+  return GetCachedInstance(t_BridgeCache.Compiler, CLSID_DxcCompiler,
+                           ppCompiler);
 }
 
 HRESULT CreateContainerReflection(IDxcContainerReflection **ppReflection) {
-  return DxcCreateInstance(CLSID_DxcContainerReflection,
-                           __uuidof(IDxcContainerReflection),
-                           (void **)ppReflection);
+  return GetCachedInstance(t_BridgeCache.Reflection,
+                           CLSID_DxcContainerReflection, ppReflection);
 }
 
 HRESULT CompileFromBlob(IDxcBlobEncoding *pSource, LPCWSTR pSourceName,
@@ -246,15 +265,29 @@ HRESULT WINAPI BridgeD3DReflect(
 
   *ppReflector = nullptr;
 
+  // Turn away anything that isn't a container before creating any objects,
+  // and copy only the container itself. The reflection keeps the copy, since
+  // the caller's buffer may go away once this returns; it reads the bitcode
+  // in place and only parses function bodies when usage is asked for.
+  const hlsl::DxilContainerHeader *pHeader =
+      (const hlsl::DxilContainerHeader *)pSrcData;
+  if (!pSrcData || SrcDataSize < sizeof(hlsl::DxilContainerHeader) ||
+      pHeader->HeaderFourCC != hlsl::DFCC_Container ||
+      pHeader->ContainerSizeInBytes > SrcDataSize)
+    return E_INVALIDARG;
+
   IFR(CreateLibrary(&library));
-  IFR(library->CreateBlobWithEncodingOnHeapCopy((LPBYTE)pSrcData, SrcDataSize,
-                                                CP_ACP, &source));
+  IFR(library->CreateBlobWithEncodingOnHeapCopy(
+      (LPBYTE)pSrcData, pHeader->ContainerSizeInBytes, CP_ACP, &source));
   IFR(CreateContainerReflection(&reflection));
   IFR(reflection->Load(source));
-  IFR(reflection->FindFirstPartKind(hlsl::DFCC_DXIL, &shaderIdx));
-  IFR(reflection->GetPartReflection(shaderIdx, pInterface,
-                                    (void **)ppReflector));
-  return S_OK;
+  HRESULT hr = reflection->FindFirstPartKind(hlsl::DFCC_DXIL, &shaderIdx);
+  if (SUCCEEDED(hr))
+    hr = reflection->GetPartReflection(shaderIdx, pInterface,
+                                       (void **)ppReflector);
+  // Don't keep the container alive in the cached object.
+  reflection->Load(nullptr);
+  return hr;
 }
 
 HRESULT WINAPI
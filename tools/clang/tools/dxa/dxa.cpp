@@ -18,7 +18,19 @@
 #include "dxc/Support/HLSLOptions.h"
 #include "dxc/HLSL/DxilContainer.h"
 
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MSFileSystem.h"
+#include "llvm/Support/Path.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
 #include <dia2.h>
 #include <intsafe.h>
 
@@ -48,6 +60,35 @@ static cl::opt<bool> ListFiles("listfiles",
 static cl::opt<std::string>
     ExtractFile("extractfile", cl::desc("Extract file from debug information (use '*' for all files)"));
 
+static cl::opt<std::string>
+    StripParts("stripparts", cl::desc("Remove the comma-separated parts from input containers (use 'debug' for ILDB and ILDN)"));
+
+static cl::opt<std::string>
+    OutputDirectory("outdir", cl::desc("Write the output of each input under the given directory instead of next to it"),
+                    cl::value_desc("directory"));
+
+static cl::opt<std::string>
+    ListFilename("list", cl::desc("Also process the containers named in the given file, one per line"),
+                 cl::value_desc("filename"));
+
+static cl::opt<unsigned>
+    Jobs("j", cl::desc("Number of containers processed at once (default: one per core)"),
+         cl::value_desc("count"), cl::init(0));
+
+// Overview of -stripparts and batch -extractpart:
+//
+// Both work on containers alone: the file is mapped and its part headers are
+// walked directly, so no bitcode is ever loaded and the DLL is not needed.
+// The input may be a directory (searched recursively), a file name with * or
+// ? wildcards, or a -list file, in which case the containers are shared out
+// to -j worker threads.
+//
+// -stripparts rewrites each container without the given parts, in place
+// unless -o or -outdir is given. Removing a part changes the container, so
+// its hash is cleared; a runtime that checks it needs the container validated
+// again. -extractpart writes the part next to each input, or under -outdir,
+// with the part name appended as the extension.
+
 
 class DxaContext {
 
@@ -120,6 +161,19 @@ HRESULT DxaContext::FindModule(hlsl::DxilFourCC fourCC, IDxcBlob *pSource, IDxcL
   if (fourCC == pDxilPartHeader->PartFourCC) {
     UINT32 pBlobSize;
     hlsl::DxilProgramHeader *pDxilProgramHeader = (hlsl::DxilProgramHeader*)(pDxilPartHeader + 1);
+    if (hlsl::IsCompressedDxilProgramHeader(pDxilProgramHeader,
+                                            pDxilPartHeader->PartSize)) {
+      std::vector<char> bitcode;
+      IFTBOOL(hlsl::GetDecompressedDxilProgramBitcode(
+                  pDxilProgramHeader, pDxilPartHeader->PartSize, bitcode,
+                  &pBitcode, &pBlobSize),
+              DXC_E_CONTAINER_INVALID);
+      CComPtr<IDxcBlobEncoding> pBitcodeBlob;
+      IFR(pLibrary->CreateBlobWithEncodingOnHeapCopy(pBitcode, pBlobSize,
+                                                     CP_ACP, &pBitcodeBlob));
+      *ppTargetBlob = pBitcodeBlob.Detach();
+      return S_OK;
+    }
     hlsl::GetDxilProgramBitcode(pDxilProgramHeader, &pBitcode, &pBlobSize);
     UINT32 offset = (UINT32)(pBitcode - (const char *)pSource->GetBufferPointer());
     pLibrary->CreateBlobFromBlob(pSource, offset, pBlobSize, ppTargetBlob);
@@ -164,7 +218,7 @@ void DxaContext::ListFiles() {
   CComPtr<IDxcBlob> pTargetBlob;
   CComPtr<IDxcLibrary> pLibrary;
   CComPtr<IDiaTable> pTable;
-  ReadFileIntoBlob(m_dxcSupport, StringRefUtf16(InputFilename), &pSource);
+  ReadFileIntoBlobMapped(StringRefUtf16(InputFilename), &pSource);
   IFTARG(pSource->GetBufferSize() >= 4);
   IFT(m_dxcSupport.CreateInstance(CLSID_DxcLibrary, &pLibrary));
   IFT(FindModule(hlsl::DxilFourCC::DFCC_ShaderDebugInfoDXIL, pSource, pLibrary, &pTargetBlob));
@@ -196,7 +250,7 @@ bool DxaContext::ExtractFile(const char *pName) {
   CComPtr<IDxcBlob> pTargetBlob;
   CComPtr<IDxcLibrary> pLibrary;
   CComPtr<IDiaTable> pTable;
-  ReadFileIntoBlob(m_dxcSupport, StringRefUtf16(InputFilename), &pSource);
+  ReadFileIntoBlobMapped(StringRefUtf16(InputFilename), &pSource);
   IFTARG(pSource->GetBufferSize() >= 4);
   IFT(m_dxcSupport.CreateInstance(CLSID_DxcLibrary, &pLibrary));
   IFT(FindModule(hlsl::DxilFourCC::DFCC_ShaderDebugInfoDXIL, pSource, pLibrary, &pTargetBlob));
@@ -254,7 +308,7 @@ bool DxaContext::ExtractPart(const char *pName) {
     extractModule = true;
   }
 
-  ReadFileIntoBlob(m_dxcSupport, StringRefUtf16(InputFilename), &pSource);
+  ReadFileIntoBlobMapped(StringRefUtf16(InputFilename), &pSource);
   IFT(m_dxcSupport.CreateInstance(CLSID_DxcContainerReflection, &pReflection));
   IFT(pReflection->Load(pSource));
   IFT(pReflection->GetPartCount(&partCount));
@@ -288,13 +342,26 @@ bool DxaContext::ExtractPart(const char *pName) {
         hlsl::DxilProgramHeader *pProgramHdr = (hlsl::DxilProgramHeader *)pDxilPart;
         const char *pBitcode;
         uint32_t bitcodeLength;
-        GetDxilProgramBitcode(pProgramHdr, &pBitcode, &bitcodeLength);
-        uint32_t offset = pBitcode - pDxilPart;
-
         CComPtr<IDxcLibrary> pLib;
         CComPtr<IDxcBlob> pModuleBlob;
         IFT(m_dxcSupport.CreateInstance(CLSID_DxcLibrary, &pLib));
-        IFT(pLib->CreateBlobFromBlob(pContent, offset, bitcodeLength, &pModuleBlob));
+        if (IsCompressedDxilProgramHeader(pProgramHdr,
+                                          pContent->GetBufferSize())) {
+          std::vector<char> bitcode;
+          IFTBOOL(GetDecompressedDxilProgramBitcode(
+                      pProgramHdr, pContent->GetBufferSize(), bitcode,
+                      &pBitcode, &bitcodeLength),
+                  DXC_E_CONTAINER_INVALID);
+          CComPtr<IDxcBlobEncoding> pBitcodeBlob;
+          IFT(pLib->CreateBlobWithEncodingOnHeapCopy(
+              pBitcode, bitcodeLength, CP_ACP, &pBitcodeBlob));
+          pModuleBlob = pBitcodeBlob;
+        } else {
+          GetDxilProgramBitcode(pProgramHdr, &pBitcode, &bitcodeLength);
+          uint32_t offset = pBitcode - pDxilPart;
+          IFT(pLib->CreateBlobFromBlob(pContent, offset, bitcodeLength,
+                                       &pModuleBlob));
+        }
         std::swap(pModuleBlob, pContent);
       }
 
@@ -306,12 +373,299 @@ bool DxaContext::ExtractPart(const char *pName) {
   return false;
 }
 
+static uint32_t PartNameToFourCC(StringRef Name) {
+  IFTARG(Name.size() == 4);
+  return (UINT32)Name[0] | ((UINT32)Name[1] << 8) | ((UINT32)Name[2] << 16) |
+         ((UINT32)Name[3] << 24);
+}
+
+namespace {
+// Strips or extracts container parts for many files at once.
+class DxaPartBatch {
+private:
+  std::vector<uint32_t> m_stripParts;
+  uint32_t m_extractPart = 0;
+  bool m_extractModule = false;
+  std::string m_extension;
+  std::atomic<unsigned> m_nextFile;
+
+  struct FileResult {
+    HRESULT Status = E_FAIL;
+    std::string Error;
+    bool Changed = false;
+  };
+
+  std::string GetOutputPath(const std::string &Path,
+                            const std::string &RelPath);
+  bool StripFile(const std::string &Path, const std::string &OutPath);
+  void ExtractFile(const std::string &Path, const std::string &OutPath);
+  void RunWorker(ArrayRef<std::string> Paths, ArrayRef<std::string> RelPaths,
+                 std::vector<FileResult> &Results);
+
+public:
+  DxaPartBatch(StringRef StripList, StringRef ExtractName);
+  int Run(ArrayRef<std::string> Paths, ArrayRef<std::string> RelPaths,
+          unsigned ThreadCount);
+};
+}
+
+DxaPartBatch::DxaPartBatch(StringRef StripList, StringRef ExtractName) {
+  SmallVector<StringRef, 8> Names;
+  StripList.split(Names, ",", -1, false);
+  for (StringRef Name : Names) {
+    Name = Name.trim();
+    if (Name == "debug") {
+      m_stripParts.push_back(hlsl::DFCC_ShaderDebugInfoDXIL);
+      m_stripParts.push_back(hlsl::DFCC_ShaderDebugName);
+    } else {
+      m_stripParts.push_back(PartNameToFourCC(Name));
+    }
+  }
+  if (ExtractName.empty())
+    return;
+  // As for a single file, 'module' and 'dbgmodule' skip the program header.
+  m_extension = ExtractName;
+  if (ExtractName == "module") {
+    ExtractName = "DXIL";
+    m_extension = "ll";
+    m_extractModule = true;
+  } else if (ExtractName == "dbgmodule") {
+    ExtractName = "ILDB";
+    m_extension = "ll";
+    m_extractModule = true;
+  }
+  m_extractPart = PartNameToFourCC(ExtractName);
+}
+
+std::string DxaPartBatch::GetOutputPath(const std::string &Path,
+                                        const std::string &RelPath) {
+  if (!OutputFilename.empty())
+    return OutputFilename;
+  std::string OutPath = Path;
+  if (!OutputDirectory.empty()) {
+    SmallString<128> Joined(OutputDirectory.getValue());
+    sys::path::append(Joined, RelPath);
+    OutPath = Joined.str();
+  }
+  if (m_extractPart)
+    OutPath += "." + m_extension;
+  return OutPath;
+}
+
+static void WriteBytesToFile(const void *pData, size_t size,
+                             LPCWSTR pFileName) {
+  CHandle file(CreateFile2(pFileName, GENERIC_WRITE, FILE_SHARE_READ,
+                           CREATE_ALWAYS, nullptr));
+  if (file == INVALID_HANDLE_VALUE) {
+    IFT_Data(HRESULT_FROM_WIN32(GetLastError()), pFileName);
+  }
+  DWORD written;
+  if (FALSE == WriteFile(file, pData, (DWORD)size, &written, nullptr)) {
+    IFT_Data(HRESULT_FROM_WIN32(GetLastError()), pFileName);
+  }
+}
+
+static const hlsl::DxilContainerHeader *GetContainer(IDxcBlob *pSource) {
+  const hlsl::DxilContainerHeader *pContainer =
+      (const hlsl::DxilContainerHeader *)pSource->GetBufferPointer();
+  IFTBOOLMSG(hlsl::IsValidDxilContainer(pContainer, pSource->GetBufferSize()),
+             DXC_E_CONTAINER_INVALID, "not a valid DXIL container");
+  return pContainer;
+}
+
+// Returns whether any part was removed; the output is written either way
+// unless it would overwrite the input unchanged.
+bool DxaPartBatch::StripFile(const std::string &Path,
+                             const std::string &OutPath) {
+  std::vector<char> Out;
+  {
+    CComPtr<IDxcBlobEncoding> pSource;
+    ReadFileIntoBlobMapped(StringRefUtf16(Path), &pSource);
+    const hlsl::DxilContainerHeader *pContainer = GetContainer(pSource);
+
+    std::vector<const hlsl::DxilPartHeader *> Kept;
+    uint32_t PartsSize = 0;
+    for (auto it = hlsl::begin(pContainer), e = hlsl::end(pContainer);
+         it != e; ++it) {
+      const hlsl::DxilPartHeader *pPart = *it;
+      if (std::find(m_stripParts.begin(), m_stripParts.end(),
+                    pPart->PartFourCC) != m_stripParts.end())
+        continue;
+      Kept.push_back(pPart);
+      PartsSize += pPart->PartSize;
+    }
+    bool bChanged = Kept.size() != pContainer->PartCount;
+    if (!bChanged && OutPath == Path)
+      return false;
+    if (!bChanged) {
+      const char *pBytes = (const char *)pContainer;
+      Out.assign(pBytes, pBytes + pContainer->ContainerSizeInBytes);
+    } else {
+      uint32_t PartCount = (uint32_t)Kept.size();
+      Out.resize(hlsl::GetDxilContainerSizeFromParts(PartCount, PartsSize));
+      hlsl::DxilContainerHeader *pHeader =
+          (hlsl::DxilContainerHeader *)Out.data();
+      hlsl::InitDxilContainer(pHeader, PartCount, (uint32_t)Out.size());
+      pHeader->Version = pContainer->Version;
+      uint32_t *pOffsets = (uint32_t *)(pHeader + 1);
+      uint32_t Offset = (uint32_t)(sizeof(hlsl::DxilContainerHeader) +
+                                   hlsl::GetOffsetTableSize(PartCount));
+      for (uint32_t i = 0; i < PartCount; ++i) {
+        uint32_t PartBytes =
+            sizeof(hlsl::DxilPartHeader) + Kept[i]->PartSize;
+        pOffsets[i] = Offset;
+        memcpy(Out.data() + Offset, Kept[i], PartBytes);
+        Offset += PartBytes;
+      }
+    }
+    // The mapping is released here, so the input can be overwritten.
+  }
+  WriteBytesToFile(Out.data(), Out.size(), StringRefUtf16(OutPath));
+  return true;
+}
+
+void DxaPartBatch::ExtractFile(const std::string &Path,
+                               const std::string &OutPath) {
+  CComPtr<IDxcBlobEncoding> pSource;
+  ReadFileIntoBlobMapped(StringRefUtf16(Path), &pSource);
+  const hlsl::DxilContainerHeader *pContainer = GetContainer(pSource);
+  auto it = std::find_if(hlsl::begin(pContainer), hlsl::end(pContainer),
+                         hlsl::DxilPartIsType(m_extractPart));
+  IFTBOOLMSG(it != hlsl::end(pContainer), E_INVALIDARG, "part not found");
+  const hlsl::DxilPartHeader *pPart = *it;
+  const char *pData = hlsl::GetDxilPartData(pPart);
+  uint32_t Size = pPart->PartSize;
+  std::vector<char> bitcode;
+  if (m_extractModule) {
+    const hlsl::DxilProgramHeader *pProgramHdr =
+        (const hlsl::DxilProgramHeader *)pData;
+    if (hlsl::IsCompressedDxilProgramHeader(pProgramHdr, Size)) {
+      IFTBOOLMSG(hlsl::GetDecompressedDxilProgramBitcode(pProgramHdr, Size,
+                                                         bitcode, &pData,
+                                                         &Size),
+                 DXC_E_CONTAINER_INVALID, "invalid compressed program part");
+      WriteBytesToFile(pData, Size, StringRefUtf16(OutPath));
+      return;
+    }
+    IFTBOOLMSG(Size >= sizeof(hlsl::DxilProgramHeader) &&
+                   hlsl::IsValidDxilBitcodeHeader(
+                       &pProgramHdr->BitcodeHeader,
+                       Size - offsetof(hlsl::DxilProgramHeader,
+                                       BitcodeHeader)),
+               DXC_E_CONTAINER_INVALID, "invalid program header");
+    hlsl::GetDxilProgramBitcode(pProgramHdr, &pData, &Size);
+  }
+  WriteBytesToFile(pData, Size, StringRefUtf16(OutPath));
+}
+
+// Claims unstarted files until none are left, so that a large file only
+// delays the worker processing it.
+void DxaPartBatch::RunWorker(ArrayRef<std::string> Paths,
+                             ArrayRef<std::string> RelPaths,
+                             std::vector<FileResult> &Results) {
+  for (;;) {
+    unsigned i = m_nextFile++;
+    if (i >= Paths.size())
+      break;
+    FileResult &Result = Results[i];
+    // Nothing may escape the thread; a file that throws just fails.
+    try {
+      std::string OutPath = GetOutputPath(Paths[i], RelPaths[i]);
+      if (m_extractPart) {
+        ExtractFile(Paths[i], OutPath);
+        Result.Changed = true;
+      } else {
+        Result.Changed = StripFile(Paths[i], OutPath);
+      }
+      Result.Status = S_OK;
+    } catch (const ::hlsl::Exception &hlslException) {
+      Result.Status = hlslException.hr;
+      Result.Error = hlslException.msg;
+    } catch (std::bad_alloc &) {
+      Result.Status = E_OUTOFMEMORY;
+      Result.Error = "out of memory";
+    } catch (...) {
+      Result.Status = E_FAIL;
+      Result.Error = "unknown error";
+    }
+  }
+}
+
+int DxaPartBatch::Run(ArrayRef<std::string> Paths,
+                      ArrayRef<std::string> RelPaths, unsigned ThreadCount) {
+  // Output directories are created up front, on the thread with a file
+  // system.
+  if (!OutputDirectory.empty()) {
+    for (unsigned i = 0; i < Paths.size(); i++) {
+      StringRef Dir = sys::path::parent_path(GetOutputPath(Paths[i], RelPaths[i]));
+      if (!Dir.empty())
+        IFTLLVM(sys::fs::create_directories(Dir));
+    }
+  }
+
+  std::vector<FileResult> Results(Paths.size());
+  m_nextFile = 0;
+  auto t_start = std::chrono::high_resolution_clock::now();
+  ThreadCount = std::max<unsigned>(
+      1, std::min<unsigned>(ThreadCount, Paths.size()));
+  if (ThreadCount > 1) {
+    std::vector<std::thread> threads;
+    threads.reserve(ThreadCount);
+    for (unsigned i = 0; i < ThreadCount; i++)
+      threads.emplace_back(&DxaPartBatch::RunWorker, this, Paths, RelPaths,
+                           std::ref(Results));
+    for (auto &th : threads)
+      th.join();
+  } else {
+    RunWorker(Paths, RelPaths, Results);
+  }
+  auto t_end = std::chrono::high_resolution_clock::now();
+  double durationMs =
+      std::chrono::duration<double, std::milli>(t_end - t_start).count();
+
+  unsigned failed = 0, changed = 0;
+  for (unsigned i = 0; i < Paths.size(); i++) {
+    const FileResult &Result = Results[i];
+    if (FAILED(Result.Status)) {
+      ++failed;
+      if (Result.Error.empty())
+        printf("%s: error code 0x%08x\n", Paths[i].c_str(),
+               (unsigned)Result.Status);
+      else
+        printf("%s: %s\n", Paths[i].c_str(), Result.Error.c_str());
+    } else if (Result.Changed) {
+      ++changed;
+    }
+  }
+  printf("%u files, %u written, %u failed in %.2f ms on %u threads\n",
+         (unsigned)Paths.size(), changed, failed, durationMs, ThreadCount);
+  return failed ? 1 : 0;
+}
+
+// Expands Input, keeping each path relative to the directory it was named
+// from, so that -outdir mirrors the layout under it.
+static void AddInputs(const std::string &Input,
+                      std::vector<std::string> &Paths,
+                      std::vector<std::string> &RelPaths) {
+  size_t First = Paths.size();
+  ExpandInputPath(Input, Paths);
+  std::string Base = sys::fs::is_directory(Input)
+                         ? Input
+                         : sys::path::parent_path(Input).str();
+  for (size_t i = First; i < Paths.size(); ++i) {
+    StringRef Rel = Paths[i];
+    if (!Base.empty() && Rel.startswith(Base))
+      Rel = Rel.drop_front(Base.size());
+    RelPaths.push_back(Rel.ltrim("\\/"));
+  }
+}
+
 void DxaContext::ListParts() {
   CComPtr<IDxcContainerReflection> pReflection;
   CComPtr<IDxcBlobEncoding> pSource;
   UINT32 partCount;
 
-  ReadFileIntoBlob(m_dxcSupport, StringRefUtf16(InputFilename), &pSource);
+  ReadFileIntoBlobMapped(StringRefUtf16(InputFilename), &pSource);
   IFT(m_dxcSupport.CreateInstance(CLSID_DxcContainerReflection, &pReflection));
   IFT(pReflection->Load(pSource));
   IFT(pReflection->GetPartCount(&partCount));
@@ -330,7 +684,17 @@ using namespace hlsl::options;
 
 int __cdecl main(int argc, _In_reads_z_(argc) char **argv) {
   const char *pStage = "Operation";
+  int retVal = 0;
+  if (FAILED(DxcInitThreadMalloc())) return 1;
+  DxcSetThreadMallocOrDefault(nullptr);
   try {
+    llvm::sys::fs::MSFileSystem *msfPtr;
+    IFT(CreateMSFileSystemForDisk(&msfPtr));
+    std::unique_ptr<::llvm::sys::fs::MSFileSystem> msf(msfPtr);
+
+    ::llvm::sys::fs::AutoPerThreadSystem pts(msf.get());
+    IFTLLVM(pts.error_code());
+
     pStage = "Argument processing";
 
     // Parse command line options.
@@ -341,7 +705,33 @@ int __cdecl main(int argc, _In_reads_z_(argc) char **argv) {
 
     dxc::EnsureEnabled(dxcSupport);
     DxaContext context(dxcSupport);
-    if (ListParts) {
+
+    std::vector<std::string> Paths, RelPaths;
+    bool bPartBatch = !StripParts.empty();
+    if (bPartBatch || !ExtractPart.empty()) {
+      AddInputs(InputFilename, Paths, RelPaths);
+      if (!ListFilename.empty()) {
+        // Listed files are mirrored under -outdir by their full path.
+        size_t First = Paths.size();
+        ReadInputPathList(dxcSupport, StringRefUtf16(ListFilename), Paths);
+        for (size_t i = First; i < Paths.size(); ++i)
+          RelPaths.push_back(sys::path::relative_path(Paths[i]));
+      }
+      bPartBatch |= !ListFilename.empty() || !OutputDirectory.empty() ||
+                    Paths.size() != 1 || Paths[0] != InputFilename;
+      IFTBOOLMSG(!bPartBatch || OutputFilename.empty() || Paths.size() == 1,
+                 E_INVALIDARG, "-o needs a single input; use -outdir");
+    }
+
+    if (bPartBatch) {
+      pStage = StripParts.empty() ? "Extracting parts" : "Stripping parts";
+      IFTBOOLMSG(StripParts.empty() || ExtractPart.empty(), E_INVALIDARG,
+                 "-stripparts and -extractpart can't be combined");
+      DxaPartBatch batch(StripParts, ExtractPart);
+      unsigned ThreadCount = Jobs ? Jobs : std::thread::hardware_concurrency();
+      retVal = batch.Run(Paths, RelPaths, ThreadCount);
+    }
+    else if (ListParts) {
       pStage = "Listing parts";
       context.ListParts();
     }
@@ -390,5 +780,5 @@ int __cdecl main(int argc, _In_reads_z_(argc) char **argv) {
     return 1;
   }
 
-  return 0;
+  return retVal;
 }
\ No newline at end of file
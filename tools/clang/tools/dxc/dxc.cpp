@@ -59,6 +59,8 @@
 #include "llvm/Support/MemoryBuffer.h"
 #include <dia2.h>
 #include <comdef.h>
+#include <fcntl.h>
+#include <io.h>
 #include <algorithm>
 #include <unordered_map>
 
@@ -165,6 +167,7 @@ private:
   DxcDllSupport &m_dxcSupport;
   NoSerializeHeapMalloc m_Malloc;
   HANDLE m_MallocHeap;
+  std::string *m_pDiagnostics;
 
   int ActOnBlob(IDxcBlob *pBlob);
   int ActOnBlob(IDxcBlob *pBlob, IDxcBlob *pDebugBlob, LPCWSTR pDebugBlobName);
@@ -178,7 +181,10 @@ private:
   HRESULT GetDxcDiaTable(IDxcLibrary *pLibrary, IDxcBlob *pTargetBlob, IDiaTable **ppTable, LPCWSTR tableName);
   HRESULT FindModuleBlob(hlsl::DxilFourCC fourCC, IDxcBlob *pSource, IDxcLibrary *pLibrary, IDxcBlob **ppTargetBlob);
   void ExtractRootSignature(IDxcBlob *pBlob, IDxcBlob **ppResult);
+  void WriteCostReport(IDxcBlob *pBlob);
   int VerifyRootSignature();
+  void WriteOperationErrors(IDxcOperationResult *pResult);
+  void WriteMessage(const char *pMessage);
 
   template <typename TInterface>
   HRESULT CreateInstance(REFCLSID clsid, _Outptr_ TInterface** pResult) {
@@ -190,16 +196,28 @@ private:
 
 public:
   DxcContext(DxcOpts &Opts, DxcDllSupport &dxcSupport)
-      : m_Opts(Opts), m_dxcSupport(dxcSupport), m_MallocHeap(nullptr) {
+      : m_Opts(Opts), m_dxcSupport(dxcSupport), m_MallocHeap(nullptr),
+        m_pDiagnostics(nullptr) {
     if (m_dxcSupport.HasCreateWithMalloc()) {
-      m_MallocHeap = HeapCreate(HEAP_NO_SERIALIZE, 1024 * 1024 * 2, 0);
+      // We never free the heap because it's tied to the dxc process lifetime;
+      // share it so that a server creating a context per request doesn't
+      // create a heap per request.
+      static HANDLE s_MallocHeap;
+      if (s_MallocHeap == NULL)
+        s_MallocHeap = HeapCreate(HEAP_NO_SERIALIZE, 1024 * 1024 * 2, 0);
+      m_MallocHeap = s_MallocHeap;
       if (m_MallocHeap == NULL)
         IFT_Data(HRESULT_FROM_WIN32(GetLastError()), L"unable to create custom heap");
       m_Malloc.SetHandle(m_MallocHeap);
-      // We never free the heap because it's tied to the dxc process lifetime
     }
   }
 
+  // Collects the messages that would go to the console in pDiagnostics
+  // instead.
+  void CaptureDiagnostics(std::string *pDiagnostics) {
+    m_pDiagnostics = pDiagnostics;
+  }
+
   int  Compile();
   void Recompile(IDxcBlob *pSource, IDxcLibrary *pLibrary, IDxcCompiler *pCompiler, std::vector<LPCWSTR> &args, IDxcOperationResult **pCompileResult);
   int DumpBinary();
@@ -296,11 +314,16 @@ int DxcContext::ActOnBlob(IDxcBlob *pBlob, IDxcBlob *pDebugBlob, LPCWSTR pDebugB
     WritePartToFile(pBlob, hlsl::DFCC_PrivateData, m_Opts.ExtractPrivateFile);
   }
 
+  // Estimate and write the cost of each entry point.
+  if (!m_Opts.CostReportFile.empty() && !m_Opts.IsRootSignatureProfile()) {
+    WriteCostReport(pBlob);
+  }
+
   // OutputObject suppresses console dump.
   bool needDisassembly =
       !m_Opts.OutputHeader.empty() || !m_Opts.AssemblyCode.empty() ||
       (m_Opts.OutputObject.empty() && m_Opts.DebugFile.empty() &&
-       m_Opts.ExtractPrivateFile.empty() &&
+       m_Opts.ExtractPrivateFile.empty() && m_Opts.CostReportFile.empty() &&
        m_Opts.VerifyRootSignatureSource.empty() && !m_Opts.ExtractRootSignature);
 
   if (!needDisassembly)
@@ -415,7 +438,7 @@ void DxcContext::UpdatePart(IDxcBlob *pSource, IDxcBlob **ppResult) {
     }
   }
   else {
-    WriteOperationErrorsToConsole(pBuilderResult, m_Opts.OutputWarnings);
+    WriteOperationErrors(pBuilderResult);
   }
   HRESULT status;
   IFT(pBuilderResult->GetStatus(&status));
@@ -446,12 +469,10 @@ HRESULT DxcContext::ReadFileIntoPartContent(hlsl::DxilFourCC fourCC, LPCWSTR fil
   // If root signature, check if it's a dxil container that contains rootsignature part, then construct a blob of root signature part
   if (fourCC == hlsl::DxilFourCC::DFCC_RootSignature) {
     CComPtr<IDxcBlob> pResult;
-    CComHeapPtr<BYTE> pData;
-    DWORD dataSize;
-    hlsl::ReadBinaryFile(fileName, (void**)&pData, &dataSize);
-    DXASSERT(pData != nullptr, "otherwise ReadBinaryFile should throw an exception");
-    hlsl::DxilContainerHeader *pHeader = (hlsl::DxilContainerHeader*) pData.m_pData;
-    IFRBOOL(hlsl::IsDxilContainerLike(pHeader, pHeader->ContainerSizeInBytes), E_INVALIDARG);
+    CComPtr<IDxcBlobEncoding> pData;
+    ReadFileIntoBlobMapped(fileName, &pData);
+    hlsl::DxilContainerHeader *pHeader = (hlsl::DxilContainerHeader*) pData->GetBufferPointer();
+    IFRBOOL(hlsl::IsDxilContainerLike(pHeader, pData->GetBufferSize()), E_INVALIDARG);
     hlsl::DxilPartHeader *pPartHeader = hlsl::GetDxilPartByType(pHeader, hlsl::DxilFourCC::DFCC_RootSignature);
     IFRBOOL(pPartHeader != nullptr, E_INVALIDARG);
     hlsl::DxcCreateBlobOnHeapCopy(hlsl::GetDxilPartData(pPartHeader), pPartHeader->PartSize, &pResult);
@@ -463,6 +484,26 @@ HRESULT DxcContext::ReadFileIntoPartContent(hlsl::DxilFourCC fourCC, LPCWSTR fil
 // Constructs a dxil container builder with only root signature part.
 // Right now IDxcContainerBuilder assumes that we are building a full dxil container,
 // but we are building a container with only rootsignature part
+// Writes the cost estimate the disassembler prints for each entry point to
+// the /Fcost file.
+void DxcContext::WriteCostReport(IDxcBlob *pBlob) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcDisassembler> pDisassembler;
+  IFT(CreateInstance(CLSID_DxcCompiler, &pCompiler));
+  IFT(pCompiler.QueryInterface(&pDisassembler));
+
+  CComPtr<IMalloc> pMalloc;
+  CComPtr<hlsl::AbstractMemoryStream> pStream;
+  IFT(CoGetMalloc(1, &pMalloc));
+  IFT(hlsl::CreateMemoryStream(pMalloc, &pStream));
+  IFT(pDisassembler->DisassembleToStream(pBlob, DxcDisassembleFlags_CostOnly,
+                                         nullptr, pStream));
+
+  CComPtr<IDxcBlob> pReport;
+  IFT(pStream.QueryInterface(&pReport));
+  WriteBlobToFile(pReport, m_Opts.CostReportFile);
+}
+
 void DxcContext::ExtractRootSignature(IDxcBlob *pBlob, IDxcBlob **ppResult) {
   
   DXASSERT_NOMSG(pBlob != nullptr && ppResult != nullptr);
@@ -508,7 +549,7 @@ void DxcContext::ExtractRootSignature(IDxcBlob *pBlob, IDxcBlob **ppResult) {
 int DxcContext::VerifyRootSignature() {
   // Get dxil container from file
   CComPtr<IDxcBlobEncoding> pSource;
-  ReadFileIntoBlob(m_dxcSupport, StringRefUtf16(m_Opts.InputFile), &pSource);
+  ReadFileIntoBlobMapped(StringRefUtf16(m_Opts.InputFile), &pSource);
   hlsl::DxilContainerHeader *pSourceHeader = (hlsl::DxilContainerHeader *)pSource->GetBufferPointer();
   IFTBOOLMSG(hlsl::IsValidDxilContainer(pSourceHeader, pSourceHeader->ContainerSizeInBytes), E_INVALIDARG, "invalid DXIL container to verify.");
 
@@ -541,16 +582,40 @@ int DxcContext::VerifyRootSignature() {
       WriteBlobToFile(pErrors, m_Opts.OutputWarningsFile);
     }
     else {
-      WriteOperationErrorsToConsole(pOperationResult, m_Opts.OutputWarnings);
+      WriteOperationErrors(pOperationResult);
     }
     return 1;
   }
   else {
-    printf("root signature verification succeeded.");
+    WriteMessage("root signature verification succeeded.");
     return 0;
   }
 }
 
+void DxcContext::WriteOperationErrors(IDxcOperationResult *pResult) {
+  if (m_pDiagnostics == nullptr) {
+    WriteOperationErrorsToConsole(pResult, m_Opts.OutputWarnings);
+    return;
+  }
+  HRESULT status;
+  IFT(pResult->GetStatus(&status));
+  if (FAILED(status) || m_Opts.OutputWarnings) {
+    CComPtr<IDxcBlobEncoding> pErrors;
+    IFT(pResult->GetErrorBuffer(&pErrors));
+    if (pErrors.p != nullptr) {
+      m_pDiagnostics->append((const char *)pErrors->GetBufferPointer(),
+                             pErrors->GetBufferSize());
+    }
+  }
+}
+
+void DxcContext::WriteMessage(const char *pMessage) {
+  if (m_pDiagnostics != nullptr)
+    m_pDiagnostics->append(pMessage);
+  else
+    printf("%s", pMessage);
+}
+
 class DxcIncludeHandlerForInjectedSources : public IDxcIncludeHandler {
 private:
   DXC_MICROCOM_REF_FIELD(m_dwRef)
@@ -766,6 +831,12 @@ int DxcContext::Compile() {
     if (m_Opts.RecompileFromBinary) {
       Recompile(pSource, pLibrary, pCompiler, args, &pCompileResult);
     }
+    else if (m_Opts.FromBundle) {
+      CComPtr<IDxcCompilerBundle> pCompilerBundle;
+      IFT(pCompiler.QueryInterface(&pCompilerBundle));
+      IFT(pCompilerBundle->CompileBundle(pSource, &pCompileResult, nullptr,
+                                         nullptr));
+    }
     else {
       CComPtr<IDxcIncludeHandler> pIncludeHandler;
       IFT(pLibrary->CreateIncludeHandler(&pIncludeHandler));
@@ -777,7 +848,29 @@ int DxcContext::Compile() {
         TargetProfile = hlsl::ShaderModel::Get(SM->GetKind(), 6, 0)->GetName();
       }
 
-      if (!m_Opts.DebugFile.empty() && m_Opts.DebugFile.endswith(llvm::StringRef("\\"))) {
+      bool debugToDirectory = !m_Opts.DebugFile.empty() &&
+                              m_Opts.DebugFile.endswith(llvm::StringRef("\\"));
+      if (!m_Opts.OutputBundle.empty()) {
+        // The bundle is written even if the compile fails, to reproduce it.
+        if (debugToDirectory)
+          args.push_back(L"/Qstrip_debug"); // implied
+        CComPtr<IDxcCompilerBundle> pCompilerBundle;
+        CComPtr<IDxcBlob> pBundle;
+        CComHeapPtr<WCHAR> pDebugName;
+        IFT(pCompiler.QueryInterface(&pCompilerBundle));
+        IFT(pCompilerBundle->CompileAndCaptureBundle(
+            pSource, StringRefUtf16(m_Opts.InputFile),
+            StringRefUtf16(m_Opts.EntryPoint), StringRefUtf16(TargetProfile),
+            args.data(), args.size(), m_Opts.Defines.data(),
+            m_Opts.Defines.size(), pIncludeHandler, &pCompileResult,
+            debugToDirectory ? &pDebugName : nullptr,
+            debugToDirectory ? &pDebugBlob : nullptr, &pBundle));
+        WriteBlobToFile(pBundle, m_Opts.OutputBundle);
+        if (pDebugName.m_pData) {
+          Unicode::UTF8ToUTF16String(m_Opts.DebugFile.str().c_str(), &debugName);
+          debugName += pDebugName.m_pData;
+        }
+      } else if (debugToDirectory) {
         args.push_back(L"/Qstrip_debug"); // implied
         CComPtr<IDxcCompiler2> pCompiler2;
         CComHeapPtr<WCHAR> pDebugName;
@@ -808,7 +901,7 @@ int DxcContext::Compile() {
     WriteBlobToFile(pErrors, m_Opts.OutputWarningsFile);
   }
   else {
-    WriteOperationErrorsToConsole(pCompileResult, m_Opts.OutputWarnings);
+    WriteOperationErrors(pCompileResult);
   }
 
   HRESULT status;
@@ -827,7 +920,11 @@ int DxcContext::Compile() {
 
 int DxcContext::DumpBinary() {
   CComPtr<IDxcBlobEncoding> pSource;
-  ReadFileIntoBlob(m_dxcSupport, StringRefUtf16(m_Opts.InputFile), &pSource);
+  // A mapped input can't be overwritten, so copy it when writing an output.
+  if (m_Opts.OutputObject.empty())
+    ReadFileIntoBlobMapped(StringRefUtf16(m_Opts.InputFile), &pSource);
+  else
+    ReadFileIntoBlob(m_dxcSupport, StringRefUtf16(m_Opts.InputFile), &pSource);
   return ActOnBlob(pSource.p);
 }
 
@@ -846,7 +943,7 @@ void DxcContext::Preprocess() {
   ReadFileIntoBlob(m_dxcSupport, StringRefUtf16(m_Opts.InputFile), &pSource);
   IFT(CreateInstance(CLSID_DxcCompiler, &pCompiler));
   IFT(pCompiler->Preprocess(pSource, StringRefUtf16(m_Opts.InputFile), args.data(), args.size(), m_Opts.Defines.data(), m_Opts.Defines.size(), pIncludeHandler, &pPreprocessResult));
-  WriteOperationErrorsToConsole(pPreprocessResult, m_Opts.OutputWarnings);
+  WriteOperationErrors(pPreprocessResult);
 
   HRESULT status;
   IFT(pPreprocessResult->GetStatus(&status));
@@ -934,6 +1031,19 @@ HRESULT DxcContext::FindModuleBlob(hlsl::DxilFourCC fourCC, IDxcBlob *pSource, I
   if (fourCC == pDxilPartHeader->PartFourCC) {
     UINT32 pBlobSize;
     hlsl::DxilProgramHeader *pDxilProgramHeader = (hlsl::DxilProgramHeader*)(pDxilPartHeader + 1);
+    if (hlsl::IsCompressedDxilProgramHeader(pDxilProgramHeader,
+                                            pDxilPartHeader->PartSize)) {
+      std::vector<char> bitcode;
+      IFTBOOL(hlsl::GetDecompressedDxilProgramBitcode(
+                  pDxilProgramHeader, pDxilPartHeader->PartSize, bitcode,
+                  &pBitcode, &pBlobSize),
+              DXC_E_CONTAINER_INVALID);
+      CComPtr<IDxcBlobEncoding> pBitcodeBlob;
+      IFR(pLibrary->CreateBlobWithEncodingOnHeapCopy(pBitcode, pBlobSize,
+                                                     CP_ACP, &pBitcodeBlob));
+      *ppTargetBlob = pBitcodeBlob.Detach();
+      return S_OK;
+    }
     hlsl::GetDxilProgramBitcode(pDxilProgramHeader, &pBitcode, &pBlobSize);
     UINT32 offset = (UINT32)(pBitcode - (const char *)pSource->GetBufferPointer());
     pLibrary->CreateBlobFromBlob(pSource, offset, pBlobSize, ppTargetBlob);
@@ -974,6 +1084,157 @@ HRESULT DxcContext::GetDxcDiaTable(IDxcLibrary *pLibrary, IDxcBlob *pTargetBlob,
   return S_OK;
 }
 
+static std::string GetExceptionMessage(const ::hlsl::Exception &hlslException) {
+  const char *msg = hlslException.what();
+  if (msg != nullptr && *msg != '\0')
+    return msg;
+  Unicode::acp_char printBuffer[128]; // printBuffer is safe to treat as
+                                      // UTF-8 because we use ASCII only errors
+  if (hlslException.hr == DXC_E_DUPLICATE_PART) {
+    sprintf_s(
+        printBuffer, _countof(printBuffer),
+        "dxc failed : DXIL container already contains the given part.");
+  } else if (hlslException.hr == DXC_E_MISSING_PART) {
+    sprintf_s(
+        printBuffer, _countof(printBuffer),
+        "dxc failed : DXIL container does not contain the given part.");
+  } else if (hlslException.hr == DXC_E_CONTAINER_INVALID) {
+    sprintf_s(printBuffer, _countof(printBuffer),
+              "dxc failed : Invalid DXIL container.");
+  } else if (hlslException.hr == DXC_E_CONTAINER_MISSING_DXIL) {
+    sprintf_s(printBuffer, _countof(printBuffer),
+              "dxc failed : DXIL container is missing DXIL part.");
+  } else if (hlslException.hr == DXC_E_CONTAINER_MISSING_DEBUG) {
+    sprintf_s(printBuffer, _countof(printBuffer),
+              "dxc failed : DXIL container is missing Debug Info part.");
+  } else if (hlslException.hr == E_OUTOFMEMORY) {
+    sprintf_s(printBuffer, _countof(printBuffer),
+              "dxc failed : Out of Memory.");
+  } else if (hlslException.hr == E_INVALIDARG) {
+    sprintf_s(printBuffer, _countof(printBuffer),
+              "dxc failed : Invalid argument.");
+  } else {
+    sprintf_s(printBuffer, _countof(printBuffer),
+      "dxc failed : error code 0x%08x.\n", hlslException.hr);
+  }
+  return printBuffer;
+}
+
+// Returns true if acting on the options would write the program, its
+// disassembly or a dump to the console.
+static bool WritesResultToConsole(const DxcOpts &opts) {
+  if (!opts.Preprocess.empty())
+    return false;
+  if (opts.AstDump || opts.OptDump)
+    return true;
+  return opts.OutputHeader.empty() && opts.AssemblyCode.empty() &&
+         opts.OutputObject.empty() && opts.DebugFile.empty() &&
+         opts.ExtractPrivateFile.empty() && opts.CostReportFile.empty() &&
+         opts.VerifyRootSignatureSource.empty() && !opts.ExtractRootSignature;
+}
+
+// Runs one server request, given as the arguments of a dxc invocation, and
+// returns the exit code dxc would have returned for it.
+static int RunServerRequest(const OptTable *optionTable,
+                            DxcDllSupport &dxcSupport,
+                            llvm::ArrayRef<llvm::StringRef> requestArgs,
+                            std::string &diagnostics) {
+  try {
+    MainArgs argStrings(requestArgs);
+    DxcOpts dxcOpts;
+    {
+      llvm::raw_string_ostream errorStream(diagnostics);
+      int optResult =
+          ReadDxcOpts(optionTable, DxcFlags, argStrings, dxcOpts, errorStream);
+      errorStream.flush();
+      if (optResult != 0)
+        return optResult;
+    }
+    if (dxcOpts.Server || dxcOpts.ShowHelp || !dxcOpts.ExternalLib.empty()) {
+      diagnostics += "dxc failed : -server, -help and -external cannot be "
+                     "used in a server request.";
+      return 1;
+    }
+    if (WritesResultToConsole(dxcOpts)) {
+      diagnostics += "dxc failed : a server request must write its result to "
+                     "a file, for example with /Fo or /Fc.";
+      return 1;
+    }
+    if (dxcOpts.EntryPoint.empty() && !dxcOpts.RecompileFromBinary) {
+      dxcOpts.EntryPoint = "main";
+    }
+
+    DxcContext context(dxcOpts, dxcSupport);
+    context.CaptureDiagnostics(&diagnostics);
+    if (!dxcOpts.Preprocess.empty()) {
+      context.Preprocess();
+      return 0;
+    }
+    if (dxcOpts.DumpBin)
+      return context.DumpBinary();
+    return context.Compile();
+  } catch (const ::hlsl::Exception &hlslException) {
+    diagnostics += GetExceptionMessage(hlslException);
+  } catch (std::bad_alloc &) {
+    diagnostics += "dxc failed : Out of Memory.";
+  } catch (...) {
+    diagnostics += "dxc failed : unknown error.";
+  }
+  return 1;
+}
+
+// Serves compile requests from standard input until it is closed, so that a
+// build system pays for process startup and for loading dxcompiler and the
+// validator once rather than once per shader.
+//
+// Each request is one line of UTF-8 text holding the arguments of a dxc
+// invocation, without the program name, separated by tab characters so that
+// no quoting is needed. Empty lines are ignored; '\r' before the line feed is
+// dropped. Relative paths are resolved against the server's working
+// directory. A request must write its outputs to files (/Fo, /Fc, /Fh, /P
+// and so on); a request that would write them to the console is rejected.
+//
+// Each response is written to standard output as a header line
+//   dxc-response <exit-code> <byte-count>
+// followed by exactly byte-count bytes of UTF-8 diagnostics, which hold the
+// warnings and errors dxc would have written to the console. The exit code is
+// the one dxc would have returned for the same arguments. Requests are served
+// in order, one at a time, and each response is flushed before the next
+// request is read.
+//
+// The compiler is created afresh for every request; pass /compile-cache or
+// /include-cache in requests to share results and include files across them.
+static int RunServer(const OptTable *optionTable, DxcDllSupport &dxcSupport) {
+  // Byte counts must match what the client reads.
+  _setmode(_fileno(stdin), _O_BINARY);
+  _setmode(_fileno(stdout), _O_BINARY);
+
+  std::string line;
+  std::string diagnostics;
+  for (;;) {
+    line.clear();
+    int c;
+    while ((c = getchar()) != EOF && c != '\n')
+      line.push_back((char)c);
+    if (c == EOF && line.empty())
+      break;
+    if (!line.empty() && line.back() == '\r')
+      line.pop_back();
+    if (line.empty())
+      continue;
+
+    llvm::SmallVector<llvm::StringRef, 16> requestArgs;
+    llvm::StringRef(line).split(requestArgs, "\t", -1, false);
+    diagnostics.clear();
+    int exitCode =
+        RunServerRequest(optionTable, dxcSupport, requestArgs, diagnostics);
+    printf("dxc-response %d %u\n", exitCode, (unsigned)diagnostics.size());
+    fwrite(diagnostics.data(), 1, diagnostics.size(), stdout);
+    fflush(stdout);
+  }
+  return 0;
+}
+
 int __cdecl wmain(int argc, const wchar_t **argv_) {
   const char *pStage = "Operation";
   int retVal = 0;
@@ -1034,6 +1295,10 @@ int __cdecl wmain(int argc, const wchar_t **argv_) {
     }
 
     EnsureEnabled(dxcSupport);
+    if (dxcOpts.Server) {
+      pStage = "Serving requests";
+      return RunServer(optionTable, dxcSupport);
+    }
     DxcContext context(dxcOpts, dxcSupport);
     // TODO: implement all other actions.
     if (!dxcOpts.Preprocess.empty()) {
@@ -1050,41 +1315,8 @@ int __cdecl wmain(int argc, const wchar_t **argv_) {
     }
   } catch (const ::hlsl::Exception &hlslException) {
     try {
-      const char *msg = hlslException.what();
-      Unicode::acp_char printBuffer[128]; // printBuffer is safe to treat as
-                                          // UTF-8 because we use ASCII only errors
-      if (msg == nullptr || *msg == '\0') {
-        if (hlslException.hr == DXC_E_DUPLICATE_PART) {
-          sprintf_s(
-              printBuffer, _countof(printBuffer),
-              "dxc failed : DXIL container already contains the given part.");
-        } else if (hlslException.hr == DXC_E_MISSING_PART) {
-          sprintf_s(
-              printBuffer, _countof(printBuffer),
-              "dxc failed : DXIL container does not contain the given part.");
-        } else if (hlslException.hr == DXC_E_CONTAINER_INVALID) {
-          sprintf_s(printBuffer, _countof(printBuffer),
-                    "dxc failed : Invalid DXIL container.");
-        } else if (hlslException.hr == DXC_E_CONTAINER_MISSING_DXIL) {
-          sprintf_s(printBuffer, _countof(printBuffer),
-                    "dxc failed : DXIL container is missing DXIL part.");
-        } else if (hlslException.hr == DXC_E_CONTAINER_MISSING_DEBUG) {
-          sprintf_s(printBuffer, _countof(printBuffer),
-                    "dxc failed : DXIL container is missing Debug Info part.");
-        } else if (hlslException.hr == E_OUTOFMEMORY) {
-          sprintf_s(printBuffer, _countof(printBuffer),
-                    "dxc failed : Out of Memory.");
-        } else if (hlslException.hr == E_INVALIDARG) {
-          sprintf_s(printBuffer, _countof(printBuffer),
-                    "dxc failed : Invalid argument.");
-        } else {
-          sprintf_s(printBuffer, _countof(printBuffer),
-            "dxc failed : error code 0x%08x.\n", hlslException.hr);
-        }
-        msg = printBuffer;
-      }
-
-      WriteUtf8ToConsoleSizeT(msg, strlen(msg), STD_ERROR_HANDLE);
+      std::string msg = GetExceptionMessage(hlslException);
+      WriteUtf8ToConsoleSizeT(msg.data(), msg.size(), STD_ERROR_HANDLE);
       printf("\n");
     } catch (...) {
       printf("%s failed - unable to retrieve error message.\n", pStage);
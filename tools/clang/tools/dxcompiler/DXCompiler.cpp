@@ -14,8 +14,13 @@
 #include "dxc/Support/Global.h"
 #include "dxc/Support/WinIncludes.h"
 #include "dxc/Support/HLSLOptions.h"
+#include "dxc/HLSL/DxilRootSignature.h"
+#include "dxc/HLSL/DxilSignature.h"
 #include "dxcetw.h"
 #include "dxillib.h"
+#include "dxccompilecache.h"
+#include "dxcincremental.h"
+#include "dxcincludecache.h"
 
 namespace hlsl { HRESULT SetupRegistryPassForHLSL(); }
 
@@ -53,6 +58,14 @@ static HRESULT InitMaybeFail() throw() {
   fsSetup = true;
   IFC(hlsl::SetupRegistryPassForHLSL());
   IFC(DxilLibInitialize());
+  IFC(dxcutil::DxcCompileCache::Initialize());
+  IFC(dxcutil::DxcIncrementalCache::Initialize());
+  IFC(dxcutil::DxcIncludeCache::Initialize());
+  IFC(hlsl::RootSignatureCache::Initialize());
+  if (!hlsl::SignaturePackingCache::Initialize()) {
+    hr = E_OUTOFMEMORY;
+    goto Cleanup;
+  }
   if (hlsl::options::initHlslOptTable()) {
     hr = E_FAIL;
     goto Cleanup;
@@ -85,6 +98,11 @@ BOOL WINAPI DllMain(HINSTANCE hinstDLL, DWORD Reason, LPVOID reserved) {
   } else if (Reason == DLL_PROCESS_DETACH) {
     DxcEtw_DXCompilerShutdown_Start();
     DxcSetThreadMallocOrDefault(nullptr);
+    dxcutil::DxcCompileCache::Cleanup();
+    dxcutil::DxcIncrementalCache::Cleanup();
+    dxcutil::DxcIncludeCache::Cleanup();
+    hlsl::RootSignatureCache::Cleanup();
+    hlsl::SignaturePackingCache::Cleanup();
     ::hlsl::options::cleanupHlslOptTable();
     ::llvm::sys::fs::CleanupPerThreadFileSystem();
     ::llvm::llvm_shutdown();
@@ -18,6 +18,7 @@
 #include "dxc/Support/Global.h"
 #include "dxcetw.h"
 #include "dxillib.h"
+#include "dxcutil.h"
 #include <memory>
 
 HRESULT CreateDxcCompiler(_In_ REFIID riid, _Out_ LPVOID *ppv);
@@ -130,3 +131,18 @@ DxcCreateInstance2(
   DxcEtw_DXCompilerCreateInstance_Stop(hr);
   return hr;
 }
+
+DXC_API_IMPORT HRESULT __stdcall
+DxcWarmUp() {
+  DxcThreadMalloc TM(nullptr);
+  try {
+    // Whether dxil.dll is used, and the version of the validator compiles
+    // record, are decided once per process. Querying the version also leaves
+    // a validator in the pool for the first compile.
+    DxilLibIsEnabled();
+    unsigned major, minor;
+    dxcutil::GetValidatorVersion(&major, &minor);
+    return S_OK;
+  }
+  CATCH_CPP_RETURN_HRESULT();
+}
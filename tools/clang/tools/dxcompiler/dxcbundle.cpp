@@ -0,0 +1,290 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// dxcbundle.cpp                                                             //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Implements self-contained bundles of compile inputs for dxcompiler.       //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/Support/WinIncludes.h"
+#include "dxc/Support/Global.h"
+#include "dxc/Support/FileIOHelper.h"
+#include "dxc/Support/Unicode.h"
+#include "dxc/dxcapi.h"
+#include "dxcbundle.h"
+#include "llvm/ADT/StringRef.h"
+#include <unordered_map>
+
+using namespace llvm;
+using namespace hlsl;
+
+// A bundle is a header followed by its fields in the order below. Each field
+// is a little-endian UINT32, or a UINT32 byte count followed by that many
+// bytes; strings are UTF-8 without a terminator.
+//
+//   source name flag, source name, entry point, target profile,
+//   argument count, arguments,
+//   define count, defines (name, value flag, value),
+//   validator version flag, validator major, validator minor,
+//   source,
+//   file count, files (name, found flag, content)
+static const char BundleMagic[4] = { 'D', 'X', 'B', 'N' };
+static const UINT32 BundleVersion = 1;
+
+namespace {
+
+class BundleWriter {
+public:
+  std::string Data;
+
+  void AddUInt32(UINT32 value) {
+    Data.append((const char *)&value, sizeof(value));
+  }
+  void AddBytes(const void *pData, size_t size) {
+    IFTBOOL(size <= UINT32_MAX, DXC_E_DATA_TOO_LARGE);
+    AddUInt32((UINT32)size);
+    Data.append((const char *)pData, size);
+  }
+  void AddString(const std::wstring &value) {
+    std::string utf8 = Unicode::UTF16ToUTF8StringOrThrow(value.c_str());
+    AddBytes(utf8.data(), utf8.size());
+  }
+  void AddBlob(IDxcBlob *pBlob) {
+    AddBytes(pBlob->GetBufferPointer(), pBlob->GetBufferSize());
+  }
+};
+
+class BundleReader {
+public:
+  BundleReader(IDxcBlob *pBlob)
+      : m_pBlob(pBlob), m_pData((const char *)pBlob->GetBufferPointer()),
+        m_size(pBlob->GetBufferSize()), m_offset(0) {}
+
+  bool ReadMagic() {
+    if (m_size < sizeof(BundleMagic) ||
+        memcmp(m_pData, BundleMagic, sizeof(BundleMagic)) != 0)
+      return false;
+    m_offset = sizeof(BundleMagic);
+    return true;
+  }
+  bool ReadUInt32(UINT32 &value) {
+    if (m_size - m_offset < sizeof(value))
+      return false;
+    memcpy(&value, m_pData + m_offset, sizeof(value));
+    m_offset += sizeof(value);
+    return true;
+  }
+  bool ReadBytes(StringRef &value) {
+    UINT32 size;
+    if (!ReadUInt32(size) || m_size - m_offset < size)
+      return false;
+    value = StringRef(m_pData + m_offset, size);
+    m_offset += size;
+    return true;
+  }
+  bool ReadString(std::wstring &value) {
+    StringRef utf8;
+    return ReadBytes(utf8) &&
+           Unicode::UTF8ToUTF16String(utf8.data(), utf8.size(), &value);
+  }
+  // Reads UTF-8 content as a view into the bundle.
+  bool ReadBlob(CComPtr<IDxcBlob> &pContent) {
+    StringRef bytes;
+    if (!ReadBytes(bytes))
+      return false;
+    CComPtr<IDxcBlob> pRange;
+    CComPtr<IDxcBlobEncoding> pEncoded;
+    IFT(DxcCreateBlobFromBlob(m_pBlob, (UINT32)(bytes.data() - m_pData),
+                              (UINT32)bytes.size(), &pRange));
+    IFT(DxcCreateBlobWithEncodingSet(pRange, CP_UTF8, &pEncoded));
+    pContent = pEncoded.p;
+    return true;
+  }
+  bool AtEnd() const { return m_offset == m_size; }
+
+private:
+  IDxcBlob *m_pBlob;
+  const char *m_pData;
+  size_t m_size;
+  size_t m_offset;
+};
+
+// Resolves the files recorded in a bundle. Names the include handler didn't
+// resolve when the bundle was captured resolve to nothing again, and names
+// it was never asked for fail as a missing file would.
+class DxcBundleIncludeHandler : public IDxcIncludeHandler {
+private:
+  DXC_MICROCOM_TM_REF_FIELDS()
+  std::unordered_map<std::wstring, CComPtr<IDxcBlob>> m_files;
+public:
+  DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
+  DXC_MICROCOM_TM_CTOR(DxcBundleIncludeHandler)
+
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) {
+    return DoBasicQueryInterface<IDxcIncludeHandler>(this, iid, ppvObject);
+  }
+
+  void AddFiles(const dxcutil::DxcCompileBundle &bundle) {
+    for (const dxcutil::DxcCompileBundle::File &file : bundle.Files)
+      m_files[file.Name] = file.pContent;
+  }
+
+  __override HRESULT STDMETHODCALLTYPE LoadSource(
+    _In_ LPCWSTR pFilename,                                   // Candidate filename.
+    _COM_Outptr_result_maybenull_ IDxcBlob **ppIncludeSource  // Resultant source object for included file, nullptr if not found.
+    ) {
+    *ppIncludeSource = nullptr;
+    auto it = m_files.find(pFilename);
+    if (it == m_files.end())
+      return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+    return it->second.CopyTo(ppIncludeSource);
+  }
+};
+
+} // namespace
+
+namespace dxcutil {
+
+void DxcCompileBundle::SetRequest(LPCWSTR pSourceName, LPCWSTR pEntryPoint,
+                                  LPCWSTR pTargetProfile, LPCWSTR *pArguments,
+                                  UINT32 argCount, const DxcDefine *pDefines,
+                                  UINT32 defineCount) {
+  HasSourceName = pSourceName != nullptr;
+  SourceName = pSourceName ? pSourceName : L"";
+  EntryPoint = pEntryPoint;
+  TargetProfile = pTargetProfile;
+  Arguments.assign(pArguments, pArguments + argCount);
+  Defines.resize(defineCount);
+  for (UINT32 i = 0; i < defineCount; ++i) {
+    Defines[i].Name = pDefines[i].Name;
+    Defines[i].HasValue = pDefines[i].Value != nullptr;
+    Defines[i].Value = pDefines[i].Value ? pDefines[i].Value : L"";
+  }
+}
+
+std::vector<LPCWSTR> DxcCompileBundle::GetArguments() const {
+  std::vector<LPCWSTR> arguments;
+  arguments.reserve(Arguments.size());
+  for (const std::wstring &argument : Arguments)
+    arguments.push_back(argument.c_str());
+  return arguments;
+}
+
+std::vector<DxcDefine> DxcCompileBundle::GetDefines() const {
+  std::vector<DxcDefine> defines(Defines.size());
+  for (size_t i = 0; i < Defines.size(); ++i) {
+    defines[i].Name = Defines[i].Name.c_str();
+    defines[i].Value = Defines[i].HasValue ? Defines[i].Value.c_str() : nullptr;
+  }
+  return defines;
+}
+
+void WriteCompileBundle(const DxcCompileBundle &bundle, IDxcBlob **ppBlob) {
+  *ppBlob = nullptr;
+  BundleWriter writer;
+  writer.Data.append(BundleMagic, sizeof(BundleMagic));
+  writer.AddUInt32(BundleVersion);
+  writer.AddUInt32(bundle.HasSourceName);
+  writer.AddString(bundle.SourceName);
+  writer.AddString(bundle.EntryPoint);
+  writer.AddString(bundle.TargetProfile);
+  writer.AddUInt32((UINT32)bundle.Arguments.size());
+  for (const std::wstring &argument : bundle.Arguments)
+    writer.AddString(argument);
+  writer.AddUInt32((UINT32)bundle.Defines.size());
+  for (const DxcCompileBundle::Define &define : bundle.Defines) {
+    writer.AddString(define.Name);
+    writer.AddUInt32(define.HasValue);
+    writer.AddString(define.Value);
+  }
+  writer.AddUInt32(bundle.HasValidatorVersion);
+  writer.AddUInt32(bundle.ValidatorMajor);
+  writer.AddUInt32(bundle.ValidatorMinor);
+  writer.AddBlob(bundle.pSource);
+  writer.AddUInt32((UINT32)bundle.Files.size());
+  for (const DxcCompileBundle::File &file : bundle.Files) {
+    writer.AddString(file.Name);
+    writer.AddUInt32(file.pContent != nullptr);
+    if (file.pContent != nullptr)
+      writer.AddBlob(file.pContent);
+    else
+      writer.AddBytes("", 0);
+  }
+  IFTBOOL(writer.Data.size() <= UINT32_MAX, DXC_E_DATA_TOO_LARGE);
+  IFT(DxcCreateBlobOnHeapCopy(writer.Data.data(), (UINT32)writer.Data.size(),
+                              ppBlob));
+}
+
+bool ReadCompileBundle(IDxcBlob *pBlob, DxcCompileBundle &bundle) {
+  BundleReader reader(pBlob);
+  UINT32 version, flag, count;
+  if (!reader.ReadMagic() || !reader.ReadUInt32(version) ||
+      version != BundleVersion)
+    return false;
+  if (!reader.ReadUInt32(flag) || !reader.ReadString(bundle.SourceName) ||
+      !reader.ReadString(bundle.EntryPoint) ||
+      !reader.ReadString(bundle.TargetProfile))
+    return false;
+  bundle.HasSourceName = flag != 0;
+
+  if (!reader.ReadUInt32(count))
+    return false;
+  bundle.Arguments.clear();
+  for (UINT32 i = 0; i < count; ++i) {
+    std::wstring argument;
+    if (!reader.ReadString(argument))
+      return false;
+    bundle.Arguments.emplace_back(std::move(argument));
+  }
+
+  if (!reader.ReadUInt32(count))
+    return false;
+  bundle.Defines.clear();
+  for (UINT32 i = 0; i < count; ++i) {
+    DxcCompileBundle::Define define;
+    if (!reader.ReadString(define.Name) || !reader.ReadUInt32(flag) ||
+        !reader.ReadString(define.Value))
+      return false;
+    define.HasValue = flag != 0;
+    bundle.Defines.emplace_back(std::move(define));
+  }
+
+  if (!reader.ReadUInt32(flag) || !reader.ReadUInt32(bundle.ValidatorMajor) ||
+      !reader.ReadUInt32(bundle.ValidatorMinor))
+    return false;
+  bundle.HasValidatorVersion = flag != 0;
+
+  bundle.pSource.Release();
+  if (!reader.ReadBlob(bundle.pSource) || !reader.ReadUInt32(count))
+    return false;
+  bundle.Files.clear();
+  for (UINT32 i = 0; i < count; ++i) {
+    DxcCompileBundle::File file;
+    if (!reader.ReadString(file.Name) || !reader.ReadUInt32(flag) ||
+        !reader.ReadBlob(file.pContent))
+      return false;
+    if (flag == 0)
+      file.pContent.Release();
+    bundle.Files.emplace_back(std::move(file));
+  }
+  return reader.AtEnd();
+}
+
+HRESULT CreateBundleIncludeHandler(const DxcCompileBundle &bundle,
+                                   IDxcIncludeHandler **ppHandler) {
+  *ppHandler = nullptr;
+  CComPtr<DxcBundleIncludeHandler> pHandler =
+      DxcBundleIncludeHandler::Alloc(DxcGetThreadMallocNoRef());
+  IFROOM(pHandler.p);
+  try {
+    pHandler->AddFiles(bundle);
+  }
+  CATCH_CPP_RETURN_HRESULT();
+  *ppHandler = pHandler.Detach();
+  return S_OK;
+}
+
+} // namespace dxcutil
@@ -0,0 +1,80 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// dxcbundle.h                                                               //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Provides self-contained bundles of compile inputs for dxcompiler.         //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "dxc/dxcapi.h"
+#include "dxc/Support/microcom.h"
+#include <string>
+#include <vector>
+
+namespace dxcutil {
+
+/// Everything a compile reads: the request itself, the validator version it
+/// targeted, and every file the include handler was asked for.
+///
+/// Files are kept under the names the include handler was asked for, so a
+/// bundle only replays with the source name and arguments it was captured
+/// with; those are part of the bundle.
+struct DxcCompileBundle {
+  struct Define {
+    std::wstring Name;
+    bool HasValue = false;
+    std::wstring Value;
+  };
+  struct File {
+    std::wstring Name;
+    CComPtr<IDxcBlob> pContent; // UTF-8; null if the handler didn't resolve it.
+  };
+
+  CComPtr<IDxcBlob> pSource; // UTF-8.
+  bool HasSourceName = false;
+  std::wstring SourceName;
+  std::wstring EntryPoint;
+  std::wstring TargetProfile;
+  std::vector<std::wstring> Arguments;
+  std::vector<Define> Defines;
+  bool HasValidatorVersion = false;
+  UINT32 ValidatorMajor = 0;
+  UINT32 ValidatorMinor = 0;
+  std::vector<File> Files;
+
+  // Records the request; the source, files and validator version are
+  // recorded once the compile has run.
+  void SetRequest(_In_opt_ LPCWSTR pSourceName, _In_ LPCWSTR pEntryPoint,
+                  _In_ LPCWSTR pTargetProfile,
+                  _In_count_(argCount) LPCWSTR *pArguments, UINT32 argCount,
+                  _In_count_(defineCount) const DxcDefine *pDefines,
+                  UINT32 defineCount);
+
+  // Views of the request, valid while the bundle is unchanged.
+  LPCWSTR GetSourceName() const {
+    return HasSourceName ? SourceName.c_str() : nullptr;
+  }
+  std::vector<LPCWSTR> GetArguments() const;
+  std::vector<DxcDefine> GetDefines() const;
+};
+
+// Serializes bundle into a blob allocated from the thread's allocator.
+void WriteCompileBundle(const DxcCompileBundle &bundle,
+                        _COM_Outptr_ IDxcBlob **ppBlob);
+
+// Reads a bundle written by WriteCompileBundle; the contents of the source
+// and files are views into pBlob. Returns false if pBlob isn't a bundle of
+// this version.
+bool ReadCompileBundle(_In_ IDxcBlob *pBlob, DxcCompileBundle &bundle);
+
+// Creates an include handler that resolves exactly the files recorded in
+// bundle, and nothing else.
+HRESULT CreateBundleIncludeHandler(const DxcCompileBundle &bundle,
+                                   _COM_Outptr_ IDxcIncludeHandler **ppHandler);
+
+} // namespace dxcutil
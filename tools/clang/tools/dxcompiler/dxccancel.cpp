@@ -0,0 +1,53 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// dxccancel.cpp                                                             //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Stops a compile that was cancelled or ran past its deadline.              //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxccancel.h"
+#include "dxc/Support/Global.h"
+#include "dxc/Support/ErrorCodes.h"
+
+namespace dxcutil {
+
+DxcCompileCanceller::DxcCompileCanceller(
+    const std::atomic<UINT64> *pCancelCount, UINT32 timeoutMs,
+    hlsl::CompilePhaseListener *pNext)
+    : m_pCancelCount(pCancelCount), m_startCancelCount(pCancelCount->load()),
+      m_hasDeadline(timeoutMs != 0),
+      m_deadline(std::chrono::steady_clock::now() +
+                 std::chrono::milliseconds(timeoutMs)),
+      m_pNext(pNext) {}
+
+void DxcCompileCanceller::ThrowIfStopped() {
+  if (m_pCancelCount->load(std::memory_order_relaxed) != m_startCancelCount)
+    throw hlsl::Exception(DXC_E_COMPILE_CANCELLED);
+  if (m_hasDeadline && std::chrono::steady_clock::now() >= m_deadline)
+    throw hlsl::Exception(DXC_E_COMPILE_TIMEOUT);
+}
+
+// Checks before passing the phase on, so that listeners further down never
+// see a phase start that doesn't finish.
+void DxcCompileCanceller::phaseStarted(const char *pName) {
+  ThrowIfStopped();
+  if (m_pNext)
+    m_pNext->phaseStarted(pName);
+}
+
+void DxcCompileCanceller::phaseFinished(const char *pName) {
+  if (m_pNext)
+    m_pNext->phaseFinished(pName);
+}
+
+void DxcCompileCanceller::checkpoint() {
+  ThrowIfStopped();
+  if (m_pNext)
+    m_pNext->checkpoint();
+}
+
+} // namespace dxcutil
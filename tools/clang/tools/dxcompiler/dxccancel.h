@@ -0,0 +1,49 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// dxccancel.h                                                               //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Stops a compile that was cancelled or ran past its deadline.              //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "dxc/Support/WinIncludes.h"
+#include "dxc/Support/CompilePhaseListener.h"
+#include <atomic>
+#include <chrono>
+
+namespace dxcutil {
+
+/// Abandons a compile once it is cancelled or runs past its deadline, by
+/// throwing DXC_E_COMPILE_CANCELLED or DXC_E_COMPILE_TIMEOUT at the next
+/// phase start or checkpoint. The exception unwinds to the compile entry
+/// point, freeing the compile state on the way, and becomes its HRESULT.
+///
+/// The compile is cancelled once *pCancelCount no longer has the value it had
+/// when the canceller was created, so cancelling only affects compiles that
+/// are already running. Phases are then passed on to pNext if there is one.
+class DxcCompileCanceller : public hlsl::CompilePhaseListener {
+public:
+  DxcCompileCanceller(_In_ const std::atomic<UINT64> *pCancelCount,
+                      UINT32 timeoutMs,
+                      _In_opt_ hlsl::CompilePhaseListener *pNext);
+
+  void phaseStarted(const char *pName) override;
+  void phaseFinished(const char *pName) override;
+  void checkpoint() override;
+
+private:
+  void ThrowIfStopped();
+
+  const std::atomic<UINT64> *m_pCancelCount;
+  UINT64 m_startCancelCount;
+  bool m_hasDeadline;
+  std::chrono::steady_clock::time_point m_deadline;
+  hlsl::CompilePhaseListener *m_pNext;
+};
+
+} // namespace dxcutil
@@ -0,0 +1,264 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// dxccompilecache.cpp                                                       //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Implements the process-wide cache of compile results for dxcompiler.      //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/Support/WinIncludes.h"
+#include "dxc/Support/Global.h"
+#include "dxc/Support/FileIOHelper.h"
+#include "dxc/Support/dxcfilesystem.h"
+#include "dxc/dxcapi.h"
+#include "dxccompilecache.h"
+#include "llvm/ADT/ArrayRef.h"
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+using namespace llvm;
+using namespace hlsl;
+
+namespace dxcutil {
+
+void DxcCompileCacheKeyBuilder::AddBytes(const void *pData, size_t size) {
+  uint64_t size64 = size;
+  m_md5.update(ArrayRef<uint8_t>((const uint8_t *)&size64, sizeof(size64)));
+  if (size)
+    m_md5.update(ArrayRef<uint8_t>((const uint8_t *)pData, size));
+}
+
+void DxcCompileCacheKeyBuilder::AddString(StringRef value) {
+  AddBytes(value.data(), value.size());
+}
+
+void DxcCompileCacheKeyBuilder::AddWString(LPCWSTR pValue) {
+  if (pValue == nullptr) {
+    // Distinguish a missing value from an empty one.
+    AddUInt32(UINT32_MAX);
+    return;
+  }
+  AddBytes(pValue, wcslen(pValue) * sizeof(wchar_t));
+}
+
+void DxcCompileCacheKeyBuilder::AddBlob(IDxcBlob *pBlob) {
+  if (pBlob == nullptr) {
+    AddUInt32(UINT32_MAX);
+    return;
+  }
+  AddBytes(pBlob->GetBufferPointer(), pBlob->GetBufferSize());
+}
+
+void DxcCompileCacheKeyBuilder::AddUInt32(uint32_t value) {
+  m_md5.update(ArrayRef<uint8_t>((const uint8_t *)&value, sizeof(value)));
+}
+
+std::string DxcCompileCacheKeyBuilder::GetDigest() {
+  MD5::MD5Result result;
+  m_md5.final(result);
+  return std::string((const char *)result, sizeof(result));
+}
+
+} // namespace dxcutil
+
+namespace {
+
+using namespace dxcutil;
+
+// Digest of the UTF-8 content of an included file; empty if the file did not
+// resolve.
+std::string GetIncludeDigest(IDxcBlob *pBlob) {
+  if (pBlob == nullptr)
+    return std::string();
+  DxcCompileCacheKeyBuilder builder;
+  builder.AddBlob(pBlob);
+  return builder.GetDigest();
+}
+
+struct CompileCacheEntry {
+  struct Include {
+    std::wstring Name;
+    std::string Digest;
+  };
+  std::vector<Include> Includes;
+  CComPtr<IDxcBlob> pResult;
+  CComPtr<IDxcBlobEncoding> pErrors;
+  CComPtr<IDxcBlob> pDebugBlob;
+  std::wstring DebugBlobName;
+  bool HasDebugBlobName;
+};
+
+// Returns true if every include recorded in the entry resolves to the same
+// content through pFileSystem. The includes are loaded once: a compile that
+// follows a miss reads the content loaded here.
+bool AreIncludesUnchanged(const CompileCacheEntry &entry,
+                          DxcArgsFileSystem *pFileSystem) {
+  for (const CompileCacheEntry::Include &include : entry.Includes) {
+    CComPtr<IDxcBlob> pBlob;
+    if (FAILED(pFileSystem->PreloadInclude(include.Name.c_str(), &pBlob)))
+      return false;
+    if (GetIncludeDigest(pBlob) != include.Digest)
+      return false;
+  }
+  return true;
+}
+
+HRESULT CopyBlobToHeap(IDxcBlob *pBlob, IDxcBlob **ppCopy) {
+  *ppCopy = nullptr;
+  if (pBlob == nullptr)
+    return S_OK;
+  return DxcCreateBlobOnHeapCopy(pBlob->GetBufferPointer(),
+                                 pBlob->GetBufferSize(), ppCopy);
+}
+
+class CompileCacheImpl {
+public:
+  // Bound on the number of results kept; the oldest entries are dropped
+  // first once it is reached.
+  static const size_t MaxEntries = 4096;
+
+  std::shared_ptr<CompileCacheEntry> Find(const std::string &key) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_entries.find(key);
+    if (it == m_entries.end())
+      return nullptr;
+    return it->second;
+  }
+
+  void Insert(const std::string &key,
+              std::shared_ptr<CompileCacheEntry> entry) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_entries.find(key);
+    if (it != m_entries.end()) {
+      it->second = std::move(entry);
+      return;
+    }
+    if (m_entries.size() == MaxEntries) {
+      m_entries.erase(m_order.front());
+      m_order.pop_front();
+    }
+    m_entries[key] = std::move(entry);
+    m_order.push_back(key);
+  }
+
+private:
+  std::mutex m_mutex;
+  std::unordered_map<std::string, std::shared_ptr<CompileCacheEntry>> m_entries;
+  std::deque<std::string> m_order;
+};
+
+// Created by DxcCompileCache::Initialize when the library is loaded.
+CompileCacheImpl *g_pCompileCache;
+
+} // namespace
+
+namespace dxcutil {
+namespace DxcCompileCache {
+
+bool Lookup(const std::string &key, DxcArgsFileSystem *pFileSystem,
+            IDxcBlob **ppResult, IDxcBlobEncoding **ppErrors,
+            IDxcBlob **ppDebugBlob, LPWSTR *ppDebugBlobName) {
+  *ppResult = nullptr;
+  *ppErrors = nullptr;
+  if (ppDebugBlob)
+    *ppDebugBlob = nullptr;
+  if (ppDebugBlobName)
+    *ppDebugBlobName = nullptr;
+
+  // Cache storage is shared across compiler instances and their allocators.
+  DxcThreadMalloc TM(nullptr);
+  std::shared_ptr<CompileCacheEntry> entry = g_pCompileCache->Find(key);
+  if (!entry || !AreIncludesUnchanged(*entry, pFileSystem))
+    return false;
+
+  if (ppDebugBlobName && entry->HasDebugBlobName) {
+    CComHeapPtr<wchar_t> name;
+    size_t len = entry->DebugBlobName.size() + 1;
+    if (!name.Allocate(len))
+      return false;
+    memcpy(name.m_pData, entry->DebugBlobName.c_str(), len * sizeof(wchar_t));
+    *ppDebugBlobName = name.Detach();
+  }
+  if (ppDebugBlob && entry->pDebugBlob)
+    *ppDebugBlob = CComPtr<IDxcBlob>(entry->pDebugBlob).Detach();
+  *ppResult = CComPtr<IDxcBlob>(entry->pResult).Detach();
+  *ppErrors = CComPtr<IDxcBlobEncoding>(entry->pErrors).Detach();
+  return true;
+}
+
+void Insert(const std::string &key, DxcArgsFileSystem *pFileSystem,
+            IDxcBlob *pResult, IDxcBlobEncoding *pErrors, IDxcBlob *pDebugBlob,
+            LPCWSTR pDebugBlobName) {
+  DxcArgsFileSystem::IncludedFileList files;
+  pFileSystem->GetIncludedFiles(files);
+
+  DxcThreadMalloc TM(nullptr);
+  std::shared_ptr<CompileCacheEntry> entry =
+      std::make_shared<CompileCacheEntry>();
+  for (auto &file : files) {
+    CompileCacheEntry::Include include;
+    include.Name = file.first;
+    include.Digest = GetIncludeDigest(file.second);
+    entry->Includes.emplace_back(std::move(include));
+  }
+
+  IFT(CopyBlobToHeap(pResult, &entry->pResult));
+  IFT(CopyBlobToHeap(pDebugBlob, &entry->pDebugBlob));
+  if (pErrors != nullptr) {
+    IFT(DxcCreateBlobWithEncodingOnHeapCopy(pErrors->GetBufferPointer(),
+                                            pErrors->GetBufferSize(), CP_UTF8,
+                                            &entry->pErrors));
+  } else {
+    IFT(DxcCreateBlobWithEncodingOnHeapCopy("", 0, CP_UTF8, &entry->pErrors));
+  }
+  entry->HasDebugBlobName = pDebugBlobName != nullptr;
+  if (pDebugBlobName)
+    entry->DebugBlobName = pDebugBlobName;
+
+  g_pCompileCache->Insert(key, std::move(entry));
+}
+
+HRESULT Initialize() {
+  DXASSERT(g_pCompileCache == nullptr, "else double-init");
+  DxcThreadMalloc TM(nullptr);
+  g_pCompileCache = new (std::nothrow) CompileCacheImpl();
+  return g_pCompileCache ? S_OK : E_OUTOFMEMORY;
+}
+
+void Cleanup() {
+  DxcThreadMalloc TM(nullptr);
+  delete g_pCompileCache;
+  g_pCompileCache = nullptr;
+}
+
+} // namespace DxcCompileCache
+
+namespace DxcContainerCache {
+
+bool Lookup(const std::string &key, IDxcBlob **ppContainer) {
+  *ppContainer = nullptr;
+  DxcThreadMalloc TM(nullptr);
+  std::shared_ptr<CompileCacheEntry> entry = g_pCompileCache->Find(key);
+  if (!entry)
+    return false;
+  *ppContainer = CComPtr<IDxcBlob>(entry->pResult).Detach();
+  return true;
+}
+
+void Insert(const std::string &key, IDxcBlob *pContainer) {
+  DxcThreadMalloc TM(nullptr);
+  std::shared_ptr<CompileCacheEntry> entry =
+      std::make_shared<CompileCacheEntry>();
+  IFT(CopyBlobToHeap(pContainer, &entry->pResult));
+  entry->HasDebugBlobName = false;
+  g_pCompileCache->Insert(key, std::move(entry));
+}
+
+} // namespace DxcContainerCache
+} // namespace dxcutil
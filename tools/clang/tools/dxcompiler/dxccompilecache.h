@@ -0,0 +1,89 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// dxccompilecache.h                                                         //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Provides a process-wide cache of compile results for dxcompiler.          //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "dxc/dxcapi.h"
+#include "dxc/Support/microcom.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/MD5.h"
+#include <string>
+
+namespace dxcutil {
+
+class DxcArgsFileSystem;
+
+/// Builds the digest that identifies a compile request. Every value is
+/// length-prefixed so that adjacent values cannot alias each other.
+class DxcCompileCacheKeyBuilder {
+public:
+  void AddBytes(const void *pData, size_t size);
+  void AddString(llvm::StringRef value);
+  void AddWString(LPCWSTR pValue);
+  void AddBlob(IDxcBlob *pBlob);
+  void AddUInt32(uint32_t value);
+  std::string GetDigest();
+
+private:
+  llvm::MD5 m_md5;
+};
+
+/// Process-wide cache of successful compile results.
+///
+/// Entries are keyed on the content of the compile request (source, source
+/// name, entry point, profile, defines and normalized arguments). Each entry
+/// also records every file requested from the include handler, so a lookup
+/// only succeeds if all of them still resolve to the same content.
+///
+/// All storage owned by the cache is allocated from the default allocator,
+/// so entries may outlive the compiler object that produced them.
+namespace DxcCompileCache {
+
+// Returns true and the cached outputs if the request was seen before and its
+// includes are unchanged. The includes are loaded through pFileSystem, which
+// keeps them for the compile that follows a miss.
+bool Lookup(const std::string &key, _In_ DxcArgsFileSystem *pFileSystem,
+            _COM_Outptr_ IDxcBlob **ppResult,
+            _COM_Outptr_ IDxcBlobEncoding **ppErrors,
+            _COM_Outptr_result_maybenull_ IDxcBlob **ppDebugBlob,
+            _Outptr_result_maybenull_z_ LPWSTR *ppDebugBlobName);
+
+// Records the outputs of a successful compile along with the include files
+// resolved through pFileSystem.
+void Insert(const std::string &key, DxcArgsFileSystem *pFileSystem,
+            _In_ IDxcBlob *pResult, _In_opt_ IDxcBlobEncoding *pErrors,
+            _In_opt_ IDxcBlob *pDebugBlob, _In_opt_ LPCWSTR pDebugBlobName);
+
+// Creates the cache; called when the library is loaded.
+HRESULT Initialize();
+
+// Drops all cached entries; called when the library is unloaded.
+void Cleanup();
+
+} // namespace DxcCompileCache
+
+/// Process-wide cache of validated containers, which shares the storage of
+/// DxcCompileCache.
+///
+/// Entries are keyed on the bitcode of a finished DXIL module and on how it
+/// is assembled, so compiles whose modules come out identical share one
+/// container, whatever their sources were.
+namespace DxcContainerCache {
+
+// Returns true and the container recorded under key.
+bool Lookup(const std::string &key, _COM_Outptr_ IDxcBlob **ppContainer);
+
+// Records the container assembled and validated under key.
+void Insert(const std::string &key, _In_ IDxcBlob *pContainer);
+
+} // namespace DxcContainerCache
+
+} // namespace dxcutil
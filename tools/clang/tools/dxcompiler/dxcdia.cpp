@@ -141,20 +141,51 @@ static HRESULT CreateDxcDiaTable(DxcDiaSession *, DiaTableKind kind, IDiaTable *
 static HRESULT DxcDiaFindLineNumbersByRVA(DxcDiaSession *, DWORD rva, DWORD length, IDiaEnumLineNumbers **);
 
 class DxcDiaSession : public IDiaSession {
+public:
+  typedef unsigned RVA;
 private:
   DXC_MICROCOM_TM_REF_FIELDS()
   std::shared_ptr<llvm::LLVMContext> m_context;
   std::shared_ptr<llvm::Module> m_module;
-  std::shared_ptr<llvm::DebugInfoFinder> m_finder;
+  std::unique_ptr<llvm::DebugInfoFinder> m_finder; // Built on first use.
   std::unique_ptr<DxilModule> m_dxilModule;
   llvm::NamedMDNode *m_contents;
   llvm::NamedMDNode *m_defines;
   llvm::NamedMDNode *m_mainFileName;
   llvm::NamedMDNode *m_arguments;
-  std::vector<const Instruction *> m_instructions;
-  std::vector<const Instruction *> m_instructionLines; // Instructions with line info.
-  typedef unsigned RVA;
-  std::unordered_map<const Instruction *, RVA> m_rvaMap; // Map instruction to its RVA.
+  // The instruction tables are built on first use, so sessions that only
+  // read sources or symbols never walk the instructions.
+  bool m_instructionsBuilt = false;
+  std::vector<const Instruction *> m_instructions; // Indexed by RVA.
+  std::vector<RVA> m_instructionLines; // Ascending RVAs of instructions with line info.
+
+  void BuildInstructionTables() {
+    if (m_instructionsBuilt)
+      return;
+    std::vector<const Instruction *> instructions;
+    std::vector<RVA> instructionLines;
+    // Build up a linear list of instructions. The index will be used as the
+    // RVA. Debug instructions are ommitted from this enumeration.
+    for (const Function &fn : m_module->functions()) {
+      for (const_inst_iterator it = inst_begin(fn), end = inst_end(fn); it != end; ++it) {
+        const Instruction &i = *it;
+        if (const CallInst *call = dyn_cast<const CallInst>(&i)) {
+          const Function *pFn = call->getCalledFunction();
+          if (pFn && pFn->getName().startswith("llvm.dbg.")) {
+            continue;
+          }
+        }
+
+        if (i.getDebugLoc()) {
+          instructionLines.push_back(static_cast<RVA>(instructions.size()));
+        }
+        instructions.push_back(&i);
+      }
+    }
+    m_instructions.swap(instructions);
+    m_instructionLines.swap(instructionLines);
+    m_instructionsBuilt = true;
+  }
 public:
   DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
   DXC_MICROCOM_TM_CTOR(DxcDiaSession)
@@ -162,46 +193,19 @@ public:
   IMalloc *GetMallocNoRef() { return m_pMalloc.p; }
 
   void Init(std::shared_ptr<llvm::LLVMContext> context,
-      std::shared_ptr<llvm::Module> module,
-      std::shared_ptr<llvm::DebugInfoFinder> finder) {
+      std::shared_ptr<llvm::Module> module) {
     m_module = module;
     m_context = context;
-    m_finder = finder;
     m_dxilModule = std::make_unique<DxilModule>(module.get());
   
     // Extract HLSL metadata.
-    m_dxilModule->LoadDxilMetadata();
+    m_dxilModule->LoadDxilMetadata(/*bLazy*/true);
 
     // Get file contents.
     m_contents = m_module->getNamedMetadata("llvm.dbg.contents");
     m_defines = m_module->getNamedMetadata("llvm.dbg.defines");
     m_mainFileName = m_module->getNamedMetadata("llvm.dbg.mainFileName");
     m_arguments = m_module->getNamedMetadata("llvm.dbg.args");
-    // Build up a linear list of instructions. The index will be used as the
-    // RVA. Debug instructions are ommitted from this enumeration.
-    for (const Function &fn : m_module->functions()) {
-      for (const_inst_iterator it = inst_begin(fn), end = inst_end(fn); it != end; ++it) {
-        const Instruction &i = *it;
-        if (const CallInst *call = dyn_cast<const CallInst>(&i)) {
-          const Function *pFn = call->getCalledFunction();
-          if (pFn && pFn->getName().startswith("llvm.dbg.")) {
-            continue;
-          }
-        }
-
-        m_rvaMap.insert({ &i, static_cast<RVA>(m_instructions.size()) });
-        m_instructions.push_back(&i);
-        if (i.getDebugLoc()) {
-          m_instructionLines.push_back(&i);
-        }
-      }
-    }
-
-    // Sanity check to make sure rva map is same as instruction index.
-    for (size_t i = 0, e = m_instructions.size(); i < e; ++i) {
-      DXASSERT(m_rvaMap.find(m_instructions[i]) != m_rvaMap.end(), "instruction not mapped to rva");
-      DXASSERT(m_rvaMap[m_instructions[i]] == i, "instruction mapped to wrong rva");
-    }
   }
   llvm::NamedMDNode *Contents() { return m_contents; }
   llvm::NamedMDNode *Defines() { return m_defines; }
@@ -209,10 +213,23 @@ public:
   llvm::NamedMDNode *Arguments() { return m_arguments; }
   hlsl::DxilModule &DxilModuleRef() { return *m_dxilModule.get(); }
   llvm::Module &ModuleRef() { return *m_module.get(); }
-  llvm::DebugInfoFinder &InfoRef() { return *m_finder.get(); }
-  std::vector<const Instruction *> &InstructionsRef() { return m_instructions; }
-  std::vector<const Instruction *> &InstructionLinesRef() { return m_instructionLines; }
-  std::unordered_map<const Instruction *, RVA> &RvaMapRef() { return m_rvaMap; }
+  llvm::DebugInfoFinder &InfoRef() {
+    if (!m_finder) {
+      std::unique_ptr<llvm::DebugInfoFinder> finder =
+          std::make_unique<llvm::DebugInfoFinder>();
+      finder->processModule(*m_module.get());
+      m_finder = std::move(finder);
+    }
+    return *m_finder.get();
+  }
+  const std::vector<const Instruction *> &InstructionsRef() {
+    BuildInstructionTables();
+    return m_instructions;
+  }
+  const std::vector<RVA> &InstructionLinesRef() {
+    BuildInstructionTables();
+    return m_instructionLines;
+  }
 
   HRESULT getSourceFileIdByName(StringRef fileName, DWORD *pRetVal) {
     if (Contents() != nullptr) {
@@ -1731,14 +1748,16 @@ class DxcDiaLineNumber : public IDiaLineNumber {
   DXC_MICROCOM_TM_REF_FIELDS()
   CComPtr<DxcDiaSession> m_pSession;
   const Instruction *m_inst;
+  DxcDiaSession::RVA m_rva;
 public:
   DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
   HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) {
     return DoBasicQueryInterface<IDiaLineNumber>(this, iid, ppvObject);
   }
 
-  DxcDiaLineNumber(IMalloc *pMalloc, DxcDiaSession *pSession, const Instruction * inst)
-    : m_pMalloc(pMalloc), m_pSession(pSession), m_inst(inst) {}
+  DxcDiaLineNumber(IMalloc *pMalloc, DxcDiaSession *pSession, DxcDiaSession::RVA rva)
+    : m_pMalloc(pMalloc), m_pSession(pSession),
+      m_inst(pSession->InstructionsRef()[rva]), m_rva(rva) {}
 
   const llvm::DebugLoc &DL() {
     DXASSERT(bool(m_inst->getDebugLoc()), "Trying to read line info from invalid debug location");
@@ -1783,7 +1802,7 @@ public:
 
   __override STDMETHODIMP get_relativeVirtualAddress(
     /* [retval][out] */ DWORD *pRetVal) { 
-    *pRetVal = m_pSession->RvaMapRef()[m_inst];
+    *pRetVal = m_rva;
     return S_OK;
   }
 
@@ -1823,36 +1842,30 @@ public:
 
 // This class implements the line number table for dxc.
 //
-// It keeps a reference to the list of instructions that contain
-// line number debug info. By default, it points to the full list
-// of instructions that contain line info.
-//
-// It can also be passed a list of instructions that contain line info so
-// that we can iterate over a subset of lines. When passed an explicit list
-// it takes ownership of the list and points its reference to the internal
-// copy of the list.
+// It refers to a slice of the session's sorted list of RVAs that have line
+// number debug info. By default, the slice covers all of them; a slice for
+// an RVA range lets us iterate over a subset of lines without copying.
 class DxcDiaTableLineNumbers : public DxcDiaTableBase<IDiaEnumLineNumbers, IDiaLineNumber> {
 public:
   DxcDiaTableLineNumbers(IMalloc *pMalloc, DxcDiaSession *pSession) 
     : DxcDiaTableBase(pMalloc, pSession, DiaTableKind::LineNumbers)
-    , m_instructions(pSession->InstructionLinesRef())
+    , m_first(0)
   {
-    m_count = m_instructions.size();
+    m_count = pSession->InstructionLinesRef().size();
   }
   
-  DxcDiaTableLineNumbers(IMalloc *pMalloc, DxcDiaSession *pSession, std::vector<const Instruction*> &&instructions) 
+  DxcDiaTableLineNumbers(IMalloc *pMalloc, DxcDiaSession *pSession, unsigned first, unsigned last) 
     : DxcDiaTableBase(pMalloc, pSession, DiaTableKind::LineNumbers)
-    , m_instructions(m_instructionsStorage)
-    , m_instructionsStorage(std::move(instructions))
+    , m_first(first)
   {
-    m_count = m_instructions.size();
+    m_count = last - first;
   }
-  
 
   __override HRESULT GetItem(DWORD index, IDiaLineNumber **ppItem) {
-    if (index >= m_instructions.size())
+    if (index >= m_count)
       return E_INVALIDARG;
-    *ppItem = CreateOnMalloc<DxcDiaLineNumber>(m_pMalloc, m_pSession, m_instructions[index]);
+    DxcDiaSession::RVA rva = m_pSession->InstructionLinesRef()[m_first + index];
+    *ppItem = CreateOnMalloc<DxcDiaLineNumber>(m_pMalloc, m_pSession, rva);
     if (*ppItem == nullptr)
       return E_OUTOFMEMORY;
     (*ppItem)->AddRef();
@@ -1860,12 +1873,8 @@ public:
   }
 
 private:
-  // Keep a reference to the instructions that contain the line numbers.
-  const std::vector<const Instruction *> &m_instructions;
-  
-  // Provide storage space for instructions for when the table contains
-  // a subset of all instructions.
-  std::vector<const Instruction *> m_instructionsStorage;
+  // Index of the first line of the table in the session's line list.
+  unsigned m_first;
 };
 
 static HRESULT DxcDiaFindLineNumbersByRVA(
@@ -1877,23 +1886,21 @@ static HRESULT DxcDiaFindLineNumbersByRVA(
   if (!ppResult)
     return E_POINTER;
 
-  std::vector<const Instruction*> instructions;
-  const std::vector<const Instruction*> &allInstructions = pSession->InstructionsRef();
+  if (length != 0 &&
+      (uint64_t)rva + length > pSession->InstructionsRef().size())
+    return E_INVALIDARG;
 
-  // Gather the list of insructions that map to the given rva range.
-  for (DWORD i = rva; i < rva + length; ++i) {
-    if (i >= allInstructions.size())
-      return E_INVALIDARG;
-
-    // Only include the instruction if it has debug info for line mappings.
-    const Instruction *inst = allInstructions[i];
-    if (inst->getDebugLoc())
-      instructions.push_back(inst);
-  }
+  // Lines are sorted by RVA, so the lines for the given rva range are a
+  // contiguous slice of them.
+  const std::vector<DxcDiaSession::RVA> &lines = pSession->InstructionLinesRef();
+  auto first = std::lower_bound(lines.begin(), lines.end(), rva);
+  auto last = std::lower_bound(first, lines.end(), rva + length);
 
-  // Create line number table from explicit instruction list.
+  // Create line number table from the slice.
   IMalloc *pMalloc = pSession->GetMallocNoRef();
-  *ppResult = CreateOnMalloc<DxcDiaTableLineNumbers>(pMalloc, pSession, std::move(instructions));
+  *ppResult = CreateOnMalloc<DxcDiaTableLineNumbers>(
+      pMalloc, pSession, (unsigned)(first - lines.begin()),
+      (unsigned)(last - lines.begin()));
   if (*ppResult == nullptr)
     return E_OUTOFMEMORY;
   (*ppResult)->AddRef();
@@ -2088,7 +2095,6 @@ private:
   DXC_MICROCOM_TM_REF_FIELDS()
   std::shared_ptr<llvm::Module> m_module;
   std::shared_ptr<llvm::LLVMContext> m_context;
-  std::shared_ptr<llvm::DebugInfoFinder> m_finder;
 public:
   DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
 
@@ -2099,7 +2105,6 @@ public:
   DxcDiaDataSource(IMalloc *pMalloc) : m_pMalloc(pMalloc) {}
   ~DxcDiaDataSource() {
     // These are cross-referenced, so let's be explicit.
-    m_finder.reset();
     m_module.reset();
     m_context.reset();
   }
@@ -2134,11 +2139,11 @@ public:
       return E_FAIL;
     }
     m_context.reset();
-    m_finder.reset();
     try {
       m_context = std::make_shared<LLVMContext>();
       MemoryBuffer *pBitcodeBuffer;
       std::unique_ptr<MemoryBuffer> pEmbeddedBuffer;
+      std::vector<char> decompressedBitcode;
       std::unique_ptr<MemoryBuffer> pBuffer =
           getMemBufferFromStream(pIStream, "data");
       size_t bufferSize = pBuffer->getBufferSize();
@@ -2158,16 +2163,27 @@ public:
         }
 
         hlsl::DxilProgramHeader *pDxilProgramHeader = (hlsl::DxilProgramHeader *)pBuffer->getBufferStart();
-        if (pDxilProgramHeader->BitcodeHeader.DxilMagic != DxilMagicValue) {
-          return DXC_E_MALFORMED_CONTAINER;
-        }
-
         UINT32 BlobSize;
         const char *pBitcode = nullptr;
-        hlsl::GetDxilProgramBitcode(pDxilProgramHeader, &pBitcode, &BlobSize);
-        UINT32 offset = (UINT32)(pBitcode - (const char *)pDxilProgramHeader);
+        if (pDxilProgramHeader->BitcodeHeader.DxilMagic ==
+            hlsl::DxilCompressedMagicValue) {
+          // The module is loaded in full below, so the decompressed bitcode
+          // need only live as long as this call.
+          if (!hlsl::GetDecompressedDxilProgramBitcode(
+                  pDxilProgramHeader, (uint32_t)bufferSize,
+                  decompressedBitcode, &pBitcode, &BlobSize)) {
+            return DXC_E_MALFORMED_CONTAINER;
+          }
+        } else {
+          if (pDxilProgramHeader->BitcodeHeader.DxilMagic != DxilMagicValue) {
+            return DXC_E_MALFORMED_CONTAINER;
+          }
+          hlsl::GetDxilProgramBitcode(pDxilProgramHeader, &pBitcode, &BlobSize);
+          UINT32 offset = (UINT32)(pBitcode - (const char *)pDxilProgramHeader);
+          BlobSize = (UINT32)bufferSize - offset;
+        }
         std::unique_ptr<MemoryBuffer> p = MemoryBuffer::getMemBuffer(
-            StringRef(pBitcode, bufferSize - offset), "data");
+            StringRef(pBitcode, BlobSize), "data");
         pEmbeddedBuffer.swap(p);
         pBitcodeBuffer = pEmbeddedBuffer.get();
       }
@@ -2177,8 +2193,6 @@ public:
           pBitcodeBuffer, *m_context.get(), DiagStr);
       if (!pModule.get())
         return E_FAIL;
-      m_finder = std::make_shared<DebugInfoFinder>();
-      m_finder->processModule(*pModule.get());
       m_module.reset(pModule.release());
     }
     CATCH_CPP_RETURN_HRESULT();
@@ -2192,7 +2206,7 @@ public:
       return E_FAIL;
     CComPtr<DxcDiaSession> pSession = DxcDiaSession::Alloc(DxcGetThreadMallocNoRef());
     IFROOM(pSession.p);
-    pSession->Init(m_context, m_module, m_finder);
+    pSession->Init(m_context, m_module);
     *ppSession = pSession.Detach();
     return S_OK;
   }
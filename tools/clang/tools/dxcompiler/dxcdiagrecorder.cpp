@@ -0,0 +1,61 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// dxcdiagrecorder.cpp                                                       //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Records the diagnostics of a compile without formatting them as text.     //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxcdiagrecorder.h"
+#include "clang/Basic/SourceManager.h"
+#include "llvm/ADT/SmallString.h"
+
+using namespace clang;
+
+namespace dxcutil {
+
+void DxcDiagnosticRecorder::HandleDiagnostic(DiagnosticsEngine::Level Level,
+                                             const Diagnostic &Info) {
+  // Keeps the warning and error counts.
+  DiagnosticConsumer::HandleDiagnostic(Level, Info);
+
+  DxcDiagnosticRecord record;
+  switch (Level) {
+  case DiagnosticsEngine::Ignored:
+    return;
+  case DiagnosticsEngine::Note:
+    record.Severity = DxcDiagnosticSeverity_Note;
+    break;
+  case DiagnosticsEngine::Remark:
+    record.Severity = DxcDiagnosticSeverity_Remark;
+    break;
+  case DiagnosticsEngine::Warning:
+    record.Severity = DxcDiagnosticSeverity_Warning;
+    break;
+  case DiagnosticsEngine::Error:
+  case DiagnosticsEngine::Fatal:
+    record.Severity = DxcDiagnosticSeverity_Error;
+    break;
+  }
+  record.Id = Info.getID();
+  record.Line = 0;
+  record.Column = 0;
+  if (Info.getLocation().isValid() && Info.hasSourceManager()) {
+    PresumedLoc PLoc =
+        Info.getSourceManager().getPresumedLoc(Info.getLocation());
+    if (PLoc.isValid()) {
+      record.FileName = PLoc.getFilename();
+      record.Line = PLoc.getLine();
+      record.Column = PLoc.getColumn();
+    }
+  }
+  SmallString<128> message;
+  Info.FormatDiagnostic(message);
+  record.Message = message.str();
+  m_records.push_back(std::move(record));
+}
+
+} // namespace dxcutil
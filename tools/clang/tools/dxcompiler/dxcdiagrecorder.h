@@ -0,0 +1,40 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// dxcdiagrecorder.h                                                         //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Records the diagnostics of a compile without formatting them as text.     //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "dxc/Support/WinIncludes.h"
+#include "dxc/Support/dxcapi.impl.h"
+#include "clang/Basic/Diagnostic.h"
+#include <vector>
+
+namespace dxcutil {
+
+/// Records the diagnostics of a compile invoked with -diag-records.
+///
+/// Only the message itself is formatted, since its arguments may refer to
+/// the AST; locations are kept as file, line and column, and the source
+/// snippets and carets of the text printer are never produced.
+class DxcDiagnosticRecorder : public clang::DiagnosticConsumer {
+public:
+  void HandleDiagnostic(clang::DiagnosticsEngine::Level Level,
+                        const clang::Diagnostic &Info) override;
+
+  /// Moves the diagnostics recorded so far out of the recorder.
+  std::vector<DxcDiagnosticRecord> takeRecords() {
+    return std::move(m_records);
+  }
+
+private:
+  std::vector<DxcDiagnosticRecord> m_records;
+};
+
+} // namespace dxcutil
@@ -19,13 +19,17 @@
 #include "dxc/HLSL/HLMatrixLowerHelper.h"
 #include "dxc/HLSL/DxilConstants.h"
 #include "dxc/HLSL/DxilOperations.h"
+#include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/IR/DebugInfo.h"
 #include "llvm/IR/DiagnosticInfo.h"
 #include "llvm/IR/DiagnosticPrinter.h"
 #include "llvm/IR/AssemblyAnnotationWriter.h"
 #include "llvm/Support/FormattedStream.h"
 #include "llvm/Support/Format.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "dxc/HLSL/DxilPipelineStateValidation.h"
 #include "dxc/HLSL/DxilContainer.h"
+#include "dxc/HLSL/DxilShaderCost.h"
 #include "dxc/HLSL/DxilUtil.h"
 #include "dxcutil.h"
 
@@ -49,7 +53,7 @@ bool SigElementHasStream(const DxilProgramSignatureElement &pSignature) {
 }
 
 void PrintSignature(LPCSTR pName, const DxilProgramSignature *pSignature,
-                           bool bIsInput, raw_string_ostream &OS,
+                           bool bIsInput, raw_ostream &OS,
                            StringRef comment) {
   OS << comment << "\n"
      << comment << " " << pName << " signature:\n"
@@ -252,7 +256,7 @@ void PrintSignature(LPCSTR pName, const DxilProgramSignature *pSignature,
   OS << comment << "\n";
 }
 
-void PintCompMaskNameCompact(raw_string_ostream &OS, unsigned CompMask) {
+void PintCompMaskNameCompact(raw_ostream &OS, unsigned CompMask) {
   char Mask[5];
   memset(Mask, '\0', sizeof(Mask));
   unsigned idx = 0;
@@ -268,7 +272,7 @@ void PintCompMaskNameCompact(raw_string_ostream &OS, unsigned CompMask) {
 }
 
 void PrintDxilSignature(LPCSTR pName, const DxilSignature &Signature,
-                               raw_string_ostream &OS, StringRef comment) {
+                               raw_ostream &OS, StringRef comment) {
   const std::vector<std::unique_ptr<DxilSignatureElement>> &sigElts =
       Signature.GetElements();
   if (sigElts.size() == 0)
@@ -319,7 +323,7 @@ PCSTR g_pFeatureInfoNames[] = {
 static_assert(_countof(g_pFeatureInfoNames) == ShaderFeatureInfoCount, "g_pFeatureInfoNames needs to be updated");
 
 void PrintFeatureInfo(const DxilShaderFeatureInfo *pFeatureInfo,
-                             raw_string_ostream &OS, StringRef comment) {
+                             raw_ostream &OS, StringRef comment) {
   uint64_t featureFlags = pFeatureInfo->FeatureFlags;
   if (!featureFlags)
     return;
@@ -333,7 +337,7 @@ void PrintFeatureInfo(const DxilShaderFeatureInfo *pFeatureInfo,
 }
 
 void PrintResourceFormat(DxilResourceBase &res, unsigned alignment,
-                                raw_string_ostream &OS) {
+                                raw_ostream &OS) {
   switch (res.GetClass()) {
   case DxilResourceBase::Class::CBuffer:
   case DxilResourceBase::Class::Sampler:
@@ -360,7 +364,7 @@ void PrintResourceFormat(DxilResourceBase &res, unsigned alignment,
 }
 
 void PrintResourceDim(DxilResourceBase &res, unsigned alignment,
-                             raw_string_ostream &OS) {
+                             raw_ostream &OS) {
   switch (res.GetClass()) {
   case DxilResourceBase::Class::CBuffer:
   case DxilResourceBase::Class::Sampler:
@@ -400,7 +404,7 @@ void PrintResourceDim(DxilResourceBase &res, unsigned alignment,
   }
 }
 
-void PrintResourceBinding(DxilResourceBase &res, raw_string_ostream &OS,
+void PrintResourceBinding(DxilResourceBase &res, raw_ostream &OS,
                                  StringRef comment) {
   OS << comment << " " << left_justify(res.GetGlobalName(), 31);
 
@@ -426,7 +430,7 @@ void PrintResourceBinding(DxilResourceBase &res, raw_string_ostream &OS,
     OS << right_justify("unbounded", 6) << "\n";
 }
 
-void PrintResourceBindings(DxilModule &M, raw_string_ostream &OS,
+void PrintResourceBindings(DxilModule &M, raw_ostream &OS,
                                   StringRef comment) {
   OS << comment << "\n"
      << comment << " Resource Bindings:\n"
@@ -493,7 +497,7 @@ void PrintInputsContributingToOutputs(
   }
 }
 
-void PrintViewIdState(DxilModule &M, raw_string_ostream &OS,
+void PrintViewIdState(DxilModule &M, raw_ostream &OS,
                              StringRef comment) {
   if (!M.GetModule()->getNamedMetadata("dx.viewIdState"))
     return;
@@ -561,7 +565,7 @@ void PrintViewIdState(DxilModule &M, raw_string_ostream &OS,
 }
 
 void PrintStructLayout(StructType *ST, DxilTypeSystem &typeSys,
-                              raw_string_ostream &OS, StringRef comment,
+                              raw_ostream &OS, StringRef comment,
                               StringRef varName, unsigned offset,
                               unsigned indent, unsigned arraySize,
                               unsigned sizeOfStruct = 0);
@@ -597,7 +601,7 @@ void PrintTypeAndName(llvm::Type *Ty, DxilFieldAnnotation &annotation,
 }
 
 void PrintFieldLayout(llvm::Type *Ty, DxilFieldAnnotation &annotation,
-                             DxilTypeSystem &typeSys, raw_string_ostream &OS,
+                             DxilTypeSystem &typeSys, raw_ostream &OS,
                              StringRef comment, unsigned offset,
                              unsigned indent, unsigned offsetIndent,
                              unsigned sizeToPrint = 0) {
@@ -665,7 +669,7 @@ void PrintFieldLayout(llvm::Type *Ty, DxilFieldAnnotation &annotation,
 }
 
 void PrintStructLayout(StructType *ST, DxilTypeSystem &typeSys,
-                              raw_string_ostream &OS, StringRef comment,
+                              raw_ostream &OS, StringRef comment,
                               StringRef varName, unsigned offset,
                               unsigned indent, unsigned offsetIndent,
                               unsigned sizeOfStruct) {
@@ -697,7 +701,7 @@ void PrintStructLayout(StructType *ST, DxilTypeSystem &typeSys,
 void PrintStructBufferDefinition(DxilResource *buf,
                                         DxilTypeSystem &typeSys,
                                         const DataLayout &DL,
-                                        raw_string_ostream &OS,
+                                        raw_ostream &OS,
                                         StringRef comment) {
   const unsigned offsetIndent = 50;
 
@@ -747,7 +751,7 @@ void PrintStructBufferDefinition(DxilResource *buf,
 }
 
 void PrintTBufferDefinition(DxilResource *buf, DxilTypeSystem &typeSys,
-                                   raw_string_ostream &OS, StringRef comment) {
+                                   raw_ostream &OS, StringRef comment) {
   const unsigned offsetIndent = 50;
   Value *GV = buf->GetGlobalSymbol();
   llvm::Type *Ty = GV->getType()->getPointerElementType();
@@ -774,7 +778,7 @@ void PrintTBufferDefinition(DxilResource *buf, DxilTypeSystem &typeSys,
 }
 
 void PrintCBufferDefinition(DxilCBuffer *buf, DxilTypeSystem &typeSys,
-                                   raw_string_ostream &OS, StringRef comment) {
+                                   raw_ostream &OS, StringRef comment) {
   const unsigned offsetIndent = 50;
   Value *GV = buf->GetGlobalSymbol();
   llvm::Type *Ty = GV->getType()->getPointerElementType();
@@ -801,7 +805,7 @@ void PrintCBufferDefinition(DxilCBuffer *buf, DxilTypeSystem &typeSys,
   OS << comment << "\n";
 }
 
-void PrintBufferDefinitions(DxilModule &M, raw_string_ostream &OS,
+void PrintBufferDefinitions(DxilModule &M, raw_ostream &OS,
                                    StringRef comment) {
   OS << comment << "\n"
      << comment << " Buffer Definitions:\n"
@@ -1003,7 +1007,7 @@ public:
 
 void PrintPipelineStateValidationRuntimeInfo(const char *pBuffer,
                                                     DXIL::ShaderKind shaderKind,
-                                                    raw_string_ostream &OS,
+                                                    raw_ostream &OS,
                                                     StringRef comment) {
   OS << comment << "\n"
      << comment << " Pipeline Runtime Information: \n"
@@ -1232,9 +1236,19 @@ void PrintPipelineStateValidationRuntimeInfo(const char *pBuffer,
 
 
 namespace dxcutil {
-HRESULT Disassemble(IDxcBlob *pProgram, raw_string_ostream &Stream) {
+HRESULT Disassemble(IDxcBlob *pProgram, raw_ostream &Stream, UINT32 flags,
+                    const char *pFunctionName) {
+  if (flags & ~DxcDisassembleFlags_ValidMask)
+    return E_INVALIDARG;
+
   const char *pIL = (const char *)pProgram->GetBufferPointer();
   uint32_t pILLength = pProgram->GetBufferSize();
+  // Holds the bitcode of a compressed debug part while it's disassembled.
+  std::vector<char> bitcodeStorage;
+  // The cost report is printed on its own, without the summaries.
+  const bool bCostOnly = (flags & DxcDisassembleFlags_CostOnly) != 0;
+  raw_null_ostream NullStream;
+  raw_ostream &SummaryStream = bCostOnly ? NullStream : Stream;
   if (const DxilContainerHeader *pContainer =
           IsDxilContainerLike(pIL, pILLength)) {
     if (!IsValidDxilContainer(pContainer, pILLength)) {
@@ -1246,7 +1260,7 @@ HRESULT Disassemble(IDxcBlob *pProgram, raw_string_ostream &Stream) {
     if (it != end(pContainer)) {
       PrintFeatureInfo(
           reinterpret_cast<const DxilShaderFeatureInfo *>(GetDxilPartData(*it)),
-          Stream, /*comment*/ ";");
+          SummaryStream, /*comment*/ ";");
     }
 
     it = std::find_if(begin(pContainer), end(pContainer),
@@ -1255,7 +1269,7 @@ HRESULT Disassemble(IDxcBlob *pProgram, raw_string_ostream &Stream) {
       PrintSignature(
           "Input",
           reinterpret_cast<const DxilProgramSignature *>(GetDxilPartData(*it)),
-          true, Stream, /*comment*/ ";");
+          true, SummaryStream, /*comment*/ ";");
     }
     it = std::find_if(begin(pContainer), end(pContainer),
                       DxilPartIsType(DFCC_OutputSignature));
@@ -1263,7 +1277,7 @@ HRESULT Disassemble(IDxcBlob *pProgram, raw_string_ostream &Stream) {
       PrintSignature(
           "Output",
           reinterpret_cast<const DxilProgramSignature *>(GetDxilPartData(*it)),
-          false, Stream, /*comment*/ ";");
+          false, SummaryStream, /*comment*/ ";");
     }
     it = std::find_if(begin(pContainer), end(pContainer),
                       DxilPartIsType(DFCC_PatchConstantSignature));
@@ -1271,7 +1285,7 @@ HRESULT Disassemble(IDxcBlob *pProgram, raw_string_ostream &Stream) {
       PrintSignature(
           "Patch Constant signature",
           reinterpret_cast<const DxilProgramSignature *>(GetDxilPartData(*it)),
-          false, Stream, /*comment*/ ";");
+          false, SummaryStream, /*comment*/ ";");
     }
 
     it = std::find_if(begin(pContainer), end(pContainer),
@@ -1279,9 +1293,25 @@ HRESULT Disassemble(IDxcBlob *pProgram, raw_string_ostream &Stream) {
     if (it != end(pContainer)) {
       const char *pDebugName;
       if (!GetDxilShaderDebugName(*it, &pDebugName, nullptr)) {
-        Stream << "; shader debug name present; corruption detected\n";
+        SummaryStream
+            << "; shader debug name present; corruption detected\n";
       } else if (pDebugName && *pDebugName) {
-        Stream << "; shader debug name: " << pDebugName << "\n";
+        SummaryStream << "; shader debug name: " << pDebugName << "\n";
+      }
+    }
+
+    it = std::find_if(begin(pContainer), end(pContainer),
+                      DxilPartIsType(DFCC_ShaderHash));
+    if (it != end(pContainer)) {
+      if ((*it)->PartSize != sizeof(DxilShaderHash)) {
+        SummaryStream << "; shader hash present; corruption detected\n";
+      } else {
+        const DxilShaderHash *pHash =
+            reinterpret_cast<const DxilShaderHash *>(GetDxilPartData(*it));
+        SummaryStream << "; shader hash: ";
+        for (size_t i = 0; i < DxilShaderHashSize; ++i)
+          SummaryStream << format("%02x", pHash->Digest[i]);
+        SummaryStream << "\n";
       }
     }
 
@@ -1300,7 +1330,11 @@ HRESULT Disassemble(IDxcBlob *pProgram, raw_string_ostream &Stream) {
 
     const DxilProgramHeader *pProgramHeader =
         reinterpret_cast<const DxilProgramHeader *>(GetDxilPartData(*it));
-    if (!IsValidDxilProgramHeader(pProgramHeader, (*it)->PartSize)) {
+    const char *pBitcode;
+    uint32_t bitcodeLength;
+    if (!GetDecompressedDxilProgramBitcode(pProgramHeader, (*it)->PartSize,
+                                           bitcodeStorage, &pBitcode,
+                                           &bitcodeLength)) {
       return DXC_E_CONTAINER_INVALID;
     }
 
@@ -1309,41 +1343,106 @@ HRESULT Disassemble(IDxcBlob *pProgram, raw_string_ostream &Stream) {
     if (it != end(pContainer)) {
       PrintPipelineStateValidationRuntimeInfo(
           GetDxilPartData(*it),
-          GetVersionShaderType(pProgramHeader->ProgramVersion), Stream,
-          /*comment*/ ";");
+          GetVersionShaderType(pProgramHeader->ProgramVersion),
+          SummaryStream, /*comment*/ ";");
     }
-    GetDxilProgramBitcode(pProgramHeader, &pIL, &pILLength);
+    pIL = pBitcode;
+    pILLength = bitcodeLength;
   } else {
     const DxilProgramHeader *pProgramHeader =
         reinterpret_cast<const DxilProgramHeader *>(pIL);
-    if (IsValidDxilProgramHeader(pProgramHeader, pILLength)) {
-      GetDxilProgramBitcode(pProgramHeader, &pIL, &pILLength);
+    const char *pBitcode;
+    uint32_t bitcodeLength;
+    if (GetDecompressedDxilProgramBitcode(pProgramHeader, pILLength,
+                                          bitcodeStorage, &pBitcode,
+                                          &bitcodeLength)) {
+      pIL = pBitcode;
+      pILLength = bitcodeLength;
     }
   }
 
+  const bool bResourcesOnly = (flags & DxcDisassembleFlags_ResourcesOnly) != 0;
   std::string DiagStr;
   llvm::LLVMContext llvmContext;
-  std::unique_ptr<llvm::Module> pModule(dxilutil::LoadModuleFromBitcode(
-    llvm::StringRef(pIL, pILLength), llvmContext, DiagStr));
-  if (pModule.get() == nullptr) {
-    return DXC_E_IR_VERIFICATION_FAILED;
+  std::unique_ptr<llvm::Module> pModule;
+  raw_string_ostream DiagStream(DiagStr);
+  DiagnosticPrinterRawOStream DiagPrinter(DiagStream);
+  if (bResourcesOnly || bCostOnly || pFunctionName) {
+    // Function bodies are only read for the functions that are used.
+    llvmContext.setDiagnosticHandler(PrintDiagnosticHandler, &DiagPrinter,
+                                     true);
+    ErrorOr<std::unique_ptr<llvm::Module>> pLazyModule = getLazyBitcodeModule(
+        MemoryBuffer::getMemBuffer(StringRef(pIL, pILLength), "", false),
+        llvmContext);
+    if (!pLazyModule) {
+      return DXC_E_IR_VERIFICATION_FAILED;
+    }
+    pModule = std::move(pLazyModule.get());
+  } else {
+    pModule = dxilutil::LoadModuleFromBitcode(
+        llvm::StringRef(pIL, pILLength), llvmContext, DiagStr);
+    if (pModule.get() == nullptr) {
+      return DXC_E_IR_VERIFICATION_FAILED;
+    }
   }
 
   if (pModule->getNamedMetadata("dx.version")) {
-    DxilModule &dxilModule = pModule->GetOrCreateDxilModule();
-    PrintDxilSignature("Input", dxilModule.GetInputSignature(), Stream,
-                       /*comment*/ ";");
-    PrintDxilSignature("Output", dxilModule.GetOutputSignature(), Stream,
-                       /*comment*/ ";");
+    DxilModule &dxilModule = pModule->GetOrCreateDxilModule(/*skipInit*/true);
+    dxilModule.LoadDxilMetadata(/*bLazy*/true);
+    PrintDxilSignature("Input", dxilModule.GetInputSignature(),
+                       SummaryStream, /*comment*/ ";");
+    PrintDxilSignature("Output", dxilModule.GetOutputSignature(),
+                       SummaryStream, /*comment*/ ";");
     PrintDxilSignature("Patch Constant signature",
-                       dxilModule.GetPatchConstantSignature(), Stream,
+                       dxilModule.GetPatchConstantSignature(), SummaryStream,
                        /*comment*/ ";");
-    PrintBufferDefinitions(dxilModule, Stream, /*comment*/ ";");
-    PrintResourceBindings(dxilModule, Stream, /*comment*/ ";");
-    PrintViewIdState(dxilModule, Stream, /*comment*/ ";");
+    PrintBufferDefinitions(dxilModule, SummaryStream, /*comment*/ ";");
+    PrintResourceBindings(dxilModule, SummaryStream, /*comment*/ ";");
+    PrintViewIdState(dxilModule, SummaryStream, /*comment*/ ";");
   }
+  if (bCostOnly) {
+    if (!pModule->HasDxilModule())
+      return DXC_E_CONTAINER_MISSING_DXIL;
+    if (pModule->materializeAllPermanently())
+      return DXC_E_IR_VERIFICATION_FAILED;
+    PrintShaderCosts(pModule->GetDxilModule(), Stream, /*comment*/ ";");
+    Stream.flush();
+    return S_OK;
+  }
+  if (bResourcesOnly) {
+    Stream.flush();
+    return S_OK;
+  }
+
+  Function *pFunction = nullptr;
+  if (pFunctionName) {
+    pFunction = pModule->getFunction(pFunctionName);
+    if (pFunction == nullptr) {
+      return E_INVALIDARG;
+    }
+    if (pFunction->materialize()) {
+      return DXC_E_IR_VERIFICATION_FAILED;
+    }
+  }
+
+  if (flags & DxcDisassembleFlags_SkipMetadata) {
+    // The module is only used for printing, so simply drop the metadata.
+    StripDebugInfo(*pModule);
+    for (Function &F : *pModule) {
+      F.dropUnknownMetadata(None);
+      for (BasicBlock &BB : F)
+        for (Instruction &I : BB)
+          I.dropUnknownMetadata();
+    }
+    while (!pModule->named_metadata_empty())
+      pModule->eraseNamedMetadata(&*pModule->named_metadata_begin());
+  }
+
   DxcAssemblyAnnotationWriter w;
-  pModule->print(Stream, &w);
+  if (pFunction)
+    pFunction->print(Stream, &w);
+  else
+    pModule->print(Stream, &w);
   Stream.flush();
   return S_OK;
 }
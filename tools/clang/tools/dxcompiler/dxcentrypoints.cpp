@@ -0,0 +1,213 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// dxcentrypoints.cpp                                                        //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Generates modules for several entry points from a single parse.           //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxcentrypoints.h"
+#include "clang/AST/ASTContext.h"
+#include "clang/Basic/Diagnostic.h"
+#include "clang/CodeGen/BackendUtil.h"
+#include "clang/CodeGen/ModuleBuilder.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/MultiplexConsumer.h"
+#include "clang/Frontend/TextDiagnosticPrinter.h"
+#include "clang/Lex/Preprocessor.h"
+#include "clang/Sema/SemaHLSL.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/IR/DiagnosticInfo.h"
+#include "llvm/IR/DiagnosticPrinter.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace clang;
+using namespace llvm;
+
+namespace dxcutil {
+
+namespace {
+
+typedef EmitEntryPointsAction::EntryPoint EntryPoint;
+
+// Collects the backend diagnostics of an entry point. Other entry points may
+// be in their backend at the same time, so these can't go through the
+// compiler's diagnostics engine.
+void EntryPointDiagnosticHandler(const DiagnosticInfo &DI, void *Context) {
+  EntryPoint &E = *static_cast<EntryPoint *>(Context);
+  raw_string_ostream OS(E.Diagnostics);
+  switch (DI.getSeverity()) {
+  case DS_Error:
+    E.HasErrors = true;
+    OS << "error: ";
+    break;
+  case DS_Warning:
+    OS << "warning: ";
+    break;
+  case DS_Note:
+    OS << "note: ";
+    break;
+  case DS_Remark:
+    return;
+  }
+  DiagnosticPrinterRawOStream DP(OS);
+  DI.print(DP);
+  OS << "\n";
+}
+
+// Restores the compiler's diagnostic consumer and entry point once the entry
+// points have been generated, also if generating one of them throws.
+class RestoreCompilerState {
+public:
+  RestoreCompilerState(CompilerInstance &CI)
+      : CI(CI), Client(CI.getDiagnostics().getClient()),
+        OwnedClient(CI.getDiagnostics().takeClient()),
+        EntryFunction(CI.getLangOpts().HLSLEntryFunction) {}
+  ~RestoreCompilerState() {
+    DiagnosticsEngine &Diags = CI.getDiagnostics();
+    if (OwnedClient)
+      Diags.setClient(OwnedClient.release(), /*ShouldOwnClient*/ true);
+    else
+      Diags.setClient(Client, /*ShouldOwnClient*/ false);
+    Diags.resetErrors();
+    CI.getLangOpts().HLSLEntryFunction = EntryFunction;
+  }
+
+private:
+  CompilerInstance &CI;
+  DiagnosticConsumer *Client;
+  std::unique_ptr<DiagnosticConsumer> OwnedClient;
+  std::string EntryFunction;
+};
+
+// Hands every top-level declaration to the IR generator of each entry point,
+// then finishes them one after another and runs their backends in parallel.
+class EntryPointsConsumer : public MultiplexConsumer {
+public:
+  EntryPointsConsumer(CompilerInstance &CI,
+                      std::vector<std::unique_ptr<ASTConsumer>> Consumers,
+                      std::vector<CodeGenerator *> Generators,
+                      std::vector<EntryPoint> &Entries,
+                      const EmitEntryPointsAction::ParallelForFn &ParallelFor)
+      : MultiplexConsumer(std::move(Consumers)), CI(CI),
+        Generators(std::move(Generators)), Entries(Entries),
+        ParallelFor(ParallelFor), TheSema(nullptr) {}
+
+  void InitializeSema(Sema &S) override {
+    TheSema = &S;
+    MultiplexConsumer::InitializeSema(S);
+  }
+
+  void ForgetSema() override {
+    TheSema = nullptr;
+    MultiplexConsumer::ForgetSema();
+  }
+
+  void HandleTranslationUnit(ASTContext &Ctx) override {
+    if (CI.getDiagnostics().hasErrorOccurred() || TheSema == nullptr) {
+      // Let the generators drop their modules.
+      MultiplexConsumer::HandleTranslationUnit(Ctx);
+      for (EntryPoint &E : Entries)
+        E.HasErrors = true;
+      return;
+    }
+
+    GenerateEntryPoints(Ctx);
+    ParallelFor((unsigned)Entries.size(),
+                [this](unsigned i) { RunBackend(Entries[i]); });
+  }
+
+private:
+  CompilerInstance &CI;
+  std::vector<CodeGenerator *> Generators; // Owned by the base class.
+  std::vector<EntryPoint> &Entries;
+  const EmitEntryPointsAction::ParallelForFn &ParallelFor;
+  Sema *TheSema;
+
+  void GenerateEntryPoints(ASTContext &Ctx) {
+    DiagnosticsEngine &Diags = CI.getDiagnostics();
+    LangOptions &LangOpts = CI.getLangOpts();
+    RestoreCompilerState Restore(CI);
+    for (size_t i = 0; i < Entries.size(); ++i) {
+      EntryPoint &E = Entries[i];
+      raw_string_ostream OS(E.Diagnostics);
+      TextDiagnosticPrinter Printer(OS, &CI.getDiagnosticOpts());
+      Printer.BeginSourceFile(LangOpts, &CI.getPreprocessor());
+      Diags.setClient(&Printer, /*ShouldOwnClient*/ false);
+      Diags.resetErrors();
+
+      // The entry point checks, and what the AST context requires to be
+      // emitted, follow the entry point in the language options.
+      LangOpts.HLSLEntryFunction = E.Name;
+      hlsl::DiagnoseTranslationUnit(TheSema);
+      Generators[i]->HandleTranslationUnit(Ctx);
+      E.Module.reset(Generators[i]->ReleaseModule());
+      E.HasErrors = Diags.hasErrorOccurred();
+      if (E.HasErrors)
+        E.Module.reset();
+
+      Diags.setClient(nullptr, /*ShouldOwnClient*/ false);
+      Printer.EndSourceFile();
+      OS.flush();
+    }
+  }
+
+  void RunBackend(EntryPoint &E) {
+    if (!E.Module)
+      return;
+    LLVMContext &Context = *E.Context;
+    Context.setDiagnosticHandler(EntryPointDiagnosticHandler, &E);
+    // Without a target description or code generation, the backend reports
+    // everything through the module's context rather than the compiler's
+    // diagnostics engine.
+    EmitBackendOutput(CI.getDiagnostics(), *E.CodeGenOpts, CI.getTargetOpts(),
+                      CI.getLangOpts(), StringRef(), E.Module.get(),
+                      Backend_EmitNothing, nullptr);
+    Context.setDiagnosticHandler(nullptr, nullptr);
+    if (E.HasErrors)
+      E.Module.reset();
+  }
+};
+
+} // namespace
+
+EmitEntryPointsAction::EmitEntryPointsAction(ParallelForFn ParallelFor)
+    : ParallelFor(std::move(ParallelFor)) {}
+
+EmitEntryPointsAction::~EmitEntryPointsAction() {}
+
+void EmitEntryPointsAction::addEntryPoint(StringRef Name, StringRef Profile) {
+  EntryPoints.emplace_back();
+  EntryPoints.back().Name = Name;
+  EntryPoints.back().Profile = Profile;
+}
+
+std::unique_ptr<ASTConsumer>
+EmitEntryPointsAction::CreateASTConsumer(CompilerInstance &CI,
+                                         StringRef InFile) {
+  std::vector<std::unique_ptr<ASTConsumer>> Consumers;
+  std::vector<CodeGenerator *> Generators;
+  for (EntryPoint &E : EntryPoints) {
+    E.CodeGenOpts.reset(new CodeGenOptions(CI.getCodeGenOpts()));
+    E.CodeGenOpts->HLSLEntryFunction = E.Name;
+    E.CodeGenOpts->HLSLProfile = E.Profile;
+    // Phases of entry points that run at the same time can't be reported.
+    E.CodeGenOpts->HLSLPhaseListener = nullptr;
+    E.Context.reset(new LLVMContext());
+    CodeGenerator *Gen = CreateLLVMCodeGen(
+        CI.getDiagnostics(), InFile, CI.getHeaderSearchOpts(),
+        CI.getPreprocessorOpts(), *E.CodeGenOpts, *E.Context);
+    Consumers.emplace_back(Gen);
+    Generators.push_back(Gen);
+  }
+  return llvm::make_unique<EntryPointsConsumer>(
+      CI, std::move(Consumers), std::move(Generators), EntryPoints,
+      ParallelFor);
+}
+
+} // namespace dxcutil
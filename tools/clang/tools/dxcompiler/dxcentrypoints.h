@@ -0,0 +1,76 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// dxcentrypoints.h                                                          //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Generates modules for several entry points from a single parse.           //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "clang/Frontend/CodeGenOptions.h"
+#include "clang/Frontend/FrontendAction.h"
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace llvm {
+class LLVMContext;
+class Module;
+}
+
+namespace dxcutil {
+
+/// Generates a DXIL module for each of several entry points from a single
+/// parse of the main file.
+///
+/// Preprocessing, parsing and semantic analysis run once; their diagnostics
+/// go to the compiler's diagnostic consumer and apply to every entry point.
+/// If they fail, no entry point gets a module. Otherwise the entry point
+/// checks and IR generation run for one entry point after another, since
+/// they walk the AST, each with its diagnostics kept apart. The optimization
+/// and DXIL generation passes then run through ParallelFor, each entry point
+/// in its own LLVMContext.
+class EmitEntryPointsAction : public clang::ASTFrontendAction {
+public:
+  /// Runs Task(0) .. Task(Count - 1), possibly concurrently, and returns once
+  /// all of them are done.
+  typedef std::function<void(unsigned Count,
+                             const std::function<void(unsigned)> &Task)>
+      ParallelForFn;
+
+  struct EntryPoint {
+    std::string Name;
+    std::string Profile;
+    std::string Diagnostics; // This entry point's own diagnostics.
+    bool HasErrors = false;
+    std::unique_ptr<clang::CodeGenOptions> CodeGenOpts;
+    std::unique_ptr<llvm::LLVMContext> Context;
+    std::unique_ptr<llvm::Module> Module; // Null if the entry point failed.
+  };
+
+  explicit EmitEntryPointsAction(ParallelForFn ParallelFor);
+  ~EmitEntryPointsAction() override;
+
+  /// Adds an entry point; all of them must be added before the action runs.
+  void addEntryPoint(llvm::StringRef Name, llvm::StringRef Profile);
+
+  /// The entry points in the order they were added, with their modules once
+  /// the action has run.
+  std::vector<EntryPoint> &getEntryPoints() { return EntryPoints; }
+
+protected:
+  std::unique_ptr<clang::ASTConsumer>
+  CreateASTConsumer(clang::CompilerInstance &CI,
+                    llvm::StringRef InFile) override;
+
+private:
+  ParallelForFn ParallelFor;
+  std::vector<EntryPoint> EntryPoints;
+};
+
+} // namespace dxcutil
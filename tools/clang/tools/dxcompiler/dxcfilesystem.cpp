@@ -18,10 +18,12 @@
 #include "dxc/dxcapi.h"
 #include "llvm/Support/raw_ostream.h"
 #include "dxcutil.h"
+#include "dxcincludecache.h"
 
 #include "dxc/Support/dxcfilesystem.h"
 #include "dxc/Support/Unicode.h"
 #include "clang/Frontend/CompilerInstance.h"
+#include <algorithm>
 
 using namespace llvm;
 using namespace hlsl;
@@ -201,17 +203,47 @@ private:
   CComPtr<IDxcIncludeHandler> m_includeLoader;
   std::vector<std::wstring> m_searchEntries;
   bool m_bDisplayIncludeProcess;
+  bool m_bUseIncludeCache;
+  bool m_bMinimizeSources;
 
   // Some constraints of the current design: opening the same file twice
   // will return the same handle/structure, and thus the same file pointer.
   struct IncludedFile {
     CComPtr<IDxcBlob> Blob;
-    CComPtr<IStream> BlobStream;
+    CComPtr<IStream> BlobStream; // Created on the first read through a fd.
     std::wstring Name;
-    IncludedFile(std::wstring &&name, IDxcBlob *pBlob, IStream *pStream)
-      : Name(name), Blob(pBlob), BlobStream(pStream) { }
+    bool NullTerminated; // A null character follows the blob's content.
+    IncludedFile(std::wstring &&name, IDxcBlob *pBlob, IStream *pStream,
+                 bool nullTerminated)
+      : Name(name), Blob(pBlob), BlobStream(pStream),
+        NullTerminated(nullTerminated) { }
   };
   llvm::SmallVector<IncludedFile, 4> m_includedFiles;
+  // Names the include handler was asked for but did not resolve.
+  std::vector<std::wstring> m_missingFiles;
+  // Includes loaded by PreloadInclude that the compile hasn't opened yet; a
+  // null blob is a name the handler did not resolve.
+  struct PreloadedFile {
+    std::wstring Name;
+    CComPtr<IDxcBlobEncoding> Blob;
+    bool NullTerminated;
+  };
+  std::vector<PreloadedFile> m_preloadedFiles;
+
+  // Loads a file through the include cache or the include handler.
+  HRESULT LoadFromHandler(LPCWSTR lpFileName, IDxcBlobEncoding **ppBlob,
+                          bool *pNullTerminated) {
+    *ppBlob = nullptr;
+    *pNullTerminated = false;
+    if (m_bUseIncludeCache)
+      return DxcIncludeCache::Load(m_includeLoader, lpFileName, ppBlob,
+                                   pNullTerminated);
+    CComPtr<::IDxcBlob> fileBlob;
+    IFR(m_includeLoader->LoadSource(lpFileName, &fileBlob));
+    if (fileBlob.p != nullptr)
+      return hlsl::DxcGetBlobAsUtf8(fileBlob, ppBlob);
+    return S_OK;
+  }
 
   static bool IsDirOf(LPCWSTR lpDir, size_t dirLen, const std::wstring &fileName) {
     if (fileName.size() <= dirLen) return false;
@@ -260,21 +292,34 @@ private:
         return ERROR_OUT_OF_STRUCTURES;
       }
 
-      CComPtr<::IDxcBlob> fileBlob;
-      HRESULT hr = m_includeLoader->LoadSource(lpFileName, &fileBlob);
-      if (FAILED(hr)) {
+      CComPtr<IDxcBlobEncoding> fileBlobEncoded;
+      bool nullTerminated = false;
+      auto preloaded = std::find_if(
+          m_preloadedFiles.begin(), m_preloadedFiles.end(),
+          [lpFileName](const PreloadedFile &file) {
+            return file.Name == lpFileName;
+          });
+      if (preloaded != m_preloadedFiles.end()) {
+        fileBlobEncoded = preloaded->Blob;
+        nullTerminated = preloaded->NullTerminated;
+        m_preloadedFiles.erase(preloaded);
+      } else if (FAILED(LoadFromHandler(lpFileName, &fileBlobEncoded,
+                                        &nullTerminated))) {
         return ERROR_UNHANDLED_EXCEPTION;
       }
-      if (fileBlob.p != nullptr) {
-        CComPtr<IDxcBlobEncoding> fileBlobEncoded;
-        if (FAILED(hlsl::DxcGetBlobAsUtf8(fileBlob, &fileBlobEncoded))) {
-          return ERROR_UNHANDLED_EXCEPTION;
-        }
-        CComPtr<IStream> fileStream;
-        if (FAILED(hlsl::CreateReadOnlyBlobStream(fileBlobEncoded, &fileStream))) {
+      if (fileBlobEncoded.p != nullptr && m_bMinimizeSources) {
+        CComPtr<IDxcBlobEncoding> pMinimized;
+        if (FAILED(DxcIncludeCache::Minimize(fileBlobEncoded, &pMinimized,
+                                             &nullTerminated))) {
           return ERROR_UNHANDLED_EXCEPTION;
         }
-        m_includedFiles.emplace_back(std::wstring(lpFileName), fileBlobEncoded, fileStream);
+        fileBlobEncoded = pMinimized;
+      }
+      if (fileBlobEncoded.p != nullptr) {
+        // The compiler gets the content through GetFileContents, so the
+        // stream is only created if something reads the file through a fd.
+        m_includedFiles.emplace_back(std::wstring(lpFileName), fileBlobEncoded,
+                                     nullptr, nullTerminated);
         index = m_includedFiles.size() - 1;
 
         if (m_bDisplayIncludeProcess) {
@@ -290,6 +335,10 @@ private:
         }
         return ERROR_SUCCESS;
       }
+      if (std::find(m_missingFiles.begin(), m_missingFiles.end(),
+                    lpFileName) == m_missingFiles.end()) {
+        m_missingFiles.emplace_back(lpFileName);
+      }
     }
     return ERROR_NOT_FOUND;
   }
@@ -308,14 +357,29 @@ private:
 public:
   DxcArgsFileSystemImpl(_In_ IDxcBlob *pSource, LPCWSTR pSourceName, _In_opt_ IDxcIncludeHandler* pHandler)
       : m_pSource(pSource), m_pSourceName(pSourceName), m_includeLoader(pHandler), m_bDisplayIncludeProcess(false),
+        m_bUseIncludeCache(false), m_bMinimizeSources(false),
         m_pOutputStreamName(nullptr) {
     MakeAbsoluteOrCurDirRelativeW(m_pSourceName, m_pAbsSourceName);
     IFT(CreateReadOnlyBlobStream(m_pSource, &m_pSourceStream));
-    m_includedFiles.push_back(IncludedFile(std::wstring(m_pSourceName), m_pSource, m_pSourceStream));
+    m_includedFiles.push_back(IncludedFile(std::wstring(m_pSourceName), m_pSource, m_pSourceStream, false));
   }
   void EnableDisplayIncludeProcess() override {
     m_bDisplayIncludeProcess = true;
   }
+  void EnableIncludeCache() override {
+    m_bUseIncludeCache = true;
+  }
+  void EnableMinimizedSources() override {
+    m_bMinimizeSources = true;
+    // The main source is already loaded; it is only read through its entry.
+    IncludedFile &main = m_includedFiles.front();
+    CComPtr<IDxcBlobEncoding> pUtf8;
+    CComPtr<IDxcBlobEncoding> pMinimized;
+    IFT(hlsl::DxcGetBlobAsUtf8(main.Blob, &pUtf8));
+    IFT(DxcIncludeCache::Minimize(pUtf8, &pMinimized, &main.NullTerminated));
+    main.Blob = pMinimized;
+    main.BlobStream.Release();
+  }
   void WriteStdErrToStream(raw_string_ostream &s) override {
     s.write((char*)m_pStdErrStream->GetPtr(), m_pStdErrStream->GetPtrSize());
     s.flush();
@@ -346,7 +410,12 @@ public:
       stream = m_pStdErrStream;
     }
     else if (argsHandle.GetKind() == HandleKind::File) {
-      stream = HandleToIncludedFile(handle).BlobStream;
+      IncludedFile &file = HandleToIncludedFile(handle);
+      if (file.BlobStream == nullptr &&
+          FAILED(CreateReadOnlyBlobStream(file.Blob, &file.BlobStream))) {
+        file.BlobStream.Release();
+      }
+      stream = file.BlobStream;
     }
     *ppResult = stream.Detach();
   }
@@ -385,6 +454,47 @@ public:
     return S_OK;
   }
 
+  void GetIncludedFiles(IncludedFileList &files) override {
+    files.clear();
+    // Skip the main source, which is always the first entry.
+    for (size_t i = 1; i < m_includedFiles.size(); ++i) {
+      files.emplace_back(m_includedFiles[i].Name, m_includedFiles[i].Blob);
+    }
+    for (const std::wstring &name : m_missingFiles) {
+      files.emplace_back(name, nullptr);
+    }
+  }
+
+  HRESULT PreloadInclude(LPCWSTR pName, IDxcBlob **ppBlob) override {
+    *ppBlob = nullptr;
+    if (m_includeLoader.p == nullptr)
+      return E_FAIL;
+    for (const PreloadedFile &file : m_preloadedFiles) {
+      if (file.Name == pName) {
+        *ppBlob = CComPtr<IDxcBlob>(file.Blob.p).Detach();
+        return S_OK;
+      }
+    }
+    PreloadedFile file;
+    file.Name = pName;
+    IFR(LoadFromHandler(pName, &file.Blob, &file.NullTerminated));
+    *ppBlob = CComPtr<IDxcBlob>(file.Blob.p).Detach();
+    m_preloadedFiles.emplace_back(std::move(file));
+    return S_OK;
+  }
+
+  void AddPreloadedIncludes(const IncludedFileList &files) override {
+    for (const auto &included : files) {
+      PreloadedFile file;
+      file.Name = included.first;
+      file.NullTerminated = false;
+      if (included.second.p != nullptr &&
+          FAILED(included.second.QueryInterface(&file.Blob)))
+        continue;
+      m_preloadedFiles.emplace_back(std::move(file));
+    }
+  }
+
   __override ~DxcArgsFileSystemImpl() { };
   __override BOOL FindNextFileW(
     _In_   HANDLE hFindFile,
@@ -707,6 +817,20 @@ public:
 
     return (int)written;
   }
+  __override bool GetFileContents(int fd, _Outptr_result_bytebuffer_(*pSize) const char **ppData,
+                                  _Out_ size_t *pSize, _Out_ bool *pNullTerminated) throw() {
+    DxcArgsHandle argsHandle(HandleFromFD(fd));
+    if (!argsHandle.IsFileKind()) {
+      return false;
+    }
+    // Included files never change during a compile, so their blobs can be
+    // used in place for as long as this file system lives.
+    IncludedFile &file = HandleToIncludedFile(argsHandle.Handle);
+    *ppData = (const char *)file.Blob->GetBufferPointer();
+    *pSize = file.Blob->GetBufferSize();
+    *pNullTerminated = file.NullTerminated;
+    return true;
+  }
 };
 }
 
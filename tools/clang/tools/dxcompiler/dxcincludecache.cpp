@@ -0,0 +1,239 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// dxcincludecache.cpp                                                       //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Implements the process-wide cache of included files for dxcompiler.       //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/Support/WinIncludes.h"
+#include "dxc/Support/Global.h"
+#include "dxc/Support/FileIOHelper.h"
+#include "dxc/dxcapi.h"
+#include "dxccompilecache.h"
+#include "dxcincludecache.h"
+#include "clang/Lex/DependencyDirectivesMinimizer.h"
+#include "llvm/ADT/SmallVector.h"
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+using namespace hlsl;
+
+namespace {
+
+struct IncludeCacheEntry {
+  bool HasStamp;
+  UINT64 Stamp;        // For handlers that provide file stamps.
+  std::string Digest;  // Of the content as loaded, for other handlers.
+  CComPtr<IDxcBlobEncoding> pUtf8;
+};
+
+std::string GetContentDigest(IDxcBlob *pBlob) {
+  dxcutil::DxcCompileCacheKeyBuilder builder;
+  builder.AddBlob(pBlob);
+  return builder.GetDigest();
+}
+
+// Includes are keyed by the full path they resolve to, so a relative name
+// seen from different current directories doesn't share an entry, and
+// different spellings of one path do.
+std::wstring GetIncludeCacheKey(LPCWSTR pFilename) {
+  DWORD length = GetFullPathNameW(pFilename, 0, nullptr, nullptr);
+  if (length == 0)
+    return std::wstring(pFilename);
+  std::wstring fullPath(length, L'\0');
+  length = GetFullPathNameW(pFilename, length, &fullPath[0], nullptr);
+  if (length == 0 || length >= fullPath.size())
+    return std::wstring(pFilename);
+  fullPath.resize(length);
+  return fullPath;
+}
+
+// The copy is followed by a null character that is not part of the blob, so
+// the compiler can use it in place.
+HRESULT CopyUtf8BlobToHeap(IDxcBlobEncoding *pUtf8, IDxcBlobEncoding **ppCopy) {
+  UINT32 size = pUtf8->GetBufferSize();
+  CDxcMallocHeapPtr<char> heapCopy(DxcGetThreadMallocNoRef());
+  if (!heapCopy.Allocate((SIZE_T)size + 1)) {
+    return E_OUTOFMEMORY;
+  }
+  memcpy(heapCopy.m_pData, pUtf8->GetBufferPointer(), size);
+  heapCopy.m_pData[size] = '\0';
+  IFR(DxcCreateBlobWithEncodingOnHeap(heapCopy.m_pData, size, CP_UTF8, ppCopy));
+  heapCopy.Detach();
+  return S_OK;
+}
+
+class IncludeCacheImpl {
+public:
+  // Bound on the number of files kept; the cache starts over once it is
+  // reached.
+  static const size_t MaxEntries = 4096;
+
+  bool Find(const std::wstring &name, IncludeCacheEntry &entry) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_entries.find(name);
+    if (it == m_entries.end())
+      return false;
+    entry = it->second;
+    return true;
+  }
+
+  void Insert(const std::wstring &name, const IncludeCacheEntry &entry) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_entries.size() == MaxEntries && m_entries.count(name) == 0)
+      m_entries.clear();
+    m_entries[name] = entry;
+  }
+
+  bool FindMinimized(const std::string &digest,
+                     IDxcBlobEncoding **ppMinimized) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_minimized.find(digest);
+    if (it == m_minimized.end())
+      return false;
+    return SUCCEEDED(it->second.CopyTo(ppMinimized));
+  }
+
+  void InsertMinimized(const std::string &digest,
+                       IDxcBlobEncoding *pMinimized) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_minimized.size() == MaxEntries && m_minimized.count(digest) == 0)
+      m_minimized.clear();
+    m_minimized[digest] = pMinimized;
+  }
+
+private:
+  std::mutex m_mutex;
+  std::unordered_map<std::wstring, IncludeCacheEntry> m_entries;
+  // Minimized sources by the digest of their full content.
+  std::unordered_map<std::string, CComPtr<IDxcBlobEncoding>> m_minimized;
+};
+
+// Created by DxcIncludeCache::Initialize when the library is loaded.
+IncludeCacheImpl *g_pIncludeCache;
+
+} // namespace
+
+namespace dxcutil {
+namespace DxcIncludeCache {
+
+HRESULT Load(IDxcIncludeHandler *pHandler, LPCWSTR pFilename,
+             IDxcBlobEncoding **ppUtf8, bool *pNullTerminated) {
+  *ppUtf8 = nullptr;
+  *pNullTerminated = false;
+  // Cache storage is shared across compiles and their allocators; the blobs
+  // handed out own their memory, so they may be released under any allocator.
+  DxcThreadMalloc TM(nullptr);
+  try {
+    std::wstring name = GetIncludeCacheKey(pFilename);
+    IncludeCacheEntry entry;
+    bool found = g_pIncludeCache->Find(name, entry);
+
+    // Stamp the file the key names, so the stamp and the entry agree.
+    CComPtr<IDxcIncludeHandlerFileStamp> pStamps;
+    UINT64 stamp = 0;
+    bool hasStamp =
+        SUCCEEDED(pHandler->QueryInterface(&pStamps)) &&
+        SUCCEEDED(pStamps->GetFileStamp(name.c_str(), &stamp));
+    if (found && hasStamp && entry.HasStamp && entry.Stamp == stamp) {
+      *ppUtf8 = entry.pUtf8.Detach();
+      *pNullTerminated = true;
+      return S_OK;
+    }
+
+    CComPtr<IDxcBlob> pBlob;
+    IFR(pHandler->LoadSource(pFilename, &pBlob));
+    if (pBlob == nullptr)
+      return S_OK;
+
+    std::string digest;
+    if (!hasStamp) {
+      digest = GetContentDigest(pBlob);
+      if (found && !entry.HasStamp && entry.Digest == digest) {
+        *ppUtf8 = entry.pUtf8.Detach();
+        *pNullTerminated = true;
+        return S_OK;
+      }
+    }
+
+    CComPtr<IDxcBlobEncoding> pUtf8;
+    IFR(DxcGetBlobAsUtf8(pBlob, &pUtf8));
+    // Without a stamp, the handler is called every time anyway; only keep
+    // content whose conversion made a new copy.
+    if (!hasStamp && pUtf8->GetBufferPointer() == pBlob->GetBufferPointer()) {
+      *ppUtf8 = pUtf8.Detach();
+      return S_OK;
+    }
+
+    IncludeCacheEntry newEntry;
+    newEntry.HasStamp = hasStamp;
+    newEntry.Stamp = stamp;
+    newEntry.Digest = std::move(digest);
+    IFR(CopyUtf8BlobToHeap(pUtf8, &newEntry.pUtf8));
+    g_pIncludeCache->Insert(name, newEntry);
+    // Hand out the shared copy, so later compiles reuse the same memory.
+    *ppUtf8 = newEntry.pUtf8.Detach();
+    *pNullTerminated = true;
+    return S_OK;
+  }
+  CATCH_CPP_RETURN_HRESULT();
+}
+
+HRESULT Minimize(IDxcBlobEncoding *pUtf8, IDxcBlobEncoding **ppMinimized,
+                 bool *pNullTerminated) {
+  *ppMinimized = nullptr;
+  DxcThreadMalloc TM(nullptr);
+  try {
+    std::string digest = GetContentDigest(pUtf8);
+    if (g_pIncludeCache->FindMinimized(digest, ppMinimized)) {
+      *pNullTerminated = true;
+      return S_OK;
+    }
+
+    llvm::SmallVector<char, 1024> minimized;
+    llvm::StringRef text((const char *)pUtf8->GetBufferPointer(),
+                         pUtf8->GetBufferSize());
+    if (!clang::minimizeSourceToDependencyDirectives(text, minimized)) {
+      pUtf8->AddRef();
+      *ppMinimized = pUtf8;
+      return S_OK;
+    }
+
+    CDxcMallocHeapPtr<char> heapCopy(DxcGetThreadMallocNoRef());
+    if (!heapCopy.Allocate(minimized.size() + 1))
+      return E_OUTOFMEMORY;
+    memcpy(heapCopy.m_pData, minimized.data(), minimized.size());
+    heapCopy.m_pData[minimized.size()] = '\0';
+    CComPtr<IDxcBlobEncoding> pMinimized;
+    IFR(DxcCreateBlobWithEncodingOnHeap(heapCopy.m_pData,
+                                        (UINT32)minimized.size(), CP_UTF8,
+                                        &pMinimized));
+    heapCopy.Detach();
+    g_pIncludeCache->InsertMinimized(digest, pMinimized);
+    *ppMinimized = pMinimized.Detach();
+    *pNullTerminated = true;
+    return S_OK;
+  }
+  CATCH_CPP_RETURN_HRESULT();
+}
+
+HRESULT Initialize() {
+  DXASSERT(g_pIncludeCache == nullptr, "else double-init");
+  DxcThreadMalloc TM(nullptr);
+  g_pIncludeCache = new (std::nothrow) IncludeCacheImpl();
+  return g_pIncludeCache ? S_OK : E_OUTOFMEMORY;
+}
+
+void Cleanup() {
+  DxcThreadMalloc TM(nullptr);
+  delete g_pIncludeCache;
+  g_pIncludeCache = nullptr;
+}
+
+} // namespace DxcIncludeCache
+} // namespace dxcutil
@@ -0,0 +1,68 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// dxcincludecache.h                                                         //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Provides a process-wide cache of included files for dxcompiler.           //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "dxc/dxcapi.h"
+#include "dxc/Support/microcom.h"
+
+/// Implemented by include handlers that load files from disk, so that cached
+/// includes can be revalidated without reading the files again. Such handlers
+/// must resolve relative file names against the current directory, as the
+/// cache keys their files by the full path that gives.
+struct __declspec(uuid("9a4e6c1b-3f52-4d8a-b7e0-5c2d81f6a39e"))
+IDxcIncludeHandlerFileStamp : public IUnknown {
+  // Gets a value that changes whenever the content of the file may have
+  // changed, typically derived from its size and last write time.
+  virtual HRESULT STDMETHODCALLTYPE GetFileStamp(_In_ LPCWSTR pFilename,
+                                                 _Out_ UINT64 *pStamp) = 0;
+};
+
+namespace dxcutil {
+
+/// Process-wide cache of UTF-8 include file contents, keyed by the full path
+/// each include name resolves to.
+///
+/// Files from handlers that implement IDxcIncludeHandlerFileStamp are reused
+/// for as long as their stamp is unchanged, without calling the handler.
+/// Files from other handlers are still loaded on every use, but reuse the
+/// UTF-8 conversion of identical content.
+///
+/// All storage owned by the cache is allocated from the default allocator,
+/// so the shared blobs may outlive the compile that loaded them.
+namespace DxcIncludeCache {
+
+// Loads pFilename through pHandler, or from the cache if it is still valid.
+// Returns S_OK and a null blob if the handler did not resolve the file.
+// *pNullTerminated is set if a null character follows the blob's content,
+// which holds for every blob kept by the cache.
+HRESULT Load(_In_ IDxcIncludeHandler *pHandler, _In_ LPCWSTR pFilename,
+             _COM_Outptr_result_maybenull_ IDxcBlobEncoding **ppUtf8,
+             _Out_ bool *pNullTerminated);
+
+// Reduces UTF-8 source to the directives that decide what it includes, for
+// dependency scanning. Minimized files are kept by content, so a header is
+// only scanned once however many shaders include it. Returns pUtf8 itself
+// and leaves *pNullTerminated unchanged if it can't be minimized; otherwise
+// the result is always followed by a null character.
+HRESULT Minimize(_In_ IDxcBlobEncoding *pUtf8,
+                 _COM_Outptr_ IDxcBlobEncoding **ppMinimized,
+                 _Inout_ bool *pNullTerminated);
+
+// Creates the cache; called when the library is loaded.
+HRESULT Initialize();
+
+// Drops all cached entries; called when the library is unloaded.
+void Cleanup();
+
+} // namespace DxcIncludeCache
+
+} // namespace dxcutil
@@ -0,0 +1,462 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// dxcincremental.cpp                                                        //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Implements function-level incremental compiles of libraries.              //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/Support/WinIncludes.h"
+#include "dxc/Support/Global.h"
+#include "dxc/Support/FileIOHelper.h"
+#include "dxc/dxcapi.h"
+#include "dxc/HLSL/HLModule.h"
+#include "dxc/HLSL/DxilOperations.h"
+#include "dxcincremental.h"
+#include "dxccompilecache.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/IR/DiagnosticInfo.h"
+#include "llvm/IR/Metadata.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/ModuleSlotTracker.h"
+#include "llvm/IR/TypeFinder.h"
+#include "llvm/Linker/Linker.h"
+#include "llvm/Support/raw_ostream.h"
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+using namespace llvm;
+using namespace hlsl;
+
+namespace {
+
+using namespace dxcutil;
+
+// Adds the defined functions that F refers to, in the order it refers to
+// them.
+void CollectReferencedFunctions(Function &F, SetVector<Function *> &callees) {
+  for (BasicBlock &BB : F) {
+    for (Instruction &I : BB) {
+      for (Value *V : I.operand_values()) {
+        Function *G = dyn_cast<Function>(V->stripPointerCasts());
+        if (G && !G->isDeclaration())
+          callees.insert(G);
+      }
+    }
+  }
+}
+
+class FunctionDigester {
+public:
+  FunctionDigester(Module &M) : m_MST(&M) {}
+
+  const std::string &GetDigest(Function &F) {
+    auto it = m_digests.find(&F);
+    if (it != m_digests.end())
+      return it->second;
+
+    m_inProgress.insert(&F);
+    DxcCompileCacheKeyBuilder builder;
+    std::string text;
+    raw_string_ostream os(text);
+    static_cast<Value &>(F).print(os, m_MST);
+    builder.AddString(os.str());
+    SetVector<Function *> callees;
+    CollectReferencedFunctions(F, callees);
+    for (Function *G : callees) {
+      // Recursion isn't allowed, but the name is enough to keep a cycle
+      // from recurring here.
+      if (m_inProgress.count(G))
+        builder.AddString(G->getName());
+      else
+        builder.AddString(GetDigest(*G));
+    }
+    m_inProgress.erase(&F);
+    return m_digests[&F] = builder.GetDigest();
+  }
+
+private:
+  ModuleSlotTracker m_MST;
+  DenseMap<Function *, std::string> m_digests;
+  SmallPtrSet<Function *, 8> m_inProgress;
+};
+
+// Adds metadata to builder; nodes already added are referred to by the order
+// they were first seen in, so shared and cyclic nodes are covered once.
+void AddMetadata(DxcCompileCacheKeyBuilder &builder, const Metadata *MD,
+                 DenseMap<const MDNode *, unsigned> &visited,
+                 ModuleSlotTracker &MST) {
+  enum { NullTag, StringTag, ValueTag, NodeRefTag, NodeTag };
+  if (MD == nullptr) {
+    builder.AddUInt32(NullTag);
+  } else if (const MDString *S = dyn_cast<MDString>(MD)) {
+    builder.AddUInt32(StringTag);
+    builder.AddString(S->getString());
+  } else if (const ValueAsMetadata *VM = dyn_cast<ValueAsMetadata>(MD)) {
+    builder.AddUInt32(ValueTag);
+    std::string text;
+    raw_string_ostream os(text);
+    VM->getValue()->printAsOperand(os, /*PrintType*/ true, MST);
+    builder.AddString(os.str());
+  } else if (const MDNode *N = dyn_cast<MDNode>(MD)) {
+    auto it = visited.find(N);
+    if (it != visited.end()) {
+      builder.AddUInt32(NodeRefTag);
+      builder.AddUInt32(it->second);
+      return;
+    }
+    unsigned index = visited.size();
+    visited[N] = index;
+    builder.AddUInt32(NodeTag);
+    builder.AddUInt32(N->getNumOperands());
+    for (const MDOperand &Op : N->operands())
+      AddMetadata(builder, Op.get(), visited, MST);
+  } else {
+    // No other kind of metadata is expected outside debug info, which
+    // incremental compiles leave out.
+    builder.AddUInt32(UINT32_MAX);
+  }
+}
+
+std::string GetModuleDigest(Module &M) {
+  ModuleSlotTracker MST(&M);
+  DxcCompileCacheKeyBuilder builder;
+  builder.AddString(M.getDataLayoutStr());
+  builder.AddString(M.getTargetTriple());
+
+  // Functions print their types by name, so the bodies are covered here.
+  TypeFinder types;
+  types.run(M, /*onlyNamed*/ false);
+  for (StructType *ST : types) {
+    if (ST->isLiteral())
+      continue;
+    builder.AddString(ST->getName());
+    builder.AddUInt32(ST->isPacked());
+    builder.AddUInt32(ST->isOpaque());
+    builder.AddUInt32(ST->getNumElements());
+    for (Type *ElTy : ST->elements()) {
+      std::string text;
+      raw_string_ostream os(text);
+      ElTy->print(os);
+      builder.AddString(os.str());
+    }
+  }
+
+  for (GlobalVariable &GV : M.globals()) {
+    std::string text;
+    raw_string_ostream os(text);
+    GV.print(os, MST);
+    builder.AddString(os.str());
+  }
+
+  for (Function &F : M.functions()) {
+    std::string text;
+    raw_string_ostream os(text);
+    F.getType()->print(os);
+    builder.AddString(F.getName());
+    builder.AddString(os.str());
+    builder.AddUInt32(F.getLinkage());
+    builder.AddUInt32(F.getCallingConv());
+    builder.AddUInt32(F.isDeclaration());
+    AttributeSet attrs = F.getAttributes();
+    builder.AddUInt32(attrs.getNumSlots());
+    for (unsigned i = 0; i < attrs.getNumSlots(); ++i) {
+      unsigned index = attrs.getSlotIndex(i);
+      builder.AddUInt32(index);
+      builder.AddString(attrs.getAsString(index));
+    }
+  }
+
+  DenseMap<const MDNode *, unsigned> visited;
+  for (NamedMDNode &NMD : M.named_metadata()) {
+    builder.AddString(NMD.getName());
+    builder.AddUInt32(NMD.getNumOperands());
+    for (const MDNode *N : NMD.operands())
+      AddMetadata(builder, N, visited, MST);
+  }
+  return builder.GetDigest();
+}
+
+// Digests are stored as the module digest followed by a count of function
+// digests and each function name and digest, each string preceded by its
+// UINT32 length.
+void AddSerializedString(std::string &data, StringRef value) {
+  UINT32 size = (UINT32)value.size();
+  data.append((const char *)&size, sizeof(size));
+  data.append(value.data(), value.size());
+}
+
+bool ReadSerializedString(StringRef &data, StringRef &value) {
+  UINT32 size;
+  if (data.size() < sizeof(size))
+    return false;
+  memcpy(&size, data.data(), sizeof(size));
+  data = data.drop_front(sizeof(size));
+  if (data.size() < size)
+    return false;
+  value = data.substr(0, size);
+  data = data.drop_front(size);
+  return true;
+}
+
+void SerializeDigests(const DxcFunctionDigests &digests, IDxcBlob **ppBlob) {
+  std::string data;
+  AddSerializedString(data, digests.ModuleDigest);
+  UINT32 count = digests.Functions.size();
+  data.append((const char *)&count, sizeof(count));
+  for (const auto &entry : digests.Functions) {
+    AddSerializedString(data, entry.getKey());
+    AddSerializedString(data, entry.getValue());
+  }
+  IFTBOOL(data.size() <= UINT32_MAX, DXC_E_DATA_TOO_LARGE);
+  IFT(DxcCreateBlobOnHeapCopy(data.data(), (UINT32)data.size(), ppBlob));
+}
+
+bool DeserializeDigests(IDxcBlob *pBlob, DxcFunctionDigests &digests) {
+  StringRef data((const char *)pBlob->GetBufferPointer(),
+                 pBlob->GetBufferSize());
+  StringRef moduleDigest;
+  UINT32 count;
+  if (!ReadSerializedString(data, moduleDigest) || data.size() < sizeof(count))
+    return false;
+  memcpy(&count, data.data(), sizeof(count));
+  data = data.drop_front(sizeof(count));
+  digests.ModuleDigest = moduleDigest;
+  digests.Functions.clear();
+  for (UINT32 i = 0; i < count; ++i) {
+    StringRef name, digest;
+    if (!ReadSerializedString(data, name) ||
+        !ReadSerializedString(data, digest))
+      return false;
+    digests.Functions[name] = digest;
+  }
+  return data.empty();
+}
+
+struct IncrementalCacheEntry {
+  CComPtr<IDxcBlob> pDigests;
+  CComPtr<IDxcBlob> pProgram;
+};
+
+class IncrementalCacheImpl {
+public:
+  // Bound on the number of libraries tracked; the oldest entries are dropped
+  // first once it is reached.
+  static const size_t MaxEntries = 256;
+
+  std::shared_ptr<IncrementalCacheEntry> Find(const std::string &key) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_entries.find(key);
+    if (it == m_entries.end())
+      return nullptr;
+    return it->second;
+  }
+
+  void Insert(const std::string &key,
+              std::shared_ptr<IncrementalCacheEntry> entry) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_entries.find(key);
+    if (it != m_entries.end()) {
+      it->second = std::move(entry);
+      return;
+    }
+    if (m_entries.size() == MaxEntries) {
+      m_entries.erase(m_order.front());
+      m_order.pop_front();
+    }
+    m_entries[key] = std::move(entry);
+    m_order.push_back(key);
+  }
+
+private:
+  std::mutex m_mutex;
+  std::unordered_map<std::string, std::shared_ptr<IncrementalCacheEntry>>
+      m_entries;
+  std::deque<std::string> m_order;
+};
+
+// Created by DxcIncrementalCache::Initialize when the library is loaded.
+IncrementalCacheImpl *g_pIncrementalCache;
+
+} // namespace
+
+namespace dxcutil {
+
+void ComputeFunctionDigests(Module &M, DxcFunctionDigests &digests) {
+  digests.ModuleDigest = GetModuleDigest(M);
+  digests.Functions.clear();
+  FunctionDigester digester(M);
+  for (Function &F : M.functions()) {
+    if (!F.isDeclaration())
+      digests.Functions[F.getName()] = digester.GetDigest(F);
+  }
+}
+
+bool CanCompileFunctionsApart(Module &M) {
+  for (GlobalVariable &GV : M.globals()) {
+    if (GV.hasLocalLinkage() && !GV.isConstant())
+      return false;
+  }
+  return true;
+}
+
+void StripUnchangedFunctions(Module &M, const StringSet<> &changed) {
+  HLModule &HLM = M.GetOrCreateHLModule();
+
+  SetVector<Function *> keep;
+  for (const auto &entry : changed) {
+    Function *F = M.getFunction(entry.getKey());
+    if (F && !F->isDeclaration())
+      keep.insert(F);
+  }
+  // keep grows as it's walked, so it ends up closed under references.
+  for (unsigned i = 0; i < keep.size(); ++i)
+    CollectReferencedFunctions(*keep[i], keep);
+
+  std::vector<Function *> unchanged;
+  for (Function &F : M.functions()) {
+    if (!F.isDeclaration() && !keep.count(&F))
+      unchanged.push_back(&F);
+  }
+
+  // The metadata is emitted again from HLM once the functions are gone.
+  HLModule::ClearHLMetadata(M);
+  for (Function *F : unchanged) {
+    HLM.RemoveFunction(F);
+    F->deleteBody();
+  }
+  for (Function *F : unchanged) {
+    if (F->use_empty())
+      F->eraseFromParent();
+  }
+  HLM.EmitHLMetadata();
+}
+
+bool MergeChangedFunctions(Module &Prev, std::unique_ptr<Module> Changed,
+                           const StringSet<> &changed) {
+  // Prev's metadata already describes every function and resource.
+  if (GlobalVariable *pUsed = Changed->getGlobalVariable("llvm.used"))
+    pUsed->eraseFromParent();
+  std::vector<NamedMDNode *> namedMDs;
+  for (NamedMDNode &NMD : Changed->named_metadata())
+    namedMDs.push_back(&NMD);
+  for (NamedMDNode *NMD : namedMDs)
+    Changed->eraseNamedMetadata(NMD);
+
+  // Every exported function that changed must have a new definition.
+  for (const auto &entry : changed) {
+    Function *PF = Prev.getFunction(entry.getKey());
+    if (PF == nullptr || PF->isDeclaration() || PF->hasLocalLinkage())
+      continue;
+    Function *F = Changed->getFunction(entry.getKey());
+    if (F == nullptr || F->isDeclaration())
+      return false;
+  }
+
+  // Unchanged functions compiled along with the changed ones keep their
+  // definitions in Prev, unless they're internal, in which case they're
+  // linked in as a copy.
+  for (Function &F : Changed->functions()) {
+    if (F.isDeclaration() || F.hasLocalLinkage())
+      continue;
+    Function *PF = Prev.getFunction(F.getName());
+    if (PF == nullptr || PF->hasLocalLinkage())
+      return false;
+    if (!changed.count(F.getName())) {
+      if (PF->isDeclaration())
+        return false;
+      F.deleteBody();
+    }
+  }
+
+  for (GlobalVariable &GV : Changed->globals()) {
+    if (GV.hasLocalLinkage()) {
+      if (!GV.isConstant())
+        return false;
+      continue;
+    }
+    if (GV.hasAppendingLinkage() ||
+        Prev.getGlobalVariable(GV.getName(), /*AllowLocal*/ false) == nullptr)
+      return false;
+    if (GV.hasInitializer())
+      GV.setInitializer(nullptr);
+  }
+
+  for (const auto &entry : changed) {
+    Function *PF = Prev.getFunction(entry.getKey());
+    if (PF && !PF->isDeclaration() && !PF->hasLocalLinkage())
+      PF->deleteBody();
+  }
+  bool linkFailed = Linker::LinkModules(&Prev, Changed.get(),
+                                        [](const DiagnosticInfo &) {});
+  if (linkFailed)
+    return false;
+
+  // Operations only the old definitions called are no longer used, and
+  // unused declarations don't validate.
+  std::vector<Function *> unusedOps;
+  for (Function &F : Prev.functions()) {
+    if (F.isDeclaration() && F.use_empty() && OP::IsDxilOpFunc(&F))
+      unusedOps.push_back(&F);
+  }
+  for (Function *F : unusedOps)
+    F->eraseFromParent();
+  return true;
+}
+
+namespace DxcIncrementalCache {
+
+bool Lookup(const std::string &key, DxcFunctionDigests &digests,
+            IDxcBlob **ppProgram) {
+  *ppProgram = nullptr;
+  CComPtr<IDxcBlob> pDigests;
+  CComPtr<IDxcBlob> pProgram;
+  {
+    // Cache storage is shared across compiler instances and their
+    // allocators; the digests are read into the caller's.
+    DxcThreadMalloc TM(nullptr);
+    std::shared_ptr<IncrementalCacheEntry> entry =
+        g_pIncrementalCache->Find(key);
+    if (!entry)
+      return false;
+    pDigests = entry->pDigests;
+    pProgram = entry->pProgram;
+  }
+  if (!DeserializeDigests(pDigests, digests))
+    return false;
+  *ppProgram = pProgram.Detach();
+  return true;
+}
+
+void Insert(const std::string &key, const DxcFunctionDigests &digests,
+            IDxcBlob *pProgram) {
+  DxcThreadMalloc TM(nullptr);
+  std::shared_ptr<IncrementalCacheEntry> entry =
+      std::make_shared<IncrementalCacheEntry>();
+  SerializeDigests(digests, &entry->pDigests);
+  IFT(DxcCreateBlobOnHeapCopy(pProgram->GetBufferPointer(),
+                              pProgram->GetBufferSize(), &entry->pProgram));
+  g_pIncrementalCache->Insert(key, std::move(entry));
+}
+
+HRESULT Initialize() {
+  DXASSERT(g_pIncrementalCache == nullptr, "else double-init");
+  DxcThreadMalloc TM(nullptr);
+  g_pIncrementalCache = new (std::nothrow) IncrementalCacheImpl();
+  return g_pIncrementalCache ? S_OK : E_OUTOFMEMORY;
+}
+
+void Cleanup() {
+  DxcThreadMalloc TM(nullptr);
+  delete g_pIncrementalCache;
+  g_pIncrementalCache = nullptr;
+}
+
+} // namespace DxcIncrementalCache
+} // namespace dxcutil
@@ -0,0 +1,90 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// dxcincremental.h                                                          //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Provides function-level incremental compiles of libraries for dxcompiler. //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "dxc/dxcapi.h"
+#include "dxc/Support/microcom.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringSet.h"
+#include <memory>
+#include <string>
+
+namespace llvm {
+class Module;
+}
+
+namespace dxcutil {
+
+/// Digests of a high-level library module, which tell the functions whose
+/// DXIL may differ from an earlier compile apart from those whose DXIL can
+/// be reused.
+struct DxcFunctionDigests {
+  /// Covers everything outside function bodies: globals, the name, type,
+  /// linkage and attributes of every function, and named metadata, which
+  /// holds function properties, annotations and resources. Compiles with
+  /// different module digests share nothing.
+  std::string ModuleDigest;
+  /// The digest of each defined function covers its body and the digests of
+  /// every function it references, so a function changes with its callees.
+  llvm::StringMap<std::string> Functions;
+};
+
+// Computes the digests of the high-level module M.
+void ComputeFunctionDigests(llvm::Module &M, DxcFunctionDigests &digests);
+
+// Returns true if the functions of M can be compiled apart from each other.
+// Globals that functions may write and that aren't visible outside the
+// library rule this out, as optimizing some of their users alone could
+// change how the others see them.
+bool CanCompileFunctionsApart(llvm::Module &M);
+
+// Reduces the high-level module M to the functions in changed and the
+// functions they reference, which are compiled along with them so that
+// they're inlined as in a full compile.
+void StripUnchangedFunctions(llvm::Module &M, const llvm::StringSet<> &changed);
+
+// Replaces the functions in changed in Prev, a DXIL library compiled from
+// the same module digest, with their definitions in Changed, the DXIL
+// compiled from the module StripUnchangedFunctions reduced. Returns false,
+// leaving Prev unspecified, if Changed refers to anything Prev lacks.
+bool MergeChangedFunctions(llvm::Module &Prev,
+                           std::unique_ptr<llvm::Module> Changed,
+                           const llvm::StringSet<> &changed);
+
+/// Process-wide record of the latest incremental compile of each library.
+///
+/// Entries are keyed on everything about a compile request but its source
+/// and includes, whose effect the digests capture, and hold the DXIL
+/// program bitcode of the compile along with the digests it was built from.
+///
+/// All storage owned by the cache is allocated from the default allocator,
+/// so entries may outlive the compiler object that produced them.
+namespace DxcIncrementalCache {
+
+// Returns true and the digests and program of the latest compile recorded
+// under key.
+bool Lookup(const std::string &key, DxcFunctionDigests &digests,
+            _COM_Outptr_ IDxcBlob **ppProgram);
+
+// Records a compile under key, replacing the one before it.
+void Insert(const std::string &key, const DxcFunctionDigests &digests,
+            _In_ IDxcBlob *pProgram);
+
+// Creates the cache; called when the library is loaded.
+HRESULT Initialize();
+
+// Drops all cached entries; called when the library is unloaded.
+void Cleanup();
+
+} // namespace DxcIncrementalCache
+
+} // namespace dxcutil
@@ -19,11 +19,13 @@
 
 #include "dxc/dxcapi.internal.h"
 #include "dxc/dxctools.h"
+#include "dxcincludecache.h"
 
 using namespace llvm;
 using namespace hlsl;
 
-class DxcIncludeHandlerForFS : public IDxcIncludeHandler {
+class DxcIncludeHandlerForFS : public IDxcIncludeHandler,
+                               public IDxcIncludeHandlerFileStamp {
 private:
   DXC_MICROCOM_TM_REF_FIELDS()
 public:
@@ -31,7 +33,25 @@ public:
   DXC_MICROCOM_TM_CTOR(DxcIncludeHandlerForFS)
 
   HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) {
-    return DoBasicQueryInterface<IDxcIncludeHandler>(this, iid, ppvObject);
+    return DoBasicQueryInterface<IDxcIncludeHandler,
+                                 IDxcIncludeHandlerFileStamp>(this, iid,
+                                                              ppvObject);
+  }
+
+  __override HRESULT STDMETHODCALLTYPE GetFileStamp(
+    _In_ LPCWSTR pFilename, _Out_ UINT64 *pStamp) {
+    *pStamp = 0;
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExW(pFilename, GetFileExInfoStandard, &data)) {
+      return HRESULT_FROM_WIN32(GetLastError());
+    }
+    // Fold the size into the last write time; either changing is enough to
+    // treat the file as modified.
+    UINT64 writeTime = ((UINT64)data.ftLastWriteTime.dwHighDateTime << 32) |
+                       data.ftLastWriteTime.dwLowDateTime;
+    UINT64 size = ((UINT64)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+    *pStamp = writeTime ^ (size * 0x9E3779B97F4A7C15ULL);
+    return S_OK;
   }
 
   __override HRESULT STDMETHODCALLTYPE LoadSource(
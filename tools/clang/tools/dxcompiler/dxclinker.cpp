@@ -21,10 +21,18 @@
 
 #include "llvm/ADT/SmallVector.h"
 #include <algorithm>
+#include <atomic>
+#include <exception>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
 
 #include "dxc/HLSL/DxilLinker.h"
+#include "dxc/HLSL/DxilModule.h"
 #include "dxc/HLSL/DxilValidation.h"
 #include "dxc/Support/Unicode.h"
+#include "dxc/Support/WorkerThreads.h"
 #include "dxc/Support/microcom.h"
 #include "dxc/dxcapi.internal.h"
 #include "dxcutil.h"
@@ -42,7 +50,7 @@ using namespace llvm;
 // This declaration is used for the locally-linked validator.
 HRESULT CreateDxcValidator(_In_ REFIID riid, _Out_ LPVOID *ppv);
 
-class DxcLinker : public IDxcLinker, public IDxcContainerEvent {
+class DxcLinker : public IDxcLinker2, public IDxcContainerEvent {
 public:
   DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
   DXC_MICROCOM_TM_CTOR(DxcLinker)
@@ -68,6 +76,17 @@ public:
           *ppResult // Linker output status, buffer, and errors
   );
 
+  // Links several entry points against one set of libraries.
+  __override HRESULT STDMETHODCALLTYPE LinkBatch(
+      _In_count_(entryCount) const LPCWSTR *pEntryNames,
+      _In_count_(entryCount) const LPCWSTR *pTargetProfiles,
+      UINT32 entryCount,
+      _In_count_(libCount) const LPCWSTR *pLibNames,
+      UINT32 libCount,
+      _In_count_(argCount) const LPCWSTR *pArguments,
+      _In_ UINT32 argCount,
+      _Out_writes_(entryCount) IDxcOperationResult **ppResults);
+
   __override HRESULT STDMETHODCALLTYPE RegisterDxilContainerEventHandler(
       IDxcContainerEventsHandler *pHandler, UINT64 *pCookie) {
     DxcThreadMalloc TM(m_pMalloc);
@@ -87,7 +106,8 @@ public:
   }
 
   HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void **ppvObject) {
-    return DoBasicQueryInterface<IDxcLinker>(this, riid, ppvObject);
+    return DoBasicQueryInterface<IDxcLinker, IDxcLinker2>(this, riid,
+                                                           ppvObject);
   }
 
   void Initialize() {
@@ -100,11 +120,18 @@ public:
   }
 
 private:
+  // Attaches the named libraries; errors are reported through m_Ctx.
+  bool AttachLibraries(const LPCWSTR *pLibNames, UINT32 libCount);
+  void OnContainerBuilt(CComPtr<IDxcBlob> &pOutputBlob);
+
   DXC_MICROCOM_TM_REF_FIELDS()
   LLVMContext m_Ctx;
   std::unique_ptr<DxilLinker> m_pLinker;
   CComPtr<IDxcContainerEventsHandler> m_pDxcContainerEventsHandler;
   std::vector<CComPtr<IDxcBlob>> m_blobs; // Keep blobs live for lazy load.
+  // Libraries attached by the last successful attach, in order; a link
+  // against the same libraries reuses the attached function table.
+  std::vector<std::string> m_attachedLibNames;
 };
 
 HRESULT
@@ -134,8 +161,23 @@ DxcLinker::RegisterLibrary(_In_opt_ LPCWSTR pLibName, // Name of the library.
         pBlob->GetBufferPointer(), pBlob->GetBufferSize(), pModule,
         pDebugModule, m_Ctx, m_Ctx, DiagStream));
 
+    // Libraries that carry a link index are registered without loading
+    // function bodies up front.
+    const void *pLinkIndex = nullptr;
+    uint32_t linkIndexSize = 0;
+    const DxilContainerHeader *pContainer =
+        (const DxilContainerHeader *)pBlob->GetBufferPointer();
+    if (IsValidDxilContainer(pContainer, pBlob->GetBufferSize())) {
+      if (const DxilPartHeader *pPart =
+              GetDxilPartByType(pContainer, DFCC_LinkIndex)) {
+        pLinkIndex = GetDxilPartData(pPart);
+        linkIndexSize = pPart->PartSize;
+      }
+    }
+
     if (m_pLinker->RegisterLib(pUtf8LibName.m_psz, std::move(pModule),
-                               std::move(pDebugModule))) {
+                               std::move(pDebugModule), pLinkIndex,
+                               linkIndexSize)) {
       m_blobs.emplace_back(pBlob);
       return S_OK;
     } else {
@@ -146,6 +188,67 @@ DxcLinker::RegisterLibrary(_In_opt_ LPCWSTR pLibName, // Name of the library.
   }
 }
 
+bool DxcLinker::AttachLibraries(const LPCWSTR *pLibNames, UINT32 libCount) {
+  // Attach libraries, unless they are the ones already attached.
+  std::vector<std::string> libNames;
+  for (unsigned i = 0; i < libCount; i++) {
+    CW2A pUtf8LibName(pLibNames[i], CP_UTF8);
+    libNames.emplace_back(pUtf8LibName.m_psz);
+  }
+  if (libNames == m_attachedLibNames)
+    return true;
+
+  // Detach previous libraries.
+  m_pLinker->DetachAll();
+  m_attachedLibNames.clear();
+  bool bSuccess = true;
+  for (const std::string &libName : libNames)
+    bSuccess &= m_pLinker->AttachLib(libName);
+  if (bSuccess)
+    m_attachedLibNames = std::move(libNames);
+  return bSuccess;
+}
+
+// Validates the linked module pM and wraps it in a container. pOutputStream
+// must already hold the bitcode of pM.
+static HRESULT AssembleLinkedModule(std::unique_ptr<Module> pM,
+                                    IMalloc *pMalloc,
+                                    CComPtr<AbstractMemoryStream> &pOutputStream,
+                                    raw_ostream &DiagStream,
+                                    CComPtr<IDxcBlob> &pOutputBlob,
+                                    bool &hasErrorOccurred) {
+  const IntrusiveRefCntPtr<clang::DiagnosticIDs> Diags(
+      new clang::DiagnosticIDs);
+  IntrusiveRefCntPtr<clang::DiagnosticOptions> DiagOpts =
+      new clang::DiagnosticOptions();
+  // Construct our diagnostic client.
+  clang::TextDiagnosticPrinter *DiagClient =
+      new clang::TextDiagnosticPrinter(DiagStream, &*DiagOpts);
+  clang::DiagnosticsEngine Diag(Diags, &*DiagOpts, DiagClient);
+
+  // Validation.
+  HRESULT valHR = dxcutil::ValidateAndAssembleToContainer(
+      std::move(pM), pOutputBlob, pMalloc, SerializeDxilFlags::None,
+      pOutputStream,
+      /*bDebugInfo*/ false, Diag);
+
+  hasErrorOccurred = Diag.hasErrorOccurred();
+  return valHR;
+}
+
+void DxcLinker::OnContainerBuilt(CComPtr<IDxcBlob> &pOutputBlob) {
+  // Callback after valid DXIL is produced
+  CComPtr<IDxcBlob> pTargetBlob;
+  if (m_pDxcContainerEventsHandler != nullptr) {
+    HRESULT hr = m_pDxcContainerEventsHandler->OnDxilContainerBuilt(
+        pOutputBlob, &pTargetBlob);
+    if (SUCCEEDED(hr) && pTargetBlob != nullptr) {
+      std::swap(pOutputBlob, pTargetBlob);
+    }
+  }
+  // TODO: DFCC_ShaderDebugName
+}
+
 // Links the shader and produces a shader blob that the Direct3D runtime can
 // use.
 HRESULT STDMETHODCALLTYPE DxcLinker::Link(
@@ -168,9 +271,6 @@ HRESULT STDMETHODCALLTYPE DxcLinker::Link(
 
   CComPtr<AbstractMemoryStream> pOutputStream;
 
-  // Detach previous libraries.
-  m_pLinker->DetachAll();
-
   HRESULT hr = S_OK;
   try {
     CComPtr<IMalloc> pMalloc;
@@ -200,53 +300,33 @@ HRESULT STDMETHODCALLTYPE DxcLinker::Link(
     m_Ctx.setDiagnosticHandler(PrintDiagnosticContext::PrintDiagnosticHandler,
                                &DiagContext, true);
 
-    // Attach libraries.
-    bool bSuccess = true;
-    for (unsigned i = 0; i < libCount; i++) {
-      CW2A pUtf8LibName(pLibNames[i], CP_UTF8);
-      bSuccess &= m_pLinker->AttachLib(pUtf8LibName.m_psz);
-    }
+    bool bSuccess = AttachLibraries(pLibNames, libCount);
 
     bool hasErrorOccurred = !bSuccess;
+    CComPtr<IDxcBlobEncoding> pResourceRemap;
     if (bSuccess) {
       std::unique_ptr<Module> pM =
           m_pLinker->Link(pUtf8EntryPoint.m_psz, pUtf8TargetProfile.m_psz);
       if (pM) {
-        const IntrusiveRefCntPtr<clang::DiagnosticIDs> Diags(
-            new clang::DiagnosticIDs);
-        IntrusiveRefCntPtr<clang::DiagnosticOptions> DiagOpts =
-            new clang::DiagnosticOptions();
-        // Construct our diagnostic client.
-        clang::TextDiagnosticPrinter *DiagClient =
-            new clang::TextDiagnosticPrinter(DiagStream, &*DiagOpts);
-        clang::DiagnosticsEngine Diag(Diags, &*DiagOpts, DiagClient);
+        std::string resourceRemap;
+        raw_string_ostream RemapStream(resourceRemap);
+        WriteLinkResourceRemap(pM->GetOrCreateDxilModule(), RemapStream);
+        RemapStream.flush();
 
         raw_stream_ostream outStream(pOutputStream.p);
         // Create bitcode of M.
         WriteBitcodeToFile(pM.get(), outStream);
         outStream.flush();
 
-        // Validation.
-        HRESULT valHR = dxcutil::ValidateAndAssembleToContainer(
-            std::move(pM), pOutputBlob, pMalloc, SerializeDxilFlags::None,
-            pOutputStream,
-            /*bDebugInfo*/ false, Diag);
-
-        // Callback after valid DXIL is produced
+        HRESULT valHR =
+            AssembleLinkedModule(std::move(pM), pMalloc, pOutputStream,
+                                 DiagStream, pOutputBlob, hasErrorOccurred);
         if (SUCCEEDED(valHR)) {
-          CComPtr<IDxcBlob> pTargetBlob;
-          if (m_pDxcContainerEventsHandler != nullptr) {
-            HRESULT hr = m_pDxcContainerEventsHandler->OnDxilContainerBuilt(
-                pOutputBlob, &pTargetBlob);
-            if (SUCCEEDED(hr) && pTargetBlob != nullptr) {
-              std::swap(pOutputBlob, pTargetBlob);
-            }
-          }
-          // TODO: DFCC_ShaderDebugName
+          OnContainerBuilt(pOutputBlob);
+          IFT(DxcCreateBlobWithEncodingOnHeapCopy(
+              resourceRemap.data(), resourceRemap.size(), CP_UTF8,
+              &pResourceRemap));
         }
-
-        hasErrorOccurred = Diag.hasErrorOccurred();
-
       } else {
         hasErrorOccurred = true;
       }
@@ -254,9 +334,189 @@ HRESULT STDMETHODCALLTYPE DxcLinker::Link(
     DiagStream.flush();
     CComPtr<IStream> pStream = pDiagStream;
     dxcutil::CreateOperationResultFromOutputs(pOutputBlob, pStream, warnings,
-                                              hasErrorOccurred, ppResult);
+                                              hasErrorOccurred, ppResult,
+                                              pResourceRemap);
+  }
+  CATCH_CPP_ASSIGN_HRESULT();
+  return hr;
+}
+
+namespace {
+// State of one entry point of a batch link.
+struct LinkBatchJob {
+  // Bitcode of the linked module, then the container source.
+  CComPtr<AbstractMemoryStream> pOutputStream;
+  CComPtr<AbstractMemoryStream> pDiagStream;
+  CComPtr<IDxcBlob> pOutputBlob;
+  std::string ResourceRemap;
+  bool bLinked = false;
+  bool hasErrorOccurred = false;
+  HRESULT valHR = S_OK;
+};
+
+// Loads the linked bitcode of job into its own context, then validates and
+// assembles it.
+void AssembleLinkBatchJob(LinkBatchJob &job, IMalloc *pMalloc) {
+  LLVMContext Ctx;
+  raw_stream_ostream DiagStream(job.pDiagStream);
+  std::unique_ptr<Module> pM;
+  HRESULT hr = ValidateLoadModule(
+      (const char *)job.pOutputStream->GetPtr(),
+      (uint32_t)job.pOutputStream->GetPtrSize(), pM, Ctx, DiagStream,
+      /*bLazyLoad*/ false);
+  if (FAILED(hr)) {
+    job.hasErrorOccurred = true;
+    job.valHR = hr;
+    return;
+  }
+  job.valHR = AssembleLinkedModule(std::move(pM), pMalloc, job.pOutputStream,
+                                   DiagStream, job.pOutputBlob,
+                                   job.hasErrorOccurred);
+  DiagStream.flush();
+}
+} // namespace
+
+HRESULT STDMETHODCALLTYPE DxcLinker::LinkBatch(
+    _In_count_(entryCount) const LPCWSTR *pEntryNames,
+    _In_count_(entryCount) const LPCWSTR *pTargetProfiles,
+    UINT32 entryCount,
+    _In_count_(libCount) const LPCWSTR *pLibNames,
+    UINT32 libCount,
+    _In_count_(argCount) const LPCWSTR *pArguments,
+    _In_ UINT32 argCount,
+    _Out_writes_(entryCount) IDxcOperationResult **ppResults) {
+  if (entryCount && (pEntryNames == nullptr || pTargetProfiles == nullptr ||
+                     ppResults == nullptr))
+    return E_INVALIDARG;
+  for (UINT32 i = 0; i < entryCount; ++i)
+    ppResults[i] = nullptr;
+  // No link options are supported yet.
+  if (argCount != 0)
+    return E_INVALIDARG;
+
+  DxcThreadMalloc TM(m_pMalloc);
+
+  HRESULT hr = S_OK;
+  try {
+    CComPtr<IMalloc> pMalloc;
+    IFT(CoGetMalloc(1, &pMalloc));
+
+    // Attach once; attach errors are reported for every entry.
+    std::string attachErrors;
+    bool bAttached;
+    {
+      raw_string_ostream AttachStream(attachErrors);
+      llvm::DiagnosticPrinterRawOStream DiagPrinter(AttachStream);
+      PrintDiagnosticContext DiagContext(DiagPrinter);
+      m_Ctx.setDiagnosticHandler(
+          PrintDiagnosticContext::PrintDiagnosticHandler, &DiagContext, true);
+      bAttached = AttachLibraries(pLibNames, libCount);
+      AttachStream.flush();
+    }
+
+    // Link every entry in the context that owns the libraries. Functions
+    // used by several entries are loaded only once by the first of them.
+    std::vector<LinkBatchJob> jobs(entryCount);
+    for (UINT32 i = 0; i < entryCount; ++i) {
+      LinkBatchJob &job = jobs[i];
+      IFT(CreateMemoryStream(pMalloc, &job.pOutputStream));
+      IFT(CreateMemoryStream(pMalloc, &job.pDiagStream));
+      raw_stream_ostream DiagStream(job.pDiagStream);
+      DiagStream << attachErrors;
+      if (!bAttached) {
+        job.hasErrorOccurred = true;
+        continue;
+      }
+
+      llvm::DiagnosticPrinterRawOStream DiagPrinter(DiagStream);
+      PrintDiagnosticContext DiagContext(DiagPrinter);
+      m_Ctx.setDiagnosticHandler(
+          PrintDiagnosticContext::PrintDiagnosticHandler, &DiagContext, true);
+      CW2A pUtf8EntryPoint(pEntryNames[i], CP_UTF8);
+      CW2A pUtf8TargetProfile(pTargetProfiles[i], CP_UTF8);
+      std::unique_ptr<Module> pM =
+          m_pLinker->Link(pUtf8EntryPoint.m_psz, pUtf8TargetProfile.m_psz);
+      if (!pM) {
+        job.hasErrorOccurred = true;
+        continue;
+      }
+      raw_string_ostream RemapStream(job.ResourceRemap);
+      WriteLinkResourceRemap(pM->GetOrCreateDxilModule(), RemapStream);
+      RemapStream.flush();
+      raw_stream_ostream outStream(job.pOutputStream.p);
+      WriteBitcodeToFile(pM.get(), outStream);
+      outStream.flush();
+      job.bLinked = true;
+    }
+    m_Ctx.setDiagnosticHandler(nullptr, nullptr);
+
+    // Validate and assemble the linked modules in parallel, each in its own
+    // context. Validation and assembly of each module stay on the thread
+    // that picked it up.
+    std::vector<LinkBatchJob *> linkedJobs;
+    for (LinkBatchJob &job : jobs) {
+      if (job.bLinked)
+        linkedJobs.emplace_back(&job);
+    }
+    WorkerThreadReservation reservation((unsigned)linkedJobs.size());
+    unsigned threadCount = reservation.GetThreadCount();
+    std::atomic<unsigned> nextJob(0);
+    std::vector<std::exception_ptr> errors(threadCount);
+    IMalloc *pThreadMalloc = m_pMalloc;
+    auto worker = [&](unsigned workerIndex) {
+      DxcThreadMalloc WorkerTM(pThreadMalloc);
+      WorkerThreadScope workerScope;
+      try {
+        for (unsigned i = nextJob++; i < linkedJobs.size(); i = nextJob++)
+          AssembleLinkBatchJob(*linkedJobs[i], pMalloc);
+      } catch (...) {
+        errors[workerIndex] = std::current_exception();
+      }
+    };
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < threadCount; ++i) {
+      try {
+        threads.emplace_back(worker, i);
+      } catch (std::system_error &) {
+        // The threads already started pick up the remaining modules.
+        break;
+      }
+    }
+    worker(0);
+    for (std::thread &thread : threads)
+      thread.join();
+    for (std::exception_ptr &error : errors) {
+      if (error)
+        std::rethrow_exception(error);
+    }
+
+    // Report in entry order; container callbacks are not run concurrently.
+    std::string warnings;
+    for (UINT32 i = 0; i < entryCount; ++i) {
+      LinkBatchJob &job = jobs[i];
+      CComPtr<IDxcBlobEncoding> pResourceRemap;
+      if (job.bLinked && SUCCEEDED(job.valHR) && job.pOutputBlob) {
+        OnContainerBuilt(job.pOutputBlob);
+        IFT(DxcCreateBlobWithEncodingOnHeapCopy(
+            job.ResourceRemap.data(), job.ResourceRemap.size(), CP_UTF8,
+            &pResourceRemap));
+      }
+      CComPtr<IStream> pStream = job.pDiagStream;
+      dxcutil::CreateOperationResultFromOutputs(
+          job.pOutputBlob, pStream, warnings, job.hasErrorOccurred,
+          &ppResults[i], pResourceRemap);
+    }
   }
   CATCH_CPP_ASSIGN_HRESULT();
+
+  if (FAILED(hr)) {
+    for (UINT32 i = 0; i < entryCount; ++i) {
+      if (ppResults[i]) {
+        ppResults[i]->Release();
+        ppResults[i] = nullptr;
+      }
+    }
+  }
   return hr;
 }
 
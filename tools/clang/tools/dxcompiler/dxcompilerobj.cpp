@@ -17,17 +17,31 @@
 #include "clang/Frontend/CompilerInstance.h"
 #include "clang/Lex/Preprocessor.h"
 #include "clang/Lex/HLSLMacroExpander.h"
+#include "llvm/ADT/StringSet.h"
 #include "clang/Frontend/ASTUnit.h"
 #include "clang/Frontend/TextDiagnosticPrinter.h"
 #include "clang/Sema/SemaHLSL.h"
 #include "llvm/Bitcode/ReaderWriter.h"
 #include "clang/Frontend/FrontendActions.h"
+#include "clang/CodeGen/BackendUtil.h"
 #include "clang/CodeGen/CodeGenAction.h"
+#include "llvm/IR/DiagnosticInfo.h"
+#include "llvm/IR/DiagnosticPrinter.h"
 #include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/Regex.h"
 #include "dxc/Support/WinIncludes.h"
 #include "dxc/HLSL/HLSLExtensionsCodegenHelper.h"
 #include "dxc/HLSL/DxilRootSignature.h"
+#include "dxc/HLSL/DxcPhaseReport.h"
 #include "dxcutil.h"
+#include "dxcbundle.h"
+#include "dxccancel.h"
+#include "dxccompilecache.h"
+#include "dxcdiagrecorder.h"
+#include "dxcentrypoints.h"
+#include "dxcincremental.h"
+#include "dxcphasetrace.h"
 #include "dxc/Support/dxcfilesystem.h"
 
 // SPIRV change starts
@@ -49,9 +63,14 @@
 #include "dxc/Support/dxcapi.impl.h"
 #include "dxc/Support/DxcLangExtensionsHelper.h"
 #include "dxc/Support/HLSLOptions.h"
+#include "dxc/Support/WorkerThreads.h"
 #include "dxcetw.h"
 #include "dxillib.h"
 #include <algorithm>
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <unordered_map>
 
 #define CP_UTF16 1200
 
@@ -71,29 +90,200 @@ HRESULT RunInternalValidator(_In_ IDxcValidator *pValidator,
                              _In_ llvm::Module *pModule,
                              _In_ llvm::Module *pDebugModule,
                              _In_ IDxcBlob *pShader, UINT32 Flags,
-                             _In_ IDxcOperationResult **ppResult);
+                             _In_ IDxcOperationResult **ppResult,
+                             _In_opt_ hlsl::CompilePhaseListener *pPhases,
+                             _In_opt_ const hlsl::DxilPartDigests *pTrustedParts);
 
 static void CreateOperationResultFromOutputs(
     IDxcBlob *pResultBlob, dxcutil::DxcArgsFileSystem *msfPtr,
     const std::string &warnings, clang::DiagnosticsEngine &diags,
-    _COM_Outptr_ IDxcOperationResult **ppResult) {
+    _COM_Outptr_ IDxcOperationResult **ppResult,
+    _In_opt_ IDxcBlobEncoding *pReport = nullptr,
+    _In_opt_ std::vector<DxcDiagnosticRecord> *pDiagnostics = nullptr) {
   CComPtr<IStream> pErrorStream;
   CComPtr<IDxcBlobEncoding> pErrorBlob;
   msfPtr->GetStdOutpuHandleStream(&pErrorStream);
   dxcutil::CreateOperationResultFromOutputs(pResultBlob, pErrorStream, warnings,
-                                            diags.hasErrorOccurred(), ppResult);
+                                            diags.hasErrorOccurred(), ppResult,
+                                            pReport, pDiagnostics);
 }
 
 static void CreateOperationResultFromOutputs(
     AbstractMemoryStream *pOutputStream, dxcutil::DxcArgsFileSystem *msfPtr,
     const std::string &warnings, clang::DiagnosticsEngine &diags,
-    _COM_Outptr_ IDxcOperationResult **ppResult) {
+    _COM_Outptr_ IDxcOperationResult **ppResult,
+    _In_opt_ IDxcBlobEncoding *pReport = nullptr) {
   CComPtr<IDxcBlob> pResultBlob;
   IFT(pOutputStream->QueryInterface(&pResultBlob));
   CreateOperationResultFromOutputs(pResultBlob, msfPtr, warnings, diags,
-                                   ppResult);
+                                   ppResult, pReport);
 }
 
+// Reports the diagnostics of optimization and DXIL generation on a module
+// that didn't come from the front end of this compile.
+static void HLModuleDiagnosticHandler(const llvm::DiagnosticInfo &DI,
+                                      void *Context) {
+  DiagnosticsEngine &Diags = *static_cast<DiagnosticsEngine *>(Context);
+  DiagnosticsEngine::Level Level;
+  switch (DI.getSeverity()) {
+  case DS_Error:
+    Level = DiagnosticsEngine::Error;
+    break;
+  case DS_Warning:
+    Level = DiagnosticsEngine::Warning;
+    break;
+  case DS_Note:
+    Level = DiagnosticsEngine::Note;
+    break;
+  case DS_Remark:
+    return;
+  }
+  std::string Message;
+  raw_string_ostream OS(Message);
+  DiagnosticPrinterRawOStream DP(OS);
+  DI.print(DP);
+  OS.flush();
+  Diags.Report(Diags.getCustomDiagID(Level, "%0")) << Message;
+}
+
+// Changed library functions are compiled in groups on worker threads once
+// there are enough of them for the threads to pay off.
+static const unsigned kMinFunctionsPerCompileThread = 4;
+
+// Runs Task(0) .. Task(Count - 1) on the threads reserved for them, this one
+// included. The workers use the allocator and file system of the calling
+// thread.
+static void ParallelForWithThreadSystem(
+    unsigned Count, const std::function<void(unsigned)> &Task) {
+  IMalloc *pMalloc = DxcGetThreadMallocNoRef();
+  ::llvm::sys::fs::MSFileSystem *pFileSystem =
+      ::llvm::sys::fs::GetCurrentThreadFileSystem();
+  WorkerThreadReservation reservation(Count);
+  unsigned threadCount = reservation.GetThreadCount();
+  std::atomic<unsigned> nextTask(0);
+  std::vector<std::exception_ptr> errors(threadCount);
+  auto worker = [&](unsigned workerIndex) {
+    DxcThreadMalloc TM(pMalloc);
+    WorkerThreadScope workerScope;
+    try {
+      ::llvm::sys::fs::AutoPerThreadSystem pts(pFileSystem);
+      IFTLLVM(pts.error_code());
+      for (unsigned i = nextTask++; i < Count; i = nextTask++)
+        Task(i);
+    } catch (...) {
+      errors[workerIndex] = std::current_exception();
+    }
+  };
+  std::vector<std::thread> threads;
+  for (unsigned i = 1; i < threadCount; ++i) {
+    try {
+      threads.emplace_back(worker, i);
+    } catch (std::system_error &) {
+      // The threads already started pick up the remaining tasks.
+      break;
+    }
+  }
+  worker(0);
+  for (std::thread &thread : threads)
+    thread.join();
+  for (std::exception_ptr &error : errors) {
+    if (error)
+      std::rethrow_exception(error);
+  }
+}
+
+namespace {
+// State of one entry point of a batch compile.
+struct CompileBatchJob {
+  dxcutil::EmitEntryPointsAction::EntryPoint *pEntry = nullptr;
+  // Bitcode of the module, then the container source.
+  CComPtr<AbstractMemoryStream> pOutputStream;
+  CComPtr<IDxcBlob> pOutputBlob;
+  std::string ValidationErrors;
+  bool hasErrorOccurred = false;
+  HRESULT valHR = S_OK;
+};
+} // namespace
+
+// Writes the bitcode of the module of job, then validates it and wraps it in
+// a container. Runs concurrently with the other jobs of the batch, so errors
+// go to a diagnostics engine of its own.
+static void AssembleCompileBatchJob(CompileBatchJob &job, IMalloc *pMalloc,
+                                    SerializeDxilFlags SerializeFlags,
+                                    bool needsValidation, bool bDebugInfo) {
+  std::unique_ptr<llvm::Module> pM = std::move(job.pEntry->Module);
+  {
+    raw_stream_ostream outStream(job.pOutputStream.p);
+    WriteBitcodeToFile(pM.get(), outStream);
+  }
+  if (!needsValidation) {
+    dxcutil::AssembleToContainer(std::move(pM), job.pOutputBlob, pMalloc,
+                                 SerializeFlags, job.pOutputStream);
+    return;
+  }
+
+  IntrusiveRefCntPtr<DiagnosticIDs> DiagIDs(new DiagnosticIDs);
+  IntrusiveRefCntPtr<DiagnosticOptions> DiagOpts = new DiagnosticOptions();
+  raw_string_ostream DiagStream(job.ValidationErrors);
+  DiagnosticsEngine Diag(DiagIDs, &*DiagOpts,
+                         new TextDiagnosticPrinter(DiagStream, &*DiagOpts));
+  job.valHR = dxcutil::ValidateAndAssembleToContainer(
+      std::move(pM), job.pOutputBlob, pMalloc, SerializeFlags,
+      job.pOutputStream, bDebugInfo, Diag);
+  job.hasErrorOccurred = Diag.hasErrorOccurred();
+  DiagStream.flush();
+}
+
+// Records the #include directives seen by the preprocessor, for the
+// -report-includes report.
+class IncludeReportCallbacks : public PPCallbacks {
+  SourceManager &m_SM;
+  std::string m_report;
+  raw_string_ostream m_out;
+
+public:
+  IncludeReportCallbacks(SourceManager &SM) : m_SM(SM), m_out(m_report) {
+    m_out << "file\tincluder\tline\tfound\n";
+  }
+
+  void InclusionDirective(SourceLocation HashLoc, const Token &IncludeTok,
+                          StringRef FileName, bool IsAngled,
+                          CharSourceRange FilenameRange, const FileEntry *File,
+                          StringRef SearchPath, StringRef RelativePath,
+                          const clang::Module *Imported) override {
+    PresumedLoc PLoc = m_SM.getPresumedLoc(HashLoc);
+    m_out << (File ? StringRef(File->getName()) : FileName) << '\t'
+          << (PLoc.isValid() ? PLoc.getFilename() : "") << '\t'
+          << (PLoc.isValid() ? PLoc.getLine() : 0) << '\t'
+          << (File ? 1 : 0) << '\n';
+  }
+
+  void CreateReport(_COM_Outptr_ IDxcBlobEncoding **ppReport) {
+    m_out.flush();
+    IFT(DxcCreateBlobWithEncodingOnHeapCopy(m_report.data(), m_report.size(),
+                                            CP_UTF8, ppReport));
+  }
+};
+
+// Lists the files included during a -scan-deps preprocess, each once, in the
+// order they were first included.
+class DependencyListCallbacks : public PPCallbacks {
+  raw_ostream &m_out;
+  llvm::StringSet<> m_seen;
+
+public:
+  DependencyListCallbacks(raw_ostream &out) : m_out(out) {}
+
+  void InclusionDirective(SourceLocation HashLoc, const Token &IncludeTok,
+                          StringRef FileName, bool IsAngled,
+                          CharSourceRange FilenameRange, const FileEntry *File,
+                          StringRef SearchPath, StringRef RelativePath,
+                          const clang::Module *Imported) override {
+    if (File && m_seen.insert(File->getName()).second)
+      m_out << File->getName() << '\n';
+  }
+};
+
 class HLSLExtensionsCodegenHelperImpl : public HLSLExtensionsCodegenHelper {
 private:
   CompilerInstance &m_CI;
@@ -124,8 +314,11 @@ private:
   }
 
   SemanticDefineErrorList GetValidatedSemanticDefines(const ParsedSemanticDefineList &defines, ParsedSemanticDefineList &validated, SemanticDefineErrorList &errors) {
-    for (const ParsedSemanticDefine &define : defines) {
-      DxcLangExtensionsHelper::SemanticDefineValidationResult result = m_langExtensionsHelper.ValidateSemanticDefine(define.Name, define.Value);
+    std::vector<DxcLangExtensionsHelper::SemanticDefineValidationResult> results =
+      m_langExtensionsHelper.ValidateSemanticDefines(defines);
+    for (size_t i = 0; i < defines.size(); ++i) {
+      const ParsedSemanticDefine &define = defines[i];
+      DxcLangExtensionsHelper::SemanticDefineValidationResult &result = results[i];
         if (result.HasError())
           errors.emplace_back(SemanticDefineError(define.Location, SemanticDefineError::Level::Error, result.Error));
         if (result.HasWarning())
@@ -194,9 +387,55 @@ public:
   }
 };
 
-class DxcCompiler : public IDxcCompiler2, public IDxcLangExtensions, public IDxcContainerEvent, public IDxcVersionInfo {
+// Options shared by every compile of a request. Compile and CompileWithDebug
+// build these for each call; IDxcCompilerSession builds them once and reuses
+// them for every compile in the session, and IDxcCompilerArgsParser for every
+// compile given the same handle.
+struct CompileOptions {
+  CompileOptions() {}
+  CompileOptions(const CompileOptions &) = delete;
+  hlsl::options::MainArgs MainArgs;   // Backing storage for Opts.
+  hlsl::options::DxcOpts Opts;
+  std::string Utf8TargetProfile;      // Backing storage for Opts.TargetProfile.
+  std::vector<std::string> Defines;   // API and command-line defines.
+  std::vector<std::string> Arguments; // UTF-8 arguments recorded in codegen.
+  bool HasValidatorVersion = false;
+  UINT32 ValidatorMajor = 0;
+  UINT32 ValidatorMinor = 0;
+  // Includes already loaded for this source and include handler, which the
+  // compile uses instead of asking the handler again.
+  dxcutil::DxcArgsFileSystem::IncludedFileList PreloadedIncludes;
+};
+
+// Arguments parsed by IDxcCompilerArgsParser::ParseArguments. The validator
+// version is resolved when they are parsed, so compiles only read the
+// options and may use them concurrently.
+class __declspec(uuid("2B7F0C94-5E31-4A86-9D2C-7E4A1F6B8D03"))
+DxcCompilerArgs : public IDxcCompilerArgs {
 private:
   DXC_MICROCOM_TM_REF_FIELDS()
+public:
+  DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
+  DXC_MICROCOM_TM_CTOR(DxcCompilerArgs)
+
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) {
+    // Lets compiler objects recognize handles they can use.
+    if (ppvObject != nullptr && IsEqualIID(iid, __uuidof(DxcCompilerArgs))) {
+      *ppvObject = this;
+      AddRef();
+      return S_OK;
+    }
+    return DoBasicQueryInterface<IDxcCompilerArgs>(this, iid, ppvObject);
+  }
+
+  CompileOptions Options;
+};
+
+class DxcCompiler : public IDxcCompiler3, public IDxcCompilerSession, public IDxcCompilerArgsParser, public IDxcCompilerPermutations, public IDxcDisassembler, public IDxcRootSignatureCache, public IDxcCompilerCancel, public IDxcCompilerToStreams, public IDxcCompilerBundle, public IDxcLangExtensions, public IDxcContainerEvent, public IDxcVersionInfo {
+private:
+  DXC_MICROCOM_TM_REF_FIELDS()
+  // Number of CancelCompiles calls; a compile stops once it changes.
+  std::atomic<UINT64> m_cancelCount{0};
   DxcLangExtensionsHelper m_langExtensionsHelper;
   CComPtr<IDxcContainerEventsHandler> m_pDxcContainerEventsHandler;
 
@@ -236,6 +475,496 @@ private:
     DXASSERT(!opts.HLSL2015, "else ReadDxcOpts didn't fail for non-isense");
     finished = false;
   }
+
+  std::unique_ptr<CompileOptions> m_pSessionOptions;
+
+  static void CreateUtf8Arguments(_In_count_(argCount) LPCWSTR *pArguments,
+                                  UINT32 argCount,
+                                  std::vector<std::string> &arguments) {
+    // Constructing vector of strings to pass in to codegen. Just passing
+    // in pArguments will expose ownership of memory to both CodeGenOptions and
+    // this caller, which can lead to unexpected behavior.
+    for (UINT32 i = 0; i != argCount; ++i) {
+      arguments.emplace_back(Unicode::UTF16ToUTF8StringOrThrow(pArguments[i]));
+    }
+  }
+
+  // Parses and validates the options of a compile request. Returns false and
+  // an operation result describing the errors if they are invalid.
+  bool ReadCompileOptions(_In_ LPCWSTR pTargetProfile,
+                          _In_count_(argCount) LPCWSTR *pArguments,
+                          UINT32 argCount,
+                          _In_count_(defineCount) const DxcDefine *pDefines,
+                          UINT32 defineCount, CompileOptions &options,
+                          _COM_Outptr_ IDxcOperationResult **ppResult) {
+    CComPtr<AbstractMemoryStream> pOutputStream;
+    IFT(CreateMemoryStream(m_pMalloc, &pOutputStream));
+
+    int argCountInt;
+    IFT(UIntToInt(argCount, &argCountInt));
+    options.MainArgs = hlsl::options::MainArgs(argCountInt, pArguments, 0);
+    options.Utf8TargetProfile =
+        Unicode::UTF16ToUTF8StringOrThrow(pTargetProfile);
+    // Set target profile before reading options and validate
+    options.Opts.TargetProfile = options.Utf8TargetProfile;
+    bool finished;
+    ReadOptsAndValidate(options.MainArgs, options.Opts, pOutputStream,
+                        ppResult, finished);
+    if (finished)
+      return false;
+
+    // Not very efficient but also not very important.
+    CreateDefineStrings(pDefines, defineCount, options.Defines);
+    CreateDefineStrings(options.Opts.Defines.data(),
+                        options.Opts.Defines.size(), options.Defines);
+    CreateUtf8Arguments(pArguments, argCount, options.Arguments);
+    return true;
+  }
+
+  // Computes the key under which the result of a compile is cached. Returns
+  // false if the request can't be cached, for example because there are
+  // registered language extensions whose behavior the key can't capture.
+  bool GetCompileCacheKey(_In_ IDxcBlob *pUtf8Source,
+                          _In_opt_ LPCWSTR pSourceName,
+                          _In_ LPCWSTR pEntryPoint,
+                          const CompileOptions &options,
+                          bool debugBlobRequested, bool debugNameRequested,
+                          std::string &key) {
+    if (m_pDxcContainerEventsHandler != nullptr ||
+        !m_langExtensionsHelper.GetSemanticDefines().empty() ||
+        !m_langExtensionsHelper.GetDefines().empty() ||
+        !m_langExtensionsHelper.GetIntrinsicTables().empty())
+      return false;
+
+    dxcutil::DxcCompileCacheKeyBuilder builder;
+    builder.AddBlob(pUtf8Source);
+    builder.AddWString(pSourceName);
+    builder.AddWString(pEntryPoint);
+    builder.AddString(options.Utf8TargetProfile);
+    builder.AddUInt32(options.Defines.size());
+    for (const std::string &define : options.Defines)
+      builder.AddString(define);
+    // Arguments are keyed on option identity rather than spelling, so that
+    // '-Zi' and '/Zi' share an entry. Defines were already added above.
+    for (const llvm::opt::Arg *A : options.Opts.Args) {
+      if (A->getOption().matches(hlsl::options::OPT_compile_cache) ||
+          A->getOption().matches(hlsl::options::OPT_D))
+        continue;
+      builder.AddUInt32(A->getOption().getID());
+      builder.AddUInt32(A->getNumValues());
+      for (const char *pValue : A->getValues())
+        builder.AddString(pValue);
+    }
+    builder.AddUInt32(debugBlobRequested);
+    builder.AddUInt32(debugNameRequested);
+    key = builder.GetDigest();
+    return true;
+  }
+
+  // Computes the key under which the high-level module of a compile is
+  // cached. Unlike the compile cache key, it leaves out the options that only
+  // affect optimization, DXIL generation and the container, and adds what
+  // the front end records in the module.
+  bool GetHLModuleCacheKey(_In_ IDxcBlob *pUtf8Source,
+                           _In_opt_ LPCWSTR pSourceName,
+                           _In_ LPCWSTR pEntryPoint,
+                           const CompileOptions &options,
+                           const CodeGenOptions &codeGenOpts,
+                           std::string &key) {
+    if (!m_langExtensionsHelper.GetSemanticDefines().empty() ||
+        !m_langExtensionsHelper.GetDefines().empty() ||
+        !m_langExtensionsHelper.GetIntrinsicTables().empty())
+      return false;
+
+    dxcutil::DxcCompileCacheKeyBuilder builder;
+    builder.AddString("high-level module");
+    builder.AddBlob(pUtf8Source);
+    builder.AddWString(pSourceName);
+    builder.AddWString(pEntryPoint);
+    builder.AddString(options.Utf8TargetProfile);
+    builder.AddUInt32(options.Defines.size());
+    for (const std::string &define : options.Defines)
+      builder.AddString(define);
+    for (const llvm::opt::Arg *A : options.Opts.Args) {
+      const llvm::opt::Option &O = A->getOption();
+      if (O.matches(hlsl::options::OPT_compile_cache) ||
+          O.matches(hlsl::options::OPT_hl_cache) ||
+          O.matches(hlsl::options::OPT_container_cache) ||
+          O.matches(hlsl::options::OPT_D) ||
+          O.matches(hlsl::options::OPT_fast_iteration) ||
+          O.matches(hlsl::options::OPT_profile_use) ||
+          O.matches(hlsl::options::OPT_VD) ||
+          O.matches(hlsl::options::OPT_Qstrip_debug) ||
+          O.matches(hlsl::options::OPT_Zss) ||
+          O.matches(hlsl::options::OPT_Zsb) ||
+          O.matches(hlsl::options::OPT_Fd))
+        continue;
+      builder.AddUInt32(O.getID());
+      builder.AddUInt32(A->getNumValues());
+      for (const char *pValue : A->getValues())
+        builder.AddString(pValue);
+    }
+    // Skipping validation and -fast-iteration change these.
+    builder.AddUInt32(codeGenOpts.HLSLValidatorMajorVer);
+    builder.AddUInt32(codeGenOpts.HLSLValidatorMinorVer);
+    builder.AddUInt32(codeGenOpts.DisableLLVMOpts);
+    key = builder.GetDigest();
+    return true;
+  }
+
+  // Computes the key under which the latest incremental compile of a library
+  // is recorded. It leaves out the source and includes, whose effect on the
+  // high-level module the digests recorded with the compile capture.
+  bool GetIncrementalKey(_In_opt_ LPCWSTR pSourceName,
+                         _In_ LPCWSTR pEntryPoint,
+                         const CompileOptions &options,
+                         const CodeGenOptions &codeGenOpts,
+                         std::string &key) {
+    if (!m_langExtensionsHelper.GetSemanticDefines().empty() ||
+        !m_langExtensionsHelper.GetDefines().empty() ||
+        !m_langExtensionsHelper.GetIntrinsicTables().empty())
+      return false;
+
+    dxcutil::DxcCompileCacheKeyBuilder builder;
+    builder.AddString("incremental library");
+    builder.AddWString(pSourceName);
+    builder.AddWString(pEntryPoint);
+    builder.AddString(options.Utf8TargetProfile);
+    builder.AddUInt32(options.Defines.size());
+    for (const std::string &define : options.Defines)
+      builder.AddString(define);
+    for (const llvm::opt::Arg *A : options.Opts.Args) {
+      const llvm::opt::Option &O = A->getOption();
+      if (O.matches(hlsl::options::OPT_compile_cache) ||
+          O.matches(hlsl::options::OPT_hl_cache) ||
+          O.matches(hlsl::options::OPT_container_cache) ||
+          O.matches(hlsl::options::OPT_incremental) ||
+          O.matches(hlsl::options::OPT_D))
+        continue;
+      builder.AddUInt32(O.getID());
+      builder.AddUInt32(A->getNumValues());
+      for (const char *pValue : A->getValues())
+        builder.AddString(pValue);
+    }
+    builder.AddUInt32(codeGenOpts.HLSLValidatorMajorVer);
+    builder.AddUInt32(codeGenOpts.HLSLValidatorMinorVer);
+    builder.AddUInt32(codeGenOpts.DisableLLVMOpts);
+    key = builder.GetDigest();
+    return true;
+  }
+
+  // Computes the key of the container assembled from the bitcode of a
+  // finished DXIL module. The module carries everything the container is
+  // built from, so compiles that only differ in dead code share the key.
+  static std::string GetContainerCacheKey(AbstractMemoryStream *pModuleBitcode,
+                                          SerializeDxilFlags SerializeFlags,
+                                          bool needsValidation) {
+    dxcutil::DxcCompileCacheKeyBuilder builder;
+    builder.AddString("container");
+    builder.AddBytes(pModuleBitcode->GetPtr(), pModuleBitcode->GetPtrSize());
+    builder.AddUInt32((uint32_t)SerializeFlags);
+    builder.AddUInt32(needsValidation);
+    if (needsValidation) {
+      unsigned major, minor;
+      dxcutil::GetValidatorVersion(&major, &minor);
+      builder.AddUInt32(major);
+      builder.AddUInt32(minor);
+    }
+    return builder.GetDigest();
+  }
+
+  // Runs the front end of a compile to a high-level module, which matches
+  // compiling with -fcgl. Returns false if an error was reported.
+  bool EmitHLModule(CompilerInstance &compiler, FrontendInputFile &file,
+                    llvm::LLVMContext &llvmContext,
+                    dxcutil::DxcArgsFileSystem *msfPtr,
+                    hlsl::CompilePhaseListener *pPhases,
+                    CComPtr<IDxcBlob> &pHLModule) {
+    CComPtr<AbstractMemoryStream> pHLStream;
+    IFT(CreateMemoryStream(m_pMalloc, &pHLStream));
+    IFT(msfPtr->RegisterOutputStream(L"output.hl.bc", pHLStream));
+    FrontendOptions &frontendOpts = compiler.getFrontendOpts();
+    CodeGenOptions &codeGenOpts = compiler.getCodeGenOpts();
+    std::string outputFile = frontendOpts.OutputFile;
+    frontendOpts.OutputFile = "output.hl.bc";
+    codeGenOpts.HLSLHighLevel = true;
+    bool frontEndOK = false;
+    {
+      hlsl::CompilePhaseScope Phase(pPhases, "Front end");
+      EmitBCAction action(&llvmContext);
+      if (action.BeginSourceFile(compiler, file)) {
+        action.Execute();
+        action.EndSourceFile();
+        frontEndOK = !compiler.getDiagnostics().hasErrorOccurred();
+      }
+    }
+    codeGenOpts.HLSLHighLevel = false;
+    frontendOpts.OutputFile = outputFile;
+    if (!frontEndOK)
+      return false;
+    IFT(pHLStream.QueryInterface(&pHLModule));
+    return true;
+  }
+
+  static std::unique_ptr<llvm::Module>
+  ParseModule(IDxcBlob *pBitcode, StringRef name,
+              llvm::LLVMContext &llvmContext) {
+    StringRef bitcode((const char *)pBitcode->GetBufferPointer(),
+                      pBitcode->GetBufferSize());
+    return ParseModule(bitcode, name, llvmContext);
+  }
+
+  static std::unique_ptr<llvm::Module>
+  ParseModule(StringRef bitcode, StringRef name,
+              llvm::LLVMContext &llvmContext) {
+    llvm::ErrorOr<std::unique_ptr<llvm::Module>> moduleOrErr =
+        llvm::parseBitcodeFile(llvm::MemoryBufferRef(bitcode, name),
+                               llvmContext);
+    IFTLLVM(moduleOrErr.getError());
+    return std::move(moduleOrErr.get());
+  }
+
+  // Optimizes a high-level module and generates DXIL from it. Returns false,
+  // releasing the module, if an error was reported.
+  static bool RunBackendOnHLModule(CompilerInstance &compiler,
+                                   llvm::LLVMContext &llvmContext,
+                                   hlsl::CompilePhaseListener *pPhases,
+                                   std::unique_ptr<llvm::Module> &pModule) {
+    return RunBackendOnHLModule(compiler, compiler.getDiagnostics(),
+                                llvmContext, pPhases, pModule);
+  }
+
+  // As above, reporting to Diags, which lets compiles in contexts of their
+  // own run concurrently.
+  static bool RunBackendOnHLModule(CompilerInstance &compiler,
+                                   DiagnosticsEngine &Diags,
+                                   llvm::LLVMContext &llvmContext,
+                                   hlsl::CompilePhaseListener *pPhases,
+                                   std::unique_ptr<llvm::Module> &pModule) {
+    {
+      hlsl::CompilePhaseScope Phase(pPhases, "Backend");
+      llvmContext.setDiagnosticHandler(HLModuleDiagnosticHandler, &Diags);
+      // The module carries its data layout, so no target description is
+      // needed to check it against.
+      EmitBackendOutput(Diags, compiler.getCodeGenOpts(),
+                        compiler.getTargetOpts(), compiler.getLangOpts(),
+                        StringRef(), pModule.get(), Backend_EmitNothing,
+                        nullptr);
+      llvmContext.setDiagnosticHandler(nullptr, nullptr);
+    }
+    if (Diags.hasErrorOccurred()) {
+      pModule.reset();
+      return false;
+    }
+    return true;
+  }
+
+  // Compiles the functions in changed in groups spread across worker
+  // threads, each from its own copy of the high-level library pHLModule in a
+  // context of its own, and merges the groups into Prev in turn. Contexts
+  // can't be shared across threads, so this is how a library compile uses
+  // more than one core. Returns false, leaving Prev unspecified, if there
+  // are too few functions to pay off, or if any group reports a diagnostic
+  // or fails to merge; the caller then compiles the functions together,
+  // which reports any diagnostics as usual.
+  static bool CompileChangedFunctionsApart(CompilerInstance &compiler,
+                                           IDxcBlob *pHLModule,
+                                           const llvm::StringSet<> &changed,
+                                           hlsl::CompilePhaseListener *pPhases,
+                                           llvm::Module &Prev) {
+    unsigned groupCount = std::min<unsigned>(
+        std::thread::hardware_concurrency(),
+        changed.size() / kMinFunctionsPerCompileThread);
+    if (groupCount < 2)
+      return false;
+
+    // Functions are dealt out in name order, so the groups don't depend on
+    // the order of the set.
+    std::vector<StringRef> names;
+    for (const auto &entry : changed)
+      names.push_back(entry.getKey());
+    std::sort(names.begin(), names.end());
+    std::vector<llvm::StringSet<>> groups(groupCount);
+    for (size_t i = 0; i < names.size(); ++i)
+      groups[i % groupCount].insert(names[i]);
+
+    struct GroupResult {
+      std::string Bitcode;
+      bool Compiled = false;
+    };
+    std::vector<GroupResult> results(groupCount);
+    {
+      hlsl::CompilePhaseScope Phase(pPhases, "Backend");
+      ParallelForWithThreadSystem(groupCount, [&](unsigned i) {
+        llvm::LLVMContext groupContext;
+        IntrusiveRefCntPtr<DiagnosticIDs> DiagIDs(new DiagnosticIDs);
+        IntrusiveRefCntPtr<DiagnosticOptions> DiagOpts =
+            new DiagnosticOptions();
+        DiagnosticsEngine Diags(DiagIDs, &*DiagOpts,
+                                new IgnoringDiagConsumer());
+        std::unique_ptr<llvm::Module> pGroup =
+            ParseModule(pHLModule, "output.hl.bc", groupContext);
+        dxcutil::StripUnchangedFunctions(*pGroup, groups[i]);
+        if (!RunBackendOnHLModule(compiler, Diags, groupContext, nullptr,
+                                  pGroup) ||
+            Diags.getNumWarnings() != 0)
+          return;
+        raw_string_ostream OS(results[i].Bitcode);
+        WriteBitcodeToFile(pGroup.get(), OS);
+        OS.flush();
+        results[i].Compiled = true;
+      });
+    }
+
+    for (unsigned i = 0; i < groupCount; ++i) {
+      if (!results[i].Compiled)
+        return false;
+      std::unique_ptr<llvm::Module> pGroup =
+          ParseModule(results[i].Bitcode, "output.bc", Prev.getContext());
+      if (!dxcutil::MergeChangedFunctions(Prev, std::move(pGroup), groups[i]))
+        return false;
+    }
+    return true;
+  }
+
+  // Generates the high-level module in memory and frees the AST and Sema
+  // before optimizing it, so the two are never resident together. Returns
+  // false if an error was reported.
+  static bool CompileStreaming(CompilerInstance &compiler,
+                               FrontendInputFile &file,
+                               llvm::LLVMContext &llvmContext,
+                               hlsl::CompilePhaseListener *pPhases,
+                               std::unique_ptr<llvm::Module> &pModule) {
+    CodeGenOptions &codeGenOpts = compiler.getCodeGenOpts();
+    codeGenOpts.HLSLHighLevel = true;
+    bool frontEndOK = false;
+    {
+      hlsl::CompilePhaseScope Phase(pPhases, "Front end");
+      EmitLLVMOnlyAction action(&llvmContext);
+      if (action.BeginSourceFile(compiler, file)) {
+        action.Execute();
+        // Ending the source file frees the AST, which the module no longer
+        // refers to.
+        action.EndSourceFile();
+        frontEndOK = !compiler.getDiagnostics().hasErrorOccurred();
+        if (frontEndOK)
+          pModule = action.takeModule();
+      }
+    }
+    codeGenOpts.HLSLHighLevel = false;
+    if (!frontEndOK)
+      return false;
+    return RunBackendOnHLModule(compiler, llvmContext, pPhases, pModule);
+  }
+
+  // Produces the DXIL module of a compile from a high-level module: the one
+  // cached under key if its includes are unchanged, or else the one the front
+  // end generates, which is then cached. This matches compiling with -fcgl
+  // and running the optimizer on the result. Returns false if an error was
+  // reported; hlModuleCached is set if the front end was skipped.
+  bool CompileThroughHLModule(const std::string &key,
+                              CompilerInstance &compiler,
+                              FrontendInputFile &file,
+                              llvm::LLVMContext &llvmContext,
+                              dxcutil::DxcArgsFileSystem *msfPtr,
+                              raw_string_ostream &w,
+                              hlsl::CompilePhaseListener *pPhases,
+                              std::unique_ptr<llvm::Module> &pModule,
+                              bool &hlModuleCached) {
+    CComPtr<IDxcBlob> pHLModule;
+    CComPtr<IDxcBlobEncoding> pHLWarnings;
+    hlModuleCached = dxcutil::DxcCompileCache::Lookup(
+        key, msfPtr, &pHLModule, &pHLWarnings, nullptr, nullptr);
+    if (hlModuleCached) {
+      // Replay the warnings of the front end.
+      w << StringRef((const char *)pHLWarnings->GetBufferPointer(),
+                     pHLWarnings->GetBufferSize());
+    } else {
+      if (!EmitHLModule(compiler, file, llvmContext, msfPtr, pPhases,
+                        pHLModule))
+        return false;
+
+      // Failing to populate the cache doesn't affect this compile.
+      try {
+        const std::string &frontEndWarnings = w.str();
+        IFT(DxcCreateBlobWithEncodingOnHeapCopy(frontEndWarnings.data(),
+                                                frontEndWarnings.size(),
+                                                CP_UTF8, &pHLWarnings));
+        dxcutil::DxcCompileCache::Insert(key, msfPtr, pHLModule, pHLWarnings,
+                                         nullptr, nullptr);
+      } catch (...) {
+      }
+    }
+
+    pModule = ParseModule(pHLModule, "output.hl.bc", llvmContext);
+    return RunBackendOnHLModule(compiler, llvmContext, pPhases, pModule);
+  }
+
+  // Compiles a library, reusing the DXIL of the functions whose digests
+  // match those of the previous compile recorded under key. The functions
+  // that changed are compiled from a high-level module reduced to them and
+  // their callees, and replace their old definitions in the previous DXIL,
+  // whose metadata still holds as the module digest is unchanged. Anything
+  // that rules this out falls back to compiling the whole library. Returns
+  // false if an error was reported.
+  bool CompileIncrementally(const std::string &key,
+                            CompilerInstance &compiler,
+                            FrontendInputFile &file,
+                            llvm::LLVMContext &llvmContext,
+                            dxcutil::DxcArgsFileSystem *msfPtr,
+                            hlsl::CompilePhaseListener *pPhases,
+                            std::unique_ptr<llvm::Module> &pModule,
+                            dxcutil::DxcFunctionDigests &digests) {
+    CComPtr<IDxcBlob> pHLModule;
+    if (!EmitHLModule(compiler, file, llvmContext, msfPtr, pPhases, pHLModule))
+      return false;
+    pModule = ParseModule(pHLModule, "output.hl.bc", llvmContext);
+    dxcutil::ComputeFunctionDigests(*pModule, digests);
+
+    dxcutil::DxcFunctionDigests prevDigests;
+    CComPtr<IDxcBlob> pPrevProgram;
+    if (!dxcutil::DxcIncrementalCache::Lookup(key, prevDigests,
+                                              &pPrevProgram) ||
+        prevDigests.ModuleDigest != digests.ModuleDigest ||
+        !dxcutil::CanCompileFunctionsApart(*pModule))
+      return RunBackendOnHLModule(compiler, llvmContext, pPhases, pModule);
+
+    llvm::StringSet<> changed;
+    for (const auto &entry : digests.Functions) {
+      auto it = prevDigests.Functions.find(entry.getKey());
+      if (it == prevDigests.Functions.end() ||
+          it->getValue() != entry.getValue())
+        changed.insert(entry.getKey());
+    }
+    if (changed.empty()) {
+      pModule = ParseModule(pPrevProgram, "output.bc", llvmContext);
+      return true;
+    }
+
+    {
+      std::unique_ptr<llvm::Module> pMerged =
+          ParseModule(pPrevProgram, "output.bc", llvmContext);
+      if (CompileChangedFunctionsApart(compiler, pHLModule, changed, pPhases,
+                                       *pMerged)) {
+        pModule = std::move(pMerged);
+        return true;
+      }
+    }
+
+    dxcutil::StripUnchangedFunctions(*pModule, changed);
+    if (!RunBackendOnHLModule(compiler, llvmContext, pPhases, pModule))
+      return false;
+    std::unique_ptr<llvm::Module> pMerged =
+        ParseModule(pPrevProgram, "output.bc", llvmContext);
+    if (dxcutil::MergeChangedFunctions(*pMerged, std::move(pModule),
+                                       changed)) {
+      pModule = std::move(pMerged);
+      return true;
+    }
+
+    pModule = ParseModule(pHLModule, "output.hl.bc", llvmContext);
+    return RunBackendOnHLModule(compiler, llvmContext, pPhases, pModule);
+  }
 public:
   DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
   DXC_MICROCOM_TM_CTOR(DxcCompiler)
@@ -256,6 +985,15 @@ public:
   HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) {
     return DoBasicQueryInterface<IDxcCompiler,
                                  IDxcCompiler2,
+                                 IDxcCompiler3,
+                                 IDxcCompilerSession,
+                                 IDxcCompilerArgsParser,
+                                 IDxcCompilerPermutations,
+                                 IDxcDisassembler,
+                                 IDxcRootSignatureCache,
+                                 IDxcCompilerCancel,
+                                 IDxcCompilerToStreams,
+                                 IDxcCompilerBundle,
                                  IDxcLangExtensions,
                                  IDxcContainerEvent,
                                  IDxcVersionInfo>
@@ -305,265 +1043,1082 @@ public:
     AssignToOutOpt(nullptr, ppDebugBlob);
 
     HRESULT hr = S_OK;
-    CComPtr<IDxcBlobEncoding> utf8Source;
-    CComPtr<AbstractMemoryStream> pOutputStream;
-    CHeapPtr<wchar_t> DebugBlobName;
     DxcEtw_DXCompilerCompile_Start();
     DxcThreadMalloc TM(m_pMalloc);
-    IFC(hlsl::DxcGetBlobAsUtf8(pSource, &utf8Source));
+    try {
+      CompileOptions options;
+      if (ReadCompileOptions(pTargetProfile, pArguments, argCount, pDefines,
+                             defineCount, options, ppResult)) {
+        hr = CompileWithOptions(pSource, pSourceName, pEntryPoint, options,
+                                pIncludeHandler, ppResult, ppDebugBlobName,
+                                ppDebugBlob);
+      }
+    }
+    CATCH_CPP_ASSIGN_HRESULT();
+    DxcEtw_DXCompilerCompile_Stop(hr);
+    return hr;
+  }
+
+  // IDxcCompilerSession
+  __override HRESULT STDMETHODCALLTYPE Initialize(
+    _In_ LPCWSTR pTargetProfile,                  // Shader profile to compile
+    _In_count_(argCount) LPCWSTR *pArguments,     // Array of pointers to arguments
+    _In_ UINT32 argCount,                         // Number of arguments
+    _In_count_(defineCount) const DxcDefine *pDefines,  // Array of defines
+    _In_ UINT32 defineCount,                      // Number of defines
+    _COM_Outptr_opt_ IDxcBlobEncoding **ppErrors  // Errors in the options
+  ) {
+    if ((defineCount > 0 && pDefines == nullptr) ||
+        (argCount > 0 && pArguments == nullptr) || pTargetProfile == nullptr)
+      return E_INVALIDARG;
+    AssignToOutOpt(nullptr, ppErrors);
 
+    DxcThreadMalloc TM(m_pMalloc);
+    m_pSessionOptions.reset();
     try {
-      CComPtr<IDxcBlob> pOutputBlob;
-      dxcutil::DxcArgsFileSystem *msfPtr =
-        dxcutil::CreateDxcArgsFileSystem(utf8Source, pSourceName, pIncludeHandler);
-      std::unique_ptr<::llvm::sys::fs::MSFileSystem> msf(msfPtr);
+      std::unique_ptr<CompileOptions> pOptions(new CompileOptions());
+      CComPtr<IDxcOperationResult> pResult;
+      if (!ReadCompileOptions(pTargetProfile, pArguments, argCount, pDefines,
+                              defineCount, *pOptions, &pResult)) {
+        if (ppErrors != nullptr)
+          IFT(pResult->GetErrorBuffer(ppErrors));
+        return E_INVALIDARG;
+      }
+      m_pSessionOptions = std::move(pOptions);
+      return S_OK;
+    }
+    CATCH_CPP_RETURN_HRESULT();
+  }
 
-      ::llvm::sys::fs::AutoPerThreadSystem pts(msf.get());
-      IFTLLVM(pts.error_code());
+  __override HRESULT STDMETHODCALLTYPE Compile(
+    _In_ IDxcBlob *pSource,                       // Source text to compile
+    _In_opt_ LPCWSTR pSourceName,                 // Optional file name for pSource. Used in errors and include handlers.
+    _In_ LPCWSTR pEntryPoint,                     // Entry point name
+    _In_opt_ IDxcIncludeHandler *pIncludeHandler, // user-provided interface to handle #include directives (optional)
+    _COM_Outptr_ IDxcOperationResult **ppResult,  // Compiler output status, buffer, and errors
+    _Outptr_opt_result_z_ LPWSTR *ppDebugBlobName,// Suggested file name for debug blob.
+    _COM_Outptr_opt_ IDxcBlob **ppDebugBlob       // Debug blob
+  ) {
+    if (pSource == nullptr || ppResult == nullptr || pEntryPoint == nullptr)
+      return E_INVALIDARG;
+    *ppResult = nullptr;
+    AssignToOutOpt(nullptr, ppDebugBlobName);
+    AssignToOutOpt(nullptr, ppDebugBlob);
+    if (m_pSessionOptions == nullptr)
+      return E_NOT_VALID_STATE;
 
-      IFT(CreateMemoryStream(m_pMalloc, &pOutputStream));
-      IFT(pOutputStream.QueryInterface(&pOutputBlob));
+    HRESULT hr = S_OK;
+    DxcEtw_DXCompilerCompile_Start();
+    DxcThreadMalloc TM(m_pMalloc);
+    try {
+      hr = CompileWithOptions(pSource, pSourceName, pEntryPoint,
+                              *m_pSessionOptions, pIncludeHandler, ppResult,
+                              ppDebugBlobName, ppDebugBlob);
+    }
+    CATCH_CPP_ASSIGN_HRESULT();
+    DxcEtw_DXCompilerCompile_Stop(hr);
+    return hr;
+  }
 
-      int argCountInt;
-      IFT(UIntToInt(argCount, &argCountInt));
-      hlsl::options::MainArgs mainArgs(argCountInt, pArguments, 0);
-      hlsl::options::DxcOpts opts;
-      CW2A pUtf8TargetProfile(pTargetProfile, CP_UTF8);
-      // Set target profile before reading options and validate
-      opts.TargetProfile = pUtf8TargetProfile.m_psz;
-      bool finished;
-      ReadOptsAndValidate(mainArgs, opts, pOutputStream, ppResult, finished);
-      if (finished) {
-        hr = S_OK;
-        goto Cleanup;
+  // IDxcCompilerArgsParser
+  __override HRESULT STDMETHODCALLTYPE ParseArguments(
+    _In_ LPCWSTR pTargetProfile,                  // Shader profile to compile
+    _In_count_(argCount) LPCWSTR *pArguments,     // Array of pointers to arguments
+    _In_ UINT32 argCount,                         // Number of arguments
+    _In_count_(defineCount) const DxcDefine *pDefines,  // Array of defines
+    _In_ UINT32 defineCount,                      // Number of defines
+    _COM_Outptr_ IDxcCompilerArgs **ppArgs,       // Parsed arguments
+    _COM_Outptr_opt_ IDxcBlobEncoding **ppErrors  // Errors in the arguments
+  ) {
+    if ((defineCount > 0 && pDefines == nullptr) ||
+        (argCount > 0 && pArguments == nullptr) || pTargetProfile == nullptr ||
+        ppArgs == nullptr)
+      return E_INVALIDARG;
+    *ppArgs = nullptr;
+    AssignToOutOpt(nullptr, ppErrors);
+
+    DxcThreadMalloc TM(m_pMalloc);
+    try {
+      CComPtr<DxcCompilerArgs> pArgs = DxcCompilerArgs::Alloc(m_pMalloc);
+      IFROOM(pArgs.p);
+      CompileOptions &options = pArgs->Options;
+      CComPtr<IDxcOperationResult> pResult;
+      if (!ReadCompileOptions(pTargetProfile, pArguments, argCount, pDefines,
+                              defineCount, options, &pResult)) {
+        if (ppErrors != nullptr)
+          IFT(pResult->GetErrorBuffer(ppErrors));
+        return E_INVALIDARG;
       }
-      if (opts.DisplayIncludeProcess)
-        msfPtr->EnableDisplayIncludeProcess();
+      dxcutil::GetValidatorVersion(&options.ValidatorMajor,
+                                   &options.ValidatorMinor);
+      options.HasValidatorVersion = true;
+      *ppArgs = pArgs.Detach();
+      return S_OK;
+    }
+    CATCH_CPP_RETURN_HRESULT();
+  }
+
+  __override HRESULT STDMETHODCALLTYPE CompileWithArgs(
+    _In_ IDxcBlob *pSource,                       // Source text to compile
+    _In_opt_ LPCWSTR pSourceName,                 // Optional file name for pSource. Used in errors and include handlers.
+    _In_ LPCWSTR pEntryPoint,                     // Entry point name
+    _In_ IDxcCompilerArgs *pArgs,                 // Parsed arguments
+    _In_opt_ IDxcIncludeHandler *pIncludeHandler, // user-provided interface to handle #include directives (optional)
+    _COM_Outptr_ IDxcOperationResult **ppResult,  // Compiler output status, buffer, and errors
+    _Outptr_opt_result_z_ LPWSTR *ppDebugBlobName,// Suggested file name for debug blob.
+    _COM_Outptr_opt_ IDxcBlob **ppDebugBlob       // Debug blob
+  ) {
+    if (pSource == nullptr || ppResult == nullptr || pEntryPoint == nullptr ||
+        pArgs == nullptr)
+      return E_INVALIDARG;
+    *ppResult = nullptr;
+    AssignToOutOpt(nullptr, ppDebugBlobName);
+    AssignToOutOpt(nullptr, ppDebugBlob);
+    CComPtr<DxcCompilerArgs> pParsedArgs;
+    if (FAILED(pArgs->QueryInterface(__uuidof(DxcCompilerArgs),
+                                     (void **)&pParsedArgs)))
+      return E_INVALIDARG;
+
+    HRESULT hr = S_OK;
+    DxcEtw_DXCompilerCompile_Start();
+    DxcThreadMalloc TM(m_pMalloc);
+    try {
+      hr = CompileWithOptions(pSource, pSourceName, pEntryPoint,
+                              pParsedArgs->Options, pIncludeHandler, ppResult,
+                              ppDebugBlobName, ppDebugBlob);
+    }
+    CATCH_CPP_ASSIGN_HRESULT();
+    DxcEtw_DXCompilerCompile_Stop(hr);
+    return hr;
+  }
+
+  // IDxcCompilerPermutations
+  __override HRESULT STDMETHODCALLTYPE CompilePermutations(
+    _In_ IDxcBlob *pSource,                       // Source text to compile
+    _In_opt_ LPCWSTR pSourceName,                 // Optional file name for pSource. Used in errors and include handlers.
+    _In_ LPCWSTR pEntryPoint,                     // Entry point name
+    _In_ LPCWSTR pTargetProfile,                  // Shader profile to compile
+    _In_count_(argCount) LPCWSTR *pArguments,     // Array of pointers to arguments
+    _In_ UINT32 argCount,                         // Number of arguments
+    _In_count_(defineCount) const DxcDefine *pDefines,  // Defines shared by every permutation
+    _In_ UINT32 defineCount,                      // Number of shared defines
+    _In_opt_ const DxcDefine *pPermutationDefines,      // Defines of every permutation
+    _In_count_(permutationCount) const UINT32 *pPermutationDefineCounts, // Number of defines of each permutation
+    UINT32 permutationCount,                      // Number of permutations
+    _In_opt_ IDxcIncludeHandler *pIncludeHandler, // user-provided interface to handle #include directives (optional)
+    _Out_writes_(permutationCount) IDxcOperationResult **ppResults // Compiler output status, buffer, and errors per permutation
+  ) {
+    if (pSource == nullptr || pEntryPoint == nullptr ||
+        pTargetProfile == nullptr ||
+        (permutationCount > 0 &&
+         (pPermutationDefineCounts == nullptr || ppResults == nullptr)) ||
+        (defineCount > 0 && pDefines == nullptr) ||
+        (argCount > 0 && pArguments == nullptr))
+      return E_INVALIDARG;
+    UINT64 permutationDefineCount = 0;
+    for (UINT32 i = 0; i < permutationCount; ++i)
+      permutationDefineCount += pPermutationDefineCounts[i];
+    if (permutationDefineCount > 0 && pPermutationDefines == nullptr)
+      return E_INVALIDARG;
+    for (UINT32 i = 0; i < permutationCount; ++i)
+      ppResults[i] = nullptr;
+
+    HRESULT hr = S_OK;
+    DxcEtw_DXCompilerCompile_Start();
+    DxcThreadMalloc TM(m_pMalloc);
+    try {
+      CComPtr<IDxcBlobEncoding> utf8Source;
+      IFT(hlsl::DxcGetBlobAsUtf8(pSource, &utf8Source));
+
+      // Maps the digest of a preprocessed permutation to the permutation
+      // that was compiled for it.
+      std::unordered_map<std::string, UINT32> compiled;
+      // Every include loaded so far, so that the include handler is asked
+      // for each file once per call rather than once per preprocess and
+      // compile of every permutation.
+      dxcutil::DxcArgsFileSystem::IncludedFileList includes;
+      const DxcDefine *pPermutation = pPermutationDefines;
+      for (UINT32 i = 0; i < permutationCount; ++i) {
+        std::vector<DxcDefine> defines(pDefines, pDefines + defineCount);
+        if (pPermutationDefineCounts[i] > 0) {
+          defines.insert(defines.end(), pPermutation,
+                         pPermutation + pPermutationDefineCounts[i]);
+          pPermutation += pPermutationDefineCounts[i];
+        }
+
+        CompileOptions options;
+        if (!ReadCompileOptions(pTargetProfile, pArguments, argCount,
+                                defines.data(), (UINT32)defines.size(),
+                                options, &ppResults[i]))
+          continue;
+        std::string digest;
+        if (permutationCount > 1 && CanSharePermutation(options) &&
+            GetPreprocessedDigest(utf8Source, pSourceName, options,
+                                  pIncludeHandler, includes, digest)) {
+          auto it = compiled.find(digest);
+          if (it != compiled.end()) {
+            ppResults[i] = ppResults[it->second];
+            ppResults[i]->AddRef();
+            continue;
+          }
+          compiled[digest] = i;
+        }
+        options.PreloadedIncludes = includes;
+        IFT(CompileWithOptions(pSource, pSourceName, pEntryPoint, options,
+                               pIncludeHandler, &ppResults[i], nullptr,
+                               nullptr));
+      }
+    }
+    CATCH_CPP_ASSIGN_HRESULT();
+
+    if (FAILED(hr)) {
+      for (UINT32 i = 0; i < permutationCount; ++i) {
+        if (ppResults[i]) {
+          ppResults[i]->Release();
+          ppResults[i] = nullptr;
+        }
+      }
+    }
+    DxcEtw_DXCompilerCompile_Stop(hr);
+    return hr;
+  }
+
+  // Whether the output of a compile only depends on its preprocessed text,
+  // so that permutations that preprocess the same can share it. Debug
+  // information records the defines, root signature defines and semantic
+  // defines read macros after preprocessing, and a phase report describes a
+  // compile of its own.
+  bool CanSharePermutation(const CompileOptions &options) {
+    const hlsl::options::DxcOpts &opts = options.Opts;
+    return !opts.DebugInfo && !opts.ReportPhases &&
+           opts.RootSignatureDefine.empty() &&
+           m_langExtensionsHelper.GetSemanticDefines().empty();
+  }
+
+  // Preprocesses the source with the defines of options and computes the
+  // digest of the output. Returns false if preprocessing reported anything,
+  // as the compile has to report it for this permutation. Includes are read
+  // from includes first, and the ones loaded from the handler are added to
+  // it.
+  bool GetPreprocessedDigest(
+      _In_ IDxcBlob *pUtf8Source, _In_opt_ LPCWSTR pSourceName,
+      CompileOptions &options, _In_opt_ IDxcIncludeHandler *pIncludeHandler,
+      dxcutil::DxcArgsFileSystem::IncludedFileList &includes,
+      std::string &digest) {
+    hlsl::options::DxcOpts &opts = options.Opts;
+    dxcutil::DxcArgsFileSystem *msfPtr =
+      dxcutil::CreateDxcArgsFileSystem(pUtf8Source, pSourceName, pIncludeHandler);
+    std::unique_ptr<::llvm::sys::fs::MSFileSystem> msf(msfPtr);
+    msfPtr->AddPreloadedIncludes(includes);
+
+    ::llvm::sys::fs::AutoPerThreadSystem pts(msf.get());
+    IFTLLVM(pts.error_code());
+
+    CComPtr<AbstractMemoryStream> pOutputStream;
+    IFT(CreateMemoryStream(m_pMalloc, &pOutputStream));
+    IFT(msfPtr->RegisterOutputStream(L"output.hlsl", pOutputStream));
+    IFT(msfPtr->CreateStdStreams(m_pMalloc));
+    if (opts.IncludeCache)
+      msfPtr->EnableIncludeCache();
+
+    CW2A utf8SourceName(pSourceName, CP_UTF8);
+    std::string diagnostics;
+    raw_string_ostream d(diagnostics);
+    raw_stream_ostream outStream(pOutputStream.p);
+    CompilerInstance compiler;
+    std::unique_ptr<TextDiagnosticPrinter> diagPrinter =
+        std::make_unique<TextDiagnosticPrinter>(d, &compiler.getDiagnosticOpts());
+    SetupCompilerForCompile(compiler, &m_langExtensionsHelper, utf8SourceName, diagPrinter.get(), options.Defines, opts, options.Arguments);
+    msfPtr->SetupForCompilerInstance(compiler);
+    compiler.getFrontendOpts().OutputFile = "output.hlsl";
+    compiler.WriteDefaultOutputDirectly = true;
+    compiler.setOutStream(&outStream);
+
+    // Pragmas and line directives are kept, as they affect the compile.
+    clang::PreprocessorOutputOptions &PPOutOpts =
+        compiler.getPreprocessorOutputOpts();
+    PPOutOpts.ShowCPP = 1;
+    PPOutOpts.ShowLineMarkers = 1;
+    PPOutOpts.UseLineDirectives = 1;
+
+    FrontendInputFile file(utf8SourceName.m_psz, IK_HLSL);
+    clang::PrintPreprocessedAction action;
+    if (!action.BeginSourceFile(compiler, file))
+      return false;
+    action.Execute();
+    action.EndSourceFile();
+    outStream.flush();
+
+    dxcutil::DxcArgsFileSystem::IncludedFileList loaded;
+    msfPtr->GetIncludedFiles(loaded);
+    for (auto &file : loaded) {
+      auto found = std::find_if(
+          includes.begin(), includes.end(),
+          [&file](const std::pair<std::wstring, CComPtr<IDxcBlob>> &known) {
+            return known.first == file.first;
+          });
+      if (found == includes.end())
+        includes.emplace_back(std::move(file));
+    }
+
+    msfPtr->WriteStdErrToStream(d);
+    d.flush();
+    if (!diagnostics.empty() || compiler.getDiagnostics().hasErrorOccurred())
+      return false;
+
+    dxcutil::DxcCompileCacheKeyBuilder builder;
+    builder.AddBytes(pOutputStream->GetPtr(), pOutputStream->GetPtrSize());
+    digest = builder.GetDigest();
+    return true;
+  }
+
+  // IDxcCompiler3
+  __override HRESULT STDMETHODCALLTYPE CompileBatch(
+    _In_ IDxcBlob *pSource,                       // Source text to compile
+    _In_opt_ LPCWSTR pSourceName,                 // Optional file name for pSource. Used in errors and include handlers.
+    _In_count_(entryCount) const LPCWSTR *pEntryPoints,    // Array of entry point names
+    _In_count_(entryCount) const LPCWSTR *pTargetProfiles, // Array of shader profiles to compile
+    UINT32 entryCount,                            // Number of entry points
+    _In_count_(argCount) LPCWSTR *pArguments,     // Array of pointers to arguments
+    _In_ UINT32 argCount,                         // Number of arguments
+    _In_count_(defineCount) const DxcDefine *pDefines,  // Array of defines
+    _In_ UINT32 defineCount,                      // Number of defines
+    _In_opt_ IDxcIncludeHandler *pIncludeHandler, // user-provided interface to handle #include directives (optional)
+    _Out_writes_(entryCount) IDxcOperationResult **ppResults // Compiler output status, buffer, and errors per entry point
+  ) {
+    if (pSource == nullptr ||
+        (entryCount > 0 && (pEntryPoints == nullptr ||
+                            pTargetProfiles == nullptr || ppResults == nullptr)) ||
+        (defineCount > 0 && pDefines == nullptr) ||
+        (argCount > 0 && pArguments == nullptr))
+      return E_INVALIDARG;
+    for (UINT32 i = 0; i < entryCount; ++i) {
+      if (pEntryPoints[i] == nullptr || pTargetProfiles[i] == nullptr)
+        return E_INVALIDARG;
+    }
+    for (UINT32 i = 0; i < entryCount; ++i)
+      ppResults[i] = nullptr;
+
+    HRESULT hr = S_OK;
+    DxcEtw_DXCompilerCompile_Start();
+    DxcThreadMalloc TM(m_pMalloc);
+    try {
+      // Entry points whose options need a compile of their own get one; the
+      // others share a single parse.
+      std::vector<std::unique_ptr<CompileOptions>> options(entryCount);
+      std::vector<UINT32> batch;
+      for (UINT32 i = 0; i < entryCount; ++i) {
+        options[i].reset(new CompileOptions());
+        if (!ReadCompileOptions(pTargetProfiles[i], pArguments, argCount,
+                                pDefines, defineCount, *options[i],
+                                &ppResults[i]))
+          continue;
+        if (CanCompileInBatch(*options[i])) {
+          batch.push_back(i);
+          continue;
+        }
+        IFT(CompileWithOptions(pSource, pSourceName, pEntryPoints[i],
+                               *options[i], pIncludeHandler, &ppResults[i],
+                               nullptr, nullptr));
+      }
+      if (!batch.empty())
+        CompileBatchWithOptions(pSource, pSourceName, pEntryPoints, options,
+                                batch, pIncludeHandler, ppResults);
+    }
+    CATCH_CPP_ASSIGN_HRESULT();
+
+    if (FAILED(hr)) {
+      for (UINT32 i = 0; i < entryCount; ++i) {
+        if (ppResults[i]) {
+          ppResults[i]->Release();
+          ppResults[i] = nullptr;
+        }
+      }
+    }
+    DxcEtw_DXCompilerCompile_Stop(hr);
+    return hr;
+  }
+
+  // Whether an entry point of CompileBatch can share the parse of the others.
+  // Dumps, high-level output, phase reports and arenas describe or scope a
+  // compile of their own, as do timeouts, memory limits and diagnostic
+  // records; libraries and root signatures don't go through DXIL generation
+  // for a single entry point.
+  static bool CanCompileInBatch(CompileOptions &options) {
+    hlsl::options::DxcOpts &opts = options.Opts;
+#ifdef ENABLE_SPIRV_CODEGEN
+    if (opts.GenSPIRV)
+      return false;
+#endif
+    return !opts.AstDump && !opts.OptDump && !opts.CodeGenHighLevel &&
+           !opts.ReportPhases && !opts.ArenaAlloc && !opts.CompileTimeout &&
+           !opts.CompileMemoryLimit && !opts.DiagRecords &&
+           !opts.IsLibraryProfile() &&
+           !StringRef(options.Utf8TargetProfile).startswith("rootsig_");
+  }
 
-      // Prepare UTF8-encoded versions of API values.
-      CW2A pUtf8EntryPoint(pEntryPoint, CP_UTF8);
-      CW2A utf8SourceName(pSourceName, CP_UTF8);
-      const char *pUtf8SourceName = utf8SourceName.m_psz;
-      if (pUtf8SourceName == nullptr) {
-        if (opts.InputFile.empty()) {
-          pUtf8SourceName = "input.hlsl";
-        }
-        else {
-          pUtf8SourceName = opts.InputFile.data();
-        }
-      }
+  // Compiles the entry points of a batch from one parse. The options of the
+  // entry points only differ in their target profile, as they come from the
+  // same arguments. Results are not cached.
+  void CompileBatchWithOptions(
+      _In_ IDxcBlob *pSource, _In_opt_ LPCWSTR pSourceName,
+      _In_count_(entryCount) const LPCWSTR *pEntryPoints,
+      std::vector<std::unique_ptr<CompileOptions>> &options,
+      const std::vector<UINT32> &batch,
+      _In_opt_ IDxcIncludeHandler *pIncludeHandler,
+      IDxcOperationResult **ppResults) {
+    CompileOptions &sharedOptions = *options[batch.front()];
+    hlsl::options::DxcOpts &opts = sharedOptions.Opts;
+    CComPtr<IDxcBlobEncoding> utf8Source;
+    IFT(hlsl::DxcGetBlobAsUtf8(pSource, &utf8Source));
 
-      IFT(msfPtr->RegisterOutputStream(L"output.bc", pOutputStream));
-      IFT(msfPtr->CreateStdStreams(m_pMalloc));
+    dxcutil::DxcArgsFileSystem *msfPtr =
+      dxcutil::CreateDxcArgsFileSystem(utf8Source, pSourceName, pIncludeHandler);
+    std::unique_ptr<::llvm::sys::fs::MSFileSystem> msf(msfPtr);
 
-      StringRef Data((LPSTR)utf8Source->GetBufferPointer(),
-                     utf8Source->GetBufferSize());
-      std::unique_ptr<llvm::MemoryBuffer> pBuffer(
-          llvm::MemoryBuffer::getMemBufferCopy(Data, pUtf8SourceName));
+    ::llvm::sys::fs::AutoPerThreadSystem pts(msf.get());
+    IFTLLVM(pts.error_code());
 
-      // Not very efficient but also not very important.
-      std::vector<std::string> defines;
-      CreateDefineStrings(pDefines, defineCount, defines);
-      CreateDefineStrings(opts.Defines.data(), opts.Defines.size(), defines);
+    if (opts.DisplayIncludeProcess)
+      msfPtr->EnableDisplayIncludeProcess();
+    if (opts.IncludeCache)
+      msfPtr->EnableIncludeCache();
 
-      // Setup a compiler instance.
-      std::string warnings;
-      raw_string_ostream w(warnings);
-      raw_stream_ostream outStream(pOutputStream.p);
-      llvm::LLVMContext llvmContext; // LLVMContext should outlive CompilerInstance
-      CompilerInstance compiler;
-      std::unique_ptr<TextDiagnosticPrinter> diagPrinter =
-          std::make_unique<TextDiagnosticPrinter>(w, &compiler.getDiagnosticOpts());
-      SetupCompilerForCompile(compiler, &m_langExtensionsHelper, utf8SourceName, diagPrinter.get(), defines, opts, pArguments, argCount);
-      msfPtr->SetupForCompilerInstance(compiler);
+    CW2A utf8SourceName(pSourceName, CP_UTF8);
+    const char *pUtf8SourceName = utf8SourceName.m_psz;
+    if (pUtf8SourceName == nullptr) {
+      if (opts.InputFile.empty()) {
+        pUtf8SourceName = "input.hlsl";
+      }
+      else {
+        pUtf8SourceName = opts.InputFile.data();
+      }
+    }
 
-      // The clang entry point (cc1_main) would now create a compiler invocation
-      // from arguments, but for this path we're exclusively trying to compile
-      // to LLVM bitcode and then package that into a DXBC blob.
-      //
-      // With the compiler invocation built from command line arguments, the
-      // next step is to call ExecuteCompilerInvocation, which creates a
-      // FrontendAction* of EmitBCAction, which is a CodeGenAction, which is an
-      // ASTFrontendAction. That sets up a BackendConsumer as the ASTConsumer.
-      compiler.getFrontendOpts().OutputFile = "output.bc";
-      compiler.WriteDefaultOutputDirectly = true;
-      compiler.setOutStream(&outStream);
+    IFT(msfPtr->CreateStdStreams(m_pMalloc));
+
+    CComPtr<IDxcBlobEncoding> utf8SourceNullTerm;
+    IFT(hlsl::DxcGetBlobAsUtf8NullTerm(utf8Source, &utf8SourceNullTerm));
+    StringRef Data((LPSTR)utf8SourceNullTerm->GetBufferPointer(),
+                   utf8SourceNullTerm->GetBufferSize() - 1);
+    std::unique_ptr<llvm::MemoryBuffer> pBuffer(
+        llvm::MemoryBuffer::getMemBuffer(Data, pUtf8SourceName,
+                                         /*RequiresNullTerminator*/ true));
+
+    // Setup a compiler instance. The action owns the contexts of the entry
+    // points' modules, so it must outlive the compiler instance.
+    std::string warnings;
+    raw_string_ostream w(warnings);
+    dxcutil::EmitEntryPointsAction action(ParallelForWithThreadSystem);
+    CompilerInstance compiler;
+    std::unique_ptr<TextDiagnosticPrinter> diagPrinter =
+        std::make_unique<TextDiagnosticPrinter>(w, &compiler.getDiagnosticOpts());
+    SetupCompilerForCompile(compiler, &m_langExtensionsHelper, utf8SourceName, diagPrinter.get(), sharedOptions.Defines, opts, sharedOptions.Arguments);
+    msfPtr->SetupForCompilerInstance(compiler);
+    if (utf8SourceName.m_psz != nullptr) {
+      // pBuffer outlives the compiler instance, which mustn't free it.
+      compiler.getPreprocessorOpts().addRemappedFile(utf8SourceName.m_psz,
+                                                     pBuffer.get());
+      compiler.getPreprocessorOpts().RetainRemappedFileBuffers = true;
+    }
+
+    // The action sets the entry point and profile of each module; the shared
+    // parse is not specific to any entry point.
+    compiler.getLangOpts().HLSLEntryFunction.clear();
+    compiler.getLangOpts().IsHLSLLibrary = false;
+    bool needsValidation = !opts.DisableValidation;
+    if (needsValidation) {
+      UINT32 validatorMajor = sharedOptions.ValidatorMajor;
+      UINT32 validatorMinor = sharedOptions.ValidatorMinor;
+      if (!sharedOptions.HasValidatorVersion)
+        dxcutil::GetValidatorVersion(&validatorMajor, &validatorMinor);
+      compiler.getCodeGenOpts().HLSLValidatorMajorVer = validatorMajor;
+      compiler.getCodeGenOpts().HLSLValidatorMinorVer = validatorMinor;
+    }
+
+    for (UINT32 i : batch) {
+      CW2A pUtf8EntryPoint(pEntryPoints[i], CP_UTF8);
+      action.addEntryPoint(pUtf8EntryPoint.m_psz, options[i]->Utf8TargetProfile);
+    }
+    FrontendInputFile file(utf8SourceName.m_psz, IK_HLSL);
+    if (action.BeginSourceFile(compiler, file)) {
+      action.Execute();
+      action.EndSourceFile();
+    }
 
-      compiler.getLangOpts().HLSLEntryFunction =
-      compiler.getCodeGenOpts().HLSLEntryFunction = pUtf8EntryPoint.m_psz;
-      compiler.getCodeGenOpts().HLSLProfile = pUtf8TargetProfile.m_psz;
+    // Add std err to warnings.
+    msfPtr->WriteStdErrToStream(w);
+    w.flush();
 
-      unsigned rootSigMajor = 0;
-      unsigned rootSigMinor = 0;
-      if (compiler.getCodeGenOpts().HLSLProfile == "rootsig_1_1") {
-        rootSigMajor = 1;
-        rootSigMinor = 1;
-      } else if (compiler.getCodeGenOpts().HLSLProfile == "rootsig_1_0") {
-        rootSigMajor = 1;
-        rootSigMinor = 0;
+    SerializeDxilFlags SerializeFlags = SerializeDxilFlags::None;
+    if (opts.DebugInfo) {
+      SerializeFlags = SerializeDxilFlags::IncludeDebugNamePart;
+      SerializeFlags |= SerializeDxilFlags::IncludeDebugInfoPart;
+      if (opts.CompressDebug)
+        SerializeFlags |= SerializeDxilFlags::CompressDebugInfoPart;
+    }
+    if (opts.DebugNameForSource)
+      SerializeFlags |= SerializeDxilFlags::DebugNameDependOnSource;
+
+    // Validate and assemble the modules in parallel, each in its own context.
+    std::vector<dxcutil::EmitEntryPointsAction::EntryPoint> &entries =
+        action.getEntryPoints();
+    std::vector<CompileBatchJob> jobs(batch.size());
+    std::vector<CompileBatchJob *> generatedJobs;
+    for (size_t i = 0; i < batch.size(); ++i) {
+      CompileBatchJob &job = jobs[i];
+      job.pEntry = &entries[i];
+      job.hasErrorOccurred = compiler.getDiagnostics().hasErrorOccurred() ||
+                             job.pEntry->HasErrors || !job.pEntry->Module;
+      if (job.hasErrorOccurred)
+        continue;
+      IFT(CreateMemoryStream(m_pMalloc, &job.pOutputStream));
+      generatedJobs.push_back(&job);
+    }
+    IMalloc *pMalloc = m_pMalloc;
+    ParallelForWithThreadSystem(
+        (unsigned)generatedJobs.size(), [&](unsigned i) {
+          AssembleCompileBatchJob(*generatedJobs[i], pMalloc, SerializeFlags,
+                                  needsValidation, opts.DebugInfo);
+        });
+
+    // Report in entry order; container callbacks are not run concurrently.
+    CComPtr<IStream> pOutputErrorStream;
+    msfPtr->GetStdOutpuHandleStream(&pOutputErrorStream);
+    for (size_t i = 0; i < batch.size(); ++i) {
+      CompileBatchJob &job = jobs[i];
+      if (!job.hasErrorOccurred && SUCCEEDED(job.valHR) &&
+          m_pDxcContainerEventsHandler != nullptr) {
+        CComPtr<IDxcBlob> pTargetBlob;
+        HRESULT hr = m_pDxcContainerEventsHandler->OnDxilContainerBuilt(
+            job.pOutputBlob, &pTargetBlob);
+        if (SUCCEEDED(hr) && pTargetBlob != nullptr) {
+          std::swap(job.pOutputBlob, pTargetBlob);
+        }
       }
-      compiler.getLangOpts().IsHLSLLibrary = opts.IsLibraryProfile();
+      std::string entryWarnings =
+          warnings + job.pEntry->Diagnostics + job.ValidationErrors;
+      dxcutil::CreateOperationResultFromOutputs(
+          job.pOutputBlob, pOutputErrorStream, entryWarnings,
+          job.hasErrorOccurred, &ppResults[batch[i]]);
+    }
+  }
 
-      // NOTE: this calls the validation component from dxil.dll; the built-in
-      // validator can be used as a fallback.
-      bool produceFullContainer = !opts.CodeGenHighLevel && !opts.AstDump && !opts.OptDump && rootSigMajor == 0;
+  // Compiles a single entry point with options that have already been read
+  // and validated. With pCapture, the source, includes and validator version
+  // the compile read are recorded in it.
+  HRESULT CompileWithOptions(_In_ IDxcBlob *pSource,
+                             _In_opt_ LPCWSTR pSourceName,
+                             _In_ LPCWSTR pEntryPoint,
+                             CompileOptions &options,
+                             _In_opt_ IDxcIncludeHandler *pIncludeHandler,
+                             _COM_Outptr_ IDxcOperationResult **ppResult,
+                             _Outptr_opt_result_z_ LPWSTR *ppDebugBlobName,
+                             _COM_Outptr_opt_ IDxcBlob **ppDebugBlob,
+                             _In_opt_ dxcutil::DxcCompileBundle *pCapture = nullptr) {
+    // With -arena-alloc, everything allocated during the compile comes from
+    // an arena that is released once all of it has been freed. The outputs
+    // are allocated with m_pMalloc, so that happens when the compile ends.
+    CComPtr<IMalloc> pArena;
+    if (options.Opts.ArenaAlloc)
+      IFR(DxcCreateArenaMalloc(m_pMalloc, &pArena));
+    // With -report-phases, allocations are counted on their way to either.
+    // With -compile-memory-limit, the count is held to the limit; requests
+    // past it fail and the compile unwinds with E_OUTOFMEMORY.
+    CComPtr<IMalloc> pCounting;
+    if (options.Opts.ReportPhases || options.Opts.CompileMemoryLimit)
+      IFR(DxcCreateCountingMalloc(pArena ? pArena.p : m_pMalloc.p, &pCounting));
+    if (options.Opts.CompileMemoryLimit)
+      DxcSetCountingMallocLimit(
+          pCounting, (unsigned long long)options.Opts.CompileMemoryLimit << 20);
+    DxcThreadMalloc TMArena(pCounting ? pCounting.p
+                                      : pArena ? pArena.p : m_pMalloc.p);
+    // Exceptions may own memory from the arena, so they must be handled
+    // while it is still installed.
+    try {
+      return CompileWithOptionsInArena(pSource, pSourceName, pEntryPoint,
+                                       options, pIncludeHandler, ppResult,
+                                       ppDebugBlobName, ppDebugBlob, pCapture);
+    }
+    CATCH_CPP_RETURN_HRESULT();
+  }
 
-      bool needsValidation = produceFullContainer && !opts.DisableValidation &&
-                             !opts.IsLibraryProfile();
+  HRESULT CompileWithOptionsInArena(_In_ IDxcBlob *pSource,
+                                    _In_opt_ LPCWSTR pSourceName,
+                                    _In_ LPCWSTR pEntryPoint,
+                                    CompileOptions &options,
+                                    _In_opt_ IDxcIncludeHandler *pIncludeHandler,
+                                    _COM_Outptr_ IDxcOperationResult **ppResult,
+                                    _Outptr_opt_result_z_ LPWSTR *ppDebugBlobName,
+                                    _COM_Outptr_opt_ IDxcBlob **ppDebugBlob,
+                                    _In_opt_ dxcutil::DxcCompileBundle *pCapture) {
+    hlsl::options::DxcOpts &opts = options.Opts;
+    CComPtr<IDxcBlobEncoding> utf8Source;
+    CComPtr<AbstractMemoryStream> pOutputStream;
+    CHeapPtr<wchar_t> DebugBlobName;
+    // Declared first, so that it outlives every phase scope below.
+    std::unique_ptr<DxcPhaseReport> pReport;
+    if (opts.ReportPhases) {
+      pReport.reset(new DxcPhaseReport(DxcGetThreadMallocNoRef()));
+      pReport->phaseStarted("Compile");
+    }
+    IFR(hlsl::DxcGetBlobAsUtf8(pSource, &utf8Source));
+    // Every phase is traced, and also reported with -report-phases.
+    dxcutil::DxcPhaseTracer phaseTracer(pSourceName, utf8Source->GetBufferSize(),
+                                        pReport.get());
+    // Cancellation and -compile-timeout are checked ahead of tracing, so a
+    // phase that never runs isn't traced either.
+    dxcutil::DxcCompileCanceller canceller(&m_cancelCount, opts.CompileTimeout,
+                                           &phaseTracer);
+    hlsl::CompilePhaseListener *pPhases = &canceller;
+
+    CComPtr<IDxcBlob> pOutputBlob;
+    dxcutil::DxcArgsFileSystem *msfPtr =
+      dxcutil::CreateDxcArgsFileSystem(utf8Source, pSourceName, pIncludeHandler);
+    std::unique_ptr<::llvm::sys::fs::MSFileSystem> msf(msfPtr);
+    msfPtr->AddPreloadedIncludes(options.PreloadedIncludes);
+
+    ::llvm::sys::fs::AutoPerThreadSystem pts(msf.get());
+    IFTLLVM(pts.error_code());
+
+    IFT(CreateMemoryStream(m_pMalloc, &pOutputStream));
+    IFT(pOutputStream.QueryInterface(&pOutputBlob));
+
+    if (opts.DisplayIncludeProcess)
+      msfPtr->EnableDisplayIncludeProcess();
+    if (opts.IncludeCache)
+      msfPtr->EnableIncludeCache();
+
+    // A report describes an actual compile, and the cache keeps diagnostics
+    // as text only, so either bypasses the cache. A cached result doesn't
+    // read its includes, so capturing a bundle bypasses it too.
+    std::string cacheKey;
+    bool useCache =
+        opts.CompileCache && !opts.ReportPhases && !opts.DiagRecords &&
+        pCapture == nullptr &&
+        GetCompileCacheKey(utf8Source, pSourceName, pEntryPoint, options,
+                           ppDebugBlob != nullptr, ppDebugBlobName != nullptr,
+                           cacheKey);
+    if (useCache) {
+      CComPtr<IDxcBlob> pCachedResult;
+      CComPtr<IDxcBlobEncoding> pCachedErrors;
+      CComPtr<IDxcBlob> pCachedDebugBlob;
+      CComHeapPtr<wchar_t> CachedDebugBlobName;
+      if (dxcutil::DxcCompileCache::Lookup(
+              cacheKey, msfPtr, &pCachedResult, &pCachedErrors,
+              ppDebugBlob ? &pCachedDebugBlob : nullptr,
+              ppDebugBlobName ? &CachedDebugBlobName : nullptr)) {
+        {
+          DxcThreadMalloc TMOutputs(m_pMalloc);
+          try {
+            IFT(DxcOperationResult::CreateFromResultErrorStatus(
+                pCachedResult, pCachedErrors, S_OK, ppResult));
+          }
+          CATCH_CPP_RETURN_HRESULT();
+        }
+        if (ppDebugBlob)
+          *ppDebugBlob = pCachedDebugBlob.Detach();
+        if (ppDebugBlobName)
+          *ppDebugBlobName = CachedDebugBlobName.Detach();
+        return S_OK;
+      }
+    }
 
-      if (needsValidation || (opts.CodeGenHighLevel && !opts.DisableValidation)) {
-        UINT32 majorVer, minorVer;
-        dxcutil::GetValidatorVersion(&majorVer, &minorVer);
-        compiler.getCodeGenOpts().HLSLValidatorMajorVer = majorVer;
-        compiler.getCodeGenOpts().HLSLValidatorMinorVer = minorVer;
+    // Prepare UTF8-encoded versions of API values.
+    CW2A pUtf8EntryPoint(pEntryPoint, CP_UTF8);
+    CW2A utf8SourceName(pSourceName, CP_UTF8);
+    const char *pUtf8SourceName = utf8SourceName.m_psz;
+    if (pUtf8SourceName == nullptr) {
+      if (opts.InputFile.empty()) {
+        pUtf8SourceName = "input.hlsl";
       }
+      else {
+        pUtf8SourceName = opts.InputFile.data();
+      }
+    }
 
-      if (opts.AstDump) {
-        clang::ASTDumpAction dumpAction;
-        // Consider - ASTDumpFilter, ASTDumpLookups
-        compiler.getFrontendOpts().ASTDumpDecls = true;
-        FrontendInputFile file(utf8SourceName.m_psz, IK_HLSL);
-        dumpAction.BeginSourceFile(compiler, file);
-        dumpAction.Execute();
-        dumpAction.EndSourceFile();
-        outStream.flush();
+    IFT(msfPtr->RegisterOutputStream(L"output.bc", pOutputStream));
+    IFT(msfPtr->CreateStdStreams(m_pMalloc));
+
+    // Hand the main source to clang in place rather than having it read a
+    // copy through the file system. The lexer requires a null terminator
+    // past the end of the buffer; a copy is only made if the source lacks
+    // one.
+    CComPtr<IDxcBlobEncoding> utf8SourceNullTerm;
+    IFT(hlsl::DxcGetBlobAsUtf8NullTerm(utf8Source, &utf8SourceNullTerm));
+    StringRef Data((LPSTR)utf8SourceNullTerm->GetBufferPointer(),
+                   utf8SourceNullTerm->GetBufferSize() - 1);
+    std::unique_ptr<llvm::MemoryBuffer> pBuffer(
+        llvm::MemoryBuffer::getMemBuffer(Data, pUtf8SourceName,
+                                         /*RequiresNullTerminator*/ true));
+
+    bool hlModuleCached = false;
+
+    // Setup a compiler instance.
+    std::string warnings;
+    raw_string_ostream w(warnings);
+    raw_stream_ostream outStream(pOutputStream.p);
+    llvm::LLVMContext llvmContext; // LLVMContext should outlive CompilerInstance
+    CompilerInstance compiler;
+    // With -diag-records, diagnostics are only formatted if the caller asks
+    // for the error buffer.
+    std::unique_ptr<DiagnosticConsumer> diagPrinter;
+    dxcutil::DxcDiagnosticRecorder *diagRecorder = nullptr;
+    if (opts.DiagRecords) {
+      diagRecorder = new dxcutil::DxcDiagnosticRecorder();
+      diagPrinter.reset(diagRecorder);
+    }
+    else {
+      diagPrinter = std::make_unique<TextDiagnosticPrinter>(
+          w, &compiler.getDiagnosticOpts());
+    }
+    SetupCompilerForCompile(compiler, &m_langExtensionsHelper, utf8SourceName, diagPrinter.get(), options.Defines, opts, options.Arguments);
+    msfPtr->SetupForCompilerInstance(compiler);
+    if (utf8SourceName.m_psz != nullptr) {
+      // pBuffer outlives the compiler instance, which mustn't free it.
+      compiler.getPreprocessorOpts().addRemappedFile(utf8SourceName.m_psz,
+                                                     pBuffer.get());
+      compiler.getPreprocessorOpts().RetainRemappedFileBuffers = true;
+    }
+
+    // The clang entry point (cc1_main) would now create a compiler invocation
+    // from arguments, but for this path we're exclusively trying to compile
+    // to LLVM bitcode and then package that into a DXBC blob.
+    //
+    // With the compiler invocation built from command line arguments, the
+    // next step is to call ExecuteCompilerInvocation, which creates a
+    // FrontendAction* of EmitBCAction, which is a CodeGenAction, which is an
+    // ASTFrontendAction. That sets up a BackendConsumer as the ASTConsumer.
+    compiler.getFrontendOpts().OutputFile = "output.bc";
+    compiler.WriteDefaultOutputDirectly = true;
+    compiler.setOutStream(&outStream);
+
+    compiler.getLangOpts().HLSLEntryFunction =
+    compiler.getCodeGenOpts().HLSLEntryFunction = pUtf8EntryPoint.m_psz;
+    compiler.getCodeGenOpts().HLSLProfile = options.Utf8TargetProfile;
+    compiler.getCodeGenOpts().HLSLPhaseListener = pPhases;
+
+    unsigned rootSigMajor = 0;
+    unsigned rootSigMinor = 0;
+    if (compiler.getCodeGenOpts().HLSLProfile == "rootsig_1_1") {
+      rootSigMajor = 1;
+      rootSigMinor = 1;
+    } else if (compiler.getCodeGenOpts().HLSLProfile == "rootsig_1_0") {
+      rootSigMajor = 1;
+      rootSigMinor = 0;
+    }
+    compiler.getLangOpts().IsHLSLLibrary = opts.IsLibraryProfile();
+
+    // NOTE: this calls the validation component from dxil.dll; the built-in
+    // validator can be used as a fallback.
+    bool produceFullContainer = !opts.CodeGenHighLevel && !opts.AstDump && !opts.OptDump && rootSigMajor == 0;
+
+    bool needsValidation = produceFullContainer && !opts.DisableValidation &&
+                           !opts.IsLibraryProfile();
+
+    // The options may be shared by concurrent compiles of a session, so a
+    // version they don't carry is resolved for this compile only.
+    bool hasValidatorVersion = options.HasValidatorVersion;
+    UINT32 validatorMajor = options.ValidatorMajor;
+    UINT32 validatorMinor = options.ValidatorMinor;
+    if (needsValidation || (opts.CodeGenHighLevel && !opts.DisableValidation)) {
+      if (!hasValidatorVersion) {
+        dxcutil::GetValidatorVersion(&validatorMajor, &validatorMinor);
+        hasValidatorVersion = true;
       }
-      else if (opts.OptDump) {
-        EmitOptDumpAction action(&llvmContext);
-        FrontendInputFile file(utf8SourceName.m_psz, IK_HLSL);
-        action.BeginSourceFile(compiler, file);
-        action.Execute();
-        action.EndSourceFile();
-        outStream.flush();
+      compiler.getCodeGenOpts().HLSLValidatorMajorVer = validatorMajor;
+      compiler.getCodeGenOpts().HLSLValidatorMinorVer = validatorMinor;
+    }
+
+    if (opts.AstDump) {
+      clang::ASTDumpAction dumpAction;
+      // Consider - ASTDumpFilter, ASTDumpLookups
+      compiler.getFrontendOpts().ASTDumpDecls = true;
+      FrontendInputFile file(utf8SourceName.m_psz, IK_HLSL);
+      dumpAction.BeginSourceFile(compiler, file);
+      dumpAction.Execute();
+      dumpAction.EndSourceFile();
+      outStream.flush();
+    }
+    else if (opts.OptDump) {
+      EmitOptDumpAction action(&llvmContext);
+      FrontendInputFile file(utf8SourceName.m_psz, IK_HLSL);
+      action.BeginSourceFile(compiler, file);
+      action.Execute();
+      action.EndSourceFile();
+      outStream.flush();
+    }
+    else if (rootSigMajor) {
+      HLSLRootSignatureAction action(
+          compiler.getCodeGenOpts().HLSLEntryFunction, rootSigMajor,
+          rootSigMinor);
+      FrontendInputFile file(utf8SourceName.m_psz, IK_HLSL);
+      action.BeginSourceFile(compiler, file);
+      action.Execute();
+      action.EndSourceFile();
+      outStream.flush();
+      // Don't do work to put in a container if an error has occurred
+      bool compileOK = !compiler.getDiagnostics().hasErrorOccurred();
+      if (compileOK) {
+        auto rootSigHandle = action.takeRootSigHandle();
+
+        CComPtr<AbstractMemoryStream> pContainerStream;
+        IFT(CreateMemoryStream(m_pMalloc, &pContainerStream));
+        SerializeDxilContainerForRootSignature(rootSigHandle.get(),
+                                               pContainerStream);
+
+        pOutputBlob.Release();
+        IFT(pContainerStream.QueryInterface(&pOutputBlob));
       }
-      else if (rootSigMajor) {
-        HLSLRootSignatureAction action(
-            compiler.getCodeGenOpts().HLSLEntryFunction, rootSigMajor,
-            rootSigMinor);
+    }
+    // SPIRV change starts
+#ifdef ENABLE_SPIRV_CODEGEN
+    else if (opts.GenSPIRV) {
+        clang::EmitSPIRVOptions spirvOpts;
+        spirvOpts.stageIoOrder = opts.VkStageIoOrder;
+        spirvOpts.groupDecorations = opts.VkGroupDecorations;
+        clang::EmitSPIRVAction action(spirvOpts);
         FrontendInputFile file(utf8SourceName.m_psz, IK_HLSL);
         action.BeginSourceFile(compiler, file);
         action.Execute();
         action.EndSourceFile();
         outStream.flush();
-        // Don't do work to put in a container if an error has occurred
-        bool compileOK = !compiler.getDiagnostics().hasErrorOccurred();
+    }
+#endif
+    // SPIRV change ends
+    else {
+      FrontendInputFile file(utf8SourceName.m_psz, IK_HLSL);
+      std::unique_ptr<llvm::Module> pModule;
+      bool compileOK;
+      std::string hlCacheKey;
+      std::string incrementalKey;
+      dxcutil::DxcFunctionDigests digests;
+      // Only DXIL without debug info is merged, and the other cases that
+      // bypass the high-level module cache bypass incremental compiles too.
+      if (opts.Incremental && !opts.CodeGenHighLevel && !opts.DiagRecords &&
+          !opts.DebugInfo && pCapture == nullptr &&
+          StringRef(options.Utf8TargetProfile).startswith("lib_") &&
+          GetIncrementalKey(pSourceName, pEntryPoint, options,
+                            compiler.getCodeGenOpts(), incrementalKey)) {
+        compileOK = CompileIncrementally(incrementalKey, compiler, file,
+                                         llvmContext, msfPtr, pPhases,
+                                         pModule, digests);
         if (compileOK) {
-          auto rootSigHandle = action.takeRootSigHandle();
-
-          CComPtr<AbstractMemoryStream> pContainerStream;
-          IFT(CreateMemoryStream(m_pMalloc, &pContainerStream));
-          SerializeDxilContainerForRootSignature(rootSigHandle.get(),
-                                                 pContainerStream);
-
-          pOutputBlob.Release();
-          IFT(pContainerStream.QueryInterface(&pOutputBlob));
+          WriteBitcodeToFile(pModule.get(), outStream,
+                             compiler.getCodeGenOpts().EmitLLVMUseLists);
+          outStream.flush();
+          // Failing to record the compile doesn't affect it.
+          try {
+            dxcutil::DxcIncrementalCache::Insert(incrementalKey, digests,
+                                                 pOutputBlob);
+          } catch (...) {
+          }
         }
       }
-      // SPIRV change starts
-#ifdef ENABLE_SPIRV_CODEGEN
-      else if (opts.GenSPIRV) {
-          clang::EmitSPIRVOptions spirvOpts;
-          spirvOpts.stageIoOrder = opts.VkStageIoOrder;
-          clang::EmitSPIRVAction action(spirvOpts);
-          FrontendInputFile file(utf8SourceName.m_psz, IK_HLSL);
-          action.BeginSourceFile(compiler, file);
-          action.Execute();
-          action.EndSourceFile();
-          outStream.flush();
+      // The cached module keeps the front end's warnings as text only.
+      else if (opts.HLCache && !opts.CodeGenHighLevel && !opts.DiagRecords &&
+          pCapture == nullptr &&
+          GetHLModuleCacheKey(utf8Source, pSourceName, pEntryPoint, options,
+                              compiler.getCodeGenOpts(), hlCacheKey)) {
+        compileOK = CompileThroughHLModule(
+            hlCacheKey, compiler, file, llvmContext, msfPtr, w, pPhases,
+            pModule, hlModuleCached);
+        if (compileOK)
+          WriteBitcodeToFile(pModule.get(), outStream,
+                             compiler.getCodeGenOpts().EmitLLVMUseLists);
+      }
+      else if (opts.StreamCodeGen && !opts.CodeGenHighLevel) {
+        compileOK = CompileStreaming(compiler, file, llvmContext, pPhases,
+                                     pModule);
+        if (compileOK)
+          WriteBitcodeToFile(pModule.get(), outStream,
+                             compiler.getCodeGenOpts().EmitLLVMUseLists);
       }
-#endif
-      // SPIRV change ends
       else {
         EmitBCAction action(&llvmContext);
-        FrontendInputFile file(utf8SourceName.m_psz, IK_HLSL);
-        bool compileOK;
-        if (action.BeginSourceFile(compiler, file)) {
-          action.Execute();
-          action.EndSourceFile();
-          compileOK = !compiler.getDiagnostics().hasErrorOccurred();
+        {
+          // Preprocessing, parsing and semantic analysis are interleaved, so
+          // they're reported together, along with the nested IR generation
+          // and backend phases.
+          hlsl::CompilePhaseScope Phase(pPhases, "Front end");
+          if (action.BeginSourceFile(compiler, file)) {
+            action.Execute();
+            action.EndSourceFile();
+            compileOK = !compiler.getDiagnostics().hasErrorOccurred();
+          }
+          else {
+            compileOK = false;
+          }
         }
-        else {
-          compileOK = false;
+        if (compileOK)
+          pModule = action.takeModule();
+      }
+      outStream.flush();
+
+      SerializeDxilFlags SerializeFlags = SerializeDxilFlags::None;
+      if (opts.DebugInfo) {
+        SerializeFlags = SerializeDxilFlags::IncludeDebugNamePart;
+        // Unless we want to strip it right away, include it in the container.
+        if (!opts.StripDebug || ppDebugBlob == nullptr) {
+          SerializeFlags |= SerializeDxilFlags::IncludeDebugInfoPart;
+          if (opts.CompressDebug)
+            SerializeFlags |= SerializeDxilFlags::CompressDebugInfoPart;
         }
-        outStream.flush();
+      }
+      if (opts.DebugNameForSource) {
+        SerializeFlags |= SerializeDxilFlags::DebugNameDependOnSource;
+      }
 
-        SerializeDxilFlags SerializeFlags = SerializeDxilFlags::None;
-        if (opts.DebugInfo) {
-          SerializeFlags = SerializeDxilFlags::IncludeDebugNamePart;
-          // Unless we want to strip it right away, include it in the container.
-          if (!opts.StripDebug || ppDebugBlob == nullptr) {
-            SerializeFlags |= SerializeDxilFlags::IncludeDebugInfoPart;
+      // Don't do work to put in a container if an error has occurred
+      // Do not create a container when there is only a a high-level representation in the module.
+      if (compileOK && !opts.CodeGenHighLevel) {
+        HRESULT valHR = S_OK;
+
+        // Permutations often optimize to the same module, which then needs
+        // no further validation or serialization.
+        std::string containerKey;
+        bool containerCached = false;
+        if (opts.ContainerCache) {
+          containerKey = GetContainerCacheKey(pOutputStream, SerializeFlags,
+                                              needsValidation);
+          CComPtr<IDxcBlob> pCachedContainer;
+          containerCached = dxcutil::DxcContainerCache::Lookup(
+              containerKey, &pCachedContainer);
+          if (containerCached) {
+            pModule.reset();
+            std::swap(pOutputBlob, pCachedContainer);
           }
         }
-        if (opts.DebugNameForSource) {
-          SerializeFlags |= SerializeDxilFlags::DebugNameDependOnSource;
+
+        if (containerCached) {
+          // The container was validated when it was recorded.
+        } else if (needsValidation) {
+          valHR = dxcutil::ValidateAndAssembleToContainer(
+              std::move(pModule), pOutputBlob, m_pMalloc, SerializeFlags,
+              pOutputStream, opts.DebugInfo, compiler.getDiagnostics(),
+              pPhases);
+        } else {
+          hlsl::CompilePhaseScope Phase(pPhases,
+                                        "Container serialization");
+          dxcutil::AssembleToContainer(std::move(pModule),
+                                               pOutputBlob, m_pMalloc,
+                                               SerializeFlags, pOutputStream);
         }
 
-        // Don't do work to put in a container if an error has occurred
-        // Do not create a container when there is only a a high-level representation in the module.
-        if (compileOK && !opts.CodeGenHighLevel) {
-          HRESULT valHR = S_OK;
-
-          if (needsValidation) {
-            valHR = dxcutil::ValidateAndAssembleToContainer(
-                action.takeModule(), pOutputBlob, m_pMalloc, SerializeFlags,
-                pOutputStream, opts.DebugInfo, compiler.getDiagnostics());
-          } else {
-            dxcutil::AssembleToContainer(action.takeModule(),
-                                                 pOutputBlob, m_pMalloc,
-                                                 SerializeFlags, pOutputStream);
+        if (opts.ContainerCache && !containerCached && SUCCEEDED(valHR) &&
+            !compiler.getDiagnostics().hasErrorOccurred()) {
+          // Failing to populate the cache doesn't affect this compile.
+          try {
+            dxcutil::DxcContainerCache::Insert(containerKey, pOutputBlob);
+          } catch (...) {
           }
+        }
 
-          // Callback after valid DXIL is produced
-          if (SUCCEEDED(valHR)) {
-            CComPtr<IDxcBlob> pTargetBlob;
-            if (m_pDxcContainerEventsHandler != nullptr) {
-              HRESULT hr = m_pDxcContainerEventsHandler->OnDxilContainerBuilt(pOutputBlob, &pTargetBlob);
-              if (SUCCEEDED(hr) && pTargetBlob != nullptr) {
-                std::swap(pOutputBlob, pTargetBlob);
-              }
+        // Callback after valid DXIL is produced
+        if (SUCCEEDED(valHR)) {
+          CComPtr<IDxcBlob> pTargetBlob;
+          if (m_pDxcContainerEventsHandler != nullptr) {
+            HRESULT hr = m_pDxcContainerEventsHandler->OnDxilContainerBuilt(pOutputBlob, &pTargetBlob);
+            if (SUCCEEDED(hr) && pTargetBlob != nullptr) {
+              std::swap(pOutputBlob, pTargetBlob);
             }
+          }
 
-            if (ppDebugBlobName && produceFullContainer) {
-              const DxilContainerHeader *pContainer = reinterpret_cast<DxilContainerHeader *>(pOutputBlob->GetBufferPointer());
-              DXASSERT(IsValidDxilContainer(pContainer, pOutputBlob->GetBufferSize()), "else invalid container generated");
-              auto it = std::find_if(begin(pContainer), end(pContainer),
-                DxilPartIsType(DFCC_ShaderDebugName));
-              if (it != end(pContainer)) {
-                const char *pDebugName;
-                if (GetDxilShaderDebugName(*it, &pDebugName, nullptr) && pDebugName && *pDebugName) {
-                  IFTBOOL(Unicode::UTF8BufferToUTF16ComHeap(pDebugName, &DebugBlobName), DXC_E_CONTAINER_INVALID);
-                }
+          if (ppDebugBlobName && produceFullContainer) {
+            const DxilContainerHeader *pContainer = reinterpret_cast<DxilContainerHeader *>(pOutputBlob->GetBufferPointer());
+            DXASSERT(IsValidDxilContainer(pContainer, pOutputBlob->GetBufferSize()), "else invalid container generated");
+            auto it = std::find_if(begin(pContainer), end(pContainer),
+              DxilPartIsType(DFCC_ShaderDebugName));
+            if (it != end(pContainer)) {
+              const char *pDebugName;
+              if (GetDxilShaderDebugName(*it, &pDebugName, nullptr) && pDebugName && *pDebugName) {
+                IFTBOOL(Unicode::UTF8BufferToUTF16ComHeap(pDebugName, &DebugBlobName), DXC_E_CONTAINER_INVALID);
               }
             }
           }
         }
       }
+    }
 
-      // Add std err to warnings.
-      msfPtr->WriteStdErrToStream(w);
-
-      CreateOperationResultFromOutputs(pOutputBlob, msfPtr, warnings,
-                                       compiler.getDiagnostics(), ppResult);
+    // Add std err to warnings.
+    msfPtr->WriteStdErrToStream(w);
+
+    if (pCapture) {
+      dxcutil::DxcArgsFileSystem::IncludedFileList files;
+      msfPtr->GetIncludedFiles(files);
+      pCapture->pSource = utf8Source.p;
+      pCapture->Files.clear();
+      for (auto &file : files) {
+        dxcutil::DxcCompileBundle::File bundleFile;
+        bundleFile.Name = std::move(file.first);
+        bundleFile.pContent = file.second;
+        pCapture->Files.emplace_back(std::move(bundleFile));
+      }
+      pCapture->HasValidatorVersion = hasValidatorVersion;
+      pCapture->ValidatorMajor = validatorMajor;
+      pCapture->ValidatorMinor = validatorMinor;
+    }
 
-      // On success, return values. After assigning ppResult, nothing should fail.
-      HRESULT status;
-      DXVERIFY_NOMSG(SUCCEEDED((*ppResult)->GetStatus(&status)));
-      if (SUCCEEDED(status)) {
-        if (opts.DebugInfo && ppDebugBlob) {
-          DXVERIFY_NOMSG(SUCCEEDED(pOutputStream.QueryInterface(ppDebugBlob)));
-        }
-        if (ppDebugBlobName) {
-          *ppDebugBlobName = DebugBlobName.Detach();
+    if (pReport)
+      pReport->phaseFinished("Compile");
+    std::vector<DxcDiagnosticRecord> diagnostics;
+    if (diagRecorder)
+      diagnostics = diagRecorder->takeRecords();
+
+    // The result and its blobs outlive the compile, so they are allocated
+    // with m_pMalloc; a result from the arena would keep every chunk of the
+    // compile alive for as long as the caller holds it. Anything they keep
+    // is copied out of the compile's allocations, and exceptions are
+    // handled before the compile's allocator is put back.
+    {
+      DxcThreadMalloc TMOutputs(m_pMalloc);
+      try {
+        CComPtr<IDxcBlobEncoding> pReportBlob;
+        if (pReport) {
+          std::string reportText;
+          raw_string_ostream r(reportText);
+          pReport->Write(r);
+          r.flush();
+          IFT(DxcCreateBlobWithEncodingOnHeapCopy(
+              reportText.data(), reportText.size(), CP_UTF8, &pReportBlob));
         }
+        std::vector<DxcDiagnosticRecord> resultDiagnostics(diagnostics);
+        CreateOperationResultFromOutputs(
+            pOutputBlob, msfPtr, warnings, compiler.getDiagnostics(), ppResult,
+            pReportBlob, diagRecorder ? &resultDiagnostics : nullptr);
       }
+      CATCH_CPP_RETURN_HRESULT();
+    }
 
-      hr = S_OK;
+    // On success, return values. After assigning ppResult, nothing should fail.
+    HRESULT status;
+    DXVERIFY_NOMSG(SUCCEEDED((*ppResult)->GetStatus(&status)));
+    // Includes aren't resolved when the front end is skipped, so a result
+    // built on a cached high-level module can't be validated on its own.
+    if (SUCCEEDED(status) && useCache && !hlModuleCached) {
+      // Failing to populate the cache doesn't affect this compile.
+      try {
+        CComPtr<IDxcBlobEncoding> pErrors;
+        CComPtr<IDxcBlob> pDebugBlob;
+        IFT((*ppResult)->GetErrorBuffer(&pErrors));
+        if (opts.DebugInfo && ppDebugBlob)
+          IFT(pOutputStream.QueryInterface(&pDebugBlob));
+        dxcutil::DxcCompileCache::Insert(
+            cacheKey, msfPtr, pOutputBlob, pErrors, pDebugBlob,
+            ppDebugBlobName ? DebugBlobName.m_pData : nullptr);
+      } catch (...) {
+      }
     }
-    CATCH_CPP_ASSIGN_HRESULT();
-  Cleanup:
-    DxcEtw_DXCompilerCompile_Stop(hr);
-    return hr;
+    if (SUCCEEDED(status)) {
+      if (opts.DebugInfo && ppDebugBlob) {
+        DXVERIFY_NOMSG(SUCCEEDED(pOutputStream.QueryInterface(ppDebugBlob)));
+      }
+      if (ppDebugBlobName) {
+        *ppDebugBlobName = DebugBlobName.Detach();
+      }
+    }
+
+    return S_OK;
   }
 
   // Preprocess source text
@@ -613,23 +2168,17 @@ public:
 
       // Prepare UTF8-encoded versions of API values.
       CW2A utf8SourceName(pSourceName, CP_UTF8);
-      const char *pUtf8SourceName = utf8SourceName.m_psz;
-      if (pUtf8SourceName == nullptr) {
-        if (opts.InputFile.empty()) {
-          pUtf8SourceName = "input.hlsl";
-        }
-        else {
-          pUtf8SourceName = opts.InputFile.data();
-        }
-      }
 
       IFT(msfPtr->RegisterOutputStream(L"output.hlsl", pOutputStream));
       IFT(msfPtr->CreateStdStreams(m_pMalloc));
-
-      StringRef Data((LPSTR)utf8Source->GetBufferPointer(),
-        utf8Source->GetBufferSize());
-      std::unique_ptr<llvm::MemoryBuffer> pBuffer(
-        llvm::MemoryBuffer::getMemBufferCopy(Data, pUtf8SourceName));
+      if (opts.DisplayIncludeProcess)
+        msfPtr->EnableDisplayIncludeProcess();
+      if (opts.IncludeCache)
+        msfPtr->EnableIncludeCache();
+      // Scanning only lexes the directives of each file; its output is the
+      // list of included files rather than the preprocessed text.
+      if (opts.ScanDependencies)
+        msfPtr->EnableMinimizedSources();
 
       // Not very efficient but also not very important.
       std::vector<std::string> defines;
@@ -642,7 +2191,9 @@ public:
       CompilerInstance compiler;
       std::unique_ptr<TextDiagnosticPrinter> diagPrinter =
           std::make_unique<TextDiagnosticPrinter>(w, &compiler.getDiagnosticOpts());
-      SetupCompilerForCompile(compiler, &m_langExtensionsHelper, utf8SourceName, diagPrinter.get(), defines, opts, pArguments, argCount);
+      std::vector<std::string> arguments;
+      CreateUtf8Arguments(pArguments, argCount, arguments);
+      SetupCompilerForCompile(compiler, &m_langExtensionsHelper, utf8SourceName, diagPrinter.get(), defines, opts, arguments);
       msfPtr->SetupForCompilerInstance(compiler);
 
       // The clang entry point (cc1_main) would now create a compiler invocation
@@ -664,8 +2215,24 @@ public:
       PPOutOpts.RewriteIncludes = 0;    // Preprocess include directives only.
 
       FrontendInputFile file(utf8SourceName.m_psz, IK_HLSL);
-      clang::PrintPreprocessedAction action;
+      clang::PrintPreprocessedAction printAction;
+      clang::PreprocessOnlyAction scanAction;
+      FrontendAction &action = opts.ScanDependencies
+                                   ? static_cast<FrontendAction &>(scanAction)
+                                   : printAction;
+      IncludeReportCallbacks *pIncludeReport = nullptr;
       if (action.BeginSourceFile(compiler, file)) {
+        // The preprocessor owns its callbacks, and outlives the action.
+        if (opts.ReportIncludes) {
+          pIncludeReport =
+              new IncludeReportCallbacks(compiler.getSourceManager());
+          compiler.getPreprocessor().addPPCallbacks(
+              std::unique_ptr<PPCallbacks>(pIncludeReport));
+        }
+        if (opts.ScanDependencies) {
+          compiler.getPreprocessor().addPPCallbacks(
+              std::make_unique<DependencyListCallbacks>(outStream));
+        }
         action.Execute();
         action.EndSourceFile();
       }
@@ -674,8 +2241,12 @@ public:
       // Add std err to warnings.
       msfPtr->WriteStdErrToStream(w);
 
+      CComPtr<IDxcBlobEncoding> pReportBlob;
+      if (pIncludeReport)
+        pIncludeReport->CreateReport(&pReportBlob);
+
       CreateOperationResultFromOutputs(pOutputStream, msfPtr, warnings,
-        compiler.getDiagnostics(), ppResult);
+        compiler.getDiagnostics(), ppResult, pReportBlob);
       hr = S_OK;
     }
     CATCH_CPP_ASSIGN_HRESULT();
@@ -721,13 +2292,261 @@ public:
     return hr;
   }
 
+  // IDxcDisassembler
+  __override HRESULT STDMETHODCALLTYPE DisassembleToStream(
+    _In_ IDxcBlob *pProgram,                      // Program to disassemble.
+    UINT32 flags,                                 // DxcDisassembleFlags_* values.
+    _In_opt_ LPCWSTR pFunctionName,               // Only print the IR of this function.
+    _In_ IStream *pOutput                         // Receives the disassembly text.
+    ) {
+    if (pProgram == nullptr || pOutput == nullptr)
+      return E_INVALIDARG;
+
+    HRESULT hr = S_OK;
+    DxcEtw_DXCompilerDisassemble_Start();
+    DxcThreadMalloc TM(m_pMalloc);
+    try {
+      ::llvm::sys::fs::MSFileSystem *msfPtr;
+      IFT(CreateMSFileSystemForDisk(&msfPtr));
+      std::unique_ptr<::llvm::sys::fs::MSFileSystem> msf(msfPtr);
+
+      ::llvm::sys::fs::AutoPerThreadSystem pts(msf.get());
+      IFTLLVM(pts.error_code());
+
+      std::string FunctionName;
+      if (pFunctionName != nullptr)
+        FunctionName = Unicode::UTF16ToUTF8StringOrThrow(pFunctionName);
+
+      // Text is written to the caller's stream as it is printed.
+      raw_istream_ostream Stream(pOutput);
+      hr = dxcutil::Disassemble(pProgram, Stream, flags,
+                                pFunctionName ? FunctionName.c_str() : nullptr);
+      if (SUCCEEDED(hr))
+        hr = Stream.GetStatus();
+    }
+    CATCH_CPP_ASSIGN_HRESULT();
+    DxcEtw_DXCompilerDisassemble_Stop(hr);
+    return hr;
+  }
+
+  // IDxcRootSignatureCache
+  __override HRESULT STDMETHODCALLTYPE Intern(
+    _In_ IDxcBlob *pRootSignature,      // Serialized root signature, or a container with a root signature part.
+    _COM_Outptr_ IDxcBlob **ppInterned, // Serialized root signature shared by all equal ones.
+    _Out_opt_ UINT64 *pHash             // Canonical hash of the root signature.
+    ) {
+    if (pRootSignature == nullptr || ppInterned == nullptr)
+      return E_INVALIDARG;
+    *ppInterned = nullptr;
+    if (pHash != nullptr)
+      *pHash = 0;
+
+    const void *pData = pRootSignature->GetBufferPointer();
+    uint32_t size = (uint32_t)pRootSignature->GetBufferSize();
+    if (const DxilContainerHeader *pContainer = IsDxilContainerLike(pData, size)) {
+      if (!IsValidDxilContainer(pContainer, size))
+        return DXC_E_CONTAINER_INVALID;
+      const DxilPartHeader *pPart =
+          GetDxilPartByType(pContainer, DFCC_RootSignature);
+      if (pPart == nullptr)
+        return DXC_E_MISSING_PART;
+      pData = GetDxilPartData(pPart);
+      size = pPart->PartSize;
+    }
+
+    DxcThreadMalloc TM(m_pMalloc);
+    try {
+      uint64_t hash;
+      RootSignatureCache::Intern(pData, size, ppInterned, &hash);
+      if (pHash != nullptr)
+        *pHash = hash;
+    }
+    CATCH_CPP_RETURN_HRESULT();
+    return S_OK;
+  }
+
+  // IDxcCompilerCancel
+  __override HRESULT STDMETHODCALLTYPE CancelCompiles() {
+    ++m_cancelCount;
+    return S_OK;
+  }
+
+  // IDxcCompilerToStreams
+  __override HRESULT STDMETHODCALLTYPE CompileToStreams(
+    _In_ IDxcBlob *pSource,                       // Source text to compile
+    _In_opt_ LPCWSTR pSourceName,                 // Optional file name for pSource. Used in errors and include handlers.
+    _In_ LPCWSTR pEntryPoint,                     // Entry point name
+    _In_ LPCWSTR pTargetProfile,                  // Shader profile to compile
+    _In_count_(argCount) LPCWSTR *pArguments,     // Array of pointers to arguments
+    _In_ UINT32 argCount,                         // Number of arguments
+    _In_count_(defineCount) const DxcDefine *pDefines,  // Array of defines
+    _In_ UINT32 defineCount,                      // Number of defines
+    _In_opt_ IDxcIncludeHandler *pIncludeHandler, // user-provided interface to handle #include directives (optional)
+    _In_opt_ IStream *pObject,                    // Receives the container.
+    _In_opt_ IStream *pDebug,                     // Receives the debug blob.
+    _In_opt_ IStream *pDisassembly,               // Receives the disassembly.
+    _COM_Outptr_ IDxcOperationResult **ppResult   // Compiler output status and errors
+  ) {
+    if (ppResult == nullptr)
+      return E_INVALIDARG;
+    *ppResult = nullptr;
+
+    CComPtr<IDxcOperationResult> pResult;
+    CComPtr<IDxcBlob> pDebugBlob;
+    IFR(CompileWithDebug(pSource, pSourceName, pEntryPoint, pTargetProfile,
+                         pArguments, argCount, pDefines, defineCount,
+                         pIncludeHandler, &pResult, nullptr,
+                         pDebug ? &pDebugBlob : nullptr));
+    HRESULT status;
+    IFR(pResult->GetStatus(&status));
+    if (FAILED(status)) {
+      *ppResult = pResult.Detach();
+      return S_OK;
+    }
+
+    // Each output goes from the buffer it was built in straight to its
+    // stream, and the result doesn't keep the container alive afterwards.
+    CComPtr<IDxcBlob> pProgram;
+    IFR(pResult->GetResult(&pProgram));
+    if (pObject)
+      IFR(WriteAllToStream(pObject, pProgram->GetBufferPointer(),
+                           pProgram->GetBufferSize()));
+    if (pDebug && pDebugBlob)
+      IFR(WriteAllToStream(pDebug, pDebugBlob->GetBufferPointer(),
+                           pDebugBlob->GetBufferSize()));
+    if (pDisassembly) {
+      DxcThreadMalloc TM(m_pMalloc);
+      try {
+        ::llvm::sys::fs::MSFileSystem *msfPtr;
+        IFT(CreateMSFileSystemForDisk(&msfPtr));
+        std::unique_ptr<::llvm::sys::fs::MSFileSystem> msf(msfPtr);
+
+        ::llvm::sys::fs::AutoPerThreadSystem pts(msf.get());
+        IFTLLVM(pts.error_code());
+
+        raw_istream_ostream Stream(pDisassembly);
+        IFT(dxcutil::Disassemble(pProgram, Stream));
+        IFT(Stream.GetStatus());
+      }
+      CATCH_CPP_RETURN_HRESULT();
+    }
+
+    DxcThreadMalloc TM(m_pMalloc);
+    return DxcOperationResult::CreateWithoutResult(pResult, ppResult);
+  }
+
+  // IDxcCompilerBundle
+  __override HRESULT STDMETHODCALLTYPE CompileAndCaptureBundle(
+    _In_ IDxcBlob *pSource,                       // Source text to compile
+    _In_opt_ LPCWSTR pSourceName,                 // Optional file name for pSource. Used in errors and include handlers.
+    _In_ LPCWSTR pEntryPoint,                     // Entry point name
+    _In_ LPCWSTR pTargetProfile,                  // Shader profile to compile
+    _In_count_(argCount) LPCWSTR *pArguments,     // Array of pointers to arguments
+    _In_ UINT32 argCount,                         // Number of arguments
+    _In_count_(defineCount) const DxcDefine *pDefines,  // Array of defines
+    _In_ UINT32 defineCount,                      // Number of defines
+    _In_opt_ IDxcIncludeHandler *pIncludeHandler, // user-provided interface to handle #include directives (optional)
+    _COM_Outptr_ IDxcOperationResult **ppResult,  // Compiler output status, buffer, and errors
+    _Outptr_opt_result_z_ LPWSTR *ppDebugBlobName,// Suggested file name for debug blob.
+    _COM_Outptr_opt_ IDxcBlob **ppDebugBlob,      // Debug blob
+    _COM_Outptr_result_maybenull_ IDxcBlob **ppBundle // Inputs of the compile
+  ) {
+    if (pSource == nullptr || ppResult == nullptr || ppBundle == nullptr ||
+        (defineCount > 0 && pDefines == nullptr) ||
+        (argCount > 0 && pArguments == nullptr) || pEntryPoint == nullptr ||
+        pTargetProfile == nullptr)
+      return E_INVALIDARG;
+    *ppResult = nullptr;
+    *ppBundle = nullptr;
+    AssignToOutOpt(nullptr, ppDebugBlobName);
+    AssignToOutOpt(nullptr, ppDebugBlob);
+
+    HRESULT hr = S_OK;
+    DxcEtw_DXCompilerCompile_Start();
+    DxcThreadMalloc TM(m_pMalloc);
+    try {
+      // Outputs are only handed over once the bundle has been written.
+      CComPtr<IDxcOperationResult> pResult;
+      CComPtr<IDxcBlob> pDebugBlob;
+      CComHeapPtr<wchar_t> DebugBlobName;
+      CComPtr<IDxcBlob> pBundle;
+      dxcutil::DxcCompileBundle bundle;
+      bundle.SetRequest(pSourceName, pEntryPoint, pTargetProfile, pArguments,
+                        argCount, pDefines, defineCount);
+      CompileOptions options;
+      if (ReadCompileOptions(pTargetProfile, pArguments, argCount, pDefines,
+                             defineCount, options, &pResult)) {
+        hr = CompileWithOptions(pSource, pSourceName, pEntryPoint, options,
+                                pIncludeHandler, &pResult,
+                                ppDebugBlobName ? &DebugBlobName : nullptr,
+                                ppDebugBlob ? &pDebugBlob : nullptr, &bundle);
+        if (SUCCEEDED(hr) && bundle.pSource != nullptr)
+          dxcutil::WriteCompileBundle(bundle, &pBundle);
+      }
+      if (SUCCEEDED(hr)) {
+        *ppResult = pResult.Detach();
+        *ppBundle = pBundle.Detach();
+        if (ppDebugBlob)
+          *ppDebugBlob = pDebugBlob.Detach();
+        if (ppDebugBlobName)
+          *ppDebugBlobName = DebugBlobName.Detach();
+      }
+    }
+    CATCH_CPP_ASSIGN_HRESULT();
+    DxcEtw_DXCompilerCompile_Stop(hr);
+    return hr;
+  }
+
+  __override HRESULT STDMETHODCALLTYPE CompileBundle(
+    _In_ IDxcBlob *pBundle,                       // Bundle from CompileAndCaptureBundle
+    _COM_Outptr_ IDxcOperationResult **ppResult,  // Compiler output status, buffer, and errors
+    _Outptr_opt_result_z_ LPWSTR *ppDebugBlobName,// Suggested file name for debug blob.
+    _COM_Outptr_opt_ IDxcBlob **ppDebugBlob       // Debug blob
+  ) {
+    if (pBundle == nullptr || ppResult == nullptr)
+      return E_INVALIDARG;
+    *ppResult = nullptr;
+    AssignToOutOpt(nullptr, ppDebugBlobName);
+    AssignToOutOpt(nullptr, ppDebugBlob);
+
+    HRESULT hr = S_OK;
+    DxcEtw_DXCompilerCompile_Start();
+    DxcThreadMalloc TM(m_pMalloc);
+    try {
+      dxcutil::DxcCompileBundle bundle;
+      IFTARG(dxcutil::ReadCompileBundle(pBundle, bundle));
+      CComPtr<IDxcIncludeHandler> pIncludeHandler;
+      IFT(dxcutil::CreateBundleIncludeHandler(bundle, &pIncludeHandler));
+      std::vector<LPCWSTR> arguments = bundle.GetArguments();
+      std::vector<DxcDefine> defines = bundle.GetDefines();
+      CompileOptions options;
+      if (ReadCompileOptions(bundle.TargetProfile.c_str(), arguments.data(),
+                             (UINT32)arguments.size(), defines.data(),
+                             (UINT32)defines.size(), options, ppResult)) {
+        // Target the validator the bundle was captured with, rather than the
+        // one available here, so that both produce the same container.
+        if (bundle.HasValidatorVersion) {
+          options.ValidatorMajor = bundle.ValidatorMajor;
+          options.ValidatorMinor = bundle.ValidatorMinor;
+          options.HasValidatorVersion = true;
+        }
+        hr = CompileWithOptions(bundle.pSource, bundle.GetSourceName(),
+                                bundle.EntryPoint.c_str(), options,
+                                pIncludeHandler, ppResult, ppDebugBlobName,
+                                ppDebugBlob);
+      }
+    }
+    CATCH_CPP_ASSIGN_HRESULT();
+    DxcEtw_DXCompilerCompile_Stop(hr);
+    return hr;
+  }
+
   void SetupCompilerForCompile(CompilerInstance &compiler,
                                _In_ DxcLangExtensionsHelper *helper,
-                               _In_ LPCSTR pMainFile, _In_ TextDiagnosticPrinter *diagPrinter,
-                               _In_ std::vector<std::string>& defines,
+                               _In_ LPCSTR pMainFile, _In_ DiagnosticConsumer *diagPrinter,
+                               _In_ const std::vector<std::string>& defines,
                                _In_ hlsl::options::DxcOpts &Opts,
-                               _In_count_(argCount) LPCWSTR *pArguments,
-                               _In_ UINT32 argCount) {
+                               _In_ const std::vector<std::string> &arguments) {
     // Setup a compiler instance.
     std::shared_ptr<TargetOptions> targetOptions(new TargetOptions);
     targetOptions->Triple = "dxil-ms-dx";
@@ -750,8 +2569,14 @@ public:
     }
 
     clang::PreprocessorOptions &PPOpts(compiler.getPreprocessorOpts());
-    for (size_t i = 0; i < defines.size(); ++i) {
-      PPOpts.addMacroDef(defines[i]);
+    if (Opts.Preprocessed) {
+      // Macros were expanded when the source was preprocessed; the source
+      // only has line directives and pragmas left to process.
+      PPOpts.UsePredefines = false;
+    } else {
+      for (size_t i = 0; i < defines.size(); ++i) {
+        PPOpts.addMacroDef(defines[i]);
+      }
     }
 
     PPOpts.IgnoreLineDirectives = Opts.IgnoreLineDirectives;
@@ -790,6 +2615,7 @@ public:
     compiler.getLangOpts().HLSL2017 = Opts.HLSL2017;
 
     compiler.getLangOpts().UseMinPrecision = !Opts.NoMinPrecision;
+    compiler.getLangOpts().HLSLLazyFunctionBodies = Opts.LazyFunctionBodies;
 
 // SPIRV change starts
 #ifdef ENABLE_SPIRV_CODEGEN
@@ -799,6 +2625,12 @@ public:
 
     if (Opts.WarningAsError)
       compiler.getDiagnostics().setWarningsAsErrors(true);
+    else if (!Opts.OutputWarnings && Opts.DiagRecords &&
+             Opts.OutputWarningsFile.empty())
+      // In records mode, -no-warnings asks for no warning records. Otherwise
+      // warnings still go to the error buffer, which dxc writes to the -Fe
+      // file, and API callers get them whatever the option.
+      compiler.getDiagnostics().setIgnoreAllWarnings(true);
 
     if (Opts.IEEEStrict)
       compiler.getCodeGenOpts().UnsafeFPMath = true;
@@ -822,11 +2654,44 @@ public:
       compiler.getCodeGenOpts().UnrollLoops = true;
 
     compiler.getCodeGenOpts().HLSLHighLevel = Opts.CodeGenHighLevel;
+    compiler.getCodeGenOpts().HLSLStreamCodeGen = Opts.StreamCodeGen;
+    if (Opts.FastIteration) {
+      // The validator checks the module regardless; skip the IR verifier.
+      compiler.getCodeGenOpts().HLSLFastIteration = true;
+      compiler.getCodeGenOpts().VerifyModule = false;
+    }
+    compiler.getCodeGenOpts().SampleProfileFile = Opts.ProfileUseFile;
     compiler.getCodeGenOpts().HLSLAllResourcesBound = Opts.AllResourcesBound;
     compiler.getCodeGenOpts().HLSLDefaultRowMajor = Opts.DefaultRowMajor;
     compiler.getCodeGenOpts().HLSLPreferControlFlow = Opts.PreferFlowControl;
     compiler.getCodeGenOpts().HLSLAvoidControlFlow = Opts.AvoidFlowControl;
     compiler.getCodeGenOpts().HLSLNotUseLegacyCBufLoad = Opts.NotUseLegacyCBufLoad;
+    compiler.getCodeGenOpts().HLSLMergeBufferAccess = Opts.MergeBufferAccess;
+    compiler.getCodeGenOpts().HLSLHoistHandles = Opts.HoistHandles;
+    compiler.getCodeGenOpts().HLSLHoistInvariantReads = Opts.HoistInvariantReads;
+    compiler.getCodeGenOpts().HLSLSinkResourceReads = Opts.SinkResourceReads;
+    compiler.getCodeGenOpts().HLSLUnrollBudget = Opts.UnrollBudget;
+    compiler.getCodeGenOpts().HLSLAnnotateUniform = Opts.AnnotateUniform;
+    compiler.getCodeGenOpts().HLSLOptimizeGroupSharedLayout = Opts.OptimizeGroupSharedLayout;
+    compiler.getCodeGenOpts().HLSLOptimizeCBufferLayout = Opts.OptimizeCBufferLayout;
+    compiler.getCodeGenOpts().MergeFunctions = Opts.MergeFunctions;
+    compiler.getCodeGenOpts().HLSLDemotePrecision = Opts.DemotePrecision;
+    compiler.getCodeGenOpts().HLSLRemoveRedundantBarriers = Opts.RemoveRedundantBarriers;
+    compiler.getCodeGenOpts().HLSLAggregateAtomics = Opts.AggregateAtomics;
+    if (Opts.DemotePrecision || Opts.RemoveRedundantBarriers) {
+      // Report each demoted expression and barrier change as a remark.
+      std::string remarkPasses;
+      if (Opts.DemotePrecision)
+        remarkPasses = "hlsl-dxil-demote-precision";
+      if (Opts.RemoveRedundantBarriers) {
+        if (!remarkPasses.empty())
+          remarkPasses += "|";
+        remarkPasses += "hlsl-dxil-remove-redundant-barriers";
+      }
+      compiler.getCodeGenOpts().OptimizationRemarkPattern =
+          std::make_shared<llvm::Regex>(remarkPasses);
+    }
+    compiler.getCodeGenOpts().HLSLPackedTypeAnnotations = Opts.PackedTypeAnnotations;
     compiler.getCodeGenOpts().HLSLDefines = defines;
     compiler.getCodeGenOpts().MainFileName = pMainFile;
 
@@ -838,13 +2703,7 @@ public:
     else
       compiler.getCodeGenOpts().HLSLSignaturePackingStrategy = (unsigned)DXIL::PackingStrategy::Default;
 
-    // Constructing vector of wide strings to pass in to codegen. Just passing
-    // in pArguments will expose ownership of memory to both CodeGenOptions and
-    // this caller, which can lead to unexpected behavior.
-    for (UINT32 i = 0; i != argCount; ++i) {
-      compiler.getCodeGenOpts().HLSLArguments.emplace_back(
-          Unicode::UTF16ToUTF8StringOrThrow(pArguments[i]));
-    }
+    compiler.getCodeGenOpts().HLSLArguments = arguments;
     // Overrding default set of loop unroll.
     if (Opts.PreferFlowControl)
       compiler.getCodeGenOpts().UnrollLoops = false;
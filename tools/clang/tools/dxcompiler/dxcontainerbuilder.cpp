@@ -27,17 +27,19 @@ using namespace hlsl;
 // This declaration is used for the locally-linked validator.
 HRESULT CreateDxcValidator(_In_ REFIID riid, _Out_ LPVOID *ppv);
 
-class DxcContainerBuilder : public IDxcContainerBuilder {
+class DxcContainerBuilder : public IDxcContainerBuilder2 {
 public:
   __override HRESULT STDMETHODCALLTYPE Load(_In_ IDxcBlob *pDxilContainerHeader); // Loads DxilContainer to the builder
   __override HRESULT STDMETHODCALLTYPE AddPart(_In_ UINT32 fourCC, _In_ IDxcBlob *pSource); // Add the given part with fourCC
   __override HRESULT STDMETHODCALLTYPE RemovePart(_In_ UINT32 fourCC);                // Remove the part with fourCC
   __override HRESULT STDMETHODCALLTYPE SerializeContainer(_Out_ IDxcOperationResult **ppResult); // Builds a container of the given container builder state
+  __override HRESULT STDMETHODCALLTYPE EditParts(_In_count_(editCount) const DxcContainerPartEdit *pEdits, UINT32 editCount); // Adds, replaces or removes parts
+  __override HRESULT STDMETHODCALLTYPE SerializeContainerWithFlags(UINT32 flags, _Out_ IDxcOperationResult **ppResult);
 
   DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
   DXC_MICROCOM_TM_CTOR(DxcContainerBuilder)
   HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void **ppvObject) {
-    return DoBasicQueryInterface<IDxcContainerBuilder>(this, riid, ppvObject);
+    return DoBasicQueryInterface<IDxcContainerBuilder, IDxcContainerBuilder2>(this, riid, ppvObject);
   }
 
   void Init(const char *warning) {
@@ -61,6 +63,20 @@ private:
   const char *m_warning;
   bool m_RequireValidation;
 
+  static bool IsAddablePart(UINT32 fourCC) {
+    return fourCC == DxilFourCC::DFCC_RootSignature ||
+           fourCC == DxilFourCC::DFCC_PrivateData;
+  }
+  static bool IsRemovablePart(UINT32 fourCC) {
+    return fourCC == DxilFourCC::DFCC_ShaderDebugInfoDXIL ||
+           IsAddablePart(fourCC);
+  }
+  static PartList::iterator FindPart(PartList &parts, UINT32 fourCC) {
+    return std::find_if(parts.begin(), parts.end(), [&](const DxilPart &part) {
+      return part.m_fourCC == fourCC;
+    });
+  }
+
   UINT32 ComputeContainerSize();
   HRESULT UpdateContainerHeader(AbstractMemoryStream *pStream, uint32_t containerSize);
   HRESULT UpdateOffsetTable(AbstractMemoryStream *pStream);
@@ -80,10 +96,7 @@ HRESULT STDMETHODCALLTYPE DxcContainerBuilder::Load(_In_ IDxcBlob *pSource) {
       const DxilPartHeader *pPartHeader = *it;
       CComPtr<IDxcBlobEncoding> pBlob;
       IFT(DxcCreateBlobWithEncodingFromPinned((const void *)(pPartHeader + 1), pPartHeader->PartSize, CP_UTF8, &pBlob));
-      PartList::iterator itPartList = std::find_if(m_parts.begin(), m_parts.end(), [&](DxilPart part) {
-        return part.m_fourCC == pPartHeader->PartFourCC;
-      });
-      IFTBOOL(itPartList == m_parts.end(), DXC_E_DUPLICATE_PART);
+      IFTBOOL(FindPart(m_parts, pPartHeader->PartFourCC) == m_parts.end(), DXC_E_DUPLICATE_PART);
       m_parts.emplace_back(DxilPart(pPartHeader->PartFourCC, pBlob));
     }
     return S_OK;
@@ -99,11 +112,8 @@ HRESULT STDMETHODCALLTYPE DxcContainerBuilder::AddPart(_In_ UINT32 fourCC, _In_
       pSource->GetBufferSize()),
       E_INVALIDARG);
     // Only allow adding private data and root signature for now
-    IFTBOOL(fourCC == DxilFourCC::DFCC_RootSignature || fourCC == DxilFourCC::DFCC_PrivateData, E_INVALIDARG);
-    PartList::iterator it = std::find_if(m_parts.begin(), m_parts.end(), [&](DxilPart part) {
-      return part.m_fourCC == fourCC;
-    });
-    IFTBOOL(it == m_parts.end(), DXC_E_DUPLICATE_PART);
+    IFTBOOL(IsAddablePart(fourCC), E_INVALIDARG);
+    IFTBOOL(FindPart(m_parts, fourCC) == m_parts.end(), DXC_E_DUPLICATE_PART);
     m_parts.emplace_back(DxilPart(fourCC, pSource));
     if (fourCC == DxilFourCC::DFCC_RootSignature) {
       m_RequireValidation = true;
@@ -116,13 +126,9 @@ HRESULT STDMETHODCALLTYPE DxcContainerBuilder::AddPart(_In_ UINT32 fourCC, _In_
 HRESULT STDMETHODCALLTYPE DxcContainerBuilder::RemovePart(_In_ UINT32 fourCC) {
   DxcThreadMalloc TM(m_pMalloc);
   try {
-    IFTBOOL(fourCC == DxilFourCC::DFCC_ShaderDebugInfoDXIL ||
-                fourCC == DxilFourCC::DFCC_RootSignature ||
-                fourCC == DxilFourCC::DFCC_PrivateData,
+    IFTBOOL(IsRemovablePart(fourCC),
             E_INVALIDARG); // You can only remove debug info, rootsignature, or private data blob
-    PartList::iterator it =
-      std::find_if(m_parts.begin(), m_parts.end(),
-        [&](DxilPart part) { return part.m_fourCC == fourCC; });
+    PartList::iterator it = FindPart(m_parts, fourCC);
     IFTBOOL(it != m_parts.end(), DXC_E_MISSING_PART);
     m_parts.erase(it);
     return S_OK;
@@ -130,9 +136,50 @@ HRESULT STDMETHODCALLTYPE DxcContainerBuilder::RemovePart(_In_ UINT32 fourCC) {
   CATCH_CPP_RETURN_HRESULT();
 }
 
+HRESULT STDMETHODCALLTYPE DxcContainerBuilder::EditParts(_In_count_(editCount) const DxcContainerPartEdit *pEdits, UINT32 editCount) {
+  DxcThreadMalloc TM(m_pMalloc);
+  try {
+    IFTBOOL(pEdits != nullptr || editCount == 0, E_INVALIDARG);
+    // Edit a copy of the part list, so a failed edit leaves the builder as is.
+    PartList parts(m_parts);
+    bool requireValidation = m_RequireValidation;
+    for (UINT32 i = 0; i < editCount; ++i) {
+      UINT32 fourCC = pEdits[i].FourCC;
+      IDxcBlob *pSource = pEdits[i].pSource;
+      PartList::iterator it = FindPart(parts, fourCC);
+      if (pSource == nullptr) {
+        IFTBOOL(IsRemovablePart(fourCC), E_INVALIDARG);
+        IFTBOOL(it != parts.end(), DXC_E_MISSING_PART);
+        parts.erase(it);
+        continue;
+      }
+      IFTBOOL(IsAddablePart(fourCC) &&
+                  !IsDxilContainerLike(pSource->GetBufferPointer(),
+                                       pSource->GetBufferSize()),
+              E_INVALIDARG);
+      if (it != parts.end())
+        it->m_Blob = pSource;
+      else
+        parts.emplace_back(DxilPart(fourCC, pSource));
+      if (fourCC == DxilFourCC::DFCC_RootSignature) {
+        requireValidation = true;
+      }
+    }
+    m_parts.swap(parts);
+    m_RequireValidation = requireValidation;
+    return S_OK;
+  }
+  CATCH_CPP_RETURN_HRESULT();
+}
+
 HRESULT STDMETHODCALLTYPE DxcContainerBuilder::SerializeContainer(_Out_ IDxcOperationResult **ppResult) {
+  return SerializeContainerWithFlags(DxcContainerBuilderFlags_Default, ppResult);
+}
+
+HRESULT STDMETHODCALLTYPE DxcContainerBuilder::SerializeContainerWithFlags(UINT32 flags, _Out_ IDxcOperationResult **ppResult) {
   DxcThreadMalloc TM(m_pMalloc);
   try {
+    IFTBOOL((flags & ~DxcContainerBuilderFlags_ValidMask) == 0, E_INVALIDARG);
     // Allocate memory for new dxil container.
     uint32_t ContainerSize = ComputeContainerSize();
     CComPtr<AbstractMemoryStream> pMemoryStream;
@@ -152,7 +199,8 @@ HRESULT STDMETHODCALLTYPE DxcContainerBuilder::SerializeContainer(_Out_ IDxcOper
 
     CComPtr<IDxcBlobEncoding> pErrorBlob;
     HRESULT valHR = S_OK;
-    if (m_RequireValidation) {
+    if (m_RequireValidation &&
+        (flags & DxcContainerBuilderFlags_SkipValidation) == 0) {
       CComPtr<IDxcValidator> pValidator;
       IFT(CreateDxcValidator(IID_PPV_ARGS(&pValidator)));
       CComPtr<IDxcOperationResult> pValidationResult;
@@ -188,7 +236,7 @@ HRESULT STDMETHODCALLTYPE DxcContainerBuilder::SerializeContainer(_Out_ IDxcOper
 
 UINT32 DxcContainerBuilder::ComputeContainerSize() {
   UINT32 partsSize = 0;
-  for (DxilPart part : m_parts) {
+  for (const DxilPart &part : m_parts) {
     partsSize += part.m_Blob->GetBufferSize();
   }
   return GetDxilContainerSizeFromParts(m_parts.size(), partsSize);
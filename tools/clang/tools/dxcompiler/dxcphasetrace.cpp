@@ -0,0 +1,56 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// dxcphasetrace.cpp                                                         //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Emits a trace event at the start and end of each phase of a compile.      //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxcphasetrace.h"
+#include "dxcetw.h"
+#include <limits>
+
+namespace dxcutil {
+
+// FNV-1a over the UTF-16 code units of the name; stable across processes.
+static UINT32 HashSourceName(LPCWSTR pSourceName) {
+  UINT32 hash = 2166136261u;
+  if (pSourceName == nullptr)
+    return hash;
+  for (const wchar_t *p = pSourceName; *p; ++p) {
+    hash ^= (UINT32)*p;
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+DxcPhaseTracer::DxcPhaseTracer(LPCWSTR pSourceName, size_t sourceSize,
+                               hlsl::CompilePhaseListener *pNext)
+    : m_pNext(pNext), m_sourceNameHash(HashSourceName(pSourceName)),
+      m_sourceSize(sourceSize > std::numeric_limits<UINT32>::max()
+                       ? std::numeric_limits<UINT32>::max()
+                       : (UINT32)sourceSize) {}
+
+void DxcPhaseTracer::phaseStarted(const char *pName) {
+  DxcEtw_DXCompilerPhase_Start(pName, m_depth, m_sourceNameHash, m_sourceSize);
+  ++m_depth;
+  if (m_pNext)
+    m_pNext->phaseStarted(pName);
+}
+
+void DxcPhaseTracer::phaseFinished(const char *pName) {
+  if (m_pNext)
+    m_pNext->phaseFinished(pName);
+  --m_depth;
+  DxcEtw_DXCompilerPhase_Stop(pName, m_depth, m_sourceNameHash, m_sourceSize);
+}
+
+void DxcPhaseTracer::checkpoint() {
+  if (m_pNext)
+    m_pNext->checkpoint();
+}
+
+} // namespace dxcutil
@@ -0,0 +1,41 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// dxcphasetrace.h                                                           //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Emits a trace event at the start and end of each phase of a compile.      //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "dxc/Support/WinIncludes.h"
+#include "dxc/Support/CompilePhaseListener.h"
+
+namespace dxcutil {
+
+/// Emits the DXCompilerPhase_Start and DXCompilerPhase_Stop events for each
+/// phase of a compile, then passes the phase on to pNext if there is one.
+///
+/// Each event carries the phase name, its nesting depth, a hash of the
+/// source name and the size of the source, so that events from concurrent
+/// compiles can be told apart.
+class DxcPhaseTracer : public hlsl::CompilePhaseListener {
+public:
+  DxcPhaseTracer(_In_opt_ LPCWSTR pSourceName, size_t sourceSize,
+                 _In_opt_ hlsl::CompilePhaseListener *pNext);
+
+  void phaseStarted(const char *pName) override;
+  void phaseFinished(const char *pName) override;
+  void checkpoint() override;
+
+private:
+  hlsl::CompilePhaseListener *m_pNext;
+  UINT32 m_sourceNameHash;
+  UINT32 m_sourceSize;
+  UINT32 m_depth = 0;
+};
+
+} // namespace dxcutil
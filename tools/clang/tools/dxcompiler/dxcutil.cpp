@@ -13,8 +13,10 @@
 
 #include "dxc/Support/WinIncludes.h"
 #include "dxc/HLSL/DxilContainer.h"
+#include "dxc/HLSL/DxilValidation.h"
 #include "dxc/Support/Global.h"
 #include "dxc/Support/FileIOHelper.h"
+#include "dxc/Support/CompilePhaseListener.h"
 #include "dxc/dxcapi.h"
 #include "dxcutil.h"
 #include "dxillib.h"
@@ -26,7 +28,6 @@
 #include "llvm/IR/Module.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/raw_ostream.h"
-#include "llvm/Transforms/Utils/Cloning.h"
 #include "dxc/Support/dxcapi.impl.h"
 
 #include "llvm/Support/Path.h"
@@ -44,14 +45,16 @@ HRESULT RunInternalValidator(_In_ IDxcValidator *pValidator,
                              _In_ llvm::Module *pModule,
                              _In_ llvm::Module *pDebugModule,
                              _In_ IDxcBlob *pShader, UINT32 Flags,
-                             _In_ IDxcOperationResult **ppResult);
+                             _In_ IDxcOperationResult **ppResult,
+                             _In_opt_ hlsl::CompilePhaseListener *pPhases,
+                             _In_opt_ const hlsl::DxilPartDigests *pTrustedParts);
 
 namespace {
 // AssembleToContainer helper functions.
 
 bool CreateValidator(CComPtr<IDxcValidator> &pValidator) {
   if (DxilLibIsEnabled()) {
-    DxilLibCreateInstance(CLSID_DxcValidator, &pValidator);
+    DxilLibAcquireValidator(&pValidator);
   }
   bool bInternalValidator = false;
   if (pValidator == nullptr) {
@@ -61,6 +64,39 @@ bool CreateValidator(CComPtr<IDxcValidator> &pValidator) {
   return bInternalValidator;
 }
 
+// Returns a validator from CreateValidator; validators from dxil.dll are
+// pooled for later compiles.
+void ReleaseValidator(CComPtr<IDxcValidator> &pValidator,
+                      bool bInternalValidator) {
+  if (bInternalValidator)
+    pValidator.Release();
+  else
+    DxilLibReleaseValidator(pValidator.Detach());
+}
+
+struct ValidatorVersion {
+  unsigned Major;
+  unsigned Minor;
+};
+
+ValidatorVersion QueryValidatorVersion() {
+  ValidatorVersion version;
+  CComPtr<IDxcValidator> pValidator;
+  bool bInternalValidator = CreateValidator(pValidator);
+
+  CComPtr<IDxcVersionInfo> pVersionInfo;
+  if (SUCCEEDED(pValidator.QueryInterface(&pVersionInfo))) {
+    IFT(pVersionInfo->GetVersion(&version.Major, &version.Minor));
+  } else {
+    // Default to 1.0
+    version.Major = 1;
+    version.Minor = 0;
+  }
+  pVersionInfo.Release();
+  ReleaseValidator(pValidator, bInternalValidator);
+  return version;
+}
+
 // Class to manage lifetime of llvm module and provide some utility
 // functions used for generating compiler output.
 class DxilCompilerLLVMModuleOutput {
@@ -68,29 +104,25 @@ public:
   DxilCompilerLLVMModuleOutput(std::unique_ptr<llvm::Module> module)
       : m_llvmModule(std::move(module)) {}
 
-  void CloneForDebugInfo() {
-    m_llvmModuleWithDebugInfo.reset(llvm::CloneModule(m_llvmModule.get()));
-  }
-
   void WrapModuleInDxilContainer(IMalloc *pMalloc,
                                  AbstractMemoryStream *pModuleBitcode,
                                  CComPtr<IDxcBlob> &pDxilContainerBlob,
-                                 SerializeDxilFlags Flags) {
+                                 SerializeDxilFlags Flags,
+                                 DxilPartDigests *pDigests = nullptr) {
     CComPtr<AbstractMemoryStream> pContainerStream;
     IFT(CreateMemoryStream(pMalloc, &pContainerStream));
     SerializeDxilContainerForModule(&m_llvmModule->GetOrCreateDxilModule(),
-                                    pModuleBitcode, pContainerStream, Flags);
+                                    pModuleBitcode, pContainerStream, Flags,
+                                    pDigests);
 
     pDxilContainerBlob.Release();
     IFT(pContainerStream.QueryInterface(&pDxilContainerBlob));
   }
 
   llvm::Module *get() { return m_llvmModule.get(); }
-  llvm::Module *getWithDebugInfo() { return m_llvmModuleWithDebugInfo.get(); }
 
 private:
   std::unique_ptr<llvm::Module> m_llvmModule;
-  std::unique_ptr<llvm::Module> m_llvmModuleWithDebugInfo;
 };
 
 } // namespace
@@ -100,17 +132,11 @@ void GetValidatorVersion(unsigned *pMajor, unsigned *pMinor) {
   if (pMajor == nullptr || pMinor == nullptr)
     return;
 
-  CComPtr<IDxcValidator> pValidator;
-  CreateValidator(pValidator);
-
-  CComPtr<IDxcVersionInfo> pVersionInfo;
-  if (SUCCEEDED(pValidator.QueryInterface(&pVersionInfo))) {
-    IFT(pVersionInfo->GetVersion(pMajor, pMinor));
-  } else {
-    // Default to 1.0
-    *pMajor = 1;
-    *pMinor = 0;
-  }
+  // Whether dxil.dll is used is decided once per process, so the version
+  // can't change after the first query.
+  static const ValidatorVersion version = QueryValidatorVersion();
+  *pMajor = version.Major;
+  *pMinor = version.Minor;
 }
 
 void AssembleToContainer(std::unique_ptr<llvm::Module> pM,
@@ -129,7 +155,7 @@ HRESULT ValidateAndAssembleToContainer(
     std::unique_ptr<llvm::Module> pM, CComPtr<IDxcBlob> &pOutputBlob,
     IMalloc *pMalloc, SerializeDxilFlags SerializeFlags,
     CComPtr<AbstractMemoryStream> &pOutputStream, bool bDebugInfo,
-    clang::DiagnosticsEngine &Diag) {
+    clang::DiagnosticsEngine &Diag, hlsl::CompilePhaseListener *pPhases) {
   HRESULT valHR = S_OK;
 
   // Take ownership of the module from the action.
@@ -137,24 +163,49 @@ HRESULT ValidateAndAssembleToContainer(
 
   CComPtr<IDxcValidator> pValidator;
   bool bInternalValidator = CreateValidator(pValidator);
-  // If using the internal validator, we'll use the modules directly.
-  // In this case, we'll want to make a clone to avoid
-  // SerializeDxilContainerForModule stripping all the debug info. The debug
-  // info will be stripped from the orginal module, but preserved in the cloned
-  // module.
-  if (bInternalValidator && bDebugInfo)
-    llvmModule.CloneForDebugInfo();
+  // A validator from dxil.dll may not read a compressed debug part.
+  if (!bInternalValidator)
+    SerializeFlags &= ~SerializeDxilFlags::CompressDebugInfoPart;
 
-  llvmModule.WrapModuleInDxilContainer(pMalloc, pOutputStream, pOutputBlob,
-                                       SerializeFlags);
+  // SerializeDxilContainerForModule strips the debug info from the module,
+  // so the internal validator runs on the stripped module directly. It also
+  // trusts the parts assembled from that module rather than generating them
+  // again; a validator from dxil.dll checks everything.
+  DxilPartDigests partDigests;
+  {
+    hlsl::CompilePhaseScope Phase(pPhases, "Container serialization");
+    llvmModule.WrapModuleInDxilContainer(pMalloc, pOutputStream, pOutputBlob,
+                                         SerializeFlags,
+                                         bInternalValidator ? &partDigests
+                                                            : nullptr);
+  }
 
+  hlsl::CompilePhaseScope Phase(pPhases, "Validation");
   CComPtr<IDxcOperationResult> pValResult;
   // Important: in-place edit is required so the blob is reused and thus
   // dxil.dll can be released.
   if (bInternalValidator) {
-    IFT(RunInternalValidator(pValidator, llvmModule.get(),
-                             llvmModule.getWithDebugInfo(), pOutputBlob,
-                             DxcValidatorFlags_InPlaceEdit, &pValResult));
+    IFT(RunInternalValidator(pValidator, llvmModule.get(), nullptr,
+                             pOutputBlob, DxcValidatorFlags_InPlaceEdit,
+                             &pValResult, pPhases, &partDigests));
+    IFT(pValResult->GetStatus(&valHR));
+    // The debug module only serves to report source locations for errors.
+    // Failing validation is rare, so rather than cloning the module up
+    // front, load it from the unstripped bitcode and validate again.
+    if (FAILED(valHR) && bDebugInfo) {
+      llvm::LLVMContext DebugContext;
+      std::unique_ptr<llvm::Module> pDebugModule;
+      if (SUCCEEDED(ValidateLoadModule(
+              (const char *)pOutputStream->GetPtr(),
+              (uint32_t)pOutputStream->GetPtrSize(), pDebugModule,
+              DebugContext, llvm::nulls(), /*bLazyLoad*/ false))) {
+        pValResult.Release();
+        IFT(RunInternalValidator(pValidator, llvmModule.get(),
+                                 pDebugModule.get(), pOutputBlob,
+                                 DxcValidatorFlags_InPlaceEdit, &pValResult,
+                                 pPhases, &partDigests));
+      }
+    }
   } else {
     IFT(pValidator->Validate(pOutputBlob, DxcValidatorFlags_InPlaceEdit,
                              &pValResult));
@@ -176,7 +227,7 @@ HRESULT ValidateAndAssembleToContainer(
   if (pValidatedBlob != nullptr) {
     std::swap(pOutputBlob, pValidatedBlob);
   }
-  pValidator.Release();
+  ReleaseValidator(pValidator, bInternalValidator);
 
   return valHR;
 }
@@ -184,7 +235,8 @@ HRESULT ValidateAndAssembleToContainer(
 void CreateOperationResultFromOutputs(
     IDxcBlob *pResultBlob, CComPtr<IStream> &pErrorStream,
     const std::string &warnings, bool hasErrorOccurred,
-    _COM_Outptr_ IDxcOperationResult **ppResult) {
+    _COM_Outptr_ IDxcOperationResult **ppResult, IDxcBlobEncoding *pReport,
+    std::vector<DxcDiagnosticRecord> *pDiagnostics) {
   CComPtr<IDxcBlobEncoding> pErrorBlob;
 
   if (pErrorStream != nullptr) {
@@ -199,8 +251,14 @@ void CreateOperationResultFromOutputs(
   }
 
   HRESULT status = hasErrorOccurred ? E_FAIL : S_OK;
-  IFT(DxcOperationResult::CreateFromResultErrorStatus(pResultBlob, pErrorBlob,
-                                                      status, ppResult));
+  if (pDiagnostics != nullptr) {
+    IFT(DxcOperationResult::CreateFromResultDiagnosticsStatus(
+        pResultBlob, std::move(*pDiagnostics), pErrorBlob, pReport, status,
+        ppResult));
+    return;
+  }
+  IFT(DxcOperationResult::CreateFromResultErrorReportStatus(
+      pResultBlob, pErrorBlob, pReport, status, ppResult));
 }
 
 bool IsAbsoluteOrCurDirRelative(const Twine &T) {
@@ -14,6 +14,7 @@
 #include "dxc/dxcapi.h"
 #include "dxc/Support/microcom.h"
 #include <memory>
+#include <vector>
 
 namespace clang {
 class DiagnosticsEngine;
@@ -23,7 +24,7 @@ namespace llvm {
 class LLVMContext;
 class MemoryBuffer;
 class Module;
-class raw_string_ostream;
+class raw_ostream;
 class StringRef;
 class Twine;
 } // namespace llvm
@@ -31,27 +32,38 @@ class Twine;
 namespace hlsl {
 enum class SerializeDxilFlags : uint32_t;
 class AbstractMemoryStream;
+class CompilePhaseListener;
 }
 
+struct DxcDiagnosticRecord;
 
 namespace dxcutil {
 HRESULT ValidateAndAssembleToContainer(
     std::unique_ptr<llvm::Module> pM, CComPtr<IDxcBlob> &pOutputContainerBlob,
     IMalloc *pMalloc, hlsl::SerializeDxilFlags SerializeFlags,
     CComPtr<hlsl::AbstractMemoryStream> &pModuleBitcode, bool bDebugInfo,
-    clang::DiagnosticsEngine &Diag);
+    clang::DiagnosticsEngine &Diag,
+    hlsl::CompilePhaseListener *pPhases = nullptr);
 void GetValidatorVersion(unsigned *pMajor, unsigned *pMinor);
 void AssembleToContainer(std::unique_ptr<llvm::Module> pM,
                          CComPtr<IDxcBlob> &pOutputContainerBlob,
                          IMalloc *pMalloc,
                          hlsl::SerializeDxilFlags SerializeFlags,
                          CComPtr<hlsl::AbstractMemoryStream> &pModuleBitcode);
-HRESULT Disassemble(IDxcBlob *pProgram, llvm::raw_string_ostream &Stream);
+// Prints the program; flags are DxcDisassembleFlags_* values, and a function
+// name restricts the IR to that one function.
+HRESULT Disassemble(IDxcBlob *pProgram, llvm::raw_ostream &Stream,
+                    UINT32 flags = DxcDisassembleFlags_None,
+                    const char *pFunctionName = nullptr);
 
+// With pDiagnostics, the error buffer of the result is formatted from the
+// diagnostics on first request, ahead of the other error text.
 void CreateOperationResultFromOutputs(
     IDxcBlob *pResultBlob, CComPtr<IStream> &pErrorStream,
     const std::string &warnings, bool hasErrorOccurred,
-    _COM_Outptr_ IDxcOperationResult **ppResult);
+    _COM_Outptr_ IDxcOperationResult **ppResult,
+    _In_opt_ IDxcBlobEncoding *pReport = nullptr,
+    _In_opt_ std::vector<DxcDiagnosticRecord> *pDiagnostics = nullptr);
 
 bool IsAbsoluteOrCurDirRelative(const llvm::Twine &T);
 
@@ -16,6 +16,7 @@
 #include "dxc/Support/WinIncludes.h"
 #include "dxc/HLSL/DxilContainer.h"
 #include "dxc/HLSL/DxilValidation.h"
+#include "dxc/Support/CompilePhaseListener.h"
 
 #include "dxc/Support/Global.h"
 #include "llvm/Support/FileSystem.h"
@@ -49,13 +50,17 @@ struct DiagRestore {
 class DxcValidator : public IDxcValidator, public IDxcVersionInfo {
 private:
   DXC_MICROCOM_TM_REF_FIELDS()
+  // Function bodies that passed validations with DxcValidatorFlags_CacheFunctions.
+  hlsl::ValidationFunctionCache m_FunctionCache;
 
   HRESULT RunValidation(
     _In_ IDxcBlob *pShader,                       // Shader to validate.
     _In_ UINT32 Flags,                            // Validation flags.
     _In_ llvm::Module *pModule,                   // Module to validate, if available.
     _In_ llvm::Module *pDebugModule,              // Debug module to validate, if available
-    _In_ AbstractMemoryStream *pDiagStream);
+    _In_ AbstractMemoryStream *pDiagStream,
+    _In_opt_ hlsl::CompilePhaseListener *pPhases,
+    _In_opt_ const hlsl::DxilPartDigests *pTrustedParts);
 
   HRESULT RunRootSignatureValidation(
     _In_ IDxcBlob *pShader,                       // Shader to validate.
@@ -75,7 +80,9 @@ public:
     _In_ UINT32 Flags,                            // Validation flags.
     _In_ llvm::Module *pModule,                   // Module to validate, if available.
     _In_ llvm::Module *pDebugModule,              // Debug module to validate, if available
-    _COM_Outptr_ IDxcOperationResult **ppResult   // Validation output status, buffer, and errors
+    _COM_Outptr_ IDxcOperationResult **ppResult,  // Validation output status, buffer, and errors
+    _In_opt_ hlsl::CompilePhaseListener *pPhases = nullptr, // Checks in during validation; may throw to stop it
+    _In_opt_ const hlsl::DxilPartDigests *pTrustedParts = nullptr // Parts of pShader assembled from pModule
   );
 
   // IDxcValidator
@@ -109,7 +116,9 @@ HRESULT DxcValidator::ValidateWithOptModules(
   _In_ UINT32 Flags,                            // Validation flags.
   _In_ llvm::Module *pModule,                   // Module to validate, if available.
   _In_ llvm::Module *pDebugModule,              // Debug module to validate, if available
-  _COM_Outptr_ IDxcOperationResult **ppResult   // Validation output status, buffer, and errors
+  _COM_Outptr_ IDxcOperationResult **ppResult,  // Validation output status, buffer, and errors
+  _In_opt_ hlsl::CompilePhaseListener *pPhases, // Checks in during validation; may throw to stop it
+  _In_opt_ const hlsl::DxilPartDigests *pTrustedParts // Parts of pShader assembled from pModule
 ) {
   *ppResult = nullptr;
   HRESULT hr = S_OK;
@@ -125,7 +134,7 @@ HRESULT DxcValidator::ValidateWithOptModules(
     if (Flags & DxcValidatorFlags_RootSignatureOnly) {
       validationStatus = RunRootSignatureValidation(pShader, pDiagStream);
     } else {
-      validationStatus = RunValidation(pShader, Flags, pModule, pDebugModule, pDiagStream);
+      validationStatus = RunValidation(pShader, Flags, pModule, pDebugModule, pDiagStream, pPhases, pTrustedParts);
     }
     if (FAILED(validationStatus)) {
       std::string msg("Validation failed.\n");
@@ -169,13 +178,17 @@ HRESULT DxcValidator::RunValidation(
   _In_ UINT32 Flags,                            // Validation flags.
   _In_ llvm::Module *pModule,                   // Module to validate, if available.
   _In_ llvm::Module *pDebugModule,              // Debug module to validate, if available
-  _In_ AbstractMemoryStream *pDiagStream) {
+  _In_ AbstractMemoryStream *pDiagStream,
+  _In_opt_ hlsl::CompilePhaseListener *pPhases,
+  _In_opt_ const hlsl::DxilPartDigests *pTrustedParts) {
 
   // Run validation may throw, but that indicates an inability to validate,
   // not that the validation failed (eg out of memory). That is indicated
   // by a failing HRESULT, and possibly error messages in the diagnostics stream.
 
   raw_stream_ostream DiagStream(pDiagStream);
+  ValidationFunctionCache *pFunctionCache =
+      (Flags & DxcValidatorFlags_CacheFunctions) ? &m_FunctionCache : nullptr;
 
   if (Flags & DxcValidatorFlags_ModuleOnly) {
     IFRBOOL(!IsDxilContainerLike(pShader->GetBufferPointer(), pShader->GetBufferSize()), E_INVALIDARG);
@@ -186,9 +199,9 @@ HRESULT DxcValidator::RunValidation(
   if (!pModule) {
     DXASSERT_NOMSG(pDebugModule == nullptr);
     if (Flags & DxcValidatorFlags_ModuleOnly) {
-      return ValidateDxilBitcode((const char*)pShader->GetBufferPointer(), (uint32_t)pShader->GetBufferSize(), DiagStream);
+      return ValidateDxilBitcode((const char*)pShader->GetBufferPointer(), (uint32_t)pShader->GetBufferSize(), DiagStream, pFunctionCache);
     } else {
-      return ValidateDxilContainer(pShader->GetBufferPointer(), pShader->GetBufferSize(), DiagStream);
+      return ValidateDxilContainer(pShader->GetBufferPointer(), pShader->GetBufferSize(), DiagStream, pFunctionCache);
     }
   }
 
@@ -196,11 +209,11 @@ HRESULT DxcValidator::RunValidation(
   PrintDiagnosticContext DiagContext(DiagPrinter);
   DiagRestore DR(pModule->getContext(), &DiagContext);
 
-  IFR(hlsl::ValidateDxilModule(pModule, pDebugModule));
+  IFR(hlsl::ValidateDxilModule(pModule, pDebugModule, pFunctionCache, pPhases));
   if (!(Flags & DxcValidatorFlags_ModuleOnly)) {
     IFR(ValidateDxilContainerParts(pModule, pDebugModule,
                       IsDxilContainerLike(pShader->GetBufferPointer(), pShader->GetBufferSize()),
-                      (uint32_t)pShader->GetBufferSize()));
+                      (uint32_t)pShader->GetBufferSize(), pTrustedParts));
   }
 
   if (DiagContext.HasErrors() || DiagContext.HasWarnings()) {
@@ -225,11 +238,10 @@ HRESULT DxcValidator::RunRootSignatureValidation(
   const DxilPartHeader *pRSPart = GetDxilPartByType(pDxilContainer, DFCC_RootSignature);
   IFRBOOL(pPSVPart && pRSPart, DXC_E_MISSING_PART);
   try {
-    RootSignatureHandle RSH;
-    RSH.LoadSerialized((const uint8_t*)GetDxilPartData(pRSPart), pRSPart->PartSize);
-    RSH.Deserialize();
+    SharedRootSignatureDesc pDesc = RootSignatureCache::Deserialize(
+        GetDxilPartData(pRSPart), pRSPart->PartSize);
     raw_stream_ostream DiagStream(pDiagStream);
-    IFRBOOL(VerifyRootSignatureWithShaderPSV(RSH.GetDesc(),
+    IFRBOOL(VerifyRootSignatureWithShaderPSV(pDesc.get(),
                                              GetVersionShaderType(pProgramHeader->ProgramVersion),
                                              GetDxilPartData(pPSVPart),
                                              pPSVPart->PartSize,
@@ -248,7 +260,9 @@ HRESULT RunInternalValidator(_In_ IDxcValidator *pValidator,
                              _In_ llvm::Module *pModule,
                              _In_ llvm::Module *pDebugModule,
                              _In_ IDxcBlob *pShader, UINT32 Flags,
-                             _COM_Outptr_ IDxcOperationResult **ppResult) {
+                             _COM_Outptr_ IDxcOperationResult **ppResult,
+                             _In_opt_ hlsl::CompilePhaseListener *pPhases,
+                             _In_opt_ const hlsl::DxilPartDigests *pTrustedParts) {
   DXASSERT_NOMSG(pValidator != nullptr);
   DXASSERT_NOMSG(pModule != nullptr);
   DXASSERT_NOMSG(pShader != nullptr);
@@ -256,7 +270,8 @@ HRESULT RunInternalValidator(_In_ IDxcValidator *pValidator,
 
   DxcValidator *pInternalValidator = (DxcValidator *)pValidator;
   return pInternalValidator->ValidateWithOptModules(pShader, Flags, pModule,
-                                                    pDebugModule, ppResult);
+                                                    pDebugModule, ppResult,
+                                                    pPhases, pTrustedParts);
 }
 
 HRESULT CreateDxcValidator(_In_ REFIID riid, _Out_ LPVOID* ppv) {
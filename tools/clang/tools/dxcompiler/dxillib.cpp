@@ -12,6 +12,8 @@
 #include "dxillib.h"
 #include "dxc/Support/Global.h" // For DXASSERT
 #include "dxc/Support/dxcapi.use.h"
+#include "dxc/dxcapi.h"
+#include <atomic>
 
 using namespace dxc;
 
@@ -19,6 +21,25 @@ static DxcDllSupport g_DllSupport;
 static HRESULT g_DllLibResult = S_OK;
 static CRITICAL_SECTION cs;
 
+// Whether dxil.dll is used is decided on first use and never changes after
+// that, so once resolved it can be checked without taking the lock.
+enum DllLibState { DllLibUnresolved, DllLibEnabled, DllLibDisabled };
+static std::atomic<int> g_DllLibState(DllLibUnresolved);
+
+// Validators from dxil.dll kept for reuse, so that compiles don't each pay
+// for instantiating one. The pool only grows to the number of concurrent
+// compiles, up to its capacity.
+static IDxcValidator *g_ValidatorPool[16];
+static unsigned g_ValidatorPoolSize = 0;
+
+static void ReleaseValidatorPool() {
+  for (unsigned i = 0; i < g_ValidatorPoolSize; ++i) {
+    g_ValidatorPool[i]->Release();
+    g_ValidatorPool[i] = nullptr;
+  }
+  g_ValidatorPoolSize = 0;
+}
+
 // Check if we can successfully get IDxcValidator from dxil.dll
 // This function is to prevent multiple attempts to load dxil.dll 
 HRESULT DxilLibInitialize() {
@@ -29,9 +50,14 @@ HRESULT DxilLibInitialize() {
 HRESULT DxilLibCleanup(DxilLibCleanUpType type) {
   HRESULT hr = S_OK;
   if (type == DxilLibCleanUpType::ProcessTermination) {
+    // dxil.dll may already be gone; the pooled validators are abandoned.
+    g_ValidatorPoolSize = 0;
+    g_DllLibState = DllLibUnresolved;
     g_DllSupport.Detach();
   }
   else if (type == DxilLibCleanUpType::UnloadLibrary) {
+    ReleaseValidatorPool();
+    g_DllLibState = DllLibUnresolved;
     g_DllSupport.Cleanup();
   }
   else {
@@ -45,12 +71,18 @@ HRESULT DxilLibCleanup(DxilLibCleanUpType type) {
 // If we fail to load dxil.dll, set g_DllLibResult to E_FAIL so that we don't
 // have multiple attempts to load dxil.dll
 bool DxilLibIsEnabled() {
+  int state = g_DllLibState.load(std::memory_order_acquire);
+  if (state != DllLibUnresolved)
+    return state == DllLibEnabled;
+
   EnterCriticalSection(&cs);
   if (SUCCEEDED(g_DllLibResult)) {
     if (!g_DllSupport.IsEnabled()) {
       g_DllLibResult = g_DllSupport.InitializeForDll(L"dxil.dll", "DxcCreateInstance");
     }
   }
+  g_DllLibState.store(SUCCEEDED(g_DllLibResult) ? DllLibEnabled : DllLibDisabled,
+                      std::memory_order_release);
   LeaveCriticalSection(&cs);
   return SUCCEEDED(g_DllLibResult);
 }
@@ -59,10 +91,38 @@ bool DxilLibIsEnabled() {
 HRESULT DxilLibCreateInstance(_In_ REFCLSID rclsid, _In_ REFIID riid, _In_ IUnknown **ppInterface) {
   DXASSERT_NOMSG(ppInterface != nullptr);
   HRESULT hr = E_FAIL;
+  // The entry point doesn't change once dxil.dll is loaded, so objects are
+  // created without holding the lock.
   if (DxilLibIsEnabled()) {
-    EnterCriticalSection(&cs);
     hr = g_DllSupport.CreateInstance(rclsid, riid, ppInterface);
-    LeaveCriticalSection(&cs);
   }
   return hr;
-}
\ No newline at end of file
+}
+
+HRESULT DxilLibAcquireValidator(_COM_Outptr_ IDxcValidator **ppValidator) {
+  DXASSERT_NOMSG(ppValidator != nullptr);
+  *ppValidator = nullptr;
+  if (!DxilLibIsEnabled())
+    return E_FAIL;
+  EnterCriticalSection(&cs);
+  if (g_ValidatorPoolSize > 0) {
+    *ppValidator = g_ValidatorPool[--g_ValidatorPoolSize];
+    g_ValidatorPool[g_ValidatorPoolSize] = nullptr;
+    LeaveCriticalSection(&cs);
+    return S_OK;
+  }
+  LeaveCriticalSection(&cs);
+  return DxilLibCreateInstance(CLSID_DxcValidator, ppValidator);
+}
+
+void DxilLibReleaseValidator(_In_ IDxcValidator *pValidator) {
+  DXASSERT_NOMSG(pValidator != nullptr);
+  EnterCriticalSection(&cs);
+  if (g_ValidatorPoolSize < _countof(g_ValidatorPool)) {
+    g_ValidatorPool[g_ValidatorPoolSize++] = pValidator;
+    pValidator = nullptr;
+  }
+  LeaveCriticalSection(&cs);
+  if (pValidator != nullptr)
+    pValidator->Release();
+}
@@ -15,6 +15,8 @@
 
 #include "dxc/Support/WinIncludes.h"
 
+struct IDxcValidator;
+
 
 // Initialize Dxil library. 
 HRESULT DxilLibInitialize();
@@ -39,4 +41,12 @@ HRESULT DxilLibCreateInstance(_In_ REFCLSID rclsid, _In_ TInterface **ppInterfac
   return DxilLibCreateInstance(rclsid, __uuidof(TInterface), (IUnknown**) ppInterface);
 }
 
+// Gets a validator from dxil.dll, reusing one returned by an earlier compile
+// when available. Each validator is used by a single compile at a time.
+HRESULT DxilLibAcquireValidator(_COM_Outptr_ IDxcValidator **ppValidator);
+
+// Returns a validator obtained from DxilLibAcquireValidator for reuse. Takes
+// ownership of the caller's reference.
+void DxilLibReleaseValidator(_In_ IDxcValidator *pValidator);
+
 #endif // __DXC_DXILLIB__
\ No newline at end of file
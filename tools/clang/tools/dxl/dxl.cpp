@@ -21,6 +21,7 @@
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support//MSFileSystem.h"
 #include "llvm/Support/FileSystem.h"
+#include <algorithm>
 #include <dia2.h>
 #include <intsafe.h>
 
@@ -47,6 +48,19 @@ static cl::opt<std::string> OutputFilename("Fo",
                                            cl::desc("Override output filename"),
                                            cl::value_desc("filename"));
 
+static cl::opt<std::string>
+    ManifestFilename("manifest",
+                     cl::desc("Link every entry listed in the given file"),
+                     cl::value_desc("filename"), cl::init(""));
+
+// A manifest has one job per line: an entry name, a target profile and an
+// optional output file name (the entry name plus .dxbc by default), separated
+// by spaces or tabs. Blank lines and lines starting with # are ignored.
+//
+// The libraries are read and registered once, and all the jobs go to a single
+// IDxcLinker2::LinkBatch call, which links the libraries once and assembles
+// the entries in parallel.
+
 
 class DxlContext {
 
@@ -57,41 +71,41 @@ private:
     return m_dxcSupport.CreateInstance(clsid, pResult);
   }
 
+  std::vector<std::wstring> m_libNames;
+  std::vector<LPCWSTR> m_pLibNames;
+
+  void RegisterLibraries(IDxcLinker *pLinker);
+  HRESULT WriteResult(IDxcOperationResult *pLinkResult, StringRef entry,
+                      StringRef output);
+
 public:
   DxlContext(DxcDllSupport &dxcSupport) : m_dxcSupport(dxcSupport) {}
 
   int Link();
+  int LinkManifest();
 };
 
-int DxlContext::Link() {
-  std::string entry = EntryName;
-  std::string profile = TargetProfile;
-
-  CComPtr<IDxcLinker> pLinker;
-  IFT(CreateInstance(CLSID_DxcLinker, &pLinker));
-
+void DxlContext::RegisterLibraries(IDxcLinker *pLinker) {
   StringRef InputFilesRef(InputFiles);
   SmallVector<StringRef, 2> InputFileList;
   InputFilesRef.split(InputFileList, ";");
 
-  std::vector<std::wstring> wInputFiles;
-  wInputFiles.reserve(InputFileList.size());
-  std::vector<LPCWSTR> wpInputFiles;
-  wpInputFiles.reserve(InputFileList.size());
+  m_libNames.clear();
+  m_libNames.reserve(InputFileList.size());
+  m_pLibNames.clear();
+  m_pLibNames.reserve(InputFileList.size());
   for (auto &file : InputFileList) {
-    wInputFiles.emplace_back(StringRefUtf16(file.str()));
-    wpInputFiles.emplace_back(wInputFiles.back().c_str());
+    m_libNames.emplace_back(StringRefUtf16(file.str()));
+    m_pLibNames.emplace_back(m_libNames.back().c_str());
     CComPtr<IDxcBlobEncoding> pLib;
-    ReadFileIntoBlob(m_dxcSupport, wInputFiles.back().c_str(), &pLib);
-    IFT(pLinker->RegisterLibrary(wInputFiles.back().c_str(), pLib));
+    ReadFileIntoBlob(m_dxcSupport, m_libNames.back().c_str(), &pLib);
+    IFT(pLinker->RegisterLibrary(m_libNames.back().c_str(), pLib));
   }
+}
 
-  CComPtr<IDxcOperationResult> pLinkResult;
-
-  IFT(pLinker->Link(StringRefUtf16(entry), StringRefUtf16(profile),
-                wpInputFiles.data(), wpInputFiles.size(), nullptr, 0,
-                &pLinkResult));
-
+// Writes the linked container to output, or prints why entry failed to link.
+HRESULT DxlContext::WriteResult(IDxcOperationResult *pLinkResult,
+                                StringRef entry, StringRef output) {
   HRESULT status;
   IFT(pLinkResult->GetStatus(&status));
   if (SUCCEEDED(status)) {
@@ -99,22 +113,113 @@ int DxlContext::Link() {
     IFT(pLinkResult->GetResult(&pContainer));
     if (pContainer.p != nullptr) {
       // Infer the output filename if needed.
-      if (OutputFilename.empty()) {
-        OutputFilename = EntryName + ".dxbc";
-      }
-      WriteBlobToFile(pContainer, StringRefUtf16(OutputFilename));
+      std::string outputName =
+          output.empty() ? entry.str() + ".dxbc" : output.str();
+      WriteBlobToFile(pContainer, StringRefUtf16(outputName));
     }
   } else {
     CComPtr<IDxcBlobEncoding> pErrors;
     IFT(pLinkResult->GetErrorBuffer(&pErrors));
     if (pErrors != nullptr) {
-      printf("Link failed:\n%s",
+      printf("Link failed for %s:\n%s", entry.str().c_str(),
              static_cast<char *>(pErrors->GetBufferPointer()));
     }
   }
   return status;
 }
 
+int DxlContext::Link() {
+  std::string entry = EntryName;
+  std::string profile = TargetProfile;
+
+  CComPtr<IDxcLinker> pLinker;
+  IFT(CreateInstance(CLSID_DxcLinker, &pLinker));
+  RegisterLibraries(pLinker);
+
+  CComPtr<IDxcOperationResult> pLinkResult;
+
+  IFT(pLinker->Link(StringRefUtf16(entry), StringRefUtf16(profile),
+                m_pLibNames.data(), m_pLibNames.size(), nullptr, 0,
+                &pLinkResult));
+
+  return WriteResult(pLinkResult, entry, OutputFilename);
+}
+
+int DxlContext::LinkManifest() {
+  struct LinkJob {
+    std::string Entry, Profile, Output;
+    std::wstring EntryW, ProfileW;
+  };
+
+  CComPtr<IDxcBlobEncoding> pManifest;
+  ReadFileIntoBlob(m_dxcSupport, StringRefUtf16(ManifestFilename), &pManifest);
+  StringRef Text((const char *)pManifest->GetBufferPointer(),
+                 pManifest->GetBufferSize());
+  SmallVector<StringRef, 64> Lines;
+  Text.split(Lines, "\n", -1, false);
+
+  std::vector<LinkJob> jobs;
+  for (StringRef Line : Lines) {
+    Line = Line.trim();
+    if (Line.empty() || Line.startswith("#"))
+      continue;
+    std::string Spaced = Line;
+    std::replace(Spaced.begin(), Spaced.end(), '\t', ' ');
+    SmallVector<StringRef, 3> Parts;
+    StringRef(Spaced).split(Parts, " ", -1, false);
+    if (Parts.size() < 2 || Parts.size() > 3) {
+      IFTMSG(E_INVALIDARG, "Manifest line '" + Line.str() +
+                               "' is not: entry profile [output]");
+    }
+    LinkJob job;
+    job.Entry = Parts[0];
+    job.Profile = Parts[1];
+    if (Parts.size() == 3)
+      job.Output = Parts[2];
+    job.EntryW = StringRefUtf16(job.Entry);
+    job.ProfileW = StringRefUtf16(job.Profile);
+    jobs.emplace_back(std::move(job));
+  }
+  if (jobs.empty())
+    return 0;
+
+  CComPtr<IDxcLinker> pLinker;
+  IFT(CreateInstance(CLSID_DxcLinker, &pLinker));
+  RegisterLibraries(pLinker);
+
+  std::vector<CComPtr<IDxcOperationResult>> results(jobs.size());
+  CComPtr<IDxcLinker2> pLinker2;
+  if (SUCCEEDED(pLinker.QueryInterface(&pLinker2))) {
+    std::vector<LPCWSTR> pEntries, pProfiles;
+    for (LinkJob &job : jobs) {
+      pEntries.emplace_back(job.EntryW.c_str());
+      pProfiles.emplace_back(job.ProfileW.c_str());
+    }
+    std::vector<IDxcOperationResult *> pResults(jobs.size(), nullptr);
+    IFT(pLinker2->LinkBatch(pEntries.data(), pProfiles.data(), jobs.size(),
+                            m_pLibNames.data(), m_pLibNames.size(), nullptr,
+                            0, pResults.data()));
+    for (unsigned i = 0; i < jobs.size(); ++i)
+      results[i].Attach(pResults[i]);
+  } else {
+    // An older dxcompiler still reuses the registered libraries.
+    for (unsigned i = 0; i < jobs.size(); ++i) {
+      IFT(pLinker->Link(jobs[i].EntryW.c_str(), jobs[i].ProfileW.c_str(),
+                        m_pLibNames.data(), m_pLibNames.size(), nullptr, 0,
+                        &results[i]));
+    }
+  }
+
+  unsigned failed = 0;
+  for (unsigned i = 0; i < jobs.size(); ++i) {
+    if (FAILED(WriteResult(results[i], jobs[i].Entry, jobs[i].Output)))
+      ++failed;
+  }
+  printf("%u entries linked, %u failed.\n", (unsigned)jobs.size() - failed,
+         failed);
+  return failed ? 1 : 0;
+}
+
 using namespace hlsl::options;
 
 int __cdecl main(int argc, _In_reads_z_(argc) char **argv) {
@@ -147,7 +252,7 @@ int __cdecl main(int argc, _In_reads_z_(argc) char **argv) {
     DxlContext context(dxcSupport);
 
     pStage = "Linking";
-    retVal = context.Link();
+    retVal = ManifestFilename.empty() ? context.Link() : context.LinkManifest();
   } catch (const ::hlsl::Exception &hlslException) {
     try {
       const char *msg = hlslException.what();
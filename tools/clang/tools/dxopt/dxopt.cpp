@@ -204,6 +204,12 @@ static void PrintHelp() {
     L"  IN-FILE        File with with bitcode to optimize\n"
     L"  OPT-ARGUMENTS  One or more passes to run in sequence\n"
     L"\n"
+    L"Optimizer arguments may also include:\n"
+    L"  -preset:NAME[@VERSION]  Runs the passes of a named pipeline: fast-iteration, ship or size\n"
+    L"  -time-passes            Writes the time and instruction count change of each pass\n"
+    L"  -opt-lazy[:FUNCTION]    Reads only the bodies of the entry points, or of the given\n"
+    L"                          functions, and of what they call; passes skip the others\n"
+    L"\n"
     L"Text that is traced during optimization is written to the standard output.\n"
   );
 }
@@ -17,77 +17,257 @@
 #include "dxc/dxcapi.internal.h"
 #include "dxc/Support/dxcapi.use.h"
 #include "dxc/Support/HLSLOptions.h"
+#include "dxc/HLSL/DxilContainer.h"
 
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MSFileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
 
 using namespace dxc;
 using namespace llvm;
 using namespace llvm::opt;
 using namespace hlsl::options;
 
+static cl::list<std::string>
+InputFilenames(cl::Positional,
+               cl::desc("<input dxil files, directories or patterns>"),
+               cl::ZeroOrMore);
+
 static cl::opt<std::string>
-InputFilename(cl::Positional, cl::desc("<input dxil file>"), cl::init("-"));
+ListFilename("list", cl::desc("Also validate the files named in the given file, one per line"),
+             cl::value_desc("filename"), cl::init(""));
+
+static cl::opt<unsigned>
+Jobs("j", cl::desc("Number of files validated at once (default: one per core)"),
+     cl::value_desc("count"), cl::init(0));
+
+static cl::opt<std::string>
+ReportFilename("report", cl::desc("Write the status and time of each file to the given file"),
+               cl::value_desc("filename"), cl::init(""));
+
+// Overview:
+//
+// With a single input file, dxv validates it and prints the result, as it
+// always has. Any other input - several files, a directory (searched
+// recursively), a file name with * or ? wildcards, or a -list file - runs in
+// batch mode: the files are shared out to -j worker threads, each of which
+// creates its validator once and keeps it for every file it takes, so the
+// cost of a run is validation rather than process and DLL startup.
+//
+// Batch mode prints each failing file with its first error, then a summary.
+// -report writes a tab-separated table with one row per file:
+//
+//   file	status	ms	error
+//
+// Inputs may be DXIL containers or modules; modules are assembled into a
+// container first.
+
+namespace {
+// Objects a thread reuses for every file it validates.
+class DxvWorker {
+private:
+  CComPtr<IDxcLibrary> m_pLibrary;
+  CComPtr<IDxcAssembler> m_pAssembler;
+  CComPtr<IDxcValidator> m_pValidator;
+public:
+  DxvWorker(DxcDllSupport &dxcSupport) {
+    IFT(dxcSupport.CreateInstance(CLSID_DxcLibrary, &m_pLibrary));
+    IFT(dxcSupport.CreateInstance(CLSID_DxcAssembler, &m_pAssembler));
+    IFT(dxcSupport.CreateInstance(CLSID_DxcValidator, &m_pValidator));
+  }
+
+  // Returns the validation status, with the messages in Errors on failure.
+  HRESULT ValidateFile(LPCWSTR pFileName, std::string &Errors);
+};
 
 class DxvContext {
 private:
   DxcDllSupport &m_dxcSupport;
+  std::atomic<unsigned> m_nextFile;
+
+  struct FileResult {
+    HRESULT Status = E_FAIL;
+    double DurationMs = 0;
+    std::string Errors;
+  };
+
+  void RunWorker(ArrayRef<std::string> Paths,
+                 std::vector<FileResult> &Results);
 public:
   DxvContext(DxcDllSupport &dxcSupport)
       : m_dxcSupport(dxcSupport) {}
 
-  void Validate();
+  void Validate(StringRef InputFilename);
+  int ValidateBatch(ArrayRef<std::string> Paths, unsigned ThreadCount,
+                    raw_ostream *pReport);
 };
+}
 
-void DxvContext::Validate() {
-  CComPtr<IDxcOperationResult> pCompileResult;
+static std::string GetErrorText(IDxcOperationResult *pResult) {
+  CComPtr<IDxcBlobEncoding> text;
+  IFT(pResult->GetErrorBuffer(&text));
+  if (!text || text->GetBufferSize() == 0)
+    return std::string();
+  const char *pStart = (const char *)text->GetBufferPointer();
+  return std::string(pStart, strnlen(pStart, text->GetBufferSize()));
+}
 
-  {
-    CComPtr<IDxcBlobEncoding> pSource;
-    ReadFileIntoBlob(m_dxcSupport, StringRefUtf16(InputFilename), &pSource);
+HRESULT DxvWorker::ValidateFile(LPCWSTR pFileName, std::string &Errors) {
+  CComPtr<IDxcBlobEncoding> pSource;
+  IFT_Data(m_pLibrary->CreateBlobFromFile(pFileName, nullptr, &pSource),
+           pFileName);
 
-    CComPtr<IDxcAssembler> pAssembler;
+  CComPtr<IDxcBlob> pContainerBlob;
+  HRESULT resultStatus;
+  const uint32_t *pMagic = (const uint32_t *)pSource->GetBufferPointer();
+  if (pSource->GetBufferSize() >= sizeof(uint32_t) &&
+      *pMagic == hlsl::DFCC_Container) {
+    pContainerBlob = pSource;
+  } else {
     CComPtr<IDxcOperationResult> pAsmResult;
-
-    CComPtr<IDxcBlob> pContainerBlob;
-    HRESULT resultStatus;
-
-    IFT(m_dxcSupport.CreateInstance(CLSID_DxcAssembler, &pAssembler));
-    IFT(pAssembler->AssembleToContainer(pSource, &pAsmResult));
+    IFT(m_pAssembler->AssembleToContainer(pSource, &pAsmResult));
     IFT(pAsmResult->GetStatus(&resultStatus));
     if (FAILED(resultStatus)) {
-      CComPtr<IDxcBlobEncoding> text;
-      IFT(pAsmResult->GetErrorBuffer(&text));
-      const char *pStart = (const char *)text->GetBufferPointer();
-      std::string msg(pStart);
-      IFTMSG(resultStatus, msg);
-      return;
+      Errors = GetErrorText(pAsmResult);
+      return resultStatus;
     }
     IFT(pAsmResult->GetResult(&pContainerBlob));
+  }
+
+  CComPtr<IDxcOperationResult> pResult;
+  IFT(m_pValidator->Validate(pContainerBlob, DxcValidatorFlags_InPlaceEdit, &pResult));
+
+  HRESULT status;
+  IFT(pResult->GetStatus(&status));
+  if (FAILED(status))
+    Errors = GetErrorText(pResult);
+  return status;
+}
 
-    CComPtr<IDxcValidator> pValidator;
-    CComPtr<IDxcOperationResult> pResult;
+void DxvContext::Validate(StringRef InputFilename) {
+  DxvWorker worker(m_dxcSupport);
+  std::string msg;
+  HRESULT status = worker.ValidateFile(StringRefUtf16(InputFilename), msg);
+  if (FAILED(status)) {
+    IFTMSG(status, msg);
+  } else {
+    printf("Validation succeed.");
+  }
+}
 
-    IFT(m_dxcSupport.CreateInstance(CLSID_DxcValidator, &pValidator));
-    IFT(pValidator->Validate(pContainerBlob, DxcValidatorFlags_InPlaceEdit, &pResult));
+// Claims unstarted files until none are left, so that a slow file only
+// delays the worker validating it.
+void DxvContext::RunWorker(ArrayRef<std::string> Paths,
+                           std::vector<FileResult> &Results) {
+  std::unique_ptr<DxvWorker> pWorker;
+  for (;;) {
+    unsigned i = m_nextFile++;
+    if (i >= Paths.size())
+      break;
+    FileResult &Result = Results[i];
+    auto t_start = std::chrono::high_resolution_clock::now();
+    // Nothing may escape the thread; a file that throws just fails.
+    try {
+      if (!pWorker)
+        pWorker.reset(new DxvWorker(m_dxcSupport));
+      std::wstring pathW = Unicode::UTF8ToUTF16StringOrThrow(Paths[i].c_str());
+      Result.Status = pWorker->ValidateFile(pathW.c_str(), Result.Errors);
+    } catch (const ::hlsl::Exception &hlslException) {
+      Result.Status = hlslException.hr;
+      Result.Errors = hlslException.msg;
+    } catch (std::bad_alloc &) {
+      Result.Status = E_OUTOFMEMORY;
+      Result.Errors = "out of memory";
+    } catch (...) {
+      Result.Status = E_FAIL;
+      Result.Errors = "unknown error";
+    }
+    auto t_end = std::chrono::high_resolution_clock::now();
+    Result.DurationMs =
+        std::chrono::duration<double, std::milli>(t_end - t_start).count();
+  }
+}
 
-    HRESULT status;
-    IFT(pResult->GetStatus(&status));
+static StringRef FirstLine(StringRef Text) {
+  Text = Text.ltrim();
+  return Text.substr(0, Text.find_first_of("\r\n"));
+}
 
-    if (FAILED(status)) {
-      CComPtr<IDxcBlobEncoding> text;
-      IFT(pResult->GetErrorBuffer(&text));
-      const char *pStart = (const char *)text->GetBufferPointer();
-      std::string msg(pStart);
-      IFTMSG(status, msg);
-    } else {
-      printf("Validation succeed.");
+int DxvContext::ValidateBatch(ArrayRef<std::string> Paths,
+                              unsigned ThreadCount, raw_ostream *pReport) {
+  std::vector<FileResult> Results(Paths.size());
+  m_nextFile = 0;
+  auto t_start = std::chrono::high_resolution_clock::now();
+  ThreadCount = std::max<unsigned>(
+      1, std::min<unsigned>(ThreadCount, Paths.size()));
+  if (ThreadCount > 1) {
+    std::vector<std::thread> threads;
+    threads.reserve(ThreadCount);
+    for (unsigned i = 0; i < ThreadCount; i++)
+      threads.emplace_back(&DxvContext::RunWorker, this, Paths,
+                           std::ref(Results));
+    for (auto &th : threads)
+      th.join();
+  } else {
+    RunWorker(Paths, Results);
+  }
+  auto t_end = std::chrono::high_resolution_clock::now();
+  double durationMs =
+      std::chrono::duration<double, std::milli>(t_end - t_start).count();
+
+  unsigned failed = 0;
+  double totalMs = 0;
+  if (pReport)
+    *pReport << "file\tstatus\tms\terror\n";
+  for (unsigned i = 0; i < Paths.size(); i++) {
+    const FileResult &Result = Results[i];
+    bool bFailed = FAILED(Result.Status);
+    StringRef Error = FirstLine(Result.Errors);
+    totalMs += Result.DurationMs;
+    if (bFailed) {
+      ++failed;
+      if (Error.empty())
+        printf("%s: error code 0x%08x\n", Paths[i].c_str(),
+               (unsigned)Result.Status);
+      else
+        printf("%s: %s\n", Paths[i].c_str(), Error.str().c_str());
+    }
+    if (pReport) {
+      *pReport << Paths[i] << '\t' << (bFailed ? "failed" : "ok") << '\t'
+               << format("%.2f", Result.DurationMs) << '\t' << Error << '\n';
     }
   }
+  printf("%u files, %u failed, %.2f ms validating in %.2f ms on %u threads\n",
+         (unsigned)Paths.size(), failed, totalMs, durationMs, ThreadCount);
+  return failed ? 1 : 0;
 }
 
 int __cdecl main(int argc,  _In_reads_z_(argc) const char **argv) {
   const char *pStage = "Operation";
+  int retVal = 0;
+  if (FAILED(DxcInitThreadMalloc())) return 1;
+  DxcSetThreadMallocOrDefault(nullptr);
   try {
+    llvm::sys::fs::MSFileSystem *msfPtr;
+    IFT(CreateMSFileSystemForDisk(&msfPtr));
+    std::unique_ptr<::llvm::sys::fs::MSFileSystem> msf(msfPtr);
+
+    ::llvm::sys::fs::AutoPerThreadSystem pts(msf.get());
+    IFTLLVM(pts.error_code());
+
     pStage = "Argument processing";
 
     // Parse command line options.
@@ -97,8 +277,32 @@ int __cdecl main(int argc,  _In_reads_z_(argc) const char **argv) {
     dxc::EnsureEnabled(dxcSupport);
 
     DxvContext context(dxcSupport);
-    pStage = "Validation";
-    context.Validate();
+    if (InputFilenames.empty() && ListFilename.empty())
+      InputFilenames.push_back("-");
+
+    std::vector<std::string> Paths;
+    for (const std::string &Input : InputFilenames)
+      ExpandInputPath(Input, Paths);
+    if (!ListFilename.empty())
+      ReadInputPathList(dxcSupport, StringRefUtf16(ListFilename), Paths);
+
+    bool bBatch = !ListFilename.empty() || !ReportFilename.empty() ||
+                  Paths.size() != 1 || InputFilenames.size() != 1 ||
+                  Paths[0] != InputFilenames[0];
+    if (!bBatch) {
+      pStage = "Validation";
+      context.Validate(InputFilenames[0]);
+    } else {
+      std::unique_ptr<raw_fd_ostream> pReport;
+      if (!ReportFilename.empty()) {
+        std::error_code EC;
+        pReport.reset(new raw_fd_ostream(ReportFilename, EC, sys::fs::F_Text));
+        IFTLLVM(EC);
+      }
+      unsigned ThreadCount = Jobs ? Jobs : std::thread::hardware_concurrency();
+      pStage = "Validation";
+      retVal = context.ValidateBatch(Paths, ThreadCount, pReport.get());
+    }
   } catch (const ::hlsl::Exception &hlslException) {
     try {
       const char *msg = hlslException.what();
@@ -124,5 +328,5 @@ int __cdecl main(int argc,  _In_reads_z_(argc) const char **argv) {
     return 1;
   }
 
-  return 0;
+  return retVal;
 }
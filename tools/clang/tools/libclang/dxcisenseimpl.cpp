@@ -25,6 +25,7 @@
 #include "clang/Frontend/ASTUnit.h"
 #include "llvm/Support/Host.h"
 #include "clang/Sema/SemaHLSL.h"
+#include "CXTranslationUnit.h"
 
 #include "dxc/Support/WinIncludes.h"
 #include "dxc/Support/Global.h"
@@ -32,6 +33,11 @@
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/MSFileSystem.h"
 
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
 ///////////////////////////////////////////////////////////////////////////////
 
 HRESULT CreateDxcIntelliSense(_In_ REFIID riid, _Out_ LPVOID* ppv) throw()
@@ -856,6 +862,88 @@ HRESULT DxcCursor::GetSnappedChild(IDxcSourceLocation* location, IDxcCursor** pR
   return S_OK;
 }
 
+static DxcCursorValue ToCursorValue(const CXCursor &cursor)
+{
+  DxcCursorValue value;
+  value.kind = (DxcCursorKind)cursor.kind;
+  value.xdata = cursor.xdata;
+  value.data[0] = cursor.data[0];
+  value.data[1] = cursor.data[1];
+  value.data[2] = cursor.data[2];
+  return value;
+}
+
+static CXCursor FromCursorValue(const DxcCursorValue &value)
+{
+  CXCursor cursor;
+  cursor.kind = (CXCursorKind)value.kind;
+  cursor.xdata = value.xdata;
+  cursor.data[0] = value.data[0];
+  cursor.data[1] = value.data[1];
+  cursor.data[2] = value.data[2];
+  return cursor;
+}
+
+struct ValueCursorVisitorContext
+{
+  DxcCursorVisitor visitor;
+  void *context;
+};
+
+static
+CXChildVisitResult LIBCLANG_CC ValueCursorVisit(CXCursor cursor, CXCursor parent, CXClientData client_data)
+{
+  ValueCursorVisitorContext* valueContext = (ValueCursorVisitorContext*)client_data;
+  DxcCursorValue cursorValue = ToCursorValue(cursor);
+  DxcCursorValue parentValue = ToCursorValue(parent);
+  return (CXChildVisitResult)valueContext->visitor(&cursorValue, &parentValue,
+                                                   valueContext->context);
+}
+
+_Use_decl_annotations_
+HRESULT DxcCursor::GetValue(DxcCursorValue* pValue)
+{
+  if (pValue == nullptr) return E_POINTER;
+  *pValue = ToCursorValue(m_cursor);
+  return S_OK;
+}
+
+_Use_decl_annotations_
+HRESULT DxcCursor::VisitChildren(DxcCursorVisitor visitor, void* context, BOOL* pVisitBroken)
+{
+  if (visitor == nullptr) return E_POINTER;
+  ValueCursorVisitorContext visitorContext = { visitor, context };
+  unsigned broken = clang_visitChildren(m_cursor, ValueCursorVisit, &visitorContext);
+  if (pVisitBroken != nullptr)
+  {
+    *pVisitBroken = broken != 0;
+  }
+  return S_OK;
+}
+
+_Use_decl_annotations_
+HRESULT DxcCursor::CreateCursor(const DxcCursorValue* value, IDxcCursor** pResult)
+{
+  if (value == nullptr) return E_POINTER;
+  DxcThreadMalloc TM(m_pMalloc);
+  return DxcCursor::Create(FromCursorValue(*value), pResult);
+}
+
+_Use_decl_annotations_
+HRESULT DxcCursor::GetValueExtentOffsets(const DxcCursorValue* value, unsigned* startOffset, unsigned* endOffset)
+{
+  if (value == nullptr) return E_POINTER;
+  if (startOffset == nullptr) return E_POINTER;
+  if (endOffset == nullptr) return E_POINTER;
+
+  CXSourceRange range = clang_getCursorExtent(FromCursorValue(*value));
+  CXFile file;
+  unsigned line, col;
+  clang_getSpellingLocation(clang_getRangeStart(range), &file, &line, &col, startOffset);
+  clang_getSpellingLocation(clang_getRangeEnd(range), &file, &line, &col, endOffset);
+  return S_OK;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 
 DxcDiagnostic::DxcDiagnostic() : m_diagnostic(nullptr)
@@ -1026,6 +1114,99 @@ HRESULT DxcFile::IsEqualTo(IDxcFile* other, BOOL* pResult)
 
 ///////////////////////////////////////////////////////////////////////////////
 
+DxcCompletionResults::DxcCompletionResults()
+{
+  m_pMalloc = DxcGetThreadMallocNoRef();
+}
+
+DxcCompletionResults::~DxcCompletionResults()
+{
+}
+
+_Use_decl_annotations_
+HRESULT DxcCompletionResults::Create(std::shared_ptr<const EntryList> entries, IDxcCompletionResults** pResult)
+{
+  if (pResult == nullptr) return E_POINTER;
+  *pResult = nullptr;
+
+  CComPtr<DxcCompletionResults> local;
+  local = new (std::nothrow)DxcCompletionResults();
+  if (local == nullptr) return E_OUTOFMEMORY;
+  try
+  {
+    local->m_indices.resize(entries->size());
+    for (unsigned i = 0; i < local->m_indices.size(); ++i)
+      local->m_indices[i] = i;
+  }
+  catch (const std::bad_alloc&)
+  {
+    return E_OUTOFMEMORY;
+  }
+  local->m_entries = std::move(entries);
+  *pResult = local.Detach();
+  return S_OK;
+}
+
+_Use_decl_annotations_
+HRESULT DxcCompletionResults::GetCount(unsigned* pCount)
+{
+  if (pCount == nullptr) return E_POINTER;
+  *pCount = m_indices.size();
+  return S_OK;
+}
+
+_Use_decl_annotations_
+HRESULT DxcCompletionResults::GetResult(unsigned index, LPSTR* pText, DxcCompletionKind* pKind)
+{
+  if (pText == nullptr || pKind == nullptr) return E_POINTER;
+  *pText = nullptr;
+  if (index >= m_indices.size()) return E_INVALIDARG;
+  const Entry &entry = (*m_entries)[m_indices[index]];
+  *pText = (char*)CoTaskMemAlloc(entry.Text.size() + 1);
+  if (*pText == nullptr) return E_OUTOFMEMORY;
+  memcpy(*pText, entry.Text.c_str(), entry.Text.size() + 1);
+  *pKind = entry.Kind;
+  return S_OK;
+}
+
+_Use_decl_annotations_
+HRESULT DxcCompletionResults::Filter(const char* prefix, IDxcCompletionResults** pResult)
+{
+  if (prefix == nullptr) return E_INVALIDARG;
+  if (pResult == nullptr) return E_POINTER;
+  *pResult = nullptr;
+
+  DxcThreadMalloc TM(m_pMalloc);
+  CComPtr<DxcCompletionResults> local;
+  local = new (std::nothrow)DxcCompletionResults();
+  if (local == nullptr) return E_OUTOFMEMORY;
+  try
+  {
+    // The names that start with prefix ignoring case sort together, right
+    // where prefix itself would go.
+    llvm::StringRef prefixRef(prefix);
+    const EntryList &entries = *m_entries;
+    auto first = std::lower_bound(m_indices.begin(), m_indices.end(), prefixRef,
+      [&entries](unsigned index, llvm::StringRef value) {
+        return llvm::StringRef(entries[index].Text).compare_lower(value) < 0;
+      });
+    auto last = first;
+    while (last != m_indices.end() &&
+           llvm::StringRef(entries[*last].Text).startswith_lower(prefixRef))
+      ++last;
+    local->m_indices.assign(first, last);
+  }
+  catch (const std::bad_alloc&)
+  {
+    return E_OUTOFMEMORY;
+  }
+  local->m_entries = m_entries;
+  *pResult = local.Detach();
+  return S_OK;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
 DxcInclusion::DxcInclusion()
     : m_file(nullptr), m_locationLength(0), m_locations(nullptr) {
   m_pMalloc = DxcGetThreadMallocNoRef();
@@ -1085,6 +1266,233 @@ HRESULT DxcInclusion::GetStackItem(unsigned index, _Outptr_result_nullonfailure_
 
 ///////////////////////////////////////////////////////////////////////////////
 
+// Parses a translation unit on a background thread. The arguments and the
+// unsaved files are copied up front, so the caller's buffers may go away as
+// soon as the operation has been started. clang offers no way to interrupt a
+// parse in progress, so cancellation is cooperative: a parse that has not
+// started, including one waiting for another parse on the same index, is
+// skipped, and the result of one that is running is discarded when it
+// finishes; waiters are released right away in both cases.
+//
+// The worker thread holds a reference on the module that contains this code,
+// which it drops as it exits, so the library is not unloaded while a parse
+// is outstanding even if the caller has released everything.
+class DxcParseOperation : public IDxcParseOperation
+{
+private:
+  DXC_MICROCOM_TM_REF_FIELDS()
+  CComPtr<DxcIndex> m_pIndex;
+  std::string m_sourceFileName;
+  std::vector<std::string> m_args;
+  std::vector<CComPtr<IDxcUnsavedFile> > m_unsavedFiles;
+  DxcTranslationUnitFlags m_options;
+  std::mutex m_mutex;
+  std::condition_variable m_finished;
+  DxcParseStatus m_status;
+  HRESULT m_hr;
+  CComPtr<IDxcTranslationUnit> m_pTU;
+  HMODULE m_hModule;
+
+  bool IsFinished() const { return m_status >= DxcParseStatus_Completed; }
+  void Run() throw();
+  static DWORD WINAPI ThreadProc(LPVOID pParam);
+public:
+  DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void** ppvObject)
+  {
+    return DoBasicQueryInterface<IDxcParseOperation>(this, iid, ppvObject);
+  }
+
+  DxcParseOperation();
+  HRESULT Initialize(_In_ DxcIndex *pIndex,
+    _In_z_ const char *source_filename,
+    _In_count_(num_command_line_args) const char * const *command_line_args,
+    int num_command_line_args,
+    _In_count_(num_unsaved_files) IDxcUnsavedFile** unsaved_files,
+    unsigned num_unsaved_files,
+    DxcTranslationUnitFlags options);
+  void Start();
+
+  __override HRESULT STDMETHODCALLTYPE Wait(unsigned timeoutMs);
+  __override HRESULT STDMETHODCALLTYPE Cancel();
+  __override HRESULT STDMETHODCALLTYPE GetStatus(_Out_ DxcParseStatus* pStatus);
+  __override HRESULT STDMETHODCALLTYPE GetResult(_Outptr_result_nullonfailure_ IDxcTranslationUnit** pTranslationUnit);
+};
+
+DxcParseOperation::DxcParseOperation()
+    : m_options(DxcTranslationUnitFlags_None),
+      m_status(DxcParseStatus_Queued), m_hr(E_PENDING), m_hModule(nullptr)
+{
+  m_pMalloc = DxcGetThreadMallocNoRef();
+}
+
+_Use_decl_annotations_
+HRESULT DxcParseOperation::Initialize(
+  DxcIndex *pIndex,
+  const char *source_filename,
+  const char * const *command_line_args,
+  int num_command_line_args,
+  IDxcUnsavedFile** unsaved_files,
+  unsigned num_unsaved_files,
+  DxcTranslationUnitFlags options)
+{
+  CXUnsavedFile* files;
+  HRESULT hr = SetupUnsavedFiles(unsaved_files, num_unsaved_files, &files);
+  if (FAILED(hr)) return hr;
+
+  try
+  {
+    m_pIndex = pIndex;
+    if (source_filename != nullptr)
+      m_sourceFileName = source_filename;
+    m_args.assign(command_line_args,
+                  command_line_args + num_command_line_args);
+    m_options = options;
+    m_unsavedFiles.resize(num_unsaved_files);
+    for (unsigned i = 0; i < num_unsaved_files && SUCCEEDED(hr); ++i)
+    {
+      hr = DxcBasicUnsavedFile::Create(files[i].Filename, files[i].Contents,
+                                       files[i].Length, &m_unsavedFiles[i]);
+    }
+  }
+  CATCH_CPP_ASSIGN_HRESULT();
+
+  CleanupUnsavedFiles(files, num_unsaved_files);
+  return hr;
+}
+
+void DxcParseOperation::Start()
+{
+  if (GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS,
+                         reinterpret_cast<LPCWSTR>(&ThreadProc),
+                         &m_hModule))
+  {
+    // The worker keeps the operation (and through it, the index) alive until
+    // the parse is done, even if the caller releases it first.
+    AddRef();
+    HANDLE hThread = CreateThread(nullptr, 0, &ThreadProc, this, 0, nullptr);
+    if (hThread != nullptr)
+    {
+      CloseHandle(hThread);
+      return;
+    }
+    Release();
+    FreeLibrary(m_hModule);
+    m_hModule = nullptr;
+  }
+  // No thread could be started; parse on the calling thread instead.
+  Run();
+}
+
+DWORD WINAPI DxcParseOperation::ThreadProc(LPVOID pParam)
+{
+  DxcParseOperation *pSelf = reinterpret_cast<DxcParseOperation *>(pParam);
+  HMODULE hModule = pSelf->m_hModule;
+  {
+    DxcThreadMalloc WorkerTM(pSelf->m_pMalloc);
+    pSelf->Run();
+  }
+  pSelf->Release();
+  FreeLibraryAndExitThread(hModule, 0);
+}
+
+void DxcParseOperation::Run() throw()
+{
+  CComPtr<IDxcTranslationUnit> pTU;
+  HRESULT hr = S_OK;
+  try
+  {
+    // Wait for the index before leaving the queue, so a parse held up by
+    // another one on the same index can still be skipped.
+    std::lock_guard<std::mutex> parseLock(m_pIndex->GetParseMutex());
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (m_status != DxcParseStatus_Queued)
+        return;
+      m_status = DxcParseStatus_Parsing;
+    }
+
+    std::vector<const char *> args;
+    args.reserve(m_args.size());
+    for (const std::string &arg : m_args)
+      args.push_back(arg.c_str());
+    std::vector<IDxcUnsavedFile *> files;
+    files.reserve(m_unsavedFiles.size());
+    for (IDxcUnsavedFile *pFile : m_unsavedFiles)
+      files.push_back(pFile);
+
+    hr = m_pIndex->ParseTranslationUnitLocked(
+        m_sourceFileName.c_str(), args.empty() ? nullptr : args.data(),
+        (int)args.size(), files.empty() ? nullptr : files.data(),
+        (unsigned)files.size(), m_options, &pTU);
+  }
+  CATCH_CPP_ASSIGN_HRESULT();
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    // A cancelled parse keeps its status; its result is dropped below. A
+    // parse still queued here could not wait for the index.
+    if (m_status == DxcParseStatus_Parsing ||
+        m_status == DxcParseStatus_Queued)
+    {
+      m_status = SUCCEEDED(hr) ? DxcParseStatus_Completed
+                               : DxcParseStatus_Failed;
+      m_hr = hr;
+      m_pTU = pTU;
+    }
+  }
+  m_finished.notify_all();
+}
+
+HRESULT DxcParseOperation::Wait(unsigned timeoutMs)
+{
+  try
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto finished = [this]() { return IsFinished(); };
+    if (timeoutMs == INFINITE)
+    {
+      m_finished.wait(lock, finished);
+      return S_OK;
+    }
+    return m_finished.wait_for(lock, std::chrono::milliseconds(timeoutMs),
+                               finished) ? S_OK : S_FALSE;
+  }
+  CATCH_CPP_RETURN_HRESULT();
+}
+
+HRESULT DxcParseOperation::Cancel()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (IsFinished())
+      return S_FALSE;
+    m_status = DxcParseStatus_Cancelled;
+    m_hr = E_ABORT;
+  }
+  m_finished.notify_all();
+  return S_OK;
+}
+
+HRESULT DxcParseOperation::GetStatus(DxcParseStatus* pStatus)
+{
+  if (pStatus == nullptr) return E_POINTER;
+  std::lock_guard<std::mutex> lock(m_mutex);
+  *pStatus = m_status;
+  return S_OK;
+}
+
+HRESULT DxcParseOperation::GetResult(IDxcTranslationUnit** pTranslationUnit)
+{
+  if (pTranslationUnit == nullptr) return E_POINTER;
+  *pTranslationUnit = nullptr;
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (FAILED(m_hr)) return m_hr;
+  return m_pTU.CopyTo(pTranslationUnit);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
 DxcIndex::DxcIndex() : m_index(0), m_options(DxcGlobalOpt_None)
 {
   m_pMalloc = DxcGetThreadMallocNoRef();
@@ -1153,6 +1561,27 @@ HRESULT DxcIndex::ParseTranslationUnit(
   unsigned num_unsaved_files,
   DxcTranslationUnitFlags options,
   IDxcTranslationUnit** pTranslationUnit)
+{
+  try
+  {
+    std::lock_guard<std::mutex> lock(m_parseMutex);
+    return ParseTranslationUnitLocked(source_filename, command_line_args,
+                                      num_command_line_args, unsaved_files,
+                                      num_unsaved_files, options,
+                                      pTranslationUnit);
+  }
+  CATCH_CPP_RETURN_HRESULT();
+}
+
+_Use_decl_annotations_
+HRESULT DxcIndex::ParseTranslationUnitLocked(
+  const char *source_filename,
+  const char * const *command_line_args,
+  int num_command_line_args,
+  IDxcUnsavedFile** unsaved_files,
+  unsigned num_unsaved_files,
+  DxcTranslationUnitFlags options,
+  IDxcTranslationUnit** pTranslationUnit)
 {
   if (pTranslationUnit == nullptr) return E_POINTER;
   *pTranslationUnit = nullptr;
@@ -1177,19 +1606,21 @@ HRESULT DxcIndex::ParseTranslationUnit(
     CXTranslationUnit tu = clang_parseTranslationUnit(m_index, source_filename,
       command_line_args, num_command_line_args,
       files, num_unsaved_files, options);
-    CleanupUnsavedFiles(files, num_unsaved_files);
     if (tu == nullptr)
     {
+      CleanupUnsavedFiles(files, num_unsaved_files);
       return E_FAIL;
     }
 
     CComPtr<DxcTranslationUnit> localTU = new (std::nothrow) DxcTranslationUnit();
     if (localTU == nullptr)
     {
+      CleanupUnsavedFiles(files, num_unsaved_files);
       clang_disposeTranslationUnit(tu);
       return E_OUTOFMEMORY;
     }
-    localTU->Initialize(tu);
+    localTU->Initialize(tu, files, num_unsaved_files);
+    CleanupUnsavedFiles(files, num_unsaved_files);
     *pTranslationUnit = localTU.Detach();
 
     return S_OK;
@@ -1197,6 +1628,33 @@ HRESULT DxcIndex::ParseTranslationUnit(
   CATCH_CPP_RETURN_HRESULT();
 }
 
+HRESULT DxcIndex::ParseTranslationUnitAsync(
+  const char *source_filename,
+  const char * const *command_line_args,
+  int num_command_line_args,
+  IDxcUnsavedFile** unsaved_files,
+  unsigned num_unsaved_files,
+  DxcTranslationUnitFlags options,
+  IDxcParseOperation** pOperation)
+{
+  if (pOperation == nullptr) return E_POINTER;
+  *pOperation = nullptr;
+
+  if (m_index == 0) return E_FAIL;
+
+  DxcThreadMalloc TM(m_pMalloc);
+
+  CComPtr<DxcParseOperation> op = new (std::nothrow) DxcParseOperation();
+  if (op == nullptr) return E_OUTOFMEMORY;
+  HRESULT hr = op->Initialize(this, source_filename, command_line_args,
+                              num_command_line_args, unsaved_files,
+                              num_unsaved_files, options);
+  if (FAILED(hr)) return hr;
+  op->Start();
+  *pOperation = op.Detach();
+  return S_OK;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 
 DxcIntelliSense::DxcIntelliSense(IMalloc *pMalloc)
@@ -1486,7 +1944,8 @@ HRESULT DxcToken::GetSpelling(LPSTR* pValue)
 
 ///////////////////////////////////////////////////////////////////////////////
 
-DxcTranslationUnit::DxcTranslationUnit() : m_tu(nullptr)
+DxcTranslationUnit::DxcTranslationUnit()
+    : m_tu(nullptr), m_parsedUnsavedFilesValid(false)
 {
   m_pMalloc = DxcGetThreadMallocNoRef();
 }
@@ -1508,9 +1967,80 @@ DxcTranslationUnit::~DxcTranslationUnit() {
   }
 }
 
-void DxcTranslationUnit::Initialize(CXTranslationUnit tu)
+void DxcTranslationUnit::Initialize(CXTranslationUnit tu,
+  const CXUnsavedFile* unsaved_files, unsigned num_unsaved_files)
 {
   m_tu = tu;
+  RecordParsedFiles(unsaved_files, num_unsaved_files);
+}
+
+void DxcTranslationUnit::RecordParsedFiles(
+  const CXUnsavedFile* unsaved_files, unsigned num_unsaved_files)
+{
+  m_parsedUnsavedFilesValid = false;
+  m_parsedUnsavedFiles.clear();
+  m_parsedUnsavedFiles.reserve(num_unsaved_files);
+  for (unsigned i = 0; i < num_unsaved_files; ++i)
+  {
+    m_parsedUnsavedFiles.emplace_back(unsaved_files[i].Filename,
+      std::string(unsaved_files[i].Contents, unsaved_files[i].Length));
+  }
+  m_parsedUnsavedFilesValid = true;
+}
+
+bool DxcTranslationUnit::IsUpToDate(
+  const CXUnsavedFile* unsaved_files, unsigned num_unsaved_files)
+{
+  if (!m_parsedUnsavedFilesValid || m_parsedUnsavedFiles.size() != num_unsaved_files)
+    return false;
+  for (unsigned i = 0; i < num_unsaved_files; ++i)
+  {
+    const auto &parsed = m_parsedUnsavedFiles[i];
+    if (parsed.first != unsaved_files[i].Filename ||
+        llvm::StringRef(parsed.second) !=
+          llvm::StringRef(unsaved_files[i].Contents, unsaved_files[i].Length))
+      return false;
+  }
+
+  // Every other file was read from disk; compare it with what is there now.
+  const clang::SourceManager &SM = clang::cxtu::getASTUnit(m_tu)->getSourceManager();
+  for (auto it = SM.fileinfo_begin(), end = SM.fileinfo_end(); it != end; ++it)
+  {
+    const clang::FileEntry *entry = it->first;
+    llvm::StringRef name = entry->getName();
+    bool isUnsaved = false;
+    for (const auto &parsed : m_parsedUnsavedFiles)
+    {
+      if (parsed.first == name)
+      {
+        isUnsaved = true;
+        break;
+      }
+    }
+    if (isUnsaved)
+      continue;
+
+    llvm::sys::fs::file_status status;
+    if (llvm::sys::fs::status(name, status) ||
+        status.getSize() != (uint64_t)entry->getSize() ||
+        status.getLastModificationTime().toEpochTime() != entry->getModificationTime())
+      return false;
+  }
+
+  // A file that was looked for and missing may exist now: an include that
+  // didn't resolve, or a header that would now shadow the one found later on
+  // the include path. The last parse had its own file manager, so these are
+  // exactly the paths it probed.
+  llvm::SmallVector<llvm::StringRef, 16> missing;
+  clang::cxtu::getASTUnit(m_tu)->getFileManager().getMissingFilePaths(missing);
+  for (llvm::StringRef name : missing)
+  {
+    llvm::sys::fs::file_status status;
+    if (!llvm::sys::fs::status(name, status) &&
+        status.type() != llvm::sys::fs::file_type::directory_file)
+      return false;
+  }
+  return true;
 }
 
 _Use_decl_annotations_
@@ -1642,9 +2172,32 @@ HRESULT DxcTranslationUnit::Reparse(
   DxcThreadMalloc TM(m_pMalloc);
   hr = SetupUnsavedFiles(unsaved_files, num_unsaved_files, &local_unsaved_files);
   if (FAILED(hr)) return hr;
-  int reparseResult = clang_reparseTranslationUnit(
-    m_tu, num_unsaved_files, local_unsaved_files, clang_defaultReparseOptions(m_tu));
+
+  // HLSL has no precompiled preamble support (see HLSLChanges.rst), so a
+  // reparse always starts over from the top of the main file. Editors often
+  // ask for one when nothing changed, though, and then the current parse is
+  // already the result.
+  int reparseResult = 0;
+  try
+  {
+    ::llvm::sys::fs::MSFileSystem* msfPtr;
+    IFT(CreateMSFileSystemForDisk(&msfPtr));
+    std::auto_ptr<::llvm::sys::fs::MSFileSystem> msf(msfPtr);
+
+    ::llvm::sys::fs::AutoPerThreadSystem pts(msf.get());
+    IFTLLVM(pts.error_code());
+    if (!IsUpToDate(local_unsaved_files, num_unsaved_files))
+    {
+      m_parsedUnsavedFilesValid = false;
+      reparseResult = clang_reparseTranslationUnit(
+        m_tu, num_unsaved_files, local_unsaved_files, clang_defaultReparseOptions(m_tu));
+      if (reparseResult == 0)
+        RecordParsedFiles(local_unsaved_files, num_unsaved_files);
+    }
+  }
+  CATCH_CPP_ASSIGN_HRESULT();
   CleanupUnsavedFiles(local_unsaved_files, num_unsaved_files);
+  if (FAILED(hr)) return hr;
   return reparseResult == 0 ? S_OK : E_FAIL;
 }
 
@@ -1817,6 +2370,90 @@ HRESULT DxcTranslationUnit::GetInclusionList(unsigned *pResultCount,
   return S_OK;
 }
 
+_Use_decl_annotations_
+HRESULT DxcTranslationUnit::CodeCompleteAt(
+  unsigned line, unsigned column,
+  IDxcUnsavedFile** unsaved_files,
+  unsigned num_unsaved_files,
+  const char* prefix,
+  IDxcCompletionResults** pResult)
+{
+  if (pResult == nullptr) return E_POINTER;
+  *pResult = nullptr;
+
+  HRESULT hr;
+  CXUnsavedFile* local_unsaved_files;
+  DxcThreadMalloc TM(m_pMalloc);
+  hr = SetupUnsavedFiles(unsaved_files, num_unsaved_files, &local_unsaved_files);
+  if (FAILED(hr)) return hr;
+
+  CComPtr<IDxcCompletionResults> results;
+  try
+  {
+    ::llvm::sys::fs::MSFileSystem* msfPtr;
+    IFT(CreateMSFileSystemForDisk(&msfPtr));
+    std::auto_ptr<::llvm::sys::fs::MSFileSystem> msf(msfPtr);
+
+    ::llvm::sys::fs::AutoPerThreadSystem pts(msf.get());
+    IFTLLVM(pts.error_code());
+
+    // The built-in names go first, so that they are kept over the
+    // declarations made for the ones the source has used.
+    std::shared_ptr<DxcCompletionResults::EntryList> entries =
+      std::make_shared<DxcCompletionResults::EntryList>();
+    for (const hlsl::GlobalCompletionName &name : hlsl::GetGlobalCompletionNames())
+    {
+      entries->push_back({ name.Name, name.IsObjectType
+        ? DxcCompletionKind_ObjectType : DxcCompletionKind_Intrinsic });
+    }
+
+    CXString fileName = clang_getTranslationUnitSpelling(m_tu);
+    std::unique_ptr<CXCodeCompleteResults, void (*)(CXCodeCompleteResults*)> completion(
+      clang_codeCompleteAt(m_tu, clang_getCString(fileName), line, column,
+        local_unsaved_files, num_unsaved_files, clang_defaultCodeCompleteOptions()),
+      clang_disposeCodeCompleteResults);
+    clang_disposeString(fileName);
+    if (completion == nullptr) throw ::hlsl::Exception(E_FAIL);
+    for (unsigned i = 0; i < completion->NumResults; ++i)
+    {
+      CXCompletionString str = completion->Results[i].CompletionString;
+      unsigned chunkCount = clang_getNumCompletionChunks(str);
+      for (unsigned chunk = 0; chunk < chunkCount; ++chunk)
+      {
+        if (clang_getCompletionChunkKind(str, chunk) != CXCompletionChunk_TypedText)
+          continue;
+        CXString text = clang_getCompletionChunkText(str, chunk);
+        const char* textPtr = clang_getCString(text);
+        if (textPtr != nullptr)
+          entries->push_back({ textPtr, DxcCompletionKind_Declaration });
+        clang_disposeString(text);
+        break;
+      }
+    }
+
+    std::stable_sort(entries->begin(), entries->end(),
+      [](const DxcCompletionResults::Entry& left, const DxcCompletionResults::Entry& right) {
+        int order = llvm::StringRef(left.Text).compare_lower(right.Text);
+        return order != 0 ? order < 0 : left.Text < right.Text;
+      });
+    entries->erase(std::unique(entries->begin(), entries->end(),
+      [](const DxcCompletionResults::Entry& left, const DxcCompletionResults::Entry& right) {
+        return left.Text == right.Text;
+      }), entries->end());
+    IFT(DxcCompletionResults::Create(std::move(entries), &results));
+  }
+  CATCH_CPP_ASSIGN_HRESULT();
+  CleanupUnsavedFiles(local_unsaved_files, num_unsaved_files);
+  if (FAILED(hr)) return hr;
+
+  if (prefix == nullptr || *prefix == '\0')
+  {
+    *pResult = results.Detach();
+    return S_OK;
+  }
+  return results->Filter(prefix, pResult);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 
 DxcType::DxcType()
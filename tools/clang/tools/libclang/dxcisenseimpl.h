@@ -12,6 +12,12 @@
 #ifndef __DXC_ISENSEIMPL__
 #define __DXC_ISENSEIMPL__
 
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
 #include "clang-c/Index.h"
 #include "dxc/dxcisense.h"
 #include "dxc/dxcapi.internal.h"
@@ -19,6 +25,7 @@
 #include "dxc/Support/DxcLangExtensionsHelper.h"
 
 // Forward declarations.
+class DxcCompletionResults;
 class DxcCursor;
 class DxcDiagnostic;
 class DxcFile;
@@ -30,7 +37,41 @@ class DxcTranslationUnit;
 class DxcToken;
 struct IMalloc;
 
-class DxcCursor : public IDxcCursor
+// Completion candidates shared by a result and the results filtered from it;
+// each holds the indices of the candidates it shows.
+class DxcCompletionResults : public IDxcCompletionResults
+{
+public:
+  struct Entry {
+    std::string Text;
+    DxcCompletionKind Kind;
+  };
+  typedef std::vector<Entry> EntryList;
+
+private:
+  DXC_MICROCOM_TM_REF_FIELDS()
+  // Sorted by text ignoring case, then by text.
+  std::shared_ptr<const EntryList> m_entries;
+  std::vector<unsigned> m_indices;
+public:
+  DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void** ppvObject)
+  {
+    return DoBasicQueryInterface<IDxcCompletionResults>(this, iid, ppvObject);
+  }
+
+  DxcCompletionResults();
+  ~DxcCompletionResults();
+  static HRESULT Create(std::shared_ptr<const EntryList> entries, _COM_Outptr_ IDxcCompletionResults** pResult);
+
+  __override HRESULT STDMETHODCALLTYPE GetCount(_Out_ unsigned* pCount);
+  __override HRESULT STDMETHODCALLTYPE GetResult(unsigned index,
+    _Outptr_result_z_ LPSTR* pText, _Out_ DxcCompletionKind* pKind);
+  __override HRESULT STDMETHODCALLTYPE Filter(_In_z_ const char* prefix,
+    _Outptr_result_nullonfailure_ IDxcCompletionResults** pResult);
+};
+
+class DxcCursor : public IDxcCursor2
 {
 private:
   DXC_MICROCOM_TM_REF_FIELDS()
@@ -39,7 +80,7 @@ public:
   DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
   HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void** ppvObject)
   {
-    return DoBasicQueryInterface<IDxcCursor>(this, iid, ppvObject);
+    return DoBasicQueryInterface<IDxcCursor, IDxcCursor2>(this, iid, ppvObject);
   }
 
   DxcCursor();
@@ -77,6 +118,14 @@ public:
     _Out_ unsigned* pResultLength, _Outptr_result_buffer_maybenull_(*pResultLength) IDxcCursor*** pResult);
   /// <summary>Gets the cursor following a location within a compound cursor.</summary>
   __override HRESULT STDMETHODCALLTYPE GetSnappedChild(_In_ IDxcSourceLocation* location, _Outptr_result_maybenull_ IDxcCursor** pResult);
+
+  __override HRESULT STDMETHODCALLTYPE GetValue(_Out_ DxcCursorValue* pValue);
+  __override HRESULT STDMETHODCALLTYPE VisitChildren(
+    _In_ DxcCursorVisitor visitor, _In_opt_ void* context, _Out_opt_ BOOL* pVisitBroken);
+  __override HRESULT STDMETHODCALLTYPE CreateCursor(
+    _In_ const DxcCursorValue* value, _Outptr_result_nullonfailure_ IDxcCursor** pResult);
+  __override HRESULT STDMETHODCALLTYPE GetValueExtentOffsets(
+    _In_ const DxcCursorValue* value, _Out_ unsigned* startOffset, _Out_ unsigned* endOffset);
 };
 
 class DxcDiagnostic : public IDxcDiagnostic
@@ -157,18 +206,21 @@ public:
   __override HRESULT STDMETHODCALLTYPE GetStackItem(unsigned index, _Outptr_result_nullonfailure_ IDxcSourceLocation **pResult);
 };
 
-class DxcIndex : public IDxcIndex
+class DxcIndex : public IDxcIndex2
 {
 private:
     DXC_MICROCOM_TM_REF_FIELDS()
     CXIndex m_index;
     DxcGlobalOptions m_options;
     hlsl::DxcLangExtensionsHelper m_langHelper;
+    // Parses on the index run one at a time, whether they were started
+    // synchronously or in the background.
+    std::mutex m_parseMutex;
 public:
     DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
     HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void** ppvObject)
     {
-      return DoBasicQueryInterface<IDxcIndex>(this, iid, ppvObject);
+      return DoBasicQueryInterface<IDxcIndex, IDxcIndex2>(this, iid, ppvObject);
     }
 
     DxcIndex();
@@ -186,6 +238,24 @@ public:
       unsigned num_unsaved_files,
       DxcTranslationUnitFlags options,
       _Outptr_result_nullonfailure_ IDxcTranslationUnit** pTranslationUnit);
+    // Same as ParseTranslationUnit, for callers that hold GetParseMutex().
+    HRESULT ParseTranslationUnitLocked(
+      _In_z_ const char *source_filename,
+      _In_count_(num_command_line_args) const char * const *command_line_args,
+      int num_command_line_args,
+      _In_count_(num_unsaved_files) IDxcUnsavedFile** unsaved_files,
+      unsigned num_unsaved_files,
+      DxcTranslationUnitFlags options,
+      _Outptr_result_nullonfailure_ IDxcTranslationUnit** pTranslationUnit);
+    std::mutex &GetParseMutex() { return m_parseMutex; }
+    __override HRESULT STDMETHODCALLTYPE ParseTranslationUnitAsync(
+      _In_z_ const char *source_filename,
+      _In_count_(num_command_line_args) const char * const *command_line_args,
+      int num_command_line_args,
+      _In_count_(num_unsaved_files) IDxcUnsavedFile** unsaved_files,
+      unsigned num_unsaved_files,
+      DxcTranslationUnitFlags options,
+      _Outptr_result_nullonfailure_ IDxcParseOperation** pOperation);
 };
 
 class DxcIntelliSense : public IDxcIntelliSense, public IDxcLangExtensions {
@@ -294,21 +364,38 @@ public:
   __override HRESULT STDMETHODCALLTYPE GetSpelling(_Outptr_result_maybenull_ LPSTR* pValue);
 };
 
-class DxcTranslationUnit : public IDxcTranslationUnit
+class DxcTranslationUnit : public IDxcTranslationUnit2
 {
 private:
     DXC_MICROCOM_TM_REF_FIELDS()
     CXTranslationUnit m_tu;
+    // Names and contents of the unsaved files of the last successful parse.
+    std::vector<std::pair<std::string, std::string> > m_parsedUnsavedFiles;
+    // Whether m_parsedUnsavedFiles describes the current parse.
+    bool m_parsedUnsavedFilesValid;
+
+    void RecordParsedFiles(
+      _In_count_(num_unsaved_files) const CXUnsavedFile* unsaved_files,
+      unsigned num_unsaved_files);
+    // Returns true if parsing with the given unsaved files would see the same
+    // sources as the last parse: the unsaved files are identical, no other
+    // file the translation unit read has changed on disk, and no file it
+    // looked for and missed has appeared since.
+    bool IsUpToDate(
+      _In_count_(num_unsaved_files) const CXUnsavedFile* unsaved_files,
+      unsigned num_unsaved_files);
 public:
     DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
     HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void** ppvObject)
     {
-      return DoBasicQueryInterface<IDxcTranslationUnit>(this, iid, ppvObject);
+      return DoBasicQueryInterface<IDxcTranslationUnit, IDxcTranslationUnit2>(this, iid, ppvObject);
     }
 
     DxcTranslationUnit();
     ~DxcTranslationUnit();
-    void Initialize(CXTranslationUnit tu);
+    void Initialize(CXTranslationUnit tu,
+      _In_count_(num_unsaved_files) const CXUnsavedFile* unsaved_files,
+      unsigned num_unsaved_files);
 
     __override HRESULT STDMETHODCALLTYPE GetCursor(_Outptr_ IDxcCursor** pCursor);
     __override HRESULT STDMETHODCALLTYPE Tokenize(
@@ -338,6 +425,12 @@ public:
       _Out_ unsigned* errorLength,
       _Out_ BSTR* errorMessage);
     __override HRESULT STDMETHODCALLTYPE GetInclusionList(_Out_ unsigned* pResultCount, _Outptr_result_buffer_(*pResultCount) IDxcInclusion*** pResult);
+    __override HRESULT STDMETHODCALLTYPE CodeCompleteAt(
+      unsigned line, unsigned column,
+      _In_count_(num_unsaved_files) IDxcUnsavedFile** unsaved_files,
+      unsigned num_unsaved_files,
+      _In_opt_z_ const char* prefix,
+      _Outptr_result_nullonfailure_ IDxcCompletionResults** pResult);
 };
 
 class DxcType : public IDxcType
@@ -25,6 +25,9 @@
 #include "clang/Sema/SemaConsumer.h"
 #include "clang/Frontend/ASTUnit.h"
 #include "clang/Frontend/TextDiagnosticPrinter.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringSet.h"
 #include "llvm/Support/Host.h"
 #include "clang/Sema/SemaHLSL.h"
 
@@ -62,39 +65,123 @@ public:
   }
 };
 
-class VarReferenceVisitor : public RecursiveASTVisitor<VarReferenceVisitor> {
+// The functions and variables that a function refers to directly.
+struct DeclReferences {
+  SmallVector<FunctionDecl*, 8> Functions;
+  SmallVector<VarDecl*, 8> Vars;
+};
+
+class DeclReferenceVisitor : public RecursiveASTVisitor<DeclReferenceVisitor> {
 private:
-  SmallPtrSet<VarDecl*, 128>& m_unusedGlobals;
-  SmallPtrSet<FunctionDecl*, 128>& m_visitedFunctions;
-  SmallVector<FunctionDecl*, 32>& m_pendingFunctions;
+  DeclReferences& m_references;
 public:
-  VarReferenceVisitor(
-    SmallPtrSet<VarDecl*, 128>& unusedGlobals,
-    SmallPtrSet<FunctionDecl*, 128>& visitedFunctions,
-    SmallVector<FunctionDecl*, 32>& pendingFunctions) :
-    m_unusedGlobals(unusedGlobals),
-    m_visitedFunctions(visitedFunctions),
-    m_pendingFunctions(pendingFunctions) {
+  DeclReferenceVisitor(DeclReferences& references) :
+    m_references(references) {
   }
 
   bool VisitDeclRefExpr(DeclRefExpr* ref) {
     ValueDecl* valueDecl = ref->getDecl();
     FunctionDecl* fnDecl = dyn_cast_or_null<FunctionDecl>(valueDecl);
     if (fnDecl != nullptr) {
-      if (!m_visitedFunctions.count(fnDecl)) {
-        m_pendingFunctions.push_back(fnDecl);
-      }
+      m_references.Functions.push_back(fnDecl);
     }
     else {
       VarDecl* varDecl = dyn_cast_or_null<VarDecl>(valueDecl);
       if (varDecl != nullptr) {
-        m_unusedGlobals.erase(varDecl);
+        m_references.Vars.push_back(varDecl);
       }
     }
     return true;
   }
 };
 
+// Finds the globals and functions of a translation unit that entry points
+// reach over its call graph. Each function body is traversed at most once,
+// however many entry points reach it, and what an entry point reaches is a
+// bit per global and per function, so entry points can be combined.
+class ReachabilityAnalysis {
+private:
+  // Global variables that are not in cbuffers, and functions with bodies,
+  // by their canonical declarations.
+  SmallVector<VarDecl*, 128> m_globals;
+  SmallVector<FunctionDecl*, 128> m_functions;
+  DenseMap<VarDecl*, unsigned> m_globalIndices;
+  DenseMap<FunctionDecl*, unsigned> m_functionIndices;
+  DenseMap<FunctionDecl*, DeclReferences> m_references;
+
+  const DeclReferences &GetReferences(FunctionDecl *fnDecl) {
+    auto it = m_references.find(fnDecl);
+    if (it != m_references.end())
+      return it->second;
+    DeclReferences &references = m_references[fnDecl];
+    FunctionDecl *definition;
+    if (fnDecl->hasBody(definition)) {
+      DeclReferenceVisitor visitor(references);
+      visitor.TraverseDecl(definition);
+    }
+    return references;
+  }
+
+public:
+  ReachabilityAnalysis(TranslationUnitDecl *tu) {
+    for (Decl *tuDecl : tu->decls()) {
+      if (VarDecl* varDecl = dyn_cast<VarDecl>(tuDecl)) {
+        varDecl = varDecl->getCanonicalDecl();
+        if (m_globalIndices.insert(std::make_pair(varDecl, m_globals.size())).second)
+          m_globals.push_back(varDecl);
+        continue;
+      }
+      if (FunctionDecl* fnDecl = dyn_cast<FunctionDecl>(tuDecl)) {
+        if (fnDecl->hasBody()) {
+          fnDecl = fnDecl->getCanonicalDecl();
+          if (m_functionIndices.insert(std::make_pair(fnDecl, m_functions.size())).second)
+            m_functions.push_back(fnDecl);
+        }
+      }
+    }
+  }
+
+  unsigned GetGlobalCount() const { return m_globals.size(); }
+  unsigned GetFunctionCount() const { return m_functions.size(); }
+
+  // Returns the bit of the global or function in the sets filled by Reach,
+  // or -1 if it is not a candidate for removal.
+  int GetIndex(Decl *D) const {
+    if (VarDecl *varDecl = dyn_cast<VarDecl>(D)) {
+      auto it = m_globalIndices.find(varDecl->getCanonicalDecl());
+      return it == m_globalIndices.end() ? -1 : (int)it->second;
+    }
+    if (FunctionDecl *fnDecl = dyn_cast<FunctionDecl>(D)) {
+      auto it = m_functionIndices.find(fnDecl->getCanonicalDecl());
+      return it == m_functionIndices.end() ? -1 : (int)it->second;
+    }
+    return -1;
+  }
+
+  // Sets the bits of the globals and functions that the entry point reaches.
+  void Reach(FunctionDecl *entry, BitVector &globals, BitVector &functions) {
+    SmallPtrSet<FunctionDecl*, 128> visitedFunctions;
+    SmallVector<FunctionDecl*, 32> pendingFunctions;
+    pendingFunctions.push_back(entry->getCanonicalDecl());
+    while (!pendingFunctions.empty()) {
+      FunctionDecl *fnDecl = pendingFunctions.pop_back_val();
+      if (!visitedFunctions.insert(fnDecl).second)
+        continue;
+      auto fnIt = m_functionIndices.find(fnDecl);
+      if (fnIt != m_functionIndices.end())
+        functions.set(fnIt->second);
+      const DeclReferences &references = GetReferences(fnDecl);
+      for (VarDecl *varDecl : references.Vars) {
+        auto varIt = m_globalIndices.find(varDecl->getCanonicalDecl());
+        if (varIt != m_globalIndices.end())
+          globals.set(varIt->second);
+      }
+      for (FunctionDecl *callee : references.Functions)
+        pendingFunctions.push_back(callee->getCanonicalDecl());
+    }
+  }
+};
+
 static void raw_string_ostream_to_CoString(raw_string_ostream &o, _Outptr_result_z_ LPSTR *pResult) {
   std::string& s = o.str(); // .str() will flush automatically
   *pResult = (LPSTR)CoTaskMemAlloc(s.size() + 1);
@@ -150,10 +237,41 @@ void SetupCompilerForRewrite(CompilerInstance &compiler,
     compiler.getSourceManager().createFileID(mainFileEntry, SourceLocation(), SrcMgr::C_User));
 }
 
-static bool IsMacroMatch(StringRef name, const std::string &mask) {
-  return Unicode::IsStarMatchUTF8(mask.c_str(), mask.size(), name.data(),
-                                  name.size());
-}
+// Matches macro names against a list of masks, with the semantics of
+// Unicode::IsStarMatchUTF8: a mask ending in '*' matches the names it is a
+// prefix of, any other mask only matches itself. The masks are indexed once
+// so that matching a name costs a lookup per prefix of the name rather than
+// a comparison per mask.
+class MacroNameMatcher {
+public:
+  explicit MacroNameMatcher(const llvm::SmallVectorImpl<std::string> &masks) {
+    for (const std::string &mask : masks) {
+      StringRef m(mask);
+      if (!m.empty() && m.back() == '*')
+        m_prefixes.insert(m.drop_back());
+      else
+        m_names.insert(m);
+    }
+  }
+
+  bool IsMatch(StringRef name) const {
+    if (name.empty())
+      return false;
+    if (m_names.count(name))
+      return true;
+    if (m_prefixes.empty())
+      return false;
+    for (size_t len = 0; len <= name.size(); ++len) {
+      if (m_prefixes.count(name.substr(0, len)))
+        return true;
+    }
+    return false;
+  }
+
+private:
+  llvm::StringSet<> m_names;
+  llvm::StringSet<> m_prefixes;
+};
 
 static
 bool MacroPairCompareIsLessThan(const std::pair<const IdentifierInfo*, const MacroInfo*> &left,
@@ -185,11 +303,11 @@ ParsedSemanticDefineList hlsl::CollectSemanticDefinesParsedByCompiler(CompilerIn
     return parsedDefines;
   }
 
-  const llvm::SmallVector<std::string, 2>& defineExclusions = helper->GetSemanticDefineExclusions();
+  const MacroNameMatcher inclusions(defines);
+  const MacroNameMatcher exclusions(helper->GetSemanticDefineExclusions());
 
-  // This is very inefficient in general, but in practice we either have
-  // no semantic defines, or we have a star define for a some reserved prefix. These will be
-  // sorted so rewrites are stable.
+  // Every macro is checked against the defines, which are indexed so that
+  // thousands of them stay cheap. These will be sorted so rewrites are stable.
   std::vector<std::pair<const IdentifierInfo*, MacroInfo*> > macros;
   Preprocessor& pp = compiler.getPreprocessor();
   Preprocessor::macro_iterator end = pp.macro_end();
@@ -205,24 +323,11 @@ ParsedSemanticDefineList hlsl::CollectSemanticDefinesParsedByCompiler(CompilerIn
     const IdentifierInfo* ii = i->first;
 
     // Exclusions take precedence over inclusions.
-    bool excluded = false;
-    for (const auto &exclusion : defineExclusions) {
-      if (IsMacroMatch(ii->getName(), exclusion)) {
-        excluded = true;
-        break;
-      }
-    }
-    if (excluded) {
+    if (exclusions.IsMatch(ii->getName()) || !inclusions.IsMatch(ii->getName())) {
       continue;
     }
 
-    for (const auto &define : defines) {
-      if (!IsMacroMatch(ii->getName(), define)) {
-        continue;
-      }
-
-      macros.push_back(std::pair<const IdentifierInfo*, MacroInfo*>(ii, mi));
-    }
+    macros.push_back(std::pair<const IdentifierInfo*, MacroInfo*>(ii, mi));
   }
 
   if (!macros.empty()) {
@@ -321,125 +426,155 @@ void WriteUserMacroDefines(CompilerInstance &compiler, raw_string_ostream &o) {
   WriteMacroDefines(macros, o);
 }
 
+// Prints the parsed source without the globals and functions that none of
+// the entry points reach. The translation unit is left as parsed, so that it
+// can be rewritten again for other entry points.
 static
-HRESULT DoRewriteUnused(_In_ DxcLangExtensionsHelper *pHelper,
-                     _In_ LPCSTR pFileName,
-                     _In_ ASTUnit::RemappedFile *pRemap,
-                     _In_ LPCSTR pEntryPoint,
-                     _In_ LPCSTR pDefines,
-                     _Outptr_result_z_ LPSTR *pWarnings,
-                     _Outptr_result_z_ LPSTR *pResult) {
-  if (pWarnings != nullptr) *pWarnings = nullptr;
-  if (pResult != nullptr) *pResult = nullptr;
-
-  std::string s, warnings;
-  raw_string_ostream o(s);
-  raw_string_ostream w(warnings);
-
-  // Setup a compiler instance.
-  CompilerInstance compiler;
-  std::unique_ptr<TextDiagnosticPrinter> diagPrinter =
-      std::make_unique<TextDiagnosticPrinter>(w, &compiler.getDiagnosticOpts());  
-  SetupCompilerForRewrite(compiler, pHelper, pFileName, diagPrinter.get(), pRemap, pDefines);
-
-  // Parse the source file.
-  compiler.getDiagnosticClient().BeginSourceFile(compiler.getLangOpts(), &compiler.getPreprocessor());
-  ParseAST(compiler.getSema(), false, false);
-
+void RewriteUnusedForEntryPoints(CompilerInstance &compiler,
+                                 _In_ DxcLangExtensionsHelper *pHelper,
+                                 ReachabilityAnalysis &reachability,
+                                 ArrayRef<LPCSTR> entryPoints,
+                                 raw_string_ostream &o,
+                                 raw_string_ostream &w) {
   ASTContext& C = compiler.getASTContext();
   TranslationUnitDecl *tu = C.getTranslationUnitDecl();
 
-  // Gather all global variables that are not in cbuffers and all functions.
-  SmallPtrSet<VarDecl*, 128> unusedGlobals;
-  SmallPtrSet<FunctionDecl*, 128> unusedFunctions;
-  auto tuDeclsEnd = tu->decls_end();
-  for (auto && tuDecl = tu->decls_begin(); tuDecl != tuDeclsEnd; ++tuDecl) {
-    VarDecl* varDecl = dyn_cast_or_null<VarDecl>(*tuDecl);
-    if (varDecl != nullptr) {
-      unusedGlobals.insert(varDecl);
+  w << "//found " << reachability.GetGlobalCount() << " globals as candidates for removal\n";
+  w << "//found " << reachability.GetFunctionCount() << " functions as candidates for removal\n";
+
+  // Traverse reachable functions and variables.
+  BitVector usedGlobals(reachability.GetGlobalCount());
+  BitVector usedFunctions(reachability.GetFunctionCount());
+  bool entryPointFound = false;
+  for (LPCSTR pEntryPoint : entryPoints) {
+    DeclContext::lookup_result l = tu->lookup(DeclarationName(&C.Idents.get(StringRef(pEntryPoint))));
+    if (l.empty()) {
+      w << "//entry point not found\n";
       continue;
     }
 
-    FunctionDecl* fnDecl = dyn_cast_or_null<FunctionDecl>(*tuDecl);
-    if (fnDecl != nullptr) {
-      if (fnDecl->hasBody()) {
-        unusedFunctions.insert(fnDecl);
-      }
-    }
-  }
-
-  w << "//found " << unusedGlobals.size() << " globals as candidates for removal\n";
-  w << "//found " << unusedFunctions.size() << " functions as candidates for removal\n";
-
-  DeclContext::lookup_result l = tu->lookup(DeclarationName(&C.Idents.get(StringRef(pEntryPoint))));
-  if (l.empty()) {
-    w << "//entry point not found\n";
-  }
-  else {
     w << "//entry point found\n";
     NamedDecl *entryDecl = l.front();
     FunctionDecl *entryFnDecl = dyn_cast_or_null<FunctionDecl>(entryDecl);
     if (entryFnDecl == nullptr) {
       o << "//entry point found but is not a function declaration\n";
+      continue;
     }
-    else {
-      // Traverse reachable functions and variables.
-      SmallPtrSet<FunctionDecl*, 128> visitedFunctions;
-      SmallVector<FunctionDecl*, 32> pendingFunctions;
-      VarReferenceVisitor visitor(unusedGlobals, visitedFunctions, pendingFunctions);
-      pendingFunctions.push_back(entryFnDecl);
-      while (!pendingFunctions.empty() && !unusedGlobals.empty()) {
-        FunctionDecl* pendingDecl = pendingFunctions.pop_back_val();
-        visitedFunctions.insert(pendingDecl);
-        visitor.TraverseDecl(pendingDecl);
-      }
+    reachability.Reach(entryFnDecl, usedGlobals, usedFunctions);
+    entryPointFound = true;
+  }
+  if (!entryPointFound) {
+    return;
+  }
 
-      // Don't bother doing work if there are no globals to remove.
-      if (unusedGlobals.empty()) {
-        w << "//no unused globals found - no work to be done\n";
-        StringRef contents = C.getSourceManager().getBufferData(C.getSourceManager().getMainFileID());
-        o << contents;
-      }
-      else {
-        w << "//found " << unusedGlobals.size() << " globals to remove\n";
+  // Don't bother doing work if there are no globals to remove.
+  if (usedGlobals.all()) {
+    w << "//no unused globals found - no work to be done\n";
+    StringRef contents = C.getSourceManager().getBufferData(C.getSourceManager().getMainFileID());
+    o << contents;
+    return;
+  }
 
-        // Don't remove visited functions.
-        auto visitedFunctionsEnd = visitedFunctions.end();
-        for (auto && visitedFn = visitedFunctions.begin(); visitedFn != visitedFunctionsEnd; ++visitedFn) {
-          unusedFunctions.erase(*visitedFn);
-        }
-        w << "//found " << unusedFunctions.size() << " functions to remove\n";
+  w << "//found " << usedGlobals.size() - usedGlobals.count() << " globals to remove\n";
+  w << "//found " << usedFunctions.size() - usedFunctions.count() << " functions to remove\n";
 
-        // Remove all unused variables and functions.
-        auto globalsEnd = unusedGlobals.end();
-        for (auto && unusedGlobal = unusedGlobals.begin(); unusedGlobal != globalsEnd; ++unusedGlobal) {
-          tu->removeDecl(*unusedGlobal);
-        }
+  // Leave all unused variables and functions out of the printed source.
+  // Rather than being removed from the translation unit, they are marked
+  // implicit, which the printer skips, and unmarked once printed.
+  SmallVector<Decl*, 128> hiddenDecls;
+  for (Decl *tuDecl : tu->decls()) {
+    int index = reachability.GetIndex(tuDecl);
+    if (index < 0 || tuDecl->isImplicit())
+      continue;
+    const BitVector &used = isa<VarDecl>(tuDecl) ? usedGlobals : usedFunctions;
+    if (!used.test(index))
+      hiddenDecls.push_back(tuDecl);
+  }
+  for (Decl *D : hiddenDecls) {
+    D->setImplicit(true);
+  }
 
-        auto functionsEnd = unusedFunctions.end();
-        for (auto && unusedFn = unusedFunctions.begin(); unusedFn != functionsEnd; ++unusedFn) {
-          tu->removeDecl(*unusedFn);
-        }
+  o << "// Rewrite unused globals result:\n";
+  PrintingPolicy p = PrintingPolicy(C.getPrintingPolicy());
+  p.Indentation = 1;
+  tu->print(o, p);
 
-        o << "// Rewrite unused globals result:\n";
-        PrintingPolicy p = PrintingPolicy(C.getPrintingPolicy());
-        p.Indentation = 1;
-        tu->print(o, p);
+  WriteSemanticDefines(compiler, pHelper, o);
 
-        WriteSemanticDefines(compiler, pHelper, o);
-      }
-    }
+  for (Decl *D : hiddenDecls) {
+    D->setImplicit(false);
   }
+}
 
-  // Flush and return results.
-  raw_string_ostream_to_CoString(o, pResult);
-  raw_string_ostream_to_CoString(w, pWarnings);
+// Parses the source once, and rewrites it for each of the entry points, or
+// once for all of them if bUnion is set. warnings and results receive one
+// string per rewrite.
+static
+HRESULT DoRewriteUnused(_In_ DxcLangExtensionsHelper *pHelper,
+                     _In_ LPCSTR pFileName,
+                     _In_ ASTUnit::RemappedFile *pRemap,
+                     ArrayRef<LPCSTR> entryPoints,
+                     bool bUnion,
+                     _In_ LPCSTR pDefines,
+                     std::vector<std::string> &warnings,
+                     std::vector<std::string> &results) {
+  std::string parseWarnings;
+  raw_string_ostream pw(parseWarnings);
+
+  // Setup a compiler instance.
+  CompilerInstance compiler;
+  std::unique_ptr<TextDiagnosticPrinter> diagPrinter =
+      std::make_unique<TextDiagnosticPrinter>(pw, &compiler.getDiagnosticOpts());  
+  SetupCompilerForRewrite(compiler, pHelper, pFileName, diagPrinter.get(), pRemap, pDefines);
+
+  // Parse the source file.
+  compiler.getDiagnosticClient().BeginSourceFile(compiler.getLangOpts(), &compiler.getPreprocessor());
+  ParseAST(compiler.getSema(), false, false);
+  pw.flush();
+
+  ReachabilityAnalysis reachability(compiler.getASTContext().getTranslationUnitDecl());
+  size_t rewriteCount = bUnion ? 1 : entryPoints.size();
+  warnings.resize(rewriteCount);
+  results.resize(rewriteCount);
+  for (size_t i = 0; i < rewriteCount; ++i) {
+    raw_string_ostream o(results[i]);
+    raw_string_ostream w(warnings[i]);
+    w << parseWarnings;
+    RewriteUnusedForEntryPoints(compiler, pHelper, reachability,
+                                bUnion ? entryPoints : entryPoints.slice(i, 1),
+                                o, w);
+    o.flush();
+    w.flush();
+  }
 
   if (compiler.getDiagnosticClient().getNumErrors() > 0)
     return E_FAIL;
   return S_OK;
 }
 
+static
+HRESULT DoRewriteUnused(_In_ DxcLangExtensionsHelper *pHelper,
+                     _In_ LPCSTR pFileName,
+                     _In_ ASTUnit::RemappedFile *pRemap,
+                     _In_ LPCSTR pEntryPoint,
+                     _In_ LPCSTR pDefines,
+                     _Outptr_result_z_ LPSTR *pWarnings,
+                     _Outptr_result_z_ LPSTR *pResult) {
+  if (pWarnings != nullptr) *pWarnings = nullptr;
+  if (pResult != nullptr) *pResult = nullptr;
+
+  std::vector<std::string> warnings, results;
+  HRESULT status = DoRewriteUnused(pHelper, pFileName, pRemap, pEntryPoint,
+                                   false, pDefines, warnings, results);
+
+  // Flush and return results.
+  raw_string_ostream o(results.front());
+  raw_string_ostream w(warnings.front());
+  raw_string_ostream_to_CoString(o, pResult);
+  raw_string_ostream_to_CoString(w, pWarnings);
+  return status;
+}
+
 static void RemoveStaticDecls(DeclContext &Ctx) {
   for (auto it = Ctx.decls_begin(); it != Ctx.decls_end(); ) {
     auto cur = it++;
@@ -540,7 +675,7 @@ HRESULT DoSimpleReWrite(_In_ DxcLangExtensionsHelper *pHelper,
   return S_OK;
 }
 
-class DxcRewriter : public IDxcRewriter, public IDxcLangExtensions {
+class DxcRewriter : public IDxcRewriter2, public IDxcLangExtensions {
 private:
   DXC_MICROCOM_TM_REF_FIELDS()
   DxcLangExtensionsHelper m_langExtensionsHelper;
@@ -550,7 +685,7 @@ public:
   DXC_LANGEXTENSIONS_HELPER_IMPL(m_langExtensionsHelper)
 
   HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) {
-    return DoBasicQueryInterface<IDxcRewriter, IDxcLangExtensions>(this, iid, ppvObject);
+    return DoBasicQueryInterface<IDxcRewriter, IDxcRewriter2, IDxcLangExtensions>(this, iid, ppvObject);
   }
 
   __override HRESULT STDMETHODCALLTYPE RemoveUnusedGlobals(_In_ IDxcBlobEncoding *pSource,
@@ -598,6 +733,77 @@ public:
     CATCH_CPP_RETURN_HRESULT();
   }
 
+  __override HRESULT STDMETHODCALLTYPE RemoveUnusedGlobalsBatch(_In_ IDxcBlobEncoding *pSource,
+                                                                _In_count_(entryPointCount) const LPCWSTR *pEntryPoints,
+                                                                _In_ UINT32 entryPointCount,
+                                                                _In_count_(defineCount) DxcDefine *pDefines,
+                                                                _In_ UINT32 defineCount,
+                                                                _In_ UINT32 batchFlags,
+                                                                _Out_writes_(entryPointCount) IDxcOperationResult **ppResults)
+  {
+    if (pSource == nullptr || (defineCount > 0 && pDefines == nullptr) ||
+        (entryPointCount > 0 && (pEntryPoints == nullptr || ppResults == nullptr)) ||
+        (batchFlags & ~DxcRewriterBatchFlags_ValidMask) != 0)
+      return E_INVALIDARG;
+    bool bUnion = (batchFlags & DxcRewriterBatchFlags_Union) != 0;
+    UINT32 resultCount = bUnion ? std::min(entryPointCount, 1U) : entryPointCount;
+    for (UINT32 i = 0; i < resultCount; ++i)
+      ppResults[i] = nullptr;
+
+    DxcThreadMalloc TM(m_pMalloc);
+
+    CComPtr<IDxcBlobEncoding> utf8Source;
+    IFR(hlsl::DxcGetBlobAsUtf8(pSource, &utf8Source));
+
+    LPCSTR fakeName = "input.hlsl";
+
+    HRESULT hr = S_OK;
+    try {
+      ::llvm::sys::fs::MSFileSystem* msfPtr;
+      IFT(CreateMSFileSystemForDisk(&msfPtr));
+      std::unique_ptr<::llvm::sys::fs::MSFileSystem> msf(msfPtr);
+
+      ::llvm::sys::fs::AutoPerThreadSystem pts(msf.get());
+      IFTLLVM(pts.error_code());
+
+      StringRef Data((LPSTR)utf8Source->GetBufferPointer(), utf8Source->GetBufferSize());
+      std::unique_ptr<llvm::MemoryBuffer> pBuffer(llvm::MemoryBuffer::getMemBufferCopy(Data, fakeName));
+      std::unique_ptr<ASTUnit::RemappedFile> pRemap(new ASTUnit::RemappedFile(fakeName, pBuffer.release()));
+
+      std::vector<std::string> utf8EntryPoints;
+      for (UINT32 i = 0; i < entryPointCount; ++i)
+        utf8EntryPoints.push_back(std::string(CW2A(pEntryPoints[i], CP_UTF8)));
+      std::vector<LPCSTR> entryPoints;
+      for (const std::string &entryPoint : utf8EntryPoints)
+        entryPoints.push_back(entryPoint.c_str());
+      std::string definesStr = DefinesToString(pDefines, defineCount);
+
+      std::vector<std::string> errors, rewrites;
+      HRESULT status = DoRewriteUnused(
+          &m_langExtensionsHelper, fakeName, pRemap.get(), entryPoints,
+          bUnion, defineCount > 0 ? definesStr.c_str() : nullptr, errors,
+          rewrites);
+      for (UINT32 i = 0; i < resultCount; ++i) {
+        raw_string_ostream o(rewrites[i]);
+        LPSTR rewrite = nullptr;
+        raw_string_ostream_to_CoString(o, &rewrite);
+        IFT(DxcOperationResult::CreateFromUtf8Strings(
+            errors[i].c_str(), rewrite, status, &ppResults[i]));
+      }
+    }
+    CATCH_CPP_ASSIGN_HRESULT();
+
+    if (FAILED(hr)) {
+      for (UINT32 i = 0; i < resultCount; ++i) {
+        if (ppResults[i]) {
+          ppResults[i]->Release();
+          ppResults[i] = nullptr;
+        }
+      }
+    }
+    return hr;
+  }
+
   __override HRESULT STDMETHODCALLTYPE 
   RewriteUnchanged(_In_ IDxcBlobEncoding *pSource,
                    _In_count_(defineCount) DxcDefine *pDefines,
@@ -535,6 +535,7 @@ public:
   TEST_METHOD(Intersections);
   TEST_METHOD(GapFilling);
   TEST_METHOD(Allocate);
+  TEST_METHOD(AllocateRepeated);
 
   void InitScenarios() {
     struct P {
@@ -754,3 +755,35 @@ TEST_F(AllocatorTest, Allocate) {
     TestSizesFn();
   }
 }
+
+TEST_F(AllocatorTest, AllocateRepeated) {
+  // Gaps at [1,1], [3,4] and [10,1000].
+  Allocator alloc(0, 1000);
+  Element fixed[] = { Element(0, 0, 0), Element(1, 2, 2), Element(2, 5, 9) };
+  for (auto &e : fixed)
+    VERIFY_IS_NULL(alloc.Insert(&e, e.start, e.end));
+
+  unsigned pos = 0;
+  VERIFY_IS_TRUE(alloc.Find(2, pos));
+  VERIFY_ARE_EQUAL(3u, pos);
+
+  // Repeated allocations of one size stay first-fit.
+  Element e(UINT_MAX, 0, 0);
+  const unsigned expected2[] = { 3, 10, 12, 14 };
+  for (unsigned expected : expected2) {
+    VERIFY_IS_TRUE(alloc.Allocate(&e, 2, pos));
+    VERIFY_ARE_EQUAL(expected, pos);
+  }
+  VERIFY_IS_TRUE(alloc.Allocate(&e, 1, pos));
+  VERIFY_ARE_EQUAL(1u, pos);
+  VERIFY_IS_TRUE(alloc.Allocate(&e, 1, pos));
+  VERIFY_ARE_EQUAL(16u, pos);
+  VERIFY_IS_TRUE(alloc.Allocate(&e, 2, pos));
+  VERIFY_ARE_EQUAL(17u, pos);
+
+  // A fixed span inserted past the hint is still skipped.
+  Element blocker(3, 19, 20);
+  VERIFY_IS_NULL(alloc.Insert(&blocker, blocker.start, blocker.end));
+  VERIFY_IS_TRUE(alloc.Allocate(&e, 2, pos));
+  VERIFY_ARE_EQUAL(21u, pos);
+}
@@ -20,6 +20,10 @@
 #include <cassert>
 #include <sstream>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <thread>
 #include "dxc/HLSL/DxilContainer.h"
 #include "dxc/Support/WinIncludes.h"
 #include "dxc/dxcapi.h"
@@ -401,6 +405,7 @@ public:
   TEST_METHOD(CompileWhenDebugWorksThenStripDebug)
   TEST_METHOD(CompileWhenWorksThenAddRemovePrivate)
   TEST_METHOD(CompileWithRootSignatureThenStripRootSignature)
+  TEST_METHOD(CompileWhenDebugWorksThenEditParts)
 
   TEST_METHOD(CompileWhenIncludeThenLoadInvoked)
   TEST_METHOD(CompileWhenIncludeThenLoadUsed)
@@ -411,12 +416,36 @@ public:
   TEST_METHOD(CompileWhenIncludeFlagsThenIncludeUsed)
   TEST_METHOD(CompileWhenIncludeMissingThenFail)
   TEST_METHOD(CompileWhenIncludeHasPathThenOK)
+  TEST_METHOD(CompileWhenCompileCacheThenIncludeChangeRecompiles)
+  TEST_METHOD(CompileWhenHLCacheThenBackendOptionsShareFrontEnd)
+  TEST_METHOD(CompileWhenContainerCacheThenIdenticalDxilShared)
+  TEST_METHOD(CompileWhenIncrementalThenChangedFunctionRecompiled)
+  TEST_METHOD(CompileWhenIncrementalManyChangedThenAllRecompiled)
+  TEST_METHOD(CompileWhenIncludeCacheThenIncludeChangeSeen)
+  TEST_METHOD(CompileWhenIncludeCacheThenKeyedByFullPath)
+  TEST_METHOD(CompileWhenSessionThenMatchesCompile)
+  TEST_METHOD(CompileWhenSessionNotInitializedThenFails)
+  TEST_METHOD(CompileWhenParsedArgsThenMatchesCompile)
+  TEST_METHOD(CompileWhenWarmedUpThenSucceeds)
+  TEST_METHOD(CompileWhenBatchThenMatchesCompile)
+  TEST_METHOD(CompileWhenPermutationsPreprocessSameThenShared)
+  TEST_METHOD(CompileWhenPermutationsIncludeThenLoadedOnce)
 
   TEST_METHOD(CompileWhenODumpThenPassConfig)
+  TEST_METHOD(CompileWhenFastIterationThenFewerPasses)
+  TEST_METHOD(CompileWhenProfileUseThenBranchWeights)
   TEST_METHOD(CompileWhenODumpThenOptimizerMatch)
   TEST_METHOD(CompileWhenVdThenProducesDxilContainer)
 
   TEST_METHOD(CompileWhenNoMemThenOOM)
+  TEST_METHOD(CompileWhenArenaAllocThenFewerAllocsAndNoLeaks)
+  TEST_METHOD(CompileWhenTimeoutThenStopsAndFreesMemory)
+  TEST_METHOD(CompileWhenCancelledBeforeThenNotAffected)
+  TEST_METHOD(CompileWhenMemoryLimitThenOOMAndFreesMemory)
+  TEST_METHOD(CompileWhenReportPhasesThenReportAttached)
+  TEST_METHOD(CompileWhenReportPhasesThenIntrinsicLoweringReported)
+  TEST_METHOD(CompileWhenDiagRecordsThenWarningRecorded)
+  TEST_METHOD(CompileWhenNoWarningsThenOnlyRecordsDropWarnings)
   TEST_METHOD(CompileWhenShaderModelMismatchAttributeThenFail)
   TEST_METHOD(CompileBadHlslThenFail)
   TEST_METHOD(CompileLegacyShaderModelThenFail)
@@ -440,6 +469,7 @@ public:
   TEST_METHOD(PixPixelCounterEarlyZ)
   TEST_METHOD(PixPixelCounterNoSvPosition)
   TEST_METHOD(PixPixelCounterAddPixelCost)
+  TEST_METHOD(PixBlockHitCounter)
   TEST_METHOD(PixConstantColor)
   TEST_METHOD(PixConstantColorInt)
   TEST_METHOD(PixConstantColorMRT)
@@ -457,12 +487,16 @@ public:
   TEST_METHOD(PixDebugPreexistingSVPosition)
   TEST_METHOD(PixDebugPreexistingSVVertex)
   TEST_METHOD(PixDebugPreexistingSVInstance)
+  TEST_METHOD(PixDebugCompactPackets)
+  TEST_METHOD(PixDebugSampleRate)
 
   TEST_METHOD(CodeGenAbs1)
   TEST_METHOD(CodeGenAbs2)
   TEST_METHOD(CodeGenAllLit)
   TEST_METHOD(CodeGenAllocaAtEntryBlk)
   TEST_METHOD(CodeGenAddUint64)
+  TEST_METHOD(CodeGenAggregateAtomics)
+  TEST_METHOD(CodeGenAnnotateUniform)
   TEST_METHOD(CodeGenArrayArg)
   TEST_METHOD(CodeGenArrayArg2)
   TEST_METHOD(CodeGenArrayArg3)
@@ -488,6 +522,7 @@ public:
   TEST_METHOD(CodeGenCast5)
   TEST_METHOD(CodeGenCast6)
   TEST_METHOD(CodeGenCast7)
+  TEST_METHOD(CodeGenCast8)
   TEST_METHOD(CodeGenCbuf_init_static)
   TEST_METHOD(CodeGenCbufferCopy)
   TEST_METHOD(CodeGenCbufferCopy1)
@@ -505,9 +540,11 @@ public:
   TEST_METHOD(CodeGenCbuffer6_51)
   TEST_METHOD(CodeGenCbufferAlloc)
   TEST_METHOD(CodeGenCbufferAllocLegacy)
+  TEST_METHOD(CodeGenCbufferRowCoalesce)
   TEST_METHOD(CodeGenCbufferHalf)
   TEST_METHOD(CodeGenCbufferInLoop)
   TEST_METHOD(CodeGenCbufferMinPrec)
+  TEST_METHOD(CodeGenCbufferOptimizeLayout)
   TEST_METHOD(CodeGenClass)
   TEST_METHOD(CodeGenClip)
   TEST_METHOD(CodeGenClipPlanes)
@@ -517,6 +554,7 @@ public:
   TEST_METHOD(CodeGenConstMat3)
   TEST_METHOD(CodeGenConstMat4)
   TEST_METHOD(CodeGenCorrectDelay)
+  TEST_METHOD(CodeGenDemotePrecision)
   TEST_METHOD(CodeGenDiscard)
   TEST_METHOD(CodeGenDivZero)
   TEST_METHOD(CodeGenDot1)
@@ -528,6 +566,7 @@ public:
   TEST_METHOD(CodeGenEliminateDynamicIndexing4)
   TEST_METHOD(CodeGenEliminateDynamicIndexing5)
   TEST_METHOD(CodeGenEliminateDynamicIndexing6)
+  TEST_METHOD(CodeGenEliminateDynamicIndexing7)
   TEST_METHOD(CodeGenEmpty)
   TEST_METHOD(CodeGenEmptyStruct)
   TEST_METHOD(CodeGenEnum1)
@@ -558,6 +597,9 @@ public:
   TEST_METHOD(CodeGenGatherOffset)
   TEST_METHOD(CodeGenGepZeroIdx)
   TEST_METHOD(CodeGenGloballyCoherent)
+  TEST_METHOD(CodeGenGroupSharedLayout)
+  TEST_METHOD(CodeGenHoistHandles)
+  TEST_METHOD(CodeGenHoistInvariantReads)
   TEST_METHOD(CodeGenI32ColIdx)
   TEST_METHOD(CodeGenIcb1)
   TEST_METHOD(CodeGenIf1)
@@ -590,6 +632,7 @@ public:
   TEST_METHOD(CodeGenInput1)
   TEST_METHOD(CodeGenInput2)
   TEST_METHOD(CodeGenInput3)
+  TEST_METHOD(CodeGenInput4)
   TEST_METHOD(CodeGenIntrinsic1)
   TEST_METHOD(CodeGenIntrinsic1Minprec)
   TEST_METHOD(CodeGenIntrinsic2)
@@ -603,18 +646,22 @@ public:
   TEST_METHOD(CodeGenIntrinsic5)
   TEST_METHOD(CodeGenIntrinsic5Minprec)
   TEST_METHOD(CodeGenInvalidInputOutputTypes)
+  TEST_METHOD(CodeGenLazyFunctionBodies)
   TEST_METHOD(CodeGenLegacyStruct)
   TEST_METHOD(CodeGenLibCsEntry)
   TEST_METHOD(CodeGenLibCsEntry2)
   TEST_METHOD(CodeGenLibCsEntry3)
   TEST_METHOD(CodeGenLibEntries)
   TEST_METHOD(CodeGenLibEntries2)
+  TEST_METHOD(CodeGenLibKeepHelpers)
+  TEST_METHOD(CodeGenLibMergeFunctions)
   TEST_METHOD(CodeGenLibNoAlias)
   TEST_METHOD(CodeGenLibResource)
   TEST_METHOD(CodeGenLibUnusedFunc)
   TEST_METHOD(CodeGenLitInParen)
   TEST_METHOD(CodeGenLiteralShift)
   TEST_METHOD(CodeGenLiveness1)
+  TEST_METHOD(CodeGenLocalConstArrayInit)
   TEST_METHOD(CodeGenLocalRes1)
   TEST_METHOD(CodeGenLocalRes4)
   TEST_METHOD(CodeGenLocalRes7)
@@ -677,6 +724,7 @@ public:
   TEST_METHOD(CodeGenNonUniform)
   TEST_METHOD(CodeGenOptForNoOpt)
   TEST_METHOD(CodeGenOptForNoOpt2)
+  TEST_METHOD(CodeGenOptForNoOpt5)
   TEST_METHOD(CodeGenOptionGis)
   TEST_METHOD(CodeGenOptionWX)
   TEST_METHOD(CodeGenOutput1)
@@ -702,6 +750,7 @@ public:
   TEST_METHOD(CodeGenReadFromOutput2)
   TEST_METHOD(CodeGenReadFromOutput3)
   TEST_METHOD(CodeGenRedundantinput1)
+  TEST_METHOD(CodeGenRemoveRedundantBarriers)
   TEST_METHOD(CodeGenRes64bit)
   TEST_METHOD(CodeGenRovs)
   TEST_METHOD(CodeGenRValAssign)
@@ -758,6 +807,7 @@ public:
   TEST_METHOD(CodeGenSimpleHS6)
   TEST_METHOD(CodeGenSimpleHS7)
   TEST_METHOD(CodeGenSimpleHS8)
+  TEST_METHOD(CodeGenSinkResourceReads)
   TEST_METHOD(CodeGenSMFail)
   TEST_METHOD(CodeGenSrv_Ms_Load1)
   TEST_METHOD(CodeGenSrv_Ms_Load2)
@@ -773,15 +823,19 @@ public:
   TEST_METHOD(CodeGenStaticMatrix)
   TEST_METHOD(CodeGenStaticResource)
   TEST_METHOD(CodeGenStaticResource2)
+  TEST_METHOD(CodeGenStreamCodeGen)
   TEST_METHOD(CodeGenStruct_Buf1)
   TEST_METHOD(CodeGenStruct_BufHasCounter)
   TEST_METHOD(CodeGenStruct_BufHasCounter2)
+  TEST_METHOD(CodeGenStruct_BufMergeAccess)
   TEST_METHOD(CodeGenStructArray)
   TEST_METHOD(CodeGenStructCast)
   TEST_METHOD(CodeGenStructCast2)
   TEST_METHOD(CodeGenStructInBuffer)
   TEST_METHOD(CodeGenStructInBuffer2)
   TEST_METHOD(CodeGenStructInBuffer3)
+  TEST_METHOD(CodeGenStructNested)
+  TEST_METHOD(CodeGenStructPackedAnnotations)
   TEST_METHOD(CodeGenSwitchFloat)
   TEST_METHOD(CodeGenSwitch1)
   TEST_METHOD(CodeGenSwitch2)
@@ -802,7 +856,10 @@ public:
   TEST_METHOD(CodeGenUint64_2)
   TEST_METHOD(CodeGenUintSample)
   TEST_METHOD(CodeGenUmaxObjectAtomic)
+  TEST_METHOD(CodeGenUnrollBudget)
   TEST_METHOD(CodeGenUnrollDbg)
+  TEST_METHOD(CodeGenUnrollPragmaDefault)
+  TEST_METHOD(CodeGenUnrollReadsDefault)
   TEST_METHOD(CodeGenUnsignedShortHandMatrixVector)
   TEST_METHOD(CodeGenUnusedFunc)
   TEST_METHOD(CodeGenUnusedCB)
@@ -903,6 +960,10 @@ public:
   TEST_METHOD(CodeGenCBufferStructArray)
   TEST_METHOD(CodeGenPatchLength)
   TEST_METHOD(PreprocessWhenValidThenOK)
+  TEST_METHOD(PreprocessWhenReportIncludesThenReportAttached)
+  TEST_METHOD(PreprocessWhenScanDepsThenIncludesListed)
+  TEST_METHOD(CompileWhenPreprocessedThenDefinesSkipped)
+  TEST_METHOD(CompileWhenBundleCapturedThenCompilesWithoutIncludeHandler)
   TEST_METHOD(WhenSigMismatchPCFunctionThenFail)
 
   // Dx11 Sample
@@ -1099,6 +1160,9 @@ public:
   BEGIN_TEST_METHOD(SingleFileCheckTest)
     TEST_METHOD_PROPERTY(L"Ignore", L"true")
   END_TEST_METHOD()
+  BEGIN_TEST_METHOD(ParallelFileCheckSuite)
+    TEST_METHOD_PROPERTY(L"Ignore", L"true")
+  END_TEST_METHOD()
 
   dxc::DxcDllSupport m_dllSupport;
   VersionSupportInfo m_ver;
@@ -1798,6 +1862,21 @@ TEST_F(CompilerTest, CompileDebugLines) {
   VERIFY_SUCCEEDED(pSession->findLinesByAddr(0, 0, numExpectedRVAs, &pEnumLineNumbers));
   linesByAddr = ReadLineNumbers(pEnumLineNumbers);
   verifyLines(linesByAddr);
+
+  // Verify a range in the middle only returns its own lines.
+  pEnumLineNumbers.Release();
+  VERIFY_SUCCEEDED(pSession->findLinesByRVA(2, 2, &pEnumLineNumbers));
+  std::vector<LineNumber> linesInRange = ReadLineNumbers(pEnumLineNumbers);
+  VERIFY_ARE_EQUAL(linesInRange.size(), 2);
+  VERIFY_ARE_EQUAL(linesInRange[0].rva, 2);
+  VERIFY_ARE_EQUAL(linesInRange[1].rva, 3);
+
+  // Verify empty and out-of-bounds ranges.
+  pEnumLineNumbers.Release();
+  VERIFY_SUCCEEDED(pSession->findLinesByRVA(numExpectedRVAs, 0, &pEnumLineNumbers));
+  VERIFY_ARE_EQUAL(ReadLineNumbers(pEnumLineNumbers).size(), 0);
+  pEnumLineNumbers.Release();
+  VERIFY_FAILED(pSession->findLinesByRVA(numExpectedRVAs - 1, 2, &pEnumLineNumbers));
 }
 
 TEST_F(CompilerTest, CompileWhenDefinesThenApplied) {
@@ -2054,6 +2133,64 @@ TEST_F(CompilerTest, CompileWithRootSignatureThenStripRootSignature) {
   VERIFY_IS_NULL(pPartHeader);
 }
 
+TEST_F(CompilerTest, CompileWhenDebugWorksThenEditParts) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcOperationResult> pResult;
+  CComPtr<IDxcBlobEncoding> pSource;
+  CComPtr<IDxcBlob> pProgram;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText("float4 main() : SV_Target {\r\n"
+                     "  return 0;\r\n"
+                     "}",
+                     &pSource);
+  LPCWSTR args[] = {L"/Zi"};
+  VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+                                      L"ps_6_0", args, _countof(args), nullptr,
+                                      0, nullptr, &pResult));
+  VERIFY_SUCCEEDED(pResult->GetResult(&pProgram));
+
+  CComPtr<IDxcContainerBuilder> pBuilder;
+  CComPtr<IDxcContainerBuilder2> pBuilder2;
+  VERIFY_SUCCEEDED(CreateContainerBuilder(&pBuilder));
+  VERIFY_SUCCEEDED(pBuilder.QueryInterface(&pBuilder2));
+  VERIFY_SUCCEEDED(pBuilder2->Load(pProgram));
+
+  // A batch that is not allowed leaves the builder as is.
+  std::string privateTxt("private data");
+  CComPtr<IDxcBlobEncoding> pPrivate;
+  CreateBlobFromText(privateTxt.c_str(), &pPrivate);
+  DxcContainerPartEdit badEdits[] = {
+    { hlsl::DxilFourCC::DFCC_PrivateData, pPrivate },
+    { hlsl::DxilFourCC::DFCC_DXIL, nullptr },
+  };
+  VERIFY_FAILED(pBuilder2->EditParts(badEdits, _countof(badEdits)));
+
+  // Strip the debug info and add private data in one batch.
+  DxcContainerPartEdit edits[] = {
+    { hlsl::DxilFourCC::DFCC_ShaderDebugInfoDXIL, nullptr },
+    { hlsl::DxilFourCC::DFCC_PrivateData, pPrivate },
+  };
+  VERIFY_SUCCEEDED(pBuilder2->EditParts(edits, _countof(edits)));
+  pResult.Release();
+  VERIFY_SUCCEEDED(pBuilder2->SerializeContainerWithFlags(
+      DxcContainerBuilderFlags_SkipValidation, &pResult));
+
+  CComPtr<IDxcBlob> pNewProgram;
+  VERIFY_SUCCEEDED(pResult->GetResult(&pNewProgram));
+  hlsl::DxilContainerHeader *pContainerHeader =
+      (hlsl::DxilContainerHeader *)(pNewProgram->GetBufferPointer());
+  VERIFY_IS_NULL(hlsl::GetDxilPartByType(
+      pContainerHeader, hlsl::DxilFourCC::DFCC_ShaderDebugInfoDXIL));
+  VERIFY_IS_NOT_NULL(hlsl::GetDxilPartByType(pContainerHeader,
+                                             hlsl::DxilFourCC::DFCC_DXIL));
+  hlsl::DxilPartHeader *pPartHeader = hlsl::GetDxilPartByType(
+      pContainerHeader, hlsl::DxilFourCC::DFCC_PrivateData);
+  VERIFY_IS_NOT_NULL(pPartHeader);
+  std::string privatePart((const char *)(pPartHeader + 1), privateTxt.size());
+  VERIFY_ARE_EQUAL_STR(privateTxt.c_str(), privatePart.c_str());
+}
+
 TEST_F(CompilerTest, CompileWhenIncludeThenLoadInvoked) {
   CComPtr<IDxcCompiler> pCompiler;
   CComPtr<IDxcOperationResult> pResult;
@@ -2255,8 +2392,541 @@ TEST_F(CompilerTest, CompileWhenIncludeHasPathThenOK) {
  }
 }
 
+TEST_F(CompilerTest, CompileWhenCompileCacheThenIncludeChangeRecompiles) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcBlobEncoding> pSource;
+  CComPtr<IDxcBlob> pPrograms[3];
+  const char *pHelpers[3] = { "#define VALUE 0", "#define VALUE 0",
+                              "#define VALUE 1" };
+  LPCWSTR args[] = { L"-compile-cache" };
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText(
+    "#include \"helper.h\"\r\n"
+    "float4 main() : SV_Target { return VALUE; }", &pSource);
+
+  for (unsigned i = 0; i < _countof(pPrograms); ++i) {
+    CComPtr<IDxcOperationResult> pResult;
+    CComPtr<TestIncludeHandler> pInclude;
+    pInclude = new TestIncludeHandler(m_dllSupport);
+    pInclude->CallResults.emplace_back(pHelpers[i]);
+    VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+      L"ps_6_0", args, _countof(args), nullptr, 0, pInclude, &pResult));
+    VerifyOperationSucceeded(pResult);
+    VERIFY_SUCCEEDED(pResult->GetResult(&pPrograms[i]));
+    // The include is loaded once per compile, whether it is only checked
+    // against the cache or also compiled after a miss.
+    VERIFY_ARE_EQUAL(1, pInclude->CallInfos.size());
+  }
+
+  // An unchanged include reuses the first result; a changed one does not.
+  VERIFY_ARE_EQUAL(pPrograms[0]->GetBufferSize(), pPrograms[1]->GetBufferSize());
+  VERIFY_ARE_EQUAL(0, memcmp(pPrograms[0]->GetBufferPointer(),
+                             pPrograms[1]->GetBufferPointer(),
+                             pPrograms[0]->GetBufferSize()));
+  VERIFY_IS_FALSE(pPrograms[0]->GetBufferSize() == pPrograms[2]->GetBufferSize() &&
+                  0 == memcmp(pPrograms[0]->GetBufferPointer(),
+                              pPrograms[2]->GetBufferPointer(),
+                              pPrograms[0]->GetBufferSize()));
+}
+
+TEST_F(CompilerTest, CompileWhenHLCacheThenBackendOptionsShareFrontEnd) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcBlobEncoding> pSource;
+  std::string programs[3];
+  const char *pHelpers[3] = { "#define VALUE 0", "#define VALUE 0",
+                              "#define VALUE 1" };
+  // -Zsb only affects the container, so the second compile reuses the
+  // high-level module of the first.
+  LPCWSTR args[] = { L"-hl-cache", L"-Zsb" };
+  UINT32 argCounts[3] = { 1, 2, 1 };
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText(
+    "#include \"helper.h\"\r\n"
+    "float4 main() : SV_Target { return VALUE; }", &pSource);
+
+  for (unsigned i = 0; i < _countof(programs); ++i) {
+    CComPtr<IDxcOperationResult> pResult;
+    CComPtr<TestIncludeHandler> pInclude;
+    CComPtr<IDxcBlob> pProgram;
+    pInclude = new TestIncludeHandler(m_dllSupport);
+    pInclude->CallResults.emplace_back(pHelpers[i]);
+    VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+      L"ps_6_0", args, argCounts[i], nullptr, 0, pInclude, &pResult));
+    VerifyOperationSucceeded(pResult);
+    VERIFY_SUCCEEDED(pResult->GetResult(&pProgram));
+    programs[i] = DisassembleProgram(m_dllSupport, pProgram);
+  }
+
+  // An unchanged include reuses the module; a changed one does not.
+  VERIFY_ARE_EQUAL(programs[0], programs[1]);
+  VERIFY_ARE_NOT_EQUAL(programs[0], programs[2]);
+}
+
+TEST_F(CompilerTest, CompileWhenContainerCacheThenIdenticalDxilShared) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcBlobEncoding> pSource;
+  CComPtr<IDxcBlob> pPrograms[3];
+  // The first two permutations only differ in a path that is optimized
+  // away, so they produce the same DXIL.
+  DxcDefine defines[3] = { { L"MODE", L"0" }, { L"MODE", L"1" },
+                           { L"MODE", L"2" } };
+  LPCWSTR args[] = { L"-container-cache" };
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText(
+    "float4 main(float4 a : A) : SV_Target {\r\n"
+    "  if (MODE == 2) return a * 2;\r\n"
+    "  if (MODE == 1 && a.x > a.x) return 0;\r\n"
+    "  return a;\r\n"
+    "}", &pSource);
+
+  for (unsigned i = 0; i < _countof(pPrograms); ++i) {
+    CComPtr<IDxcOperationResult> pResult;
+    VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+      L"ps_6_0", args, _countof(args), &defines[i], 1, nullptr, &pResult));
+    VerifyOperationSucceeded(pResult);
+    VERIFY_SUCCEEDED(pResult->GetResult(&pPrograms[i]));
+  }
+
+  // The second compile reuses the container of the first; the third, whose
+  // DXIL differs, does not.
+  VERIFY_ARE_EQUAL(pPrograms[0]->GetBufferPointer(),
+                   pPrograms[1]->GetBufferPointer());
+  VERIFY_ARE_NOT_EQUAL(pPrograms[0]->GetBufferPointer(),
+                       pPrograms[2]->GetBufferPointer());
+}
+
+TEST_F(CompilerTest, CompileWhenIncrementalThenChangedFunctionRecompiled) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcBlobEncoding> pSource;
+  std::string programs[2];
+  const char *pHelpers[2] = { "#define VALUE 3", "#define VALUE 5" };
+  LPCWSTR args[] = { L"-incremental" };
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  // Only the body of A depends on the include, so the second compile reuses
+  // the DXIL of B.
+  CreateBlobFromText(
+    "#include \"helper.h\"\r\n"
+    "RWBuffer<float> Out : register(u0);\r\n"
+    "export void A() { Out[0] = VALUE; }\r\n"
+    "export void B() { Out[1] = 7; }", &pSource);
+
+  for (unsigned i = 0; i < _countof(programs); ++i) {
+    CComPtr<IDxcOperationResult> pResult;
+    CComPtr<TestIncludeHandler> pInclude;
+    CComPtr<IDxcBlob> pProgram;
+    pInclude = new TestIncludeHandler(m_dllSupport);
+    pInclude->CallResults.emplace_back(pHelpers[i]);
+    VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"",
+      L"lib_6_1", args, _countof(args), nullptr, 0, pInclude, &pResult));
+    VerifyOperationSucceeded(pResult);
+    VERIFY_SUCCEEDED(pResult->GetResult(&pProgram));
+    programs[i] = DisassembleProgram(m_dllSupport, pProgram);
+  }
+
+  VERIFY_ARE_NOT_EQUAL(std::string::npos, programs[0].find("3.000000e+00"));
+  VERIFY_ARE_EQUAL(std::string::npos, programs[1].find("3.000000e+00"));
+  VERIFY_ARE_NOT_EQUAL(std::string::npos, programs[1].find("5.000000e+00"));
+  VERIFY_ARE_NOT_EQUAL(std::string::npos, programs[1].find("7.000000e+00"));
+}
+
+TEST_F(CompilerTest, CompileWhenIncrementalManyChangedThenAllRecompiled) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcBlobEncoding> pSource;
+  std::string programs[2];
+  const char *pHelpers[2] = { "#define VALUE 10", "#define VALUE 20" };
+  LPCWSTR args[] = { L"-incremental" };
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  // Every function changes, so with enough cores they're recompiled in
+  // groups on worker threads and merged.
+  std::string source = "#include \"helper.h\"\r\n"
+                       "RWBuffer<float> Out : register(u0);\r\n";
+  for (unsigned i = 0; i < 16; ++i) {
+    source += "export void F" + std::to_string(i) + "() { Out[" +
+              std::to_string(i) + "] = VALUE + " + std::to_string(i) +
+              "; }\r\n";
+  }
+  CreateBlobFromText(source.c_str(), &pSource);
+
+  for (unsigned i = 0; i < _countof(programs); ++i) {
+    CComPtr<IDxcOperationResult> pResult;
+    CComPtr<TestIncludeHandler> pInclude;
+    CComPtr<IDxcBlob> pProgram;
+    pInclude = new TestIncludeHandler(m_dllSupport);
+    pInclude->CallResults.emplace_back(pHelpers[i]);
+    VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"apart.hlsl", L"",
+      L"lib_6_1", args, _countof(args), nullptr, 0, pInclude, &pResult));
+    VerifyOperationSucceeded(pResult);
+    VERIFY_SUCCEEDED(pResult->GetResult(&pProgram));
+    programs[i] = DisassembleProgram(m_dllSupport, pProgram);
+  }
+
+  VERIFY_ARE_EQUAL(std::string::npos, programs[1].find("1.000000e+01"));
+  VERIFY_ARE_NOT_EQUAL(std::string::npos, programs[1].find("2.000000e+01"));
+  VERIFY_ARE_NOT_EQUAL(std::string::npos, programs[1].find("3.500000e+01"));
+}
+
+TEST_F(CompilerTest, CompileWhenIncludeCacheThenIncludeChangeSeen) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcBlobEncoding> pSource;
+  CComPtr<IDxcBlob> pPrograms[2];
+  const char *pHelpers[2] = { "#define VALUE 0", "#define VALUE 1" };
+  LPCWSTR args[] = { L"-include-cache" };
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText(
+    "#include \"helper.h\"\r\n"
+    "float4 main() : SV_Target { return VALUE; }", &pSource);
+
+  for (unsigned i = 0; i < _countof(pPrograms); ++i) {
+    CComPtr<IDxcOperationResult> pResult;
+    CComPtr<TestIncludeHandler> pInclude;
+    pInclude = new TestIncludeHandler(m_dllSupport);
+    pInclude->CallResults.emplace_back(pHelpers[i]);
+    VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+      L"ps_6_0", args, _countof(args), nullptr, 0, pInclude, &pResult));
+    VerifyOperationSucceeded(pResult);
+    VERIFY_ARE_EQUAL_WSTR(L"./helper.h;", pInclude->GetAllFileNames().c_str());
+    VERIFY_SUCCEEDED(pResult->GetResult(&pPrograms[i]));
+  }
+
+  // Handlers without file stamps are still asked every time, so the second
+  // compile must see the changed include.
+  VERIFY_IS_FALSE(pPrograms[0]->GetBufferSize() == pPrograms[1]->GetBufferSize() &&
+                  0 == memcmp(pPrograms[0]->GetBufferPointer(),
+                              pPrograms[1]->GetBufferPointer(),
+                              pPrograms[0]->GetBufferSize()));
+}
+
+TEST_F(CompilerTest, CompileWhenIncludeCacheThenKeyedByFullPath) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcLibrary> pLibrary;
+  CComPtr<IDxcBlobEncoding> pSource;
+  CComPtr<IDxcBlob> pPrograms[2];
+  const char *pHelpers[2] = { "#define VALUE 0", "#define VALUE 1" };
+  LPCWSTR args[] = { L"-include-cache" };
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcLibrary, &pLibrary));
+  CreateBlobFromText(
+    "#include \"helper.h\"\r\n"
+    "float4 main() : SV_Target { return VALUE; }", &pSource);
+
+  // Two directories hold a helper.h of the same size and last write time, so
+  // only the full path tells the cached files apart.
+  wchar_t TempPath[MAX_PATH];
+  wchar_t OldDir[MAX_PATH];
+  VERIFY_WIN32_BOOL_SUCCEEDED(GetTempPathW(MAX_PATH, TempPath) != 0);
+  VERIFY_WIN32_BOOL_SUCCEEDED(GetCurrentDirectoryW(MAX_PATH, OldDir) != 0);
+  std::wstring Dirs[2];
+  FILETIME WriteTime = { 0x12345678, 0x01d00000 };
+  for (unsigned i = 0; i < _countof(Dirs); ++i) {
+    Dirs[i] = TempPath;
+    Dirs[i] += L"CompilerTest_include_cache_";
+    Dirs[i] += std::to_wstring(i);
+    CreateDirectoryW(Dirs[i].c_str(), nullptr);
+    std::wstring FileName = Dirs[i] + L"\\helper.h";
+    {
+      std::ofstream Out(FileName.c_str(), std::ios::binary | std::ios::trunc);
+      Out << pHelpers[i];
+    }
+    HANDLE hFile = CreateFileW(FileName.c_str(), FILE_WRITE_ATTRIBUTES, 0,
+                               nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                               nullptr);
+    VERIFY_IS_TRUE(hFile != INVALID_HANDLE_VALUE);
+    VERIFY_WIN32_BOOL_SUCCEEDED(
+        SetFileTime(hFile, nullptr, nullptr, &WriteTime));
+    CloseHandle(hFile);
+  }
+
+  for (unsigned i = 0; i < _countof(pPrograms); ++i) {
+    CComPtr<IDxcOperationResult> pResult;
+    CComPtr<IDxcIncludeHandler> pInclude;
+    VERIFY_SUCCEEDED(pLibrary->CreateIncludeHandler(&pInclude));
+    VERIFY_WIN32_BOOL_SUCCEEDED(SetCurrentDirectoryW(Dirs[i].c_str()));
+    HRESULT hr = pCompiler->Compile(pSource, L"source.hlsl", L"main",
+      L"ps_6_0", args, _countof(args), nullptr, 0, pInclude, &pResult);
+    SetCurrentDirectoryW(OldDir);
+    VERIFY_SUCCEEDED(hr);
+    VerifyOperationSucceeded(pResult);
+    VERIFY_SUCCEEDED(pResult->GetResult(&pPrograms[i]));
+  }
+
+  for (const std::wstring &Dir : Dirs) {
+    DeleteFileW((Dir + L"\\helper.h").c_str());
+    RemoveDirectoryW(Dir.c_str());
+  }
+
+  // The same relative name from another directory is a different file.
+  VERIFY_IS_FALSE(pPrograms[0]->GetBufferSize() == pPrograms[1]->GetBufferSize() &&
+                  0 == memcmp(pPrograms[0]->GetBufferPointer(),
+                              pPrograms[1]->GetBufferPointer(),
+                              pPrograms[0]->GetBufferSize()));
+}
+
 static const char EmptyCompute[] = "[numthreads(8,8,1)] void main() { }";
 
+TEST_F(CompilerTest, CompileWhenSessionThenMatchesCompile) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcCompilerSession> pSession;
+  LPCWSTR args[] = { L"/Vd" };
+  DxcDefine define = { L"VALUE", L"2" };
+  const char *pSources[2] = {
+    "float4 main() : SV_Target { return VALUE; }",
+    "float4 main(float4 a : A) : SV_Target { return a * VALUE; }" };
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  VERIFY_SUCCEEDED(pCompiler.QueryInterface(&pSession));
+  VERIFY_SUCCEEDED(pSession->Initialize(L"ps_6_0", args, _countof(args),
+                                        &define, 1, nullptr));
+
+  for (const char *pText : pSources) {
+    CComPtr<IDxcBlobEncoding> pSource;
+    CComPtr<IDxcOperationResult> pResult;
+    CComPtr<IDxcOperationResult> pSessionResult;
+    CComPtr<IDxcBlob> pProgram;
+    CComPtr<IDxcBlob> pSessionProgram;
+    CreateBlobFromText(pText, &pSource);
+    VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+      L"ps_6_0", args, _countof(args), &define, 1, nullptr, &pResult));
+    VerifyOperationSucceeded(pResult);
+    VERIFY_SUCCEEDED(pResult->GetResult(&pProgram));
+    VERIFY_SUCCEEDED(pSession->Compile(pSource, L"source.hlsl", L"main",
+      nullptr, &pSessionResult, nullptr, nullptr));
+    VerifyOperationSucceeded(pSessionResult);
+    VERIFY_SUCCEEDED(pSessionResult->GetResult(&pSessionProgram));
+    VERIFY_ARE_EQUAL(pProgram->GetBufferSize(), pSessionProgram->GetBufferSize());
+    VERIFY_ARE_EQUAL(0, memcmp(pProgram->GetBufferPointer(),
+                               pSessionProgram->GetBufferPointer(),
+                               pProgram->GetBufferSize()));
+  }
+}
+
+TEST_F(CompilerTest, CompileWhenParsedArgsThenMatchesCompile) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcCompiler> pOtherCompiler;
+  CComPtr<IDxcCompilerArgsParser> pParser;
+  CComPtr<IDxcCompilerArgsParser> pOtherParser;
+  CComPtr<IDxcCompilerArgs> pArgs;
+  CComPtr<IDxcBlobEncoding> pSource;
+  CComPtr<IDxcOperationResult> pResult;
+  CComPtr<IDxcBlob> pProgram;
+  LPCWSTR args[] = { L"/Vd", L"/O3" };
+  DxcDefine define = { L"VALUE", L"2" };
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  VERIFY_SUCCEEDED(CreateCompiler(&pOtherCompiler));
+  VERIFY_SUCCEEDED(pCompiler.QueryInterface(&pParser));
+  VERIFY_SUCCEEDED(pOtherCompiler.QueryInterface(&pOtherParser));
+  VERIFY_SUCCEEDED(pParser->ParseArguments(L"ps_6_0", args, _countof(args),
+                                           &define, 1, &pArgs, nullptr));
+
+  CreateBlobFromText("float4 main() : SV_Target { return VALUE; }", &pSource);
+  VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+    L"ps_6_0", args, _countof(args), &define, 1, nullptr, &pResult));
+  VerifyOperationSucceeded(pResult);
+  VERIFY_SUCCEEDED(pResult->GetResult(&pProgram));
+
+  // The handle can be used again, and by another compiler object.
+  IDxcCompilerArgsParser *pUsers[] = { pParser, pParser, pOtherParser };
+  for (IDxcCompilerArgsParser *pUser : pUsers) {
+    CComPtr<IDxcOperationResult> pArgsResult;
+    CComPtr<IDxcBlob> pArgsProgram;
+    VERIFY_SUCCEEDED(pUser->CompileWithArgs(pSource, L"source.hlsl", L"main",
+      pArgs, nullptr, &pArgsResult, nullptr, nullptr));
+    VerifyOperationSucceeded(pArgsResult);
+    VERIFY_SUCCEEDED(pArgsResult->GetResult(&pArgsProgram));
+    VERIFY_ARE_EQUAL(pProgram->GetBufferSize(), pArgsProgram->GetBufferSize());
+    VERIFY_ARE_EQUAL(0, memcmp(pProgram->GetBufferPointer(),
+                               pArgsProgram->GetBufferPointer(),
+                               pProgram->GetBufferSize()));
+  }
+
+  // Invalid arguments produce no handle.
+  CComPtr<IDxcCompilerArgs> pBadArgs;
+  CComPtr<IDxcBlobEncoding> pErrors;
+  LPCWSTR badArgs[] = { L"/not-an-option" };
+  VERIFY_ARE_EQUAL(E_INVALIDARG,
+    pParser->ParseArguments(L"ps_6_0", badArgs, _countof(badArgs), nullptr, 0,
+                            &pBadArgs, &pErrors));
+  VERIFY_IS_NULL(pBadArgs.p);
+  VERIFY_IS_NOT_NULL(pErrors.p);
+}
+
+TEST_F(CompilerTest, CompileWhenWarmedUpThenSucceeds) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcBlobEncoding> pSource;
+  CComPtr<IDxcOperationResult> pResult;
+
+  // Warming up more than once is allowed.
+  VERIFY_SUCCEEDED(m_dllSupport.WarmUp());
+  VERIFY_SUCCEEDED(m_dllSupport.WarmUp());
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText(EmptyCompute, &pSource);
+  VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+    L"cs_6_0", nullptr, 0, nullptr, 0, nullptr, &pResult));
+  VerifyOperationSucceeded(pResult);
+}
+
+TEST_F(CompilerTest, CompileWhenSessionNotInitializedThenFails) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcCompilerSession> pSession;
+  CComPtr<IDxcBlobEncoding> pSource;
+  CComPtr<IDxcOperationResult> pResult;
+  CComPtr<IDxcBlobEncoding> pErrors;
+  LPCWSTR badArgs[] = { L"/not-an-option" };
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  VERIFY_SUCCEEDED(pCompiler.QueryInterface(&pSession));
+  CreateBlobFromText(EmptyCompute, &pSource);
+  VERIFY_ARE_EQUAL(E_NOT_VALID_STATE,
+    pSession->Compile(pSource, L"source.hlsl", L"main", nullptr, &pResult,
+                      nullptr, nullptr));
+
+  // Invalid options leave the session uninitialized.
+  VERIFY_ARE_EQUAL(E_INVALIDARG,
+    pSession->Initialize(L"cs_6_0", badArgs, _countof(badArgs), nullptr, 0,
+                         &pErrors));
+  VERIFY_IS_NOT_NULL(pErrors.p);
+  VERIFY_ARE_EQUAL(E_NOT_VALID_STATE,
+    pSession->Compile(pSource, L"source.hlsl", L"main", nullptr, &pResult,
+                      nullptr, nullptr));
+}
+
+TEST_F(CompilerTest, CompileWhenBatchThenMatchesCompile) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcCompiler3> pCompiler3;
+  CComPtr<IDxcBlobEncoding> pSource;
+  LPCWSTR args[] = { L"/Vd" };
+  LPCWSTR entryPoints[] = { L"VSMain", L"PSMain", L"Missing" };
+  LPCWSTR profiles[] = { L"vs_6_0", L"ps_6_0", L"ps_6_0" };
+  IDxcOperationResult *pResults[_countof(entryPoints)];
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  VERIFY_SUCCEEDED(pCompiler.QueryInterface(&pCompiler3));
+  CreateBlobFromText(
+    "float4 Scale(float4 v) { return v * 2; }\r\n"
+    "float4 VSMain(float4 pos : POSITION) : SV_Position { return Scale(pos); }\r\n"
+    "float4 PSMain(float4 c : COLOR) : SV_Target { return Scale(c); }",
+    &pSource);
+  VERIFY_SUCCEEDED(pCompiler3->CompileBatch(
+    pSource, L"source.hlsl", entryPoints, profiles, _countof(entryPoints),
+    args, _countof(args), nullptr, 0, nullptr, pResults));
+  CComPtr<IDxcOperationResult> pBatchResults[_countof(entryPoints)];
+  for (size_t i = 0; i < _countof(entryPoints); ++i)
+    pBatchResults[i].Attach(pResults[i]);
+
+  // A missing entry point only fails its own result.
+  VerifyOperationFailed(pBatchResults[2]);
+
+  for (size_t i = 0; i < 2; ++i) {
+    CComPtr<IDxcOperationResult> pResult;
+    CComPtr<IDxcBlob> pProgram;
+    CComPtr<IDxcBlob> pBatchProgram;
+    VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl",
+      entryPoints[i], profiles[i], args, _countof(args), nullptr, 0, nullptr,
+      &pResult));
+    VerifyOperationSucceeded(pResult);
+    VERIFY_SUCCEEDED(pResult->GetResult(&pProgram));
+    VerifyOperationSucceeded(pBatchResults[i]);
+    VERIFY_SUCCEEDED(pBatchResults[i]->GetResult(&pBatchProgram));
+    VERIFY_ARE_EQUAL(pProgram->GetBufferSize(), pBatchProgram->GetBufferSize());
+    VERIFY_ARE_EQUAL(0, memcmp(pProgram->GetBufferPointer(),
+                               pBatchProgram->GetBufferPointer(),
+                               pProgram->GetBufferSize()));
+  }
+}
+
+TEST_F(CompilerTest, CompileWhenPermutationsPreprocessSameThenShared) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcCompilerPermutations> pPermutations;
+  CComPtr<IDxcBlobEncoding> pSource;
+  LPCWSTR args[] = { L"/Vd" };
+  // The second permutation only adds a define the source doesn't use.
+  DxcDefine defines[] = { { L"FEATURE", L"1" },
+                          { L"FEATURE", L"1" }, { L"UNUSED", L"1" } };
+  UINT32 defineCounts[] = { 1, 2, 0 };
+  IDxcOperationResult *pResults[_countof(defineCounts)];
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  VERIFY_SUCCEEDED(pCompiler.QueryInterface(&pPermutations));
+  CreateBlobFromText(
+    "float4 main(float4 c : COLOR) : SV_Target {\r\n"
+    "#if FEATURE\r\n"
+    "  c *= 2;\r\n"
+    "#endif\r\n"
+    "  return c;\r\n"
+    "}",
+    &pSource);
+  VERIFY_SUCCEEDED(pPermutations->CompilePermutations(
+    pSource, L"source.hlsl", L"main", L"ps_6_0", args, _countof(args),
+    nullptr, 0, defines, defineCounts, _countof(defineCounts), nullptr,
+    pResults));
+  CComPtr<IDxcOperationResult> pPermutationResults[_countof(defineCounts)];
+  for (size_t i = 0; i < _countof(defineCounts); ++i)
+    pPermutationResults[i].Attach(pResults[i]);
+
+  VERIFY_ARE_EQUAL(pPermutationResults[0].p, pPermutationResults[1].p);
+  VERIFY_ARE_NOT_EQUAL(pPermutationResults[0].p, pPermutationResults[2].p);
+
+  // Each result matches a compile of its own.
+  const DxcDefine *pDefines[] = { &defines[0], &defines[1], nullptr };
+  for (size_t i = 0; i < _countof(defineCounts); ++i) {
+    CComPtr<IDxcOperationResult> pResult;
+    CComPtr<IDxcBlob> pProgram;
+    CComPtr<IDxcBlob> pPermutationProgram;
+    VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+      L"ps_6_0", args, _countof(args), pDefines[i], defineCounts[i], nullptr,
+      &pResult));
+    VerifyOperationSucceeded(pResult);
+    VERIFY_SUCCEEDED(pResult->GetResult(&pProgram));
+    VerifyOperationSucceeded(pPermutationResults[i]);
+    VERIFY_SUCCEEDED(pPermutationResults[i]->GetResult(&pPermutationProgram));
+    VERIFY_ARE_EQUAL(pProgram->GetBufferSize(),
+                     pPermutationProgram->GetBufferSize());
+    VERIFY_ARE_EQUAL(0, memcmp(pProgram->GetBufferPointer(),
+                               pPermutationProgram->GetBufferPointer(),
+                               pProgram->GetBufferSize()));
+  }
+}
+
+TEST_F(CompilerTest, CompileWhenPermutationsIncludeThenLoadedOnce) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcCompilerPermutations> pPermutations;
+  CComPtr<IDxcBlobEncoding> pSource;
+  CComPtr<TestIncludeHandler> pInclude;
+  // Both permutations change the preprocessed text, so both are compiled.
+  DxcDefine defines[] = { { L"SCALE", L"2" }, { L"SCALE", L"3" } };
+  UINT32 defineCounts[] = { 1, 1 };
+  IDxcOperationResult *pResults[_countof(defineCounts)];
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  VERIFY_SUCCEEDED(pCompiler.QueryInterface(&pPermutations));
+  CreateBlobFromText(
+    "#include \"helper.h\"\r\n"
+    "float4 main() : SV_Target { return helper() * SCALE; }", &pSource);
+  pInclude = new TestIncludeHandler(m_dllSupport);
+  pInclude->CallResults.emplace_back("float4 helper() { return 1; }\r\n");
+
+  VERIFY_SUCCEEDED(pPermutations->CompilePermutations(
+    pSource, L"source.hlsl", L"main", L"ps_6_0", nullptr, 0, nullptr, 0,
+    defines, defineCounts, _countof(defineCounts), pInclude, pResults));
+  CComPtr<IDxcOperationResult> pPermutationResults[_countof(defineCounts)];
+  for (size_t i = 0; i < _countof(defineCounts); ++i)
+    pPermutationResults[i].Attach(pResults[i]);
+
+  VERIFY_ARE_NOT_EQUAL(pPermutationResults[0].p, pPermutationResults[1].p);
+  for (size_t i = 0; i < _countof(defineCounts); ++i)
+    VerifyOperationSucceeded(pPermutationResults[i]);
+  // The preprocess and compile of every permutation share one load.
+  VERIFY_ARE_EQUAL(1U, pInclude->CallInfos.size());
+}
+
 TEST_F(CompilerTest, CompileWhenODumpThenPassConfig) {
   CComPtr<IDxcCompiler> pCompiler;
   CComPtr<IDxcOperationResult> pResult;
@@ -2276,6 +2946,85 @@ TEST_F(CompilerTest, CompileWhenODumpThenPassConfig) {
   VERIFY_ARE_NOT_EQUAL(string::npos, passes.find("inline"));
 }
 
+TEST_F(CompilerTest, CompileWhenFastIterationThenFewerPasses) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcBlobEncoding> pSource;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText(
+    "Texture2D g_Tex; SamplerState g_Sampler;\r\n"
+    "float4 main(float4 pos : SV_Position, float2 uv : UV) : SV_Target {\r\n"
+    "  float4 c = g_Tex.Sample(g_Sampler, uv);\r\n"
+    "  if (c.w < 0.5) c.xyz *= pos.xyz;\r\n"
+    "  return c;\r\n"
+    "}", &pSource);
+
+  // The result still validates.
+  {
+    CComPtr<IDxcOperationResult> pResult;
+    LPCWSTR Args[] = { L"-fast-iteration" };
+    VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+      L"ps_6_0", Args, _countof(Args), nullptr, 0, nullptr, &pResult));
+    VerifyOperationSucceeded(pResult);
+  }
+
+  // The pipeline is a subset of /Od.
+  string passes[2];
+  LPCWSTR OptArgs[2] = { L"/Od", L"-fast-iteration" };
+  for (unsigned i = 0; i < 2; ++i) {
+    CComPtr<IDxcOperationResult> pResult;
+    CComPtr<IDxcBlob> pResultBlob;
+    LPCWSTR Args[] = { OptArgs[i], L"/Odump" };
+    VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+      L"ps_6_0", Args, _countof(Args), nullptr, 0, nullptr, &pResult));
+    VerifyOperationSucceeded(pResult);
+    VERIFY_SUCCEEDED(pResult->GetResult(&pResultBlob));
+    passes[i] = BlobToUtf8(pResultBlob);
+  }
+  VERIFY_ARE_NOT_EQUAL(string::npos, passes[0].find("-verify"));
+  VERIFY_ARE_EQUAL(string::npos, passes[1].find("-verify"));
+  VERIFY_ARE_EQUAL(string::npos, passes[1].find("-add-discriminators"));
+  VERIFY_ARE_NOT_EQUAL(string::npos, passes[1].find("-dxilgen"));
+  VERIFY_IS_TRUE(std::count(passes[1].begin(), passes[1].end(), '\n') <
+                 std::count(passes[0].begin(), passes[0].end(), '\n'));
+}
+
+TEST_F(CompilerTest, CompileWhenProfileUseThenBranchWeights) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcOperationResult> pResult;
+  CComPtr<IDxcBlobEncoding> pSource;
+  CComPtr<TestIncludeHandler> pInclude;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText(
+    "float n;\r\n"
+    "float4 main(float4 pos : SV_Position) : SV_Target {\r\n"
+    "  float4 c = pos;\r\n"
+    "  [branch] if (pos.x > n) {\r\n"
+    "    c.xyz = sin(c.xyz);\r\n"
+    "  }\r\n"
+    "  return c;\r\n"
+    "}", &pSource);
+
+  // Line offsets from the declaration of main; the branch is rarely taken.
+  pInclude = new TestIncludeHandler(m_dllSupport);
+  pInclude->CallResults.emplace_back(
+    "main:1201:1000\n"
+    " 1: 1000\n"
+    " 2: 1000\n"
+    " 3: 1\n"
+    " 5: 1000\n");
+
+  LPCWSTR Args[] = { L"/Zi", L"-profile-use", L"profile.txt" };
+  VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+    L"ps_6_0", Args, _countof(Args), nullptr, 0, pInclude, &pResult));
+  VerifyOperationSucceeded(pResult);
+  CComPtr<IDxcBlob> pResultBlob;
+  VERIFY_SUCCEEDED(pResult->GetResult(&pResultBlob));
+  string text = DisassembleProgram(m_dllSupport, pResultBlob);
+  VERIFY_ARE_NOT_EQUAL(string::npos, text.find("!\"branch_weights\""));
+}
+
 TEST_F(CompilerTest, CompileWhenVdThenProducesDxilContainer) {
   CComPtr<IDxcCompiler> pCompiler;
   CComPtr<IDxcOperationResult> pResult;
@@ -2533,57 +3282,309 @@ TEST_F(CompilerTest, CompileWhenNoMemThenOOM) {
   allocCount = InstrMalloc.GetAllocCount();
   allocSize = InstrMalloc.GetAllocSize();
 
-  HRESULT hrWithMemory;
-  VERIFY_SUCCEEDED(pResult->GetStatus(&hrWithMemory));
-  VERIFY_SUCCEEDED(hrWithMemory);
+  HRESULT hrWithMemory;
+  VERIFY_SUCCEEDED(pResult->GetStatus(&hrWithMemory));
+  VERIFY_SUCCEEDED(hrWithMemory);
+
+  pCompiler.Release();
+  pResult.Release();
+
+  VERIFY_IS_TRUE(allocSize > allocCount);
+
+  // Ensure that after all resources are released, there are no outstanding
+  // allocations or references.
+  //
+  // First leak is in ((InstrumentedHeapMalloc::PtrData *)InstrMalloc.AllocList.Flink)
+  VERIFY_IS_TRUE(0 == InstrMalloc.GetSize());
+  VERIFY_ARE_EQUAL(initialRefCount, InstrMalloc.GetRefCount());
+
+  // In Debug, without /D_ITERATOR_DEBUG_LEVEL=0, debug iterators will be used;
+  // this causes a problem where std::string is specified as noexcept, and yet
+  // a sentinel is allocated that may fail and throw.
+  if (m_ver.SkipOutOfMemoryTest()) return;
+
+  // Now, fail each allocation and make sure we get an error.
+  for (ULONG i = 0; i <= allocCount; ++i) {
+    // LogCommentFmt(L"alloc fail %u", i);
+    bool isLast = i == allocCount;
+    InstrMalloc.ResetCounts();
+    InstrMalloc.ResetHeap();
+    InstrMalloc.SetFailAlloc(i + 1);
+    HRESULT hrOp = m_dllSupport.CreateInstance2(&InstrMalloc, CLSID_DxcCompiler, &pCompiler);
+    if (SUCCEEDED(hrOp)) {
+      hrOp = pCompiler->Compile(pSource, L"source.hlsl", L"main", L"cs_6_0",
+                                nullptr, 0, nullptr, 0, nullptr, &pResult);
+      if (SUCCEEDED(hrOp)) {
+        pResult->GetStatus(&hrOp);
+      }
+    }
+    if (FAILED(hrOp)) {
+      // This is true in *almost* every case. When the OOM happens during stream
+      // handling, there is no specific error set; by the time it's detected,
+      // it propagates as E_FAIL.
+      //VERIFY_ARE_EQUAL(hrOp, E_OUTOFMEMORY);
+      VERIFY_IS_TRUE(hrOp == E_OUTOFMEMORY || hrOp == E_FAIL);
+    }
+    if (isLast)
+      VERIFY_SUCCEEDED(hrOp);
+    else
+      VERIFY_FAILED(hrOp);
+    pCompiler.Release();
+    pResult.Release();
+    VERIFY_IS_TRUE(0 == InstrMalloc.GetSize()); // breakpoint for i failure - i == val
+    VERIFY_ARE_EQUAL(initialRefCount, InstrMalloc.GetRefCount());
+  }
+}
+
+TEST_F(CompilerTest, CompileWhenArenaAllocThenFewerAllocsAndNoLeaks) {
+  CComPtr<IDxcBlobEncoding> pSource;
+  CreateBlobFromText(EmptyCompute, &pSource);
+
+  InstrumentedHeapMalloc InstrMalloc;
+  VERIFY_IS_TRUE(m_dllSupport.HasCreateWithMalloc());
+
+  LPCWSTR noArgs[] = { L"/O3" };
+  LPCWSTR arenaArgs[] = { L"/O3", L"-arena-alloc" };
+  ULONG allocCounts[2];
+  ULONG heldSizes[2];
+  for (unsigned i = 0; i < 2; ++i) {
+    CComPtr<IDxcCompiler> pCompiler;
+    CComPtr<IDxcOperationResult> pResult;
+    InstrMalloc.ResetCounts();
+    InstrMalloc.ResetHeap();
+    ULONG initialRefCount = InstrMalloc.GetRefCount();
+    VERIFY_SUCCEEDED(m_dllSupport.CreateInstance2(&InstrMalloc, CLSID_DxcCompiler, &pCompiler));
+    VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+      L"cs_6_0", i ? arenaArgs : noArgs, i ? _countof(arenaArgs) : _countof(noArgs),
+      nullptr, 0, nullptr, &pResult));
+    VerifyOperationSucceeded(pResult);
+    allocCounts[i] = InstrMalloc.GetAllocCount();
+    pCompiler.Release();
+    heldSizes[i] = InstrMalloc.GetSize();
+    pResult.Release();
+
+    // The arena must hand all of its memory back once the outputs are gone.
+    VERIFY_IS_TRUE(0 == InstrMalloc.GetSize());
+    VERIFY_ARE_EQUAL(initialRefCount, InstrMalloc.GetRefCount());
+  }
+  VERIFY_IS_TRUE(allocCounts[1] < allocCounts[0]);
+  // A result the caller keeps doesn't keep the arena alive.
+  VERIFY_IS_TRUE(heldSizes[1] <= heldSizes[0]);
+}
+
+TEST_F(CompilerTest, CompileWhenTimeoutThenStopsAndFreesMemory) {
+  CComPtr<IDxcBlobEncoding> pSource;
+  CreateBlobFromText(
+    "RWBuffer<float> u;\r\n"
+    "[numthreads(1, 1, 1)] void main() {\r\n"
+    "  float f = 0;\r\n"
+    "  [unroll] for (uint i = 0; i < 4096; ++i) f = f * u[i] + 1;\r\n"
+    "  u[0] = f;\r\n"
+    "}", &pSource);
+  LPCWSTR args[] = { L"-compile-timeout", L"1" };
+
+  InstrumentedHeapMalloc InstrMalloc;
+  InstrMalloc.ResetHeap();
+  ULONG initialRefCount = InstrMalloc.GetRefCount();
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcOperationResult> pResult;
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance2(&InstrMalloc, CLSID_DxcCompiler, &pCompiler));
+  VERIFY_ARE_EQUAL(DXC_E_COMPILE_TIMEOUT,
+                   pCompiler->Compile(pSource, L"source.hlsl", L"main",
+                                      L"cs_6_0", args, _countof(args), nullptr,
+                                      0, nullptr, &pResult));
+  VERIFY_IS_NULL(pResult.p);
+
+  // Nothing the compile allocated outlives the compiler.
+  pCompiler.Release();
+  VERIFY_IS_TRUE(0 == InstrMalloc.GetSize());
+  VERIFY_ARE_EQUAL(initialRefCount, InstrMalloc.GetRefCount());
+}
+
+TEST_F(CompilerTest, CompileWhenCancelledBeforeThenNotAffected) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcCompilerCancel> pCancel;
+  CComPtr<IDxcBlobEncoding> pSource;
+  CComPtr<IDxcOperationResult> pResult;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  VERIFY_SUCCEEDED(pCompiler.QueryInterface(&pCancel));
+  CreateBlobFromText(EmptyCompute, &pSource);
+
+  // Cancelling only stops the compiles that are running at the time.
+  VERIFY_SUCCEEDED(pCancel->CancelCompiles());
+  VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+    L"cs_6_0", nullptr, 0, nullptr, 0, nullptr, &pResult));
+  VerifyOperationSucceeded(pResult);
+}
+
+TEST_F(CompilerTest, CompileWhenMemoryLimitThenOOMAndFreesMemory) {
+  CComPtr<IDxcBlobEncoding> pSource;
+  CreateBlobFromText(EmptyCompute, &pSource);
+
+  InstrumentedHeapMalloc InstrMalloc;
+  InstrMalloc.ResetHeap();
+  ULONG initialRefCount = InstrMalloc.GetRefCount();
+  CComPtr<IDxcCompiler> pCompiler;
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance2(&InstrMalloc, CLSID_DxcCompiler, &pCompiler));
+
+  // Setting up the front end alone takes more than a megabyte.
+  LPCWSTR tightArgs[] = { L"-compile-memory-limit", L"1" };
+  CComPtr<IDxcOperationResult> pResult;
+  VERIFY_ARE_EQUAL(E_OUTOFMEMORY,
+                   pCompiler->Compile(pSource, L"source.hlsl", L"main",
+                                      L"cs_6_0", tightArgs, _countof(tightArgs),
+                                      nullptr, 0, nullptr, &pResult));
+  VERIFY_IS_NULL(pResult.p);
+
+  LPCWSTR looseArgs[] = { L"-compile-memory-limit", L"4096" };
+  VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+                                      L"cs_6_0", looseArgs, _countof(looseArgs),
+                                      nullptr, 0, nullptr, &pResult));
+  VerifyOperationSucceeded(pResult);
+
+  pResult.Release();
+  pCompiler.Release();
+  VERIFY_IS_TRUE(0 == InstrMalloc.GetSize());
+  VERIFY_ARE_EQUAL(initialRefCount, InstrMalloc.GetRefCount());
+}
+
+TEST_F(CompilerTest, CompileWhenReportPhasesThenReportAttached) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcBlobEncoding> pSource;
+  LPCWSTR args[] = { L"-report-phases" };
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText(EmptyCompute, &pSource);
+
+  for (unsigned i = 0; i < 2; ++i) {
+    CComPtr<IDxcOperationResult> pResult;
+    CComPtr<IDxcOperationResultReport> pResultReport;
+    CComPtr<IDxcBlobEncoding> pReport;
+    VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+      L"cs_6_0", args, i, nullptr, 0, nullptr, &pResult));
+    VerifyOperationSucceeded(pResult);
+    VERIFY_SUCCEEDED(pResult.QueryInterface(&pResultReport));
+    VERIFY_SUCCEEDED(pResultReport->GetReport(&pReport));
+    if (i == 0) {
+      VERIFY_IS_NULL(pReport.p);
+      continue;
+    }
+
+    VERIFY_IS_NOT_NULL(pReport.p);
+    std::string report = BlobToUtf8(pReport);
+    VERIFY_ARE_EQUAL((size_t)0, report.find("phase\tdepth\tcount\twall_us\tallocs\t"));
+    VERIFY_ARE_NOT_EQUAL(string::npos, report.find("\nCompile\t0\t1\t"));
+    VERIFY_ARE_NOT_EQUAL(string::npos, report.find("\n  Front end\t1\t1\t"));
+    VERIFY_ARE_NOT_EQUAL(string::npos, report.find("IR generation\t2\t"));
+    VERIFY_ARE_NOT_EQUAL(string::npos, report.find("Backend\t2\t1\t"));
+    VERIFY_ARE_NOT_EQUAL(string::npos, report.find("DXIL Generator\t"));
+    VERIFY_ARE_NOT_EQUAL(string::npos, report.find("\n  Validation\t1\t1\t"));
+  }
+}
+
+TEST_F(CompilerTest, CompileWhenReportPhasesThenIntrinsicLoweringReported) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcBlobEncoding> pSource;
+  CComPtr<IDxcOperationResult> pResult;
+  CComPtr<IDxcOperationResultReport> pResultReport;
+  CComPtr<IDxcBlobEncoding> pReport;
+  LPCWSTR args[] = { L"-report-phases" };
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText("float4 main(float4 a : A) : SV_Target {\n"
+                     "  return sin(a) + cos(a);\n"
+                     "}", &pSource);
+  VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+    L"ps_6_0", args, _countof(args), nullptr, 0, nullptr, &pResult));
+  VerifyOperationSucceeded(pResult);
+  VERIFY_SUCCEEDED(pResult.QueryInterface(&pResultReport));
+  VERIFY_SUCCEEDED(pResultReport->GetReport(&pReport));
+
+  // Each intrinsic is reported within the pass that lowers it.
+  std::string report = BlobToUtf8(pReport);
+  size_t generator = report.find("DXIL Generator\t");
+  VERIFY_ARE_NOT_EQUAL(string::npos, generator);
+  VERIFY_ARE_NOT_EQUAL(string::npos, report.find("IOP_sin\t", generator));
+  VERIFY_ARE_NOT_EQUAL(string::npos, report.find("IOP_cos\t", generator));
+}
 
-  pCompiler.Release();
-  pResult.Release();
+TEST_F(CompilerTest, CompileWhenDiagRecordsThenWarningRecorded) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcBlobEncoding> pSource;
+  CComPtr<IDxcOperationResult> pResult;
+  CComPtr<IDxcOperationResultDiagnostics> pDiagnostics;
+  CComPtr<IDxcBlobEncoding> pErrors;
+  LPCWSTR args[] = { L"-diag-records" };
 
-  VERIFY_IS_TRUE(allocSize > allocCount);
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText("float4 main() : SV_Target {\n"
+                     "  int x = 3;\n"
+                     "  x;\n"
+                     "  return x;\n"
+                     "}", &pSource);
+  VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+    L"ps_6_0", args, _countof(args), nullptr, 0, nullptr, &pResult));
+  VerifyOperationSucceeded(pResult);
+  VERIFY_SUCCEEDED(pResult.QueryInterface(&pDiagnostics));
+
+  UINT32 count;
+  DxcDiagnostic diagnostic;
+  VERIFY_SUCCEEDED(pDiagnostics->GetDiagnosticCount(&count));
+  VERIFY_ARE_EQUAL(1, count);
+  VERIFY_SUCCEEDED(pDiagnostics->GetDiagnostic(0, &diagnostic));
+  VERIFY_ARE_EQUAL(DxcDiagnosticSeverity_Warning, diagnostic.Severity);
+  VERIFY_ARE_EQUAL_STR("source.hlsl", diagnostic.pFileName);
+  VERIFY_ARE_EQUAL(3, diagnostic.Line);
+  VERIFY_ARE_EQUAL(3, diagnostic.Column);
+  VERIFY_ARE_EQUAL_STR("expression result unused", diagnostic.pMessage);
+  VERIFY_ARE_EQUAL(E_INVALIDARG, pDiagnostics->GetDiagnostic(1, &diagnostic));
+
+  // The error buffer is formatted from the record.
+  VERIFY_SUCCEEDED(pResult->GetErrorBuffer(&pErrors));
+  std::string errors = BlobToUtf8(pErrors);
+  VERIFY_ARE_EQUAL_STR("source.hlsl:3:3: warning: expression result unused\n",
+                       errors.c_str());
+}
 
-  // Ensure that after all resources are released, there are no outstanding
-  // allocations or references.
-  //
-  // First leak is in ((InstrumentedHeapMalloc::PtrData *)InstrMalloc.AllocList.Flink)
-  VERIFY_IS_TRUE(0 == InstrMalloc.GetSize());
-  VERIFY_ARE_EQUAL(initialRefCount, InstrMalloc.GetRefCount());
+TEST_F(CompilerTest, CompileWhenNoWarningsThenOnlyRecordsDropWarnings) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcBlobEncoding> pSource;
+  LPCWSTR args[] = { L"-no-warnings" };
+  LPCWSTR recordArgs[] = { L"-no-warnings", L"-diag-records" };
 
-  // In Debug, without /D_ITERATOR_DEBUG_LEVEL=0, debug iterators will be used;
-  // this causes a problem where std::string is specified as noexcept, and yet
-  // a sentinel is allocated that may fail and throw.
-  if (m_ver.SkipOutOfMemoryTest()) return;
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText("float4 main() : SV_Target {\n"
+                     "  int x = 3;\n"
+                     "  x;\n"
+                     "  return x;\n"
+                     "}", &pSource);
+
+  // Without records, warnings still reach the error buffer; dxc only leaves
+  // them off the console, and writes them to the -Fe file.
+  {
+    CComPtr<IDxcOperationResult> pResult;
+    CComPtr<IDxcBlobEncoding> pErrors;
+    VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+      L"ps_6_0", args, _countof(args), nullptr, 0, nullptr, &pResult));
+    VerifyOperationSucceeded(pResult);
+    VERIFY_SUCCEEDED(pResult->GetErrorBuffer(&pErrors));
+    VERIFY_ARE_NOT_EQUAL(std::string::npos,
+                         BlobToUtf8(pErrors).find("warning:"));
+  }
 
-  // Now, fail each allocation and make sure we get an error.
-  for (ULONG i = 0; i <= allocCount; ++i) {
-    // LogCommentFmt(L"alloc fail %u", i);
-    bool isLast = i == allocCount;
-    InstrMalloc.ResetCounts();
-    InstrMalloc.ResetHeap();
-    InstrMalloc.SetFailAlloc(i + 1);
-    HRESULT hrOp = m_dllSupport.CreateInstance2(&InstrMalloc, CLSID_DxcCompiler, &pCompiler);
-    if (SUCCEEDED(hrOp)) {
-      hrOp = pCompiler->Compile(pSource, L"source.hlsl", L"main", L"cs_6_0",
-                                nullptr, 0, nullptr, 0, nullptr, &pResult);
-      if (SUCCEEDED(hrOp)) {
-        pResult->GetStatus(&hrOp);
-      }
-    }
-    if (FAILED(hrOp)) {
-      // This is true in *almost* every case. When the OOM happens during stream
-      // handling, there is no specific error set; by the time it's detected,
-      // it propagates as E_FAIL.
-      //VERIFY_ARE_EQUAL(hrOp, E_OUTOFMEMORY);
-      VERIFY_IS_TRUE(hrOp == E_OUTOFMEMORY || hrOp == E_FAIL);
-    }
-    if (isLast)
-      VERIFY_SUCCEEDED(hrOp);
-    else
-      VERIFY_FAILED(hrOp);
-    pCompiler.Release();
-    pResult.Release();
-    VERIFY_IS_TRUE(0 == InstrMalloc.GetSize()); // breakpoint for i failure - i == val
-    VERIFY_ARE_EQUAL(initialRefCount, InstrMalloc.GetRefCount());
+  // With records and no warnings file, warnings are not recorded at all.
+  {
+    CComPtr<IDxcOperationResult> pResult;
+    CComPtr<IDxcOperationResultDiagnostics> pDiags;
+    UINT32 count;
+    VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+      L"ps_6_0", recordArgs, _countof(recordArgs), nullptr, 0, nullptr,
+      &pResult));
+    VerifyOperationSucceeded(pResult);
+    VERIFY_SUCCEEDED(pResult.QueryInterface(&pDiags));
+    VERIFY_SUCCEEDED(pDiags->GetDiagnosticCount(&count));
+    VERIFY_ARE_EQUAL(0u, count);
   }
 }
 
@@ -2849,6 +3850,10 @@ TEST_F(CompilerTest, PixPixelCounterAddPixelCost) {
   CodeGenTestCheck(L"pix\\pixelCounterAddPixelCost.hlsl");
 }
 
+TEST_F(CompilerTest, PixBlockHitCounter) {
+  CodeGenTestCheck(L"pix\\blockHitCounter.hlsl");
+}
+
 TEST_F(CompilerTest, PixConstantColor) {
   CodeGenTestCheck(L"pix\\constantcolor.hlsl");
 }
@@ -2917,6 +3922,14 @@ TEST_F(CompilerTest, PixDebugPreexistingSVInstance) {
   CodeGenTestCheck(L"pix\\DebugPreexistingSVInstance.hlsl");
 }
 
+TEST_F(CompilerTest, PixDebugCompactPackets) {
+  CodeGenTestCheck(L"pix\\DebugCompactPackets.hlsl");
+}
+
+TEST_F(CompilerTest, PixDebugSampleRate) {
+  CodeGenTestCheck(L"pix\\DebugSampleRate.hlsl");
+}
+
 TEST_F(CompilerTest, CodeGenAbs1) {
   CodeGenTestCheck(L"..\\CodeGenHLSL\\abs1.hlsl");
 }
@@ -2937,6 +3950,14 @@ TEST_F(CompilerTest, CodeGenAddUint64) {
   CodeGenTestCheck(L"..\\CodeGenHLSL\\AddUint64.hlsl");
 }
 
+TEST_F(CompilerTest, CodeGenAggregateAtomics) {
+  CodeGenTestCheck(L"..\\CodeGenHLSL\\aggregate_atomics.hlsl");
+}
+
+TEST_F(CompilerTest, CodeGenAnnotateUniform) {
+  CodeGenTestCheck(L"..\\CodeGenHLSL\\annotate_uniform.hlsl");
+}
+
 TEST_F(CompilerTest, CodeGenArrayArg){
   CodeGenTest(L"..\\CodeGenHLSL\\arrayArg.hlsl");
 }
@@ -3041,6 +4062,10 @@ TEST_F(CompilerTest, CodeGenCast7) {
   CodeGenTestCheck(L"..\\CodeGenHLSL\\cast7.hlsl");
 }
 
+TEST_F(CompilerTest, CodeGenCast8) {
+  CodeGenTestCheck(L"..\\CodeGenHLSL\\cast8.hlsl");
+}
+
 TEST_F(CompilerTest, CodeGenCbuf_init_static) {
   CodeGenTest(L"..\\CodeGenHLSL\\cbuf_init_static.hlsl");
 }
@@ -3109,6 +4134,10 @@ TEST_F(CompilerTest, CodeGenCbufferAllocLegacy) {
   CodeGenTestCheck(L"..\\CodeGenHLSL\\cbufferAlloc_legacy.hlsl");
 }
 
+TEST_F(CompilerTest, CodeGenCbufferRowCoalesce) {
+  CodeGenTestCheck(L"..\\CodeGenHLSL\\cbufferRowCoalesce.hlsl");
+}
+
 TEST_F(CompilerTest, CodeGenCbufferHalf) {
   if (m_ver.SkipDxilVersion(1, 2)) return;
   CodeGenTestCheck(L"..\\CodeGenHLSL\\cbufferHalf.hlsl");
@@ -3122,6 +4151,10 @@ TEST_F(CompilerTest, CodeGenCbufferMinPrec) {
   CodeGenTestCheck(L"..\\CodeGenHLSL\\cbufferMinPrec.hlsl");
 }
 
+TEST_F(CompilerTest, CodeGenCbufferOptimizeLayout) {
+  CodeGenTestCheck(L"..\\CodeGenHLSL\\cbuffer_optimize_layout.hlsl");
+}
+
 TEST_F(CompilerTest, CodeGenClass) {
   CodeGenTestCheck(L"..\\CodeGenHLSL\\class.hlsl");
 }
@@ -3158,6 +4191,10 @@ TEST_F(CompilerTest, CodeGenCorrectDelay) {
   CodeGenTestCheck(L"..\\CodeGenHLSL\\correct_delay.hlsl");
 }
 
+TEST_F(CompilerTest, CodeGenDemotePrecision) {
+  CodeGenTestCheck(L"..\\CodeGenHLSL\\demote_precision.hlsl");
+}
+
 TEST_F(CompilerTest, CodeGenDiscard) {
   CodeGenTestCheck(L"..\\CodeGenHLSL\\discard.hlsl");
 }
@@ -3202,6 +4239,10 @@ TEST_F(CompilerTest, CodeGenEliminateDynamicIndexing6) {
   CodeGenTestCheck(L"eliminate_dynamic_output6.hlsl");
 }
 
+TEST_F(CompilerTest, CodeGenEliminateDynamicIndexing7) {
+  CodeGenTestCheck(L"eliminate_dynamic_output7.hlsl");
+}
+
 TEST_F(CompilerTest, CodeGenEmpty) {
   CodeGenTest(L"..\\CodeGenHLSL\\empty.hlsl");
 }
@@ -3338,6 +4379,18 @@ TEST_F(CompilerTest, CodeGenGloballyCoherent) {
   CodeGenTestCheck(L"..\\CodeGenHLSL\\globallycoherent.hlsl");
 }
 
+TEST_F(CompilerTest, CodeGenGroupSharedLayout) {
+  CodeGenTestCheck(L"..\\CodeGenHLSL\\groupshared_layout.hlsl");
+}
+
+TEST_F(CompilerTest, CodeGenHoistHandles) {
+  CodeGenTestCheck(L"..\\CodeGenHLSL\\hoist_handles.hlsl");
+}
+
+TEST_F(CompilerTest, CodeGenHoistInvariantReads) {
+  CodeGenTestCheck(L"..\\CodeGenHLSL\\hoist_invariant_reads.hlsl");
+}
+
 TEST_F(CompilerTest, CodeGenI32ColIdx) {
   CodeGenTest(L"..\\CodeGenHLSL\\i32colIdx.hlsl");
 }
@@ -3448,6 +4501,10 @@ TEST_F(CompilerTest, CodeGenInput3) {
   CodeGenTest(L"..\\CodeGenHLSL\\input3.hlsl");
 }
 
+TEST_F(CompilerTest, CodeGenInput4) {
+  CodeGenTestCheck(L"..\\CodeGenHLSL\\input4.hlsl");
+}
+
 TEST_F(CompilerTest, CodeGenIntrinsic1) {
   CodeGenTestCheck(L"..\\CodeGenHLSL\\intrinsic1.hlsl");
 }
@@ -3500,6 +4557,10 @@ TEST_F(CompilerTest, CodeGenInvalidInputOutputTypes) {
   CodeGenTestCheck(L"..\\CodeGenHLSL\\invalid_input_output_types.hlsl");
 }
 
+TEST_F(CompilerTest, CodeGenLazyFunctionBodies) {
+  CodeGenTestCheck(L"..\\CodeGenHLSL\\lazy_function_bodies.hlsl");
+}
+
 TEST_F(CompilerTest, CodeGenLegacyStruct) {
   CodeGenTestCheck(L"..\\CodeGenHLSL\\legacy_struct.hlsl");
 }
@@ -3524,6 +4585,14 @@ TEST_F(CompilerTest, CodeGenLibEntries2) {
   CodeGenTestCheck(L"..\\CodeGenHLSL\\lib_entries2.hlsl");
 }
 
+TEST_F(CompilerTest, CodeGenLibKeepHelpers) {
+  CodeGenTestCheck(L"..\\CodeGenHLSL\\lib_keep_helpers.hlsl");
+}
+
+TEST_F(CompilerTest, CodeGenLibMergeFunctions) {
+  CodeGenTestCheck(L"..\\CodeGenHLSL\\lib_merge_functions.hlsl");
+}
+
 TEST_F(CompilerTest, CodeGenLibNoAlias) {
   CodeGenTestCheck(L"..\\CodeGenHLSL\\lib_no_alias.hlsl");
 }
@@ -3552,6 +4621,10 @@ TEST_F(CompilerTest, CodeGenLoop1) {
   CodeGenTestCheck(L"..\\CodeGenHLSL\\loop1.hlsl");
 }
 
+TEST_F(CompilerTest, CodeGenLocalConstArrayInit) {
+  CodeGenTestCheck(L"..\\CodeGenHLSL\\local_const_array_init.hlsl");
+}
+
 TEST_F(CompilerTest, CodeGenLocalRes1) {
   CodeGenTestCheck(L"..\\CodeGenHLSL\\local_resource1.hlsl");
 }
@@ -3804,6 +4877,10 @@ TEST_F(CompilerTest, CodeGenOptForNoOpt2) {
   CodeGenTestCheck(L"..\\CodeGenHLSL\\optForNoOpt2.hlsl");
 }
 
+TEST_F(CompilerTest, CodeGenOptForNoOpt5) {
+  CodeGenTestCheck(L"..\\CodeGenHLSL\\optForNoOpt5.hlsl");
+}
+
 TEST_F(CompilerTest, CodeGenOptionGis) {
   CodeGenTestCheck(L"..\\CodeGenHLSL\\option_gis.hlsl");
 }
@@ -3910,6 +4987,10 @@ TEST_F(CompilerTest, CodeGenRedundantinput1) {
   CodeGenTest(L"..\\CodeGenHLSL\\redundantinput1.hlsl");
 }
 
+TEST_F(CompilerTest, CodeGenRemoveRedundantBarriers) {
+  CodeGenTestCheck(L"..\\CodeGenHLSL\\remove_redundant_barriers.hlsl");
+}
+
 TEST_F(CompilerTest, CodeGenRes64bit) {
   CodeGenTestCheck(L"..\\CodeGenHLSL\\res64bit.hlsl");
 }
@@ -4135,6 +5216,10 @@ TEST_F(CompilerTest, CodeGenSimpleHS8) {
   CodeGenTestCheck(L"..\\CodeGenHLSL\\SimpleHS8.hlsl");
 }
 
+TEST_F(CompilerTest, CodeGenSinkResourceReads) {
+  CodeGenTestCheck(L"..\\CodeGenHLSL\\sink_resource_reads.hlsl");
+}
+
 TEST_F(CompilerTest, CodeGenSMFail) {
   CodeGenTestCheck(L"sm-fail.hlsl");
 }
@@ -4195,6 +5280,10 @@ TEST_F(CompilerTest, CodeGenStaticResource2) {
   CodeGenTest(L"..\\CodeGenHLSL\\static_resource2.hlsl");
 }
 
+TEST_F(CompilerTest, CodeGenStreamCodeGen) {
+  CodeGenTestCheck(L"..\\CodeGenHLSL\\stream_codegen.hlsl");
+}
+
 TEST_F(CompilerTest, CodeGenStruct_Buf1) {
   CodeGenTest(L"..\\CodeGenHLSL\\struct_buf1.hlsl");
 }
@@ -4207,6 +5296,10 @@ TEST_F(CompilerTest, CodeGenStruct_BufHasCounter2) {
   CodeGenTestCheck(L"..\\CodeGenHLSL\\struct_bufHasCounter2.hlsl");
 }
 
+TEST_F(CompilerTest, CodeGenStruct_BufMergeAccess) {
+  CodeGenTestCheck(L"..\\CodeGenHLSL\\structBufMergeAccess.hlsl");
+}
+
 TEST_F(CompilerTest, CodeGenStructArray) {
   CodeGenTest(L"..\\CodeGenHLSL\\structArray.hlsl");
 }
@@ -4231,6 +5324,14 @@ TEST_F(CompilerTest, CodeGenStructInBuffer3) {
   CodeGenTestCheck(L"..\\CodeGenHLSL\\structInBuffer3.hlsl");
 }
 
+TEST_F(CompilerTest, CodeGenStructNested) {
+  CodeGenTestCheck(L"..\\CodeGenHLSL\\structNested.hlsl");
+}
+
+TEST_F(CompilerTest, CodeGenStructPackedAnnotations) {
+  CodeGenTestCheck(L"..\\CodeGenHLSL\\structPackedAnnotations.hlsl");
+}
+
 TEST_F(CompilerTest, CodeGenSwitchFloat) {
   CodeGenTestCheck(L"..\\CodeGenHLSL\\switch_float.hlsl");
 }
@@ -4312,10 +5413,22 @@ TEST_F(CompilerTest, CodeGenUmaxObjectAtomic) {
   CodeGenTestCheck(L"..\\CodeGenHLSL\\umaxObjectAtomic.hlsl");
 }
 
+TEST_F(CompilerTest, CodeGenUnrollBudget) {
+  CodeGenTestCheck(L"..\\CodeGenHLSL\\unroll_budget.hlsl");
+}
+
 TEST_F(CompilerTest, CodeGenUnrollDbg) {
   CodeGenTest(L"..\\CodeGenHLSL\\unroll_dbg.hlsl");
 }
 
+TEST_F(CompilerTest, CodeGenUnrollPragmaDefault) {
+  CodeGenTestCheck(L"..\\CodeGenHLSL\\unroll_pragma_default.hlsl");
+}
+
+TEST_F(CompilerTest, CodeGenUnrollReadsDefault) {
+  CodeGenTestCheck(L"..\\CodeGenHLSL\\unroll_reads_default.hlsl");
+}
+
 TEST_F(CompilerTest, CodeGenUnsignedShortHandMatrixVector) {
   CodeGenTestCheck(L"..\\CodeGenHLSL\\unsignedShortHandMatrixVector.hlsl");
 }
@@ -5545,6 +6658,156 @@ TEST_F(CompilerTest, PreprocessWhenValidThenOK) {
     "int BAR;\n", text.c_str());
 }
 
+TEST_F(CompilerTest, PreprocessWhenReportIncludesThenReportAttached) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcOperationResult> pResult;
+  CComPtr<IDxcOperationResultReport> pResultReport;
+  CComPtr<IDxcBlobEncoding> pReport;
+  CComPtr<IDxcBlobEncoding> pSource;
+  CComPtr<TestIncludeHandler> pInclude;
+  LPCWSTR args[] = { L"-report-includes" };
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText(
+    "// First line\r\n"
+    "#include \"helper.h\"\r\n"
+    "int g_int = HELPER;", &pSource);
+
+  pInclude = new TestIncludeHandler(m_dllSupport);
+  pInclude->CallResults.emplace_back("#include \"other.h\"\r\n#define HELPER OTHER\r\n");
+  pInclude->CallResults.emplace_back("#define OTHER 1\r\n");
+
+  VERIFY_SUCCEEDED(pCompiler->Preprocess(pSource, L"file.hlsl", args,
+                                         _countof(args), nullptr, 0, pInclude,
+                                         &pResult));
+  VerifyOperationSucceeded(pResult);
+  VERIFY_SUCCEEDED(pResult.QueryInterface(&pResultReport));
+  VERIFY_SUCCEEDED(pResultReport->GetReport(&pReport));
+  VERIFY_IS_NOT_NULL(pReport.p);
+  VERIFY_ARE_EQUAL_STR(
+    "file\tincluder\tline\tfound\n"
+    "./helper.h\tfile.hlsl\t2\t1\n"
+    "./other.h\t./helper.h\t1\t1\n", BlobToUtf8(pReport).c_str());
+}
+
+TEST_F(CompilerTest, PreprocessWhenScanDepsThenIncludesListed) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcOperationResult> pResult;
+  CComPtr<IDxcBlob> pDependencies;
+  CComPtr<IDxcBlobEncoding> pSource;
+  CComPtr<TestIncludeHandler> pInclude;
+  LPCWSTR args[] = { L"-scan-deps" };
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  // Directives in comments and strings are not directives, and conditions
+  // see the macros defined by headers.
+  CreateBlobFromText(
+    "/* #include \"comment.h\"\r\n"
+    "#include \"comment.h\" */\r\n"
+    "static const string s = \"\\\r\n"
+    "#include \"string.h\"\";\r\n"
+    "#include \"helper.h\"\r\n"
+    "#if HELPER_VERSION > 1 // comment\r\n"
+    "#include \"other.h\"\r\n"
+    "#endif\r\n"
+    "#include \"helper.h\"\r\n"
+    "float4 main() : SV_Target { return 0; }", &pSource);
+
+  pInclude = new TestIncludeHandler(m_dllSupport);
+  pInclude->CallResults.emplace_back(
+    "#pragma once\r\n#define HELPER_VERSION \\\r\n  2\r\nint helper;\r\n");
+  pInclude->CallResults.emplace_back("int other;\r\n");
+
+  VERIFY_SUCCEEDED(pCompiler->Preprocess(pSource, L"file.hlsl", args,
+                                         _countof(args), nullptr, 0, pInclude,
+                                         &pResult));
+  VerifyOperationSucceeded(pResult);
+  VERIFY_SUCCEEDED(pResult->GetResult(&pDependencies));
+  VERIFY_ARE_EQUAL_STR("./helper.h\n./other.h\n",
+                       BlobToUtf8(pDependencies).c_str());
+}
+
+TEST_F(CompilerTest, CompileWhenPreprocessedThenDefinesSkipped) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcOperationResult> pResult;
+  CComPtr<IDxcBlobEncoding> pSource;
+  CComPtr<IDxcBlob> pPreprocessed;
+  DxcDefine defines[1];
+  defines[0].Name = L"RET";
+  defines[0].Value = L"float4";
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText(
+    "#define VALUE 1\r\n"
+    "RET main() : SV_Target { return VALUE; }", &pSource);
+  VERIFY_SUCCEEDED(pCompiler->Preprocess(pSource, L"file.hlsl", nullptr, 0,
+                                         defines, _countof(defines), nullptr,
+                                         &pResult));
+  VerifyOperationSucceeded(pResult);
+  VERIFY_SUCCEEDED(pResult->GetResult(&pPreprocessed));
+  pResult.Release();
+
+  // A define that would break the source if it were applied again.
+  defines[0].Name = L"main";
+  defines[0].Value = L"other";
+  LPCWSTR args[] = { L"-preprocessed" };
+  VERIFY_SUCCEEDED(pCompiler->Compile(pPreprocessed, L"file.hlsl", L"main",
+    L"ps_6_0", args, _countof(args), defines, _countof(defines), nullptr,
+    &pResult));
+  VerifyOperationSucceeded(pResult);
+}
+
+TEST_F(CompilerTest, CompileWhenBundleCapturedThenCompilesWithoutIncludeHandler) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcCompilerBundle> pCompilerBundle;
+  CComPtr<IDxcLibrary> pLibrary;
+  CComPtr<IDxcOperationResult> pResult;
+  CComPtr<IDxcBlobEncoding> pSource;
+  CComPtr<IDxcBlob> pBundle;
+  CComPtr<IDxcBlob> pTruncated;
+  CComPtr<IDxcBlob> pProgram;
+  CComPtr<IDxcBlob> pReplayed;
+  CComPtr<TestIncludeHandler> pInclude;
+  DxcDefine defines[1];
+  defines[0].Name = L"SCALE";
+  defines[0].Value = L"2";
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  VERIFY_SUCCEEDED(pCompiler.QueryInterface(&pCompilerBundle));
+  CreateBlobFromText(
+    "#include \"helper.h\"\r\n"
+    "float4 main() : SV_Target { return helper() * SCALE; }", &pSource);
+  pInclude = new TestIncludeHandler(m_dllSupport);
+  pInclude->CallResults.emplace_back("float4 helper() { return 1; }\r\n");
+
+  VERIFY_SUCCEEDED(pCompilerBundle->CompileAndCaptureBundle(
+    pSource, L"file.hlsl", L"main", L"ps_6_0", nullptr, 0, defines,
+    _countof(defines), pInclude, &pResult, nullptr, nullptr, &pBundle));
+  VerifyOperationSucceeded(pResult);
+  VERIFY_SUCCEEDED(pResult->GetResult(&pProgram));
+  VERIFY_IS_NOT_NULL(pBundle.p);
+  VERIFY_ARE_EQUAL(1U, pInclude->CallInfos.size());
+  pResult.Release();
+
+  // The bundle holds the request and the include, and compiles to the same
+  // container.
+  VERIFY_SUCCEEDED(pCompilerBundle->CompileBundle(pBundle, &pResult, nullptr,
+                                                  nullptr));
+  VerifyOperationSucceeded(pResult);
+  VERIFY_SUCCEEDED(pResult->GetResult(&pReplayed));
+  VERIFY_ARE_EQUAL(pProgram->GetBufferSize(), pReplayed->GetBufferSize());
+  VERIFY_IS_TRUE(0 == memcmp(pProgram->GetBufferPointer(),
+                             pReplayed->GetBufferPointer(),
+                             pProgram->GetBufferSize()));
+  VERIFY_ARE_EQUAL(1U, pInclude->CallInfos.size());
+  pResult.Release();
+
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcLibrary, &pLibrary));
+  VERIFY_SUCCEEDED(pLibrary->CreateBlobFromBlob(
+    pBundle, 0, pBundle->GetBufferSize() - 1, &pTruncated));
+  VERIFY_ARE_EQUAL(E_INVALIDARG, pCompilerBundle->CompileBundle(
+    pTruncated, &pResult, nullptr, nullptr));
+}
+
 TEST_F(CompilerTest, WhenSigMismatchPCFunctionThenFail) {
   CComPtr<IDxcCompiler> pCompiler;
   CComPtr<IDxcOperationResult> pResult;
@@ -5666,4 +6929,286 @@ TEST_F(CompilerTest, SingleFileCheckTest) {
   }
 
   CodeGenTestCheckBatch(filename.c_str(), 0);
+}
+
+// Compile time and memory of one test over several runs, as kept in a
+// baseline file.
+struct CompileStatsBaseline {
+  unsigned Samples;
+  double MeanSeconds;
+  double StdDevSeconds;
+  unsigned long long PeakBytes;
+};
+
+static void WriteCompileStatsBaseline(
+    LPCWSTR path, const std::map<std::string, CompileStatsBaseline> &tests) {
+  std::ofstream out(path);
+  VERIFY_IS_TRUE((bool)out);
+  out << "test\tsamples\tmean_us\tstddev_us\tpeak_bytes\n";
+  for (const auto &test : tests) {
+    out << test.first << '\t' << test.second.Samples << '\t'
+        << (unsigned long long)(test.second.MeanSeconds * 1e6) << '\t'
+        << (unsigned long long)(test.second.StdDevSeconds * 1e6) << '\t'
+        << test.second.PeakBytes << '\n';
+  }
+  VERIFY_IS_TRUE((bool)out);
+}
+
+static void ReadCompileStatsBaseline(
+    LPCWSTR path, std::map<std::string, CompileStatsBaseline> &tests) {
+  std::ifstream in(path);
+  VERIFY_IS_TRUE((bool)in);
+  std::string line;
+  std::getline(in, line);
+  while (std::getline(in, line)) {
+    llvm::SmallVector<llvm::StringRef, 8> fields;
+    llvm::StringRef(line).split(fields, "\t");
+    CompileStatsBaseline entry;
+    unsigned long long meanUs, stdDevUs;
+    if (fields.size() != 5 || fields[1].getAsInteger(10, entry.Samples) ||
+        fields[2].getAsInteger(10, meanUs) ||
+        fields[3].getAsInteger(10, stdDevUs) ||
+        fields[4].getAsInteger(10, entry.PeakBytes))
+      continue;
+    entry.MeanSeconds = meanUs / 1e6;
+    entry.StdDevSeconds = stdDevUs / 1e6;
+    tests[fields[0].str()] = entry;
+  }
+}
+
+// Whether current is slower than baseline by more than minPercent, and by
+// more than run-to-run noise explains. Welch's t statistic must exceed 3,
+// which keeps false alarms rare across a suite of hundreds of tests.
+static bool IsCompileSlowdown(const CompileStatsBaseline &baseline,
+                              const CompileStatsBaseline &current,
+                              double minPercent) {
+  if (current.MeanSeconds <= baseline.MeanSeconds * (1 + minPercent / 100))
+    return false;
+  double stdErr = std::sqrt(
+      baseline.StdDevSeconds * baseline.StdDevSeconds / baseline.Samples +
+      current.StdDevSeconds * current.StdDevSeconds / current.Samples);
+  return stdErr == 0 ||
+         (current.MeanSeconds - baseline.MeanSeconds) / stdErr > 3;
+}
+
+// Runs every FileCheck test under SuitePath (CodeGenHLSL by default) on Jobs
+// threads, each with its own DxcDllSupport. With CacheDir set, %dxc output is
+// kept there between runs and reused while the compiler and source are
+// unchanged.
+//
+// With RecordBaseline or CompareBaseline set, each test runs StatsRepeat
+// times (5 by default) uncached, and the compile time and peak memory of its
+// %dxc commands are written to, or compared against, a baseline file. Tests
+// that got slower or bigger by more than SlowdownPercent (5 by default) and
+// by more than noise explains fail. Jobs=1 keeps timings free of contention.
+TEST_F(CompilerTest, ParallelFileCheckSuite) {
+  using namespace llvm;
+  using namespace WEX::TestExecution;
+
+  ::llvm::sys::fs::MSFileSystem *msfPtr;
+  VERIFY_SUCCEEDED(CreateMSFileSystemForDisk(&msfPtr));
+  std::unique_ptr<::llvm::sys::fs::MSFileSystem> msf(msfPtr);
+  ::llvm::sys::fs::AutoPerThreadSystem pts(msf.get());
+  IFTLLVM(pts.error_code());
+
+  std::wstring suitePath = L"..\\CodeGenHLSL";
+  WEX::Common::String value;
+  if (!DXC_FAILED(RuntimeParameters::TryGetValue(L"SuitePath", value))) {
+    suitePath = value;
+  }
+  CW2A pUtf8SuitePath(suitePath.c_str());
+  if (!llvm::sys::path::is_absolute(pUtf8SuitePath.m_psz)) {
+    suitePath = hlsl_test::GetPathToHlslDataFile(suitePath.c_str());
+  }
+
+  unsigned jobs = std::thread::hardware_concurrency();
+  if (!DXC_FAILED(RuntimeParameters::TryGetValue(L"Jobs", value))) {
+    jobs = wcstoul(value, nullptr, 10);
+  }
+  if (jobs == 0)
+    jobs = 1;
+
+  std::unique_ptr<FileRunCompileCache> pCache;
+  if (!DXC_FAILED(RuntimeParameters::TryGetValue(L"CacheDir", value))) {
+    wchar_t compilerPath[MAX_PATH];
+    DWORD len = GetModuleFileNameW(GetModuleHandleW(L"dxcompiler.dll"),
+                                   compilerPath, _countof(compilerPath));
+    VERIFY_IS_TRUE(len != 0 && len < _countof(compilerPath));
+    pCache.reset(new FileRunCompileCache(value, compilerPath));
+  }
+
+  std::wstring recordBaselinePath, compareBaselinePath;
+  if (!DXC_FAILED(RuntimeParameters::TryGetValue(L"RecordBaseline", value))) {
+    recordBaselinePath = value;
+  }
+  if (!DXC_FAILED(RuntimeParameters::TryGetValue(L"CompareBaseline", value))) {
+    compareBaselinePath = value;
+  }
+  bool recordStats =
+      !recordBaselinePath.empty() || !compareBaselinePath.empty();
+  unsigned statsRepeat = 5;
+  if (!DXC_FAILED(RuntimeParameters::TryGetValue(L"StatsRepeat", value))) {
+    statsRepeat = wcstoul(value, nullptr, 10);
+  }
+  if (!recordStats || statsRepeat == 0)
+    statsRepeat = 1;
+  double slowdownPercent = 5;
+  if (!DXC_FAILED(RuntimeParameters::TryGetValue(L"SlowdownPercent", value))) {
+    slowdownPercent = wcstod(value, nullptr);
+  }
+
+  // Files without a RUN line are compile-only tests run elsewhere.
+  std::vector<std::wstring> files;
+  CW2A utf8SuitePath(suitePath.c_str());
+  std::error_code EC;
+  llvm::SmallString<128> DirNative;
+  llvm::sys::path::native(utf8SuitePath.m_psz, DirNative);
+  for (llvm::sys::fs::recursive_directory_iterator Dir(DirNative, EC), DirEnd;
+       Dir != DirEnd && !EC; Dir.increment(EC)) {
+    if (llvm::sys::path::extension(Dir->path()) != ".hlsl")
+      continue;
+    CA2W wPath(Dir->path().c_str(), CP_UTF8);
+    if (GetFirstLine(wPath.m_psz).find("RUN: ") == std::string::npos)
+      continue;
+    files.push_back(wPath.m_psz);
+  }
+
+  struct TestRun {
+    int RunResult;
+    std::string ErrorMessage;
+    double Seconds;
+    std::vector<double> CompileSeconds;
+    unsigned long long CompilePeakBytes;
+  };
+  std::vector<TestRun> runs(files.size());
+  std::atomic<size_t> nextFile(0);
+  auto startAll = std::chrono::steady_clock::now();
+  auto worker = [&]() {
+    dxc::DxcDllSupport support;
+    HRESULT hrInit = support.Initialize();
+    for (size_t i = nextFile++; i < files.size(); i = nextFile++) {
+      TestRun &run = runs[i];
+      run.CompilePeakBytes = 0;
+      auto start = std::chrono::steady_clock::now();
+      try {
+        IFT(hrInit);
+        for (unsigned n = 0; n < statsRepeat; ++n) {
+          FileRunTestResult t = FileRunTestResult::RunFromFileCommands(
+              files[i].c_str(), support, pCache.get(), recordStats);
+          run.RunResult = t.RunResult;
+          run.ErrorMessage = std::move(t.ErrorMessage);
+          if (run.RunResult != 0)
+            break;
+          run.CompileSeconds.push_back(t.CompileSeconds);
+          run.CompilePeakBytes =
+              std::max(run.CompilePeakBytes, t.CompilePeakBytes);
+        }
+      } catch (const hlsl::Exception &e) {
+        run.RunResult = 1;
+        run.ErrorMessage = "Exception while running test: " + e.msg;
+      } catch (...) {
+        run.RunResult = 1;
+        run.ErrorMessage = "Exception while running test";
+      }
+      run.Seconds = std::chrono::duration<double>(
+                        std::chrono::steady_clock::now() - start).count();
+    }
+  };
+  std::vector<std::thread> threads;
+  for (unsigned i = 1; i < jobs; ++i)
+    threads.emplace_back(worker);
+  worker();
+  for (std::thread &t : threads)
+    t.join();
+  double totalSeconds = std::chrono::duration<double>(
+                            std::chrono::steady_clock::now() - startAll).count();
+
+  // Log from this thread only, in file order.
+  unsigned failures = 0;
+  for (size_t i = 0; i < files.size(); ++i) {
+    if (runs[i].RunResult == 0)
+      continue;
+    ++failures;
+    WEX::Logging::Log::StartGroup(files[i].c_str());
+    CA2W commentWide(runs[i].ErrorMessage.c_str(), CP_UTF8);
+    WEX::Logging::Log::Comment(commentWide);
+    WEX::Logging::Log::Error(L"Run result is not zero");
+    WEX::Logging::Log::EndGroup(files[i].c_str());
+  }
+
+  std::vector<size_t> bySeconds(files.size());
+  for (size_t i = 0; i < bySeconds.size(); ++i)
+    bySeconds[i] = i;
+  std::sort(bySeconds.begin(), bySeconds.end(), [&](size_t a, size_t b) {
+    return runs[a].Seconds > runs[b].Seconds;
+  });
+  WEX::Logging::Log::Comment(L"Slowest tests:");
+  for (size_t i = 0; i < bySeconds.size() && i < 10; ++i) {
+    WEX::Logging::Log::Comment(FormatToWString(
+        L"  %.3fs %s", runs[bySeconds[i]].Seconds,
+        files[bySeconds[i]].c_str()).c_str());
+  }
+  WEX::Logging::Log::Comment(FormatToWString(
+      L"Ran %u tests on %u threads in %.3fs, %u failed.",
+      (unsigned)files.size(), jobs, totalSeconds, failures).c_str());
+
+  if (!recordStats)
+    return;
+
+  // Baselines name tests by their path under the suite, so they can be
+  // compared across enlistments.
+  std::map<std::string, CompileStatsBaseline> current;
+  for (size_t i = 0; i < files.size(); ++i) {
+    const std::vector<double> &samples = runs[i].CompileSeconds;
+    if (runs[i].RunResult != 0 || samples.empty() ||
+        runs[i].CompilePeakBytes == 0)
+      continue;
+    CompileStatsBaseline entry;
+    entry.Samples = samples.size();
+    entry.MeanSeconds = 0;
+    for (double s : samples)
+      entry.MeanSeconds += s;
+    entry.MeanSeconds /= samples.size();
+    double variance = 0;
+    for (double s : samples)
+      variance += (s - entry.MeanSeconds) * (s - entry.MeanSeconds);
+    entry.StdDevSeconds =
+        samples.size() > 1 ? std::sqrt(variance / (samples.size() - 1)) : 0;
+    entry.PeakBytes = runs[i].CompilePeakBytes;
+    CW2A relPath(files[i].c_str() + suitePath.size() + 1, CP_UTF8);
+    current[relPath.m_psz] = entry;
+  }
+
+  if (!recordBaselinePath.empty())
+    WriteCompileStatsBaseline(recordBaselinePath.c_str(), current);
+
+  if (compareBaselinePath.empty())
+    return;
+  std::map<std::string, CompileStatsBaseline> baseline;
+  ReadCompileStatsBaseline(compareBaselinePath.c_str(), baseline);
+  unsigned regressions = 0;
+  for (const auto &test : current) {
+    auto it = baseline.find(test.first);
+    if (it == baseline.end())
+      continue;
+    const CompileStatsBaseline &before = it->second;
+    const CompileStatsBaseline &after = test.second;
+    CA2W testName(test.first.c_str(), CP_UTF8);
+    if (IsCompileSlowdown(before, after, slowdownPercent)) {
+      ++regressions;
+      WEX::Logging::Log::Error(FormatToWString(
+          L"Compile time regressed from %.3fms to %.3fms: %s",
+          before.MeanSeconds * 1e3, after.MeanSeconds * 1e3,
+          testName.m_psz).c_str());
+    }
+    if (after.PeakBytes > before.PeakBytes * (1 + slowdownPercent / 100)) {
+      ++regressions;
+      WEX::Logging::Log::Error(FormatToWString(
+          L"Compile peak memory regressed from %llu to %llu bytes: %s",
+          before.PeakBytes, after.PeakBytes, testName.m_psz).c_str());
+    }
+  }
+  WEX::Logging::Log::Comment(FormatToWString(
+      L"Compared %u tests with the baseline, %u regressions.",
+      (unsigned)current.size(), regressions).c_str());
 }
\ No newline at end of file
@@ -12,6 +12,8 @@
 #include "CompilationResult.h"
 #include "HLSLTestData.h"
 #include <stdint.h>
+#include <future>
+#include <thread>
 
 #include "WexTestClass.h"
 #include "HlslTestUtils.h"
@@ -108,6 +110,11 @@ protected:
   TEST_METHOD(TUWhenRegionInactiveThenEndIsBeforeEndifHash);
   TEST_METHOD(TUWhenRegionInactiveThenStartIsAtIfdefEol);
   TEST_METHOD(TUWhenUnsaveFileThenOK);
+  TEST_METHOD(TUWhenReparseThenChangesApply);
+  TEST_METHOD(TUWhenParsedAsyncThenResultAvailable);
+  TEST_METHOD(TUWhenParseCancelledWhileQueuedThenSkipped);
+  TEST_METHOD(TUWhenCodeCompleteThenBuiltinsFiltered);
+  TEST_METHOD(CursorWhenVisitedThenMatchesChildren);
 
   TEST_METHOD(QualifiedNameClass);
   TEST_METHOD(QualifiedNameVariable);
@@ -439,6 +446,288 @@ TEST_F(DXIntellisenseTest, TUWhenUnsaveFileThenOK) {
   }
 }
 
+TEST_F(DXIntellisenseTest, TUWhenReparseThenChangesApply) {
+  const char fileName[] = "filename.hlsl";
+  char brokenProgram[] = "int f() { return undeclared; }";
+  char fixedProgram[] = "int f() { return 1; }";
+
+  HlslIntellisenseSupport support;
+  VERIFY_SUCCEEDED(support.Initialize());
+  CComPtr<IDxcIntelliSense> isense;
+  CComPtr<IDxcIndex> tuIndex;
+  CComPtr<IDxcTranslationUnit> tu;
+  CComPtr<IDxcUnsavedFile> brokenFile, fixedFile;
+  DxcTranslationUnitFlags localOptions;
+  VERIFY_SUCCEEDED(support.CreateIntellisense(&isense));
+  VERIFY_SUCCEEDED(isense->CreateIndex(&tuIndex));
+  VERIFY_SUCCEEDED(isense->GetDefaultEditingTUOptions(&localOptions));
+  VERIFY_SUCCEEDED(TrivialDxcUnsavedFile::Create(fileName, brokenProgram, &brokenFile));
+  VERIFY_SUCCEEDED(TrivialDxcUnsavedFile::Create(fileName, fixedProgram, &fixedFile));
+
+  VERIFY_SUCCEEDED(tuIndex->ParseTranslationUnit(fileName, nullptr, 0,
+    &(brokenFile.p), 1, localOptions, &tu));
+  unsigned numDiagnostics;
+  VERIFY_SUCCEEDED(tu->GetNumDiagnostics(&numDiagnostics));
+  VERIFY_ARE_EQUAL(1, numDiagnostics);
+
+  // Reparsing the same contents keeps the results.
+  VERIFY_SUCCEEDED(tu->Reparse(&(brokenFile.p), 1));
+  VERIFY_SUCCEEDED(tu->GetNumDiagnostics(&numDiagnostics));
+  VERIFY_ARE_EQUAL(1, numDiagnostics);
+
+  // Reparsing changed contents picks up the change.
+  VERIFY_SUCCEEDED(tu->Reparse(&(fixedFile.p), 1));
+  VERIFY_SUCCEEDED(tu->GetNumDiagnostics(&numDiagnostics));
+  VERIFY_ARE_EQUAL(0, numDiagnostics);
+
+  VERIFY_SUCCEEDED(tu->Reparse(&(brokenFile.p), 1));
+  VERIFY_SUCCEEDED(tu->GetNumDiagnostics(&numDiagnostics));
+  VERIFY_ARE_EQUAL(1, numDiagnostics);
+}
+
+TEST_F(DXIntellisenseTest, TUWhenParsedAsyncThenResultAvailable) {
+  const char fileName[] = "filename.hlsl";
+  char program[] = "int f() { return undeclared; }";
+
+  HlslIntellisenseSupport support;
+  VERIFY_SUCCEEDED(support.Initialize());
+  CComPtr<IDxcIntelliSense> isense;
+  CComPtr<IDxcIndex> tuIndex;
+  CComPtr<IDxcIndex2> tuIndex2;
+  CComPtr<IDxcUnsavedFile> unsavedFile;
+  DxcTranslationUnitFlags localOptions;
+  VERIFY_SUCCEEDED(support.CreateIntellisense(&isense));
+  VERIFY_SUCCEEDED(isense->CreateIndex(&tuIndex));
+  VERIFY_SUCCEEDED(tuIndex.QueryInterface(&tuIndex2));
+  VERIFY_SUCCEEDED(isense->GetDefaultEditingTUOptions(&localOptions));
+  VERIFY_SUCCEEDED(TrivialDxcUnsavedFile::Create(fileName, program, &unsavedFile));
+
+  CComPtr<IDxcParseOperation> op;
+  VERIFY_SUCCEEDED(tuIndex2->ParseTranslationUnitAsync(fileName, nullptr, 0,
+    &(unsavedFile.p), 1, localOptions, &op));
+  // The operation owns a copy of the unsaved file.
+  unsavedFile.Release();
+  VERIFY_ARE_EQUAL(S_OK, op->Wait(INFINITE));
+
+  DxcParseStatus status;
+  VERIFY_SUCCEEDED(op->GetStatus(&status));
+  VERIFY_ARE_EQUAL(DxcParseStatus_Completed, status);
+  CComPtr<IDxcTranslationUnit> tu;
+  VERIFY_SUCCEEDED(op->GetResult(&tu));
+  unsigned numDiagnostics;
+  VERIFY_SUCCEEDED(tu->GetNumDiagnostics(&numDiagnostics));
+  VERIFY_ARE_EQUAL(1, numDiagnostics);
+  // A finished operation cannot be cancelled.
+  VERIFY_ARE_EQUAL(S_FALSE, op->Cancel());
+}
+
+// An unsaved file that holds up whoever reads its contents until released.
+class BlockingDxcUnsavedFile : public TrivialDxcUnsavedFile
+{
+public:
+  std::promise<void> Entered;
+  std::promise<void> Released;
+
+  BlockingDxcUnsavedFile(LPCSTR fileName, LPCSTR contents)
+    : TrivialDxcUnsavedFile(fileName, contents) { }
+  HRESULT STDMETHODCALLTYPE GetContents(LPSTR* pContents)
+  {
+    Entered.set_value();
+    Released.get_future().wait();
+    return TrivialDxcUnsavedFile::GetContents(pContents);
+  }
+};
+
+TEST_F(DXIntellisenseTest, TUWhenParseCancelledWhileQueuedThenSkipped) {
+  const char fileName[] = "filename.hlsl";
+  char program[] = "int f() { return undeclared; }";
+
+  HlslIntellisenseSupport support;
+  VERIFY_SUCCEEDED(support.Initialize());
+  CComPtr<IDxcIntelliSense> isense;
+  CComPtr<IDxcIndex> tuIndex;
+  CComPtr<IDxcIndex2> tuIndex2;
+  CComPtr<IDxcUnsavedFile> unsavedFile;
+  DxcTranslationUnitFlags localOptions;
+  VERIFY_SUCCEEDED(support.CreateIntellisense(&isense));
+  VERIFY_SUCCEEDED(isense->CreateIndex(&tuIndex));
+  VERIFY_SUCCEEDED(tuIndex.QueryInterface(&tuIndex2));
+  VERIFY_SUCCEEDED(isense->GetDefaultEditingTUOptions(&localOptions));
+  VERIFY_SUCCEEDED(TrivialDxcUnsavedFile::Create(fileName, program, &unsavedFile));
+
+  // Parses on an index run one at a time, so a synchronous parse that is
+  // stuck reading its unsaved file keeps the background parse queued.
+  CComPtr<BlockingDxcUnsavedFile> blockingFile =
+    new BlockingDxcUnsavedFile(fileName, program);
+  CComPtr<IDxcUnsavedFile> blockingUnsavedFile;
+  VERIFY_SUCCEEDED(blockingFile.QueryInterface(&blockingUnsavedFile));
+  HRESULT blockerHr = E_PENDING;
+  std::thread blocker([&]() {
+    CComPtr<IDxcTranslationUnit> tu;
+    blockerHr = tuIndex->ParseTranslationUnit(fileName, nullptr, 0,
+      &(blockingUnsavedFile.p), 1, localOptions, &tu);
+  });
+  blockingFile->Entered.get_future().wait();
+
+  CComPtr<IDxcParseOperation> op;
+  DxcParseStatus status;
+  VERIFY_SUCCEEDED(tuIndex2->ParseTranslationUnitAsync(fileName, nullptr, 0,
+    &(unsavedFile.p), 1, localOptions, &op));
+  VERIFY_SUCCEEDED(op->GetStatus(&status));
+  VERIFY_ARE_EQUAL(DxcParseStatus_Queued, status);
+
+  // A cancelled operation releases its waiters and produces no result.
+  VERIFY_ARE_EQUAL(S_OK, op->Cancel());
+  VERIFY_ARE_EQUAL(S_OK, op->Wait(0));
+  VERIFY_SUCCEEDED(op->GetStatus(&status));
+  VERIFY_ARE_EQUAL(DxcParseStatus_Cancelled, status);
+  CComPtr<IDxcTranslationUnit> cancelledTU;
+  VERIFY_ARE_EQUAL(E_ABORT, op->GetResult(&cancelledTU));
+  VERIFY_IS_NULL(cancelledTU.p);
+
+  // Freeing the index doesn't bring the cancelled operation back.
+  blockingFile->Released.set_value();
+  blocker.join();
+  VERIFY_SUCCEEDED(blockerHr);
+  VERIFY_ARE_EQUAL(S_FALSE, op->Cancel());
+  VERIFY_SUCCEEDED(op->GetStatus(&status));
+  VERIFY_ARE_EQUAL(DxcParseStatus_Cancelled, status);
+}
+
+static bool HasCompletion(IDxcCompletionResults *results, const char *name,
+                          DxcCompletionKind kind) {
+  unsigned count;
+  VERIFY_SUCCEEDED(results->GetCount(&count));
+  for (unsigned i = 0; i < count; ++i) {
+    CComHeapPtr<char> text;
+    DxcCompletionKind textKind;
+    VERIFY_SUCCEEDED(results->GetResult(i, &text, &textKind));
+    if (0 == strcmp(name, text) && kind == textKind)
+      return true;
+  }
+  return false;
+}
+
+TEST_F(DXIntellisenseTest, TUWhenCodeCompleteThenBuiltinsFiltered) {
+  const char fileName[] = "filename.hlsl";
+  char program[] =
+    "float saturation;\n"
+    "float4 main() : SV_Target {\n"
+    "  return sa\n"
+    "}";
+
+  HlslIntellisenseSupport support;
+  VERIFY_SUCCEEDED(support.Initialize());
+  CComPtr<IDxcIntelliSense> isense;
+  CComPtr<IDxcIndex> tuIndex;
+  CComPtr<IDxcTranslationUnit> tu;
+  CComPtr<IDxcTranslationUnit2> tu2;
+  CComPtr<IDxcUnsavedFile> unsavedFile;
+  DxcTranslationUnitFlags localOptions;
+  VERIFY_SUCCEEDED(support.CreateIntellisense(&isense));
+  VERIFY_SUCCEEDED(isense->CreateIndex(&tuIndex));
+  VERIFY_SUCCEEDED(isense->GetDefaultEditingTUOptions(&localOptions));
+  VERIFY_SUCCEEDED(TrivialDxcUnsavedFile::Create(fileName, program, &unsavedFile));
+  VERIFY_SUCCEEDED(tuIndex->ParseTranslationUnit(fileName, nullptr, 0,
+    &(unsavedFile.p), 1, localOptions, &tu));
+  VERIFY_SUCCEEDED(tu.QueryInterface(&tu2));
+
+  // Intrinsics and object types are offered before the source uses them.
+  CComPtr<IDxcCompletionResults> all;
+  VERIFY_SUCCEEDED(tu2->CodeCompleteAt(3, 10, &(unsavedFile.p), 1, nullptr, &all));
+  VERIFY_IS_TRUE(HasCompletion(all, "saturate", DxcCompletionKind_Intrinsic));
+  VERIFY_IS_TRUE(HasCompletion(all, "Texture2D", DxcCompletionKind_ObjectType));
+  VERIFY_IS_TRUE(HasCompletion(all, "saturation", DxcCompletionKind_Declaration));
+
+  CComPtr<IDxcCompletionResults> sa, sat, saturati;
+  VERIFY_SUCCEEDED(tu2->CodeCompleteAt(3, 10, &(unsavedFile.p), 1, "sa", &sa));
+  VERIFY_IS_FALSE(HasCompletion(sa, "Texture2D", DxcCompletionKind_ObjectType));
+  VERIFY_IS_TRUE(HasCompletion(sa, "sampler", DxcCompletionKind_ObjectType));
+  VERIFY_SUCCEEDED(sa->Filter("SAT", &sat));
+  VERIFY_IS_FALSE(HasCompletion(sat, "sampler", DxcCompletionKind_ObjectType));
+  VERIFY_IS_TRUE(HasCompletion(sat, "saturate", DxcCompletionKind_Intrinsic));
+  VERIFY_IS_TRUE(HasCompletion(sat, "saturation", DxcCompletionKind_Declaration));
+  VERIFY_SUCCEEDED(sat->Filter("saturati", &saturati));
+  unsigned count;
+  VERIFY_SUCCEEDED(saturati->GetCount(&count));
+  VERIFY_ARE_EQUAL(1, count);
+
+  // Filtering doesn't change the results it starts from.
+  unsigned allCount, saCount;
+  VERIFY_SUCCEEDED(all->GetCount(&allCount));
+  VERIFY_SUCCEEDED(sa->GetCount(&saCount));
+  VERIFY_IS_TRUE(saCount < allCount);
+  VERIFY_IS_TRUE(HasCompletion(sa, "sampler", DxcCompletionKind_ObjectType));
+}
+
+static DxcChildVisitResult STDMETHODCALLTYPE CollectCursorVisit(
+    const DxcCursorValue *cursor, const DxcCursorValue *, void *context) {
+  ((std::vector<DxcCursorValue> *)context)->push_back(*cursor);
+  return DxcChildVisit_Continue;
+}
+
+static DxcChildVisitResult STDMETHODCALLTYPE CountCursorVisit(
+    const DxcCursorValue *, const DxcCursorValue *, void *context) {
+  ++*(unsigned *)context;
+  return DxcChildVisit_Recurse;
+}
+
+static DxcChildVisitResult STDMETHODCALLTYPE BreakCursorVisit(
+    const DxcCursorValue *, const DxcCursorValue *, void *context) {
+  ++*(unsigned *)context;
+  return DxcChildVisit_Break;
+}
+
+TEST_F(DXIntellisenseTest, CursorWhenVisitedThenMatchesChildren) {
+  char program[] =
+    "int a;\r\n"
+    "int f() { return a; }";
+  CompilationResult result(CompilationResult::CreateForProgram(program, _countof(program)));
+  CComPtr<IDxcCursor> tuCursor;
+  CComPtr<IDxcCursor2> tuCursor2;
+  VERIFY_SUCCEEDED(result.TU->GetCursor(&tuCursor));
+  VERIFY_SUCCEEDED(tuCursor.QueryInterface(&tuCursor2));
+
+  // Visiting without recursion finds the same cursors as GetChildren.
+  std::vector<DxcCursorValue> values;
+  BOOL broken;
+  VERIFY_SUCCEEDED(tuCursor2->VisitChildren(CollectCursorVisit, &values, &broken));
+  VERIFY_IS_FALSE(broken);
+  CComInterfaceArray<IDxcCursor> cursors;
+  VERIFY_SUCCEEDED(tuCursor->GetChildren(0, 64, cursors.size_ref(), cursors.data_ref()));
+  VERIFY_ARE_EQUAL((size_t)cursors.size(), values.size());
+  for (unsigned i = 0; i < values.size(); ++i) {
+    IDxcCursor *pChild = cursors.begin()[i];
+    CComPtr<IDxcCursor> valueCursor;
+    BOOL isEqual;
+    VERIFY_SUCCEEDED(tuCursor2->CreateCursor(&values[i], &valueCursor));
+    VERIFY_SUCCEEDED(valueCursor->IsEqualTo(pChild, &isEqual));
+    VERIFY_IS_TRUE(isEqual);
+
+    DxcCursorKind kind;
+    VERIFY_SUCCEEDED(pChild->GetKind(&kind));
+    VERIFY_ARE_EQUAL(kind, values[i].kind);
+
+    CComPtr<IDxcSourceRange> range;
+    unsigned start, end, valueStart, valueEnd;
+    VERIFY_SUCCEEDED(pChild->GetExtent(&range));
+    VERIFY_SUCCEEDED(range->GetOffsets(&start, &end));
+    VERIFY_SUCCEEDED(tuCursor2->GetValueExtentOffsets(&values[i], &valueStart, &valueEnd));
+    VERIFY_ARE_EQUAL(start, valueStart);
+    VERIFY_ARE_EQUAL(end, valueEnd);
+  }
+
+  // Recursing reaches the nested cursors too.
+  unsigned count = 0;
+  VERIFY_SUCCEEDED(tuCursor2->VisitChildren(CountCursorVisit, &count, nullptr));
+  VERIFY_IS_GREATER_THAN(count, (unsigned)values.size());
+
+  count = 0;
+  VERIFY_SUCCEEDED(tuCursor2->VisitChildren(BreakCursorVisit, &count, &broken));
+  VERIFY_IS_TRUE(broken);
+  VERIFY_ARE_EQUAL(1, count);
+}
+
 TEST_F(DXIntellisenseTest, QualifiedNameClass) {
   char program[] =
     "class TheClass {\r\n"
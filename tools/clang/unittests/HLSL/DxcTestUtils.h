@@ -51,6 +51,26 @@ public:
   int Run();
 };
 
+/// Keeps the output of %dxc commands on disk between runs, keyed by a hash
+/// of the compiler binary, the arguments and the source text.
+class FileRunCompileCache {
+public:
+  FileRunCompileCache(LPCWSTR cacheDir, LPCWSTR compilerPath);
+
+  /// Computes the key for compiling fileName with arguments; returns false
+  /// if the result can't be cached, eg because the source has includes.
+  bool GetKey(LPCWSTR fileName, const std::string &arguments,
+              std::string &key);
+  bool Lookup(const std::string &key, int &runResult, std::string &stdOut,
+              std::string &stdErr);
+  void Store(const std::string &key, int runResult, const std::string &stdOut,
+             const std::string &stdErr);
+
+private:
+  std::wstring m_cacheDir;
+  std::string m_compilerHash;
+};
+
 class FileRunCommandPart {
 private:
   void RunFileChecker(const FileRunCommandPart *Prior);
@@ -73,12 +93,16 @@ public:
   LPCWSTR CommandFileName;  // File name replacement for %s
 
   dxc::DxcDllSupport *DllSupport; // DLL support to use for Run().
+  FileRunCompileCache *CompileCache; // Cache for %dxc output, if any.
+  bool RecordCompileStats; // Whether %dxc fills in the compile stats below.
 
   // These fields are set after an invocation to Run().
   CComPtr<IDxcOperationResult> OpResult;  // The operation result, if any.
   int RunResult;                          // The exit code for the operation.
   std::string StdOut;                     // Standard output text.
   std::string StdErr;                     // Standard error text.
+  double CompileSeconds;                  // Wall time of the compile.
+  unsigned long long CompilePeakBytes;    // Peak memory of the compile.
 };
 
 void ParseCommandParts(LPCSTR commands, LPCWSTR fileName, std::vector<FileRunCommandPart> &parts);
@@ -88,8 +112,15 @@ class FileRunTestResult {
 public:
   std::string ErrorMessage;
   int RunResult;
+  // With recordCompileStats, the total wall time and largest peak memory of
+  // the %dxc commands, bypassing any compile cache.
+  double CompileSeconds;
+  unsigned long long CompilePeakBytes;
   static FileRunTestResult RunFromFileCommands(LPCWSTR fileName);
   static FileRunTestResult RunFromFileCommands(LPCWSTR fileName, dxc::DxcDllSupport &dllSupport);
+  static FileRunTestResult RunFromFileCommands(LPCWSTR fileName, dxc::DxcDllSupport &dllSupport,
+                                               FileRunCompileCache *pCache,
+                                               bool recordCompileStats = false);
 };
 
 inline std::string BlobToUtf8(_In_ IDxcBlob *pBlob) {
@@ -31,8 +31,13 @@
 
 #include "dxc/Support/Global.h"
 #include "dxc/Support/dxcapi.use.h"
+#include "dxc/Support/FileIOHelper.h"
 #include "dxc/Support/HLSLOptions.h"
+#include "dxc/HLSL/DxilCompression.h"
 #include "dxc/HLSL/DxilContainer.h"
+#include "dxc/HLSL/DxilPipelineStateValidation.h"
+#include "dxc/HLSL/DxilRootSignature.h"
+#include "llvm/Support/raw_ostream.h"
 
 #include <fstream>
 #include <filesystem>
@@ -66,17 +71,33 @@ public:
   END_TEST_CLASS()
 
   TEST_METHOD(CompileWhenDebugSourceThenSourceMatters)
+  TEST_METHOD(CompileWhenDebugAndRootSignatureThenPartsMatch)
+  TEST_METHOD(CompileWhenDebugCompressedThenBitcodeMatches)
+  TEST_METHOD(DecompressWhenSizeImplausibleThenFails)
   TEST_METHOD(CompileWhenOKThenIncludesFeatureInfo)
+  TEST_METHOD(CompileWhenOKThenIncludesShaderHash)
+  TEST_METHOD(CompileWhenOKThenPSVIncludesNames)
+  TEST_METHOD(CompileWhenOKThenPSVIncludesUsedRanges)
+  TEST_METHOD(ContainerWhenMappedThenLoads)
+  TEST_METHOD(ArchiveWhenPartsMatchThenStoredOnce)
   TEST_METHOD(CompileWhenOKThenIncludesSignatures)
   TEST_METHOD(CompileWhenSigSquareThenIncludeSplit)
   TEST_METHOD(DisassemblyWhenMissingThenFails)
   TEST_METHOD(DisassemblyWhenBCInvalidThenFails)
   TEST_METHOD(DisassemblyWhenInvalidThenFails)
   TEST_METHOD(DisassemblyWhenValidThenOK)
+  TEST_METHOD(DisassemblyWhenStreamedThenFiltered)
+  TEST_METHOD(CompileWhenToStreamsThenMatchesBlobs)
+  TEST_METHOD(RootSignatureWhenEqualThenInterned)
+  TEST_METHOD(RootSignatureWhenTextRepeatsThenCompiledOnce)
+  TEST_METHOD(RootSignatureWhenCheckedOnceThenMatchesShaders)
   TEST_METHOD(ValidateFromLL_Abs2)
   TEST_METHOD(DxilContainerUnitTest)
 
   TEST_METHOD(ReflectionMatchesDXBC_CheckIn)
+  TEST_METHOD(ReflectionWhenUsageQueriedLastThenMatches)
+  TEST_METHOD(ReflectionWhenDescQueriedThenIncludesCost)
+  TEST_METHOD(ReflectionWhenTypesRepeatThenShared)
   BEGIN_TEST_METHOD(ReflectionMatchesDXBC_Full)
     TEST_METHOD_PROPERTY(L"Priority", L"1")
   END_TEST_METHOD()
@@ -435,6 +456,37 @@ public:
     return Major == 1 && (Minor >= 1);
   }
 
+  bool DoesValidatorSupportShaderHash() {
+    CComPtr<IDxcVersionInfo> pVersionInfo;
+    UINT Major, Minor;
+    HRESULT hrVer = m_dllSupport.CreateInstance(CLSID_DxcValidator, &pVersionInfo);
+    if (hrVer == E_NOINTERFACE) return false;
+    VERIFY_SUCCEEDED(hrVer);
+    VERIFY_SUCCEEDED(pVersionInfo->GetVersion(&Major, &Minor));
+    return Major == 1 && (Minor >= 4);
+  }
+
+  std::string CompileToShaderHash(LPCSTR program, LPCWSTR entryPoint,
+                                  LPCWSTR target, LPCWSTR *pArguments,
+                                  UINT32 argCount) {
+    CComPtr<IDxcBlob> pProgram;
+    CComPtr<IDxcBlob> pHashBlob;
+    CComPtr<IDxcContainerReflection> pContainer;
+    UINT32 index;
+
+    CompileToProgram(program, entryPoint, target, pArguments, argCount, &pProgram);
+    VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcContainerReflection, &pContainer));
+    VERIFY_SUCCEEDED(pContainer->Load(pProgram));
+    if (FAILED(pContainer->FindFirstPartKind(hlsl::DFCC_ShaderHash, &index))) {
+      return std::string();
+    }
+    VERIFY_SUCCEEDED(pContainer->GetPartContent(index, &pHashBlob));
+    VERIFY_ARE_EQUAL(sizeof(hlsl::DxilShaderHash), pHashBlob->GetBufferSize());
+    const hlsl::DxilShaderHash *pHash = (hlsl::DxilShaderHash *)pHashBlob->GetBufferPointer();
+    VERIFY_ARE_EQUAL(0, pHash->Flags);
+    return std::string((const char *)pHash->Digest, hlsl::DxilShaderHashSize);
+  }
+
   std::string CompileToDebugName(LPCSTR program, LPCWSTR entryPoint,
                                  LPCWSTR target, LPCWSTR *pArguments, UINT32 argCount) {
     CComPtr<IDxcBlob> pProgram;
@@ -558,6 +610,155 @@ TEST_F(DxilContainerTest, CompileWhenDebugSourceThenSourceMatters) {
   VERIFY_IS_FALSE(0 == strcmp(sourceName1Zss.c_str(), binName1.c_str()));
 }
 
+TEST_F(DxilContainerTest, CompileWhenDebugAndRootSignatureThenPartsMatch) {
+  // With a root signature, the debug module is written alongside the other
+  // parts; they should come out as they do without debug info.
+  char program[] =
+    "[RootSignature(\"CBV(b0), DescriptorTable(SRV(t0, numDescriptors=2))\")]\n"
+    "float4 main(float4 pos : SV_Position) : SV_Target { return pos; }";
+  LPCWSTR Zi[] = { L"/Zi" };
+  CComPtr<IDxcBlob> pProgram;
+  CComPtr<IDxcBlob> pProgramZi;
+  CompileToProgram(program, L"main", L"ps_6_0", nullptr, 0, &pProgram);
+  CompileToProgram(program, L"main", L"ps_6_0", Zi, _countof(Zi), &pProgramZi);
+
+  const hlsl::DxilContainerHeader *pContainer = hlsl::IsDxilContainerLike(
+      pProgram->GetBufferPointer(), pProgram->GetBufferSize());
+  const hlsl::DxilContainerHeader *pContainerZi = hlsl::IsDxilContainerLike(
+      pProgramZi->GetBufferPointer(), pProgramZi->GetBufferSize());
+  VERIFY_IS_NOT_NULL(pContainer);
+  VERIFY_IS_NOT_NULL(pContainerZi);
+  VERIFY_IS_NOT_NULL(
+      hlsl::GetDxilPartByType(pContainerZi, hlsl::DFCC_ShaderDebugInfoDXIL));
+
+  const hlsl::DxilFourCC fourCCs[] = {
+      hlsl::DFCC_FeatureInfo, hlsl::DFCC_InputSignature,
+      hlsl::DFCC_OutputSignature, hlsl::DFCC_PipelineStateValidation,
+      hlsl::DFCC_RootSignature, hlsl::DFCC_DXIL};
+  for (hlsl::DxilFourCC fourCC : fourCCs) {
+    const hlsl::DxilPartHeader *pPart =
+        hlsl::GetDxilPartByType(pContainer, fourCC);
+    const hlsl::DxilPartHeader *pPartZi =
+        hlsl::GetDxilPartByType(pContainerZi, fourCC);
+    VERIFY_IS_NOT_NULL(pPart);
+    VERIFY_IS_NOT_NULL(pPartZi);
+    VERIFY_ARE_EQUAL(pPart->PartSize, pPartZi->PartSize);
+    VERIFY_ARE_EQUAL(0, memcmp(hlsl::GetDxilPartData(pPart),
+                               hlsl::GetDxilPartData(pPartZi),
+                               pPart->PartSize));
+  }
+}
+
+TEST_F(DxilContainerTest, CompileWhenDebugCompressedThenBitcodeMatches) {
+  char program[] =
+    "float4 main(float4 pos : SV_Position) : SV_Target {\n"
+    "  float4 r = pos;\n"
+    "  for (int i = 0; i < 4; ++i) r = r * pos + i;\n"
+    "  return r;\n"
+    "}";
+  LPCWSTR Zi[] = { L"/Zi" };
+  LPCWSTR ZiCompressed[] = { L"/Zi", L"/Qcompress_debug" };
+  CComPtr<IDxcBlob> pProgram;
+  CComPtr<IDxcBlob> pProgramCompressed;
+  CompileToProgram(program, L"main", L"ps_6_0", Zi, _countof(Zi), &pProgram);
+  CompileToProgram(program, L"main", L"ps_6_0", ZiCompressed,
+                   _countof(ZiCompressed), &pProgramCompressed);
+
+  const hlsl::DxilPartHeader *pPart = hlsl::GetDxilPartByType(
+      hlsl::IsDxilContainerLike(pProgram->GetBufferPointer(),
+                                pProgram->GetBufferSize()),
+      hlsl::DFCC_ShaderDebugInfoDXIL);
+  const hlsl::DxilPartHeader *pPartCompressed = hlsl::GetDxilPartByType(
+      hlsl::IsDxilContainerLike(pProgramCompressed->GetBufferPointer(),
+                                pProgramCompressed->GetBufferSize()),
+      hlsl::DFCC_ShaderDebugInfoDXIL);
+  VERIFY_IS_NOT_NULL(pPart);
+  VERIFY_IS_NOT_NULL(pPartCompressed);
+  const hlsl::DxilProgramHeader *pHeader =
+      (const hlsl::DxilProgramHeader *)hlsl::GetDxilPartData(pPart);
+  const hlsl::DxilProgramHeader *pHeaderCompressed =
+      (const hlsl::DxilProgramHeader *)hlsl::GetDxilPartData(pPartCompressed);
+  VERIFY_IS_FALSE(
+      hlsl::IsCompressedDxilProgramHeader(pHeader, pPart->PartSize));
+  VERIFY_IS_TRUE(hlsl::IsCompressedDxilProgramHeader(
+      pHeaderCompressed, pPartCompressed->PartSize));
+  VERIFY_IS_TRUE(pPartCompressed->PartSize < pPart->PartSize);
+
+  // The part decompresses to the bitcode written without compression.
+  std::vector<char> storage;
+  const char *pBitcode, *pBitcodeCompressed;
+  uint32_t bitcodeLength, bitcodeLengthCompressed;
+  VERIFY_IS_TRUE(hlsl::GetDecompressedDxilProgramBitcode(
+      pHeader, pPart->PartSize, storage, &pBitcode, &bitcodeLength));
+  VERIFY_IS_TRUE(storage.empty());
+  VERIFY_IS_TRUE(hlsl::GetDecompressedDxilProgramBitcode(
+      pHeaderCompressed, pPartCompressed->PartSize, storage,
+      &pBitcodeCompressed, &bitcodeLengthCompressed));
+  VERIFY_ARE_EQUAL(bitcodeLength, bitcodeLengthCompressed);
+  VERIFY_ARE_EQUAL(0, memcmp(pBitcode, pBitcodeCompressed, bitcodeLength));
+
+  // Tools reading the debug module see the same one.
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcBlobEncoding> pDisassembly;
+  CComPtr<IDxcBlobEncoding> pDisassemblyCompressed;
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  VERIFY_SUCCEEDED(pCompiler->Disassemble(pProgram, &pDisassembly));
+  VERIFY_SUCCEEDED(
+      pCompiler->Disassemble(pProgramCompressed, &pDisassemblyCompressed));
+  VERIFY_ARE_EQUAL(BlobToUtf8(pDisassembly),
+                   BlobToUtf8(pDisassemblyCompressed));
+}
+
+TEST_F(DxilContainerTest, DecompressWhenSizeImplausibleThenFails) {
+  std::string data(1000, 'a');
+  std::vector<char> compressed, decompressed;
+  hlsl::CompressLZ(data.data(), data.size(), compressed);
+  VERIFY_IS_TRUE(hlsl::DecompressLZ(compressed.data(), compressed.size(),
+                                    data.size(), decompressed));
+  VERIFY_IS_TRUE(std::string(decompressed.begin(), decompressed.end()) == data);
+
+  // A size the input can't expand to is rejected before any memory is
+  // reserved for it.
+  VERIFY_IS_FALSE(hlsl::DecompressLZ(compressed.data(), compressed.size(),
+                                     UINT32_MAX, decompressed));
+  VERIFY_IS_TRUE(decompressed.capacity() < UINT32_MAX);
+}
+
+TEST_F(DxilContainerTest, CompileWhenOKThenIncludesShaderHash) {
+  char program1[] = "float4 main() : SV_Target { return 0; }";
+  char program2[] = "  float4 main() : SV_Target { return 0; }  ";
+  char program3[] = "float4 main() : SV_Target { return 1; }";
+  LPCWSTR Zi[] = { L"/Zi" };
+  LPCWSTR ZiZsb[] = { L"/Zi", L"/Zsb" };
+
+  if (!DoesValidatorSupportShaderHash())
+    return;
+
+  std::string hash1 = CompileToShaderHash(program1, L"main", L"ps_6_0", nullptr, 0);
+  VERIFY_ARE_EQUAL(hlsl::DxilShaderHashSize, hash1.size());
+
+  // Debug info and source layout don't change the hash.
+  std::string hash1Zi = CompileToShaderHash(program1, L"main", L"ps_6_0", Zi, _countof(Zi));
+  VERIFY_IS_TRUE(hash1 == hash1Zi);
+  std::string hash2Zi = CompileToShaderHash(program2, L"main", L"ps_6_0", Zi, _countof(Zi));
+  VERIFY_IS_TRUE(hash1 == hash2Zi);
+
+  // A different program hashes differently.
+  std::string hash3 = CompileToShaderHash(program3, L"main", L"ps_6_0", nullptr, 0);
+  VERIFY_IS_FALSE(hash1 == hash3);
+
+  // The binary debug name is the same digest.
+  std::string binName1 = CompileToDebugName(program1, L"main", L"ps_6_0", ZiZsb, _countof(ZiZsb));
+  std::string hashName;
+  for (unsigned char c : hash1) {
+    char hex[3];
+    sprintf_s(hex, _countof(hex), "%02x", c);
+    hashName += hex;
+  }
+  hashName += ".lld";
+  VERIFY_ARE_EQUAL_STR(hashName.c_str(), binName1.c_str());
+}
+
 TEST_F(DxilContainerTest, CompileWhenOKThenIncludesSignatures) {
   char program[] =
     "struct PSInput {\r\n"
@@ -674,6 +875,201 @@ TEST_F(DxilContainerTest, CompileWhenOKThenIncludesFeatureInfo) {
   VERIFY_ARE_EQUAL(0, *(uint64_t *)hlsl::GetDxilPartData(*pPartIter));
 }
 
+TEST_F(DxilContainerTest, ContainerWhenMappedThenLoads) {
+  CComPtr<IDxcBlob> pProgram;
+  CompileToProgram("float4 main() : SV_Target { return 0; }", L"main",
+                   L"ps_6_0", nullptr, 0, &pProgram);
+
+  wchar_t TempPath[MAX_PATH];
+  VERIFY_WIN32_BOOL_SUCCEEDED(GetTempPathW(MAX_PATH, TempPath) != 0);
+  std::wstring FileName(TempPath);
+  FileName += L"DxilContainerTest_mapped.cso";
+  hlsl::WriteBinaryFile(FileName.c_str(), pProgram->GetBufferPointer(),
+                        pProgram->GetBufferSize());
+
+  {
+    CComPtr<IDxcBlobEncoding> pMapped;
+    VERIFY_SUCCEEDED(hlsl::DxcCreateBlobFromFileMapped(FileName.c_str(),
+                                                       nullptr, &pMapped));
+    VERIFY_ARE_EQUAL(pProgram->GetBufferSize(), pMapped->GetBufferSize());
+    VERIFY_ARE_EQUAL(0, memcmp(pProgram->GetBufferPointer(),
+                               pMapped->GetBufferPointer(),
+                               pProgram->GetBufferSize()));
+
+    // Parts are views into the mapping rather than copies.
+    CComPtr<IDxcContainerReflection> pReflection;
+    CComPtr<IDxcBlob> pPart;
+    UINT32 partIdx;
+    VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcContainerReflection,
+                                                 &pReflection));
+    VERIFY_SUCCEEDED(pReflection->Load(pMapped));
+    VERIFY_SUCCEEDED(pReflection->FindFirstPartKind(hlsl::DFCC_DXIL, &partIdx));
+    VERIFY_SUCCEEDED(pReflection->GetPartContent(partIdx, &pPart));
+    const BYTE *pBegin = (const BYTE *)pMapped->GetBufferPointer();
+    const BYTE *pPartData = (const BYTE *)pPart->GetBufferPointer();
+    VERIFY_IS_TRUE(pBegin <= pPartData &&
+                   pPartData + pPart->GetBufferSize() <=
+                       pBegin + pMapped->GetBufferSize());
+
+    CComPtr<IDxcContainerBuilder> pBuilder;
+    CComPtr<IDxcOperationResult> pResult;
+    CComPtr<IDxcBlob> pRebuilt;
+    VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcContainerBuilder,
+                                                 &pBuilder));
+    VERIFY_SUCCEEDED(pBuilder->Load(pMapped));
+    VERIFY_SUCCEEDED(pBuilder->SerializeContainer(&pResult));
+    VERIFY_SUCCEEDED(pResult->GetResult(&pRebuilt));
+    VERIFY_ARE_EQUAL(pProgram->GetBufferSize(), pRebuilt->GetBufferSize());
+  }
+
+  // The view is released with the blob.
+  VERIFY_WIN32_BOOL_SUCCEEDED(DeleteFileW(FileName.c_str()));
+}
+
+TEST_F(DxilContainerTest, ArchiveWhenPartsMatchThenStoredOnce) {
+  const char program[] = "float4 main() : SV_Target { return 0; }";
+  const char other[] = "float4 main() : SV_Target { return 1; }";
+  const char *keys[] = { "first", "second", "other" };
+  CComPtr<IDxcBlob> pPrograms[3];
+  CompileToProgram(program, L"main", L"ps_6_0", nullptr, 0, &pPrograms[0]);
+  CompileToProgram(program, L"main", L"ps_6_0", nullptr, 0, &pPrograms[1]);
+  CompileToProgram(other, L"main", L"ps_6_0", nullptr, 0, &pPrograms[2]);
+
+  std::unique_ptr<hlsl::DxilArchiveWriter> pWriter(hlsl::NewDxilArchiveWriter());
+  uint32_t partRefCount = 0;
+  uint32_t partCounts[_countof(keys)];
+  for (unsigned i = 0; i < _countof(keys); ++i) {
+    const hlsl::DxilContainerHeader *pContainer =
+        (const hlsl::DxilContainerHeader *)pPrograms[i]->GetBufferPointer();
+    pWriter->AddContainer(keys[i], (uint32_t)strlen(keys[i]), pContainer);
+    partCounts[i] = pContainer->PartCount;
+    partRefCount += pContainer->PartCount;
+  }
+
+  CComPtr<IMalloc> pMalloc;
+  CComPtr<hlsl::AbstractMemoryStream> pStream;
+  VERIFY_SUCCEEDED(CoGetMalloc(1, &pMalloc));
+  VERIFY_SUCCEEDED(hlsl::CreateMemoryStream(pMalloc, &pStream));
+  pWriter->write(pStream);
+  VERIFY_ARE_EQUAL(pWriter->size(), (uint64_t)pStream->GetPtrSize());
+
+  const hlsl::DxilArchiveHeader *pArchive =
+      hlsl::IsDxilArchiveLike(pStream->GetPtr(), pStream->GetPtrSize());
+  VERIFY_IS_TRUE(hlsl::IsValidDxilArchive(pArchive, pStream->GetPtrSize()));
+  VERIFY_ARE_EQUAL(3, pArchive->EntryCount);
+  VERIFY_ARE_EQUAL(partRefCount, pArchive->PartRefCount);
+  // The second container is identical to the first, so adds no parts.
+  VERIFY_IS_TRUE(pArchive->PartCount <= partRefCount - partCounts[1]);
+
+  for (unsigned i = 0; i < _countof(keys); ++i) {
+    const hlsl::DxilArchiveEntry *pEntry = hlsl::FindDxilArchiveEntry(
+        pArchive, keys[i], (uint32_t)strlen(keys[i]));
+    VERIFY_IS_NOT_NULL(pEntry);
+    VERIFY_ARE_EQUAL(0, strcmp(keys[i],
+                               hlsl::GetDxilArchiveEntryKey(pArchive, pEntry)));
+    uint32_t size = hlsl::GetDxilArchiveEntryContainerSize(pArchive, pEntry);
+    VERIFY_ARE_EQUAL(pPrograms[i]->GetBufferSize(), (size_t)size);
+    std::vector<uint8_t> container(size);
+    hlsl::CopyDxilArchiveEntryContainer(pArchive, pEntry, container.data());
+    VERIFY_ARE_EQUAL(0, memcmp(container.data(),
+                               pPrograms[i]->GetBufferPointer(), size));
+  }
+  VERIFY_IS_NULL(hlsl::FindDxilArchiveEntry(pArchive, "missing", 7));
+}
+
+TEST_F(DxilContainerTest, CompileWhenOKThenPSVIncludesNames) {
+  const char program[] =
+    "cbuffer C { float4 first; float second; };\n"
+    "RWBuffer<float> U;\n"
+    "[numthreads(4, 2, 1)] void main() { U[0] = first.x + second; }";
+  CComPtr<IDxcBlob> pProgram;
+  CompileToProgram(program, L"main", L"cs_6_0", nullptr, 0, &pProgram);
+
+  hlsl::DxilContainerHeader *pHeader =
+      (hlsl::DxilContainerHeader *)pProgram->GetBufferPointer();
+  hlsl::DxilPartIterator pPartIter =
+      std::find_if(hlsl::begin(pHeader), hlsl::end(pHeader),
+                   hlsl::DxilPartIsType(hlsl::DFCC_PipelineStateValidation));
+  VERIFY_ARE_NOT_EQUAL(hlsl::end(pHeader), pPartIter);
+  DxilPipelineStateValidation PSV;
+  VERIFY_IS_TRUE(PSV.InitFromPSV0(hlsl::GetDxilPartData(*pPartIter),
+                                  (*pPartIter)->PartSize));
+  // Older validators produce an earlier PSV version.
+  if (PSV.GetPSVRuntimeInfo2() == nullptr)
+    return;
+
+  PSVRuntimeInfo2 *pInfo = PSV.GetPSVRuntimeInfo2();
+  VERIFY_ARE_EQUAL(4, pInfo->NumThreadsX);
+  VERIFY_ARE_EQUAL(2, pInfo->NumThreadsY);
+  VERIFY_ARE_EQUAL(1, pInfo->NumThreadsZ);
+
+  const PSVStringTable &strings = PSV.GetStringTable();
+  VERIFY_ARE_EQUAL(2, PSV.GetBindCount());
+  PSVResourceBindInfo1 *pCB = PSV.GetPSVResourceBindInfo1(0);
+  PSVResourceBindInfo1 *pUAV = PSV.GetPSVResourceBindInfo1(1);
+  VERIFY_IS_NOT_NULL(pCB);
+  VERIFY_IS_NOT_NULL(pUAV);
+  VERIFY_ARE_EQUAL_STR("C", strings.Get(pCB->Name));
+  VERIFY_ARE_EQUAL_STR("U", strings.Get(pUAV->Name));
+  VERIFY_ARE_EQUAL(32, pCB->Size);
+  VERIFY_ARE_EQUAL(2, pCB->VariableCount);
+
+  PSVCBufferVariable0 *pFirst = PSV.GetCBufferVariable0(pCB->VariableStart);
+  PSVCBufferVariable0 *pSecond = PSV.GetCBufferVariable0(pCB->VariableStart + 1);
+  VERIFY_IS_NOT_NULL(pFirst);
+  VERIFY_IS_NOT_NULL(pSecond);
+  VERIFY_ARE_EQUAL_STR("first", strings.Get(pFirst->Name));
+  VERIFY_ARE_EQUAL(0, pFirst->StartOffset);
+  VERIFY_ARE_EQUAL(16, pFirst->Size);
+  VERIFY_ARE_EQUAL_STR("second", strings.Get(pSecond->Name));
+  VERIFY_ARE_EQUAL(16, pSecond->StartOffset);
+}
+
+TEST_F(DxilContainerTest, CompileWhenOKThenPSVIncludesUsedRanges) {
+  const char program[] =
+    "cbuffer C { float4 a; float b; float c; float arr[4]; };\n"
+    "RWBuffer<float> U;\n"
+    "[numthreads(4, 1, 1)] void main(uint i : SV_GroupIndex) {\n"
+    "  U[i] = a.x + c + arr[i];\n"
+    "}";
+  CComPtr<IDxcBlob> pProgram;
+  CompileToProgram(program, L"main", L"cs_6_0", nullptr, 0, &pProgram);
+
+  hlsl::DxilContainerHeader *pHeader =
+      (hlsl::DxilContainerHeader *)pProgram->GetBufferPointer();
+  hlsl::DxilPartIterator pPartIter =
+      std::find_if(hlsl::begin(pHeader), hlsl::end(pHeader),
+                   hlsl::DxilPartIsType(hlsl::DFCC_PipelineStateValidation));
+  VERIFY_ARE_NOT_EQUAL(hlsl::end(pHeader), pPartIter);
+  DxilPipelineStateValidation PSV;
+  VERIFY_IS_TRUE(PSV.InitFromPSV0(hlsl::GetDxilPartData(*pPartIter),
+                                  (*pPartIter)->PartSize));
+  // Older validators produce an earlier PSV version.
+  if (PSV.GetPSVRuntimeInfo3() == nullptr)
+    return;
+
+  // a.x and c are read alone; arr is indexed, so all of it counts.
+  PSVResourceBindInfo2 *pCB = PSV.GetPSVResourceBindInfo2(0);
+  VERIFY_IS_NOT_NULL(pCB);
+  VERIFY_ARE_EQUAL(3, pCB->UsedRangeCount);
+  const unsigned expected[][2] = {{0, 4}, {20, 4}, {32, 52}};
+  for (unsigned i = 0; i < 3; ++i) {
+    PSVCBufferRange0 *pRange = PSV.GetCBufferRange0(pCB->UsedRangeStart + i);
+    VERIFY_IS_NOT_NULL(pRange);
+    VERIFY_ARE_EQUAL(expected[i][0], pRange->StartOffset);
+    VERIFY_ARE_EQUAL(expected[i][1], pRange->Size);
+  }
+
+  // Reflection marks the variables from the same ranges.
+  CComPtr<ID3D12ShaderReflection> pReflection;
+  CreateReflectionFromBlob(pProgram, &pReflection);
+  D3D12_SHADER_VARIABLE_DESC varDesc;
+  VERIFY_SUCCEEDED(pReflection->GetVariableByName("b")->GetDesc(&varDesc));
+  VERIFY_ARE_EQUAL(0, varDesc.uFlags & D3D_SVF_USED);
+  VERIFY_SUCCEEDED(pReflection->GetVariableByName("arr")->GetDesc(&varDesc));
+  VERIFY_ARE_NOT_EQUAL(0, varDesc.uFlags & D3D_SVF_USED);
+}
+
 TEST_F(DxilContainerTest, DisassemblyWhenBCInvalidThenFails) {
   CComPtr<IDxcCompiler> pCompiler;
   CComPtr<IDxcBlobEncoding> pSource;
@@ -810,6 +1206,263 @@ TEST_F(DxilContainerTest, DisassemblyWhenValidThenOK) {
   VERIFY_ARE_NOT_EQUAL(0, disassembleString.size());
 }
 
+TEST_F(DxilContainerTest, DisassemblyWhenStreamedThenFiltered) {
+  const char program[] =
+    "RWBuffer<float> U;\n"
+    "[numthreads(1, 1, 1)] void main() { U[0] = 1; }";
+  CComPtr<IDxcBlob> pProgram;
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcDisassembler> pDisassembler;
+  CComPtr<IMalloc> pMalloc;
+  CompileToProgram(program, L"main", L"cs_6_0", nullptr, 0, &pProgram);
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  VERIFY_SUCCEEDED(pCompiler.QueryInterface(&pDisassembler));
+  VERIFY_SUCCEEDED(CoGetMalloc(1, &pMalloc));
+
+  auto Disassemble = [&](UINT32 flags, LPCWSTR pFunctionName) {
+    CComPtr<hlsl::AbstractMemoryStream> pStream;
+    VERIFY_SUCCEEDED(hlsl::CreateMemoryStream(pMalloc, &pStream));
+    VERIFY_SUCCEEDED(pDisassembler->DisassembleToStream(pProgram, flags,
+                                                        pFunctionName, pStream));
+    return std::string((const char *)pStream->GetPtr(), pStream->GetPtrSize());
+  };
+
+  // Without filters, the stream matches the blob.
+  CComPtr<IDxcBlobEncoding> pDisassembly;
+  VERIFY_SUCCEEDED(pCompiler->Disassemble(pProgram, &pDisassembly));
+  VERIFY_ARE_EQUAL(BlobToUtf8(pDisassembly),
+                   Disassemble(DxcDisassembleFlags_None, nullptr));
+
+  std::string text = Disassemble(DxcDisassembleFlags_SkipMetadata, nullptr);
+  VERIFY_ARE_NOT_EQUAL(std::string::npos, text.find("define void @main()"));
+  VERIFY_ARE_EQUAL(std::string::npos, text.find("!dx.entryPoints"));
+
+  text = Disassemble(DxcDisassembleFlags_ResourcesOnly, nullptr);
+  VERIFY_ARE_NOT_EQUAL(std::string::npos, text.find("; Resource Bindings:"));
+  VERIFY_ARE_EQUAL(std::string::npos, text.find("define "));
+
+  text = Disassemble(DxcDisassembleFlags_None, L"main");
+  VERIFY_ARE_NOT_EQUAL(std::string::npos, text.find("define void @main()"));
+  VERIFY_ARE_EQUAL(std::string::npos, text.find("!dx.entryPoints"));
+
+  CComPtr<hlsl::AbstractMemoryStream> pStream;
+  VERIFY_SUCCEEDED(hlsl::CreateMemoryStream(pMalloc, &pStream));
+  VERIFY_ARE_EQUAL(E_INVALIDARG, pDisassembler->DisassembleToStream(
+                                     pProgram, DxcDisassembleFlags_None,
+                                     L"missing", pStream));
+}
+
+TEST_F(DxilContainerTest, CompileWhenToStreamsThenMatchesBlobs) {
+  const char program[] =
+    "RWBuffer<float> U;\n"
+    "[numthreads(1, 1, 1)] void main() { U[0] = 1; }";
+  LPCWSTR args[] = { L"/Zi" };
+  CComPtr<IDxcBlobEncoding> pSource;
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcCompilerToStreams> pToStreams;
+  CComPtr<IMalloc> pMalloc;
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  VERIFY_SUCCEEDED(pCompiler.QueryInterface(&pToStreams));
+  VERIFY_SUCCEEDED(CoGetMalloc(1, &pMalloc));
+  CreateBlobFromText(program, &pSource);
+
+  CComPtr<IDxcOperationResult> pResult;
+  CComPtr<IDxcBlob> pProgram;
+  CComPtr<IDxcBlob> pDebugBlob;
+  CComPtr<IDxcBlobEncoding> pDisassembly;
+  VERIFY_SUCCEEDED(pCompiler->CompileWithDebug(
+      pSource, L"hlsl.hlsl", L"main", L"cs_6_0", args, _countof(args), nullptr,
+      0, nullptr, &pResult, nullptr, &pDebugBlob));
+  VERIFY_SUCCEEDED(pResult->GetResult(&pProgram));
+  VERIFY_SUCCEEDED(pCompiler->Disassemble(pProgram, &pDisassembly));
+
+  CComPtr<hlsl::AbstractMemoryStream> pObject, pDebug, pText;
+  VERIFY_SUCCEEDED(hlsl::CreateMemoryStream(pMalloc, &pObject));
+  VERIFY_SUCCEEDED(hlsl::CreateMemoryStream(pMalloc, &pDebug));
+  VERIFY_SUCCEEDED(hlsl::CreateMemoryStream(pMalloc, &pText));
+  pResult.Release();
+  VERIFY_SUCCEEDED(pToStreams->CompileToStreams(
+      pSource, L"hlsl.hlsl", L"main", L"cs_6_0", args, _countof(args), nullptr,
+      0, nullptr, pObject, pDebug, pText, &pResult));
+  HRESULT status;
+  VERIFY_SUCCEEDED(pResult->GetStatus(&status));
+  VERIFY_SUCCEEDED(status);
+
+  // Each stream gets what the blob would hold, and the result holds none.
+  auto StreamToString = [](hlsl::AbstractMemoryStream *pStream) {
+    return std::string((const char *)pStream->GetPtr(), pStream->GetPtrSize());
+  };
+  VERIFY_ARE_EQUAL(std::string((const char *)pProgram->GetBufferPointer(),
+                               pProgram->GetBufferSize()),
+                   StreamToString(pObject));
+  VERIFY_ARE_EQUAL(std::string((const char *)pDebugBlob->GetBufferPointer(),
+                               pDebugBlob->GetBufferSize()),
+                   StreamToString(pDebug));
+  VERIFY_ARE_EQUAL(BlobToUtf8(pDisassembly), StreamToString(pText));
+  CComPtr<IDxcBlob> pNoProgram;
+  VERIFY_SUCCEEDED(pResult->GetResult(&pNoProgram));
+  VERIFY_IS_NULL(pNoProgram.p);
+
+  // A failed compile writes nothing and reports its errors.
+  CComPtr<hlsl::AbstractMemoryStream> pFailedObject;
+  VERIFY_SUCCEEDED(hlsl::CreateMemoryStream(pMalloc, &pFailedObject));
+  pResult.Release();
+  VERIFY_SUCCEEDED(pToStreams->CompileToStreams(
+      pSource, L"hlsl.hlsl", L"missing", L"cs_6_0", nullptr, 0, nullptr, 0,
+      nullptr, pFailedObject, nullptr, nullptr, &pResult));
+  VERIFY_SUCCEEDED(pResult->GetStatus(&status));
+  VERIFY_FAILED(status);
+  VERIFY_ARE_EQUAL(0U, pFailedObject->GetPtrSize());
+}
+
+TEST_F(DxilContainerTest, RootSignatureWhenEqualThenInterned) {
+  // The first two root signatures define the same layout.
+  const char programA[] =
+    "[RootSignature(\"CBV(b0), DescriptorTable(SRV(t0, numDescriptors=2))\")]\n"
+    "float4 main() : SV_Target { return 0; }";
+  const char programB[] =
+    "[RootSignature(\"CBV(b0, space=0), DescriptorTable(SRV(t0, space=0, numDescriptors=2))\")]\n"
+    "float4 main() : SV_Target { return 1; }";
+  const char programC[] =
+    "[RootSignature(\"CBV(b1), DescriptorTable(SRV(t0, numDescriptors=2))\")]\n"
+    "float4 main() : SV_Target { return 0; }";
+  CComPtr<IDxcBlob> pProgramA, pProgramB, pProgramC;
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcRootSignatureCache> pCache;
+  CompileToProgram(programA, L"main", L"ps_6_0", nullptr, 0, &pProgramA);
+  CompileToProgram(programB, L"main", L"ps_6_0", nullptr, 0, &pProgramB);
+  CompileToProgram(programC, L"main", L"ps_6_0", nullptr, 0, &pProgramC);
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  VERIFY_SUCCEEDED(pCompiler.QueryInterface(&pCache));
+
+  CComPtr<IDxcBlob> pInternedA, pInternedB, pInternedC;
+  UINT64 hashA, hashB, hashC;
+  VERIFY_SUCCEEDED(pCache->Intern(pProgramA, &pInternedA, &hashA));
+  VERIFY_SUCCEEDED(pCache->Intern(pProgramB, &pInternedB, &hashB));
+  VERIFY_SUCCEEDED(pCache->Intern(pProgramC, &pInternedC, &hashC));
+  VERIFY_ARE_EQUAL(pInternedA.p, pInternedB.p);
+  VERIFY_ARE_EQUAL(hashA, hashB);
+  VERIFY_ARE_NOT_EQUAL(pInternedA.p, pInternedC.p);
+  VERIFY_ARE_NOT_EQUAL(hashA, hashC);
+
+  // A bare root signature part interns like the container holding it.
+  const hlsl::DxilContainerHeader *pContainer = hlsl::IsDxilContainerLike(
+      pProgramC->GetBufferPointer(), pProgramC->GetBufferSize());
+  VERIFY_IS_NOT_NULL(pContainer);
+  const hlsl::DxilPartHeader *pPart =
+      hlsl::GetDxilPartByType(pContainer, hlsl::DFCC_RootSignature);
+  VERIFY_IS_NOT_NULL(pPart);
+  CComPtr<IDxcBlobEncoding> pPartBlob;
+  CComPtr<IDxcBlob> pInternedPart;
+  UINT64 hashPart;
+  CreateBlobPinned(hlsl::GetDxilPartData(pPart), pPart->PartSize, CP_ACP,
+                   &pPartBlob);
+  VERIFY_SUCCEEDED(pCache->Intern(pPartBlob, &pInternedPart, &hashPart));
+  VERIFY_ARE_EQUAL(pInternedC.p, pInternedPart.p);
+  VERIFY_ARE_EQUAL(hashC, hashPart);
+  VERIFY_ARE_EQUAL(pPart->PartSize, pInternedPart->GetBufferSize());
+  VERIFY_ARE_EQUAL(0, memcmp(hlsl::GetDxilPartData(pPart),
+                             pInternedPart->GetBufferPointer(),
+                             pPart->PartSize));
+}
+
+TEST_F(DxilContainerTest, RootSignatureWhenTextRepeatsThenCompiledOnce) {
+  // The texts differ only in white space, so the second compile reuses the
+  // first one's root signature.
+  const char programA[] =
+    "[RootSignature(\"CBV(b0), DescriptorTable(SRV(t0, numDescriptors=2))\")]\n"
+    "float4 main() : SV_Target { return 0; }";
+  const char programB[] =
+    "[RootSignature(\"CBV(b0),\tDescriptorTable(SRV(t0,  numDescriptors=2)) \")]\n"
+    "float4 main() : SV_Target { return 1; }";
+  const char macroProgram[] =
+    "#define RS \"CBV(b0), DescriptorTable(SRV(t0, numDescriptors=2))\"\n";
+  CComPtr<IDxcBlob> pProgramA, pProgramB, pRootSig;
+  CompileToProgram(programA, L"main", L"ps_6_0", nullptr, 0, &pProgramA);
+  CompileToProgram(programB, L"main", L"ps_6_0", nullptr, 0, &pProgramB);
+  CompileToProgram(macroProgram, L"RS", L"rootsig_1_1", nullptr, 0,
+                   &pRootSig);
+
+  auto GetRootSignaturePart = [](IDxcBlob *pBlob) {
+    const hlsl::DxilContainerHeader *pContainer = hlsl::IsDxilContainerLike(
+        pBlob->GetBufferPointer(), pBlob->GetBufferSize());
+    VERIFY_IS_NOT_NULL(pContainer);
+    const hlsl::DxilPartHeader *pPart =
+        hlsl::GetDxilPartByType(pContainer, hlsl::DFCC_RootSignature);
+    VERIFY_IS_NOT_NULL(pPart);
+    return std::string(hlsl::GetDxilPartData(pPart), pPart->PartSize);
+  };
+  std::string partA = GetRootSignaturePart(pProgramA);
+  VERIFY_ARE_EQUAL(partA, GetRootSignaturePart(pProgramB));
+  VERIFY_ARE_EQUAL(partA, GetRootSignaturePart(pRootSig));
+
+  // Text that fails to compile reports its error every time.
+  const char badProgram[] =
+    "[RootSignature(\"CBV(q0)\")]\n"
+    "float4 main() : SV_Target { return 0; }";
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcBlobEncoding> pSource;
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText(badProgram, &pSource);
+  for (unsigned i = 0; i < 2; ++i) {
+    CComPtr<IDxcOperationResult> pResult;
+    HRESULT status;
+    VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"hlsl.hlsl", L"main",
+                                        L"ps_6_0", nullptr, 0, nullptr, 0,
+                                        nullptr, &pResult));
+    VERIFY_SUCCEEDED(pResult->GetStatus(&status));
+    VERIFY_FAILED(status);
+  }
+}
+
+TEST_F(DxilContainerTest, RootSignatureWhenCheckedOnceThenMatchesShaders) {
+  const char programs[][160] = {
+    "[RootSignature(\"DescriptorTable(SRV(t0, numDescriptors=2)), CBV(b0)\")]\n"
+    "float4 main() : SV_Target { return 0; }",
+    "Buffer<float4> B : register(t1);\n"
+    "float4 main() : SV_Target { return B[0]; }",
+    "cbuffer C : register(b0) { float4 f; };\n"
+    "float4 main() : SV_Target { return f; }",
+    "Buffer<float4> B : register(t2);\n"
+    "float4 main() : SV_Target { return B[0]; }",
+  };
+  const bool compatible[] = { true, true, true, false };
+  CComPtr<IDxcBlob> pPrograms[_countof(programs)];
+  for (unsigned i = 0; i < _countof(programs); ++i)
+    CompileToProgram(programs[i], L"main", L"ps_6_0", nullptr, 0, &pPrograms[i]);
+
+  auto GetPart = [](IDxcBlob *pProgram, hlsl::DxilFourCC fourCC) {
+    const hlsl::DxilContainerHeader *pContainer = hlsl::IsDxilContainerLike(
+        pProgram->GetBufferPointer(), pProgram->GetBufferSize());
+    VERIFY_IS_NOT_NULL(pContainer);
+    const hlsl::DxilPartHeader *pPart = hlsl::GetDxilPartByType(pContainer, fourCC);
+    VERIFY_IS_NOT_NULL(pPart);
+    return pPart;
+  };
+
+  const hlsl::DxilPartHeader *pRSPart = GetPart(pPrograms[0], hlsl::DFCC_RootSignature);
+  const hlsl::DxilVersionedRootSignatureDesc *pDesc = nullptr;
+  hlsl::DeserializeRootSignature(hlsl::GetDxilPartData(pRSPart),
+                                 pRSPart->PartSize, &pDesc);
+  std::string diag;
+  llvm::raw_string_ostream diagStream(diag);
+  hlsl::RootSignatureCompatibilityChecker checker;
+  VERIFY_IS_TRUE(checker.Init(pDesc, diagStream));
+
+  // The index built once gives the same answers as verifying each pair.
+  for (unsigned i = 0; i < _countof(programs); ++i) {
+    const hlsl::DxilPartHeader *pPSVPart =
+        GetPart(pPrograms[i], hlsl::DFCC_PipelineStateValidation);
+    VERIFY_ARE_EQUAL(compatible[i], checker.VerifyShaderPSV(
+        hlsl::DXIL::ShaderKind::Pixel, hlsl::GetDxilPartData(pPSVPart),
+        pPSVPart->PartSize, diagStream));
+    VERIFY_ARE_EQUAL(compatible[i], hlsl::VerifyRootSignatureWithShaderPSV(
+        pDesc, hlsl::DXIL::ShaderKind::Pixel, hlsl::GetDxilPartData(pPSVPart),
+        pPSVPart->PartSize, diagStream));
+  }
+  hlsl::DeleteRootSignature(pDesc);
+}
+
 class HlslFileVariables {
 private:
   std::wstring m_Entry;
@@ -913,6 +1566,115 @@ TEST_F(DxilContainerTest, ReflectionMatchesDXBC_Full) {
   }
 }
 
+TEST_F(DxilContainerTest, ReflectionWhenUsageQueriedLastThenMatches) {
+  const char program[] =
+    "cbuffer C { float used; float unused; };\n"
+    "RWBuffer<float> U;\n"
+    "[numthreads(4, 2, 1)] void main() { U[0] = used; }";
+  CComPtr<IDxcBlob> pProgram;
+  CComPtr<ID3D12ShaderReflection> pReflection;
+  CompileToProgram(program, L"main", L"cs_6_0", nullptr, 0, &pProgram);
+  CreateReflectionFromBlob(pProgram, &pReflection);
+
+  // Bindings and thread group size do not need function bodies.
+  UINT x, y, z;
+  VERIFY_ARE_EQUAL(8, pReflection->GetThreadGroupSize(&x, &y, &z));
+  VERIFY_ARE_EQUAL(4, x);
+  VERIFY_ARE_EQUAL(2, y);
+  VERIFY_ARE_EQUAL(1, z);
+  D3D12_SHADER_INPUT_BIND_DESC bindDesc;
+  VERIFY_SUCCEEDED(pReflection->GetResourceBindingDescByName("U", &bindDesc));
+  VERIFY_ARE_EQUAL(D3D_SIT_UAV_RWTYPED, bindDesc.Type);
+
+  // Variable usage is still reported once it is asked for.
+  D3D12_SHADER_VARIABLE_DESC varDesc;
+  VERIFY_SUCCEEDED(pReflection->GetVariableByName("used")->GetDesc(&varDesc));
+  VERIFY_ARE_NOT_EQUAL(0, varDesc.uFlags & D3D_SVF_USED);
+  VERIFY_SUCCEEDED(pReflection->GetVariableByName("unused")->GetDesc(&varDesc));
+  VERIFY_ARE_EQUAL(0, varDesc.uFlags & D3D_SVF_USED);
+}
+
+TEST_F(DxilContainerTest, ReflectionWhenDescQueriedThenIncludesCost) {
+  const char program[] =
+    "Texture2D T; SamplerState S;\n"
+    "float4 main(float2 uv : TEXCOORD, float f : F) : SV_Target {\n"
+    "  float4 r = T.Sample(S, uv);\n"
+    "  [loop] for (int i = 0; i < 4; ++i) r.x += sin(f * i);\n"
+    "  return r;\n"
+    "}";
+  CComPtr<IDxcBlob> pProgram;
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcDisassembler> pDisassembler;
+  CComPtr<IMalloc> pMalloc;
+  CompileToProgram(program, L"main", L"ps_6_0", nullptr, 0, &pProgram);
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  VERIFY_SUCCEEDED(pCompiler.QueryInterface(&pDisassembler));
+  VERIFY_SUCCEEDED(CoGetMalloc(1, &pMalloc));
+
+  // The disassembler prints only the cost when asked to.
+  CComPtr<hlsl::AbstractMemoryStream> pStream;
+  VERIFY_SUCCEEDED(hlsl::CreateMemoryStream(pMalloc, &pStream));
+  VERIFY_SUCCEEDED(pDisassembler->DisassembleToStream(
+      pProgram, DxcDisassembleFlags_CostOnly, nullptr, pStream));
+  std::string text((const char *)pStream->GetPtr(), pStream->GetPtrSize());
+  VERIFY_ARE_NOT_EQUAL(std::string::npos,
+                       text.find("; Estimated cost of main"));
+  VERIFY_ARE_EQUAL(std::string::npos, text.find("define "));
+
+  // Reflection fills the instruction counts from the same estimate.
+  CComPtr<ID3D12ShaderReflection> pReflection;
+  CreateReflectionFromBlob(pProgram, &pReflection);
+  D3D12_SHADER_DESC desc;
+  VERIFY_SUCCEEDED(pReflection->GetDesc(&desc));
+  VERIFY_ARE_NOT_EQUAL(0, desc.InstructionCount);
+  VERIFY_ARE_NOT_EQUAL(0, desc.TempRegisterCount);
+  VERIFY_ARE_NOT_EQUAL(0, desc.FloatInstructionCount);
+  VERIFY_ARE_NOT_EQUAL(0, desc.DynamicFlowControlCount);
+  VERIFY_ARE_EQUAL(1, desc.TextureNormalInstructions);
+  VERIFY_ARE_EQUAL(0, desc.TextureLoadInstructions);
+}
+
+TEST_F(DxilContainerTest, ReflectionWhenTypesRepeatThenShared) {
+  const char program[] =
+    "struct S { float4 a; float b; };\n"
+    "cbuffer C { S s0; S s1; float f; };\n"
+    "RWBuffer<float> U;\n"
+    "[numthreads(1, 1, 1)] void main() { U[0] = s0.b + s1.a.x + f; }";
+  CComPtr<IDxcBlob> pProgram;
+  CComPtr<ID3D12ShaderReflection> pReflection;
+  CompileToProgram(program, L"main", L"cs_6_0", nullptr, 0, &pProgram);
+  CreateReflectionFromBlob(pProgram, &pReflection);
+
+  // Names are found in every kind of lookup.
+  D3D12_SHADER_INPUT_BIND_DESC bindDesc;
+  VERIFY_SUCCEEDED(pReflection->GetResourceBindingDescByName("U", &bindDesc));
+  VERIFY_ARE_EQUAL(D3D_SIT_UAV_RWTYPED, bindDesc.Type);
+  VERIFY_ARE_EQUAL(HRESULT_FROM_WIN32(ERROR_NOT_FOUND),
+                   pReflection->GetResourceBindingDescByName("V", &bindDesc));
+  D3D12_SHADER_BUFFER_DESC bufferDesc;
+  VERIFY_SUCCEEDED(
+      pReflection->GetConstantBufferByName("C")->GetDesc(&bufferDesc));
+  VERIFY_ARE_EQUAL(3, bufferDesc.Variables);
+  VERIFY_FAILED(pReflection->GetConstantBufferByName("D")->GetDesc(&bufferDesc));
+
+  // Variables of the same type share one type object, as do their members.
+  ID3D12ShaderReflectionVariable *pS0 = pReflection->GetVariableByName("s0");
+  ID3D12ShaderReflectionVariable *pS1 = pReflection->GetVariableByName("s1");
+  ID3D12ShaderReflectionType *pType = pS0->GetType();
+  VERIFY_ARE_EQUAL(pType, pS1->GetType());
+  VERIFY_ARE_EQUAL(pType->GetMemberTypeByName("a"),
+                   pS1->GetType()->GetMemberTypeByIndex(0));
+  VERIFY_ARE_NOT_EQUAL(pType, pReflection->GetVariableByName("f")->GetType());
+  D3D12_SHADER_TYPE_DESC typeDesc;
+  VERIFY_SUCCEEDED(pType->GetDesc(&typeDesc));
+  VERIFY_ARE_EQUAL(D3D_SVC_STRUCT, typeDesc.Class);
+  VERIFY_ARE_EQUAL(2, typeDesc.Members);
+  VERIFY_ARE_EQUAL(0, typeDesc.Offset);
+  VERIFY_SUCCEEDED(pType->GetMemberTypeByIndex(1)->GetDesc(&typeDesc));
+  VERIFY_ARE_EQUAL(16, typeDesc.Offset);
+  VERIFY_ARE_EQUAL(pS0->GetBuffer(), pS1->GetBuffer());
+}
+
 TEST_F(DxilContainerTest, ValidateFromLL_Abs2) {
   CodeGenTestCheck(L"abs2_m.ll");
 }
@@ -19,6 +19,9 @@
 #include "dxc/HLSL/DxilInstructions.h"
 #include "dxc/HLSL/DxilContainer.h"
 #include "dxc/HLSL/DxilModule.h"
+#include "dxc/HLSL/DxilSemantic.h"
+#include "dxc/HLSL/DxilComputeExecutor.h"
+#include "dxc/HLSL/DxilValidation.h"
 #include "llvm/Support/Regex.h"
 #include "llvm/Support/MSFileSystem.h"
 #include "llvm/Support/FileSystem.h"
@@ -27,6 +30,8 @@
 #include "llvm/BitCode/ReaderWriter.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Module.h"
+#include <algorithm>
 
 using namespace hlsl;
 using namespace llvm;
@@ -49,6 +54,13 @@ public:
   TEST_METHOD(LoadDxilModule_1_2);
 
   TEST_METHOD(FunctionFPFlag);
+  TEST_METHOD(LazyLoadDxilMetadata);
+  TEST_METHOD(OpFunctionTypesSharedAcrossModules);
+  TEST_METHOD(TypeSystemEraseKeepsOrder);
+  TEST_METHOD(DxilOpFuncFollowsName);
+  TEST_METHOD(DxilOpCallListGroupsByClass);
+  TEST_METHOD(ValidationFunctionCacheHitsUnchangedBody);
+  TEST_METHOD(SemanticGetByName);
 
   // Precise query tests.
   TEST_METHOD(Precise1);
@@ -58,6 +70,11 @@ public:
   TEST_METHOD(Precise5);
   TEST_METHOD(Precise6);
   TEST_METHOD(Precise7);
+
+  // CPU executor tests.
+  TEST_METHOD(ComputeExecutorThreadIds);
+  TEST_METHOD(ComputeExecutorGroupSharedReduction);
+  TEST_METHOD(ComputeExecutorWaveOps);
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -261,6 +278,174 @@ TEST_F(DxilModuleTest, FunctionFPFlag) {
   }
 }
 
+TEST_F(DxilModuleTest, LazyLoadDxilMetadata) {
+  Compiler c(m_dllSupport);
+  c.Compile(
+    "float4 main(float4 a : A) : SV_Target {\n"
+    "  return a;\n"
+    "}\n"
+  );
+
+  // A lazily loaded module reads the type system on first use.
+  DxilModule &DM = c.GetDxilModule();
+  DxilModule LazyDM(DM.GetModule());
+  LazyDM.LoadDxilMetadata(/*bLazy*/true);
+  VERIFY_ARE_EQUAL(DM.GetInputSignature().GetElements().size(),
+                   LazyDM.GetInputSignature().GetElements().size());
+  Function *F = LazyDM.GetEntryFunction();
+  VERIFY_IS_NOT_NULL(F);
+  VERIFY_IS_NOT_NULL(LazyDM.GetTypeSystem().GetFunctionAnnotation(F));
+  VERIFY_IS_NOT_NULL(DM.GetTypeSystem().GetFunctionAnnotation(F));
+}
+
+TEST_F(DxilModuleTest, OpFunctionTypesSharedAcrossModules) {
+  LLVMContext Ctx;
+  Module M1("m1", Ctx);
+  Module M2("m2", Ctx);
+  OP op1(Ctx, &M1);
+  OP op2(Ctx, &M2);
+
+  // Each module gets its own declaration, built from the same type.
+  Type *pF32 = Type::getFloatTy(Ctx);
+  for (OP::OpCode opCode : {OP::OpCode::Sin, OP::OpCode::BufferLoad}) {
+    Function *F1 = op1.GetOpFunc(opCode, pF32);
+    Function *F2 = op2.GetOpFunc(opCode, pF32);
+    VERIFY_ARE_EQUAL(&M1, F1->getParent());
+    VERIFY_ARE_EQUAL(&M2, F2->getParent());
+    VERIFY_ARE_EQUAL(F1->getFunctionType(), F2->getFunctionType());
+    VERIFY_IS_TRUE(F1->getAttributes() == F2->getAttributes());
+    VERIFY_IS_TRUE(F2->hasFnAttribute(Attribute::NoUnwind));
+  }
+}
+
+TEST_F(DxilModuleTest, TypeSystemEraseKeepsOrder) {
+  LLVMContext context;
+  Module module("types", context);
+  DxilTypeSystem typeSys(&module);
+  std::vector<StructType *> types;
+  for (unsigned i = 0; i < 8; ++i) {
+    types.push_back(StructType::create(context, Type::getInt32Ty(context),
+                                       "struct.S" + std::to_string(i)));
+    typeSys.AddStructAnnotation(types.back())->SetCBufferSize(i);
+  }
+
+  // Erase every other annotation, then add one back.
+  for (unsigned i = 0; i < 8; i += 2)
+    typeSys.EraseStructAnnotation(types[i]);
+  VERIFY_IS_NULL(typeSys.GetStructAnnotation(types[0]));
+  VERIFY_ARE_EQUAL(5u, typeSys.GetStructAnnotation(types[5])->GetCBufferSize());
+  typeSys.AddStructAnnotation(types[0])->SetCBufferSize(100);
+
+  std::vector<unsigned> sizes;
+  for (auto &it : typeSys.GetStructAnnotationMap()) {
+    VERIFY_ARE_EQUAL(it.first, it.second->GetStructType());
+    sizes.push_back(it.second->GetCBufferSize());
+  }
+  std::vector<unsigned> expected = {1, 3, 5, 7, 100};
+  VERIFY_IS_TRUE(sizes == expected);
+  VERIFY_ARE_EQUAL(3u, typeSys.GetStructAnnotation(types[3])->GetCBufferSize());
+}
+
+TEST_F(DxilModuleTest, DxilOpFuncFollowsName) {
+  LLVMContext context;
+  Module module("ops", context);
+  FunctionType *FT = FunctionType::get(Type::getVoidTy(context), false);
+  Function *Op = Function::Create(FT, GlobalValue::ExternalLinkage,
+                                  "dx.op.barrier", &module);
+  Function *Other = Function::Create(FT, GlobalValue::ExternalLinkage,
+                                     "main", &module);
+  VERIFY_IS_TRUE(OP::IsDxilOpFunc(Op));
+  VERIFY_IS_FALSE(OP::IsDxilOpFunc(Other));
+
+  Op->setName("dx.other");
+  VERIFY_IS_FALSE(OP::IsDxilOpFunc(Op));
+  Op->setName("dx.op.barrier");
+  VERIFY_IS_TRUE(OP::IsDxilOpFunc(Op));
+
+  Other->takeName(Op);
+  VERIFY_IS_TRUE(OP::IsDxilOpFunc(Other));
+  VERIFY_IS_FALSE(OP::IsDxilOpFunc(Op));
+}
+
+TEST_F(DxilModuleTest, DxilOpCallListGroupsByClass) {
+  Compiler c(m_dllSupport);
+  c.Compile(
+    "float main(float x : X, float y : Y) : SV_Target {\n"
+    "  return sin(sqrt(x)) + y;\n"
+    "}\n"
+  );
+
+  DxilModule &DM = c.GetDxilModule();
+  DxilOpCallList OpCalls(*DM.GetEntryFunction());
+
+  // The unary calls keep their order within the class.
+  ArrayRef<DxilOpCallList::Call> Unary = OpCalls.calls(OP::OpCodeClass::Unary);
+  VERIFY_ARE_EQUAL(2u, Unary.size());
+  VERIFY_IS_TRUE(Unary[0].Opcode == OP::OpCode::Sqrt);
+  VERIFY_IS_TRUE(Unary[1].Opcode == OP::OpCode::Sin);
+  VERIFY_ARE_EQUAL(2u, OpCalls.calls(OP::OpCodeClass::LoadInput).size());
+  VERIFY_ARE_EQUAL(1u, OpCalls.calls(OP::OpCodeClass::StoreOutput).size());
+
+  size_t NumCalls = 0;
+  for (unsigned C = 0; C < (unsigned)OP::OpCodeClass::NumOpClasses; ++C) {
+    for (const DxilOpCallList::Call &Call :
+         OpCalls.calls((OP::OpCodeClass)C)) {
+      VERIFY_IS_TRUE(OP::GetDxilOpFuncCallInst(Call.CI) == Call.Opcode);
+      VERIFY_IS_TRUE(OP::GetOpCodeClass(Call.Opcode) == (OP::OpCodeClass)C);
+      ++NumCalls;
+    }
+  }
+  VERIFY_ARE_EQUAL(OpCalls.calls().size(), NumCalls);
+}
+
+TEST_F(DxilModuleTest, ValidationFunctionCacheHitsUnchangedBody) {
+  Compiler c(m_dllSupport);
+  c.Compile(
+    "float main(float x : X, float y : Y) : SV_Target {\n"
+    "  return sin(sqrt(x)) + y;\n"
+    "}\n"
+  );
+
+  DxilModule &DM = c.GetDxilModule();
+  ValidationFunctionCache Cache;
+
+  // The first validation records the entry body, the second one finds it.
+  VERIFY_SUCCEEDED(ValidateDxilModule(DM.GetModule(), nullptr, &Cache));
+  VERIFY_ARE_EQUAL(0u, Cache.GetHitCount());
+  VERIFY_SUCCEEDED(ValidateDxilModule(DM.GetModule(), nullptr, &Cache));
+  VERIFY_ARE_EQUAL(1u, Cache.GetHitCount());
+
+  // A changed body is looked up under a new digest and misses.
+  Function *F = DM.GetEntryFunction();
+  Instruction *Sin = nullptr;
+  for (Instruction &I : inst_range(F))
+    if (OP::IsDxilOpFuncCallInst(&I, OP::OpCode::Sin))
+      Sin = &I;
+  VERIFY_IS_NOT_NULL(Sin);
+  Sin->getOperandUse(0).set(DM.GetOP()->GetI32Const((int)OP::OpCode::Cos));
+  VERIFY_SUCCEEDED(ValidateDxilModule(DM.GetModule(), nullptr, &Cache));
+  VERIFY_ARE_EQUAL(1u, Cache.GetHitCount());
+}
+
+TEST_F(DxilModuleTest, SemanticGetByName) {
+  for (unsigned i = (unsigned)Semantic::Kind::Arbitrary + 1;
+       i < (unsigned)Semantic::Kind::Invalid; ++i) {
+    const Semantic *pSemantic = Semantic::Get((Semantic::Kind)i);
+    std::string Name = pSemantic->GetName();
+    VERIFY_ARE_EQUAL(pSemantic, Semantic::GetByName(Name));
+    std::transform(Name.begin(), Name.end(), Name.begin(), ::tolower);
+    VERIFY_ARE_EQUAL(pSemantic, Semantic::GetByName(Name));
+    std::transform(Name.begin(), Name.end(), Name.begin(), ::toupper);
+    VERIFY_ARE_EQUAL(pSemantic, Semantic::GetByName(Name));
+  }
+
+  VERIFY_IS_TRUE(Semantic::GetByName("TEXCOORD")->IsArbitrary());
+  VERIFY_IS_TRUE(Semantic::GetByName("SV_")->IsInvalid());
+  VERIFY_IS_TRUE(Semantic::GetByName("SV_P")->IsInvalid());
+  VERIFY_IS_TRUE(Semantic::GetByName("SV_Positio")->IsInvalid());
+  VERIFY_IS_TRUE(Semantic::GetByName("SV_PositionX")->IsInvalid());
+}
+
 TEST_F(DxilModuleTest, Precise1) {
   Compiler c(m_dllSupport);
   c.Compile(
@@ -459,3 +644,113 @@ TEST_F(DxilModuleTest, Precise7) {
   }
   VERIFY_ARE_EQUAL(numChecks, 4);
 }
+
+TEST_F(DxilModuleTest, ComputeExecutorThreadIds) {
+  Compiler c(m_dllSupport);
+  c.Compile(
+    "RWByteAddressBuffer Out : register(u0);\n"
+    "[numthreads(4, 2, 1)]\n"
+    "void main(uint3 dtid : SV_DispatchThreadID, uint gi : SV_GroupIndex) {\n"
+    "  uint index = dtid.y * 8 + dtid.x;\n"
+    "  Out.Store(index * 4, index * 10 + gi);\n"
+    "}\n"
+    ,
+    L"cs_6_0"
+  );
+
+  DxilModule &DM = c.GetDxilModule();
+  std::vector<uint32_t> out(32, 0xFFFFFFFF);
+  DxilComputeExecutor executor(DM);
+  executor.BindUAV(0, 0, out.data(), out.size() * sizeof(uint32_t));
+  executor.Dispatch(2, 2, 1);
+
+  for (uint32_t y = 0; y < 4; ++y) {
+    for (uint32_t x = 0; x < 8; ++x) {
+      uint32_t index = y * 8 + x;
+      uint32_t gi = (y % 2) * 4 + x % 4;
+      VERIFY_ARE_EQUAL(index * 10 + gi, out[index]);
+    }
+  }
+}
+
+TEST_F(DxilModuleTest, ComputeExecutorGroupSharedReduction) {
+  Compiler c(m_dllSupport);
+  c.Compile(
+    "StructuredBuffer<uint> In : register(t0);\n"
+    "RWStructuredBuffer<uint> Out : register(u1);\n"
+    "groupshared uint Shared[64];\n"
+    "[numthreads(64, 1, 1)]\n"
+    "void main(uint gi : SV_GroupIndex, uint3 gid : SV_GroupID) {\n"
+    "  Shared[gi] = In[gid.x * 64 + gi];\n"
+    "  GroupMemoryBarrierWithGroupSync();\n"
+    "  for (uint s = 32; s > 0; s >>= 1) {\n"
+    "    if (gi < s)\n"
+    "      Shared[gi] += Shared[gi + s];\n"
+    "    GroupMemoryBarrierWithGroupSync();\n"
+    "  }\n"
+    "  if (gi == 0)\n"
+    "    Out[gid.x] = Shared[0];\n"
+    "}\n"
+    ,
+    L"cs_6_0"
+  );
+
+  DxilModule &DM = c.GetDxilModule();
+  std::vector<uint32_t> in(256);
+  for (uint32_t i = 0; i < in.size(); ++i)
+    in[i] = i;
+  std::vector<uint32_t> out(4, 0);
+  DxilComputeExecutor executor(DM);
+  executor.BindSRV(0, 0, in.data(), in.size() * sizeof(uint32_t));
+  executor.BindUAV(0, 1, out.data(), out.size() * sizeof(uint32_t));
+  executor.SetWorkerCount(2);
+  executor.Dispatch(4, 1, 1);
+
+  for (uint32_t g = 0; g < 4; ++g) {
+    uint32_t first = g * 64, last = first + 63;
+    VERIFY_ARE_EQUAL((first + last) * 64 / 2, out[g]);
+  }
+}
+
+TEST_F(DxilModuleTest, ComputeExecutorWaveOps) {
+  Compiler c(m_dllSupport);
+  c.Compile(
+    "RWStructuredBuffer<uint4> Out : register(u0);\n"
+    "[numthreads(16, 1, 1)]\n"
+    "void main(uint gi : SV_GroupIndex) {\n"
+    "  uint4 r;\n"
+    "  r.x = WaveActiveSum(gi);\n"
+    "  r.y = WavePrefixSum(gi);\n"
+    "  r.z = WaveActiveBallot(gi % 3 == 0).x;\n"
+    "  r.w = 0;\n"
+    "  if (gi % 2 == 0)\n"
+    "    r.w = WaveActiveCountBits(true);\n"
+    "  Out[gi] = r;\n"
+    "}\n"
+    ,
+    L"cs_6_0"
+  );
+
+  DxilModule &DM = c.GetDxilModule();
+  std::vector<uint32_t> out(16 * 4, 0xFFFFFFFF);
+  DxilComputeExecutor executor(DM);
+  executor.BindUAV(0, 0, out.data(), out.size() * sizeof(uint32_t));
+  executor.SetWaveSize(8);
+  executor.Dispatch(1, 1, 1);
+
+  for (uint32_t gi = 0; gi < 16; ++gi) {
+    uint32_t first = gi / 8 * 8;
+    uint32_t sum = 0, prefix = 0, ballot = 0;
+    for (uint32_t lane = first; lane < first + 8; ++lane) {
+      sum += lane;
+      if (lane < gi)
+        prefix += lane;
+      if (lane % 3 == 0)
+        ballot |= 1U << (lane - first);
+    }
+    VERIFY_ARE_EQUAL(sum, out[gi * 4 + 0]);
+    VERIFY_ARE_EQUAL(prefix, out[gi * 4 + 1]);
+    VERIFY_ARE_EQUAL(ballot, out[gi * 4 + 2]);
+    VERIFY_ARE_EQUAL(gi % 2 == 0 ? 4U : 0U, out[gi * 4 + 3]);
+  }
+}
@@ -18,6 +18,8 @@
 #include <unordered_set>
 #include <strstream>
 #include <iomanip>
+#include <fstream>
+#include <sstream>
 #include "CompilationResult.h"
 #include "HLSLTestData.h"
 #include <Shlwapi.h>
@@ -532,6 +534,8 @@ public:
   TEST_METHOD(WaveIntrinsicsDDITest);
   TEST_METHOD(WaveIntrinsicsInPSTest);
   TEST_METHOD(PartialDerivTest);
+  TEST_METHOD(ShaderOpBenchmark);
+  TEST_METHOD(ShaderOpTune);
 
   BEGIN_TEST_METHOD(CBufferTestHalf)
     TEST_METHOD_PROPERTY(L"DataSource", L"Table:ShaderOpArithTable.xml#CBufferTestHalf")
@@ -2322,6 +2326,289 @@ TEST_F(ExecutionTest, OutOfBoundsTest) {
   }
 }
 
+static std::vector<std::wstring> SplitParamList(LPCWSTR pValue) {
+  std::vector<std::wstring> result;
+  std::wstring item;
+  for (LPCWSTR p = pValue; ; ++p) {
+    if (*p == L';' || *p == L'\0') {
+      result.push_back(item);
+      item.clear();
+      if (*p == L'\0')
+        break;
+    } else {
+      item.push_back(*p);
+    }
+  }
+  return result;
+}
+
+// Times the ShaderOps in BenchmarkOps (semicolon-separated names from
+// ShaderOpArith.xml) once per option set in BenchmarkArgs (semicolon-separated,
+// appended to every shader's arguments), and logs the median and deviation of
+// the GPU time of BenchmarkRuns runs after BenchmarkWarmUp unmeasured ones.
+TEST_F(ExecutionTest, ShaderOpBenchmark) {
+  WEX::Common::String OpsValue, ArgsValue;
+  if (FAILED(WEX::TestExecution::RuntimeParameters::TryGetValue(L"BenchmarkOps", OpsValue)) ||
+      OpsValue.IsEmpty()) {
+    LogCommentFmt(L"Set BenchmarkOps to the shader ops to benchmark.");
+    WEX::Logging::Log::Result(WEX::Logging::TestResults::Skipped);
+    return;
+  }
+  WEX::TestExecution::RuntimeParameters::TryGetValue(L"BenchmarkArgs", ArgsValue);
+  int WarmUpCount = 3, RunCount = 21;
+  WEX::TestExecution::RuntimeParameters::TryGetValue(L"BenchmarkWarmUp", WarmUpCount);
+  WEX::TestExecution::RuntimeParameters::TryGetValue(L"BenchmarkRuns", RunCount);
+  VERIFY_IS_TRUE(WarmUpCount >= 0 && RunCount > 0);
+
+  CComPtr<ID3D12Device> pDevice;
+  if (!CreateDevice(&pDevice))
+    return;
+
+  for (const std::wstring &OpName : SplitParamList(OpsValue)) {
+    for (const std::wstring &Args : SplitParamList(ArgsValue)) {
+      CComPtr<IStream> pStream;
+      ReadHlslDataIntoNewStream(L"ShaderOpArith.xml", &pStream);
+      std::shared_ptr<st::ShaderOpSet> ShaderOpSet = std::make_shared<st::ShaderOpSet>();
+      st::ParseShaderOpSetFromStream(pStream, ShaderOpSet.get());
+      CW2A OpNameA(OpName.c_str(), CP_UTF8);
+      st::ShaderOp *pShaderOp = ShaderOpSet->GetShaderOp(OpNameA);
+      if (pShaderOp == nullptr) {
+        LogErrorFmt(L"Unable to find shader op %s", OpName.c_str());
+        continue;
+      }
+      CW2A ArgsA(Args.c_str(), CP_UTF8);
+      for (st::ShaderOpShader &S : pShaderOp->Shaders) {
+        std::string ShaderArgs(S.Arguments ? S.Arguments : "");
+        ShaderArgs += " ";
+        ShaderArgs += ArgsA;
+        S.Arguments = pShaderOp->Strings.insert(ShaderArgs.c_str());
+      }
+
+      st::ShaderOpTest test;
+      st::ShaderOpTimings timings;
+      test.SetDxcSupport(&m_support);
+      test.SetDevice(pDevice);
+      test.RunShaderOpBenchmark(pShaderOp, (UINT)WarmUpCount, (UINT)RunCount, &timings);
+      LogCommentFmt(L"%s [%s]: median %.4f ms, deviation %.4f ms over %u runs",
+                    OpName.c_str(), Args.c_str(), timings.MedianMs,
+                    timings.StdDevMs, (unsigned)timings.SamplesMs.size());
+    }
+  }
+}
+
+// Parses "NAME=v1,v2;NAME2=v3" into a list of names with their values.
+static std::vector<std::pair<std::wstring, std::vector<std::wstring>>>
+ParseTuneSpace(LPCWSTR pValue) {
+  std::vector<std::pair<std::wstring, std::vector<std::wstring>>> space;
+  for (const std::wstring &Item : SplitParamList(pValue)) {
+    if (Item.empty())
+      continue;
+    size_t eq = Item.find(L'=');
+    VERIFY_IS_TRUE(eq != std::wstring::npos && eq > 0);
+    std::vector<std::wstring> values;
+    std::wstring value;
+    for (size_t i = eq + 1; i <= Item.size(); ++i) {
+      if (i == Item.size() || Item[i] == L',') {
+        VERIFY_IS_FALSE(value.empty());
+        values.push_back(value);
+        value.clear();
+      } else {
+        value.push_back(Item[i]);
+      }
+    }
+    space.emplace_back(Item.substr(0, eq), std::move(values));
+  }
+  return space;
+}
+
+// Compiles every DXIL shader of the op with the given defines, so that
+// variants the kernel rejects are skipped instead of failing the run.
+static bool CompileTuneVariant(dxc::DxcDllSupport &support, st::ShaderOp *pShaderOp,
+                               const std::vector<DxcDefine> &defines) {
+  for (st::ShaderOpShader &S : pShaderOp->Shaders) {
+    if (strlen(S.Target) <= 3 || S.Target[3] < '6')
+      continue;
+    LPCSTR pText = pShaderOp->GetShaderText(&S);
+    CComPtr<IDxcLibrary> pLibrary;
+    CComPtr<IDxcCompiler> pCompiler;
+    CComPtr<IDxcBlobEncoding> pTextBlob;
+    CComPtr<IDxcOperationResult> pResult;
+    VERIFY_SUCCEEDED(support.CreateInstance(CLSID_DxcLibrary, &pLibrary));
+    VERIFY_SUCCEEDED(pLibrary->CreateBlobWithEncodingFromPinned(
+        (LPBYTE)pText, (UINT32)strlen(pText), CP_UTF8, &pTextBlob));
+    VERIFY_SUCCEEDED(support.CreateInstance(CLSID_DxcCompiler, &pCompiler));
+    std::wstring argumentsW = CA2W(S.Arguments ? S.Arguments : "", CP_UTF8);
+    std::wstringstream argumentsStream(argumentsW);
+    std::vector<std::wstring> arguments;
+    std::wstring argument;
+    while (argumentsStream >> argument)
+      arguments.push_back(argument);
+    std::vector<LPCWSTR> argumentPtrs;
+    for (const std::wstring &A : arguments)
+      argumentPtrs.push_back(A.c_str());
+    VERIFY_SUCCEEDED(pCompiler->Compile(
+        pTextBlob, CA2W(S.Name, CP_UTF8), CA2W(S.EntryPoint, CP_UTF8),
+        CA2W(S.Target, CP_UTF8), argumentPtrs.data(), (UINT32)argumentPtrs.size(),
+        defines.data(), (UINT32)defines.size(), nullptr, &pResult));
+    HRESULT resultCode;
+    VERIFY_SUCCEEDED(pResult->GetStatus(&resultCode));
+    if (FAILED(resultCode)) {
+      CComPtr<IDxcBlobEncoding> pErrors;
+      VERIFY_SUCCEEDED(pResult->GetErrorBuffer(&pErrors));
+      LogCommentFmt(L"%S", std::string((LPCSTR)pErrors->GetBufferPointer(),
+                                       pErrors->GetBufferSize()).c_str());
+      return false;
+    }
+  }
+  return true;
+}
+
+static std::wstring GetAdapterDescription(ID3D12Device *pDevice) {
+  CComPtr<IDXGIFactory4> factory;
+  CComPtr<IDXGIAdapter1> adapter;
+  DXGI_ADAPTER_DESC1 desc;
+  if (FAILED(CreateDXGIFactory1(IID_PPV_ARGS(&factory))) ||
+      FAILED(factory->EnumAdapterByLuid(pDevice->GetAdapterLuid(),
+                                        IID_PPV_ARGS(&adapter))) ||
+      FAILED(adapter->GetDesc1(&desc)))
+    return L"?";
+  return desc.Description;
+}
+
+// Times the ShaderOp in TuneOp (from ShaderOpArith.xml) once per combination
+// of the defines in TuneSpace, for example "GROUP_X=32,64,128;UNROLL=1,2,4",
+// and reports the fastest combination on the device's adapter.
+//
+// When TuneWorkSize is set to "X,Y,Z", the dispatch of each variant covers
+// that many threads, with GROUP_X, GROUP_Y and GROUP_Z, which default to 1,
+// taken as the thread group size. Timing uses BenchmarkWarmUp and
+// BenchmarkRuns as ShaderOpBenchmark does.
+//
+// The fastest variant is appended to the file in TuneOutput, if set, as a
+// tab-separated line of adapter, op, defines, median and deviation in ms.
+TEST_F(ExecutionTest, ShaderOpTune) {
+  WEX::Common::String OpValue, SpaceValue, WorkSizeValue, OutputValue;
+  if (FAILED(WEX::TestExecution::RuntimeParameters::TryGetValue(L"TuneOp", OpValue)) ||
+      OpValue.IsEmpty() ||
+      FAILED(WEX::TestExecution::RuntimeParameters::TryGetValue(L"TuneSpace", SpaceValue)) ||
+      SpaceValue.IsEmpty()) {
+    LogCommentFmt(L"Set TuneOp and TuneSpace to the shader op and defines to tune.");
+    WEX::Logging::Log::Result(WEX::Logging::TestResults::Skipped);
+    return;
+  }
+  WEX::TestExecution::RuntimeParameters::TryGetValue(L"TuneWorkSize", WorkSizeValue);
+  WEX::TestExecution::RuntimeParameters::TryGetValue(L"TuneOutput", OutputValue);
+  int WarmUpCount = 3, RunCount = 21;
+  WEX::TestExecution::RuntimeParameters::TryGetValue(L"BenchmarkWarmUp", WarmUpCount);
+  WEX::TestExecution::RuntimeParameters::TryGetValue(L"BenchmarkRuns", RunCount);
+  VERIFY_IS_TRUE(WarmUpCount >= 0 && RunCount > 0);
+
+  auto Space = ParseTuneSpace(SpaceValue);
+  VERIFY_IS_FALSE(Space.empty());
+  UINT WorkSize[3] = {0, 0, 0};
+  bool bHasWorkSize = !WorkSizeValue.IsEmpty();
+  if (bHasWorkSize) {
+    VERIFY_ARE_EQUAL(3, swscanf_s(WorkSizeValue, L"%u,%u,%u", &WorkSize[0],
+                                  &WorkSize[1], &WorkSize[2]));
+  }
+
+  CComPtr<ID3D12Device> pDevice;
+  if (!CreateDevice(&pDevice))
+    return;
+  std::wstring Adapter = GetAdapterDescription(pDevice);
+
+  std::wstring BestDefines;
+  st::ShaderOpTimings BestTimings;
+  bool bHasBest = false;
+  std::vector<size_t> Choice(Space.size(), 0);
+  for (;;) {
+    CComPtr<IStream> pStream;
+    ReadHlslDataIntoNewStream(L"ShaderOpArith.xml", &pStream);
+    std::shared_ptr<st::ShaderOpSet> ShaderOpSet = std::make_shared<st::ShaderOpSet>();
+    st::ParseShaderOpSetFromStream(pStream, ShaderOpSet.get());
+    st::ShaderOp *pShaderOp = ShaderOpSet->GetShaderOp(CW2A(OpValue, CP_UTF8));
+    if (pShaderOp == nullptr) {
+      LogErrorFmt(L"Unable to find shader op %s", (LPCWSTR)OpValue);
+      return;
+    }
+
+    std::wstring Defines;
+    std::vector<DxcDefine> DxcDefines;
+    UINT GroupSize[3] = {1, 1, 1};
+    LPCWSTR GroupNames[3] = {L"GROUP_X", L"GROUP_Y", L"GROUP_Z"};
+    for (size_t i = 0; i < Space.size(); ++i) {
+      const std::wstring &Name = Space[i].first;
+      const std::wstring &Value = Space[i].second[Choice[i]];
+      DxcDefines.push_back({Name.c_str(), Value.c_str()});
+      if (!Defines.empty())
+        Defines += L" ";
+      Defines += Name + L"=" + Value;
+      for (unsigned d = 0; d < 3; ++d) {
+        if (Name == GroupNames[d])
+          GroupSize[d] = (UINT)_wtoi(Value.c_str());
+      }
+    }
+
+    if (!CompileTuneVariant(m_support, pShaderOp, DxcDefines)) {
+      LogCommentFmt(L"%s [%s]: does not compile, skipped",
+                    (LPCWSTR)OpValue, Defines.c_str());
+    } else {
+      std::string DefineArgs;
+      for (const DxcDefine &D : DxcDefines) {
+        DefineArgs += " -D ";
+        DefineArgs += CW2A(D.Name, CP_UTF8);
+        DefineArgs += "=";
+        DefineArgs += CW2A(D.Value, CP_UTF8);
+      }
+      for (st::ShaderOpShader &S : pShaderOp->Shaders) {
+        std::string ShaderArgs(S.Arguments ? S.Arguments : "");
+        ShaderArgs += DefineArgs;
+        S.Arguments = pShaderOp->Strings.insert(ShaderArgs.c_str());
+      }
+      if (bHasWorkSize) {
+        VERIFY_IS_TRUE(GroupSize[0] > 0 && GroupSize[1] > 0 && GroupSize[2] > 0);
+        pShaderOp->DispatchX = (WorkSize[0] + GroupSize[0] - 1) / GroupSize[0];
+        pShaderOp->DispatchY = (WorkSize[1] + GroupSize[1] - 1) / GroupSize[1];
+        pShaderOp->DispatchZ = (WorkSize[2] + GroupSize[2] - 1) / GroupSize[2];
+      }
+
+      st::ShaderOpTest test;
+      st::ShaderOpTimings timings;
+      test.SetDxcSupport(&m_support);
+      test.SetDevice(pDevice);
+      test.RunShaderOpBenchmark(pShaderOp, (UINT)WarmUpCount, (UINT)RunCount, &timings);
+      LogCommentFmt(L"%s [%s]: median %.4f ms, deviation %.4f ms over %u runs",
+                    (LPCWSTR)OpValue, Defines.c_str(), timings.MedianMs,
+                    timings.StdDevMs, (unsigned)timings.SamplesMs.size());
+      if (!bHasBest || timings.MedianMs < BestTimings.MedianMs) {
+        BestDefines = Defines;
+        BestTimings = timings;
+        bHasBest = true;
+      }
+    }
+
+    // Next combination, the last define varying fastest.
+    size_t i = Space.size();
+    while (i > 0 && ++Choice[i - 1] == Space[i - 1].second.size())
+      Choice[--i] = 0;
+    if (i == 0)
+      break;
+  }
+
+  VERIFY_IS_TRUE(bHasBest);
+  wchar_t Line[1024];
+  VERIFY_SUCCEEDED(StringCchPrintfW(Line, _countof(Line), L"%s\t%s\t%s\t%.4f\t%.4f",
+                                    Adapter.c_str(), (LPCWSTR)OpValue,
+                                    BestDefines.c_str(), BestTimings.MedianMs,
+                                    BestTimings.StdDevMs));
+  LogCommentFmt(L"Fastest: %s", Line);
+  if (!OutputValue.IsEmpty()) {
+    std::ofstream Output((LPCWSTR)OutputValue, std::ios::app);
+    VERIFY_IS_TRUE(Output.good());
+    Output << (LPCSTR)CW2A(Line, CP_UTF8) << "\n";
+  }
+}
+
 TEST_F(ExecutionTest, SaturateTest) {
   WEX::TestExecution::SetVerifyOutput verifySettings(WEX::TestExecution::VerifyOutputSettings::LogOnlyFailures);
   CComPtr<IStream> pStream;
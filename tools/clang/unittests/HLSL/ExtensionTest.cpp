@@ -341,6 +341,42 @@ public:
     return S_OK;
   }
 };
+
+// A semantic define validator that also validates defines in batches.
+// It counts the calls made through each interface.
+class TestSemanticDefineBatchValidator : public TestSemanticDefineValidator,
+                                         public IDxcSemanticDefineBatchValidator {
+public:
+  unsigned SingleCalls = 0;
+  unsigned BatchCalls = 0;
+  unsigned BatchedDefines = 0;
+
+  TestSemanticDefineBatchValidator(const std::vector<std::string> &errorDefines, const std::vector<std::string> &warningDefines)
+    : TestSemanticDefineValidator(errorDefines, warningDefines)
+  { }
+
+  __override ULONG STDMETHODCALLTYPE AddRef() { return TestSemanticDefineValidator::AddRef(); }
+  __override ULONG STDMETHODCALLTYPE Release() { return TestSemanticDefineValidator::Release(); }
+  __override HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void** ppvObject) {
+    return DoBasicQueryInterface<IDxcSemanticDefineValidator, IDxcSemanticDefineBatchValidator>(this, iid, ppvObject);
+  }
+
+  virtual HRESULT STDMETHODCALLTYPE GetSemanticDefineWarningsAndErrors(LPCSTR pName, LPCSTR pValue, IDxcBlobEncoding **ppWarningBlob, IDxcBlobEncoding **ppErrorBlob) {
+    ++SingleCalls;
+    return TestSemanticDefineValidator::GetSemanticDefineWarningsAndErrors(pName, pValue, ppWarningBlob, ppErrorBlob);
+  }
+
+  virtual HRESULT STDMETHODCALLTYPE GetSemanticDefinesWarningsAndErrors(UINT32 count, const LPCSTR *pNames, const LPCSTR *pValues, IDxcBlobEncoding **ppWarningBlobs, IDxcBlobEncoding **ppErrorBlobs) {
+    ++BatchCalls;
+    BatchedDefines += count;
+    for (UINT32 i = 0; i < count; ++i) {
+      HRESULT hr = TestSemanticDefineValidator::GetSemanticDefineWarningsAndErrors(pNames[i], pValues[i], &ppWarningBlobs[i], &ppErrorBlobs[i]);
+      if (FAILED(hr))
+        return hr;
+    }
+    return S_OK;
+  }
+};
 static void CheckOperationFailed(IDxcOperationResult *pResult) {
   HRESULT status;
   VERIFY_SUCCEEDED(pResult->GetStatus(&status));
@@ -426,6 +462,7 @@ public:
   TEST_METHOD(DefineValidationError);
   TEST_METHOD(DefineValidationWarning);
   TEST_METHOD(DefineNoValidatorOk);
+  TEST_METHOD(DefineValidationWhenBatchValidatorThenOneCall);
   TEST_METHOD(DefineFromMacro);
   TEST_METHOD(IntrinsicWhenAvailableThenUsed);
   TEST_METHOD(CustomIntrinsicName);
@@ -559,6 +596,41 @@ TEST_F(ExtensionTest, DefineNoValidatorOk) {
     disassembly.find("!{!\"FOO\", !\"1\"}"));
 }
 
+TEST_F(ExtensionTest, DefineValidationWhenBatchValidatorThenOneCall) {
+  Compiler c(m_dllSupport);
+  c.RegisterSemanticDefine(L"FOO*");
+  c.RegisterSemanticDefine(L"BAR");
+  c.RegisterSemanticDefineExclusion(L"FOOBAR*");
+  TestSemanticDefineBatchValidator *pValidator =
+    new TestSemanticDefineBatchValidator({ "FOOBAD" }, { "BAR" });
+  c.SetSemanticDefineValidator(pValidator);
+  IDxcOperationResult *pCompileResult = c.Compile(
+    "#define FOO 1\n"
+    "#define FOOBAD 2\n"
+    "#define FOOBARBAZ 3\n"
+    "#define BAR 4\n"
+    "#define BARBAZ 5\n"
+    "float4 main() : SV_Target {\n"
+    "  return 0;\n"
+    "}\n",
+    {L"/Vd"}, {}
+  );
+
+  // FOO, FOOBAD and BAR are validated together.
+  VERIFY_ARE_EQUAL(1u, pValidator->BatchCalls);
+  VERIFY_ARE_EQUAL(3u, pValidator->BatchedDefines);
+  VERIFY_ARE_EQUAL(0u, pValidator->SingleCalls);
+
+  CheckOperationFailed(pCompileResult);
+  std::string errors = GetCompileErrors(pCompileResult);
+  VERIFY_IS_TRUE(
+    errors.npos !=
+    errors.find("hlsl.hlsl:2:9: error: bad define: FOOBAD"));
+  VERIFY_IS_TRUE(
+    errors.npos !=
+    errors.find("hlsl.hlsl:4:9: warning: bad define: BAR"));
+}
+
 TEST_F(ExtensionTest, DefineFromMacro) {
   Compiler c(m_dllSupport);
   c.RegisterSemanticDefine(L"FOO*");
@@ -1314,7 +1314,9 @@ struct GlobalPerThreadSys {
 
 int run_main() {
   // HLSL Change Starts
-  GlobalPerThreadSys gpts;
+  // Set up once for the process; tests may run FileCheck on several threads
+  // at once.
+  static GlobalPerThreadSys gpts;
   if (!gpts.success) {
     return 1;
   }
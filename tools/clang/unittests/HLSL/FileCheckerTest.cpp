@@ -18,6 +18,8 @@
 #include <string>
 #include <cassert>
 #include <algorithm>
+#include <fstream>
+#include <sstream>
 #include "dxc/Support/WinIncludes.h"
 #include "dxc/dxcapi.h"
 #include <atlfile.h>
@@ -28,6 +30,8 @@
 #include "DxcTestUtils.h"
 
 #include "llvm/Support/raw_os_ostream.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/ADT/SmallString.h"
 #include "dxc/Support/Global.h"
 #include "dxc/Support/dxcapi.use.h"
 #include "dxc/Support/HLSLOptions.h"
@@ -61,15 +65,132 @@ static string trim(string value) {
   return value;
 }
 
+static bool ReadFileBytes(LPCWSTR path, std::string &bytes) {
+  std::ifstream infile(path, std::ios::binary);
+  if (!infile)
+    return false;
+  std::ostringstream contents;
+  contents << infile.rdbuf();
+  bytes = contents.str();
+  return true;
+}
+
+static std::string FinalMD5String(llvm::MD5 &hash) {
+  llvm::MD5::MD5Result result;
+  hash.final(result);
+  llvm::SmallString<32> str;
+  llvm::MD5::stringifyResult(result, str);
+  return str.str();
+}
+
+FileRunCompileCache::FileRunCompileCache(LPCWSTR cacheDir,
+                                         LPCWSTR compilerPath)
+    : m_cacheDir(cacheDir) {
+  // A different compiler build must not reuse results, so the binary itself
+  // is part of every key.
+  std::string compilerBytes;
+  IFTBOOL(ReadFileBytes(compilerPath, compilerBytes),
+          HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND));
+  llvm::MD5 hash;
+  hash.update(compilerBytes);
+  m_compilerHash = FinalMD5String(hash);
+  CreateDirectoryW(cacheDir, nullptr);
+}
+
+bool FileRunCompileCache::GetKey(LPCWSTR fileName,
+                                 const std::string &arguments,
+                                 std::string &key) {
+  std::string source;
+  if (!ReadFileBytes(fileName, source))
+    return false;
+  // Included files aren't part of the key.
+  if (source.find("#include") != std::string::npos)
+    return false;
+  llvm::MD5 hash;
+  hash.update(m_compilerHash);
+  hash.update(arguments);
+  hash.update(llvm::StringRef("\0", 1));
+  hash.update(source);
+  key = FinalMD5String(hash);
+  return true;
+}
+
+bool FileRunCompileCache::Lookup(const std::string &key, int &runResult,
+                                 std::string &stdOut, std::string &stdErr) {
+  std::wstring path = m_cacheDir + L"\\" + CA2W(key.c_str()).m_psz;
+  std::string entry;
+  if (!ReadFileBytes(path.c_str(), entry))
+    return false;
+  // An entry is the exit code and the size of stdout on one line each,
+  // followed by stdout and stderr.
+  std::istringstream header(entry);
+  int result;
+  size_t outSize;
+  if (!(header >> result >> outSize) || header.get() != '\n')
+    return false;
+  size_t outStart = (size_t)header.tellg();
+  if (outStart + outSize > entry.size())
+    return false;
+  runResult = result;
+  stdOut = entry.substr(outStart, outSize);
+  stdErr = entry.substr(outStart + outSize);
+  return true;
+}
+
+void FileRunCompileCache::Store(const std::string &key, int runResult,
+                                const std::string &stdOut,
+                                const std::string &stdErr) {
+  std::wstring path = m_cacheDir + L"\\" + CA2W(key.c_str()).m_psz;
+  // Write a private file and move it into place, so concurrent runs never
+  // read a partial entry.
+  std::wstring tempPath = path + L"." + std::to_wstring(GetCurrentThreadId());
+  {
+    std::ofstream outfile(tempPath, std::ios::binary);
+    if (!outfile)
+      return;
+    outfile << runResult << ' ' << stdOut.size() << '\n' << stdOut << stdErr;
+    if (!outfile)
+      return;
+  }
+  if (!MoveFileExW(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING))
+    DeleteFileW(tempPath.c_str());
+}
+
+// Reads the wall time and peak memory of the whole compile from the first row
+// of a -report-phases report.
+static bool ReadCompileStats(const std::string &report, double &seconds,
+                             unsigned long long &peakBytes) {
+  std::istringstream lines(report);
+  std::string header, row;
+  if (!std::getline(lines, header) || !std::getline(lines, row))
+    return false;
+  // phase, depth, count, wall_us, allocs, alloc_bytes, peak_bytes
+  llvm::SmallVector<llvm::StringRef, 8> fields;
+  llvm::StringRef(row).split(fields, "\t");
+  unsigned long long wallMicroseconds;
+  if (fields.size() != 7 || fields[3].getAsInteger(10, wallMicroseconds) ||
+      fields[6].getAsInteger(10, peakBytes))
+    return false;
+  seconds = wallMicroseconds / 1e6;
+  return true;
+}
+
     FileRunCommandPart::FileRunCommandPart(const std::string &command, const std::string &arguments, LPCWSTR commandFileName) :
-      Command(command), Arguments(arguments), CommandFileName(commandFileName) { }
+      Command(command), Arguments(arguments), CommandFileName(commandFileName),
+      DllSupport(nullptr), CompileCache(nullptr), RecordCompileStats(false),
+      CompileSeconds(0), CompilePeakBytes(0) { }
     FileRunCommandPart::FileRunCommandPart(FileRunCommandPart && other) :
       Command(std::move(other.Command)),
       CommandFileName(other.CommandFileName),
       Arguments(std::move(other.Arguments)),
+      DllSupport(other.DllSupport),
+      CompileCache(other.CompileCache),
+      RecordCompileStats(other.RecordCompileStats),
       RunResult(other.RunResult),
       StdOut(std::move(other.StdOut)),
-      StdErr(std::move(other.StdErr)) { }
+      StdErr(std::move(other.StdErr)),
+      CompileSeconds(other.CompileSeconds),
+      CompilePeakBytes(other.CompilePeakBytes) { }
 
     void FileRunCommandPart::Run(const FileRunCommandPart *Prior) {
       bool isFileCheck =
@@ -199,6 +320,16 @@ static string trim(string value) {
       hlsl::options::DxcOpts opts;
       ReadOptsForDxc(args, opts);
 
+      if (RecordCompileStats) {
+        flags.push_back(L"-report-phases");
+      }
+
+      std::string cacheKey;
+      if (CompileCache && !RecordCompileStats &&
+          CompileCache->GetKey(CommandFileName, Arguments, cacheKey) &&
+          CompileCache->Lookup(cacheKey, RunResult, StdOut, StdErr))
+        return;
+
       std::wstring entry =
           Unicode::UTF8ToUTF16StringOrThrow(opts.EntryPoint.str().c_str());
       std::wstring profile =
@@ -250,6 +381,17 @@ static string trim(string value) {
       }
 
       OpResult = pResult;
+      // Compiles that fail before the report is written record nothing.
+      CComPtr<IDxcOperationResultReport> pResultReport;
+      CComPtr<IDxcBlobEncoding> pReport;
+      if (RecordCompileStats &&
+          SUCCEEDED(pResult.QueryInterface(&pResultReport)) &&
+          SUCCEEDED(pResultReport->GetReport(&pReport)) && pReport) {
+        ReadCompileStats(BlobToUtf8(pReport), CompileSeconds,
+                         CompilePeakBytes);
+      }
+      if (!cacheKey.empty())
+        CompileCache->Store(cacheKey, RunResult, StdOut, StdErr);
     }
 
     void FileRunCommandPart::RunDxv(const FileRunCommandPart *Prior) {
@@ -382,6 +524,8 @@ static string trim(string value) {
 
 class FileRunTestResultImpl : public FileRunTestResult {
   dxc::DxcDllSupport &m_support;
+  FileRunCompileCache *m_pCache;
+  bool m_recordCompileStats;
 
   void RunFileCheckFromCommands(LPCSTR commands, LPCWSTR fileName) {
     std::vector<FileRunCommandPart> parts;
@@ -389,9 +533,18 @@ class FileRunTestResultImpl : public FileRunTestResult {
     FileRunCommandPart *prior = nullptr;
     for (FileRunCommandPart & part : parts) {
       part.DllSupport = &m_support;
+      part.CompileCache = m_pCache;
+      part.RecordCompileStats = m_recordCompileStats;
       part.Run(prior);
       prior = &part;
     }
+    this->CompileSeconds = 0;
+    this->CompilePeakBytes = 0;
+    for (const FileRunCommandPart &part : parts) {
+      this->CompileSeconds += part.CompileSeconds;
+      this->CompilePeakBytes =
+          std::max(this->CompilePeakBytes, part.CompilePeakBytes);
+    }
     if (prior == nullptr) {
       this->RunResult = 1;
       this->ErrorMessage = "FileCheck found no commands to run";
@@ -403,7 +556,11 @@ class FileRunTestResultImpl : public FileRunTestResult {
   }
 
 public:
-  FileRunTestResultImpl(dxc::DxcDllSupport &support) : m_support(support) {}
+  FileRunTestResultImpl(dxc::DxcDllSupport &support,
+                        FileRunCompileCache *pCache = nullptr,
+                        bool recordCompileStats = false)
+      : m_support(support), m_pCache(pCache),
+        m_recordCompileStats(recordCompileStats) {}
   void RunFileCheckFromFileCommands(LPCWSTR fileName) {
     // Assume UTF-8 files.
     std::string commands(GetFirstLine(fileName));
@@ -425,6 +582,14 @@ FileRunTestResult FileRunTestResult::RunFromFileCommands(LPCWSTR fileName, dxc::
   return result;
 }
 
+FileRunTestResult FileRunTestResult::RunFromFileCommands(LPCWSTR fileName, dxc::DxcDllSupport &dllSupport,
+                                                         FileRunCompileCache *pCache,
+                                                         bool recordCompileStats) {
+  FileRunTestResultImpl result(dllSupport, pCache, recordCompileStats);
+  result.RunFileCheckFromFileCommands(fileName);
+  return result;
+}
+
 void ParseCommandParts(LPCSTR commands, LPCWSTR fileName,
                        std::vector<FileRunCommandPart> &parts) {
   // Barely enough parsing here.
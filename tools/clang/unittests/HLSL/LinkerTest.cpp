@@ -21,6 +21,7 @@
 #include "WexTestClass.h"
 #include "HlslTestUtils.h"
 #include "dxc/dxcapi.h"
+#include "dxc/HLSL/DxilContainer.h"
 #include "DxcTestUtils.h"
 
 using namespace std;
@@ -39,14 +40,19 @@ public:
   TEST_CLASS_SETUP(InitSupport);
 
   TEST_METHOD(RunLinkResource);
+  TEST_METHOD(RunLinkResourceRemap);
   TEST_METHOD(RunLinkAllProfiles);
+  TEST_METHOD(RunLinkBatch);
   TEST_METHOD(RunLinkFailNoDefine);
   TEST_METHOD(RunLinkFailReDefine);
   TEST_METHOD(RunLinkGlobalInit);
+  TEST_METHOD(RunLinkReuseLibs);
+  TEST_METHOD(RunLinkWithLinkIndex);
   TEST_METHOD(RunLinkNoAlloca);
   TEST_METHOD(RunLinkFailReDefineGlobal);
   TEST_METHOD(RunLinkFailProfileMismatch);
   TEST_METHOD(RunLinkFailEntryNoProps);
+  TEST_METHOD(RunLinkWhenRepeatedThenOutputIdentical);
 
 
   dxc::DxcDllSupport m_dllSupport;
@@ -79,6 +85,21 @@ public:
     VERIFY_SUCCEEDED(pResult->GetResult(pResultBlob));
   }
 
+  void LinkProgram(LPCWSTR pEntryName, LPCWSTR pShaderModel,
+                   IDxcLinker *pLinker, ArrayRef<LPCWSTR> libNames,
+                   IDxcBlob **ppProgram) {
+    CComPtr<IDxcOperationResult> pResult;
+    VERIFY_SUCCEEDED(pLinker->Link(pEntryName, pShaderModel, libNames.data(),
+                                   libNames.size(), nullptr, 0, &pResult));
+    CheckOperationSucceeded(pResult, ppProgram);
+  }
+
+  static bool BlobsEqual(IDxcBlob *pA, IDxcBlob *pB) {
+    return pA->GetBufferSize() == pB->GetBufferSize() &&
+           0 == memcmp(pA->GetBufferPointer(), pB->GetBufferPointer(),
+                       pA->GetBufferSize());
+  }
+
   void RegisterDxcModule(LPCWSTR pLibName, IDxcBlob *pBlob,
                          IDxcLinker *pLinker) {
     VERIFY_SUCCEEDED(pLinker->RegisterLibrary(pLibName, pBlob));
@@ -141,6 +162,37 @@ TEST_F(LinkerTest, RunLinkResource) {
   Link(L"entry", L"cs_6_0", pLinker, {libResName, libName}, {} ,{});
 }
 
+TEST_F(LinkerTest, RunLinkResourceRemap) {
+  CComPtr<IDxcBlob> pResLib;
+  CompileLib(L"..\\CodeGenHLSL\\lib_resource2.hlsl", &pResLib);
+  CComPtr<IDxcBlob> pEntryLib;
+  CompileLib(L"..\\CodeGenHLSL\\lib_cs_entry.hlsl", &pEntryLib);
+  CComPtr<IDxcLinker> pLinker;
+  CreateLinker(&pLinker);
+  LPCWSTR libNames[] = {L"res", L"entry"};
+  RegisterDxcModule(libNames[0], pResLib, pLinker);
+  RegisterDxcModule(libNames[1], pEntryLib, pLinker);
+
+  CComPtr<IDxcOperationResult> pResult;
+  VERIFY_SUCCEEDED(pLinker->Link(L"entry", L"cs_6_0", libNames,
+                                 _countof(libNames), nullptr, 0, &pResult));
+  CComPtr<IDxcBlob> pProgram;
+  CheckOperationSucceeded(pResult, &pProgram);
+
+  CComPtr<IDxcOperationResultReport> pResultReport;
+  VERIFY_SUCCEEDED(pResult.QueryInterface(&pResultReport));
+  CComPtr<IDxcBlobEncoding> pRemap;
+  VERIFY_SUCCEEDED(pResultReport->GetReport(&pRemap));
+  VERIFY_IS_NOT_NULL(pRemap.p);
+  std::string remap = BlobToUtf8(pRemap);
+  VERIFY_IS_TRUE(remap.find("class\tname\tid\t") == 0);
+  // Resources only referenced by code that isn't linked are removed.
+  VERIFY_IS_TRUE(remap.find("\tfA\t") != std::string::npos);
+  VERIFY_IS_TRUE(remap.find("cbuffer\tA\t") != std::string::npos);
+  VERIFY_IS_TRUE(remap.find("cbuffer\tB\t") != std::string::npos);
+  VERIFY_IS_TRUE(remap.find("unusedBuf") == std::string::npos);
+}
+
 TEST_F(LinkerTest, RunLinkAllProfiles) {
   CComPtr<IDxcLinker> pLinker;
   CreateLinker(&pLinker);
@@ -165,6 +217,47 @@ TEST_F(LinkerTest, RunLinkAllProfiles) {
   Link(L"cs_main", L"cs_6_0", pLinker, {libName, libResName}, {},{});
 }
 
+TEST_F(LinkerTest, RunLinkBatch) {
+  CComPtr<IDxcLinker> pLinker;
+  CreateLinker(&pLinker);
+  CComPtr<IDxcLinker2> pLinker2;
+  VERIFY_SUCCEEDED(pLinker.QueryInterface(&pLinker2));
+
+  LPCWSTR libName = L"entry";
+  CComPtr<IDxcBlob> pEntryLib;
+  CompileLib(L"..\\CodeGenHLSL\\lib_entries2.hlsl", &pEntryLib);
+  RegisterDxcModule(libName, pEntryLib, pLinker);
+
+  LPCWSTR entries[] = {L"vs_main", L"hs_main", L"ds_main",
+                       L"gs_main", L"ps_main", L"vs_main"};
+  // The last entry is linked with a mismatched profile.
+  LPCWSTR profiles[] = {L"vs_6_0", L"hs_6_0", L"ds_6_0",
+                        L"gs_6_0", L"ps_6_0", L"ps_6_0"};
+  const UINT32 entryCount = _countof(entries);
+  IDxcOperationResult *pRawResults[entryCount] = {};
+  VERIFY_SUCCEEDED(pLinker2->LinkBatch(entries, profiles, entryCount,
+                                       &libName, 1, nullptr, 0, pRawResults));
+  CComPtr<IDxcOperationResult> pResults[entryCount];
+  for (UINT32 i = 0; i < entryCount; ++i)
+    pResults[i].Attach(pRawResults[i]);
+  for (UINT32 i = 0; i + 1 < entryCount; ++i) {
+    CComPtr<IDxcBlob> pProgram;
+    CheckOperationSucceeded(pResults[i], &pProgram);
+  }
+  LPCSTR pErrorMsgs[] = {"Profile mismatch between entry function and target "
+                         "profile"};
+  CheckOperationResultMsgs(pResults[entryCount - 1], pErrorMsgs,
+                           _countof(pErrorMsgs), false, false);
+
+  // Link arguments aren't supported, so they are rejected, not dropped.
+  LPCWSTR args[] = {L"-Vd"};
+  IDxcOperationResult *pArgResult = nullptr;
+  VERIFY_ARE_EQUAL(E_INVALIDARG,
+                   pLinker2->LinkBatch(entries, profiles, 1, &libName, 1,
+                                       args, _countof(args), &pArgResult));
+  VERIFY_IS_NULL(pArgResult);
+}
+
 TEST_F(LinkerTest, RunLinkFailNoDefine) {
   CComPtr<IDxcBlob> pEntryLib;
   CompileLib(L"..\\CodeGenHLSL\\lib_cs_entry.hlsl", &pEntryLib);
@@ -208,6 +301,55 @@ TEST_F(LinkerTest, RunLinkGlobalInit) {
        {"dx.op.cbufferLoad"},{});
 }
 
+TEST_F(LinkerTest, RunLinkReuseLibs) {
+  CComPtr<IDxcBlob> pEntryLib;
+  CompileLib(L"..\\CodeGenHLSL\\lib_global.hlsl", &pEntryLib);
+  CComPtr<IDxcLinker> pLinker;
+  CreateLinker(&pLinker);
+
+  LPCWSTR libName = L"entry";
+  RegisterDxcModule(libName, pEntryLib, pLinker);
+  LPCWSTR libName2 = L"entry2";
+  RegisterDxcModule(libName2, pEntryLib, pLinker);
+
+  // Links against the same libraries reuse their loaded functions and init
+  // functions.
+  Link(L"test", L"ps_6_0", pLinker, {libName}, {"dx.op.cbufferLoad"}, {});
+  Link(L"test", L"ps_6_0", pLinker, {libName}, {"dx.op.cbufferLoad"}, {});
+
+  // A failed attach must not be reused by the next link.
+  LinkCheckMsg(L"test", L"ps_6_0", pLinker, {libName, libName2},
+               {"Definition already exists for function"});
+  Link(L"test", L"ps_6_0", pLinker, {libName2}, {"dx.op.cbufferLoad"}, {});
+  Link(L"test", L"ps_6_0", pLinker, {libName}, {"dx.op.cbufferLoad"}, {});
+}
+
+TEST_F(LinkerTest, RunLinkWithLinkIndex) {
+  CComPtr<IDxcBlob> pEntryLib;
+  CompileLib(L"..\\CodeGenHLSL\\lib_global.hlsl", &pEntryLib);
+
+  // Libraries carry the call graph and global usage of their functions.
+  CComPtr<IDxcContainerReflection> pReflection;
+  UINT32 index;
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcContainerReflection,
+                                               &pReflection));
+  VERIFY_SUCCEEDED(pReflection->Load(pEntryLib));
+  VERIFY_SUCCEEDED(pReflection->FindFirstPartKind(DFCC_LinkIndex, &index));
+  CComPtr<IDxcBlob> pIndexBlob;
+  VERIFY_SUCCEEDED(pReflection->GetPartContent(index, &pIndexBlob));
+  VERIFY_IS_TRUE(pIndexBlob->GetBufferSize() >= sizeof(DxilLinkIndexHeader));
+  const DxilLinkIndexHeader *pHeader =
+      (const DxilLinkIndexHeader *)pIndexBlob->GetBufferPointer();
+  VERIFY_IS_TRUE(pHeader->FunctionCount > 0);
+
+  // Init functions found through the index are still linked.
+  CComPtr<IDxcLinker> pLinker;
+  CreateLinker(&pLinker);
+  LPCWSTR libName = L"entry";
+  RegisterDxcModule(libName, pEntryLib, pLinker);
+  Link(L"test", L"ps_6_0", pLinker, {libName}, {"dx.op.cbufferLoad"}, {});
+}
+
 TEST_F(LinkerTest, RunLinkFailReDefineGlobal) {
   CComPtr<IDxcBlob> pEntryLib;
   CompileLib(L"..\\CodeGenHLSL\\lib_global2.hlsl", &pEntryLib);
@@ -278,3 +420,29 @@ TEST_F(LinkerTest, RunLinkNoAlloca) {
 
   Link(L"ps_main", L"ps_6_0", pLinker, {libName, libName2}, {}, {"alloca"});
 }
+
+TEST_F(LinkerTest, RunLinkWhenRepeatedThenOutputIdentical) {
+  // Output is cached by its inputs, so the same inputs must give the same
+  // bytes, for libraries and linked programs alike.
+  CComPtr<IDxcBlob> pResLib, pResLib2;
+  CompileLib(L"..\\CodeGenHLSL\\lib_resource2.hlsl", &pResLib);
+  CompileLib(L"..\\CodeGenHLSL\\lib_resource2.hlsl", &pResLib2);
+  VERIFY_IS_TRUE(BlobsEqual(pResLib, pResLib2));
+  CComPtr<IDxcBlob> pEntryLib, pEntryLib2;
+  CompileLib(L"..\\CodeGenHLSL\\lib_cs_entry.hlsl", &pEntryLib);
+  CompileLib(L"..\\CodeGenHLSL\\lib_cs_entry.hlsl", &pEntryLib2);
+  VERIFY_IS_TRUE(BlobsEqual(pEntryLib, pEntryLib2));
+
+  LPCWSTR libName = L"entry";
+  LPCWSTR libResName = L"res";
+  CComPtr<IDxcBlob> pPrograms[2];
+  for (CComPtr<IDxcBlob> &pProgram : pPrograms) {
+    CComPtr<IDxcLinker> pLinker;
+    CreateLinker(&pLinker);
+    RegisterDxcModule(libName, pEntryLib, pLinker);
+    RegisterDxcModule(libResName, pResLib, pLinker);
+    LinkProgram(L"entry", L"cs_6_0", pLinker, {libResName, libName},
+                &pProgram);
+  }
+  VERIFY_IS_TRUE(BlobsEqual(pPrograms[0], pPrograms[1]));
+}
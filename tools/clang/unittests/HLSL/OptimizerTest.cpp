@@ -89,6 +89,9 @@ public:
   TEST_METHOD(OptimizerWhenSlice1ThenOK)
   TEST_METHOD(OptimizerWhenSlice2ThenOK)
   TEST_METHOD(OptimizerWhenSlice3ThenOK)
+  TEST_METHOD(OptimizerWhenPresetAndTimePassesThenReport)
+  TEST_METHOD(OptimizerWhenLazyThenOnlyRootsRead)
+  TEST_METHOD(OptimizerWhenLazyAndModulePassThenAllRead)
 
   void OptimizerWhenSliceNThenOK(int optLevel);
   void OptimizerWhenSliceNThenOK(int optLevel, LPCWSTR pText, LPCWSTR pTarget);
@@ -130,6 +133,137 @@ TEST_F(OptimizerTest, OptimizerWhenSlice1ThenOK) { OptimizerWhenSliceNThenOK(1);
 TEST_F(OptimizerTest, OptimizerWhenSlice2ThenOK) { OptimizerWhenSliceNThenOK(2); }
 TEST_F(OptimizerTest, OptimizerWhenSlice3ThenOK) { OptimizerWhenSliceNThenOK(3); }
 
+TEST_F(OptimizerTest, OptimizerWhenPresetAndTimePassesThenReport) {
+  const char SampleModule[] =
+    "define float @f(float %a) {\n"
+    "entry:\n"
+    "  %p = alloca float\n"
+    "  store float %a, float* %p\n"
+    "  %v = load float, float* %p\n"
+    "  ret float %v\n"
+    "}\n";
+  CComPtr<IDxcOptimizer> pOptimizer;
+  CComPtr<IDxcBlobEncoding> pModule;
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcOptimizer, &pOptimizer));
+  Utf8ToBlob(m_dllSupport, SampleModule, &pModule);
+
+  // Presets expand to their pass list; the report has one row per pass.
+  {
+    CComPtr<IDxcBlob> pOutputModule;
+    CComPtr<IDxcBlobEncoding> pOutputText;
+    LPCWSTR options[] = { L"-preset:fast-iteration", L"-time-passes" };
+    VERIFY_SUCCEEDED(pOptimizer->RunOptimizer(pModule, options, _countof(options),
+      &pOutputModule, &pOutputText));
+    std::string text = BlobToUtf8(pOutputText);
+    VERIFY_IS_TRUE(text.find("pass\truns\twall_us\tinst_delta\n") != std::string::npos);
+    VERIFY_IS_TRUE(text.find("\nsroa\t1\t") != std::string::npos);
+    VERIFY_IS_TRUE(text.find("\nsimplifycfg\t1\t") != std::string::npos);
+    VERIFY_IS_TRUE(text.find("\ntotal\t-\t") != std::string::npos);
+    // The alloca, store and load are removed.
+    VERIFY_IS_TRUE(text.find("\t-3\n") != std::string::npos);
+  }
+
+  // A preset may be pinned to its current version only.
+  {
+    CComPtr<IDxcBlob> pOutputModule;
+    LPCWSTR options[] = { L"-preset=size@1" };
+    VERIFY_SUCCEEDED(pOptimizer->RunOptimizer(pModule, options, _countof(options),
+      &pOutputModule, nullptr));
+  }
+  LPCWSTR badPresets[] = { L"-preset:size@2", L"-preset:unknown", L"-preset" };
+  for (LPCWSTR pBadPreset : badPresets) {
+    CComPtr<IDxcBlob> pOutputModule;
+    VERIFY_ARE_EQUAL(E_INVALIDARG, pOptimizer->RunOptimizer(pModule, &pBadPreset, 1,
+      &pOutputModule, nullptr));
+  }
+}
+
+TEST_F(OptimizerTest, OptimizerWhenLazyThenOnlyRootsRead) {
+  const char SampleModule[] =
+    "define float @f(float %a) {\n"
+    "entry:\n"
+    "  %p = alloca float\n"
+    "  store float %a, float* %p\n"
+    "  %v = load float, float* %p\n"
+    "  ret float %v\n"
+    "}\n"
+    "define float @g(float %a) {\n"
+    "entry:\n"
+    "  %p = alloca float\n"
+    "  store float %a, float* %p\n"
+    "  %v = load float, float* %p\n"
+    "  ret float %v\n"
+    "}\n";
+  CComPtr<IDxcOptimizer> pOptimizer;
+  CComPtr<IDxcBlobEncoding> pModule;
+  CComPtr<IDxcBlob> pBitcode;
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcOptimizer, &pOptimizer));
+  Utf8ToBlob(m_dllSupport, SampleModule, &pModule);
+  VERIFY_SUCCEEDED(pOptimizer->RunOptimizer(pModule, nullptr, 0, &pBitcode,
+    nullptr));
+
+  // Only @f is read and optimized; @g is printed unread.
+  CComPtr<IDxcBlob> pLazyModule;
+  CComPtr<IDxcBlobEncoding> pLazyText;
+  LPCWSTR options[] = { L"-opt-lazy:f", L"-sroa", L"-S" };
+  VERIFY_SUCCEEDED(pOptimizer->RunOptimizer(pBitcode, options, _countof(options),
+    &pLazyModule, &pLazyText));
+  std::string text = BlobToUtf8(pLazyText);
+  VERIFY_IS_TRUE(text.find("; Materializable\ndefine float @g") != std::string::npos);
+  VERIFY_IS_TRUE(text.find("; Materializable\ndefine float @f") == std::string::npos);
+
+  // The written module has both bodies, with @g as it was.
+  CComPtr<IDxcBlob> pOutputModule;
+  CComPtr<IDxcBlobEncoding> pOutputText;
+  LPCWSTR printOptions[] = { L"-S" };
+  VERIFY_SUCCEEDED(pOptimizer->RunOptimizer(pLazyModule, printOptions,
+    _countof(printOptions), &pOutputModule, &pOutputText));
+  text = BlobToUtf8(pOutputText);
+  size_t gPos = text.find("define float @g");
+  VERIFY_IS_TRUE(gPos != std::string::npos);
+  VERIFY_IS_TRUE(text.find("alloca") > text.find("define float @f"));
+  VERIFY_IS_TRUE(text.find("alloca") > gPos);
+
+  LPCWSTR pMissingRoot = L"-opt-lazy:h";
+  CComPtr<IDxcBlob> pMissingModule;
+  VERIFY_ARE_EQUAL(E_INVALIDARG, pOptimizer->RunOptimizer(pBitcode,
+    &pMissingRoot, 1, &pMissingModule, nullptr));
+}
+
+TEST_F(OptimizerTest, OptimizerWhenLazyAndModulePassThenAllRead) {
+  // @g is only used from @h, which is not a lazy root.
+  const char SampleModule[] =
+    "define float @f(float %a) {\n"
+    "entry:\n"
+    "  ret float %a\n"
+    "}\n"
+    "define internal float @g(float %a) {\n"
+    "entry:\n"
+    "  ret float %a\n"
+    "}\n"
+    "define float @h(float %a) {\n"
+    "entry:\n"
+    "  %v = call float @g(float %a)\n"
+    "  ret float %v\n"
+    "}\n";
+  CComPtr<IDxcOptimizer> pOptimizer;
+  CComPtr<IDxcBlobEncoding> pModule;
+  CComPtr<IDxcBlob> pBitcode;
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcOptimizer, &pOptimizer));
+  Utf8ToBlob(m_dllSupport, SampleModule, &pModule);
+  VERIFY_SUCCEEDED(pOptimizer->RunOptimizer(pModule, nullptr, 0, &pBitcode,
+    nullptr));
+
+  CComPtr<IDxcBlob> pOutputModule;
+  CComPtr<IDxcBlobEncoding> pOutputText;
+  LPCWSTR options[] = { L"-opt-lazy:f", L"-globaldce", L"-S" };
+  VERIFY_SUCCEEDED(pOptimizer->RunOptimizer(pBitcode, options, _countof(options),
+    &pOutputModule, &pOutputText));
+  std::string text = BlobToUtf8(pOutputText);
+  VERIFY_IS_TRUE(text.find("define internal float @g") != std::string::npos);
+  VERIFY_IS_TRUE(text.find("; Materializable") == std::string::npos);
+}
+
 void OptimizerTest::OptimizerWhenSliceNThenOK(int optLevel) {
   LPCWSTR SampleProgram =
     L"Texture2D g_Tex;\r\n"
@@ -80,6 +80,8 @@ public:
   TEST_METHOD(RunNoFunctionBodyInclude);
   TEST_METHOD(RunNoStatic);
   TEST_METHOD(RunKeepUserMacro);
+  TEST_METHOD(RunRemoveUnusedGlobalsBatch);
+  TEST_METHOD(RunRemoveUnusedGlobalsUnion);
 
   dxc::DxcDllSupport m_dllSupport;
   CComPtr<IDxcIncludeHandler> m_pIncludeHandler;
@@ -608,4 +610,72 @@ float test(float a, float b) {\n\
 #define X 1\n\
 #define Y(A, B)  ( ( A ) + ( B ) )\n\
 ") == 0);
-}
\ No newline at end of file
+}
+
+TEST_F(RewriterTest, RunRemoveUnusedGlobalsBatch) {
+  CComPtr<IDxcRewriter> pRewriter;
+  CComPtr<IDxcRewriter2> pRewriter2;
+  VERIFY_SUCCEEDED(CreateRewriter(&pRewriter));
+  VERIFY_SUCCEEDED(pRewriter.QueryInterface(&pRewriter2));
+
+  char text[] = "float a;\n"
+                "float b;\n"
+                "float fa() { return a; }\n"
+                "float fb() { return b; }\n";
+  CComPtr<IDxcBlobEncoding> source;
+  CreateBlobPinned(text, sizeof(text) - 1, CP_UTF8, &source);
+
+  // Each entry point keeps only what it reaches, whatever was removed for
+  // the entry points before it.
+  LPCWSTR entryPoints[] = { L"fa", L"fb", L"fa" };
+  IDxcOperationResult *pResults[_countof(entryPoints)];
+  VERIFY_SUCCEEDED(pRewriter2->RemoveUnusedGlobalsBatch(
+      source, entryPoints, _countof(entryPoints), nullptr, 0,
+      DxcRewriterBatchFlags_None, pResults));
+
+  for (size_t i = 0; i < _countof(entryPoints); ++i) {
+    CComPtr<IDxcOperationResult> pRewriteResult;
+    pRewriteResult.Attach(pResults[i]);
+    CComPtr<IDxcBlob> result;
+    VERIFY_SUCCEEDED(pRewriteResult->GetResult(&result));
+    std::string strResult = BlobToUtf8(result);
+    bool isA = wcscmp(entryPoints[i], L"fa") == 0;
+    VERIFY_ARE_EQUAL(isA, strResult.find("float a;") != std::string::npos);
+    VERIFY_ARE_EQUAL(isA, strResult.find("fa()") != std::string::npos);
+    VERIFY_ARE_EQUAL(!isA, strResult.find("float b;") != std::string::npos);
+    VERIFY_ARE_EQUAL(!isA, strResult.find("fb()") != std::string::npos);
+  }
+}
+
+TEST_F(RewriterTest, RunRemoveUnusedGlobalsUnion) {
+  CComPtr<IDxcRewriter> pRewriter;
+  CComPtr<IDxcRewriter2> pRewriter2;
+  VERIFY_SUCCEEDED(CreateRewriter(&pRewriter));
+  VERIFY_SUCCEEDED(pRewriter.QueryInterface(&pRewriter2));
+
+  char text[] = "float a;\n"
+                "float b;\n"
+                "float c;\n"
+                "float fa();\n"
+                "float fb() { return fa() + b; }\n"
+                "float fa() { return a; }\n"
+                "float fc() { return c; }\n";
+  CComPtr<IDxcBlobEncoding> source;
+  CreateBlobPinned(text, sizeof(text) - 1, CP_UTF8, &source);
+
+  // fb reaches fa through its prototype.
+  LPCWSTR entryPoints[] = { L"fb", L"missing" };
+  CComPtr<IDxcOperationResult> pRewriteResult;
+  VERIFY_SUCCEEDED(pRewriter2->RemoveUnusedGlobalsBatch(
+      source, entryPoints, _countof(entryPoints), nullptr, 0,
+      DxcRewriterBatchFlags_Union, &pRewriteResult));
+
+  CComPtr<IDxcBlob> result;
+  VERIFY_SUCCEEDED(pRewriteResult->GetResult(&result));
+  std::string strResult = BlobToUtf8(result);
+  VERIFY_IS_TRUE(strResult.find("float a;") != std::string::npos);
+  VERIFY_IS_TRUE(strResult.find("float b;") != std::string::npos);
+  VERIFY_IS_TRUE(strResult.find("return a;") != std::string::npos);
+  VERIFY_IS_TRUE(strResult.find("float c;") == std::string::npos);
+  VERIFY_IS_TRUE(strResult.find("fc()") == std::string::npos);
+}
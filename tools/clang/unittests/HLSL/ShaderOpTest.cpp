@@ -27,6 +27,8 @@
 #include "HLSLTestUtils.h"          // LogCommentFmt
 
 #include <stdlib.h>
+#include <math.h>
+#include <algorithm>
 #include <DirectXMath.h>
 #include <intsafe.h>
 #include <strsafe.h>
@@ -724,8 +726,25 @@ static void SetDescriptorHeaps(ID3D12GraphicsCommandList *pList,
     pList->SetDescriptorHeaps((UINT)localHeaps.size(), localHeaps.data());
 }
 
-void ShaderOpTest::RunCommandList() {
-  ID3D12GraphicsCommandList *pList = m_CommandList.List.p;
+void ShaderOpTest::CreateTimestampQueries(UINT RunCount) {
+  D3D12_QUERY_HEAP_DESC queryHeapDesc;
+  ZeroMemory(&queryHeapDesc, sizeof(queryHeapDesc));
+  queryHeapDesc.Count = RunCount * 2;
+  queryHeapDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+  m_pTimestampHeap.Release();
+  CHECK_HR(m_pDevice->CreateQueryHeap(&queryHeapDesc, IID_PPV_ARGS(&m_pTimestampHeap)));
+
+  CD3DX12_HEAP_PROPERTIES readback(D3D12_HEAP_TYPE_READBACK);
+  CD3DX12_RESOURCE_DESC readbackDesc(CD3DX12_RESOURCE_DESC::Buffer(queryHeapDesc.Count * sizeof(UINT64)));
+  m_pTimestampBuffer.Release();
+  CHECK_HR(m_pDevice->CreateCommittedResource(
+    &readback, D3D12_HEAP_FLAG_NONE, &readbackDesc,
+    D3D12_RESOURCE_STATE_COPY_DEST, nullptr,
+    IID_PPV_ARGS(&m_pTimestampBuffer)));
+  SetObjectName(m_pTimestampBuffer, "Query Timestamp Readback Buffer");
+}
+
+void ShaderOpTest::RecordShaderOp(ID3D12GraphicsCommandList *pList) {
   if (m_pShaderOp->IsCompute()) {
     pList->SetPipelineState(m_pPSO);
     pList->SetComputeRootSignature(m_pRootSignature);
@@ -763,6 +782,8 @@ void ShaderOpTest::RunCommandList() {
       auto &rt = m_pShaderOp->RenderTargets[i];
       ShaderOpDescriptorData &DData = m_DescriptorData[rt];
       rtvHandles[i] = DData.CPUHandle;
+      if (DData.ResData->ResourceState == D3D12_RESOURCE_STATE_RENDER_TARGET)
+        continue; // Already transitioned by a previous run.
       RecordTransitionBarrier(pList, DData.ResData->Resource,
                               DData.ResData->ResourceState,
                               D3D12_RESOURCE_STATE_RENDER_TARGET);
@@ -807,6 +828,11 @@ void ShaderOpTest::RunCommandList() {
     pList->ResolveQueryData(m_pQueryHeap, D3D12_QUERY_TYPE_PIPELINE_STATISTICS,
                             0, 1, m_pQueryBuffer, 0);
   }
+}
+
+void ShaderOpTest::RunCommandList() {
+  ID3D12GraphicsCommandList *pList = m_CommandList.List.p;
+  RecordShaderOp(pList);
   CHECK_HR(pList->Close());
   ExecuteCommandList(m_CommandList.Queue, pList);
   WaitForSignal(m_CommandList.Queue, m_pFence, m_hFence, m_FenceValue++);
@@ -829,6 +855,57 @@ void ShaderOpTest::RunShaderOp(std::shared_ptr<ShaderOp> ShaderOp) {
   RunShaderOp(m_OrigShaderOp.get());
 }
 
+void ShaderOpTest::RunShaderOpBenchmark(ShaderOp *pShaderOp, UINT WarmUpCount,
+                                        UINT RunCount,
+                                        ShaderOpTimings *pTimings) {
+  m_pShaderOp = pShaderOp;
+
+  CreateDevice();
+  CreateResources();
+  CreateDescriptorHeaps();
+  CreatePipelineState();
+  CreateCommandList();
+  CreateTimestampQueries(RunCount);
+
+  // Each run is its own submission so that runs cannot overlap on the GPU.
+  ID3D12GraphicsCommandList *pList = m_CommandList.List.p;
+  for (UINT i = 0; i < WarmUpCount + RunCount; ++i) {
+    if (i > 0) {
+      CHECK_HR(m_CommandList.Allocator->Reset());
+      CHECK_HR(pList->Reset(m_CommandList.Allocator, nullptr));
+    }
+    bool measured = i >= WarmUpCount;
+    UINT query = (i - WarmUpCount) * 2;
+    if (measured)
+      pList->EndQuery(m_pTimestampHeap, D3D12_QUERY_TYPE_TIMESTAMP, query);
+    RecordShaderOp(pList);
+    if (measured) {
+      pList->EndQuery(m_pTimestampHeap, D3D12_QUERY_TYPE_TIMESTAMP, query + 1);
+      pList->ResolveQueryData(m_pTimestampHeap, D3D12_QUERY_TYPE_TIMESTAMP,
+                              query, 2, m_pTimestampBuffer,
+                              query * sizeof(UINT64));
+    }
+    CHECK_HR(pList->Close());
+    ExecuteCommandList(m_CommandList.Queue, pList);
+    WaitForSignal(m_CommandList.Queue, m_pFence, m_hFence, m_FenceValue++);
+  }
+
+  UINT64 frequency;
+  CHECK_HR(m_CommandList.Queue->GetTimestampFrequency(&frequency));
+  {
+    MappedData M(m_pTimestampBuffer, RunCount * 2 * sizeof(UINT64));
+    const UINT64 *pTicks = (const UINT64 *)M.data();
+    pTimings->SamplesMs.clear();
+    for (UINT i = 0; i < RunCount; ++i) {
+      UINT64 ticks = pTicks[i * 2 + 1] - pTicks[i * 2];
+      pTimings->SamplesMs.push_back(ticks * 1000.0 / frequency);
+    }
+  }
+  pTimings->ComputeStats();
+
+  CopyBackResources();
+}
+
 void ShaderOpTest::SetRootValues(ID3D12GraphicsCommandList *pList,
   bool isCompute) {
   for (size_t i = 0; i < m_pShaderOp->RootValues.size(); ++i) {
@@ -890,6 +967,25 @@ void ShaderOpTest::SetRootValues(ID3D12GraphicsCommandList *pList,
   }
 }
 
+void ShaderOpTimings::ComputeStats() {
+  MedianMs = StdDevMs = 0;
+  if (SamplesMs.empty())
+    return;
+  std::vector<double> sorted(SamplesMs);
+  std::sort(sorted.begin(), sorted.end());
+  size_t mid = sorted.size() / 2;
+  MedianMs = (sorted.size() % 2) ? sorted[mid]
+                                 : (sorted[mid - 1] + sorted[mid]) / 2;
+  double mean = 0;
+  for (double S : SamplesMs)
+    mean += S;
+  mean /= SamplesMs.size();
+  double variance = 0;
+  for (double S : SamplesMs)
+    variance += (S - mean) * (S - mean);
+  StdDevMs = sqrt(variance / SamplesMs.size());
+}
+
 void ShaderOpTest::SetDevice(ID3D12Device *pDevice) {
   m_pDevice = pDevice;
 }
@@ -231,6 +231,14 @@ struct CommandListRefs {
   void CreateForDevice(ID3D12Device *pDevice, bool compute);
 };
 
+// Use this structure to hold the GPU timings of a benchmarked ShaderOp.
+struct ShaderOpTimings {
+  std::vector<double> SamplesMs; // GPU time of each measured run.
+  double MedianMs = 0;
+  double StdDevMs = 0;
+  void ComputeStats();
+};
+
 // Use this class to run the operation described in a ShaderOp object.
 class ShaderOpTest {
 public:
@@ -239,6 +247,10 @@ public:
   void GetReadBackData(LPCSTR pResourceName, MappedData *pData);
   void RunShaderOp(ShaderOp *pShaderOp);
   void RunShaderOp(std::shared_ptr<ShaderOp> pShaderOp);
+  // Runs the operation WarmUpCount times unmeasured, then RunCount times
+  // between GPU timestamps; resources are read back after the last run.
+  void RunShaderOpBenchmark(ShaderOp *pShaderOp, UINT WarmUpCount,
+                            UINT RunCount, ShaderOpTimings *pTimings);
   void SetDevice(ID3D12Device* pDevice);
   void SetDxcSupport(dxc::DxcDllSupport *pDxcSupport);
   void SetInitCallback(TInitCallbackFn InitCallbackFn);
@@ -267,6 +279,8 @@ private:
   CComPtr<ID3D12RootSignature> m_pRootSignature;
   CComPtr<ID3D12QueryHeap> m_pQueryHeap;
   CComPtr<ID3D12Resource> m_pQueryBuffer;
+  CComPtr<ID3D12QueryHeap> m_pTimestampHeap;
+  CComPtr<ID3D12Resource> m_pTimestampBuffer;
   dxc::DxcDllSupport *m_pDxcSupport = nullptr;
   CommandListRefs m_CommandList;
   HANDLE m_hFence;
@@ -287,6 +301,8 @@ private:
   void CreateResources();
   void CreateRootSignature();
   void CreateShaders();
+  void CreateTimestampQueries(UINT RunCount);
+  void RecordShaderOp(ID3D12GraphicsCommandList *pList);
   void RunCommandList();
   void SetRootValues(ID3D12GraphicsCommandList *pList, bool isCompute);
 };
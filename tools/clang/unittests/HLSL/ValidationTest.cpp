@@ -127,6 +127,8 @@ public:
   TEST_CLASS_SETUP(InitSupport);
 
   TEST_METHOD(WhenCorrectThenOK);
+  TEST_METHOD(WhenFunctionCacheThenChangedBodyRevalidated);
+  TEST_METHOD(WhenManyFunctionsWithStructsThenResultStable);
   TEST_METHOD(WhenMisalignedThenFail);
   TEST_METHOD(WhenEmptyFileThenFail);
   TEST_METHOD(WhenIncorrectMagicThenFail);
@@ -592,6 +594,109 @@ TEST_F(ValidationTest, WhenCorrectThenOK) {
   CheckValidationMsgs(pProgram, nullptr);
 }
 
+TEST_F(ValidationTest, WhenFunctionCacheThenChangedBodyRevalidated) {
+  if (!m_ver.m_InternalValidator) {
+    WEX::Logging::Log::Comment(L"Test skipped due to use of external DXIL.dll validator.");
+    return;
+  }
+  const char *pSource =
+      "float4 main(uint a : A, uint b : B) : SV_Target { return a / b; }";
+  CComPtr<IDxcValidator> pValidator;
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcValidator, &pValidator));
+
+  // Validating the same program again reuses the cached function.
+  CComPtr<IDxcBlob> pProgram;
+  CompileSource(pSource, "ps_6_0", &pProgram);
+  for (int i = 0; i < 2; ++i) {
+    CComPtr<IDxcOperationResult> pResult;
+    VERIFY_SUCCEEDED(pValidator->Validate(
+        pProgram, DxcValidatorFlags_CacheFunctions, &pResult));
+    CheckOperationResultMsgs(pResult, nullptr, false, false);
+  }
+
+  // A changed body is validated again.
+  CComPtr<IDxcBlobEncoding> pSourceBlob;
+  Utf8ToBlob(m_dllSupport, pSource, &pSourceBlob);
+  CComPtr<IDxcBlob> pText;
+  RewriteAssemblyToText(pSourceBlob, "ps_6_0", nullptr, 0, nullptr, 0,
+                        "udiv i32 %([0-9]+), %[0-9]+", "udiv i32 %\\1, 0",
+                        &pText, /*bRegex*/true);
+  CComPtr<IDxcAssembler> pAssembler;
+  CComPtr<IDxcOperationResult> pAssembleResult;
+  CComPtr<IDxcBlob> pChanged;
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcAssembler, &pAssembler));
+  VERIFY_SUCCEEDED(pAssembler->AssembleToContainer(pText, &pAssembleResult));
+  VERIFY_SUCCEEDED(pAssembleResult->GetResult(&pChanged));
+  CComPtr<IDxcOperationResult> pResult;
+  VERIFY_SUCCEEDED(pValidator->Validate(
+      pChanged, DxcValidatorFlags_CacheFunctions, &pResult));
+  CheckOperationResultMsgs(pResult, {"No unsigned integer division by zero"},
+                           false, false);
+}
+
+TEST_F(ValidationTest, WhenManyFunctionsWithStructsThenResultStable) {
+  if (!m_ver.m_InternalValidator) {
+    WEX::Logging::Log::Comment(L"Test skipped due to use of external DXIL.dll validator.");
+    return;
+  }
+  // A library with enough functions to be validated on several threads,
+  // which all look up the layouts of the same struct types.
+  const unsigned StructCount = 8, FunctionCount = 64;
+  std::string source;
+  for (unsigned s = 0; s < StructCount; ++s) {
+    std::string n = std::to_string(s);
+    source += "struct S" + n + " { float" + std::to_string(s % 4 + 1) +
+              " a; uint b[" + n + " + 1]; min16float c; };\n";
+    source += "StructuredBuffer<S" + n + "> In" + n + ";\n";
+    source += "RWStructuredBuffer<S" + n + "> Out" + n + ";\n";
+  }
+  for (unsigned f = 0; f < FunctionCount; ++f) {
+    std::string s = std::to_string(f % StructCount);
+    source += "export void F" + std::to_string(f) + "(uint i) { S" + s +
+              " v = In" + s + "[i]; v.b[0] += " + std::to_string(f) +
+              "; Out" + s + "[i + 1] = v; }\n";
+  }
+
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcBlobEncoding> pSource;
+  CComPtr<IDxcOperationResult> pCompileResult;
+  CComPtr<IDxcBlob> pProgram;
+  Utf8ToBlob(m_dllSupport, source.c_str(), &pSource);
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcCompiler, &pCompiler));
+  VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"hlsl.hlsl", L"", L"lib_6_1",
+                                      nullptr, 0, nullptr, 0, nullptr,
+                                      &pCompileResult));
+  CheckOperationResultMsgs(pCompileResult, nullptr, false, false);
+  VERIFY_SUCCEEDED(pCompileResult->GetResult(&pProgram));
+
+  // Every validation loads the module afresh, with empty layout caches, and
+  // must come to the same result.
+  CComPtr<IDxcValidator> pValidator;
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcValidator, &pValidator));
+  HRESULT firstStatus = S_OK;
+  std::string firstErrors;
+  for (int i = 0; i < 16; ++i) {
+    CComPtr<IDxcOperationResult> pResult;
+    CComPtr<IDxcBlobEncoding> pErrors;
+    HRESULT status;
+    VERIFY_SUCCEEDED(pValidator->Validate(pProgram, DxcValidatorFlags_Default,
+                                          &pResult));
+    VERIFY_SUCCEEDED(pResult->GetStatus(&status));
+    VERIFY_SUCCEEDED(pResult->GetErrorBuffer(&pErrors));
+    std::string errors;
+    if (pErrors)
+      errors.assign((const char *)pErrors->GetBufferPointer(),
+                    pErrors->GetBufferSize());
+    if (i == 0) {
+      firstStatus = status;
+      firstErrors = errors;
+      continue;
+    }
+    VERIFY_ARE_EQUAL(firstStatus, status);
+    VERIFY_IS_TRUE(firstErrors == errors);
+  }
+}
+
 // Lots of these going on below for simplicity in setting up payloads.
 //
 // warning C4838: conversion from 'int' to 'const char' requires a narrowing conversion
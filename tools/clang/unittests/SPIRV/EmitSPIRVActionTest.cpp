@@ -0,0 +1,59 @@
+//===- unittests/SPIRV/EmitSPIRVActionTest.cpp - EmitSPIRVAction tests ----===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "clang/SPIRV/EmitSPIRVAction.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/CompilerInvocation.h"
+#include "clang/Frontend/TextDiagnosticPrinter.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+using namespace clang;
+
+/// Runs action on source, returning whether it succeeded and the
+/// diagnostics it reported in diagnostics.
+bool runAction(FrontendAction &action, llvm::StringRef source,
+               std::string *diagnostics) {
+  CompilerInvocation *invocation = new CompilerInvocation;
+  CompilerInvocation::setLangDefaults(*invocation->getLangOpts(), IK_HLSL,
+                                      LangStandard::lang_hlsl);
+  invocation->getPreprocessorOpts().addRemappedFile(
+      "test.hlsl", llvm::MemoryBuffer::getMemBufferCopy(source).release());
+  invocation->getFrontendOpts().Inputs.push_back(
+      FrontendInputFile("test.hlsl", IK_HLSL));
+  invocation->getTargetOpts().Triple = "dxil-ms-dx";
+
+  llvm::raw_string_ostream diagStream(*diagnostics);
+  CompilerInstance compiler;
+  compiler.setInvocation(invocation);
+  compiler.createDiagnostics(
+      new TextDiagnosticPrinter(diagStream, &invocation->getDiagnosticOpts()),
+      /*ShouldOwnClient*/ true);
+  const bool succeeded = compiler.ExecuteAction(action);
+  diagStream.flush();
+  return succeeded;
+}
+
+TEST(EmitSPIRVModulesAction, UnknownProfileReportsError) {
+  EmitSPIRVOptions options;
+  EmitSPIRVModulesAction action(options, {{"main", "xs_6_0"}});
+  std::string diagnostics;
+  EXPECT_FALSE(runAction(action, "float4 main() : SV_Target { return 0; }",
+                         &diagnostics));
+  EXPECT_NE(std::string::npos,
+            diagnostics.find("unknown shader model 'xs_6_0' for entry "
+                             "point main"));
+  ASSERT_EQ(1u, action.getModules().size());
+  EXPECT_TRUE(action.getModules()[0].empty());
+}
+
+} // anonymous namespace
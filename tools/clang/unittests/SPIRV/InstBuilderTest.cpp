@@ -158,6 +158,17 @@ TEST(InstBuilder, NullConsumerResultsInError) {
   EXPECT_EQ(InstBuilder::Status::NullConsumer, ib.opNop().x());
 }
 
+TEST(InstBuilder, ConstructSiteHoldsLastInst) {
+  std::vector<uint32_t> site;
+  auto ib = InstBuilder(&site);
+  expectBuildSuccess(ib.opNop().x());
+  EXPECT_THAT(site, ContainerEq(constructInst(spv::Op::OpNop, {})));
+  // Each finished instruction replaces the previous one.
+  expectBuildSuccess(ib.opTypeFloat(1, 32).x());
+  EXPECT_THAT(site,
+              ContainerEq(constructInst(spv::Op::OpTypeFloat, {1, 32})));
+}
+
 TEST(InstBuilder, InstWStringParams) {
   std::vector<uint32_t> result;
   auto ib = constructInstBuilder(result);
@@ -71,4 +71,30 @@ TEST(ModuleBuilder, CreateBasicBlock) {
   EXPECT_THAT(result, ContainerEq(sib.get()));
 }
 
+TEST(ModuleBuilder, GroupSharedDecorations) {
+  SPIRVContext context;
+  ModuleBuilder builder(&context);
+  builder.setGroupDecorations(true);
+
+  const auto var1 = context.takeNextId();
+  const auto var2 = context.takeNextId();
+  const auto var3 = context.takeNextId();
+  builder.decorateDSetBindings({{var1, 0, 0}, {var2, 0, 1}, {var3, 0, 2}});
+  const auto groupId = context.getNextId();
+  const auto result = builder.takeModule();
+
+  const auto binding = static_cast<uint32_t>(spv::Decoration::Binding);
+  const auto dset = static_cast<uint32_t>(spv::Decoration::DescriptorSet);
+  SimpleInstBuilder sib(context.getNextId());
+  sib.inst(spv::Op::OpDecorate, {var1, binding, 0});
+  sib.inst(spv::Op::OpDecorate, {var2, binding, 1});
+  sib.inst(spv::Op::OpDecorate, {var3, binding, 2});
+  // The descriptor set shared by all three goes through a group.
+  sib.inst(spv::Op::OpDecorate, {groupId, dset, 0});
+  sib.inst(spv::Op::OpDecorationGroup, {groupId});
+  sib.inst(spv::Op::OpGroupDecorate, {groupId, var1, var2, var3});
+
+  EXPECT_THAT(result, ContainerEq(sib.get()));
+}
+
 } // anonymous namespace
@@ -93,6 +93,33 @@ TEST(SPIRVContext, UniqueIdForUniqueConstants) {
   EXPECT_NE(uint1Id, float1Id);
   EXPECT_NE(int1Id, anotherInt1Id);
 }
+
+TEST(SPIRVContext, UniqueConstantsSurviveTableGrowth) {
+  SPIRVContext ctx;
+  std::vector<const Constant *> constants;
+  std::vector<uint32_t> ids;
+  // Enough constants to grow the interning table several times.
+  for (uint32_t i = 0; i < 1000; ++i) {
+    constants.push_back(Constant::getUint32(ctx, /*type_id*/ 1, i));
+    ids.push_back(ctx.getResultIdForConstant(constants.back()));
+  }
+
+  for (uint32_t i = 0; i < 1000; ++i) {
+    EXPECT_EQ(Constant::getUint32(ctx, 1, i), constants[i]);
+    EXPECT_EQ(ctx.getResultIdForConstant(constants[i]), ids[i]);
+  }
+}
+
+TEST(SPIRVContext, ReportsWhetherTypeIsRegistered) {
+  SPIRVContext ctx;
+  const Type *boolt = Type::getBool(ctx);
+  bool isRegistered = true;
+  const uint32_t id = ctx.getResultIdForType(boolt, &isRegistered);
+  EXPECT_FALSE(isRegistered);
+  EXPECT_EQ(ctx.getResultIdForType(Type::getBool(ctx), &isRegistered), id);
+  EXPECT_TRUE(isRegistered);
+}
+
 // TODO: Add more SPIRVContext tests
 
 } // anonymous namespace
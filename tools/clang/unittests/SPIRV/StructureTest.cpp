@@ -51,6 +51,29 @@ TEST(Structure, InstructionIsNotTerminator) {
   }
 }
 
+TEST(Structure, InstructionListKeepsOrderAndLastOpcode) {
+  InstructionList list;
+  EXPECT_TRUE(list.isEmpty());
+  EXPECT_EQ(list.getLastOpcode(), spv::Op::Max);
+
+  EXPECT_EQ(list.append(constructInst(spv::Op::OpNop, {})), 0u);
+  EXPECT_EQ(list.append(constructInst(spv::Op::OpIAdd, {1, 2, 3, 4})), 1u);
+  EXPECT_EQ(list.getLastOpcode(), spv::Op::OpIAdd);
+
+  InstructionList prologue;
+  prologue.append(constructInst(spv::Op::OpVariable, {1, 5, 7}));
+  list.prepend(std::move(prologue));
+  EXPECT_TRUE(prologue.isEmpty());
+  EXPECT_EQ(list.getLastOpcode(), spv::Op::OpIAdd);
+
+  SimpleInstBuilder sib;
+  sib.inst(spv::Op::OpVariable, {1, 5, 7});
+  sib.inst(spv::Op::OpNop, {});
+  sib.inst(spv::Op::OpIAdd, {1, 2, 3, 4});
+  EXPECT_THAT(list.take(), ContainerEq(sib.get()));
+  EXPECT_TRUE(list.isEmpty());
+}
+
 TEST(Structure, TakeBasicBlockHaveAllContents) {
   std::vector<uint32_t> result;
   auto ib = constructInstBuilder(result);
@@ -33,6 +33,7 @@
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/raw_ostream.h"
 #include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <comdef.h>
 #include <thread>
@@ -85,7 +86,8 @@ public:
   DxcContext(DxcOpts &Opts, DxcDllSupport &dxcSupport)
       : m_Opts(Opts), m_dxcSupport(dxcSupport) {}
 
-  int Compile(llvm::StringRef path, bool bLibLink);
+  int Compile(llvm::StringRef path, bool bLibLink,
+              IDxcCompiler *pSharedCompiler = nullptr);
   int DumpBinary();
   void Preprocess();
 };
@@ -136,8 +138,11 @@ static void PrintHlslException(const ::hlsl::Exception &hlslException,
   }
 }
 
+// Runs a single batch command. If pCompiler is provided, it is used instead
+// of creating a new compiler instance for the command.
 static int Compile(llvm::StringRef command, DxcDllSupport &dxcSupport,
-                   llvm::StringRef path, bool bLinkLib) {
+                   llvm::StringRef path, bool bLinkLib,
+                   IDxcCompiler *pCompiler = nullptr) {
   const OptTable *optionTable = getHlslOptTable();
   llvm::SmallVector<llvm::StringRef, 4> args;
   command.split(args, " ");
@@ -170,7 +175,7 @@ static int Compile(llvm::StringRef command, DxcDllSupport &dxcSupport,
     } else if (dxcOpts.DumpBin) {
       retVal = context.DumpBinary();
     } else {
-      retVal = context.Compile(path, bLinkLib);
+      retVal = context.Compile(path, bLinkLib, pCompiler);
     }
   } catch (const ::hlsl::Exception &hlslException) {
     PrintHlslException(hlslException, command.str().c_str());
@@ -573,8 +578,9 @@ public:
   }
 };
 
-int DxcContext::Compile(llvm::StringRef path, bool bLibLink) {
-  CComPtr<IDxcCompiler> pCompiler;
+int DxcContext::Compile(llvm::StringRef path, bool bLibLink,
+                        IDxcCompiler *pSharedCompiler) {
+  CComPtr<IDxcCompiler> pCompiler(pSharedCompiler);
   CComPtr<IDxcOperationResult> pCompileResult;
   CComPtr<IDxcBlob> pDebugBlob;
   std::wstring debugName;
@@ -598,7 +604,8 @@ int DxcContext::Compile(llvm::StringRef path, bool bLibLink) {
 
     CComPtr<IDxcLibrary> pLibrary;
     IFT(m_dxcSupport.CreateInstance(CLSID_DxcLibrary, &pLibrary));
-    IFT(m_dxcSupport.CreateInstance(CLSID_DxcCompiler, &pCompiler));
+    if (pCompiler == nullptr)
+      IFT(m_dxcSupport.CreateInstance(CLSID_DxcCompiler, &pCompiler));
     if (path.empty()) {
       ReadFileIntoBlob(m_dxcSupport, StringRefUtf16(m_Opts.InputFile),
                        &pSource);
@@ -770,17 +777,81 @@ public:
   DxcBatchContext(DxcOpts &Opts, DxcDllSupport &dxcSupport)
       : m_Opts(Opts), m_dxcSupport(dxcSupport) {}
 
-  int BatchCompile(bool bMultiThread, bool bLibLink);
+  int BatchCompile(bool bMultiThread, bool bLibLink, bool bReport);
 
 private:
+  struct CommandResult {
+    int RetVal = 0;
+    double DurationMs = 0;
+    bool Done = false;
+  };
+
+  void RunWorker(llvm::ArrayRef<llvm::StringRef> commands,
+                 llvm::StringRef path, bool bLibLink,
+                 std::vector<CommandResult> &results);
+  void PrintReport(llvm::ArrayRef<llvm::StringRef> commands,
+                   llvm::ArrayRef<CommandResult> results, double durationMs);
+
   DxcOpts &m_Opts;
   DxcDllSupport &m_dxcSupport;
+  std::atomic<unsigned> m_nextCommand;
+  std::atomic<unsigned> m_completed;
 };
 
-int DxcBatchContext::BatchCompile(bool bMultiThread, bool bLibLink) {
-  DxcOpts tmp_Opts;
-  // tmp_Opts = m_Opts;
-  m_Opts.InputFile;
+// Claims unstarted commands until none are left, so that a slow command only
+// delays the worker running it. Each worker keeps one compiler for all of
+// the commands it runs.
+void DxcBatchContext::RunWorker(llvm::ArrayRef<llvm::StringRef> commands,
+                                llvm::StringRef path, bool bLibLink,
+                                std::vector<CommandResult> &results) {
+  CComPtr<IDxcCompiler> pCompiler;
+  if (FAILED(m_dxcSupport.CreateInstance(CLSID_DxcCompiler, &pCompiler)))
+    pCompiler.Release(); // Fall back to a compiler per command.
+
+  for (;;) {
+    unsigned i = m_nextCommand++;
+    if (i >= commands.size())
+      break;
+    llvm::StringRef command = commands[i];
+    if (command.empty() || command.startswith("//"))
+      continue;
+
+    auto t_start = std::chrono::high_resolution_clock::now();
+    results[i].RetVal =
+        ::Compile(command, m_dxcSupport, path, bLibLink, pCompiler);
+    auto t_end = std::chrono::high_resolution_clock::now();
+    results[i].DurationMs =
+        std::chrono::duration<double, std::milli>(t_end - t_start).count();
+    results[i].Done = true;
+    ++m_completed;
+  }
+}
+
+void DxcBatchContext::PrintReport(llvm::ArrayRef<llvm::StringRef> commands,
+                                  llvm::ArrayRef<CommandResult> results,
+                                  double durationMs) {
+  unsigned compiled = 0, failed = 0;
+  double totalMs = 0;
+  for (unsigned i = 0; i < commands.size(); i++) {
+    if (!results[i].Done)
+      continue;
+    ++compiled;
+    if (results[i].RetVal != 0)
+      ++failed;
+    totalMs += results[i].DurationMs;
+    fprintf(stderr, "%10.2f ms %s %s\n", results[i].DurationMs,
+            results[i].RetVal == 0 ? "ok    " : "failed",
+            commands[i].str().c_str());
+  }
+  fprintf(stderr, "%u commands, %u failed, %.2f ms compiling",
+          compiled, failed, totalMs);
+  if (durationMs > 0)
+    fprintf(stderr, " in %.2f ms (%.2fx)", durationMs, totalMs / durationMs);
+  fprintf(stderr, "\n");
+}
+
+int DxcBatchContext::BatchCompile(bool bMultiThread, bool bLibLink,
+                                  bool bReport) {
   SmallString<128> path(m_Opts.InputFile.begin(), m_Opts.InputFile.end());
   llvm::sys::path::remove_filename(path);
 
@@ -791,39 +862,44 @@ int DxcBatchContext::BatchCompile(bool bMultiThread, bool bLibLink) {
   llvm::SmallVector<llvm::StringRef, 4> commands;
   source.split(commands, "\r\n");
 
+  std::vector<CommandResult> results(commands.size());
+  m_nextCommand = 0;
+  m_completed = 0;
+  auto t_start = std::chrono::high_resolution_clock::now();
   if (bMultiThread) {
-    unsigned int threadNum = std::min<unsigned>(
-        std::thread::hardware_concurrency(), commands.size());
-    auto empty_fn = []() {};
-    std::vector<std::thread> threads(threadNum);
+    unsigned int threadNum = std::max<unsigned>(1,
+        std::min<unsigned>(std::thread::hardware_concurrency(),
+                           commands.size()));
+    std::vector<std::thread> threads;
+    threads.reserve(threadNum);
     for (unsigned i = 0; i < threadNum; i++)
-      threads[i] = std::thread(empty_fn);
-
-    for (unsigned i = 0; i < commands.size(); i++) {
-      llvm::StringRef command = commands[i];
-      if (command.empty())
-        continue;
-      if (command.startswith("//"))
-        continue;
-
-      unsigned threadIdx = i % threadNum;
-      threads[threadIdx].join();
-
-      threads[threadIdx] = std::thread(
-          ::Compile, command, std::ref(m_dxcSupport), path.str(), bLibLink);
+      threads.emplace_back(&DxcBatchContext::RunWorker, this,
+                           llvm::ArrayRef<llvm::StringRef>(commands),
+                           path.str(), bLibLink, std::ref(results));
+
+    // Report progress while the workers run.
+    if (bReport) {
+      unsigned reported = 0;
+      while (m_nextCommand < commands.size()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        unsigned completed = m_completed;
+        if (completed != reported) {
+          fprintf(stderr, "progress: %u commands done\n", completed);
+          reported = completed;
+        }
+      }
     }
     for (auto &th : threads)
       th.join();
   } else {
-    for (llvm::StringRef command : commands) {
-      if (command.empty())
-        continue;
-      if (command.startswith("//"))
-        continue;
-      llvm::SmallVector<llvm::StringRef, 4> args;
-      command.split(args, " ");
-      Compile(command, m_dxcSupport, path.str(), bLibLink);
-    }
+    RunWorker(commands, path.str(), bLibLink, results);
+  }
+  auto t_end = std::chrono::high_resolution_clock::now();
+
+  if (bReport) {
+    PrintReport(commands, results,
+                std::chrono::duration<double, std::milli>(t_end - t_start)
+                    .count());
   }
   return 0;
 }
@@ -845,6 +921,8 @@ int __cdecl wmain(int argc, const wchar_t **argv_) {
     bool bMultiThread = false;
     const char *kLibLinkArg = "-lib-link";
     bool bLibLink = false;
+    const char *kReportArg = "-report";
+    bool bReport = false;
     // Parse command line options.
     const OptTable *optionTable = getHlslOptTable();
     MainArgs argStrings(argc, argv_);
@@ -857,10 +935,12 @@ int __cdecl wmain(int argc, const wchar_t **argv_) {
     std::vector<StringRef> refArgs;
     refArgs.reserve(args.size());
     for (auto &arg : args) {
-      if (arg != kMultiThreadArg && arg != kLibLinkArg) {
+      if (arg != kMultiThreadArg && arg != kLibLinkArg && arg != kReportArg) {
         refArgs.emplace_back(arg.c_str());
       } else if (arg == kLibLinkArg) {
         bLibLink = true;
+      } else if (arg == kReportArg) {
+        bReport = true;
       } else {
         bMultiThread = true;
       }
@@ -892,7 +972,7 @@ int __cdecl wmain(int argc, const wchar_t **argv_) {
       std::string helpString;
       llvm::raw_string_ostream helpStream(helpString);
       optionTable->PrintHelp(helpStream, "dxc_bach.exe", "HLSL Compiler");
-      helpStream << "multi-thread";
+      helpStream << "multi-thread\nlib-link\nreport";
       helpStream.flush();
       dxc::WriteUtf8ToConsoleSizeT(helpString.data(), helpString.size());
       return 0;
@@ -914,7 +994,7 @@ int __cdecl wmain(int argc, const wchar_t **argv_) {
     EnsureEnabled(dxcSupport);
     DxcBatchContext context(dxcOpts, dxcSupport);
     pStage = "BatchCompilation";
-    retVal = context.BatchCompile(bMultiThread, bLibLink);
+    retVal = context.BatchCompile(bMultiThread, bLibLink, bReport);
     {
       auto t_end = std::chrono::high_resolution_clock::now();
       double duration_ms =
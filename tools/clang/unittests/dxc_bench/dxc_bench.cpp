@@ -0,0 +1,374 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// dxc_bench.cpp                                                             //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Provides the entry point for the dxc_bench console program.               //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+// dxc_bench is a fork of dxc_batch that measures compile throughput over a
+// corpus of shaders instead of running a batch file.
+
+#include "dxc/Support/Global.h"
+#include "dxc/Support/Unicode.h"
+#include "dxc/Support/WinIncludes.h"
+#include <string>
+#include <vector>
+
+#include "dxc/Support/FileIOHelper.h"
+#include "dxc/Support/HLSLOptions.h"
+#include "dxc/Support/dxcapi.use.h"
+#include "dxc/Support/microcom.h"
+#include "dxc/dxcapi.h"
+#include "llvm/Option/ArgList.h"
+#include "llvm/Option/OptTable.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <chrono>
+
+#include "llvm/Support//MSFileSystem.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+
+using namespace dxc;
+using namespace llvm;
+using namespace llvm::opt;
+using namespace hlsl::options;
+
+// Overview:
+//
+// Every .hlsl file under the input is compiled with the entry point and
+// target from its first dxc RUN line (so the CodeGenHLSL corpus can be used
+// as is) plus the dxc options given to dxc_bench, a number of times in a
+// row. The compile with the median wall time is reported with
+// -report-phases, so the report is a tab-separated table with one row per
+// shader and phase:
+//
+//   shader  phase  depth  count  wall_us  allocs  alloc_bytes  peak_bytes
+//
+// where the Compile row at depth 0 covers the whole compile. Shaders without
+// a dxc RUN line are skipped; shaders that fail to compile get a single
+// "<failed>" row. Rows are in corpus order and contain no addresses, so the
+// reports of two builds can be diffed or joined on the first two columns.
+
+static void PrintHlslException(const ::hlsl::Exception &hlslException,
+                               llvm::StringRef stage) {
+  printf("%s failed\n", stage.str().c_str());
+  try {
+    const char *msg = hlslException.what();
+    Unicode::acp_char
+        printBuffer[128]; // printBuffer is safe to treat as
+                          // UTF-8 because we use ASCII only errors
+    if (msg == nullptr || *msg == '\0') {
+      if (hlslException.hr == E_OUTOFMEMORY) {
+        sprintf_s(printBuffer, _countof(printBuffer),
+                  "dxc_bench failed : Out of Memory.");
+      } else if (hlslException.hr == E_INVALIDARG) {
+        sprintf_s(printBuffer, _countof(printBuffer),
+                  "dxc_bench failed : Invalid argument.");
+      } else {
+        sprintf_s(printBuffer, _countof(printBuffer),
+                  "dxc_bench failed : error code 0x%08x.\n", hlslException.hr);
+      }
+      msg = printBuffer;
+    }
+
+    dxc::WriteUtf8ToConsoleSizeT(msg, strlen(msg), STD_ERROR_HANDLE);
+    printf("\n");
+  } catch (...) {
+    printf("  unable to retrieve error message.\n");
+  }
+}
+
+struct CorpusShader {
+  std::string Path;
+  std::wstring EntryPoint;
+  std::wstring TargetProfile;
+};
+
+// Finds the value of an option given as "-E main" or "-Emain" on a RUN line.
+static bool FindRunLineOption(StringRef Line, StringRef Name,
+                              std::wstring &Value) {
+  SmallVector<StringRef, 16> Tokens;
+  Line.split(Tokens, " ", -1, false);
+  for (size_t i = 0; i < Tokens.size(); ++i) {
+    StringRef T = Tokens[i];
+    if (!T.startswith("-") && !T.startswith("/"))
+      continue;
+    T = T.drop_front();
+    if (!T.startswith(Name))
+      continue;
+    StringRef V = T.drop_front(Name.size());
+    if (V.empty() && i + 1 < Tokens.size())
+      V = Tokens[i + 1];
+    if (V.empty())
+      return false;
+    Value = Unicode::UTF8ToUTF16StringOrThrow(V.str().c_str());
+    return true;
+  }
+  return false;
+}
+
+static bool ReadCorpusShader(StringRef Text, CorpusShader &Shader) {
+  SmallVector<StringRef, 8> Lines;
+  Text.split(Lines, "\n", 8, false);
+  for (StringRef Line : Lines) {
+    size_t Run = Line.find("RUN:");
+    if (Run == StringRef::npos || Line.find("%dxc", Run) == StringRef::npos)
+      continue;
+    Line = Line.substr(Line.find("%dxc", Run)).rtrim();
+    return FindRunLineOption(Line, "E", Shader.EntryPoint) &&
+           FindRunLineOption(Line, "T", Shader.TargetProfile);
+  }
+  return false;
+}
+
+class DxcBenchContext {
+public:
+  DxcBenchContext(DxcOpts &Opts, DxcDllSupport &dxcSupport)
+      : m_Opts(Opts), m_dxcSupport(dxcSupport) {}
+
+  int BenchCompile(unsigned iterations, raw_ostream &OS);
+
+private:
+  void CompileShader(const CorpusShader &Shader, IDxcBlobEncoding *pSource,
+                     IDxcCompiler *pCompiler, unsigned iterations,
+                     raw_ostream &OS);
+
+  DxcOpts &m_Opts;
+  DxcDllSupport &m_dxcSupport;
+  std::vector<std::wstring> m_args;
+};
+
+// Compiles a shader iterations times and writes the report of the compile
+// with the median wall time.
+void DxcBenchContext::CompileShader(const CorpusShader &Shader,
+                                    IDxcBlobEncoding *pSource,
+                                    IDxcCompiler *pCompiler,
+                                    unsigned iterations, raw_ostream &OS) {
+  std::vector<LPCWSTR> args;
+  for (const std::wstring &A : m_args)
+    args.push_back(A.c_str());
+  args.push_back(L"-report-phases");
+
+  std::wstring pathW = Unicode::UTF8ToUTF16StringOrThrow(Shader.Path.c_str());
+  std::vector<std::pair<double, CComPtr<IDxcBlobEncoding>>> runs;
+  for (unsigned i = 0; i < iterations; ++i) {
+    CComPtr<IDxcOperationResult> pResult;
+    auto t_start = std::chrono::high_resolution_clock::now();
+    IFT(pCompiler->Compile(pSource, pathW.c_str(),
+                           Shader.EntryPoint.c_str(),
+                           Shader.TargetProfile.c_str(), args.data(),
+                           (UINT32)args.size(), nullptr, 0, nullptr,
+                           &pResult));
+    auto t_end = std::chrono::high_resolution_clock::now();
+    HRESULT status;
+    IFT(pResult->GetStatus(&status));
+    if (FAILED(status)) {
+      OS << Shader.Path << "\t<failed>\t0\t0\t0\t0\t0\t0\n";
+      return;
+    }
+    CComPtr<IDxcOperationResultReport> pResultReport;
+    CComPtr<IDxcBlobEncoding> pReport;
+    IFT(pResult.QueryInterface(&pResultReport));
+    IFT(pResultReport->GetReport(&pReport));
+    runs.emplace_back(
+        std::chrono::duration<double, std::milli>(t_end - t_start).count(),
+        pReport);
+  }
+
+  std::sort(runs.begin(), runs.end(),
+            [](const std::pair<double, CComPtr<IDxcBlobEncoding>> &a,
+               const std::pair<double, CComPtr<IDxcBlobEncoding>> &b) {
+              return a.first < b.first;
+            });
+  IDxcBlobEncoding *pReport = runs[runs.size() / 2].second;
+  if (pReport == nullptr)
+    return;
+
+  // Prefix every row of the report but its header with the shader.
+  StringRef Report((const char *)pReport->GetBufferPointer(),
+                   pReport->GetBufferSize());
+  SmallVector<StringRef, 64> Rows;
+  Report.split(Rows, "\n", -1, false);
+  for (size_t i = 1; i < Rows.size(); ++i)
+    OS << Shader.Path << '\t' << Rows[i].ltrim() << '\n';
+}
+
+int DxcBenchContext::BenchCompile(unsigned iterations, raw_ostream &OS) {
+  // Every compile gets the compiler options given to dxc_bench; the entry
+  // point and target come from each shader instead.
+  ArgStringList argStrings;
+  for (const Arg *A : m_Opts.Args) {
+    const Option &O = A->getOption();
+    if (O.hasFlag(CoreOption) && !O.matches(OPT_entrypoint) &&
+        !O.matches(OPT_target_profile))
+      A->renderAsInput(m_Opts.Args, argStrings);
+  }
+  for (const char *argText : argStrings)
+    m_args.emplace_back(Unicode::UTF8ToUTF16StringOrThrow(argText));
+
+  std::vector<std::string> paths;
+  if (!llvm::sys::fs::is_directory(m_Opts.InputFile)) {
+    paths.push_back(m_Opts.InputFile);
+  } else {
+    std::error_code EC;
+    for (llvm::sys::fs::recursive_directory_iterator I(m_Opts.InputFile, EC), E;
+         I != E && !EC; I.increment(EC)) {
+      if (llvm::sys::path::extension(I->path()).equals_lower(".hlsl"))
+        paths.push_back(I->path());
+    }
+    IFTLLVM(EC);
+  }
+  // Keep the report stable across file systems.
+  std::sort(paths.begin(), paths.end());
+
+  // One compiler runs every compile, as dxc_batch's workers do.
+  CComPtr<IDxcCompiler> pCompiler;
+  IFT(m_dxcSupport.CreateInstance(CLSID_DxcCompiler, &pCompiler));
+
+  OS << "shader\tphase\tdepth\tcount\twall_us\tallocs\talloc_bytes\tpeak_bytes\n";
+  unsigned skipped = 0;
+  for (const std::string &path : paths) {
+    CorpusShader Shader;
+    Shader.Path = path;
+    CComPtr<IDxcBlobEncoding> pSource;
+    ReadFileIntoBlob(m_dxcSupport, StringRefUtf16(path), &pSource);
+    StringRef Text((const char *)pSource->GetBufferPointer(),
+                   pSource->GetBufferSize());
+    if (!ReadCorpusShader(Text, Shader)) {
+      ++skipped;
+      continue;
+    }
+    CompileShader(Shader, pSource, pCompiler, iterations, OS);
+  }
+  if (skipped)
+    fprintf(stderr, "Skipped %u shaders without a dxc RUN line.\n", skipped);
+  return 0;
+}
+
+int __cdecl wmain(int argc, const wchar_t **argv_) {
+  const char *pStage = "Initialization";
+  int retVal = 0;
+  if (FAILED(DxcInitThreadMalloc())) return 1;
+  DxcSetThreadMallocOrDefault(nullptr);
+  try {
+    llvm::sys::fs::MSFileSystem *msfPtr;
+    IFT(CreateMSFileSystemForDisk(&msfPtr));
+    std::unique_ptr<::llvm::sys::fs::MSFileSystem> msf(msfPtr);
+
+    ::llvm::sys::fs::AutoPerThreadSystem pts(msf.get());
+    IFTLLVM(pts.error_code());
+
+    std::error_code ec = hlsl::options::initHlslOptTable();
+    if (ec) {
+      fprintf(stderr, "%s failed - %s.\n", pStage, ec.message().c_str());
+      return ec.value();
+    }
+
+    pStage = "Argument processing";
+    const char *kIterationsArg = "-iterations";
+    unsigned iterations = 5;
+    const char *kReportFileArg = "-report-file";
+    std::string reportFile = "-";
+    // Parse command line options.
+    const OptTable *optionTable = getHlslOptTable();
+    MainArgs argStrings(argc, argv_);
+    llvm::ArrayRef<const char *> tmpArgStrings = argStrings.getArrayRef();
+    std::vector<std::string> args(tmpArgStrings.begin(), tmpArgStrings.end());
+    // Add target to avoid fail; each shader's own target is used instead.
+    args.emplace_back("-T");
+    args.emplace_back("lib_6_1");
+
+    std::vector<StringRef> refArgs;
+    refArgs.reserve(args.size());
+    for (size_t i = 0; i < args.size(); ++i) {
+      const std::string &arg = args[i];
+      if (arg != kIterationsArg && arg != kReportFileArg) {
+        refArgs.emplace_back(arg.c_str());
+        continue;
+      }
+      if (i + 1 == args.size()) {
+        fprintf(stderr, "dxc_bench failed : Argument to '%s' is missing\n",
+                arg.c_str());
+        return 1;
+      }
+      const std::string &value = args[++i];
+      if (arg == kReportFileArg) {
+        reportFile = value;
+      } else if (StringRef(value).getAsInteger(10, iterations) ||
+                 iterations == 0) {
+        fprintf(stderr, "dxc_bench failed : Invalid iteration count '%s'\n",
+                value.c_str());
+        return 1;
+      }
+    }
+
+    MainArgs benchArgStrings(refArgs);
+
+    DxcOpts dxcOpts;
+    DxcDllSupport dxcSupport;
+
+    // Read options and check errors.
+    {
+      std::string errorString;
+      llvm::raw_string_ostream errorStream(errorString);
+      int optResult = ReadDxcOpts(optionTable, DxcFlags, benchArgStrings,
+                                  dxcOpts, errorStream);
+      errorStream.flush();
+      if (errorString.size()) {
+        fprintf(stderr, "dxc_bench failed : %s", errorString.data());
+      }
+      if (optResult != 0) {
+        return optResult;
+      }
+    }
+
+    // Handle help request, which overrides any other processing.
+    if (dxcOpts.ShowHelp) {
+      std::string helpString;
+      llvm::raw_string_ostream helpStream(helpString);
+      optionTable->PrintHelp(helpStream, "dxc_bench.exe", "HLSL Compiler");
+      helpStream << "iterations <count>\nreport-file <file>";
+      helpStream.flush();
+      dxc::WriteUtf8ToConsoleSizeT(helpString.data(), helpString.size());
+      return 0;
+    }
+
+    // Setup a helper DLL.
+    {
+      std::string dllErrorString;
+      llvm::raw_string_ostream dllErrorStream(dllErrorString);
+      int dllResult = SetupDxcDllSupport(dxcOpts, dxcSupport, dllErrorStream);
+      dllErrorStream.flush();
+      if (dllErrorString.size()) {
+        fprintf(stderr, "%s", dllErrorString.data());
+      }
+      if (dllResult)
+        return dllResult;
+    }
+
+    EnsureEnabled(dxcSupport);
+    DxcBenchContext context(dxcOpts, dxcSupport);
+
+    std::error_code EC;
+    raw_fd_ostream OS(reportFile, EC, llvm::sys::fs::F_Text);
+    IFTLLVM(EC);
+
+    pStage = "Benchmarking";
+    retVal = context.BenchCompile(iterations, OS);
+  } catch (const ::hlsl::Exception &hlslException) {
+    PrintHlslException(hlslException, pStage);
+    return 1;
+  } catch (std::bad_alloc &) {
+    printf("%s failed - out of memory.\n", pStage);
+    return 1;
+  } catch (...) {
+    printf("%s failed - unknown error.\n", pStage);
+    return 1;
+  }
+  return retVal;
+}
@@ -1263,14 +1263,24 @@ class db_dxil(object):
         add_pass('mem2reg', 'PromotePass', 'Promote Memory to Register', [])
         add_pass('hlsl-dxil-precise', 'DxilPrecisePropagatePass', 'DXIL precise attribute propagate', [])
         add_pass('dxil-legalize-sample-offset', 'DxilLegalizeSampleOffsetPass', 'DXIL legalize sample offset', [])
+        add_pass('hlsl-dxil-hoist-handles', 'DxilHoistHandles', 'DXIL hoist handles', [])
+        add_pass('hlsl-dxil-hoist-invariant-reads', 'DxilHoistInvariantReads', 'DXIL hoist loop-invariant reads', [])
+        add_pass('hlsl-dxil-sink-resource-reads', 'DxilSinkResourceReads', 'DXIL sink resource reads', [])
+        add_pass('hlsl-dxil-groupshared-layout', 'DxilGroupSharedLayout', 'DXIL groupshared layout', [])
+        add_pass('hlsl-dxil-remove-redundant-barriers', 'DxilRemoveRedundantBarriers', 'DXIL remove redundant barriers', [])
+        add_pass('hlsl-dxil-annotate-uniform', 'DxilAnnotateUniform', 'DXIL annotate wave-uniform values', [])
+        add_pass('hlsl-dxil-demote-precision', 'DxilDemotePrecision', 'DXIL demote float math to half', [])
+        add_pass('hlsl-dxil-aggregate-atomics', 'DxilAggregateAtomics', 'DXIL aggregate wave-uniform atomics', [])
         add_pass('scalarizer', 'Scalarizer', 'Scalarize vector operations', [])
         add_pass('multi-dim-one-dim', 'MultiDimArrayToOneDimArray', 'Flatten multi-dim array into one-dim array', [])
         add_pass('resource-handle', 'ResourceToHandle', 'Lower resource into handle', [])
+        add_pass('lower-resource-vector-types', 'LowerResourceAndVectorTypes', 'Lower resource into handle and dynamic indexing vector into array', [])
         add_pass('hlsl-passes-nopause', 'NoPausePasses', 'Clears metadata used for pause and resume', [])
         add_pass('hlsl-passes-pause', 'PausePasses', 'Prepare to pause passes', [])
         add_pass('hlsl-passes-resume', 'ResumePasses', 'Prepare to resume passes', [])
         add_pass('hlsl-dxil-condense', 'DxilCondenseResources', 'DXIL Condense Resources', [])
         add_pass('hlsl-dxil-eliminate-output-dynamic', 'DxilEliminateOutputDynamicIndexing', 'DXIL eliminate ouptut dynamic indexing', [])
+        add_pass('hlsl-dxil-add-block-hit-instrumentation', 'DxilAddBlockHitInstrumentation', 'DXIL Count basic block executions', [])
         add_pass('hlsl-dxil-add-pixel-hit-instrmentation', 'DxilAddPixelHitInstrumentation', 'DXIL Count completed PS invocations and costs', [
             {'n':'force-early-z','t':'int','c':1},
             {'n':'add-pixel-cost','t':'int','c':1},
@@ -1289,14 +1299,20 @@ class db_dxil(object):
             {'n':'UAVSize','t':'int','c':1},
             {'n':'parameter0','t':'int','c':1},
             {'n':'parameter1','t':'int','c':1},
-            {'n':'parameter2','t':'int','c':1}])
+            {'n':'parameter2','t':'int','c':1},
+            {'n':'compact-packets','t':'int','c':1},
+            {'n':'sample-rate','t':'int','c':1},
+            {'n':'lines','t':'string','c':1},
+            {'n':'blocks','t':'string','c':1}])
         add_pass('hlsl-dxil-reduce-msaa-to-single', 'DxilReduceMSAAToSingleSample', 'HLSL DXIL Reduce all MSAA reads to single-sample reads', [])
         add_pass('hlsl-dxilfinalize', 'DxilFinalizeModule', 'HLSL DXIL Finalize Module', [])
         add_pass('hlsl-dxilemit', 'DxilEmitMetadata', 'HLSL DXIL Metadata Emit', [])
+        add_pass('hlsl-dxilfinalize-emit', 'DxilFinalizeAndEmit', 'HLSL DXIL Finalize Module and Metadata Emit', [])
         add_pass('hlsl-dxilload', 'DxilLoadMetadata', 'HLSL DXIL Metadata Load', [])
         add_pass('dxil-dfe', 'DxilDeadFunctionElimination', 'Remove all unused function except entry from DxilModule', [])
         add_pass('hl-dfe', 'HLDeadFunctionElimination', 'Remove all unused function except entry from HLModule', [])
-        add_pass('hlsl-dxil-expand-trig', 'DxilExpandTrigIntrinsics', 'DXIL expand trig intrinsics', [])
+        add_pass('hlsl-dxil-expand-trig-intrinsics', 'DxilExpandTrigIntrinsics', 'DXIL expand trig intrinsics', [
+            {'n':'relaxed','t':'bool','c':1,'d':'Use reduced precision expansions for 32-bit types'}])
         add_pass('hlsl-hca', 'HoistConstantArray', 'HLSL constant array hoisting', [])
         add_pass('hlsl-dxil-preserve-all-outputs', 'DxilPreserveAllOutputs', 'DXIL write to all outputs in signature', [])
         add_pass('ipsccp', 'IPSCCP', 'Interprocedural Sparse Conditional Constant Propagation', [])
@@ -2,6 +2,7 @@
 # This file is distributed under the University of Illinois Open Source License. See LICENSE.TXT for details.
 import argparse
 import functools
+import itertools
 import collections
 from hctdb import *
 
@@ -691,6 +692,22 @@ def enum_hlsl_intrinsics():
     result += "  Num_Intrinsics,\n"
     return result
 
+def get_hlsl_intrinsic_names():
+    db = get_db_hlsl()
+    result = ""
+    enumed = []
+    for i in sorted(db.intrinsics, key=lambda x: x.key):
+        if (i.enum_name not in enumed):
+            result += "    \"%s\",\n" % (i.enum_name)
+            enumed.append(i.enum_name)
+    # unsigned
+    for i in sorted(db.intrinsics, key=lambda x: x.key):
+        if (i.unsigned_op != ""):
+          if (i.unsigned_op not in enumed):
+            result += "    \"%s\",\n" % (i.unsigned_op)
+            enumed.append(i.unsigned_op)
+    return result
+
 def has_unsigned_hlsl_intrinsics():
     db = get_db_hlsl()
     result = ""
@@ -884,44 +901,23 @@ def get_opsigs():
     code += "};\n"
     return code
 
-def get_valopcode_sm_text():
+def get_valopcode_sm_table():
+    "Create the rows of the table of shader kinds and minimum shader model per DXIL operation."
     db = get_db_dxil()
     instrs = [i for i in db.instr if i.is_dxil_op]
-    instrs = sorted(instrs, key=lambda v : (v.shader_model, v.shader_stages, v.dxil_opid))
-    last_model = None
-    last_stage = None
-    grouped_instrs = []
+    instrs = sorted(instrs, key=lambda v : v.dxil_opid)
+    # Bit positions follow DXIL::ShaderKind.
+    stage_bits = { "p": 0, "v": 1, "g": 2, "h": 3, "d": 4, "c": 5 }
     code = ""
-    def flush_instrs(grouped_instrs, last_model, last_stage):
-        if len(grouped_instrs) == 0:
-            return ""
-        result = format_comment("// ", "Instructions: %s" % ", ".join([i.name + "=" + str(i.dxil_opid) for i in grouped_instrs]))
-        result += "if (" + build_range_code("op", [i.dxil_opid for i in grouped_instrs]) + ")\n"
-        result += "  return "
-
-        model_cond = stage_cond = None
-        if last_model != (6,0):
-            model_cond = "pSM->GetMajor() > %d || (pSM->GetMajor() == %d && pSM->GetMinor() >= %d)" % (
-                last_model[0], last_model[0], last_model[1])
-        if last_stage != "*":
-            stage_cond = ' || '.join(["pSM->Is%sS()" % c.upper() for c in last_stage])
-        if model_cond or stage_cond:
-            result += '\n      && '.join(
-                ["(%s)" % expr for expr in (model_cond, stage_cond) if expr] )
-            return result + ";\n"
-        else:
-            # don't write these out, instead fall through
-            return ""
-
     for i in instrs:
-        if (i.shader_model, i.shader_stages) != (last_model, last_stage):
-            code += flush_instrs(grouped_instrs, last_model, last_stage)
-            grouped_instrs = []
-            last_model = i.shader_model
-            last_stage = i.shader_stages
-        grouped_instrs.append(i)
-    code += flush_instrs(grouped_instrs, last_model, last_stage)
-    code += "return true;\n"
+        if i.shader_stages == "*":
+            mask = 0xff
+        else:
+            mask = 0
+            for c in i.shader_stages:
+                mask |= 1 << stage_bits[c]
+        code += "{ 0x%02x, %d, %d }, // %s=%d (%s)\n" % (
+            mask, i.shader_model[0], i.shader_model[1], i.name, i.dxil_opid, i.shader_stages)
     return code
 
 def get_sigpoint_table():
@@ -958,6 +954,36 @@ def get_interpretation_table():
     return run_with_stdout(lambda: gen.print_interpretation_table())
 
 
+def get_semantic_name_hash():
+    "Create a perfect hash of the system value semantic names."
+    db = get_db_dxil()
+    kinds = [v.name for v in db.enum_idx['SemanticKind'].values[1:-1]]  # Exclude Arbitrary and Invalid
+    # Names are hashed without their SV_ prefix, case-folded, from their
+    # length and their first, second and last characters.
+    def hash_name(name, mul, size):
+        s = name.lower()
+        return (len(s) * mul[0] + ord(s[0]) * mul[1] + ord(s[1]) * mul[2] + ord(s[-1])) & (size - 1)
+    size = 32
+    while True:
+        for mul in itertools.product(range(1, 32), repeat=3):
+            slots = [hash_name(k, mul, size) for k in kinds]
+            if len(set(slots)) == len(kinds):
+                table = ['Invalid'] * size
+                for k, slot in zip(kinds, slots):
+                    table[slot] = k
+                result = "static const unsigned kSemanticNameHashSize = %d;\n\n" % size
+                result += "static unsigned HashSemanticName(llvm::StringRef Name) {\n"
+                result += "  return ((unsigned)Name.size() * %d + ((unsigned char)Name[0] | 0x20) * %d +\n" % mul[:2]
+                result += "          ((unsigned char)Name[1] | 0x20) * %d + ((unsigned char)Name.back() | 0x20)) &\n" % mul[2]
+                result += "         (kSemanticNameHashSize - 1);\n"
+                result += "}\n\n"
+                result += "static const DXIL::SemanticKind SemanticNameHashTable[kSemanticNameHashSize] = {\n"
+                for k in table:
+                    result += "  DXIL::SemanticKind::%s,\n" % k
+                result += "};\n"
+                return result
+        size *= 2
+
 def RunCodeTagUpdate(file_path):
     import os
     import CodeTags
@@ -1035,6 +1061,7 @@ if __name__ == "__main__":
             'include/dxc/HlslIntrinsicOp.h',
             'tools/clang/tools/dxcompiler/dxcdisassembler.cpp',
             'include/dxc/HLSL/DxilSigPoint.inl',
+            'lib/HLSL/DxilSemantic.cpp',
             ]
         for relative_file_path in files:
             RunCodeTagUpdate(pj(hlsl_src_dir, relative_file_path))
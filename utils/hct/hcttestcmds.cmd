@@ -33,6 +33,26 @@ if %errorlevel% neq 0 (
   exit /b 1
 )
 
+rem Server requests separate arguments with tabs.
+echo /T	ps_6_0	%script_dir%\smoke.hlsl	/Fo	smoke.server.cso> smoke.server.req
+dxc.exe -server < smoke.server.req > smoke.server.txt
+if %errorlevel% neq 0 (
+  echo Failed - %CD%\dxc.exe -server ^< %CD%\smoke.server.req
+  call :cleanup 2>nul
+  exit /b 1
+)
+findstr /b /c:"dxc-response 0 " smoke.server.txt 1>nul
+if %errorlevel% neq 0 (
+  echo Failed to find successful response in %CD%\smoke.server.txt
+  call :cleanup 2>nul
+  exit /b 1
+)
+if not exist smoke.server.cso (
+  echo Failed to find server output %CD%\smoke.server.cso
+  call :cleanup 2>nul
+  exit /b 1
+)
+
 dxc.exe /T ps_6_0 %script_dir%\smoke.hlsl /Zi /Fd smoke.hlsl.d 1>nul
 if %errorlevel% neq 0 (
   echo Failed - %CD%\dxc.exe /T ps_6_0 %script_dir%\smoke.hlsl /Zi /Fd %CD%\smoke.hlsl.d
@@ -645,6 +665,9 @@ del %CD%\smoke.opt.ll
 del %CD%\smoke.opt.prn.txt
 del %CD%\smoke.rebuilt-container.cso
 del %CD%\smoke.rebuilt-container2.cso
+del %CD%\smoke.server.cso
+del %CD%\smoke.server.req
+del %CD%\smoke.server.txt
 rem SPIR-V Change Starts
 del %CD%\smoke.spirv.log
 rem SPIR-V Change Ends